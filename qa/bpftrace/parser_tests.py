@@ -1,6 +1,7 @@
 import unittest
 from cpmapi import PM_SEM_COUNTER
-from bpftrace.parser import parse_code, process_bpftrace_output_obj
+from bpftrace.parser import parse_code, process_bpftrace_output_obj, is_shareable, merge_scripts, \
+    process_shared_output
 from bpftrace.models import Script, RuntimeInfo, MetricType
 
 
@@ -92,5 +93,33 @@ class ParserTests(unittest.TestCase):
         assert_output('header\nline 10\nline 11\nline 12\n')
 
 
+    def testShareable(self):
+        script = parse_code(Script('kprobe:vfs_read { @reads = count(); }'))
+        self.assertTrue(is_shareable(script))
+        script = parse_code(Script('kprobe:vfs_read { printf("read\\n"); }'))
+        self.assertFalse(is_shareable(script))
+        script = parse_code(Script('BEGIN { @start = nsecs; }'))
+        self.assertFalse(is_shareable(script))
+
+    def testMergeScripts(self):
+        runtime_info = RuntimeInfo()
+        a = parse_code(Script('#include <linux/fs.h>\n'
+                              'kprobe:vfs_read { @[comm] = count(); } // @ignored'))
+        b = parse_code(Script('#include <linux/fs.h>\n'
+                              'kprobe:vfs_write { @bytes = hist(arg2); }'))
+        members = {'_0_': a, '_1_': b}
+        code = merge_scripts(members)
+        self.assertEqual(code.count('#include'), 1)
+        self.assertIn('@_0_[comm] = count(); } // @ignored', code)
+        self.assertIn('@_1_bytes = hist(arg2);', code)
+        self.assertIn('interval:s:1 { print(@_0_); print(@_1_bytes); }', code)
+
+        process_shared_output(runtime_info, members, '{"type": "map", "data": {"@_0_": {"bash": 3}}}')
+        process_shared_output(runtime_info, members, '{"type": "hist", "data": {"@_1_bytes": '
+                                                     '[{"min": 1, "max": 1, "count": 2}]}}')
+        self.assertEqual(a.state.data, {'@': {'bash': 3}})
+        self.assertEqual(b.state.data, {'@bytes': {'1-1': 2}})
+
+
 if __name__ == '__main__':
     unittest.main()
@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ */
+
+#include <pcp/pmapi.h>
+#include "libpcp.h"
+
+/*
+ * Check the host access list matching used by __pmAccAddClient and
+ * __pmAccDelClient: overlapping wildcards where the more specific
+ * entry overrides the more general ones, IPv4 and IPv6, wildcards with
+ * masks that are not a prefix ("fec0::1:*") and unix domain entries
+ * (both matched without the prefix tree), client addresses differing
+ * only in bits outside an entry's mask, and the connection limits.
+ */
+
+static struct {
+    const char		*name;
+    unsigned int	specOps;
+    unsigned int	denyOps;
+    int			maxcons;
+} hosts[] = {
+    { ".*",		0x80, 0x80, 0 },
+    { "155.*",		0x0f, 0x0f, 0 },
+    { "155.23.*",	0x03, 0x00, 3 },
+    { "155.23.6.*",	0x01, 0x01, 2 },
+    { "155.23.6.7",	0x0c, 0x04, 0 },
+    { "155.23.7.*",	0x7f, 0x7f, 0 },
+    { "10.*",		0x30, 0x10, 1 },
+    { ":*",		0x40, 0x40, 0 },
+    { "fec0:*",		0x0f, 0x0c, 0 },
+    { "fec0:0:0:*",	0x02, 0x02, 2 },
+    { "fec0::1:*",	0x04, 0x00, 1 },
+    { "fec0::1:7",	0x08, 0x08, 0 },
+    { "unix:",		0xc0, 0x40, 2 },
+};
+#define NHOSTS	(int)(sizeof(hosts)/sizeof(hosts[0]))
+
+static const char *clients[] = {
+    "155.23.6.7", "155.23.6.8", "155.23.6.255", "155.23.5.1", "155.23.7.1",
+    "155.24.6.7", "155.255.255.255", "156.23.6.7", "10.1.2.3", "11.0.0.1",
+    "fec0::1:7", "fec0::1:8", "fec0:1::1:7", "fec0:0:0:1::1:7", "fec0::2:1",
+    "fec0::5", "fe80::1", "2001:db8::1", "/tmp/pmcd.socket",
+};
+#define NCLIENTS	(int)(sizeof(clients)/sizeof(clients[0]))
+
+static int
+addclient(const char *name, int verbose)
+{
+    __pmSockAddr	*addr;
+    unsigned int	denyOps;
+    int			sts;
+
+    if ((addr = __pmStringToSockAddr(name)) == NULL) {
+	printf("%s: __pmStringToSockAddr failed\n", name);
+	exit(1);
+    }
+    sts = __pmAccAddClient(addr, &denyOps);
+    __pmSockAddrFree(addr);
+    if (verbose) {
+	if (sts < 0)
+	    printf("  %-16s %s\n", name, pmErrStr(sts));
+	else
+	    printf("  %-16s deny 0x%02x\n", name, denyOps);
+    }
+    return sts;
+}
+
+static void
+delclient(const char *name)
+{
+    __pmSockAddr	*addr;
+
+    if ((addr = __pmStringToSockAddr(name)) == NULL) {
+	printf("%s: __pmStringToSockAddr failed\n", name);
+	exit(1);
+    }
+    __pmAccDelClient(addr);
+    __pmSockAddrFree(addr);
+}
+
+static void
+allclients(void)
+{
+    int		i;
+
+    for (i = 0; i < NCLIENTS; i++) {
+	if (addclient(clients[i], 1) == 0)
+	    delclient(clients[i]);
+    }
+}
+
+/* connect until refused, then show the limit is per-connection */
+static void
+connlimit(const char *name)
+{
+    int		i, n;
+
+    printf("\n%s:\n", name);
+    for (n = 0; n < 5; n++) {
+	if (addclient(name, 1) < 0)
+	    break;
+    }
+    __pmAccDumpHosts(stdout);
+    if (n > 0) {
+	delclient(name);
+	printf("after one disconnect\n");
+	addclient(name, 1);
+	addclient(name, 1);
+    }
+    for (i = 0; i < n; i++)
+	delclient(name);
+}
+
+int
+main(int argc, char **argv)
+{
+    int		sts, i;
+
+    pmSetProgname(argv[0]);
+    if (argc > 1 && (sts = pmSetDebug(argv[1])) < 0) {
+	fprintf(stderr, "%s: bad debug option (%s)\n", pmGetProgname(), argv[1]);
+	exit(1);
+    }
+
+    for (i = 0; i < 8; i++) {
+	if ((sts = __pmAccAddOp(1 << i)) < 0) {
+	    printf("__pmAccAddOp(0x%x): %s\n", 1 << i, pmErrStr(sts));
+	    exit(1);
+	}
+    }
+
+    printf("=== no host access list ===\n");
+    addclient(clients[0], 1);
+
+    for (i = 0; i < NHOSTS; i++) {
+	if ((sts = __pmAccAddHost(hosts[i].name, hosts[i].specOps,
+				  hosts[i].denyOps, hosts[i].maxcons)) < 0) {
+	    printf("__pmAccAddHost(%s): %s\n", hosts[i].name, pmErrStr(sts));
+	    exit(1);
+	}
+    }
+    printf("\n=== host access list ===\n");
+    __pmAccDumpHosts(stdout);
+
+    printf("\n=== clients ===\n");
+    allclients();
+
+    printf("\n=== connection limits ===");
+    connlimit("155.23.6.8");
+    connlimit("155.23.5.1");
+    connlimit("10.1.2.3");
+    connlimit("fec0::1:8");
+    connlimit("fec0:0:0:1::1:7");
+    connlimit("/tmp/pmcd.socket");
+    printf("\nall disconnected\n");
+    __pmAccDumpHosts(stdout);
+
+    printf("\n=== hosts added and merged with clients connected ===\n");
+    addclient("155.23.6.8", 1);
+    addclient("fec0::1:8", 1);
+    if ((sts = __pmAccAddHost("155.23.6.8", 0x30, 0x20, 0)) < 0)
+	printf("__pmAccAddHost(155.23.6.8): %s\n", pmErrStr(sts));
+    if ((sts = __pmAccAddHost("155.23.*", 0x40, 0x00, 0)) < 0)
+	printf("__pmAccAddHost(155.23.*): %s\n", pmErrStr(sts));
+    if ((sts = __pmAccAddHost("fec0::1:*", 0x08, 0x00, 0)) < 0)
+	printf("__pmAccAddHost(fec0::1:*): %s\n", pmErrStr(sts));
+    if ((sts = __pmAccAddHost("fec0::*", 0x10, 0x10, 0)) < 0)
+	printf("__pmAccAddHost(fec0::*): %s\n", pmErrStr(sts));
+    allclients();
+    delclient("155.23.6.8");
+    delclient("fec0::1:8");
+    __pmAccDumpHosts(stdout);
+
+    printf("\n=== saved and restored host access list ===\n");
+    if ((sts = __pmAccSaveHosts()) < 0) {
+	printf("__pmAccSaveHosts: %s\n", pmErrStr(sts));
+	exit(1);
+    }
+    if ((sts = __pmAccAddHost("155.*", 0x0f, 0x00, 0)) < 0)
+	printf("__pmAccAddHost(155.*): %s\n", pmErrStr(sts));
+    printf("new list\n");
+    allclients();
+    if ((sts = __pmAccRestoreHosts()) < 0) {
+	printf("__pmAccRestoreHosts: %s\n", pmErrStr(sts));
+	exit(1);
+    }
+    printf("restored list\n");
+    allclients();
+
+    return 0;
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * Exercise pmiPutAtomValues, writing a matrix of values (one row per
+ * timestamp, one column per handle) in a single call, and its error
+ * handling.
+ */
+
+#include <pcp/pmapi.h>
+#include <pcp/import.h>
+
+#define NCOL	5
+
+static void
+check(int sts, char *name)
+{
+    if (sts < 0)
+	printf("%s: Error: %s\n", name, pmiErrStr(sts));
+    else
+	printf("%s: OK ->%d\n", name, sts);
+}
+
+int
+main(int argc, char **argv)
+{
+    int			sts;
+    int			c;
+    int			errflag = 0;
+    int			nsamples = 20;
+    int			s, h;
+    int			handles[NCOL];
+    int			dups[2];
+    char		*endnum;
+    struct timespec	*stamps;
+    pmAtomValue		*values;
+    pmAtomValue		*row;
+    static char		*strings[] = { "alpha", "bravo", "charlie" };
+
+    pmSetProgname(argv[0]);
+
+    while ((c = getopt(argc, argv, "D:s:?")) != EOF) {
+	switch (c) {
+
+	case 'D':	/* debug options */
+	    sts = pmSetDebug(optarg);
+	    if (sts < 0) {
+		fprintf(stderr, "%s: unrecognized debug options specification (%s)\n",
+		    pmGetProgname(), optarg);
+		errflag++;
+	    }
+	    break;
+
+	case 's':	/* sample count */
+	    nsamples = (int)strtol(optarg, &endnum, 10);
+	    if (*endnum != '\0' || nsamples < 1) {
+		fprintf(stderr, "%s: -s requires a positive integer\n", pmGetProgname());
+		errflag++;
+	    }
+	    break;
+
+	case '?':
+	default:
+	    errflag++;
+	    break;
+	}
+    }
+
+    if (errflag || optind != argc - 1) {
+	fprintf(stderr, "Usage: %s [-D debug] [-s samples] archive\n", pmGetProgname());
+	exit(1);
+    }
+
+    check(pmiStart(argv[optind], 0), "pmiStart");
+    check(pmiSetHostname("bulk.example.com"), "pmiSetHostname");
+    check(pmiSetTimezone("UTC"), "pmiSetTimezone");
+
+    check(pmiAddMetric("bulk.u32", pmiID(245,0,1), PM_TYPE_U32, PM_INDOM_NULL,
+		PM_SEM_COUNTER, pmiUnits(0,0,1,0,0,PM_COUNT_ONE)), "pmiAddMetric");
+    check(pmiAddMetric("bulk.double", pmiID(245,0,2), PM_TYPE_DOUBLE,
+		pmiInDom(245,0), PM_SEM_INSTANT, pmiUnits(0,0,0,0,0,0)),
+		"pmiAddMetric");
+    check(pmiAddMetric("bulk.string", pmiID(245,0,3), PM_TYPE_STRING,
+		PM_INDOM_NULL, PM_SEM_DISCRETE, pmiUnits(0,0,0,0,0,0)),
+		"pmiAddMetric");
+    check(pmiAddMetric("bulk.u64", pmiID(245,0,4), PM_TYPE_U64, PM_INDOM_NULL,
+		PM_SEM_COUNTER, pmiUnits(1,0,0,PM_SPACE_BYTE,0,0)), "pmiAddMetric");
+    check(pmiAddInstance(pmiInDom(245,0), "red", 1), "pmiAddInstance");
+    check(pmiAddInstance(pmiInDom(245,0), "green", 2), "pmiAddInstance");
+
+    /* columns interleave the metrics, they are regrouped per record */
+    check(handles[0] = pmiGetHandle("bulk.double", "green"), "pmiGetHandle");
+    check(handles[1] = pmiGetHandle("bulk.u32", NULL), "pmiGetHandle");
+    check(handles[2] = pmiGetHandle("bulk.double", "red"), "pmiGetHandle");
+    check(handles[3] = pmiGetHandle("bulk.string", NULL), "pmiGetHandle");
+    check(handles[4] = pmiGetHandle("bulk.u64", NULL), "pmiGetHandle");
+
+    stamps = (struct timespec *)calloc(nsamples, sizeof(*stamps));
+    values = (pmAtomValue *)calloc(nsamples * NCOL, sizeof(*values));
+    if (stamps == NULL || values == NULL) {
+	fprintf(stderr, "%s: out of memory\n", pmGetProgname());
+	exit(1);
+    }
+    for (s = 0; s < nsamples; s++) {
+	stamps[s].tv_sec = 1700000000 + s;
+	stamps[s].tv_nsec = 250000000;
+	row = &values[s * NCOL];
+	row[0].d = s * 1.5;
+	row[1].ul = 100 + s;
+	row[2].d = -s * 0.25;
+	row[3].cp = strings[s % 3];
+	row[4].ull = 0x100000000ULL * s;
+    }
+
+    /* first half, then the remainder, in two calls */
+    check(pmiPutAtomValues(NCOL, handles, nsamples / 2, stamps, values),
+		"pmiPutAtomValues");
+    check(pmiPutAtomValues(NCOL, handles, nsamples - nsamples / 2,
+		&stamps[nsamples / 2], &values[(nsamples / 2) * NCOL]),
+		"pmiPutAtomValues");
+
+    /* error cases, none of which write anything */
+    check(pmiPutAtomValues(NCOL, handles, 1, stamps, values),
+		"pmiPutAtomValues (time goes backwards)");
+    h = handles[1];
+    handles[1] = 42;
+    check(pmiPutAtomValues(NCOL, handles, 1, &stamps[nsamples-1], values),
+		"pmiPutAtomValues (bad handle)");
+    handles[1] = h;
+    dups[0] = dups[1] = handles[2];
+    check(pmiPutAtomValues(2, dups, 1, &stamps[nsamples-1], values),
+		"pmiPutAtomValues (duplicate)");
+    check(pmiPutAtomValues(NCOL, handles, 0, stamps, values),
+		"pmiPutAtomValues (no data)");
+
+    /* and the string interface still works after the bulk calls */
+    check(pmiPutValueHandle(handles[1], "1234"), "pmiPutValueHandle");
+    check(pmiWrite(stamps[nsamples-1].tv_sec + 1, 0), "pmiWrite");
+
+    check(pmiEnd(), "pmiEnd");
+
+    free(stamps);
+    free(values);
+    exit(0);
+}
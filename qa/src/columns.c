@@ -0,0 +1,348 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * Exercise __pmExtractColumn() ... the values and errors must be the
+ * same as from pmExtractValue() for every pmValue, and with -a, report
+ * the values from a fetchgroup for some instance domain metrics in an
+ * archive (rate converted for counters), which now uses columns.
+ */
+
+#include <pcp/pmapi.h>
+#include "libpcp.h"
+#include <limits.h>
+
+static const int	numeric[] = {
+    PM_TYPE_32, PM_TYPE_U32, PM_TYPE_64, PM_TYPE_U64,
+    PM_TYPE_FLOAT, PM_TYPE_DOUBLE
+};
+#define NUMERIC	(sizeof(numeric)/sizeof(numeric[0]))
+
+#define MAXVAL	8
+
+static int	nmismatch;
+
+static size_t
+typesize(int type)
+{
+    switch (type) {
+	case PM_TYPE_32:
+	case PM_TYPE_U32:
+	case PM_TYPE_FLOAT:
+	    return 4;
+    }
+    return 8;
+}
+
+static void *
+colvalue(const __pmColumn *cp, int i)
+{
+    switch (cp->type) {
+	case PM_TYPE_32:
+	    return &cp->value.l[i];
+	case PM_TYPE_U32:
+	    return &cp->value.ul[i];
+	case PM_TYPE_64:
+	    return &cp->value.ll[i];
+	case PM_TYPE_U64:
+	    return &cp->value.ull[i];
+	case PM_TYPE_FLOAT:
+	    return &cp->value.f[i];
+    }
+    return &cp->value.d[i];
+}
+
+/*
+ * build a pmValueSet with values of type itype, as DPTR pmValueBlocks
+ * unless insitu ... if bad, the last value has the wrong vtype
+ */
+static pmValueSet *
+mkvset(int itype, int insitu, int numval, const pmAtomValue *av, int bad)
+{
+    pmValueSet	*vsp;
+    int		i;
+
+    vsp = (pmValueSet *)calloc(1, sizeof(pmValueSet) + (numval-1) * sizeof(pmValue));
+    vsp->pmid = pmID_build(29, 0, itype);
+    vsp->numval = numval;
+    vsp->valfmt = insitu ? PM_VAL_INSITU : PM_VAL_DPTR;
+    for (i = 0; i < numval; i++) {
+	vsp->vlist[i].inst = 100 - i;
+	if (insitu)
+	    vsp->vlist[i].value.lval = av[i].l;
+	else {
+	    pmValueBlock	*vbp;
+
+	    vbp = (pmValueBlock *)calloc(1, PM_VAL_HDR_SIZE + sizeof(pmAtomValue));
+	    vbp->vlen = PM_VAL_HDR_SIZE + typesize(itype);
+	    vbp->vtype = (bad && i == numval-1) ? PM_TYPE_STRING : itype;
+	    memcpy(vbp->vbuf, &av[i], typesize(itype));
+	    vsp->vlist[i].value.pval = vbp;
+	}
+    }
+    return vsp;
+}
+
+static void
+freevset(pmValueSet *vsp)
+{
+    int		i;
+
+    if (vsp->valfmt != PM_VAL_INSITU) {
+	for (i = 0; i < vsp->numval; i++)
+	    free(vsp->vlist[i].value.pval);
+    }
+    free(vsp);
+}
+
+static void
+check(pmValueSet *vsp, int itype, __pmColumn *cp, const char *tag)
+{
+    pmAtomValue	av;
+    char	ibuf[20], obuf[20];
+    int		o, i, sts, nerr;
+
+    for (o = 0; o < NUMERIC; o++) {
+	sts = __pmExtractColumn(vsp, itype, numeric[o], cp);
+	if (sts != vsp->numval) {
+	    printf("%s %s -> %s: __pmExtractColumn: %d, expected %d\n", tag,
+		   pmTypeStr_r(itype, ibuf, sizeof(ibuf)),
+		   pmTypeStr_r(numeric[o], obuf, sizeof(obuf)), sts, vsp->numval);
+	    nmismatch++;
+	    continue;
+	}
+	nerr = 0;
+	for (i = 0; i < vsp->numval; i++) {
+	    sts = pmExtractValue(vsp->valfmt, &vsp->vlist[i], itype, &av, numeric[o]);
+	    if (sts < 0)
+		nerr++;
+	    if (cp->inst[i] != vsp->vlist[i].inst || cp->sts[i] != sts ||
+		(sts == 0 &&
+		 memcmp(colvalue(cp, i), &av, typesize(numeric[o])) != 0)) {
+		printf("%s %s -> %s: [%d] inst %d sts %d, expected inst %d sts %d\n", tag,
+		       pmTypeStr_r(itype, ibuf, sizeof(ibuf)),
+		       pmTypeStr_r(numeric[o], obuf, sizeof(obuf)),
+		       i, cp->inst[i], cp->sts[i], vsp->vlist[i].inst, sts);
+		nmismatch++;
+	    }
+	}
+	if (cp->nerr != nerr) {
+	    printf("%s %s -> %s: nerr %d, expected %d\n", tag,
+		   pmTypeStr_r(itype, ibuf, sizeof(ibuf)),
+		   pmTypeStr_r(numeric[o], obuf, sizeof(obuf)), cp->nerr, nerr);
+	    nmismatch++;
+	}
+	printf("%s %s -> %s: %d values, %d errors\n", tag,
+	       pmTypeStr_r(itype, ibuf, sizeof(ibuf)),
+	       pmTypeStr_r(numeric[o], obuf, sizeof(obuf)), vsp->numval, nerr);
+    }
+}
+
+static void
+selfcheck(void)
+{
+    __pmColumn	col;
+    pmAtomValue	av[MAXVAL];
+    pmValueSet	*vsp;
+    int		sts;
+    int		n = 6;
+
+    memset(&col, 0, sizeof(col));
+
+    /* insitu */
+    av[0].l = 0; av[1].l = 1; av[2].l = -1;
+    av[3].l = INT_MAX; av[4].l = INT_MIN; av[5].l = 123456;
+    vsp = mkvset(PM_TYPE_32, 1, n, av, 0);
+    check(vsp, PM_TYPE_32, &col, "insitu");
+    check(vsp, PM_TYPE_U32, &col, "insitu");
+    check(vsp, PM_TYPE_64, &col, "insitu");
+    sts = __pmExtractColumn(vsp, PM_TYPE_32, PM_TYPE_STRING, &col);
+    printf("insitu 32 -> STRING: %s\n", pmErrStr(sts));
+    freevset(vsp);
+
+    /* DPTR */
+    av[0].ll = 0; av[1].ll = 1; av[2].ll = -1;
+    av[3].ll = LLONG_MAX; av[4].ll = LLONG_MIN; av[5].ll = 1LL << 40;
+    vsp = mkvset(PM_TYPE_64, 0, n, av, 0);
+    check(vsp, PM_TYPE_64, &col, "dptr");
+    freevset(vsp);
+    vsp = mkvset(PM_TYPE_64, 0, n, av, 1);
+    check(vsp, PM_TYPE_64, &col, "dptr bad vtype");
+    freevset(vsp);
+
+    av[0].ull = 0; av[1].ull = 1; av[2].ull = (1ULL << 63) + 5;
+    av[3].ull = ULLONG_MAX; av[4].ull = 1ULL << 32; av[5].ull = 42;
+    vsp = mkvset(PM_TYPE_U64, 0, n, av, 0);
+    check(vsp, PM_TYPE_U64, &col, "dptr");
+    freevset(vsp);
+
+    av[0].d = 0; av[1].d = -1.5; av[2].d = 1e300;
+    av[3].d = -1e300; av[4].d = 3.5e9; av[5].d = 4.3e9;
+    vsp = mkvset(PM_TYPE_DOUBLE, 0, n, av, 0);
+    check(vsp, PM_TYPE_DOUBLE, &col, "dptr");
+    freevset(vsp);
+
+    av[0].f = 0; av[1].f = -1.5; av[2].f = 3e38;
+    av[3].f = 1e10; av[4].f = 65536; av[5].f = -3e38;
+    vsp = mkvset(PM_TYPE_FLOAT, 0, n, av, 0);
+    check(vsp, PM_TYPE_FLOAT, &col, "dptr");
+    freevset(vsp);
+
+    /* more values than before, so the column grows */
+    n = MAXVAL;
+    av[6].ll = 7; av[7].ll = -7;
+    vsp = mkvset(PM_TYPE_U32, 1, n, av, 0);
+    check(vsp, PM_TYPE_U32, &col, "grow");
+    printf("index of inst %d: %d (hint %d), %d (hint %d), inst %d: %d\n",
+	   col.inst[3], __pmColumnIndex(&col, col.inst[3], 3), 3,
+	    __pmColumnIndex(&col, col.inst[3], 0), 0,
+	   1000, __pmColumnIndex(&col, 1000, 0));
+    freevset(vsp);
+
+    /* error from the pmValueSet */
+    vsp = mkvset(PM_TYPE_32, 1, 1, av, 0);
+    vsp->numval = PM_ERR_PMID;
+    sts = __pmExtractColumn(vsp, PM_TYPE_32, PM_TYPE_32, &col);
+    printf("numval error: %s numval %d\n", pmErrStr(sts), col.numval);
+    vsp->numval = 1;
+    freevset(vsp);
+
+    __pmFreeColumn(&col);
+    printf("%d mismatches\n", nmismatch);
+}
+
+static void
+archive(const char *name, int samples, int nmetric, char **metrics)
+{
+    pmFG	fg;
+    pmDesc	desc;
+    pmID	pmid;
+    unsigned	*num;
+    int		*fg_sts;
+    int		**stss;
+    int		**insts;
+    pmAtomValue	**values;
+    int		m, s, j;
+    int		sts;
+    enum { maxinst = 1024 };
+
+    if ((sts = pmCreateFetchGroup(&fg, PM_CONTEXT_ARCHIVE, name)) < 0) {
+	fprintf(stderr, "pmCreateFetchGroup(%s): %s\n", name, pmErrStr(sts));
+	exit(1);
+    }
+    num = (unsigned *)calloc(nmetric, sizeof(unsigned));
+    fg_sts = (int *)calloc(nmetric, sizeof(int));
+    stss = (int **)calloc(nmetric, sizeof(int *));
+    insts = (int **)calloc(nmetric, sizeof(int *));
+    values = (pmAtomValue **)calloc(nmetric, sizeof(pmAtomValue *));
+    pmUseContext(pmGetFetchGroupContext(fg));
+    for (m = 0; m < nmetric; m++) {
+	stss[m] = (int *)calloc(maxinst, sizeof(int));
+	insts[m] = (int *)calloc(maxinst, sizeof(int));
+	values[m] = (pmAtomValue *)calloc(maxinst, sizeof(pmAtomValue));
+	if ((sts = pmLookupName(1, (const char **)&metrics[m], &pmid)) < 0 ||
+	    (sts = pmLookupDesc(pmid, &desc)) < 0) {
+	    fprintf(stderr, "%s: %s\n", metrics[m], pmErrStr(sts));
+	    exit(1);
+	}
+	sts = pmExtendFetchGroup_indom(fg, metrics[m],
+			desc.sem == PM_SEM_COUNTER ? "rate" : NULL,
+			insts[m], NULL, values[m], PM_TYPE_DOUBLE,
+			stss[m], maxinst, &num[m], &fg_sts[m]);
+	if (sts < 0) {
+	    fprintf(stderr, "pmExtendFetchGroup_indom(%s): %s\n", metrics[m], pmErrStr(sts));
+	    exit(1);
+	}
+    }
+    for (s = 0; s < samples; s++) {
+	if ((sts = pmFetchGroup(fg)) < 0) {
+	    printf("pmFetchGroup: %s\n", pmErrStr(sts));
+	    break;
+	}
+	printf("sample %d\n", s);
+	for (m = 0; m < nmetric; m++) {
+	    printf("  %s: sts %d, %u instances\n", metrics[m], fg_sts[m], num[m]);
+	    for (j = 0; j < num[m]; j++) {
+		if (stss[m][j] < 0)
+		    printf("    [%d] %s\n", insts[m][j], pmErrStr(stss[m][j]));
+		else
+		    printf("    [%d] %.6g\n", insts[m][j], values[m][j].d);
+	    }
+	}
+    }
+    pmDestroyFetchGroup(fg);
+    for (m = 0; m < nmetric; m++) {
+	free(stss[m]);
+	free(insts[m]);
+	free(values[m]);
+    }
+    free(num);
+    free(fg_sts);
+    free(stss);
+    free(insts);
+    free(values);
+}
+
+int
+main(int argc, char **argv)
+{
+    int		c;
+    int		errflag = 0;
+    int		samples = 3;
+    char	*endnum;
+    char	*name = NULL;
+
+    pmSetProgname(argv[0]);
+
+    while ((c = getopt(argc, argv, "a:D:s:?")) != EOF) {
+	switch (c) {
+
+	case 'a':	/* archive */
+	    name = optarg;
+	    break;
+
+	case 'D':	/* debug options */
+	    if (pmSetDebug(optarg) < 0) {
+		fprintf(stderr, "%s: unrecognized debug options specification (%s)\n",
+		    pmGetProgname(), optarg);
+		errflag++;
+	    }
+	    break;
+
+	case 's':	/* number of samples */
+	    samples = (int)strtol(optarg, &endnum, 10);
+	    if (*endnum != '\0' || samples < 1) {
+		fprintf(stderr, "%s: -s requires positive numeric argument\n", pmGetProgname());
+		errflag++;
+	    }
+	    break;
+
+	case '?':
+	default:
+	    errflag++;
+	    break;
+	}
+    }
+
+    if (errflag || (name == NULL && optind != argc) ||
+	(name != NULL && optind == argc)) {
+	fprintf(stderr,
+"Usage: %s [options] [metric ...]\n\
+\n\
+Options:\n\
+  -a archive  fetchgroup values for metrics from archive\n\
+  -D debugflag[,...]\n\
+  -s samples  number of fetches [default 3]\n\
+\n\
+Without -a, check __pmExtractColumn() against pmExtractValue()\n\
+",
+                pmGetProgname());
+        exit(1);
+    }
+
+    if (name == NULL)
+	selfcheck();
+    else
+	archive(name, samples, argc - optind, &argv[optind]);
+
+    exit(0);
+}
@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ */
+
+#include <pcp/pmapi.h>
+#include "libpcp.h"
+#include <assert.h>
+#include "localconfig.h"
+
+/*
+ * Encode a pmResult as PDU_COMPACT_RESULT, decode it again and check
+ * every value survives the trip; then check that every truncation of
+ * the PDU is rejected.
+ */
+
+static pmValueBlock *
+mkblock(int type, void *buf, int len)
+{
+    pmValueBlock	*vbp = (pmValueBlock *)malloc(PM_VAL_HDR_SIZE + len + sizeof(int));
+
+    assert(vbp != NULL);
+    vbp->vtype = type;
+    vbp->vlen = PM_VAL_HDR_SIZE + len;
+    memcpy(vbp->vbuf, buf, len);
+    return vbp;
+}
+
+static pmValueSet *
+mkvset(pmID pmid, int numval, int valfmt)
+{
+    pmValueSet	*vsp;
+    int		n = numval > 0 ? numval : 1;
+
+    vsp = (pmValueSet *)malloc(sizeof(pmValueSet) + (n - 1) * sizeof(pmValue));
+    assert(vsp != NULL);
+    vsp->pmid = pmid;
+    vsp->numval = numval;
+    vsp->valfmt = valfmt;
+    return vsp;
+}
+
+static __pmResult *
+build(void)
+{
+    __pmResult	*rp;
+    pmValueSet	*vsp;
+    __int64_t	ll;
+    __uint64_t	ull;
+    double	d;
+    float	f;
+    int		i;
+
+    rp = __pmAllocResult(7);
+    assert(rp != NULL);
+    rp->numpmid = 7;
+    rp->timestamp.sec = 1700000000;
+    rp->timestamp.nsec = 123456789;
+
+    /* 32-bit values for many instances, as for a per-cpu counter */
+    vsp = rp->vset[0] = mkvset(pmID_build(60, 0, 20), 64, PM_VAL_INSITU);
+    for (i = 0; i < 64; i++) {
+	vsp->vlist[i].inst = i;
+	vsp->vlist[i].value.lval = i * 1000 - 7;
+    }
+    vsp->vlist[63].value.lval = -1;		/* large U32 */
+
+    /* singular 64-bit values */
+    ll = -1234567890123LL;
+    vsp = rp->vset[1] = mkvset(pmID_build(60, 0, 21), 1, PM_VAL_DPTR);
+    vsp->vlist[0].inst = PM_IN_NULL;
+    vsp->vlist[0].value.pval = mkblock(PM_TYPE_64, &ll, sizeof(ll));
+    ull = 0xfedcba9876543210ULL;
+    vsp = rp->vset[2] = mkvset(pmID_build(60, 1, 3), 2, PM_VAL_DPTR);
+    vsp->vlist[0].inst = 2147483647;
+    vsp->vlist[0].value.pval = mkblock(PM_TYPE_U64, &ull, sizeof(ull));
+    ull = 5;
+    vsp->vlist[1].inst = 0;
+    vsp->vlist[1].value.pval = mkblock(PM_TYPE_U64, &ull, sizeof(ull));
+
+    /* floating point and string values */
+    d = 3.141592653589793;
+    f = 2.5;
+    vsp = rp->vset[3] = mkvset(pmID_build(29, 0, 1), 2, PM_VAL_DPTR);
+    vsp->vlist[0].inst = 10;
+    vsp->vlist[0].value.pval = mkblock(PM_TYPE_DOUBLE, &d, sizeof(d));
+    vsp->vlist[1].inst = 11;
+    vsp->vlist[1].value.pval = mkblock(PM_TYPE_FLOAT, &f, sizeof(f));
+    vsp = rp->vset[4] = mkvset(pmID_build(29, 0, 2), 1, PM_VAL_DPTR);
+    vsp->vlist[0].inst = PM_IN_NULL;
+    vsp->vlist[0].value.pval = mkblock(PM_TYPE_STRING, "hello world", 12);
+
+    /* no values, and an error code */
+    rp->vset[5] = mkvset(pmID_build(2, 3, 4), 0, PM_VAL_INSITU);
+    rp->vset[6] = mkvset(pmID_build(511, 4095, 1023), PM_ERR_AGAIN, PM_VAL_INSITU);
+
+    return rp;
+}
+
+static int
+compare(__pmResult *a, __pmResult *b)
+{
+    pmValueSet	*va, *vb;
+    int		i, j, bad = 0;
+
+    if (a->timestamp.sec != b->timestamp.sec ||
+	a->timestamp.nsec != b->timestamp.nsec) {
+	printf("timestamp differs\n");
+	bad++;
+    }
+    if (a->numpmid != b->numpmid) {
+	printf("numpmid %d != %d\n", a->numpmid, b->numpmid);
+	return 1;
+    }
+    for (i = 0; i < a->numpmid; i++) {
+	va = a->vset[i];
+	vb = b->vset[i];
+	if (va->pmid != vb->pmid || va->numval != vb->numval) {
+	    printf("vset[%d]: pmid or numval differs\n", i);
+	    bad++;
+	    continue;
+	}
+	if (va->numval <= 0)
+	    continue;
+	if (va->valfmt != vb->valfmt) {
+	    printf("vset[%d]: valfmt %d != %d\n", i, va->valfmt, vb->valfmt);
+	    bad++;
+	    continue;
+	}
+	for (j = 0; j < va->numval; j++) {
+	    if (va->vlist[j].inst != vb->vlist[j].inst) {
+		printf("vset[%d][%d]: inst %d != %d\n", i, j,
+			va->vlist[j].inst, vb->vlist[j].inst);
+		bad++;
+	    }
+	    if (va->valfmt == PM_VAL_INSITU) {
+		if (va->vlist[j].value.lval != vb->vlist[j].value.lval) {
+		    printf("vset[%d][%d]: lval differs\n", i, j);
+		    bad++;
+		}
+	    }
+	    else if (va->vlist[j].value.pval->vlen != vb->vlist[j].value.pval->vlen ||
+		     va->vlist[j].value.pval->vtype != vb->vlist[j].value.pval->vtype ||
+		     memcmp(va->vlist[j].value.pval->vbuf,
+			    vb->vlist[j].value.pval->vbuf,
+			    va->vlist[j].value.pval->vlen - PM_VAL_HDR_SIZE) != 0) {
+		printf("vset[%d][%d]: pmValueBlock differs\n", i, j);
+		bad++;
+	    }
+	}
+    }
+    return bad;
+}
+
+int
+main(int argc, char **argv)
+{
+    __pmResult	*rp, *dp;
+    __pmPDU	*pb, *hb, *tb;
+    int		len, hlen;
+    int		reject = 0;
+    int		sts;
+
+    pmSetProgname(argv[0]);
+    if (argc > 1 && (sts = pmSetDebug(argv[1])) < 0) {
+	fprintf(stderr, "%s: bad debug option (%s)\n", pmGetProgname(), argv[1]);
+	exit(1);
+    }
+
+    rp = build();
+    if ((sts = __pmEncodeHighResResult(rp, &hb)) < 0) {
+	fprintf(stderr, "__pmEncodeHighResResult: %s\n", pmErrStr(sts));
+	exit(1);
+    }
+    hlen = ((__pmPDUHdr *)hb)->len;
+    __pmUnpinPDUBuf(hb);
+    if ((sts = __pmEncodeCompactResult(rp, &pb)) < 0) {
+	fprintf(stderr, "__pmEncodeCompactResult: %s\n", pmErrStr(sts));
+	exit(1);
+    }
+    len = ((__pmPDUHdr *)pb)->len;
+    printf("highres len %d, compact len %d\n", hlen, len);
+
+    if ((sts = __pmDecodeCompactResult(pb, &dp)) < 0) {
+	printf("__pmDecodeCompactResult: %s\n", pmErrStr(sts));
+	exit(1);
+    }
+    printf("roundtrip: %s\n", compare(rp, dp) == 0 ? "ok" : "botch");
+    __pmFreeResult(dp);
+
+    /* every shorter PDU must be rejected */
+    tb = __pmFindPDUBuf(len + 1);
+    assert(tb != NULL);
+    for (hlen = sizeof(__pmPDUHdr); hlen < len; hlen++) {
+	memcpy(tb, pb, hlen);
+	((__pmPDUHdr *)tb)->len = hlen;
+	if ((sts = __pmDecodeCompactResult(tb, &dp)) == PM_ERR_IPC)
+	    reject++;
+	else if (sts >= 0)
+	    __pmFreeResult(dp);
+    }
+    printf("truncated: %d of %d rejected\n", reject, len - (int)sizeof(__pmPDUHdr));
+    __pmUnpinPDUBuf(tb);
+    __pmUnpinPDUBuf(pb);
+    __pmFreeResult(rp);
+
+    return 0;
+}
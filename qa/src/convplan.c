@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ */
+
+#include <pcp/pmapi.h>
+
+/*
+ * Check pmConvScalePlan and pmConvScaleApply against pmConvScale for
+ * all of the PM_TYPE_* types: conversions that are a single multiply
+ * (div == 1), conversions that round (div > 1), the error cases, and
+ * applying a plan in place (ival == oval).
+ */
+
+static pmUnits
+mkunits(int dimSpace, int dimTime, int dimCount, int scaleSpace, int scaleTime, int scaleCount)
+{
+    pmUnits	u;
+
+    memset(&u, 0, sizeof(u));
+    u.dimSpace = dimSpace;
+    u.dimTime = dimTime;
+    u.dimCount = dimCount;
+    u.scaleSpace = scaleSpace;
+    u.scaleTime = scaleTime;
+    u.scaleCount = scaleCount;
+    return u;
+}
+
+/* the numeric types come first, the others are never converted */
+#define NNUMERIC	6
+static int types[] = {
+    PM_TYPE_32, PM_TYPE_U32, PM_TYPE_64, PM_TYPE_U64,
+    PM_TYPE_FLOAT, PM_TYPE_DOUBLE,
+    PM_TYPE_STRING, PM_TYPE_AGGREGATE, PM_TYPE_AGGREGATE_STATIC,
+    PM_TYPE_EVENT, PM_TYPE_HIGHRES_EVENT, PM_TYPE_NOSUPPORT, PM_TYPE_UNKNOWN,
+};
+#define NTYPES	(int)(sizeof(types)/sizeof(types[0]))
+
+static double values[] = {
+    0, 1, 2, 499, 500, 501, 511, 512, 513, 999, 1000, 1023, 1024, 1536,
+    123456, 2147483647, -1, -500, -512, -513, -1536, -2147483647,
+};
+#define NVALUES	(int)(sizeof(values)/sizeof(values[0]))
+
+static int
+setvalue(int type, double v, pmAtomValue *ap)
+{
+    memset(ap, 0, sizeof(*ap));
+    switch (type) {
+	case PM_TYPE_32:
+	    ap->l = (__int32_t)v;
+	    break;
+	case PM_TYPE_U32:
+	    if (v < 0)
+		return 0;
+	    ap->ul = (__uint32_t)v;
+	    break;
+	case PM_TYPE_64:
+	    ap->ll = (__int64_t)v;
+	    break;
+	case PM_TYPE_U64:
+	    if (v < 0)
+		return 0;
+	    ap->ull = (__uint64_t)v;
+	    break;
+	case PM_TYPE_FLOAT:
+	    ap->f = (float)v / 3;
+	    break;
+	case PM_TYPE_DOUBLE:
+	    ap->d = v / 3;
+	    break;
+	default:
+	    ap->ll = (__int64_t)v;
+	    break;
+    }
+    return 1;
+}
+
+static int
+same(int type, const pmAtomValue *a, const pmAtomValue *b)
+{
+    switch (type) {
+	case PM_TYPE_32:
+	    return a->l == b->l;
+	case PM_TYPE_U32:
+	    return a->ul == b->ul;
+	case PM_TYPE_64:
+	    return a->ll == b->ll;
+	case PM_TYPE_U64:
+	    return a->ull == b->ull;
+	case PM_TYPE_FLOAT:
+	    return memcmp(&a->f, &b->f, sizeof(a->f)) == 0;
+	case PM_TYPE_DOUBLE:
+	    return memcmp(&a->d, &b->d, sizeof(a->d)) == 0;
+    }
+    return 0;
+}
+
+static int	nerrors;
+
+static void
+check(const pmUnits *iu, const pmUnits *ou)
+{
+    pmAtomValue	ival[NVALUES], oval[NVALUES], inplace[NVALUES], expect;
+    pmConvPlan	plan;
+    char	ibuf[64], obuf[64], vbuf[64];
+    int		type, sts, psts, n, i, t;
+    int		nother = 0;
+
+    printf("\n[%s] -> [%s]\n", pmUnitsStr_r(iu, ibuf, sizeof(ibuf)),
+		pmUnitsStr_r(ou, obuf, sizeof(obuf)));
+    for (t = 0; t < NTYPES; t++) {
+	type = types[t];
+	for (i = n = 0; i < NVALUES; i++)
+	    n += setvalue(type, values[i], &ival[n]);
+
+	psts = pmConvScalePlan(type, iu, ou, &plan);
+	sts = pmConvScale(type, &ival[0], iu, &expect, ou);
+	if (psts != sts) {
+	    printf("  %s: pmConvScalePlan: %s, but pmConvScale: %s\n",
+			pmTypeStr(type), pmErrStr(psts), pmErrStr(sts));
+	    nerrors++;
+	    continue;
+	}
+	if (psts < 0) {
+	    if (t < NNUMERIC || psts != PM_ERR_CONV)
+		printf("  %s: %s\n", pmTypeStr(type), pmErrStr(psts));
+	    else
+		nother++;
+	    continue;
+	}
+	if (t >= NNUMERIC) {
+	    printf("  %s: converted, but not a numeric type\n", pmTypeStr(type));
+	    nerrors++;
+	    continue;
+	}
+	if (t == 0)
+	    printf("  mult %lld div %lld\n", (long long)plan.mult, (long long)plan.div);
+
+	memset(oval, 0, sizeof(oval));
+	if ((sts = pmConvScaleApply(&plan, ival, oval, n)) != n) {
+	    printf("  %s: pmConvScaleApply returns %d, expected %d\n",
+			pmTypeStr(type), sts, n);
+	    nerrors++;
+	    continue;
+	}
+	memcpy(inplace, ival, sizeof(ival));
+	if ((sts = pmConvScaleApply(&plan, inplace, inplace, n)) != n) {
+	    printf("  %s: in place pmConvScaleApply returns %d, expected %d\n",
+			pmTypeStr(type), sts, n);
+	    nerrors++;
+	    continue;
+	}
+
+	printf("  %s:", pmTypeStr(type));
+	for (i = 0; i < n; i++) {
+	    if ((sts = pmConvScale(type, &ival[i], iu, &expect, ou)) < 0) {
+		printf("\n    [%d] pmConvScale: %s\n", i, pmErrStr(sts));
+		nerrors++;
+		continue;
+	    }
+	    printf(" %s", pmAtomStr_r(&expect, type, vbuf, sizeof(vbuf)));
+	    if (!same(type, &oval[i], &expect)) {
+		printf("\n    [%d] pmConvScaleApply: %s", i,
+			pmAtomStr_r(&oval[i], type, vbuf, sizeof(vbuf)));
+		nerrors++;
+	    }
+	    if (!same(type, &inplace[i], &expect)) {
+		printf("\n    [%d] in place pmConvScaleApply: %s", i,
+			pmAtomStr_r(&inplace[i], type, vbuf, sizeof(vbuf)));
+		nerrors++;
+	    }
+	}
+	putchar('\n');
+    }
+    if (nother == NTYPES - NNUMERIC)
+	printf("  other types: %s\n", pmErrStr(PM_ERR_CONV));
+}
+
+int
+main(int argc, char **argv)
+{
+    pmUnits	iu, ou;
+    pmConvPlan	plan;
+    pmAtomValue	av;
+    int		sts;
+
+    pmSetProgname(argv[0]);
+    if (argc > 1 && (sts = pmSetDebug(argv[1])) < 0) {
+	fprintf(stderr, "%s: bad debug option (%s)\n", pmGetProgname(), argv[1]);
+	exit(1);
+    }
+
+    printf("=== div == 1 ===\n");
+    iu = mkunits(0, 0, 0, 0, 0, 0);
+    check(&iu, &iu);
+    iu = mkunits(1, 0, 0, PM_SPACE_KBYTE, 0, 0);
+    ou = mkunits(1, 0, 0, PM_SPACE_BYTE, 0, 0);
+    check(&iu, &ou);
+    iu = mkunits(0, 1, 0, 0, PM_TIME_SEC, 0);
+    ou = mkunits(0, 1, 0, 0, PM_TIME_MSEC, 0);
+    check(&iu, &ou);
+    iu = mkunits(0, 0, 1, 0, 0, 3);
+    ou = mkunits(0, 0, 1, 0, 0, 0);
+    check(&iu, &ou);
+    iu = mkunits(0, 0, 0, 0, 0, 2);
+    ou = mkunits(0, 0, 0, 0, 0, 0);
+    check(&iu, &ou);
+
+    printf("\n=== div > 1, rounding ===\n");
+    iu = mkunits(1, 0, 0, PM_SPACE_BYTE, 0, 0);
+    ou = mkunits(1, 0, 0, PM_SPACE_KBYTE, 0, 0);
+    check(&iu, &ou);
+    iu = mkunits(0, 1, 0, 0, PM_TIME_MSEC, 0);
+    ou = mkunits(0, 1, 0, 0, PM_TIME_SEC, 0);
+    check(&iu, &ou);
+    iu = mkunits(0, -1, 1, 0, PM_TIME_SEC, 0);
+    ou = mkunits(0, -1, 1, 0, PM_TIME_MSEC, 0);
+    check(&iu, &ou);
+    iu = mkunits(1, -1, 0, PM_SPACE_MBYTE, PM_TIME_SEC, 0);
+    ou = mkunits(1, -1, 0, PM_SPACE_KBYTE, PM_TIME_MSEC, 0);
+    check(&iu, &ou);
+    iu = mkunits(0, 0, 1, 0, 0, 0);
+    ou = mkunits(0, 0, 1, 0, 0, 2);
+    check(&iu, &ou);
+
+    printf("\n=== errors ===\n");
+    iu = mkunits(1, 0, 0, PM_SPACE_BYTE, 0, 0);
+    ou = mkunits(0, 1, 0, 0, PM_TIME_SEC, 0);
+    check(&iu, &ou);
+    iu = mkunits(1, 0, 0, 15, 0, 0);
+    ou = mkunits(1, 0, 0, PM_SPACE_BYTE, 0, 0);
+    check(&iu, &ou);
+    iu = mkunits(0, 1, 0, 0, PM_TIME_SEC, 0);
+    ou = mkunits(0, 1, 0, 0, 15, 0);
+    check(&iu, &ou);
+    iu = mkunits(0, 0, 0, 0, 0, 0);
+    if ((sts = pmConvScalePlan(PM_TYPE_32, &iu, &iu, &plan)) < 0) {
+	printf("pmConvScalePlan: %s\n", pmErrStr(sts));
+	nerrors++;
+    }
+    plan.type = PM_TYPE_STRING;
+    av.ll = 0;
+    printf("apply plan for %s: %s\n", pmTypeStr(plan.type),
+		pmErrStr(pmConvScaleApply(&plan, &av, &av, 1)));
+
+    printf("\n%d errors\n", nerrors);
+    return nerrors != 0;
+}
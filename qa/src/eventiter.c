@@ -0,0 +1,171 @@
+/*
+ * Exercise pmEventIter*() against pmUnpack[HighRes]EventRecords(),
+ * and pmdaEvent array reuse after release.
+ *
+ * Copyright (c) 2026 Red Hat.
+ */
+#include <pcp/pmapi.h>
+#include <pcp/pmda.h>
+
+static pmID	pmid_type;
+static pmID	pmid_64;
+static pmID	pmid_double;
+static pmID	pmid_string;
+
+static void
+value(pmValueSet *vsp)
+{
+    pmDesc	desc = { .indom = PM_INDOM_NULL, .sem = PM_SEM_INSTANT };
+
+    if (vsp->valfmt == PM_VAL_INSITU)
+	desc.type = PM_TYPE_U32;
+    else
+	desc.type = vsp->vlist[0].value.pval->vtype;
+    desc.pmid = vsp->pmid;
+    printf("    %s = ", pmIDStr(vsp->pmid));
+    pmPrintValue(stdout, vsp->valfmt, desc.type, &vsp->vlist[0], 1);
+    putchar('\n');
+}
+
+static void
+walk(pmValueSet *vsp, int highres)
+{
+    pmEventIter	iter;
+    pmValueSet	*vset;
+    int		sts, r = 0, p;
+
+    if ((sts = pmEventIterStart(&iter, vsp, 0)) < 0) {
+	printf("pmEventIterStart: %s\n", pmErrStr(sts));
+	return;
+    }
+    printf("iterator: %d records\n", sts);
+    while (pmEventIterNext(&iter) > 0) {
+	printf("  record[%d] flags 0x%x at %lld.%0*lld\n", r++, iter.flags,
+		(long long)iter.timestamp.tv_sec, highres ? 9 : 6,
+		highres ? (long long)iter.timestamp.tv_nsec :
+			  (long long)iter.timestamp.tv_nsec / 1000);
+	/* stop early on the second record, the next one must not care */
+	for (p = 0; (sts = pmEventIterParam(&iter, &vset)) > 0; p++) {
+	    value(vset);
+	    if (r == 2 && p == 0)
+		break;
+	}
+	if (sts < 0)
+	    printf("    pmEventIterParam: %s\n", pmErrStr(sts));
+    }
+}
+
+static void
+unpack(pmValueSet *vsp, int highres)
+{
+    pmHighResResult	**hrap;
+    pmResult		**rap;
+    int			nrecords, r, p;
+
+    if (highres) {
+	if ((nrecords = pmUnpackHighResEventRecords(vsp, 0, &hrap)) < 0) {
+	    printf("pmUnpackHighResEventRecords: %s\n", pmErrStr(nrecords));
+	    return;
+	}
+	printf("unpack: %d records\n", nrecords);
+	for (r = 0; r < nrecords; r++) {
+	    printf("  record[%d] at %lld.%09lld\n", r,
+		(long long)hrap[r]->timestamp.tv_sec,
+		(long long)hrap[r]->timestamp.tv_nsec);
+	    for (p = 0; p < hrap[r]->numpmid; p++)
+		value(hrap[r]->vset[p]);
+	}
+	pmFreeHighResEventResult(hrap);
+    }
+    else {
+	if ((nrecords = pmUnpackEventRecords(vsp, 0, &rap)) < 0) {
+	    printf("pmUnpackEventRecords: %s\n", pmErrStr(nrecords));
+	    return;
+	}
+	printf("unpack: %d records\n", nrecords);
+	for (r = 0; r < nrecords; r++) {
+	    printf("  record[%d] at %lld.%06lld\n", r,
+		(long long)rap[r]->timestamp.tv_sec,
+		(long long)rap[r]->timestamp.tv_usec);
+	    for (p = 0; p < rap[r]->numpmid; p++)
+		value(rap[r]->vset[p]);
+	}
+	pmFreeEventResult(rap);
+    }
+}
+
+static int
+fill(int highres)
+{
+    struct timespec	ts = { 1700000000, 123456789 };
+    struct timeval	tv = { 1700000000, 123456 };
+    pmAtomValue		atom;
+    int			(*param)(int, pmID, int, pmAtomValue *);
+    int			idx, i;
+
+    idx = highres ? pmdaEventNewHighResArray() : pmdaEventNewArray();
+    param = highres ? pmdaEventAddHighResParam : pmdaEventAddParam;
+    for (i = 0; i < 3; i++) {
+	if (highres)
+	    pmdaEventAddHighResRecord(idx, &ts, i ? PM_EVENT_FLAG_POINT : 0);
+	else
+	    pmdaEventAddRecord(idx, &tv, i ? PM_EVENT_FLAG_POINT : 0);
+	atom.ul = i;
+	param(idx, pmid_type, PM_TYPE_U32, &atom);
+	atom.ll = -1000000000000LL * (i + 1);
+	param(idx, pmid_64, PM_TYPE_64, &atom);
+	atom.d = 0.5 * i;
+	param(idx, pmid_double, PM_TYPE_DOUBLE, &atom);
+	atom.cp = i == 1 ? "one" : "not one";
+	param(idx, pmid_string, PM_TYPE_STRING, &atom);
+	ts.tv_sec++;
+	tv.tv_sec++;
+    }
+    if (highres)
+	pmdaEventAddHighResMissedRecord(idx, &ts, 42);
+    else
+	pmdaEventAddMissedRecord(idx, &tv, 42);
+    return idx;
+}
+
+int
+main(int argc, char **argv)
+{
+    pmValueSet		vs;
+    void		*first;
+    int			highres, idx;
+
+    pmSetProgname(argv[0]);
+    pmid_type = pmID_build(29, 0, 127);
+    pmid_64 = pmID_build(29, 0, 130);
+    pmid_double = pmID_build(29, 0, 133);
+    pmid_string = pmID_build(29, 0, 134);
+
+    for (highres = 0; highres < 2; highres++) {
+	printf("=== %s ===\n", highres ? "PM_TYPE_HIGHRES_EVENT" : "PM_TYPE_EVENT");
+	idx = fill(highres);
+	vs.pmid = pmID_build(29, 0, 136);
+	vs.numval = 1;
+	vs.valfmt = PM_VAL_DPTR;
+	vs.vlist[0].inst = PM_IN_NULL;
+	if (highres)
+	    vs.vlist[0].value.pval = (pmValueBlock *)pmdaEventGetHighResAddr(idx);
+	else
+	    vs.vlist[0].value.pval = (pmValueBlock *)pmdaEventGetAddr(idx);
+	unpack(&vs, highres);
+	walk(&vs, highres);
+
+	/* a released array's buffer is reused by the next new array */
+	first = vs.vlist[0].value.pval;
+	pmdaEventReleaseArray(idx);
+	idx = fill(highres);
+	printf("buffer %s after release\n",
+		(void *)pmdaEventGetAddr(idx) == first ? "reused" : "not reused");
+	pmdaEventReleaseArray(idx);
+    }
+
+    vs.numval = 1;
+    vs.valfmt = PM_VAL_INSITU;
+    walk(&vs, 0);
+    return 0;
+}
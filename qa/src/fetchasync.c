@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * Exercise pmFetchAsync, pmGetAsyncFd, pmAsyncService and pmAsyncCancel
+ * over several host contexts from a single poll(2) loop.
+ */
+
+#include <poll.h>
+#include <pcp/pmapi.h>
+#include "libpcp.h"
+
+#define MAXCTX	16
+#define NREQ	3		/* requests queued per context per sample */
+
+static char	*hosts[MAXCTX];
+static int	nhosts;
+
+static struct {
+    int		request;
+    int		sts;
+    int		numval;
+    int		done;
+} reqs[MAXCTX][NREQ];
+
+static int	outstanding;
+
+static void
+fetched(int ctx, int request, int sts, pmHighResResult *result, void *arg)
+{
+    int		c = (int)(long)arg;
+    int		r;
+
+    for (r = 0; r < NREQ; r++) {
+	if (reqs[c][r].request == request)
+	    break;
+    }
+    if (r == NREQ) {
+	printf("context %d: unexpected request %d\n", c, request);
+	return;
+    }
+    reqs[c][r].sts = sts;
+    reqs[c][r].done++;
+    if (result != NULL) {
+	reqs[c][r].numval = result->vset[0]->numval;
+	pmFreeHighResResult(result);
+    }
+    outstanding--;
+}
+
+int
+main(int argc, char **argv)
+{
+    int			c, r, n;
+    int			sts;
+    int			errflag = 0;
+    int			samples = 2;
+    int			ctxids[MAXCTX];
+    struct pollfd	pfd[MAXCTX];
+    pmID		pmid;
+    pmResult		*rp;
+    char		*endnum;
+    char		*name;
+    char		*archive = NULL;
+
+    pmSetProgname(argv[0]);
+
+    while ((c = getopt(argc, argv, "a:D:h:s:?")) != EOF) {
+	switch (c) {
+
+	case 'a':	/* archive, for the error cases */
+	    archive = optarg;
+	    break;
+
+	case 'h':	/* host */
+	    if (nhosts == MAXCTX) {
+		fprintf(stderr, "%s: at most %d contexts\n", pmGetProgname(), MAXCTX);
+		exit(1);
+	    }
+	    hosts[nhosts++] = optarg;
+	    break;
+
+	case 'D':	/* debug options */
+	    sts = pmSetDebug(optarg);
+	    if (sts < 0) {
+		fprintf(stderr, "%s: unrecognized debug options specification (%s)\n",
+		    pmGetProgname(), optarg);
+		errflag++;
+	    }
+	    break;
+
+	case 's':	/* sample count */
+	    samples = (int)strtol(optarg, &endnum, 10);
+	    if (*endnum != '\0' || samples < 1) {
+		fprintf(stderr, "%s: -s requires a positive integer\n", pmGetProgname());
+		errflag++;
+	    }
+	    break;
+
+	case '?':
+	default:
+	    errflag++;
+	    break;
+	}
+    }
+
+    if (nhosts == 0 || optind != argc - 1)
+	errflag++;
+
+    if (errflag) {
+	fprintf(stderr,
+"Usage: %s [options] metric\n\
+\n\
+Options\n\
+  -a archive  also check an archive context is refused\n\
+  -D debug    debug flags\n\
+  -h host     add a host context (may be repeated)\n\
+  -s samples  number of fetches [default 2]\n",
+		pmGetProgname());
+	exit(1);
+    }
+
+    for (c = 0; c < nhosts; c++) {
+	if ((sts = pmNewContext(PM_CONTEXT_HOST, hosts[c])) < 0) {
+	    fprintf(stderr, "%s: Cannot connect to PMCD on host \"%s\": %s\n",
+		    pmGetProgname(), hosts[c], pmErrStr(sts));
+	    exit(1);
+	}
+	ctxids[c] = sts;
+	pfd[c].fd = pmGetAsyncFd(sts);
+	pfd[c].events = POLLIN;
+    }
+    name = argv[optind];
+    if ((sts = pmLookupName(1, (const char **)&name, &pmid)) < 0) {
+	fprintf(stderr, "%s: pmLookupName: %s\n", pmGetProgname(), pmErrStr(sts));
+	exit(1);
+    }
+
+    for (n = 0; n < samples; n++) {
+	memset(reqs, 0, sizeof(reqs));
+	for (c = 0; c < nhosts; c++) {
+	    for (r = 0; r < NREQ; r++) {
+		sts = pmFetchAsync(ctxids[c], 1, &pmid, fetched, (void *)(long)c);
+		if (sts < 0) {
+		    printf("context %d: pmFetchAsync: %s\n", c, pmErrStr(sts));
+		    continue;
+		}
+		reqs[c][r].request = sts;
+		outstanding++;
+	    }
+	    /* drop the last one queued, it must not call back */
+	    if ((sts = pmAsyncCancel(ctxids[c], reqs[c][NREQ-1].request)) < 0)
+		printf("context %d: pmAsyncCancel: %s\n", c, pmErrStr(sts));
+	    else
+		outstanding--;
+	}
+
+	/* synchronous fetches wait until the asynchronous ones are done */
+	sts = pmUseContext(ctxids[0]);
+	if (sts >= 0)
+	    sts = pmFetch(1, &pmid, &rp);
+	printf("sample %d: pmFetch with requests queued: %s\n", n,
+		sts < 0 ? pmErrStr(sts) : "success");
+	if (sts >= 0)
+	    pmFreeResult(rp);
+
+	while (outstanding > 0) {
+	    if ((sts = poll(pfd, nhosts, 10000)) <= 0) {
+		printf("poll: %s\n", sts < 0 ? strerror(errno) : "timeout");
+		exit(1);
+	    }
+	    for (c = 0; c < nhosts; c++) {
+		if (pfd[c].revents == 0)
+		    continue;
+		if ((sts = pmAsyncService(ctxids[c])) < 0)
+		    printf("context %d: pmAsyncService: %s\n", c, pmErrStr(sts));
+	    }
+	}
+
+	for (c = 0; c < nhosts; c++) {
+	    for (r = 0; r < NREQ; r++) {
+		printf("  [%d] request %d: ", c, r);
+		if (reqs[c][r].done == 0)
+		    printf("no callback\n");
+		else if (reqs[c][r].sts < 0)
+		    printf("%s\n", pmErrStr(reqs[c][r].sts));
+		else
+		    printf("callbacks %d numval %d\n",
+			    reqs[c][r].done, reqs[c][r].numval);
+	    }
+	}
+	sts = pmFetch(1, &pmid, &rp);
+	printf("sample %d: pmFetch after: %s\n", n,
+		sts < 0 ? pmErrStr(sts) : "success");
+	if (sts >= 0)
+	    pmFreeResult(rp);
+    }
+
+    /* only host contexts can be asynchronous */
+    if (archive != NULL) {
+	if ((sts = pmNewContext(PM_CONTEXT_ARCHIVE, archive)) < 0) {
+	    fprintf(stderr, "%s: Cannot open archive \"%s\": %s\n",
+		    pmGetProgname(), archive, pmErrStr(sts));
+	    exit(1);
+	}
+	printf("archive: pmFetchAsync: %s\n",
+		pmErrStr(pmFetchAsync(sts, 1, &pmid, fetched, NULL)));
+	printf("archive: pmGetAsyncFd: %s\n", pmErrStr(pmGetAsyncFd(sts)));
+    }
+    printf("bad context: pmAsyncService: %s\n",
+		pmErrStr(pmAsyncService(ctxids[nhosts - 1] + 100)));
+
+    exit(0);
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * Exercise pmFetchMany and pmFetchHighResMany across several contexts,
+ * including an unknown handle and a repeated handle.
+ */
+
+#include <pcp/pmapi.h>
+#include "libpcp.h"
+
+#define MAXCTX	16
+
+static char	*sources[MAXCTX];
+static int	types[MAXCTX];
+static int	nsources;
+
+int
+main(int argc, char **argv)
+{
+    int			c;
+    int			sts;
+    int			errflag = 0;
+    int			samples = 2;
+    int			ctxids[MAXCTX + 2];
+    int			status[MAXCTX + 2];
+    pmResult		*results[MAXCTX + 2];
+    pmHighResResult	*hresults[MAXCTX + 2];
+    pmID		pmids[MAXCTX];
+    char		*endnum;
+    int			nctx;
+    int			numpmid;
+    int			i, j, n;
+
+    pmSetProgname(argv[0]);
+
+    while ((c = getopt(argc, argv, "a:D:h:s:?")) != EOF) {
+	switch (c) {
+
+	case 'a':	/* archive */
+	case 'h':	/* host */
+	    if (nsources == MAXCTX) {
+		fprintf(stderr, "%s: at most %d contexts\n", pmGetProgname(), MAXCTX);
+		exit(1);
+	    }
+	    types[nsources] = (c == 'a') ? PM_CONTEXT_ARCHIVE : PM_CONTEXT_HOST;
+	    sources[nsources++] = optarg;
+	    break;
+
+	case 'D':	/* debug options */
+	    sts = pmSetDebug(optarg);
+	    if (sts < 0) {
+		fprintf(stderr, "%s: unrecognized debug options specification (%s)\n",
+		    pmGetProgname(), optarg);
+		errflag++;
+	    }
+	    break;
+
+	case 's':	/* sample count */
+	    samples = (int)strtol(optarg, &endnum, 10);
+	    if (*endnum != '\0' || samples < 1) {
+		fprintf(stderr, "%s: -s requires a positive integer\n", pmGetProgname());
+		errflag++;
+	    }
+	    break;
+
+	case '?':
+	default:
+	    errflag++;
+	    break;
+	}
+    }
+
+    numpmid = argc - optind;
+    if (nsources == 0 || numpmid < 1 || numpmid > MAXCTX)
+	errflag++;
+
+    if (errflag) {
+	fprintf(stderr,
+"Usage: %s [options] metric ...\n\
+\n\
+Options\n\
+  -a archive  add an archive context (may be repeated)\n\
+  -D debug    debug flags\n\
+  -h host     add a host context (may be repeated)\n\
+  -s samples  number of fetches [default 2]\n",
+		pmGetProgname());
+	exit(1);
+    }
+
+    for (nctx = 0; nctx < nsources; nctx++) {
+	if ((sts = pmNewContext(types[nctx], sources[nctx])) < 0) {
+	    fprintf(stderr, "%s: Cannot open \"%s\": %s\n",
+		    pmGetProgname(), sources[nctx], pmErrStr(sts));
+	    exit(1);
+	}
+	ctxids[nctx] = sts;
+    }
+    /* the metric names are resolved in the last context */
+    if ((sts = pmLookupName(numpmid, (const char **)&argv[optind], pmids)) < 0) {
+	fprintf(stderr, "%s: pmLookupName: %s\n", pmGetProgname(), pmErrStr(sts));
+	exit(1);
+    }
+    /* an unknown context, and a repeat of the first one */
+    ctxids[nctx++] = ctxids[nsources - 1] + 100;
+    ctxids[nctx++] = ctxids[0];
+
+    for (n = 0; n < samples; n++) {
+	if ((n % 2) == 0)
+	    sts = pmFetchMany(nctx, ctxids, numpmid, pmids, results, status);
+	else
+	    sts = pmFetchHighResMany(nctx, ctxids, numpmid, pmids, hresults, status);
+	printf("sample %d: %s returns %d\n", n,
+		(n % 2) == 0 ? "pmFetchMany" : "pmFetchHighResMany", sts);
+	for (i = 0; i < nctx; i++) {
+	    printf("  [%d] ", i);
+	    if (status[i] < 0) {
+		printf("%s\n", pmErrStr(status[i]));
+		continue;
+	    }
+	    if ((n % 2) == 0)
+		printf("%ld.%06ld", (long)results[i]->timestamp.tv_sec,
+			(long)results[i]->timestamp.tv_usec);
+	    else
+		printf("%ld.%09ld", (long)hresults[i]->timestamp.tv_sec,
+			(long)hresults[i]->timestamp.tv_nsec);
+	    printf(" numval");
+	    for (j = 0; j < numpmid; j++) {
+		if ((n % 2) == 0)
+		    printf(" %d", results[i]->vset[j]->numval);
+		else
+		    printf(" %d", hresults[i]->vset[j]->numval);
+	    }
+	    putchar('\n');
+	    if ((n % 2) == 0)
+		pmFreeResult(results[i]);
+	    else
+		pmFreeHighResResult(hresults[i]);
+	}
+    }
+
+    exit(0);
+}
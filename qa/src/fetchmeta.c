@@ -0,0 +1,322 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * Fetch some metrics from pmcd, then look up their descriptors and
+ * instance domains ... with $PCP_FETCH_METADATA set these arrive with
+ * the first fetch result and no further lookup PDUs are needed, which
+ * is checked both in libpcp and in the pmcd PDU counters.  Optionally
+ * run a command (that restarts agents) and repeat the whole sequence
+ * once pmcd reports the agent change.
+ */
+
+#include <pcp/pmapi.h>
+#include "libpcp.h"
+
+static const char *metrics[] = {
+    "sample.long.one", "sample.ulong.million", "sample.float.ten",
+    "sample.string.hullo", "sample.bin", "sample.hordes.one",
+};
+#define NMETRICS	(int)(sizeof(metrics)/sizeof(metrics[0]))
+static pmID	pmids[NMETRICS];
+
+static const char *counters[] = {
+    "pmcd.pdu_in.desc_req", "pmcd.pdu_in.desc_ids", "pmcd.pdu_in.instance_req",
+};
+#define NCOUNTERS	(int)(sizeof(counters)/sizeof(counters[0]))
+static pmID	cpmids[NCOUNTERS];
+
+static int	verbose;
+static int	changes;		/* PMCD state changes seen */
+static unsigned int	before;		/* lookups() before the last fetch */
+static __uint64_t	pmcdbefore;	/* pmcdlookups() before the last fetch */
+
+static unsigned int
+lookups(void)
+{
+    return __pmPDUCntOut[PDU_DESC_REQ - PDU_START] +
+	   __pmPDUCntOut[PDU_DESC_IDS - PDU_START] +
+	   __pmPDUCntOut[PDU_INSTANCE_REQ - PDU_START];
+}
+
+/* lookup requests received by pmcd, from all clients */
+static __uint64_t
+pmcdlookups(void)
+{
+    pmResult	*rp;
+    pmAtomValue	atom;
+    __uint64_t	sum = 0;
+    int		i, sts;
+
+    if ((sts = pmFetch(NCOUNTERS, cpmids, &rp)) < 0) {
+	fprintf(stderr, "pmFetch(counters): %s\n", pmErrStr(sts));
+	exit(1);
+    }
+    changes |= sts;
+    for (i = 0; i < rp->numpmid; i++) {
+	if (rp->vset[i]->numval != 1) {
+	    fprintf(stderr, "%s: no value\n", counters[i]);
+	    exit(1);
+	}
+	pmExtractValue(rp->vset[i]->valfmt, &rp->vset[i]->vlist[0],
+			PM_TYPE_U32, &atom, PM_TYPE_U64);
+	sum += atom.ull;
+    }
+    pmFreeResult(rp);
+    return sum;
+}
+
+/*
+ * Fetch the metrics, noting the lookups so far first (any fetch, even
+ * of the counters, drops the instances sent with the previous one)
+ */
+static pmResult *
+fetch(void)
+{
+    pmResult	*rp;
+    int		sts;
+
+    before = lookups();
+    pmcdbefore = pmcdlookups();
+    if ((sts = pmFetch(NMETRICS, pmids, &rp)) < 0) {
+	fprintf(stderr, "pmFetch: %s\n", pmErrStr(sts));
+	exit(1);
+    }
+    changes |= sts;
+    return rp;
+}
+
+static void
+report(const char *name, pmValueSet *vsp, pmDesc *dp, int numinst,
+	int *instlist, char **namelist)
+{
+    pmAtomValue	atom;
+    char	strbuf[60];
+    int		i, j;
+
+    printf("%s %s", name, pmIDStr_r(dp->pmid, strbuf, sizeof(strbuf)));
+    printf(" %s", pmTypeStr_r(dp->type, strbuf, sizeof(strbuf)));
+    printf(" %s", pmInDomStr_r(dp->indom, strbuf, sizeof(strbuf)));
+    printf(" %d", dp->sem);
+    printf(" %s\n", pmUnitsStr_r(&dp->units, strbuf, sizeof(strbuf)));
+    if (dp->indom != PM_INDOM_NULL) {
+	printf("    %d instances:", numinst);
+	for (i = 0; i < numinst; i++) {
+	    if (i == 3 && numinst > 6) {
+		printf(" ...");
+		i = numinst - 3;
+	    }
+	    printf(" %d \"%s\"", instlist[i], namelist[i]);
+	}
+	putchar('\n');
+    }
+    if (vsp->numval < 0) {
+	printf("    %s\n", pmErrStr(vsp->numval));
+	return;
+    }
+    printf("    %d values:", vsp->numval);
+    for (i = 0; i < vsp->numval; i++) {
+	if (i == 3 && vsp->numval > 6) {
+	    printf(" ...");
+	    i = vsp->numval - 3;
+	}
+	pmExtractValue(vsp->valfmt, &vsp->vlist[i], dp->type, &atom, dp->type);
+	printf(" [%d] ", vsp->vlist[i].inst);
+	if (dp->type == PM_TYPE_STRING) {
+	    printf("\"%s\"", atom.cp);
+	    free(atom.cp);
+	    continue;
+	}
+	for (j = 0; j < numinst; j++) {
+	    /* value and instance lists should agree */
+	    if (instlist[j] == vsp->vlist[i].inst)
+		break;
+	}
+	if (dp->indom != PM_INDOM_NULL && j == numinst)
+	    printf("no instance ");
+	pmPrintValue(stdout, vsp->valfmt, dp->type, &vsp->vlist[i], 1);
+    }
+    putchar('\n');
+}
+
+static void
+describe(const char *label, pmResult *rp)
+{
+    pmDesc		descs[NMETRICS];
+    int			*instlist[NMETRICS];
+    char		**namelist[NMETRICS];
+    int			numinst[NMETRICS];
+    int			i, sts;
+
+    for (i = 0; i < NMETRICS; i++) {
+	if ((sts = pmLookupDesc(pmids[i], &descs[i])) < 0) {
+	    fprintf(stderr, "pmLookupDesc(%s): %s\n", metrics[i], pmErrStr(sts));
+	    exit(1);
+	}
+	numinst[i] = 0;
+	instlist[i] = NULL;
+	namelist[i] = NULL;
+	if (descs[i].indom == PM_INDOM_NULL)
+	    continue;
+	if ((sts = pmGetInDom(descs[i].indom, &instlist[i], &namelist[i])) < 0) {
+	    fprintf(stderr, "pmGetInDom(%s): %s\n", metrics[i], pmErrStr(sts));
+	    exit(1);
+	}
+	numinst[i] = sts;
+    }
+    printf("%s: lookups: %s\n", label,
+	lookups() - before ? "lookup PDUs sent" : "no lookup PDUs");
+    printf("%s: pmcd: %s\n", label,
+	pmcdlookups() - pmcdbefore ? "lookup PDUs received" : "no lookup PDUs");
+
+    for (i = 0; i < NMETRICS; i++) {
+	if (verbose)
+	    report(metrics[i], rp->vset[i], &descs[i], numinst[i],
+		    instlist[i], namelist[i]);
+	if (instlist[i] != NULL) {
+	    free(instlist[i]);
+	    free(namelist[i]);
+	}
+    }
+}
+
+/*
+ * Names are cached too, until pmcd reports a change of names or agents
+ * and the lookup cache is flushed
+ */
+static void
+names(const char *label)
+{
+    unsigned int	count = __pmPDUCntOut[PDU_PMNS_NAMES - PDU_START];
+    int			sts;
+
+    if ((sts = pmLookupName(NMETRICS, metrics, pmids)) < 0) {
+	fprintf(stderr, "pmLookupName: %s\n", pmErrStr(sts));
+	exit(1);
+    }
+    printf("%s: names: %s\n", label,
+	__pmPDUCntOut[PDU_PMNS_NAMES - PDU_START] - count ?
+	"lookup cache flushed" : "cached");
+}
+
+/* all the sample metrics have values, i.e. the agent is running */
+static int
+running(pmResult *rp)
+{
+    int		i;
+
+    for (i = 0; i < rp->numpmid; i++) {
+	if (rp->vset[i]->numval <= 0)
+	    return 0;
+    }
+    return 1;
+}
+
+int
+main(int argc, char **argv)
+{
+    int		c;
+    int		sts;
+    int		ctx;
+    int		errflag = 0;
+    int		tries;
+    char	*host = "local:";
+    char	*command = NULL;
+    pmResult	*rp;
+    struct timeval	delay = { 0, 100000 };
+
+    pmSetProgname(argv[0]);
+
+    while ((c = getopt(argc, argv, "c:D:h:v?")) != EOF) {
+	switch (c) {
+
+	case 'c':	/* command to run between rounds */
+	    command = optarg;
+	    break;
+
+	case 'D':	/* debug options */
+	    sts = pmSetDebug(optarg);
+	    if (sts < 0) {
+		fprintf(stderr, "%s: unrecognized debug options specification (%s)\n",
+		    pmGetProgname(), optarg);
+		errflag++;
+	    }
+	    break;
+
+	case 'h':	/* host */
+	    host = optarg;
+	    break;
+
+	case 'v':	/* report each metric */
+	    verbose++;
+	    break;
+
+	case '?':
+	default:
+	    errflag++;
+	    break;
+	}
+    }
+
+    if (errflag || optind != argc) {
+	fprintf(stderr, "Usage: %s [-c command] [-D debug] [-h host] [-v]\n",
+		pmGetProgname());
+	exit(1);
+    }
+
+    if ((ctx = pmNewContext(PM_CONTEXT_HOST, host)) < 0) {
+	fprintf(stderr, "%s: Cannot connect to %s: %s\n",
+		pmGetProgname(), host, pmErrStr(ctx));
+	exit(1);
+    }
+    if ((sts = pmLookupName(NMETRICS, metrics, pmids)) < 0) {
+	fprintf(stderr, "pmLookupName: %s\n", pmErrStr(sts));
+	exit(1);
+    }
+    if ((sts = pmLookupName(NCOUNTERS, counters, cpmids)) < 0) {
+	fprintf(stderr, "pmLookupName: %s\n", pmErrStr(sts));
+	exit(1);
+    }
+
+    rp = fetch();
+    describe("first fetch", rp);
+    pmFreeResult(rp);
+
+    /* descriptors are cached, instances are sent once per connection */
+    rp = fetch();
+    describe("second fetch", rp);
+    pmFreeResult(rp);
+    names("second fetch");
+
+    if (command == NULL) {
+	pmDestroyContext(ctx);
+	exit(0);
+    }
+
+    fflush(stdout);
+    if ((sts = system(command)) != 0) {
+	fprintf(stderr, "%s: exit status %d\n", command, sts);
+	exit(1);
+    }
+
+    /* fetch until the agents are back, noting the state changes */
+    for (changes = tries = 0; tries < 100; tries++) {
+	rp = fetch();
+	if ((changes & PMCD_ADD_AGENT) && running(rp))
+	    break;
+	pmFreeResult(rp);
+	rp = NULL;
+	__pmtimevalSleep(delay);
+    }
+    if (rp == NULL) {
+	fprintf(stderr, "agents not restarted, changes 0x%x\n", changes);
+	exit(1);
+    }
+    printf("agent change: %s\n",
+	(changes & PMCD_AGENT_CHANGE) ? "reported" : "not reported");
+    describe("after restart", rp);
+    pmFreeResult(rp);
+    names("after restart");
+
+    pmDestroyContext(ctx);
+    exit(0);
+}
@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * Create an archive without pmcd, with optionally compressed data
+ * volumes, following the pmlogger write sequence ... flush before
+ * each result that gets a temporal index entry, write the result,
+ * then seek back to the start of the result for __pmLogPutIndex().
+ */
+
+#include <pcp/pmapi.h>
+#include "libpcp.h"
+
+int
+main(int argc, char **argv)
+{
+    int		c;
+    int		i;
+    int		sts;
+    int		errflag = 0;
+    int		nrec = 1000;
+    int		every = 50;
+    int		volrec = 0;
+    int		needti;
+    char	*method = NULL;
+    char	*endnum;
+    char	*name = "qa.gzvolume.counter";
+    off_t	offset, save;
+    pmDesc	desc;
+    pmValueSet	vset;
+    __pmResult	*rp;
+    __pmLogCtl	logctl;
+    __pmArchCtl	archctl;
+    __pmFILE	*newfp;
+    __pmPDU	*pdp;
+    __pmTimestamp	stamp = { 1700000000, 0 };
+
+    pmSetProgname(argv[0]);
+
+    while ((c = getopt(argc, argv, "D:i:n:v:z:?")) != EOF) {
+	switch (c) {
+
+	case 'D':	/* debug options */
+	    sts = pmSetDebug(optarg);
+	    if (sts < 0) {
+		fprintf(stderr, "%s: unrecognized debug options specification (%s)\n",
+		    pmGetProgname(), optarg);
+		errflag++;
+	    }
+	    break;
+
+	case 'i':	/* temporal index entry every N results */
+	    every = (int)strtol(optarg, &endnum, 10);
+	    if (*endnum != '\0' || every < 1) {
+		fprintf(stderr, "%s: -i requires positive numeric argument\n", pmGetProgname());
+		errflag++;
+	    }
+	    break;
+
+	case 'n':	/* number of results */
+	    nrec = (int)strtol(optarg, &endnum, 10);
+	    if (*endnum != '\0' || nrec < 1) {
+		fprintf(stderr, "%s: -n requires positive numeric argument\n", pmGetProgname());
+		errflag++;
+	    }
+	    break;
+
+	case 'v':	/* volume switch every N results */
+	    volrec = (int)strtol(optarg, &endnum, 10);
+	    if (*endnum != '\0' || volrec < 0) {
+		fprintf(stderr, "%s: -v requires numeric argument\n", pmGetProgname());
+		errflag++;
+	    }
+	    break;
+
+	case 'z':	/* compression method */
+	    method = optarg;
+	    break;
+
+	case '?':
+	default:
+	    errflag++;
+	    break;
+	}
+    }
+
+    if (errflag || optind != argc-1) {
+	fprintf(stderr,
+"Usage: %s [options] archive\n\
+\n\
+Options:\n\
+  -D debugflag[,...]\n\
+  -i N      temporal index entry every N results [default 50]\n\
+  -n N      number of results [default 1000]\n\
+  -v N      switch volumes every N results [default never]\n\
+  -z method compression for data volumes\n\
+",
+                pmGetProgname());
+        exit(1);
+    }
+
+    if (method != NULL && (sts = __pmLogSetCompress(method)) < 0) {
+	fprintf(stderr, "%s: __pmLogSetCompress(%s) failed: %s\n", pmGetProgname(), method, pmErrStr(sts));
+	exit(1);
+    }
+
+    memset(&logctl, 0, sizeof(logctl));
+    memset(&archctl, 0, sizeof(archctl));
+    archctl.ac_log = &logctl;
+    if ((sts = __pmLogCreate("qatest", argv[optind], PM_LOG_VERS03, &archctl)) != 0) {
+	fprintf(stderr, "%s: __pmLogCreate failed: %s\n", pmGetProgname(), pmErrStr(sts));
+	exit(1);
+    }
+
+    /* make the archive label deterministic */
+    logctl.label.pid = 1234;
+    if (logctl.label.hostname)
+	free(logctl.label.hostname);
+    logctl.label.hostname = strdup("happycamper");
+    if (logctl.label.timezone)
+	free(logctl.label.timezone);
+    logctl.label.timezone = strdup("UTC");
+    if (logctl.label.zoneinfo)
+	free(logctl.label.zoneinfo);
+    logctl.label.zoneinfo = NULL;
+
+    desc.pmid = pmID_build(511, 0, 1);
+    desc.type = PM_TYPE_U32;
+    desc.indom = PM_INDOM_NULL;
+    desc.sem = PM_SEM_COUNTER;
+    memset(&desc.units, 0, sizeof(desc.units));
+    desc.units.dimCount = 1;
+
+    if ((rp = __pmAllocResult(1)) == NULL) {
+	fprintf(stderr, "%s: __pmAllocResult failed\n", pmGetProgname());
+	exit(1);
+    }
+    rp->numpmid = 1;
+    rp->vset[0] = &vset;
+    vset.pmid = desc.pmid;
+    vset.numval = 1;
+    vset.valfmt = PM_VAL_INSITU;
+    vset.vlist[0].inst = PM_IN_NULL;
+
+    /* where the first record goes, in case there are none */
+    offset = __pmLogLabelSize(&logctl);
+    for (i = 0; i < nrec; i++) {
+	if (volrec > 0 && i > 0 && (i % volrec) == 0) {
+	    /* volume switch, as for newvolume() in pmlogger */
+	    if ((newfp = __pmLogNewFile(argv[optind], archctl.ac_curvol+1)) == NULL) {
+		fprintf(stderr, "%s: __pmLogNewFile failed: %s\n", pmGetProgname(), pmErrStr(-oserror()));
+		exit(1);
+	    }
+	    __pmFclose(archctl.ac_mfp);
+	    archctl.ac_mfp = newfp;
+	    logctl.label.vol = ++archctl.ac_curvol;
+	    __pmLogWriteLabel(archctl.ac_mfp, &logctl.label);
+	}
+	offset = __pmFtell(archctl.ac_mfp);
+	needti = (offset == __pmLogLabelSize(&logctl) || (i % every) == 0);
+	if (needti)
+	    __pmFflush(archctl.ac_mfp);
+
+	stamp.sec++;
+	rp->timestamp = stamp;
+	vset.vlist[0].value.lval = i * (i % 7);
+	if ((sts = __pmEncodeResult(&logctl, rp, &pdp)) < 0) {
+	    fprintf(stderr, "%s: __pmEncodeResult failed: %s\n", pmGetProgname(), pmErrStr(sts));
+	    exit(1);
+	}
+	__pmOverrideLastFd(__pmFileno(archctl.ac_mfp));
+	if ((sts = __pmLogPutResult3(&archctl, pdp)) < 0) {
+	    fprintf(stderr, "%s: __pmLogPutResult3 failed: %s\n", pmGetProgname(), pmErrStr(sts));
+	    exit(1);
+	}
+	__pmUnpinPDUBuf(pdp);
+
+	if (i == 0) {
+	    /*
+	     * first result, so the label records have now been written,
+	     * as for the pmlogger prologue, add the metadata and fudge
+	     * the offset for the temporal index
+	     */
+	    if ((sts = __pmLogPutDesc(&archctl, &desc, 1, &name)) < 0) {
+		fprintf(stderr, "%s: __pmLogPutDesc failed: %s\n", pmGetProgname(), pmErrStr(sts));
+		exit(1);
+	    }
+	    offset = __pmLogLabelSize(&logctl);
+	}
+	if (needti) {
+	    save = __pmFtell(archctl.ac_mfp);
+	    __pmFseek(archctl.ac_mfp, offset, SEEK_SET);
+	    __pmLogPutIndex(&archctl, &stamp);
+	    __pmFseek(archctl.ac_mfp, save, SEEK_SET);
+	}
+    }
+
+    /* last temporal index entry, as for run_done() in pmlogger */
+    __pmFseek(archctl.ac_mfp, offset, SEEK_SET);
+    __pmLogPutIndex(&archctl, &stamp);
+
+    free(rp);
+    __pmLogClose(&archctl);
+
+    exit(0);
+}
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2016 Red Hat.
+ * Copyright (c) 2016,2026 Red Hat.
  * Check the pmhttp.h / libpcp_web client APIs
  */
 
@@ -13,15 +13,16 @@ main(int argc, char *argv[])
     int			verbose = 0;
     int			version = 0;
     int			errflag = 0;
+    int			fresh = 0;
     char		*agent = NULL;
     char		*http_version = NULL;
     char		*agent_version = NULL;
     struct timeval	timeout = { 0 };
-    static const char	*usage = "[-aAptV] url";
+    static const char	*usage = "[-aAftV] url ...";
     struct http_client	*client;
 
     pmSetProgname(argv[0]);
-    while ((c = getopt(argc, argv, "a:A:D:t:vV:?")) != EOF) {
+    while ((c = getopt(argc, argv, "a:A:D:ft:vV:?")) != EOF) {
 	switch (c) {
 
 	case 'a':	/* user-agent string */
@@ -40,6 +41,10 @@ main(int argc, char *argv[])
 	    }
 	    break;
 
+	case 'f':	/* new client for each URL, connections are pooled */
+	    fresh = 1;
+	    break;
+
 	case 't':	/* request timeout (sec) */
 	    timeout.tv_sec = atoi(optarg);
 	    break;
@@ -85,24 +90,28 @@ main(int argc, char *argv[])
 	exit(1);
     }
 
-    if ((client = pmhttpNewClient()) == NULL) {
-	perror("pmhttpNewClient");
-	exit(1);
-    }
-
-    if (agent && agent_version)
-	pmhttpClientSetUserAgent(client, agent, agent_version);
-
-    if (http_version)
-	pmhttpClientSetProtocol(client, version);
-
-    if (timeout.tv_sec)
-	pmhttpClientSetTimeout(client, &timeout);
-
+    client = NULL;
     while (optind < argc) {
 	char buf[BUFSIZ];
 	char type[64] = {0};
 
+	if (client && fresh) {
+	    pmhttpFreeClient(client);
+	    client = NULL;
+	}
+	if (client == NULL) {
+	    if ((client = pmhttpNewClient()) == NULL) {
+		perror("pmhttpNewClient");
+		exit(1);
+	    }
+	    if (agent && agent_version)
+		pmhttpClientSetUserAgent(client, agent, agent_version);
+	    if (http_version)
+		pmhttpClientSetProtocol(client, version);
+	    if (timeout.tv_sec)
+		pmhttpClientSetTimeout(client, &timeout);
+	}
+
 	if (verbose)
 	    printf("<-- GET %s -->\n", argv[optind]);
 
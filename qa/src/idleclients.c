@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * Hold many idle client connections open to pmcd, then check that a
+ * client connecting after them (so with a pmcd descriptor larger than
+ * all of theirs) is still served, and that pmcd notices when the idle
+ * connections go away.
+ *
+ * Usage: idleclients [-h host] [-p port] nclients
+ */
+
+#include <pcp/pmapi.h>
+#include "libpcp.h"
+
+#define NSPARE	16
+
+static int
+numclients(int ctx, pmID *pmids, int *openfds)
+{
+    pmResult	*rp;
+    int		sts;
+
+    if ((sts = pmUseContext(ctx)) < 0)
+	return sts;
+    if ((sts = pmFetch(2, pmids, &rp)) < 0)
+	return sts;
+    if (rp->vset[0]->numval != 1 || rp->vset[1]->numval != 1)
+	sts = PM_ERR_VALUE;
+    else {
+	sts = rp->vset[0]->vlist[0].value.lval;
+	*openfds = rp->vset[1]->vlist[0].value.lval;
+    }
+    pmFreeResult(rp);
+    return sts;
+}
+
+static int
+connect_raw(const char *host, const char *port)
+{
+    struct addrinfo	hints;
+    struct addrinfo	*res;
+    struct timeval	wait = { 10, 0 };
+    char		ack[64];
+    int			fd;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, port, &hints, &res) != 0)
+	return -1;
+    if ((fd = socket(res->ai_family, res->ai_socktype, 0)) >= 0 &&
+	connect(fd, res->ai_addr, res->ai_addrlen) < 0) {
+	close(fd);
+	fd = -1;
+    }
+    freeaddrinfo(res);
+    /*
+     * wait for the connection ack (an error PDU) from pmcd, so the
+     * next connect does not overflow a short listen backlog
+     */
+    if (fd >= 0 &&
+	(setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &wait, sizeof(wait)) < 0 ||
+	 recv(fd, ack, sizeof(ack), 0) <= 0)) {
+	close(fd);
+	fd = -1;
+    }
+    return fd;
+}
+
+int
+main(int argc, char **argv)
+{
+    int		c;
+    int		errflag = 0;
+    int		nclients;
+    int		before, after, openfds;
+    int		ctx1, ctx2;
+    int		spare[NSPARE];
+    int		*fds;
+    int		i, sts;
+    char	*host = "localhost";
+    char	*port = NULL;
+    char	*endnum;
+    const char	*names[] = { "pmcd.numclients", "pmcd.openfds" };
+    pmID	pmids[2];
+
+    pmSetProgname(argv[0]);
+
+    while ((c = getopt(argc, argv, "h:p:")) != EOF) {
+	switch (c) {
+	case 'h':
+	    host = optarg;
+	    break;
+	case 'p':
+	    port = optarg;
+	    break;
+	default:
+	    errflag++;
+	}
+    }
+    if (errflag || optind != argc-1 ||
+	(nclients = (int)strtol(argv[optind], &endnum, 10)) <= 0 || *endnum) {
+	fprintf(stderr, "Usage: %s [-h host] [-p port] nclients\n", pmGetProgname());
+	exit(1);
+    }
+    if (port == NULL && (port = getenv("PMCD_PORT")) == NULL)
+	port = "44321";
+
+    if ((ctx1 = pmNewContext(PM_CONTEXT_HOST, host)) < 0) {
+	fprintf(stderr, "pmNewContext(%s): %s\n", host, pmErrStr(ctx1));
+	exit(1);
+    }
+    if ((sts = pmLookupName(2, names, pmids)) < 0) {
+	fprintf(stderr, "pmLookupName: %s\n", pmErrStr(sts));
+	exit(1);
+    }
+    if ((before = numclients(ctx1, pmids, &openfds)) < 0) {
+	fprintf(stderr, "fetch before: %s\n", pmErrStr(before));
+	exit(1);
+    }
+
+    /*
+     * keep some low numbered descriptors aside, so the connection for
+     * ctx2 below is not a large descriptor here (only at the pmcd end)
+     */
+    for (i = 0; i < NSPARE; i++)
+	spare[i] = open("/dev/null", O_RDONLY);
+
+    if ((fds = (int *)malloc(nclients * sizeof(int))) == NULL) {
+	fprintf(stderr, "malloc(%d fds) failed\n", nclients);
+	exit(1);
+    }
+    for (i = 0; i < nclients; i++) {
+	if ((fds[i] = connect_raw(host, port)) < 0) {
+	    fprintf(stderr, "connect #%d failed: %s\n", i, osstrerror());
+	    exit(1);
+	}
+    }
+    printf("%d idle clients connected\n", nclients);
+
+    for (i = 0; i < NSPARE; i++)
+	close(spare[i]);
+    if ((ctx2 = pmNewContext(PM_CONTEXT_HOST, host)) < 0) {
+	fprintf(stderr, "pmNewContext(%s) after idle clients: %s\n", host, pmErrStr(ctx2));
+	exit(1);
+    }
+    if ((after = numclients(ctx2, pmids, &openfds)) < 0) {
+	fprintf(stderr, "fetch after: %s\n", pmErrStr(after));
+	exit(1);
+    }
+    printf("numclients increased by at least %d: %s\n", nclients,
+	    after - before >= nclients ? "yes" : "no");
+    printf("pmcd.openfds above %d: %s\n", nclients,
+	    openfds > nclients ? "yes" : "no");
+    if (after - before < nclients || openfds <= nclients)
+	fprintf(stderr, "before=%d after=%d openfds=%d\n", before, after, openfds);
+
+    for (i = 0; i < nclients; i++)
+	close(fds[i]);
+    for (i = 0; i < 100; i++) {
+	if ((after = numclients(ctx2, pmids, &openfds)) < 0) {
+	    fprintf(stderr, "fetch at end: %s\n", pmErrStr(after));
+	    exit(1);
+	}
+	if (after <= before + 1)
+	    break;
+	usleep(100000);
+    }
+    printf("idle clients gone: %s\n", after <= before + 1 ? "yes" : "no");
+    if (after > before + 1)
+	fprintf(stderr, "before=%d end=%d\n", before, after);
+
+    pmDestroyContext(ctx2);
+    pmDestroyContext(ctx1);
+    free(fds);
+    return 0;
+}
@@ -0,0 +1,155 @@
+/*
+ * Instance profile checks after a PDU_PROFILE round trip - compares
+ * pmdaInProfile and pmdaProfileInstances against a linear scan of the
+ * profile as it was sent, in whatever order that was.
+ *
+ * Copyright (c) 2026 Red Hat.
+ */
+
+#include <pcp/pmapi.h>
+#include <pcp/libpcp.h>
+#include <pcp/pmda.h>
+#include <sys/socket.h>
+
+static void
+usage(void)
+{
+    fprintf(stderr, "Usage: %s [-n numinst] [-s step]\n", pmGetProgname());
+    exit(1);
+}
+
+/* the original, linear, profile check */
+static int
+linear(pmInDom indom, const pmProfile *prof, int inst)
+{
+    pmInDomProfile	*p;
+    int			i, j;
+
+    for (i = 0; i < prof->profile_len; i++) {
+	p = &prof->profile[i];
+	if (p->indom != indom)
+	    continue;
+	for (j = 0; j < p->instances_len; j++)
+	    if (p->instances[j] == inst)
+		return (p->state == PM_PROFILE_INCLUDE) ? 0 : 1;
+	return (p->state == PM_PROFILE_INCLUDE) ? 1 : 0;
+    }
+    return (prof->state == PM_PROFILE_INCLUDE) ? 1 : 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    pmProfile		sent, *recv;
+    pmInDomProfile	idp[3];
+    pmInDom		indoms[4];
+    pmdaExt		ext;
+    __pmPDU		*pb;
+    char		strbuf[20], *endnum;
+    int			few[] = { 5, 3, 1 };
+    int			*many, *list;
+    int			c, i, j, k, sts, fd[2], ctxnum, state, len;
+    int			numinst = 50000, step = 25;
+    int			nwant, nbad;
+
+    pmSetProgname(argv[0]);
+    while ((c = getopt(argc, argv, "n:s:")) != EOF) {
+	switch (c) {
+	case 'n':
+	    numinst = (int)strtol(optarg, &endnum, 10);
+	    if (*endnum != '\0' || numinst <= 0)
+		usage();
+	    break;
+	case 's':
+	    step = (int)strtol(optarg, &endnum, 10);
+	    if (*endnum != '\0' || step <= 0)
+		usage();
+	    break;
+	default:
+	    usage();
+	}
+    }
+    if (optind != argc)
+	usage();
+
+    /* every step'th instance, highest first */
+    if ((many = (int *)malloc(numinst * sizeof(int))) == NULL) {
+	perror("malloc");
+	exit(1);
+    }
+    for (i = numinst - 1, k = 0; i >= 0; i -= step)
+	many[k++] = i;
+
+    /* indoms deliberately out of order */
+    indoms[0] = pmInDom_build(29, 3);
+    indoms[1] = pmInDom_build(29, 1);
+    indoms[2] = pmInDom_build(29, 2);
+    indoms[3] = pmInDom_build(29, 4);	/* not in the profile */
+    idp[0].indom = indoms[0];
+    idp[0].state = PM_PROFILE_EXCLUDE;
+    idp[0].instances_len = k;
+    idp[0].instances = many;
+    idp[1].indom = indoms[1];
+    idp[1].state = PM_PROFILE_INCLUDE;
+    idp[1].instances_len = sizeof(few) / sizeof(few[0]);
+    idp[1].instances = few;
+    idp[2].indom = indoms[2];
+    idp[2].state = PM_PROFILE_EXCLUDE;
+    idp[2].instances_len = 0;
+    idp[2].instances = NULL;
+    sent.state = PM_PROFILE_INCLUDE;
+    sent.profile_len = 3;
+    sent.profile = idp;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fd) < 0) {
+	perror("socketpair");
+	exit(1);
+    }
+    if ((sts = __pmSendProfile(fd[1], FROM_ANON, 0, &sent)) < 0) {
+	fprintf(stderr, "__pmSendProfile: %s\n", pmErrStr(sts));
+	exit(1);
+    }
+    if ((sts = __pmGetPDU(fd[0], ANY_SIZE, TIMEOUT_DEFAULT, &pb)) != PDU_PROFILE) {
+	fprintf(stderr, "__pmGetPDU: %s\n", sts < 0 ? pmErrStr(sts) : __pmPDUTypeStr(sts));
+	exit(1);
+    }
+    if ((sts = __pmDecodeProfile(pb, &ctxnum, &recv)) < 0) {
+	fprintf(stderr, "__pmDecodeProfile: %s\n", pmErrStr(sts));
+	exit(1);
+    }
+    __pmUnpinPDUBuf(pb);
+
+    /* shorten the long list so that the dump is readable */
+    len = recv->profile[2].instances_len;
+    if (len > 4)
+	recv->profile[2].instances_len = 4;
+    __pmDumpProfile(stdout, PM_INDOM_NULL, recv);
+    recv->profile[2].instances_len = len;
+
+    memset(&ext, 0, sizeof(ext));
+    pmdaProfile(recv, &ext);
+
+    for (i = 0; i < 4; i++) {
+	nwant = nbad = 0;
+	for (j = 0; j < numinst; j++) {
+	    sts = pmdaInProfile(indoms[i], j, &ext);
+	    if (sts != linear(indoms[i], &sent, j))
+		nbad++;
+	    nwant += sts;
+	}
+	len = pmdaProfileInstances(indoms[i], &state, &list, &ext);
+	printf("indom %s: %d of %d wanted, %d mismatches; list %s %d",
+		pmInDomStr_r(indoms[i], strbuf, sizeof(strbuf)),
+		nwant, numinst, nbad,
+		state == PM_PROFILE_INCLUDE ? "excludes" : "includes", len);
+	for (j = 0; j < len && j < 4; j++)
+	    printf(" [%d]", list[j]);
+	if (len > j)
+	    printf(" ... [%d]", list[len-1]);
+	putchar('\n');
+    }
+
+    __pmFreeProfile(recv);
+    free(many);
+    exit(0);
+}
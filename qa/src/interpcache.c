@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * Exercise the archive interpolation read cache by replaying the
+ * same time window several times and reporting archive reads and
+ * read cache hits for each pass.
+ *
+ * Usage: interpcache archive metric [passes [samples]]
+ */
+
+#include <pcp/pmapi.h>
+#include "libpcp.h"
+
+int
+main(int argc, char **argv)
+{
+    pmID	pmid;
+    pmResult	*rp;
+    pmLogLabel	label;
+    const char	*name;
+    long	reads, hits;
+    long	last_reads = 0, last_hits = 0;
+    int		passes = 3;
+    int		samples = 100;
+    int		pass, i, sts;
+
+    pmSetProgname(argv[0]);
+    if (argc < 3 || argc > 5) {
+	fprintf(stderr, "Usage: %s archive metric [passes [samples]]\n", pmGetProgname());
+	exit(1);
+    }
+    if (argc > 3)
+	passes = atoi(argv[3]);
+    if (argc > 4)
+	samples = atoi(argv[4]);
+
+    if ((sts = pmNewContext(PM_CONTEXT_ARCHIVE, argv[1])) < 0) {
+	fprintf(stderr, "pmNewContext(%s): %s\n", argv[1], pmErrStr(sts));
+	exit(1);
+    }
+    name = argv[2];
+    if ((sts = pmLookupName(1, &name, &pmid)) < 0) {
+	fprintf(stderr, "pmLookupName(%s): %s\n", name, pmErrStr(sts));
+	exit(1);
+    }
+    if ((sts = pmGetArchiveLabel(&label)) < 0) {
+	fprintf(stderr, "pmGetArchiveLabel: %s\n", pmErrStr(sts));
+	exit(1);
+    }
+
+    for (pass = 0; pass < passes; pass++) {
+	if ((sts = pmSetMode(PM_MODE_INTERP, &label.ll_start, 20000)) < 0) {
+	    fprintf(stderr, "pmSetMode: %s\n", pmErrStr(sts));
+	    exit(1);
+	}
+	for (i = 0; i < samples; i++) {
+	    if ((sts = pmFetch(1, &pmid, &rp)) < 0)
+		break;
+	    pmFreeResult(rp);
+	}
+	if ((sts = __pmGetInterpStats(PM_MODE_FORW, &reads, &hits)) < 0) {
+	    fprintf(stderr, "__pmGetInterpStats: %s\n", pmErrStr(sts));
+	    exit(1);
+	}
+	printf("pass %d: %d samples, %ld reads, %ld cache hits\n",
+		pass, i, reads - last_reads, hits - last_hits);
+	last_reads = reads;
+	last_hits = hits;
+    }
+
+    if ((sts = __pmGetInterpStats(-1, &reads, &hits)) != PM_ERR_MODE)
+	printf("__pmGetInterpStats(-1): unexpected return %d\n", sts);
+
+    return 0;
+}
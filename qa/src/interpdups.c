@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * Interpolated fetches where the same metric appears more than once
+ * in the pmidlist[], every copy should have the same values.
+ *
+ * Usage: interpdups archive samples metric [metric ...]
+ */
+
+#include <pcp/pmapi.h>
+#include "libpcp.h"
+
+static int
+samevset(pmValueSet *a, pmValueSet *b)
+{
+    int		j;
+
+    if (a->numval != b->numval)
+	return 0;
+    if (a->numval > 0 && a->valfmt != b->valfmt)
+	return 0;
+    for (j = 0; j < a->numval; j++) {
+	if (a->vlist[j].inst != b->vlist[j].inst)
+	    return 0;
+	if (a->valfmt == PM_VAL_INSITU) {
+	    if (a->vlist[j].value.lval != b->vlist[j].value.lval)
+		return 0;
+	}
+	else if (a->vlist[j].value.pval->vlen != b->vlist[j].value.pval->vlen ||
+		 memcmp(a->vlist[j].value.pval, b->vlist[j].value.pval,
+			a->vlist[j].value.pval->vlen) != 0)
+	    return 0;
+    }
+    return 1;
+}
+
+int
+main(int argc, char **argv)
+{
+    pmID	*pmidlist;
+    pmResult	*rp;
+    pmLogLabel	label;
+    int		numpmid;
+    int		samples;
+    int		i, j, k, sts;
+
+    pmSetProgname(argv[0]);
+    if (argc < 4) {
+	fprintf(stderr, "Usage: %s archive samples metric [metric ...]\n", pmGetProgname());
+	exit(1);
+    }
+    samples = atoi(argv[2]);
+    numpmid = argc - 3;
+
+    if ((sts = pmNewContext(PM_CONTEXT_ARCHIVE, argv[1])) < 0) {
+	fprintf(stderr, "pmNewContext(%s): %s\n", argv[1], pmErrStr(sts));
+	exit(1);
+    }
+    if ((pmidlist = (pmID *)malloc(numpmid * sizeof(pmID))) == NULL) {
+	fprintf(stderr, "malloc: %s\n", pmErrStr(-oserror()));
+	exit(1);
+    }
+    if ((sts = pmLookupName(numpmid, (const char **)&argv[3], pmidlist)) < 0) {
+	fprintf(stderr, "pmLookupName: %s\n", pmErrStr(sts));
+	exit(1);
+    }
+    if ((sts = pmGetArchiveLabel(&label)) < 0) {
+	fprintf(stderr, "pmGetArchiveLabel: %s\n", pmErrStr(sts));
+	exit(1);
+    }
+    if ((sts = pmSetMode(PM_MODE_INTERP, &label.ll_start, 1000)) < 0) {
+	fprintf(stderr, "pmSetMode: %s\n", pmErrStr(sts));
+	exit(1);
+    }
+
+    for (i = 0; i < samples; i++) {
+	if ((sts = pmFetch(numpmid, pmidlist, &rp)) < 0) {
+	    printf("sample %d: pmFetch: %s\n", i, pmErrStr(sts));
+	    break;
+	}
+	printf("sample %d: numval", i);
+	for (j = 0; j < rp->numpmid; j++)
+	    printf(" %d", rp->vset[j]->numval);
+	putchar('\n');
+	for (j = 0; j < rp->numpmid; j++) {
+	    for (k = j + 1; k < rp->numpmid; k++) {
+		if (rp->vset[j]->pmid == rp->vset[k]->pmid &&
+		    !samevset(rp->vset[j], rp->vset[k]))
+		    printf("sample %d: vset[%d] and vset[%d] differ for %s\n",
+			i, j, k, pmIDStr(rp->vset[j]->pmid));
+	    }
+	}
+	pmFreeResult(rp);
+    }
+
+    return 0;
+}
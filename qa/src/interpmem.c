@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * Replay an archive in interpolated mode and report the values
+ * returned (as a count and a checksum, so runs with and without a
+ * memory limit can be compared) and the memory used for interpolation
+ * in the context.
+ *
+ * -r replays backwards from the end of the archive, -x fetches only the
+ * first metric at every second sample.
+ *
+ * Usage: interpmem [-rx] [-l limit] [-t interval] archive metric ...
+ */
+
+#include <pcp/pmapi.h>
+#include "libpcp.h"
+
+int
+main(int argc, char **argv)
+{
+    pmID		*pmids;
+    pmResult		*rp;
+    pmLogLabel		label;
+    struct timeval	start;
+    pmDesc		desc;
+    pmAtomValue		atom;
+    __pmInterpUsage	usage;
+    struct timeval	interval = { 10, 0 };
+    char		*endnum;
+    double		sum = 0;
+    size_t		maxbytes = 0;
+    long		limit = -1;
+    long		values = 0;
+    int			samples = 0;
+    int			c, i, j, n, sts;
+    int			reverse = 0;
+    int			alternate = 0;
+    int			errflag = 0;
+
+    pmSetProgname(argv[0]);
+    while ((c = getopt(argc, argv, "l:rt:x")) != EOF) {
+	switch (c) {
+	case 'l':
+	    limit = strtol(optarg, &endnum, 10);
+	    if (*endnum != '\0' || limit < 0)
+		errflag++;
+	    break;
+	case 'r':
+	    reverse = 1;
+	    break;
+	case 'x':
+	    alternate = 1;
+	    break;
+	case 't':
+	    if (pmParseInterval(optarg, &interval, &endnum) < 0) {
+		free(endnum);
+		errflag++;
+	    }
+	    break;
+	default:
+	    errflag++;
+	}
+    }
+    if (errflag || argc - optind < 2) {
+	fprintf(stderr, "Usage: %s [-rx] [-l limit] [-t interval] archive metric ...\n", pmGetProgname());
+	exit(1);
+    }
+
+    if ((sts = pmNewContext(PM_CONTEXT_ARCHIVE, argv[optind])) < 0) {
+	fprintf(stderr, "pmNewContext(%s): %s\n", argv[optind], pmErrStr(sts));
+	exit(1);
+    }
+    optind++;
+    n = argc - optind;
+    if ((pmids = (pmID *)malloc(n * sizeof(pmID))) == NULL) {
+	fprintf(stderr, "malloc failed\n");
+	exit(1);
+    }
+    if ((sts = pmLookupName(n, (const char **)&argv[optind], pmids)) < 0) {
+	fprintf(stderr, "pmLookupName: %s\n", pmErrStr(sts));
+	exit(1);
+    }
+    if ((sts = pmGetArchiveLabel(&label)) < 0) {
+	fprintf(stderr, "pmGetArchiveLabel: %s\n", pmErrStr(sts));
+	exit(1);
+    }
+    if (limit >= 0 && (sts = __pmSetInterpLimit(limit)) < 0) {
+	fprintf(stderr, "__pmSetInterpLimit: %s\n", pmErrStr(sts));
+	exit(1);
+    }
+    start = label.ll_start;
+    if (reverse) {
+	if ((sts = pmGetArchiveEnd(&start)) < 0) {
+	    fprintf(stderr, "pmGetArchiveEnd: %s\n", pmErrStr(sts));
+	    exit(1);
+	}
+	sts = pmSetMode(PM_MODE_INTERP, &start, -pmtimevalToReal(&interval) * 1000);
+    }
+    else
+	sts = pmSetMode(PM_MODE_INTERP, &start, pmtimevalToReal(&interval) * 1000);
+    if (sts < 0) {
+	fprintf(stderr, "pmSetMode: %s\n", pmErrStr(sts));
+	exit(1);
+    }
+
+    while ((sts = pmFetch(alternate && (samples & 1) ? 1 : n, pmids, &rp)) >= 0) {
+	samples++;
+	for (i = 0; i < rp->numpmid; i++) {
+	    pmValueSet	*vsp = rp->vset[i];
+
+	    if (vsp->numval <= 0)
+		continue;
+	    if ((sts = pmLookupDesc(vsp->pmid, &desc)) < 0) {
+		fprintf(stderr, "pmLookupDesc: %s\n", pmErrStr(sts));
+		exit(1);
+	    }
+	    for (j = 0; j < vsp->numval; j++) {
+		values++;
+		sum += vsp->vlist[j].inst;
+		if (desc.type == PM_TYPE_STRING) {
+		    if (pmExtractValue(vsp->valfmt, &vsp->vlist[j], desc.type, &atom, PM_TYPE_STRING) >= 0) {
+			sum += strlen(atom.cp);
+			free(atom.cp);
+		    }
+		}
+		else if (pmExtractValue(vsp->valfmt, &vsp->vlist[j], desc.type, &atom, PM_TYPE_DOUBLE) >= 0)
+		    sum += atom.d;
+	    }
+	}
+	pmFreeResult(rp);
+	if ((sts = __pmGetInterpUsage(&usage)) < 0) {
+	    fprintf(stderr, "__pmGetInterpUsage: %s\n", pmErrStr(sts));
+	    exit(1);
+	}
+	if (usage.bytes > maxbytes)
+	    maxbytes = usage.bytes;
+    }
+    if (sts != PM_ERR_EOL)
+	fprintf(stderr, "pmFetch: %s\n", pmErrStr(sts));
+
+    printf("%d samples, %ld values, checksum %.15g\n", samples, values, sum);
+    if ((sts = __pmGetInterpUsage(&usage)) < 0) {
+	fprintf(stderr, "__pmGetInterpUsage: %s\n", pmErrStr(sts));
+	exit(1);
+    }
+    printf("limit %zu bytes, max %zu bytes, now %zu bytes\n", usage.limit, maxbytes, usage.bytes);
+    printf("values held %ld, evicted %ld, released %ld, unloaded %ld\n",
+	    usage.values, usage.evicted, usage.released, usage.unloaded);
+
+    return 0;
+}
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * Exercise the mmap i/o handler for uncompressed files opened
+ * read-only by __pmFopen(), comparing forwards and backwards reads
+ * against stdio, and reading a file that grows after it is opened.
+ *
+ * Usage: iommap file tmpfile
+ */
+
+#include <pcp/pmapi.h>
+#include "libpcp.h"
+
+static int
+compare(const char *file, int chunk)
+{
+    __pmFILE	*f;
+    FILE	*fp;
+    char	buf1[1024], buf2[1024];
+    long	size, posn;
+    size_t	n1, n2;
+    int		bad = 0;
+
+    if ((f = __pmFopen(file, "r")) == NULL) {
+	fprintf(stderr, "__pmFopen(%s): %s\n", file, pmErrStr(-oserror()));
+	exit(1);
+    }
+    if ((fp = fopen(file, "r")) == NULL) {
+	fprintf(stderr, "fopen(%s): %s\n", file, pmErrStr(-oserror()));
+	exit(1);
+    }
+
+    /* forwards, chunk bytes at a time */
+    for ( ; ; ) {
+	n1 = __pmFread(buf1, 1, chunk, f);
+	n2 = fread(buf2, 1, chunk, fp);
+	if (n1 != n2 || memcmp(buf1, buf2, n1) != 0) {
+	    printf("forw: mismatch at %ld: %zd vs %zd\n", ftell(fp), n1, n2);
+	    bad++;
+	    break;
+	}
+	if (n1 < (size_t)chunk)
+	    break;
+    }
+    printf("forw chunk=%d: feof=%d tell=%s\n", chunk,
+	    __pmFeof(f) != 0, __pmFtell(f) == ftell(fp) ? "ok" : "bad");
+
+    /* backwards, chunk bytes at a time */
+    __pmClearerr(f);
+    __pmFseek(f, 0L, SEEK_END);
+    size = __pmFtell(f);
+    for (posn = size - chunk; posn > -chunk; posn -= chunk) {
+	if (posn < 0)
+	    posn = 0;
+	__pmFseek(f, posn, SEEK_SET);
+	fseek(fp, posn, SEEK_SET);
+	n1 = __pmFread(buf1, 1, chunk, f);
+	n2 = fread(buf2, 1, chunk, fp);
+	if (n1 != n2 || memcmp(buf1, buf2, n1) != 0) {
+	    printf("back: mismatch at %ld: %zd vs %zd\n", posn, n1, n2);
+	    bad++;
+	    break;
+	}
+	if (posn == 0)
+	    break;
+    }
+    fseek(fp, 0L, SEEK_END);
+    printf("back chunk=%d: size=%s\n", chunk, size == ftell(fp) ? "ok" : "bad");
+
+    __pmRewind(f);
+    rewind(fp);
+    if (__pmFgetc(f) != fgetc(fp) || __pmFtell(f) != 1) {
+	printf("fgetc: mismatch\n");
+	bad++;
+    }
+
+    fclose(fp);
+    __pmFclose(f);
+    return bad;
+}
+
+static int
+grow(const char *tmpfile)
+{
+    __pmFILE	*f;
+    FILE	*fp;
+    char	buf[16];
+    size_t	n;
+    int		bad = 0;
+
+    if ((fp = fopen(tmpfile, "w")) == NULL) {
+	fprintf(stderr, "fopen(%s): %s\n", tmpfile, pmErrStr(-oserror()));
+	exit(1);
+    }
+    fputs("abcd", fp);
+    fflush(fp);
+
+    if ((f = __pmFopen(tmpfile, "r")) == NULL) {
+	fprintf(stderr, "__pmFopen(%s): %s\n", tmpfile, pmErrStr(-oserror()));
+	exit(1);
+    }
+    n = __pmFread(buf, 1, 8, f);
+    printf("grow: read %zd bytes feof=%d\n", n, __pmFeof(f) != 0);
+    if (n != 4)
+	bad++;
+
+    __pmClearerr(f);
+    fputs("efgh", fp);
+    fflush(fp);
+    n = __pmFread(buf, 1, 4, f);
+    buf[n] = '\0';
+    printf("grow: read %zd more bytes \"%s\" feof=%d\n", n, buf, __pmFeof(f) != 0);
+    if (n != 4 || strcmp(buf, "efgh") != 0)
+	bad++;
+
+    __pmFseek(f, 0L, SEEK_END);
+    printf("grow: size %ld\n", __pmFtell(f));
+
+    if (__pmFwrite(buf, 1, 1, f) != 0) {
+	printf("grow: write to read-only stream succeeded\n");
+	bad++;
+    }
+
+    fclose(fp);
+    __pmFclose(f);
+    return bad;
+}
+
+int
+main(int argc, char **argv)
+{
+    int		bad = 0;
+
+    pmSetProgname(argv[0]);
+    if (argc != 3) {
+	fprintf(stderr, "Usage: %s file tmpfile\n", pmGetProgname());
+	exit(1);
+    }
+
+    bad += compare(argv[1], 1);
+    bad += compare(argv[1], 13);
+    bad += compare(argv[1], 1024);
+    bad += grow(argv[2]);
+
+    printf("%s\n", bad ? "failed" : "passed");
+    return bad != 0;
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * Random and sequential reads of a (possibly compressed) file via
+ * __pmFopen(), compared with the same reads of the uncompressed file
+ * via stdio.
+ *
+ * Usage: ioseek [-n count] file plainfile
+ */
+
+#include <pcp/pmapi.h>
+#include "libpcp.h"
+
+#define MAXREAD 65536
+
+int
+main(int argc, char **argv)
+{
+    __pmFILE	*f;
+    FILE	*fp;
+    struct stat	sbuf;
+    static char	buf1[MAXREAD], buf2[MAXREAD];
+    long	size, posn;
+    size_t	n1, n2;
+    int		count = 1000;
+    int		bad = 0;
+    int		c, i, len;
+
+    pmSetProgname(argv[0]);
+    while ((c = getopt(argc, argv, "n:")) != EOF) {
+	switch (c) {
+	case 'n':
+	    count = atoi(optarg);
+	    break;
+	default:
+	    bad++;
+	}
+    }
+    if (bad || argc != optind + 2) {
+	fprintf(stderr, "Usage: %s [-n count] file plainfile\n", pmGetProgname());
+	exit(1);
+    }
+
+    if ((f = __pmFopen(argv[optind], "r")) == NULL) {
+	fprintf(stderr, "__pmFopen(%s): %s\n", argv[optind], pmErrStr(-oserror()));
+	exit(1);
+    }
+    if ((fp = fopen(argv[optind+1], "r")) == NULL) {
+	fprintf(stderr, "fopen(%s): %s\n", argv[optind+1], pmErrStr(-oserror()));
+	exit(1);
+    }
+
+    fseek(fp, 0L, SEEK_END);
+    size = ftell(fp);
+    if (__pmFstat(f, &sbuf) < 0 || sbuf.st_size != size) {
+	printf("__pmFstat: size %lld, expected %ld\n", (long long)sbuf.st_size, size);
+	bad++;
+    }
+
+    /* random reads, some past the end of the file */
+    srandom(1);
+    for (i = 0; i < count; i++) {
+	len = random() % MAXREAD;
+	posn = random() % (size + 100);
+	__pmFseek(f, posn, SEEK_SET);
+	fseek(fp, posn, SEEK_SET);
+	n1 = __pmFread(buf1, 1, len, f);
+	n2 = fread(buf2, 1, len, fp);
+	if (n1 != n2 || memcmp(buf1, buf2, n1) != 0) {
+	    printf("random: mismatch at %ld len %d: got %zd expected %zd\n",
+		    posn, len, n1, n2);
+	    bad++;
+	    break;
+	}
+	if (__pmFtell(f) != ftell(fp)) {
+	    printf("random: __pmFtell %ld expected %ld\n", __pmFtell(f), ftell(fp));
+	    bad++;
+	    break;
+	}
+    }
+    printf("random reads: %s\n", bad ? "failed" : "ok");
+
+    /* sequential reads */
+    __pmRewind(f);
+    rewind(fp);
+    while ((n1 = __pmFread(buf1, 1, 4096, f)) > 0) {
+	n2 = fread(buf2, 1, 4096, fp);
+	if (n1 != n2 || memcmp(buf1, buf2, n1) != 0) {
+	    printf("sequential: mismatch at %ld\n", ftell(fp));
+	    bad++;
+	    break;
+	}
+    }
+    printf("sequential reads: %s feof=%d\n", bad ? "failed" : "ok", __pmFeof(f) != 0);
+
+    __pmFclose(f);
+    fclose(fp);
+    return bad != 0;
+}
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * Exercise the client-side cache of name and descriptor lookups for
+ * host contexts ... count the lookup PDUs sent to pmcd for repeated
+ * pmLookupName, pmLookupDesc and pmLookupDescs calls.
+ */
+
+#include <pcp/pmapi.h>
+#include "libpcp.h"
+
+#define MAXNAMES	32
+
+static unsigned int
+lookups(void)
+{
+    return __pmPDUCntOut[PDU_PMNS_NAMES - PDU_START] +
+	   __pmPDUCntOut[PDU_DESC_REQ - PDU_START] +
+	   __pmPDUCntOut[PDU_DESC_IDS - PDU_START];
+}
+
+static int
+lookup(int numnames, const char **names, pmID *pmids, pmDesc *descs)
+{
+    pmDesc	desc;
+    int		i, sts;
+
+    if ((sts = pmLookupName(numnames, names, pmids)) < 0) {
+	fprintf(stderr, "pmLookupName: %s\n", pmErrStr(sts));
+	return sts;
+    }
+    if ((sts = pmLookupDescs(numnames, pmids, descs)) < 0) {
+	fprintf(stderr, "pmLookupDescs: %s\n", pmErrStr(sts));
+	return sts;
+    }
+    for (i = 0; i < numnames; i++) {
+	if ((sts = pmLookupDesc(pmids[i], &desc)) < 0) {
+	    fprintf(stderr, "pmLookupDesc(%s): %s\n", names[i], pmErrStr(sts));
+	    return sts;
+	}
+	if (memcmp(&desc, &descs[i], sizeof(desc)) != 0) {
+	    fprintf(stderr, "%s: pmLookupDesc and pmLookupDescs differ\n",
+		    names[i]);
+	    return PM_ERR_GENERIC;
+	}
+    }
+    return numnames;
+}
+
+static void
+report(const char *what, unsigned int before, int sts)
+{
+    unsigned int	n = lookups() - before;
+
+    if (sts < 0)
+	printf("%s: failed\n", what);
+    else
+	printf("%s: %s\n", what, n ? "lookup PDUs sent" : "no lookup PDUs");
+}
+
+int
+main(int argc, char **argv)
+{
+    int			c;
+    int			sts;
+    int			ctx;
+    int			errflag = 0;
+    int			numnames;
+    char		*host = "local:";
+    const char		*names[MAXNAMES];
+    const char		*bad = "no.such.metric";
+    pmID		pmids[MAXNAMES], pmids2[MAXNAMES], pmid;
+    pmDesc		descs[MAXNAMES], descs2[MAXNAMES];
+    unsigned int	before;
+
+    pmSetProgname(argv[0]);
+
+    while ((c = getopt(argc, argv, "D:h:?")) != EOF) {
+	switch (c) {
+
+	case 'D':	/* debug options */
+	    sts = pmSetDebug(optarg);
+	    if (sts < 0) {
+		fprintf(stderr, "%s: unrecognized debug options specification (%s)\n",
+		    pmGetProgname(), optarg);
+		errflag++;
+	    }
+	    break;
+
+	case 'h':	/* host */
+	    host = optarg;
+	    break;
+
+	case '?':
+	default:
+	    errflag++;
+	    break;
+	}
+    }
+
+    numnames = argc - optind;
+    if (errflag || numnames < 1 || numnames > MAXNAMES) {
+	fprintf(stderr, "Usage: %s [-D debug] [-h host] metric ...\n",
+		pmGetProgname());
+	exit(1);
+    }
+    for (c = 0; c < numnames; c++)
+	names[c] = argv[optind + c];
+
+    if ((ctx = pmNewContext(PM_CONTEXT_HOST, host)) < 0) {
+	fprintf(stderr, "%s: Cannot connect to %s: %s\n",
+		pmGetProgname(), host, pmErrStr(ctx));
+	exit(1);
+    }
+
+    before = lookups();
+    sts = lookup(numnames, names, pmids, descs);
+    report("first lookup", before, sts);
+
+    before = lookups();
+    sts = lookup(numnames, names, pmids2, descs2);
+    report("repeated lookup", before, sts);
+    if (sts >= 0) {
+	printf("same pmids: %s\n",
+	    memcmp(pmids, pmids2, numnames * sizeof(pmID)) ? "no" : "yes");
+	printf("same descs: %s\n",
+	    memcmp(descs, descs2, numnames * sizeof(pmDesc)) ? "no" : "yes");
+    }
+
+    before = lookups();
+    sts = pmLookupName(1, &bad, &pmid);
+    report("unknown name", before, (sts == PM_ERR_NAME) ? 0 : -1);
+    before = lookups();
+    sts = pmLookupName(1, &bad, &pmid);
+    report("unknown name again", before, (sts == PM_ERR_NAME) ? 0 : -1);
+
+    if ((sts = pmReconnectContext(ctx)) < 0) {
+	fprintf(stderr, "pmReconnectContext: %s\n", pmErrStr(sts));
+	exit(1);
+    }
+    before = lookups();
+    sts = lookup(numnames, names, pmids2, descs2);
+    report("lookup after reconnect", before, sts);
+
+    pmDestroyContext(ctx);
+    exit(0);
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * Merge label set hierarchies with __pmMergedLabelSet() and check the
+ * result against pmMergeLabelSets(), including compound and optional
+ * labels and the label flags carried through from each level.
+ */
+
+#include <pcp/pmapi.h>
+#include "libpcp.h"
+
+static const struct {
+    const char	*json;
+    int		flags;
+} input[] = {
+    { "{\"hostname\":\"acme\",\"agent\":\"none\"}", PM_LABEL_CONTEXT },
+    { "{\"agent\":\"sample\",\"role\":\"testing\"}", PM_LABEL_DOMAIN },
+    { "{\"device\":{\"type\":\"disk\",\"bus\":\"scsi\"}}", PM_LABEL_INDOM },
+    { "{\"units\":\"bytes\"}", PM_LABEL_CLUSTER|PM_LABEL_OPTIONAL },
+    { "{\"role\":\"production\",\"model\":[1,2]}", PM_LABEL_ITEM },
+    { "{\"device\":{\"bus\":\"nvme\"},\"serial\":null}", PM_LABEL_INSTANCES },
+};
+#define NSETS	(sizeof(input) / sizeof(input[0]))
+
+int
+main(int argc, char **argv)
+{
+    pmLabelSet	*sets[NSETS], *merged;
+    pmLabel	*lp;
+    char	buf[PM_MAXLABELJSONLEN];
+    int		i, n, sts, len, save;
+
+    pmSetProgname(argv[0]);
+
+    for (i = 0; i < NSETS; i++) {
+	if ((sts = __pmParseLabelSet(input[i].json, strlen(input[i].json),
+				input[i].flags, &sets[i])) < 0) {
+	    fprintf(stderr, "%s: parse [%d] failed: %s\n",
+			pmGetProgname(), i, pmErrStr(sts));
+	    exit(1);
+	}
+    }
+
+    for (n = 1; n <= NSETS; n++) {
+	if ((len = pmMergeLabelSets(sets, n, buf, sizeof(buf), NULL, NULL)) < 0) {
+	    printf("%d sets: pmMergeLabelSets: %s\n", n, pmErrStr(len));
+	    continue;
+	}
+	if ((sts = __pmMergedLabelSet(sets, n, &merged)) < 0) {
+	    printf("%d sets: __pmMergedLabelSet: %s\n", n, pmErrStr(sts));
+	    continue;
+	}
+	printf("%d sets: %d labels %.*s\n", n, sts, len, buf);
+	if (merged->jsonlen != len || strncmp(merged->json, buf, len) != 0)
+	    printf("  mismatch: %.*s\n", (int)merged->jsonlen, merged->json);
+	for (i = 0; i < merged->nlabels; i++) {
+	    lp = &merged->labels[i];
+	    printf("  %.*s=%.*s%s%s\n",
+			lp->namelen, merged->json + lp->name,
+			lp->valuelen, merged->json + lp->value,
+			(lp->flags & PM_LABEL_COMPOUND) ? " compound" : "",
+			(lp->flags & PM_LABEL_OPTIONAL) ? " optional" : "");
+	}
+	pmFreeLabelSets(merged, 1);
+    }
+
+    /* an empty hierarchy merges to an empty set */
+    save = sets[0]->nlabels;
+    sets[0]->nlabels = -1;
+    if ((sts = __pmMergedLabelSet(sets, 1, &merged)) < 0)
+	printf("empty: %s\n", pmErrStr(sts));
+    else {
+	printf("empty: %d labels\n", merged->nlabels);
+	pmFreeLabelSets(merged, 1);
+    }
+    sets[0]->nlabels = save;
+
+    for (i = 0; i < NSETS; i++)
+	pmFreeLabelSets(sets[i], 1);
+    return 0;
+}
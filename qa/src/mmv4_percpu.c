@@ -0,0 +1,129 @@
+/* C language writer - per-CPU striped counters, MMV v4 */
+/* Build via: cc -g -Wall -lpcp_mmv -lpthread -o mmv4_percpu mmv4_percpu.c */
+
+#include <pcp/pmapi.h>
+#include <pcp/mmv_stats.h>
+#include <pthread.h>
+
+#define NTHREADS	8
+#define NLOOPS		100000
+
+static mmv_instances2_t instances[] = {
+    {  .internal = 0, .external = "handle" },
+    {  .internal = 1, .external = "legacy" },
+};
+
+static mmv_indom2_t indoms[] = {
+    {   .serial = 1,
+        .count = 2,
+        .instances = instances,
+        .shorttext = "update method",
+        .helptext = "Increments via value handles or via pmAtomValue pointers",
+    },
+};
+
+static mmv_metric2_t metrics[] = {
+    {   .name = "u64",
+        .item = 1,
+        .type = MMV_TYPE_U64,
+        .semantics = MMV_SEM_COUNTER,
+        .dimension = MMV_UNITS(0,0,1,0,0,PM_COUNT_ONE),
+        .indom = 1,
+        .shorttext = "64-bit unsigned counter",
+    },
+    {   .name = "i32",
+        .item = 2,
+        .type = MMV_TYPE_I32,
+        .semantics = MMV_SEM_COUNTER,
+        .dimension = MMV_UNITS(0,0,1,0,0,PM_COUNT_ONE),
+        .shorttext = "32-bit signed counter",
+    },
+    {   .name = "double",
+        .item = 3,
+        .type = MMV_TYPE_DOUBLE,
+        .semantics = MMV_SEM_COUNTER,
+        .dimension = MMV_UNITS(0,0,0,0,0,0),
+        .shorttext = "double precision counter",
+    },
+    {   .name = "instant",
+        .item = 4,
+        .type = MMV_TYPE_U32,
+        .semantics = MMV_SEM_INSTANT,
+        .dimension = MMV_UNITS(0,0,0,0,0,0),
+        .shorttext = "set after increments, discarding stripes",
+    },
+};
+
+static void		*map;
+static pmAtomValue	*legacy;
+static mmv_value_handle_t handles[4];
+
+static void *
+worker(void *arg)
+{
+    pmAtomValue		inc = { .ull = 2 };
+    int			i;
+
+    (void)arg;
+    for (i = 0; i < NLOOPS; i++) {
+	mmv_handle_inc(&handles[0]);
+	mmv_inc(map, legacy);
+	mmv_handle_inc_atomvalue(&handles[0], &inc);
+	mmv_handle_inc_value(&handles[1], -1);
+	mmv_handle_inc_value(&handles[2], 0.5);
+	mmv_handle_inc(&handles[3]);
+    }
+    return NULL;
+}
+
+int
+main(int argc, char **argv)
+{
+    int			i;
+    pthread_t		threads[NTHREADS];
+    pmAtomValue		*value;
+    char		*file = (argc > 1) ? argv[1] : "percpu";
+    mmv_registry_t	*registry = mmv_stats_registry(file, 444, MMV_FLAG_PERCPU);
+
+    if (!registry) {
+	fprintf(stderr, "mmv_stats_registry: %s - %s\n", file, strerror(errno));
+	return 1;
+    }
+
+    mmv_stats_add_indom(registry, indoms[0].serial,
+			indoms[0].shorttext, indoms[0].helptext);
+    for (i = 0; i < indoms[0].count; i++)
+	mmv_stats_add_instance(registry, indoms[0].serial,
+			instances[i].internal, instances[i].external);
+    for (i = 0; i < sizeof(metrics) / sizeof(mmv_metric2_t); i++)
+	mmv_stats_add_metric(registry,
+			 metrics[i].name, metrics[i].item, metrics[i].type,
+			 metrics[i].semantics, metrics[i].dimension,
+			 metrics[i].indom, metrics[i].shorttext, NULL);
+
+    map = mmv_stats_start(registry);
+    if (!map) {
+	fprintf(stderr, "mmv_stats_start: %s - %s\n", file, strerror(errno));
+	return 1;
+    }
+
+    value = mmv_lookup_value_desc(map, "u64", "handle");
+    mmv_lookup_value_handle(map, value, &handles[0]);
+    legacy = mmv_lookup_value_desc(map, "u64", "legacy");
+    value = mmv_lookup_value_desc(map, "i32", NULL);
+    mmv_lookup_value_handle(map, value, &handles[1]);
+    value = mmv_lookup_value_desc(map, "double", NULL);
+    mmv_lookup_value_handle(map, value, &handles[2]);
+    value = mmv_lookup_value_desc(map, "instant", NULL);
+    mmv_lookup_value_handle(map, value, &handles[3]);
+
+    for (i = 0; i < NTHREADS; i++)
+	pthread_create(&threads[i], NULL, worker, NULL);
+    for (i = 0; i < NTHREADS; i++)
+	pthread_join(threads[i], NULL);
+
+    mmv_set_value(map, handles[3].value, 42);
+
+    mmv_stats_free(registry);
+    return 0;
+}
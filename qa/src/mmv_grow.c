@@ -0,0 +1,98 @@
+/* C language writer - instances appended after the mapping is created */
+/* Build via: cc -g -Wall -lpcp_mmv -o mmv_grow mmv_grow.c */
+
+#include <pcp/pmapi.h>
+#include <pcp/mmv_stats.h>
+#include <signal.h>
+
+static const char *names[] = { "zero", "one", "two", "three" };
+static pmUnits none = MMV_UNITS(0,0,0,0,0,0);
+static pmUnits count = MMV_UNITS(0,0,1,0,0,PM_COUNT_ONE);
+
+static volatile sig_atomic_t steps;
+
+static void
+onsignal(int sig)
+{
+    (void)sig;
+    steps++;
+}
+
+static void
+update(void *map, int inst)
+{
+    pmAtomValue	*value;
+
+    value = mmv_lookup_value_desc(map, "count", names[inst]);
+    mmv_set_value(map, value, 10 * (inst + 1));
+    value = mmv_lookup_value_desc(map, "label", names[inst]);
+    mmv_set_string(map, value, names[inst], strlen(names[inst]));
+    value = mmv_lookup_value_desc(map, "total", NULL);
+    mmv_inc(map, value);
+}
+
+static void
+append(mmv_registry_t *registry, int inst)
+{
+    if (mmv_stats_append_instance(registry, 1, inst, names[inst]) < 0)
+	printf("append %s: %s\n", names[inst], strerror(errno));
+    else
+	printf("append %s: ok\n", names[inst]);
+    fflush(stdout);
+}
+
+int
+main(int argc, char **argv)
+{
+    int			i, seen = 0;
+    void		*map;
+    char		*file = (argc > 1) ? argv[1] : "grow";
+    mmv_registry_t	*registry = mmv_stats_registry(file, 445, 0);
+    sigset_t		mask, prev;
+
+    if (!registry) {
+	fprintf(stderr, "mmv_stats_registry: %s - %s\n", file, strerror(errno));
+	return 1;
+    }
+
+    mmv_stats_add_indom(registry, 1, "growing indom", NULL);
+    mmv_stats_add_instance(registry, 1, 0, names[0]);
+    if (mmv_stats_reserve_instances(registry, 1, 2) < 0) {
+	fprintf(stderr, "mmv_stats_reserve_instances: %s\n", strerror(errno));
+	return 1;
+    }
+    mmv_stats_add_metric(registry, "count", 1, MMV_TYPE_U32, MMV_SEM_INSTANT,
+			none, 1, "per-instance value", NULL);
+    mmv_stats_add_metric(registry, "label", 2, MMV_TYPE_STRING, MMV_SEM_INSTANT,
+			none, 1, "per-instance string", NULL);
+    mmv_stats_add_metric(registry, "total", 3, MMV_TYPE_U64, MMV_SEM_COUNTER,
+			count, 0, "instances", NULL);
+
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGUSR1);
+    sigprocmask(SIG_BLOCK, &mask, &prev);
+    signal(SIGUSR1, onsignal);
+
+    if ((map = mmv_stats_start(registry)) == NULL) {
+	fprintf(stderr, "mmv_stats_start: %s - %s\n", file, strerror(errno));
+	return 1;
+    }
+    update(map, 0);
+
+    /* each SIGUSR1 appends the next instance, the last one just exits */
+    for (i = 1; i <= 3; i++) {
+	while (seen == steps)
+	    sigsuspend(&prev);
+	seen++;
+	append(registry, i);
+	if (i == 1)
+	    append(registry, i);	/* duplicate, should fail */
+	if (i < 3)
+	    update(map, i);
+    }
+    while (seen == steps)
+	sigsuspend(&prev);
+
+    mmv_stats_free(registry);
+    return 0;
+}
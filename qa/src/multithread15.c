@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * exercise lock-free context handle lookup in __pmHandleToPtr() while
+ * other threads create and destroy contexts
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pcp/pmapi.h>
+#include <pthread.h>
+#include "libpcp.h"
+
+#ifndef HAVE_PTHREAD_BARRIER_T
+#include "pthread_barrier.h"
+#endif
+
+#define NTHREAD	4
+
+static pthread_barrier_t barrier;
+static char	*archive;
+static int	iter = 200;
+static int	handles[NTHREAD];	/* most recent handle for each thread */
+
+static struct {
+    int		found;		/* handle resolved to its own context */
+    int		gone;		/* handle destroyed before the lookup */
+    int		wrong;		/* handle resolved to some other context */
+} result[NTHREAD];
+
+static void *
+func(void *arg)
+{
+    int		iam = *((int *)arg);
+    int		i, j, k, h, sts;
+    __pmContext	*ctxp;
+
+    pthread_barrier_wait(&barrier);
+
+    for (i = 0; i < iter; i++) {
+	if ((sts = pmNewContext(PM_CONTEXT_ARCHIVE, archive)) < 0) {
+	    fprintf(stderr, "[tid %d] pmNewContext(%s): %s\n",
+			iam, archive, pmErrStr(sts));
+	    pthread_exit("botch");
+	}
+	__atomic_store_n(&handles[iam], sts, __ATOMIC_RELEASE);
+
+	for (k = 0; k < 100; k++) {
+	    /* our own handle must always resolve */
+	    if ((ctxp = __pmHandleToPtr(sts)) == NULL) {
+		fprintf(stderr, "[tid %d] __pmHandleToPtr(%d) failed\n", iam, sts);
+		pthread_exit("botch");
+	    }
+	    if (ctxp->c_handle != sts || ctxp->c_type != PM_CONTEXT_ARCHIVE)
+		result[iam].wrong++;
+	    PM_UNLOCK(ctxp->c_lock);
+
+	    /* other threads' handles may come and go underneath us */
+	    for (j = 0; j < NTHREAD; j++) {
+		if (j == iam)
+		    continue;
+		h = __atomic_load_n(&handles[j], __ATOMIC_ACQUIRE);
+		if (h < 0)
+		    continue;
+		if ((ctxp = __pmHandleToPtr(h)) == NULL)
+		    result[iam].gone++;
+		else {
+		    if (ctxp->c_handle == h && ctxp->c_type == PM_CONTEXT_ARCHIVE)
+			result[iam].found++;
+		    else
+			result[iam].wrong++;
+		    PM_UNLOCK(ctxp->c_lock);
+		}
+	    }
+	}
+
+	__atomic_store_n(&handles[iam], -1, __ATOMIC_RELEASE);
+	if ((sts = pmDestroyContext(sts)) < 0) {
+	    fprintf(stderr, "[tid %d] pmDestroyContext: %s\n", iam, pmErrStr(sts));
+	    pthread_exit("botch");
+	}
+    }
+    pthread_exit(NULL);
+}
+
+int
+main(int argc, char **argv)
+{
+    pthread_t	tid[NTHREAD];
+    int		id[NTHREAD];
+    int		i, sts;
+    int		errflag = 0;
+    char	*msg;
+
+    pmSetProgname(argv[0]);
+
+    while ((i = getopt(argc, argv, "D:i:")) != EOF) {
+	switch (i) {
+	case 'D':
+	    if ((sts = pmSetDebug(optarg)) < 0) {
+		fprintf(stderr, "%s: unrecognized debug options specification (%s)\n",
+		    pmGetProgname(), optarg);
+		errflag++;
+	    }
+	    break;
+	case 'i':
+	    iter = atoi(optarg);
+	    break;
+	default:
+	    errflag++;
+	}
+    }
+    if (errflag || optind != argc-1) {
+	fprintf(stderr, "Usage: %s [-D debug] [-i iter] archive\n", pmGetProgname());
+	exit(1);
+    }
+    archive = argv[optind];
+
+    sts = pthread_barrier_init(&barrier, NULL, NTHREAD);
+    if (sts != 0) {
+	printf("pthread_barrier_init: sts=%d\n", sts);
+	exit(1);
+    }
+
+    for (i = 0; i < NTHREAD; i++) {
+	handles[i] = -1;
+	id[i] = i;
+    }
+    for (i = 0; i < NTHREAD; i++) {
+	if ((sts = pthread_create(&tid[i], NULL, func, &id[i])) != 0) {
+	    printf("pthread_create: tid[%d]: sts=%d\n", i, sts);
+	    exit(1);
+	}
+    }
+
+    for (i = 0; i < NTHREAD; i++) {
+	pthread_join(tid[i], (void *)&msg);
+	if (msg != NULL)
+	    printf("tid[%d]: %s\n", i, msg);
+	if (pmDebugOptions.appl0)
+	    fprintf(stderr, "tid[%d]: found %d gone %d\n",
+			i, result[i].found, result[i].gone);
+	if (result[i].wrong)
+	    printf("tid[%d]: %d lookups returned the wrong context\n",
+			i, result[i].wrong);
+    }
+
+    printf("%d threads x %d contexts done\n", NTHREAD, iter);
+    return 0;
+}
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2014,2019 Red Hat.
+ * Copyright (c) 2014,2019,2026 Red Hat.
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms of the GNU General Public License as published by the
@@ -243,6 +243,37 @@ nvmlDeviceGetUtilizationRates(nvmlDevice_t device, nvmlUtilization_t *util)
     return NVML_SUCCESS;
 }
 
+int
+nvmlDeviceGetSamples(nvmlDevice_t device, nvmlSamplingType_t type,
+		unsigned long long lastseen, nvmlValueType_t *valtype,
+		unsigned int *count, nvmlSample_t *samples)
+{
+    struct gputab *dev = (struct gputab *)device;
+    static unsigned long long timestamp;
+
+    if (pmDebugOptions.appl0)
+	fprintf(stderr, "qa-nvidia-ml: nvmlDeviceGetSamples\n");
+    CHECK_DEVICE(dev);
+    if (type != NVML_GPU_UTILIZATION_SAMPLES &&
+	type != NVML_MEMORY_UTILIZATION_SAMPLES)
+	return NVML_ERROR_NOT_SUPPORTED;
+    *valtype = NVML_VALUE_TYPE_UNSIGNED_INT;
+    if (samples == NULL) {
+	*count = 1;
+	return NVML_SUCCESS;
+    }
+    if (*count < 1)
+	return NVML_ERROR_INSUFFICIENT_SIZE;
+    /* one sample per call, always newer than any seen before */
+    samples[0].timeStamp = ++timestamp + lastseen;
+    if (type == NVML_GPU_UTILIZATION_SAMPLES)
+	samples[0].sampleValue.uiVal = dev->util.gpu;
+    else
+	samples[0].sampleValue.uiVal = dev->util.memory;
+    *count = 1;
+    return NVML_SUCCESS;
+}
+
 int
 nvmlDeviceGetMemoryInfo(nvmlDevice_t device, nvmlMemory_t *mem)
 {
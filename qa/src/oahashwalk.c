@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * Exercise libpcp open-addressing hash interfaces
+ */
+
+#include <pcp/pmapi.h>
+#include "libpcp.h"
+
+void
+dumpnode(unsigned int key, __int64_t data)
+{
+    printf("%u => %" FMT_INT64 "\n", key, data);
+}
+
+__pmHashWalkState
+walker(const __pmOAHashNode *n, void *v)
+{
+    __pmHashWalkState state = (__pmHashWalkState)v;
+    dumpnode(n->key, (__int64_t)((__psint_t)n->data));
+    return state;
+}
+
+void
+iterate(__pmOAHashCtl *h)
+{
+    __pmOAHashNode *n;
+
+    for (n = __pmOAHashWalk(h, PM_HASH_WALK_START);
+         n != NULL;
+         n = __pmOAHashWalk(h, PM_HASH_WALK_NEXT)) {
+	dumpnode(n->key, (__int64_t)((__psint_t)n->data));
+    }
+}
+
+/*
+ * Grow to many entries, delete every other one, then check that
+ * lookups and insertion-ordered iteration still agree.
+ */
+int
+stress(int count)
+{
+    __pmOAHashCtl	hc;
+    __pmOAHashNode	*n;
+    unsigned int	key, last = 0;
+    int			i, errors = 0;
+
+    __pmOAHashInit(&hc);
+    for (i = 0; i < count; i++) {
+	key = (unsigned int)i * 7919;
+	if (__pmOAHashAdd(key, (void *)(__psint_t)i, &hc) < 0)
+	    errors++;
+    }
+    for (i = 0; i < count; i += 2) {
+	key = (unsigned int)i * 7919;
+	if (__pmOAHashDel(key, (void *)(__psint_t)i, &hc) != 1)
+	    errors++;
+    }
+    /* reinsertion forces reclaim of the deleted entries */
+    for (i = count; i < count + count / 2; i++) {
+	key = (unsigned int)i * 7919;
+	if (__pmOAHashAdd(key, (void *)(__psint_t)i, &hc) < 0)
+	    errors++;
+    }
+    for (i = 0; i < count + count / 2; i++) {
+	key = (unsigned int)i * 7919;
+	n = __pmOAHashSearch(key, &hc);
+	if ((i < count && (i % 2) == 0) ? (n != NULL) :
+	    (n == NULL || n->data != (void *)(__psint_t)i))
+	    errors++;
+    }
+    for (i = 0, n = __pmOAHashWalk(&hc, PM_HASH_WALK_START);
+	 n != NULL;
+	 i++, n = __pmOAHashWalk(&hc, PM_HASH_WALK_NEXT)) {
+	if (i > 0 && (__psint_t)n->data <= (__psint_t)last)
+	    errors++;
+	last = (__psint_t)n->data;
+    }
+    printf("stress: %d entries, %d walked, %d errors\n", hc.nodes, i, errors);
+    __pmOAHashClear(&hc);
+    return errors;
+}
+
+int
+main(int argc, char **argv)
+{
+    __pmOAHashCtl hc;
+
+    __pmOAHashInit(&hc);
+    printf("adding entries\n");
+    __pmOAHashAdd(3, (void *)3L, &hc);
+    __pmOAHashAdd(0, (void *)0L, &hc);
+    __pmOAHashAdd(2, (void *)2L, &hc);
+    __pmOAHashAdd(1, (void *)1L, &hc);
+
+    if (argc >= 2) {
+        if (strcmp(argv[1], "callback") == 0)
+            __pmOAHashWalkCB(walker, (void *)PM_HASH_WALK_NEXT, &hc);
+        else if (strcmp(argv[1], "linked") == 0)
+            iterate(&hc);
+        else if (strcmp(argv[1], "stress") == 0)
+            exit(stress(100000) != 0);
+        exit(0);
+    }
+
+    printf("iterating WALK_STOP\n");
+    __pmOAHashWalkCB(walker, (void *)PM_HASH_WALK_STOP, &hc);
+    printf("iterating WALK_NEXT\n");
+    __pmOAHashWalkCB(walker, (void *)PM_HASH_WALK_NEXT, &hc);
+    printf("iterating WALK_DELETE_STOP\n");
+    __pmOAHashWalkCB(walker, (void *)PM_HASH_WALK_DELETE_STOP, &hc);
+    printf("iterating WALK_NEXT\n");
+    __pmOAHashWalkCB(walker, (void *)PM_HASH_WALK_NEXT, &hc);
+    printf("iterating WALK_DELETE_NEXT\n");
+    __pmOAHashWalkCB(walker, (void *)PM_HASH_WALK_DELETE_NEXT, &hc);
+    printf("iterating WALK_NEXT\n");
+    __pmOAHashWalkCB(walker, (void *)PM_HASH_WALK_NEXT, &hc);
+
+    exit(0);
+}
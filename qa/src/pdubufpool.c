@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ */
+
+#include <pcp/pmapi.h>
+#include "libpcp.h"
+#include <assert.h>
+#include "localconfig.h"
+
+/*
+ * Exercise the PDU buffer pool: reuse through the size class free
+ * lists, pin and unpin via addresses inside a buffer, rejection of
+ * addresses that are not in any pdubuf, and unpooled large buffers.
+ */
+
+static int sizes[] = { 4, 100, 512, 513, 1024, 4000, 65536, 65537, 300000 };
+
+int
+main(int argc, char **argv)
+{
+    char	*buf, *again, *mid;
+    char	local[64];
+    char	*heap;
+    int		alloced, nfree;
+    int		i;
+
+    for (i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++) {
+	printf("pdubuf size %d\n", sizes[i]);
+	buf = (char *)__pmFindPDUBuf(sizes[i]);
+	assert(buf != NULL);
+	memset(buf, 0xaa, sizes[i]);
+
+	/* pin via an address part way into the buffer */
+	mid = buf + ((sizes[i] / 2) & ~(sizeof(int)-1));
+	__pmPinPDUBuf(mid);
+	__pmCountPDUBuf(sizes[i], &alloced, &nfree);
+	printf("  pinned: alloc %d\n", alloced);
+	printf("  unpin mid -> %d\n", __pmUnpinPDUBuf(mid));
+	printf("  unpin buf -> %d\n", __pmUnpinPDUBuf(buf));
+	printf("  unpin buf again -> %d\n", __pmUnpinPDUBuf(buf));
+	__pmCountPDUBuf(sizes[i], &alloced, &nfree);
+	printf("  unpinned: alloc %d\n", alloced);
+
+	/* same size again, pooled sizes should recycle the buffer */
+	again = (char *)__pmFindPDUBuf(sizes[i]);
+	assert(again != NULL);
+	if (sizes[i] <= 65536)
+	    printf("  recycled: %s\n", again == buf ? "yes" : "no");
+	printf("  unpin again -> %d\n", __pmUnpinPDUBuf(again));
+    }
+
+    /* addresses that are not PDU buffers are rejected */
+    heap = (char *)malloc(1024);
+    printf("unpin stack -> %d\n", __pmUnpinPDUBuf((void *)local));
+    printf("unpin heap -> %d\n", __pmUnpinPDUBuf((void *)heap));
+    free(heap);
+
+    __pmCountPDUBuf(0, &alloced, &nfree);
+    printf("final: alloc %d\n", alloced);
+    fflush(stdout);
+    __pmFindPDUBuf(-1);		/* report, expect no pinned buffers */
+
+    return 0;
+}
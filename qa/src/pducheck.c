@@ -843,6 +843,12 @@ _z(void)
 		    if (profp->profile == NULL)
 			fprintf(stderr, "Botch: Profile: profp->profile is NULL!\n");
 		    else {
+			/* decoded profiles are sorted by indom */
+			if (idp[0].indom > idp[1].indom) {
+			    pmInDomProfile	tmp = idp[0];
+			    idp[0] = idp[1];
+			    idp[1] = tmp;
+			}
 			for (i = 0; i < curprof.profile_len; i++) {
 			    if (profp->profile[i].indom != curprof.profile[i].indom)
 				fprintf(stderr, "Botch: Profile: [%d]indom: got: 0x%x expect: 0x%x\n",
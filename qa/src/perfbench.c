@@ -0,0 +1,738 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * Micro-benchmarks for libpcp hot paths, reporting operations per
+ * second and heap allocations per operation.
+ *
+ * Each benchmark is calibrated so one run takes about -t milliseconds,
+ * then run -r times and the median reported, so results are stable
+ * enough to compare across builds:
+ *
+ *	$ perfbench >before
+ *	... rebuild libpcp ...
+ *	$ perfbench -c before
+ *
+ * Fixtures are synthetic: a PDU built in memory for the decode path,
+ * an archive written with libpcp_import for the archive paths, and a
+ * local context with the sample PMDA DSO for the PMDA paths (skipped
+ * if the DSO cannot be loaded; names come from the default PMNS, so
+ * set $PMNS_DEFAULT when running from a build tree).
+ */
+
+#include <pcp/pmapi.h>
+#include <pcp/import.h>
+#include "libpcp.h"
+
+#define MAXRUNS		25
+
+/*
+ * Count heap allocations by interposing on the glibc allocator, so
+ * libpcp's own calls are seen too.
+ */
+#ifdef __GLIBC__
+extern void *__libc_malloc(size_t);
+extern void *__libc_calloc(size_t, size_t);
+extern void *__libc_realloc(void *, size_t);
+
+static unsigned long	nalloc;
+
+void *
+malloc(size_t size)
+{
+    __atomic_add_fetch(&nalloc, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+void *
+calloc(size_t nmemb, size_t size)
+{
+    __atomic_add_fetch(&nalloc, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(nmemb, size);
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+    __atomic_add_fetch(&nalloc, 1, __ATOMIC_RELAXED);
+    return __libc_realloc(ptr, size);
+}
+
+#define ALLOCS()	__atomic_load_n(&nalloc, __ATOMIC_RELAXED)
+#define HAVE_ALLOCS	1
+#else
+#define ALLOCS()	0
+#define HAVE_ALLOCS	0
+#endif
+
+typedef struct {
+    const char	*name;
+    const char	*desc;
+    int		(*setup)(void);		/* < 0 => skip this benchmark */
+    void	(*run)(long);		/* perform this many operations */
+    void	(*teardown)(void);
+} bench_t;
+
+static int	verbose;
+static char	*archive;		/* -a, else a synthetic one */
+static char	*pmdadso;		/* -P, else the installed sample PMDA */
+static char	tmpdir[MAXPATHLEN];
+
+/*
+ * Synthetic archive: NMETRIC metrics, every second one with NINST
+ * instances, NRECORD records one second apart.
+ */
+#define NMETRIC		40
+#define NINST		16
+#define NRECORD		600
+
+static char	*names[NMETRIC];
+static pmID	pmids[NMETRIC];
+
+static void
+fail(const char *what, int sts)
+{
+    fprintf(stderr, "%s: %s: %s\n", pmGetProgname(), what, pmErrStr(sts));
+    exit(1);
+}
+
+static void
+make_names(void)
+{
+    char	buf[64];
+    int		m;
+
+    for (m = 0; m < NMETRIC; m++) {
+	pmsprintf(buf, sizeof(buf), "bench.group%d.%s%d",
+		m % 4, (m & 1) ? "inst" : "value", m);
+	names[m] = strdup(buf);
+    }
+}
+
+static void
+make_archive(void)
+{
+    struct timespec	*stamps;
+    pmAtomValue		*values;
+    int			*handles;
+    char		base[MAXPATHLEN];
+    char		inst[16];
+    int			m, i, h, s, n, sts;
+
+    pmsprintf(tmpdir, sizeof(tmpdir), "%s/perfbench-XXXXXX", pmGetConfig("PCP_TMP_DIR"));
+    if (mkdtemp(tmpdir) == NULL) {
+	pmsprintf(tmpdir, sizeof(tmpdir), "/tmp/perfbench-XXXXXX");
+	if (mkdtemp(tmpdir) == NULL)
+	    fail("mkdtemp", -oserror());
+    }
+    pmsprintf(base, sizeof(base), "%s/synthetic", tmpdir);
+    archive = strdup(base);
+
+    if ((sts = pmiStart(archive, 0)) < 0)
+	fail("pmiStart", sts);
+    pmiSetHostname("perfbench.example.com");
+    pmiSetTimezone("UTC");
+    for (i = 0; i < NINST; i++) {
+	pmsprintf(inst, sizeof(inst), "inst%02d", i);
+	if ((sts = pmiAddInstance(pmiInDom(245, 1), inst, i)) < 0)
+	    fail("pmiAddInstance", sts);
+    }
+    n = 0;
+    for (m = 0; m < NMETRIC; m++) {
+	sts = pmiAddMetric(names[m], pmiID(245, m % 4, m),
+		(m & 1) ? PM_TYPE_DOUBLE : PM_TYPE_U64,
+		(m & 1) ? pmiInDom(245, 1) : PM_INDOM_NULL,
+		(m & 1) ? PM_SEM_INSTANT : PM_SEM_COUNTER,
+		pmiUnits(0, 0, 1, 0, 0, PM_COUNT_ONE));
+	if (sts < 0)
+	    fail("pmiAddMetric", sts);
+	n += (m & 1) ? NINST : 1;
+    }
+
+    handles = (int *)malloc(n * sizeof(int));
+    stamps = (struct timespec *)malloc(NRECORD * sizeof(*stamps));
+    values = (pmAtomValue *)malloc(NRECORD * n * sizeof(*values));
+    if (handles == NULL || stamps == NULL || values == NULL)
+	fail("make_archive", -ENOMEM);
+    for (h = m = 0; m < NMETRIC; m++) {
+	if ((m & 1) == 0) {
+	    if ((handles[h++] = pmiGetHandle(names[m], NULL)) < 0)
+		fail("pmiGetHandle", handles[h-1]);
+	    continue;
+	}
+	for (i = 0; i < NINST; i++) {
+	    pmsprintf(inst, sizeof(inst), "inst%02d", i);
+	    if ((handles[h++] = pmiGetHandle(names[m], inst)) < 0)
+		fail("pmiGetHandle", handles[h-1]);
+	}
+    }
+    for (s = 0; s < NRECORD; s++) {
+	stamps[s].tv_sec = 1700000000 + s;
+	stamps[s].tv_nsec = 0;
+	for (h = m = 0; m < NMETRIC; m++) {
+	    if ((m & 1) == 0) {
+		values[s * n + h++].ull = (__uint64_t)s * 1000 + m;
+		continue;
+	    }
+	    for (i = 0; i < NINST; i++)
+		values[s * n + h++].d = s * 0.5 + i;
+	}
+    }
+    if ((sts = pmiPutAtomValues(n, handles, NRECORD, stamps, values)) < 0)
+	fail("pmiPutAtomValues", sts);
+    if ((sts = pmiEnd()) < 0)
+	fail("pmiEnd", sts);
+
+    free(handles);
+    free(stamps);
+    free(values);
+}
+
+static void
+remove_archive(void)
+{
+    char	path[MAXPATHLEN];
+    static char	*suffix[] = { "0", "meta", "index" };
+    int		i;
+
+    if (tmpdir[0] == '\0')
+	return;
+    for (i = 0; i < sizeof(suffix) / sizeof(suffix[0]); i++) {
+	pmsprintf(path, sizeof(path), "%s.%s", archive, suffix[i]);
+	unlink(path);
+    }
+    rmdir(tmpdir);
+}
+
+/*
+ * decode.result: __pmDecodeResult of a PDU with NMETRIC metrics,
+ * mixing insitu and pointer values, copied into a fresh buffer
+ * each time as it would be when read off the wire.
+ */
+static __pmPDU	*encoded;
+static __pmPDU	*scratch;
+static int	encodedlen;
+
+static int
+decode_setup(void)
+{
+    __pmResult	*rp;
+    pmValueSet	*vsp;
+    pmAtomValue	atom;
+    int		m, i, n, sts;
+
+    if ((rp = __pmAllocResult(NMETRIC)) == NULL)
+	return -ENOMEM;
+    rp->numpmid = NMETRIC;
+    rp->timestamp.sec = 1700000000;
+    rp->timestamp.nsec = 0;
+    for (m = 0; m < NMETRIC; m++) {
+	n = (m & 1) ? NINST : 1;
+	vsp = (pmValueSet *)malloc(sizeof(pmValueSet) + (n-1)*sizeof(pmValue));
+	if (vsp == NULL)
+	    return -ENOMEM;
+	vsp->pmid = pmID_build(245, m % 4, m);
+	vsp->numval = n;
+	for (i = 0; i < n; i++) {
+	    vsp->vlist[i].inst = (n == 1) ? PM_IN_NULL : i;
+	    if (m % 3 == 0) {
+		atom.ul = m * 100 + i;
+		vsp->valfmt = __pmStuffValue(&atom, &vsp->vlist[i], PM_TYPE_U32);
+	    }
+	    else {
+		atom.ull = (__uint64_t)m * 100000 + i;
+		vsp->valfmt = __pmStuffValue(&atom, &vsp->vlist[i], PM_TYPE_U64);
+	    }
+	}
+	rp->vset[m] = vsp;
+    }
+    sts = __pmEncodeResult(NULL, rp, &encoded);
+    __pmFreeResult(rp);
+    if (sts < 0)
+	return sts;
+    encodedlen = ((__pmPDUHdr *)encoded)->len;
+    if ((scratch = __pmFindPDUBuf(encodedlen)) == NULL)
+	return -ENOMEM;
+    return 0;
+}
+
+static void
+decode_run(long n)
+{
+    __pmResult	*rp;
+    int		sts;
+
+    while (n-- > 0) {
+	memcpy(scratch, encoded, encodedlen);
+	if ((sts = __pmDecodeResult(scratch, &rp)) < 0)
+	    fail("__pmDecodeResult", sts);
+	__pmFreeResult(rp);
+    }
+}
+
+static void
+decode_teardown(void)
+{
+    __pmUnpinPDUBuf(encoded);
+    __pmUnpinPDUBuf(scratch);
+}
+
+/*
+ * hash.search: hits in a __pmHashCtl of NHASH entries.
+ */
+#define NHASH	10000
+static __pmHashCtl	hashctl;
+
+static int
+hash_setup(void)
+{
+    unsigned int	i;
+    int			sts;
+
+    __pmHashInit(&hashctl);
+    for (i = 0; i < NHASH; i++) {
+	if ((sts = __pmHashAdd(i * 2654435761U, NULL, &hashctl)) < 0)
+	    return sts;
+    }
+    return 0;
+}
+
+static void
+hash_run(long n)
+{
+    static unsigned int	i;
+
+    while (n-- > 0) {
+	if (__pmHashSearch((i % NHASH) * 2654435761U, &hashctl) == NULL)
+	    fail("__pmHashSearch", PM_ERR_NOTCONN);
+	i++;
+    }
+}
+
+static void
+hash_teardown(void)
+{
+    __pmHashClear(&hashctl);
+}
+
+/*
+ * labels.merge: pmMergeLabelSets over a context..instance hierarchy.
+ */
+static const struct {
+    const char	*json;
+    int		flags;
+} labelinput[] = {
+    { "{\"hostname\":\"bench.example.com\",\"agent\":\"none\",\"groupid\":1000}", PM_LABEL_CONTEXT },
+    { "{\"agent\":\"sample\",\"role\":\"testing\"}", PM_LABEL_DOMAIN },
+    { "{\"device\":{\"type\":\"disk\",\"bus\":\"scsi\"}}", PM_LABEL_INDOM },
+    { "{\"units\":\"bytes\"}", PM_LABEL_CLUSTER|PM_LABEL_OPTIONAL },
+    { "{\"role\":\"production\",\"model\":[1,2]}", PM_LABEL_ITEM },
+    { "{\"device\":{\"bus\":\"nvme\"},\"serial\":\"XYZ123\"}", PM_LABEL_INSTANCES },
+};
+#define NLABELSETS	(sizeof(labelinput) / sizeof(labelinput[0]))
+static pmLabelSet	*labelsets[NLABELSETS];
+
+static int
+labels_setup(void)
+{
+    int		i, sts;
+
+    for (i = 0; i < NLABELSETS; i++) {
+	if ((sts = __pmParseLabelSet(labelinput[i].json,
+			strlen(labelinput[i].json), labelinput[i].flags,
+			&labelsets[i])) < 0)
+	    return sts;
+    }
+    return 0;
+}
+
+static void
+labels_run(long n)
+{
+    char	buf[PM_MAXLABELJSONLEN];
+    int		sts;
+
+    while (n-- > 0) {
+	if ((sts = pmMergeLabelSets(labelsets, NLABELSETS, buf, sizeof(buf),
+			NULL, NULL)) < 0)
+	    fail("pmMergeLabelSets", sts);
+    }
+}
+
+static void
+labels_teardown(void)
+{
+    int		i;
+
+    for (i = 0; i < NLABELSETS; i++)
+	pmFreeLabelSets(labelsets[i], 1);
+}
+
+/*
+ * archive.lookup and archive.interp: pmLookupName against the archive
+ * PMNS, and pmFetch in interpolation mode (__pmLogFetchInterp) stepping
+ * at half the archive sampling interval, rewinding at the end.
+ */
+static int		archctx = -1;
+static struct timespec	archstart;
+
+static int
+archive_setup(void)
+{
+    pmHighResLogLabel	label;
+    int			sts;
+
+    if (archctx >= 0)
+	return pmUseContext(archctx);
+    if ((sts = pmNewContext(PM_CONTEXT_ARCHIVE, archive)) < 0)
+	return sts;
+    archctx = sts;
+    if ((sts = pmGetHighResArchiveLabel(&label)) < 0)
+	return sts;
+    archstart = label.start;
+    return pmLookupName(NMETRIC, (const char **)names, pmids);
+}
+
+static void
+lookup_run(long n)
+{
+    static int	i;
+    pmID	pmid;
+    int		sts;
+
+    while (n-- > 0) {
+	if ((sts = pmLookupName(1, (const char **)&names[i % NMETRIC], &pmid)) < 0)
+	    fail("pmLookupName", sts);
+	i++;
+    }
+}
+
+static int
+interp_setup(void)
+{
+    struct timespec	delta = { 0, 500000000 };
+    int			sts;
+
+    if ((sts = archive_setup()) < 0)
+	return sts;
+    return pmSetModeHighRes(PM_MODE_INTERP, &archstart, &delta);
+}
+
+static void
+interp_run(long n)
+{
+    pmResult	*rp;
+    int		sts;
+
+    while (n-- > 0) {
+	if ((sts = pmFetch(NMETRIC, pmids, &rp)) == PM_ERR_EOL) {
+	    if ((sts = interp_setup()) < 0)
+		fail("pmSetModeHighRes", sts);
+	    sts = pmFetch(NMETRIC, pmids, &rp);
+	}
+	if (sts < 0)
+	    fail("pmFetch", sts);
+	pmFreeResult(rp);
+    }
+}
+
+/*
+ * local.lookup and local.fetch: a PM_CONTEXT_LOCAL context with the
+ * sample PMDA loaded as a DSO.
+ */
+static const char	*samplenames[] = {
+    "sample.long.one", "sample.ulonglong.hundred", "sample.double.bin",
+    "sample.string.hullo", "sample.bin", "sample.colour",
+    "sample.longlong.million", "sample.float.ten",
+};
+#define NSAMPLE		(sizeof(samplenames) / sizeof(samplenames[0]))
+static pmID		samplepmids[NSAMPLE];
+static int		localctx = -1;
+
+static int
+local_setup(void)
+{
+    char	spec[MAXPATHLEN+64];
+    char	*msg;
+    int		sts;
+
+    if (localctx >= 0)
+	return pmUseContext(localctx);
+    if (pmdadso == NULL) {
+	pmsprintf(spec, sizeof(spec), "%s/sample/pmda_sample.%s",
+		pmGetConfig("PCP_PMDAS_DIR"), pmGetConfig("PCP_SHARED_SUFFIX"));
+	pmdadso = strdup(spec);
+    }
+    if (access(pmdadso, R_OK) < 0)
+	return -oserror();
+    pmSpecLocalPMDA("clear");
+    pmsprintf(spec, sizeof(spec), "add,29,%s,sample_init", pmdadso);
+    if ((msg = pmSpecLocalPMDA(spec)) != NULL) {
+	if (verbose)
+	    fprintf(stderr, "pmSpecLocalPMDA: %s\n", msg);
+	return PM_ERR_NOAGENT;
+    }
+    if ((sts = pmNewContext(PM_CONTEXT_LOCAL, NULL)) < 0)
+	return sts;
+    localctx = sts;
+    if ((sts = pmLookupName(NSAMPLE, samplenames, samplepmids)) != NSAMPLE)
+	return sts < 0 ? sts : PM_ERR_NAME;
+    return 0;
+}
+
+static void
+local_lookup_run(long n)
+{
+    static int	i;
+    pmID	pmid;
+    int		sts;
+
+    while (n-- > 0) {
+	if ((sts = pmLookupName(1, &samplenames[i % NSAMPLE], &pmid)) < 0)
+	    fail("pmLookupName", sts);
+	i++;
+    }
+}
+
+static void
+local_fetch_run(long n)
+{
+    pmResult	*rp;
+    int		sts;
+
+    while (n-- > 0) {
+	if ((sts = pmFetch(NSAMPLE, samplepmids, &rp)) < 0)
+	    fail("pmFetch", sts);
+	pmFreeResult(rp);
+    }
+}
+
+static bench_t	benches[] = {
+    { "decode.result", "__pmDecodeResult, 40 metrics, 340 values",
+	decode_setup, decode_run, decode_teardown },
+    { "hash.search", "__pmHashSearch, 10000 entries",
+	hash_setup, hash_run, hash_teardown },
+    { "labels.merge", "pmMergeLabelSets, 6 levels",
+	labels_setup, labels_run, labels_teardown },
+    { "archive.lookup", "pmLookupName, archive context",
+	archive_setup, lookup_run, NULL },
+    { "archive.interp", "pmFetch, interpolated archive, 40 metrics",
+	interp_setup, interp_run, NULL },
+    { "local.lookup", "pmLookupName, local context, sample PMDA",
+	local_setup, local_lookup_run, NULL },
+    { "local.fetch", "pmFetch, local context, sample PMDA, 8 metrics",
+	local_setup, local_fetch_run, NULL },
+};
+#define NBENCH	(sizeof(benches) / sizeof(benches[0]))
+
+static double
+now(void)
+{
+    struct timespec	ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int
+cmpdouble(const void *a, const void *b)
+{
+    double	x = *(const double *)a, y = *(const double *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/* ops/sec from a previous run of perfbench, else 0 */
+static double
+baseline(const char *file, const char *name)
+{
+    FILE	*f;
+    char	line[256], bname[64];
+    double	ops;
+
+    if (file == NULL || (f = fopen(file, "r")) == NULL)
+	return 0;
+    while (fgets(line, sizeof(line), f) != NULL) {
+	if (line[0] == '#')
+	    continue;
+	if (sscanf(line, "%63s %lf", bname, &ops) == 2 && strcmp(bname, name) == 0) {
+	    fclose(f);
+	    return ops;
+	}
+    }
+    fclose(f);
+    return 0;
+}
+
+static int
+selected(const char *name, int argc, char **argv)
+{
+    int		i;
+
+    if (optind == argc)
+	return 1;
+    for (i = optind; i < argc; i++) {
+	if (strncmp(name, argv[i], strlen(argv[i])) == 0)
+	    return 1;
+    }
+    return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    int		c, sts, b, r;
+    int		errflag = 0;
+    int		quick = 0;
+    int		runs = 5;
+    int		target = 200;		/* msec per run */
+    char	*compare = NULL;
+    char	*endnum;
+    bench_t	*bp;
+    long	n;
+    double	elapsed, ops, base;
+    double	nsop[MAXRUNS];
+    unsigned long	allocs;
+
+    pmSetProgname(argv[0]);
+
+    while ((c = getopt(argc, argv, "a:c:D:P:qr:t:v?")) != EOF) {
+	switch (c) {
+
+	case 'a':	/* use this archive rather than a synthetic one */
+	    archive = optarg;
+	    break;
+
+	case 'c':	/* compare with an earlier run */
+	    compare = optarg;
+	    break;
+
+	case 'D':	/* debug options */
+	    sts = pmSetDebug(optarg);
+	    if (sts < 0) {
+		fprintf(stderr, "%s: unrecognized debug options specification (%s)\n",
+		    pmGetProgname(), optarg);
+		errflag++;
+	    }
+	    break;
+
+	case 'P':	/* sample PMDA DSO path */
+	    pmdadso = optarg;
+	    break;
+
+	case 'q':	/* quick, a smoke test for QA */
+	    quick = 1;
+	    break;
+
+	case 'r':	/* runs */
+	    runs = (int)strtol(optarg, &endnum, 10);
+	    if (*endnum != '\0' || runs < 1 || runs > MAXRUNS) {
+		fprintf(stderr, "%s: -r requires an integer between 1 and %d\n",
+			pmGetProgname(), MAXRUNS);
+		errflag++;
+	    }
+	    break;
+
+	case 't':	/* target msec per run */
+	    target = (int)strtol(optarg, &endnum, 10);
+	    if (*endnum != '\0' || target < 1) {
+		fprintf(stderr, "%s: -t requires a positive integer\n", pmGetProgname());
+		errflag++;
+	    }
+	    break;
+
+	case 'v':	/* verbose */
+	    verbose++;
+	    break;
+
+	case '?':
+	default:
+	    errflag++;
+	    break;
+	}
+    }
+
+    if (errflag) {
+	fprintf(stderr,
+"Usage: %s [options] [benchmark ...]\n\
+\n\
+Options:\n\
+  -a archive  use archive rather than a synthetic one (names must match)\n\
+  -c file     compare ops/sec with the output of an earlier run\n\
+  -D debug    debug flags\n\
+  -P dso      sample PMDA DSO for the local context\n\
+  -q          quick smoke test, one short run of each benchmark\n\
+  -r runs     runs per benchmark, median is reported [default 5]\n\
+  -t msec     target duration of each run [default 200]\n\
+  -v          verbose, report calibration and each run\n\
+\n\
+Benchmarks (select by prefix):\n",
+		pmGetProgname());
+	for (b = 0; b < NBENCH; b++)
+	    fprintf(stderr, "  %-16s %s\n", benches[b].name, benches[b].desc);
+	exit(1);
+    }
+
+    if (quick) {
+	runs = 1;
+	target = 5;
+    }
+    make_names();
+    if (archive == NULL)
+	make_archive();
+
+    printf("# %-14s %12s %12s %10s%s\n", "benchmark", "ops/s", "ns/op",
+	    HAVE_ALLOCS ? "allocs/op" : "", compare ? "     change" : "");
+    for (b = 0; b < NBENCH; b++) {
+	bp = &benches[b];
+	if (!selected(bp->name, argc, argv))
+	    continue;
+	if ((sts = bp->setup()) < 0) {
+	    printf("# %-14s skipped: %s\n", bp->name, pmErrStr(sts));
+	    continue;
+	}
+
+	/* warm up and calibrate: double until a run is long enough */
+	for (n = 1; ; n *= 2) {
+	    elapsed = now();
+	    bp->run(n);
+	    elapsed = now() - elapsed;
+	    if (elapsed * 1000 >= target / 4.0 || n >= (1L << 30))
+		break;
+	}
+	n = (long)(n * target / (elapsed * 1000));
+	if (n < 1)
+	    n = 1;
+	if (verbose)
+	    fprintf(stderr, "%s: %ld ops per run\n", bp->name, n);
+
+	allocs = ALLOCS();
+	for (r = 0; r < runs; r++) {
+	    elapsed = now();
+	    bp->run(n);
+	    elapsed = now() - elapsed;
+	    nsop[r] = elapsed * 1e9 / n;
+	    if (verbose)
+		fprintf(stderr, "%s: run %d %.1f ns/op\n", bp->name, r, nsop[r]);
+	}
+	allocs = ALLOCS() - allocs;
+	if (bp->teardown)
+	    bp->teardown();
+
+	qsort(nsop, runs, sizeof(double), cmpdouble);
+	ops = 1e9 / nsop[runs / 2];
+	printf("%-16s %12.0f %12.1f", bp->name, ops, nsop[runs / 2]);
+	if (HAVE_ALLOCS)
+	    printf(" %10.2f", (double)allocs / ((double)n * runs));
+	if ((base = baseline(compare, bp->name)) > 0)
+	    printf(" %+9.1f%%", (ops - base) * 100 / base);
+	putchar('\n');
+	fflush(stdout);
+    }
+
+    if (archctx >= 0)
+	pmDestroyContext(archctx);
+    if (localctx >= 0)
+	pmDestroyContext(localctx);
+    remove_archive();
+    exit(0);
+}
@@ -39,16 +39,17 @@ void release_filter(void *data)
  */
 void queue_statistics(int q)
 {
-    pmAtomValue count, bytes, clients, memory;
+    pmAtomValue count, bytes, clients, memory, dropped;
 
     pmdaEventQueueCounter(q, &count);
     pmdaEventQueueBytes(q, &bytes);
     pmdaEventQueueClients(q, &clients);
     pmdaEventQueueMemory(q, &memory);
+    pmdaEventQueueDropped(q, &dropped);
 
-    fprintf(stderr, "event queue#%d count=%d, bytes=%d, clients=%d, mem=%" FMT_INT64 "\n",
+    fprintf(stderr, "event queue#%d count=%d, bytes=%d, clients=%d, mem=%" FMT_INT64 ", dropped=%" FMT_INT64 "\n",
 	    q, (int)count.ul, (int)bytes.ull, (int)clients.ul,
-	    memory.ull);
+	    memory.ull, dropped.ull);
 }
 
 /*
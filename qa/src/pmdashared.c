@@ -0,0 +1,93 @@
+/*
+ * Exercise pmdaSharedOpen, pmdaSharedStore and pmdaSharedLookup.
+ *
+ * Copyright (c) 2026 Red Hat.
+ */
+
+#include <pcp/pmapi.h>
+#include <pcp/pmda.h>
+
+static void
+usage(void)
+{
+    fprintf(stderr, "Usage: %s [-D debug] [-w] [-n count] name [key[=value] ...]\n",
+	    pmGetProgname());
+    exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+    char	value[PMDA_SHARED_VALUELEN];
+    char	key[PMDA_SHARED_KEYLEN];
+    char	*p, *endnum;
+    int		c, i, sts, handle, flags = 0, count = 0, found;
+
+    pmSetProgname(argv[0]);
+    while ((c = getopt(argc, argv, "D:n:w")) != EOF) {
+	switch (c) {
+	case 'D':
+	    if ((sts = pmSetDebug(optarg)) < 0) {
+		fprintf(stderr, "%s: unrecognized debug options specification (%s)\n",
+			pmGetProgname(), optarg);
+		exit(1);
+	    }
+	    break;
+	case 'n':
+	    count = (int)strtol(optarg, &endnum, 10);
+	    if (*endnum != '\0' || count < 0)
+		usage();
+	    break;
+	case 'w':
+	    flags |= PMDA_SHARED_WRITE;
+	    break;
+	default:
+	    usage();
+	}
+    }
+    if (optind >= argc)
+	usage();
+
+    if ((handle = pmdaSharedOpen(argv[optind], flags)) < 0) {
+	printf("open %s: %s\n", argv[optind], pmErrStr(handle));
+	exit(1);
+    }
+
+    /* -n stores (or looks up) count generated keys */
+    if (count > 0) {
+	for (i = found = 0; i < count; i++) {
+	    pmsprintf(key, sizeof(key), "key%06d", i);
+	    pmsprintf(value, sizeof(value), "value%06d", i);
+	    if (flags & PMDA_SHARED_WRITE) {
+		if ((sts = pmdaSharedStore(handle, key, value)) >= 0)
+		    found++;
+	    } else {
+		if ((sts = pmdaSharedLookup(handle, key, value, sizeof(value))) == 0)
+		    found++;
+	    }
+	}
+	printf("%s %d of %d keys\n",
+		(flags & PMDA_SHARED_WRITE) ? "stored" : "found", found, count);
+    }
+
+    for (i = optind + 1; i < argc; i++) {
+	if ((p = strchr(argv[i], '=')) != NULL) {
+	    *p++ = '\0';
+	    sts = pmdaSharedStore(handle, argv[i], p);
+	    if (sts < 0)
+		printf("store %s: %s\n", argv[i], pmErrStr(sts));
+	    else
+		printf("store %s=%s: %s\n", argv[i], p,
+			sts ? "updated" : "unchanged");
+	} else {
+	    sts = pmdaSharedLookup(handle, argv[i], value, sizeof(value));
+	    if (sts < 0)
+		printf("lookup %s: %s\n", argv[i], pmErrStr(sts));
+	    else
+		printf("lookup %s: %s\n", argv[i], value);
+	}
+    }
+
+    pmdaSharedClose(handle);
+    exit(0);
+}
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * Exercise the PMDA dynamic namespace helpers with names below a very
+ * wide node ... pmdaTreeInsert() both before and after the hash has
+ * been built, pmdaTreePMID(), pmdaTreeName(), pmdaTreeChildren() and
+ * pmdaTreeRemove().
+ */
+
+#include <pcp/pmapi.h>
+#include <pcp/pmda.h>
+
+static void
+mkname(char *buf, size_t len, int i)
+{
+    pmsprintf(buf, len, "wide.m%d.value", i);
+}
+
+/*
+ * Check every name from 0 to numnames, those with removed set (for
+ * i % 3 == 0) must not be found.
+ */
+static int
+check(pmdaNameSpace *tree, int numnames, int removed)
+{
+    char	name[64];
+    char	**names;
+    pmID	pmid;
+    int		i, sts, gone, nbad = 0;
+
+    for (i = 0; i < numnames; i++) {
+	mkname(name, sizeof(name), i);
+	gone = removed && (i % 3 == 0);
+	sts = pmdaTreePMID(tree, name, &pmid);
+	if (gone) {
+	    if (sts != PM_ERR_NAME) {
+		fprintf(stderr, "pmdaTreePMID(%s): removed name found\n", name);
+		nbad++;
+	    }
+	    if (pmdaTreeName(tree, pmID_build(1, i / 1024, i % 1024), &names) >= 0) {
+		fprintf(stderr, "pmdaTreeName(%s): removed PMID found\n", name);
+		free(names);
+		nbad++;
+	    }
+	    continue;
+	}
+	if (sts < 0) {
+	    fprintf(stderr, "pmdaTreePMID(%s): %s\n", name, pmErrStr(sts));
+	    nbad++;
+	    continue;
+	}
+	if (pmid != pmID_build(1, i / 1024, i % 1024)) {
+	    fprintf(stderr, "pmdaTreePMID(%s): wrong PMID %s\n", name, pmIDStr(pmid));
+	    nbad++;
+	    continue;
+	}
+	if ((sts = pmdaTreeName(tree, pmid, &names)) != 1) {
+	    fprintf(stderr, "pmdaTreeName(%s): %s\n", pmIDStr(pmid),
+		    sts < 0 ? pmErrStr(sts) : "wrong number of names");
+	    if (sts > 0)
+		free(names);
+	    nbad++;
+	    continue;
+	}
+	if (strcmp(names[0], name) != 0) {
+	    fprintf(stderr, "pmdaTreeName(%s): %s not %s\n", pmIDStr(pmid), names[0], name);
+	    nbad++;
+	}
+	free(names);
+    }
+    return nbad;
+}
+
+int
+main(int argc, char **argv)
+{
+    int			c;
+    int			i;
+    int			sts;
+    int			errflag = 0;
+    int			numnames = 10000;
+    char		name[64];
+    char		*endnum;
+    char		**kids;
+    int			*leaf;
+    pmdaNameSpace	*tree;
+    pmID		pmid;
+
+    pmSetProgname(argv[0]);
+
+    while ((c = getopt(argc, argv, "D:n:?")) != EOF) {
+	switch (c) {
+
+	case 'D':	/* debug options */
+	    sts = pmSetDebug(optarg);
+	    if (sts < 0) {
+		fprintf(stderr, "%s: unrecognized debug options specification (%s)\n",
+		    pmGetProgname(), optarg);
+		errflag++;
+	    }
+	    break;
+
+	case 'n':	/* number of names */
+	    numnames = (int)strtol(optarg, &endnum, 10);
+	    if (*endnum != '\0' || numnames < 2) {
+		fprintf(stderr, "%s: -n requires a number larger than one\n",
+		    pmGetProgname());
+		errflag++;
+	    }
+	    break;
+
+	case '?':
+	default:
+	    errflag++;
+	    break;
+	}
+    }
+
+    if (errflag || optind != argc) {
+	fprintf(stderr, "Usage: %s [-D debug] [-n numnames]\n", pmGetProgname());
+	exit(1);
+    }
+
+    if ((sts = pmdaTreeCreate(&tree)) < 0) {
+	fprintf(stderr, "pmdaTreeCreate: %s\n", pmErrStr(sts));
+	exit(1);
+    }
+
+    /* first half, then build the hash, then the rest incrementally */
+    for (i = 0; i < numnames; i++) {
+	if (i == numnames / 2)
+	    pmdaTreeRebuildHash(tree, i);
+	mkname(name, sizeof(name), i);
+	if ((sts = pmdaTreeInsert(tree, pmID_build(1, i / 1024, i % 1024), name)) < 0) {
+	    fprintf(stderr, "pmdaTreeInsert(%s): %s\n", name, pmErrStr(sts));
+	    exit(1);
+	}
+    }
+    /* inserting an existing name again must not duplicate it */
+    mkname(name, sizeof(name), numnames - 1);
+    sts = pmdaTreeInsert(tree, pmID_build(1, (numnames - 1) / 1024, (numnames - 1) % 1024), name);
+    printf("insert again: %s\n", sts < 0 ? pmErrStr(sts) : "ok");
+    printf("size: %d\n", pmdaTreeSize(tree) == numnames ? numnames : -1);
+    printf("%d names checked, %d errors\n", numnames, check(tree, numnames, 0));
+
+    sts = pmdaTreeChildren(tree, "wide", 0, &kids, &leaf);
+    printf("children of wide: %s\n", sts == numnames ? "all" : "wrong");
+    if (sts > 0) {
+	free(kids);
+	free(leaf);
+    }
+
+    /* remove every third name, their parent nodes go too */
+    for (i = 0; i < numnames; i += 3) {
+	mkname(name, sizeof(name), i);
+	if ((sts = pmdaTreeRemove(tree, name)) < 0) {
+	    fprintf(stderr, "pmdaTreeRemove(%s): %s\n", name, pmErrStr(sts));
+	    exit(1);
+	}
+    }
+    printf("size: %d\n", pmdaTreeSize(tree) == numnames - (numnames + 2) / 3 ? numnames - (numnames + 2) / 3 : -1);
+    printf("%d names checked after remove, %d errors\n", numnames, check(tree, numnames, 1));
+    sts = pmdaTreeChildren(tree, "wide.m0", 0, &kids, &leaf);
+    printf("wide.m0: %s\n", sts < 0 ? pmErrStr(sts) : "still present");
+    sts = pmdaTreeChildren(tree, "wide", 0, &kids, &leaf);
+    printf("children of wide: %s\n", sts == numnames - (numnames + 2) / 3 ? "remaining" : "wrong");
+    if (sts > 0) {
+	free(kids);
+	free(leaf);
+    }
+
+    /* errors ... removing it again, and non-leaf names */
+    mkname(name, sizeof(name), 0);
+    sts = pmdaTreeRemove(tree, name);
+    printf("remove again: %s\n", sts < 0 ? pmErrStr(sts) : "ok");
+    sts = pmdaTreeRemove(tree, "wide.m1");
+    printf("remove non-leaf: %s\n", sts < 0 ? pmErrStr(sts) : "ok");
+    sts = pmdaTreePMID(tree, "wide.m1", &pmid);
+    printf("wide.m1: %s\n", sts < 0 ? pmErrStr(sts) : pmIDStr(pmid));
+
+    /* add a removed name back */
+    sts = pmdaTreeInsert(tree, pmID_build(1, 0, 0), name);
+    printf("insert removed name: %s\n", sts < 0 ? pmErrStr(sts) : "ok");
+    sts = pmdaTreePMID(tree, name, &pmid);
+    printf("%s: %s\n", name, sts < 0 ? pmErrStr(sts) : pmIDStr(pmid));
+
+    /* remove everything, the tree is left empty */
+    for (i = 0; i < numnames; i++) {
+	mkname(name, sizeof(name), i);
+	pmdaTreeRemove(tree, name);
+    }
+    printf("size: %d\n", pmdaTreeSize(tree));
+    sts = pmdaTreeChildren(tree, "wide", 0, &kids, &leaf);
+    printf("wide: %s\n", sts < 0 ? pmErrStr(sts) : "still present");
+
+    pmdaTreeRelease(tree);
+    exit(0);
+}
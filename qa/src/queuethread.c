@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * Exercise a pmdaEventQueue with the producer on another thread.
+ * Every event carries its sequence number and a pattern derived from
+ * it, so the consumer can check events are intact and in order, and
+ * that every event is either delivered or accounted for as missed.
+ *
+ * Usage: queuethread [-v] [-e events] [-m maxmemory] [-s fetch-usecs]
+ */
+
+#include <pcp/pmapi.h>
+#include <pcp/pmda.h>
+#include <pthread.h>
+
+static int	queueid;
+static int	nevents = 100000;
+static int	done;
+
+static unsigned int	delivered;
+static unsigned int	bad;
+static int		last = -1;
+
+static void *
+producer(void *arg)
+{
+    struct timeval	tv;
+    unsigned char	buffer[256];
+    size_t		size;
+    int			i, j;
+
+    for (i = 0; i < nevents; i++) {
+	/* vary the size, so records wrap around the end of the ring */
+	size = sizeof(int) + (i * 7) % (sizeof(buffer) - sizeof(int));
+	memcpy(buffer, &i, sizeof(int));
+	for (j = sizeof(int); j < size; j++)
+	    buffer[j] = (unsigned char)(i + j);
+	gettimeofday(&tv, NULL);
+	pmdaEventQueueAppend(queueid, buffer, size, &tv);
+	if ((i % 1000) == 0)
+	    sched_yield();
+    }
+    __atomic_store_n(&done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static int
+decode_event(int key, void *event, size_t size, struct timeval *tv, void *data)
+{
+    unsigned char	*buffer = (unsigned char *)event;
+    int			i, j;
+
+    memcpy(&i, buffer, sizeof(int));
+    if (i <= last || size != sizeof(int) + (i * 7) % (256 - sizeof(int)))
+	bad++;
+    else {
+	for (j = sizeof(int); j < size; j++)
+	    if (buffer[j] != (unsigned char)(i + j))
+		break;
+	if (j < size)
+	    bad++;
+    }
+    last = i;
+    delivered++;
+    return 0;
+}
+
+static void
+fetch(void)
+{
+    pmAtomValue	atom;
+
+    pmdaEventQueueRecords(queueid, &atom, 1, decode_event, NULL);
+}
+
+int
+main(int argc, char **argv)
+{
+    pthread_t	tid;
+    pmAtomValue	count, dropped;
+    char	*endnum;
+    long	maxmemory = 4096;
+    long	usecs = 100;
+    int		c, sts;
+    int		errflag = 0;
+    int		verbose = 0;
+
+    pmSetProgname(argv[0]);
+    while ((c = getopt(argc, argv, "e:m:s:v")) != EOF) {
+	switch (c) {
+	case 'e':
+	    nevents = (int)strtol(optarg, &endnum, 10);
+	    if (*endnum != '\0' || nevents <= 0)
+		errflag++;
+	    break;
+	case 'm':
+	    maxmemory = strtol(optarg, &endnum, 10);
+	    if (*endnum != '\0' || maxmemory < 256)
+		errflag++;
+	    break;
+	case 's':
+	    usecs = strtol(optarg, &endnum, 10);
+	    if (*endnum != '\0' || usecs < 0)
+		errflag++;
+	    break;
+	case 'v':
+	    verbose = 1;
+	    break;
+	default:
+	    errflag++;
+	}
+    }
+    if (errflag || optind != argc) {
+	fprintf(stderr, "Usage: %s [-v] [-e events] [-m maxmemory] [-s fetch-usecs]\n", pmGetProgname());
+	exit(1);
+    }
+
+    if ((queueid = pmdaEventNewQueue("queue0", maxmemory)) < 0) {
+	fprintf(stderr, "pmdaEventNewQueue: %s\n", pmErrStr(queueid));
+	exit(1);
+    }
+    pmdaEventNewClient(1);
+    pmdaEventSetAccess(1, queueid, 1);
+    fetch();	/* client now active, before the producer starts */
+
+    if ((sts = pthread_create(&tid, NULL, producer, NULL)) != 0) {
+	fprintf(stderr, "pthread_create: %s\n", pmErrStr(-sts));
+	exit(1);
+    }
+    while (!__atomic_load_n(&done, __ATOMIC_ACQUIRE)) {
+	fetch();
+	if (usecs)
+	    usleep(usecs);
+    }
+    pthread_join(tid, NULL);
+    fetch();
+
+    pmdaEventQueueCounter(queueid, &count);
+    pmdaEventQueueDropped(queueid, &dropped);
+    printf("appended %u, delivered + dropped %s, bad %u, last %s\n",
+	    count.ul,
+	    delivered + dropped.ull == count.ul ? "ok" : "mismatch",
+	    bad, last == nevents - 1 ? "ok" : "missing");
+    if (verbose)
+	printf("delivered %u dropped %" FMT_UINT64 "\n", delivered, dropped.ull);
+
+    pmdaEventEndClient(1);
+    pmdaEventQueueShutdown(queueid);
+    return 0;
+}
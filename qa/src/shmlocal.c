@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ */
+
+#include <pcp/pmapi.h>
+#include "libpcp.h"
+#include <sys/mman.h>
+
+/*
+ * Exercise the shared memory ring passed from a client to pmcd on the
+ * local unix domain socket, with both ends of a socketpair in this
+ * process: "client" is fds[0] (reading results), "pmcd" is fds[1].
+ *
+ * After the ring is set up and used, check the ways pmcd falls back
+ * to sending PDUs inline or drops the connection: no ring, a ring that
+ * is not sealed, no message, a bad message and a client that corrupts
+ * the ring indices.
+ */
+static int sizes[] = { 100, 100000, 1500000 };
+#define NSIZES	(int)(sizeof(sizes)/sizeof(sizes[0]))
+
+/*
+ * Both ends are in one process, so anything sent inline must fit in
+ * the socket buffer; this is above the ring threshold, but fits.
+ */
+#define INLINE	20000
+
+static char *
+fill(int n, int len)
+{
+    char	*buf = (char *)malloc(len + 1);
+    int		i;
+
+    if (buf == NULL) {
+	fprintf(stderr, "malloc failed\n");
+	exit(1);
+    }
+    for (i = 0; i < len; i++)
+	buf[i] = 'a' + (i * 7 + n) % 26;
+    buf[len] = '\0';
+    return buf;
+}
+
+static void
+xmit(int fd, int n, int len)
+{
+    char	*buf = fill(n, len);
+    int		sts;
+
+    if ((sts = __pmSendText(fd, FROM_ANON, n, buf)) < 0) {
+	fprintf(stderr, "__pmSendText[%d]: %s\n", n, pmErrStr(sts));
+	exit(1);
+    }
+    free(buf);
+}
+
+static void
+recv_check(int fd, int n, int len)
+{
+    __pmPDU	*pb;
+    char	*buf, *expect;
+    int		ident;
+    int		sts;
+
+    if ((sts = __pmGetPDU(fd, ANY_SIZE, TIMEOUT_DEFAULT, &pb)) != PDU_TEXT) {
+	printf("PDU %d: type %d, expected PDU_TEXT\n", n, sts);
+	exit(1);
+    }
+    if ((sts = __pmDecodeText(pb, &ident, &buf)) < 0) {
+	printf("PDU %d: decode: %s\n", n, pmErrStr(sts));
+	exit(1);
+    }
+    expect = fill(n, len);
+    printf("PDU %d: ident %d len %d %s\n", n, ident, (int)strlen(buf),
+	    strcmp(buf, expect) == 0 ? "ok" : "corrupt");
+    free(expect);
+    free(buf);
+    __pmUnpinPDUBuf(pb);
+}
+
+static void
+newpair(int *fds)
+{
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+	perror("socketpair");
+	exit(1);
+    }
+}
+
+static void
+closepair(int *fds)
+{
+    __pmCloseSocket(fds[0]);
+    __pmCloseSocket(fds[1]);
+}
+
+/* pmcd end: receive the ring, report and attach it if all is well */
+static int
+accept_ring(int fd)
+{
+    struct timeval	wait = { 0, 100000 };
+    int			shmfd;
+    int			sts;
+
+    if ((shmfd = __pmShmRecvFd(fd, &wait)) < 0) {
+	printf("pmcd: %s\n", pmErrStr(shmfd));
+	return shmfd;
+    }
+    sts = __pmSetShmIPC(fd, shmfd, PDU_SHM_XMIT);
+    close(shmfd);
+    if (sts < 0) {
+	printf("pmcd: __pmSetShmIPC: %s\n", pmErrStr(sts));
+	return sts;
+    }
+    printf("pmcd: ring mode %s\n",
+	    __pmShmIPC(fd) == PDU_SHM_XMIT ? "xmit" : "botch");
+    return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    __uint32_t	*ring;
+    size_t	maplen;
+    struct stat	sbuf;
+    char	path[MAXPATHLEN];
+    int		fds[2], pipefds[2];
+    int		shmfd, keepfd;
+    int		sts;
+    int		n;
+
+    pmSetProgname(argv[0]);
+    if (argc > 1 && (sts = pmSetDebug(argv[1])) < 0) {
+	fprintf(stderr, "%s: bad debug option (%s)\n", pmGetProgname(), argv[1]);
+	exit(1);
+    }
+
+    printf("=== ring from client to pmcd ===\n");
+    if (pipe(pipefds) < 0) {
+	perror("pipe");
+	exit(1);
+    }
+    sts = __pmShmCreateLocal(pipefds[0]);
+    printf("pipe: %s\n", sts < 0 ? "refused" : "botch");
+    newpair(fds);
+    if ((shmfd = __pmShmCreateLocal(fds[0])) < 0) {
+	printf("client: %s\n", pmErrStr(shmfd));
+	exit(0);
+    }
+    if ((keepfd = dup(shmfd)) < 0) {
+	perror("dup");
+	exit(1);
+    }
+    if ((sts = __pmSetShmIPC(fds[0], shmfd, PDU_SHM_RECV)) < 0) {
+	printf("client: __pmSetShmIPC: %s\n", pmErrStr(sts));
+	exit(1);
+    }
+    if ((sts = __pmShmSendFd(fds[0], shmfd)) < 0) {
+	printf("client: __pmShmSendFd: %s\n", pmErrStr(sts));
+	exit(1);
+    }
+    close(shmfd);
+    printf("client: ring mode %s\n",
+	    __pmShmIPC(fds[0]) == PDU_SHM_RECV ? "recv" : "botch");
+    if (accept_ring(fds[1]) < 0)
+	exit(1);
+    for (n = 0; n < NSIZES; n++) {
+	xmit(fds[1], n, sizes[n]);
+	recv_check(fds[0], n, sizes[n]);
+    }
+    /* requests from the client are always sent inline */
+    xmit(fds[0], n, INLINE);
+    recv_check(fds[1], n, INLINE);
+
+    printf("\n=== client corrupts the ring tail ===\n");
+    if (fstat(keepfd, &sbuf) < 0) {
+	perror("fstat");
+	exit(1);
+    }
+    maplen = sbuf.st_size;
+    ring = (__uint32_t *)mmap(NULL, maplen, PROT_READ|PROT_WRITE, MAP_SHARED, keepfd, 0);
+    if (ring == (__uint32_t *)MAP_FAILED) {
+	perror("mmap");
+	exit(1);
+    }
+    /* magic, size, head, tail ... */
+    ring[3] = ring[2] + 0x40000000;
+    xmit(fds[1], 10, INLINE);
+    recv_check(fds[0], 10, INLINE);
+    ring[3] = ring[2];
+    xmit(fds[1], 11, INLINE);
+    recv_check(fds[0], 11, INLINE);
+
+    printf("\n=== client cannot resize the ring ===\n");
+    printf("shrink: %s\n", ftruncate(keepfd, 4096) < 0 ? "refused" : "botch");
+    printf("grow: %s\n", ftruncate(keepfd, maplen * 2) < 0 ? "refused" : "botch");
+    munmap((void *)ring, maplen);
+    close(keepfd);
+    closepair(fds);
+    printf("after close ring modes %d %d\n", __pmShmIPC(fds[0]), __pmShmIPC(fds[1]));
+
+    printf("\n=== no ring passed ===\n");
+    newpair(fds);
+    __pmShmSendFd(fds[0], -1);
+    accept_ring(fds[1]);
+    xmit(fds[1], 20, INLINE);
+    recv_check(fds[0], 20, INLINE);
+    closepair(fds);
+
+    printf("\n=== ring not sealed ===\n");
+    newpair(fds);
+    pmsprintf(path, sizeof(path), "%s/shmlocal.XXXXXX", getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp");
+    if ((shmfd = mkstemp(path)) < 0) {
+	perror("mkstemp");
+	exit(1);
+    }
+    unlink(path);
+    if (ftruncate(shmfd, maplen) < 0) {
+	perror("ftruncate");
+	exit(1);
+    }
+    __pmShmSendFd(fds[0], shmfd);
+    close(shmfd);
+    accept_ring(fds[1]);
+    closepair(fds);
+
+    printf("\n=== no message ===\n");
+    newpair(fds);
+    accept_ring(fds[1]);
+    closepair(fds);
+
+    printf("\n=== bad message ===\n");
+    newpair(fds);
+    if (write(fds[0], "PCP!", 4) != 4) {
+	perror("write");
+	exit(1);
+    }
+    accept_ring(fds[1]);
+    closepair(fds);
+
+    return 0;
+}
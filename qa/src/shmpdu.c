@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ */
+
+#include <pcp/pmapi.h>
+#include "libpcp.h"
+#include <assert.h>
+#include <sys/wait.h>
+#include <sys/ioctl.h>
+#include "localconfig.h"
+
+/*
+ * Exercise the shared memory PDU ring between a writer (child) and
+ * a reader (parent) on a pipe.  Small PDUs go inline, large PDUs via
+ * the ring, a PDU that does not fit in the remaining ring space goes
+ * inline, and a later PDU wraps around the end of the ring.
+ *
+ * With a 4Mbyte ring, PDU 1 to 3 fill it to 3.1Mbytes, so PDU 4 must be
+ * sent inline; PDU 5 then wraps around the end of the ring.
+ */
+static int sizes[] = { 100, 100000, 1500000, 1500000, 1500000, 1500000, 20000 };
+#define NSIZES	(int)(sizeof(sizes)/sizeof(sizes[0]))
+
+static char *
+fill(int n, int len)
+{
+    char	*buf = (char *)malloc(len + 1);
+    int		i;
+
+    assert(buf != NULL);
+    for (i = 0; i < len; i++)
+	buf[i] = 'a' + (i * 7 + n) % 26;
+    buf[len] = '\0';
+    return buf;
+}
+
+static void
+writer(int fd, int shmfd)
+{
+    char	*buf;
+    int		sts;
+    int		n;
+
+    if ((sts = __pmSetShmIPC(fd, shmfd, PDU_SHM_XMIT)) < 0) {
+	fprintf(stderr, "writer: __pmSetShmIPC: %s\n", pmErrStr(sts));
+	exit(1);
+    }
+    close(shmfd);
+    for (n = 0; n < NSIZES; n++) {
+	buf = fill(n, sizes[n]);
+	if ((sts = __pmSendText(fd, FROM_ANON, n, buf)) < 0) {
+	    fprintf(stderr, "writer: __pmSendText[%d]: %s\n", n, pmErrStr(sts));
+	    exit(1);
+	}
+	free(buf);
+    }
+    exit(0);
+}
+
+int
+main(int argc, char **argv)
+{
+    __pmPDU	*pb;
+    char	*buf, *expect;
+    int		fds[2];
+    int		pending = 0;
+    int		shmfd;
+    int		ident;
+    int		sts;
+    int		n;
+    pid_t	pid;
+
+    pmSetProgname(argv[0]);
+    if (argc > 1 && (sts = pmSetDebug(argv[1])) < 0) {
+	fprintf(stderr, "%s: bad debug option (%s)\n", pmGetProgname(), argv[1]);
+	exit(1);
+    }
+
+    if (pipe(fds) < 0) {
+	perror("pipe");
+	exit(1);
+    }
+    if ((shmfd = __pmShmCreate()) < 0) {
+	fprintf(stderr, "__pmShmCreate: %s\n", pmErrStr(shmfd));
+	exit(1);
+    }
+
+    if ((pid = fork()) == 0) {
+	close(fds[0]);
+	writer(fds[1], shmfd);
+    }
+    close(fds[1]);
+    if ((sts = __pmSetShmIPC(fds[0], shmfd, PDU_SHM_RECV)) < 0) {
+	fprintf(stderr, "reader: __pmSetShmIPC: %s\n", pmErrStr(sts));
+	exit(1);
+    }
+    close(shmfd);
+    printf("reader ring mode %s\n",
+	    __pmShmIPC(fds[0]) == PDU_SHM_RECV ? "recv" : "botch");
+
+    /*
+     * Do not read until PDU 4 is being written inline, i.e. the pipe
+     * holds far more than the small PDU 0 and the ring references.
+     */
+    while (pending < 4096) {
+	if (ioctl(fds[0], FIONREAD, &pending) < 0) {
+	    perror("FIONREAD");
+	    exit(1);
+	}
+	if (pending < 4096)
+	    usleep(10000);
+    }
+
+    for (n = 0; n < NSIZES; n++) {
+	sts = __pmGetPDU(fds[0], ANY_SIZE, TIMEOUT_NEVER, &pb);
+	if (sts != PDU_TEXT) {
+	    printf("PDU %d: type %d, expected PDU_TEXT\n", n, sts);
+	    break;
+	}
+	if ((sts = __pmDecodeText(pb, &ident, &buf)) < 0) {
+	    printf("PDU %d: decode: %s\n", n, pmErrStr(sts));
+	    __pmUnpinPDUBuf(pb);
+	    break;
+	}
+	expect = fill(n, sizes[n]);
+	printf("PDU %d: ident %d len %d %s\n", n, ident, (int)strlen(buf),
+		strcmp(buf, expect) == 0 ? "ok" : "corrupt");
+	free(expect);
+	free(buf);
+	__pmUnpinPDUBuf(pb);
+    }
+
+    sts = __pmGetPDU(fds[0], ANY_SIZE, TIMEOUT_NEVER, &pb);
+    printf("end of pipe -> %d\n", sts);
+    waitpid(pid, &sts, 0);
+    printf("writer exit status %d\n", WEXITSTATUS(sts));
+
+    __pmResetIPC(fds[0]);
+    printf("after reset ring mode %d\n", __pmShmIPC(fds[0]));
+
+    return 0;
+}
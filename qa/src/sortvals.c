@@ -0,0 +1,118 @@
+/*
+ * pmSortInstances on value sets in various initial orders.
+ *
+ * Copyright (c) 2026 Red Hat.
+ */
+
+#include <pcp/pmapi.h>
+#include <limits.h>
+
+#define NUMVAL	10000
+
+static pmResult *
+newresult(void)
+{
+    pmResult	*rp;
+
+    if ((rp = (pmResult *)calloc(1, sizeof(pmResult))) == NULL ||
+	(rp->vset[0] = (pmValueSet *)calloc(1, sizeof(pmValueSet) +
+				(NUMVAL - 1) * sizeof(pmValue))) == NULL) {
+	perror("calloc");
+	exit(1);
+    }
+    rp->numpmid = 1;
+    rp->vset[0]->valfmt = PM_VAL_INSITU;
+    return rp;
+}
+
+static void
+check(const char *name, pmResult *rp)
+{
+    pmValueSet	*vsp = rp->vset[0];
+    int		i, bad = 0;
+    long long	sum = 0, vsum = 0;
+
+    for (i = 0; i < vsp->numval; i++) {
+	sum += vsp->vlist[i].inst;
+	vsum += vsp->vlist[i].value.lval;
+    }
+    pmSortInstances(rp);
+    for (i = 0; i < vsp->numval; i++) {
+	/* every value must have moved with its instance */
+	if (vsp->vlist[i].value.lval != (vsp->vlist[i].inst ^ 0x5a5a))
+	    bad++;
+	if (i > 0 && vsp->vlist[i].inst < vsp->vlist[i-1].inst)
+	    bad++;
+	sum -= vsp->vlist[i].inst;
+	vsum -= vsp->vlist[i].value.lval;
+    }
+    printf("%-16s numval=%-5d %s", name, vsp->numval,
+	    (bad || sum || vsum) ? "BAD" : "sorted");
+    if (vsp->numval > 0)
+	printf(" first=%d last=%d", vsp->vlist[0].inst,
+		vsp->vlist[vsp->numval-1].inst);
+    putchar('\n');
+}
+
+static void
+set(pmResult *rp, int i, int inst)
+{
+    rp->vset[0]->vlist[i].inst = inst;
+    rp->vset[0]->vlist[i].value.lval = inst ^ 0x5a5a;
+}
+
+int
+main(int argc, char **argv)
+{
+    pmResult	*rp = newresult();
+    int		i, n, tmp;
+
+    pmSetProgname(argv[0]);
+    srandom(42);
+
+    rp->vset[0]->numval = 0;
+    check("empty", rp);
+
+    rp->vset[0]->numval = 1;
+    set(rp, 0, 7);
+    check("single", rp);
+
+    rp->vset[0]->numval = NUMVAL;
+    for (i = 0; i < NUMVAL; i++)
+	set(rp, i, i * 3);
+    check("ascending", rp);
+
+    for (i = 0; i < NUMVAL; i++)
+	set(rp, i, NUMVAL - i);
+    check("descending", rp);
+
+    for (i = 0; i < NUMVAL; i++)
+	set(rp, i, i);
+    for (n = 0; n < 5; n++) {
+	/* a few stragglers, well out of place */
+	i = random() % NUMVAL;
+	tmp = rp->vset[0]->vlist[i].inst;
+	set(rp, i, rp->vset[0]->vlist[NUMVAL-1-i].inst);
+	set(rp, NUMVAL-1-i, tmp);
+    }
+    check("nearly-sorted", rp);
+
+    for (i = 0; i < NUMVAL; i++)
+	set(rp, i, (i + NUMVAL / 2) % NUMVAL);
+    check("rotated", rp);
+
+    for (i = 0; i < NUMVAL; i++)
+	set(rp, i, (int)(random() % 1000));
+    check("random-dups", rp);
+
+    rp->vset[0]->numval = 6;
+    set(rp, 0, INT_MAX);
+    set(rp, 1, -1);
+    set(rp, 2, INT_MIN);
+    set(rp, 3, 0);
+    set(rp, 4, INT_MAX - 1);
+    set(rp, 5, INT_MIN + 1);
+    check("extremes", rp);
+
+    exit(0);
+}
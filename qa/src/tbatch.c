@@ -0,0 +1,180 @@
+/*
+ * Batched trace data PDUs, as per pmtracestate(PMTRACE_STATE_BATCH).
+ *
+ * Forks a libpcp_trace client which sends to this process, standing
+ * in for pmdatrace, and reports the data that arrives.
+ *
+ * Copyright (c) 2026 Red Hat.
+ */
+
+#include <pcp/pmapi.h>
+#include <pcp/trace.h>
+#include <pcp/trace_dev.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+typedef struct {
+    char	*tag;
+    int		type;
+    int		count;
+    double	sum;
+} tag_t;
+
+static tag_t	tags[8];
+static int	ntags;
+
+static void
+usage(void)
+{
+    fprintf(stderr, "Usage: %s [-l linger] [-n count]\n", pmGetProgname());
+    exit(1);
+}
+
+static void
+check(int sts, const char *call)
+{
+    if (sts < 0) {
+	fprintf(stderr, "client %s: %s\n", call, pmtraceerrstr(sts));
+	_exit(1);
+    }
+}
+
+static void
+client(int count, int linger)
+{
+    int		i;
+
+    check(pmtracestate(PMTRACE_STATE_BATCH), "pmtracestate");
+    for (i = 0; i < count; i++)
+	check(pmtraceobs("obs", (double)i), "pmtraceobs");
+    for (i = 0; i < 10; i++)
+	check(pmtracepoint("point"), "pmtracepoint");
+    check(pmtracebegin("txn"), "pmtracebegin");
+    check(pmtraceend("txn"), "pmtraceend");
+    for (i = 1; i <= 3; i++)
+	check(pmtracecounter("last", (double)i), "pmtracecounter");
+
+    if (linger) {
+	/* the flusher thread must send the tail, there is no exit flush */
+	sleep(linger);
+	_exit(0);
+    }
+    exit(0);
+}
+
+static void
+record(char *tag, int type, double data)
+{
+    int		i;
+
+    for (i = 0; i < ntags; i++) {
+	if (strcmp(tags[i].tag, tag) == 0 && tags[i].type == type)
+	    break;
+    }
+    if (i == ntags) {
+	if (ntags == sizeof(tags) / sizeof(tags[0])) {
+	    fprintf(stderr, "too many tags at \"%s\"\n", tag);
+	    exit(1);
+	}
+	tags[i].tag = strdup(tag);
+	tags[i].type = type;
+	ntags++;
+    }
+    tags[i].count++;
+    tags[i].sum += data;
+}
+
+int
+main(int argc, char **argv)
+{
+    struct sockaddr_in	addr;
+    socklen_t		addrlen = sizeof(addr);
+    __pmTracePDU	*pb;
+    double		data;
+    char		*tag, *endnum;
+    char		port[16];
+    int			c, i, sts, lfd, fd, status;
+    int			count = 1000, linger = 0, nsync = 0;
+    int			taglen, type, protocol;
+    pid_t		pid;
+
+    pmSetProgname(argv[0]);
+    while ((c = getopt(argc, argv, "l:n:")) != EOF) {
+	switch (c) {
+	case 'l':
+	    linger = (int)strtol(optarg, &endnum, 10);
+	    if (*endnum != '\0' || linger < 0)
+		usage();
+	    break;
+	case 'n':
+	    count = (int)strtol(optarg, &endnum, 10);
+	    if (*endnum != '\0' || count < 0)
+		usage();
+	    break;
+	default:
+	    usage();
+	}
+    }
+    if (optind != argc)
+	usage();
+
+    if ((lfd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+	perror("socket");
+	exit(1);
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+	listen(lfd, 1) < 0 ||
+	getsockname(lfd, (struct sockaddr *)&addr, &addrlen) < 0) {
+	perror("bind");
+	exit(1);
+    }
+    pmsprintf(port, sizeof(port), "%d", ntohs(addr.sin_port));
+    setenv(TRACE_ENV_HOST, "127.0.0.1", 1);
+    setenv(TRACE_ENV_PORT, port, 1);
+
+    fflush(stdout);
+    if ((pid = fork()) == 0) {
+	close(lfd);
+	client(count, linger);
+    }
+    if ((fd = accept(lfd, NULL, NULL)) < 0) {
+	perror("accept");
+	exit(1);
+    }
+    __pmtracesendack(fd, TRACE_PDU_VERSION);
+
+    while ((sts = __pmtracegetPDU(fd, TRACE_TIMEOUT_NEVER, &pb)) > 0) {
+	if (sts != TRACE_PDU_DATA) {
+	    printf("unexpected PDU type 0x%x\n", sts);
+	    break;
+	}
+	if ((sts = __pmtracedecodedata(pb, &tag, &taglen,
+					&type, &protocol, &data)) < 0) {
+	    printf("decode failed: %s\n", pmtraceerrstr(sts));
+	    break;
+	}
+	if (protocol)
+	    nsync++;
+	/* transaction times vary, so only their count is reported */
+	record(tag, type, type == TRACE_TYPE_TRANSACT ? 0 : data);
+	free(tag);
+    }
+    if (sts < 0)
+	printf("read failed: %s\n", pmtraceerrstr(sts));
+    close(fd);
+
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+	printf("client failed, status 0x%x\n", status);
+
+    printf("synchronous PDUs: %d\n", nsync);
+    for (i = 0; i < ntags; i++)
+	printf("tag %s type %d: count %d sum %.0f\n",
+		tags[i].tag, tags[i].type, tags[i].count, tags[i].sum);
+    exit(0);
+}
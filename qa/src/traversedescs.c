@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * pmTraversePMNS against pmcd, then look up the names and descriptors
+ * of everything found ... with the lookup cache enabled, the traversal
+ * returns the descriptors too and no further lookup PDUs are needed.
+ */
+
+#include <pcp/pmapi.h>
+#include "libpcp.h"
+
+static int	numnames;
+static char	**names;
+
+static void
+dometric(const char *name, void *closure)
+{
+    names = (char **)realloc(names, (numnames + 1) * sizeof(names[0]));
+    if (names == NULL) {
+	fprintf(stderr, "dometric: realloc failed\n");
+	exit(1);
+    }
+    if ((names[numnames++] = strdup(name)) == NULL) {
+	fprintf(stderr, "dometric: strdup failed\n");
+	exit(1);
+    }
+}
+
+static unsigned int
+lookups(void)
+{
+    return __pmPDUCntOut[PDU_PMNS_NAMES - PDU_START] +
+	   __pmPDUCntOut[PDU_DESC_REQ - PDU_START] +
+	   __pmPDUCntOut[PDU_DESC_IDS - PDU_START];
+}
+
+int
+main(int argc, char **argv)
+{
+    int			c;
+    int			i;
+    int			sts;
+    int			ctx;
+    int			errflag = 0;
+    int			verbose = 0;
+    char		*host = "local:";
+    pmID		*pmids;
+    pmDesc		*descs;
+    unsigned int	before;
+    char		strbuf[60];
+
+    pmSetProgname(argv[0]);
+
+    while ((c = getopt(argc, argv, "D:h:v?")) != EOF) {
+	switch (c) {
+
+	case 'D':	/* debug options */
+	    sts = pmSetDebug(optarg);
+	    if (sts < 0) {
+		fprintf(stderr, "%s: unrecognized debug options specification (%s)\n",
+		    pmGetProgname(), optarg);
+		errflag++;
+	    }
+	    break;
+
+	case 'h':	/* host */
+	    host = optarg;
+	    break;
+
+	case 'v':	/* report each metric */
+	    verbose++;
+	    break;
+
+	case '?':
+	default:
+	    errflag++;
+	    break;
+	}
+    }
+
+    if (errflag || optind != argc - 1) {
+	fprintf(stderr, "Usage: %s [-D debug] [-h host] [-v] name\n",
+		pmGetProgname());
+	exit(1);
+    }
+
+    if ((ctx = pmNewContext(PM_CONTEXT_HOST, host)) < 0) {
+	fprintf(stderr, "%s: Cannot connect to %s: %s\n",
+		pmGetProgname(), host, pmErrStr(ctx));
+	exit(1);
+    }
+
+    if ((sts = pmTraversePMNS_r(argv[optind], dometric, NULL)) < 0) {
+	fprintf(stderr, "pmTraversePMNS(%s): %s\n", argv[optind], pmErrStr(sts));
+	exit(1);
+    }
+    printf("traverse: %s\n",
+	__pmPDUCntIn[PDU_PMNS_NAMEDESCS - PDU_START] ?
+	"names and descriptors" : "names only");
+
+    pmids = (pmID *)malloc(numnames * sizeof(pmID));
+    descs = (pmDesc *)malloc(numnames * sizeof(pmDesc));
+    if (pmids == NULL || descs == NULL) {
+	fprintf(stderr, "malloc failed\n");
+	exit(1);
+    }
+
+    before = lookups();
+    if ((sts = pmLookupName(numnames, (const char **)names, pmids)) < 0) {
+	fprintf(stderr, "pmLookupName: %s\n", pmErrStr(sts));
+	exit(1);
+    }
+    if ((sts = pmLookupDescs(numnames, pmids, descs)) < 0) {
+	fprintf(stderr, "pmLookupDescs: %s\n", pmErrStr(sts));
+	exit(1);
+    }
+    printf("lookups after traverse: %s\n",
+	lookups() - before ? "lookup PDUs sent" : "no lookup PDUs");
+
+    if (verbose) {
+	for (i = 0; i < numnames; i++) {
+	    printf("%s %s", names[i], pmIDStr_r(pmids[i], strbuf, sizeof(strbuf)));
+	    if (descs[i].pmid == PM_ID_NULL) {
+		printf(" no descriptor\n");
+		continue;
+	    }
+	    printf(" %s", pmTypeStr_r(descs[i].type, strbuf, sizeof(strbuf)));
+	    printf(" %s", pmInDomStr_r(descs[i].indom, strbuf, sizeof(strbuf)));
+	    printf(" %d", descs[i].sem);
+	    printf(" %s\n", pmUnitsStr_r(&descs[i].units, strbuf, sizeof(strbuf)));
+	}
+    }
+
+    pmDestroyContext(ctx);
+    exit(0);
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * Build a PMNS with many names below a few very wide nodes, as for
+ * archives with large numbers of metrics, then check name to PMID
+ * and PMID to name translation for all of them.
+ */
+
+#include <pcp/pmapi.h>
+#include "libpcp.h"
+
+#define NUMTOP	4
+
+static void
+mkname(char *buf, size_t len, int i)
+{
+    /* spread names across NUMTOP top level nodes and one wide level */
+    pmsprintf(buf, len, "top%d.wide.m%d", i % NUMTOP, i);
+}
+
+int
+main(int argc, char **argv)
+{
+    int		c;
+    int		i;
+    int		sts;
+    int		errflag = 0;
+    int		numnames = 100000;
+    int		nbad = 0;
+    char	name[64];
+    char	*np;
+    char	*endnum;
+    const char	*namep = name;
+    __pmnsTree	*pmns;
+    pmID	pmid;
+
+    pmSetProgname(argv[0]);
+
+    while ((c = getopt(argc, argv, "D:n:?")) != EOF) {
+	switch (c) {
+
+	case 'D':	/* debug options */
+	    sts = pmSetDebug(optarg);
+	    if (sts < 0) {
+		fprintf(stderr, "%s: unrecognized debug options specification (%s)\n",
+		    pmGetProgname(), optarg);
+		errflag++;
+	    }
+	    break;
+
+	case 'n':	/* number of names */
+	    numnames = (int)strtol(optarg, &endnum, 10);
+	    if (*endnum != '\0' || numnames < 1) {
+		fprintf(stderr, "%s: -n requires a positive number\n",
+		    pmGetProgname());
+		errflag++;
+	    }
+	    break;
+
+	case '?':
+	default:
+	    errflag++;
+	    break;
+	}
+    }
+
+    if (errflag || optind != argc) {
+	fprintf(stderr, "Usage: %s [-D debug] [-n numnames]\n", pmGetProgname());
+	exit(1);
+    }
+
+    if ((sts = __pmNewPMNS(&pmns)) < 0) {
+	fprintf(stderr, "__pmNewPMNS: %s\n", pmErrStr(sts));
+	exit(1);
+    }
+    for (i = 0; i < numnames; i++) {
+	mkname(name, sizeof(name), i);
+	if ((sts = __pmAddPMNSNode(pmns, pmID_build(1, i / 1024, i % 1024), name)) < 0) {
+	    fprintf(stderr, "__pmAddPMNSNode(%s): %s\n", name, pmErrStr(sts));
+	    exit(1);
+	}
+    }
+
+    /* same name again is fine, same name with another PMID is not */
+    mkname(name, sizeof(name), numnames / 2);
+    sts = __pmAddPMNSNode(pmns, pmID_build(1, (numnames / 2) / 1024, (numnames / 2) % 1024), name);
+    printf("add duplicate: %s\n", sts < 0 ? pmErrStr(sts) : "ok");
+    sts = __pmAddPMNSNode(pmns, pmID_build(2, 0, 0), name);
+    printf("add duplicate with another PMID: %s\n", sts < 0 ? pmErrStr(sts) : "ok");
+
+    if ((sts = __pmFixPMNSHashTab(pmns, numnames, 1)) < 0) {
+	fprintf(stderr, "__pmFixPMNSHashTab: %s\n", pmErrStr(sts));
+	exit(1);
+    }
+    __pmUsePMNS(pmns);
+
+    for (i = 0; i < numnames; i++) {
+	mkname(name, sizeof(name), i);
+	if ((sts = pmLookupName(1, &namep, &pmid)) < 0) {
+	    fprintf(stderr, "pmLookupName(%s): %s\n", name, pmErrStr(sts));
+	    nbad++;
+	    continue;
+	}
+	if (pmid != pmID_build(1, i / 1024, i % 1024)) {
+	    fprintf(stderr, "pmLookupName(%s): wrong PMID %s\n", name, pmIDStr(pmid));
+	    nbad++;
+	    continue;
+	}
+	if ((sts = pmNameID(pmid, &np)) < 0) {
+	    fprintf(stderr, "pmNameID(%s): %s\n", pmIDStr(pmid), pmErrStr(sts));
+	    nbad++;
+	    continue;
+	}
+	if (strcmp(np, name) != 0) {
+	    fprintf(stderr, "pmNameID(%s): %s not %s\n", pmIDStr(pmid), np, name);
+	    nbad++;
+	}
+	free(np);
+    }
+    printf("%d names checked, %d errors\n", numnames, nbad);
+
+    /* names that are not there, or are not leaves */
+    strcpy(name, "top0.wide.nosuchmetric");
+    sts = pmLookupName(1, &namep, &pmid);
+    printf("%s: %s\n", name, sts < 0 ? pmErrStr(sts) : pmIDStr(pmid));
+    strcpy(name, "top0.wide");
+    sts = pmLookupName(1, &namep, &pmid);
+    printf("%s: %s\n", name, sts < 0 ? pmErrStr(sts) : pmIDStr(pmid));
+    mkname(name, sizeof(name), numnames);
+    sts = pmLookupName(1, &namep, &pmid);
+    printf("%s: %s\n", "one past the end", sts < 0 ? pmErrStr(sts) : pmIDStr(pmid));
+
+    __pmUsePMNS(NULL);
+    __pmFreePMNS(pmns);
+    exit(0);
+}
@@ -0,0 +1,44 @@
+#!/usr/bin/env pmpython
+# -*- coding: utf-8 -*-
+
+# Exercises multiple network listener threads sharing the configured port
+
+import sys
+import socket
+import glob
+import os
+import time
+
+utils_path = os.path.abspath(os.path.join("utils"))
+sys.path.append(utils_path)
+
+import pmdastatsd_test_utils as utils
+
+utils.print_test_file_separator()
+print(os.path.basename(__file__))
+
+ip = "0.0.0.0"
+port = 8125
+socket_count = 16
+datagrams_per_socket = 10
+
+testconfigs = [utils.configs["listener_threads"][0], utils.configs["listener_threads"][1]]
+
+def run_test():
+    for testconfig in testconfigs:
+        utils.print_test_section_separator()
+        utils.pmdastatsd_install(testconfig)
+        # each socket has its own source port, spreading datagrams over listeners
+        for i in range(socket_count):
+            sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+            for j in range(datagrams_per_socket):
+                sock.sendto("test_listeners:1|c".encode("utf-8"), (ip, port))
+            sock.close()
+        time.sleep(1)
+        utils.print_metric("statsd.test_listeners")
+        utils.print_metric("statsd.pmda.received")
+        utils.pmdastatsd_remove()
+        utils.restore_config()
+
+run_test()
+
@@ -53,6 +53,10 @@ duration_aggregation_type = 0
 """
 [global]
 duration_aggregation_type = 1
+""",
+"""
+[global]
+duration_aggregation_type = 2
 """],
 	"max_udp_packet_size": [
 """
@@ -84,6 +88,15 @@ parser_type = 0
 """
 [global]
 parser_type = 1
+"""],
+	"listener_threads": [
+"""
+[global]
+listener_threads = 1
+""",
+"""
+[global]
+listener_threads = 4
 """],
 	"port": [
 """
@@ -166,6 +166,7 @@ typedef struct __pmnsTree {
     __pmnsNode		**htab; /* hash table of nodes keyed on pmid */
     int			htabsize;     /* number of nodes in the table */
     int			mark_state;   /* the total mark value for trimming */
+    struct __pmnsIndex	*index;	/* child node index, private to pmns.c */
 } __pmnsTree;
 
 /* used by pmnsmerge/pmnsdel */
@@ -176,6 +177,8 @@ PCP_CALL extern int __pmNewPMNS(__pmnsTree **);
 PCP_CALL extern void __pmUsePMNS(__pmnsTree *); /* for debugging */
 PCP_CALL extern int __pmFixPMNSHashTab(__pmnsTree *, int, int);
 PCP_CALL extern int __pmAddPMNSNode(__pmnsTree *, int, const char *);
+PCP_CALL extern __pmnsNode *__pmFindPMNSNode(__pmnsTree *, const char *);
+PCP_CALL extern int __pmRemovePMNSNode(__pmnsTree *, const char *);
 
 /* return true if the named pmns file has changed */
 PCP_CALL extern int __pmHasPMNSFileChanged(const char *);
@@ -206,7 +209,9 @@ PCP_CALL extern int __pmHasPMNSFileChanged(const char *);
 #define PDU_HIGHRES_RESULT	0x7015
 #define PDU_DESC_IDS		0x7016
 #define PDU_DESCS		0x7017
-#define PDU_FINISH		0x7017
+#define PDU_COMPACT_RESULT	0x7018
+#define PDU_PMNS_NAMEDESCS	0x7019
+#define PDU_FINISH		0x7019
 #define PDU_MAX		 	(PDU_FINISH - PDU_START)
 
 typedef __uint32_t	__pmPDU;
@@ -282,6 +287,9 @@ typedef struct {
 #define PDU_FLAG_LABELS		(1U<<9)
 #define PDU_FLAG_HIGHRES	(1U<<10)
 #define PDU_FLAG_DESCS		(1U<<11)
+#define PDU_FLAG_SHM		(1U<<12)
+#define PDU_FLAG_COMPACT	(1U<<13)
+#define PDU_FLAG_METADATA	(1U<<14)
 /* Credential CVERSION PDU elements look like this */
 typedef struct {
 #ifdef HAVE_BITFIELDS_LTOR
@@ -314,6 +322,30 @@ typedef struct __pmResult {
     pmValueSet		*vset[1];	/* set of value sets, one per PMID */
 } __pmResult;
 
+/*
+ * Columnar form of the values in one pmValueSet, see __pmExtractColumn()
+ * ... contiguous arrays of instance identifiers and values, with all
+ * of the values of the one numeric type
+ */
+typedef struct {
+    pmID		pmid;
+    int			numval;		/* number of values, else error */
+    int			type;		/* PM_TYPE_* of the values */
+    int			nerr;		/* number of values with sts[] < 0 */
+    int			maxval;		/* space allocated for the arrays */
+    int			*inst;		/* instance identifiers */
+    int			*sts;		/* pmExtractValue() status per value */
+    union {
+	void		*vp;
+	__int32_t	*l;
+	__uint32_t	*ul;
+	__int64_t	*ll;
+	__uint64_t	*ull;
+	float		*f;
+	double		*d;
+    } value;				/* values, using the type member */
+} __pmColumn;
+
 #if defined(HAVE_64BIT_PTR)
 /*
  * A pmValue contains the union of a 32-bit int and a pointer.  In the world
@@ -382,6 +414,9 @@ PCP_CALL extern int __pmSendHighResResult(int, int, const __pmResult *);
 PCP_CALL extern int __pmEncodeHighResResult(const __pmResult *, __pmPDU **);
 PCP_CALL extern int __pmDecodeResult(__pmPDU *, __pmResult **);
 PCP_CALL extern int __pmDecodeHighResResult(__pmPDU *, __pmResult **);
+PCP_CALL extern int __pmSendCompactResult(int, int, const __pmResult *);
+PCP_CALL extern int __pmEncodeCompactResult(const __pmResult *, __pmPDU **);
+PCP_CALL extern int __pmDecodeCompactResult(__pmPDU *, __pmResult **);
 PCP_CALL extern int __pmDecodeValueSet(__pmPDU *, int, __pmPDU *, char *, int, int, int, pmValueSet **);
 PCP_CALL extern int __pmSendProfile(int, int, int, pmProfile *);
 PCP_CALL extern int __pmDecodeProfile(__pmPDU *, int *, pmProfile **);
@@ -416,6 +451,10 @@ PCP_CALL extern int __pmSendChildReq(int, int, const char *, int);
 PCP_CALL extern int __pmDecodeChildReq(__pmPDU *, char **, int *);
 PCP_CALL extern int __pmSendTraversePMNSReq(int, int, const char *);
 PCP_CALL extern int __pmDecodeTraversePMNSReq(__pmPDU *, char **);
+PCP_CALL extern int __pmSendTraversePMNSDescsReq(int, int, const char *);
+PCP_CALL extern int __pmDecodeTraversePMNSReq2(__pmPDU *, char **, int *);
+PCP_CALL extern int __pmSendNameDescs(int, int, int, const char **, const pmDesc *);
+PCP_CALL extern int __pmDecodeNameDescs(__pmPDU *, int *, char ***, pmDesc **);
 PCP_CALL extern int __pmSendAuth(int, int, int, const char *, int);
 PCP_CALL extern int __pmDecodeAuth(__pmPDU *, int *, char **, int *);
 PCP_CALL extern int __pmSendAttr(int, int, int, const char *, int);
@@ -426,6 +465,7 @@ PCP_CALL extern int __pmSendLabel(int, int, int, int, pmLabelSet *, int);
 PCP_CALL extern int __pmDecodeLabel(__pmPDU *, int *, int *, pmLabelSet **, int *);
 PCP_CALL unsigned int __pmServerGetFeaturesFromPDU(__pmPDU *);
 PCP_CALL extern int __pmFeaturesIPC(int);
+PCP_CALL extern int __pmSetFeaturesIPC(int, int, int);
 
 /* PDU buffer services */
 PCP_CALL extern __pmPDU *__pmFindPDUBuf(int);
@@ -449,6 +489,17 @@ PCP_CALL extern int __pmSocketIPC(int);
 PCP_CALL extern void __pmOverrideLastFd(int);
 PCP_CALL extern void __pmResetIPC(int);
 
+/* shared memory PDU transport between pmcd and pipe PMDAs or local clients */
+#define PDU_SHM_XMIT	1
+#define PDU_SHM_RECV	2
+PCP_CALL extern int __pmShmCreate(void);
+PCP_CALL extern int __pmSetShmIPC(int, int, int);
+PCP_CALL extern int __pmShmIPC(int);
+PCP_CALL extern void __pmCloseShmIPC(int);
+PCP_CALL extern int __pmShmCreateLocal(int);
+PCP_CALL extern int __pmShmSendFd(int, int);
+PCP_CALL extern int __pmShmRecvFd(int, struct timeval *);
+
 /* platform independent socket services */
 typedef fd_set __pmFdSet;
 typedef struct __pmSockAddr __pmSockAddr;
@@ -537,6 +588,31 @@ PCP_CALL extern int __pmHashDel(unsigned int, void *, __pmHashCtl *);
 PCP_CALL extern void __pmHashClear(__pmHashCtl *);
 PCP_CALL extern void __pmHashFree(__pmHashCtl *);
 
+/* Open-addressing hash tables ... keys and data stored inline */
+typedef struct __pmOAHashNode {
+    unsigned int	key;
+    unsigned int	state;		/* zero for a deleted entry */
+    void		*data;
+} __pmOAHashNode;
+typedef struct __pmOAHashCtl {
+    int			nodes;		/* live entries */
+    int			used;		/* entries[] used, including deleted */
+    int			size;		/* entries[] allocated */
+    unsigned int	hsize;		/* index[] slots, a power of two */
+    __pmOAHashNode	*entries;	/* in insertion order */
+    int			*index;		/* offsets into entries[] */
+    int			cursor;		/* for __pmOAHashWalk */
+} __pmOAHashCtl;
+PCP_CALL extern void __pmOAHashInit(__pmOAHashCtl *);
+PCP_CALL extern int __pmOAHashPreAlloc(int, __pmOAHashCtl *);
+typedef __pmHashWalkState(*__pmOAHashWalkCallback)(const __pmOAHashNode *, void *);
+PCP_CALL extern void __pmOAHashWalkCB(__pmOAHashWalkCallback, void *, __pmOAHashCtl *);
+PCP_CALL extern __pmOAHashNode *__pmOAHashWalk(__pmOAHashCtl *, __pmHashWalkState);
+PCP_CALL extern __pmOAHashNode *__pmOAHashSearch(unsigned int, __pmOAHashCtl *);
+PCP_CALL extern int __pmOAHashAdd(unsigned int, void *, __pmOAHashCtl *);
+PCP_CALL extern int __pmOAHashDel(unsigned int, void *, __pmOAHashCtl *);
+PCP_CALL extern void __pmOAHashClear(__pmOAHashCtl *);
+
 
 /*
  * Host specification allowing one or more pmproxy host, and port numbers
@@ -613,6 +689,26 @@ PCP_CALL extern int __pmFclose(__pmFILE *);
 
 PCP_CALL extern int __pmCompressedFileIndex(char *, size_t);
 
+/*
+ * Block checksums for archive data volumes, see __pmLogSetChecksum().
+ */
+#define PM_LOG_CKSUM_SUFFIX	".crc"
+#define PM_LOG_CKSUM_BLOCKSIZE	65536
+PCP_CALL extern int __pmFchecksum(__pmFILE *, const char *, size_t);
+PCP_CALL extern __uint32_t __pmCRC32(__uint32_t, const void *, size_t);
+
+/*
+ * Space accounting for archive data volumes, see __pmLogSetSizes().
+ */
+#define PM_LOG_SIZE_SUFFIX	".size"
+PCP_CALL extern int __pmFlogsize(__pmFILE *, const char *);
+
+/*
+ * Copies of records written to archive files, see __pmLogSetTee().
+ */
+typedef void (*__pmTeeCallBack)(void *, int, const void *, size_t);
+PCP_CALL extern int __pmFtee(__pmFILE *, int, __pmTeeCallBack, void *);
+
 /*
  * st_size within struct stat is set by __pmStat() to this value to indicate
  * that the size could not be obtained. This happens when the file is compressed.
@@ -647,6 +743,7 @@ pmlabel_intrinsic(pmLabel *lp)
 PCP_CALL extern int __pmAddLabels(pmLabelSet **, const char *, int);
 PCP_CALL extern pmLabelSet *__pmDupLabelSets(pmLabelSet *, int);
 PCP_CALL extern int __pmParseLabelSet(const char *, int, int, pmLabelSet **);
+PCP_CALL extern int __pmMergedLabelSet(pmLabelSet **, int, pmLabelSet **);
 PCP_CALL extern int __pmGetContextLabels(pmLabelSet **);
 PCP_CALL extern int __pmGetDomainLabels(int, const char *, pmLabelSet **);
 
@@ -703,6 +800,11 @@ typedef struct __pmLogHdr {
 #define PMLID_INSTLIST	2		/* instlist[] is malloc'd */
 #define PMLID_NAMELIST	4		/* namelist[] is malloc'd */
 #define PMLID_NAMES	8		/* namelist[i] strings are malloc'd */
+#define PMLID_LAZY	16		/* instances not loaded yet, buf[] is */
+					/* the whole on-disk record, in the */
+					/* mapped metadata file, see .midx */
+					/* below, unless PMLID_RECORD */
+#define PMLID_RECORD	32		/* PMLID_LAZY buf[] is malloc'd */
 
 typedef struct __pmLogInDom {
     struct __pmLogInDom	*next;			/* backwards in time */
@@ -715,6 +817,10 @@ typedef struct __pmLogInDom {
     int			*instlist;		/* may point into buf[] */
     char		**namelist;		/* may point into buf[] */
     __int32_t		*buf;			/* on-disk buffer */
+    __int32_t		*rec;			/* record in the mapped metadata */
+						/* file (see .midx below), so the */
+						/* instances can be unloaded, */
+						/* else NULL */
 } __pmLogInDom;
 
 /*
@@ -813,8 +919,10 @@ typedef struct {
     __pmTimestamp endtime;	/* (when reading) timestamp at logical EOF */
     int		numti;		/* (when reading) no. temporal index entries */
     __pmLogTI	*ti;		/* (when reading) temporal index */
+    int		tisorted;	/* (when reading) ti[] is in time order */
     struct __pmnsTree *pmns;	/* namespace from meta data */
     int		multi;		/* part of a multi-archive context */
+    void	*metamap;	/* (when reading) mapped metadata files */
 } __pmLogCtl;
 
 /* state values */
@@ -846,7 +954,7 @@ typedef struct {
     int			ac_vol;		/* volume for ac_offset */
     int			ac_serial;	/* serial access pattern for archives */
     int			ac_chkfeatures;	/* 1 => check featutre bits */
-    __pmHashCtl		ac_pmid_hc;	/* per PMID controls for INTERP */
+    __pmOAHashCtl	ac_pmid_hc;	/* per PMID controls for INTERP */
     double		ac_end;		/* time at end of archive */
     void		*ac_want;	/* used in interp.c */
     void		*ac_unbound;	/* used in interp.c */
@@ -861,6 +969,9 @@ typedef struct {
     int			ac_num_logs;	/* The number of archives */
     int			ac_cur_log;	/* The currently open archive */
     __pmMultiLogCtl	**ac_log_list;	/* Current set of archives */
+    int			ac_prefetch;	/* 1 + archive last prefetched, */
+					/*   0 if none */
+    void		*ac_memctl;	/* used in interp.c */
 } __pmArchCtl;
 
 /*
@@ -914,6 +1025,8 @@ typedef struct {
     __pmHashCtl		c_attrs;	/* various optional context attributes */
     int			c_handle;	/* context number above PMAPI */
     int			c_slot;		/* index to contexts[] below PMAPI */
+    void		*c_lookup;	/* cached name and desc lookups */
+    void		*c_async;	/* queued pmFetchAsync requests */
 } __pmContext;
 
 #define PM_CONTEXT_INIT	-2		/* special type: being initialized, do not use */
@@ -927,6 +1040,10 @@ PCP_CALL extern size_t __pmLogLabelSize(const __pmLogCtl *);
 PCP_CALL extern int __pmLogChkLabel(__pmArchCtl *, __pmFILE *, __pmLogLabel *, int);
 PCP_CALL extern int __pmLogCreate(const char *, const char *, int, __pmArchCtl *);
 PCP_CALL extern __pmFILE *__pmLogNewFile(const char *, int);
+PCP_CALL extern int __pmLogSetCompress(const char *);
+PCP_CALL extern int __pmLogSetChecksum(size_t);
+PCP_CALL extern void __pmLogSetSizes(int);
+PCP_CALL extern void __pmLogSetTee(__pmTeeCallBack, void *);
 PCP_CALL extern void __pmLogClose(__pmArchCtl *);
 PCP_CALL extern int __pmLogPutDesc(__pmArchCtl *, const pmDesc *, int, char **);
 PCP_CALL extern int __pmLogPutInDom(__pmArchCtl *, int, const __pmLogInDom * const);
@@ -946,6 +1063,9 @@ PCP_CALL extern int __pmLogAddInDom(__pmArchCtl *, int, const __pmLogInDom *, __
 PCP_CALL extern int __pmLogEncodeInDom(__pmLogCtl *, int, const __pmLogInDom * const, __int32_t **);
 PCP_CALL extern __pmLogInDom *__pmLogSearchInDom(__pmLogCtl *, pmInDom, __pmTimestamp *);
 PCP_CALL extern void __pmLogUndeltaInDom(pmInDom, __pmLogInDom *);
+PCP_CALL extern int __pmLogLoadLazyInDom(__pmLogInDom *);
+PCP_CALL extern int __pmLogUnloadInDoms(__pmLogCtl *, const __pmTimestamp *, int);
+PCP_CALL extern int __pmLogWriteMetaIndex(const char *);
 PCP_CALL extern int __pmLogAddPMNSNode(__pmArchCtl *, pmID, const char *);
 PCP_CALL extern int __pmLogAddLabelSets(__pmArchCtl *, const __pmTimestamp *, unsigned int, unsigned int, int, pmLabelSet *);
 PCP_CALL extern int __pmLogAddText(__pmArchCtl *, unsigned int, unsigned int, const char *);
@@ -956,8 +1076,24 @@ PCP_CALL extern int __pmLogRead(__pmArchCtl *, int, __pmFILE *, __pmResult **, i
 PCP_CALL extern int __pmLogRead_ctx(__pmContext *, int, __pmFILE *, __pmResult **, int);
 PCP_CALL extern int __pmLogChangeVol(__pmArchCtl *, int);
 PCP_CALL extern int __pmLogFetch(__pmContext *, int, pmID *, __pmResult **);
+PCP_CALL extern int __pmLogFetchFilter(__pmContext *, int, pmID *, __pmResult **);
 PCP_CALL extern int __pmLogGetInDom(__pmArchCtl *, pmInDom, __pmTimestamp *, int **, char ***);
 PCP_CALL extern int __pmGetArchiveEnd(__pmArchCtl *, __pmTimestamp *);
+PCP_CALL extern int __pmGetInterpStats(int, long *, long *);
+/*
+ * Memory held for interpolation in the current archive context, and
+ * the limit on it, see __pmSetInterpLimit() and $PCP_INTERP_MEMORY
+ */
+typedef struct {
+    size_t	bytes;		/* metric and instance controls + values */
+    size_t	limit;		/* 0 => no limit */
+    long	values;		/* values held for interpolation */
+    long	evicted;	/* instances released when out of range */
+    long	released;	/* instances released to meet the limit */
+    long	unloaded;	/* instance domain records unloaded */
+} __pmInterpUsage;
+PCP_CALL extern int __pmGetInterpUsage(__pmInterpUsage *);
+PCP_CALL extern int __pmSetInterpLimit(size_t);
 PCP_CALL extern int __pmLogLookupDesc(__pmArchCtl *, pmID, pmDesc *);
 #define PMLOGPUTINDOM_DUP       1
 PCP_CALL extern int __pmLogLookupInDom(__pmArchCtl *, pmInDom, __pmTimestamp *, const char *);
@@ -975,6 +1111,7 @@ PCP_DATA extern int __pmLogReads;
 
 /* Convert opaque context handle to __pmContext pointer */
 PCP_CALL extern __pmContext *__pmHandleToPtr(int);
+PCP_CALL extern void __pmHandleToPtrList(int, const int *, __pmContext **);
 
 /*
  * Dump the current context (source details + instance profile),
@@ -984,6 +1121,7 @@ PCP_CALL extern __pmContext *__pmHandleToPtr(int);
 
 /* pmFetch helper routines, hooks for derivations and local contexts */
 PCP_CALL extern int __pmFetch(__pmContext *, int, pmID *, __pmResult **);
+PCP_CALL extern int __pmFetchMany(int, const int *, int, pmID *, __pmResult **, int *);
 PCP_CALL extern int __pmFetchLocal(__pmContext *, int, pmID *, __pmResult **);
 PCP_CALL extern int __pmFetchArchive(__pmContext *, __pmResult **);
 PCP_CALL extern int __pmPrepareFetch(__pmContext *, int, const pmID *, pmID **);
@@ -992,7 +1130,9 @@ PCP_CALL extern int __pmFinishHighResResult(__pmContext *, int, pmHighResResult
 PCP_CALL extern int __pmFetchLocal(__pmContext *, int, pmID *, __pmResult **);
 PCP_CALL extern int __pmFetchHighResLocal(__pmContext *, int, pmID *, __pmResult **);
 PCP_CALL extern int __pmDecodeResult_ctx(__pmContext *, __pmPDU *, __pmResult **);
+PCP_CALL extern int __pmLogDecodeResult(int, __pmPDU *, __pmResult **);
 PCP_CALL extern int __pmDecodeHighResResult_ctx(__pmContext *, __pmPDU *, __pmResult **);
+PCP_CALL extern int __pmDecodeCompactResult_ctx(__pmContext *, __pmPDU *, __pmResult **);
 PCP_CALL extern void __pmGetResultSize(int, int, pmValueSet * const *, size_t *, size_t *);
 PCP_CALL extern void __pmSortInstances(__pmResult *);
 
@@ -1407,6 +1547,9 @@ typedef struct __pmSecureConfig {
     char	*clientcertfile;/* certificate chain (client only) */
     char	*clientkeyfile;	/* certificate key (client only) */
     char	*clientverify;	/* client certificates (t/f) */
+    char	*clientsessiondir; /* resumable sessions (client only) */
+    char	*sessiontimeout;/* session lifetime in seconds */
+    char	*kerneloffload;	/* kernel TLS (kTLS) offload (t/f) */
 } __pmSecureConfig;
 
 PCP_CALL extern void __pmSecureConfigInit(void);
@@ -1428,6 +1571,9 @@ PCP_CALL extern int __pmInProfile(pmInDom, const pmProfile *, int);
 
 /* __pmResult alloc/offsets */
 PCP_CALL extern __pmResult *__pmAllocResult(int);
+PCP_CALL extern int __pmExtractColumn(const pmValueSet *, int, int, __pmColumn *);
+PCP_CALL extern int __pmColumnIndex(const __pmColumn *, int, int);
+PCP_CALL extern void __pmFreeColumn(__pmColumn *);
 /*
  * __pmResult and pmResult are identical after the timestamp.
  * If we're exporting a pmResult from a __pmResult, this function
@@ -19,7 +19,8 @@
 #define MMV_VERSION1	1	/* original on-disk format */
 #define MMV_VERSION2	2	/* + mmv_disk_{metric2,instance2}_t */
 #define MMV_VERSION3	3	/* + labels support */
-#define MMV_VERSION     1	/* default, upgrading to v3 only if needed */
+#define MMV_VERSION4	4	/* + per-CPU value stripes */
+#define MMV_VERSION     1	/* default, upgrading to v4 only if needed */
 
 typedef enum mmv_toc_type {
     MMV_TOC_INDOMS	= 1,	/* mmv_disk_indom_t */
@@ -28,8 +29,19 @@ typedef enum mmv_toc_type {
     MMV_TOC_VALUES	= 4,	/* mmv_disk_value_t */
     MMV_TOC_STRINGS	= 5,	/* mmv_disk_string_t */
     MMV_TOC_LABELS	= 6,	/* mmv_disk_label_t */
+    MMV_TOC_STRIPES	= 7,	/* per-CPU pmAtomValue arrays */
 } mmv_toc_type_t;
 
+/*
+ * Each per-CPU stripe holds one pmAtomValue per entry in the values
+ * section (same order), padded out to a cache line so that no two
+ * CPUs update the same line.  The TOC count is the number of stripes.
+ */
+#define MMV_STRIPE_ALIGN	64
+#define MMV_STRIPE_STRIDE(nvalues) \
+	((((nvalues) * sizeof(pmAtomValue)) + MMV_STRIPE_ALIGN - 1) & \
+	 ~((__uint64_t)MMV_STRIPE_ALIGN - 1))
+
 /* The way the Table Of Contents is written into the file */
 typedef struct mmv_disk_toc {
     mmv_toc_type_t	type;		/* What is it? */
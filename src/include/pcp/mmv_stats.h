@@ -105,6 +105,8 @@ typedef enum mmv_stats_flags {
     MMV_FLAG_NOPREFIX  = 0x1,  /* Don't prefix metric names by filename */ 
     MMV_FLAG_PROCESS   = 0x2,  /* Indicates process check on PID needed */ 
     MMV_FLAG_SENTINEL  = 0x4,  /* Sentinel values == no-value-available */ 
+    MMV_FLAG_PERCPU    = 0x8,  /* Per-CPU striped counter values */
+    MMV_FLAG_GROWABLE  = 0x10, /* Instances may be appended after start */
 } mmv_stats_flags_t;
 
 typedef enum mmv_value_type {
@@ -125,6 +127,19 @@ typedef enum mmv_value_type {
 struct mmv_registry;
 typedef struct mmv_registry mmv_registry_t;
 
+/*
+ * Value handle with the metric type and any per-CPU stripes resolved
+ * once up-front, see mmv_lookup_value_handle(3).
+ */
+typedef struct mmv_value_handle {
+    void *		addr;		/* start of the mapping */
+    pmAtomValue *	value;		/* value within the mapping */
+    char *		stripe;		/* value within first per-CPU stripe */
+    __uint64_t		stride;		/* bytes between per-CPU stripes */
+    __uint32_t		nstripes;	/* number of per-CPU stripes */
+    mmv_metric_type_t	type;		/* metric value type */
+} mmv_value_handle_t;
+
 extern mmv_registry_t * mmv_stats_registry(const char *, int,
 		mmv_stats_flags_t);
 extern int mmv_stats_add_indom(mmv_registry_t *, int, const char *,
@@ -133,6 +148,8 @@ extern int mmv_stats_add_metric(mmv_registry_t *, const char *, int,
 		mmv_metric_type_t, mmv_metric_sem_t, pmUnits,
 		int, const char *, const char *);
 extern int mmv_stats_add_instance(mmv_registry_t *, int, int, const char *);
+extern int mmv_stats_reserve_instances(mmv_registry_t *, int, int);
+extern int mmv_stats_append_instance(mmv_registry_t *, int, int, const char *);
 
 extern int mmv_stats_add_registry_label(mmv_registry_t *,
 		const char *, const char *, mmv_value_type_t, int);
@@ -157,6 +174,16 @@ extern void mmv_add(void *, pmAtomValue *, void *);
 extern void mmv_inc_atomvalue(void *, pmAtomValue *, pmAtomValue *);
 extern void mmv_inc_value(void *, pmAtomValue *, double);
 
+/*
+ * Handle-based variants of the above, with all lookups done once in
+ * mmv_lookup_value_handle and increments going to per-CPU stripes if
+ * the registry was created with MMV_FLAG_PERCPU.
+ */
+extern int mmv_lookup_value_handle(void *, pmAtomValue *, mmv_value_handle_t *);
+extern void mmv_handle_inc(mmv_value_handle_t *);
+extern void mmv_handle_inc_atomvalue(mmv_value_handle_t *, pmAtomValue *);
+extern void mmv_handle_inc_value(mmv_value_handle_t *, double);
+
 extern void mmv_set(void *, pmAtomValue *, void *);
 extern void mmv_set_atomvalue(void *, pmAtomValue *, pmAtomValue *);
 extern void mmv_set_value(void *, pmAtomValue *, double);
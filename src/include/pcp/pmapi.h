@@ -542,6 +542,26 @@ PCP_CALL extern int pmFetchHighRes(int, pmID *, pmHighResResult **);
 /* older name maintained for backwards compatibility */
 PCP_CALL extern int pmHighResFetch(int, pmID *, pmHighResResult **);
 
+/*
+ * Fetch the same metrics from several contexts with overlapping
+ * round trips, per-context results and status codes returned.
+ */
+PCP_CALL extern int pmFetchMany(int, const int *, int, pmID *, pmResult **, int *);
+PCP_CALL extern int pmFetchHighResMany(int, const int *, int, pmID *, pmHighResResult **, int *);
+
+/*
+ * Asynchronous fetch for PM_CONTEXT_HOST contexts.  pmFetchAsync sends
+ * the request and returns a request handle without waiting; the caller
+ * polls the descriptor from pmGetAsyncFd (libuv, epoll, Qt, ...) and
+ * calls pmAsyncService when it is readable, which makes the callback
+ * (context, request, status, result, arg) for each completed request.
+ */
+typedef void (*pmFetchCallBack)(int, int, int, pmHighResResult *, void *);
+PCP_CALL extern int pmFetchAsync(int, int, pmID *, pmFetchCallBack, void *);
+PCP_CALL extern int pmGetAsyncFd(int);
+PCP_CALL extern int pmAsyncService(int);
+PCP_CALL extern int pmAsyncCancel(int, int);
+
 /*
  * PMCD state changes returned as fetch function results for PM_CONTEXT_HOST
  * contexts, i.e. when communicating with PMCD
@@ -556,6 +576,22 @@ PCP_CALL extern int pmHighResFetch(int, pmID *, pmHighResResult **);
 #define PMCD_LABEL_CHANGE	(1<<3)
 #define PMCD_NAMES_CHANGE	(1<<4)
 
+/*
+ * Label hierarchy levels affected, reported along with PMCD_LABEL_CHANGE
+ * (none of these are set by older PMCDs and PMDAs, in which case any
+ * level may have changed)
+ */
+#define PMCD_CONTEXT_LABEL_CHANGE	(1<<8)
+#define PMCD_DOMAIN_LABEL_CHANGE	(1<<9)
+#define PMCD_INDOM_LABEL_CHANGE		(1<<10)
+#define PMCD_CLUSTER_LABEL_CHANGE	(1<<11)
+#define PMCD_ITEM_LABEL_CHANGE		(1<<12)
+#define PMCD_INSTANCES_LABEL_CHANGE	(1<<13)
+#define PMCD_LABEL_LEVELS	\
+	(PMCD_CONTEXT_LABEL_CHANGE | PMCD_DOMAIN_LABEL_CHANGE | \
+	 PMCD_INDOM_LABEL_CHANGE | PMCD_CLUSTER_LABEL_CHANGE | \
+	 PMCD_ITEM_LABEL_CHANGE | PMCD_INSTANCES_LABEL_CHANGE)
+
 /*
  * Variant that is used to return a result from an archive.
  */
@@ -709,6 +745,17 @@ PCP_CALL extern void pmPrintValue(FILE *, int, int, const pmValue *, int);
 PCP_CALL extern int pmConvScale(int, const pmAtomValue *, const pmUnits *, pmAtomValue *, 
 		       const pmUnits *);
 
+/* Precompiled scale conversion, applied to arrays of values */
+typedef struct pmConvPlan {
+    int		type;		/* PM_TYPE_* of input and output values */
+    int		__pad;
+    __int64_t	mult;		/* exact integer scale factor is mult/div */
+    __int64_t	div;
+    double	scale;		/* mult/div, for floating point types */
+} pmConvPlan;
+PCP_CALL extern int pmConvScalePlan(int, const pmUnits *, const pmUnits *, pmConvPlan *);
+PCP_CALL extern int pmConvScaleApply(const pmConvPlan *, const pmAtomValue *, pmAtomValue *, int);
+
 /* Sort instances for each metric within a pmResult */
 PCP_CALL extern void pmSortInstances(pmResult *);
 PCP_CALL extern void pmSortHighResInstances(pmHighResResult *);
@@ -1173,6 +1220,23 @@ PCP_CALL extern int pmUnpackHighResEventRecords(pmValueSet *, int, pmHighResResu
 /* Free set of pmHighResResults from pmUnpackEventRecords */
 PCP_CALL extern void pmFreeHighResEventResult(pmHighResResult **);
 
+/* Walk [HIGHRES_]EVENT records in place, no pmResult allocations */
+typedef struct pmEventIter {
+    char		*next;		/* next record or parameter */
+    int			highres;	/* PM_TYPE_HIGHRES_EVENT array */
+    int			nrecords;	/* records not yet visited */
+    unsigned int	flags;		/* er_flags, current record */
+    int			nparams;	/* er_nparams, current record */
+    int			numpmid;	/* parameters, incl. anon metrics */
+    int			param;		/* parameters already visited */
+    pmTimespec		timestamp;	/* current record timestamp */
+    pmValueSet		vset;		/* current parameter */
+} pmEventIter;
+
+PCP_CALL extern int pmEventIterStart(pmEventIter *, pmValueSet *, int);
+PCP_CALL extern int pmEventIterNext(pmEventIter *);
+PCP_CALL extern int pmEventIterParam(pmEventIter *, pmValueSet **);
+
 /* Service discovery, for clients. */
 #define PM_SERVER_SERVICE_SPEC	"pmcd"
 #define PM_SERVER_PROXY_SPEC	"pmproxy"
@@ -1198,6 +1262,12 @@ PCP_CALL extern int pmExtendFetchGroup_timestamp(pmFG, struct timeval *);
 PCP_CALL extern int pmFetchGroup(pmFG);
 PCP_CALL extern int pmDestroyFetchGroup(pmFG);
 
+/* pmFormatFetchGroup output formats */
+#define PM_FG_FORMAT_JSON	1	/* one JSON object */
+#define PM_FG_FORMAT_CSV	2	/* time,metric,instance,value rows */
+#define PM_FG_FORMAT_LINE	3	/* InfluxDB line protocol */
+PCP_CALL extern int pmFormatFetchGroup(pmFG, int, const char **);
+
 /* libpcp debug/tracing */
 PCP_CALL extern int pmSetDebug(const char *);
 PCP_CALL extern int pmClearDebug(const char *);
@@ -112,6 +112,12 @@ typedef void (*pmdaEndContextCallBack)(int);
  */
 typedef int (*pmdaLabelCallBack)(pmInDom, unsigned int, pmLabelSet **);
 
+/*
+ * Type of function call back used by pmdaRefreshRegister to rebuild a
+ * cluster snapshot from a background thread.
+ */
+typedef int (*pmdaRefreshCallBack)(int, void *, void *);
+
 
 /*
  * libpcp_pmda extension structure.
@@ -166,6 +172,11 @@ typedef struct pmdaExt {
 #define PMDA_EXT_NOTREADY	(1<<4)	/* pmcd connection marked NOTREADY */
 #define PMDA_EXT_LABEL_CHANGE	(1<<5)	/* new label metadata notification */
 #define PMDA_EXT_NAMES_CHANGE	(1<<6)	/* metric name change notification */
+#define PMDA_EXT_DOMAIN_LABEL_CHANGE	(1<<7)	/* domain labels changed */
+#define PMDA_EXT_INDOM_LABEL_CHANGE	(1<<8)	/* indom labels changed */
+#define PMDA_EXT_CLUSTER_LABEL_CHANGE	(1<<9)	/* cluster labels changed */
+#define PMDA_EXT_ITEM_LABEL_CHANGE	(1<<10)	/* item labels changed */
+#define PMDA_EXT_INSTANCES_LABEL_CHANGE	(1<<11)	/* instance labels changed */
 
 /*
  * Optionally restrict symbol visibility for DSO PMDAs
@@ -477,6 +488,15 @@ typedef struct pmdaOptions {
  *	Lookup any metadata labels associated with metric instances.
  *	Passed in a metric table entry and instance identifier and expects
  *      the callback to fill the given labelset structure.
+ *
+ * pmdaRefreshRegister
+ *	Rebuild a fixed-size snapshot for one cluster on a background thread
+ *	at a target interval.  The newest complete snapshot is swapped in at
+ *	the start of each pmdaFetch and returned by pmdaRefreshSnapshot, so
+ *	fetch callbacks never wait on a refresh in progress.
+ *
+ * pmdaRefreshStop
+ *	Stop all background refresh threads and release their snapshots.
  */
 
 PMDA_CALL extern int pmdaGetOpt(int, char *const *, const char *, pmdaInterface *, int *);
@@ -504,6 +524,10 @@ PMDA_CALL extern void pmdaSetDoneCallBack(pmdaInterface *, pmdaDoneCallBack);
 PMDA_CALL extern void pmdaSetEndContextCallBack(pmdaInterface *, pmdaEndContextCallBack);
 PMDA_CALL extern void pmdaSetLabelCallBack(pmdaInterface *, pmdaLabelCallBack);
 
+PMDA_CALL extern int pmdaRefreshRegister(pmdaInterface *, int, const struct timeval *, size_t, pmdaRefreshCallBack, void *);
+PMDA_CALL extern int pmdaRefreshSnapshot(pmdaInterface *, int, void **);
+PMDA_CALL extern void pmdaRefreshStop(pmdaInterface *);
+
 /*
  * Callbacks to PMCD which should be adequate for most PMDAs.
  * NOTE: if pmdaFetch is used, e_callback must be specified in the pmdaExt
@@ -567,6 +591,22 @@ PMDA_CALL extern int pmdaChildren(const char *, int, char ***, int **, pmdaExt *
 PMDA_CALL extern int pmdaAttribute(int, int, const char *, int, pmdaExt *);
 PMDA_CALL extern int pmdaLabel(int, int, pmLabelSet **, pmdaExt *);
 
+/*
+ * Instance profile queries, for use in PMDA fetch callbacks
+ *
+ * pmdaInProfile
+ *	Returns 1 if an instance of indom is selected by the current
+ *	profile, else 0.
+ *
+ * pmdaProfileInstances
+ *	Returns the length of the sorted profile instance list for indom
+ *	and sets state to PM_PROFILE_EXCLUDE if only the listed instances
+ *	are wanted, or PM_PROFILE_INCLUDE if all but the listed instances
+ *	are wanted.  The list belongs to the profile, do not free it.
+ */
+PMDA_CALL extern int pmdaInProfile(pmInDom, int, pmdaExt *);
+PMDA_CALL extern int pmdaProfileInstances(pmInDom, int *, int **, pmdaExt *);
+
 /*
  * PMDA "help" text manipulation
  */
@@ -664,6 +704,7 @@ PMDA_CALL extern int pmdaTreeSize(pmdaNameSpace *);
 
 PMDA_CALL extern int pmdaTreeCreate(pmdaNameSpace **);
 PMDA_CALL extern int pmdaTreeInsert(pmdaNameSpace *, pmID, const char *);
+PMDA_CALL extern int pmdaTreeRemove(pmdaNameSpace *, const char *);
 PMDA_CALL extern void pmdaTreeRelease(pmdaNameSpace *);
 
 /*
@@ -730,6 +771,32 @@ PMDA_CALL extern int pmdaCacheResize(pmInDom, int);
 #define PMDA_CACHE_DUMP			19
 #define PMDA_CACHE_DUMP_ALL		20
 
+/*
+ * Name mappings shared between PMDAs on one host, e.g. container
+ * identifiers to names, in a memory-mapped file that persists across
+ * PMDA restarts.
+ *
+ * pmdaSharedOpen
+ *	open the named mapping, for updates if PMDA_SHARED_WRITE is set
+ *
+ * pmdaSharedStore
+ *	add or update the value for a key (writers only)
+ *
+ * pmdaSharedLookup
+ *	copy out the value for a key
+ *
+ * pmdaSharedClose
+ *	release the mapping
+ */
+PMDA_CALL extern int pmdaSharedOpen(const char *, int);
+PMDA_CALL extern int pmdaSharedStore(int, const char *, const char *);
+PMDA_CALL extern int pmdaSharedLookup(int, const char *, char *, size_t);
+PMDA_CALL extern void pmdaSharedClose(int);
+
+#define PMDA_SHARED_WRITE		1
+#define PMDA_SHARED_KEYLEN		88	/* includes null terminator */
+#define PMDA_SHARED_VALUELEN		160	/* includes null terminator */
+
 /*
  * Internal libpcp_pmda routines.
  *
@@ -814,6 +881,7 @@ PMDA_CALL extern int pmdaEventQueueClients(int, pmAtomValue *);
 PMDA_CALL extern int pmdaEventQueueCounter(int, pmAtomValue *);
 PMDA_CALL extern int pmdaEventQueueBytes(int, pmAtomValue *);
 PMDA_CALL extern int pmdaEventQueueMemory(int, pmAtomValue *);
+PMDA_CALL extern int pmdaEventQueueDropped(int, pmAtomValue *);
 
 typedef int (*pmdaEventDecodeCallBack)(int,
 		void *, size_t, struct timeval *, void *);
@@ -36,6 +36,8 @@ extern int pmhttpClientFetch(struct http_client *, const char *,
 extern int pmhttpClientSetTimeout(struct http_client *, struct timeval *);
 extern int pmhttpClientSetProtocol(struct http_client *, enum http_protocol);
 extern int pmhttpClientSetUserAgent(struct http_client *, const char *, const char *);
+extern int pmhttpClientSetHeaders(struct http_client *, const char *);
+extern int pmhttpClientGetStatus(struct http_client *);
 
 #ifdef __cplusplus
 }
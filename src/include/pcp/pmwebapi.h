@@ -242,6 +242,16 @@ extern int pmDiscoverSetConfiguration(pmDiscoverModule *, struct dict *);
 extern int pmDiscoverSetMetricRegistry(pmDiscoverModule *, struct mmv_registry *);
 extern void pmDiscoverClose(pmDiscoverModule *);
 
+/*
+ * Archive records streamed from a remote logger, see pmlogger -R
+ */
+typedef struct pmDiscoverStream pmDiscoverStream;
+
+extern pmDiscoverStream *pmDiscoverStreamOpen(pmDiscoverModule *,
+				const char *, const char *, const char *, void *);
+extern int pmDiscoverStreamData(pmDiscoverStream *, const char *, size_t);
+extern void pmDiscoverStreamClose(pmDiscoverStream *);
+
 /*
  * Interfaces providing PMWEBAPI(3) backward compatibility.
  * Provides live performance data only; no archive support.
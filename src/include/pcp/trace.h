@@ -102,6 +102,7 @@ extern int pmtracestate(int code);
 #define PMTRACE_STATE_PDUBUF  8  /* debug:   internal IPC buffer management */
 #define PMTRACE_STATE_NOAGENT 16 /* debug:   no PMDA communications at all  */
 #define PMTRACE_STATE_ASYNC   32 /* control: use asynchronous PDU protocol  */
+#define PMTRACE_STATE_BATCH   64 /* control: batch asynchronous data PDUs    */
 
 #ifdef __cplusplus
 }
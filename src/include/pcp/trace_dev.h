@@ -30,6 +30,8 @@ extern "C" {
 #define TRACE_ENV_NOAGENT	"PCP_TRACE_NOAGENT"
 #define TRACE_ENV_REQTIMEOUT	"PCP_TRACE_REQTIMEOUT"
 #define TRACE_ENV_RECTIMEOUT	"PCP_TRACE_RECONNECT"
+#define TRACE_ENV_BATCHSIZE	"PCP_TRACE_BATCHSIZE"
+#define TRACE_ENV_BATCHDELAY	"PCP_TRACE_BATCHDELAY"
 #define TRACE_PORT		4323
 #define TRACE_PDU_VERSION	1
 
@@ -77,6 +79,11 @@ extern int __pmtracesendack(int, int);
 extern int __pmtracedecodeack(__pmTracePDU *, int *);
 extern int __pmtracesenddata(int, char *, int, int, double);
 extern int __pmtracedecodedata(__pmTracePDU *, char **, int *, int *, int *, double *);
+extern int __pmtracebatchdata(int, char *, int, int, double);
+extern int __pmtraceflushdata(int);
+
+#define TRACE_BATCH_SIZE	16384	/* default bytes queued before a flush */
+#define TRACE_BATCH_DELAY	1.0	/* default seconds queued before a flush */
 
 #define TRACE_PROTOCOL_FINAL    -1
 #define TRACE_PROTOCOL_QUERY    0
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012-2013 Red Hat.
+ * Copyright (c) 2012-2013,2026 Red Hat.
  * Copyright (c) 1995-2000,2004 Silicon Graphics, Inc.  All Rights Reserved.
  * 
  * This library is free software; you can redistribute it and/or modify it
@@ -17,6 +17,7 @@
 #include <assert.h>
 #include "pmapi.h"
 #include "libpcp.h"
+#define SOCKET_INTERNAL
 #include "internal.h"
 
 static int __pmAccSaveUsers(void);
@@ -26,6 +27,7 @@ static int __pmAccRestoreGroups(void);
 static void __pmAccFreeSavedHosts(void);
 static void __pmAccFreeSavedUsers(void);
 static void __pmAccFreeSavedGroups(void);
+static void acctriefree(void);
 
 /* Host access control list */
 
@@ -44,6 +46,27 @@ static hostinfo	*hostlist;
 static int	nhosts;
 static int	szhostlist;
 
+/*
+ * Compiled form of the host access list, built on first use after the
+ * list changes.  IPv4 and IPv6 entries go into a binary trie for their
+ * address family, keyed on the address bits covered by the entry mask,
+ * so matching a client address takes at most 32 or 128 steps however
+ * long the list is.  Entries for other address families (Unix domain
+ * sockets) or with a mask that is not a prefix are matched by scanning.
+ */
+typedef struct accnode {
+    struct accnode	*child[2];
+    int			*hosts;		/* hostlist[] indices ending here */
+    int			nhosts;
+} accnode;
+
+static int	acccompiled;		/* trie is up to date with hostlist */
+static accnode	*acctrie4;
+static accnode	*acctrie6;
+static int	*accscan;		/* hostlist[] indices not in a trie */
+static int	naccscan;
+static int	*accmatch;		/* hostlist[] indices matching a client */
+
 /* User access control list */
 
 typedef struct {
@@ -185,6 +208,7 @@ __pmAccSaveHosts(void)
     if (saved & HOSTS_SAVED)
 	return PM_ERR_TOOBIG;
 
+    acctriefree();
     saved |= HOSTS_SAVED;
     oldhostlist = hostlist;
     oldnhosts = nhosts;
@@ -241,6 +265,7 @@ accfreehosts(void)
 {
     int		i;
 
+    acctriefree();
     if (szhostlist) {
 	for (i = 0; i < nhosts; i++)
 	    if (hostlist[i].hostspec != NULL)
@@ -1238,6 +1263,7 @@ __pmAccAddHost(const char *name, unsigned int specOps, unsigned int denyOps, int
 	    hp->maxcons = maxcons;
 	    hp->curcons = 0;
 	    nhosts++;
+	    acctriefree();
 	}
 	/* Count the found hosts. */
 	++found;
@@ -1340,6 +1366,188 @@ freeClientIds(__pmSockAddr **clientIds)
     free(clientIds);
 }
 
+static void
+accnodefree(accnode *np)
+{
+    if (np != NULL) {
+	accnodefree(np->child[0]);
+	accnodefree(np->child[1]);
+	free(np->hosts);
+	free(np);
+    }
+}
+
+/* Discard the compiled host access list, rebuilt when next needed. */
+static void
+acctriefree(void)
+{
+    accnodefree(acctrie4);
+    accnodefree(acctrie6);
+    acctrie4 = acctrie6 = NULL;
+    free(accscan);
+    accscan = NULL;
+    naccscan = 0;
+    free(accmatch);
+    accmatch = NULL;
+    acccompiled = 0;
+}
+
+/*
+ * Address bytes of an IPv4 or IPv6 address, NULL for other families.
+ */
+static const unsigned char *
+accaddrbytes(const __pmSockAddr *addr, int *nbits)
+{
+    if (addr->sockaddr.raw.sa_family == AF_INET) {
+	*nbits = 32;
+	return (const unsigned char *)&addr->sockaddr.inet.sin_addr.s_addr;
+    }
+    if (addr->sockaddr.raw.sa_family == AF_INET6) {
+	*nbits = 128;
+	return addr->sockaddr.ipv6.sin6_addr.s6_addr;
+    }
+    return NULL;
+}
+
+#define ACCBIT(bytes, n)	(((bytes)[(n) >> 3] >> (7 - ((n) & 7))) & 1)
+
+/*
+ * Number of leading one bits in mask, or -1 if the mask is not a prefix.
+ */
+static int
+accprefixlen(const unsigned char *mask, int nbits)
+{
+    int		n, i;
+
+    for (n = 0; n < nbits && ACCBIT(mask, n); n++)
+	;
+    for (i = n; i < nbits; i++)
+	if (ACCBIT(mask, i))
+	    return -1;
+    return n;
+}
+
+static void
+acctrieadd(accnode **root, const unsigned char *addr, int plen, int host)
+{
+    accnode	**npp = root;
+    size_t	need;
+    int		n = 0;
+
+    for (;;) {
+	if (*npp == NULL && (*npp = (accnode *)calloc(1, sizeof(accnode))) == NULL)
+	    pmNoMem("AddClient trie", sizeof(accnode), PM_FATAL_ERR);
+	if (n == plen)
+	    break;
+	npp = &(*npp)->child[ACCBIT(addr, n)];
+	n++;
+    }
+    need = ((*npp)->nhosts + 1) * sizeof(int);
+    if (((*npp)->hosts = (int *)realloc((*npp)->hosts, need)) == NULL)
+	pmNoMem("AddClient trie hosts", need, PM_FATAL_ERR);
+    (*npp)->hosts[(*npp)->nhosts++] = host;
+}
+
+/*
+ * Build the compiled form of the host access list.  The local host
+ * addresses are looked up here too (for localhost clients), so that
+ * no name service lookups are made when admitting clients.
+ */
+static void
+acccompile(void)
+{
+    const unsigned char	*addr, *mask;
+    hostinfo		*hp;
+    size_t		need;
+    int			i, j, nbits, plen;
+
+    acctriefree();
+    need = (nhosts ? nhosts : 1) * sizeof(int);
+    if ((accscan = (int *)malloc(need)) == NULL)
+	pmNoMem("AddClient scan", need, PM_FATAL_ERR);
+    if ((accmatch = (int *)malloc(need)) == NULL)
+	pmNoMem("AddClient match", need, PM_FATAL_ERR);
+
+    for (i = 0; i < nhosts; i++) {
+	hp = &hostlist[i];
+	if ((mask = accaddrbytes(hp->hostmask, &nbits)) == NULL ||
+	    hp->hostid->sockaddr.raw.sa_family != hp->hostmask->sockaddr.raw.sa_family ||
+	    (plen = accprefixlen(mask, nbits)) < 0) {
+	    accscan[naccscan++] = i;
+	    continue;
+	}
+	/* bits set outside the mask, as for the scan this never matches */
+	addr = accaddrbytes(hp->hostid, &nbits);
+	for (j = plen; j < nbits; j++)
+	    if (ACCBIT(addr, j))
+		break;
+	if (j < nbits)
+	    continue;
+	acctrieadd(nbits == 32 ? &acctrie4 : &acctrie6, addr, plen, i);
+    }
+
+    PM_INIT_LOCKS();
+    PM_LOCK(__pmLock_libpcp);
+    if (!gotmyhostid)
+	getmyhostid();
+    PM_UNLOCK(__pmLock_libpcp);
+
+    acccompiled = 1;
+    if (pmDebugOptions.access)
+	fprintf(stderr, "acccompile: %d host entries, %d not in trie\n",
+		nhosts, naccscan);
+}
+
+/*
+ * Find all host access list entries matching the client address, in
+ * accmatch[] in descending hostlist[] order (most general first) as
+ * for a backwards scan of the list.  Returns the number of matches.
+ */
+static int
+accmatchclient(const __pmSockAddr *clientId)
+{
+    const unsigned char	*addr;
+    __pmSockAddr	*matchId;
+    accnode		*np;
+    hostinfo		*hp;
+    int			i, j, k, n = 0, nbits, host;
+
+    if (!acccompiled)
+	acccompile();
+
+    for (i = 0; i < naccscan; i++) {
+	hp = &hostlist[accscan[i]];
+	/* At a minumum, the addresses must be from the same family. */
+	if (__pmSockAddrGetFamily(clientId) == __pmSockAddrGetFamily(hp->hostmask)) {
+	    matchId = __pmSockAddrDup(clientId);
+	    __pmSockAddrMask(matchId, hp->hostmask);
+	    if (__pmSockAddrCompare(matchId, hp->hostid) == 0)
+		accmatch[n++] = accscan[i];
+	    __pmSockAddrFree(matchId);
+	}
+    }
+
+    if ((addr = accaddrbytes(clientId, &nbits)) != NULL) {
+	np = (nbits == 32) ? acctrie4 : acctrie6;
+	for (i = 0; np != NULL; i++) {
+	    for (j = 0; j < np->nhosts; j++)
+		accmatch[n++] = np->hosts[j];
+	    if (i == nbits)
+		break;
+	    np = np->child[ACCBIT(addr, i)];
+	}
+    }
+
+    /* insertion sort, there are only ever a handful of matches */
+    for (i = 1; i < n; i++) {
+	host = accmatch[i];
+	for (k = i; k > 0 && accmatch[k-1] < host; k--)
+	    accmatch[k] = accmatch[k-1];
+	accmatch[k] = host;
+    }
+    return n;
+}
+
 /* Called after accepting new client's connection to check that another
  * connection from its host is permitted and to find which operations the
  * client is permitted to perform.
@@ -1356,7 +1564,7 @@ __pmAccAddClient(__pmSockAddr *hostid, unsigned int *denyOpsResult)
     int			clientIx;
     __pmSockAddr	**clientIds;
     __pmSockAddr	*clientId;
-    __pmSockAddr	*matchId;
+    int			nmatch;
 
     if (PM_MULTIPLE_THREADS(PM_SCOPE_ACL))
 	return PM_ERR_THREAD;
@@ -1390,20 +1598,13 @@ __pmAccAddClient(__pmSockAddr *hostid, unsigned int *denyOpsResult)
     /* Accumulate permissions for each client address. */
     for (clientIx = 0; clientIds[clientIx] != NULL; ++clientIx) {
 	clientId = clientIds[clientIx];
-	for (i = nhosts - 1; i >= 0; i--) {
-	    hp = &hostlist[i];
-	    /* At a minumum, the addresses must be from the same family. */
-	    if (__pmSockAddrGetFamily(clientId) == __pmSockAddrGetFamily(hp->hostmask)) {
-		matchId = __pmSockAddrDup(clientId);
-		__pmSockAddrMask(matchId, hp->hostmask);
-		if (__pmSockAddrCompare(matchId, hp->hostid) == 0) {
-		    /* Clobber specified ops then set. Leave unspecified ops alone. */
-		    *denyOpsResult &= ~hp->specOps;
-		    *denyOpsResult |= hp->denyOps;
-		    lastmatch = hp;
-		}
-		__pmSockAddrFree(matchId);
-	    }
+	nmatch = accmatchclient(clientId);
+	for (i = 0; i < nmatch; i++) {
+	    hp = &hostlist[accmatch[i]];
+	    /* Clobber specified ops then set. Leave unspecified ops alone. */
+	    *denyOpsResult &= ~hp->specOps;
+	    *denyOpsResult |= hp->denyOps;
+	    lastmatch = hp;
 	}
 	/* no matching entry in hostlist => allow all */
 
@@ -1440,18 +1641,10 @@ __pmAccAddClient(__pmSockAddr *hostid, unsigned int *denyOpsResult)
 	 * host access list that match the client's IP address.  A client may
 	 * contribute to several connection counts because of wildcarding.
 	 */
-	for (i = 0; i < nhosts; i++) {
-	    hp = &hostlist[i];
-	    /* At a minumum, the addresses must be from the same family. */
-	    if (__pmSockAddrGetFamily(clientId) == __pmSockAddrGetFamily(hp->hostmask)) {
-		matchId = __pmSockAddrDup(clientId);
-		__pmSockAddrMask(matchId, hp->hostmask);
-		if (__pmSockAddrCompare(matchId, hp->hostid) == 0) {
-		    if (hp->maxcons)
-			hp->curcons++;
-		}
-		__pmSockAddrFree(matchId);
-	    }
+	for (i = 0; i < nmatch; i++) {
+	    hp = &hostlist[accmatch[i]];
+	    if (hp->maxcons)
+		hp->curcons++;
 	}
     }
 
@@ -1475,7 +1668,7 @@ __pmAccDelClient(__pmSockAddr *hostid)
     int		clientIx;
     __pmSockAddr **clientIds;
     __pmSockAddr *clientId;
-    __pmSockAddr *matchId;
+    int		nmatch;
 
     if (PM_MULTIPLE_THREADS(PM_SCOPE_ACL))
 	return;
@@ -1491,18 +1684,11 @@ __pmAccDelClient(__pmSockAddr *hostid)
      */
     for (clientIx = 0; clientIds[clientIx] != NULL; ++clientIx) {
 	clientId = clientIds[clientIx];
-	for (i = 0; i < nhosts; i++) {
-	    hp = &hostlist[i];
-	    /* At a minumum, the addresses must be from the same family. */
-	    if (__pmSockAddrGetFamily(clientId) == __pmSockAddrGetFamily(hp->hostmask)) {
-		matchId = __pmSockAddrDup(clientId);
-		__pmSockAddrMask(matchId, hp->hostmask);
-		if (__pmSockAddrCompare(matchId, hp->hostid) == 0) {
-		    if (hp->maxcons)
-			hp->curcons--;
-		}
-		__pmSockAddrFree(matchId);
-	    }
+	nmatch = accmatchclient(clientId);
+	for (i = 0; i < nmatch; i++) {
+	    hp = &hostlist[accmatch[i]];
+	    if (hp->maxcons)
+		hp->curcons--;
 	}
     }
     freeClientIds(clientIds);
@@ -24,6 +24,9 @@
 #ifdef HAVE_NETIOAPI_H
 #include <netioapi.h>
 #endif
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#endif
 #define SOCKET_INTERNAL
 #include "internal.h"
 
@@ -1470,6 +1473,33 @@ __pmGetSockOpt(int socket, int level, int option_name, void *option_value,
     return getsockopt(socket, level, option_name, option_value, option_len);
 }
 
+/*
+ * Wait for input on a single file descriptor, as select(2) would.
+ * With poll(2) there is no FD_SETSIZE limit on the value of fd, which
+ * matters for servers like pmcd with very many client connections.
+ */
+int
+__pmFdReadyRead(int fd, struct timeval *timeout)
+{
+#if defined(HAVE_POLL_H)
+    struct pollfd	pfd;
+    int			msec = -1;
+
+    if (timeout != NULL)
+	msec = timeout->tv_sec * 1000 + (timeout->tv_usec + 999) / 1000;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    return poll(&pfd, 1, msec);
+#else
+    __pmFdSet	onefd;
+
+    FD_ZERO(&onefd);
+    FD_SET(fd, &onefd);
+    return select(fd+1, &onefd, NULL, NULL, timeout);
+#endif
+}
+
 #if !defined(HAVE_SECURE_SOCKETS)
 
 void
@@ -1629,14 +1659,10 @@ __pmRecv(int socket, void *buffer, size_t length, int flags)
 int
 __pmSocketReady(int fd, struct timeval *timeout)
 {
-    __pmFdSet	onefd;
-
     if (fd < 0)
 	return -EBADF;
 
-    FD_ZERO(&onefd);
-    FD_SET(fd, &onefd);
-    return select(fd+1, &onefd, NULL, NULL, timeout);
+    return __pmFdReadyRead(fd, timeout);
 }
 
 #endif /* !HAVE_SECURE_SOCKETS */
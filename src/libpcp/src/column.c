@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * Columnar form of the values for one metric in a result.
+ *
+ * Consumers of a pmResult (or pmHighResResult) usually walk the
+ * pmValueSet one pmValue at a time and call pmExtractValue() for each
+ * instance.  __pmExtractColumn() does this once for the whole
+ * pmValueSet, producing a contiguous array of instance identifiers
+ * and a contiguous array of values of the one requested type, so the
+ * caller can then convert, scale or rate convert the values as a
+ * vector.  The conversions and errors are exactly those of
+ * pmExtractValue(), but the common lossless cases (no conversion, or
+ * widening to 64-bit or double) avoid the per-value call.
+ *
+ * A __pmColumn may be re-used for many calls to __pmExtractColumn(),
+ * the arrays only grow, and __pmFreeColumn() releases them.
+ */
+
+#include "pmapi.h"
+#include "libpcp.h"
+#include "fault.h"
+
+#if defined(HAVE_CONST_LONGLONG)
+#define SIGN_64_MASK 0x8000000000000000LL
+#else
+#define SIGN_64_MASK 0x8000000000000000
+#endif
+
+static int
+column_grow(__pmColumn *cp, int numval)
+{
+    int		*inst;
+    int		*sts;
+    void	*vp;
+
+    if (numval <= cp->maxval)
+	return 0;
+PM_FAULT_POINT("libpcp/" __FILE__ ":1", PM_FAULT_ALLOC);
+    if ((inst = (int *)realloc(cp->inst, numval * sizeof(int))) == NULL)
+	return -oserror();
+    cp->inst = inst;
+    if ((sts = (int *)realloc(cp->sts, numval * sizeof(int))) == NULL)
+	return -oserror();
+    cp->sts = sts;
+    /* room for the widest type, so the column can be re-used for any type */
+    if ((vp = realloc(cp->value.vp, numval * sizeof(pmAtomValue))) == NULL)
+	return -oserror();
+    cp->value.vp = vp;
+    cp->maxval = numval;
+    return 0;
+}
+
+static void
+column_put(__pmColumn *cp, int i, const pmAtomValue *avp)
+{
+    switch (cp->type) {
+	case PM_TYPE_32:
+	    cp->value.l[i] = avp->l;
+	    break;
+	case PM_TYPE_U32:
+	    cp->value.ul[i] = avp->ul;
+	    break;
+	case PM_TYPE_64:
+	    cp->value.ll[i] = avp->ll;
+	    break;
+	case PM_TYPE_U64:
+	    cp->value.ull[i] = avp->ull;
+	    break;
+	case PM_TYPE_FLOAT:
+	    cp->value.f[i] = avp->f;
+	    break;
+	case PM_TYPE_DOUBLE:
+	    cp->value.d[i] = avp->d;
+	    break;
+    }
+}
+
+/*
+ * the value for vlist[i], as for pmExtractValue(), into the column
+ */
+static void
+column_extract(__pmColumn *cp, const pmValueSet *vsp, int i, int itype)
+{
+    pmAtomValue	av;
+
+    cp->sts[i] = pmExtractValue(vsp->valfmt, &vsp->vlist[i], itype, &av, cp->type);
+    if (cp->sts[i] < 0) {
+	/* as pmExtractValue(), the value is 0 after an error */
+	av.ll = 0;
+	cp->nerr++;
+    }
+    column_put(cp, i, &av);
+}
+
+/*
+ * true if the pmValueBlock holds a value of type itype and size bytes,
+ * else the caller should use pmExtractValue() for this value
+ */
+static inline int
+pval_ok(const pmValueBlock *vbp, int itype, size_t size)
+{
+    return vbp->vlen == PM_VAL_HDR_SIZE + size &&
+	   (vbp->vtype == itype || vbp->vtype == 0);
+}
+
+static inline double
+u64_to_double(__uint64_t usrc)
+{
+#if !defined(HAVE_CAST_U64_DOUBLE)
+    if (SIGN_64_MASK & usrc)
+	return (double) (__int64_t) (usrc & (~SIGN_64_MASK)) + (__uint64_t) SIGN_64_MASK;
+    return (double) (__int64_t) usrc;
+#else
+    return (double) usrc;
+#endif
+}
+
+/*
+ * Extract all of the values from the pmValueSet vsp, of type itype
+ * (from the pmDesc for the metric), into the column cp as values of
+ * type otype, which must be one of the numeric types.
+ *
+ * Returns the number of values, or the error from vsp->numval, or a
+ * negative error code if the column cannot be filled.  Errors from
+ * converting individual values are returned in cp->sts[] (cp->nerr
+ * counts them) and the corresponding value is 0.
+ */
+int
+__pmExtractColumn(const pmValueSet *vsp, int itype, int otype, __pmColumn *cp)
+{
+    const pmValue	*vp;
+    int			numval = vsp->numval;
+    int			i;
+    int			sts;
+
+    switch (otype) {
+	case PM_TYPE_32:
+	case PM_TYPE_U32:
+	case PM_TYPE_64:
+	case PM_TYPE_U64:
+	case PM_TYPE_FLOAT:
+	case PM_TYPE_DOUBLE:
+	    break;
+	default:
+	    return PM_ERR_TYPE;
+    }
+
+    cp->pmid = vsp->pmid;
+    cp->type = otype;
+    cp->nerr = 0;
+    cp->numval = numval;
+    if (numval <= 0)
+	return numval;
+    if ((sts = column_grow(cp, numval)) < 0) {
+	cp->numval = 0;
+	return sts;
+    }
+
+    for (i = 0; i < numval; i++)
+	cp->inst[i] = vsp->vlist[i].inst;
+    memset(cp->sts, 0, numval * sizeof(int));
+
+    vp = vsp->vlist;
+    if (vsp->valfmt == PM_VAL_INSITU) {
+	if ((itype == PM_TYPE_32 || itype == PM_TYPE_UNKNOWN) && otype == PM_TYPE_32) {
+	    for (i = 0; i < numval; i++)
+		cp->value.l[i] = vp[i].value.lval;
+	}
+	else if (itype == PM_TYPE_U32 && otype == PM_TYPE_U32) {
+	    for (i = 0; i < numval; i++)
+		cp->value.ul[i] = (__uint32_t)vp[i].value.lval;
+	}
+	else if ((itype == PM_TYPE_32 || itype == PM_TYPE_UNKNOWN) && otype == PM_TYPE_64) {
+	    for (i = 0; i < numval; i++)
+		cp->value.ll[i] = (__int64_t)vp[i].value.lval;
+	}
+	else if (itype == PM_TYPE_U32 && (otype == PM_TYPE_64 || otype == PM_TYPE_U64)) {
+	    for (i = 0; i < numval; i++)
+		cp->value.ll[i] = (__int64_t)(__uint32_t)vp[i].value.lval;
+	}
+	else if ((itype == PM_TYPE_32 || itype == PM_TYPE_UNKNOWN) && otype == PM_TYPE_DOUBLE) {
+	    for (i = 0; i < numval; i++)
+		cp->value.d[i] = (double)vp[i].value.lval;
+	}
+	else if (itype == PM_TYPE_U32 && otype == PM_TYPE_DOUBLE) {
+	    for (i = 0; i < numval; i++)
+		cp->value.d[i] = (double)(__uint32_t)vp[i].value.lval;
+	}
+	else {
+	    for (i = 0; i < numval; i++)
+		column_extract(cp, vsp, i, itype);
+	}
+    }
+    else if (vsp->valfmt == PM_VAL_DPTR || vsp->valfmt == PM_VAL_SPTR) {
+	__int64_t	ll;
+	__uint64_t	ull;
+
+	if ((itype == PM_TYPE_64 || itype == PM_TYPE_U64 || itype == PM_TYPE_DOUBLE) &&
+	    itype == otype) {
+	    for (i = 0; i < numval; i++) {
+		if (pval_ok(vp[i].value.pval, itype, sizeof(ll)))
+		    memcpy(&cp->value.ll[i], vp[i].value.pval->vbuf, sizeof(ll));
+		else
+		    column_extract(cp, vsp, i, itype);
+	    }
+	}
+	else if (itype == PM_TYPE_64 && otype == PM_TYPE_DOUBLE) {
+	    for (i = 0; i < numval; i++) {
+		if (pval_ok(vp[i].value.pval, itype, sizeof(ll))) {
+		    memcpy(&ll, vp[i].value.pval->vbuf, sizeof(ll));
+		    cp->value.d[i] = (double)ll;
+		}
+		else
+		    column_extract(cp, vsp, i, itype);
+	    }
+	}
+	else if (itype == PM_TYPE_U64 && otype == PM_TYPE_DOUBLE) {
+	    for (i = 0; i < numval; i++) {
+		if (pval_ok(vp[i].value.pval, itype, sizeof(ull))) {
+		    memcpy(&ull, vp[i].value.pval->vbuf, sizeof(ull));
+		    cp->value.d[i] = u64_to_double(ull);
+		}
+		else
+		    column_extract(cp, vsp, i, itype);
+	    }
+	}
+	else if (itype == PM_TYPE_FLOAT && otype == PM_TYPE_DOUBLE) {
+	    float	f;
+
+	    for (i = 0; i < numval; i++) {
+		if (pval_ok(vp[i].value.pval, itype, sizeof(f))) {
+		    memcpy(&f, vp[i].value.pval->vbuf, sizeof(f));
+		    cp->value.d[i] = (double)f;
+		}
+		else
+		    column_extract(cp, vsp, i, itype);
+	    }
+	}
+	else {
+	    for (i = 0; i < numval; i++)
+		column_extract(cp, vsp, i, itype);
+	}
+    }
+    else {
+	for (i = 0; i < numval; i++)
+	    column_extract(cp, vsp, i, itype);
+    }
+
+    return numval;
+}
+
+/*
+ * Index of instance inst in the column, trying index hint first
+ * (values for the same metric in successive results are usually in
+ * the same order), else -1
+ */
+int
+__pmColumnIndex(const __pmColumn *cp, int inst, int hint)
+{
+    int		i;
+
+    if (hint >= 0 && hint < cp->numval && cp->inst[hint] == inst)
+	return hint;
+    for (i = 0; i < cp->numval; i++) {
+	if (cp->inst[i] == inst)
+	    return i;
+    }
+    return -1;
+}
+
+void
+__pmFreeColumn(__pmColumn *cp)
+{
+    free(cp->inst);
+    free(cp->sts);
+    free(cp->value.vp);
+    memset(cp, 0, sizeof(*cp));
+}
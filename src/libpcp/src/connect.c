@@ -135,6 +135,14 @@ check_feature_flags(int ctxflags, int features, int local_conn)
 	}
     }
 
+    /*
+     * Descriptors and instances sent ahead of fetch results are only
+     * useful if there is a lookup cache to put them in, and pmcd may
+     * not offer them, in which case the client looks them up itself.
+     */
+    if ((features & PDU_FLAG_METADATA) && __pmLookupCacheMetadata())
+	pduflags |= PDU_FLAG_METADATA;
+
     if (ctxflags) {
 	/*
 	 * If an optional connection feature (e.g. encryption) is
@@ -157,8 +165,13 @@ check_feature_flags(int ctxflags, int features, int local_conn)
 		return -EOPNOTSUPP;
 	    }
 	}
-	if (ctxflags & PM_CTXFLAG_COMPRESS)
-	    return -EOPNOTSUPP;
+	/*
+	 * Compression is a transfer optimisation rather than a security
+	 * property, so quietly fall back to the regular result encoding
+	 * if pmcd does not offer the compact one.
+	 */
+	if ((ctxflags & PM_CTXFLAG_COMPRESS) && (features & PDU_FLAG_COMPACT))
+	    pduflags |= PDU_FLAG_COMPACT;
 	if (ctxflags & PM_CTXFLAG_AUTH) {
 	    if (features & PDU_FLAG_AUTH)
 		pduflags |= PDU_FLAG_AUTH;
@@ -269,6 +282,7 @@ __pmConnectHandshake(int fd, const char *hostname, int ctxflags, __pmHashCtl *at
 	    __pmVersionCred	handshake;
 	    int			pduflags;
 	    int			local_conn;
+	    int			shmfd = -1;
 
 	    local_conn = is_local_connection(hostname, attrs);
 
@@ -284,6 +298,16 @@ __pmConnectHandshake(int fd, const char *hostname, int ctxflags, __pmHashCtl *at
 		return ok;
 	    }
 
+	    /*
+	     * On the local unix domain socket, offer pmcd a shared memory
+	     * ring for the (large) PDUs it sends back, quietly continuing
+	     * with PDUs sent inline on the socket if that is not possible.
+	     */
+	    if ((pduinfo.features & PDU_FLAG_SHM) &&
+		(pduflags & PDU_FLAG_SECURE) == 0 &&
+		(shmfd = __pmShmCreateLocal(fd)) >= 0)
+		pduflags |= PDU_FLAG_SHM;
+
 	    /*
 	     * Negotiate connection version and features (via creds PDU)
 	     */
@@ -293,12 +317,31 @@ __pmConnectHandshake(int fd, const char *hostname, int ctxflags, __pmHashCtl *at
 	    handshake.c_flags = pduflags;
 	    sts = __pmSendCreds(fd, (int)getpid(), 1, (__pmCred *)&handshake);
 
+	    /*
+	     * pmcd now expects the ring to follow, even if it could not be
+	     * attached here (in which case none is sent), and will use it
+	     * from the next PDU it sends on this connection.
+	     */
+	    if (shmfd >= 0) {
+		if (sts >= 0) {
+		    if (__pmSetShmIPC(fd, shmfd, PDU_SHM_RECV) < 0) {
+			close(shmfd);
+			shmfd = -1;
+		    }
+		    sts = __pmShmSendFd(fd, shmfd);
+		}
+		if (shmfd >= 0)
+		    close(shmfd);
+	    }
+
 	    /*
 	     * At this point we know the caller wants to set channel options
 	     * and pmcd supports them so go ahead and update the socket (this
 	     * completes the TLS handshake in encrypting mode, authentication
 	     * via SASL, and any other requested connection attributes).
 	     */
+	    /* no attributes, just result encoding, content and transport */
+	    pduflags &= ~(PDU_FLAG_COMPACT | PDU_FLAG_METADATA | PDU_FLAG_SHM);
 	    if (sts >= 0 && pduflags)
 		sts = attributes_handshake(fd, pduflags, hostname, attrs);
 	}
@@ -19,7 +19,11 @@
  * curr_ctx needs to be thread-private
  *
  * contexts[], contexts_map[], contexts_len and last_handle are protected
- * from changes * using the local contexts_lock mutex.
+ * from changes * using the local contexts_lock mutex.  Readers resolving
+ * a handle in __pmHandleToPtr() do not take contexts_lock at all; they
+ * scan the published contexts_tab with atomic loads, so every store to
+ * a slot must go through store_context() and store_map(), and the
+ * arrays are replaced (never realloc'd or freed) when they need to grow.
  *
  * Ditto for back n_backoff, def_backoff[] and backoff[].
  *
@@ -28,6 +32,9 @@
  * and pmDupContext(), then locked in __pmHandleToPtr() ... it is
  * the responsibility of all __pmHandleToPtr() callers to call
  * PM_UNLOCK(ctxp->c_lock) when they are finished with the context.
+ * A __pmContext is never freed, only reused in the same slot, which is
+ * what lets __pmHandleToPtr() lock a context it found without holding
+ * contexts_lock and then re-check that the handle still maps to it.
  */
 
 #include "pmapi.h"
@@ -46,6 +53,23 @@ static int		last_handle = -1;	/* last returned context handle */
  */
 static int		*contexts_map;
 
+/*
+ * contexts[] and contexts_map[] live in a ctxtab_t, published through
+ * contexts_tab for the lock-free readers.  When the table fills up a
+ * table twice the size replaces it, and the old one is kept on the
+ * prev chain because a reader may still be scanning it; the retired
+ * tables together are never larger than the current one.
+ */
+typedef struct ctxtab {
+    int			len;		/* slots in use, == contexts_len */
+    int			alloc;		/* slots allocated */
+    int			*map;		/* contexts_map[] */
+    __pmContext		**ctx;		/* contexts[] */
+    struct ctxtab	*prev;		/* retired, smaller table */
+} ctxtab_t;
+
+static ctxtab_t		*contexts_tab;
+
 /*
  * Special sentinals for contexts_map[] ...
  */
@@ -113,6 +137,87 @@ map_handle(int handle)
     return map_handle_nolock(handle);
 }
 
+/*
+ * Slot updates, called with contexts_lock held.  The release stores
+ * pair with the acquire loads in __pmHandleToPtr(), so a reader that
+ * sees a handle in contexts_map[] also sees the contexts[] entry that
+ * was stored before it.
+ */
+static void
+store_context(int i, __pmContext *ctxp)
+{
+    PM_ASSERT_IS_LOCKED(contexts_lock);
+
+    __atomic_store_n(&contexts[i], ctxp, __ATOMIC_RELEASE);
+}
+
+static void
+store_map(int i, int handle)
+{
+    PM_ASSERT_IS_LOCKED(contexts_lock);
+
+    __atomic_store_n(&contexts_map[i], handle, __ATOMIC_RELEASE);
+}
+
+/*
+ * Make room for at least one more slot, called with contexts_lock held.
+ */
+static int
+grow_contexts(void)
+{
+    ctxtab_t	*tab;
+    size_t	size;
+    int		alloc;
+    int		i;
+
+    PM_ASSERT_IS_LOCKED(contexts_lock);
+
+    if (contexts_tab != NULL && contexts_len < contexts_tab->alloc)
+	return 0;
+
+    alloc = contexts_tab ? 2 * contexts_tab->alloc : 4;
+    size = sizeof(ctxtab_t) + alloc * (sizeof(__pmContext *) + sizeof(int));
+    if ((tab = (ctxtab_t *)malloc(size)) == NULL)
+	return -oserror();
+    tab->len = contexts_len;
+    tab->alloc = alloc;
+    tab->ctx = (__pmContext **)&tab[1];
+    tab->map = (int *)&tab->ctx[alloc];
+    tab->prev = contexts_tab;
+    for (i = 0; i < contexts_len; i++) {
+	tab->ctx[i] = contexts[i];
+	tab->map[i] = contexts_map[i];
+    }
+    for (; i < alloc; i++) {
+	tab->ctx[i] = NULL;
+	tab->map[i] = MAP_FREE;
+    }
+    contexts = tab->ctx;
+    contexts_map = tab->map;
+    __atomic_store_n(&contexts_tab, tab, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/*
+ * Lock-free search of a published table for handle, trying the slot
+ * hint first.
+ */
+static int
+lookup_slot(ctxtab_t *tab, int handle, int hint)
+{
+    int		len = __atomic_load_n(&tab->len, __ATOMIC_ACQUIRE);
+    int		i;
+
+    if (hint >= 0 && hint < len &&
+	__atomic_load_n(&tab->map[hint], __ATOMIC_ACQUIRE) == handle)
+	return hint;
+    for (i = 0; i < len; i++) {
+	if (__atomic_load_n(&tab->map[i], __ATOMIC_ACQUIRE) == handle)
+	    return i;
+    }
+    return -1;
+}
+
 static void
 waitawhile(__pmPMCDCtl *ctl)
 {
@@ -185,39 +290,83 @@ waitawhile(__pmPMCDCtl *ctl)
 __pmContext *
 __pmHandleToPtr(int handle)
 {
+    ctxtab_t	*tab;
+    __pmContext	*ctxp;
+    int		hint = -1;
     int		i;
 
+    if (handle < 0)
+	return NULL;
+    if (handle == PM_TPD(curr_handle) && PM_TPD(curr_ctxp) != NULL)
+	hint = PM_TPD(curr_ctxp)->c_slot;
+
+    if ((tab = __atomic_load_n(&contexts_tab, __ATOMIC_ACQUIRE)) == NULL)
+	return NULL;
+    if ((i = lookup_slot(tab, handle, hint)) < 0)
+	return NULL;
+    ctxp = __atomic_load_n(&tab->ctx[i], __ATOMIC_ACQUIRE);
+    /* the being_initialized stub in pmNewContext() is PM_CONTEXT_INIT */
+    if (ctxp == NULL || ctxp->c_type <= PM_CONTEXT_UNDEF)
+	return NULL;
+
+    /*
+     * Important Note:
+     *   Once c_lock is locked for _any_ context, the caller
+     *   cannot call into the routines here where contexts_lock
+     *   is acquired without first releasing the c_lock for all
+     *   contexts that are locked.
+     */
+    PM_LOCK(ctxp->c_lock);
+
+    /*
+     * Without contexts_lock the context may have been destroyed, and
+     * even reused for another handle, between the search above and the
+     * lock being granted.  pmDestroyContext() marks the slot while
+     * holding c_lock, so now that we hold it the current table tells us
+     * whether this is still the context for handle.
+     */
+    tab = __atomic_load_n(&contexts_tab, __ATOMIC_ACQUIRE);
+    i = ctxp->c_slot;
+    if (ctxp->c_handle == handle && ctxp->c_type > PM_CONTEXT_UNDEF &&
+	i >= 0 && i < __atomic_load_n(&tab->len, __ATOMIC_ACQUIRE) &&
+	__atomic_load_n(&tab->map[i], __ATOMIC_ACQUIRE) == handle &&
+	__atomic_load_n(&tab->ctx[i], __ATOMIC_ACQUIRE) == ctxp)
+	return ctxp;
+    PM_UNLOCK(ctxp->c_lock);
+    return NULL;
+}
+
+/*
+ * Lock several contexts at once, for pmFetchMany().  contexts_lock is
+ * held while all the c_locks are acquired, so concurrent callers of
+ * this routine are serialized against each other and against context
+ * creation and destruction.  Unknown handles, and repeats of a handle
+ * earlier in the list, give NULL.
+ */
+void
+__pmHandleToPtrList(int n, const int *handles, __pmContext **ctxps)
+{
+    int		i, j, k;
+
     PM_LOCK(contexts_lock);
-    for (i = 0; i < contexts_len; i++) {
-	if (contexts_map[i] == handle && contexts_map[i] >= 0) {
-	    if (contexts[i]->c_type > PM_CONTEXT_UNDEF) {
-		__pmContext	*sts = contexts[i];
-		/*
-		 * Important Note:
-		 *   Once c_lock is locked for _any_ context, the caller
-		 *   cannot call into the routines here where contexts_lock
-		 *   is acquired without first releasing the c_lock for all
-		 *   contexts that are locked.
-		 */
-		PM_LOCK(sts->c_lock);
-		/*
-		 * Note:
-		 *   Since we're holding the contexts_lock no
-		 *   pmDestroyContext() for this context can happen between
-		 *   the test above and the lock being granted ... and
-		 *   without a pmContextDestroy() there can be no reuse
-		 *   of the __pmContext struct, so the asserts below are
-		 *   to-be-sure-to-be-sure.
-		 */
-		PM_UNLOCK(contexts_lock);
-		assert(sts->c_handle == handle);
-		assert(sts->c_type > PM_CONTEXT_UNDEF);
-		return sts;
+    for (k = 0; k < n; k++) {
+	ctxps[k] = NULL;
+	for (j = 0; j < k; j++) {
+	    if (handles[j] == handles[k])
+		break;
+	}
+	if (j < k)
+	    continue;
+	for (i = 0; i < contexts_len; i++) {
+	    if (contexts_map[i] == handles[k] && contexts_map[i] >= 0 &&
+		contexts[i]->c_type > PM_CONTEXT_UNDEF) {
+		ctxps[k] = contexts[i];
+		PM_LOCK(ctxps[k]->c_lock);
+		break;
 	    }
 	}
     }
     PM_UNLOCK(contexts_lock);
-    return NULL;
 }
 
 int
@@ -814,6 +963,8 @@ initarchive(__pmContext	*ctxp, const char *name, int chkfeatures)
     acp->ac_log_list = NULL;
     acp->ac_log = NULL;
     acp->ac_mark_done = 0;
+    acp->ac_prefetch = 0;
+    acp->ac_memctl = NULL;
     acp->ac_chkfeatures = chkfeatures;
 
     /*
@@ -981,12 +1132,12 @@ initarchive(__pmContext	*ctxp, const char *name, int chkfeatures)
     acp->ac_offset = __pmLogLabelSize(acp->ac_log);
     acp->ac_vol = acp->ac_curvol;
     acp->ac_serial = 0;		/* not serial access, yet */
-    acp->ac_pmid_hc.nodes = 0;	/* empty hash list */
-    acp->ac_pmid_hc.hsize = 0;
+    __pmOAHashInit(&acp->ac_pmid_hc);	/* empty hash list */
     acp->ac_end = 0.0;
     acp->ac_want = NULL;
     acp->ac_unbound = NULL;
     acp->ac_cache = NULL;
+    acp->ac_memctl = NULL;
 
     return 0; /* success */
 
@@ -1028,8 +1179,6 @@ int
 pmNewContext(int type, const char *name)
 {
     __pmContext	*new = NULL;
-    __pmContext	**list;
-    int		*list_map;
     int		i;
     int		sts;
     int		old_curr_handle;
@@ -1073,27 +1222,12 @@ pmNewContext(int type, const char *name)
     }
 
     /* Create a new one */
-    if (contexts == NULL) {
-	list = (__pmContext **)malloc(sizeof(__pmContext *));
-	list_map = (int *)malloc(sizeof(int));
-    }
-    else {
-	list = (__pmContext **)realloc((void *)contexts, (1+contexts_len) * sizeof(__pmContext *));
-	list_map = (int *)realloc((void *)contexts_map, (1+contexts_len) * sizeof(int));
-    }
-    if (list == NULL || list_map == NULL) {
-	sts = -oserror();
+    if ((sts = grow_contexts()) < 0)
 	goto FAILED_LOCKED;
-    }
-    contexts = list;
-    contexts_map = list_map;
     /*
-     * NB: it is harmless (not a leak) if contexts[] and/or contexts_map[]
-     * is realloc'd a little larger, and then the last slot is not
-     * initialized (since context_len is not incremented, and/or
-     * initialization fails.
-     * A subsequent pmNewContext allocation attempt will just do the
-     * realloc again, and that time it'll be a trivial success.
+     * NB: it is harmless (not a leak) if contexts[] and contexts_map[]
+     * have grown, and then the next slot is not used (since contexts_len
+     * is not incremented) because initialization fails.
      */
 
     new = (__pmContext *)malloc(sizeof(__pmContext));
@@ -1105,7 +1239,9 @@ pmNewContext(int type, const char *name)
     initcontextlock(&new->c_lock);
 
     ctxnum = contexts_len;
+    store_context(ctxnum, new);
     contexts_len++;
+    __atomic_store_n(&contexts_tab->len, contexts_len, __ATOMIC_RELEASE);
 
     /*
      * We do not need to hold contexts_lock just for filling of the
@@ -1123,8 +1259,8 @@ INIT_CONTEXT:
     PM_TPD(curr_ctxp) = new;
     PM_TPD(curr_handle) = new->c_handle = ++last_handle;
     new->c_slot = ctxnum;
-    contexts[ctxnum] = &being_initialized;
-    contexts_map[ctxnum] = last_handle;
+    store_context(ctxnum, &being_initialized);
+    store_map(ctxnum, last_handle);
     PM_UNLOCK(contexts_lock);
     /* c_lock not re-initialized, created once from initcontextlock() above */
     new->c_type = (type & PM_CONTEXT_TYPEMASK);
@@ -1133,6 +1269,8 @@ INIT_CONTEXT:
     new->c_delta.sec = new->c_delta.nsec = 0;
     new->c_direction = 0;
     new->c_sent = 0;
+    new->c_lookup = NULL;
+    new->c_async = NULL;
     new->c_flags = (type & ~PM_CONTEXT_TYPEMASK);
     if ((new->c_instprof = (pmProfile *)calloc(1, sizeof(pmProfile))) == NULL) {
 	/*
@@ -1227,7 +1365,7 @@ INIT_CONTEXT:
     /* Take contexts_lock mutex to update contexts[] with this fully operational
        battle station ^W context. */
     PM_LOCK(contexts_lock);
-    contexts[ctxnum] = new;
+    store_context(ctxnum, new);
     PM_UNLOCK(contexts_lock);
 
     /* return the handle to the new (current) context */
@@ -1269,8 +1407,8 @@ FAILED_LOCKED:
         }
         /* We could memset-0 the struct, but this is not really
            necessary.  That's the first thing we'll do in INIT_CONTEXT. */
-        contexts[ctxnum] = new;
-	contexts_map[ctxnum] = MAP_FREE;
+	store_context(ctxnum, new);
+	store_map(ctxnum, MAP_FREE);
     }
     PM_TPD(curr_handle) = old_curr_handle;
     PM_TPD(curr_ctxp) = old_curr_ctxp;
@@ -1355,6 +1493,9 @@ pmReconnectContext(int handle)
 	}
     }
 
+    /* pmcd may have been restarted with a different PMNS or agents */
+    __pmLookupCacheFlush(ctxp);
+
     /* clear any derived metrics and re-bind */
     __dmclosecontext(ctxp);
     __dmopencontext(ctxp);
@@ -1499,9 +1640,9 @@ pmDupContext(void)
 	 * __pmFreeInterpData() to trash our hash list and read cache.
 	 * Start with an empty hash list and read cache for the dup'd context.
 	 */
-	newcon->c_archctl->ac_pmid_hc.nodes = 0;
-	newcon->c_archctl->ac_pmid_hc.hsize = 0;
+	__pmOAHashInit(&newcon->c_archctl->ac_pmid_hc);
 	newcon->c_archctl->ac_cache = NULL;
+	newcon->c_archctl->ac_memctl = NULL;
 
 	/*
 	 * Need a new ac_mfp, but pointing at the same volume so ac_offset
@@ -1581,7 +1722,7 @@ done:
     /* return an error code, or the handle for the new context */
     if (sts < 0 && new >= 0) {
 	PM_LOCK(contexts_lock);
-	contexts_map[ctxnum] = MAP_FREE;
+	store_map(ctxnum, MAP_FREE);
 	PM_UNLOCK(contexts_lock);
     }
 
@@ -1690,7 +1831,7 @@ pmDestroyContext(int handle)
 
     ctxp = contexts[ctxnum];
     PM_LOCK(ctxp->c_lock);
-    contexts_map[ctxnum] = MAP_TEARDOWN;
+    store_map(ctxnum, MAP_TEARDOWN);
     PM_UNLOCK(contexts_lock);
     if (ctxp->c_pmcd != NULL) {
 	__pmPMCDCtlFree(ctxp->c_pmcd);
@@ -1720,6 +1861,10 @@ pmDestroyContext(int handle)
     }
     __pmFreeProfile(ctxp->c_instprof);
     ctxp->c_instprof = NULL;
+    /* Note: __pmLookupCacheFlush sets ctxp->c_lookup = NULL */
+    __pmLookupCacheFlush(ctxp);
+    /* Note: __pmAsyncFree sets ctxp->c_async = NULL */
+    __pmAsyncFree(ctxp);
     /* Note: __dmclosecontext sets ctxp->c_dm = NULL */
     __dmclosecontext(ctxp);
     if (pmDebugOptions.context)
@@ -1729,7 +1874,7 @@ pmDestroyContext(int handle)
     PM_UNLOCK(ctxp->c_lock);
 
     PM_LOCK(contexts_lock);
-    contexts_map[ctxnum] = MAP_FREE;
+    store_map(ctxnum, MAP_FREE);
     PM_UNLOCK(contexts_lock);
 
     sts = 0;
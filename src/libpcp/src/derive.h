@@ -31,14 +31,20 @@ typedef struct {		/* one value in the expression tree */
 typedef struct {		/* dynamic information for an expression node */
     pmID		pmid;
     int			numval;		/* length of ivlist[] */
+    int			maxval;		/* allocated length of ivlist[] */
+    int			fastop;		/* 1 for type-specialised binary op */
     int			mul_scale;	/* scale multiplier */
     int			div_scale;	/* scale divisor */
     val_t		*ivlist;	/* instance-value pairs */
     struct timespec	stamp;		/* timestamp from current fetch */
     double		time_scale;	/* time utilization scaling for rate() */
     int			last_numval;	/* length of last_ivlist[] */
+    int			last_maxval;	/* allocated length of last_ivlist[] */
     val_t		*last_ivlist;	/* values from previous fetch for delta() or rate() */
     struct timespec	last_stamp;	/* timestamp from previous fetch for rate() */
+    unsigned int	evalseq;	/* fetch sequence of last evaluation */
+    int			evalsts;	/* result of last evaluation */
+    struct node		*share;		/* same subtree in another metric, ivlist[] is borrowed */
 } info_t;
 
 typedef struct {			/* for instance filtering */
@@ -106,6 +112,7 @@ typedef struct {
     int			glob_last;	/* last global metric added */
     int			fetch_has_dm;	/* ==1 if pmResult rewrite needed */
     int			numpmid;	/* from pmFetch before rewrite */
+    unsigned int	fetchseq;	/* bumped for each pmResult rewrite */
 } ctl_t;
 
 /* node_t types */
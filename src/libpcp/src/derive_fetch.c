@@ -27,13 +27,24 @@
 
 extern const int promote[6][6];
 
+/*
+ * Add the operand pmIDs of an expression tree to list[], skipping any
+ * already there ... operands are often repeated within a derived
+ * metric and across derived metrics in the same fetch.
+ */
 static void
 get_pmids(node_t *np, int *cnt, pmID **list)
 {
+    int		i;
+
     assert(np != NULL);
     if (np->left != NULL) get_pmids(np->left, cnt, list);
     if (np->right != NULL) get_pmids(np->right, cnt, list);
     if (np->type == N_NAME) {
+	for (i = 0; i < *cnt; i++) {
+	    if ((*list)[i] == np->data.info->pmid)
+		return;
+	}
 	(*cnt)++;
 	if ((*list = (pmID *)realloc(*list, (*cnt)*sizeof(pmID))) == NULL) {
 	    pmNoMem("__dmprefetch: realloc xtralist", (*cnt)*sizeof(pmID), PM_FATAL_ERR);
@@ -103,8 +114,7 @@ __dmprefetch(__pmContext *ctxp, int numpmid, const pmID *pmidlist, pmID **newlis
 
     /*
      * Some of the "extra" ones, may already be in the caller's pmFetch 
-     * list, or repeated in xtralist[] (if the same metric operand appears
-     * more than once as a leaf node in the expression tree.
+     * list (xtralist[] itself has no duplicates, see get_pmids()).
      * Remove these duplicates
      */
     j = 0;
@@ -114,13 +124,7 @@ __dmprefetch(__pmContext *ctxp, int numpmid, const pmID *pmidlist, pmID **newlis
 		/* already in pmFetch list */
 		break;
 	}
-	if (m < numpmid) continue;
-	for (m = 0; m < j; m++) {
-	    if (xtralist[i] == xtralist[m])
-	    	/* already in xtralist[] */
-		break;
-	}
-	if (m == j)
+	if (m == numpmid)
 	    xtralist[j++] = xtralist[i];
     }
     xtracnt = j;
@@ -153,59 +157,90 @@ __dmprefetch(__pmContext *ctxp, int numpmid, const pmID *pmidlist, pmID **newlis
 }
 
 /*
- * Free the old ivlist[] (if any) ... may need to walk the list because
- * the pmAtomValues may have buffers attached in the type STRING,
- * type AGGREGATE* and type EVENT cases.
+ * Release the old ivlist[] values (if any) ... may need to walk the
+ * list because the pmAtomValues may have buffers attached in the type
+ * STRING, type AGGREGATE* and type EVENT cases.
+ * The ivlist[] array itself is kept for the next fetch, see
+ * need_ivlist().
  * Includes logic to save one history sample (for delta() and rate()).
  */
 static void
 free_ivlist(node_t *np)
 {
+    info_t	*ip = np->data.info;
+    val_t	*tmp;
     int		i;
 
-    assert(np->data.info != NULL);
+    assert(ip != NULL);
 
     if (np->save_last) {
 	/*
-	 * saving history for delta() or rate() ... release previous
-	 * sample, and save this sample
+	 * saving history for delta() or rate() ... this sample becomes
+	 * the previous one, and the previous one's ivlist[] is recycled
+	 * (no STRING, AGGREGATE or EVENT types for delta() or rate())
 	 */
-	if (np->data.info->last_ivlist != NULL) {
-	    /*
-	     * no STRING, AGGREGATE or EVENT types for delta() or rate()
-	     * so simple free()
-	     */
-	    free(np->data.info->last_ivlist);
-	}
-	np->data.info->last_numval = np->data.info->numval;
-	np->data.info->last_ivlist = np->data.info->ivlist;
-	np->data.info->ivlist = NULL;
+	tmp = ip->last_ivlist;
+	i = ip->last_maxval;
+	ip->last_numval = ip->numval;
+	ip->last_ivlist = ip->ivlist;
+	ip->last_maxval = ip->maxval;
+	ip->ivlist = tmp;
+	ip->maxval = i;
+	ip->numval = 0;
     }
     else {
 	/* no history */
-	if (np->data.info->ivlist != NULL) {
+	if (ip->ivlist != NULL) {
 	    if (np->desc.type == PM_TYPE_STRING) {
-		for (i = 0; i < np->data.info->numval; i++) {
-		    if (np->data.info->ivlist[i].value.cp != NULL)
-			free(np->data.info->ivlist[i].value.cp);
+		for (i = 0; i < ip->numval; i++) {
+		    if (ip->ivlist[i].value.cp != NULL) {
+			free(ip->ivlist[i].value.cp);
+			ip->ivlist[i].value.cp = NULL;
+		    }
 		}
 	    }
 	    else if (np->desc.type == PM_TYPE_AGGREGATE ||
 		     np->desc.type == PM_TYPE_AGGREGATE_STATIC ||
 		     np->desc.type == PM_TYPE_EVENT ||
 		     np->desc.type == PM_TYPE_HIGHRES_EVENT) {
-		for (i = 0; i < np->data.info->numval; i++) {
-		    if (np->data.info->ivlist[i].value.vbp != NULL)
-			free(np->data.info->ivlist[i].value.vbp);
+		for (i = 0; i < ip->numval; i++) {
+		    if (ip->ivlist[i].value.vbp != NULL) {
+			free(ip->ivlist[i].value.vbp);
+			ip->ivlist[i].value.vbp = NULL;
+		    }
 		}
 	    }
 	}
-	free(np->data.info->ivlist);
-	np->data.info->numval = 0;
-	np->data.info->ivlist = NULL;
+	ip->numval = 0;
     }
 }
 
+/*
+ * Make sure ivlist[] can hold numval values.  The array only grows
+ * (geometrically), so once the instance domain is stable there is no
+ * more allocation on the fetch path.
+ */
+static void
+need_ivlist(node_t *np, int numval, const char *tag)
+{
+    info_t	*ip = np->data.info;
+    val_t	*tmp;
+    int		maxval;
+
+    if (numval <= ip->maxval)
+	return;
+    maxval = ip->maxval < 4 ? 4 : ip->maxval;
+    while (maxval < numval)
+	maxval *= 2;
+    if ((tmp = (val_t *)realloc(ip->ivlist, maxval*sizeof(val_t))) == NULL) {
+	pmNoMem(tag, maxval*sizeof(val_t), PM_FATAL_ERR);
+	/*NOTREACHED*/
+    }
+    memset(&tmp[ip->maxval], 0, (maxval - ip->maxval)*sizeof(val_t));
+    ip->ivlist = tmp;
+    ip->maxval = maxval;
+}
+
 /*
  * Binary arithmetic.
  *
@@ -635,6 +670,104 @@ bin_op(int type, int op, pmAtomValue a, int ltype, int lmul, int ldiv, pmAtomVal
     return res;
 }
 
+/*
+ * Type-specialised version of the binary operator loop in eval_expr()
+ * for the common case chosen at bind time (see fast_binop() in the
+ * parser), where both operands have the same type, there is no units
+ * scaling and the instances of the operands line up one-to-one.
+ *
+ * Returns 0 if the result has been computed into np's ivlist[] (sized
+ * by the caller), else -1 and the caller falls back to the general
+ * loop with bin_op().
+ */
+#define BIN_LOOP(f, rf, expr) \
+    for (k = 0; k < n; k++) { \
+	l = &lp[k*ls].value; \
+	r = &rp[k*rs].value; \
+	vp[k].value.rf = (expr); \
+	vp[k].inst = ip[k*is].inst; \
+    }
+
+#define BIN_OPS(f) \
+    switch (np->type) { \
+	case N_PLUS: BIN_LOOP(f, f, l->f + r->f); break; \
+	case N_MINUS: BIN_LOOP(f, f, l->f - r->f); break; \
+	case N_STAR: BIN_LOOP(f, f, l->f * r->f); break; \
+	case N_LT: BIN_LOOP(f, ul, l->f < r->f); break; \
+	case N_LEQ: BIN_LOOP(f, ul, l->f <= r->f); break; \
+	case N_EQ: BIN_LOOP(f, ul, l->f == r->f); break; \
+	case N_GEQ: BIN_LOOP(f, ul, l->f >= r->f); break; \
+	case N_GT: BIN_LOOP(f, ul, l->f > r->f); break; \
+	case N_NEQ: BIN_LOOP(f, ul, l->f != r->f); break; \
+	case N_AND: BIN_LOOP(f, ul, (l->f != 0) && (r->f != 0)); break; \
+	case N_OR: BIN_LOOP(f, ul, (l->f != 0) || (r->f != 0)); break; \
+	default: return -1; \
+    }
+
+static int
+bin_op_fast(node_t *np)
+{
+    val_t	*lp = np->left->data.info->ivlist;
+    val_t	*rp = np->right->data.info->ivlist;
+    val_t	*vp = np->data.info->ivlist;
+    val_t	*ip;
+    pmAtomValue	*l;
+    pmAtomValue	*r;
+    int		n = np->data.info->numval;
+    int		ls = 1;		/* stride, 0 for a singular operand */
+    int		rs = 1;
+    int		is;
+    int		k;
+
+    if (np->left->desc.indom == PM_INDOM_NULL)
+	ls = 0;
+    if (np->right->desc.indom == PM_INDOM_NULL)
+	rs = 0;
+    if (ls && rs) {
+	if (np->left->data.info->numval != n || np->right->data.info->numval != n)
+	    return -1;
+	for (k = 0; k < n; k++) {
+	    if (lp[k].inst != rp[k].inst)
+		return -1;
+	}
+    }
+    /* result instances from the operand with an indom, else right */
+    ip = ls ? lp : rp;
+    is = ls ? ls : rs;
+
+    switch (np->left->desc.type) {
+	case PM_TYPE_32:
+	    BIN_OPS(l);
+	    break;
+	case PM_TYPE_U32:
+	    BIN_OPS(ul);
+	    break;
+	case PM_TYPE_64:
+	    BIN_OPS(ll);
+	    break;
+	case PM_TYPE_U64:
+	    BIN_OPS(ull);
+	    break;
+	case PM_TYPE_FLOAT:
+	    BIN_OPS(f);
+	    break;
+	case PM_TYPE_DOUBLE:
+	    if (np->type == N_SLASH) {
+		BIN_LOOP(d, d, l->d == 0 ? 0 : l->d / r->d);
+	    }
+	    else {
+		BIN_OPS(d);
+	    }
+	    break;
+	default:
+	    return -1;
+    }
+    return 0;
+}
+
+#undef BIN_OPS
+#undef BIN_LOOP
+
 /*
  * For regular expression instance matching, the hash list of observed
  * instances could grow without bounds for a dynamic indom.
@@ -674,13 +807,15 @@ regex_inst_gc(pattern_t *pp)
     pp->used = 0;
 }
 
+static int eval_expr(__pmContext *, node_t *, struct timespec *, int,
+		pmValueSet **, int);
+
 /*
- * Walk an expression tree, filling in operand values from the
- * pmResult at the leaf nodes and propagating the computed values
- * towards the root node of the tree.
+ * Evaluate one node of an expression tree ... the operands are
+ * evaluated first via eval_expr().
  */
 static int
-eval_expr(__pmContext *ctxp, node_t *np, struct timespec *stamp, int numpmid,
+eval_node(__pmContext *ctxp, node_t *np, struct timespec *stamp, int numpmid,
 		pmValueSet **vset, int level)
 {
     int		sts;
@@ -689,6 +824,7 @@ eval_expr(__pmContext *ctxp, node_t *np, struct timespec *stamp, int numpmid,
     int		k;
     size_t	need;
     char	strbuf[20];
+    pmConvPlan	plan;
 
     assert(np != NULL);
     if (np->left != NULL) {
@@ -773,10 +909,7 @@ eval_expr(__pmContext *ctxp, node_t *np, struct timespec *stamp, int numpmid,
 	    np->data.info->numval = np->left->data.info->numval <= np->left->data.info->last_numval ? np->left->data.info->numval : np->left->data.info->last_numval;
 	    if (np->data.info->numval <= 0)
 		return np->data.info->numval;
-	    if ((np->data.info->ivlist = (val_t *)malloc(np->data.info->numval*sizeof(val_t))) == NULL) {
-		pmNoMem("eval_expr: delta()/rate() ivlist", np->data.info->numval*sizeof(val_t), PM_FATAL_ERR);
-		/*NOTREACHED*/
-	    }
+	    need_ivlist(np, np->data.info->numval, "eval_expr: delta()/rate() ivlist");
 	    /*
 	     * delta()
 	     * ivlist[k] = left->ivlist[i] - left->last_ivlist[j]
@@ -915,10 +1048,7 @@ eval_expr(__pmContext *ctxp, node_t *np, struct timespec *stamp, int numpmid,
 	    np->data.info->numval = np->left->data.info->numval;
 	    if (np->data.info->numval <= 0)
 		return np->data.info->numval;
-	    if ((np->data.info->ivlist = (val_t *)malloc(np->data.info->numval*sizeof(val_t))) == NULL) {
-		pmNoMem("eval_expr: N_NOT ivlist", np->data.info->numval*sizeof(val_t), PM_FATAL_ERR);
-		/*NOTREACHED*/
-	    }
+	    need_ivlist(np, np->data.info->numval, "eval_expr: N_NOT ivlist");
 	    /*
 	     * ivlist[i] = ! left->ivlist[i]
 	     */
@@ -953,10 +1083,7 @@ eval_expr(__pmContext *ctxp, node_t *np, struct timespec *stamp, int numpmid,
 	    np->data.info->numval = np->left->data.info->numval;
 	    if (np->data.info->numval <= 0)
 		return np->data.info->numval;
-	    if ((np->data.info->ivlist = (val_t *)malloc(np->data.info->numval*sizeof(val_t))) == NULL) {
-		pmNoMem("eval_expr: N_NEG ivlist", np->data.info->numval*sizeof(val_t), PM_FATAL_ERR);
-		/*NOTREACHED*/
-	    }
+	    need_ivlist(np, np->data.info->numval, "eval_expr: N_NEG ivlist");
 	    /*
 	     * ivlist[i] = - left->ivlist[i]
 	     */
@@ -1023,10 +1150,7 @@ eval_expr(__pmContext *ctxp, node_t *np, struct timespec *stamp, int numpmid,
 		if (np->right->right->data.info->numval > numval)
 		    numval = np->right->right->data.info->numval;
 		np->data.info->numval = numval;
-		if ((np->data.info->ivlist = (val_t *)malloc(numval*sizeof(val_t))) == NULL) {
-		    pmNoMem("eval_expr: N_QUEST ivlist", numval*sizeof(val_t), PM_FATAL_ERR);
-		    /*NOTREACHED*/
-		}
+		need_ivlist(np, numval, "eval_expr: N_QUEST ivlist");
 		/*
 		 * if guard, true and false operands are a mix of singular
 		 * values and values with an indom, need to use one of the
@@ -1152,20 +1276,17 @@ eval_expr(__pmContext *ctxp, node_t *np, struct timespec *stamp, int numpmid,
 	    np->data.info->numval = np->left->data.info->numval;
 	    if (np->data.info->numval <= 0)
 		return np->data.info->numval;
-	    if ((np->data.info->ivlist = (val_t *)malloc(np->data.info->numval*sizeof(val_t))) == NULL) {
-		pmNoMem("eval_expr: N_RESCALE ivlist", np->data.info->numval*sizeof(val_t), PM_FATAL_ERR);
-		/*NOTREACHED*/
-	    }
+	    need_ivlist(np, np->data.info->numval, "eval_expr: N_RESCALE ivlist");
 	    /*
 	     * ivlist[i] = rescale(left->ivlist[i], right->desc.units)
 	     */
-	    for (j = 0, i = 0; i < np->data.info->numval; i++) {
-		sts = pmConvScale(np->desc.type,
-		    &np->left->data.info->ivlist[i].value, &np->left->desc.units,
-		    &np->data.info->ivlist[j].value, &np->right->desc.units);
+	    sts = pmConvScalePlan(np->desc.type, &np->left->desc.units,
+				&np->right->desc.units, &plan);
+	    for (j = 0, i = 0; sts >= 0 && i < np->data.info->numval; i++) {
+		pmConvScaleApply(&plan, &np->left->data.info->ivlist[i].value,
+				&np->data.info->ivlist[j].value, 1);
 		np->data.info->ivlist[j].inst = np->left->data.info->ivlist[i].inst;
-		if (sts >= 0)
-		    j++;
+		j++;
 	    }
 	    np->data.info->numval = j;
 	    return np->data.info->numval;
@@ -1397,10 +1518,7 @@ eval_expr(__pmContext *ctxp, node_t *np, struct timespec *stamp, int numpmid,
 		    np->data.info->numval = vset[j]->numval;
 		    if (np->data.info->numval <= 0)
 			return np->data.info->numval;
-		    if ((np->data.info->ivlist = (val_t *)malloc(np->data.info->numval*sizeof(val_t))) == NULL) {
-			pmNoMem("eval_expr: metric ivlist", np->data.info->numval*sizeof(val_t), PM_FATAL_ERR);
-			/*NOTREACHED*/
-		    }
+		    need_ivlist(np, np->data.info->numval, "eval_expr: metric ivlist");
 		    for (i = 0; i < np->data.info->numval; i++) {
 			np->data.info->ivlist[i].inst = vset[j]->vlist[i].inst;
 			switch (np->desc.type) {
@@ -1567,13 +1685,8 @@ eval_expr(__pmContext *ctxp, node_t *np, struct timespec *stamp, int numpmid,
 			ip = (instctl_t *)hp->data;
 		    ip->used++;
 		    if (ip->match) {
-			val_t	*tmp_ivlist;
 			np->data.info->numval++;
-			if ((tmp_ivlist = (val_t *)realloc(np->data.info->ivlist, np->data.info->numval*sizeof(val_t))) == NULL) {
-			    pmNoMem("eval_expr: PATTERN ivlist", np->data.info->numval*sizeof(val_t), PM_FATAL_ERR);
-			    /*NOTREACHED*/
-			}
-			np->data.info->ivlist = tmp_ivlist;
+			need_ivlist(np, np->data.info->numval, "eval_expr: PATTERN ivlist");
 			np->data.info->ivlist[np->data.info->numval-1] = np->right->data.info->ivlist[i];
 		    }
 		}
@@ -1663,10 +1776,9 @@ eval_expr(__pmContext *ctxp, node_t *np, struct timespec *stamp, int numpmid,
 		else
 		    np->data.info->numval = np->right->data.info->numval;
 	    }
-	    if ((np->data.info->ivlist = (val_t *)malloc(np->data.info->numval*sizeof(val_t))) == NULL) {
-		pmNoMem("eval_expr: expr ivlist", np->data.info->numval*sizeof(val_t), PM_FATAL_ERR);
-		/*NOTREACHED*/
-	    }
+	    need_ivlist(np, np->data.info->numval, "eval_expr: expr ivlist");
+	    if (np->data.info->fastop && bin_op_fast(np) == 0)
+		return np->data.info->numval;
 	    /*
 	     * ivlist[k] = left->ivlist[i] <op> right->ivlist[j]
 	     */
@@ -1783,6 +1895,42 @@ eval_expr(__pmContext *ctxp, node_t *np, struct timespec *stamp, int numpmid,
     /*NOTREACHED*/
 }
 
+/*
+ * Walk an expression tree, filling in operand values from the
+ * pmResult at the leaf nodes and propagating the computed values
+ * towards the root node of the tree.
+ *
+ * Each node is evaluated at most once per pmResult rewrite (see
+ * fetchseq), so the same derived metric requested more than once
+ * in a fetch, or a subtree shared with another derived metric (see
+ * share_expr() in the parser), is computed once.
+ */
+static int
+eval_expr(__pmContext *ctxp, node_t *np, struct timespec *stamp, int numpmid,
+		pmValueSet **vset, int level)
+{
+    ctl_t	*cp = (ctl_t *)ctxp->c_dm;
+    info_t	*ip;
+    int		sts;
+
+    if (np->type == N_PATTERN || (ip = np->data.info) == NULL)
+	return eval_node(ctxp, np, stamp, numpmid, vset, level);
+    if (ip->evalseq == cp->fetchseq)
+	return ip->evalsts;
+    if (ip->share != NULL) {
+	/* borrow the values of the equivalent node */
+	sts = eval_expr(ctxp, ip->share, stamp, numpmid, vset, level);
+	ip->numval = ip->share->data.info->numval;
+	ip->ivlist = ip->share->data.info->ivlist;
+	ip->stamp = ip->share->data.info->stamp;
+    }
+    else
+	sts = eval_node(ctxp, np, stamp, numpmid, vset, level);
+    ip->evalseq = cp->fetchseq;
+    ip->evalsts = sts;
+    return sts;
+}
+
 /*
  * Algorithm here is complicated by trying to re-write the pmValueSets
  * in a result structure (either pmResult or pmHighResResult).
@@ -1827,9 +1975,17 @@ __dmpostvalueset(__pmContext *ctxp, struct timespec *stamp, int vnumpmid,
     int		rewrite;
     ctl_t	*cp = (ctl_t *)ctxp->c_dm;
 
+    /* new generation for the once per fetch evaluation in eval_expr() */
+    if (++cp->fetchseq == 0)
+	cp->fetchseq = 1;
+
     for (j = 0; j < numpmid; j++) {
 	numval = vset[j]->numval;
-	valfmt = vset[j]->valfmt;
+	/*
+	 * pmValueSets with no values may be allocated without valfmt,
+	 * e.g. by __pmLogFetch()
+	 */
+	valfmt = numval <= 0 ? 0 : vset[j]->valfmt;
 	rewrite = 0;
 	/*
 	 * pandering to gcc ... m is not used unless rewrite == 1 in
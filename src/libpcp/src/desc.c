@@ -74,11 +74,15 @@ pmLookupDesc_ctx(__pmContext *ctxp, int derive_locked, pmID pmid, pmDesc *desc)
     if (ctxp->c_type == PM_CONTEXT_HOST) {
 	tout = ctxp->c_pmcd->pc_tout_sec;
 	fd = ctxp->c_pmcd->pc_fd;
-	if ((sts = __pmSendDescReq(fd, __pmPtrToHandle(ctxp), pmid)) < 0) {
+	if (__pmLookupCacheDesc(ctxp, pmid, desc)) {
+	    sts = 0;
+	} else if ((sts = __pmSendDescReq(fd, __pmPtrToHandle(ctxp), pmid)) < 0) {
 	    sts = __pmMapErrno(sts);
 	} else {
 	    PM_FAULT_POINT("libpcp/" __FILE__ ":1", PM_FAULT_CALL);
 	    sts = __pmRecvDesc(fd, ctxp, tout, desc);
+	    if (sts >= 0)
+		__pmLookupCacheAddDesc(ctxp, desc);
 	}
     }
     else if (ctxp->c_type == PM_CONTEXT_LOCAL) {
@@ -209,7 +213,21 @@ pmLookupDescs_ctx(__pmContext *ctxp, int derive_locked, int numpmid, pmID *pmidl
 	tout = ctxp->c_pmcd->pc_tout_sec;
 	fd = ctxp->c_pmcd->pc_fd;
 
-	if ((__pmFeaturesIPC(fd) & PDU_FLAG_DESCS)) {
+	/* no round trip needed if all the descriptors are cached */
+	for (i = lsts = 0; i < numpmid; i++) {
+	    if (IS_DERIVED(pmidlist[i]))
+		desclist[i].pmid = PM_ID_NULL;
+	    else if (__pmLookupCacheDesc(ctxp, pmidlist[i], &desclist[i]))
+		lsts++;
+	    else
+		break;
+	}
+
+	if (i == numpmid && lsts > 0) {
+	    sts = lsts;
+	    nfail = numpmid - lsts;
+	}
+	else if ((__pmFeaturesIPC(fd) & PDU_FLAG_DESCS)) {
 	    /* Use the bulk-transfer mechanism from a more modern pmcd */
 	    ctx = __pmPtrToHandle(ctxp);
 	    for (i = sts = 0; i < numpmid; i++)
@@ -223,6 +241,9 @@ pmLookupDescs_ctx(__pmContext *ctxp, int derive_locked, int numpmid, pmID *pmidl
 		PM_FAULT_POINT("libpcp/" __FILE__ ":2", PM_FAULT_CALL);
 		sts = __pmRecvDescs(fd, ctxp, tout, numpmid, desclist);
 		nfail = (sts >= 0) ? numpmid - sts : numpmid;
+		for (i = 0; sts > 0 && i < numpmid; i++)
+		    if (desclist[i].pmid != PM_ID_NULL)
+			__pmLookupCacheAddDesc(ctxp, &desclist[i]);
 	    }
 	} else {
 	    /* Fallback for down-revision pmcd, desc lookups in a loop */
@@ -237,6 +258,8 @@ pmLookupDescs_ctx(__pmContext *ctxp, int derive_locked, int numpmid, pmID *pmidl
 		} else {
 		    PM_FAULT_POINT("libpcp/" __FILE__ ":3", PM_FAULT_CALL);
 		    lsts = __pmRecvDesc(fd, ctxp, tout, &desclist[i]);
+		    if (lsts >= 0)
+			__pmLookupCacheAddDesc(ctxp, &desclist[i]);
 		}
 		if (lsts >= 0)
 		    sts++;
@@ -226,9 +226,11 @@ __pmLogLoadIndex(__pmLogCtl *lcp)
     size_t	bytes;
     void	*buffer;
     __pmLogTI	*tip;
+    int		maxti = 0;
 
     lcp->numti = 0;
     lcp->ti = NULL;
+    lcp->tisorted = 1;
 
     if (__pmLogVersion(lcp) == PM_LOG_VERS03)
 	record_size = sizeof(__pmTI_v3);
@@ -245,15 +247,19 @@ __pmLogLoadIndex(__pmLogCtl *lcp)
     if (lcp->tifp != NULL) {
 	__pmFseek(f, (long)__pmLogLabelSize(lcp), SEEK_SET);
 	for ( ; ; ) {
-	    __pmLogTI	*tmp;
-	    bytes = (1 + lcp->numti) * sizeof(__pmLogTI);
-	    tmp = (__pmLogTI *)realloc(lcp->ti, bytes);
-	    if (tmp == NULL) {
-		pmNoMem("__pmLogLoadIndex: realloc TI", bytes, PM_FATAL_ERR);
-		sts = -oserror();
-		goto bad;
+	    if (lcp->numti == maxti) {
+		__pmLogTI	*tmp;
+		/* grow geometrically, dense indexes can be large */
+		maxti = maxti == 0 ? 64 : 2 * maxti;
+		bytes = maxti * sizeof(__pmLogTI);
+		tmp = (__pmLogTI *)realloc(lcp->ti, bytes);
+		if (tmp == NULL) {
+		    pmNoMem("__pmLogLoadIndex: realloc TI", bytes, PM_FATAL_ERR);
+		    sts = -oserror();
+		    goto bad;
+		}
+		lcp->ti = tmp;
 	    }
-	    lcp->ti = tmp;
 	    bytes = __pmFread(buffer, 1, record_size, f);
 	    if (bytes != record_size) {
 		if (__pmFeof(f)) {
@@ -296,6 +302,18 @@ __pmLogLoadIndex(__pmLogCtl *lcp)
 		tip->off_data = ntohl(tip_v2->off_data);
 	    }
 
+	    /*
+	     * __pmLogSetTime() can only binary search the index if the
+	     * entries are in time order, and in volume and offset order
+	     */
+	    if (lcp->numti > 0) {
+		__pmLogTI	*prev = tip - 1;
+		if (__pmTimestampCmp(&tip->stamp, &prev->stamp) < 0 ||
+		    tip->vol < prev->vol ||
+		    (tip->vol == prev->vol && tip->off_data < prev->off_data))
+		    lcp->tisorted = 0;
+	    }
+
 	    lcp->numti++;
 	}
     }
@@ -380,3 +380,99 @@ bad:
     __pmFreeLogInDom(lidp);
     return PM_ERR_LOGREC;
 }
+
+/*
+ * Unpack just the fixed fields (timestamp, indom and numinst) of an
+ * InDom record into *lidp, and check the instance identifiers and
+ * string indices, without decoding the instances ... this is used by
+ * __pmLogLoadMeta() to defer the decoding until the instances are
+ * needed, while still rejecting the same corrupted records as
+ * __pmLogLoadInDom() would.
+ *
+ * buf[] contains the on-disk record (after the header), and is not
+ * modified.  On success lidp->instlist and lidp->namelist are NULL.
+ */
+int
+__pmLogScanInDom(int rlen, int type, const __int32_t *buf, __pmLogInDom *lidp)
+{
+    int			i;
+    int			k;
+    int			idx;
+    int			max_idx;
+    const __int32_t	*instlist;
+    const __int32_t	*stridx;
+    char		strbuf[20];
+
+    /* timestamp, indom and numinst */
+    if (type == TYPE_INDOM || type == TYPE_INDOM_DELTA)
+	k = 5;
+    else if (type == TYPE_INDOM_V2)
+	k = 4;
+    else {
+	if (pmDebugOptions.logmeta)
+	    fprintf(stderr, "__pmLogScanInDom: botch type=%d\n", type);
+	return PM_ERR_LOGREC;
+    }
+    if (rlen < k * (int)sizeof(__int32_t)) {
+	if (pmDebugOptions.logmeta)
+	    fprintf(stderr, "__pmLogScanInDom: record length (%d) too short\n", rlen);
+	return PM_ERR_LOGREC;
+    }
+    if (k == 5)
+	__pmLoadTimestamp(&buf[0], &lidp->stamp);
+    else
+	__pmLoadTimeval(&buf[0], &lidp->stamp);
+    lidp->indom = __ntohpmInDom(buf[k-2]);
+    lidp->numinst = ntohl(buf[k-1]);
+    lidp->next = lidp->prior = NULL;
+    lidp->isdelta = (type == TYPE_INDOM_DELTA);
+    lidp->instlist = NULL;
+    lidp->namelist = NULL;
+    lidp->buf = NULL;
+    lidp->alloc = 0;
+
+    if (lidp->numinst <= 0)
+	return 0;
+
+    /* rlen minus fixed fields, minus instlist[], minus strindex[] */
+    if (lidp->numinst > rlen / (int)sizeof(__int32_t))
+	max_idx = -1;
+    else
+	max_idx = rlen - (k + 2*lidp->numinst) * (int)sizeof(__int32_t);
+    if (max_idx < 0) {
+	if (pmDebugOptions.logmeta)
+	    fprintf(stderr, "__pmLogScanInDom: InDom: %s: numinst (%d) too large for record length (%d)\n",
+		pmInDomStr_r(lidp->indom, strbuf, sizeof(strbuf)),
+		lidp->numinst, rlen);
+	return PM_ERR_LOGREC;
+    }
+    instlist = &buf[k];
+    stridx = &buf[k + lidp->numinst];
+    for (i = 0; i < lidp->numinst; i++) {
+	if ((int)ntohl(instlist[i]) < 0) {
+	    /* bad internal instance identifier */
+	    if (pmDebugOptions.logmeta)
+		fprintf(stderr, "__pmLogScanInDom: InDom: %s: instance[%d]: bad instance identifier (%d)\n", 
+		    pmInDomStr_r(lidp->indom, strbuf, sizeof(strbuf)),
+		    i, (int)ntohl(instlist[i]));
+	    return PM_ERR_LOGREC;
+	}
+	idx = ntohl(stridx[i]);
+	if (idx > max_idx) {
+	    if (pmDebugOptions.logmeta)
+		fprintf(stderr, "__pmLogScanInDom: InDom: %s instance[%d]: bad string index (%d) > max index based on record length (%d)\n",
+		    pmInDomStr_r(lidp->indom, strbuf, sizeof(strbuf)),
+		    i, idx, max_idx);
+	    return PM_ERR_LOGREC;
+	}
+	if (idx < 0 && !(type == TYPE_INDOM_DELTA && idx == -1)) {
+	    if (pmDebugOptions.logmeta)
+		fprintf(stderr, "__pmLogScanInDom: InDom: %s instance[%d]: bad string index (%d)\n",
+		    pmInDomStr_r(lidp->indom, strbuf, sizeof(strbuf)),
+		    i, idx);
+	    return PM_ERR_LOGREC;
+	}
+    }
+
+    return 0;
+}
@@ -380,14 +380,44 @@ count_event_parameters(unsigned int flags, int nparams)
     return nparams + 1;
 }
 
+static pmID
+anon_event_pmid(const char *caller, const char *name, pmID *pmidp)
+{
+    char		errmsg[PM_MAXERRMSGLEN];
+    int			sts;
+
+    if (*pmidp == 0) {
+	if ((sts = pmLookupName(1, &name, pmidp)) < 0) {
+	    fprintf(stderr, "%s: Warning: failed to get PMID for %s: %s\n",
+		    caller, name, pmErrStr_r(sts, errmsg, sizeof(errmsg)));
+	    *pmidp = pmID_build(pmID_domain(*pmidp), pmID_cluster(*pmidp), 1);
+	}
+    }
+    return *pmidp;
+}
+
+static pmID
+event_flags_pmid(const char *caller)
+{
+    static pmID	pmid_flags = 0;
+
+    return anon_event_pmid(caller, "event.flags", &pmid_flags);
+}
+
+static pmID
+event_missed_pmid(const char *caller)
+{
+    static pmID	pmid_missed = 0;
+
+    return anon_event_pmid(caller, "event.missed", &pmid_missed);
+}
+
 static int
 add_event_parameter(const char *caller, pmEventParameter *epp, int idx,
 		    unsigned int flags, int nparams, pmValueSet **vsetp)
 {
     pmValueSet		*vset;
     char		*vbuf;
-    char		errmsg[PM_MAXERRMSGLEN];
-    int			sts;
     int			need;
     int			want;
     int			vsize;
@@ -399,17 +429,7 @@ PM_FAULT_POINT("libpcp/" __FILE__ ":2", PM_FAULT_ALLOC);
 
     if (idx == 0 && flags != 0) {
 	/* rewrite non-zero er_flags as the anon event.flags metric */
-	static pmID	pmid_flags = 0;
-
-	if (pmid_flags == 0) {
-	    const char	*name = "event.flags";
-	    if ((sts = pmLookupName(1, &name, &pmid_flags)) < 0) {
-		fprintf(stderr, "%s: Warning: failed to get PMID for %s: %s\n",
-			caller, name, pmErrStr_r(sts, errmsg, sizeof(errmsg)));
-		pmid_flags = pmID_build(pmID_domain(pmid_flags), pmID_cluster(pmid_flags), 1);
-	    }
-	}
-	vset->pmid = pmid_flags;
+	vset->pmid = event_flags_pmid(caller);
 	vset->numval = 1;
 	vset->vlist[0].inst = PM_IN_NULL;
 	vset->valfmt = PM_VAL_INSITU;
@@ -419,17 +439,7 @@ PM_FAULT_POINT("libpcp/" __FILE__ ":2", PM_FAULT_ALLOC);
     }
     if (idx == 1 && flags & PM_EVENT_FLAG_MISSED) {
 	/* rewrite missed count as the anon event.missed metric */
-	static pmID	pmid_missed = 0;
-
-	if (pmid_missed == 0) {
-	    const char	*name = "event.missed";
-	    if ((sts = pmLookupName(1, &name, &pmid_missed)) < 0) {
-		fprintf(stderr, "%s: Warning: failed to get PMID for %s: %s\n",
-			caller, name, pmErrStr_r(sts, errmsg, sizeof(errmsg)));
-		pmid_missed = pmID_build(pmID_domain(pmid_missed), pmID_cluster(pmid_missed), 1);
-	    }
-	}
-	vset->pmid = pmid_missed;
+	vset->pmid = event_missed_pmid(caller);
 	vset->numval = 1;
 	vset->vlist[0].inst = PM_IN_NULL;
 	vset->valfmt = PM_VAL_INSITU;
@@ -691,6 +701,157 @@ bail:
     return sts;
 }
 
+/*
+ * Walk the idx'th instance of a packed event record array in place,
+ * without the allocations of pmUnpackEventRecords() ... parameters
+ * are presented one at a time in a pmValueSet within the iterator,
+ * with values referring directly into the packed array, and with the
+ * same anon event.flags and event.missed metrics added.
+ */
+int
+pmEventIterStart(pmEventIter *iter, pmValueSet *vsp, int idx)
+{
+    int			sts;
+
+    memset(iter, 0, sizeof(*iter));
+    if (vsp->numval < 1)
+	return vsp->numval;
+    if (vsp->valfmt != PM_VAL_DPTR && vsp->valfmt != PM_VAL_SPTR)
+	return PM_ERR_CONV;
+
+    if (vsp->vlist[idx].value.pval->vtype == PM_TYPE_HIGHRES_EVENT) {
+	pmHighResEventArray	*hreap;
+
+	if ((sts = __pmCheckHighResEventRecords(vsp, idx)) < 0) {
+	    __pmDumpHighResEventRecords(stderr, vsp, idx);
+	    return sts;
+	}
+	hreap = (pmHighResEventArray *)vsp->vlist[idx].value.pval;
+	iter->highres = 1;
+	iter->nrecords = hreap->ea_nrecords;
+	iter->next = (char *)&hreap->ea_record[0];
+    }
+    else {
+	pmEventArray	*eap;
+
+	if ((sts = __pmCheckEventRecords(vsp, idx)) < 0) {
+	    __pmDumpEventRecords(stderr, vsp, idx);
+	    return sts;
+	}
+	eap = (pmEventArray *)vsp->vlist[idx].value.pval;
+	iter->nrecords = eap->ea_nrecords;
+	iter->next = (char *)&eap->ea_record[0];
+    }
+    return iter->nrecords;
+}
+
+/*
+ * Move to the next event record, skipping any parameters of the
+ * current record not yet visited.  Returns 1 at a record, else 0
+ * once all records have been visited.
+ */
+int
+pmEventIterNext(pmEventIter *iter)
+{
+    pmValueSet		*vsp;
+    int			sts;
+
+    while (iter->param < iter->numpmid) {
+	if ((sts = pmEventIterParam(iter, &vsp)) <= 0)
+	    break;
+    }
+    if (iter->nrecords <= 0)
+	return 0;
+    iter->nrecords--;
+
+    if (iter->highres) {
+	pmHighResEventRecord	*erp = (pmHighResEventRecord *)iter->next;
+
+	iter->timestamp.tv_sec = erp->er_timestamp.tv_sec;
+	iter->timestamp.tv_nsec = erp->er_timestamp.tv_nsec;
+	iter->flags = erp->er_flags;
+	iter->nparams = erp->er_nparams;
+	iter->next += sizeof(erp->er_timestamp) + sizeof(erp->er_flags) +
+		      sizeof(erp->er_nparams);
+    }
+    else {
+	pmEventRecord	*erp = (pmEventRecord *)iter->next;
+
+	iter->timestamp.tv_sec = erp->er_timestamp.tv_sec;
+	iter->timestamp.tv_nsec = erp->er_timestamp.tv_usec * 1000;
+	iter->flags = erp->er_flags;
+	iter->nparams = erp->er_nparams;
+	iter->next += sizeof(erp->er_timestamp) + sizeof(erp->er_flags) +
+		      sizeof(erp->er_nparams);
+    }
+    iter->numpmid = count_event_parameters(iter->flags, iter->nparams);
+    iter->param = 0;
+    return 1;
+}
+
+/*
+ * Next parameter of the current event record, returned through vsetp
+ * and valid until the next call for this iterator.  Returns 1 with a
+ * parameter, 0 after the last, else a negative error code.
+ */
+int
+pmEventIterParam(pmEventIter *iter, pmValueSet **vsetp)
+{
+    pmEventParameter	*epp = (pmEventParameter *)iter->next;
+    pmValueSet		*vset = &iter->vset;
+    const char		caller[] = "pmEventIterParam";
+    int			p = iter->param;
+
+    if (p >= iter->numpmid)
+	return 0;
+    iter->param++;
+
+    vset->numval = 1;
+    vset->vlist[0].inst = PM_IN_NULL;
+    *vsetp = vset;
+
+    if (p == 0 && iter->flags != 0) {
+	vset->pmid = event_flags_pmid(caller);
+	vset->valfmt = PM_VAL_INSITU;
+	vset->vlist[0].value.lval = iter->flags;
+	return 1;
+    }
+    if (p == 1 && (iter->flags & PM_EVENT_FLAG_MISSED)) {
+	vset->pmid = event_missed_pmid(caller);
+	vset->valfmt = PM_VAL_INSITU;
+	vset->vlist[0].value.lval = iter->nparams;
+	return 1;
+    }
+
+    /* an event parameter, bar the pmID, has the layout of a pmValueBlock */
+    iter->next += sizeof(epp->ep_pmid) + PM_PDU_SIZE_BYTES(epp->ep_len);
+    vset->pmid = epp->ep_pmid;
+    switch (epp->ep_type) {
+	case PM_TYPE_32:
+	case PM_TYPE_U32:
+	    vset->valfmt = PM_VAL_INSITU;
+	    memcpy((void *)&vset->vlist[0].value.lval,
+		   (char *)epp + sizeof(epp->ep_pmid) + sizeof(int),
+		   sizeof(__int32_t));
+	    return 1;
+	case PM_TYPE_64:
+	case PM_TYPE_U64:
+	case PM_TYPE_FLOAT:
+	case PM_TYPE_DOUBLE:
+	case PM_TYPE_AGGREGATE:
+	case PM_TYPE_STRING:
+	case PM_TYPE_AGGREGATE_STATIC:
+	    vset->valfmt = PM_VAL_DPTR;
+	    vset->vlist[0].value.pval =
+		(pmValueBlock *)((char *)epp + sizeof(epp->ep_pmid));
+	    return 1;
+	default:	/* no nesting of event records either */
+	    break;
+    }
+    vset->numval = PM_ERR_TYPE;
+    return PM_ERR_TYPE;
+}
+
 void
 pmFreeEventResult(pmResult **rset)
 {
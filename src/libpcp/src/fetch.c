@@ -43,6 +43,66 @@ __pmUpdateProfile(int fd, __pmContext *ctxp, int timeout)
     return 0;
 }
 
+/* positive __pmDecodeFetchPDU return for a PDU_FLAG_METADATA PDU */
+#define FETCH_METADATA	(1<<30)
+
+/*
+ * Cache the descriptors or instances pmcd sends ahead of a result for
+ * clients that asked for PDU_FLAG_METADATA, see lookupcache.c
+ */
+static int
+__pmDecodeFetchMetadata(__pmContext *ctxp, int sts, __pmPDU *pb)
+{
+    pmInResult	*inresult;
+    pmDesc	*descs;
+    int		i, numdescs;
+
+    if (sts == PDU_DESCS) {
+	if ((sts = __pmDecodeDescs2(pb, &numdescs, &descs)) < 0)
+	    return sts;
+	for (i = 0; i < numdescs; i++)
+	    __pmLookupCacheAddDesc(ctxp, &descs[i]);
+	free(descs);
+    }
+    else {
+	if ((sts = __pmDecodeInstance(pb, &inresult)) < 0)
+	    return sts;
+	__pmLookupCacheAddInDom(ctxp, inresult);
+    }
+    return FETCH_METADATA;
+}
+
+/*
+ * Decode one PDU (of type sts, from __pmGetPDU) sent by pmcd in reply
+ * to a fetch.  A positive return is a PMCD state change or metadata
+ * (FETCH_METADATA), and the result is still to follow in another PDU.
+ */
+static int
+__pmDecodeFetchPDU(__pmContext *ctxp, int sts, __pmPDU *pb, int pdutype,
+		__pmResult **result)
+{
+    if (sts == PDU_HIGHRES_RESULT && pdutype == PDU_HIGHRES_FETCH)
+	sts = __pmDecodeHighResResult_ctx(ctxp, pb, result);
+    else if (sts == PDU_COMPACT_RESULT && pdutype == PDU_HIGHRES_FETCH)
+	sts = __pmDecodeCompactResult_ctx(ctxp, pb, result);
+    else if (sts == PDU_RESULT && pdutype == PDU_FETCH)
+	sts = __pmDecodeResult_ctx(ctxp, pb, result);
+    else if (sts == PDU_DESCS || sts == PDU_INSTANCE)
+	sts = __pmDecodeFetchMetadata(ctxp, sts, pb);
+    else if (sts == PDU_ERROR) {
+	__pmDecodeError(pb, &sts);
+	/*
+	 * names or metadata may have changed, so cached lookups are
+	 * stale - flushed before any metadata that follows is cached
+	 */
+	if (sts > 0 && (sts & (PMCD_NAMES_CHANGE | PMCD_AGENT_CHANGE)))
+	    __pmLookupCacheFlush(ctxp);
+    }
+    else if (sts != PM_ERR_TIMEOUT)
+	sts = PM_ERR_IPC;
+    return sts;
+}
+
 static int
 __pmRecvFetchPDU(int fd, __pmContext *ctxp, int timeout, int pdutype,
 		__pmResult **result)
@@ -52,18 +112,10 @@ __pmRecvFetchPDU(int fd, __pmContext *ctxp, int timeout, int pdutype,
 
     do {
 	sts = pinpdu = __pmGetPDU(fd, ANY_SIZE, timeout, &pb);
-	if (sts == PDU_HIGHRES_RESULT && pdutype == PDU_HIGHRES_FETCH)
-	    sts = __pmDecodeHighResResult_ctx(ctxp, pb, result);
-	else if (sts == PDU_RESULT && pdutype == PDU_FETCH)
-	    sts = __pmDecodeResult_ctx(ctxp, pb, result);
-	else if (sts == PDU_ERROR) {
-	    __pmDecodeError(pb, &sts);
-	    if (sts > 0)
-		/* PMCD state change protocol */
-		changed |= sts;
-	}
-	else if (sts != PM_ERR_TIMEOUT)
-	    sts = PM_ERR_IPC;
+	sts = __pmDecodeFetchPDU(ctxp, sts, pb, pdutype, result);
+	if (sts > 0)
+	    /* PMCD state change protocol, or metadata */
+	    changed |= (sts & ~FETCH_METADATA);
 
 	if (pinpdu > 0)
 	    __pmUnpinPDUBuf(pb);
@@ -105,6 +157,12 @@ dump_fetch_flags(int sts)
 	if (flag++)
 	    fprintf(stderr, ", ");
 	fprintf(stderr, "label change");
+	if (sts & PMCD_CONTEXT_LABEL_CHANGE) fprintf(stderr, " context");
+	if (sts & PMCD_DOMAIN_LABEL_CHANGE) fprintf(stderr, " domain");
+	if (sts & PMCD_INDOM_LABEL_CHANGE) fprintf(stderr, " indom");
+	if (sts & PMCD_CLUSTER_LABEL_CHANGE) fprintf(stderr, " cluster");
+	if (sts & PMCD_ITEM_LABEL_CHANGE) fprintf(stderr, " item");
+	if (sts & PMCD_INSTANCES_LABEL_CHANGE) fprintf(stderr, " instances");
     }
     if (sts & PMCD_NAMES_CHANGE) {
 	if (flag++)
@@ -139,6 +197,109 @@ trace_fetch_exit(int sts)
     }
 }
 
+/*
+ * State carried between fetch_start() and fetch_finish() for one context.
+ */
+typedef struct {
+    int		numpmid;
+    pmID	*pmidlist;
+    pmID	*newlist;	/* rewritten pmidlist for derived metrics */
+    int		have_dm;
+    int		pdutype;
+} fetchstate_t;
+
+/*
+ * First half of a fetch on a locked context ... prepare any derived
+ * metrics, then for a host context send the profile (if needed) and
+ * the fetch request, but do not wait for the reply.
+ */
+static int
+fetch_start(__pmContext *ctxp, int numpmid, pmID *pmidlist, fetchstate_t *fcp)
+{
+    int		newcnt;
+    int		fd, tout;
+    int		sts = 0;
+
+    PM_ASSERT_IS_LOCKED(ctxp->c_lock);
+
+    /* for derived metrics, may need to rewrite the pmidlist */
+    fcp->newlist = NULL;
+    fcp->have_dm = newcnt = __pmPrepareFetch(ctxp, numpmid, pmidlist, &fcp->newlist);
+    if (newcnt > numpmid) {
+	/* replace args passed into pmFetch */
+	numpmid = newcnt;
+	pmidlist = fcp->newlist;
+    }
+    fcp->numpmid = numpmid;
+    fcp->pmidlist = pmidlist;
+
+    if (ctxp->c_type == PM_CONTEXT_HOST) {
+	/* find type of PDU we will send in live mode */
+	fd = ctxp->c_pmcd->pc_fd;
+	/* use high resolution timestamps whenever pmcd supports them */
+	if ((__pmFeaturesIPC(fd) & PDU_FLAG_HIGHRES))
+	    fcp->pdutype = PDU_HIGHRES_FETCH;
+	else
+	    fcp->pdutype = PDU_FETCH;
+	tout = ctxp->c_pmcd->pc_tout_sec;
+	__pmLookupCacheDropInDoms(ctxp);
+	if ((sts = __pmUpdateProfile(fd, ctxp, tout)) < 0)
+	    sts = __pmMapErrno(sts);
+	else if ((sts = __pmSendFetchPDU(fd, __pmPtrToHandle(ctxp),
+			    ctxp->c_slot, numpmid, pmidlist, fcp->pdutype)) < 0)
+	    sts = __pmMapErrno(sts);
+    }
+    return sts;
+}
+
+/*
+ * Common tail of a fetch, once the result (or an error) is in hand ...
+ * finish off any derived metrics.
+ */
+static int
+fetch_done(__pmContext *ctxp, fetchstate_t *fcp, int sts, __pmResult **result)
+{
+    PM_ASSERT_IS_LOCKED(ctxp->c_lock);
+
+    /* process derived metrics, if any */
+    if (fcp->have_dm) {
+	__pmFinishResult(ctxp, sts, result);
+	if (fcp->newlist != NULL)
+	    free(fcp->newlist);
+    }
+    return sts;
+}
+
+/*
+ * Second half of a fetch ... sts is the fetch_start() return value;
+ * collect the reply from pmcd, or do the whole fetch for local and
+ * archive contexts, then finish off any derived metrics.
+ */
+static int
+fetch_finish(__pmContext *ctxp, fetchstate_t *fcp, int sts, __pmResult **result)
+{
+    PM_ASSERT_IS_LOCKED(ctxp->c_lock);
+
+    if (sts < 0)
+	;
+    else if (ctxp->c_type == PM_CONTEXT_HOST) {
+	PM_FAULT_POINT("libpcp/" __FILE__ ":1", PM_FAULT_CALL);
+	sts = __pmRecvFetchPDU(ctxp->c_pmcd->pc_fd, ctxp,
+			ctxp->c_pmcd->pc_tout_sec, fcp->pdutype, result);
+    }
+    else if (ctxp->c_type == PM_CONTEXT_LOCAL) {
+	sts = __pmFetchLocal(ctxp, fcp->numpmid, fcp->pmidlist, result);
+    }
+    else {
+	/* assume PM_CONTEXT_ARCHIVE */
+	sts = __pmLogFetch(ctxp, fcp->numpmid, fcp->pmidlist, result);
+	if (sts >= 0 && (ctxp->c_mode & __PM_MODE_MASK) != PM_MODE_INTERP)
+	    ctxp->c_origin = (*result)->timestamp;
+    }
+
+    return fetch_done(ctxp, fcp, sts, result);
+}
+
 /*
  * Internal variant of pmFetch() API family ... ctxp is not NULL for
  * internal callers where the current context is already locked, but
@@ -160,9 +321,7 @@ __pmFetch(__pmContext *ctxp, int numpmid, pmID *pmidlist, __pmResult **result)
     }
 
     if ((sts = ctx = pmWhichContext()) >= 0) {
-	pmID		*newlist = NULL;
-	int		newcnt;
-	int		fd, tout, have_dm, pdutype;
+	fetchstate_t	fstate;
 
 	if (ctxp == NULL) {
 	    ctxp = __pmHandleToPtr(ctx);
@@ -184,49 +343,14 @@ __pmFetch(__pmContext *ctxp, int numpmid, pmID *pmidlist, __pmResult **result)
 	    goto pmapi_return;
 	}
 
-	/* for derived metrics, may need to rewrite the pmidlist */
-	have_dm = newcnt = __pmPrepareFetch(ctxp, numpmid, pmidlist, &newlist);
-	if (newcnt > numpmid) {
-	    /* replace args passed into pmFetch */
-	    numpmid = newcnt;
-	    pmidlist = newlist;
-	}
-
-	if (ctxp->c_type == PM_CONTEXT_HOST) {
-	    /* find type of PDU we will send in live mode */
-	    fd = ctxp->c_pmcd->pc_fd;
-	    /* use high resolution timestamps whenever pmcd supports them */
-	    if ((__pmFeaturesIPC(fd) & PDU_FLAG_HIGHRES))
-		pdutype = PDU_HIGHRES_FETCH;
-	    else
-		pdutype = PDU_FETCH;
-	    tout = ctxp->c_pmcd->pc_tout_sec;
-	    if ((sts = __pmUpdateProfile(fd, ctxp, tout)) < 0)
-		sts = __pmMapErrno(sts);
-	    else if ((sts = __pmSendFetchPDU(fd, __pmPtrToHandle(ctxp),
-				ctxp->c_slot, numpmid, pmidlist, pdutype)) < 0)
-		sts = __pmMapErrno(sts);
-	    else {
-		PM_FAULT_POINT("libpcp/" __FILE__ ":1", PM_FAULT_CALL);
-		sts = __pmRecvFetchPDU(fd, ctxp, tout, pdutype, result);
-	    }
-	}
-	else if (ctxp->c_type == PM_CONTEXT_LOCAL) {
-	    sts = __pmFetchLocal(ctxp, numpmid, pmidlist, result);
-	}
-	else {
-	    /* assume PM_CONTEXT_ARCHIVE */
-	    sts = __pmLogFetch(ctxp, numpmid, pmidlist, result);
-	    if (sts >= 0 && (ctxp->c_mode & __PM_MODE_MASK) != PM_MODE_INTERP)
-		ctxp->c_origin = (*result)->timestamp;
+	/* the reply to a pmFetchAsync() request is still to come */
+	if (ctxp->c_async != NULL) {
+	    sts = -EBUSY;
+	    goto pmapi_return;
 	}
 
-	/* process derived metrics, if any */
-	if (have_dm) {
-	    __pmFinishResult(ctxp, sts, result);
-	    if (newlist != NULL)
-		free(newlist);
-	}
+	sts = fetch_start(ctxp, numpmid, pmidlist, &fstate);
+	sts = fetch_finish(ctxp, &fstate, sts, result);
     }
 
 pmapi_return:
@@ -251,6 +375,318 @@ pmapi_return:
     return sts;
 }
 
+/*
+ * Fetch the same metrics from several contexts.  All the contexts are
+ * locked together, the requests are sent to every pmcd before any reply
+ * is read, and then the replies are collected in order, so the network
+ * round trips overlap rather than adding up.
+ *
+ * Per-context outcomes are returned via results[] and status[], and the
+ * return value is the number of contexts with a result.
+ */
+int
+__pmFetchMany(int nctx, const int *ctxids, int numpmid, pmID *pmidlist,
+		__pmResult **results, int *status)
+{
+    __pmContext	**ctxps;
+    fetchstate_t	*fstate;
+    int		count = 0;
+    int		i;
+
+    if (nctx < 1 || numpmid < 1)
+	return PM_ERR_TOOSMALL;
+
+    if ((ctxps = (__pmContext **)calloc(nctx, sizeof(*ctxps))) == NULL)
+	return -oserror();
+    if ((fstate = (fetchstate_t *)calloc(nctx, sizeof(*fstate))) == NULL) {
+	free(ctxps);
+	return -oserror();
+    }
+    __pmHandleToPtrList(nctx, ctxids, ctxps);
+
+    for (i = 0; i < nctx; i++) {
+	results[i] = NULL;
+	if (ctxps[i] == NULL) {
+	    status[i] = PM_ERR_NOCONTEXT;
+	    continue;
+	}
+	/* local context requires single-threaded applications */
+	if (ctxps[i]->c_type == PM_CONTEXT_LOCAL &&
+	    PM_MULTIPLE_THREADS(PM_SCOPE_DSO_PMDA)) {
+	    status[i] = PM_ERR_THREAD;
+	    PM_UNLOCK(ctxps[i]->c_lock);
+	    ctxps[i] = NULL;
+	    continue;
+	}
+	if (ctxps[i]->c_async != NULL) {
+	    status[i] = -EBUSY;
+	    PM_UNLOCK(ctxps[i]->c_lock);
+	    ctxps[i] = NULL;
+	    continue;
+	}
+	status[i] = fetch_start(ctxps[i], numpmid, pmidlist, &fstate[i]);
+    }
+
+    for (i = 0; i < nctx; i++) {
+	if (ctxps[i] == NULL)
+	    continue;
+	status[i] = fetch_finish(ctxps[i], &fstate[i], status[i], &results[i]);
+	if (status[i] >= 0)
+	    count++;
+	else
+	    results[i] = NULL;
+	if (pmDebugOptions.fetch) {
+	    fprintf(stderr, "%s[%d] context %d returns ...\n",
+			    "pmFetchMany", i, ctxids[i]);
+	    if (status[i] >= 0) {
+		if (status[i] > 0)
+		    dump_fetch_flags(status[i]);
+		__pmPrintResult_ctx(ctxps[i], stderr, results[i]);
+	    } else {
+		char	errmsg[PM_MAXERRMSGLEN];
+		fprintf(stderr, "Error: %s\n",
+			pmErrStr_r(status[i], errmsg, sizeof(errmsg)));
+	    }
+	}
+	PM_UNLOCK(ctxps[i]->c_lock);
+    }
+
+    free(fstate);
+    free(ctxps);
+    return count;
+}
+
+/*
+ * Asynchronous fetches ... requests for a context are queued on
+ * c_async, and only the request at the head is ever in flight, as the
+ * derived metric state in c_dm is per-fetch.  The caller drives the
+ * queue by calling pmAsyncService() whenever the pmcd socket (from
+ * pmGetAsyncFd()) is readable.
+ */
+typedef struct asyncreq {
+    struct asyncreq	*next;
+    int			request;	/* handle returned to the caller */
+    int			started;	/* fetch_start() done, sts is valid */
+    int			sts;
+    int			changed;	/* PMCD state changes seen so far */
+    int			numpmid;
+    pmID		*pmidlist;	/* copy of the caller's pmidlist */
+    fetchstate_t	fstate;
+    __pmResult		*result;
+    pmFetchCallBack	callback;	/* NULL once cancelled */
+    void		*arg;
+} asyncreq_t;
+
+static int	async_request;		/* last request handle issued */
+
+static void
+async_free(asyncreq_t *rp)
+{
+    if (rp->result != NULL)
+	__pmFreeResult(rp->result);
+    free(rp->pmidlist);
+    free(rp);
+}
+
+/*
+ * Send the request at the head of the queue, unless it is in flight
+ * already.  Called with c_lock held.
+ */
+static void
+async_start(__pmContext *ctxp)
+{
+    asyncreq_t	*rp = (asyncreq_t *)ctxp->c_async;
+
+    if (rp != NULL && !rp->started) {
+	rp->sts = fetch_start(ctxp, rp->numpmid, rp->pmidlist, &rp->fstate);
+	rp->started = 1;
+    }
+}
+
+/*
+ * Discard queued requests without any callbacks, for pmDestroyContext().
+ */
+void
+__pmAsyncFree(__pmContext *ctxp)
+{
+    asyncreq_t	*rp, *next;
+
+    for (rp = (asyncreq_t *)ctxp->c_async; rp != NULL; rp = next) {
+	next = rp->next;
+	if (rp->started)
+	    free(rp->fstate.newlist);
+	async_free(rp);
+    }
+    ctxp->c_async = NULL;
+}
+
+int
+pmFetchAsync(int ctx, int numpmid, pmID *pmidlist, pmFetchCallBack callback, void *arg)
+{
+    __pmContext	*ctxp;
+    asyncreq_t	*rp, **tail;
+    int		sts;
+
+    if (numpmid < 1)
+	return PM_ERR_TOOSMALL;
+    if ((ctxp = __pmHandleToPtr(ctx)) == NULL)
+	return PM_ERR_NOCONTEXT;
+    if (ctxp->c_type != PM_CONTEXT_HOST) {
+	sts = PM_ERR_NOTHOST;
+	goto unlock;
+    }
+    if ((rp = (asyncreq_t *)calloc(1, sizeof(*rp))) == NULL ||
+	(rp->pmidlist = (pmID *)malloc(numpmid * sizeof(pmID))) == NULL) {
+	sts = -oserror();
+	free(rp);
+	goto unlock;
+    }
+    memcpy(rp->pmidlist, pmidlist, numpmid * sizeof(pmID));
+    rp->numpmid = numpmid;
+    rp->callback = callback;
+    rp->arg = arg;
+    sts = rp->request = __atomic_add_fetch(&async_request, 1, __ATOMIC_RELAXED);
+
+    for (tail = (asyncreq_t **)&ctxp->c_async; *tail != NULL; tail = &(*tail)->next)
+	;
+    *tail = rp;
+    async_start(ctxp);
+
+    if (pmDebugOptions.fetch)
+	fprintf(stderr, "pmFetchAsync(%d, %d, ...) -> request %d\n",
+			ctx, numpmid, rp->request);
+unlock:
+    PM_UNLOCK(ctxp->c_lock);
+    return sts;
+}
+
+int
+pmGetAsyncFd(int ctx)
+{
+    __pmContext	*ctxp;
+    int		sts;
+
+    if ((ctxp = __pmHandleToPtr(ctx)) == NULL)
+	return PM_ERR_NOCONTEXT;
+    if (ctxp->c_type != PM_CONTEXT_HOST)
+	sts = PM_ERR_NOTHOST;
+    else
+	sts = ctxp->c_pmcd->pc_fd;
+    PM_UNLOCK(ctxp->c_lock);
+    return sts;
+}
+
+/*
+ * Collect whatever replies can be read without blocking, start the
+ * next queued request as each one completes, then make the callbacks
+ * with c_lock released so they are free to use the context again.
+ * Returns the number of requests completed.
+ */
+int
+pmAsyncService(int ctx)
+{
+    __pmContext		*ctxp;
+    asyncreq_t		*rp, *done = NULL, **tail = &done;
+    pmHighResResult	*hrp;
+    __pmTimestamp	stamp;
+    __pmPDU		*pb;
+    struct timeval	nowait;
+    int			fd, sts, pinpdu;
+    int			count = 0;
+
+    if ((ctxp = __pmHandleToPtr(ctx)) == NULL)
+	return PM_ERR_NOCONTEXT;
+    if (ctxp->c_type != PM_CONTEXT_HOST) {
+	PM_UNLOCK(ctxp->c_lock);
+	return PM_ERR_NOTHOST;
+    }
+
+    fd = ctxp->c_pmcd->pc_fd;
+    while ((rp = (asyncreq_t *)ctxp->c_async) != NULL) {
+	if ((sts = rp->sts) >= 0) {
+	    nowait.tv_sec = nowait.tv_usec = 0;
+	    if ((sts = __pmSocketReady(fd, &nowait)) == 0)
+		break;
+	    if (sts > 0) {
+		/* the rest of a PDU follows its header closely */
+		sts = pinpdu = __pmGetPDU(fd, ANY_SIZE,
+					ctxp->c_pmcd->pc_tout_sec, &pb);
+		sts = __pmDecodeFetchPDU(ctxp, sts, pb,
+					rp->fstate.pdutype, &rp->result);
+		if (pinpdu > 0)
+		    __pmUnpinPDUBuf(pb);
+		if (sts > 0) {
+		    /* PMCD state change protocol, result still to come */
+		    rp->changed |= (sts & ~FETCH_METADATA);
+		    continue;
+		}
+		if (sts == 0)
+		    sts = rp->changed;
+	    }
+	}
+	rp->sts = fetch_done(ctxp, &rp->fstate, sts, &rp->result);
+
+	/* dequeue, and on to the next request */
+	ctxp->c_async = rp->next;
+	rp->next = NULL;
+	*tail = rp;
+	tail = &rp->next;
+	async_start(ctxp);
+    }
+    PM_UNLOCK(ctxp->c_lock);
+
+    for (rp = done; rp != NULL; rp = done) {
+	done = rp->next;
+	count++;
+	if (pmDebugOptions.fetch)
+	    fprintf(stderr, "pmAsyncService(%d): request %d -> %d%s\n",
+			    ctx, rp->request, rp->sts,
+			    rp->callback ? "" : " (cancelled)");
+	if (rp->callback != NULL) {
+	    hrp = NULL;
+	    if (rp->sts >= 0 && rp->result != NULL) {
+		stamp = rp->result->timestamp;	/* struct copy */
+		hrp = __pmOffsetHighResResult(rp->result);
+		hrp->timestamp.tv_sec = stamp.sec;
+		hrp->timestamp.tv_nsec = stamp.nsec;
+		rp->result = NULL;	/* now owned by the callback */
+	    }
+	    rp->callback(ctx, rp->request, rp->sts, hrp, rp->arg);
+	}
+	async_free(rp);
+    }
+    return count;
+}
+
+/*
+ * Cancel a request ... if it is already in flight the reply is still
+ * read by pmAsyncService(), but no callback is made.
+ */
+int
+pmAsyncCancel(int ctx, int request)
+{
+    __pmContext	*ctxp;
+    asyncreq_t	*rp, **rpp;
+    int		sts = -ESRCH;
+
+    if ((ctxp = __pmHandleToPtr(ctx)) == NULL)
+	return PM_ERR_NOCONTEXT;
+    for (rpp = (asyncreq_t **)&ctxp->c_async; (rp = *rpp) != NULL; rpp = &rp->next) {
+	if (rp->request != request || rp->callback == NULL)
+	    continue;
+	if (rp->started)
+	    rp->callback = NULL;
+	else {
+	    *rpp = rp->next;
+	    async_free(rp);
+	}
+	sts = 0;
+	break;
+    }
+    PM_UNLOCK(ctxp->c_lock);
+    return sts;
+}
+
 int
 pmFetch_ctx(__pmContext *ctxp, int numpmid, pmID *pmidlist, __pmResult **result)
 {
@@ -293,6 +729,58 @@ pmFetchHighRes(int numpmid, pmID *pmidlist, pmHighResResult **result)
     return sts;
 }
 
+int
+pmFetchMany(int nctx, const int *ctxids, int numpmid, pmID *pmidlist,
+		pmResult **results, int *status)
+{
+    __pmResult	**rpp;
+    __pmTimestamp	tmp;
+    int		i, sts;
+
+    if (nctx < 1)
+	return PM_ERR_TOOSMALL;
+    if ((rpp = (__pmResult **)calloc(nctx, sizeof(*rpp))) == NULL)
+	return -oserror();
+    sts = __pmFetchMany(nctx, ctxids, numpmid, pmidlist, rpp, status);
+    for (i = 0; i < nctx; i++) {
+	results[i] = NULL;
+	if (sts >= 0 && rpp[i] != NULL) {
+	    tmp = rpp[i]->timestamp;	/* struct copy */
+	    results[i] = __pmOffsetResult(rpp[i]);
+	    results[i]->timestamp.tv_sec = tmp.sec;
+	    results[i]->timestamp.tv_usec = tmp.nsec / 1000;
+	}
+    }
+    free(rpp);
+    return sts;
+}
+
+int
+pmFetchHighResMany(int nctx, const int *ctxids, int numpmid, pmID *pmidlist,
+		pmHighResResult **results, int *status)
+{
+    __pmResult	**rpp;
+    __pmTimestamp	tmp;
+    int		i, sts;
+
+    if (nctx < 1)
+	return PM_ERR_TOOSMALL;
+    if ((rpp = (__pmResult **)calloc(nctx, sizeof(*rpp))) == NULL)
+	return -oserror();
+    sts = __pmFetchMany(nctx, ctxids, numpmid, pmidlist, rpp, status);
+    for (i = 0; i < nctx; i++) {
+	results[i] = NULL;
+	if (sts >= 0 && rpp[i] != NULL) {
+	    tmp = rpp[i]->timestamp;	/* struct copy */
+	    results[i] = __pmOffsetHighResResult(rpp[i]);
+	    results[i]->timestamp.tv_sec = tmp.sec;
+	    results[i]->timestamp.tv_nsec = tmp.nsec;
+	}
+    }
+    free(rpp);
+    return sts;
+}
+
 /*
  * older name, maintained for backwards compatibility
  */
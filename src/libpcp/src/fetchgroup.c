@@ -16,6 +16,7 @@
 #include "libpcp.h"
 #include "internal.h"
 #include <math.h>
+#include <ctype.h>
 #include <assert.h>
 #include <inttypes.h>
 #include <limits.h>
@@ -48,6 +49,10 @@ struct __pmFetchGroup {
     pmID *unique_pmids;
     size_t num_unique_pmids;
     size_t num_unique_indoms;
+    struct timespec stamp;	/* of the last pmFetchGroup */
+    char *text;			/* pmFormatFetchGroup buffer, reused */
+    size_t textlen;
+    size_t textsize;
 };
 
 /*
@@ -58,6 +63,8 @@ struct __pmFetchGroupConversionSpec {
     unsigned unit_convert : 1;
     pmUnits output_units;	/* NB: same dim* as input units; maybe different scale */
     double output_multiplier;
+    pmConvPlan plan;		/* input to output_units, if unit_convert */
+    int plan_sts;		/* pmConvScalePlan error, reported per value */
 };
 typedef struct __pmFetchGroupConversionSpec *pmFGC;
 
@@ -73,6 +80,8 @@ struct __pmFetchGroupItem {
 
     union {
 	struct {
+	    char *metric_name;	/* for pmFormatFetchGroup */
+	    char *inst_name;	/* ditto, NULL if metric_desc.indom == PM_INDOM_NULL */
 	    pmID metric_pmid;
 	    pmDesc metric_desc;
 	    int metric_inst;	/* unused if metric_desc.indom == PM_INDOM_NULL */
@@ -80,8 +89,10 @@ struct __pmFetchGroupItem {
 	    pmAtomValue *output_value;	/* NB: may be NULL */
 	    int output_type;	/* PM_TYPE_* */
 	    int *output_sts;	/* NB: may be NULL */
+	    int vset_hint;	/* index of metric_pmid in the last result */
 	} item;
 	struct {
+	    char *metric_name;	/* for pmFormatFetchGroup */
 	    pmID metric_pmid;
 	    pmDesc metric_desc;
 	    struct __pmFetchGroupConversionSpec conv;
@@ -93,6 +104,11 @@ struct __pmFetchGroupItem {
 	    int *output_sts;	/* NB: may be NULL */
 	    unsigned output_maxnum;
 	    unsigned *output_num;	/* NB: may be NULL */
+	    __pmColumn column;		/* values from this result */
+	    __pmColumn prev_column;	/* values from prevResult, for rates */
+	    int vset_hint;	/* index of metric_pmid in the last result */
+	    int cache;		/* index into unique_indoms, or -1 */
+	    unsigned filled;	/* outputs set by the last fetch */
 	} indom;
 	struct {
 	    pmID metric_pmid;
@@ -215,6 +231,7 @@ pmfg_lookup_indom(pmFG pmfg, const char *metric, pmFGI item)
 	return sts;
 
     /* As a convenience to users, we also accept non-indom'd metrics */
+    item->u.indom.cache = -1;
     if ((indom = item->u.indom.metric_desc.indom) == PM_INDOM_NULL)
 	return 0;
 
@@ -222,8 +239,10 @@ pmfg_lookup_indom(pmFG pmfg, const char *metric, pmFGI item)
      * Insert into the instance domain cache if not seen previously
      */
     for (i = 0; i < pmfg->num_unique_indoms; i++) {
-	if (pmfg->unique_indoms[i].indom == indom)
+	if (pmfg->unique_indoms[i].indom == indom) {
+	    item->u.indom.cache = i;
 	    return 0;
+	}
     }
 
     size = sizeof(struct __pmInDomCache) * (pmfg->num_unique_indoms + 1);
@@ -236,7 +255,7 @@ pmfg_lookup_indom(pmFG pmfg, const char *metric, pmFGI item)
     pmfg->unique_indoms[pmfg->num_unique_indoms].codes = NULL;
     pmfg->unique_indoms[pmfg->num_unique_indoms].names = NULL;
     pmfg->unique_indoms[pmfg->num_unique_indoms].refreshed = 0;
-    pmfg->num_unique_indoms++;
+    item->u.indom.cache = pmfg->num_unique_indoms++;
 
     /*
      * Add all instances; this will override any other past or future
@@ -357,6 +376,8 @@ pmfg_prep_conversion(const pmDesc *desc, const char *scale, pmFGC conv, int otyp
 	    desc->units.dimTime == conv->output_units.dimTime) {
 	    conv->unit_convert = 1;
 	    conv->rate_convert = 0;
+	    conv->plan_sts = pmConvScalePlan(PM_TYPE_DOUBLE, &desc->units,
+				&conv->output_units, &conv->plan);
 	    return 0;
 	}
 	if (desc->units.dimSpace == conv->output_units.dimSpace &&
@@ -387,6 +408,8 @@ pmfg_prep_conversion(const pmDesc *desc, const char *scale, pmFGC conv, int otyp
 	    conv->output_units.dimTime++;	/* Adjust back to normal dim */
 	    conv->unit_convert = 1;
 	    conv->rate_convert = 1;
+	    conv->plan_sts = pmConvScalePlan(PM_TYPE_DOUBLE, &desc->units,
+				&conv->output_units, &conv->plan);
 	    return 0;
 	}
 	return PM_ERR_CONV;
@@ -587,8 +610,8 @@ pmfg_reinit_item(pmFGI item)
     if (item->u.item.output_value)
 	__pmReinitValue(out_value, item->u.item.output_type);
 
-    if (item->u.indom.output_sts)
-	*item->u.indom.output_sts = PM_ERR_VALUE;
+    if (item->u.item.output_sts)
+	*item->u.item.output_sts = PM_ERR_VALUE;
 }
 
 static void
@@ -599,20 +622,25 @@ pmfg_reinit_indom(pmFGI item)
     assert(item != NULL);
     assert(item->type == pmfg_indom);
 
+    /*
+     * Only the outputs set by the last fetch need clearing, the rest
+     * are still as the reinit before it left them.
+     */
     if (item->u.indom.output_values)
-	for (i = 0; i < item->u.indom.output_maxnum; i++)
+	for (i = 0; i < item->u.indom.filled; i++)
 	    __pmReinitValue(&item->u.indom.output_values[i], item->u.indom.output_type);
 
     if (item->u.indom.output_inst_names)
-	for (i = 0; i < item->u.indom.output_maxnum; i++)
+	for (i = 0; i < item->u.indom.filled; i++)
 	    item->u.indom.output_inst_names[i] = NULL;	/* ptr into names[] */
 
     if (item->u.indom.output_stss)
-	for (i = 0; i < item->u.indom.output_maxnum; i++)
+	for (i = 0; i < item->u.indom.filled; i++)
 	    item->u.indom.output_stss[i] = PM_ERR_VALUE;
 
     if (item->u.indom.output_num)
 	*item->u.indom.output_num = 0;
+    item->u.indom.filled = 0;
 }
 
 static void
@@ -649,6 +677,53 @@ pmfg_reinit_event(pmFGI item)
     }
 }
 
+/*
+ * Index of the pmValueSet for pmid in the result, else -1 ... hint is
+ * where it was last time, which is almost always where it still is as
+ * each fetch asks for the same pmIDs in the same order.
+ */
+static int
+pmfg_find_vset(const pmHighResResult *result, pmID pmid, int *hint)
+{
+    int i;
+
+    if (*hint < result->numpmid && result->vset[*hint]->pmid == pmid)
+	return *hint;
+    for (i = 0; i < result->numpmid; i++) {
+	if (result->vset[i]->pmid == pmid) {
+	    *hint = i;
+	    return i;
+	}
+    }
+    return -1;
+}
+
+/*
+ * Index of inst in the instance domain cache, else -1 ... the search
+ * starts at hint, after the previous instance found, so walking the
+ * (sorted) instances of a result costs one comparison per instance
+ * when the cache holds them in the same order.
+ */
+static int
+pmfg_find_inst(const struct __pmInDomCache *cache, int inst, unsigned int *hint)
+{
+    unsigned int k;
+
+    for (k = *hint; k < cache->size; k++) {
+	if (cache->codes[k] == inst)
+	    goto found;
+    }
+    for (k = 0; k < *hint && k < cache->size; k++) {
+	if (cache->codes[k] == inst)
+	    goto found;
+    }
+    return -1;
+
+found:
+    *hint = k + 1;
+    return k;
+}
+
 /*
  * Find the pmValue corresponding to the item within the given
  * valueset.  Convert it to given output type, including possible
@@ -691,24 +766,16 @@ pmfg_extract_item(pmID metric_pmid, int metric_inst, int first_vset,
 static int
 pmfg_convert_double(const pmDesc *desc, const pmFGC conv, double *value)
 {
-    pmAtomValue v, v_scaled;
-    int sts;
-
     assert(value != NULL);
 
     if (!conv->unit_convert)
 	return 0;
 
-    v.d = *value;
-
-    /* Unit conversion. */
-    sts = pmConvScale(PM_TYPE_DOUBLE, &v, &desc->units,
-			&v_scaled, &conv->output_units);
-    if (sts)
-	return sts;
-
-    *value = v_scaled.d * conv->output_multiplier;
-    return sts;
+    /* Unit conversion, planned at pmfg_prep_conversion */
+    if (conv->plan_sts < 0)
+	return conv->plan_sts;
+    *value = (*value * conv->plan.scale) * conv->output_multiplier;
+    return 0;
 }
 
 static int
@@ -806,6 +873,117 @@ pmfg_extract_convert_item(pmFG pmfg, pmID metric_pmid, int metric_inst,
     return __pmStuffDoubleValue(value, oval, otype);
 }
 
+/*
+ * Numeric metrics can be extracted a whole pmValueSet at a time, see
+ * __pmExtractColumn(), as double if there is scaling or rate conversion
+ * to be done, else directly as the output type ... returns the column
+ * type, or PM_TYPE_UNKNOWN when values must be extracted one at a time.
+ */
+static int
+pmfg_column_type(int metric_type, const pmFGC conv, int otype)
+{
+    switch (metric_type) {
+	case PM_TYPE_32:
+	case PM_TYPE_U32:
+	case PM_TYPE_64:
+	case PM_TYPE_U64:
+	case PM_TYPE_FLOAT:
+	case PM_TYPE_DOUBLE:
+	    break;
+	default:
+	    return PM_TYPE_UNKNOWN;
+    }
+    if (conv->rate_convert || conv->unit_convert)
+	return PM_TYPE_DOUBLE;
+    switch (otype) {
+	case PM_TYPE_32:
+	case PM_TYPE_U32:
+	case PM_TYPE_64:
+	case PM_TYPE_U64:
+	case PM_TYPE_FLOAT:
+	case PM_TYPE_DOUBLE:
+	    return otype;
+    }
+    return PM_TYPE_UNKNOWN;
+}
+
+/*
+ * Value j from the column, scaled and rate converted as for
+ * pmfg_extract_convert_item() ... prev is the column from the
+ * previous result (NULL if there is none) and prev_sts is the error
+ * if the metric is missing from it, deltaT is the time between the
+ * results.
+ */
+static int
+pmfg_column_value(pmFG pmfg, const __pmColumn *col, int j,
+		  const __pmColumn *prev, int prev_sts, double deltaT,
+		  const pmDesc *desc, const pmFGC conv,
+		  pmAtomValue *oval, int otype)
+{
+    double value, delta;
+    int k;
+    int sts;
+
+    if (col->sts[j] < 0)
+	return col->sts[j];
+
+    if (!conv->rate_convert && !conv->unit_convert) {
+	switch (col->type) {
+	    case PM_TYPE_32:
+		oval->l = col->value.l[j];
+		break;
+	    case PM_TYPE_U32:
+		oval->ul = col->value.ul[j];
+		break;
+	    case PM_TYPE_64:
+		oval->ll = col->value.ll[j];
+		break;
+	    case PM_TYPE_U64:
+		oval->ull = col->value.ull[j];
+		break;
+	    case PM_TYPE_FLOAT:
+		oval->f = col->value.f[j];
+		break;
+	    case PM_TYPE_DOUBLE:
+		oval->d = col->value.d[j];
+		break;
+	}
+	return 0;
+    }
+
+    value = col->value.d[j];
+    if (conv->rate_convert) {
+	if (prev == NULL)	/* no previous result */
+	    return PM_ERR_AGAIN;
+	if (prev_sts < 0)
+	    return prev_sts;
+	if ((k = __pmColumnIndex(prev, col->inst[j], j)) < 0)
+	    return PM_ERR_VALUE;
+	if (prev->sts[k] < 0)
+	    return prev->sts[k];
+
+	sts = 0;
+	delta = value - prev->value.d[k];
+	if (delta < 0.0)
+	    sts = pmfg_unwrap_counter(pmfg, desc->type, &delta);
+	/* NB: "metric_units / second", see pmfg_extract_convert_item() */
+	if (sts == 0) {
+	    delta /= deltaT;
+	    sts = pmfg_convert_double(desc, conv, &delta);
+	}
+	if (sts)
+	    return sts;
+	value = delta;
+    }
+    else {			/* no rate conversion */
+	sts = pmfg_convert_double(desc, conv, &value);
+	if (sts)
+	    return sts;
+    }
+
+    return __pmStuffDoubleValue(value, oval, otype);
+}
+
 static void
 pmfg_fetch_item(pmFG pmfg, pmFGI item, pmHighResResult *newResult)
 {
@@ -817,28 +995,30 @@ pmfg_fetch_item(pmFG pmfg, pmFGI item, pmHighResResult *newResult)
     assert(item->type == pmfg_item);
     assert(newResult != NULL);
 
+    /* Find our pmid in the newResult, searching no further below. */
+    i = pmfg_find_vset(newResult, item->u.item.metric_pmid,
+			&item->u.item.vset_hint);
+
     /*
      * If we have some values, then DISCRETE preserved values should
      * be cleared now.
      */
-    if (item->u.item.metric_desc.sem == PM_SEM_DISCRETE) {
-	for (i = 0; i < newResult->numpmid; i++) {
-	    if (newResult->vset[i]->pmid == item->u.item.metric_pmid) {
-		if (newResult->vset[i]->numval > 0) {
-		    pmfg_reinit_item(item);
-		    break;
-		} else if (newResult->vset[i]->numval == 0) {
-		    return; /* NB: leave outputs alone. */
-		}
-	    }
-	}
+    if (item->u.item.metric_desc.sem == PM_SEM_DISCRETE && i >= 0) {
+	if (newResult->vset[i]->numval > 0)
+	    pmfg_reinit_item(item);
+	else if (newResult->vset[i]->numval == 0)
+	    return; /* NB: leave outputs alone. */
     }
 
+    if (i < 0) {
+	sts = PM_ERR_VALUE;
+	goto out;
+    }
     if (item->u.item.conv.rate_convert || item->u.item.conv.unit_convert) {
 	sts = pmfg_extract_convert_item(pmfg,
 			item->u.item.metric_pmid, item->u.item.metric_inst, 0,
 		 	&item->u.item.metric_desc, &item->u.item.conv,
-			newResult->vset, newResult->numpmid, &newResult->timestamp,
+			&newResult->vset[i], 1, &newResult->timestamp,
 			&v, item->u.item.output_type);
 	if (sts < 0)
 	    goto out;
@@ -847,7 +1027,7 @@ pmfg_fetch_item(pmFG pmfg, pmFGI item, pmHighResResult *newResult)
 	sts = pmfg_extract_item(item->u.item.metric_pmid,
 			item->u.item.metric_inst, 0,
 			&item->u.item.metric_desc,
-			newResult->vset, newResult->numpmid,
+			&newResult->vset[i], 1,
 			&v, item->u.item.output_type);
 	if (sts < 0)
 	    goto out;
@@ -890,11 +1070,15 @@ pmfg_fetch_timeval(pmFG pmfg, pmFGI item, pmHighResResult *newResult)
 static void
 pmfg_fetch_indom(pmFG pmfg, pmFGI item, pmHighResResult *newResult)
 {
-    int i, sts = 0;
-    unsigned int j, k;
+    int i, k, sts = 0;
+    unsigned int j, hint;
     struct __pmInDomCache *cache;
     const pmValueSet *iv;
-    pmInDom indom;
+    int ctype;
+    __pmColumn *col = NULL;
+    __pmColumn *prev = NULL;
+    int prev_sts = 0;
+    double deltaT = 0.0;
 
     assert(item != NULL);
     assert(item->type == pmfg_indom);
@@ -905,11 +1089,9 @@ pmfg_fetch_indom(pmFG pmfg, pmFGI item, pmHighResResult *newResult)
      * find the corresponding pmid (and each instance) anew in the previous
      * result.
      */
-    for (i = 0; i < newResult->numpmid; i++) {
-	if (newResult->vset[i]->pmid == item->u.indom.metric_pmid)
-	    break;
-    }
-    if (i >= newResult->numpmid) {
+    i = pmfg_find_vset(newResult, item->u.indom.metric_pmid,
+			&item->u.indom.vset_hint);
+    if (i < 0) {
 	sts = PM_ERR_VALUE;
 	goto out;
     }
@@ -936,21 +1118,14 @@ pmfg_fetch_indom(pmFG pmfg, pmFGI item, pmHighResResult *newResult)
      * Analyze newResult to see whether it only contains instances we
      * already know.
      */
-    cache = NULL;
-    indom = item->u.indom.metric_desc.indom;
-    for (j = 0; j < pmfg->num_unique_indoms; j++) {
-	if (indom != pmfg->unique_indoms[j].indom)
-	    continue;
-	cache = &pmfg->unique_indoms[j];
-	break;
-    }
+    if (item->u.indom.cache < 0)
+	cache = NULL;
+    else
+	cache = &pmfg->unique_indoms[item->u.indom.cache];
     if (cache && cache->refreshed &&
 	item->u.indom.output_inst_names) {	/* Caller interested at all? */
-	for (j = 0; j < (unsigned int)iv->numval; j++) {
-	    for (k = 0; k < cache->size; k++)
-		if (cache->codes[k] == iv->vlist[j].inst)
-		    break;
-	    if (k >= cache->size) {
+	for (j = 0, hint = 0; j < (unsigned int)iv->numval; j++) {
+	    if (pmfg_find_inst(cache, iv->vlist[j].inst, &hint) < 0) {
 		cache->refreshed = 0;
 		break;
 	    }
@@ -964,7 +1139,7 @@ pmfg_fetch_indom(pmFG pmfg, pmFGI item, pmHighResResult *newResult)
 	cache->codes = NULL;
 	cache->names = NULL;
 
-	sts = pmGetInDom(indom, &cache->codes, &cache->names);
+	sts = pmGetInDom(cache->indom, &cache->codes, &cache->names);
 	if (sts < 1) {
 	    if (sts < 0)
 		cache->refreshed = 0;
@@ -981,18 +1156,50 @@ pmfg_fetch_indom(pmFG pmfg, pmFGI item, pmHighResResult *newResult)
 	sts = 0;
     }
 
+    /*
+     * For numeric metrics, extract all of the values at once (and
+     * those from the previous result for rate conversion) rather than
+     * searching the results again for each instance.
+     */
+    ctype = pmfg_column_type(item->u.indom.metric_desc.type,
+			     &item->u.indom.conv, item->u.indom.output_type);
+    if (ctype != PM_TYPE_UNKNOWN &&
+	__pmExtractColumn(iv, item->u.indom.metric_desc.type, ctype,
+			  &item->u.indom.column) >= 0) {
+	col = &item->u.indom.column;
+	if (item->u.indom.conv.rate_convert && pmfg->prevResult) {
+	    pmHighResResult *prev_r = pmfg->prevResult;
+	    const double epsilon = 0.000000001;	/* 1 nanosecond */
+
+	    deltaT = pmtimespecSub(&newResult->timestamp, &prev_r->timestamp);
+	    if (deltaT < epsilon)	/* avoid division by zero */
+		deltaT = epsilon;	/* (chose not to PM_ERR_CONV here) */
+
+	    prev = &item->u.indom.prev_column;
+	    prev_sts = PM_ERR_VALUE;
+	    k = item->u.indom.vset_hint;
+	    if (pmfg_find_vset(prev_r, item->u.indom.metric_pmid, &k) >= 0) {
+		prev_sts = __pmExtractColumn(prev_r->vset[k],
+				item->u.indom.metric_desc.type, ctype, prev);
+		if (prev_sts == 0)	/* no instances to match */
+		    prev_sts = PM_ERR_VALUE;
+	    }
+	}
+    }
+
     /*
      * Process each instance element in the pmValueSet.	 We persevere
      * in the face of per-item errors (including conversion errors),
      * since we signal individual errors, except once we run out of
      * output space.
      */
-    for (j = 0; j < (unsigned)iv->numval; j++) {
+    for (j = 0, hint = 0; j < (unsigned)iv->numval; j++) {
 	const pmValue *jv = &iv->vlist[j];
 	pmAtomValue v;
 	int stss = 0;
 
 	if (j >= item->u.indom.output_maxnum) {	/* too many instances! */
+	    item->u.indom.filled = j;
 	    sts = PM_ERR_TOOBIG;
 	    goto out;
 	}
@@ -1008,37 +1215,40 @@ pmfg_fetch_indom(pmFG pmfg, pmFGI item, pmHighResResult *newResult)
 	if (item->u.indom.output_inst_names) {
 	    if (cache == NULL)
 		item->u.indom.output_inst_names[j] = NULL;
-	    else {
-	        for (k = 0; k < cache->size; k++) {
-		    if (cache->codes[k] == jv->inst) {
-			/*
-			 * NB: copy the indom name char* by value.
-			 * User may not modify / free this pointer,
-			 * nor use it after subsequent fetch / delete.
-			 */
-			item->u.indom.output_inst_names[j] = cache->names[k];
-			break;
-		    }
-		}
+	    else if ((k = pmfg_find_inst(cache, jv->inst, &hint)) >= 0) {
+		/*
+		 * NB: copy the indom name char* by value.
+		 * User may not modify / free this pointer,
+		 * nor use it after subsequent fetch / delete.
+		 */
+		item->u.indom.output_inst_names[j] = cache->names[k];
 	    }
 	}
 
 	/* Fetch & convert the actual value. */
-	if (item->u.indom.conv.rate_convert ||
+	if (col != NULL) {
+	    stss = pmfg_column_value(pmfg, col, j, prev, prev_sts, deltaT,
+				&item->u.indom.metric_desc,
+				&item->u.indom.conv,
+				&v, item->u.indom.output_type);
+	    if (stss < 0)
+		goto out1;
+	}
+	else if (item->u.indom.conv.rate_convert ||
 	    item->u.indom.conv.unit_convert) {
 	    stss = pmfg_extract_convert_item(pmfg, item->u.indom.metric_pmid,
 				jv->inst, 0, &item->u.indom.metric_desc,
 				&item->u.indom.conv,
-				newResult->vset, newResult->numpmid,
+				&newResult->vset[i], 1,
 				&newResult->timestamp,
 				&v, item->u.indom.output_type);
 	    if (stss < 0)
 		goto out1;
 	}
 	else {
-	    stss = pmfg_extract_item(item->u.indom.metric_pmid, jv->inst,
-				0, &item->u.indom.metric_desc,
-				newResult->vset, newResult->numpmid, &v,
+	    /* NB: jv is already the pmValue pmfg_extract_item() would find */
+	    stss = __pmExtractValue2(iv->valfmt, jv,
+				item->u.indom.metric_desc.type, &v,
 				item->u.indom.output_type);
 	    if (stss < 0)
 		goto out1;
@@ -1052,6 +1262,7 @@ out1:
 	if (item->u.indom.output_stss)
 	    item->u.indom.output_stss[j] = stss;
     }
+    item->u.indom.filled = j;
 
     if (item->u.indom.output_num)
 	*item->u.indom.output_num = j;
@@ -1391,6 +1602,12 @@ pmExtendFetchGroup_item(pmFG pmfg,
     if (sts != 0)
 	goto out;
 
+    if ((item->u.item.metric_name = strdup(metric)) == NULL ||
+	(instance && (item->u.item.inst_name = strdup(instance)) == NULL)) {
+	sts = -ENOMEM;
+	goto out;
+    }
+
     sts = pmfg_add_pmid(pmfg, item->u.item.metric_pmid);
     if (sts != 0)
 	goto out;
@@ -1411,6 +1628,8 @@ pmExtendFetchGroup_item(pmFG pmfg,
     return 0;
 
 out:
+    free(item->u.item.metric_name);
+    free(item->u.item.inst_name);
     free(item);
 
     return sts;
@@ -1504,6 +1723,11 @@ pmExtendFetchGroup_indom(pmFG pmfg,
     if (sts != 0)
 	goto out;
 
+    if ((item->u.indom.metric_name = strdup(metric)) == NULL) {
+	sts = -ENOMEM;
+	goto out;
+    }
+
     sts = pmfg_add_pmid(pmfg, item->u.indom.metric_pmid);
     if (sts < 0)
 	goto out;
@@ -1522,6 +1746,7 @@ pmExtendFetchGroup_indom(pmFG pmfg,
 	memset(out_values, 0, sizeof(pmAtomValue) * out_maxnum);
     if (out_num)
 	*out_num = 0;
+    item->u.indom.filled = out_maxnum;
     pmfg_reinit_indom(item);
 
     /* link in */
@@ -1530,6 +1755,7 @@ pmExtendFetchGroup_indom(pmFG pmfg,
     return 0;
 
 out:
+    free(item->u.indom.metric_name);
     free(item);
     return sts;
 }
@@ -1717,6 +1943,7 @@ pmFetchGroup(pmFG pmfg)
 
     /* Sort instances so that the indom fetchgroups come out conveniently */
     pmSortHighResInstances(newResult);
+    pmfg->stamp = newResult->timestamp;
 
     /* Walk the fetchgroup. */
     for (item = pmfg->items; item; item = item->next) {
@@ -1757,6 +1984,503 @@ pmFetchGroup(pmFG pmfg)
     return sts;
 }
 
+/*
+ * Rendering of fetchgroup values for pmFormatFetchGroup, into a text
+ * buffer kept with the fetchgroup and reused from one call to the next.
+ */
+static int
+pmfg_text_grow(pmFG pmfg, size_t need)
+{
+    size_t size;
+    char *text;
+
+    if (pmfg->textlen + need < pmfg->textsize)
+	return 0;
+    size = pmfg->textsize ? pmfg->textsize : 4096;
+    while (size <= pmfg->textlen + need)
+	size *= 2;
+    if ((text = realloc(pmfg->text, size)) == NULL)
+	return -ENOMEM;
+    pmfg->text = text;
+    pmfg->textsize = size;
+    return 0;
+}
+
+static int
+pmfg_text_put(pmFG pmfg, const char *str, size_t len)
+{
+    if (pmfg_text_grow(pmfg, len) < 0)
+	return -ENOMEM;
+    memcpy(pmfg->text + pmfg->textlen, str, len);
+    pmfg->textlen += len;
+    pmfg->text[pmfg->textlen] = '\0';
+    return 0;
+}
+
+static int
+pmfg_text_puts(pmFG pmfg, const char *str)
+{
+    return pmfg_text_put(pmfg, str, strlen(str));
+}
+
+static int
+pmfg_text_putc(pmFG pmfg, char c)
+{
+    return pmfg_text_put(pmfg, &c, 1);
+}
+
+/* str as a JSON string, with quotes */
+static int
+pmfg_text_json(pmFG pmfg, const char *str)
+{
+    const char *p;
+    char esc[8];
+    int sts = pmfg_text_putc(pmfg, '"');
+
+    for (p = str; *p && sts == 0; p++) {
+	switch (*p) {
+	    case '"':
+		sts = pmfg_text_put(pmfg, "\\\"", 2);
+		break;
+	    case '\\':
+		sts = pmfg_text_put(pmfg, "\\\\", 2);
+		break;
+	    case '\n':
+		sts = pmfg_text_put(pmfg, "\\n", 2);
+		break;
+	    case '\r':
+		sts = pmfg_text_put(pmfg, "\\r", 2);
+		break;
+	    case '\t':
+		sts = pmfg_text_put(pmfg, "\\t", 2);
+		break;
+	    default:
+		if ((unsigned char)*p < 0x20) {
+		    pmsprintf(esc, sizeof(esc), "\\u%04x", (unsigned char)*p);
+		    sts = pmfg_text_puts(pmfg, esc);
+		}
+		else
+		    sts = pmfg_text_putc(pmfg, *p);
+	}
+    }
+    return sts ? sts : pmfg_text_putc(pmfg, '"');
+}
+
+/* str as a CSV field, quoted (RFC 4180) only if it needs to be */
+static int
+pmfg_text_csv(pmFG pmfg, const char *str)
+{
+    const char *p;
+    int sts;
+
+    if (strpbrk(str, ",\"\r\n") == NULL)
+	return pmfg_text_puts(pmfg, str);
+    sts = pmfg_text_putc(pmfg, '"');
+    for (p = str; *p && sts == 0; p++) {
+	if (*p == '"')
+	    sts = pmfg_text_putc(pmfg, '"');
+	if (sts == 0)
+	    sts = pmfg_text_putc(pmfg, *p);
+    }
+    return sts ? sts : pmfg_text_putc(pmfg, '"');
+}
+
+/*
+ * Line protocol names, as pcp2influxdb(1) makes them ... the metric
+ * name with '.' and '-' as '_' (and no "__") is the measurement, and
+ * the field key is the instance name prefixed by '_', with anything
+ * but [a-zA-Z0-9_-] as '_', or "value" for a metric without instances.
+ */
+static int
+pmfg_text_measurement(pmFG pmfg, const char *name)
+{
+    const char *p;
+    char c, last = '\0';
+    int sts = 0;
+
+    for (p = name; *p && sts == 0; p++) {
+	c = (*p == '.' || *p == '-') ? '_' : *p;
+	if (c == '_' && last == '_')
+	    continue;
+	if (c == ',' || c == ' ' || c == '\\')
+	    sts = pmfg_text_putc(pmfg, '\\');
+	if (sts == 0)
+	    sts = pmfg_text_putc(pmfg, c);
+	last = c;
+    }
+    return sts;
+}
+
+static int
+pmfg_text_fieldkey(pmFG pmfg, const char *inst)
+{
+    const char *p;
+    int sts;
+
+    if (inst == NULL)
+	return pmfg_text_put(pmfg, "value", 5);
+    sts = pmfg_text_putc(pmfg, '_');
+    for (p = inst; *p && sts == 0; p++) {
+	if (isalnum((unsigned char)*p) || *p == '_' || *p == '-')
+	    sts = pmfg_text_putc(pmfg, *p);
+	else
+	    sts = pmfg_text_putc(pmfg, '_');
+    }
+    return sts;
+}
+
+static int
+pmfg_text_linestr(pmFG pmfg, const char *str)
+{
+    const char *p;
+    int sts = pmfg_text_putc(pmfg, '"');
+
+    for (p = str; *p && sts == 0; p++) {
+	if (*p == '"' || *p == '\\')
+	    sts = pmfg_text_putc(pmfg, '\\');
+	if (sts == 0)
+	    sts = pmfg_text_putc(pmfg, *p);
+    }
+    return sts ? sts : pmfg_text_putc(pmfg, '"');
+}
+
+/*
+ * Shortest %g form that reads back as the same value ... returns 0,
+ * or -1 for a NaN or infinity, which none of the formats can express.
+ */
+static int
+pmfg_format_real(double value, int isfloat, char *buf, size_t size)
+{
+    int prec, maxprec = isfloat ? 9 : 17;	/* {FLT,DBL}_DECIMAL_DIG */
+
+    if (isnan(value) || isinf(value))
+	return -1;
+    for (prec = isfloat ? 6 : 15; prec < maxprec; prec++) {
+	pmsprintf(buf, size, "%.*g", prec, value);
+	if (isfloat ? (float)strtod(buf, NULL) == (float)value :
+		      strtod(buf, NULL) == value)
+	    return 0;
+    }
+    pmsprintf(buf, size, "%.*g", maxprec, value);
+    return 0;
+}
+
+/*
+ * One value, of the fetchgroup output type, in the given format ...
+ * returns 1 if the value cannot be expressed (so nothing was added).
+ */
+static int
+pmfg_text_value(pmFG pmfg, int format, const pmAtomValue *avp, int type)
+{
+    char buf[64];
+
+    switch (type) {
+	case PM_TYPE_32:
+	    pmsprintf(buf, sizeof(buf), "%d", avp->l);
+	    break;
+	case PM_TYPE_U32:
+	    pmsprintf(buf, sizeof(buf), "%u", avp->ul);
+	    break;
+	case PM_TYPE_64:
+	    pmsprintf(buf, sizeof(buf), "%" PRIi64, avp->ll);
+	    break;
+	case PM_TYPE_U64:
+	    pmsprintf(buf, sizeof(buf), "%" PRIu64, avp->ull);
+	    break;
+	case PM_TYPE_FLOAT:
+	    if (pmfg_format_real(avp->f, 1, buf, sizeof(buf)) < 0)
+		return 1;
+	    break;
+	case PM_TYPE_DOUBLE:
+	    if (pmfg_format_real(avp->d, 0, buf, sizeof(buf)) < 0)
+		return 1;
+	    break;
+	case PM_TYPE_STRING:
+	    if (avp->cp == NULL)
+		return 1;
+	    if (format == PM_FG_FORMAT_JSON)
+		return pmfg_text_json(pmfg, avp->cp);
+	    if (format == PM_FG_FORMAT_CSV)
+		return pmfg_text_csv(pmfg, avp->cp);
+	    return pmfg_text_linestr(pmfg, avp->cp);
+	default:
+	    return 1;
+    }
+    return pmfg_text_puts(pmfg, buf);
+}
+
+/*
+ * Render the values of one item, which are in the same output
+ * variables the application sees, of nvalues instances (inst is NULL
+ * for a metric without instances) ... each format shares only the
+ * walk over the values, so this is one routine per format.
+ */
+static int
+pmfg_render_json(pmFG pmfg, const char *metric, int nvalues, int indom,
+		const pmAtomValue *values, const int *stss, int type,
+		char * const *names, const int *codes, int *firstp)
+{
+    char buf[32];
+    const char *inst;
+    int j, first = 1, sts;
+
+    if ((sts = pmfg_text_puts(pmfg, *firstp ? "" : ",")) < 0 ||
+	(sts = pmfg_text_json(pmfg, metric)) < 0 ||
+	(sts = pmfg_text_putc(pmfg, ':')) < 0)
+	return sts;
+    *firstp = 0;
+    if (!indom) {
+	if (nvalues < 1 || (stss && stss[0] < 0) ||
+	    (sts = pmfg_text_value(pmfg, PM_FG_FORMAT_JSON, &values[0], type)) == 1)
+	    sts = pmfg_text_put(pmfg, "null", 4);
+	return sts;
+    }
+    if ((sts = pmfg_text_putc(pmfg, '{')) < 0)
+	return sts;
+    for (j = 0; j < nvalues; j++) {
+	if (stss && stss[j] < 0)
+	    continue;
+	if (names && names[j])
+	    inst = names[j];
+	else {
+	    pmsprintf(buf, sizeof(buf), "%d", codes[j]);
+	    inst = buf;
+	}
+	if ((sts = pmfg_text_puts(pmfg, first ? "" : ",")) < 0 ||
+	    (sts = pmfg_text_json(pmfg, inst)) < 0 ||
+	    (sts = pmfg_text_putc(pmfg, ':')) < 0)
+	    return sts;
+	if ((sts = pmfg_text_value(pmfg, PM_FG_FORMAT_JSON, &values[j], type)) == 1)
+	    sts = pmfg_text_put(pmfg, "null", 4);
+	if (sts < 0)
+	    return sts;
+	first = 0;
+    }
+    return pmfg_text_putc(pmfg, '}');
+}
+
+static int
+pmfg_render_csv(pmFG pmfg, const char *metric, int nvalues, int indom,
+		const pmAtomValue *values, const int *stss, int type,
+		char * const *names, const int *codes, const char *stamp)
+{
+    char buf[32];
+    size_t mark;
+    int j, sts;
+
+    for (j = 0; j < nvalues; j++) {
+	if (stss && stss[j] < 0)
+	    continue;
+	mark = pmfg->textlen;
+	if ((sts = pmfg_text_puts(pmfg, stamp)) < 0 ||
+	    (sts = pmfg_text_putc(pmfg, ',')) < 0 ||
+	    (sts = pmfg_text_csv(pmfg, metric)) < 0 ||
+	    (sts = pmfg_text_putc(pmfg, ',')) < 0)
+	    return sts;
+	if (indom) {
+	    if (names && names[j])
+		sts = pmfg_text_csv(pmfg, names[j]);
+	    else {
+		pmsprintf(buf, sizeof(buf), "%d", codes[j]);
+		sts = pmfg_text_puts(pmfg, buf);
+	    }
+	    if (sts < 0)
+		return sts;
+	}
+	if ((sts = pmfg_text_putc(pmfg, ',')) < 0)
+	    return sts;
+	if ((sts = pmfg_text_value(pmfg, PM_FG_FORMAT_CSV, &values[j], type)) == 1) {
+	    /* no row at all for a value that cannot be expressed */
+	    pmfg->textlen = mark;
+	    pmfg->text[mark] = '\0';
+	    continue;
+	}
+	if (sts < 0 || (sts = pmfg_text_putc(pmfg, '\n')) < 0)
+	    return sts;
+    }
+    return 0;
+}
+
+static int
+pmfg_render_line(pmFG pmfg, const char *metric, int nvalues, int indom,
+		const pmAtomValue *values, const int *stss, int type,
+		char * const *names, const int *codes, const char *stamp)
+{
+    char buf[32];
+    size_t start = pmfg->textlen, mark;
+    int j, nfields = 0, sts;
+
+    if ((sts = pmfg_text_measurement(pmfg, metric)) < 0 ||
+	(sts = pmfg_text_putc(pmfg, ' ')) < 0)
+	return sts;
+    for (j = 0; j < nvalues; j++) {
+	if (stss && stss[j] < 0)
+	    continue;
+	mark = pmfg->textlen;
+	if (nfields && (sts = pmfg_text_putc(pmfg, ',')) < 0)
+	    return sts;
+	if (!indom)
+	    sts = pmfg_text_fieldkey(pmfg, NULL);
+	else if (names && names[j])
+	    sts = pmfg_text_fieldkey(pmfg, names[j]);
+	else {
+	    pmsprintf(buf, sizeof(buf), "%d", codes[j]);
+	    sts = pmfg_text_fieldkey(pmfg, buf);
+	}
+	if (sts < 0 || (sts = pmfg_text_putc(pmfg, '=')) < 0)
+	    return sts;
+	if ((sts = pmfg_text_value(pmfg, PM_FG_FORMAT_LINE, &values[j], type)) == 1) {
+	    pmfg->textlen = mark;
+	    pmfg->text[mark] = '\0';
+	    continue;
+	}
+	if (sts < 0)
+	    return sts;
+	nfields++;
+    }
+    if (nfields == 0) {
+	/* line protocol has no way to say "no values" */
+	pmfg->textlen = start;
+	pmfg->text[start] = '\0';
+	return 0;
+    }
+    if ((sts = pmfg_text_putc(pmfg, ' ')) < 0 ||
+	(sts = pmfg_text_puts(pmfg, stamp)) < 0)
+	return sts;
+    return pmfg_text_putc(pmfg, '\n');
+}
+
+/* reverse the item list in place, so it can be walked in pmExtend order */
+static pmFGI
+pmfg_reverse_items(pmFGI item)
+{
+    pmFGI prev = NULL, next;
+
+    while (item) {
+	next = item->next;
+	item->next = prev;
+	prev = item;
+	item = next;
+    }
+    return prev;
+}
+
+static int
+pmfg_render(pmFG pmfg, int format, pmFGI item, int *firstp)
+{
+    char stamp[48];
+    const char *metric;
+    int nvalues, indom, sts = 0;
+
+    if (format == PM_FG_FORMAT_LINE)
+	pmsprintf(stamp, sizeof(stamp), "%lld%09ld",
+		(long long)pmfg->stamp.tv_sec, (long)pmfg->stamp.tv_nsec);
+    else
+	pmsprintf(stamp, sizeof(stamp), "%lld.%09ld",
+		(long long)pmfg->stamp.tv_sec, (long)pmfg->stamp.tv_nsec);
+
+    for (; item && sts >= 0; item = item->next) {
+	if (item->type == pmfg_item) {
+	    if (item->u.item.output_value == NULL ||
+		(item->u.item.output_sts && *item->u.item.output_sts < 0))
+		continue;
+	    metric = item->u.item.metric_name;
+	    indom = (item->u.item.inst_name != NULL);
+	    if (format == PM_FG_FORMAT_JSON)
+		sts = pmfg_render_json(pmfg, metric, 1, indom,
+			item->u.item.output_value, NULL,
+			item->u.item.output_type,
+			&item->u.item.inst_name, NULL, firstp);
+	    else if (format == PM_FG_FORMAT_CSV)
+		sts = pmfg_render_csv(pmfg, metric, 1, indom,
+			item->u.item.output_value, NULL,
+			item->u.item.output_type,
+			&item->u.item.inst_name, NULL, stamp);
+	    else
+		sts = pmfg_render_line(pmfg, metric, 1, indom,
+			item->u.item.output_value, NULL,
+			item->u.item.output_type,
+			&item->u.item.inst_name, NULL, stamp);
+	}
+	else if (item->type == pmfg_indom) {
+	    if (item->u.indom.output_values == NULL ||
+		(item->u.indom.output_sts && *item->u.indom.output_sts < 0))
+		continue;
+	    indom = (item->u.indom.metric_desc.indom != PM_INDOM_NULL);
+	    /* need some way to tell the instances apart */
+	    if (indom && item->u.indom.output_inst_names == NULL &&
+		item->u.indom.output_inst_codes == NULL)
+		continue;
+	    metric = item->u.indom.metric_name;
+	    nvalues = item->u.indom.filled;
+	    if (format == PM_FG_FORMAT_JSON)
+		sts = pmfg_render_json(pmfg, metric, nvalues, indom,
+			item->u.indom.output_values, item->u.indom.output_stss,
+			item->u.indom.output_type,
+			item->u.indom.output_inst_names,
+			item->u.indom.output_inst_codes, firstp);
+	    else if (format == PM_FG_FORMAT_CSV)
+		sts = pmfg_render_csv(pmfg, metric, nvalues, indom,
+			item->u.indom.output_values, item->u.indom.output_stss,
+			item->u.indom.output_type,
+			item->u.indom.output_inst_names,
+			item->u.indom.output_inst_codes, stamp);
+	    else
+		sts = pmfg_render_line(pmfg, metric, nvalues, indom,
+			item->u.indom.output_values, item->u.indom.output_stss,
+			item->u.indom.output_type,
+			item->u.indom.output_inst_names,
+			item->u.indom.output_inst_codes, stamp);
+	}
+	/* event records and timestamps are not rendered */
+    }
+    return sts < 0 ? sts : 0;
+}
+
+/*
+ * Render the values from the last pmFetchGroup as text, into a buffer
+ * belonging to the fetchgroup, which is valid until the next call.
+ */
+int
+pmFormatFetchGroup(pmFG pmfg, int format, const char **text)
+{
+    pmFGI items;
+    char stamp[48];
+    int first = 1;
+    int sts;
+
+    if (pmfg == NULL || text == NULL)
+	return -EINVAL;
+    if (format != PM_FG_FORMAT_JSON && format != PM_FG_FORMAT_CSV &&
+	format != PM_FG_FORMAT_LINE)
+	return -EINVAL;
+
+    pmfg->textlen = 0;
+    if ((sts = pmfg_text_grow(pmfg, 0)) < 0)
+	return sts;
+    pmfg->text[0] = '\0';
+
+    if (format == PM_FG_FORMAT_JSON) {
+	pmsprintf(stamp, sizeof(stamp), "{\"timestamp\":%lld.%09ld,\"metrics\":{",
+		(long long)pmfg->stamp.tv_sec, (long)pmfg->stamp.tv_nsec);
+	if ((sts = pmfg_text_puts(pmfg, stamp)) < 0)
+	    return sts;
+    }
+
+    /* items are linked newest first, render them in the order given */
+    items = pmfg_reverse_items(pmfg->items);
+    sts = pmfg_render(pmfg, format, items, &first);
+    pmfg->items = pmfg_reverse_items(items);
+
+    if (sts == 0 && format == PM_FG_FORMAT_JSON)
+	sts = pmfg_text_puts(pmfg, "}}\n");
+    if (sts < 0)
+	return sts;
+
+    *text = pmfg->text;
+    return (int)pmfg->textlen;
+}
+
 /*
  * Clear the fetchgroup of all items, keeping the PMAPI context alive.
  */
@@ -1776,9 +2500,14 @@ pmClearFetchGroup(pmFG pmfg)
 	switch (item->type) {
 	    case pmfg_item:
 		pmfg_reinit_item(item);
+		free(item->u.item.metric_name);
+		free(item->u.item.inst_name);
 		break;
 	    case pmfg_indom:
 		pmfg_reinit_indom(item);
+		free(item->u.indom.metric_name);
+		__pmFreeColumn(&item->u.indom.column);
+		__pmFreeColumn(&item->u.indom.prev_column);
 		break;
 	    case pmfg_event:
 		pmfg_reinit_event(item);
@@ -1827,6 +2556,7 @@ pmDestroyFetchGroup(pmFG pmfg)
     pmfg->ctx = -EINVAL;
     pmDestroyContext(ctx);
     pmClearFetchGroup(pmfg);
+    free(pmfg->text);
     free(pmfg);
     return 0;
 }
@@ -247,3 +247,238 @@ __pmHashFree(__pmHashCtl *hcp)
 
     __pmHashClear(hcp);
 }
+
+/*
+ * Open-addressing variant, for hash tables with many small entries.
+ *
+ * Keys and data are stored inline in a single entries[] array, in
+ * insertion order, and a separate power-of-two sized index of entries[]
+ * offsets is probed linearly from a multiplicative hash of the key.
+ * There is no per-entry malloc, iteration visits entries in insertion
+ * order (and that order is preserved when the table grows), and
+ * deleted entries are lazily squeezed out when the table is resized.
+ *
+ * Node pointers returned by __pmOAHashSearch or __pmOAHashWalk remain
+ * valid only until the next __pmOAHashAdd on the same table.
+ */
+
+#define OAHASH_EMPTY	(-1)	/* index slot never used */
+#define OAHASH_DELETED	(-2)	/* index slot of a deleted entry */
+
+static inline unsigned int
+oahash_slot(unsigned int key, unsigned int hsize)
+{
+    /* Fibonacci hashing, hsize is a power of two */
+    unsigned int	h = key * 0x9e3779b1U;
+
+    return (h ^ (h >> 16)) & (hsize - 1);
+}
+
+void
+__pmOAHashInit(__pmOAHashCtl *hcp)
+{
+    memset(hcp, 0, sizeof(*hcp));
+}
+
+/*
+ * (Re)build the index for the live entries, squeezing out any deleted
+ * entries and ensuring space in entries[] for at least size entries.
+ */
+static int
+oahash_resize(__pmOAHashCtl *hcp, int size)
+{
+    __pmOAHashNode	*entries;
+    unsigned int	hsize, slot;
+    int			*index;
+    int			i, n;
+
+    if (size < hcp->nodes)
+	size = hcp->nodes;
+    if (size < 4)
+	size = 4;
+    for (hsize = 8; hsize < (unsigned int)size * 2; hsize <<= 1)
+	;
+    if ((index = (int *)malloc(hsize * sizeof(int))) == NULL)
+	return -oserror();
+    for (slot = 0; slot < hsize; slot++)
+	index[slot] = OAHASH_EMPTY;
+
+    /* compact in place, so insertion order is preserved */
+    for (i = n = 0; i < hcp->used; i++) {
+	if (hcp->entries[i].state == 0)
+	    continue;
+	if (i != n)
+	    hcp->entries[n] = hcp->entries[i];
+	n++;
+    }
+    if (size != hcp->size) {
+	entries = (__pmOAHashNode *)realloc(hcp->entries, size * sizeof(*entries));
+	if (entries == NULL) {
+	    free(index);
+	    hcp->used = n;
+	    return -oserror();
+	}
+	hcp->entries = entries;
+	hcp->size = size;
+    }
+    hcp->used = n;
+
+    for (i = 0; i < n; i++) {
+	slot = oahash_slot(hcp->entries[i].key, hsize);
+	while (index[slot] != OAHASH_EMPTY)
+	    slot = (slot + 1) & (hsize - 1);
+	index[slot] = i;
+    }
+    free(hcp->index);
+    hcp->index = index;
+    hcp->hsize = hsize;
+    return 0;
+}
+
+/*
+ * Used to preallocate the hash table when the size is known ahead of time.
+ */
+int
+__pmOAHashPreAlloc(int hsize, __pmOAHashCtl *hcp)
+{
+    return oahash_resize(hcp, hsize);
+}
+
+__pmOAHashNode *
+__pmOAHashSearch(unsigned int key, __pmOAHashCtl *hcp)
+{
+    unsigned int	slot;
+    int			i;
+
+    if (hcp->nodes == 0)
+	return NULL;
+
+    for (slot = oahash_slot(key, hcp->hsize);
+	 (i = hcp->index[slot]) != OAHASH_EMPTY;
+	 slot = (slot + 1) & (hcp->hsize - 1)) {
+	if (i >= 0 && hcp->entries[i].key == key)
+	    return &hcp->entries[i];
+    }
+    return NULL;
+}
+
+int
+__pmOAHashAdd(unsigned int key, void *data, __pmOAHashCtl *hcp)
+{
+    __pmOAHashNode	*hp;
+    unsigned int	slot;
+    int			sts;
+
+    if (hcp->used >= hcp->size) {
+	/* full ... reclaim deleted entries if that frees enough, else grow */
+	sts = oahash_resize(hcp, hcp->nodes * 2 <= hcp->size ?
+				 hcp->size : hcp->size * 2);
+	if (sts < 0)
+	    return sts;
+    }
+
+    slot = oahash_slot(key, hcp->hsize);
+    while (hcp->index[slot] >= 0)
+	slot = (slot + 1) & (hcp->hsize - 1);
+    hcp->index[slot] = hcp->used;
+
+    hp = &hcp->entries[hcp->used++];
+    hp->key = key;
+    hp->state = 1;
+    hp->data = data;
+    hcp->nodes++;
+
+    return 1;
+}
+
+static void
+oahash_delete(__pmOAHashCtl *hcp, int i)
+{
+    unsigned int	slot;
+
+    for (slot = oahash_slot(hcp->entries[i].key, hcp->hsize);
+	 hcp->index[slot] != i;
+	 slot = (slot + 1) & (hcp->hsize - 1))
+	;
+    hcp->index[slot] = OAHASH_DELETED;
+    hcp->entries[i].state = 0;
+    hcp->nodes--;
+}
+
+int
+__pmOAHashDel(unsigned int key, void *data, __pmOAHashCtl *hcp)
+{
+    unsigned int	slot;
+    int			i;
+
+    if (hcp->nodes == 0)
+	return 0;
+
+    for (slot = oahash_slot(key, hcp->hsize);
+	 (i = hcp->index[slot]) != OAHASH_EMPTY;
+	 slot = (slot + 1) & (hcp->hsize - 1)) {
+	if (i >= 0 && hcp->entries[i].key == key &&
+	    hcp->entries[i].data == data) {
+	    oahash_delete(hcp, i);
+	    return 1;
+	}
+    }
+    return 0;
+}
+
+void
+__pmOAHashClear(__pmOAHashCtl *hcp)
+{
+    free(hcp->entries);
+    free(hcp->index);
+    __pmOAHashInit(hcp);
+}
+
+/*
+ * Iterate over the entire hash table in insertion order, with the
+ * same callback semantics as __pmHashWalkCB().
+ */
+void
+__pmOAHashWalkCB(__pmOAHashWalkCallback cb, void *cdata, __pmOAHashCtl *hcp)
+{
+    int		i;
+
+    for (i = 0; i < hcp->used; i++) {
+	if (hcp->entries[i].state == 0)
+	    continue;
+	switch ((*cb)(&hcp->entries[i], cdata)) {
+	case PM_HASH_WALK_DELETE_STOP:
+	    oahash_delete(hcp, i);
+	    return;
+
+	case PM_HASH_WALK_NEXT:
+	    break;
+
+	case PM_HASH_WALK_DELETE_NEXT:
+	    oahash_delete(hcp, i);
+	    break;
+
+	case PM_HASH_WALK_STOP:
+	default:
+	    return;
+	}
+    }
+}
+
+/*
+ * Walk a hash table in insertion order; state flow is START ... NEXT ...
+ */
+__pmOAHashNode *
+__pmOAHashWalk(__pmOAHashCtl *hcp, __pmHashWalkState state)
+{
+    if (state == PM_HASH_WALK_START)
+	hcp->cursor = 0;
+
+    while (hcp->cursor < hcp->used) {
+	__pmOAHashNode	*hp = &hcp->entries[hcp->cursor++];
+
+	if (hp->state != 0)
+	    return hp;
+    }
+    return NULL;
+}
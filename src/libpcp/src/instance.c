@@ -301,6 +301,7 @@ pmGetInDom(pmInDom indom, int **instlist, char ***namelist)
     int			need;
     int			*ilist = NULL;
     char		**nlist = NULL;
+    pmInResult		*cached;
 
     if (pmDebugOptions.pmapi) {
 	char    dbgbuf[20];
@@ -319,7 +320,12 @@ pmGetInDom(pmInDom indom, int **instlist, char ***namelist)
 	    sts = PM_ERR_NOCONTEXT;
 	    goto pmapi_return;
 	}
-	if (ctxp->c_type == PM_CONTEXT_HOST) {
+	if (ctxp->c_type == PM_CONTEXT_HOST &&
+	    (cached = __pmLookupCacheTakeInDom(ctxp, indom)) != NULL) {
+	    /* sent with the last fetch, see PDU_FLAG_METADATA */
+	    sts = inresult_to_lists(cached, instlist, namelist);
+	}
+	else if (ctxp->c_type == PM_CONTEXT_HOST) {
 	    sts = __pmSendInstanceReq(ctxp->c_pmcd->pc_fd, __pmPtrToHandle(ctxp), indom, PM_IN_NULL, NULL);
 	    if (sts < 0)
 		sts = __pmMapErrno(sts);
@@ -235,6 +235,7 @@ extern unsigned char *__pmNextIpv6SubnetAddr(unsigned char *, int maskBits) _PCP
 extern int __pmInitSecureSockets(void) _PCP_HIDDEN;
 extern int __pmInitSocket(int, int) _PCP_HIDDEN;
 extern int __pmSocketReady(int, struct timeval *) _PCP_HIDDEN;
+extern int __pmFdReadyRead(int, struct timeval *) _PCP_HIDDEN;
 extern void *__pmGetSecureSocket(int) _PCP_HIDDEN;
 extern void *__pmGetUserAuthData(int) _PCP_HIDDEN;
 extern int __pmSecureServerNegotiation(int, int *) _PCP_HIDDEN;
@@ -374,7 +375,6 @@ extern void __pmCheckIsUnlocked(void *, char *, int) _PCP_HIDDEN;
 
 extern int __pmGetPDUCeiling(void) _PCP_HIDDEN;
 
-extern int __pmSetFeaturesIPC(int, int, int) _PCP_HIDDEN;
 extern int __pmSetDataIPC(int, void *) _PCP_HIDDEN;
 extern int __pmDataIPCSize(void) _PCP_HIDDEN;
 extern int __pmLastVersionIPC(void) _PCP_HIDDEN;
@@ -401,6 +401,7 @@ extern const char *__pmLogName_r(const char *, int, char *, int) _PCP_HIDDEN;
 extern const char *__pmLogName(const char *, int) _PCP_HIDDEN;	/* NOT thread-safe */
 extern int __pmLogGenerateMark(__pmLogCtl *, int, __pmResult **) _PCP_HIDDEN;
 extern int __pmLogFetchInterp(__pmContext *, int, pmID *, __pmResult **) _PCP_HIDDEN;
+extern int __pmLogResultFilter(int, const __pmPDU *, int, const pmID *, __pmTimestamp *, __pmPDU **) _PCP_HIDDEN;
 extern __pmTimestamp *__pmLogStartTime(__pmArchCtl *) _PCP_HIDDEN;
 extern int __pmLogSetTime(__pmContext *) _PCP_HIDDEN;
 extern void __pmLogResetInterp(__pmContext *) _PCP_HIDDEN;
@@ -426,9 +427,23 @@ extern int __pmTimevalCmp(const pmTimeval *, const pmTimeval *) _PCP_HIDDEN;
 extern int __pmSecureServerSetup(void) _PCP_HIDDEN;
 
 extern pmInDomProfile *__pmFindProfile(pmInDom, const pmProfile *) _PCP_HIDDEN;
+extern void __pmSortProfile(pmProfile *) _PCP_HIDDEN;
 
 extern void __pmFreeInterpData(__pmContext *) _PCP_HIDDEN;
 
+/* name and descriptor lookup cache for host contexts, see lookupcache.c */
+extern int __pmLookupCacheEnabled(__pmContext *) _PCP_HIDDEN;
+extern int __pmLookupCacheName(__pmContext *, const char *, pmID *) _PCP_HIDDEN;
+extern void __pmLookupCacheAddName(__pmContext *, const char *, pmID) _PCP_HIDDEN;
+extern int __pmLookupCacheDesc(__pmContext *, pmID, pmDesc *) _PCP_HIDDEN;
+extern void __pmLookupCacheAddDesc(__pmContext *, const pmDesc *) _PCP_HIDDEN;
+extern void __pmLookupCacheFlush(__pmContext *) _PCP_HIDDEN;
+extern int __pmLookupCacheMetadata(void) _PCP_HIDDEN;
+extern void __pmLookupCacheAddInDom(__pmContext *, pmInResult *) _PCP_HIDDEN;
+extern pmInResult *__pmLookupCacheTakeInDom(__pmContext *, pmInDom) _PCP_HIDDEN;
+extern void __pmLookupCacheDropInDoms(__pmContext *) _PCP_HIDDEN;
+extern void __pmAsyncFree(__pmContext *) _PCP_HIDDEN;
+
 extern void __pmDumpNameAndStatusList(FILE *, int, char **, int *) _PCP_HIDDEN;
 
 #define MAXLABELNAMELEN		((1<<8)-1)
@@ -441,6 +456,14 @@ extern char *__pmLabelFlagString(int, char *, int) _PCP_HIDDEN;
 /* logmeta.c hooks */
 extern int addindom(__pmLogCtl *, int, const __pmLogInDom *, __int32_t *) _PCP_HIDDEN;
 extern int addlabel(__pmArchCtl *, unsigned int, unsigned int, int, pmLabelSet *, const __pmTimestamp *) _PCP_HIDDEN;
+extern int __pmLogScanInDom(int, int, const __int32_t *, __pmLogInDom *) _PCP_HIDDEN;
+
+/* metaindex.c hooks for __pmLogLoadMeta() */
+struct __pmLogMetaIndex;
+extern struct __pmLogMetaIndex *__pmLogOpenMetaIndex(__pmLogCtl *) _PCP_HIDDEN;
+extern int __pmLogMetaIndexSkip(__pmLogCtl *, struct __pmLogMetaIndex *) _PCP_HIDDEN;
+extern void __pmLogCloseMetaIndex(struct __pmLogMetaIndex *) _PCP_HIDDEN;
+extern void __pmLogFreeMetaMaps(__pmLogCtl *) _PCP_HIDDEN;
 
 /* getopt.c ABI-version-specific details */
 extern void __pmParseTimeWindow2(pmOptions *,
@@ -450,4 +473,24 @@ extern void __pmParseTimeWindow3(pmOptions *,
 extern void __pmSetSampleInterval2(pmOptions *, char *) _PCP_HIDDEN;
 extern void __pmSetSampleInterval3(pmOptions *, char *) _PCP_HIDDEN;
 
+/* io.c suffix for creating compressed files */
+extern const char *__pmCompressSuffix(const char *) _PCP_HIDDEN;
+
+/*
+ * pdushm.c shared memory PDU transport ... a PDU_SHM_REF is sent down
+ * the channel in place of a PDU that has been placed in the ring, and
+ * is never seen by callers of __pmGetPDU
+ */
+#define PDU_SHM_REF		0x7100
+#define PDU_SHM_SIZE		(4*1024*1024)	/* ring bytes, power of two */
+#define PDU_SHM_THRESHOLD	(16*1024)	/* smaller PDUs go inline */
+typedef struct {
+    __pmPDUHdr		hdr;
+    __uint32_t		start;		/* ring offset of the PDU */
+    __uint32_t		len;		/* PDU length in bytes */
+} __pmShmRef;
+extern int __pmShmIPCCount _PCP_HIDDEN;
+extern int __pmShmXmit(int, const __pmPDU *, int, __pmShmRef *) _PCP_HIDDEN;
+extern int __pmShmRecv(int, __pmPDU **) _PCP_HIDDEN;
+
 #endif /* _LIBPCP_INTERNAL_H */
@@ -21,6 +21,9 @@
  * the one-trip initialization of ignore_mark_records and ignore_mark_gap
  * is not guarded as the same value would result from concurrent repeated
  * execution
+ *
+ * the one-trip initializations of cache_limit and memory_limit are
+ * guarded by the __pmLock_extcall mutex
  */
 
 /*
@@ -97,15 +100,26 @@ typedef struct instcntl {		/* metric-instance control */
     double		t_last;		/* no records after this */
     double		t_birth;	/* (optional) instance first seen */
     double		t_death;	/* (optional) instance last seen */
+    int			evicted;	/* values released, see evict() */
     struct pmidcntl	*metric;	/* back to metric control */
 } instcntl_t;
 
+/*
+ * The metric-instance controls for each metric are allocated as a single
+ * array, ordered as a walk of the hash chains in hc, and the hash entries
+ * point into this array.  The per-fetch passes over all instances of a
+ * metric then walk contiguous memory, and hc is only used for lookups by
+ * instance identifier.
+ */
 typedef struct pmidcntl {		/* metric control */
     pmDesc		desc;
     int			valfmt;		/* used to build result */
     int			numval;		/* number of instances in this result */
     int			last_numval;	/* number of instances in previous result */
-    __pmHashCtl		hc;		/* metric-instances */
+    int			inwant;		/* already on ac_want for this fetch */
+    int			ninst;		/* number of metric-instances */
+    instcntl_t		*inst;		/* metric-instances, ninst entries */
+    __pmHashCtl		hc;		/* metric-instances, by inst */
 } pmidcntl_t;
 
 typedef struct {
@@ -117,16 +131,137 @@ typedef struct {
     long	tail_posn;	/* posn in file after forwards __pmLogRead */
     int		mode;		/* PM_MODE_FORW or PM_MODE_BACK */
     int		used;		/* used count for LFU replacement */
+    size_t	size;		/* bytes on disk for the cached record */
 } cache_t;
 
+/*
+ * Read cache, one per archive context, hung off ac_cache.  By default
+ * this holds NUMCACHE records.  If $PCP_INTERP_CACHE_SIZE is set, the
+ * cache grows until the records it holds exceed that many bytes (but
+ * never holds fewer than NUMCACHE records), which suits interpolation
+ * at small deltas over dense archives where the same records are
+ * read repeatedly as the prior and next values move forward.
+ *
+ * Allocated as a single block, so __pmArchCtlFree() can free() it.
+ */
+typedef struct {
+    int		ncache;		/* entries in use */
+    int		nalloc;		/* entries allocated */
+    size_t	bytes;		/* sum of cache[].size */
+    cache_t	cache[1];	/* actually nalloc entries */
+} readcache_t;
+
 #define NUMCACHE 4
 
+/* -1 => not yet initialized, 0 => NUMCACHE entries, else bytes */
+static long	cache_limit = -1;
+
+/*
+ * bytes from the environment variable var, with an optional K, M or G
+ * suffix, else 0 if not set ... called with __pmLock_extcall held
+ */
+static long
+getenv_bytes(const char *var)
+{
+    char	*str, *end;
+    long	limit;
+
+    str = getenv(var);			/* THREADSAFE */
+    if (str == NULL || str[0] == '\0')
+	return 0;
+    limit = strtol(str, &end, 10);
+    if (*end == 'k' || *end == 'K')
+	limit *= 1024, end++;
+    else if (*end == 'm' || *end == 'M')
+	limit *= 1024 * 1024, end++;
+    else if (*end == 'g' || *end == 'G')
+	limit *= 1024 * 1024 * 1024, end++;
+    if (*end != '\0' || limit <= 0) {
+	fprintf(stderr, "%s: Warning: bad $%s: %s\n",
+		pmGetProgname(), var, str);
+	return 0;
+    }
+    return limit;
+}
+
+static long
+get_cache_limit(void)
+{
+    long	limit;
+
+    PM_LOCK(__pmLock_extcall);
+    if (cache_limit < 0) {
+	/* one-trip initialization */
+	cache_limit = getenv_bytes("PCP_INTERP_CACHE_SIZE");
+    }
+    limit = cache_limit;
+    PM_UNLOCK(__pmLock_extcall);
+    return limit;
+}
+
+/*
+ * Memory controls, one per archive context, hung off ac_memctl.
+ *
+ * Instances that are out of range (see evict()) have their values
+ * released as each fetch is processed.  Beyond that, if there is a
+ * limit (from __pmSetInterpLimit(), else $PCP_INTERP_MEMORY) on the
+ * bytes used by the metric-instance controls and the values they hold,
+ * then when it is exceeded the values held for metrics not in the
+ * current fetch and instances not in the profile are released, and
+ * instance domain records behind the current position are unloaded
+ * from the metadata.
+ *
+ * Allocated as a single block, so __pmArchCtlFree() can free() it.
+ */
+typedef struct {
+    long	limit;		/* -1 => $PCP_INTERP_MEMORY, 0 => none */
+    long	evicted;	/* instances released when out of range */
+    long	released;	/* instances released to meet the limit */
+    long	unloaded;	/* instance domain records unloaded */
+} memctl_t;
+
+/* -1 => not yet initialized, 0 => no limit, else bytes */
+static long	memory_limit = -1;
+
+static memctl_t *
+get_memctl(__pmArchCtl *acp)
+{
+    memctl_t	*mcp = (memctl_t *)acp->ac_memctl;
+
+    if (mcp == NULL) {
+	if ((mcp = (memctl_t *)calloc(1, sizeof(memctl_t))) == NULL)
+	    return NULL;
+	mcp->limit = -1;
+	acp->ac_memctl = mcp;
+    }
+    return mcp;
+}
+
+static long
+get_memory_limit(memctl_t *mcp)
+{
+    long	limit;
+
+    if (mcp != NULL && mcp->limit >= 0)
+	return mcp->limit;
+    PM_LOCK(__pmLock_extcall);
+    if (memory_limit < 0) {
+	/* one-trip initialization */
+	memory_limit = getenv_bytes("PCP_INTERP_MEMORY");
+    }
+    limit = memory_limit;
+    PM_UNLOCK(__pmLock_extcall);
+    return limit;
+}
+
 /*
  * diagnostic counters ... indexed by PM_MODE_FORW (2) and
  * PM_MODE_BACK	(3), hence 4 elts for cached and non-cached reads
  */
 static long	nr_cache[PM_MODE_BACK+1];
 static long	nr[PM_MODE_BACK+1];
+static long	nr_cache_start[PM_MODE_BACK+1];
+static long	nr_start[PM_MODE_BACK+1];
 
 /*
  * called with the context lock held
@@ -136,9 +271,12 @@ cache_read(__pmContext *ctxp, int mode, __pmResult **rp)
 {
     __pmArchCtl	*acp = ctxp->c_archctl;
     long	posn;
+    long	limit;
     cache_t	*cp;
     cache_t	*lfup;
     cache_t	*cache;
+    readcache_t	*rcp;
+    size_t	need;
     char	*save_curlog_name;
     int		sts;
     int		save_curvol;
@@ -162,15 +300,19 @@ cache_read(__pmContext *ctxp, int mode, __pmResult **rp)
     else
 	posn = 0;
 
+    limit = get_cache_limit();
     if (acp->ac_cache == NULL) {
 	/* cache initialization */
-	acp->ac_cache = cache = (cache_t *)calloc(NUMCACHE, sizeof(cache_t));
-	if (!cache)
+	need = sizeof(readcache_t) + (NUMCACHE - 1) * sizeof(cache_t);
+	if ((rcp = (readcache_t *)calloc(1, need)) == NULL)
 	    return -ENOMEM;
+	rcp->ncache = rcp->nalloc = NUMCACHE;
+	acp->ac_cache = rcp;
 	acp->ac_cache_idx = 0;
     }
     else
-	cache = acp->ac_cache;
+	rcp = (readcache_t *)acp->ac_cache;
+    cache = rcp->cache;
 
     if (pmDebugOptions.log && pmDebugOptions.desperate) {
 	fprintf(stderr, "cache_read: fd=%d mode=%s vol=%d (curvol=%d) %s_posn=%ld ",
@@ -181,9 +323,9 @@ cache_read(__pmContext *ctxp, int mode, __pmResult **rp)
 	    (long)posn);
     }
 
-    acp->ac_cache_idx = (acp->ac_cache_idx + 1) % NUMCACHE;
+    acp->ac_cache_idx = (acp->ac_cache_idx + 1) % rcp->ncache;
     lfup = &cache[acp->ac_cache_idx];
-    for (cp = cache; cp < &cache[NUMCACHE]; cp++) {
+    for (cp = cache; cp < &cache[rcp->ncache]; cp++) {
 	if (cp->c_name != NULL && strcmp(cp->c_name, acp->ac_log->name) == 0 &&
 	    cp->vol == acp->ac_vol &&
 	    ((mode == PM_MODE_FORW && cp->head_posn == posn) ||
@@ -195,6 +337,7 @@ cache_read(__pmContext *ctxp, int mode, __pmResult **rp)
 		__pmFseek(acp->ac_mfp, cp->tail_posn, SEEK_SET);
 	    else
 		__pmFseek(acp->ac_mfp, cp->head_posn, SEEK_SET);
+	    nr_cache[mode]++;
 	    if (pmDebugOptions.log && pmDebugOptions.desperate) {
 		__pmTimestamp	tmp;
 		double		t_this;
@@ -202,7 +345,6 @@ cache_read(__pmContext *ctxp, int mode, __pmResult **rp)
 		t_this = __pmTimestampSub(&tmp, __pmLogStartTime(acp));
 		fprintf(stderr, "hit cache[%d] t=%.6f\n",
 			(int)(cp - cache), t_this);
-		nr_cache[mode]++;
 	    }
 	    acp->ac_mark_done = 0;
 	    sts = cp->sts;
@@ -214,8 +356,31 @@ cache_read(__pmContext *ctxp, int mode, __pmResult **rp)
 	fprintf(stderr, "miss\n");
     nr[mode]++;
 
-    if (lfup->rp != NULL)
+    if (limit > 0 && rcp->bytes < (size_t)limit) {
+	/* memory-bounded cache with room to spare, add an entry */
+	if (rcp->ncache == rcp->nalloc) {
+	    readcache_t	*tmp_rcp;
+
+	    need = sizeof(readcache_t) + (2 * rcp->nalloc - 1) * sizeof(cache_t);
+	    if ((tmp_rcp = (readcache_t *)realloc(rcp, need)) != NULL) {
+		memset(&tmp_rcp->cache[tmp_rcp->nalloc], 0,
+			tmp_rcp->nalloc * sizeof(cache_t));
+		tmp_rcp->nalloc *= 2;
+		acp->ac_cache = rcp = tmp_rcp;
+		cache = rcp->cache;
+	    }
+	}
+	if (rcp->ncache < rcp->nalloc)
+	    acp->ac_cache_idx = rcp->ncache++;
+	lfup = &cache[acp->ac_cache_idx];
+    }
+
+    if (lfup->rp != NULL) {
 	__pmFreeResult(lfup->rp);
+	lfup->rp = NULL;
+    }
+    rcp->bytes -= lfup->size;
+    lfup->size = 0;
 
     /*
      * We need to know when we cross archive or volume boundaries.
@@ -277,6 +442,10 @@ cache_read(__pmContext *ctxp, int mode, __pmResult **rp)
 	    lfup->head_posn = __pmFtell(acp->ac_mfp);
 	    assert(lfup->head_posn >= 0);
 	}
+	if (lfup->tail_posn > lfup->head_posn) {
+	    lfup->size = lfup->tail_posn - lfup->head_posn;
+	    rcp->bytes += lfup->size;
+	}
 	if (pmDebugOptions.log && pmDebugOptions.desperate) {
 	    fprintf(stderr, "cache_read: reload cache[%d] vol=%d (curvol=%d) head=%ld tail=%ld ",
 		(int)(lfup - cache), lfup->vol, acp->ac_curvol,
@@ -318,6 +487,10 @@ dumpval(FILE *f, int type, int valfmt, int prior, instcntl_t *icp)
 	return;
     }
     if (IS_SCANNED(state)) fprintf(f, " state=<scanned>");
+    if (valfmt != PM_VAL_INSITU && vp->pval == NULL) {
+	fprintf(f, " v=<released>");
+	return;
+    }
     if (type == PM_TYPE_32 || type == PM_TYPE_U32)
 	fprintf(f, " v=%d", vp->lval);
     else if (type == PM_TYPE_FLOAT && valfmt == PM_VAL_INSITU) {
@@ -398,8 +571,8 @@ update_bounds(__pmContext *ctxp, double t_req, __pmResult *logrp, int do_mark, i
      */
     int			k;
     int			i;
-    __pmHashCtl		*hcp = &ctxp->c_archctl->ac_pmid_hc;
-    __pmHashNode	*hp;
+    __pmOAHashCtl	*hcp = &ctxp->c_archctl->ac_pmid_hc;
+    __pmOAHashNode	*hp;
     __pmHashNode	*ihp;
     pmidcntl_t		*pcp;
     instcntl_t		*icp;
@@ -658,7 +831,7 @@ check:
 
     changed = 0;
     for (k = 0; k < logrp->numpmid; k++) {
-	hp = __pmHashSearch((int)logrp->vset[k]->pmid, hcp);
+	hp = __pmOAHashSearch((int)logrp->vset[k]->pmid, hcp);
 	if (hp == NULL)
 	    continue;
 	pcp = (pmidcntl_t *)hp->data;
@@ -964,6 +1137,7 @@ time_caliper(__pmContext *ctxp, instcntl_t *icp)
 
 	t_indom_prior = -1;
 	for (idp = (__pmLogInDom *)jp->data; idp != NULL; idp = idp->next) {
+	    __pmLogLoadLazyInDom(idp);
 	    t_indom = __pmTimestampSub(&idp->stamp, __pmLogStartTime(ctxp->c_archctl));
 	    for (j = 0; j < idp->numinst; j++) {
 		if ((ip = __pmHashSearch((unsigned int)idp->instlist[j], &indomp->hashinst)) == NULL) {
@@ -1016,6 +1190,208 @@ time_caliper(__pmContext *ctxp, instcntl_t *icp)
     return;
 }
 
+/*
+ * release any values held for a metric-instance
+ */
+static void
+release(instcntl_t *icp)
+{
+    if (icp->metric->valfmt != PM_VAL_INSITU) {
+	if (icp->v_prior.pval != NULL)
+	    __pmUnpinPDUBuf((void *)icp->v_prior.pval);
+	if (icp->v_next.pval != NULL)
+	    __pmUnpinPDUBuf((void *)icp->v_next.pval);
+    }
+    icp->v_prior.pval = icp->v_next.pval = NULL;
+}
+
+/*
+ * forget everything about a metric-instance, as if it had never been
+ * fetched, so the bounds are searched for again if it is next fetched
+ */
+static void
+reset(instcntl_t *icp)
+{
+    release(icp);
+    icp->t_prior = icp->t_next = -1;
+    SET_UNDEFINED(icp->s_prior);
+    SET_UNDEFINED(icp->s_next);
+    icp->evicted = 0;
+}
+
+/*
+ * Is t_req more than window outside the range of times at which the
+ * metric-instance could have a value, from the observations (t_first,
+ * t_last) and the instance domain (t_birth, t_death)?  A discrete
+ * value persists after t_last until the instance goes away.
+ */
+static int
+out_of_range(instcntl_t *icp, double t_req, double window)
+{
+    double	lo = icp->t_first;
+    double	hi = -1;
+
+    if (icp->t_birth > lo)
+	lo = icp->t_birth;
+    if (lo >= 0 && t_req < lo - window)
+	return 1;
+    if (icp->metric->desc.sem != PM_SEM_DISCRETE)
+	hi = icp->t_last;
+    if (icp->t_death >= 0 && (hi < 0 || icp->t_death < hi))
+	hi = icp->t_death;
+    if (hi >= 0 && t_req > hi + window)
+	return 1;
+    return 0;
+}
+
+/*
+ * Once an instance has gone away (or has yet to appear) the values
+ * last seen for it are never used again, but would be held (and the
+ * PDU buffers they are in pinned) for as long as the context is open,
+ * which adds up for a long archive with changing instances.  So when
+ * t_req is out of range by more than one interpolation interval, the
+ * values are released.  t_prior, t_next and the states are kept, so the
+ * searching is exactly as before, but an evicted metric-instance has
+ * no value until t_req comes back into range, when it is reset if a
+ * value it needs has been released.
+ *
+ * Values in pmValue (PM_VAL_INSITU) cost nothing extra to hold, so are
+ * never evicted.
+ */
+static void
+evict(__pmArchCtl *acp, instcntl_t *icp, double t_req, double window)
+{
+    memctl_t	*mcp;
+
+    if (icp->evicted) {
+	if (!out_of_range(icp, t_req, 0)) {
+	    /* back in range */
+	    if ((IS_VALUE(icp->s_prior) && icp->v_prior.pval == NULL) ||
+		(IS_VALUE(icp->s_next) && icp->v_next.pval == NULL))
+		reset(icp);
+	    else
+		icp->evicted = 0;
+	}
+	else if (icp->v_prior.pval != NULL || icp->v_next.pval != NULL) {
+	    /* value from update_bounds() since */
+	    release(icp);
+	}
+	return;
+    }
+    if (icp->metric->valfmt == PM_VAL_INSITU ||
+	(icp->v_prior.pval == NULL && icp->v_next.pval == NULL))
+	return;
+    if (!out_of_range(icp, t_req, window))
+	return;
+    release(icp);
+    icp->evicted = 1;
+    if ((mcp = get_memctl(acp)) != NULL)
+	mcp->evicted++;
+    if (pmDebugOptions.interp && pmDebugOptions.desperate)
+	dumpicp("evict", icp);
+}
+
+/*
+ * bytes used by the metric-instance controls and the values they hold
+ */
+static size_t
+interp_usage(__pmArchCtl *acp, long *nvalues)
+{
+    __pmOAHashNode	*hp;
+    pmidcntl_t		*pcp;
+    instcntl_t		*icp;
+    size_t		bytes = 0;
+    long		values = 0;
+
+    for (hp = __pmOAHashWalk(&acp->ac_pmid_hc, PM_HASH_WALK_START); hp != NULL;
+	 hp = __pmOAHashWalk(&acp->ac_pmid_hc, PM_HASH_WALK_NEXT)) {
+	pcp = (pmidcntl_t *)hp->data;
+	bytes += sizeof(pmidcntl_t) + pcp->ninst * sizeof(instcntl_t) +
+		 pcp->hc.hsize * sizeof(__pmHashNode *) +
+		 pcp->hc.nodes * sizeof(__pmHashNode);
+	for (icp = pcp->inst; icp < &pcp->inst[pcp->ninst]; icp++) {
+	    if (pcp->valfmt == PM_VAL_INSITU) {
+		values += IS_VALUE(icp->s_prior) + IS_VALUE(icp->s_next);
+		continue;
+	    }
+	    if (icp->v_prior.pval != NULL) {
+		bytes += icp->v_prior.pval->vlen;
+		values++;
+	    }
+	    if (icp->v_next.pval != NULL) {
+		bytes += icp->v_next.pval->vlen;
+		values++;
+	    }
+	}
+    }
+    if (nvalues != NULL)
+	*nvalues = values;
+    return bytes;
+}
+
+/*
+ * Over the memory limit after a fetch at t_req, so release the values
+ * held for metrics not in this fetch and instances not in the profile
+ * (the instances in the profile are left alone, as releasing them would
+ * only mean searching for the same values again at the next fetch),
+ * as for evict(), and unload instance domain records behind t_req.
+ */
+static void
+enforce_limit(__pmContext *ctxp, int numpmid, pmID pmidlist[], long limit)
+{
+    __pmArchCtl		*acp = ctxp->c_archctl;
+    __pmOAHashNode	*hp;
+    pmidcntl_t		*pcp;
+    instcntl_t		*icp;
+    memctl_t		*mcp;
+    size_t		before;
+    long		released = 0;
+    int			unloaded = 0;
+    int			j;
+
+    before = interp_usage(acp, NULL);
+    if (before <= (size_t)limit || (mcp = get_memctl(acp)) == NULL)
+	return;
+    for (hp = __pmOAHashWalk(&acp->ac_pmid_hc, PM_HASH_WALK_START); hp != NULL;
+	 hp = __pmOAHashWalk(&acp->ac_pmid_hc, PM_HASH_WALK_NEXT))
+	((pmidcntl_t *)hp->data)->inwant = 0;
+    for (j = 0; j < numpmid; j++) {
+	if (pmidlist[j] == PM_ID_NULL)
+	    continue;
+	if ((hp = __pmOAHashSearch((int)pmidlist[j], &acp->ac_pmid_hc)) != NULL)
+	    ((pmidcntl_t *)hp->data)->inwant = 1;
+    }
+    for (hp = __pmOAHashWalk(&acp->ac_pmid_hc, PM_HASH_WALK_START); hp != NULL;
+	 hp = __pmOAHashWalk(&acp->ac_pmid_hc, PM_HASH_WALK_NEXT)) {
+	pcp = (pmidcntl_t *)hp->data;
+	for (icp = pcp->inst; icp < &pcp->inst[pcp->ninst]; icp++) {
+	    if (pcp->inwant && (pcp->desc.indom == PM_INDOM_NULL ||
+		__pmInProfile(pcp->desc.indom, ctxp->c_instprof, icp->inst)))
+		continue;
+	    if (pcp->valfmt == PM_VAL_INSITU ||
+		(icp->v_prior.pval == NULL && icp->v_next.pval == NULL))
+		continue;
+	    release(icp);
+	    icp->evicted = 1;
+	    released++;
+	}
+    }
+    mcp->released += released;
+
+    /* indoms are shared by contexts from pmDupContext() */
+    PM_LOCK(acp->ac_log->lc_lock);
+    if (acp->ac_log->refcnt == 1)
+	unloaded = __pmLogUnloadInDoms(acp->ac_log, &ctxp->c_origin, ctxp->c_direction);
+    PM_UNLOCK(acp->ac_log->lc_lock);
+    mcp->unloaded += unloaded;
+
+    if (pmDebugOptions.interp) {
+	fprintf(stderr, "__pmLogFetchInterp: memory %zu bytes > limit %ld:"
+		" released %ld instances (-> %zu bytes), unloaded %d indoms\n",
+		before, limit, released, interp_usage(acp, NULL), unloaded);
+    }
+}
+
 /*
  * classes of "unbound" list instcntl_t scanning effort ...
  * counted in nuis[] below
@@ -1035,8 +1411,9 @@ __pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult *
     int			i, j, k, sts;
     double		t_req, t_this;
     __pmResult		*rp, *logrp;
-    __pmHashCtl		*hcp = &ctxp->c_archctl->ac_pmid_hc;
-    __pmHashNode	*hp, *ihp;
+    __pmOAHashCtl	*hcp = &ctxp->c_archctl->ac_pmid_hc;
+    __pmOAHashNode	*hp;
+    __pmHashNode	*ihp;
     pmidcntl_t		*pcp = NULL;	/* initialize to pander to gcc */
     instcntl_t		*icp = NULL;	/* initialize to pander to gcc */
     instcntl_t		*ub, *ub_prev;
@@ -1045,6 +1422,8 @@ __pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult *
     int			done;
     int			done_roll;
     int			seen_mark;
+    long		limit;
+    double		window;
     static int		dowrap = -1;
     __pmTimestamp	tmp;
     long		nuis[] = { 0, 0, 0, 0, 0, 0, 0, 0 };
@@ -1068,9 +1447,15 @@ __pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult *
 	    t_req, ctxp->c_archctl->ac_curvol,
 	    (long)ctxp->c_archctl->ac_offset, ctxp->c_archctl->ac_vol,
 	    ctxp->c_archctl->ac_serial);
-	nr_cache[PM_MODE_FORW] = nr[PM_MODE_FORW] = 0;
-	nr_cache[PM_MODE_BACK] = nr[PM_MODE_BACK] = 0;
     }
+    /* evict() window is one interpolation interval */
+    window = ctxp->c_delta.sec + ctxp->c_delta.nsec / 1000000000.0;
+    if (window < 0)
+	window = -window;
+    nr_start[PM_MODE_FORW] = nr[PM_MODE_FORW];
+    nr_start[PM_MODE_BACK] = nr[PM_MODE_BACK];
+    nr_cache_start[PM_MODE_FORW] = nr_cache[PM_MODE_FORW];
+    nr_cache_start[PM_MODE_BACK] = nr_cache[PM_MODE_BACK];
 
     /*
      * the 0.001 is magic slop for 1 msec, which is about as accurate
@@ -1110,7 +1495,13 @@ __pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult *
     for (j = 0; j < numpmid; j++) {
 	if (pmidlist[j] == PM_ID_NULL)
 	    continue;
-	hp = __pmHashSearch((int)pmidlist[j], hcp);
+	if ((hp = __pmOAHashSearch((int)pmidlist[j], hcp)) != NULL)
+	    ((pmidcntl_t *)hp->data)->inwant = 0;
+    }
+    for (j = 0; j < numpmid; j++) {
+	if (pmidlist[j] == PM_ID_NULL)
+	    continue;
+	hp = __pmOAHashSearch((int)pmidlist[j], hcp);
 	if (hp == NULL) {
 	    /* first time we've been asked for this one in this context */
 	    if ((pcp = (pmidcntl_t *)malloc(sizeof(pmidcntl_t))) == NULL) {
@@ -1119,8 +1510,11 @@ __pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult *
 	    }
 	    pcp->valfmt = -1;
 	    pcp->last_numval = -1;
+	    pcp->inwant = 0;
+	    pcp->ninst = 0;
+	    pcp->inst = NULL;
 	    __pmHashInit(&pcp->hc);
-	    sts = __pmHashAdd((int)pmidlist[j], (void *)pcp, hcp);
+	    sts = __pmOAHashAdd((int)pmidlist[j], (void *)pcp, hcp);
 	    if (sts < 0) {
 		free(pcp);
 		return sts;
@@ -1153,22 +1547,31 @@ __pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult *
 			}
 		    }
 		}
+		if (sts > 0 &&
+		    (pcp->inst = (instcntl_t *)malloc(sts * sizeof(instcntl_t))) == NULL) {
+		    pmNoMem("__pmLogFetchInterp.instcntl_t", sts * sizeof(instcntl_t), PM_FATAL_ERR);
+		}
 		for (i = 0; i < sts; i++) {
-		    if ((icp = (instcntl_t *)malloc(sizeof(instcntl_t))) == NULL) {
-			pmNoMem("__pmLogFetchInterp.instcntl_t", sizeof(instcntl_t), PM_FATAL_ERR);
-		    }
-		    icp->metric = pcp;
-		    icp->inst = instlist[i];
-		    icp->t_first = icp->t_last = -1;
-		    icp->t_prior = icp->t_next = -1;
-		    SET_UNDEFINED(icp->s_prior);
-		    SET_UNDEFINED(icp->s_next);
-		    icp->v_prior.pval = icp->v_next.pval = NULL;
-		    time_caliper(ctxp, icp);
-		    hsts = __pmHashAdd((int)instlist[i], (void *)icp, &pcp->hc);
-		    if (hsts < 0) {
-			free(icp);
+		    hsts = __pmHashAdd((int)instlist[i], NULL, &pcp->hc);
+		    if (hsts < 0)
 			goto done_icp;
+		}
+		/*
+		 * and now the metric-instance controls, in hash walk order
+		 */
+		for (k = 0; k < pcp->hc.hsize; k++) {
+		    for (ihp = pcp->hc.hash[k]; ihp != NULL; ihp = ihp->next) {
+			icp = &pcp->inst[pcp->ninst++];
+			icp->metric = pcp;
+			icp->inst = (int)ihp->key;
+			icp->t_first = icp->t_last = -1;
+			icp->t_prior = icp->t_next = -1;
+			SET_UNDEFINED(icp->s_prior);
+			SET_UNDEFINED(icp->s_next);
+			icp->v_prior.pval = icp->v_next.pval = NULL;
+			icp->evicted = 0;
+			time_caliper(ctxp, icp);
+			ihp->data = (void *)icp;
 		    }
 		}
 	    done_icp:
@@ -1180,9 +1583,18 @@ __pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult *
 		    return hsts; /* hash allocation error */
 	    }
 	}
-	else
+	else {
 	    /* seen this one before */
 	    pcp = (pmidcntl_t *)hp->data;
+	    if (pcp->inwant)
+		/*
+		 * duplicate PMID in pmidlist[], the instances are already
+		 * on the ac_want list (and adding them again would link
+		 * the list into a cycle)
+		 */
+		continue;
+	}
+	pcp->inwant = 1;
 
 	pcp->numval = 0;
 	if (pcp->desc.type == -1) {
@@ -1190,33 +1602,29 @@ __pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult *
 	}
 	else if (pcp->desc.indom != PM_INDOM_NULL) {
 	    /* use the profile to filter the instances to be returned */
-	    for (i = 0; i < pcp->hc.hsize; i++) {
-		for (ihp = pcp->hc.hash[i]; ihp != NULL; ihp = ihp->next) {
-		    icp = (instcntl_t *)ihp->data;
-		    icp->search = 0;
-		    if (__pmInProfile(pcp->desc.indom, ctxp->c_instprof, icp->inst)) {
-			icp->inresult = 1;
-			icp->want = (instcntl_t *)ctxp->c_archctl->ac_want;
-			ctxp->c_archctl->ac_want = icp;
-			pcp->numval++;
-		    }
-		    else
-			icp->inresult = 0;
+	    for (icp = pcp->inst; icp < &pcp->inst[pcp->ninst]; icp++) {
+		icp->search = 0;
+		evict(ctxp->c_archctl, icp, t_req, window);
+		if (__pmInProfile(pcp->desc.indom, ctxp->c_instprof, icp->inst)) {
+		    icp->inresult = 1;
+		    icp->want = (instcntl_t *)ctxp->c_archctl->ac_want;
+		    ctxp->c_archctl->ac_want = icp;
+		    pcp->numval++;
 		}
+		else
+		    icp->inresult = 0;
 	    }
 	}
 	else {
 	    /* There will be only one instance */
-	    ihp = __pmHashWalk(&pcp->hc, PM_HASH_WALK_START);
-	    assert(ihp);
-	    icp = (instcntl_t *)ihp->data;
+	    assert(pcp->ninst == 1);
+	    icp = pcp->inst;
 	    icp->inresult = 1;
 	    icp->search = 0;
+	    evict(ctxp->c_archctl, icp, t_req, window);
 	    icp->want = (instcntl_t *)ctxp->c_archctl->ac_want;
 	    ctxp->c_archctl->ac_want = icp;
 	    pcp->numval = 1;
-	    ihp = __pmHashWalk(&pcp->hc, PM_HASH_WALK_NEXT);
-	    assert(!ihp);
 	}
     }
 
@@ -1271,7 +1679,7 @@ __pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult *
 	for (j = 0; j < numpmid; j++) {
 	    if (pmidlist[j] == PM_ID_NULL)
 		continue;
-	    hp = __pmHashSearch((int)pmidlist[j], hcp);
+	    hp = __pmOAHashSearch((int)pmidlist[j], hcp);
 	    assert(hp != NULL);
 	    pcp = (pmidcntl_t *)hp->data;
 	    pcp->last_numval = -1;
@@ -1597,7 +2005,12 @@ __pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult *
     for (icp = (instcntl_t *)ctxp->c_archctl->ac_want; icp != NULL; icp = icp->want) {
 	assert(icp->inresult);
 	pcp = (pmidcntl_t *)icp->metric;
-	if (pcp->desc.sem == PM_SEM_DISCRETE) {
+	if (icp->evicted) {
+	    /* out of range, values released */
+	    pcp->numval--;
+	    icp->inresult = 0;
+	}
+	else if (pcp->desc.sem == PM_SEM_DISCRETE) {
 	    if (IS_MARK(icp->s_prior) || IS_UNDEFINED(icp->s_prior) ||
 		icp->t_prior > t_req ||
 		(icp->t_birth != -1 && icp->t_birth > t_req)) {
@@ -1663,7 +2076,7 @@ PM_FAULT_POINT("libpcp/" __FILE__ ":1", PM_FAULT_CALL);
 					    sizeof(pmValue));
 	}
 	else {
-	    hp = __pmHashSearch((int)pmidlist[j], hcp);
+	    hp = __pmOAHashSearch((int)pmidlist[j], hcp);
 	    assert(hp != NULL);
 	    pcp = (pmidcntl_t *)hp->data;
 
@@ -1689,253 +2102,275 @@ PM_FAULT_POINT("libpcp/" __FILE__ ":1", PM_FAULT_CALL);
 
 	i = 0;
 	if (pcp->numval > 0) {
-	    for (k = 0; k < pcp->hc.hsize; k++) {
-		for (ihp = pcp->hc.hash[k]; ihp != NULL; ihp = ihp->next) {
-		    icp = (instcntl_t *)ihp->data;
-		    if (!icp->inresult)
-			continue;
-		    if (pmDebugOptions.interp && done_roll) {
-			char	strbuf[20];
-			fprintf(stderr, "pmid %s inst %d prior: t=%.6f",
-				pmIDStr_r(pmidlist[j], strbuf, sizeof(strbuf)), icp->inst, icp->t_prior);
-			dumpval(stderr, pcp->desc.type, icp->metric->valfmt, 1, icp);
-			fprintf(stderr, " next: t=%.6f", icp->t_next);
-			dumpval(stderr, pcp->desc.type, icp->metric->valfmt, 0, icp);
-			fprintf(stderr, " t_first=%.6f t_last=%.6f\n",
-				icp->t_first, icp->t_last);
-		    }
-		    rp->vset[j]->vlist[i].inst = icp->inst;
-		    if (pcp->desc.type == PM_TYPE_32 || pcp->desc.type == PM_TYPE_U32) {
-			if (icp->t_prior == t_req)
-			    rp->vset[j]->vlist[i++].value.lval = icp->v_prior.lval;
-			else if (icp->t_next == t_req)
-			    rp->vset[j]->vlist[i++].value.lval = icp->v_next.lval;
+	    for (icp = pcp->inst; icp < &pcp->inst[pcp->ninst]; icp++) {
+		if (!icp->inresult)
+		    continue;
+		if (pmDebugOptions.interp && done_roll) {
+		    char	strbuf[20];
+		    fprintf(stderr, "pmid %s inst %d prior: t=%.6f",
+			    pmIDStr_r(pmidlist[j], strbuf, sizeof(strbuf)), icp->inst, icp->t_prior);
+		    dumpval(stderr, pcp->desc.type, icp->metric->valfmt, 1, icp);
+		    fprintf(stderr, " next: t=%.6f", icp->t_next);
+		    dumpval(stderr, pcp->desc.type, icp->metric->valfmt, 0, icp);
+		    fprintf(stderr, " t_first=%.6f t_last=%.6f\n",
+			    icp->t_first, icp->t_last);
+		}
+		rp->vset[j]->vlist[i].inst = icp->inst;
+		if (pcp->desc.type == PM_TYPE_32 || pcp->desc.type == PM_TYPE_U32) {
+		    if (icp->t_prior == t_req)
+			rp->vset[j]->vlist[i++].value.lval = icp->v_prior.lval;
+		    else if (icp->t_next == t_req)
+			rp->vset[j]->vlist[i++].value.lval = icp->v_next.lval;
+		    else {
+			if (pcp->desc.sem == PM_SEM_DISCRETE) {
+			    if (icp->t_prior >= 0)
+				rp->vset[j]->vlist[i++].value.lval = icp->v_prior.lval;
+			}
+			else if (pcp->desc.sem == PM_SEM_INSTANT) {
+			    if (icp->t_prior >= 0 && icp->t_next >= 0)
+				rp->vset[j]->vlist[i++].value.lval = icp->v_prior.lval;
+			}
 			else {
-			    if (pcp->desc.sem == PM_SEM_DISCRETE) {
-				if (icp->t_prior >= 0)
-				    rp->vset[j]->vlist[i++].value.lval = icp->v_prior.lval;
-			    }
-			    else if (pcp->desc.sem == PM_SEM_INSTANT) {
-				if (icp->t_prior >= 0 && icp->t_next >= 0)
-				    rp->vset[j]->vlist[i++].value.lval = icp->v_prior.lval;
-			    }
-			    else {
-				/* assume COUNTER */
-				if (icp->t_prior >= 0 && icp->t_next >= 0) {
-				    if (pcp->desc.type == PM_TYPE_32) {
-					if (icp->v_next.lval >= icp->v_prior.lval ||
-					    dowrap == 0) {
-					    rp->vset[j]->vlist[i++].value.lval = 0.5 +
-						icp->v_prior.lval + (t_req - icp->t_prior) *
-						(icp->v_next.lval - icp->v_prior.lval) /
-						(icp->t_next - icp->t_prior);
-					}
-					else {
-					    /* not monotonic increasing and want wrap */
-					    rp->vset[j]->vlist[i++].value.lval = 0.5 +
-						(t_req - icp->t_prior) *
-						(__int32_t)(UINT_MAX - icp->v_prior.lval + 1 + icp->v_next.lval) /
-						(icp->t_next - icp->t_prior);
-					    rp->vset[j]->vlist[i].value.lval += icp->v_prior.lval;
-					}
+			    /* assume COUNTER */
+			    if (icp->t_prior >= 0 && icp->t_next >= 0) {
+				if (pcp->desc.type == PM_TYPE_32) {
+				    if (icp->v_next.lval >= icp->v_prior.lval ||
+					dowrap == 0) {
+					rp->vset[j]->vlist[i++].value.lval = 0.5 +
+					    icp->v_prior.lval + (t_req - icp->t_prior) *
+					    (icp->v_next.lval - icp->v_prior.lval) /
+					    (icp->t_next - icp->t_prior);
+				    }
+				    else {
+					/* not monotonic increasing and want wrap */
+					rp->vset[j]->vlist[i++].value.lval = 0.5 +
+					    (t_req - icp->t_prior) *
+					    (__int32_t)(UINT_MAX - icp->v_prior.lval + 1 + icp->v_next.lval) /
+					    (icp->t_next - icp->t_prior);
+					rp->vset[j]->vlist[i].value.lval += icp->v_prior.lval;
+				    }
+				}
+				else {
+				    pmAtomValue     av;
+				    pmAtomValue     *avp_prior = (pmAtomValue *)&icp->v_prior.lval;
+				    pmAtomValue     *avp_next = (pmAtomValue *)&icp->v_next.lval;
+				    if (avp_next->ul >= avp_prior->ul) {
+					av.ul = 0.5 + avp_prior->ul +
+					    (t_req - icp->t_prior) *
+					    (avp_next->ul - avp_prior->ul) /
+					    (icp->t_next - icp->t_prior);
 				    }
 				    else {
-					pmAtomValue     av;
-					pmAtomValue     *avp_prior = (pmAtomValue *)&icp->v_prior.lval;
-					pmAtomValue     *avp_next = (pmAtomValue *)&icp->v_next.lval;
-					if (avp_next->ul >= avp_prior->ul) {
-					    av.ul = 0.5 + avp_prior->ul +
+					/* not monotonic increasing */
+					if (dowrap) {
+					    av.ul = 0.5 +
 						(t_req - icp->t_prior) *
-						(avp_next->ul - avp_prior->ul) /
+						(__uint32_t)(UINT_MAX - avp_prior->ul + 1 + avp_next->ul ) /
 						(icp->t_next - icp->t_prior);
+					    av.ul += avp_prior->ul;
 					}
 					else {
-					    /* not monotonic increasing */
-					    if (dowrap) {
-						av.ul = 0.5 +
-						    (t_req - icp->t_prior) *
-						    (__uint32_t)(UINT_MAX - avp_prior->ul + 1 + avp_next->ul ) /
-						    (icp->t_next - icp->t_prior);
-						av.ul += avp_prior->ul;
-					    }
-					    else {
-						__uint32_t	ul;
-						ul = avp_prior->ul - avp_next->ul;
-						av.ul = 0.5 + avp_prior->ul -
-						    (t_req - icp->t_prior) * ul /
-						    (icp->t_next - icp->t_prior);
-					    }
+					    __uint32_t	ul;
+					    ul = avp_prior->ul - avp_next->ul;
+					    av.ul = 0.5 + avp_prior->ul -
+						(t_req - icp->t_prior) * ul /
+						(icp->t_next - icp->t_prior);
 					}
-					rp->vset[j]->vlist[i++].value.lval = av.ul;
 				    }
+				    rp->vset[j]->vlist[i++].value.lval = av.ul;
 				}
 			    }
 			}
 		    }
-		    else if (pcp->desc.type == PM_TYPE_FLOAT && icp->metric->valfmt == PM_VAL_INSITU) {
-			/* OLD style FLOAT insitu */
-			if (icp->t_prior == t_req)
-			    rp->vset[j]->vlist[i++].value.lval = icp->v_prior.lval;
-			else if (icp->t_next == t_req)
-			    rp->vset[j]->vlist[i++].value.lval = icp->v_next.lval;
+		}
+		else if (pcp->desc.type == PM_TYPE_FLOAT && icp->metric->valfmt == PM_VAL_INSITU) {
+		    /* OLD style FLOAT insitu */
+		    if (icp->t_prior == t_req)
+			rp->vset[j]->vlist[i++].value.lval = icp->v_prior.lval;
+		    else if (icp->t_next == t_req)
+			rp->vset[j]->vlist[i++].value.lval = icp->v_next.lval;
+		    else {
+			if (pcp->desc.sem == PM_SEM_DISCRETE) {
+			    if (icp->t_prior >= 0)
+				rp->vset[j]->vlist[i++].value.lval = icp->v_prior.lval;
+			}
+			else if (pcp->desc.sem == PM_SEM_INSTANT) {
+			    if (icp->t_prior >= 0 && icp->t_next >= 0)
+				rp->vset[j]->vlist[i++].value.lval = icp->v_prior.lval;
+			}
 			else {
-			    if (pcp->desc.sem == PM_SEM_DISCRETE) {
-				if (icp->t_prior >= 0)
-				    rp->vset[j]->vlist[i++].value.lval = icp->v_prior.lval;
-			    }
-			    else if (pcp->desc.sem == PM_SEM_INSTANT) {
-				if (icp->t_prior >= 0 && icp->t_next >= 0)
-				    rp->vset[j]->vlist[i++].value.lval = icp->v_prior.lval;
-			    }
-			    else {
-				/* assume COUNTER */
-				pmAtomValue	av;
-				pmAtomValue	*avp_prior = (pmAtomValue *)&icp->v_prior.lval;
-				pmAtomValue	*avp_next = (pmAtomValue *)&icp->v_next.lval;
-				if (icp->t_prior >= 0 && icp->t_next >= 0) {
-				    av.f = avp_prior->f + (t_req - icp->t_prior) *
-					(avp_next->f - avp_prior->f) /
-					(icp->t_next - icp->t_prior);
-				    /* yes this IS correct ... */
-				    rp->vset[j]->vlist[i++].value.lval = av.l;
-				}
+			    /* assume COUNTER */
+			    pmAtomValue	av;
+			    pmAtomValue	*avp_prior = (pmAtomValue *)&icp->v_prior.lval;
+			    pmAtomValue	*avp_next = (pmAtomValue *)&icp->v_next.lval;
+			    if (icp->t_prior >= 0 && icp->t_next >= 0) {
+				av.f = avp_prior->f + (t_req - icp->t_prior) *
+				    (avp_next->f - avp_prior->f) /
+				    (icp->t_next - icp->t_prior);
+				/* yes this IS correct ... */
+				rp->vset[j]->vlist[i++].value.lval = av.l;
 			    }
 			}
 		    }
-		    else if (pcp->desc.type == PM_TYPE_FLOAT) {
-			/* NEW style FLOAT in pmValueBlock */
-			int			need;
-			pmValueBlock	*vp;
-			int			ok = 1;
-
-			need = PM_VAL_HDR_SIZE + sizeof(float);
-			if ((vp = (pmValueBlock *)malloc(need)) == NULL) {
-			    sts = -oserror();
-			    goto bad_alloc;
+		}
+		else if (pcp->desc.type == PM_TYPE_FLOAT) {
+		    /* NEW style FLOAT in pmValueBlock */
+		    int			need;
+		    pmValueBlock	*vp;
+		    int			ok = 1;
+
+		    need = PM_VAL_HDR_SIZE + sizeof(float);
+		    if ((vp = (pmValueBlock *)malloc(need)) == NULL) {
+			sts = -oserror();
+			goto bad_alloc;
+		    }
+		    vp->vlen = need;
+		    vp->vtype = PM_TYPE_FLOAT;
+		    rp->vset[j]->valfmt = PM_VAL_DPTR;
+		    rp->vset[j]->vlist[i++].value.pval = vp;
+		    if (icp->t_prior == t_req)
+			memcpy((void *)vp->vbuf, (void *)icp->v_prior.pval->vbuf, sizeof(float));
+		    else if (icp->t_next == t_req)
+			memcpy((void *)vp->vbuf, (void *)icp->v_next.pval->vbuf, sizeof(float));
+		    else {
+			if (pcp->desc.sem == PM_SEM_DISCRETE) {
+			    if (icp->t_prior >= 0)
+				memcpy((void *)vp->vbuf, (void *)icp->v_prior.pval->vbuf, sizeof(float));
+			    else
+				ok = 0;
+			}
+			else if (pcp->desc.sem == PM_SEM_INSTANT) {
+			    if (icp->t_prior >= 0 && icp->t_next >= 0)
+				memcpy((void *)vp->vbuf, (void *)icp->v_prior.pval->vbuf, sizeof(float));
+			    else
+				ok = 0;
 			}
-			vp->vlen = need;
-			vp->vtype = PM_TYPE_FLOAT;
-			rp->vset[j]->valfmt = PM_VAL_DPTR;
-			rp->vset[j]->vlist[i++].value.pval = vp;
-			if (icp->t_prior == t_req)
-			    memcpy((void *)vp->vbuf, (void *)icp->v_prior.pval->vbuf, sizeof(float));
-			else if (icp->t_next == t_req)
-			    memcpy((void *)vp->vbuf, (void *)icp->v_next.pval->vbuf, sizeof(float));
 			else {
-			    if (pcp->desc.sem == PM_SEM_DISCRETE) {
-				if (icp->t_prior >= 0)
-				    memcpy((void *)vp->vbuf, (void *)icp->v_prior.pval->vbuf, sizeof(float));
-				else
-				    ok = 0;
-			    }
-			    else if (pcp->desc.sem == PM_SEM_INSTANT) {
-				if (icp->t_prior >= 0 && icp->t_next >= 0)
-				    memcpy((void *)vp->vbuf, (void *)icp->v_prior.pval->vbuf, sizeof(float));
-				else
-				    ok = 0;
-			    }
-			    else {
-				/* assume COUNTER */
-				if (icp->t_prior >= 0 && icp->t_next >= 0) {
-				    pmAtomValue	av;
-				    void		*avp_prior = icp->v_prior.pval->vbuf;
-				    void		*avp_next = icp->v_next.pval->vbuf;
-				    float	f_prior;
-				    float	f_next;
-
-				    memcpy((void *)&av.f, avp_prior, sizeof(av.f));
-				    f_prior = av.f;
-				    memcpy((void *)&av.f, avp_next, sizeof(av.f));
-				    f_next = av.f;
+			    /* assume COUNTER */
+			    if (icp->t_prior >= 0 && icp->t_next >= 0) {
+				pmAtomValue	av;
+				void		*avp_prior = icp->v_prior.pval->vbuf;
+				void		*avp_next = icp->v_next.pval->vbuf;
+				float	f_prior;
+				float	f_next;
+
+				memcpy((void *)&av.f, avp_prior, sizeof(av.f));
+				f_prior = av.f;
+				memcpy((void *)&av.f, avp_next, sizeof(av.f));
+				f_next = av.f;
 				    
-				    av.f = f_prior + (t_req - icp->t_prior) *
-					(f_next - f_prior) /
-					(icp->t_next - icp->t_prior);
-				    memcpy((void *)vp->vbuf, (void *)&av.f, sizeof(av.f));
-				}
-				else
-				    ok = 0;
+				av.f = f_prior + (t_req - icp->t_prior) *
+				    (f_next - f_prior) /
+				    (icp->t_next - icp->t_prior);
+				memcpy((void *)vp->vbuf, (void *)&av.f, sizeof(av.f));
 			    }
-			}
-			if (!ok) {
-			    i--;
-			    free(vp);
+			    else
+				ok = 0;
 			}
 		    }
-		    else if (pcp->desc.type == PM_TYPE_64 || pcp->desc.type == PM_TYPE_U64) {
-			int			need;
-			pmValueBlock	*vp;
-			int			ok = 1;
+		    if (!ok) {
+			i--;
+			free(vp);
+		    }
+		}
+		else if (pcp->desc.type == PM_TYPE_64 || pcp->desc.type == PM_TYPE_U64) {
+		    int			need;
+		    pmValueBlock	*vp;
+		    int			ok = 1;
 			
-			need = PM_VAL_HDR_SIZE + sizeof(__int64_t);
-			if ((vp = (pmValueBlock *)malloc(need)) == NULL) {
-			    sts = -oserror();
-			    goto bad_alloc;
+		    need = PM_VAL_HDR_SIZE + sizeof(__int64_t);
+		    if ((vp = (pmValueBlock *)malloc(need)) == NULL) {
+			sts = -oserror();
+			goto bad_alloc;
+		    }
+		    vp->vlen = need;
+		    if (pcp->desc.type == PM_TYPE_64)
+			vp->vtype = PM_TYPE_64;
+		    else
+			vp->vtype = PM_TYPE_U64;
+		    rp->vset[j]->valfmt = PM_VAL_DPTR;
+		    rp->vset[j]->vlist[i++].value.pval = vp;
+		    if (icp->t_prior == t_req)
+			memcpy((void *)vp->vbuf, (void *)icp->v_prior.pval->vbuf, sizeof(__int64_t));
+		    else if (icp->t_next == t_req)
+			memcpy((void *)vp->vbuf, (void *)icp->v_next.pval->vbuf, sizeof(__int64_t));
+		    else {
+			if (pcp->desc.sem == PM_SEM_DISCRETE) {
+			    if (icp->t_prior >= 0)
+				memcpy((void *)vp->vbuf, (void *)icp->v_prior.pval->vbuf, sizeof(__int64_t));
+			    else
+				ok = 0;
+			}
+			else if (pcp->desc.sem == PM_SEM_INSTANT) {
+			    if (icp->t_prior >= 0 && icp->t_next >= 0)
+				memcpy((void *)vp->vbuf, (void *)icp->v_prior.pval->vbuf, sizeof(__int64_t));
+			    else
+				ok = 0;
 			}
-			vp->vlen = need;
-			if (pcp->desc.type == PM_TYPE_64)
-			    vp->vtype = PM_TYPE_64;
-			else
-			    vp->vtype = PM_TYPE_U64;
-			rp->vset[j]->valfmt = PM_VAL_DPTR;
-			rp->vset[j]->vlist[i++].value.pval = vp;
-			if (icp->t_prior == t_req)
-			    memcpy((void *)vp->vbuf, (void *)icp->v_prior.pval->vbuf, sizeof(__int64_t));
-			else if (icp->t_next == t_req)
-			    memcpy((void *)vp->vbuf, (void *)icp->v_next.pval->vbuf, sizeof(__int64_t));
 			else {
-			    if (pcp->desc.sem == PM_SEM_DISCRETE) {
-				if (icp->t_prior >= 0)
-				    memcpy((void *)vp->vbuf, (void *)icp->v_prior.pval->vbuf, sizeof(__int64_t));
-				else
-				    ok = 0;
-			    }
-			    else if (pcp->desc.sem == PM_SEM_INSTANT) {
-				if (icp->t_prior >= 0 && icp->t_next >= 0)
-				    memcpy((void *)vp->vbuf, (void *)icp->v_prior.pval->vbuf, sizeof(__int64_t));
-				else
-				    ok = 0;
-			    }
-			    else {
-				/* assume COUNTER */
-				if (icp->t_prior >= 0 && icp->t_next >= 0) {
-				    pmAtomValue	av;
-				    void		*avp_prior = (void *)icp->v_prior.pval->vbuf;
-				    void		*avp_next = (void *)icp->v_next.pval->vbuf;
-				    if (pcp->desc.type == PM_TYPE_64) {
-					__int64_t	ll_prior;
-					__int64_t	ll_next;
-					memcpy((void *)&av.ll, avp_prior, sizeof(av.ll));
-					ll_prior = av.ll;
-					memcpy((void *)&av.ll, avp_next, sizeof(av.ll));
-					ll_next = av.ll;
-					if (ll_next >= ll_prior || dowrap == 0)
-					    av.ll = ll_next - ll_prior;
-					else
-					    /* not monotonic increasing and want wrap */
-					    av.ll = (__int64_t)(ULONGLONG_MAX - ll_prior + 1 +  ll_next);
-					av.ll = (__int64_t)(0.5 + (double)ll_prior +
-							    (t_req - icp->t_prior) * (double)av.ll / (icp->t_next - icp->t_prior));
-					memcpy((void *)vp->vbuf, (void *)&av.ll, sizeof(av.ll));
+			    /* assume COUNTER */
+			    if (icp->t_prior >= 0 && icp->t_next >= 0) {
+				pmAtomValue	av;
+				void		*avp_prior = (void *)icp->v_prior.pval->vbuf;
+				void		*avp_next = (void *)icp->v_next.pval->vbuf;
+				if (pcp->desc.type == PM_TYPE_64) {
+				    __int64_t	ll_prior;
+				    __int64_t	ll_next;
+				    memcpy((void *)&av.ll, avp_prior, sizeof(av.ll));
+				    ll_prior = av.ll;
+				    memcpy((void *)&av.ll, avp_next, sizeof(av.ll));
+				    ll_next = av.ll;
+				    if (ll_next >= ll_prior || dowrap == 0)
+					av.ll = ll_next - ll_prior;
+				    else
+					/* not monotonic increasing and want wrap */
+					av.ll = (__int64_t)(ULONGLONG_MAX - ll_prior + 1 +  ll_next);
+				    av.ll = (__int64_t)(0.5 + (double)ll_prior +
+							(t_req - icp->t_prior) * (double)av.ll / (icp->t_next - icp->t_prior));
+				    memcpy((void *)vp->vbuf, (void *)&av.ll, sizeof(av.ll));
+				}
+				else {
+				    __int64_t	ull_prior;
+				    __int64_t	ull_next;
+				    memcpy((void *)&av.ull, avp_prior, sizeof(av.ull));
+				    ull_prior = av.ull;
+				    memcpy((void *)&av.ull, avp_next, sizeof(av.ull));
+				    ull_next = av.ull;
+				    if (ull_next >= ull_prior) {
+					av.ull = ull_next - ull_prior;
+#if !defined(HAVE_CAST_U64_DOUBLE)
+					{
+					    double tmp;
+						
+					    if (SIGN_64_MASK & av.ull)
+						tmp = (double)(__int64_t)(av.ull & (~SIGN_64_MASK)) + (__uint64_t)SIGN_64_MASK;
+					    else
+						tmp = (double)(__int64_t)av.ull;
+						
+					    av.ull = (__uint64_t)(0.5 + (double)ull_prior +
+								  (t_req - icp->t_prior) * tmp /
+								  (icp->t_next - icp->t_prior));
+					}
+#else
+					av.ull = (__uint64_t)(0.5 + (double)ull_prior +
+							      (t_req - icp->t_prior) * (double)av.ull /
+							      (icp->t_next - icp->t_prior));
+#endif
 				    }
 				    else {
-					__int64_t	ull_prior;
-					__int64_t	ull_next;
-					memcpy((void *)&av.ull, avp_prior, sizeof(av.ull));
-					ull_prior = av.ull;
-					memcpy((void *)&av.ull, avp_next, sizeof(av.ull));
-					ull_next = av.ull;
-					if (ull_next >= ull_prior) {
-					    av.ull = ull_next - ull_prior;
+					/* not monotonic increasing */
+					if (dowrap) {
+					    av.ull = ULONGLONG_MAX - ull_prior + 1 +
+						ull_next;
 #if !defined(HAVE_CAST_U64_DOUBLE)
 					    {
 						double tmp;
-						
+						    
 						if (SIGN_64_MASK & av.ull)
 						    tmp = (double)(__int64_t)(av.ull & (~SIGN_64_MASK)) + (__uint64_t)SIGN_64_MASK;
 						else
 						    tmp = (double)(__int64_t)av.ull;
-						
+						    
 						av.ull = (__uint64_t)(0.5 + (double)ull_prior +
 								      (t_req - icp->t_prior) * tmp /
 								      (icp->t_next - icp->t_prior));
@@ -1947,144 +2382,119 @@ PM_FAULT_POINT("libpcp/" __FILE__ ":1", PM_FAULT_CALL);
 #endif
 					}
 					else {
-					    /* not monotonic increasing */
-					    if (dowrap) {
-						av.ull = ULONGLONG_MAX - ull_prior + 1 +
-						    ull_next;
+					    __uint64_t	ull;
+					    ull = ull_prior - ull_next;
 #if !defined(HAVE_CAST_U64_DOUBLE)
-						{
-						    double tmp;
+					    {
+						double xull;
 						    
-						    if (SIGN_64_MASK & av.ull)
-							tmp = (double)(__int64_t)(av.ull & (~SIGN_64_MASK)) + (__uint64_t)SIGN_64_MASK;
-						    else
-							tmp = (double)(__int64_t)av.ull;
+						if (SIGN_64_MASK & av.ull)
+						    xull = (double)(__int64_t)(ull & (~SIGN_64_MASK)) + (__uint64_t)SIGN_64_MASK;
+						else
+						    xull = (double)(__int64_t)ull;
 						    
-						    av.ull = (__uint64_t)(0.5 + (double)ull_prior +
-									  (t_req - icp->t_prior) * tmp /
-									  (icp->t_next - icp->t_prior));
-						}
-#else
-						av.ull = (__uint64_t)(0.5 + (double)ull_prior +
-								      (t_req - icp->t_prior) * (double)av.ull /
+						av.ull = (__uint64_t)(0.5 + (double)ull_prior -
+								      (t_req - icp->t_prior) * xull /
 								      (icp->t_next - icp->t_prior));
-#endif
 					    }
-					    else {
-						__uint64_t	ull;
-						ull = ull_prior - ull_next;
-#if !defined(HAVE_CAST_U64_DOUBLE)
-						{
-						    double xull;
-						    
-						    if (SIGN_64_MASK & av.ull)
-							xull = (double)(__int64_t)(ull & (~SIGN_64_MASK)) + (__uint64_t)SIGN_64_MASK;
-						    else
-							xull = (double)(__int64_t)ull;
-						    
-						    av.ull = (__uint64_t)(0.5 + (double)ull_prior -
-									  (t_req - icp->t_prior) * xull /
-									  (icp->t_next - icp->t_prior));
-						}
 #else
-						av.ull = (__uint64_t)(0.5 + (double)ull_prior -
-								      (t_req - icp->t_prior) * (double)ull /
-								      (icp->t_next - icp->t_prior));
+					    av.ull = (__uint64_t)(0.5 + (double)ull_prior -
+								  (t_req - icp->t_prior) * (double)ull /
+								  (icp->t_next - icp->t_prior));
 #endif
-					    }
 					}
-					memcpy((void *)vp->vbuf, (void *)&av.ull, sizeof(av.ull));
 				    }
+				    memcpy((void *)vp->vbuf, (void *)&av.ull, sizeof(av.ull));
 				}
-				else
-				    ok = 0;
 			    }
-			}
-			if (!ok) {
-			    i--;
-			    free(vp);
+			    else
+				ok = 0;
 			}
 		    }
-		    else if (pcp->desc.type == PM_TYPE_DOUBLE) {
-			pmValueBlock	*vp;
-			int		need;
-			int		ok = 1;
+		    if (!ok) {
+			i--;
+			free(vp);
+		    }
+		}
+		else if (pcp->desc.type == PM_TYPE_DOUBLE) {
+		    pmValueBlock	*vp;
+		    int		need;
+		    int		ok = 1;
 			
-			need = PM_VAL_HDR_SIZE + sizeof(double);
-			if ((vp = (pmValueBlock *)malloc(need)) == NULL) {
-			    sts = -oserror();
-			    goto bad_alloc;
+		    need = PM_VAL_HDR_SIZE + sizeof(double);
+		    if ((vp = (pmValueBlock *)malloc(need)) == NULL) {
+			sts = -oserror();
+			goto bad_alloc;
+		    }
+		    vp->vlen = need;
+		    vp->vtype = PM_TYPE_DOUBLE;
+		    rp->vset[j]->valfmt = PM_VAL_DPTR;
+		    rp->vset[j]->vlist[i++].value.pval = vp;
+		    if (icp->t_prior == t_req)
+			memcpy((void *)vp->vbuf, (void *)icp->v_prior.pval->vbuf, sizeof(double));
+		    else if (icp->t_next == t_req)
+			memcpy((void *)vp->vbuf, (void *)icp->v_next.pval->vbuf, sizeof(double));
+		    else {
+			if (pcp->desc.sem == PM_SEM_DISCRETE) {
+			    if (icp->t_prior >= 0)
+				memcpy((void *)vp->vbuf, (void *)icp->v_prior.pval->vbuf, sizeof(double));
+			    else
+				ok = 0;
+			}
+			else if (pcp->desc.sem == PM_SEM_INSTANT) {
+			    if (icp->t_prior >= 0 && icp->t_next >= 0)
+				memcpy((void *)vp->vbuf, (void *)icp->v_prior.pval->vbuf, sizeof(double));
+			    else
+				ok = 0;
 			}
-			vp->vlen = need;
-			vp->vtype = PM_TYPE_DOUBLE;
-			rp->vset[j]->valfmt = PM_VAL_DPTR;
-			rp->vset[j]->vlist[i++].value.pval = vp;
-			if (icp->t_prior == t_req)
-			    memcpy((void *)vp->vbuf, (void *)icp->v_prior.pval->vbuf, sizeof(double));
-			else if (icp->t_next == t_req)
-			    memcpy((void *)vp->vbuf, (void *)icp->v_next.pval->vbuf, sizeof(double));
 			else {
-			    if (pcp->desc.sem == PM_SEM_DISCRETE) {
-				if (icp->t_prior >= 0)
-				    memcpy((void *)vp->vbuf, (void *)icp->v_prior.pval->vbuf, sizeof(double));
-				else
-				    ok = 0;
-			    }
-			    else if (pcp->desc.sem == PM_SEM_INSTANT) {
-				if (icp->t_prior >= 0 && icp->t_next >= 0)
-				    memcpy((void *)vp->vbuf, (void *)icp->v_prior.pval->vbuf, sizeof(double));
-				else
-				    ok = 0;
-			    }
-			    else {
-				/* assume COUNTER */
-				if (icp->t_prior >= 0 && icp->t_next >= 0) {
-				    pmAtomValue	av;
-				    void	*avp_prior = (void *)icp->v_prior.pval->vbuf;
-				    void	*avp_next = (void *)icp->v_next.pval->vbuf;
-				    double	d_prior;
-				    double	d_next;
-				    memcpy((void *)&av.d, avp_prior, sizeof(av.d));
-				    d_prior = av.d;
-				    memcpy((void *)&av.d, avp_next, sizeof(av.d));
-				    d_next = av.d;
-				    av.d = d_prior + (t_req - icp->t_prior) *
-					(d_next - d_prior) /
-					(icp->t_next - icp->t_prior);
-				    memcpy((void *)vp->vbuf, (void *)&av.d, sizeof(av.d));
-				}
-				else
-				    ok = 0;
+			    /* assume COUNTER */
+			    if (icp->t_prior >= 0 && icp->t_next >= 0) {
+				pmAtomValue	av;
+				void	*avp_prior = (void *)icp->v_prior.pval->vbuf;
+				void	*avp_next = (void *)icp->v_next.pval->vbuf;
+				double	d_prior;
+				double	d_next;
+				memcpy((void *)&av.d, avp_prior, sizeof(av.d));
+				d_prior = av.d;
+				memcpy((void *)&av.d, avp_next, sizeof(av.d));
+				d_next = av.d;
+				av.d = d_prior + (t_req - icp->t_prior) *
+				    (d_next - d_prior) /
+				    (icp->t_next - icp->t_prior);
+				memcpy((void *)vp->vbuf, (void *)&av.d, sizeof(av.d));
 			    }
-			}
-			if (!ok) {
-			    i--;
-			    free(vp);
+			    else
+				ok = 0;
 			}
 		    }
-		    else if ((pcp->desc.type == PM_TYPE_AGGREGATE ||
-			      pcp->desc.type == PM_TYPE_EVENT ||
-			      pcp->desc.type == PM_TYPE_HIGHRES_EVENT ||
-			      pcp->desc.type == PM_TYPE_STRING) &&
-			     icp->t_prior >= 0) {
-			int		need;
-			pmValueBlock	*vp;
+		    if (!ok) {
+			i--;
+			free(vp);
+		    }
+		}
+		else if ((pcp->desc.type == PM_TYPE_AGGREGATE ||
+			  pcp->desc.type == PM_TYPE_EVENT ||
+			  pcp->desc.type == PM_TYPE_HIGHRES_EVENT ||
+			  pcp->desc.type == PM_TYPE_STRING) &&
+			 icp->t_prior >= 0) {
+		    int		need;
+		    pmValueBlock	*vp;
 			
-			need = icp->v_prior.pval->vlen;
+		    need = icp->v_prior.pval->vlen;
 			
-			vp = (pmValueBlock *)malloc(need);
-			if (vp == NULL) {
-			    sts = -oserror();
-			    goto bad_alloc;
-			}
-			rp->vset[j]->valfmt = PM_VAL_DPTR;
-			rp->vset[j]->vlist[i++].value.pval = vp;
-			memcpy((void *)vp, icp->v_prior.pval, need);
-		    }
-		    else {
-			/* unknown type - skip it, else junk in result */
-			i--;
+		    vp = (pmValueBlock *)malloc(need);
+		    if (vp == NULL) {
+			sts = -oserror();
+			goto bad_alloc;
 		    }
+		    rp->vset[j]->valfmt = PM_VAL_DPTR;
+		    rp->vset[j]->vlist[i++].value.pval = vp;
+		    memcpy((void *)vp, icp->v_prior.pval, need);
+		}
+		else {
+		    /* unknown type - skip it, else junk in result */
+		    i--;
 		}
 	    }
 	}
@@ -2094,6 +2504,9 @@ PM_FAULT_POINT("libpcp/" __FILE__ ":1", PM_FAULT_CALL);
     *result = rp;
     sts = 0;
 
+    if ((limit = get_memory_limit((memctl_t *)ctxp->c_archctl->ac_memctl)) > 0)
+	enforce_limit(ctxp, numpmid, pmidlist, limit);
+
 all_done:
     ctxp->c_origin.sec += ctxp->c_delta.sec;
     ctxp->c_origin.nsec += ctxp->c_delta.nsec;
@@ -2108,13 +2521,15 @@ all_done:
 
     if (pmDebugOptions.interp) {
 	fprintf(stderr, "__pmLogFetchInterp: log reads: forward %ld",
-	    nr[PM_MODE_FORW]);
-	if (nr_cache[PM_MODE_FORW])
-	    fprintf(stderr, " (+%ld cached)", nr_cache[PM_MODE_FORW]);
+	    nr[PM_MODE_FORW] - nr_start[PM_MODE_FORW]);
+	if (nr_cache[PM_MODE_FORW] != nr_cache_start[PM_MODE_FORW])
+	    fprintf(stderr, " (+%ld cached)",
+		nr_cache[PM_MODE_FORW] - nr_cache_start[PM_MODE_FORW]);
 	fprintf(stderr, " backwards %ld",
-	    nr[PM_MODE_BACK]);
-	if (nr_cache[PM_MODE_BACK])
-	    fprintf(stderr, " (+%ld cached)", nr_cache[PM_MODE_BACK]);
+	    nr[PM_MODE_BACK] - nr_start[PM_MODE_BACK]);
+	if (nr_cache[PM_MODE_BACK] != nr_cache_start[PM_MODE_BACK])
+	    fprintf(stderr, " (+%ld cached)",
+		nr_cache[PM_MODE_BACK] - nr_cache_start[PM_MODE_BACK]);
 	fprintf(stderr, "\n");
     }
     if (pmDebugOptions.qa) {
@@ -2149,38 +2564,22 @@ bad_alloc:
 void
 __pmLogResetInterp(__pmContext *ctxp)
 {
-    __pmHashCtl	*hcp = &ctxp->c_archctl->ac_pmid_hc;
+    __pmOAHashCtl	*hcp = &ctxp->c_archctl->ac_pmid_hc;
     double	t_req;
-    __pmHashNode	*hp;
-    __pmHashNode	*ihp;
-    int		i, k;
+    __pmOAHashNode	*hp;
     pmidcntl_t	*pcp;
     instcntl_t	*icp;
 
-    if (hcp->hsize == 0)
+    if (hcp->nodes == 0)
 	return;
 
     t_req = __pmTimestampSub(&ctxp->c_origin, __pmLogStartTime(ctxp->c_archctl));
-    for (k = 0; k < hcp->hsize; k++) {
-	for (hp = hcp->hash[k]; hp != NULL; hp = hp->next) {
-	    pcp = (pmidcntl_t *)hp->data;
-	    for (i = 0; i < pcp->hc.hsize; i++) {
-		for (ihp = pcp->hc.hash[i]; ihp != NULL; ihp = ihp->next) {
-		    icp = (instcntl_t *)ihp->data;
-		    if (icp->t_prior > t_req || icp->t_next < t_req) {
-			icp->t_prior = icp->t_next = -1;
-			SET_UNDEFINED(icp->s_prior);
-			SET_UNDEFINED(icp->s_next);
-			if (pcp->valfmt != PM_VAL_INSITU) {
-			    if (icp->v_prior.pval != NULL)
-				__pmUnpinPDUBuf((void *)icp->v_prior.pval);
-			    if (icp->v_next.pval != NULL)
-				__pmUnpinPDUBuf((void *)icp->v_next.pval);
-			}
-			icp->v_prior.pval = icp->v_next.pval = NULL;
-		    }
-		}
-	    }
+    for (hp = __pmOAHashWalk(hcp, PM_HASH_WALK_START); hp != NULL;
+	 hp = __pmOAHashWalk(hcp, PM_HASH_WALK_NEXT)) {
+	pcp = (pmidcntl_t *)hp->data;
+	for (icp = pcp->inst; icp < &pcp->inst[pcp->ninst]; icp++) {
+	    if (icp->t_prior > t_req || icp->t_next < t_req)
+		reset(icp);
 	}
     }
 }
@@ -2196,98 +2595,77 @@ __pmLogResetInterp(__pmContext *ctxp)
 void
 __pmFreeInterpData(__pmContext *ctxp)
 {
-    if (ctxp->c_archctl->ac_pmid_hc.hsize > 0) {
+    if (ctxp->c_archctl->ac_pmid_hc.nodes > 0) {
 	/* we have done some interpolation ... */
-	__pmHashCtl	*hcp = &ctxp->c_archctl->ac_pmid_hc;
-	__pmHashNode	*hp;
+	__pmOAHashCtl	*hcp = &ctxp->c_archctl->ac_pmid_hc;
+	__pmOAHashNode	*hp;
 	__pmHashNode	*ihp;
 	pmidcntl_t	*pcp;
 	instcntl_t	*icp;
-	int		i, j;
+	int		i;
 
-	for (j = 0; j < hcp->hsize; j++) {
-	    __pmHashNode	*last_hp = NULL;
-	    /*
-	     * Don't free __pmHashNode until hp->next has been traversed,
-	     * hence free lags one node in the chain (last_hp used for free).
-	     * Same for linked list of instcntl_t structs (use last_ihp
-	     * for free in this case).
-	     */
-	    for (hp = hcp->hash[j]; hp != NULL; hp = hp->next) {
-		pcp = (pmidcntl_t *)hp->data;
-		for (i = 0; i < pcp->hc.hsize; i++) {
-		    __pmHashNode	*last_ihp = NULL;
-		    for (ihp = pcp->hc.hash[i]; ihp != NULL; ihp = ihp->next) {
-			icp = (instcntl_t *)ihp->data;
-			if (pcp->valfmt != PM_VAL_INSITU) {
-			    /*
-			     * Held values may be in PDU buffers, unpin the PDU
-			     * buffers just in case (__pmUnpinPDUBuf is a NOP if
-			     * the value is not in a PDU buffer)
-			     */
-			    if (icp->v_prior.pval != NULL) {
-				if (pmDebugOptions.interp && pmDebugOptions.desperate) {
-				    char	strbuf[20];
-				    fprintf(stderr, "release pmid %s inst %d prior\n",
-					    pmIDStr_r(pcp->desc.pmid, strbuf, sizeof(strbuf)), icp->inst);
-				}
-				__pmUnpinPDUBuf((void *)icp->v_prior.pval);
-			    }
-			    if (icp->v_next.pval != NULL) {
-				if (pmDebugOptions.interp && pmDebugOptions.desperate) {
-				    char	strbuf[20];
-				    fprintf(stderr, "release pmid %s inst %d next\n",
-					    pmIDStr_r(pcp->desc.pmid, strbuf, sizeof(strbuf)), icp->inst);
-				}
-				__pmUnpinPDUBuf((void *)icp->v_next.pval);
-			    }
-			}
-			if (last_ihp != NULL) {
-			    if (last_ihp->data != NULL)
-				free(last_ihp->data);
-			    free(last_ihp);
+	for (hp = __pmOAHashWalk(hcp, PM_HASH_WALK_START); hp != NULL;
+	     hp = __pmOAHashWalk(hcp, PM_HASH_WALK_NEXT)) {
+	    pcp = (pmidcntl_t *)hp->data;
+	    for (icp = pcp->inst; icp < &pcp->inst[pcp->ninst]; icp++) {
+		if (pcp->valfmt != PM_VAL_INSITU) {
+		    /*
+		     * Held values may be in PDU buffers, unpin the PDU
+		     * buffers just in case (__pmUnpinPDUBuf is a NOP if
+		     * the value is not in a PDU buffer)
+		     */
+		    if (icp->v_prior.pval != NULL) {
+			if (pmDebugOptions.interp && pmDebugOptions.desperate) {
+			    char	strbuf[20];
+			    fprintf(stderr, "release pmid %s inst %d prior\n",
+				    pmIDStr_r(pcp->desc.pmid, strbuf, sizeof(strbuf)), icp->inst);
 			}
-			last_ihp = ihp;
+			__pmUnpinPDUBuf((void *)icp->v_prior.pval);
 		    }
-		    if (last_ihp != NULL) {
-			if (last_ihp->data != NULL)
-			    free(last_ihp->data);
-			free(last_ihp);
+		    if (icp->v_next.pval != NULL) {
+			if (pmDebugOptions.interp && pmDebugOptions.desperate) {
+			    char	strbuf[20];
+			    fprintf(stderr, "release pmid %s inst %d next\n",
+				    pmIDStr_r(pcp->desc.pmid, strbuf, sizeof(strbuf)), icp->inst);
+			}
+			__pmUnpinPDUBuf((void *)icp->v_next.pval);
 		    }
 		}
-		if (pcp->hc.hash) {
-		    free(pcp->hc.hash);
-		    /* just being paranoid here */
-		    pcp->hc.hash = NULL;
-		}
-		pcp->hc.hsize = 0;
-		if (last_hp != NULL) {
-		    if (last_hp->data != NULL)
-			free(last_hp->data);
-		    free(last_hp);
+	    }
+	    if (pcp->inst != NULL)
+		free(pcp->inst);
+	    for (i = 0; i < pcp->hc.hsize; i++) {
+		__pmHashNode	*last_ihp = NULL;
+		/*
+		 * Don't free __pmHashNode until ihp->next has been
+		 * traversed, hence free lags one node in the chain
+		 * (last_ihp used for free), the data is in pcp->inst[].
+		 */
+		for (ihp = pcp->hc.hash[i]; ihp != NULL; ihp = ihp->next) {
+		    if (last_ihp != NULL)
+			free(last_ihp);
+		    last_ihp = ihp;
 		}
-		last_hp = hp;
+		if (last_ihp != NULL)
+		    free(last_ihp);
 	    }
-	    if (last_hp != NULL) {
-		if (last_hp->data != NULL)
-		    free(last_hp->data);
-		free(last_hp);
+	    if (pcp->hc.hash) {
+		free(pcp->hc.hash);
+		/* just being paranoid here */
+		pcp->hc.hash = NULL;
 	    }
+	    pcp->hc.hsize = 0;
+	    free(pcp);
 	}
-	if (hcp->hash) {
-	    free(hcp->hash);
-	    /* just being paranoid here */
-	    hcp->hash = NULL;
-	}
-	hcp->hsize = 0;
+	__pmOAHashClear(hcp);
     }
 
     if (ctxp->c_archctl->ac_cache != NULL) {
 	/* read cache allocated, work to be done */
-	cache_t		*cache = (cache_t *)ctxp->c_archctl->ac_cache;
+	readcache_t	*rcp = (readcache_t *)ctxp->c_archctl->ac_cache;
 	cache_t		*cp;
 
-	for (cp = cache; cp < &cache[NUMCACHE]; cp++) {
+	for (cp = rcp->cache; cp < &rcp->cache[rcp->ncache]; cp++) {
 	    if (pmDebugOptions.log && pmDebugOptions.interp) {
 		fprintf(stderr, "read cache entry "
 			PRINTF_P_PFX "%p: c_name=%s rp="
@@ -2304,6 +2682,77 @@ __pmFreeInterpData(__pmContext *ctxp)
 		cp->rp = NULL;
 	    }
 	    cp->used = 0;
+	    cp->size = 0;
 	}
+	rcp->bytes = 0;
     }
 }
+
+/*
+ * Archive record reads and read cache hits, summed over all archive
+ * contexts since the process started.  mode is PM_MODE_FORW or
+ * PM_MODE_BACK.
+ */
+int
+__pmGetInterpStats(int mode, long *reads, long *hits)
+{
+    if (mode != PM_MODE_FORW && mode != PM_MODE_BACK)
+	return PM_ERR_MODE;
+    if (reads != NULL)
+	*reads = nr[mode];
+    if (hits != NULL)
+	*hits = nr_cache[mode];
+    return 0;
+}
+
+/*
+ * Memory used for interpolation in the current archive context, see
+ * memctl_t above.
+ */
+int
+__pmGetInterpUsage(__pmInterpUsage *up)
+{
+    __pmContext	*ctxp;
+    memctl_t	*mcp;
+
+    if ((ctxp = __pmHandleToPtr(pmWhichContext())) == NULL)
+	return PM_ERR_NOCONTEXT;
+    if (ctxp->c_type != PM_CONTEXT_ARCHIVE) {
+	PM_UNLOCK(ctxp->c_lock);
+	return PM_ERR_NOTARCHIVE;
+    }
+    memset(up, 0, sizeof(*up));
+    up->bytes = interp_usage(ctxp->c_archctl, &up->values);
+    mcp = (memctl_t *)ctxp->c_archctl->ac_memctl;
+    up->limit = get_memory_limit(mcp);
+    if (mcp != NULL) {
+	up->evicted = mcp->evicted;
+	up->released = mcp->released;
+	up->unloaded = mcp->unloaded;
+    }
+    PM_UNLOCK(ctxp->c_lock);
+    return 0;
+}
+
+/*
+ * Set the limit on memory used for interpolation in the current
+ * archive context, overriding $PCP_INTERP_MEMORY ... 0 for no limit.
+ */
+int
+__pmSetInterpLimit(size_t limit)
+{
+    __pmContext	*ctxp;
+    memctl_t	*mcp;
+    int		sts = 0;
+
+    if ((ctxp = __pmHandleToPtr(pmWhichContext())) == NULL)
+	return PM_ERR_NOCONTEXT;
+    if (ctxp->c_type != PM_CONTEXT_ARCHIVE)
+	sts = PM_ERR_NOTARCHIVE;
+    else if ((mcp = get_memctl(ctxp->c_archctl)) == NULL)
+	sts = -oserror();
+    else
+	mcp->limit = (long)limit;
+    PM_UNLOCK(ctxp->c_lock);
+    return sts;
+}
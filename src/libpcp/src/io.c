@@ -25,9 +25,15 @@
 #include "internal.h"
 
 extern __pm_fops __pm_stdio;
+#if !defined(IS_MINGW)
+extern __pm_fops __pm_mmap;
+#endif
 #if HAVE_TRANSPARENT_DECOMPRESSION && HAVE_LZMA_DECOMPRESSION
 extern __pm_fops __pm_xz;
 #endif
+#if HAVE_ZLIB_DECOMPRESSION
+extern __pm_fops __pm_gzip;
+#endif
 
 /*
  * Suffixes and associated compresssion application for compressed filenames.
@@ -46,21 +52,60 @@ extern __pm_fops __pm_xz;
 #define TRANSPARENT_XZ NULL
 #endif
 
+#if HAVE_TRANSPARENT_DECOMPRESSION && HAVE_ZLIB_DECOMPRESSION
+#define TRANSPARENT_GZIP (&__pm_gzip)
+#else
+#define TRANSPARENT_GZIP NULL
+#endif
+
+/* handlers that can also write compressed files, for __pmFopen(..., "w") */
+#if HAVE_ZLIB_DECOMPRESSION
+#define WRITE_GZIP (&__pm_gzip)
+#else
+#define WRITE_GZIP NULL
+#endif
+
 static const struct {
     const char	*suffix;
     const int	appl;
     __pm_fops   *handler;
+    __pm_fops   *whandler;
 } compress_ctl[] = {
-    { ".xz",	USE_XZ,	 	TRANSPARENT_XZ },
-    { ".lzma",	USE_XZ,		NULL },
-    { ".bz2",	USE_BZIP2,	NULL },
-    { ".bz",	USE_BZIP2,	NULL },
-    { ".gz",	USE_GZIP,	NULL },
-    { ".Z",	USE_GZIP,	NULL },
-    { ".z",	USE_GZIP,	NULL },
+    { ".xz",	USE_XZ,	 	TRANSPARENT_XZ,		NULL },
+    { ".lzma",	USE_XZ,		NULL,			NULL },
+    { ".bz2",	USE_BZIP2,	NULL,			NULL },
+    { ".bz",	USE_BZIP2,	NULL,			NULL },
+    { ".gz",	USE_GZIP,	TRANSPARENT_GZIP,	WRITE_GZIP },
+    { ".Z",	USE_GZIP,	NULL,			NULL },
+    { ".z",	USE_GZIP,	NULL,			NULL },
 };
 static const int ncompress = sizeof(compress_ctl) / sizeof(compress_ctl[0]);
 
+#if !defined(IS_MINGW)
+/*
+ * Uncompressed files opened read-only use the mmap handler unless
+ * $PCP_ARCHIVE_MMAP is set to 0 ... -1 => not yet initialized.
+ * One-trip initialization is guarded by the __pmLock_extcall mutex.
+ */
+static int	use_mmap = -1;
+
+static int
+mmap_enabled(void)
+{
+    char	*str;
+    int		sts;
+
+    PM_LOCK(__pmLock_extcall);
+    if (use_mmap < 0) {
+	str = getenv("PCP_ARCHIVE_MMAP");	/* THREADSAFE */
+	use_mmap = (str == NULL || strcmp(str, "0") != 0);
+    }
+    sts = use_mmap;
+    PM_UNLOCK(__pmLock_extcall);
+    return sts;
+}
+#endif
+
 int
 __pmLogCompressedSuffix(const char *suffix)
 {
@@ -352,6 +397,29 @@ __pmCompressedFileIndex(char *fname, size_t flen)
     return -1;
 }
 
+/*
+ * Return the file name suffix for new files compressed with method
+ * (e.g. "gzip"), or NULL if libpcp cannot write files compressed
+ * this way.
+ */
+const char *
+__pmCompressSuffix(const char *method)
+{
+    int		appl;
+    int		i;
+
+    if (strcmp(method, "bzip2") == 0) appl = USE_BZIP2;
+    else if (strcmp(method, "gzip") == 0) appl = USE_GZIP;
+    else if (strcmp(method, "xz") == 0) appl = USE_XZ;
+    else return NULL;
+
+    for (i = 0; i < ncompress; i++) {
+	if (compress_ctl[i].appl == appl && compress_ctl[i].whandler != NULL)
+	    return compress_ctl[i].suffix;
+    }
+    return NULL;
+}
+
 /*
  * Lookup whether the suffix matches one of the compression styles,
  * and if so return the matching index into the compress_ctl table.
@@ -428,7 +496,8 @@ __pmAccess(const char *path, int amode)
 /*
  * Open a PCP file with given mode and return a __pmFILE. An i/o
  * handler is automatically chosen based on filename suffix, e.g. .xz, .gz,
- * etc. The stdio pass-thru handler will be chosen for other files.
+ * etc. Other regular files opened read-only use the mmap handler, and
+ * the stdio pass-thru handler will be chosen for everything else.
  * The stdio handler is the only handler currently supporting write operations.
  * Return a valid __pmFILE pointer on success or NULL on failure.
  */
@@ -465,9 +534,19 @@ __pmFopen(const char *path, const char *mode)
 	    fputc('\n', stderr);
 	}
     }
-    if (compress_ix >= 0) {
+    if (compress_ix >= 0 && mode[0] == 'w' && mode[1] == '\0' &&
+	compress_ctl[compress_ix].whandler != NULL &&
+	strcmp(path, tmpname) == 0) {
+	/*
+	 * Creating a compressed file, and the compression suffix was
+	 * given explicitly (not found by index_compress() because an
+	 * uncompressed file of the given name is missing).
+	 */
+	handler = compress_ctl[compress_ix].whandler;
+    }
+    else if (compress_ix >= 0) {
 	if (mode[0] != 'r' || mode[1] != '\0') {
-	    /* We don't (yet) support opening compressed files for writing. */
+	    /* Otherwise compressed files cannot be opened for writing. */
 	    return NULL;
 	}
 
@@ -486,6 +565,30 @@ __pmFopen(const char *path, const char *mode)
  	/* Fall through and use the default handler. */
     }
 
+    /* Now allocate and open the __pmFile. */
+    if ((f = (__pmFILE *)malloc(sizeof(__pmFILE))) == NULL)
+    	return NULL;
+
+    memset(f, 0, sizeof(__pmFILE));
+
+#if !defined(IS_MINGW)
+    if (handler == NULL && mode[0] == 'r' && mode[1] == '\0' &&
+	mmap_enabled()) {
+	/*
+	 * Not compressed and read-only, try the mmap handler and
+	 * fall back to stdio if the file cannot be mapped, e.g. it
+	 * is not a regular file.
+	 */
+	f->fops = &__pm_mmap;
+	if (f->fops->__pmopen(f, path, mode) != NULL) {
+	    if (pmDebugOptions.log && pmDebugOptions.desperate)
+		fprintf(stderr, "__pmFopen(\"%s\", \"%s\"): mmap\n", path, mode);
+	    goto done;
+	}
+	memset(f, 0, sizeof(__pmFILE));
+    }
+#endif
+
     if (handler == NULL) {
 	/*
 	 * The file is either not compressed, or we can not decompress it
@@ -493,12 +596,6 @@ __pmFopen(const char *path, const char *mode)
 	 */
 	handler = &__pm_stdio;
     }
-
-    /* Now allocate and open the __pmFile. */
-    if ((f = (__pmFILE *)malloc(sizeof(__pmFILE))) == NULL)
-    	return NULL;
-
-    memset(f, 0, sizeof(__pmFILE));
     f->fops = handler;
 
     /*
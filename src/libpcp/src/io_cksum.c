@@ -0,0 +1,385 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ * 
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ * 
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ */
+
+/*
+ * Block checksums for archive data volumes as they are written.
+ *
+ * __pmFchecksum() stacks this handler on top of whichever handler
+ * __pmFopen() chose for a new data volume, and as bytes are appended
+ * to the volume a CRC-32 of each block of the (uncompressed) byte
+ * stream is written to a checksum file alongside it, one line per
+ * block, i.e.
+ *
+ *	PCP checksum crc32 <blocksize>
+ *	<offset> <length> <crc>
+ *	...
+ *
+ * with the final, partial, block added when the volume is closed.
+ * Data volumes are only ever appended to, but should a write land
+ * anywhere other than at the end of the volume the checksum file is
+ * ended with a "#" comment line and no further blocks are recorded.
+ * pmlogcheck(1) uses the checksum file to verify a volume with a
+ * streaming pass over the bytes rather than by decoding records.
+ */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <inttypes.h>
+#include "pmapi.h"
+#include "libpcp.h"
+#include "internal.h"
+
+static const __uint32_t crctab[256] = {
+    0x00000000, 0x77073096, 0xee0e612c, 0x990951ba,
+    0x076dc419, 0x706af48f, 0xe963a535, 0x9e6495a3,
+    0x0edb8832, 0x79dcb8a4, 0xe0d5e91e, 0x97d2d988,
+    0x09b64c2b, 0x7eb17cbd, 0xe7b82d07, 0x90bf1d91,
+    0x1db71064, 0x6ab020f2, 0xf3b97148, 0x84be41de,
+    0x1adad47d, 0x6ddde4eb, 0xf4d4b551, 0x83d385c7,
+    0x136c9856, 0x646ba8c0, 0xfd62f97a, 0x8a65c9ec,
+    0x14015c4f, 0x63066cd9, 0xfa0f3d63, 0x8d080df5,
+    0x3b6e20c8, 0x4c69105e, 0xd56041e4, 0xa2677172,
+    0x3c03e4d1, 0x4b04d447, 0xd20d85fd, 0xa50ab56b,
+    0x35b5a8fa, 0x42b2986c, 0xdbbbc9d6, 0xacbcf940,
+    0x32d86ce3, 0x45df5c75, 0xdcd60dcf, 0xabd13d59,
+    0x26d930ac, 0x51de003a, 0xc8d75180, 0xbfd06116,
+    0x21b4f4b5, 0x56b3c423, 0xcfba9599, 0xb8bda50f,
+    0x2802b89e, 0x5f058808, 0xc60cd9b2, 0xb10be924,
+    0x2f6f7c87, 0x58684c11, 0xc1611dab, 0xb6662d3d,
+    0x76dc4190, 0x01db7106, 0x98d220bc, 0xefd5102a,
+    0x71b18589, 0x06b6b51f, 0x9fbfe4a5, 0xe8b8d433,
+    0x7807c9a2, 0x0f00f934, 0x9609a88e, 0xe10e9818,
+    0x7f6a0dbb, 0x086d3d2d, 0x91646c97, 0xe6635c01,
+    0x6b6b51f4, 0x1c6c6162, 0x856530d8, 0xf262004e,
+    0x6c0695ed, 0x1b01a57b, 0x8208f4c1, 0xf50fc457,
+    0x65b0d9c6, 0x12b7e950, 0x8bbeb8ea, 0xfcb9887c,
+    0x62dd1ddf, 0x15da2d49, 0x8cd37cf3, 0xfbd44c65,
+    0x4db26158, 0x3ab551ce, 0xa3bc0074, 0xd4bb30e2,
+    0x4adfa541, 0x3dd895d7, 0xa4d1c46d, 0xd3d6f4fb,
+    0x4369e96a, 0x346ed9fc, 0xad678846, 0xda60b8d0,
+    0x44042d73, 0x33031de5, 0xaa0a4c5f, 0xdd0d7cc9,
+    0x5005713c, 0x270241aa, 0xbe0b1010, 0xc90c2086,
+    0x5768b525, 0x206f85b3, 0xb966d409, 0xce61e49f,
+    0x5edef90e, 0x29d9c998, 0xb0d09822, 0xc7d7a8b4,
+    0x59b33d17, 0x2eb40d81, 0xb7bd5c3b, 0xc0ba6cad,
+    0xedb88320, 0x9abfb3b6, 0x03b6e20c, 0x74b1d29a,
+    0xead54739, 0x9dd277af, 0x04db2615, 0x73dc1683,
+    0xe3630b12, 0x94643b84, 0x0d6d6a3e, 0x7a6a5aa8,
+    0xe40ecf0b, 0x9309ff9d, 0x0a00ae27, 0x7d079eb1,
+    0xf00f9344, 0x8708a3d2, 0x1e01f268, 0x6906c2fe,
+    0xf762575d, 0x806567cb, 0x196c3671, 0x6e6b06e7,
+    0xfed41b76, 0x89d32be0, 0x10da7a5a, 0x67dd4acc,
+    0xf9b9df6f, 0x8ebeeff9, 0x17b7be43, 0x60b08ed5,
+    0xd6d6a3e8, 0xa1d1937e, 0x38d8c2c4, 0x4fdff252,
+    0xd1bb67f1, 0xa6bc5767, 0x3fb506dd, 0x48b2364b,
+    0xd80d2bda, 0xaf0a1b4c, 0x36034af6, 0x41047a60,
+    0xdf60efc3, 0xa867df55, 0x316e8eef, 0x4669be79,
+    0xcb61b38c, 0xbc66831a, 0x256fd2a0, 0x5268e236,
+    0xcc0c7795, 0xbb0b4703, 0x220216b9, 0x5505262f,
+    0xc5ba3bbe, 0xb2bd0b28, 0x2bb45a92, 0x5cb36a04,
+    0xc2d7ffa7, 0xb5d0cf31, 0x2cd99e8b, 0x5bdeae1d,
+    0x9b64c2b0, 0xec63f226, 0x756aa39c, 0x026d930a,
+    0x9c0906a9, 0xeb0e363f, 0x72076785, 0x05005713,
+    0x95bf4a82, 0xe2b87a14, 0x7bb12bae, 0x0cb61b38,
+    0x92d28e9b, 0xe5d5be0d, 0x7cdcefb7, 0x0bdbdf21,
+    0x86d3d2d4, 0xf1d4e242, 0x68ddb3f8, 0x1fda836e,
+    0x81be16cd, 0xf6b9265b, 0x6fb077e1, 0x18b74777,
+    0x88085ae6, 0xff0f6a70, 0x66063bca, 0x11010b5c,
+    0x8f659eff, 0xf862ae69, 0x616bffd3, 0x166ccf45,
+    0xa00ae278, 0xd70dd2ee, 0x4e048354, 0x3903b3c2,
+    0xa7672661, 0xd06016f7, 0x4969474d, 0x3e6e77db,
+    0xaed16a4a, 0xd9d65adc, 0x40df0b66, 0x37d83bf0,
+    0xa9bcae53, 0xdebb9ec5, 0x47b2cf7f, 0x30b5ffe9,
+    0xbdbdf21c, 0xcabac28a, 0x53b39330, 0x24b4a3a6,
+    0xbad03605, 0xcdd70693, 0x54de5729, 0x23d967bf,
+    0xb3667a2e, 0xc4614ab8, 0x5d681b02, 0x2a6f2b94,
+    0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d
+};
+
+/*
+ * CRC-32 (as for zlib, gzip, etc) of len bytes at buf, continuing
+ * from crc, which is 0 at the start.
+ */
+__uint32_t
+__pmCRC32(__uint32_t crc, const void *buf, size_t len)
+{
+    const unsigned char	*p = (const unsigned char *)buf;
+
+    crc = crc ^ 0xffffffff;
+    while (len-- > 0)
+	crc = crctab[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    return crc ^ 0xffffffff;
+}
+
+typedef struct {
+    __pmFILE	inner;		/* the wrapped handler, fops and priv */
+    FILE	*sumfp;		/* checksum file, NULL once ended */
+    size_t	blocksize;
+    off_t	start;		/* offset of the current block */
+    off_t	end;		/* offset of the end of checksummed bytes */
+    __uint32_t	crc;		/* of bytes from start to end */
+} cksum_t;
+
+static void
+cksum_block(cksum_t *cp)
+{
+    if (cp->end > cp->start) {
+	fprintf(cp->sumfp, "%lld %lld %08x\n",
+		(long long)cp->start, (long long)(cp->end - cp->start),
+		cp->crc);
+	fflush(cp->sumfp);
+    }
+    cp->start = cp->end;
+    cp->crc = 0;
+}
+
+static void
+cksum_update(cksum_t *cp, const char *p, size_t len)
+{
+    size_t	n;
+
+    while (len > 0) {
+	n = cp->blocksize - (size_t)(cp->end - cp->start);
+	if (n > len)
+	    n = len;
+	cp->crc = __pmCRC32(cp->crc, p, n);
+	cp->end += n;
+	p += n;
+	len -= n;
+	if (cp->end - cp->start == cp->blocksize)
+	    cksum_block(cp);
+    }
+}
+
+static void
+cksum_end(cksum_t *cp, off_t offset)
+{
+    cksum_block(cp);
+    if (offset >= 0)
+	fprintf(cp->sumfp, "# write at offset %lld, checksums end\n",
+		(long long)offset);
+    fclose(cp->sumfp);
+    cp->sumfp = NULL;
+}
+
+static void *
+cksum_open(__pmFILE *f, const char *path, const char *mode)
+{
+    /* only ever stacked on an open file by __pmFchecksum() */
+    return NULL;
+}
+
+static void *
+cksum_fdopen(__pmFILE *f, int fd, const char *mode)
+{
+    return NULL;
+}
+
+static int
+cksum_seek(__pmFILE *f, off_t offset, int whence)
+{
+    cksum_t	*cp = (cksum_t *)f->priv;
+    int		sts = cp->inner.fops->__pmseek(&cp->inner, offset, whence);
+
+    f->position = cp->inner.position;
+    return sts;
+}
+
+static void
+cksum_rewind(__pmFILE *f)
+{
+    cksum_t	*cp = (cksum_t *)f->priv;
+
+    cp->inner.fops->__pmrewind(&cp->inner);
+    f->position = cp->inner.position;
+}
+
+static off_t
+cksum_tell(__pmFILE *f)
+{
+    cksum_t	*cp = (cksum_t *)f->priv;
+    return cp->inner.fops->__pmtell(&cp->inner);
+}
+
+static int
+cksum_getc(__pmFILE *f)
+{
+    cksum_t	*cp = (cksum_t *)f->priv;
+    int		c = cp->inner.fops->__pmfgetc(&cp->inner);
+
+    f->position = cp->inner.position;
+    return c;
+}
+
+static size_t
+cksum_read(void *ptr, size_t size, size_t nmemb, __pmFILE *f)
+{
+    cksum_t	*cp = (cksum_t *)f->priv;
+    size_t	n = cp->inner.fops->__pmread(ptr, size, nmemb, &cp->inner);
+
+    f->position = cp->inner.position;
+    return n;
+}
+
+static size_t
+cksum_write(void *ptr, size_t size, size_t nmemb, __pmFILE *f)
+{
+    cksum_t	*cp = (cksum_t *)f->priv;
+    off_t	offset = cp->inner.fops->__pmtell(&cp->inner);
+    size_t	n = cp->inner.fops->__pmwrite(ptr, size, nmemb, &cp->inner);
+
+    f->position = cp->inner.position;
+    if (cp->sumfp != NULL) {
+	if (offset != cp->end)
+	    cksum_end(cp, offset);
+	else
+	    cksum_update(cp, (const char *)ptr, n * size);
+    }
+    return n;
+}
+
+static int
+cksum_flush(__pmFILE *f)
+{
+    cksum_t	*cp = (cksum_t *)f->priv;
+    return cp->inner.fops->__pmflush(&cp->inner);
+}
+
+static int
+cksum_fsync(__pmFILE *f)
+{
+    cksum_t	*cp = (cksum_t *)f->priv;
+
+    if (cp->sumfp != NULL)
+	fsync(fileno(cp->sumfp));
+    return cp->inner.fops->__pmfsync(&cp->inner);
+}
+
+static int
+cksum_fileno(__pmFILE *f)
+{
+    cksum_t	*cp = (cksum_t *)f->priv;
+    return cp->inner.fops->__pmfileno(&cp->inner);
+}
+
+static off_t
+cksum_lseek(__pmFILE *f, off_t offset, int whence)
+{
+    cksum_t	*cp = (cksum_t *)f->priv;
+    return cp->inner.fops->__pmlseek(&cp->inner, offset, whence);
+}
+
+static int
+cksum_fstat(__pmFILE *f, struct stat *buf)
+{
+    cksum_t	*cp = (cksum_t *)f->priv;
+    return cp->inner.fops->__pmfstat(&cp->inner, buf);
+}
+
+static int
+cksum_feof(__pmFILE *f)
+{
+    cksum_t	*cp = (cksum_t *)f->priv;
+    return cp->inner.fops->__pmfeof(&cp->inner);
+}
+
+static int
+cksum_ferror(__pmFILE *f)
+{
+    cksum_t	*cp = (cksum_t *)f->priv;
+    return cp->inner.fops->__pmferror(&cp->inner);
+}
+
+static void
+cksum_clearerr(__pmFILE *f)
+{
+    cksum_t	*cp = (cksum_t *)f->priv;
+    cp->inner.fops->__pmclearerr(&cp->inner);
+}
+
+static int
+cksum_setvbuf(__pmFILE *f, char *buf, int mode, size_t size)
+{
+    cksum_t	*cp = (cksum_t *)f->priv;
+    return cp->inner.fops->__pmsetvbuf(&cp->inner, buf, mode, size);
+}
+
+static int
+cksum_close(__pmFILE *f)
+{
+    cksum_t	*cp = (cksum_t *)f->priv;
+    int		sts;
+
+    if (cp->sumfp != NULL)
+	cksum_end(cp, -1);
+    sts = cp->inner.fops->__pmclose(&cp->inner);
+    free(cp);
+    return sts;
+}
+
+static __pm_fops __pm_cksum = {
+    /*
+     * cksum - block checksums for another handler's writes
+     */
+    .__pmopen = cksum_open,
+    .__pmfdopen = cksum_fdopen,
+    .__pmseek = cksum_seek,
+    .__pmrewind = cksum_rewind,
+    .__pmtell = cksum_tell,
+    .__pmfgetc = cksum_getc,
+    .__pmread = cksum_read,
+    .__pmwrite = cksum_write,
+    .__pmflush = cksum_flush,
+    .__pmfsync = cksum_fsync,
+    .__pmfileno = cksum_fileno,
+    .__pmlseek = cksum_lseek,
+    .__pmfstat = cksum_fstat,
+    .__pmfeof = cksum_feof,
+    .__pmferror = cksum_ferror,
+    .__pmclearerr = cksum_clearerr,
+    .__pmsetvbuf = cksum_setvbuf,
+    .__pmclose = cksum_close
+};
+
+/*
+ * Start checksumming blocks of blocksize bytes for all subsequent
+ * writes to f, which must be a newly created file, into the checksum
+ * file sumpath.  Returns 0, or -oserror() if sumpath cannot be
+ * created, in which case f is unchanged.
+ */
+int
+__pmFchecksum(__pmFILE *f, const char *sumpath, size_t blocksize)
+{
+    cksum_t	*cp;
+    FILE	*sumfp;
+    int		sts;
+
+    if (blocksize == 0)
+	return -EINVAL;
+    if ((cp = (cksum_t *)calloc(1, sizeof(cksum_t))) == NULL)
+	return -oserror();
+    if ((sumfp = fopen(sumpath, "w")) == NULL) {
+	sts = -oserror();
+	free(cp);
+	return sts;
+    }
+    fprintf(sumfp, "PCP checksum crc32 %zu\n", blocksize);
+    cp->inner = *f;	/* struct assignment */
+    cp->sumfp = sumfp;
+    cp->blocksize = blocksize;
+    cp->start = cp->end = cp->inner.fops->__pmtell(&cp->inner);
+    f->fops = &__pm_cksum;
+    f->priv = (void *)cp;
+    return 0;
+}
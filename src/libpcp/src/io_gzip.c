@@ -0,0 +1,848 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * Transparent gzip decompression, using zlib.
+ *
+ * Unlike xz, the gzip format has no index of independently decodable
+ * blocks, so when the file is opened one decompression pass builds an
+ * index of access points (in the style of examples/zran.c from the
+ * zlib sources).  An access point is recorded at a deflate block
+ * boundary about every GZ_SPAN bytes of uncompressed data, along with
+ * the 32K window of uncompressed data that precedes it, and at the
+ * start of every gzip member in a multi-member file (e.g. from pigz or
+ * concatenated files) where no window is needed.
+ *
+ * The uncompressed data between consecutive access points is treated
+ * as a block, and the most recently used blocks are cached, as for
+ * io_xz.c.  So __pmFseek() to any offset costs at most one block of
+ * decompression, rather than decompressing from the start of the file.
+ *
+ * Files may also be created ("w" mode), e.g. pmlogger data volumes.
+ * Writes are append-only, but seeks are allowed (and only change the
+ * __pmFtell() offset) because pmlogger seeks back to an earlier
+ * record to report its offset in the temporal index.  A __pmFflush()
+ * at the end of the file ends the current gzip member, so the next
+ * write starts a new member, which is an access point for readers
+ * that needs no window.  A __pmFflush() while seeked back (as done by
+ * __pmLogPutIndex()) leaves the member open.
+ */
+#include "config.h"
+#if HAVE_ZLIB_DECOMPRESSION
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <zlib.h>
+#include "pmapi.h"
+#include "libpcp.h"
+
+#ifndef PCP_GZ_CACHE_BLOCKS
+#define PCP_GZ_CACHE_BLOCKS 4 /* 4 blocks in the cache, as for xz */
+#endif
+
+#define GZ_SPAN		(1024*1024)	/* uncompressed bytes between points */
+#define GZ_WINSIZE	32768		/* deflate window */
+#define GZ_CHUNK	16384		/* compressed input buffer */
+
+#define GZ_HEADER_MAGIC     "\x1f\x8b"
+#define GZ_HEADER_MAGIC_LEN 2
+
+/* An access point, where decompression can start */
+typedef struct gzpoint {
+    off_t out;			/* offset in uncompressed data */
+    off_t in;			/* offset in compressed file */
+    int bits;			/* bits (1-7) from byte at in-1, or 0 */
+    int member;			/* 1 => start of a gzip member, no window */
+    unsigned char *window;	/* uncompressed data before out */
+} gzpoint;
+
+/* A buffer of uncompressed data between two access points */
+typedef struct gzblock {
+    off_t start;
+    size_t size;
+    char *data;
+} gzblock;
+
+/* The file handle */
+typedef struct gzfile {
+    FILE *f;
+    int fd;
+    int npoints;
+    gzpoint *points;
+    off_t uncompressed_offset;
+    off_t uncompressed_size;
+    int eof;
+    int err;
+    gzblock cache[PCP_GZ_CACHE_BLOCKS];	/* most recently used first */
+    int writing;		/* 1 => opened for writing */
+    int member;			/* (writing) 1 => a gzip member is open */
+    int deflating;		/* (writing) 1 => strm is initialized */
+    z_stream strm;		/* (writing) deflate state */
+} gzfile;
+
+static void
+gz_debug(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (pmDebugOptions.compress) {
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	fputc('\n', stderr);
+	va_end(ap);
+    }
+}
+
+static void
+free_points(gzfile *gz)
+{
+    int i;
+
+    for (i = 0; i < gz->npoints; i++)
+	free(gz->points[i].window);
+    free(gz->points);
+    gz->points = NULL;
+    gz->npoints = 0;
+}
+
+/*
+ * Append an access point.  For points within a gzip member, window[]
+ * is the circular output buffer and left is the space remaining in it,
+ * so there are left bytes of older data at the end, followed by the
+ * newer data from the start of window[].
+ */
+static int
+add_point(gzfile *gz, int member, int bits, off_t in, off_t out,
+	unsigned left, const unsigned char *window)
+{
+    gzpoint *tmp;
+    gzpoint *pt;
+
+    if ((gz->npoints % 32) == 0) {
+	tmp = realloc(gz->points, (gz->npoints + 32) * sizeof(gzpoint));
+	if (tmp == NULL) {
+	    gz_debug("%s(%d, ...): realloc: %m", __func__, gz->fd);
+	    return -1;
+	}
+	gz->points = tmp;
+    }
+    pt = &gz->points[gz->npoints];
+    pt->out = out;
+    pt->in = in;
+    pt->bits = bits;
+    pt->member = member;
+    pt->window = NULL;
+    if (!member) {
+	if ((pt->window = malloc(GZ_WINSIZE)) == NULL) {
+	    gz_debug("%s(%d, ...): malloc: %m", __func__, gz->fd);
+	    return -1;
+	}
+	if (left)
+	    memcpy(pt->window, window + GZ_WINSIZE - left, left);
+	if (left < GZ_WINSIZE)
+	    memcpy(pt->window + left, window, GZ_WINSIZE - left);
+    }
+    gz->npoints++;
+    return 0;
+}
+
+/*
+ * Decompress the whole file once, recording access points and the
+ * uncompressed size.
+ */
+static int
+build_index(gzfile *gz)
+{
+    z_stream strm;
+    unsigned char input[GZ_CHUNK];
+    unsigned char window[GZ_WINSIZE];
+    off_t totin = 0, totout = 0, last = 0;
+    off_t complete = 0;		/* end of the last complete member */
+    int ret;
+    int done = 0;
+
+    memset(&strm, 0, sizeof(strm));
+    if (inflateInit2(&strm, 15 + 16) != Z_OK) {	/* gzip format */
+	gz_debug("%s(%d, ...): inflateInit2: %s", __func__, gz->fd, strm.msg);
+	return -1;
+    }
+    if (add_point(gz, 1, 0, 0, 0, 0, NULL) < 0)
+	goto fail;
+
+    strm.avail_out = 0;
+    while (!done) {
+	strm.avail_in = fread(input, 1, GZ_CHUNK, gz->f);
+	if (ferror(gz->f)) {
+	    gz_debug("%s(%d, ...): fread: %m", __func__, gz->fd);
+	    goto fail;
+	}
+	if (strm.avail_in == 0) {
+	    if (complete == 0) {
+		gz_debug("%s(%d, ...): truncated gzip file", __func__, gz->fd);
+		goto fail;
+	    }
+	    /*
+	     * The last member is incomplete, e.g. the file is still
+	     * being written, so use the data up to the end of the
+	     * last complete member.
+	     */
+	    gz_debug("%s(%d, ...): incomplete last member at %lld bytes uncompressed",
+		    __func__, gz->fd, (long long)complete);
+	    while (gz->npoints > 1 && gz->points[gz->npoints-1].out >= complete) {
+		free(gz->points[gz->npoints-1].window);
+		gz->npoints--;
+	    }
+	    totout = complete;
+	    break;
+	}
+	strm.next_in = input;
+
+	do {
+	    if (strm.avail_out == 0) {
+		strm.avail_out = GZ_WINSIZE;
+		strm.next_out = window;
+	    }
+	    totin += strm.avail_in;
+	    totout += strm.avail_out;
+	    ret = inflate(&strm, Z_BLOCK);
+	    totin -= strm.avail_in;
+	    totout -= strm.avail_out;
+	    if (ret == Z_NEED_DICT || ret == Z_DATA_ERROR || ret == Z_MEM_ERROR) {
+		gz_debug("%s(%d, ...): inflate: %s", __func__, gz->fd,
+			strm.msg ? strm.msg : "error");
+		goto fail;
+	    }
+	    if (ret == Z_STREAM_END) {
+		/*
+		 * End of a gzip member ... another may follow, and if
+		 * so its start is an access point needing no window.
+		 */
+		int c;
+
+		complete = totout;
+		if (strm.avail_in == 0) {
+		    if ((c = getc(gz->f)) != EOF)
+			ungetc(c, gz->f);
+		}
+		else
+		    c = strm.next_in[0];
+		if (c != (unsigned char)GZ_HEADER_MAGIC[0]) {
+		    /* end of file, or trailing garbage ignored as for gzip(1) */
+		    done = 1;
+		    break;
+		}
+		inflateReset(&strm);
+		if (add_point(gz, 1, 0, totin, totout, 0, NULL) < 0)
+		    goto fail;
+		last = totout;
+		continue;
+	    }
+	    /* at the end of a deflate block, but not the last one? */
+	    if ((strm.data_type & 128) && !(strm.data_type & 64) &&
+		totout - last > GZ_SPAN) {
+		if (add_point(gz, 0, strm.data_type & 7, totin, totout,
+				strm.avail_out, window) < 0)
+		    goto fail;
+		last = totout;
+	    }
+	} while (strm.avail_in != 0);
+    }
+
+    inflateEnd(&strm);
+    gz->uncompressed_size = totout;
+    gz_debug("%s(%d, ...): %lld bytes uncompressed, %d access points",
+		__func__, gz->fd, (long long)totout, gz->npoints);
+    return 0;
+
+ fail:
+    inflateEnd(&strm);
+    free_points(gz);
+    setoserror(-PM_ERR_LOGREC);
+    return -1;
+}
+
+/*
+ * Decompress the block starting at access point i.
+ */
+static char *
+read_block(gzfile *gz, int i, size_t *size_rtn)
+{
+    gzpoint *pt = &gz->points[i];
+    z_stream strm;
+    unsigned char input[GZ_CHUNK];
+    off_t end;
+    size_t size;
+    char *data;
+    int ret;
+    int c;
+
+    end = i + 1 < gz->npoints ? gz->points[i+1].out : gz->uncompressed_size;
+    size = (size_t)(end - pt->out);
+    *size_rtn = size;
+
+    gz_debug("%s(%d, ...): point %d at file offset %lld (%zd bytes)",
+		__func__, gz->fd, i, (long long)pt->in, size);
+
+    if ((data = malloc(size ? size : 1)) == NULL) {
+	gz_debug("%s(%d, ...): malloc(%zd bytes): %m", __func__, gz->fd, size);
+	return NULL;
+    }
+
+    memset(&strm, 0, sizeof(strm));
+    if (inflateInit2(&strm, pt->member ? 15 + 16 : -15) != Z_OK) {
+	gz_debug("%s(%d, ...): inflateInit2: %s", __func__, gz->fd, strm.msg);
+	free(data);
+	return NULL;
+    }
+    if (fseeko(gz->f, pt->in - (pt->bits ? 1 : 0), SEEK_SET) < 0) {
+	gz_debug("%s(%d, ...): fseek: %m", __func__, gz->fd);
+	goto fail;
+    }
+    if (pt->bits) {
+	if ((c = getc(gz->f)) == EOF)
+	    goto fail;
+	inflatePrime(&strm, pt->bits, c >> (8 - pt->bits));
+    }
+    if (!pt->member)
+	inflateSetDictionary(&strm, pt->window, GZ_WINSIZE);
+
+    strm.next_out = (unsigned char *)data;
+    strm.avail_out = size;
+    while (strm.avail_out != 0) {
+	strm.avail_in = fread(input, 1, GZ_CHUNK, gz->f);
+	if (ferror(gz->f)) {
+	    gz_debug("%s(%d, ...): fread: %m", __func__, gz->fd);
+	    goto fail;
+	}
+	if (strm.avail_in == 0) {
+	    gz_debug("%s(%d, ...): unexpected end of file", __func__, gz->fd);
+	    goto fail;
+	}
+	strm.next_in = input;
+	ret = inflate(&strm, Z_NO_FLUSH);
+	if (ret == Z_STREAM_END)
+	    break;
+	if (ret != Z_OK && ret != Z_BUF_ERROR) {
+	    gz_debug("%s(%d, ...): inflate: %s", __func__, gz->fd,
+			strm.msg ? strm.msg : "error");
+	    goto fail;
+	}
+    }
+    if (strm.avail_out != 0) {
+	gz_debug("%s(%d, ...): short block, %u bytes missing",
+		__func__, gz->fd, strm.avail_out);
+	goto fail;
+    }
+
+    inflateEnd(&strm);
+    return data;
+
+ fail:
+    inflateEnd(&strm);
+    free(data);
+    return NULL;
+}
+
+/*
+ * Find the block containing the current uncompressed offset, from
+ * the cache if possible, else by decompressing it into the least
+ * recently used slot.  Returns NULL at end of file or on error.
+ */
+static gzblock *
+reposition(gzfile *gz)
+{
+    gzblock used;
+    gzblock *blk;
+    off_t offset = gz->uncompressed_offset;
+    size_t size;
+    char *data;
+    int lo, hi, mid;
+    int slot;
+
+    if (gz->writing) {
+	setoserror(EBADF);
+	gz->err = 1;
+	return NULL;
+    }
+    if (offset >= gz->uncompressed_size) {
+	gz->eof = 1;
+	return NULL;
+    }
+
+    for (slot = 0; slot < PCP_GZ_CACHE_BLOCKS; slot++) {
+	blk = &gz->cache[slot];
+	if (blk->data == NULL)
+	    break; /* end of cache */
+	if (offset >= blk->start && offset < blk->start + (off_t)blk->size)
+	    goto found;
+    }
+    if (slot >= PCP_GZ_CACHE_BLOCKS)
+	slot = PCP_GZ_CACHE_BLOCKS - 1;
+
+    /* binary search for the last access point at or before offset */
+    lo = 0;
+    hi = gz->npoints - 1;
+    while (lo < hi) {
+	mid = (lo + hi + 1) / 2;
+	if (gz->points[mid].out <= offset)
+	    lo = mid;
+	else
+	    hi = mid - 1;
+    }
+    if ((data = read_block(gz, lo, &size)) == NULL) {
+	gz->err = 1;
+	return NULL;
+    }
+    blk = &gz->cache[slot];
+    free(blk->data);
+    blk->data = data;
+    blk->start = gz->points[lo].out;
+    blk->size = size;
+
+ found:
+    /* mark this block as most recently used */
+    if (slot > 0) {
+	used = gz->cache[slot];
+	memmove(&gz->cache[1], &gz->cache[0], slot * sizeof(gzblock));
+	gz->cache[0] = used;
+    }
+    return &gz->cache[0];
+}
+
+static int
+gz_feof(__pmFILE *f)
+{
+    gzfile *gz = f->priv;
+    return gz->eof;
+}
+
+static int
+gz_ferror(__pmFILE *f)
+{
+    gzfile *gz = f->priv;
+    return gz->err;
+}
+
+static void
+gz_clearerr(__pmFILE *f)
+{
+    gzfile *gz = f->priv;
+    gz->eof = gz->err = 0;
+}
+
+static int
+check_header_magic(FILE *f)
+{
+    char buf[GZ_HEADER_MAGIC_LEN];
+
+    if (fseek(f, 0, SEEK_SET) == -1)
+	return 1; /* error */
+    if (fread(buf, 1, sizeof(buf), f) != sizeof(buf) ||
+	memcmp(buf, GZ_HEADER_MAGIC, sizeof(buf)) != 0) {
+	setoserror(-PM_ERR_LOGREC);
+	return 1; /* error */
+    }
+    return fseek(f, 0, SEEK_SET) == -1;
+}
+
+static int
+init(gzfile *gz, const char *mode)
+{
+    memset(gz->cache, 0, sizeof(gz->cache));
+    gz->points = NULL;
+    gz->npoints = 0;
+    gz->uncompressed_offset = 0;
+    gz->uncompressed_size = 0;
+    gz->eof = gz->err = 0;
+    gz->writing = gz->member = gz->deflating = 0;
+
+    if (mode[0] == 'w') {
+	gz->writing = 1;
+	return 0; /* ok, nothing more until the first write */
+    }
+    if (check_header_magic(gz->f))
+	return 1; /* error */
+    if (build_index(gz) < 0)
+	return 1; /* error */
+    return 0; /* ok */
+}
+
+static void *
+gz_open(__pmFILE *f, const char *path, const char *mode)
+{
+    gzfile *gz;
+
+    if ((gz = malloc(sizeof(*gz))) == NULL) {
+	pmNoMem("gz_open", sizeof(*gz), PM_FATAL_ERR);
+	return NULL;
+    }
+
+    /* Open the file. */
+    if ((gz->f = fopen(path, mode)) == NULL) {
+	gz_debug("%s(..., %s, ...): fopen: %m", __func__, path);
+	goto err;
+    }
+    gz->fd = fileno(gz->f);
+    gz_debug("%s(..., %s, ...): fd=%d", __func__, path, gz->fd);
+
+    if (init(gz, mode) == 0) {
+	f->priv = gz;
+	return gz;
+    }
+
+    fclose(gz->f);
+ err:
+    free(gz);
+    return NULL;
+}
+
+static void *
+gz_fdopen(__pmFILE *f, int fd, const char *mode)
+{
+    gzfile *gz;
+
+    if ((gz = malloc(sizeof(*gz))) == NULL) {
+	pmNoMem("gz_fdopen", sizeof(*gz), PM_FATAL_ERR);
+	return NULL;
+    }
+
+    /* Open the file. */
+    if ((gz->f = fdopen(fd, mode)) == NULL)
+	goto err;
+    gz->fd = fd;
+
+    if (init(gz, mode) == 0) {
+	f->priv = gz;
+	return gz;
+    }
+
+    fclose(gz->f);
+ err:
+    free(gz);
+    return NULL;
+}
+
+static int
+gz_seek(__pmFILE *f, off_t offset, int whence)
+{
+    gzfile *gz = (gzfile *)f->priv;
+    off_t new_offset;
+
+    switch (whence) {
+    case SEEK_SET:
+	new_offset = offset;
+	break;
+    case SEEK_CUR:
+	new_offset = gz->uncompressed_offset + offset;
+	break;
+    case SEEK_END:
+	new_offset = gz->uncompressed_size + offset;
+	break;
+    default:
+	errno = EINVAL;
+	return -1;
+    }
+
+    if (new_offset < 0) {
+	errno = EINVAL;
+	return -1;
+    }
+
+    /* Don't actually seek to the requested offset now. Just record it. */
+    gz->uncompressed_offset = new_offset;
+    gz->eof = 0;
+    return 0;
+}
+
+static off_t
+gz_lseek(__pmFILE *f, off_t offset, int whence)
+{
+    gzfile *gz = (gzfile *)f->priv;
+
+    if (gz_seek(f, offset, whence) < 0)
+	return -1;
+    return gz->uncompressed_offset;
+}
+
+static void
+gz_rewind(__pmFILE *f)
+{
+    gzfile *gz = (gzfile *)f->priv;
+
+    /* Don't actually seek to the requested offset now. Just record it. */
+    gz->uncompressed_offset = 0;
+
+    /* The function also requires that any error flag be reset. */
+    gz_clearerr(f);
+}
+
+static off_t
+gz_tell(__pmFILE *f)
+{
+    gzfile *gz = (gzfile *)f->priv;
+    return gz->uncompressed_offset;
+}
+
+static int
+gz_getc(__pmFILE *f)
+{
+    gzfile *gz = (gzfile *)f->priv;
+    gzblock *blk = reposition(gz);
+    int c;
+
+    if (blk == NULL)
+	return EOF;
+
+    c = *(unsigned char *)(blk->data + (gz->uncompressed_offset - blk->start));
+    ++gz->uncompressed_offset;
+    return c;
+}
+
+static size_t
+gz_read(void *ptr, size_t size, size_t nmemb, __pmFILE *f)
+{
+    gzfile *gz = (gzfile *)f->priv;
+    gzblock *blk;
+    size_t want, copied, n, off;
+
+    if (size == 0 || nmemb == 0)
+	return 0;
+    want = size * nmemb;
+
+    /*
+     * Copy data from the current block and possibly from subsequent
+     * blocks until we have copied the requested number of bytes.
+     */
+    copied = 0;
+    while (copied < want) {
+	if ((blk = reposition(gz)) == NULL)
+	    break; /* end of file or error */
+	off = (size_t)(gz->uncompressed_offset - blk->start);
+	n = want - copied;
+	if (n > blk->size - off)
+	    n = blk->size - off;
+	memcpy((char *)ptr + copied, blk->data + off, n);
+	copied += n;
+	gz->uncompressed_offset += n;
+    }
+
+    return copied / size;
+}
+
+/*
+ * Run deflate() over any pending input, writing the compressed output
+ * to the file.  With flush == Z_FINISH this ends the gzip member.
+ */
+static int
+deflate_out(gzfile *gz, int flush)
+{
+    unsigned char output[GZ_CHUNK];
+    size_t n;
+    int ret;
+
+    do {
+	gz->strm.next_out = output;
+	gz->strm.avail_out = GZ_CHUNK;
+	ret = deflate(&gz->strm, flush);
+	if (ret == Z_STREAM_ERROR) {
+	    gz_debug("%s(%d, ...): deflate: %s", __func__, gz->fd,
+			gz->strm.msg ? gz->strm.msg : "error");
+	    setoserror(EIO);
+	    return -1;
+	}
+	n = GZ_CHUNK - gz->strm.avail_out;
+	if (n > 0 && fwrite(output, 1, n, gz->f) != n) {
+	    gz_debug("%s(%d, ...): fwrite: %m", __func__, gz->fd);
+	    return -1;
+	}
+    } while (gz->strm.avail_out == 0);
+    return 0;
+}
+
+/*
+ * Finish the current gzip member (if any) and flush it to the file.
+ */
+static int
+end_member(gzfile *gz)
+{
+    if (!gz->member)
+	return 0;
+    gz->member = 0;
+    gz->strm.next_in = NULL;
+    gz->strm.avail_in = 0;
+    if (deflate_out(gz, Z_FINISH) < 0) {
+	gz->err = 1;
+	return -1;
+    }
+    gz_debug("%s(%d, ...): member ends at %lld bytes uncompressed",
+		__func__, gz->fd, (long long)gz->uncompressed_size);
+    return fflush(gz->f) == 0 ? 0 : -1;
+}
+
+static size_t
+gz_write(void *ptr, size_t size, size_t nmemb, __pmFILE *f)
+{
+    gzfile *gz = (gzfile *)f->priv;
+    size_t want;
+
+    if (!gz->writing) {
+	setoserror(EBADF);
+	gz->err = 1;
+	return 0;
+    }
+    if (size == 0 || nmemb == 0)
+	return 0;
+    if (gz->uncompressed_offset != gz->uncompressed_size) {
+	/* compressed data cannot be rewritten, only appended */
+	gz_debug("%s(%d, ...): write at %lld, not end of file (%lld)",
+		__func__, gz->fd, (long long)gz->uncompressed_offset,
+		(long long)gz->uncompressed_size);
+	setoserror(ESPIPE);
+	gz->err = 1;
+	return 0;
+    }
+    want = size * nmemb;
+
+    if (!gz->member) {
+	if (!gz->deflating) {
+	    memset(&gz->strm, 0, sizeof(gz->strm));
+	    if (deflateInit2(&gz->strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+			15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		gz_debug("%s(%d, ...): deflateInit2: %s", __func__, gz->fd,
+			gz->strm.msg ? gz->strm.msg : "error");
+		setoserror(ENOMEM);
+		gz->err = 1;
+		return 0;
+	    }
+	    gz->deflating = 1;
+	}
+	else
+	    deflateReset(&gz->strm);
+	gz->member = 1;
+    }
+
+    gz->strm.next_in = (unsigned char *)ptr;
+    gz->strm.avail_in = want;
+    if (deflate_out(gz, Z_NO_FLUSH) < 0) {
+	gz->err = 1;
+	return 0;
+    }
+    gz->uncompressed_size += want;
+    gz->uncompressed_offset = gz->uncompressed_size;
+    return nmemb;
+}
+
+static int
+gz_flush(__pmFILE *f)
+{
+    gzfile *gz = (gzfile *)f->priv;
+
+    if (!gz->writing)
+	return 0;
+    if (gz->uncompressed_offset != gz->uncompressed_size)
+	return 0;	/* seeked back, not the end of a member */
+    return end_member(gz) < 0 ? EOF : 0;
+}
+
+static int
+gz_fsync(__pmFILE *f)
+{
+    gzfile *gz = (gzfile *)f->priv;
+
+    if (gz_flush(f) != 0)
+	return -1;
+    return fsync(gz->fd);
+}
+
+static int
+gz_fileno(__pmFILE *f)
+{
+    gzfile *gz = f->priv;
+    return gz->fd;
+}
+
+static int
+gz_fstat(__pmFILE *f, struct stat *buf)
+{
+    gzfile *gz = f->priv;
+    int rc = fstat(gz->fd, buf);
+
+    /* What the caller really wants for st_size is the uncompressed size. */
+    if (rc != -1)
+	buf->st_size = gz->uncompressed_size;
+
+    return rc;
+}
+
+static int
+gz_setvbuf(__pmFILE *f, char *buf, int mode, size_t size)
+{
+    gzfile *gz = (gzfile *)f->priv;
+
+    /* output is buffered by deflate until the end of each member */
+    if (gz->writing)
+	return 0;
+    gz_debug("libpcp internal error: %s not implemented\n", __func__);
+    return -1;
+}
+
+static int
+gz_close(__pmFILE *f)
+{
+    gzfile *gz = f->priv;
+    int sts = 0;
+    int i;
+
+    if (gz->writing) {
+	if (end_member(gz) < 0)
+	    sts = EOF;
+	if (gz->deflating)
+	    deflateEnd(&gz->strm);
+    }
+    for (i = 0; i < PCP_GZ_CACHE_BLOCKS; i++)
+	free(gz->cache[i].data);
+    free_points(gz);
+    if (fclose(gz->f) != 0)
+	sts = EOF;
+    free(gz);
+    return sts;
+}
+
+__pm_fops __pm_gzip = {
+    /*
+     * gzip decompression, and compression for new files
+     */
+    .__pmopen = gz_open,
+    .__pmfdopen = gz_fdopen,
+    .__pmseek = gz_seek,
+    .__pmrewind = gz_rewind,
+    .__pmtell = gz_tell,
+    .__pmfgetc = gz_getc,
+    .__pmread = gz_read,
+    .__pmwrite = gz_write,
+    .__pmflush = gz_flush,
+    .__pmfsync = gz_fsync,
+    .__pmfileno = gz_fileno,
+    .__pmlseek = gz_lseek,
+    .__pmfstat = gz_fstat,
+    .__pmfeof = gz_feof,
+    .__pmferror = gz_ferror,
+    .__pmclearerr = gz_clearerr,
+    .__pmsetvbuf = gz_setvbuf,
+    .__pmclose = gz_close
+};
+#endif /* HAVE_ZLIB_DECOMPRESSION */
@@ -0,0 +1,500 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ * 
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ * 
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ */
+
+/*
+ * Space accounting for archive data volumes as they are written.
+ *
+ * __pmFlogsize() stacks this handler on top of whichever handler(s)
+ * __pmLogNewFile() chose for a new data volume.  Each record appended
+ * to the volume is parsed as it goes by, and when the volume is closed
+ * the bytes, records and values for each metric, attributed the same
+ * way as pmlogsize(1) does when it scans the volume, are written to
+ * a space accounting file alongside it, i.e.
+ *
+ *	PCP logsize 1
+ *	volume <size> <label> <bytes> <overhead> <nrec> <nmark> <nmetric>
+ *	<pmid> <bytes> <nrec> <nval>
+ *	...
+ *
+ * with one line per metric in the order the metrics were first seen.
+ * <size> is the (uncompressed) size of the volume, so the file can be
+ * recognized as stale.  If anything other than well-formed v2 or v3
+ * records is appended, or a write lands anywhere other than at the
+ * end of the volume, no accounting file is left behind.
+ */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "pmapi.h"
+#include "libpcp.h"
+#include "internal.h"
+
+typedef struct {
+    pmID	pmid;
+    int		slot;		/* index in metrics[] */
+    long long	bytes;
+    int		nrec;		/* records containing the metric */
+    int		nval;		/* total number of values */
+} logsize_metric_t;
+
+typedef struct {
+    __pmFILE		inner;		/* the wrapped handler, fops and priv */
+    char		*path;		/* accounting file, NULL once abandoned */
+    int			version;	/* from the label, 0 before it */
+    off_t		end;		/* offset of the end of parsed bytes */
+    char		*rec;		/* partial record from earlier writes */
+    size_t		have;		/* bytes in rec[] */
+    size_t		size;		/* space in rec[] */
+    long long		label;
+    long long		bytes;
+    long long		ohead;
+    int			nrec;
+    int			nmark;
+    int			nmetric;
+    logsize_metric_t	**metrics;	/* in order first seen */
+    int			next;		/* metrics[] slot likely to be next */
+    __pmHashCtl		hash;		/* pmid -> logsize_metric_t */
+} logsize_t;
+
+static void
+logsize_abandon(logsize_t *lp)
+{
+    if (lp->path != NULL) {
+	unlink(lp->path);
+	free(lp->path);
+	lp->path = NULL;
+    }
+}
+
+static logsize_metric_t *
+logsize_lookup(logsize_t *lp, pmID pmid)
+{
+    __pmHashNode	*hp;
+    logsize_metric_t	*mp;
+    logsize_metric_t	**tmp;
+
+    /* records from one logger mostly repeat the same pmids in order */
+    if (lp->next < lp->nmetric && lp->metrics[lp->next]->pmid == pmid)
+	return lp->metrics[lp->next++];
+    if ((hp = __pmHashSearch(pmid, &lp->hash)) != NULL) {
+	mp = (logsize_metric_t *)hp->data;
+	lp->next = mp->slot + 1;
+	return mp;
+    }
+    if ((mp = (logsize_metric_t *)calloc(1, sizeof(*mp))) == NULL)
+	return NULL;
+    tmp = (logsize_metric_t **)realloc(lp->metrics, (lp->nmetric+1) * sizeof(*tmp));
+    if (tmp == NULL || __pmHashAdd(pmid, mp, &lp->hash) < 0) {
+	if (tmp != NULL)
+	    lp->metrics = tmp;
+	free(mp);
+	return NULL;
+    }
+    mp->pmid = pmid;
+    mp->slot = lp->nmetric;
+    lp->metrics = tmp;
+    lp->metrics[lp->nmetric++] = mp;
+    lp->next = lp->nmetric;
+    return mp;
+}
+
+/*
+ * Account for one complete record of len bytes (including the header
+ * and trailer lengths), laid out as written by logputresult().
+ * Returns 0, or -1 if the record is not what we expect.
+ */
+static int
+logsize_record(logsize_t *lp, const __pmPDU *rec, size_t len)
+{
+    logsize_metric_t	*mp;
+    pmValueBlock	vb;
+    __uint32_t		hdr;
+    size_t		nwords = len / sizeof(__pmPDU);
+    size_t		p, v, off;
+    int			stamp, numpmid, numval, valfmt;
+    int			i, j;
+    long		vlen;
+
+    if (lp->version == 0) {
+	/* label record */
+	if (len < 2 * sizeof(__pmPDU) ||
+	    (ntohl(rec[1]) & 0xffffff00) != PM_LOG_MAGIC)
+	    return -1;
+	lp->version = ntohl(rec[1]) & 0xff;
+	if (lp->version != PM_LOG_VERS02 && lp->version != PM_LOG_VERS03)
+	    return -1;
+	lp->label = len;
+	lp->ohead = len;
+	return 0;
+    }
+
+    /* timestamp words, __pmTimestamp (sec[2], nsec) or pmTimeval */
+    stamp = lp->version >= PM_LOG_VERS03 ? 3 : 2;
+    if (nwords < 3 + stamp || (len % sizeof(__pmPDU)) != 0)
+	return -1;
+    lp->bytes += len - (2 + stamp + 1) * sizeof(__pmPDU);
+    lp->ohead += (2 + stamp + 1) * sizeof(__pmPDU);
+    numpmid = ntohl(rec[1 + stamp]);
+    if (numpmid == 0) {
+	lp->nmark++;
+	return 0;
+    }
+    lp->nrec++;
+
+    /* trailer is the last word, value blocks lie between the vsets and it */
+    nwords--;
+    p = 2 + stamp;
+    for (i = 0; i < numpmid; i++) {
+	if (p + 2 > nwords || (mp = logsize_lookup(lp, __ntohpmID(rec[p]))) == NULL)
+	    return -1;
+	numval = ntohl(rec[p + 1]);
+	mp->nrec++;
+	if (numval <= 0) {
+	    mp->bytes += 2 * sizeof(__pmPDU);
+	    p += 2;
+	    continue;
+	}
+	if (p + 3 + 2 * (size_t)numval > nwords)
+	    return -1;
+	valfmt = ntohl(rec[p + 2]);
+	mp->bytes += 3 * sizeof(__pmPDU) + numval * sizeof(__pmValue_PDU);
+	mp->nval += numval;
+	if (valfmt != PM_VAL_INSITU) {
+	    for (j = 0; j < numval; j++) {
+		/* offset is in __pmPDU units from the start of the PDU */
+		v = p + 3 + 2 * j + 1;
+		off = ntohl(rec[v]);
+		if (off < 2 || off - 2 >= nwords)
+		    return -1;
+		hdr = ntohl(rec[off - 2]);
+		memcpy(&vb, &hdr, sizeof(hdr));
+		vlen = vb.vlen;
+		if (vlen < PM_VAL_HDR_SIZE)
+		    return -1;
+		mp->bytes += PM_PDU_SIZE_BYTES(vlen);
+	    }
+	}
+	p += 3 + 2 * numval;
+    }
+    return 0;
+}
+
+/*
+ * Parse len bytes appended to the volume, which need not be aligned
+ * with records, although with unbuffered writes they usually are.
+ */
+static void
+logsize_update(logsize_t *lp, const char *p, size_t len)
+{
+    __pmPDU	word;
+    size_t	rlen, n;
+    char	*tmp;
+
+    while (len > 0 && lp->path != NULL) {
+	if (lp->have == 0 && len >= sizeof(word)) {
+	    memcpy(&word, p, sizeof(word));
+	    rlen = ntohl(word);
+	    if (rlen <= len && rlen >= 2 * sizeof(word) &&
+		((uintptr_t)p % sizeof(word)) == 0) {
+		/* whole record in this write, parse it in place */
+		if (logsize_record(lp, (const __pmPDU *)p, rlen) < 0)
+		    logsize_abandon(lp);
+		p += rlen;
+		len -= rlen;
+		continue;
+	    }
+	}
+	if (lp->have < sizeof(word))
+	    rlen = sizeof(word);
+	else {
+	    memcpy(&word, lp->rec, sizeof(word));
+	    rlen = ntohl(word);
+	    if (rlen < 2 * sizeof(word)) {
+		logsize_abandon(lp);
+		break;
+	    }
+	}
+	if (rlen > lp->size) {
+	    if ((tmp = (char *)realloc(lp->rec, rlen)) == NULL) {
+		logsize_abandon(lp);
+		break;
+	    }
+	    lp->rec = tmp;
+	    lp->size = rlen;
+	}
+	n = rlen - lp->have;
+	if (n > len)
+	    n = len;
+	memcpy(&lp->rec[lp->have], p, n);
+	lp->have += n;
+	p += n;
+	len -= n;
+	if (lp->have == rlen && rlen > sizeof(word)) {
+	    if (logsize_record(lp, (const __pmPDU *)lp->rec, rlen) < 0)
+		logsize_abandon(lp);
+	    lp->have = 0;
+	}
+    }
+}
+
+static void
+logsize_end(logsize_t *lp)
+{
+    FILE		*fp;
+    logsize_metric_t	*mp;
+    char		strbuf[20];
+    int			i;
+
+    if (lp->path != NULL && lp->have == 0 && lp->version != 0) {
+	if ((fp = fopen(lp->path, "w")) != NULL) {
+	    fprintf(fp, "PCP logsize 1\n");
+	    fprintf(fp, "volume %lld %lld %lld %lld %d %d %d\n",
+		    (long long)lp->end, lp->label, lp->bytes, lp->ohead,
+		    lp->nrec, lp->nmark, lp->nmetric);
+	    for (i = 0; i < lp->nmetric; i++) {
+		mp = lp->metrics[i];
+		fprintf(fp, "%s %lld %d %d\n",
+			pmIDStr_r(mp->pmid, strbuf, sizeof(strbuf)),
+			mp->bytes, mp->nrec, mp->nval);
+	    }
+	    if (fclose(fp) == 0) {
+		free(lp->path);
+		lp->path = NULL;
+	    }
+	}
+    }
+    logsize_abandon(lp);
+    for (i = 0; i < lp->nmetric; i++)
+	free(lp->metrics[i]);
+    free(lp->metrics);
+    lp->metrics = NULL;
+    lp->nmetric = 0;
+    __pmHashFree(&lp->hash);
+    free(lp->rec);
+    lp->rec = NULL;
+}
+
+static void *
+logsize_open(__pmFILE *f, const char *path, const char *mode)
+{
+    /* only ever stacked on an open file by __pmFlogsize() */
+    return NULL;
+}
+
+static void *
+logsize_fdopen(__pmFILE *f, int fd, const char *mode)
+{
+    return NULL;
+}
+
+static int
+logsize_seek(__pmFILE *f, off_t offset, int whence)
+{
+    logsize_t	*lp = (logsize_t *)f->priv;
+    int		sts = lp->inner.fops->__pmseek(&lp->inner, offset, whence);
+
+    f->position = lp->inner.position;
+    return sts;
+}
+
+static void
+logsize_rewind(__pmFILE *f)
+{
+    logsize_t	*lp = (logsize_t *)f->priv;
+
+    lp->inner.fops->__pmrewind(&lp->inner);
+    f->position = lp->inner.position;
+}
+
+static off_t
+logsize_tell(__pmFILE *f)
+{
+    logsize_t	*lp = (logsize_t *)f->priv;
+    return lp->inner.fops->__pmtell(&lp->inner);
+}
+
+static int
+logsize_getc(__pmFILE *f)
+{
+    logsize_t	*lp = (logsize_t *)f->priv;
+    int		c = lp->inner.fops->__pmfgetc(&lp->inner);
+
+    f->position = lp->inner.position;
+    return c;
+}
+
+static size_t
+logsize_read(void *ptr, size_t size, size_t nmemb, __pmFILE *f)
+{
+    logsize_t	*lp = (logsize_t *)f->priv;
+    size_t	n = lp->inner.fops->__pmread(ptr, size, nmemb, &lp->inner);
+
+    f->position = lp->inner.position;
+    return n;
+}
+
+static size_t
+logsize_write(void *ptr, size_t size, size_t nmemb, __pmFILE *f)
+{
+    logsize_t	*lp = (logsize_t *)f->priv;
+    off_t	offset = lp->inner.fops->__pmtell(&lp->inner);
+    size_t	n = lp->inner.fops->__pmwrite(ptr, size, nmemb, &lp->inner);
+
+    f->position = lp->inner.position;
+    if (lp->path != NULL) {
+	if (offset != lp->end)
+	    logsize_abandon(lp);
+	else {
+	    lp->end += n * size;
+	    logsize_update(lp, (const char *)ptr, n * size);
+	}
+    }
+    return n;
+}
+
+static int
+logsize_flush(__pmFILE *f)
+{
+    logsize_t	*lp = (logsize_t *)f->priv;
+    return lp->inner.fops->__pmflush(&lp->inner);
+}
+
+static int
+logsize_fsync(__pmFILE *f)
+{
+    logsize_t	*lp = (logsize_t *)f->priv;
+    return lp->inner.fops->__pmfsync(&lp->inner);
+}
+
+static int
+logsize_fileno(__pmFILE *f)
+{
+    logsize_t	*lp = (logsize_t *)f->priv;
+    return lp->inner.fops->__pmfileno(&lp->inner);
+}
+
+static off_t
+logsize_lseek(__pmFILE *f, off_t offset, int whence)
+{
+    logsize_t	*lp = (logsize_t *)f->priv;
+    return lp->inner.fops->__pmlseek(&lp->inner, offset, whence);
+}
+
+static int
+logsize_fstat(__pmFILE *f, struct stat *buf)
+{
+    logsize_t	*lp = (logsize_t *)f->priv;
+    return lp->inner.fops->__pmfstat(&lp->inner, buf);
+}
+
+static int
+logsize_feof(__pmFILE *f)
+{
+    logsize_t	*lp = (logsize_t *)f->priv;
+    return lp->inner.fops->__pmfeof(&lp->inner);
+}
+
+static int
+logsize_ferror(__pmFILE *f)
+{
+    logsize_t	*lp = (logsize_t *)f->priv;
+    return lp->inner.fops->__pmferror(&lp->inner);
+}
+
+static void
+logsize_clearerr(__pmFILE *f)
+{
+    logsize_t	*lp = (logsize_t *)f->priv;
+    lp->inner.fops->__pmclearerr(&lp->inner);
+}
+
+static int
+logsize_setvbuf(__pmFILE *f, char *buf, int mode, size_t size)
+{
+    logsize_t	*lp = (logsize_t *)f->priv;
+    return lp->inner.fops->__pmsetvbuf(&lp->inner, buf, mode, size);
+}
+
+static int
+logsize_close(__pmFILE *f)
+{
+    logsize_t	*lp = (logsize_t *)f->priv;
+    int		sts;
+
+    /* volume first, so that the accounting file is never the newer */
+    sts = lp->inner.fops->__pmclose(&lp->inner);
+    if (sts != 0)
+	logsize_abandon(lp);
+    logsize_end(lp);
+    free(lp);
+    return sts;
+}
+
+static __pm_fops __pm_logsize = {
+    /*
+     * logsize - space accounting for another handler's writes
+     */
+    .__pmopen = logsize_open,
+    .__pmfdopen = logsize_fdopen,
+    .__pmseek = logsize_seek,
+    .__pmrewind = logsize_rewind,
+    .__pmtell = logsize_tell,
+    .__pmfgetc = logsize_getc,
+    .__pmread = logsize_read,
+    .__pmwrite = logsize_write,
+    .__pmflush = logsize_flush,
+    .__pmfsync = logsize_fsync,
+    .__pmfileno = logsize_fileno,
+    .__pmlseek = logsize_lseek,
+    .__pmfstat = logsize_fstat,
+    .__pmfeof = logsize_feof,
+    .__pmferror = logsize_ferror,
+    .__pmclearerr = logsize_clearerr,
+    .__pmsetvbuf = logsize_setvbuf,
+    .__pmclose = logsize_close
+};
+
+/*
+ * Start space accounting for all subsequent writes to f, which must
+ * be a newly created data volume, into the accounting file sizepath
+ * when f is closed.  Returns 0, or -oserror() if sizepath cannot be
+ * created, in which case f is unchanged.
+ */
+int
+__pmFlogsize(__pmFILE *f, const char *sizepath)
+{
+    logsize_t	*lp;
+    int		fd, sts;
+
+    if ((lp = (logsize_t *)calloc(1, sizeof(logsize_t))) == NULL)
+	return -oserror();
+    /* create it now, so any failure is reported up front */
+    if ((fd = open(sizepath, O_WRONLY|O_CREAT|O_TRUNC, 0644)) < 0 ||
+	(lp->path = strdup(sizepath)) == NULL) {
+	sts = -oserror();
+	if (fd >= 0) {
+	    close(fd);
+	    unlink(sizepath);
+	}
+	free(lp);
+	return sts;
+    }
+    close(fd);
+    lp->inner = *f;	/* struct assignment */
+    lp->end = lp->inner.fops->__pmtell(&lp->inner);
+    __pmHashInit(&lp->hash);
+    f->fops = &__pm_logsize;
+    f->priv = (void *)lp;
+    return 0;
+}
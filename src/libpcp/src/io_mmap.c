@@ -0,0 +1,387 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * Read-only i/o handler for uncompressed PCP files, using mmap(2).
+ *
+ * Archive replay, especially backwards, is a sequence of small seeks
+ * and reads that defeats stdio buffering ... every fseek() discards
+ * the stdio buffer and each record then costs a read(2) and a copy
+ * through the stdio buffer.  Here reads are a memcpy() from the
+ * mapping and seeks are just arithmetic on f->position.
+ *
+ * The file may still be growing (e.g. an archive being written by a
+ * concurrent pmlogger), so when a read or seek goes past the end of
+ * the current mapping the file size is checked again and the mapping
+ * is extended if the file has grown.
+ *
+ * madvise(2) hints follow the direction of the reads: sequential
+ * forward reads use MADV_SEQUENTIAL, and when reading backwards the
+ * window before the current position is requested with MADV_WILLNEED
+ * because the kernel's read-ahead only works forwards.
+ */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include "pmapi.h"
+#include "libpcp.h"
+#include "internal.h"
+
+/* bytes requested with MADV_WILLNEED ahead of each backwards read */
+#define MMAP_WINDOW	(256*1024)
+
+#define DIR_NONE	0
+#define DIR_FORW	1
+#define DIR_BACK	2
+
+typedef struct {
+    int		fd;
+    char	*base;		/* start of mapping, NULL if nothing mapped */
+    size_t	maplen;		/* bytes mapped from base */
+    int		eof;
+    int		err;
+    int		dir;		/* direction of the last read */
+    off_t	lastpos;	/* f->position after last read */
+    off_t	window;		/* start of last MADV_WILLNEED, -1 if none */
+} mmap_data_t;
+
+static long	pagesize;
+
+/*
+ * (re)map the whole file if it has grown beyond the current mapping
+ * ... returns 0 if the mapping is unchanged, 1 if it was extended,
+ * else -1
+ */
+static int
+mmap_refresh(mmap_data_t *mp)
+{
+    struct stat	sbuf;
+    void	*addr;
+
+    if (fstat(mp->fd, &sbuf) < 0)
+	return -1;
+    if (sbuf.st_size <= (off_t)mp->maplen)
+	return 0;
+    addr = mmap(NULL, (size_t)sbuf.st_size, PROT_READ, MAP_SHARED, mp->fd, 0);
+    if (addr == MAP_FAILED)
+	return -1;
+    if (mp->base != NULL)
+	munmap(mp->base, mp->maplen);
+    mp->base = (char *)addr;
+    mp->maplen = (size_t)sbuf.st_size;
+    mp->dir = DIR_NONE;
+    return 1;
+}
+
+/*
+ * establish madvise(2) hints for a read of len bytes at posn
+ */
+static void
+mmap_advise(mmap_data_t *mp, off_t posn, size_t len)
+{
+    off_t	lo;
+
+    if (posn + (off_t)len <= mp->lastpos) {
+	/* reading backwards */
+	if (mp->dir != DIR_BACK) {
+	    madvise(mp->base, mp->maplen, MADV_RANDOM);
+	    mp->dir = DIR_BACK;
+	    mp->window = -1;
+	}
+	if (posn < mp->window || mp->window < 0 ||
+	    posn > mp->window + MMAP_WINDOW) {
+	    /* outside the last window, request the next one */
+	    lo = posn - MMAP_WINDOW;
+	    if (lo < 0)
+		lo = 0;
+	    lo -= lo % pagesize;
+	    madvise(mp->base + lo, (size_t)(posn + len - lo), MADV_WILLNEED);
+	    mp->window = lo;
+	}
+    }
+    else if (posn >= mp->lastpos && mp->dir != DIR_FORW) {
+	/* reading forwards */
+	madvise(mp->base, mp->maplen, MADV_SEQUENTIAL);
+	mp->dir = DIR_FORW;
+    }
+}
+
+static void *
+mmap_fdopen(__pmFILE *f, int fd, const char *mode)
+{
+    mmap_data_t	*mp;
+    struct stat	sbuf;
+
+    if (mode[0] != 'r' || mode[1] != '\0') {
+	/* read-only */
+	setoserror(EINVAL);
+	return NULL;
+    }
+    if (fstat(fd, &sbuf) < 0)
+	return NULL;
+    if (!S_ISREG(sbuf.st_mode)) {
+	setoserror(ENODEV);
+	return NULL;
+    }
+    if (pagesize == 0)
+	pagesize = sysconf(_SC_PAGESIZE);	/* same value for all threads */
+    if ((mp = (mmap_data_t *)calloc(1, sizeof(mmap_data_t))) == NULL)
+	return NULL;
+    mp->fd = fd;
+    if (mmap_refresh(mp) < 0) {
+	free(mp);
+	return NULL;
+    }
+
+    f->priv = (void *)mp;
+    f->position = 0;
+
+    return f;
+}
+
+static void *
+mmap_open(__pmFILE *f, const char *path, const char *mode)
+{
+    int		fd;
+    int		sts;
+
+    if (mode[0] != 'r' || mode[1] != '\0') {
+	/* read-only */
+	setoserror(EINVAL);
+	return NULL;
+    }
+    if ((fd = open(path, O_RDONLY)) < 0)
+	return NULL;
+    if (mmap_fdopen(f, fd, mode) == NULL) {
+	sts = oserror();
+	close(fd);
+	setoserror(sts);
+	return NULL;
+    }
+    return f;
+}
+
+static off_t
+mmap_setpos(__pmFILE *f, off_t offset, int whence)
+{
+    mmap_data_t	*mp = (mmap_data_t *)f->priv;
+    off_t	posn;
+
+    switch (whence) {
+	case SEEK_SET:
+	    posn = offset;
+	    break;
+	case SEEK_CUR:
+	    posn = f->position + offset;
+	    break;
+	case SEEK_END:
+	    if (mmap_refresh(mp) < 0) {
+		mp->err = 1;
+		return -1;
+	    }
+	    posn = (off_t)mp->maplen + offset;
+	    break;
+	default:
+	    setoserror(EINVAL);
+	    return -1;
+    }
+    if (posn < 0) {
+	setoserror(EINVAL);
+	return -1;
+    }
+    f->position = posn;
+    mp->eof = 0;
+    return posn;
+}
+
+static int
+mmap_seek(__pmFILE *f, off_t offset, int whence)
+{
+    return mmap_setpos(f, offset, whence) < 0 ? -1 : 0;
+}
+
+static void
+mmap_rewind(__pmFILE *f)
+{
+    mmap_data_t	*mp = (mmap_data_t *)f->priv;
+
+    f->position = 0;
+    mp->eof = mp->err = 0;
+}
+
+static off_t
+mmap_tell(__pmFILE *f)
+{
+    return f->position;
+}
+
+static size_t
+mmap_read(void *ptr, size_t size, size_t nmemb, __pmFILE *f)
+{
+    mmap_data_t	*mp = (mmap_data_t *)f->priv;
+    size_t	want, avail;
+
+    if (size == 0 || nmemb == 0)
+	return 0;
+    want = size * nmemb;
+    if (f->position + (off_t)want > (off_t)mp->maplen) {
+	/* short of data in the mapping, has the file grown? */
+	if (mmap_refresh(mp) < 0) {
+	    mp->err = 1;
+	    return 0;
+	}
+    }
+    if (f->position >= (off_t)mp->maplen) {
+	mp->eof = 1;
+	return 0;
+    }
+    avail = mp->maplen - (size_t)f->position;
+    if (want > avail) {
+	want = avail;
+	mp->eof = 1;
+    }
+    mmap_advise(mp, f->position, want);
+    memcpy(ptr, mp->base + f->position, want);
+    f->position += want;
+    mp->lastpos = f->position;
+    return want / size;
+}
+
+static int
+mmap_getc(__pmFILE *f)
+{
+    unsigned char	c;
+
+    if (mmap_read(&c, 1, 1, f) != 1)
+	return EOF;
+    return (int)c;
+}
+
+static size_t
+mmap_write(void *ptr, size_t size, size_t nmemb, __pmFILE *f)
+{
+    mmap_data_t	*mp = (mmap_data_t *)f->priv;
+
+    /* read-only */
+    (void)ptr;
+    (void)size;
+    (void)nmemb;
+    mp->err = 1;
+    setoserror(EBADF);
+    return 0;
+}
+
+static int
+mmap_flush(__pmFILE *f)
+{
+    (void)f;
+    return 0;
+}
+
+static int
+mmap_fsync(__pmFILE *f)
+{
+    mmap_data_t	*mp = (mmap_data_t *)f->priv;
+    return fsync(mp->fd);
+}
+
+static int
+mmap_fileno(__pmFILE *f)
+{
+    mmap_data_t	*mp = (mmap_data_t *)f->priv;
+    return mp->fd;
+}
+
+static off_t
+mmap_lseek(__pmFILE *f, off_t offset, int whence)
+{
+    return mmap_setpos(f, offset, whence);
+}
+
+static int
+mmap_fstat(__pmFILE *f, struct stat *buf)
+{
+    mmap_data_t	*mp = (mmap_data_t *)f->priv;
+    return fstat(mp->fd, buf);
+}
+
+static int
+mmap_feof(__pmFILE *f)
+{
+    mmap_data_t	*mp = (mmap_data_t *)f->priv;
+    return mp->eof;
+}
+
+static int
+mmap_ferror(__pmFILE *f)
+{
+    mmap_data_t	*mp = (mmap_data_t *)f->priv;
+    return mp->err;
+}
+
+static void
+mmap_clearerr(__pmFILE *f)
+{
+    mmap_data_t	*mp = (mmap_data_t *)f->priv;
+    mp->eof = mp->err = 0;
+}
+
+static int
+mmap_setvbuf(__pmFILE *f, char *buf, int mode, size_t size)
+{
+    /* no buffering to adjust */
+    (void)f;
+    (void)buf;
+    (void)mode;
+    (void)size;
+    return 0;
+}
+
+static int
+mmap_close(__pmFILE *f)
+{
+    mmap_data_t	*mp = (mmap_data_t *)f->priv;
+    int		sts;
+
+    if (mp->base != NULL)
+	munmap(mp->base, mp->maplen);
+    sts = close(mp->fd);
+    free(mp);
+    return sts;
+}
+
+__pm_fops __pm_mmap = {
+    /*
+     * mmap - read-only, no compression
+     */
+    .__pmopen = mmap_open,
+    .__pmfdopen = mmap_fdopen,
+    .__pmseek = mmap_seek,
+    .__pmrewind = mmap_rewind,
+    .__pmtell = mmap_tell,
+    .__pmfgetc = mmap_getc,
+    .__pmread = mmap_read,
+    .__pmwrite = mmap_write,
+    .__pmflush = mmap_flush,
+    .__pmfsync = mmap_fsync,
+    .__pmfileno = mmap_fileno,
+    .__pmlseek = mmap_lseek,
+    .__pmfstat = mmap_fstat,
+    .__pmfeof = mmap_feof,
+    .__pmferror = mmap_ferror,
+    .__pmclearerr = mmap_clearerr,
+    .__pmsetvbuf = mmap_setvbuf,
+    .__pmclose = mmap_close
+};
@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ * 
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ * 
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ */
+
+/*
+ * Copies of the records of an archive as they are written.
+ *
+ * __pmFtee() stacks this handler on top of whichever handler(s)
+ * __pmLogNewFile() chose for a new metadata or data volume, and each
+ * write appended to the file is passed to a callback as well, along
+ * with the volume number.  Archive files are unbuffered, so each
+ * callback is one complete record, in the (uncompressed) on-disk
+ * format.  Writes anywhere other than at the end of the file (there
+ * are none for the files pmlogger creates) are not passed on.
+ */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "pmapi.h"
+#include "libpcp.h"
+#include "internal.h"
+
+typedef struct {
+    __pmFILE		inner;		/* the wrapped handler, fops and priv */
+    __pmTeeCallBack	callback;
+    void		*arg;
+    int			vol;
+    off_t		end;		/* offset of the end of the file */
+} tee_t;
+
+static void *
+tee_open(__pmFILE *f, const char *path, const char *mode)
+{
+    /* only ever stacked on an open file by __pmFtee() */
+    return NULL;
+}
+
+static void *
+tee_fdopen(__pmFILE *f, int fd, const char *mode)
+{
+    return NULL;
+}
+
+static int
+tee_seek(__pmFILE *f, off_t offset, int whence)
+{
+    tee_t	*tp = (tee_t *)f->priv;
+    int		sts = tp->inner.fops->__pmseek(&tp->inner, offset, whence);
+
+    f->position = tp->inner.position;
+    return sts;
+}
+
+static void
+tee_rewind(__pmFILE *f)
+{
+    tee_t	*tp = (tee_t *)f->priv;
+
+    tp->inner.fops->__pmrewind(&tp->inner);
+    f->position = tp->inner.position;
+}
+
+static off_t
+tee_tell(__pmFILE *f)
+{
+    tee_t	*tp = (tee_t *)f->priv;
+    return tp->inner.fops->__pmtell(&tp->inner);
+}
+
+static int
+tee_getc(__pmFILE *f)
+{
+    tee_t	*tp = (tee_t *)f->priv;
+    int		c = tp->inner.fops->__pmfgetc(&tp->inner);
+
+    f->position = tp->inner.position;
+    return c;
+}
+
+static size_t
+tee_read(void *ptr, size_t size, size_t nmemb, __pmFILE *f)
+{
+    tee_t	*tp = (tee_t *)f->priv;
+    size_t	n = tp->inner.fops->__pmread(ptr, size, nmemb, &tp->inner);
+
+    f->position = tp->inner.position;
+    return n;
+}
+
+static size_t
+tee_write(void *ptr, size_t size, size_t nmemb, __pmFILE *f)
+{
+    tee_t	*tp = (tee_t *)f->priv;
+    off_t	offset = tp->inner.fops->__pmtell(&tp->inner);
+    size_t	n = tp->inner.fops->__pmwrite(ptr, size, nmemb, &tp->inner);
+
+    f->position = tp->inner.position;
+    if (offset == tp->end && n > 0) {
+	tp->callback(tp->arg, tp->vol, ptr, n * size);
+	tp->end += n * size;
+    }
+    else if (offset + (off_t)(n * size) > tp->end)
+	tp->end = offset + n * size;
+    return n;
+}
+
+static int
+tee_flush(__pmFILE *f)
+{
+    tee_t	*tp = (tee_t *)f->priv;
+    return tp->inner.fops->__pmflush(&tp->inner);
+}
+
+static int
+tee_fsync(__pmFILE *f)
+{
+    tee_t	*tp = (tee_t *)f->priv;
+    return tp->inner.fops->__pmfsync(&tp->inner);
+}
+
+static int
+tee_fileno(__pmFILE *f)
+{
+    tee_t	*tp = (tee_t *)f->priv;
+    return tp->inner.fops->__pmfileno(&tp->inner);
+}
+
+static off_t
+tee_lseek(__pmFILE *f, off_t offset, int whence)
+{
+    tee_t	*tp = (tee_t *)f->priv;
+    return tp->inner.fops->__pmlseek(&tp->inner, offset, whence);
+}
+
+static int
+tee_fstat(__pmFILE *f, struct stat *buf)
+{
+    tee_t	*tp = (tee_t *)f->priv;
+    return tp->inner.fops->__pmfstat(&tp->inner, buf);
+}
+
+static int
+tee_feof(__pmFILE *f)
+{
+    tee_t	*tp = (tee_t *)f->priv;
+    return tp->inner.fops->__pmfeof(&tp->inner);
+}
+
+static int
+tee_ferror(__pmFILE *f)
+{
+    tee_t	*tp = (tee_t *)f->priv;
+    return tp->inner.fops->__pmferror(&tp->inner);
+}
+
+static void
+tee_clearerr(__pmFILE *f)
+{
+    tee_t	*tp = (tee_t *)f->priv;
+    tp->inner.fops->__pmclearerr(&tp->inner);
+}
+
+static int
+tee_setvbuf(__pmFILE *f, char *buf, int mode, size_t size)
+{
+    tee_t	*tp = (tee_t *)f->priv;
+    return tp->inner.fops->__pmsetvbuf(&tp->inner, buf, mode, size);
+}
+
+static int
+tee_close(__pmFILE *f)
+{
+    tee_t	*tp = (tee_t *)f->priv;
+    int		sts;
+
+    sts = tp->inner.fops->__pmclose(&tp->inner);
+    free(tp);
+    return sts;
+}
+
+static __pm_fops __pm_tee = {
+    /*
+     * tee - copies of another handler's appended writes
+     */
+    .__pmopen = tee_open,
+    .__pmfdopen = tee_fdopen,
+    .__pmseek = tee_seek,
+    .__pmrewind = tee_rewind,
+    .__pmtell = tee_tell,
+    .__pmfgetc = tee_getc,
+    .__pmread = tee_read,
+    .__pmwrite = tee_write,
+    .__pmflush = tee_flush,
+    .__pmfsync = tee_fsync,
+    .__pmfileno = tee_fileno,
+    .__pmlseek = tee_lseek,
+    .__pmfstat = tee_fstat,
+    .__pmfeof = tee_feof,
+    .__pmferror = tee_ferror,
+    .__pmclearerr = tee_clearerr,
+    .__pmsetvbuf = tee_setvbuf,
+    .__pmclose = tee_close
+};
+
+/*
+ * Pass each subsequent write appended to f, which is volume vol of
+ * an archive (PM_LOG_VOL_META for the metadata), to callback.
+ * Returns 0, or -oserror() on allocation failure, in which case f
+ * is unchanged.
+ */
+int
+__pmFtee(__pmFILE *f, int vol, __pmTeeCallBack callback, void *arg)
+{
+    tee_t	*tp;
+
+    if (callback == NULL)
+	return -EINVAL;
+    if ((tp = (tee_t *)calloc(1, sizeof(tee_t))) == NULL)
+	return -oserror();
+    tp->inner = *f;	/* struct assignment */
+    tp->callback = callback;
+    tp->arg = arg;
+    tp->vol = vol;
+    tp->end = tp->inner.fops->__pmtell(&tp->inner);
+    f->fops = &__pm_tee;
+    f->priv = (void *)tp;
+    return 0;
+}
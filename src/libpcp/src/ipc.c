@@ -356,6 +356,7 @@ __pmOverrideLastFd(int fd)
 void
 __pmResetIPC(int fd)
 {
+    __pmCloseShmIPC(fd);
     PM_LOCK(ipc_lock);
     if (__pmIPCTable && fd >= 0 && fd < ipctablecount)
 	memset(__pmIPCTablePtr(fd), 0, ipcentrysize);
@@ -109,18 +109,6 @@ state_string(struct jsonsl_state_st *state)
     return "?";
 }
 
-static const char *
-label_name(const pmLabel *lp, const char *json, __pmHashCtl *lc)
-{
-    __pmHashNode	*hp;
-
-    if (!(lp->flags & PM_LABEL_COMPOUND) || lc == NULL ||
-	(hp = __pmHashSearch(lp->name, lc)) == NULL)
-	return json + lp->name;
-    /* compound "a.b.c" style label name */
-    return (const char *)hp->data;
-}
-
 static void
 label_name_length(const pmLabel *lp, const char *json, __pmHashCtl *lc,
 		const char **name, int *length)
@@ -382,24 +370,19 @@ static int
 namecmp6(const pmLabel *ap, const char *as, __pmHashCtl *ac,
 	 const pmLabel *bp, const char *bs, __pmHashCtl *bc)
 {
-    const char	*name;
-    int		sts, length;
+    const char	*aname, *bname;
+    int		sts, alength, blength;
 
-    if (ap->namelen > bp->namelen) {
-	label_name_length(bp, bs, bc, &name, &length);
-	if ((sts = strncmp(label_name(ap, as, ac), name, length)))
-	    return sts;
-	return 1;	/* ap longer, so remainder sorts larger */
-    }
-    if (ap->namelen < bp->namelen) {
-	label_name_length(ap, as, ac, &name, &length);
-	if ((sts = strncmp(name, label_name(bp, bs, bc), length)))
-	    return sts;
-	return -1;	/* bp longer, so remainder sorts larger */
-    }
-    /* (ap->namelen == bp->namelen) */
-    label_name_length(ap, as, ac, &name, &length);
-    return strncmp(name, label_name(bp, bs, bc), length);
+    /*
+     * Compare full names - for compound labels the pmLabel namelen is
+     * that of the final name component only, whereas a merged set has
+     * the flattened "a.b.c" form and its length.
+     */
+    label_name_length(ap, as, ac, &aname, &alength);
+    label_name_length(bp, bs, bc, &bname, &blength);
+    if ((sts = strncmp(aname, bname, alength < blength ? alength : blength)))
+	return sts;
+    return alength - blength;	/* longer name sorts larger */
 }
 
 static int
@@ -961,37 +944,28 @@ __pmMergeLabels(const char *a, const char *b, char *buffer, int buflen, int flag
     return sts;
 }
 
-/*
- * Walk the "sets" array left to right (increasing precedence)
- * and produce the merged set into the supplied buffer.
- * An optional user-supplied callback routine allows fine-tuning
- * of the resulting set of labels.
- */
-int
-pmMergeLabelSets(pmLabelSet **sets, int nsets, char *buffer, int buflen,
-		filter_labels filter, void *arg)
+static int
+merge_labelsets(pmLabelSet **sets, int nsets, char *buffer, int buflen,
+		pmLabel *olabels, int *nlabels, filter_labels filter, void *arg)
 {
     __pmHashCtl		*compound, bhash = {0};
-    pmLabel		olabels[MAXLABELSET];
     pmLabel		blabels[MAXLABELSET];
     char		buf[PM_MAXLABELJSONLEN];
-    int			nlabels = 0;
     int			i, sts = 0;
 
-    if (!sets || nsets < 1)
-	return -EINVAL;
-
+    *nlabels = 0;
     for (i = 0; i < nsets; i++) {
 	if (sets[i] == NULL || sets[i]->nlabels < 0)
 	    continue;
 
-	/* avoid overwriting the working set, if there is one */
+	/*
+	 * Avoid overwriting the working set, if there is one - only the
+	 * labels and JSONB bytes in use are copied, the remainder of the
+	 * working buffers is never referenced.
+	 */
 	if (sts > 0) {
 	    memcpy(buf, buffer, sts);
-	    memcpy(blabels, olabels, nlabels * sizeof(pmLabel));
-	} else {
-	    memset(buf, 0, sizeof(buf));
-	    memset(blabels, 0, sizeof(blabels));
+	    memcpy(blabels, olabels, *nlabels * sizeof(pmLabel));
 	}
 
 	if (pmDebugOptions.labels) {
@@ -1008,10 +982,10 @@ pmMergeLabelSets(pmLabelSet **sets, int nsets, char *buffer, int buflen,
 	 * Merge sets[i] with blabels into olabels. Any duplicate label
 	 * names in sets[i] prevail over those in blabels.
 	 */
-	sts = __pmMergeLabelSets(blabels, buf, &bhash, nlabels,
+	sts = __pmMergeLabelSets(blabels, buf, &bhash, *nlabels,
 				sets[i]->labels, sets[i]->json,
 				compound, sets[i]->nlabels,
-				olabels, buffer, &nlabels, buflen, filter, arg);
+				olabels, buffer, nlabels, buflen, filter, arg);
 	labels_hash_destroy(&bhash);
 	if (sts < 0)
 	    return sts;
@@ -1021,6 +995,69 @@ pmMergeLabelSets(pmLabelSet **sets, int nsets, char *buffer, int buflen,
     return sts;
 }
 
+/*
+ * Walk the "sets" array left to right (increasing precedence)
+ * and produce the merged set into the supplied buffer.
+ * An optional user-supplied callback routine allows fine-tuning
+ * of the resulting set of labels.
+ */
+int
+pmMergeLabelSets(pmLabelSet **sets, int nsets, char *buffer, int buflen,
+		filter_labels filter, void *arg)
+{
+    pmLabel		olabels[MAXLABELSET];
+    int			nlabels;
+
+    if (!sets || nsets < 1)
+	return -EINVAL;
+    return merge_labelsets(sets, nsets, buffer, buflen,
+			    olabels, &nlabels, filter, arg);
+}
+
+/*
+ * As for pmMergeLabelSets, but the result is returned as a newly
+ * allocated (single) pmLabelSet, indexed and with the label flags
+ * of the contributing sets, instead of as a JSONB string.  Compound
+ * names are flattened to their "a.b.c" form in the JSONB, so there
+ * is no compound naming hash in the result.  This allows callers to
+ * keep a merged hierarchy of labels and walk it directly, without
+ * merging (or parsing) again on every use.
+ */
+int
+__pmMergedLabelSet(pmLabelSet **sets, int nsets, pmLabelSet **merged)
+{
+    pmLabelSet		*result;
+    pmLabel		olabels[MAXLABELSET], *lp = NULL;
+    char		buf[PM_MAXLABELJSONLEN], *json = NULL;
+    int			sts, nlabels;
+
+    if (!sets || nsets < 1 || merged == NULL)
+	return -EINVAL;
+    if ((sts = merge_labelsets(sets, nsets, buf, sizeof(buf),
+			    olabels, &nlabels, NULL, NULL)) < 0)
+	return sts;
+
+    if ((result = (pmLabelSet *)calloc(1, sizeof(*result))) == NULL)
+	return -ENOMEM;
+    if (nlabels > 0) {
+	if ((json = strndup(buf, sts)) == NULL ||
+	    (lp = malloc(nlabels * sizeof(pmLabel))) == NULL) {
+	    if (json) free(json);
+	    free(result);
+	    return -ENOMEM;
+	}
+	memcpy(lp, olabels, nlabels * sizeof(pmLabel));
+	result->jsonlen = sts;
+    }
+    result->inst = PM_IN_NULL;
+    result->nlabels = nlabels;
+    result->json = json;
+    result->labels = lp;
+
+    *merged = result;
+    return nlabels;
+}
+
 /*
  * Walk the "sets" array left to right (increasing precendence)
  * of JSON and produce the merged set into the supplied buffer.
@@ -117,7 +117,18 @@ PM_FAULT_POINT("libpcp/" __FILE__ ":1", PM_FAULT_ALLOC);
     idp->isdelta = (type == TYPE_INDOM_DELTA);
     idp->buf = indom_buf;
     idp->alloc = lidp->alloc;
-    addinsts(idp, lidp->numinst, lidp->instlist, lidp->namelist);
+    if ((lidp->alloc & (PMLID_LAZY|PMLID_RECORD)) == PMLID_LAZY)
+	idp->rec = indom_buf;
+    else
+	idp->rec = NULL;
+    if (lidp->alloc & PMLID_LAZY) {
+	/* from the metadata index, instances loaded on demand */
+	idp->numinst = lidp->numinst;
+	idp->instlist = NULL;
+	idp->namelist = NULL;
+    }
+    else
+	addinsts(idp, lidp->numinst, lidp->instlist, lidp->namelist);
 
     if (pmDebugOptions.logmeta) {
 	char    strbuf[20];
@@ -177,7 +188,9 @@ PM_FAULT_POINT("libpcp/" __FILE__ ":1", PM_FAULT_ALLOC);
 		    __pmPrintTimestamp(stderr, &idp->stamp);
 		    fprintf(stderr, "[%d numinst]) ? ", idp->numinst);
 		}
-		if (sameindom(idp_cached, idp)) {
+		if (__pmLogLoadLazyInDom(idp_cached) == 0 &&
+		    __pmLogLoadLazyInDom(idp) == 0 &&
+		    sameindom(idp_cached, idp)) {
 		    sts = PMLOGPUTINDOM_DUP; /* duplicate */
 		    if (pmDebugOptions.logmeta && pmDebugOptions.desperate)
 			fprintf(stderr, "yes\n");
@@ -199,8 +212,14 @@ PM_FAULT_POINT("libpcp/" __FILE__ ":1", PM_FAULT_ALLOC);
 		 * indom_buf because we don't know where the storage
 		 * came from. Only the caller knows. The best we can do is to
 		 * indicate that we found a duplicate and let the caller manage
-		 * them. We do, however need to free idp.
+		 * them. We do, however need to free idp, and anything
+		 * allocated when idp was loaded from the metadata index.
 		 */
+		if (lidp->alloc & PMLID_LAZY) {
+		    if (idp->alloc & PMLID_NAMELIST)
+			free(idp->namelist);
+		    free(idp->buf);
+		}
 		free(idp);
 		if (idp_prior == idp_time) {
 		    /* The duplicate is already in the right place. */
@@ -682,14 +701,23 @@ __pmLogLoadMeta(__pmArchCtl *acp)
     int			i;
     int			len;
     char		name[MAXPATHLEN];
+    struct __pmLogMetaIndex	*mip = NULL;
     
     if (lcp->pmns == NULL) {
 	if ((sts = __pmNewPMNS(&(lcp->pmns))) < 0)
 	    goto end;
     }
 
+    mip = __pmLogOpenMetaIndex(lcp);
     __pmFseek(f, (long)__pmLogLabelSize(lcp), SEEK_SET);
     for ( ; ; ) {
+	if (mip != NULL) {
+	    /* indom records covered by the metadata index are skipped */
+	    if ((sts = __pmLogMetaIndexSkip(lcp, mip)) < 0)
+		goto end;
+	    if (sts > 0)
+		continue;
+	}
 	n = (int)__pmFread(&h, 1, sizeof(__pmLogHdr), f);
 
 	/* swab hdr */
@@ -817,38 +845,64 @@ __pmLogLoadMeta(__pmArchCtl *acp)
 	}
 	else if (h.type == TYPE_INDOM || h.type == TYPE_INDOM_DELTA || h.type == TYPE_INDOM_V2) {
 	    __pmLogInDom	lid;
-	    __int32_t		*buf;
+	    char		*rec;
 
-	    if ((sts = __pmLogLoadInDom(acp, rlen, h.type, &lid, &buf)) < 0) {
+	    /*
+	     * Most of the metadata for an archive with large and changing
+	     * instance domains is indom records, and most of those are
+	     * never used, so keep a copy of the whole record and only
+	     * check it here ... the instances are decoded on first use,
+	     * see __pmLogLoadLazyInDom()
+	     */
+PM_FAULT_POINT("libpcp/" __FILE__ ":17", PM_FAULT_ALLOC);
+	    if ((rec = (char *)malloc(h.len)) == NULL) {
+		sts = -oserror();
+		goto end;
+	    }
+	    if ((n = (int)__pmFread(&rec[sizeof(__pmLogHdr)], 1, rlen, f)) != rlen) {
+		if (pmDebugOptions.logmeta) {
+		    fprintf(stderr, "%s: indom read -> %d: expected: %d\n",
+			    "__pmLogLoadMeta", n, rlen);
+		}
+		free(rec);
+		if (__pmFerror(f)) {
+		    __pmClearerr(f);
+		    sts = -oserror();
+		}
+		else
+		    sts = PM_ERR_LOGREC;
+		goto end;
+	    }
+	    if ((sts = __pmLogScanInDom(rlen, h.type, (__int32_t *)&rec[sizeof(__pmLogHdr)], &lid)) < 0) {
+		free(rec);
 		goto end;
 	    }
 	    if (lid.numinst > 0) {
 		/*
-		 * we have instances, so in.namelist is not NULL
+		 * header and trailer in disk format, the trailer itself
+		 * is checked below
 		 */
-		if ((sts = __pmLogAddInDom(acp, h.type, &lid, buf)) < 0) {
-		    free(buf);
-		    __pmFreeLogInDom(&lid);
+		check = htonl(h.len);
+		memcpy(&rec[h.len - sizeof(check)], &check, sizeof(check));
+		check = htonl(h.type);
+		memcpy(&rec[sizeof(h.len)], &check, sizeof(check));
+		check = htonl(h.len);
+		memcpy(&rec[0], &check, sizeof(check));
+		lid.alloc = PMLID_LAZY|PMLID_RECORD;
+		/*
+		 * rec is now owned by the __pmLogInDom, even if this indom
+		 * was a duplicate (in which case it has already been
+		 * free'd), unless there was an error
+		 */
+		if ((sts = __pmLogAddInDom(acp, h.type, &lid, (__int32_t *)rec)) < 0) {
+		    free(rec);
 		    goto end;
 		}
-		/* If this indom was a duplicate, then we need to free tbuf and
-		   namelist, as appropriate. */
-		if (sts == PMLOGPUTINDOM_DUP) {
-		    free(buf);
-		    __pmFreeLogInDom(&lid);
-		}
 	    }
 	    else {
-		/* no instances, or an error */
-		free(buf);
+		/* no instances */
+		free(rec);
 	    }
-	    /*
-	     * don't free namelist ... it will have been salted away in
-	     * __pmLogAddInDom() and maybe free'd later in
-	     * logFreeHashInDom()
-	     */
-	    lid.alloc &= (~PMLID_NAMELIST);
-	    __pmFreeLogInDom(&lid);
 	}
 	else if (h.type == TYPE_LABEL || h.type == TYPE_LABEL_V2) {
 	    __pmTimestamp	stamp;
@@ -948,6 +1002,8 @@ PM_FAULT_POINT("libpcp/" __FILE__ ":16", PM_FAULT_ALLOC);
 				"__pmLogLoadMeta", h.type, (int)(__pmFtell(f) - sizeof(check)));
 
 	    }
+	    if (mip != NULL)
+		__pmLogCloseMetaIndex(mip);
 	    return PM_ERR_RECTYPE;
 	}
 	n = (int)__pmFread(&check, 1, sizeof(check), f);
@@ -968,6 +1024,8 @@ PM_FAULT_POINT("libpcp/" __FILE__ ":16", PM_FAULT_ALLOC);
 	}
     }/*for*/
 end:
+    if (mip != NULL)
+	__pmLogCloseMetaIndex(mip);
 
     /* Check for duplicate label sets. */
     check_dup_labels(acp);
@@ -1090,6 +1148,212 @@ PM_FAULT_POINT("libpcp/" __FILE__ ":5", PM_FAULT_ALLOC);
     return __pmHashAdd((int)dp->pmid, (void *)tdp, &lcp->hashpmid);
 }
 
+/*
+ * Load the instances for a __pmLogInDom that was added by
+ * __pmLogLoadMeta() without decoding the instances (PMLID_LAZY), so
+ * idp->buf is the whole on-disk record, either in the mapped metadata
+ * file (from the metadata index) or a malloc'd copy (PMLID_RECORD)
+ * ... after this the __pmLogInDom is the same as if the record had
+ * been decoded when it was first read.  Nothing to be done if the
+ * instances are already loaded.
+ *
+ * The record is checked again before it is used, and if the record
+ * is bad the __pmLogInDom is left with no instances.
+ */
+int
+__pmLogLoadLazyInDom(__pmLogInDom *idp)
+{
+    __pmLogInDom	lid;
+    __pmLogHdr		h;
+    __int32_t		*lbuf;
+    __int32_t		check;
+    char		*rec;
+    int			rlen;
+    int			fixed;
+    int			numinst;
+    int			own;
+    int			i;
+
+    if ((idp->alloc & PMLID_LAZY) == 0)
+	return 0;
+
+    rec = (char *)idp->buf;
+    own = (idp->alloc & PMLID_RECORD);
+    idp->alloc &= ~(PMLID_LAZY|PMLID_RECORD);
+    idp->buf = NULL;
+    idp->instlist = NULL;
+    idp->namelist = NULL;
+    numinst = idp->numinst;
+    idp->numinst = 0;
+
+    memcpy(&h, rec, sizeof(h));
+    h.len = ntohl(h.len);
+    h.type = ntohl(h.type);
+    memcpy(&check, &rec[h.len - sizeof(check)], sizeof(check));
+    rlen = h.len - (int)sizeof(__pmLogHdr) - (int)sizeof(int);
+    /* timestamp, indom and numinst, then instlist[] and stridx[] */
+    fixed = (h.type == TYPE_INDOM_V2) ? 4 : 5;
+    if (ntohl(check) != h.len ||
+	rlen < (fixed + 2 * numinst) * (int)sizeof(__int32_t)) {
+	if (pmDebugOptions.logmeta)
+	    fprintf(stderr, "__pmLogLoadLazyInDom: bad record len=%d trailer=%d numinst=%d\n",
+		    h.len, ntohl(check), numinst);
+	if (own)
+	    free(rec);
+	return PM_ERR_LOGREC;
+    }
+    if (own) {
+	/* decode in place, after dropping the header */
+	memmove(rec, &rec[sizeof(__pmLogHdr)], rlen);
+	lbuf = (__int32_t *)rec;
+    }
+    else {
+	if ((lbuf = (__int32_t *)malloc(rlen)) == NULL)
+	    return -oserror();
+	memcpy(lbuf, &rec[sizeof(__pmLogHdr)], rlen);
+    }
+    memset(&lid, 0, sizeof(lid));
+    if (__pmLogLoadInDom(NULL, rlen, h.type, &lid, &lbuf) < 0)
+	goto bad;
+    if (lid.numinst != numinst || __pmTimestampCmp(&lid.stamp, &idp->stamp) != 0)
+	goto bad;
+    /*
+     * names must start and end in the record, __pmLogLoadInDom() only
+     * checks this when it reads the record itself
+     */
+    for (i = 0; i < lid.numinst; i++) {
+	char	*end = (char *)lbuf + rlen;
+	char	*name = lid.namelist[i];
+
+	if (name == NULL)
+	    continue;
+	if (name < (char *)lbuf || name >= end || memchr(name, '\0', end - name) == NULL)
+	    goto bad;
+    }
+
+    addinsts(idp, lid.numinst, lid.instlist, lid.namelist);
+    idp->buf = lbuf;
+    idp->alloc |= lid.alloc;
+    return 0;
+
+bad:
+    if (pmDebugOptions.logmeta) {
+	fprintf(stderr, "__pmLogLoadLazyInDom: record @ ");
+	StrTimestamp(&idp->stamp);
+	fprintf(stderr, " does not match %s\n", own ? "loaded record" : "metadata index");
+    }
+    if (lid.alloc & PMLID_NAMELIST)
+	free(lid.namelist);
+    free(lbuf);
+    return PM_ERR_LOGREC;
+}
+
+static int
+unloadable(__pmLogInDom *idp)
+{
+    __pmLogHdr		h;
+
+    if (idp->rec == NULL || idp->isdelta || (idp->alloc & PMLID_LAZY))
+	return 0;
+    memcpy(&h, idp->rec, sizeof(h));
+    return ntohl(h.type) != TYPE_INDOM_DELTA;
+}
+
+/*
+ * Undo __pmLogLoadLazyInDom() for the records of each instance domain
+ * that are behind the replay position at tsp, i.e. older than the
+ * record in effect at tsp if direction > 0, else newer, so the decoded
+ * instances of a long archive are not all held at once.  Only records
+ * in the mapped metadata file (idp->rec) can be unloaded, and not delta
+ * records (once "un-delta'd" the instances no longer match the record)
+ * nor the records they were "un-delta'd" from.
+ * They are loaded again on demand, like any other PMLID_LAZY record.
+ *
+ * The caller must be the only user of lcp (refcnt == 1), as pointers
+ * into the instances are returned from __pmLogGetInDom().  Returns the
+ * number of records unloaded.
+ */
+int
+__pmLogUnloadInDoms(__pmLogCtl *lcp, const __pmTimestamp *tsp, int direction)
+{
+    __pmHashNode	*hp;
+    __pmLogInDom	*idp;
+    __pmLogInDom	*cur;
+    __pmLogHdr		h;
+    int			count = 0;
+    int			i, j;
+
+    for (i = 0; i < lcp->hashindom.hsize; i++) {
+	for (hp = lcp->hashindom.hash[i]; hp != NULL; hp = hp->next) {
+	    /* "next" is in reverse chronological order */
+	    for (cur = (__pmLogInDom *)hp->data; cur != NULL; cur = cur->next) {
+		if (__pmTimestampCmp(&cur->stamp, tsp) <= 0)
+		    break;
+	    }
+	    for (idp = (__pmLogInDom *)hp->data; idp != NULL; idp = idp->next) {
+		if (idp == cur)
+		    continue;
+		if (cur != NULL && direction < 0) {
+		    if (__pmTimestampCmp(&idp->stamp, &cur->stamp) < 0)
+			break;
+		}
+		else if (direction > 0) {
+		    if (cur == NULL)
+			break;
+		    if (__pmTimestampCmp(&idp->stamp, &cur->stamp) > 0)
+			continue;
+		}
+		if (!unloadable(idp))
+		    continue;
+		if (idp->prior != NULL) {
+		    /*
+		     * the names of a following delta record, once
+		     * "un-delta'd", point into this record
+		     */
+		    if (idp->prior->rec == NULL)
+			continue;
+		    memcpy(&h, idp->prior->rec, sizeof(h));
+		    if (ntohl(h.type) == TYPE_INDOM_DELTA)
+			continue;
+		}
+		if (idp->alloc & PMLID_NAMES) {
+		    for (j = 0; j < idp->numinst; j++) {
+			if (idp->namelist[j] != NULL)
+			    free(idp->namelist[j]);
+		    }
+		}
+		if (idp->alloc & PMLID_NAMELIST)
+		    free(idp->namelist);
+		if (idp->alloc & PMLID_INSTLIST)
+		    free(idp->instlist);
+		if (idp->buf != NULL)
+		    free(idp->buf);
+		idp->instlist = NULL;
+		idp->namelist = NULL;
+		idp->buf = idp->rec;
+		idp->alloc = (idp->alloc & PMLID_SELF) | PMLID_LAZY;
+		count++;
+	    }
+	}
+    }
+    if (pmDebugOptions.logmeta && count > 0)
+	fprintf(stderr, "__pmLogUnloadInDoms: %d records unloaded\n", count);
+    return count;
+}
+
+/*
+ * make the instances for idp available, "un-delta" if this is a delta
+ * indom record, else load if added from the metadata index
+ */
+static void
+fullindom(pmInDom indom, __pmLogInDom *idp)
+{
+    if (idp->isdelta)
+	__pmLogUndeltaInDom(indom, idp);
+    else
+	__pmLogLoadLazyInDom(idp);
+}
+
 void
 __pmLogUndeltaInDom(pmInDom indom, __pmLogInDom *idp)
 {
@@ -1123,6 +1387,7 @@ __pmLogUndeltaInDom(pmInDom indom, __pmLogInDom *idp)
 	pmflush();
 	return;
     }
+    __pmLogLoadLazyInDom(tidp);
 
     /*
      * found the previous full indom, now march forward in time replacing
@@ -1135,6 +1400,7 @@ __pmLogUndeltaInDom(pmInDom indom, __pmLogInDom *idp)
 	int	i;		/* index over last full indom */
 	int	j;		/* index over delta indom */
 	int	k;		/* index over new full indom we're building */
+	__pmLogLoadLazyInDom(didp);
 	numinst = didp->next->numinst;
 	for (j = 0; j < didp->numinst; j++) {
 	    if (didp->namelist[j] != NULL)
@@ -1236,12 +1502,6 @@ __pmLogSearchInDom(__pmLogCtl *lcp, pmInDom indom, __pmTimestamp *tsp)
     idp = (__pmLogInDom *)hp->data;
     if (tsp != NULL) {
 	for ( ; idp != NULL; idp = idp->next) {
-	    if (idp->isdelta) {
-		/*
-		 * Need to "un-delta" this delta indom record
-		 */
-		__pmLogUndeltaInDom(indom, idp);
-	    }
 	    if (__pmTimestampCmp(&idp->stamp, tsp) <= 0)
 		break;
 	    if (pmDebugOptions.logmeta) {
@@ -1254,7 +1514,13 @@ __pmLogSearchInDom(__pmLogCtl *lcp, pmInDom indom, __pmTimestamp *tsp)
 	}
 	if (idp == NULL)
 	    return NULL;
+	/*
+	 * Need to "un-delta" this if it is a delta indom record
+	 */
+	fullindom(indom, idp);
     }
+    else
+	__pmLogLoadLazyInDom(idp);
 
     if (pmDebugOptions.logmeta) {
 	fprintf(stderr, "success for indom @ ");
@@ -1484,10 +1750,8 @@ pmLookupInDomArchive(pmInDom indom, const char *name)
 	}
 
 	for (idp = (__pmLogInDom *)hp->data; idp != NULL; idp = idp->next) {
-	    if (idp->isdelta) {
-		/* Need to "un-delta" this delta indom record */
-		__pmLogUndeltaInDom(indom, idp);
-	    }
+	    /* Need to "un-delta" (or load) this indom record */
+	    fullindom(indom, idp);
 	    /* full match */
 	    for (j = 0; j < idp->numinst; j++) {
 		if (strcmp(name, idp->namelist[j]) == 0) {
@@ -1542,10 +1806,8 @@ pmNameInDomArchive(pmInDom indom, int inst, char **name)
 	}
 
 	for (idp = (__pmLogInDom *)hp->data; idp != NULL; idp = idp->next) {
-	    if (idp->isdelta) {
-		/* Need to "un-delta" this delta indom record */
-		__pmLogUndeltaInDom(indom, idp);
-	    }
+	    /* Need to "un-delta" (or load) this indom record */
+	    fullindom(indom, idp);
 	    for (j = 0; j < idp->numinst; j++) {
 		if (idp->instlist[j] == inst) {
 		    if ((*name = strdup(idp->namelist[j])) == NULL)
@@ -1666,10 +1928,6 @@ pmGetInDomArchive_ctx(__pmContext *ctxp, pmInDom indom, int **instlist, char ***
     }
 
     for (idp = (__pmLogInDom *)hp->data; idp != NULL; idp = idp->next) {
-	if (idp->isdelta) {
-	    /* Need to "un-delta" this delta indom record */
-	    __pmLogUndeltaInDom(indom, idp);
-	}
 	if (idp->numinst > HASH_THRESHOLD) {
 	    big_indom = 1;
 	    reset_ihash();
@@ -1678,6 +1936,8 @@ pmGetInDomArchive_ctx(__pmContext *ctxp, pmInDom indom, int **instlist, char ***
     }
 
     for (idp = (__pmLogInDom *)hp->data; idp != NULL; idp = idp->next) {
+	/* Need to "un-delta" (or load) this indom record */
+	fullindom(indom, idp);
 	for (j = 0; j < idp->numinst; j++) {
 	    if (big_indom) {
 		/* big indom - use a hash table */
@@ -1807,9 +2067,9 @@ __pmPutTimeval(const __pmTimestamp *tsp, __int32_t *buf)
 void
 __pmFreeLogInDom(__pmLogInDom *lidp)
 {
-    if ((lidp->alloc & ~(PMLID_SELF|PMLID_INSTLIST|PMLID_NAMELIST|PMLID_NAMES)) != 0) {
+    if ((lidp->alloc & ~(PMLID_SELF|PMLID_INSTLIST|PMLID_NAMELIST|PMLID_NAMES|PMLID_LAZY|PMLID_RECORD)) != 0) {
 	fprintf(stderr, "__pmFreeLogInDom(%p): Warning: bogus alloc flags: 0x%x\n",
-		lidp, lidp->alloc & ~(PMLID_SELF|PMLID_INSTLIST|PMLID_NAMELIST|PMLID_NAMES));
+		lidp, lidp->alloc & ~(PMLID_SELF|PMLID_INSTLIST|PMLID_NAMELIST|PMLID_NAMES|PMLID_LAZY|PMLID_RECORD));
     }
 
     if (pmDebugOptions.indom) {
@@ -1890,6 +2150,7 @@ __pmDupLogInDom(__pmLogInDom *lidp)
     __pmLogInDom	*new;
     int			i;
 
+    __pmLogLoadLazyInDom(lidp);
     if ((new = (__pmLogInDom *)malloc(sizeof(__pmLogInDom))) == NULL) {
 	pmNoMem("__pmDupLogInDom base", sizeof(__pmLogInDom), PM_FATAL_ERR);
 	/*NOTREACHED*/
@@ -22,6 +22,7 @@
 #include <inttypes.h>
 #include <assert.h>
 #include <sys/stat.h>
+#include <fcntl.h>
 #include "pmapi.h"
 #include "libpcp.h"
 #include "internal.h"
@@ -48,6 +49,33 @@ typedef struct {
  */
 static __pmHashCtl	pc_hc;
 
+/*
+ * Compression suffix for data volumes created by __pmLogNewFile(),
+ * NULL for uncompressed volumes.  Set (once, before any archive is
+ * created) by __pmLogSetCompress().
+ */
+static const char	*vol_suffix;
+
+/*
+ * Block size for checksums of data volumes created by __pmLogNewFile(),
+ * 0 for none.  Set by __pmLogSetChecksum().
+ */
+static size_t		vol_cksum;
+
+/*
+ * Non-zero to write space accounting files for data volumes created
+ * by __pmLogNewFile().  Set by __pmLogSetSizes().
+ */
+static int		vol_sizes;
+
+/*
+ * Callback (and its argument) to be passed a copy of each record
+ * written to the metadata and data volumes created by __pmLogNewFile(),
+ * NULL for none.  Set by __pmLogSetTee().
+ */
+static __pmTeeCallBack	vol_tee;
+static void		*vol_tee_arg;
+
 static int LogCheckForNextArchive(__pmContext *, int, __pmResult **);
 static int LogChangeToNextArchive(__pmContext *);
 static int LogChangeToPreviousArchive(__pmContext *);
@@ -241,6 +269,68 @@ __pmLogName(const char *base, int vol)
     return __pmLogName_r(base, vol, tbuf, sizeof(tbuf));
 }
 
+/*
+ * Select compression (e.g. "gzip") for subsequently created data
+ * volumes, or NULL (or "none") for uncompressed data volumes.
+ *
+ * Each __pmFflush() of a compressed data volume ends a frame (a gzip
+ * member) that can be decompressed independently of the frames
+ * before it, so a writer that flushes the volume before writing the
+ * record a temporal index entry will refer to lets readers start
+ * decompression at exactly the offset in the temporal index.
+ */
+int
+__pmLogSetCompress(const char *method)
+{
+    const char	*suffix;
+
+    if (method == NULL || strcmp(method, "none") == 0) {
+	vol_suffix = NULL;
+	return 0;
+    }
+    if ((suffix = __pmCompressSuffix(method)) == NULL)
+	return -EOPNOTSUPP;
+    vol_suffix = suffix;
+    return 0;
+}
+
+/*
+ * Write checksums of each blocksize bytes (usually PM_LOG_CKSUM_BLOCKSIZE)
+ * for subsequently created data volumes, or none if blocksize is 0.  Checksums of volume <base>.<vol> are written to the
+ * checksum file <base>.<vol>.crc, see __pmFchecksum().
+ */
+int
+__pmLogSetChecksum(size_t blocksize)
+{
+    if (blocksize != 0 && blocksize < 512)
+	return -EINVAL;
+    vol_cksum = blocksize;
+    return 0;
+}
+
+/*
+ * Write per-metric space accounting for subsequently created data
+ * volumes (if on is non-zero), to the file <base>.<vol>.size when
+ * volume <base>.<vol> is closed, see __pmFlogsize().
+ */
+void
+__pmLogSetSizes(int on)
+{
+    vol_sizes = on;
+}
+
+/*
+ * Pass a copy of each record written to subsequently created metadata
+ * and data volumes to callback (or stop, if callback is NULL), see
+ * __pmFtee().
+ */
+void
+__pmLogSetTee(__pmTeeCallBack callback, void *arg)
+{
+    vol_tee = callback;
+    vol_tee_arg = arg;
+}
+
 __pmFILE *
 __pmLogNewFile(const char *base, int vol)
 {
@@ -249,6 +339,8 @@ __pmLogNewFile(const char *base, int vol)
     int		save_error;
 
     __pmLogName_r(base, vol, fname, sizeof(fname));
+    if (vol >= 0 && vol_suffix != NULL)
+	strncat(fname, vol_suffix, sizeof(fname) - strlen(fname) - 1);
 
     if (access(fname, R_OK) != -1) {
 	/* exists and readable ... */
@@ -283,6 +375,36 @@ __pmLogNewFile(const char *base, int vol)
 	return NULL;
     }
 
+    if (vol >= 0 && vol_cksum != 0) {
+	/* checksums are an aid to checking, so failure is not fatal */
+	__pmLogName_r(base, vol, fname, sizeof(fname));
+	strncat(fname, PM_LOG_CKSUM_SUFFIX, sizeof(fname) - strlen(fname) - 1);
+	if ((save_error = __pmFchecksum(f, fname, vol_cksum)) < 0) {
+	    char	errmsg[PM_MAXERRMSGLEN];
+	    pmprintf("__pmLogNewFile: failed to create \"%s\": %s\n", fname, pmErrStr_r(save_error, errmsg, sizeof(errmsg)));
+	    pmflush();
+	}
+    }
+
+    if (vol >= 0 && vol_sizes) {
+	/* likewise, space accounting is only an aid to pmlogsize(1) */
+	__pmLogName_r(base, vol, fname, sizeof(fname));
+	strncat(fname, PM_LOG_SIZE_SUFFIX, sizeof(fname) - strlen(fname) - 1);
+	if ((save_error = __pmFlogsize(f, fname)) < 0) {
+	    char	errmsg[PM_MAXERRMSGLEN];
+	    pmprintf("__pmLogNewFile: failed to create \"%s\": %s\n", fname, pmErrStr_r(save_error, errmsg, sizeof(errmsg)));
+	    pmflush();
+	}
+    }
+
+    if (vol >= PM_LOG_VOL_META && vol_tee != NULL) {
+	if ((save_error = __pmFtee(f, vol, vol_tee, vol_tee_arg)) < 0) {
+	    char	errmsg[PM_MAXERRMSGLEN];
+	    pmprintf("__pmLogNewFile: failed to copy records of \"%s\": %s\n", base, pmErrStr_r(save_error, errmsg, sizeof(errmsg)));
+	    pmflush();
+	}
+    }
+
     return f;
 }
 
@@ -301,6 +423,7 @@ __pmLogCreate(const char *host, const char *base, int log_version,
     lcp->hashlabels.nodes = lcp->hashlabels.hsize = 0;
     lcp->hashtext.nodes = lcp->hashtext.hsize = 0;
     lcp->tifp = lcp->mdfp = acp->ac_mfp = NULL;
+    lcp->metamap = NULL;
 
     if ((lcp->tifp = __pmLogNewFile(base, PM_LOG_VOL_TI)) != NULL) {
 	if ((lcp->mdfp = __pmLogNewFile(base, PM_LOG_VOL_META)) != NULL) {
@@ -377,12 +500,17 @@ logFreeHashInDom(__pmHashCtl *hcp)
 	for (hp = hcp->hash[i], prior_hp = NULL; hp != NULL; hp = hp->next) {
 	    for (idp = (__pmLogInDom *)hp->data, prior_idp = NULL;
 		idp != NULL; idp = idp->next) {
-		if ((idp->alloc & ~(PMLID_SELF|PMLID_INSTLIST|PMLID_NAMELIST|PMLID_NAMES)) != 0) {
+		if ((idp->alloc & ~(PMLID_SELF|PMLID_INSTLIST|PMLID_NAMELIST|PMLID_NAMES|PMLID_LAZY|PMLID_RECORD)) != 0) {
 		    fprintf(stderr, "logFreeHashInDom(%p): Warning: bogus alloc flags: 0x%x for idp=%p\n",
-			hcp, idp->alloc & ~(PMLID_SELF|PMLID_INSTLIST|PMLID_NAMELIST|PMLID_NAMES), idp);
+			hcp, idp->alloc & ~(PMLID_SELF|PMLID_INSTLIST|PMLID_NAMELIST|PMLID_NAMES|PMLID_LAZY|PMLID_RECORD), idp);
 		}
 
-		if (idp->buf != NULL)
+		/*
+		 * PMLID_LAZY => buf is in the mapped metadata file, unless
+		 * PMLID_RECORD
+		 */
+		if (idp->buf != NULL &&
+		    ((idp->alloc & PMLID_LAZY) == 0 || (idp->alloc & PMLID_RECORD)))
 		    free(idp->buf);
 		if (idp->numinst >= 0) {
 		    if (idp->alloc & PMLID_NAMES && idp->namelist != NULL) {
@@ -564,6 +692,9 @@ logFreeMeta(__pmLogCtl *lcp)
 
     if (lcp->hashtext.hsize != 0)
 	logFreeHashText(&lcp->hashtext);
+
+    /* after hashindom, PMLID_LAZY indoms point into these mappings */
+    __pmLogFreeMetaMaps(lcp);
 }
 
 /*
@@ -952,6 +1083,8 @@ logputresult(int version, __pmArchCtl *acp, __pmPDU *pb)
 	__pmLogWriteLabel(lcp->mdfp, &lcp->label);
 	lcp->label.vol = 0;
 	__pmLogWriteLabel(acp->ac_mfp, &lcp->label);
+	/* for a compressed data volume, the first frame is the label */
+	__pmFflush(acp->ac_mfp);
 	lcp->state = PM_LOG_STATE_INIT;
     }
 
@@ -1359,6 +1492,78 @@ __pmLogWriteMark(__pmArchCtl *acp, const __pmTimestamp *last_stamp, const __pmTi
     return sts;
 }
 
+/*
+ * Multi-archive contexts ... as replay approaches the boundary with the
+ * adjacent archive (the next one reading forwards, the previous one
+ * reading backwards), ask the kernel to read that archive's metadata,
+ * temporal index and first data volume in the background, so the
+ * __pmLogOpen() and __pmLogLoadMeta() at the boundary find them in
+ * the page cache instead of stalling on disk reads.
+ *
+ * "Approaching" means within the last (or first, reading backwards)
+ * 1/PREFETCH_SPLIT of the time between the start of the current archive
+ * and the start of the adjacent one.
+ */
+#define PREFETCH_SPLIT	10
+
+static void
+LogPrefetchFile(const char *base, const char *suffix)
+{
+#ifdef POSIX_FADV_WILLNEED
+    char	fname[MAXPATHLEN];
+    int		fd;
+
+    pmsprintf(fname, sizeof(fname), "%s.%s", base, suffix);
+    if (access(fname, R_OK) < 0 &&
+	__pmCompressedFileIndex(fname, sizeof(fname)) < 0)
+	return;
+    if ((fd = open(fname, O_RDONLY)) < 0)
+	return;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    close(fd);
+    if (pmDebugOptions.log)
+	fprintf(stderr, "LogPrefetch: %s\n", fname);
+#else
+    (void)base;
+    (void)suffix;
+#endif
+}
+
+static void
+LogPrefetch(__pmContext *ctxp, int mode, const __pmTimestamp *stamp)
+{
+    __pmArchCtl		*acp = ctxp->c_archctl;
+    __pmMultiLogCtl	*cur;
+    __pmMultiLogCtl	*adj;
+    double		span;
+    double		left;
+    int			arch;
+
+    if (acp->ac_num_logs < 2)
+	return;
+    arch = mode == PM_MODE_BACK ? acp->ac_cur_log - 1 : acp->ac_cur_log + 1;
+    if (arch < 0 || arch >= acp->ac_num_logs || acp->ac_prefetch == arch + 1)
+	return;
+
+    cur = acp->ac_log_list[acp->ac_cur_log];
+    adj = acp->ac_log_list[arch];
+    if (mode == PM_MODE_BACK) {
+	span = __pmTimestampSub(&cur->starttime, &adj->starttime);
+	left = __pmTimestampSub(stamp, &cur->starttime);
+    }
+    else {
+	span = __pmTimestampSub(&adj->starttime, &cur->starttime);
+	left = __pmTimestampSub(&adj->starttime, stamp);
+    }
+    if (left * PREFETCH_SPLIT > span)
+	return;
+
+    acp->ac_prefetch = arch + 1;
+    LogPrefetchFile(adj->name, "meta");
+    LogPrefetchFile(adj->name, "index");
+    LogPrefetchFile(adj->name, "0");
+}
+
 /*
  * read next forward or backward from the log
  *
@@ -1370,9 +1575,15 @@ __pmLogWriteMark(__pmArchCtl *acp, const __pmTimestamp *last_stamp, const __pmTi
  * Internal variant of __pmLogRead() ... using a __pmContext * instead
  * of a __pmLogCtl * as the first argument so that the current context
  * can be carried down the call stack.
+ *
+ * If nfilter > 0, only the pmValueSets for the metrics in filter[] are
+ * decoded and returned ... records that contain none of them are not
+ * decoded at all, and are returned as a result with the record's
+ * timestamp and no pmValueSets (like a <mark> record) and a return
+ * value of 1 (rather than 0) to tell the two apart.
  */
-int
-__pmLogRead_ctx(__pmContext *ctxp, int mode, __pmFILE *peekf, __pmResult **result, int option)
+static int
+LogReadFilter_ctx(__pmContext *ctxp, int mode, __pmFILE *peekf, __pmResult **result, int option, int nfilter, pmID *filter)
 {
     __pmLogCtl	*lcp;
     __pmArchCtl	*acp;
@@ -1693,6 +1904,38 @@ again:
 	__pmFseek(f, -(long)sizeof(trail), SEEK_CUR);
 
     __pmOverrideLastFd(__pmFileno(f));
+
+    if (nfilter > 0) {
+	__pmTimestamp	stamp;
+	__pmPDU		*subset;
+
+	sts = __pmLogResultFilter(version, pb, nfilter, filter, &stamp, &subset);
+	if (sts == 0) {
+	    __pmUnpinPDUBuf(pb);
+	    if ((*result = __pmAllocResult(0)) == NULL) {
+		sts = -oserror();
+		goto func_return;
+	    }
+	    (*result)->numpmid = 0;
+	    (*result)->timestamp = stamp;	/* struct assignment */
+	    if (pmDebugOptions.log) {
+		fprintf(stderr, "@");
+		__pmPrintTimestamp(stderr, &stamp);
+		fprintf(stderr, " filtered\n");
+	    }
+	    /* exported to indicate how efficient we are ... */
+	    __pmLogReads++;
+	    sts = 1;
+	    goto func_return;
+	}
+	if (sts > 0 && subset != NULL) {
+	    /* decode just the requested metrics */
+	    __pmUnpinPDUBuf(pb);
+	    pb = subset;
+	    rlen = pb[0] - (int)sizeof(__pmPDUHdr);
+	}
+    }
+
     sts = __pmDecodeResult_ctx(ctxp, pb, result); /* also swabs the result */
 
     if (pmDebugOptions.log) {
@@ -1733,6 +1976,8 @@ again:
     sts = 0;
 
 func_return:
+    if (sts == 0 && peekf == NULL && *result != NULL)
+	LogPrefetch(ctxp, mode, &(*result)->timestamp);
 
     if (ctx_ctl.need_ctx_unlock)
 	PM_UNLOCK(ctx_ctl.ctxp->c_lock);
@@ -1740,6 +1985,12 @@ func_return:
     return sts;
 }
 
+int
+__pmLogRead_ctx(__pmContext *ctxp, int mode, __pmFILE *peekf, __pmResult **result, int option)
+{
+    return LogReadFilter_ctx(ctxp, mode, peekf, result, option, 0, NULL);
+}
+
 int
 __pmLogRead(__pmArchCtl *acp, int mode, __pmFILE *peekf, __pmResult **result, int option)
 {
@@ -1780,8 +2031,14 @@ check_all_derived(int numpmid, pmID pmidlist[])
     return 1;
 }
 
-int
-__pmLogFetch(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult **result)
+/*
+ * Fetch the next record for pmFetch (numpmid > 0) or pmFetchArchive
+ * (numpmid == 0).  Records without any of the nfilter metrics in filter[]
+ * are skipped, and only those metrics are decoded from the others, so
+ * for pmFetch filter[] is usually pmidlist[].
+ */
+static int
+LogFetch(__pmContext *ctxp, int numpmid, pmID pmidlist[], int nfilter, pmID *filter, __pmResult **result)
 {
     int		i;
     int		j;
@@ -1798,6 +2055,7 @@ __pmLogFetch(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult **resul
     int		nskip;
     __pmTimestamp	tmp;
     int		ctxp_mode;
+    int		filtered = 0;
     ctx_ctl_t	ctx_ctl = { NULL, 0 };
 
     sts = lock_ctx(ctxp, &ctx_ctl);
@@ -1807,7 +2065,10 @@ __pmLogFetch(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult **resul
     ctxp_mode = ctxp->c_mode & __PM_MODE_MASK;
 
     if (ctxp_mode == PM_MODE_INTERP) {
-	sts = __pmLogFetchInterp(ctxp, numpmid, pmidlist, result);
+	if (numpmid == 0 && nfilter > 0)
+	    sts = PM_ERR_MODE;
+	else
+	    sts = __pmLogFetchInterp(ctxp, numpmid, pmidlist, result);
 	goto func_return;
     }
 
@@ -1893,8 +2154,11 @@ more:
 	    }
 	    nskip = 0;
 	}
-	if ((sts = __pmLogRead_ctx(ctxp, ctxp->c_mode, NULL, result, PMLOGREAD_NEXT)) < 0)
+	if ((sts = LogReadFilter_ctx(ctxp, ctxp->c_mode, NULL, result, PMLOGREAD_NEXT, nfilter, filter)) < 0)
 	    break;
+	/* 1 => none of the filter[] metrics, returned like a <mark> */
+	filtered = (sts == 1);
+	sts = 0;
 	tmp = (*result)->timestamp;
 	tdiff = __pmTimestampSub(&tmp, &ctxp->c_origin);
 	if ((tdiff < 0 && ctxp_mode == PM_MODE_FORW) ||
@@ -1927,9 +2191,9 @@ more:
 	/*
 	 * mark record, and not interpolating ...
 	 * if pmFetchArchive(), return it
-	 * otherwise keep searching
+	 * otherwise (or if it is really a filtered record) keep searching
 	 */
-	if (numpmid != 0) {
+	if (numpmid != 0 || filtered) {
 	    __pmFreeResult(*result);
 	    goto more;
 	}
@@ -2084,6 +2348,33 @@ func_return:
     return sts;
 }
 
+int
+__pmLogFetch(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult **result)
+{
+    /*
+     * records without any of the requested metrics are skipped, so
+     * don't bother decoding them (unless all are derived metrics,
+     * when any record will do)
+     */
+    if (check_all_derived(numpmid, pmidlist))
+	return LogFetch(ctxp, numpmid, pmidlist, 0, NULL, result);
+    return LogFetch(ctxp, numpmid, pmidlist, numpmid, pmidlist, result);
+}
+
+/*
+ * Like __pmLogFetch() for pmFetchArchive(), returning each record in
+ * turn including <mark> records, except that records holding none of
+ * the metrics in filter[] are skipped and only the pmValueSets for
+ * those metrics are decoded (and returned) from the others.
+ */
+int
+__pmLogFetchFilter(__pmContext *ctxp, int nfilter, pmID *filter, __pmResult **result)
+{
+    if (nfilter <= 0)
+	return PM_ERR_TOOSMALL;
+    return LogFetch(ctxp, 0, NULL, nfilter, filter, result);
+}
+
 /*
  * error handling wrappers around __pmLogChangeVol() to deal with
  * missing volumes ... return lcp->ti[] index for entry matching
@@ -2121,6 +2412,113 @@ VolSkip(__pmArchCtl *acp, int mode, int j)
     return PM_ERR_EOL;
 }
 
+/*
+ * Size of the last volume, for the truncated index entry checks in
+ * TIFind() ... note this uses the current volume if the last volume
+ * has been opened already.
+ */
+static off_t
+LastVolSize(__pmArchCtl *acp)
+{
+    __pmLogCtl	*lcp = acp->ac_log;
+    __pmFILE	*f;
+    struct stat	sbuf;
+    int		vol = lcp->maxvol;
+
+    sbuf.st_size = 0;
+    if (vol >= 0 && vol < lcp->numseen && lcp->seen[vol])
+	__pmFstat(acp->ac_mfp, &sbuf);
+    else if ((f = _logpeek(acp, lcp->maxvol)) != NULL) {
+	__pmFstat(f, &sbuf);
+	__pmFclose(f);
+    }
+    return sbuf.st_size;
+}
+
+/*
+ * Return the lcp->ti[] index of the first temporal index entry at or
+ * after origin (*match set if the timestamp is equal), skipping entries
+ * for missing preliminary volumes.  An entry beyond the end of a
+ * truncated last volume stops the search, with *toobig set.  Returns
+ * lcp->numti if every usable entry is before origin.
+ *
+ * If the index is in time, volume and offset order (as written by
+ * pmlogger) each boundary is found with a binary search, otherwise
+ * the index is scanned linearly.
+ */
+static int
+TIFind(__pmArchCtl *acp, const __pmTimestamp *origin, int *match, int *toobig)
+{
+    __pmLogCtl	*lcp = acp->ac_log;
+    __pmLogTI	*tip;
+    int		numti = lcp->numti;
+    int		lo, hi, mid;
+    int		end;
+    int		cmp;
+    off_t	size = -1;
+
+    *match = *toobig = 0;
+
+    if (!lcp->tisorted || lcp->ti[numti-1].vol > lcp->maxvol) {
+	for (lo = 0, tip = lcp->ti; lo < numti; lo++, tip++) {
+	    if (tip->vol < lcp->minvol)
+		/* skip missing preliminary volumes */
+		continue;
+	    if (tip->vol == lcp->maxvol) {
+		/* truncated check for last volume */
+		if (size < 0)
+		    size = LastVolSize(acp);
+		if (tip->off_data > size) {
+		    *toobig = 1;
+		    break;
+		}
+	    }
+	    if ((cmp = __pmTimestampCmp(&tip->stamp, origin)) >= 0) {
+		*match = (cmp == 0);
+		break;
+	    }
+	}
+	return lo;
+    }
+
+    /* truncated check for last volume */
+    end = numti;
+    if (lcp->ti[numti-1].vol == lcp->maxvol) {
+	size = LastVolSize(acp);
+	for (lo = 0, hi = numti; lo < hi; ) {
+	    mid = lo + (hi - lo) / 2;
+	    if (lcp->ti[mid].vol == lcp->maxvol && lcp->ti[mid].off_data > size)
+		hi = mid;
+	    else
+		lo = mid + 1;
+	}
+	end = lo;
+    }
+
+    /* skip missing preliminary volumes */
+    for (lo = 0, hi = end; lo < hi; ) {
+	mid = lo + (hi - lo) / 2;
+	if (lcp->ti[mid].vol < lcp->minvol)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+
+    /* first entry at or after origin */
+    for (hi = end; lo < hi; ) {
+	mid = lo + (hi - lo) / 2;
+	if (__pmTimestampCmp(&lcp->ti[mid].stamp, origin) < 0)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    if (lo < end)
+	*match = (__pmTimestampCmp(&lcp->ti[lo].stamp, origin) == 0);
+    else if (end < numti)
+	*toobig = 1;
+    return lo;
+}
+
 int
 __pmLogSetTime(__pmContext *ctxp)
 {
@@ -2178,58 +2576,15 @@ __pmLogSetTime(__pmContext *ctxp)
 
     if (lcp->numti) {
 	/* we have a temporal index, use it! */
-	int		j = -1;
+	int		j;
 	int		try;
-	int		toobig = 0;
-	int		match = 0;
-	int		tivol;
-	int		vol;
+	int		toobig;
+	int		match;
 	int		numti = lcp->numti;
 	off_t		tilog;
-	__pmFILE	*f;
-	__pmLogTI	*tip = lcp->ti;
 	double		t_lo;
-	struct stat	sbuf;
-
-	sbuf.st_size = -1;
 
-	for (i = 0; i < numti; i++, tip++) {
-	    tivol = tip->vol;
-	    tilog = tip->off_data;
-	    if (tivol < lcp->minvol)
-		/* skip missing preliminary volumes */
-		continue;
-	    if (tivol == lcp->maxvol) {
-		/* truncated check for last volume */
-		if (sbuf.st_size < 0) {
-		    sbuf.st_size = 0;
-		    vol = lcp->maxvol;
-		    if (vol >= 0 && vol < lcp->numseen && lcp->seen[vol])
-			__pmFstat(acp->ac_mfp, &sbuf);
-		    else if ((f = _logpeek(acp, lcp->maxvol)) != NULL) {
-			__pmFstat(f, &sbuf);
-			__pmFclose(f);
-		    }
-		}
-		if (tilog > sbuf.st_size) {
-		    j = i;
-		    toobig++;
-		    break;
-		}
-	    }
-	    t_hi = __pmTimestampSub(&tip->stamp, &ctxp->c_origin);
-	    if (t_hi > 0) {
-		j = i;
-		break;
-	    }
-	    else if (t_hi == 0) {
-		j = i;
-		match = 1;
-		break;
-	    }
-	}
-	if (i == numti)
-	    j = numti;
+	j = TIFind(acp, &ctxp->c_origin, &match, &toobig);
 
 	acp->ac_serial = 1;
 
@@ -3185,6 +3540,8 @@ __pmArchCtlFree(__pmArchCtl *acp)
     /* And the cache. */
     if (acp->ac_cache != NULL)
 	free(acp->ac_cache);
+    if (acp->ac_memctl != NULL)
+	free(acp->ac_memctl);
 
     if (acp->ac_mfp != NULL) {
 	__pmResetIPC(__pmFileno(acp->ac_mfp));
@@ -0,0 +1,297 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * Client-side cache of PMNS name to PMID and PMID to pmDesc lookups
+ * for PM_CONTEXT_HOST contexts.
+ *
+ * A pmLookupName() or pmLookupDesc() against a remote pmcd is a PDU
+ * round trip, and many clients repeat the same lookups (re-resolving
+ * metrics after a reconnect, derived metric binding, libraries layered
+ * on each other that each look the metrics up again).  Successful
+ * answers from pmcd are remembered per context, and served from here
+ * for as long as pmcd has not told us that its namespace or agents
+ * have changed.
+ *
+ * The cache is flushed when a fetch returns with PMCD_NAMES_CHANGE or
+ * PMCD_AGENT_CHANGE set, when the context is reconnected, and when
+ * the context is destroyed.  Failed lookups are never cached, so new
+ * names are always seen.  Setting $PCP_LOOKUP_CACHE to 0 disables it.
+ *
+ * pmTraversePMNS() on a context with the cache enabled asks pmcd for
+ * a PDU_PMNS_NAMEDESCS reply and seeds the cache from it, so the usual
+ * traverse, then lookup names, then lookup descriptors sequence costs
+ * one round trip rather than three or more.
+ *
+ * Setting $PCP_FETCH_METADATA as well asks pmcd (PDU_FLAG_METADATA)
+ * to send the descriptor of each metric ahead of the first result
+ * it appears in on this connection, and the instances of its indom.
+ * The descriptors are cached here like any other.  Instances change
+ * over time, so those are only kept until the next fetch and are
+ * handed to the first pmGetInDom() that asks for them - this covers
+ * the usual fetch, then describe the new metrics sequence of clients
+ * like the libpcp_web series loader.
+ *
+ * All routines are called with the context locked.
+ */
+
+#include "pmapi.h"
+#include "libpcp.h"
+#include "internal.h"
+
+/* bound on the cache size, well above the size of any real PMNS */
+#define MAXNAMES	65536
+
+typedef struct {
+    pmID	pmid;
+    char	name[1];	/* actually strlen(name)+1 */
+} namecache_t;
+
+typedef struct {
+    __pmHashCtl	names;		/* hash of name -> namecache_t */
+    __pmHashCtl	descs;		/* pmid -> pmDesc */
+    __pmHashCtl	indoms;		/* indom -> pmInResult, until next fetch */
+} lookupcache_t;
+
+/* -1 => not yet initialized, else 0 (disabled) or 1 (enabled) */
+static int	cache_enabled = -1;
+static int	fetch_metadata;
+
+static int
+setting(void)
+{
+    char	*str;
+    int		sts;
+
+    PM_LOCK(__pmLock_extcall);
+    if (cache_enabled < 0) {
+	/* one-trip initialization */
+	str = getenv("PCP_LOOKUP_CACHE");	/* THREADSAFE */
+	cache_enabled = (str == NULL || strcmp(str, "0") != 0);
+	str = getenv("PCP_FETCH_METADATA");	/* THREADSAFE */
+	fetch_metadata = (str != NULL && strcmp(str, "0") != 0);
+    }
+    sts = cache_enabled;
+    PM_UNLOCK(__pmLock_extcall);
+    return sts;
+}
+
+static int
+enabled(__pmContext *ctxp)
+{
+    if (ctxp->c_type != PM_CONTEXT_HOST)
+	return 0;
+    return setting();
+}
+
+/* should pmcd be asked for metadata ahead of fetch results? */
+int
+__pmLookupCacheMetadata(void)
+{
+    return setting() && fetch_metadata;
+}
+
+int
+__pmLookupCacheEnabled(__pmContext *ctxp)
+{
+    return enabled(ctxp);
+}
+
+/* FNV-1a */
+static unsigned int
+hashname(const char *name)
+{
+    unsigned int	h = 2166136261U;
+
+    while (*name)
+	h = (h ^ (unsigned char)*name++) * 16777619U;
+    return h;
+}
+
+static lookupcache_t *
+getcache(__pmContext *ctxp, int create)
+{
+    lookupcache_t	*cp = (lookupcache_t *)ctxp->c_lookup;
+
+    PM_ASSERT_IS_LOCKED(ctxp->c_lock);
+
+    if (cp == NULL && create && enabled(ctxp)) {
+	if ((cp = (lookupcache_t *)calloc(1, sizeof(*cp))) != NULL)
+	    ctxp->c_lookup = cp;
+    }
+    return cp;
+}
+
+int
+__pmLookupCacheName(__pmContext *ctxp, const char *name, pmID *pmidp)
+{
+    lookupcache_t	*cp;
+    __pmHashNode	*hp;
+    namecache_t		*np;
+    unsigned int	key;
+
+    if ((cp = getcache(ctxp, 0)) == NULL)
+	return 0;
+    key = hashname(name);
+    for (hp = __pmHashSearch(key, &cp->names); hp != NULL; hp = hp->next) {
+	if (hp->key != key)
+	    continue;
+	np = (namecache_t *)hp->data;
+	if (strcmp(np->name, name) == 0) {
+	    *pmidp = np->pmid;
+	    return 1;
+	}
+    }
+    return 0;
+}
+
+void
+__pmLookupCacheAddName(__pmContext *ctxp, const char *name, pmID pmid)
+{
+    lookupcache_t	*cp;
+    namecache_t		*np;
+    size_t		len;
+    pmID		cached;
+
+    if (pmid == PM_ID_NULL || (cp = getcache(ctxp, 1)) == NULL)
+	return;
+    if (cp->names.nodes >= MAXNAMES ||
+	__pmLookupCacheName(ctxp, name, &cached))
+	return;
+    len = strlen(name);
+    if ((np = (namecache_t *)malloc(sizeof(*np) + len)) == NULL)
+	return;
+    np->pmid = pmid;
+    memcpy(np->name, name, len + 1);
+    if (__pmHashAdd(hashname(name), np, &cp->names) < 0)
+	free(np);
+}
+
+int
+__pmLookupCacheDesc(__pmContext *ctxp, pmID pmid, pmDesc *desc)
+{
+    lookupcache_t	*cp;
+    __pmHashNode	*hp;
+
+    if ((cp = getcache(ctxp, 0)) == NULL || IS_DERIVED(pmid))
+	return 0;
+    if ((hp = __pmHashSearch(pmid, &cp->descs)) == NULL)
+	return 0;
+    *desc = *(pmDesc *)hp->data;
+    return 1;
+}
+
+void
+__pmLookupCacheAddDesc(__pmContext *ctxp, const pmDesc *desc)
+{
+    lookupcache_t	*cp;
+    pmDesc		*dp;
+
+    if (desc->pmid == PM_ID_NULL || IS_DERIVED(desc->pmid) ||
+	(cp = getcache(ctxp, 1)) == NULL)
+	return;
+    if (cp->descs.nodes >= MAXNAMES ||
+	__pmHashSearch(desc->pmid, &cp->descs) != NULL)
+	return;
+    if ((dp = (pmDesc *)malloc(sizeof(*dp))) == NULL)
+	return;
+    *dp = *desc;
+    if (__pmHashAdd(desc->pmid, dp, &cp->descs) < 0)
+	free(dp);
+}
+
+void
+__pmLookupCacheAddInDom(__pmContext *ctxp, pmInResult *inresult)
+{
+    lookupcache_t	*cp;
+    __pmHashNode	*hp;
+
+    if ((cp = getcache(ctxp, 1)) == NULL) {
+	__pmFreeInResult(inresult);
+	return;
+    }
+    if ((hp = __pmHashSearch(inresult->indom, &cp->indoms)) != NULL) {
+	__pmFreeInResult((pmInResult *)hp->data);
+	hp->data = inresult;
+    }
+    else if (__pmHashAdd(inresult->indom, inresult, &cp->indoms) < 0)
+	__pmFreeInResult(inresult);
+}
+
+/* caller takes ownership of (and frees) any instances returned */
+pmInResult *
+__pmLookupCacheTakeInDom(__pmContext *ctxp, pmInDom indom)
+{
+    lookupcache_t	*cp;
+    __pmHashNode	*hp;
+    pmInResult		*inresult;
+
+    if ((cp = getcache(ctxp, 0)) == NULL)
+	return NULL;
+    if ((hp = __pmHashSearch(indom, &cp->indoms)) == NULL)
+	return NULL;
+    inresult = (pmInResult *)hp->data;
+    __pmHashDel(indom, inresult, &cp->indoms);
+    return inresult;
+}
+
+static void
+freeindoms(__pmHashCtl *hcp)
+{
+    __pmHashNode	*hp;
+    int			i;
+
+    for (i = 0; i < hcp->hsize; i++)
+	for (hp = hcp->hash[i]; hp != NULL; hp = hp->next)
+	    __pmFreeInResult((pmInResult *)hp->data);
+    __pmHashFree(hcp);
+    hcp->nodes = 0;
+}
+
+/* instances sent with the last fetch are stale once the next is sent */
+void
+__pmLookupCacheDropInDoms(__pmContext *ctxp)
+{
+    lookupcache_t	*cp = (lookupcache_t *)ctxp->c_lookup;
+
+    if (cp != NULL && cp->indoms.nodes > 0)
+	freeindoms(&cp->indoms);
+}
+
+static void
+freedata(__pmHashCtl *hcp)
+{
+    __pmHashNode	*hp;
+    int			i;
+
+    for (i = 0; i < hcp->hsize; i++)
+	for (hp = hcp->hash[i]; hp != NULL; hp = hp->next)
+	    free(hp->data);
+    __pmHashFree(hcp);
+}
+
+void
+__pmLookupCacheFlush(__pmContext *ctxp)
+{
+    lookupcache_t	*cp = (lookupcache_t *)ctxp->c_lookup;
+
+    if (cp == NULL)
+	return;
+    if (pmDebugOptions.pmns || pmDebugOptions.context)
+	fprintf(stderr, "__pmLookupCacheFlush(%d): %d names, %d descs\n",
+		ctxp->c_handle, cp->names.nodes, cp->descs.nodes);
+    freedata(&cp->names);
+    freedata(&cp->descs);
+    freeindoms(&cp->indoms);
+    free(cp);
+    ctxp->c_lookup = NULL;
+}
@@ -0,0 +1,473 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * Metadata index, an optional sidecar file (<base>.midx) for the
+ * metadata file (<base>.meta) of an archive.
+ *
+ * For archives with large instance domains that change often, most of
+ * the metadata file is instance domain records and decoding all of
+ * them in __pmLogLoadMeta() dominates the time and memory needed to
+ * open the archive.  The index has one fixed size entry for each
+ * instance domain record in the metadata file, with the offset and
+ * length of the record and just the fields needed to place the record
+ * in lcp->hashindom (indom, timestamp and number of instances).  When
+ * the index can be trusted, __pmLogLoadMeta() skips over the instance
+ * domain records and adds a PMLID_LAZY __pmLogInDom for each of them
+ * that refers to the record in a mapping of the metadata file, and
+ * the instances are only decoded when they are first needed, see
+ * __pmLogLoadLazyInDom().  All other metadata records are loaded as
+ * before.
+ *
+ * The index is only trusted if it was built from this metadata file
+ * (same inode and device and the same archive label), and then only
+ * for the part of the metadata file that existed when the index was
+ * built ... anything appended since (e.g. by a pmlogger that is still
+ * running) is loaded in the usual way.
+ *
+ * The .midx suffix is deliberately not one that __pmLogBaseName()
+ * recognizes, so the index is not mistaken for part of the archive.
+ *
+ * On-disk format, all fields in network byte order
+ *	header:	magic, version, inode[2], device[2], metalen[2], nentry,
+ *		label[MIDX_LABEL] (the start of the metadata file)
+ *	nentry entries: offset[2], len, type, timestamp[3], indom, numinst
+ */
+#include <sys/types.h>
+#include <sys/stat.h>
+#if !defined(IS_MINGW)
+#include <sys/mman.h>
+#endif
+#include <fcntl.h>
+#include <unistd.h>
+#include "pmapi.h"
+#include "libpcp.h"
+#include "internal.h"
+
+#define MIDX_MAGIC	0x50434d49	/* "PCMI" */
+#define MIDX_VERSION	1
+#define MIDX_LABEL	8		/* 32-bit words of label compared */
+
+typedef struct {
+    __int32_t	magic;
+    __int32_t	version;
+    __uint32_t	ino[2];
+    __uint32_t	dev[2];
+    __uint32_t	metalen[2];		/* bytes of .meta indexed */
+    __int32_t	nentry;
+    __int32_t	label[MIDX_LABEL];
+} midx_hdr_t;
+
+typedef struct {
+    __uint32_t	off[2];
+    __int32_t	len;
+    __int32_t	type;
+    __int32_t	stamp[3];		/* __pmPutTimestamp() format */
+    __int32_t	indom;
+    __int32_t	numinst;
+} midx_entry_t;
+
+static void
+put64(__uint64_t val, __uint32_t *buf)
+{
+    buf[0] = htonl((__uint32_t)(val >> 32));
+    buf[1] = htonl((__uint32_t)(val & 0xffffffff));
+}
+
+static __uint64_t
+get64(const __uint32_t *buf)
+{
+    return ((__uint64_t)ntohl(buf[0]) << 32) | ntohl(buf[1]);
+}
+
+/*
+ * Build the index for the metadata file of the archive with base name
+ * base ... the metadata file must not be compressed.  A truncated or
+ * corrupt record ends the index, so an archive being written (or
+ * damaged) is still indexed up to the last good record.
+ */
+int
+__pmLogWriteMetaIndex(const char *base)
+{
+    char		path[MAXPATHLEN];
+    char		tmppath[MAXPATHLEN];
+    FILE		*mf;
+    FILE		*xf;
+    struct stat		sbuf;
+    midx_hdr_t		hdr;
+    midx_entry_t	entry;
+    __pmLogHdr		h;
+    __int32_t		rec[5];
+    __int32_t		check;
+    __pmTimestamp	stamp;
+    off_t		off;
+    int			len;
+    int			type;
+    int			need;
+    int			nentry = 0;
+    int			sts = 0;
+
+    pmsprintf(path, sizeof(path), "%s.meta", base);
+    if ((mf = fopen(path, "r")) == NULL)
+	return -oserror();
+    if (fstat(fileno(mf), &sbuf) < 0) {
+	sts = -oserror();
+	fclose(mf);
+	return sts;
+    }
+    memset(&hdr, 0, sizeof(hdr));
+    if (fread(hdr.label, 1, sizeof(hdr.label), mf) != sizeof(hdr.label) ||
+	(ntohl(hdr.label[1]) & 0xffffff00) != PM_LOG_MAGIC) {
+	fclose(mf);
+	return PM_ERR_LABEL;
+    }
+
+    pmsprintf(tmppath, sizeof(tmppath), "%s.midx.tmp", base);
+    if ((xf = fopen(tmppath, "w")) == NULL) {
+	sts = -oserror();
+	fclose(mf);
+	return sts;
+    }
+    /* header is rewritten with the final counts at the end */
+    if (fwrite(&hdr, 1, sizeof(hdr), xf) != sizeof(hdr))
+	goto bad;
+
+    /* first record after the label record */
+    off = ntohl(hdr.label[0]);
+    for ( ; ; ) {
+	if (fseeko(mf, off, SEEK_SET) < 0 ||
+	    fread(&h, 1, sizeof(h), mf) != sizeof(h))
+	    break;
+	len = ntohl(h.len);
+	type = ntohl(h.type);
+	if (len < (int)(sizeof(h) + sizeof(check)) || off + len > sbuf.st_size)
+	    break;
+	if (type == TYPE_INDOM || type == TYPE_INDOM_DELTA || type == TYPE_INDOM_V2) {
+	    /* timestamp (3 or 2 words), indom, numinst */
+	    need = (type == TYPE_INDOM_V2) ? 4 : 5;
+	    if (len < (int)(sizeof(h) + need * sizeof(rec[0]) + sizeof(check)) ||
+		fread(rec, sizeof(rec[0]), need, mf) != need)
+		break;
+	    if (type == TYPE_INDOM_V2)
+		__pmLoadTimeval(&rec[0], &stamp);
+	    else
+		__pmLoadTimestamp(&rec[0], &stamp);
+	    put64((__uint64_t)off, entry.off);
+	    entry.len = h.len;
+	    entry.type = h.type;
+	    __pmPutTimestamp(&stamp, entry.stamp);
+	    entry.indom = rec[need-2];
+	    entry.numinst = rec[need-1];
+	}
+	if (fseeko(mf, off + len - sizeof(check), SEEK_SET) < 0 ||
+	    fread(&check, 1, sizeof(check), mf) != sizeof(check) ||
+	    ntohl(check) != len)
+	    break;
+	if (type == TYPE_INDOM || type == TYPE_INDOM_DELTA || type == TYPE_INDOM_V2) {
+	    if (fwrite(&entry, 1, sizeof(entry), xf) != sizeof(entry))
+		goto bad;
+	    nentry++;
+	}
+	off += len;
+    }
+
+    hdr.magic = htonl(MIDX_MAGIC);
+    hdr.version = htonl(MIDX_VERSION);
+    put64((__uint64_t)sbuf.st_ino, hdr.ino);
+    put64((__uint64_t)sbuf.st_dev, hdr.dev);
+    put64((__uint64_t)off, hdr.metalen);
+    hdr.nentry = htonl(nentry);
+    if (fseek(xf, 0L, SEEK_SET) < 0 ||
+	fwrite(&hdr, 1, sizeof(hdr), xf) != sizeof(hdr) ||
+	fflush(xf) != 0)
+	goto bad;
+    fclose(xf);
+    fclose(mf);
+
+    pmsprintf(path, sizeof(path), "%s.midx", base);
+    if (rename(tmppath, path) < 0) {
+	sts = -oserror();
+	unlink(tmppath);
+	return sts;
+    }
+    if (pmDebugOptions.logmeta)
+	fprintf(stderr, "__pmLogWriteMetaIndex(%s): %d indom records in %lld bytes\n",
+		base, nentry, (long long)off);
+    return 0;
+
+bad:
+    sts = -oserror();
+    fclose(xf);
+    fclose(mf);
+    unlink(tmppath);
+    return sts;
+}
+
+#if !defined(IS_MINGW)
+struct __pmLogMetaIndex {
+    char		*idx;		/* mapped .midx file */
+    size_t		idxlen;
+    const char		*meta;		/* mapped .meta file */
+    off_t		metalen;	/* bytes of .meta indexed */
+    int			nentry;
+    int			next;		/* next entry to be used */
+};
+
+typedef struct metamap {
+    struct metamap	*next;
+    void		*addr;
+    size_t		len;
+} metamap_t;
+
+static void
+midx_entry(const struct __pmLogMetaIndex *mip, int i, midx_entry_t *ep)
+{
+    memcpy(ep, &mip->idx[sizeof(midx_hdr_t) + i * sizeof(midx_entry_t)], sizeof(*ep));
+}
+
+/*
+ * Open and check the index for the metadata file lcp->mdfp ... returns
+ * NULL if there is no index or it cannot be trusted.  On success the
+ * metadata file is mapped, and the mapping is kept until
+ * __pmLogFreeMetaMaps() because the PMLID_LAZY __pmLogInDom records
+ * refer to it.
+ */
+struct __pmLogMetaIndex *
+__pmLogOpenMetaIndex(__pmLogCtl *lcp)
+{
+    struct __pmLogMetaIndex	*mip;
+    char		path[MAXPATHLEN];
+    struct stat		sbuf;
+    struct stat		mbuf;
+    midx_hdr_t		hdr;
+    midx_entry_t	last;
+    metamap_t		*mmp;
+    char		*idx;
+    char		*meta;
+    off_t		metalen;
+    off_t		off;
+    __int32_t		check;
+    int			nentry;
+    int			fd;
+    const char		*why;
+
+    if (lcp->name == NULL || lcp->mdfp == NULL)
+	return NULL;
+    pmsprintf(path, sizeof(path), "%s.midx", lcp->name);
+    if ((fd = open(path, O_RDONLY)) < 0)
+	return NULL;
+    if (fstat(fd, &sbuf) < 0 || sbuf.st_size < (off_t)sizeof(hdr)) {
+	close(fd);
+	why = "too short";
+	goto untrusted;
+    }
+    idx = mmap(NULL, (size_t)sbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (idx == MAP_FAILED) {
+	why = "mmap failed";
+	goto untrusted;
+    }
+    memcpy(&hdr, idx, sizeof(hdr));
+    nentry = ntohl(hdr.nentry);
+    metalen = (off_t)get64(hdr.metalen);
+    if (ntohl(hdr.magic) != MIDX_MAGIC || ntohl(hdr.version) != MIDX_VERSION ||
+	nentry < 0 ||
+	sbuf.st_size < (off_t)(sizeof(hdr) + nentry * sizeof(midx_entry_t))) {
+	why = "bad header";
+	goto unmap;
+    }
+
+    /*
+     * must be the index for this metadata file, which may only have
+     * grown since ... if the metadata file is compressed, __pmFileno()
+     * is the compressed file, so the inode does not match
+     */
+    if (fstat(__pmFileno(lcp->mdfp), &mbuf) < 0 ||
+	(__uint64_t)mbuf.st_ino != get64(hdr.ino) ||
+	(__uint64_t)mbuf.st_dev != get64(hdr.dev) ||
+	mbuf.st_size < metalen) {
+	why = "not for this metadata file";
+	goto unmap;
+    }
+    if (metalen < (off_t)sizeof(hdr.label)) {
+	why = "bad header";
+	goto unmap;
+    }
+    meta = mmap(NULL, (size_t)metalen, PROT_READ, MAP_SHARED, __pmFileno(lcp->mdfp), 0);
+    if (meta == MAP_FAILED) {
+	why = "metadata mmap failed";
+	goto unmap;
+    }
+    if (memcmp(meta, hdr.label, sizeof(hdr.label)) != 0) {
+	why = "archive label mismatch";
+	goto unmap_meta;
+    }
+    if (nentry > 0) {
+	/* cheap check that the last indexed record is intact */
+	memcpy(&last, &idx[sizeof(hdr) + (nentry-1) * sizeof(last)], sizeof(last));
+	off = (off_t)get64(last.off);
+	if (ntohl(last.len) < (int)(sizeof(__pmLogHdr) + sizeof(check)) ||
+	    off + ntohl(last.len) > metalen) {
+	    why = "bad last entry";
+	    goto unmap_meta;
+	}
+	memcpy(&check, &meta[off + ntohl(last.len) - sizeof(check)], sizeof(check));
+	if (check != last.len) {
+	    why = "last record mismatch";
+	    goto unmap_meta;
+	}
+    }
+
+    if ((mip = (struct __pmLogMetaIndex *)malloc(sizeof(*mip))) == NULL) {
+	why = "malloc failed";
+	goto unmap_meta;
+    }
+    if ((mmp = (metamap_t *)malloc(sizeof(*mmp))) == NULL) {
+	free(mip);
+	why = "malloc failed";
+	goto unmap_meta;
+    }
+    mmp->addr = meta;
+    mmp->len = (size_t)metalen;
+    mmp->next = (metamap_t *)lcp->metamap;
+    lcp->metamap = (void *)mmp;
+
+    mip->idx = idx;
+    mip->idxlen = (size_t)sbuf.st_size;
+    mip->meta = meta;
+    mip->metalen = metalen;
+    mip->nentry = nentry;
+    mip->next = 0;
+    if (pmDebugOptions.logmeta)
+	fprintf(stderr, "__pmLogOpenMetaIndex: %s: %d entries for %lld bytes\n",
+		path, nentry, (long long)metalen);
+    return mip;
+
+unmap_meta:
+    munmap(meta, (size_t)metalen);
+unmap:
+    munmap(idx, (size_t)sbuf.st_size);
+untrusted:
+    if (pmDebugOptions.logmeta)
+	fprintf(stderr, "__pmLogOpenMetaIndex: %s: %s, ignored\n", path, why);
+    return NULL;
+}
+
+/*
+ * Called from __pmLogLoadMeta() with lcp->mdfp positioned at the start
+ * of the next metadata record.  If this is an indexed instance domain
+ * record, add a PMLID_LAZY __pmLogInDom for it, skip lcp->mdfp over the
+ * record and return 1, else return 0 and the record is loaded in the
+ * usual way.  If the index and the metadata file disagree, the rest of
+ * the index is not used.
+ */
+int
+__pmLogMetaIndexSkip(__pmLogCtl *lcp, struct __pmLogMetaIndex *mip)
+{
+    midx_entry_t	entry;
+    __pmLogHdr		h;
+    __pmLogInDom	lid;
+    off_t		off;
+    off_t		eoff;
+    int			len;
+    int			type;
+    int			sts;
+
+    if (mip->next >= mip->nentry)
+	return 0;
+    off = __pmFtell(lcp->mdfp);
+    midx_entry(mip, mip->next, &entry);
+    eoff = (off_t)get64(entry.off);
+    if (eoff > off)
+	/* not an instance domain record */
+	return 0;
+    len = ntohl(entry.len);
+    type = ntohl(entry.type);
+    if (eoff == off && off + len <= mip->metalen)
+	memcpy(&h, &mip->meta[off], sizeof(h));
+    else
+	h.len = h.type = 0;
+    if (h.len != entry.len || h.type != entry.type ||
+	(type != TYPE_INDOM && type != TYPE_INDOM_DELTA && type != TYPE_INDOM_V2)) {
+	if (pmDebugOptions.logmeta)
+	    fprintf(stderr, "__pmLogMetaIndexSkip: entry[%d] @ offset=%lld does not match record @ offset=%lld, rest of index ignored\n",
+		    mip->next, (long long)eoff, (long long)off);
+	mip->next = mip->nentry;
+	return 0;
+    }
+    mip->next++;
+
+    lid.numinst = ntohl(entry.numinst);
+    if (lid.numinst > 0) {
+	lid.next = lid.prior = NULL;
+	lid.indom = __ntohpmInDom(entry.indom);
+	__pmLoadTimestamp(entry.stamp, &lid.stamp);
+	lid.isdelta = (type == TYPE_INDOM_DELTA);
+	lid.instlist = NULL;
+	lid.namelist = NULL;
+	lid.buf = NULL;
+	lid.alloc = PMLID_LAZY;
+	if ((sts = addindom(lcp, type, &lid, (__int32_t *)&mip->meta[off])) < 0)
+	    return sts;
+    }
+    __pmFseek(lcp->mdfp, (long)(off + len), SEEK_SET);
+    return 1;
+}
+
+void
+__pmLogCloseMetaIndex(struct __pmLogMetaIndex *mip)
+{
+    munmap(mip->idx, mip->idxlen);
+    free(mip);
+}
+
+void
+__pmLogFreeMetaMaps(__pmLogCtl *lcp)
+{
+    metamap_t	*mmp;
+
+    while ((mmp = (metamap_t *)lcp->metamap) != NULL) {
+	lcp->metamap = (void *)mmp->next;
+	munmap(mmp->addr, mmp->len);
+	free(mmp);
+    }
+}
+
+#else /* IS_MINGW */
+
+struct __pmLogMetaIndex *
+__pmLogOpenMetaIndex(__pmLogCtl *lcp)
+{
+    (void)lcp;
+    return NULL;
+}
+
+int
+__pmLogMetaIndexSkip(__pmLogCtl *lcp, struct __pmLogMetaIndex *mip)
+{
+    (void)lcp;
+    (void)mip;
+    return 0;
+}
+
+void
+__pmLogCloseMetaIndex(struct __pmLogMetaIndex *mip)
+{
+    (void)mip;
+}
+
+void
+__pmLogFreeMetaMaps(__pmLogCtl *lcp)
+{
+    (void)lcp;
+}
+#endif /* IS_MINGW */
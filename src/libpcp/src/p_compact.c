@@ -0,0 +1,428 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * Thread-safe note
+ *
+ * As for __pmEncodeResult() and __pmDecodeResult() in p_result.c, the
+ * buffer returned from __pmEncodeCompactResult() remains pinned, and the
+ * pmValueSets returned from __pmDecodeCompactResult() live in a second
+ * pinned PDU buffer that is released by __pmFreeResult().
+ */
+
+#include "pmapi.h"
+#include "libpcp.h"
+#include "internal.h"
+
+/*
+ * PDU for compact results (PDU_COMPACT_RESULT)
+ *
+ * Sent by pmcd in place of PDU_HIGHRES_RESULT to clients that asked for
+ * it with PDU_FLAG_COMPACT in their CVERSION credential.  After the usual
+ * three word header the body is a byte stream of unsigned LEB128 varints
+ * (uv) and zigzag encoded signed varints (sv), with no padding:
+ *
+ *	uv sec, uv nsec, uv numpmid
+ *	for each pmValueSet ...
+ *	    sv pmid, as a delta from the previous pmid (initially 0)
+ *	    sv numval, negative for an error code
+ *	    if numval > 0 ...
+ *		byte valfmt
+ *		for each pmValue ...
+ *		    sv inst, as a delta from the previous inst (initially 0)
+ *		    PM_VAL_INSITU: sv lval
+ *		    otherwise: byte vtype, then for
+ *			PM_TYPE_64: sv value
+ *			PM_TYPE_U64: uv value
+ *			other types: uv length, length bytes of vbuf[] in
+ *			network byte order (as for PDU_HIGHRES_RESULT)
+ *
+ * hdr.len is the exact length of the PDU in bytes.
+ */
+typedef struct {
+    __pmPDUHdr		hdr;
+    unsigned char	data[1];	/* zero or more */
+} compact_result_t;
+
+#define VARINT_MAX	10	/* bytes for a 64-bit varint */
+
+static unsigned char *
+putuv(unsigned char *p, __uint64_t value)
+{
+    while (value >= 0x80) {
+	*p++ = (unsigned char)(value | 0x80);
+	value >>= 7;
+    }
+    *p++ = (unsigned char)value;
+    return p;
+}
+
+static unsigned char *
+putsv(unsigned char *p, __int64_t value)
+{
+    return putuv(p, ((__uint64_t)value << 1) ^ (__uint64_t)(value >> 63));
+}
+
+static int
+getuv(const unsigned char **pp, const unsigned char *end, __uint64_t *value)
+{
+    const unsigned char	*p = *pp;
+    __uint64_t		v = 0;
+    int			shift;
+
+    for (shift = 0; shift < 64; shift += 7) {
+	if (p >= end)
+	    break;
+	v |= (__uint64_t)(*p & 0x7f) << shift;
+	if ((*p++ & 0x80) == 0) {
+	    *pp = p;
+	    *value = v;
+	    return 0;
+	}
+    }
+    return PM_ERR_IPC;
+}
+
+static int
+getsv(const unsigned char **pp, const unsigned char *end, __int64_t *value)
+{
+    __uint64_t	v;
+
+    if (getuv(pp, end, &v) < 0)
+	return PM_ERR_IPC;
+    *value = (__int64_t)(v >> 1) ^ -(__int64_t)(v & 1);
+    return 0;
+}
+
+int
+__pmEncodeCompactResult(const __pmResult *result, __pmPDU **pdu)
+{
+    compact_result_t	*pp;
+    const pmValueSet	*vsp;
+    const pmValue	*vp;
+    pmValueBlock	*vbp;
+    __pmPDU		*pdubuf;
+    unsigned char	*p;
+    char		*scratch = NULL;
+    size_t		need, vlen, maxvlen = 0;
+    __int64_t		prevpmid, previnst;
+    __int64_t		ll;
+    __uint64_t		ull;
+    int			i, j;
+
+    /* worst case size, the real PDU length is known after encoding */
+    need = sizeof(__pmPDUHdr) + 3 * VARINT_MAX;
+    for (i = 0; i < result->numpmid; i++) {
+	vsp = result->vset[i];
+	need += 2 * VARINT_MAX + 1;
+	for (j = 0; j < vsp->numval; j++) {
+	    need += 2 * VARINT_MAX + 1;
+	    if (vsp->valfmt == PM_VAL_DPTR || vsp->valfmt == PM_VAL_SPTR) {
+		vlen = vsp->vlist[j].value.pval->vlen;
+		if (vlen < PM_VAL_HDR_SIZE)
+		    return PM_ERR_CONV;
+		need += vlen;
+		if (vlen > maxvlen)
+		    maxvlen = vlen;
+	    }
+	}
+    }
+    if (need > INT_MAX)
+	return -E2BIG;
+
+    if ((pdubuf = __pmFindPDUBuf((int)need)) == NULL)
+	return -oserror();
+    if (maxvlen > 0 && (scratch = (char *)malloc(maxvlen)) == NULL) {
+	i = -oserror();
+	__pmUnpinPDUBuf(pdubuf);
+	return i;
+    }
+
+    pp = (compact_result_t *)pdubuf;
+    pp->hdr.type = PDU_COMPACT_RESULT;
+    p = pp->data;
+    p = putuv(p, (__uint64_t)result->timestamp.sec);
+    p = putuv(p, (__uint64_t)result->timestamp.nsec);
+    p = putuv(p, (__uint64_t)result->numpmid);
+    prevpmid = 0;
+    for (i = 0; i < result->numpmid; i++) {
+	vsp = result->vset[i];
+	p = putsv(p, (__int64_t)vsp->pmid - prevpmid);
+	prevpmid = vsp->pmid;
+	p = putsv(p, vsp->numval);
+	if (vsp->numval <= 0)
+	    continue;
+	*p++ = (unsigned char)vsp->valfmt;
+	previnst = 0;
+	for (j = 0; j < vsp->numval; j++) {
+	    vp = &vsp->vlist[j];
+	    p = putsv(p, (__int64_t)vp->inst - previnst);
+	    previnst = vp->inst;
+	    if (vsp->valfmt == PM_VAL_INSITU) {
+		p = putsv(p, vp->value.lval);
+		continue;
+	    }
+	    vbp = vp->value.pval;
+	    vlen = vbp->vlen - PM_VAL_HDR_SIZE;
+	    *p++ = (unsigned char)vbp->vtype;
+	    if (vbp->vtype == PM_TYPE_64 && vlen == sizeof(ll)) {
+		memcpy(&ll, vbp->vbuf, sizeof(ll));
+		p = putsv(p, ll);
+	    }
+	    else if (vbp->vtype == PM_TYPE_U64 && vlen == sizeof(ull)) {
+		memcpy(&ull, vbp->vbuf, sizeof(ull));
+		p = putuv(p, ull);
+	    }
+	    else if (vbp->vtype == PM_TYPE_64 || vbp->vtype == PM_TYPE_U64) {
+		/* botch, cannot be represented */
+		free(scratch);
+		__pmUnpinPDUBuf(pdubuf);
+		return PM_ERR_CONV;
+	    }
+	    else {
+		/* byte order conversion happens in place, so use a copy */
+		p = putuv(p, vlen);
+		memcpy(scratch, vbp, vbp->vlen);
+		__htonpmValueBlock((pmValueBlock *)scratch);
+		memcpy(p, scratch + PM_VAL_HDR_SIZE, vlen);
+		p += vlen;
+	    }
+	}
+    }
+    pp->hdr.len = (int)(p - (unsigned char *)pdubuf);
+    free(scratch);
+
+    /* Note PDU remains pinned ... see thread-safe comments above */
+    *pdu = pdubuf;
+    return 0;
+}
+
+int
+__pmSendCompactResult(int fd, int from, const __pmResult *result)
+{
+    __pmPDU		*pdubuf = NULL;
+    compact_result_t	*pp;
+    int			sts;
+
+    if (pmDebugOptions.pdu)
+	__pmPrintResult_ctx(NULL, stderr, result);
+    if ((sts = __pmEncodeCompactResult(result, &pdubuf)) < 0)
+	return sts;
+    pp = (compact_result_t *)pdubuf;
+    pp->hdr.from = from;
+    sts = __pmXmitPDU(fd, pdubuf);
+    __pmUnpinPDUBuf(pdubuf);
+    return sts;
+}
+
+/*
+ * Walk the value sets in the PDU body; with vset == NULL just validate
+ * and compute the space needed for the pmValueSets (*vsizep) and the
+ * pmValueBlocks (*vbsizep), else build them in newbuf.
+ */
+static int
+decode_valuesets(const unsigned char *p, const unsigned char *end,
+		int numpmid, char *newbuf, size_t *vsizep, size_t *vbsizep,
+		pmValueSet **vset)
+{
+    pmValueSet		*vsp = NULL;
+    pmValueBlock	*vbp;
+    size_t		vsize = 0, vbsize = 0;
+    __uint32_t		pmid = 0, inst;
+    __int64_t		delta, numval, ll;
+    __uint64_t		ull, vlen;
+    unsigned int	*ip;
+    int			valfmt, vtype;
+    int			i, j;
+
+    for (i = 0; i < numpmid; i++) {
+	if (getsv(&p, end, &delta) < 0 || getsv(&p, end, &numval) < 0)
+	    return PM_ERR_IPC;
+	pmid += (__uint32_t)delta;
+	/* numval may be negative - it holds an error code in that case */
+	if (numval < INT_MIN || numval > end - p)
+	    return PM_ERR_IPC;
+	if (vset != NULL) {
+	    vsp = vset[i] = (pmValueSet *)&newbuf[vsize];
+	    vsp->pmid = pmid;
+	    vsp->numval = (int)numval;
+	}
+	vsize += sizeof(pmValueSet);
+	if (vsize > INT_MAX)
+	    return PM_ERR_IPC;
+	if (numval <= 0)
+	    continue;
+
+	if (p >= end)
+	    return PM_ERR_IPC;
+	valfmt = *p++;
+	if (valfmt != PM_VAL_INSITU && valfmt != PM_VAL_DPTR &&
+	    valfmt != PM_VAL_SPTR)
+	    return PM_ERR_IPC;
+	if (numval - 1 > (INT_MAX - vsize) / sizeof(pmValue))
+	    return PM_ERR_IPC;
+	vsize += (numval - 1) * sizeof(pmValue);
+	if (vsp != NULL)
+	    vsp->valfmt = valfmt;
+
+	inst = 0;
+	for (j = 0; j < numval; j++) {
+	    if (getsv(&p, end, &delta) < 0)
+		return PM_ERR_IPC;
+	    inst += (__uint32_t)delta;
+	    if (vsp != NULL)
+		vsp->vlist[j].inst = (int)inst;
+	    if (valfmt == PM_VAL_INSITU) {
+		if (getsv(&p, end, &ll) < 0 || ll < INT_MIN || ll > INT_MAX)
+		    return PM_ERR_IPC;
+		if (vsp != NULL)
+		    vsp->vlist[j].value.lval = (int)ll;
+		continue;
+	    }
+
+	    if (p >= end)
+		return PM_ERR_IPC;
+	    vtype = *p++;
+	    vbp = NULL;
+	    if (vsp != NULL) {
+		vbp = (pmValueBlock *)&newbuf[*vsizep + vbsize];
+		vsp->vlist[j].value.pval = vbp;
+		vbp->vtype = vtype;
+	    }
+	    if (vtype == PM_TYPE_64) {
+		if (getsv(&p, end, &ll) < 0)
+		    return PM_ERR_IPC;
+		vlen = sizeof(ll);
+		if (vbp != NULL)
+		    memcpy(vbp->vbuf, &ll, sizeof(ll));
+	    }
+	    else if (vtype == PM_TYPE_U64) {
+		if (getuv(&p, end, &ull) < 0)
+		    return PM_ERR_IPC;
+		vlen = sizeof(ull);
+		if (vbp != NULL)
+		    memcpy(vbp->vbuf, &ull, sizeof(ull));
+	    }
+	    else {
+		if (getuv(&p, end, &vlen) < 0 || vlen > end - p ||
+		    vlen > PM_VAL_VLEN_MAX - PM_VAL_HDR_SIZE)
+		    return PM_ERR_IPC;
+		if ((vtype == PM_TYPE_DOUBLE && vlen != sizeof(double)) ||
+		    (vtype == PM_TYPE_FLOAT && vlen != sizeof(float)))
+		    return PM_ERR_IPC;
+		if (vbp != NULL) {
+		    memcpy(vbp->vbuf, p, vlen);
+		    vbp->vlen = PM_VAL_HDR_SIZE + vlen;
+		    /* header is in host order, swab it so both are in PDU order */
+		    ip = (unsigned int *)vbp;
+		    *ip = htonl(*ip);
+		    __ntohpmValueBlock(vbp);
+		}
+		p += vlen;
+	    }
+	    if (vbp != NULL)
+		vbp->vlen = PM_VAL_HDR_SIZE + vlen;
+	    if (vbsize > INT_MAX - PM_PDU_SIZE_BYTES(PM_VAL_HDR_SIZE + vlen))
+		return PM_ERR_IPC;
+	    vbsize += PM_PDU_SIZE_BYTES(PM_VAL_HDR_SIZE + vlen);
+	}
+    }
+
+    if (vset == NULL) {
+	*vsizep = vsize;
+	*vbsizep = vbsize;
+    }
+    return 0;
+}
+
+/*
+ * Internal variant of __pmDecodeCompactResult() with current context.
+ *
+ * Enter here with pdubuf already pinned ... result may point into
+ * _another_ pdu buffer that is pinned on exit
+ */
+int
+__pmDecodeCompactResult_ctx(__pmContext *ctxp, __pmPDU *pdubuf, __pmResult **result)
+{
+    compact_result_t	*pp = (compact_result_t *)pdubuf;
+    const unsigned char	*p, *end;
+    __pmResult		*pr;
+    __uint64_t		sec, nsec, numpmid;
+    size_t		vsize = 0, vbsize = 0;
+    char		*newbuf = NULL;
+    int			sts;
+
+    if (ctxp != NULL)
+	PM_ASSERT_IS_LOCKED(ctxp->c_lock);
+
+    if (pp->hdr.len < (int)sizeof(__pmPDUHdr)) {
+	if (pmDebugOptions.pdu && pmDebugOptions.desperate)
+	    fprintf(stderr, "%s: Bad: len=%d smaller than min %d\n",
+			    "__pmDecodeCompactResult", pp->hdr.len,
+			    (int)sizeof(__pmPDUHdr));
+	return PM_ERR_IPC;
+    }
+    p = pp->data;
+    end = (const unsigned char *)pdubuf + pp->hdr.len;
+    if (getuv(&p, end, &sec) < 0 || getuv(&p, end, &nsec) < 0 ||
+	getuv(&p, end, &numpmid) < 0 ||
+	sec > INT64_MAX || nsec >= 1000000000 || numpmid > end - p) {
+	if (pmDebugOptions.pdu && pmDebugOptions.desperate)
+	    fprintf(stderr, "%s: Bad: timestamp or numpmid\n",
+			    "__pmDecodeCompactResult");
+	return PM_ERR_IPC;
+    }
+
+    if ((sts = decode_valuesets(p, end, (int)numpmid, NULL,
+				&vsize, &vbsize, NULL)) < 0 ||
+	vsize + vbsize > INT_MAX) {
+	if (pmDebugOptions.pdu && pmDebugOptions.desperate)
+	    fprintf(stderr, "%s: Bad: pmValueSet encoding\n",
+			    "__pmDecodeCompactResult");
+	return PM_ERR_IPC;
+    }
+
+    if ((pr = __pmAllocResult((int)numpmid)) == NULL)
+	return -oserror();
+    pr->numpmid = (int)numpmid;
+    pr->timestamp.sec = (__int64_t)sec;
+    pr->timestamp.nsec = (__int32_t)nsec;
+
+    if (numpmid > 0) {
+	/* pmValueSets first, then the pmValueBlocks, as in p_result.c */
+	if ((newbuf = (char *)__pmFindPDUBuf((int)(vsize + vbsize))) == NULL) {
+	    sts = -oserror();
+	    pr->numpmid = 0;	/* force no pmValueSet's to free */
+	    __pmFreeResult(pr);
+	    return sts;
+	}
+	if ((sts = decode_valuesets(p, end, (int)numpmid, newbuf,
+				    &vsize, &vbsize, pr->vset)) < 0) {
+	    __pmUnpinPDUBuf(newbuf);
+	    pr->numpmid = 0;	/* force no pmValueSet's to free */
+	    __pmFreeResult(pr);
+	    return sts;
+	}
+    }
+
+    if (pmDebugOptions.pdu)
+	__pmPrintResult_ctx(ctxp, stderr, pr);
+
+    *result = pr;
+    return 0;
+}
+
+int
+__pmDecodeCompactResult(__pmPDU *pdubuf, __pmResult **result)
+{
+    return __pmDecodeCompactResult_ctx(NULL, pdubuf, result);
+}
@@ -452,6 +452,17 @@ __pmSendTraversePMNSReq(int fd, int from, const char *name)
 }
 
 
+/*
+ * Send a PDU_PMNS_TRAVERSE asking for a PDU_PMNS_NAMEDESCS reply,
+ * i.e. the descriptor of each name as well as the name.  A pmcd that
+ * predates this ignores the subtype and replies with PDU_PMNS_NAMES.
+ */
+int
+__pmSendTraversePMNSDescsReq(int fd, int from, const char *name)
+{
+    return SendNameReq(fd, from, name, PDU_PMNS_TRAVERSE, 1);
+}
+
 /*
  * Decode a PDU_PMNS_TRAVERSE
  */
@@ -461,4 +472,196 @@ __pmDecodeTraversePMNSReq(__pmPDU *pdubuf, char **name_p)
     return DecodeNameReq(pdubuf, name_p, 0);
 }
 
+/*
+ * Decode a PDU_PMNS_TRAVERSE, including the subtype (1 if the
+ * descriptors are wanted, else 0)
+ */
+int
+__pmDecodeTraversePMNSReq2(__pmPDU *pdubuf, char **name_p, int *subtype)
+{
+    return DecodeNameReq(pdubuf, name_p, subtype);
+}
+
+/*********************************************************************/
+
+/*
+ * PDU for name and descriptor list (PDU_PMNS_NAMEDESCS), the reply
+ * to a PDU_PMNS_TRAVERSE with subtype 1.
+ *
+ * Each record is a descriptor followed by a length prefixed name,
+ * padded to a __pmPDU boundary as for PDU_PMNS_NAMES.  If the name
+ * could not be resolved, or it has no descriptor, the pmid of the
+ * descriptor is PM_ID_NULL.
+ */
+
+typedef struct {
+    pmDesc	desc;
+    int		namelen;
+    char	name[sizeof(__pmPDU)]; /* variable length */
+} name_desc_t;
+
+typedef struct {
+    __pmPDUHdr	hdr;
+    int		nstrbytes; /* number of str bytes including null terminators */
+    int		numnames;
+    __pmPDU	names[1]; /* list of variable length name_desc_t */
+} namedescs_t;
+
+int
+__pmSendNameDescs(int fd, int from, int numnames, const char *namelist[],
+		  const pmDesc *desclist)
+{
+    namedescs_t		*nlistp;
+    name_desc_t		*np;
+    int			need;
+    int			nstrbytes = 0;
+    int			namelen;
+    int			i, j;
+    int			sts;
+
+    if (pmDebugOptions.pmns) {
+	fprintf(stderr, "__pmSendNameDescs\n");
+	__pmDumpNameList(stderr, numnames, namelist);
+    }
+
+    need = sizeof(*nlistp) - sizeof(nlistp->names);
+    for (i = 0; i < numnames; i++) {
+	namelen = (int)strlen(namelist[i]);
+	nstrbytes += namelen + 1;
+	need += sizeof(*np) - sizeof(np->name) + PM_PDU_SIZE_BYTES(namelen);
+    }
+
+    if ((nlistp = (namedescs_t *)__pmFindPDUBuf(need)) == NULL)
+	return -oserror();
+    nlistp->hdr.len = need;
+    nlistp->hdr.type = PDU_PMNS_NAMEDESCS;
+    nlistp->hdr.from = from;
+    nlistp->nstrbytes = htonl(nstrbytes);
+    nlistp->numnames = htonl(numnames);
+
+    for (i = j = 0; i < numnames; i++) {
+	np = (name_desc_t *)&nlistp->names[j/sizeof(__pmPDU)];
+	np->desc.type = htonl(desclist[i].type);
+	np->desc.sem = htonl(desclist[i].sem);
+	np->desc.indom = __htonpmInDom(desclist[i].indom);
+	np->desc.units = __htonpmUnits(desclist[i].units);
+	np->desc.pmid = __htonpmID(desclist[i].pmid);
+	namelen = (int)strlen(namelist[i]);
+	memcpy(np->name, namelist[i], namelen);
+	if ((namelen % sizeof(__pmPDU)) != 0) {
+	    /* clear the padding bytes, lest they contain garbage */
+	    int		pad;
+	    char	*padp = np->name + namelen;
+	    for (pad = sizeof(__pmPDU) - 1; pad >= (namelen % sizeof(__pmPDU)); pad--)
+		*padp++ = '~';	/* buffer end */
+	}
+	np->namelen = htonl(namelen);
+	j += sizeof(np->desc) + sizeof(np->namelen) + PM_PDU_SIZE_BYTES(namelen);
+    }
+
+    sts = __pmXmitPDU(fd, (__pmPDU *)nlistp);
+    __pmUnpinPDUBuf(nlistp);
+    return sts;
+}
+
+/*
+ * Decode a PDU_PMNS_NAMEDESCS ... namelist is allocated as for
+ * __pmDecodeNameList(), desclist separately, and both are to be
+ * freed by the caller.
+ */
+int
+__pmDecodeNameDescs(__pmPDU *pdubuf, int *numnamesp, char ***namelist,
+		    pmDesc **desclist)
+{
+    namedescs_t	*nlistp;
+    name_desc_t	*np;
+    char	*pdu_end;
+    char	**names;
+    char	*dest, *dest_end;
+    pmDesc	*descs;
+    int		namesize, numnames;
+    int		nstrbytes;
+    int		namelen;
+    int		i, j;
+
+    nlistp = (namedescs_t *)pdubuf;
+    pdu_end = (char *)pdubuf + nlistp->hdr.len;
+
+    *namelist = NULL;
+    *desclist = NULL;
+
+    if (pdu_end - (char *)nlistp < sizeof(namedescs_t) - sizeof(__pmPDU))
+	return PM_ERR_IPC;
+
+    numnames = ntohl(nlistp->numnames);
+    nstrbytes = ntohl(nlistp->nstrbytes);
+
+    if (numnames == 0) {
+	*numnamesp = 0;
+	return 0;
+    }
+
+    /* validity checks - none of these conditions should happen */
+    if (numnames < 0 || nstrbytes < 0)
+	return PM_ERR_IPC;
+    /* anti-DOS measure - limiting allowable memory allocations */
+    if (numnames > nlistp->hdr.len || nstrbytes > nlistp->hdr.len)
+	return PM_ERR_IPC;
+    if (numnames >= (INT_MAX - nstrbytes) / (int)sizeof(char *))
+	return PM_ERR_IPC;
+
+    namesize = numnames * ((int)sizeof(char *)) + nstrbytes;
+    if ((names = (char **)malloc(namesize)) == NULL)
+	return -oserror();
+    if ((descs = (pmDesc *)malloc(numnames * sizeof(pmDesc))) == NULL) {
+	free(names);
+	return -oserror();
+    }
+
+    dest = (char *)&names[numnames];
+    dest_end = (char *)names + namesize;
+
+    for (i = j = 0; i < numnames; i++) {
+	np = (name_desc_t *)&nlistp->names[j/sizeof(__pmPDU)];
+	names[i] = dest;
+
+	if (sizeof(name_desc_t) > (size_t)(pdu_end - (char *)np))
+	    goto corrupt;
+	namelen = ntohl(np->namelen);
+	/* ensure source buffer contains everything that we copy over */
+	if (sizeof(np->desc) + sizeof(np->namelen) + namelen > (size_t)(pdu_end - (char *)np))
+	    goto corrupt;
+	/* ensure space for null-terminated name in destination buffer */
+	if (namelen < 0 || (namelen + 1) > (dest_end - dest))
+	    goto corrupt;
+
+	descs[i].type = ntohl(np->desc.type);
+	descs[i].sem = ntohl(np->desc.sem);
+	descs[i].indom = __ntohpmInDom(np->desc.indom);
+	descs[i].units = __ntohpmUnits(np->desc.units);
+	descs[i].pmid = __ntohpmID(np->desc.pmid);
+
+	memcpy(dest, np->name, namelen);
+	*(dest + namelen) = '\0';
+	dest += namelen + 1;
+
+	j += sizeof(np->desc) + sizeof(np->namelen) + PM_PDU_SIZE_BYTES(namelen);
+    }
+
+    if (pmDebugOptions.pmns) {
+	fprintf(stderr, "__pmDecodeNameDescs\n");
+	__pmDumpNameList(stderr, numnames, (const char **)names);
+    }
+
+    *namelist = names;
+    *desclist = descs;
+    *numnamesp = numnames;
+    return numnames;
+
+corrupt:
+    free(descs);
+    free(names);
+    return PM_ERR_IPC;
+}
+
 /*********************************************************************/
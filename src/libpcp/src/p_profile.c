@@ -210,6 +210,8 @@ PM_FAULT_POINT("libpcp/" __FILE__ ":3", PM_FAULT_ALLOC);
 	instprof->profile = NULL;
     }
 
+    /* sorted once here, so each __pmInProfile() check is a binary search */
+    __pmSortProfile(instprof);
     *resultp = instprof;
     *ctxidp = ctxid;
     return 0;
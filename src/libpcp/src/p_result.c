@@ -751,6 +751,8 @@ __pmDecodeValueSet(__pmPDU *pdubuf, int pdulen, __pmPDU *data, char *pduend,
 #error Bozo - unexpected sizeof pointer!! - commented for static checking
 #endif
 
+static int decode_result(__pmContext *, int, __pmPDU *, __pmResult **);
+
 /*
  * Internal variant of __pmDecodeResult() with current context and
  * internal result structure format.
@@ -760,6 +762,30 @@ __pmDecodeValueSet(__pmPDU *pdubuf, int pdulen, __pmPDU *data, char *pduend,
  */
 int
 __pmDecodeResult_ctx(__pmContext *ctxp, __pmPDU *pdubuf, __pmResult **result)
+{
+    int		v3 = 0;
+
+    if (ctxp != NULL)
+	PM_ASSERT_IS_LOCKED(ctxp->c_lock);
+
+    if (ctxp != NULL && ctxp->c_type == PM_CONTEXT_ARCHIVE && __pmLogVersion(ctxp->c_archctl->ac_log) == PM_LOG_VERS03)
+	v3 = 1;
+    return decode_result(ctxp, v3, pdubuf, result);
+}
+
+/*
+ * Decode an archive result record of the given archive version (PDU
+ * buffer as built by __pmLogRead) without an archive context, e.g. for
+ * records arriving other than from an archive file.
+ */
+int
+__pmLogDecodeResult(int version, __pmPDU *pdubuf, __pmResult **result)
+{
+    return decode_result(NULL, version == PM_LOG_VERS03, pdubuf, result);
+}
+
+static int
+decode_result(__pmContext *ctxp, int v3, __pmPDU *pdubuf, __pmResult **result)
 {
     int			sts;
     int			numpmid;	/* number of metrics */
@@ -771,10 +797,7 @@ __pmDecodeResult_ctx(__pmContext *ctxp, __pmPDU *pdubuf, __pmResult **result)
     __pmResult		*pr;
     __pmTimestamp	stamp;
 
-    if (ctxp != NULL)
-	PM_ASSERT_IS_LOCKED(ctxp->c_lock);
-
-    if (ctxp != NULL && ctxp->c_type == PM_CONTEXT_ARCHIVE && __pmLogVersion(ctxp->c_archctl->ac_log) == PM_LOG_VERS03) {
+    if (v3) {
 	/*
 	 * V3 archive
 	 */
@@ -845,6 +868,169 @@ __pmDecodeResult_ctx(__pmContext *ctxp, __pmPDU *pdubuf, __pmResult **result)
     return 0;
 }
 
+static int
+in_pmidlist(pmID pmid, int nlist, const pmID *pmidlist)
+{
+    int		i;
+
+    for (i = 0; i < nlist; i++) {
+	if (pmidlist[i] == pmid)
+	    return 1;
+    }
+    return 0;
+}
+
+/*
+ * Filter an archive result record (PDU buffer as built by __pmLogRead,
+ * before any byte swapping) down to the metrics in pmidlist, without
+ * decoding it.  Returns the record timestamp via stampp, and
+ *   0  if the record contains none of the metrics
+ *   1  if it does (or is a <mark> record) ... *subsetp is then NULL
+ *      if the record can be decoded as is, else a new pinned PDU
+ *      buffer holding just the pmValueSets (and pmValueBlocks) for
+ *      the requested metrics, ready for __pmDecodeResult
+ *   PM_ERR_IPC for a malformed record (to be reported when decoded)
+ *   or a negative error code if a new PDU buffer cannot be allocated
+ */
+int
+__pmLogResultFilter(int version, const __pmPDU *pdubuf, int nlist,
+		const pmID *pmidlist, __pmTimestamp *stampp, __pmPDU **subsetp)
+{
+    int			len = pdubuf[0];
+    const char		*pduend = (const char *)pdubuf + len;
+    const __pmPDU	*data;
+    const __pmPDU	*vp;
+    const vlist_t	*vlp;
+    __pmPDU		*subset;
+    __pmPDU		*np;
+    __pmPDU		*nbp;
+    pmValueBlock	*vbp;
+    unsigned int	vbhdr;
+    size_t		preamble;
+    size_t		vsize;
+    size_t		size;
+    size_t		vbsize = 0;
+    int			numpmid;
+    int			numval;
+    int			vindex;
+    int			keep = 0;
+    int			i;
+    int			j;
+
+    *subsetp = NULL;
+
+    if (version == PM_LOG_VERS03) {
+	const log_result_v3_t	*lrp = (const log_result_v3_t *)pdubuf;
+
+	if (pduend - (const char *)pdubuf < sizeof(*lrp) - sizeof(__int32_t))
+	    return PM_ERR_IPC;
+	numpmid = ntohl(lrp->numpmid);
+	__pmLoadTimestamp((const __int32_t *)&lrp->sec[0], stampp);
+	data = (const __pmPDU *)lrp->data;
+    }
+    else {
+	const result_t	*pp = (const result_t *)pdubuf;
+
+	if (pduend - (const char *)pdubuf < sizeof(*pp) - sizeof(__pmPDU))
+	    return PM_ERR_IPC;
+	numpmid = ntohl(pp->numpmid);
+	__pmLoadTimeval((const __int32_t *)&pp->timestamp, stampp);
+	data = pp->data;
+    }
+    if (numpmid == 0)
+	return 1;
+    if (numpmid < 0)
+	return PM_ERR_IPC;
+    preamble = (const char *)data - (const char *)pdubuf;
+
+    /*
+     * first pass ... find the sizes of the pmValueSets and pmValueBlocks
+     * for the requested metrics
+     */
+    vsize = 0;
+    for (vp = data, i = 0; i < numpmid; i++) {
+	vlp = (const vlist_t *)vp;
+	if ((const char *)&vlp->valfmt > pduend)
+	    return PM_ERR_IPC;
+	numval = ntohl(vlp->numval);
+	if (numval > 0) {
+	    if (numval > len ||
+		(const char *)&vlp->vlist[numval] > pduend)
+		return PM_ERR_IPC;
+	    size = (const char *)&vlp->vlist[numval] - (const char *)vlp;
+	}
+	else
+	    size = sizeof(vlp->pmid) + sizeof(vlp->numval);
+	if (in_pmidlist(__ntohpmID(vlp->pmid), nlist, pmidlist)) {
+	    keep++;
+	    vsize += size;
+	    if (numval > 0 && ntohl(vlp->valfmt) != PM_VAL_INSITU) {
+		for (j = 0; j < numval; j++) {
+		    vindex = ntohl(vlp->vlist[j].value.lval);
+		    if (vindex < 0 || vindex >= len / sizeof(__pmPDU))
+			return PM_ERR_IPC;
+		    vbhdr = ntohl(pdubuf[vindex]);
+		    vbp = (pmValueBlock *)&vbhdr;
+		    if (vbp->vlen < PM_VAL_HDR_SIZE ||
+			PM_PDU_SIZE_BYTES(vbp->vlen) > pduend - (const char *)&pdubuf[vindex])
+			return PM_ERR_IPC;
+		    vbsize += PM_PDU_SIZE_BYTES(vbp->vlen);
+		}
+	    }
+	}
+	vp = (const __pmPDU *)((const char *)vp + size);
+    }
+    if (keep == 0)
+	return 0;
+    if (keep == numpmid)
+	return 1;
+
+    /*
+     * second pass ... build the subset PDU, preamble then pmValueSets
+     * then pmValueBlocks, with the pmValueBlock indices rewritten to
+     * their new position (as in __pmEncodeValueSet)
+     */
+    size = preamble + vsize + vbsize;
+    if ((subset = __pmFindPDUBuf(size + sizeof(int))) == NULL)
+	return -oserror();
+    memcpy(subset, pdubuf, preamble);
+    subset[0] = size;
+    if (version == PM_LOG_VERS03)
+	((log_result_v3_t *)subset)->numpmid = htonl(keep);
+    else
+	((result_t *)subset)->numpmid = htonl(keep);
+    np = (__pmPDU *)((char *)subset + preamble);
+    nbp = (__pmPDU *)((char *)np + vsize);
+    for (vp = data, i = 0; i < numpmid; i++) {
+	vlp = (const vlist_t *)vp;
+	numval = ntohl(vlp->numval);
+	if (numval > 0)
+	    size = (const char *)&vlp->vlist[numval] - (const char *)vlp;
+	else
+	    size = sizeof(vlp->pmid) + sizeof(vlp->numval);
+	if (in_pmidlist(__ntohpmID(vlp->pmid), nlist, pmidlist)) {
+	    memcpy(np, vlp, size);
+	    if (numval > 0 && ntohl(vlp->valfmt) != PM_VAL_INSITU) {
+		vlist_t	*nvlp = (vlist_t *)np;
+
+		for (j = 0; j < numval; j++) {
+		    vindex = ntohl(vlp->vlist[j].value.lval);
+		    vbhdr = ntohl(pdubuf[vindex]);
+		    vbp = (pmValueBlock *)&vbhdr;
+		    memcpy(nbp, &pdubuf[vindex], PM_PDU_SIZE_BYTES(vbp->vlen));
+		    nvlp->vlist[j].value.lval = htonl((int)(nbp - subset));
+		    nbp += PM_PDU_SIZE(vbp->vlen);
+		}
+	    }
+	    np = (__pmPDU *)((char *)np + size);
+	}
+	vp = (const __pmPDU *)((const char *)vp + size);
+    }
+
+    *subsetp = subset;
+    return 1;
+}
+
 int
 __pmDecodeResult(__pmPDU *pdubuf, __pmResult **result)
 {
@@ -376,6 +376,8 @@ __pmPDUTypeStr_r(int type, char *buf, int buflen)
     case PDU_HIGHRES_RESULT:	res = "HIGHRES_RESULT"; break;
     case PDU_DESC_IDS:		res = "DESC_IDS"; break;
     case PDU_DESCS:		res = "DESCS"; break;
+    case PDU_COMPACT_RESULT:	res = "COMPACT_RESULT"; break;
+    case PDU_PMNS_NAMEDESCS:	res = "PMNS_NAMEDESCS"; break;
     default:			res = NULL; break;
     }
     if (res)
@@ -429,8 +431,11 @@ __pmXmitPDU(int fd, __pmPDU *pdubuf)
     int		socketipc = __pmSocketIPC(fd);
     int		off = 0;
     int		len;
+    int		xmitlen;
     int		sts;
+    char	*xmitbuf = (char *)pdubuf;
     __pmPDUHdr	*php = (__pmPDUHdr *)pdubuf;
+    __pmShmRef	ref;
 
     if (fd < 0)
 	return -EBADF;
@@ -464,21 +469,28 @@ __pmXmitPDU(int fd, __pmPDU *pdubuf)
     php->len = htonl(php->len);
     php->from = htonl(php->from);
     php->type = htonl(php->type);
-    while (off < len) {
-	char *p = (char *)pdubuf;
+    xmitlen = len;
+    /* large PDUs may go via a shared memory ring, see pdushm.c */
+    if (__pmShmIPCCount > 0 && len >= PDU_SHM_THRESHOLD &&
+	__pmShmXmit(fd, pdubuf, len, &ref) > 0) {
+	xmitbuf = (char *)&ref;
+	xmitlen = sizeof(ref);
+    }
+    while (off < xmitlen) {
+	char *p = xmitbuf;
 	int n;
 
 	p += off;
 
-	n = socketipc ? __pmSend(fd, p, len-off, 0) : write(fd, p, len-off);
+	n = socketipc ? __pmSend(fd, p, xmitlen-off, 0) : write(fd, p, xmitlen-off);
 	if (n < 0) {
 	    if (pmDebugOptions.pdu) {
 		if (socketipc)
 		    fprintf(stderr, "%s: socket __pmSend() result %d != %d\n",
-				    "__pmXmitPDU", n, len-off);
+				    "__pmXmitPDU", n, xmitlen-off);
 		else
 		    fprintf(stderr, "%s: non-socket write() result %d != %d\n",
-				    "__pmXmitPDU", n, len-off);
+				    "__pmXmitPDU", n, xmitlen-off);
 	    }
 	    break;
 	}
@@ -488,7 +500,7 @@ __pmXmitPDU(int fd, __pmPDU *pdubuf)
     php->from = ntohl(php->from);
     php->type = ntohl(php->type);
 
-    if (off != len) {
+    if (off != xmitlen) {
 	if (socketipc) {
 	    sts = -neterror();
 	    if (__pmSocketClosed()) {
@@ -530,7 +542,7 @@ __pmXmitPDU(int fd, __pmPDU *pdubuf)
 	__pmPDUCntOut[php->type-PDU_START]++;
     trace_insert(fd, 1, php);
 
-    return off;
+    return len;
 }
 
 /* result is pinned on successful return */
@@ -693,6 +705,17 @@ check_read_len:
 	}
     }
 
+    if (__pmShmIPCCount > 0 && ntohl((unsigned int)php->type) == PDU_SHM_REF) {
+	/* PDU body is in the shared memory ring, see pdushm.c */
+	int	sts;
+
+	if ((sts = __pmShmRecv(fd, &pdubuf)) < 0) {
+	    __pmUnpinPDUBuf(pdubuf);
+	    return sts;
+	}
+	php = (__pmPDUHdr *)pdubuf;
+    }
+
     *result = (__pmPDU *)php;
     php->type = ntohl((unsigned int)php->type);
     if (php->type < 0) {
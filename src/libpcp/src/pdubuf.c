@@ -1,12 +1,12 @@
 /*
  * Copyright (c) 1995 Silicon Graphics, Inc.  All Rights Reserved.
  * Copyright (c) 2015 Red Hat, Inc.
- * 
+ *
  * This library is free software; you can redistribute it and/or modify it
  * under the terms of the GNU Lesser General Public License as published
  * by the Free Software Foundation; either version 2.1 of the License, or
  * (at your option) any later version.
- * 
+ *
  * This library is distributed in the hope that it will be useful, but
  * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
  * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
@@ -17,28 +17,102 @@
  * To avoid buffer trampling, on success __pmFindPDUBuf() now returns
  * a pinned PDU buffer.  It is the caller's responsibility to unpin the
  * PDU buffer when safe to do so.
+ *
+ * Buffer pool notes
+ *
+ * PDU buffers are drawn from a set of size classes (PDUBUF_NCLASS of
+ * them, with power-of-two capacities), and when the last pin on a
+ * buffer is dropped it returns to a free list for its class rather
+ * than back to malloc.  For threaded builds, each thread keeps a small
+ * private cache per class in front of the shared free lists, so
+ * __pmFindPDUBuf() usually completes without taking pdubuf_lock.
+ * Buffers larger than the biggest class are not pooled.
+ *
+ * Every buffer is allocated on a PDUBUF_BLOCK boundary, with its
+ * bufctl_t header at the start, and a length that is a multiple of
+ * PDUBUF_BLOCK.  Each block of each pooled buffer is entered in the
+ * registry (a simple open-addressing hash table keyed on block number),
+ * so a pin or unpin for any address (including addresses into the
+ * middle of a buffer, as used for pmValueBlocks) finds the owning
+ * header with one probe.  Unpooled buffers can be many megabytes, so
+ * they are instead kept in largebuf[], sorted by address and searched
+ * when the registry has no entry.  Addresses that are not in any PDU
+ * buffer are rejected without ever being dereferenced.
  */
 
 #include "pmapi.h"
 #include "libpcp.h"
+#include "internal.h"
 #include "compiler.h"
 #include <assert.h>
-#include <search.h>
 #include <stdint.h>
 
+#define PDUBUF_BLOCKSHIFT	9
+#define PDUBUF_BLOCK		(1 << PDUBUF_BLOCKSHIFT)
+#define PDUBUF_MINSIZE		512	/* capacity of the smallest class */
+#define PDUBUF_NCLASS		8	/* 512 bytes ... 64 Kbytes */
+#define PDUBUF_POOLMAX		16	/* free buffers kept per class */
+#define PDUBUF_CACHEMAX		4	/* per-thread free buffers per class */
+#define PDUBUF_LARGE		(-1)	/* bc_class for unpooled buffers */
+
 typedef struct bufctl
 {
-    int		bc_pincnt;
-    int		bc_size;
-    char	*bc_buf;
-    /* The actual buffer happens to follow this struct. */
+    struct bufctl	*bc_next;	/* free list or thread cache link */
+    struct bufctl	*bc_allnext;	/* all buffers, for dump and count */
+    struct bufctl	*bc_allprev;
+    void		*bc_base;	/* address to free() */
+    int			bc_pincnt;
+    int			bc_size;	/* usable bytes at bc_buf[] */
+    int			bc_need;	/* bytes requested by current user */
+    int			bc_class;	/* size class or PDUBUF_LARGE */
+    int			bc_nblock;	/* PDUBUF_BLOCKs spanned */
+    char		*bc_buf;
+    /* The actual buffer follows this struct, at BUFCTL_HDRSIZE. */
 } bufctl_t;
 
+#define BUFCTL_HDRSIZE	((sizeof(bufctl_t) + 15) & ~((size_t)15))
+
+typedef struct {
+    uintptr_t		block;		/* block number, 0 for empty slot */
+    bufctl_t		*bcp;
+} regent_t;
+
 /* Protected by the pdubuf_lock mutex. */
-static void *buf_tree;
+static regent_t		*registry;
+static size_t		regsize;	/* slots, always a power of two */
+static size_t		regcount;	/* slots in use */
+static bufctl_t		**largebuf;	/* unpooled buffers, in address order */
+static int		nlargebuf;
+static int		szlargebuf;
+static bufctl_t		*buf_list;
+static bufctl_t		*pool[PDUBUF_NCLASS];
+static int		npool[PDUBUF_NCLASS];
+
+/* Pool hit rates, reported with -Dpdubuf,desperate. */
+static unsigned long	nhit_pool;
+static unsigned long	nmiss;
+static unsigned long	nlarge;
+static unsigned long	nrelease;
 
 #ifdef PM_MULTI_THREAD
 static pthread_mutex_t	pdubuf_lock = PTHREAD_MUTEX_INITIALIZER;
+#ifdef HAVE___THREAD
+#define PDUBUF_THREAD_CACHE 1
+/*
+ * Per-thread caches are drained back into pool[] (or freed) by the
+ * tcache_key destructor when a thread exits, so threads that come and
+ * go do not strand buffers.  tcache_key is set non-NULL the first time
+ * a thread puts anything in its cache.
+ */
+static __thread bufctl_t	*tcache[PDUBUF_NCLASS];
+static __thread int		ntcache[PDUBUF_NCLASS];
+static __thread int		tcache_keyset;
+static __thread unsigned long	nhit_thread;
+static unsigned long		nhit_exited;	/* nhit_thread of exited threads */
+static pthread_key_t		tcache_key;
+static pthread_once_t		tcache_once = PTHREAD_ONCE_INIT;
+static int			tcache_keyok;
+#endif
 #else
 void			*pdubuf_lock;
 #endif
@@ -55,55 +129,372 @@ __pmIsPdubufLock(void *lock)
 #endif
 
 static void
-pdubufdump1(const void *nodep, const VISIT which, const int depth)
+pdubufdump(void)
 {
-    const bufctl_t	*pcp = *(bufctl_t **)nodep;
+    bufctl_t	*pcp;
+    int		pinned = 0;
+    int		i;
 
-    if (which == postorder || which == leaf)	/* called once per node */
+    PM_LOCK(pdubuf_lock);
+    for (pcp = buf_list; pcp != NULL; pcp = pcp->bc_allnext) {
+	if (pcp->bc_pincnt == 0)
+	    continue;
+	if (pinned++ == 0)
+	    fprintf(stderr, "   pinned pdubuf[size](pincnt):");
 	fprintf(stderr, " " PRINTF_P_PFX "%p...%p[%d](%d)",
-		pcp->bc_buf, &pcp->bc_buf[pcp->bc_size - 1], pcp->bc_size,
+		pcp->bc_buf, &pcp->bc_buf[pcp->bc_need - 1], pcp->bc_need,
 		pcp->bc_pincnt);
+    }
+    if (pinned)
+	fprintf(stderr, "\n");
+    if (pmDebugOptions.pdubuf && pmDebugOptions.desperate) {
+	fprintf(stderr, "   free pdubuf[size](count):");
+	for (i = 0; i < PDUBUF_NCLASS; i++)
+	    fprintf(stderr, " [%d](%d)", PDUBUF_MINSIZE << i, npool[i]);
+	fprintf(stderr, "\n");
+#ifdef PDUBUF_THREAD_CACHE
+	fprintf(stderr, "   pool: thread hits=%lu+%lu pool hits=%lu misses=%lu "
+		"large=%lu released=%lu\n", nhit_exited, nhit_thread,
+		nhit_pool, nmiss, nlarge, nrelease);
+#else
+	fprintf(stderr, "   pool: pool hits=%lu misses=%lu "
+		"large=%lu released=%lu\n",
+		nhit_pool, nmiss, nlarge, nrelease);
+#endif
+    }
+    PM_UNLOCK(pdubuf_lock);
+}
+
+/*
+ * Registry of PDU buffer blocks ... all routines below must be
+ * called with pdubuf_lock held.
+ */
+static inline size_t
+reghash(uintptr_t block)
+{
+    uint64_t	h = (uint64_t)block * 0x9e3779b97f4a7c15ULL;
+
+    return (size_t)(h ^ (h >> 32)) & (regsize - 1);
+}
+
+static int
+reggrow(void)
+{
+    regent_t	*old = registry;
+    size_t	oldsize = regsize;
+    size_t	i, j;
+
+    regsize = oldsize ? oldsize * 2 : 256;
+    if ((registry = (regent_t *)calloc(regsize, sizeof(regent_t))) == NULL) {
+	registry = old;
+	regsize = oldsize;
+	return -oserror();
+    }
+    for (i = 0; i < oldsize; i++) {
+	if (old[i].block == 0)
+	    continue;
+	for (j = reghash(old[i].block); registry[j].block != 0; )
+	    j = (j + 1) & (regsize - 1);
+	registry[j] = old[i];
+    }
+    free(old);
+    return 0;
+}
+
+static int
+regadd(uintptr_t block, bufctl_t *pcp)
+{
+    size_t	j;
+    int		sts;
+
+    /* keep the load factor at or below one half */
+    if (2 * (regcount + 1) > regsize) {
+	if ((sts = reggrow()) < 0)
+	    return sts;
+    }
+    for (j = reghash(block); registry[j].block != 0; )
+	j = (j + 1) & (regsize - 1);
+    registry[j].block = block;
+    registry[j].bcp = pcp;
+    regcount++;
+    return 0;
 }
 
 static void
-pdubufdump(void)
+regdel(uintptr_t block)
 {
-    /*
-     * There is no longer a pdubuf free list, ergo no
-     * fprintf(stderr, "   free pdubuf[size]:\n");
-     */
+    size_t	i, j, k;
+
+    if (regsize == 0)
+	return;
+    for (i = reghash(block); registry[i].block != block; ) {
+	if (registry[i].block == 0)
+	    return;
+	i = (i + 1) & (regsize - 1);
+    }
+    /* backward-shift deletion, so probe sequences stay unbroken */
+    for (j = i; ; ) {
+	j = (j + 1) & (regsize - 1);
+	if (registry[j].block == 0)
+	    break;
+	k = reghash(registry[j].block);
+	if ((j > i && (k <= i || k > j)) || (j < i && (k <= i && k > j))) {
+	    registry[i] = registry[j];
+	    i = j;
+	}
+    }
+    registry[i].block = 0;
+    registry[i].bcp = NULL;
+    regcount--;
+}
+
+static bufctl_t *
+reglookup(const void *handle)
+{
+    uintptr_t	block = (uintptr_t)handle >> PDUBUF_BLOCKSHIFT;
+    size_t	j;
+
+    if (regcount == 0)
+	return NULL;
+    for (j = reghash(block); registry[j].block != 0; ) {
+	if (registry[j].block == block)
+	    return registry[j].bcp;
+	j = (j + 1) & (regsize - 1);
+    }
+    return NULL;
+}
+
+/*
+ * Index in largebuf[] of the last buffer starting at or below addr,
+ * or -1 if there is none.
+ */
+static int
+largeindex(const void *addr)
+{
+    int		lo = 0, hi = nlargebuf - 1, mid;
+
+    while (lo <= hi) {
+	mid = (lo + hi) / 2;
+	if ((const char *)largebuf[mid] <= (const char *)addr)
+	    lo = mid + 1;
+	else
+	    hi = mid - 1;
+    }
+    return hi;
+}
+
+static int
+largeadd(bufctl_t *pcp)
+{
+    bufctl_t	**tmp;
+    size_t	need;
+    int		i;
+
+    if (nlargebuf == szlargebuf) {
+	szlargebuf = szlargebuf ? szlargebuf * 2 : 8;
+	need = szlargebuf * sizeof(bufctl_t *);
+	if ((tmp = (bufctl_t **)realloc(largebuf, need)) == NULL) {
+	    szlargebuf = nlargebuf;
+	    return -oserror();
+	}
+	largebuf = tmp;
+    }
+    i = largeindex(pcp) + 1;
+    memmove(&largebuf[i+1], &largebuf[i], (nlargebuf - i) * sizeof(bufctl_t *));
+    largebuf[i] = pcp;
+    nlargebuf++;
+    return 0;
+}
+
+static void
+largedel(bufctl_t *pcp)
+{
+    int		i = largeindex(pcp);
+
+    if (i < 0 || largebuf[i] != pcp)
+	return;
+    nlargebuf--;
+    memmove(&largebuf[i], &largebuf[i+1], (nlargebuf - i) * sizeof(bufctl_t *));
+}
+
+static bufctl_t *
+largelookup(const void *handle)
+{
+    bufctl_t	*pcp;
+    int		i;
+
+    if ((i = largeindex(handle)) < 0)
+	return NULL;
+    pcp = largebuf[i];
+    if ((const char *)handle >=
+	(const char *)pcp + ((size_t)pcp->bc_nblock << PDUBUF_BLOCKSHIFT))
+	return NULL;
+    return pcp;
+}
+
+/*
+ * Return the size class for a buffer of need bytes.
+ */
+static int
+bufclass(int need)
+{
+    int		i;
+
+    for (i = 0; i < PDUBUF_NCLASS; i++) {
+	if (need <= (PDUBUF_MINSIZE << i))
+	    return i;
+    }
+    return PDUBUF_LARGE;
+}
+
+/*
+ * Allocate, register and link a new buffer with at least size
+ * usable bytes.
+ */
+static bufctl_t *
+bufalloc(int size, int class)
+{
+    bufctl_t	*pcp;
+    uintptr_t	block;
+    size_t	length;
+    void	*base;
+    int		i;
+
+    length = BUFCTL_HDRSIZE + size;
+    length = (length + PDUBUF_BLOCK - 1) & ~((size_t)PDUBUF_BLOCK - 1);
+#ifdef HAVE_POSIX_MEMALIGN
+    if (posix_memalign(&base, PDUBUF_BLOCK, length) != 0)
+	return NULL;
+    pcp = (bufctl_t *)base;
+#else
+    if ((base = malloc(length + PDUBUF_BLOCK)) == NULL)
+	return NULL;
+    pcp = (bufctl_t *)(((uintptr_t)base + PDUBUF_BLOCK - 1) &
+		~((uintptr_t)PDUBUF_BLOCK - 1));
+#endif
+    pcp->bc_next = NULL;
+    pcp->bc_allprev = NULL;
+    pcp->bc_base = base;
+    pcp->bc_pincnt = 1;
+    pcp->bc_size = (int)(length - BUFCTL_HDRSIZE);
+    pcp->bc_class = class;
+    pcp->bc_nblock = (int)(length >> PDUBUF_BLOCKSHIFT);
+    pcp->bc_buf = ((char *)pcp) + BUFCTL_HDRSIZE;
+
+    block = (uintptr_t)pcp >> PDUBUF_BLOCKSHIFT;
     PM_LOCK(pdubuf_lock);
-    if (buf_tree != NULL) {
-	fprintf(stderr, "   pinned pdubuf[size](pincnt):");
-	/* THREADSAFE - no locks acquired in pdubufdump1() */
-	twalk(buf_tree, &pdubufdump1);
-	fprintf(stderr, "\n");
+    if (class == PDUBUF_LARGE) {
+	nlarge++;
+	if (largeadd(pcp) < 0) {		/* ENOMEM */
+	    PM_UNLOCK(pdubuf_lock);
+	    free(base);
+	    return NULL;
+	}
+    }
+    else {
+	nmiss++;
+	for (i = 0; i < pcp->bc_nblock; i++) {
+	    if (regadd(block + i, pcp) < 0) {	/* ENOMEM */
+		while (--i >= 0)
+		    regdel(block + i);
+		PM_UNLOCK(pdubuf_lock);
+		free(base);
+		return NULL;
+	    }
+	}
     }
+    if ((pcp->bc_allnext = buf_list) != NULL)
+	buf_list->bc_allprev = pcp;
+    buf_list = pcp;
     PM_UNLOCK(pdubuf_lock);
+
+    return pcp;
 }
 
 /*
- * A tsearch(3) comparison function for the buffer-segments used here.
+ * Unregister, unlink and free a buffer ... pdubuf_lock must be held.
  */
-static int
-bufctl_t_compare(const void *a, const void *b)
+static void
+buffree(bufctl_t *pcp)
+{
+    uintptr_t	block = (uintptr_t)pcp >> PDUBUF_BLOCKSHIFT;
+    int		i;
+
+    if (pcp->bc_class == PDUBUF_LARGE)
+	largedel(pcp);
+    else {
+	for (i = 0; i < pcp->bc_nblock; i++)
+	    regdel(block + i);
+    }
+    if (pcp->bc_allprev != NULL)
+	pcp->bc_allprev->bc_allnext = pcp->bc_allnext;
+    else
+	buf_list = pcp->bc_allnext;
+    if (pcp->bc_allnext != NULL)
+	pcp->bc_allnext->bc_allprev = pcp->bc_allprev;
+    nrelease++;
+    free(pcp->bc_base);
+}
+
+#ifdef PDUBUF_THREAD_CACHE
+/*
+ * Thread exit ... return this thread's cached buffers to the shared
+ * pool, freeing any that do not fit.
+ */
+static void
+tcache_drain(void *arg)
 {
-    const bufctl_t *aa = (const bufctl_t *)a;
-    const bufctl_t *bb = (const bufctl_t *)b;
+    bufctl_t	*pcp;
+    int		class;
 
-    /* NB: valid range is bc_buf[0 .. bc_size-1] */
-    if ((uintptr_t)&aa->bc_buf[aa->bc_size-1] < (uintptr_t)&bb->bc_buf[0])
-	return -1;
-    if ((uintptr_t)&bb->bc_buf[bb->bc_size-1] < (uintptr_t)&aa->bc_buf[0])
+    (void)arg;
+    PM_LOCK(pdubuf_lock);
+    for (class = 0; class < PDUBUF_NCLASS; class++) {
+	while ((pcp = tcache[class]) != NULL) {
+	    tcache[class] = pcp->bc_next;
+	    if (npool[class] < PDUBUF_POOLMAX) {
+		pcp->bc_next = pool[class];
+		pool[class] = pcp;
+		npool[class]++;
+	    }
+	    else
+		buffree(pcp);
+	}
+	ntcache[class] = 0;
+    }
+    nhit_exited += nhit_thread;
+    nhit_thread = 0;
+    PM_UNLOCK(pdubuf_lock);
+}
+
+static void
+tcache_init(void)
+{
+    tcache_keyok = (pthread_key_create(&tcache_key, tcache_drain) == 0);
+}
+
+/*
+ * Arrange for tcache_drain() to be called when this thread exits;
+ * returns 0 if that is not possible and the cache must not be used.
+ */
+static int
+tcache_register(void)
+{
+    if (tcache_keyset)
 	return 1;
-    return 0;		/* overlap */
+    pthread_once(&tcache_once, tcache_init);
+    if (!tcache_keyok || pthread_setspecific(tcache_key, tcache) != 0)
+	return 0;
+    tcache_keyset = 1;
+    return 1;
 }
+#endif
 
 __pmPDU *
 __pmFindPDUBuf(int need)
 {
-    bufctl_t	*pcp;
-    void	*bcp;
+    bufctl_t	*pcp = NULL;
+    int		class;
 
     if (unlikely(need < 0)) {
 	/* special diagnostic case ... dump buffer state */
@@ -112,24 +503,36 @@ __pmFindPDUBuf(int need)
 	return NULL;
     }
 
-    if ((pcp = (bufctl_t *)malloc(sizeof(*pcp) + need)) == NULL) {
-	return NULL;
+    if ((class = bufclass(need)) != PDUBUF_LARGE) {
+#ifdef PDUBUF_THREAD_CACHE
+	if ((pcp = tcache[class]) != NULL) {
+	    tcache[class] = pcp->bc_next;
+	    ntcache[class]--;
+	    nhit_thread++;
+	}
+	else
+#endif
+	{
+	    PM_LOCK(pdubuf_lock);
+	    if ((pcp = pool[class]) != NULL) {
+		pool[class] = pcp->bc_next;
+		npool[class]--;
+		nhit_pool++;
+	    }
+	    PM_UNLOCK(pdubuf_lock);
+	}
+	if (pcp != NULL) {
+	    pcp->bc_next = NULL;
+	    pcp->bc_pincnt = 1;
+	}
+	else
+	    pcp = bufalloc(PDUBUF_MINSIZE << class, class);
     }
-
-    pcp->bc_pincnt = 1;
-    pcp->bc_size = need;
-    pcp->bc_buf = ((char *)pcp) + sizeof(*pcp);
-
-    PM_LOCK(pdubuf_lock);
-    /* Insert the node in the tree. */
-    /* THREADSAFE - no locks acquired in bufctl_t_compare() */
-    bcp = tsearch((void *)pcp, &buf_tree, &bufctl_t_compare);
-    if (unlikely(bcp == NULL)) {	/* ENOMEM */
-	PM_UNLOCK(pdubuf_lock);
-	free(pcp);
+    else
+	pcp = bufalloc(need, PDUBUF_LARGE);
+    if (pcp == NULL)
 	return NULL;
-    }
-    PM_UNLOCK(pdubuf_lock);
+    pcp->bc_need = need;
 
     if (unlikely(pmDebugOptions.pdubuf)) {
 	fprintf(stderr, "__pmFindPDUBuf(%d) -> " PRINTF_P_PFX "%p\n",
@@ -140,34 +543,39 @@ __pmFindPDUBuf(int need)
     return (__pmPDU *)pcp->bc_buf;
 }
 
+/*
+ * Find the pdubuf containing handle ... pdubuf_lock must be held.
+ */
+static bufctl_t *
+buffind(const void *handle)
+{
+    bufctl_t	*pcp;
+
+    if ((pcp = reglookup(handle)) == NULL &&
+	(nlargebuf == 0 || (pcp = largelookup(handle)) == NULL))
+	return NULL;
+    /* NB: valid range is bc_buf[0 .. bc_need-1] */
+    if ((const char *)handle < &pcp->bc_buf[0] ||
+	(const char *)handle >= &pcp->bc_buf[pcp->bc_need])
+	return NULL;
+    return pcp;
+}
+
 void
 __pmPinPDUBuf(void *handle)
 {
-    bufctl_t	*pcp, pcp_search;
-    void	*bcp;
+    bufctl_t	*pcp;
 
     assert(((__psint_t)handle % sizeof(int)) == 0);
-    /*
-     * Initialize a dummy bufctl_t to use only as search key;
-     * only its bc_buf & bc_size fields need to be set, as that's
-     * all that bufctl_t_compare will look at.
-     */
-    pcp_search.bc_buf = handle;
-    pcp_search.bc_size = 1;
 
     PM_LOCK(pdubuf_lock);
-    /* THREADSAFE - no locks acquired in bufctl_t_compare() */
-    bcp = tfind(&pcp_search, &buf_tree, &bufctl_t_compare);
     /*
      * NB: don't release the lock until final disposition of this object;
      * we don't want to play TOCTOU.
      */
-    if (likely(bcp != NULL)) {
-	pcp = *(bufctl_t **)bcp;
-	assert((&pcp->bc_buf[0] <= (char *)handle) &&
-	       ((char *)handle < &pcp->bc_buf[pcp->bc_size]));
+    if (likely((pcp = buffind(handle)) != NULL && pcp->bc_pincnt > 0))
 	pcp->bc_pincnt++;
-    } else {
+    else {
 	PM_UNLOCK(pdubuf_lock);
 	pmNotifyErr(LOG_WARNING, "__pmPinPDUBuf: " PRINTF_P_PFX "%p not in pool!", handle);
 	if (pmDebugOptions.pdubuf)
@@ -186,29 +594,17 @@ __pmPinPDUBuf(void *handle)
 int
 __pmUnpinPDUBuf(void *handle)
 {
-    bufctl_t	*pcp, pcp_search;
-    void	*bcp;
+    bufctl_t	*pcp;
+    int		class;
 
     assert(((__psint_t)handle % sizeof(int)) == 0);
     PM_LOCK(pdubuf_lock);
 
-    /*
-     * Initialize a dummy bufctl_t to use only as search key;
-     * only its bc_buf & bc_size fields need to be set, as that's
-     * all that bufctl_t_compare will look at.
-     */
-    pcp_search.bc_buf = handle;
-    pcp_search.bc_size = 1;
-
-    /* THREADSAFE - no locks acquired in bufctl_t_compare() */
-    bcp = tfind(&pcp_search, &buf_tree, &bufctl_t_compare);
     /*
      * NB: don't release the lock until final disposition of this object;
      * we don't want to play TOCTOU.
      */
-    if (likely(bcp != NULL)) {
-	pcp = *(bufctl_t **)bcp;
-    } else {
+    if (unlikely((pcp = buffind(handle)) == NULL || pcp->bc_pincnt == 0)) {
 	PM_UNLOCK(pdubuf_lock);
 	if (pmDebugOptions.pdubuf) {
 	    fprintf(stderr, "__pmUnpinPDUBuf(" PRINTF_P_PFX "%p) -> fails\n",
@@ -223,51 +619,50 @@ __pmUnpinPDUBuf(void *handle)
 			PRINTF_P_PFX "%p, pincnt=%d\n", handle,
 		pcp->bc_buf, pcp->bc_pincnt - 1);
 
-    assert((&pcp->bc_buf[0] <= (char*)handle) &&
-	   ((char*)handle < &pcp->bc_buf[pcp->bc_size]));
-
     if (likely(--pcp->bc_pincnt == 0)) {
-	/* THREADSAFE - no locks acquired in bufctl_t_compare() */
-	tdelete(pcp, &buf_tree, &bufctl_t_compare);
-	PM_UNLOCK(pdubuf_lock);
-	free(pcp);
-    }
-    else {
-	PM_UNLOCK(pdubuf_lock);
+	class = pcp->bc_class;
+	if (class == PDUBUF_LARGE) {
+	    buffree(pcp);
+	}
+#ifdef PDUBUF_THREAD_CACHE
+	else if (ntcache[class] < PDUBUF_CACHEMAX && tcache_register()) {
+	    PM_UNLOCK(pdubuf_lock);
+	    pcp->bc_next = tcache[class];
+	    tcache[class] = pcp;
+	    ntcache[class]++;
+	    return 1;
+	}
+#endif
+	else if (npool[class] < PDUBUF_POOLMAX) {
+	    pcp->bc_next = pool[class];
+	    pool[class] = pcp;
+	    npool[class]++;
+	}
+	else {
+	    buffree(pcp);
+	}
     }
+    PM_UNLOCK(pdubuf_lock);
 
     return 1;
 }
 
-/*
- * Used to pass context from __pmCountPDUBuf to the pdubufcount callback.
- * They are protected by the pdubuf_lock mutex.
- */
-static int	pdu_bufcnt_need;
-static unsigned	pdu_bufcnt;
-
-static void
-pdubufcount(const void *nodep, const VISIT which, const int depth)
-{
-    const bufctl_t	*pcp = *(bufctl_t **)nodep;
-
-    if (which == postorder || which == leaf)	/* called once per node */
-	if (pcp->bc_size >= pdu_bufcnt_need)
-	    pdu_bufcnt++;
-}
-
 void
 __pmCountPDUBuf(int need, int *alloc, int *free)
 {
-    PM_LOCK(pdubuf_lock);
+    bufctl_t	*pcp;
 
-    pdu_bufcnt_need = need;
-    pdu_bufcnt = 0;
-    /* THREADSAFE - no locks acquired in pdubufcount() */
-    twalk(buf_tree, &pdubufcount);
-    *alloc = pdu_bufcnt;
+    PM_LOCK(pdubuf_lock);
 
-    *free = 0;			/* We don't retain freed nodes. */
+    *alloc = *free = 0;
+    for (pcp = buf_list; pcp != NULL; pcp = pcp->bc_allnext) {
+	if (pcp->bc_size < need)
+	    continue;
+	if (pcp->bc_pincnt > 0)
+	    (*alloc)++;
+	else
+	    (*free)++;
+    }
 
     PM_UNLOCK(pdubuf_lock);
 }
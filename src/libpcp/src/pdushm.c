@@ -0,0 +1,620 @@
+/*
+ * Shared memory PDU transport between pmcd and its pipe-connected PMDAs.
+ *
+ * Copyright (c) 2019 Red Hat.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+
+/*
+ * A ring is a single-producer, single-consumer byte buffer in a shared
+ * mapping, attached to one direction of an IPC channel (file descriptor).
+ * The writer copies a large PDU (already in network byte order) into the
+ * ring and sends a small PDU_SHM_REF down the channel in its place; the
+ * reader sees the reference arrive through the normal __pmGetPDU path,
+ * copies the PDU out of the ring into a PDU buffer and releases the space.
+ *
+ * The channel itself provides the ordering and wakeups, so the ring has
+ * no locks of its own: "head" is only advanced by the writer and "tail"
+ * only by the reader.  When a PDU does not fit, or is small enough that
+ * a pipe write is cheaper, it is simply sent inline as before.
+ *
+ * Clients connected to pmcd on its local unix domain socket can also
+ * offer a ring for the PDUs (mostly fetch results) pmcd sends back to
+ * them - the client creates the ring and passes it to pmcd with the
+ * credentials PDU that starts the connection.  Since the other end may
+ * not be trusted, such rings must be sealed against resizing and each
+ * end keeps its own copies of the ring size and of the index it owns.
+ */
+
+#include "pmapi.h"
+#include "libpcp.h"
+#include "internal.h"
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+#define PDU_SHM_MAGIC	0x50534852	/* "PSHR" */
+#define PDU_SHM_FDMAGIC	0x5053484d	/* "PSHM", message passing a ring */
+
+#if defined(MFD_ALLOW_SEALING) && defined(F_ADD_SEALS)
+#define HAVE_SHM_SEALING 1
+#endif
+
+typedef struct {
+    __uint32_t		magic;
+    __uint32_t		size;		/* bytes in data[], a power of two */
+    volatile __uint32_t	head;		/* advanced by the writer */
+    volatile __uint32_t	tail;		/* advanced by the reader */
+    char		pad[48];	/* keep data[] cache line aligned */
+    char		data[0];
+} shmring_t;
+
+typedef struct {
+    int			fd;		/* IPC channel using this ring */
+    int			mode;		/* PDU_SHM_XMIT or PDU_SHM_RECV */
+    shmring_t		*ring;
+    size_t		maplen;
+    __uint32_t		size;		/* private copy of ring->size */
+    __uint32_t		index;		/* private head (xmit) or tail (recv) */
+} shmipc_t;
+
+int		__pmShmIPCCount;	/* unlocked fast path check */
+static shmipc_t	*shmtab;
+static int	nshmtab;
+
+#ifdef PM_MULTI_THREAD
+static pthread_mutex_t	shm_lock = PTHREAD_MUTEX_INITIALIZER;
+#else
+void			*shm_lock;
+#endif
+
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MKSTEMP)
+
+static shmipc_t *
+shm_lookup(int fd)
+{
+    int		i;
+
+    for (i = 0; i < nshmtab; i++) {
+	if (shmtab[i].fd == fd)
+	    return &shmtab[i];
+    }
+    return NULL;
+}
+
+static int
+shm_tmpfile(void)
+{
+    char	path[MAXPATHLEN];
+    char	*tmpdir;
+    int		fd;
+    mode_t	cur_umask;
+    struct stat	sbuf;
+
+    if (stat("/dev/shm", &sbuf) == 0 && S_ISDIR(sbuf.st_mode))
+	tmpdir = "/dev/shm";
+    else if ((tmpdir = pmGetOptionalConfig("PCP_TMP_DIR")) == NULL)
+	tmpdir = "/tmp";
+    pmsprintf(path, sizeof(path), "%s%cpcp-shm.XXXXXX", tmpdir, pmPathSeparator());
+
+    cur_umask = umask(S_IXUSR | S_IRWXG | S_IRWXO);
+    fd = mkstemp(path);
+    umask(cur_umask);
+    if (fd < 0)
+	return -oserror();
+    unlink(path);
+    return fd;
+}
+
+/*
+ * Create a new (unlinked) ring segment, returning a file descriptor
+ * that can be inherited across fork and exec by the PMDA.  Where the
+ * platform allows, the segment is sealed so its size cannot change
+ * while mapped at the other end.
+ */
+int
+__pmShmCreate(void)
+{
+    shmring_t	*ring;
+    size_t	maplen = sizeof(shmring_t) + PDU_SHM_SIZE;
+    int		fd = -1;
+    int		sts;
+    int		sealed = 0;
+
+#ifdef HAVE_SHM_SEALING
+    if ((fd = memfd_create("pcp-shm", MFD_ALLOW_SEALING)) >= 0)
+	sealed = 1;
+#endif
+    if (fd < 0 && (fd = shm_tmpfile()) < 0)
+	return fd;
+
+    if (ftruncate(fd, maplen) < 0) {
+	sts = -oserror();
+	close(fd);
+	return sts;
+    }
+#ifdef HAVE_SHM_SEALING
+    if (sealed &&
+	fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) {
+	sts = -oserror();
+	close(fd);
+	return sts;
+    }
+#endif
+    ring = (shmring_t *)mmap(NULL, maplen, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    if (ring == (shmring_t *)MAP_FAILED) {
+	sts = -oserror();
+	close(fd);
+	return sts;
+    }
+    ring->magic = PDU_SHM_MAGIC;
+    ring->size = PDU_SHM_SIZE;
+    ring->head = ring->tail = 0;
+    munmap((void *)ring, maplen);
+
+    if (pmDebugOptions.pdu)
+	fprintf(stderr, "__pmShmCreate: fd=%d size=%d%s\n", fd, PDU_SHM_SIZE,
+		sealed ? " sealed" : "");
+    return fd;
+}
+
+/*
+ * Attach a ring to one direction of the channel fd.  The
+ * mapping persists after the caller closes shmfd.
+ */
+int
+__pmSetShmIPC(int fd, int shmfd, int mode)
+{
+    shmring_t	*ring;
+    shmipc_t	*sp;
+    size_t	maplen;
+    __uint32_t	size;
+    struct stat	sbuf;
+
+    if (fd < 0 || (mode != PDU_SHM_XMIT && mode != PDU_SHM_RECV))
+	return -EINVAL;
+    if (fstat(shmfd, &sbuf) < 0)
+	return -oserror();
+    maplen = (size_t)sbuf.st_size;
+    if (maplen <= sizeof(shmring_t))
+	return -EINVAL;
+    ring = (shmring_t *)mmap(NULL, maplen, PROT_READ|PROT_WRITE, MAP_SHARED, shmfd, 0);
+    if (ring == (shmring_t *)MAP_FAILED)
+	return -oserror();
+    size = ring->size;
+    if (ring->magic != PDU_SHM_MAGIC || size == 0 ||
+	size != maplen - sizeof(shmring_t) || (size & (size - 1)) != 0) {
+	munmap((void *)ring, maplen);
+	return -EINVAL;
+    }
+
+    PM_LOCK(shm_lock);
+    if ((sp = shm_lookup(fd)) != NULL)
+	munmap((void *)sp->ring, sp->maplen);
+    else {
+	sp = (shmipc_t *)realloc(shmtab, (nshmtab + 1) * sizeof(shmipc_t));
+	if (sp == NULL) {
+	    PM_UNLOCK(shm_lock);
+	    munmap((void *)ring, maplen);
+	    return -oserror();
+	}
+	shmtab = sp;
+	sp = &shmtab[nshmtab++];
+	sp->fd = fd;
+    }
+    sp->mode = mode;
+    sp->ring = ring;
+    sp->maplen = maplen;
+    sp->size = size;
+    sp->index = (mode == PDU_SHM_XMIT) ? ring->head : ring->tail;
+    __pmShmIPCCount = nshmtab;
+    PM_UNLOCK(shm_lock);
+
+    if (pmDebugOptions.pdu)
+	fprintf(stderr, "__pmSetShmIPC: fd=%d %s ring size=%u\n", fd,
+		mode == PDU_SHM_XMIT ? "xmit" : "recv", size);
+    return 0;
+}
+
+int
+__pmShmIPC(int fd)
+{
+    shmipc_t	*sp;
+    int		mode = 0;
+
+    if (__pmShmIPCCount == 0)
+	return 0;
+    PM_LOCK(shm_lock);
+    if ((sp = shm_lookup(fd)) != NULL)
+	mode = sp->mode;
+    PM_UNLOCK(shm_lock);
+    return mode;
+}
+
+void
+__pmCloseShmIPC(int fd)
+{
+    shmipc_t	*sp;
+
+    if (__pmShmIPCCount == 0)
+	return;
+    PM_LOCK(shm_lock);
+    if ((sp = shm_lookup(fd)) != NULL) {
+	munmap((void *)sp->ring, sp->maplen);
+	*sp = shmtab[--nshmtab];
+	__pmShmIPCCount = nshmtab;
+    }
+    PM_UNLOCK(shm_lock);
+}
+
+/*
+ * Place a PDU (len bytes, header already in network byte order) in
+ * the ring for fd, filling in ref to be sent in its place.  Returns 1
+ * if the PDU is in the ring, 0 if it should be sent inline.
+ */
+int
+__pmShmXmit(int fd, const __pmPDU *pdubuf, int len, __pmShmRef *ref)
+{
+    const char	*src = (const char *)pdubuf;
+    shmring_t	*ring;
+    shmipc_t	*sp;
+    __uint32_t	head, used, off, part;
+
+    PM_LOCK(shm_lock);
+    if ((sp = shm_lookup(fd)) == NULL || sp->mode != PDU_SHM_XMIT) {
+	PM_UNLOCK(shm_lock);
+	return 0;
+    }
+    ring = sp->ring;
+    head = sp->index;
+    used = head - ring->tail;
+    if (used > sp->size || (__uint32_t)len > sp->size - used) {
+	PM_UNLOCK(shm_lock);
+	if (pmDebugOptions.pdu)
+	    fprintf(stderr, "__pmShmXmit: fd=%d len=%d ring %s, sent inline\n",
+		    fd, len, used > sp->size ? "corrupt" : "full");
+	return 0;
+    }
+
+    off = head & (sp->size - 1);
+    part = sp->size - off;
+    if (part >= (__uint32_t)len)
+	memcpy(&ring->data[off], src, len);
+    else {
+	memcpy(&ring->data[off], src, part);
+	memcpy(&ring->data[0], src + part, len - part);
+    }
+    __sync_synchronize();
+    ring->head = sp->index = head + len;
+    PM_UNLOCK(shm_lock);
+
+    ref->hdr.len = htonl(sizeof(__pmShmRef));
+    ref->hdr.type = htonl(PDU_SHM_REF);
+    ref->hdr.from = ((const __pmPDUHdr *)pdubuf)->from;
+    ref->start = htonl(head);
+    ref->len = htonl(len);
+
+    if (pmDebugOptions.pdu)
+	fprintf(stderr, "__pmShmXmit: fd=%d len=%d start=%u\n", fd, len, head);
+    return 1;
+}
+
+/*
+ * Replace the PDU_SHM_REF in *result (header len already in host
+ * byte order) with a newly pinned PDU buffer holding the referenced
+ * PDU, also with its header len in host byte order.
+ */
+int
+__pmShmRecv(int fd, __pmPDU **result)
+{
+    __pmShmRef	*ref = (__pmShmRef *)*result;
+    __pmPDU	*pdubuf;
+    char	*dst;
+    shmring_t	*ring;
+    shmipc_t	*sp;
+    __uint32_t	start, len, head, off, part;
+
+    if (ref->hdr.len != sizeof(__pmShmRef)) {
+	pmNotifyErr(LOG_ERR, "__pmShmRecv: fd=%d bad reference len=%d",
+		    fd, ref->hdr.len);
+	return PM_ERR_IPC;
+    }
+    start = ntohl(ref->start);
+    len = ntohl(ref->len);
+
+    PM_LOCK(shm_lock);
+    if ((sp = shm_lookup(fd)) == NULL || sp->mode != PDU_SHM_RECV) {
+	PM_UNLOCK(shm_lock);
+	pmNotifyErr(LOG_ERR, "__pmShmRecv: fd=%d unexpected reference", fd);
+	return PM_ERR_IPC;
+    }
+    ring = sp->ring;
+    head = ring->head;
+    if (start != sp->index || len > head - start ||
+	len > sp->size || len < sizeof(__pmPDUHdr)) {
+	PM_UNLOCK(shm_lock);
+	pmNotifyErr(LOG_ERR, "__pmShmRecv: fd=%d bad reference start=%u len=%u "
+		    "(head=%u tail=%u)", fd, start, len, head, sp->index);
+	return PM_ERR_IPC;
+    }
+    if ((pdubuf = __pmFindPDUBuf(len)) == NULL) {
+	PM_UNLOCK(shm_lock);
+	return -oserror();
+    }
+    __sync_synchronize();
+    dst = (char *)pdubuf;
+    off = start & (sp->size - 1);
+    part = sp->size - off;
+    if (part >= len)
+	memcpy(dst, &ring->data[off], len);
+    else {
+	memcpy(dst, &ring->data[off], part);
+	memcpy(dst + part, &ring->data[0], len - part);
+    }
+    __sync_synchronize();
+    ring->tail = sp->index = start + len;
+    PM_UNLOCK(shm_lock);
+
+    ((__pmPDUHdr *)pdubuf)->len = ntohl(((__pmPDUHdr *)pdubuf)->len);
+    if (((__pmPDUHdr *)pdubuf)->len != (int)len) {
+	pmNotifyErr(LOG_ERR, "__pmShmRecv: fd=%d PDU len=%d, reference len=%u",
+		    fd, ((__pmPDUHdr *)pdubuf)->len, len);
+	__pmUnpinPDUBuf(pdubuf);
+	return PM_ERR_IPC;
+    }
+    __pmUnpinPDUBuf(*result);
+    *result = pdubuf;
+
+    if (pmDebugOptions.pdu)
+	fprintf(stderr, "__pmShmRecv: fd=%d len=%u start=%u\n", fd, len, start);
+    return 0;
+}
+
+#else /* !HAVE_SYS_MMAN_H || !HAVE_MKSTEMP */
+
+int
+__pmShmCreate(void)
+{
+    return -EOPNOTSUPP;
+}
+
+int
+__pmSetShmIPC(int fd, int shmfd, int mode)
+{
+    (void)fd; (void)shmfd; (void)mode;
+    return -EOPNOTSUPP;
+}
+
+int
+__pmShmIPC(int fd)
+{
+    (void)fd;
+    return 0;
+}
+
+void
+__pmCloseShmIPC(int fd)
+{
+    (void)fd;
+}
+
+int
+__pmShmXmit(int fd, const __pmPDU *pdubuf, int len, __pmShmRef *ref)
+{
+    (void)fd; (void)pdubuf; (void)len; (void)ref;
+    return 0;
+}
+
+int
+__pmShmRecv(int fd, __pmPDU **result)
+{
+    (void)fd; (void)result;
+    return PM_ERR_IPC;
+}
+
+#endif
+
+/*
+ * Rings offered by pmcd clients on the local unix domain socket.
+ */
+
+#if defined(HAVE_STRUCT_SOCKADDR_UN)
+
+/* -1 => not yet initialized, else 0 (disabled) or 1 (enabled) */
+static int	shm_transport = -1;
+
+static int
+shm_sealed(int shmfd)
+{
+#ifdef F_GET_SEALS
+    int		seals = fcntl(shmfd, F_GET_SEALS);
+
+    return seals >= 0 && (seals & F_SEAL_SHRINK) != 0;
+#else
+    (void)shmfd;
+    return 0;
+#endif
+}
+
+/*
+ * Create a ring for PDUs sent back by pmcd on the connection fd, if
+ * fd is a unix domain socket and the ring can be sealed; else return
+ * an error and the client simply does not ask pmcd to use a ring.
+ */
+int
+__pmShmCreateLocal(int fd)
+{
+    struct sockaddr_storage	addr;
+    socklen_t	addrlen = sizeof(addr);
+    char	*str;
+    int		shmfd;
+
+    PM_LOCK(__pmLock_extcall);
+    if (shm_transport < 0) {
+	/* one-trip initialization */
+	str = getenv("PCP_SHM_TRANSPORT");	/* THREADSAFE */
+	shm_transport = (str == NULL || strcmp(str, "0") != 0);
+    }
+    PM_UNLOCK(__pmLock_extcall);
+    if (shm_transport == 0)
+	return -EOPNOTSUPP;
+
+    if (getsockname(fd, (struct sockaddr *)&addr, &addrlen) < 0)
+	return -oserror();
+    if (addr.ss_family != AF_UNIX)
+	return -EOPNOTSUPP;
+
+    if ((shmfd = __pmShmCreate()) < 0)
+	return shmfd;
+    if (!shm_sealed(shmfd)) {
+	close(shmfd);
+	return -EOPNOTSUPP;
+    }
+    return shmfd;
+}
+
+/*
+ * Pass the ring shmfd to pmcd, following the credentials PDU that
+ * asked for PDU_FLAG_SHM.  With shmfd < 0, the message is sent with
+ * no ring attached and pmcd continues with PDUs sent inline.
+ */
+int
+__pmShmSendFd(int fd, int shmfd)
+{
+    struct msghdr	msgh;
+    struct iovec	iov;
+    struct cmsghdr	*cmhp;
+    union {
+	struct cmsghdr	cmh;
+	char		control[CMSG_SPACE(sizeof(int))];
+    } control_un;
+    __uint32_t		magic = htonl(PDU_SHM_FDMAGIC);
+
+    memset(&msgh, 0, sizeof(msgh));
+    msgh.msg_iov = &iov;
+    msgh.msg_iovlen = 1;
+    iov.iov_base = &magic;
+    iov.iov_len = sizeof(magic);
+
+    if (shmfd >= 0) {
+	memset(&control_un, 0, sizeof(control_un));
+	msgh.msg_control = control_un.control;
+	msgh.msg_controllen = sizeof(control_un.control);
+	cmhp = CMSG_FIRSTHDR(&msgh);
+	cmhp->cmsg_level = SOL_SOCKET;
+	cmhp->cmsg_type = SCM_RIGHTS;
+	cmhp->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmhp), &shmfd, sizeof(int));
+    }
+
+    __pmIgnoreSignalPIPE();
+    if (sendmsg(fd, &msgh, MSG_NOSIGNAL) != sizeof(magic))
+	return PM_ERR_IPC;
+    if (pmDebugOptions.pdu)
+	fprintf(stderr, "__pmShmSendFd: fd=%d shmfd=%d\n", fd, shmfd);
+    return 0;
+}
+
+/*
+ * Receive the message sent by __pmShmSendFd on fd, waiting at most
+ * timeout.  Returns a ring file descriptor to be attached for PDUs
+ * sent on fd, PM_ERR_IPC or PM_ERR_TIMEOUT if the message could not
+ * be read (and the connection is unusable), or another error if the
+ * ring is missing or not acceptable - PDUs are then sent inline.
+ */
+int
+__pmShmRecvFd(int fd, struct timeval *timeout)
+{
+    struct msghdr	msgh;
+    struct iovec	iov;
+    struct cmsghdr	*cmhp;
+    union {
+	struct cmsghdr	cmh;
+	char		control[CMSG_SPACE(sizeof(int))];
+    } control_un;
+    struct stat		sbuf;
+    __uint32_t		magic;
+    int			shmfd = -1;
+    int			flags = 0;
+    int			sts;
+
+    if ((sts = __pmSocketReady(fd, timeout)) <= 0)
+	return sts < 0 ? PM_ERR_IPC : PM_ERR_TIMEOUT;
+
+    memset(&msgh, 0, sizeof(msgh));
+    memset(&control_un, 0, sizeof(control_un));
+    msgh.msg_iov = &iov;
+    msgh.msg_iovlen = 1;
+    msgh.msg_control = control_un.control;
+    msgh.msg_controllen = sizeof(control_un.control);
+    iov.iov_base = &magic;
+    iov.iov_len = sizeof(magic);
+#ifdef MSG_CMSG_CLOEXEC
+    flags |= MSG_CMSG_CLOEXEC;
+#endif
+    if (recvmsg(fd, &msgh, flags) != sizeof(magic) ||
+	ntohl(magic) != PDU_SHM_FDMAGIC)
+	return PM_ERR_IPC;
+
+    cmhp = CMSG_FIRSTHDR(&msgh);
+    if (cmhp == NULL ||
+	cmhp->cmsg_level != SOL_SOCKET ||
+	cmhp->cmsg_type != SCM_RIGHTS ||
+	cmhp->cmsg_len != CMSG_LEN(sizeof(int)))
+	return -ENOENT;
+    memcpy(&shmfd, CMSG_DATA(cmhp), sizeof(int));
+
+    /*
+     * The ring belongs to the client: it must not be able to shrink
+     * the mapping under us, and should be exactly the expected size.
+     */
+    if (!shm_sealed(shmfd))
+	sts = -EPERM;
+    else if (fstat(shmfd, &sbuf) < 0)
+	sts = -oserror();
+    else if (!S_ISREG(sbuf.st_mode) ||
+	     sbuf.st_size != sizeof(shmring_t) + PDU_SHM_SIZE)
+	sts = -EINVAL;
+    else
+	sts = shmfd;
+    if (sts < 0)
+	close(shmfd);
+
+    if (pmDebugOptions.pdu)
+	fprintf(stderr, "__pmShmRecvFd: fd=%d shmfd=%d sts=%d\n", fd, shmfd, sts);
+    return sts;
+}
+
+#else /* !HAVE_STRUCT_SOCKADDR_UN */
+
+int
+__pmShmCreateLocal(int fd)
+{
+    (void)fd;
+    return -EOPNOTSUPP;
+}
+
+int
+__pmShmSendFd(int fd, int shmfd)
+{
+    (void)fd; (void)shmfd;
+    return -EOPNOTSUPP;
+}
+
+int
+__pmShmRecvFd(int fd, struct timeval *timeout)
+{
+    (void)fd; (void)timeout;
+    return PM_ERR_IPC;
+}
+
+#endif
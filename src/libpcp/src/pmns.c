@@ -109,7 +109,7 @@ static int export;
 static int havePmLoadCall;
 
 static int load(const char *, int, int);
-static __pmnsNode *locate(const char *, __pmnsNode *);
+static __pmnsNode *locate(const char *, __pmnsTree *);
 
 #ifdef PM_MULTI_THREAD
 static pthread_mutex_t	pmns_lock;
@@ -928,6 +928,7 @@ pass2(int dupok)
     main_pmns->htab = NULL;
     main_pmns->htabsize = 0;
     main_pmns->mark_state = UNKNOWN_MARK_STATE;
+    main_pmns->index = NULL;
 
     /* Get the root subtree out of the seen list */
     if ((main_pmns->root = findseen("root")) == NULL) {
@@ -1012,6 +1013,145 @@ mark_one(__pmnsTree *pmns, pmID pmid, int bit)
 }
 
 
+/*
+ * Index of child nodes, keyed on the parent node and the name of the
+ * child, so translating a name costs one probe per component rather
+ * than a scan along the list of siblings at each level ... this matters
+ * for archives and PMDAs with very wide subtrees, where adding every
+ * name was quadratic in the number of siblings.
+ *
+ * Open addressing with linear probing, the table size is a power of 2
+ * and the table is kept at most half full.  If the index cannot be
+ * allocated, or has been dropped, lookups fall back to the sibling
+ * lists, so the index is only ever an accelerator.
+ */
+typedef struct __pmnsIndex {
+    __pmnsNode		**tab;
+    unsigned int	size;
+    unsigned int	used;
+} __pmnsIndex;
+
+#define INDEX_MINSIZE	64
+
+static unsigned int
+childhash(const __pmnsNode *parent, const char *name, int nch)
+{
+    unsigned int	h;
+    int			i;
+
+    /* FNV-1a over the name, seeded from the parent node address */
+    h = 2166136261U ^ (unsigned int)(((__psint_t)parent >> 4) * 2654435761U);
+    for (i = 0; i < nch; i++)
+	h = (h ^ (unsigned char)name[i]) * 16777619U;
+    return h;
+}
+
+static void
+index_free(__pmnsTree *tree)
+{
+    if (tree->index != NULL) {
+	free(tree->index->tab);
+	free(tree->index);
+	tree->index = NULL;
+    }
+}
+
+static int
+index_resize(__pmnsIndex *ip, unsigned int size)
+{
+    __pmnsNode		**tab;
+    __pmnsNode		*np;
+    unsigned int	i, j;
+
+    if ((tab = (__pmnsNode **)calloc(size, sizeof(tab[0]))) == NULL)
+	return -oserror();
+    for (i = 0; i < ip->size; i++) {
+	if ((np = ip->tab[i]) == NULL)
+	    continue;
+	j = childhash(np->parent, np->name, (int)strlen(np->name)) & (size - 1);
+	while (tab[j] != NULL)
+	    j = (j + 1) & (size - 1);
+	tab[j] = np;
+    }
+    free(ip->tab);
+    ip->tab = tab;
+    ip->size = size;
+    return 0;
+}
+
+/*
+ * Add np (with np->parent already set) to the index ... on failure
+ * the index is dropped.
+ */
+static void
+index_add(__pmnsTree *tree, __pmnsNode *np)
+{
+    __pmnsIndex		*ip = tree->index;
+    unsigned int	j;
+
+    if (ip == NULL)
+	return;
+    if (2 * (ip->used + 1) > ip->size &&
+	index_resize(ip, ip->size ? 2 * ip->size : INDEX_MINSIZE) < 0) {
+	index_free(tree);
+	return;
+    }
+    j = childhash(np->parent, np->name, (int)strlen(np->name)) & (ip->size - 1);
+    while (ip->tab[j] != NULL)
+	j = (j + 1) & (ip->size - 1);
+    ip->tab[j] = np;
+    ip->used++;
+}
+
+static void
+index_addtree(__pmnsTree *tree, __pmnsNode *root)
+{
+    __pmnsNode	*np;
+
+    for (np = root->first; np != NULL && tree->index != NULL; np = np->next) {
+	index_add(tree, np);
+	index_addtree(tree, np);
+    }
+}
+
+/*
+ * (Re)build the index for the whole tree, parent links must be
+ * correct
+ */
+static void
+index_build(__pmnsTree *tree)
+{
+    index_free(tree);
+    if ((tree->index = (__pmnsIndex *)calloc(1, sizeof(__pmnsIndex))) != NULL)
+	index_addtree(tree, tree->root);
+}
+
+/*
+ * Find the child of parent called name[0] ... name[nch-1]
+ */
+static __pmnsNode *
+findchild(__pmnsTree *tree, __pmnsNode *parent, const char *name, int nch)
+{
+    __pmnsIndex		*ip = tree->index;
+    __pmnsNode		*np;
+    unsigned int	j;
+
+    if (ip == NULL || ip->size == 0) {
+	for (np = parent->first; np != NULL; np = np->next) {
+	    if (strncmp(name, np->name, nch) == 0 && np->name[nch] == '\0')
+		break;
+	}
+	return np;
+    }
+    j = childhash(parent, name, nch) & (ip->size - 1);
+    for ( ; (np = ip->tab[j]) != NULL; j = (j + 1) & (ip->size - 1)) {
+	if (np->parent == parent &&
+	    strncmp(name, np->name, nch) == 0 && np->name[nch] == '\0')
+	    break;
+    }
+    return np;
+}
+
 /*
  * Create a new empty PMNS for Adding nodes to.
  * Use with __pmAddPMNSNode() and __pmFixPMNSHashTab()
@@ -1044,6 +1184,8 @@ __pmNewPMNS(__pmnsTree **pmns)
     t->htab = NULL;
     t->htabsize = 0;
     t->mark_state = UNKNOWN_MARK_STATE;
+    /* index maintained as nodes are added */
+    t->index = (__pmnsIndex *)calloc(1, sizeof(__pmnsIndex));
 
     *pmns = t;
     return 0;
@@ -1083,6 +1225,7 @@ __pmFixPMNSHashTab(__pmnsTree *tree, int numpmid, int dupok)
     if ((sts = backlink(tree, tree->root, dupok)) < 0) {
 	goto pmapi_return;
     }
+    index_build(tree);
     mark_all(tree, 0);
     sts = 0;
 
@@ -1099,7 +1242,7 @@ pmapi_return:
  */
 
 static int
-AddPMNSNode(__pmnsNode *root, int pmid, const char *name)
+AddPMNSNode(__pmnsTree *tree, __pmnsNode *root, int pmid, const char *name)
 {
     __pmnsNode *np = NULL;
     const char *tail;
@@ -1111,11 +1254,8 @@ AddPMNSNode(__pmnsNode *root, int pmid, const char *name)
 
     nch = (int)(tail - name);
 
-    /* Compare name with all the child nodes */
-    for (np = root->first; np != NULL; np = np->next) {
-	if (strncmp(name, np->name, (int)nch) == 0 && np->name[(int)nch] == '\0')
-	    break;
-    }
+    /* Find name among the child nodes */
+    np = findchild(tree, root, name, nch);
 
     if (np == NULL) { /* no match with child */
 	__pmnsNode *parent_np = root;
@@ -1147,6 +1287,7 @@ AddPMNSNode(__pmnsNode *root, int pmid, const char *name)
 		}
 	    }
 	    parent_np->first = np;
+	    index_add(tree, np);
 
 	    /* at this stage, assume np is a non-leaf */
 	    np->pmid = PM_ID_NULL;
@@ -1170,7 +1311,7 @@ AddPMNSNode(__pmnsNode *root, int pmid, const char *name)
 	    return 0;
     }
     else {
-	return AddPMNSNode(np, pmid, tail+1); /* try matching with rest of pathname */
+	return AddPMNSNode(tree, np, pmid, tail+1); /* try matching with rest of pathname */
     }
 
 }
@@ -1184,7 +1325,101 @@ AddPMNSNode(__pmnsNode *root, int pmid, const char *name)
 int
 __pmAddPMNSNode(__pmnsTree *tree, int pmid, const char *name)
 {
-    return AddPMNSNode(tree->root, pmid, name);
+    return AddPMNSNode(tree, tree->root, pmid, name);
+}
+
+/*
+ * Find the node for fullpath, name, using the child index so the cost
+ * is independent of the number of siblings at each level.
+ */
+__pmnsNode *
+__pmFindPMNSNode(__pmnsTree *tree, const char *name)
+{
+    const char	*tail;
+    __pmnsNode	*np = tree->root;
+
+    for ( ; ; ) {
+	for (tail = name; *tail && *tail != '.'; tail++)
+	    ;
+	if ((np = findchild(tree, np, name, (int)(tail - name))) == NULL)
+	    return NULL;
+	if (*tail == '\0')
+	    return np;
+	name = tail + 1;
+    }
+}
+
+/*
+ * Remove np from the index, re-placing the rest of its probe
+ * cluster so later lookups do not stop short at the hole.
+ */
+static void
+index_remove(__pmnsTree *tree, __pmnsNode *np)
+{
+    __pmnsIndex		*ip = tree->index;
+    __pmnsNode		*xp;
+    unsigned int	j, k, mask;
+
+    if (ip == NULL || ip->size == 0)
+	return;
+    mask = ip->size - 1;
+    j = childhash(np->parent, np->name, (int)strlen(np->name)) & mask;
+    for ( ; ip->tab[j] != np; j = (j + 1) & mask) {
+	if (ip->tab[j] == NULL)
+	    return;
+    }
+    ip->tab[j] = NULL;
+    ip->used--;
+    for (j = (j + 1) & mask; (xp = ip->tab[j]) != NULL; j = (j + 1) & mask) {
+	ip->tab[j] = NULL;
+	k = childhash(xp->parent, xp->name, (int)strlen(xp->name)) & mask;
+	while (ip->tab[k] != NULL)
+	    k = (k + 1) & mask;
+	ip->tab[k] = xp;
+    }
+}
+
+/*
+ * Remove the leaf node for fullpath, name, and any non-leaf nodes
+ * above it that are left with no children.  The hash table (if any)
+ * and the child index are kept up to date, so unlike adding nodes
+ * there is no need to call __pmFixPMNSHashTab() afterwards.
+ */
+int
+__pmRemovePMNSNode(__pmnsTree *tree, const char *name)
+{
+    __pmnsNode	*np, *parent, **npp;
+
+    if ((np = __pmFindPMNSNode(tree, name)) == NULL)
+	return PM_ERR_NAME;
+    if (np->pmid == PM_ID_NULL)
+	return PM_ERR_NAME;	/* only leaf names can be removed */
+
+    if (tree->htabsize > 0) {
+	npp = &tree->htab[np->pmid % tree->htabsize];
+	for ( ; *npp != NULL; npp = &(*npp)->hash) {
+	    if (*npp == np) {
+		*npp = np->hash;
+		break;
+	    }
+	}
+    }
+
+    do {
+	parent = np->parent;
+	for (npp = &parent->first; *npp != NULL; npp = &(*npp)->next) {
+	    if (*npp == np) {
+		*npp = np->next;
+		break;
+	    }
+	}
+	index_remove(tree, np);
+	free(np->name);
+	free(np);
+	np = parent;
+    } while (np != tree->root && np->first == NULL);
+
+    return 0;
 }
 
 /*
@@ -1539,6 +1774,9 @@ __pmExportPMNS(void)
     lock_ctx_and_pmns(NULL, &ctx_ctl);
 
     export = 1;
+    /* caller is about to edit the tree directly */
+    if (main_pmns != NULL)
+	index_free(main_pmns);
 
     if (ctx_ctl.need_pmns_unlock)
 	PM_UNLOCK(pmns_lock);
@@ -1552,34 +1790,26 @@ __pmExportPMNS(void)
 }
 
 /*
- * Find and return the named node in the tree, root.
+ * Find and return the named node in the tree.
  */
 static __pmnsNode *
-locate(const char *name, __pmnsNode *root)
+locate(const char *name, __pmnsTree *tree)
 {
     const char	*tail;
-    ptrdiff_t	nch;
-    __pmnsNode	*np;
-
-    /* Traverse until '.' or '\0' */
-    for (tail = name; *tail && *tail != '.'; tail++)
-	;
+    __pmnsNode	*np = tree->root;
 
-    nch = tail - name;
+    for ( ; ; ) {
+	/* Traverse until '.' or '\0' */
+	for (tail = name; *tail && *tail != '.'; tail++)
+	    ;
 
-    /* Compare name with all the child nodes */
-    for (np = root->first; np != NULL; np = np->next) {
-	if (strncmp(name, np->name, (int)nch) == 0 && np->name[(int)nch] == '\0' &&
-	    (np->pmid & MARK_BIT) == 0)
-	    break;
+	np = findchild(tree, np, name, (int)(tail - name));
+	if (np == NULL || (np->pmid & MARK_BIT) != 0)
+	    return NULL;	/* no match with child */
+	if (*tail == '\0')
+	    return np;		/* matched with whole path */
+	name = tail + 1;	/* try matching with rest of pathname */
     }
-
-    if (np == NULL) /* no match with child */
-	return NULL;
-    else if (*tail == '\0') /* matched with whole path */
-	return np;
-    else
-	return locate(tail+1, np); /* try matching with rest of pathname */
 }
 
 /*
@@ -1656,6 +1886,7 @@ __pmFreePMNS(__pmnsTree *pmns)
 {
     if (pmns != NULL) {
 	free(pmns->htab);
+	index_free(pmns);
 	FreeTraversePMNS(pmns->root);
 	free(pmns);
     }
@@ -1767,7 +1998,7 @@ pmLookupName_ctx(__pmContext *ctxp, int derive_locked, int numpmid, const char *
 	     * if we locate the name and it is a leaf in the PMNS
 	     * this is good
 	     */
-	    np = locate(namelist[i], PM_TPD(curr_pmns)->root);
+	    np = locate(namelist[i], PM_TPD(curr_pmns));
 	    if (np != NULL ) {
 		if (np->first == NULL) {
 		    /* looks good from local PMNS */
@@ -1797,7 +2028,7 @@ pmLookupName_ctx(__pmContext *ctxp, int derive_locked, int numpmid, const char *
 	    while ((xp = rindex(xname, '.')) != NULL) {
 		*xp = '\0';
 		lsts = 0;
-		np = locate(xname, PM_TPD(curr_pmns)->root);
+		np = locate(xname, PM_TPD(curr_pmns));
 		if (np != NULL && np->first == NULL &&
 		    IS_DYNAMIC_ROOT(np->pmid)) {
 		    /* root of dynamic subtree */
@@ -1876,6 +2107,21 @@ pmLookupName_ctx(__pmContext *ctxp, int derive_locked, int numpmid, const char *
 	    fputc('\n', stderr);
 	}
 
+	/*
+	 * If every name has been looked up before, and pmcd has not
+	 * reported a PMNS change since, there is no need to ask again.
+	 */
+	for (i = 0; i < numpmid; i++) {
+	    if (!__pmLookupCacheName(ctxp, namelist[i], &pmidlist[i]))
+		break;
+	}
+	if (i == numpmid) {
+	    sts = num_ok = numpmid;
+	    base = numpmid;
+	    if (pmDebugOptions.pmns)
+		fprintf(stderr, "pmLookupName: all %d names cached\n", numpmid);
+	}
+
 	/*
 	 * Avoid false DoS response from pmcd ...
 	 * pmcd has a hard 64 Kbyte max PDU length, so we need to be sure
@@ -1943,6 +2189,8 @@ PM_FAULT_POINT("libpcp/" __FILE__ ":1", PM_FAULT_CALL);
 		    if (sts >= 0) {
 			sts = op_status;
 			num_ok += op_status;
+			for (i = base; i < base + num; i++)
+			    __pmLookupCacheAddName(ctxp, namelist[i], pmidlist[i]);
 		    }
 		}
 		else if (sts == PDU_ERROR)
@@ -2256,7 +2504,7 @@ getchildren(__pmContext *ctxp, int needlocks, const char *name, char ***offsprin
 	if (*name == '\0')
 	    np = PM_TPD(curr_pmns)->root; /* use "" to name the root of the PMNS */
 	else
-	    np = locate(name, PM_TPD(curr_pmns)->root);
+	    np = locate(name, PM_TPD(curr_pmns));
 	if (np == NULL) {
 	    if (ctxp != NULL && ctxp->c_type == PM_CONTEXT_LOCAL) {
 		/*
@@ -2274,7 +2522,7 @@ getchildren(__pmContext *ctxp, int needlocks, const char *name, char ***offsprin
 		}
 		while ((xp = rindex(xname, '.')) != NULL) {
 		    *xp = '\0';
-		    np = locate(xname, PM_TPD(curr_pmns)->root);
+		    np = locate(xname, PM_TPD(curr_pmns));
 		    if (np != NULL && np->first == NULL &&
 			IS_DYNAMIC_ROOT(np->pmid)) {
 			int		domain = ((__pmID_int *)&np->pmid)->cluster;
@@ -3032,7 +3280,14 @@ TraversePMNS(const char *name, void(*func)(const char *), void(*func_r)(const ch
 	    sts = PM_ERR_NOCONTEXT;
 	    goto pmapi_return;
 	}
-	sts = __pmSendTraversePMNSReq(ctxp->c_pmcd->pc_fd, __pmPtrToHandle(ctxp), name);
+	/*
+	 * if we're caching lookups, ask for the descriptors as well and
+	 * seed the cache from the reply
+	 */
+	if (__pmLookupCacheEnabled(ctxp))
+	    sts = __pmSendTraversePMNSDescsReq(ctxp->c_pmcd->pc_fd, __pmPtrToHandle(ctxp), name);
+	else
+	    sts = __pmSendTraversePMNSReq(ctxp->c_pmcd->pc_fd, __pmPtrToHandle(ctxp), name);
 	if (sts < 0) {
 	    sts = __pmMapErrno(sts);
 	    goto pmapi_return;
@@ -3042,11 +3297,33 @@ TraversePMNS(const char *name, void(*func)(const char *), void(*func_r)(const ch
 	    int		xtra;
 	    char	**namelist;
 	    int		pinpdu;
+	    int		havenames = 0;
 
 PM_FAULT_POINT("libpcp/" __FILE__ ":4", PM_FAULT_CALL);
 	    pinpdu = sts = __pmGetPDU(ctxp->c_pmcd->pc_fd, ANY_SIZE, 
 				      TIMEOUT_DEFAULT, &pb);
 
+	    if (sts == PDU_PMNS_NAMEDESCS) {
+		pmDesc	*desclist;
+
+		sts = __pmDecodeNameDescs(pb, &numnames, &namelist, &desclist);
+		if (sts > 0) {
+		    /* seed the cache while we still hold the context lock */
+		    for (i = 0; i < numnames; i++) {
+			if (desclist[i].pmid == PM_ID_NULL)
+			    continue;
+			__pmLookupCacheAddName(ctxp, namelist[i], desclist[i].pmid);
+			__pmLookupCacheAddDesc(ctxp, &desclist[i]);
+		    }
+		    free(desclist);
+		}
+		havenames = 1;
+	    }
+	    else if (sts == PDU_PMNS_NAMES) {
+		sts = __pmDecodeNameList(pb, &numnames, &namelist, NULL);
+		havenames = 1;
+	    }
+
 	    /*
 	     * It is important that we don't hold the context lock before
 	     * doing the callback, which implies we have to release the
@@ -3061,9 +3338,7 @@ PM_FAULT_POINT("libpcp/" __FILE__ ":4", PM_FAULT_CALL);
 		ctx_ctl.need_ctx_unlock = 0;
 	    }
 
-	    if (sts == PDU_PMNS_NAMES) {
-		sts = __pmDecodeNameList(pb, &numnames, 
-		                      &namelist, NULL);
+	    if (havenames) {
 		if (sts > 0) {
 		    for (i=0; i<numnames; i++) {
 			if (func_r == NULL)
@@ -16,6 +16,47 @@
 #include "libpcp.h"
 #include "internal.h"
 
+/*
+ * Profiles are kept in a canonical order - the per-indom entries sorted
+ * by indom and each instance list sorted - so that the checks made by
+ * PMDAs for every instance of every fetch are binary searches rather
+ * than linear scans of (potentially) thousands of instances.
+ */
+static int
+_cmpinst(const void *a, const void *b)
+{
+    int		ia = *(const int *)a;
+    int		ib = *(const int *)b;
+
+    return (ia > ib) - (ia < ib);
+}
+
+static int
+_cmpindom(const void *a, const void *b)
+{
+    pmInDom	ia = ((const pmInDomProfile *)a)->indom;
+    pmInDom	ib = ((const pmInDomProfile *)b)->indom;
+
+    return (ia > ib) - (ia < ib);
+}
+
+/*
+ * Sort a profile received from a client, see __pmDecodeProfile()
+ */
+void
+__pmSortProfile(pmProfile *prof)
+{
+    pmInDomProfile	*p, *p_end;
+
+    if (prof == NULL || prof->profile_len <= 0)
+	return;
+    qsort(prof->profile, prof->profile_len, sizeof(pmInDomProfile), _cmpindom);
+    for (p = prof->profile, p_end = p + prof->profile_len; p < p_end; p++) {
+	if (p->instances_len > 1)
+	    qsort(p->instances, p->instances_len, sizeof(int), _cmpinst);
+    }
+}
+
 static int *
 _subtract(int *list, int *list_len, int *arg, int arg_len)
 {
@@ -55,8 +96,11 @@ _union(int *list, int *list_len, int *arg, int arg_len)
 
     if (list == NULL) {
 	list = (int *)malloc(arg_len * sizeof(int));
+	if (list == NULL)
+	    return NULL;
 	memcpy((void *)list, (void *)arg, arg_len * sizeof(int));
 	*list_len = arg_len;
+	qsort(list, arg_len, sizeof(int), _cmpinst);
 	return list;
     }
 
@@ -74,6 +118,7 @@ _union(int *list, int *list_len, int *arg, int arg_len)
 	    new[new_len++] = arg[i];
     }
     *list_len = new_len;
+    qsort(new, new_len, sizeof(int), _cmpinst);
     return new;
 }
 
@@ -104,6 +149,7 @@ static pmInDomProfile *
 _newprof(pmInDom indom, __pmContext *ctxp)
 {
     pmInDomProfile	*p;
+    int			i;
 
     if (ctxp->c_instprof->profile == NULL) {
 	/* create a new profile for this inDom in the default state */
@@ -115,15 +161,20 @@ _newprof(pmInDom indom, __pmContext *ctxp)
 	ctxp->c_instprof->profile_len = 1;
     }
     else {
-	/* append a new profile to the end of the list */
-	ctxp->c_instprof->profile_len++;
+	/* insert a new profile into the list, which is sorted by indom */
 	p = (pmInDomProfile *)realloc((void *)ctxp->c_instprof->profile, 
-	    ctxp->c_instprof->profile_len * sizeof(pmInDomProfile));
+	    (ctxp->c_instprof->profile_len + 1) * sizeof(pmInDomProfile));
 	if (p == NULL)
 	    /* fail, no changes */
 	    return NULL;
 	ctxp->c_instprof->profile = p;
-	p = ctxp->c_instprof->profile + ctxp->c_instprof->profile_len - 1;
+	for (i = 0; i < ctxp->c_instprof->profile_len; i++) {
+	    if (p[i].indom > indom)
+		break;
+	}
+	memmove(&p[i+1], &p[i], (ctxp->c_instprof->profile_len - i) * sizeof(pmInDomProfile));
+	ctxp->c_instprof->profile_len++;
+	p = &p[i];
     }
 
     /* initialise a new profile entry : default = include all instances */
@@ -137,25 +188,21 @@ _newprof(pmInDom indom, __pmContext *ctxp)
 pmInDomProfile *
 __pmFindProfile(pmInDom indom, const pmProfile *prof)
 {
-    pmInDomProfile	*p, *p_end;
+    pmInDomProfile	key;
 
-    if (prof != NULL && prof->profile_len > 0)
-	/* search for the profile entry for this instance domain */
-	for (p=prof->profile, p_end=p+prof->profile_len; p < p_end; p++) {
-	    if (p->indom == indom)
-		/* found : an entry for this instance domain already exists */
-		return p;
-	}
+    if (prof == NULL || prof->profile_len <= 0)
+	return NULL;
 
-    /* not found */
-    return NULL;
+    /* search for the profile entry for this instance domain */
+    key.indom = indom;
+    return (pmInDomProfile *)bsearch(&key, prof->profile, prof->profile_len,
+				sizeof(pmInDomProfile), _cmpindom);
 }
 
 int
 __pmInProfile(pmInDom indom, const pmProfile *prof, int inst)
 {
     pmInDomProfile	*p;
-    int			*in, *in_end;
 
     if (prof == NULL)
 	/* default if no profile for any instance domains */
@@ -165,10 +212,10 @@ __pmInProfile(pmInDom indom, const pmProfile *prof, int inst)
 	/* no profile for this indom => use global default */
 	return (prof->state == PM_PROFILE_INCLUDE) ? 1 : 0;
 
-    for (in=p->instances, in_end=in+p->instances_len; in < in_end; in++)
-	if (*in == inst)
-	    /* present in the list => inverse of default for this indom */
-	    return (p->state == PM_PROFILE_INCLUDE) ? 0 : 1;
+    if (p->instances_len > 0 &&
+	bsearch(&inst, p->instances, p->instances_len, sizeof(int), _cmpinst))
+	/* present in the list => inverse of default for this indom */
+	return (p->state == PM_PROFILE_INCLUDE) ? 0 : 1;
 
     /* not in the list => use default for this indom */
     return (p->state == PM_PROFILE_INCLUDE) ? 1 : 0;
@@ -22,6 +22,7 @@
 #include <openssl/opensslv.h>
 #include <openssl/ssl.h>
 #include <openssl/err.h>
+#include <openssl/pem.h>
 #include <sys/stat.h>
 #ifdef HAVE_SYS_TERMIOS_H
 #include <sys/termios.h>
@@ -482,9 +483,23 @@ __pmAuthPromptCB(void *context, int id, const char *challenge, const char *promp
     return SASL_OK;
 }
 
+/*
+ * Resumable TLS sessions, one per server host name (as sent in the
+ * SNI extension), so that reconnecting to a host can skip the full
+ * handshake.  Optionally these are also kept in files below the
+ * tls-client-session-dir directory, for the benefit of short-lived
+ * client tools.
+ */
+typedef struct __pmSecureSession {
+    struct __pmSecureSession	*next;
+    char			*host;
+    SSL_SESSION			*session;
+} __pmSecureSession;
+
 typedef struct __pmSecureContext {
     SSL_CTX		*ctx;
     __pmSecureConfig	cfg;
+    __pmSecureSession	*sessions;
 } __pmSecureContext;
 static __pmSecureContext tls;	/* protected by secureclient_lock */
 
@@ -507,6 +522,9 @@ __pmGetSecureConfig(__pmSecureConfig *config)
 	{ "tls-client-cert-file", &config->clientcertfile },
 	{ "tls-client-key-file", &config->clientkeyfile },
 	{ "tls-verify-clients",	&config->clientverify },
+	{ "tls-client-session-dir", &config->clientsessiondir },
+	{ "tls-session-timeout", &config->sessiontimeout },
+	{ "tls-kernel-offload",	&config->kerneloffload },
     };
     size_t	i, n;
     char	*p, *s, *end;
@@ -599,6 +617,151 @@ __pmSecureConfigInit(void)
     PM_UNLOCK(secureclient_lock);
 }
 
+/*
+ * Path of the saved session file for host, if the session directory is
+ * configured and safe to use (owned by us, and private) ... sessions
+ * hold key material so they must never be readable by anyone else.
+ */
+static int
+session_path(const char *host, char *path, size_t pathlen)
+{
+    const char	*dir = tls.cfg.clientsessiondir;
+    struct stat	sbuf;
+
+    if (dir == NULL || host[0] == '.' || strchr(host, '/') != NULL)
+	return 0;
+    if (stat(dir, &sbuf) < 0 || !S_ISDIR(sbuf.st_mode) ||
+	sbuf.st_uid != geteuid() || (sbuf.st_mode & (S_IRWXG|S_IRWXO)) != 0) {
+	if (pmDebugOptions.tls)
+	    fprintf(stderr, "%s: ignoring unsafe session directory %s\n",
+			    "session_path", dir);
+	return 0;
+    }
+    return pmsprintf(path, pathlen, "%s/%s.pem", dir, host) < pathlen;
+}
+
+static SSL_SESSION *
+session_load(const char *host)
+{
+    SSL_SESSION	*session;
+    char	path[MAXPATHLEN];
+    FILE	*fp;
+
+    if (!session_path(host, path, sizeof(path)))
+	return NULL;
+    if ((fp = fopen(path, "r")) == NULL)
+	return NULL;
+    session = PEM_read_SSL_SESSION(fp, NULL, NULL, NULL);
+    fclose(fp);
+    return session;
+}
+
+static void
+session_save(const char *host, SSL_SESSION *session)
+{
+    char	path[MAXPATHLEN];
+    FILE	*fp;
+    int		fd;
+
+    if (!session_path(host, path, sizeof(path)))
+	return;
+    if ((fd = open(path, O_WRONLY|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR)) < 0)
+	return;
+    if ((fp = fdopen(fd, "w")) == NULL) {
+	close(fd);
+	return;
+    }
+    if (!PEM_write_SSL_SESSION(fp, session) && pmDebugOptions.tls)
+	fprintf(stderr, "%s: failed to save session to %s\n",
+			"session_save", path);
+    fclose(fp);
+}
+
+/*
+ * Called by OpenSSL with a new resumable session for a connection
+ * (for TLSv1.3 this is when a session ticket arrives, which may be
+ * after the handshake); returning 1 keeps the session reference.
+ */
+static int
+session_new(SSL *ssl, SSL_SESSION *session)
+{
+    __pmSecureSession	*sp;
+    const char		*host;
+
+    if ((host = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name)) == NULL)
+	return 0;
+
+    PM_LOCK(secureclient_lock);
+    for (sp = tls.sessions; sp != NULL; sp = sp->next) {
+	if (strcmp(sp->host, host) == 0)
+	    break;
+    }
+    if (sp == NULL) {
+	if ((sp = (__pmSecureSession *)calloc(1, sizeof(*sp))) == NULL ||
+	    (sp->host = strdup(host)) == NULL) {
+	    PM_UNLOCK(secureclient_lock);
+	    free(sp);
+	    return 0;
+	}
+	sp->next = tls.sessions;
+	tls.sessions = sp;
+    }
+    else if (sp->session != NULL)
+	SSL_SESSION_free(sp->session);
+    sp->session = session;
+    session_save(host, session);
+    PM_UNLOCK(secureclient_lock);
+
+    if (pmDebugOptions.tls)
+	fprintf(stderr, "%s: new session for %s\n", "session_new", host);
+    return 1;
+}
+
+/*
+ * Find a resumable session for host, in memory or saved earlier,
+ * returning a new reference to it.
+ */
+static SSL_SESSION *
+session_find(const char *host)
+{
+    __pmSecureSession	*sp;
+    SSL_SESSION		*session = NULL;
+
+    PM_LOCK(secureclient_lock);
+    for (sp = tls.sessions; sp != NULL; sp = sp->next) {
+	if (strcmp(sp->host, host) == 0) {
+	    session = sp->session;
+	    break;
+	}
+    }
+    if (session != NULL)
+	SSL_SESSION_up_ref(session);
+    else
+	session = session_load(host);
+    PM_UNLOCK(secureclient_lock);
+
+    if (session != NULL && !SSL_SESSION_is_resumable(session)) {
+	SSL_SESSION_free(session);
+	session = NULL;
+    }
+    return session;
+}
+
+static void
+session_free(void)
+{
+    __pmSecureSession	*sp, *next;
+
+    for (sp = tls.sessions; sp != NULL; sp = next) {
+	next = sp->next;
+	if (sp->session)
+	    SSL_SESSION_free(sp->session);
+	free(sp->host);
+	free(sp);
+    }
+    tls.sessions = NULL;
+}
+
 void
 __pmInitSecureClients(void)
 {
@@ -636,6 +799,24 @@ __pmInitSecureClients(void)
 	verify |= SSL_VERIFY_PEER;
     SSL_CTX_set_verify(tls.ctx, verify, NULL);
 
+    /* optionally have the kernel do the symmetric crypto (kTLS) */
+    if (tls.cfg.kerneloffload && (
+	strcmp(tls.cfg.kerneloffload, "yes") == 0 ||
+	strcmp(tls.cfg.kerneloffload, "true") == 0)) {
+#ifdef SSL_OP_ENABLE_KTLS
+	SSL_CTX_set_options(tls.ctx, SSL_OP_ENABLE_KTLS);
+#else
+	if (pmDebugOptions.tls)
+	    fprintf(stderr, "%s: no kernel TLS support in this OpenSSL\n",
+			    "__pmInitSecureClients");
+#endif
+    }
+
+    /* keep resumable sessions ourselves, see session_new() */
+    SSL_CTX_set_session_cache_mode(tls.ctx,
+		SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(tls.ctx, session_new);
+
     if (tls.cfg.cacertfile || tls.cfg.cacertdir) {
 	if (!SSL_CTX_load_verify_locations(tls.ctx,
 			tls.cfg.cacertfile, tls.cfg.cacertdir)) {
@@ -736,6 +917,9 @@ __pmFreeSecureConfig(__pmSecureConfig *config)
     free(config->clientcertfile);
     free(config->clientkeyfile);
     free(config->clientverify);
+    free(config->clientsessiondir);
+    free(config->sessiontimeout);
+    free(config->kerneloffload);
     memset(config, 0, sizeof(*config));
 }
 
@@ -745,6 +929,7 @@ __pmShutdownSecureSockets(void)
     PM_LOCK(secureclient_lock);
     if (tls.ctx)
 	SSL_CTX_free(tls.ctx);
+    session_free();
     __pmFreeSecureConfig(&tls.cfg);
     PM_UNLOCK(secureclient_lock);
     return 0;
@@ -755,6 +940,7 @@ __pmSecureClientIPCFlags(int fd, int flags, const char *host, __pmHashCtl *attrs
 {
     __pmSecureSocket	ss;
     sasl_callback_t	*cb;
+    SSL_SESSION		*session;
     char		hostname[MAXHOSTNAMELEN];
     int			sts;
 
@@ -783,6 +969,13 @@ __pmSecureClientIPCFlags(int fd, int flags, const char *host, __pmHashCtl *attrs
 			"__pmSecureClientIPCFlags", hostname);
 	    SSL_free(ss.ssl);
 	}
+	if ((session = session_find(hostname)) != NULL) {
+	    if (pmDebugOptions.tls)
+		fprintf(stderr, "%s: resuming session for %s\n",
+				"__pmSecureClientIPCFlags", hostname);
+	    SSL_set_session(ss.ssl, session);
+	    SSL_SESSION_free(session);
+	}
 	SSL_set_mode(ss.ssl, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
 	SSL_set_fd(ss.ssl, fd);
 	SSL_set_connect_state(ss.ssl);	/* client */
@@ -844,6 +1037,23 @@ __pmSecureClientIPCFlags(int fd, int flags, const char *host, __pmHashCtl *attrs
     return 0;
 }
 
+/*
+ * Report whether the kernel has taken over record encryption (send)
+ * and decryption (recv) for a connection, after the handshake.
+ */
+static void
+__pmSecureKernelOffloadDebug(const char *caller, SSL *ssl)
+{
+#ifdef SSL_OP_ENABLE_KTLS
+    fprintf(stderr, "%s: kernel TLS send %s, recv %s\n", caller,
+		    BIO_get_ktls_send(SSL_get_wbio(ssl)) ? "on" : "off",
+		    BIO_get_ktls_recv(SSL_get_rbio(ssl)) ? "on" : "off");
+#else
+    (void)caller;
+    (void)ssl;
+#endif
+}
+
 int
 __pmSecureServerNegotiation(int fd, int *strength)
 {
@@ -875,6 +1085,9 @@ __pmSecureServerNegotiation(int fd, int *strength)
     if (found == 0)
 	*strength = DEFAULT_SECURITY_STRENGTH;
 
+    if (pmDebugOptions.tls)
+	__pmSecureKernelOffloadDebug("__pmSecureServerNegotiation", ss.ssl);
+
     return 0;
 }
 
@@ -909,6 +1122,12 @@ __pmSecureClientNegotiation(int fd, int *strength)
     if (found == 0)
 	*strength = DEFAULT_SECURITY_STRENGTH;
 
+    if (pmDebugOptions.tls) {
+	fprintf(stderr, "%s: %s handshake\n", "__pmSecureClientNegotiation",
+			SSL_session_reused(ss.ssl) ? "resumed" : "full");
+	__pmSecureKernelOffloadDebug("__pmSecureClientNegotiation", ss.ssl);
+    }
+
     return 0;
 }
 
@@ -1410,7 +1629,6 @@ int
 __pmSocketReady(int fd, struct timeval *timeout)
 {
     __pmSecureSocket ss;
-    __pmFdSet onefd;
 
     if (fd < 0)
 	return -EBADF;
@@ -1419,7 +1637,5 @@ __pmSocketReady(int fd, struct timeval *timeout)
 	if (SSL_pending(ss.ssl) > 0)
 	    return 1;	/* proceed without blocking */
 
-    FD_ZERO(&onefd);
-    FD_SET(fd, &onefd);
-    return select(fd+1, &onefd, NULL, NULL, timeout);
+    return __pmFdReadyRead(fd, timeout);
 }
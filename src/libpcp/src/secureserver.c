@@ -131,6 +131,7 @@ __pmSecureServerInit(__pmSecureConfig *tls)
     int		flags = SSL_OP_NO_SSLv2 | SSL_OP_NO_SSLv3 |
 			SSL_OP_NO_TLSv1 |SSL_OP_NO_TLSv1_1;
     int		verify = SSL_VERIFY_PEER;
+    size_t	length;
     SSL_CTX	*context;
 
     if (pmDebugOptions.tls)
@@ -176,6 +177,44 @@ __pmSecureServerInit(__pmSecureConfig *tls)
 	verify |= SSL_VERIFY_FAIL_IF_NO_PEER_CERT;
     SSL_CTX_set_verify(context, verify, NULL);
 
+    /* optionally have the kernel do the symmetric crypto (kTLS) */
+    if (tls->kerneloffload && strcmp(tls->kerneloffload, "true") == 0) {
+#ifdef SSL_OP_ENABLE_KTLS
+	SSL_CTX_set_options(context, SSL_OP_ENABLE_KTLS);
+#else
+	pmNotifyErr(LOG_INFO, "No kernel TLS support in this OpenSSL version");
+#endif
+    }
+
+    /*
+     * Allow clients to resume earlier sessions (via session tickets or
+     * the server-side cache) rather than repeat the full handshake on
+     * every connection.  The session id context is needed for resumption
+     * to be allowed when client certificates are being verified.
+     */
+    if ((length = strlen(pmGetProgname())) > SSL_MAX_SID_CTX_LENGTH)
+	length = SSL_MAX_SID_CTX_LENGTH;
+    SSL_CTX_set_session_cache_mode(context, SSL_SESS_CACHE_SERVER);
+    SSL_CTX_set_session_id_context(context,
+		(const unsigned char *)pmGetProgname(), length);
+    if (tls->sessiontimeout) {
+	char	*end;
+	long	timeout = strtol(tls->sessiontimeout, &end, 10);
+
+	if (*end != '\0' || timeout < 0) {
+	    pmNotifyErr(LOG_ERR, "Invalid session timeout %s",
+			tls->sessiontimeout);
+	    exit(1);
+	}
+	if (timeout == 0) {	/* no resumption, full handshakes only */
+	    SSL_CTX_set_session_cache_mode(context, SSL_SESS_CACHE_OFF);
+	    SSL_CTX_set_options(context, SSL_OP_NO_TICKET);
+	    SSL_CTX_set_num_tickets(context, 0);
+	}
+	else
+	    SSL_CTX_set_timeout(context, timeout);
+    }
+
     /* Set the key and cert */
     if (SSL_CTX_use_certificate_chain_file(context, tls->certfile) <= 0) {
 	pmNotifyErr(LOG_ERR, "Cannot load certificate chain from %s",
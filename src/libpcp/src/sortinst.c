@@ -1,6 +1,6 @@
 /*
  * Copyright (c) 1995 Silicon Graphics, Inc.  All Rights Reserved.
- * Copyright (c) 2022 Red Hat.
+ * Copyright (c) 2022,2026 Red Hat.
  *
  * This library is free software; you can redistribute it and/or modify it
  * under the terms of the GNU Lesser General Public License as published
@@ -23,7 +23,58 @@ diffinsts(const void *a, const void *b)
     pmValue	*ap = (pmValue *)a;
     pmValue	*bp = (pmValue *)b;
 
-    return ap->inst - bp->inst;
+    /* no subtraction, instance identifiers can span the range of int */
+    return (ap->inst > bp->inst) - (ap->inst < bp->inst);
+}
+
+/*
+ * Most PMDAs return instances in ascending order already, so a linear
+ * scan for out-of-order pairs usually avoids sorting at all.  A few
+ * stragglers (e.g. instances appended to an otherwise ordered indom)
+ * are cheaper to move with an insertion sort than a full qsort, and a
+ * descending list (as from some directory walks) is simply reversed.
+ * The insertion sort gives up and leaves the rest to qsort if the
+ * values turn out to be further out of place than that.
+ */
+#define INSERTION_MOVES(numval)	(8 * (numval))
+
+static void
+sortvlist(pmValue *vlist, int numval)
+{
+    pmValue	tmp;
+    int		i, j, ascents = 0, descents = 0;
+    long	moves = 0;
+
+    for (i = 1; i < numval; i++) {
+	if (vlist[i].inst < vlist[i-1].inst)
+	    descents++;
+	else if (vlist[i].inst > vlist[i-1].inst)
+	    ascents++;
+    }
+    if (descents == 0)
+	return;
+
+    if (ascents == 0) {
+	for (i = 0, j = numval - 1; i < j; i++, j--) {
+	    tmp = vlist[i];
+	    vlist[i] = vlist[j];
+	    vlist[j] = tmp;
+	}
+	return;
+    }
+
+    for (i = 1; i < numval; i++) {
+	if (vlist[i].inst >= vlist[i-1].inst)
+	    continue;
+	tmp = vlist[i];
+	for (j = i; j > 0 && vlist[j-1].inst > tmp.inst; j--)
+	    vlist[j] = vlist[j-1];
+	vlist[j] = tmp;
+	if ((moves += i - j) > INSERTION_MOVES(numval)) {
+	    qsort(vlist, numval, sizeof(pmValue), diffinsts);
+	    return;
+	}
+    }
 }
 
 static void
@@ -33,7 +84,7 @@ sortinsts(int numpmid, pmValueSet **vset)
 
     for (i = 0; i < numpmid; i++) {
 	if (vset[i]->numval > 1)
-	    qsort(vset[i]->vlist, vset[i]->numval, sizeof(pmValue), diffinsts);
+	    sortvlist(vset[i]->vlist, vset[i]->numval);
     }
 }
 
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2014,2018-2019 Red Hat.
+ * Copyright (c) 2014,2018-2019,2026 Red Hat.
  * 
  * This library is free software; you can redistribute it and/or modify it
  * under the terms of the GNU Lesser General Public License as published
@@ -15,6 +15,10 @@
 #include "libpcp.h"
 #include "internal.h"
 #include "subnetprobe.h"
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#endif
 
 #define PROBE	"__pmSubnetProbeDiscoverServices"
 
@@ -26,6 +30,8 @@ typedef struct connectionOptions {
     __pmSockAddr	*netAddress;	/* Address of the subnet */
     int			maskBits;	/* Number of bits in the subnet */
     unsigned		maxThreads;	/* Max number of threads to use. */
+    unsigned		maxConnections;	/* Max concurrent connection attempts */
+    double		rate;		/* Max connection attempts per second */
     struct timeval	timeout;	/* Connection timeout */
     const __pmServiceDiscoveryOptions *globalOptions; /* Global discover options */
 } connectionOptions;
@@ -44,6 +50,70 @@ typedef struct connectionContext {
     __pmMutex		urlLock;	/* lock for the above results */
 } connectionContext;
 
+/*
+ * Add a service found at the given address+port to the results.
+ */
+static void
+addService(connectionContext *context, __pmSockAddr *addr)
+{
+    __pmServiceInfo	serviceInfo;
+
+    serviceInfo.spec = context->service;
+    serviceInfo.address = addr;
+    serviceInfo.protocol = NULL;
+    if (strcmp(context->service, PM_SERVER_SERVICE_SPEC) == 0)
+	serviceInfo.protocol = SERVER_PROTOCOL;
+    else if (strcmp(context->service, PM_SERVER_PROXY_SPEC) == 0)
+	serviceInfo.protocol = PROXY_PROTOCOL;
+    else if (strcmp(context->service, PM_SERVER_WEBAPI_SPEC) == 0)
+	serviceInfo.protocol = WEBAPI_PROTOCOL;
+
+    if (pmDebugOptions.discovery) {
+	char *addrString = __pmSockAddrToString(addr);
+	pmNotifyErr(LOG_INFO, "%s: found %s on %s port %d\n", PROBE,
+		    context->service, addrString, __pmSockAddrGetPort(addr));
+	free(addrString);
+    }
+
+    PM_LOCK(context->urlLock);
+    *context->numUrls =
+	__pmAddDiscoveredService(&serviceInfo, context->options->globalOptions,
+				 *context->numUrls, context->urls);
+    PM_UNLOCK(context->urlLock);
+}
+
+/*
+ * Secure the next address+port to probe, advancing the shared context.
+ * Returns NULL when there are none left.  The caller holds addrLock.
+ */
+static __pmSockAddr *
+nextConnection(connectionContext *context, int *port)
+{
+    __pmSockAddr	*addr;
+
+    if (context->nextAddress == NULL)
+	return NULL;
+    if ((addr = __pmSockAddrDup(context->nextAddress)) == NULL)
+	return NULL;
+    *port = context->ports[context->portIx];
+    __pmSockAddrSetPort(addr, *port);
+
+    /*
+     * Advance the port index for the next attempt. If we took the
+     * final port, then advance the address and reset the port index.
+     * The address may become NULL which is the signal that all of
+     * the addresses have been tried.
+     */
+    ++context->portIx;
+    if (context->portIx == context->nports) {
+	context->portIx = 0;
+	context->nextAddress =
+	    __pmSockAddrNextSubnetAddr(context->nextAddress,
+				       context->options->maskBits);
+    }
+    return addr;
+}
+
 /*
  * Attempt connection based on the given context until there are no more
  * addresses+ports to try.
@@ -55,7 +125,6 @@ attemptConnections(void *arg)
     int			flags;
     int			sts;
     __pmFdSet		wfds;
-    __pmServiceInfo	serviceInfo;
     __pmSockAddr	*addr;
     const __pmServiceDiscoveryOptions *globalOptions;
     int			port;
@@ -84,28 +153,10 @@ attemptConnections(void *arg)
 	 * obtain our own copy of the address, then give up the lock and
 	 * try again. Another thread will try this address+port.
 	 */
-	addr = __pmSockAddrDup(context->nextAddress);
-	if (addr == NULL) {
-	    PM_UNLOCK(context->addrLock);
-	    continue;
-	}
-	port = context->ports[context->portIx];
-	__pmSockAddrSetPort(addr, port);
-
-	/*
-	 * Advance the port index for the next thread. If we took the
-	 * final port, then advance the address and reset the port index.
-	 * The address may become NULL which is the signal for all
-	 * threads to exit.
-	 */
-	++context->portIx;
-	if (context->portIx == context->nports) {
-	    context->portIx = 0;
-	    context->nextAddress =
-		__pmSockAddrNextSubnetAddr(context->nextAddress,
-					   context->options->maskBits);
-	}
+	addr = nextConnection(context, &port);
 	PM_UNLOCK(context->addrLock);
+	if (addr == NULL)
+	    continue;
 
 	/*
 	 * Create a socket. There is a limit on open fds, not just from
@@ -164,22 +215,8 @@ attemptConnections(void *arg)
 	}
 
 	/* If connection was successful, add this service to the list.  */
-	if (sts == 0) {
-	    serviceInfo.spec = context->service;
-	    serviceInfo.address = addr;
-	    if (strcmp(context->service, PM_SERVER_SERVICE_SPEC) == 0)
-		serviceInfo.protocol = SERVER_PROTOCOL;
-	    else if (strcmp(context->service, PM_SERVER_PROXY_SPEC) == 0)
-		serviceInfo.protocol = PROXY_PROTOCOL;
-	    else if (strcmp(context->service, PM_SERVER_WEBAPI_SPEC) == 0)
-		serviceInfo.protocol = WEBAPI_PROTOCOL;
-
-	    PM_LOCK(context->urlLock);
-	    *context->numUrls =
-		__pmAddDiscoveredService(&serviceInfo, globalOptions,
-					 *context->numUrls, context->urls);
-	    PM_UNLOCK(context->urlLock);
-	}
+	if (sts == 0)
+	    addService(context, addr);
 
 	__pmSockAddrFree(addr);
     } /* Loop over connection attempts. */
@@ -187,6 +224,235 @@ attemptConnections(void *arg)
     return NULL;
 }
 
+#ifdef HAVE_SYS_EPOLL_H
+/*
+ * Event-driven probing: a single thread keeps many non-blocking connection
+ * attempts in flight, using epoll(7) to learn when each one completes.
+ * Attempts are kept in a ring in the order they were started, so the
+ * oldest is always at the head and is the next one that can time out.
+ *
+ * Hosts that answer - with a connection or a refusal - provide round
+ * trip time samples, and once there are enough of these the timeout
+ * adapts (as for TCP retransmission) down from the configured timeout,
+ * which is the upper bound.  So scans of quiet, distant networks do not
+ * wait the full timeout for every silent address once the real round
+ * trip time is known.
+ */
+#define PROBE_MIN_TIMEOUT	0.005	/* seconds, floor for adaptive timeout */
+#define PROBE_MIN_SAMPLES	8	/* RTT samples before adapting */
+#define PROBE_MAX_WAIT		100	/* msec, bounds flag checking latency */
+
+typedef struct probeSlot {
+    int			fd;		/* -1 once the attempt has finished */
+    double		start;		/* when connect(2) was called */
+    __pmSockAddr	*addr;		/* address+port being tried */
+} probeSlot;
+
+static double
+probeNow(void)
+{
+    struct timespec	now;
+
+    pmtimespecNow(&now);
+    return pmtimespecToReal(&now);
+}
+
+static void
+finishSlot(probeSlot *slot)
+{
+    __pmCloseSocket(slot->fd);
+    __pmSockAddrFree(slot->addr);
+    slot->fd = -1;
+    slot->addr = NULL;
+}
+
+/*
+ * Returns 0 when probing is complete (or interrupted), or -1 if the event
+ * machinery could not be set up, in which case nothing has been probed.
+ */
+static int
+probeWithEvents(connectionContext *context)
+{
+    const connectionOptions *options = context->options;
+    const __pmServiceDiscoveryOptions *globalOptions = options->globalOptions;
+    struct epoll_event	ev, *events;
+    probeSlot		*ring, *slot;
+    __pmSockAddr	*addr;
+    unsigned		size = options->maxConnections;
+    unsigned		limit = size;	/* lowered if we run out of fds */
+    unsigned		head = 0, used = 0, inflight = 0, i;
+    double		maxTimeout = pmtimevalToReal(&options->timeout);
+    double		timeout = maxTimeout;
+    double		srtt = 0.0, rttvar = 0.0, maxrtt = 0.0, rtt;
+    double		now, last, wait, credit = 1.0;
+    int			nsamples = 0, probes = 0;
+    int			efd, n, s, sts, port;
+
+    if ((efd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+	return -1;
+    ring = (probeSlot *)calloc(size, sizeof(probeSlot));
+    events = (struct epoll_event *)calloc(size, sizeof(struct epoll_event));
+    if (ring == NULL || events == NULL) {
+	free(ring);
+	free(events);
+	close(efd);
+	return -1;
+    }
+
+    last = probeNow();
+    while (! globalOptions->timedOut &&
+	   (! globalOptions->flags ||
+	    (*globalOptions->flags & PM_SERVICE_DISCOVERY_INTERRUPTED) == 0)) {
+	now = probeNow();
+
+	/* Time out the oldest attempts, and drop finished ones from the ring */
+	while (used > 0) {
+	    slot = &ring[head];
+	    if (slot->fd >= 0) {
+		if (now - slot->start < timeout)
+		    break;
+		finishSlot(slot);
+		inflight--;
+	    }
+	    head = (head + 1) % size;
+	    used--;
+	}
+
+	/* Earn connection attempt credit at the requested rate */
+	if (options->rate > 0.0) {
+	    credit += (now - last) * options->rate;
+	    if (credit > limit)
+		credit = limit;
+	}
+	last = now;
+
+	/* Start as many new attempts as the limits allow */
+	while (context->nextAddress != NULL && used < size && inflight < limit &&
+	       (options->rate <= 0.0 || credit >= 1.0)) {
+	    if (__pmSockAddrIsInet(context->nextAddress))
+		s = __pmCreateSocket();
+	    else /* address family already checked */
+		s = __pmCreateIPv6Socket();
+	    if (s < 0) {
+		if ((s == -EMFILE || s == -ENFILE || s == -EAGAIN) &&
+		    inflight > 0) {
+		    /* out of fds, this is as many as we can have in flight */
+		    if (pmDebugOptions.discovery)
+			pmNotifyErr(LOG_INFO, "%s: limiting to %u connections\n",
+				    PROBE, inflight);
+		    limit = inflight;
+		    break;
+		}
+		addr = nextConnection(context, &port);
+		if (addr != NULL) {
+		    char *addrString = __pmSockAddrToString(addr);
+		    pmNotifyErr(LOG_WARNING, "%s: Cannot create socket for address %s",
+				PROBE, addrString);
+		    free(addrString);
+		    __pmSockAddrFree(addr);
+		}
+		continue;
+	    }
+	    if ((addr = nextConnection(context, &port)) == NULL) {
+		__pmCloseSocket(s);
+		break;
+	    }
+	    credit -= 1.0;
+	    probes++;
+
+	    /* A negative result means that the socket has been closed */
+	    if (__pmConnectTo(s, addr, port) < 0) {
+		__pmSockAddrFree(addr);
+		continue;
+	    }
+	    slot = &ring[(head + used) % size];
+	    slot->fd = s;
+	    slot->start = now;
+	    slot->addr = addr;
+	    memset(&ev, 0, sizeof(ev));
+	    ev.events = EPOLLOUT;
+	    ev.data.ptr = slot;
+	    if (epoll_ctl(efd, EPOLL_CTL_ADD, s, &ev) < 0) {
+		finishSlot(slot);
+		continue;
+	    }
+	    used++;
+	    inflight++;
+	}
+
+	if (used == 0 && context->nextAddress == NULL)
+	    break;	/* all done */
+
+	/*
+	 * Wait for attempts to complete, but no longer than it takes for
+	 * the oldest to time out or for the next attempt to be allowed.
+	 */
+	wait = PROBE_MAX_WAIT / 1000.0;
+	if (used > 0 && ring[head].start + timeout - now < wait)
+	    wait = ring[head].start + timeout - now;
+	if (options->rate > 0.0 && context->nextAddress != NULL &&
+	    used < size && inflight < limit && (1.0 - credit) / options->rate < wait)
+	    wait = (1.0 - credit) / options->rate;
+	if (wait < 0.0)
+	    wait = 0.0;
+
+	n = epoll_wait(efd, events, size, (int)(wait * 1000.0 + 0.999));
+	if (n < 0) {
+	    if (errno == EINTR)
+		continue;
+	    pmNotifyErr(LOG_ERR, "%s: epoll_wait: %s", PROBE, osstrerror());
+	    break;
+	}
+	now = probeNow();
+	for (i = 0; i < n; i++) {
+	    slot = (probeSlot *)events[i].data.ptr;
+	    sts = __pmConnectCheckError(slot->fd);
+	    if (sts == 0 || sts == ECONNREFUSED) {
+		/* an answer from the host, adapt the timeout to its RTT */
+		rtt = now - slot->start;
+		if (nsamples++ == 0) {
+		    srtt = rtt;
+		    rttvar = rtt / 2.0;
+		}
+		else {
+		    rttvar = 0.75 * rttvar + 0.25 * (srtt > rtt ? srtt - rtt : rtt - srtt);
+		    srtt = 0.875 * srtt + 0.125 * rtt;
+		}
+		if (rtt > maxrtt)
+		    maxrtt = rtt;
+		if (nsamples >= PROBE_MIN_SAMPLES) {
+		    timeout = 2.0 * (srtt + 4.0 * rttvar);
+		    if (timeout < 2.0 * maxrtt)
+			timeout = 2.0 * maxrtt;
+		    if (timeout < PROBE_MIN_TIMEOUT)
+			timeout = PROBE_MIN_TIMEOUT;
+		    if (timeout > maxTimeout)
+			timeout = maxTimeout;
+		}
+	    }
+	    if (sts == 0)
+		addService(context, slot->addr);
+	    finishSlot(slot);
+	    inflight--;
+	}
+    }
+
+    /* Abandon anything still in flight */
+    for (i = 0; i < used; i++) {
+	slot = &ring[(head + i) % size];
+	if (slot->fd >= 0)
+	    finishSlot(slot);
+    }
+    if (pmDebugOptions.discovery)
+	pmNotifyErr(LOG_INFO, "%s: %d connection attempts, %d answers, timeout %.3fs\n",
+		    PROBE, probes, nsamples, timeout);
+    free(ring);
+    free(events);
+    close(efd);
+    return 0;
+}
+#endif
+
 static int
 probeForServices(const char *service,
     const connectionOptions *options, int numUrls, char ***urls)
@@ -248,7 +514,15 @@ probeForServices(const char *service,
      */
     pthread_mutex_init(&context.addrLock, NULL);
     pthread_mutex_init(&context.urlLock, NULL);
+#endif
+
+#ifdef HAVE_SYS_EPOLL_H
+    /* One thread can drive all of the connection attempts, if epoll works */
+    if (probeWithEvents(&context) == 0)
+	goto finish;
+#endif
 
+#if PM_MULTI_THREAD
     if (options->maxThreads > 0) {
 	/*
 	 * Allocate the thread table. We have a maximum for the number of
@@ -314,7 +588,12 @@ probeForServices(const char *service,
 	for (threadIx = 0; threadIx < nThreads; ++threadIx)
 	    pthread_join(threads[threadIx], NULL);
     }
+#endif
 
+#ifdef HAVE_SYS_EPOLL_H
+ finish:
+#endif
+#if PM_MULTI_THREAD
     /* These must not be destroyed until all of the threads have finished. */
     pthread_mutex_destroy(&context.addrLock);
     pthread_mutex_destroy(&context.urlLock);
@@ -343,6 +622,10 @@ probeForServices(const char *service,
  *   timeout=<double>      -- number of seconds before timing out an address
  *   maxThreads=<integer>  -- specifies a hard limit on the number of active
  *                            threads.
+ *   maxConnections=<integer> -- limit on concurrent connection attempts when
+ *                            probing is event-driven.
+ *   rate=<double>         -- limit on connection attempts per second when
+ *                            probing is event-driven.
  */
 static int
 parseOptions(const char *mechanism, connectionOptions *options)
@@ -356,8 +639,13 @@ parseOptions(const char *mechanism, connectionOptions *options)
     int			family;
     int			sts;
     long		longVal;
+    double		doubleVal;
     unsigned		subnetBits;
     unsigned		subnetSize;
+    int			explicitThreads = 0;
+#ifdef HAVE_SYS_EPOLL_H
+    struct rlimit	rlim;
+#endif
 
     /* Nothing to probe? */
     if (mechanism == NULL)
@@ -442,6 +730,21 @@ parseOptions(const char *mechanism, connectionOptions *options)
     options->timeout.tv_sec = 0;
     options->timeout.tv_usec = 20 * 1000;
 
+    /*
+     * Event-driven probing is limited by the number of open files, with
+     * some held back for the rest of the process, rather than by threads.
+     */
+    options->maxConnections = 4096;
+#ifdef HAVE_SYS_EPOLL_H
+    if (getrlimit(RLIMIT_NOFILE, &rlim) == 0 && rlim.rlim_cur != RLIM_INFINITY) {
+	if (rlim.rlim_cur <= 64 + 16)
+	    options->maxConnections = 16;
+	else if (rlim.rlim_cur - 64 < options->maxConnections)
+	    options->maxConnections = rlim.rlim_cur - 64;
+    }
+#endif
+    options->rate = 0.0;	/* unlimited */
+
     /* Now parse the options. */
     sts = 0;
     for (option = end; *option != '\0'; /**/) {
@@ -484,6 +787,7 @@ parseOptions(const char *mechanism, connectionOptions *options)
 		    sts = -1;
 		}
 		else {
+		    explicitThreads = longVal;
 #if PM_MULTI_THREAD
 		    /* The main thread participates, so reduce this by one. */
 		    options->maxThreads = longVal - 1;
@@ -495,6 +799,33 @@ parseOptions(const char *mechanism, connectionOptions *options)
 		}
 	    }
 	}
+	else if (strncmp(option, "maxConnections=", sizeof("maxConnections=") - 1) == 0) {
+	    option += sizeof("maxConnections=") - 1;
+	    longVal = strtol(option, &end, 0);
+	    if ((*end != '\0' && *end != ',') || longVal <= 0) {
+		pmNotifyErr(LOG_ERR, "%s: maxConnections value '%s' is not valid",
+				PROBE, option);
+		sts = -1;
+	    }
+	    else {
+		option = end;
+		if (longVal < options->maxConnections)
+		    options->maxConnections = longVal;
+	    }
+	}
+	else if (strncmp(option, "rate=", sizeof("rate=") - 1) == 0) {
+	    option += sizeof("rate=") - 1;
+	    doubleVal = strtod(option, &end);
+	    if ((*end != '\0' && *end != ',') || doubleVal < 0.0) {
+		pmNotifyErr(LOG_ERR, "%s: rate value '%s' is not valid",
+				PROBE, option);
+		sts = -1;
+	    }
+	    else {
+		option = end;
+		options->rate = doubleVal;
+	    }
+	}
 	else if (strncmp(option, "timeout=", sizeof("timeout=") - 1) == 0) {
 	    option += sizeof("timeout=") - 1;
 	    option = __pmServiceDiscoveryParseTimeout(option, &options->timeout);
@@ -530,8 +861,14 @@ parseOptions(const char *mechanism, connectionOptions *options)
 	subnetSize = 1 << subnetBits;
 	if (subnetSize - 1 < options->maxThreads)
 	    options->maxThreads = subnetSize - 1;
+	if (subnetSize < options->maxConnections)
+	    options->maxConnections = subnetSize;
     }
 
+    /* An explicit thread limit also limits concurrent connection attempts */
+    if (explicitThreads > 0 && explicitThreads < options->maxConnections)
+	options->maxConnections = explicitThreads;
+
     return sts;
 }
 
@@ -336,47 +336,39 @@ pmUnitsStr(const pmUnits *pu)
     return ubuf;
 }
 
-/* Scale conversion, based on value format, value type and scale */
-int
-pmConvScale(int type, const pmAtomValue *ival, const pmUnits *iunit_arg, pmAtomValue *oval, const pmUnits *ounit_arg)
+/*
+ * Special case ... if all components of the dimension are zero
+ * (dimension "none"), then treat this as the dimension of "count"
+ */
+static const pmUnits *
+count_units(const pmUnits *unit, pmUnits *special)
 {
-    int sts;
-    int k;
-    __int64_t div, mult;
-    __int64_t d, m;
-    char strbuf[80];
-    pmUnits	*iunit = (pmUnits *)iunit_arg;
-    pmUnits	*ounit = (pmUnits *)ounit_arg;
-    pmUnits	ispecial;
-    pmUnits	ospecial;
-
-    if (pmDebugOptions.value) {
-	fprintf(stderr, "pmConvScale: %s", pmAtomStr_r(ival, type, strbuf, sizeof(strbuf)));
-	fprintf(stderr, " [%s]", pmUnitsStr_r(iunit, strbuf, sizeof(strbuf)));
+    if (unit->dimSpace == 0 && unit->dimTime == 0 && unit->dimCount == 0) {
+	*special = *unit;
+	special->dimCount = 1;
+	return special;
     }
+    return unit;
+}
 
-    /*
-     * special case ... if all components of the dimension are zero
-     * (dimension "none"), then treat this as the dimension of "count"
-     */
-    if (iunit->dimSpace == 0 && iunit->dimTime == 0 && iunit->dimCount == 0) {
-	ispecial = *iunit_arg;
-	iunit = &ispecial;
-	iunit->dimCount = 1;
-	if (pmDebugOptions.value) {
-	    fprintf(stderr, " defaults to [%s]", pmUnitsStr_r(iunit, strbuf, sizeof(strbuf)));
-	}
-    }
-    if (ounit->dimSpace == 0 && ounit->dimTime == 0 && ounit->dimCount == 0) {
-	ospecial = *ounit_arg;
-	ounit = &ospecial;
-	ounit->dimCount = 1;
-    }
+/*
+ * Compile the scale conversion from iunit to ounit for values of the
+ * given type, so it can be applied to any number of values without
+ * the units being examined again.  The multiplier is kept as an exact
+ * integer ratio, reduced to a single multiply where it divides evenly.
+ */
+int
+pmConvScalePlan(int type, const pmUnits *iunit_arg, const pmUnits *ounit_arg, pmConvPlan *plan)
+{
+    int		k;
+    __int64_t	div, mult;
+    __int64_t	d, m;
+    pmUnits	ispecial, ospecial;
+    const pmUnits *iunit = count_units(iunit_arg, &ispecial);
+    const pmUnits *ounit = count_units(ounit_arg, &ospecial);
 
-    if (iunit->dimSpace != ounit->dimSpace || iunit->dimTime != ounit->dimTime || iunit->dimCount != ounit->dimCount) {
-	sts = PM_ERR_CONV;
-	goto bad;
-    }
+    if (iunit->dimSpace != ounit->dimSpace || iunit->dimTime != ounit->dimTime || iunit->dimCount != ounit->dimCount)
+	return PM_ERR_CONV;
 
     div = mult = 1;
 
@@ -406,8 +398,7 @@ pmConvScale(int type, const pmAtomValue *ival, const pmUnits *iunit_arg, pmAtomV
 		m = (__int64_t) 1024 *1024 * 1024 * 1024;
 		break;
 	    default:
-		sts = PM_ERR_UNIT;
-		goto bad;
+		return PM_ERR_UNIT;
 	}
 	switch (ounit->scaleSpace) {
 	    case PM_SPACE_BYTE:
@@ -432,8 +423,7 @@ pmConvScale(int type, const pmAtomValue *ival, const pmUnits *iunit_arg, pmAtomV
 		d *= (__int64_t) 1024 *1024 * 1024 * 1024;
 		break;
 	    default:
-		sts = PM_ERR_UNIT;
-		goto bad;
+		return PM_ERR_UNIT;
 	}
 	if (iunit->dimSpace > 0) {
 	    for (k = 0; k < iunit->dimSpace; k++) {
@@ -472,8 +462,7 @@ pmConvScale(int type, const pmAtomValue *ival, const pmUnits *iunit_arg, pmAtomV
 		m = 3600;
 		break;
 	    default:
-		sts = PM_ERR_UNIT;
-		goto bad;
+		return PM_ERR_UNIT;
 	}
 	switch (ounit->scaleTime) {
 	    case PM_TIME_NSEC:
@@ -495,8 +484,7 @@ pmConvScale(int type, const pmAtomValue *ival, const pmUnits *iunit_arg, pmAtomV
 		d *= 3600;
 		break;
 	    default:
-		sts = PM_ERR_UNIT;
-		goto bad;
+		return PM_ERR_UNIT;
 	}
 	if (iunit->dimTime > 0) {
 	    for (k = 0; k < iunit->dimTime; k++) {
@@ -556,44 +544,112 @@ pmConvScale(int type, const pmAtomValue *ival, const pmUnits *iunit_arg, pmAtomV
 
     switch (type) {
 	case PM_TYPE_32:
-	    oval->l = (__int32_t) ((ival->l * mult + div / 2) / div);
+	case PM_TYPE_U32:
+	case PM_TYPE_64:
+	case PM_TYPE_U64:
+	case PM_TYPE_FLOAT:
+	case PM_TYPE_DOUBLE:
+	    break;
+	default:
+	    return PM_ERR_CONV;
+    }
+
+    memset(plan, 0, sizeof(*plan));
+    plan->type = type;
+    plan->mult = mult;
+    plan->div = div;
+    plan->scale = (double)mult / (double)div;
+    return 0;
+}
+
+/*
+ * Apply a conversion from pmConvScalePlan to n values, ival and oval
+ * may be the same array.  Returns n, or PM_ERR_CONV for a bad plan.
+ */
+int
+pmConvScaleApply(const pmConvPlan *plan, const pmAtomValue *ival, pmAtomValue *oval, int n)
+{
+    __int64_t	mult = plan->mult, div = plan->div, half = plan->div / 2;
+    float	fscale;
+    int		i;
+
+    switch (plan->type) {
+	case PM_TYPE_32:
+	    if (div == 1)
+		for (i = 0; i < n; i++)
+		    oval[i].l = (__int32_t) (ival[i].l * mult);
+	    else
+		for (i = 0; i < n; i++)
+		    oval[i].l = (__int32_t) ((ival[i].l * mult + half) / div);
 	    break;
 	case PM_TYPE_U32:
-	    oval->ul = (__uint32_t) ((ival->ul * mult + div / 2) / div);
+	    if (div == 1)
+		for (i = 0; i < n; i++)
+		    oval[i].ul = (__uint32_t) (ival[i].ul * mult);
+	    else
+		for (i = 0; i < n; i++)
+		    oval[i].ul = (__uint32_t) ((ival[i].ul * mult + half) / div);
 	    break;
 	case PM_TYPE_64:
-	    oval->ll = (ival->ll * mult + div / 2) / div;
+	    if (div == 1)
+		for (i = 0; i < n; i++)
+		    oval[i].ll = ival[i].ll * mult;
+	    else
+		for (i = 0; i < n; i++)
+		    oval[i].ll = (ival[i].ll * mult + half) / div;
 	    break;
 	case PM_TYPE_U64:
-	    oval->ull = (ival->ull * mult + div / 2) / div;
+	    if (div == 1)
+		for (i = 0; i < n; i++)
+		    oval[i].ull = ival[i].ull * mult;
+	    else
+		for (i = 0; i < n; i++)
+		    oval[i].ull = (ival[i].ull * mult + half) / div;
 	    break;
 	case PM_TYPE_FLOAT:
-	    oval->f = ival->f * ((float) mult / (float) div);
+	    fscale = (float) mult / (float) div;
+	    for (i = 0; i < n; i++)
+		oval[i].f = ival[i].f * fscale;
 	    break;
 	case PM_TYPE_DOUBLE:
-	    oval->d = ival->d * ((double) mult / (double) div);
+	    for (i = 0; i < n; i++)
+		oval[i].d = ival[i].d * plan->scale;
 	    break;
 	default:
-	    sts = PM_ERR_CONV;
-	    goto bad;
+	    return PM_ERR_CONV;
     }
+    return n;
+}
+
+/* Scale conversion, based on value format, value type and scale */
+int
+pmConvScale(int type, const pmAtomValue *ival, const pmUnits *iunit, pmAtomValue *oval, const pmUnits *ounit)
+{
+    int		sts;
+    char	strbuf[80];
+    pmUnits	special;
+    pmConvPlan	plan;
 
     if (pmDebugOptions.value) {
-	fprintf(stderr, " -> %s", pmAtomStr_r(oval, type, strbuf, sizeof(strbuf)));
-	fprintf(stderr, " [%s]", pmUnitsStr_r(ounit_arg, strbuf, sizeof(strbuf)));
-	if (ounit != ounit_arg)
-	    fprintf(stderr, " defaults to [%s]", pmUnitsStr_r(ounit, strbuf, sizeof(strbuf)));
-	fputc('\n', stderr);
+	fprintf(stderr, "pmConvScale: %s", pmAtomStr_r(ival, type, strbuf, sizeof(strbuf)));
+	fprintf(stderr, " [%s]", pmUnitsStr_r(iunit, strbuf, sizeof(strbuf)));
+	if (count_units(iunit, &special) != iunit)
+	    fprintf(stderr, " defaults to [%s]", pmUnitsStr_r(&special, strbuf, sizeof(strbuf)));
     }
-    return 0;
 
-bad:
+    if ((sts = pmConvScalePlan(type, iunit, ounit, &plan)) == 0)
+	sts = pmConvScaleApply(&plan, ival, oval, 1) < 0 ? PM_ERR_CONV : 0;
+
     if (pmDebugOptions.value) {
-	char errmsg[PM_MAXERRMSGLEN];
-	fprintf(stderr, " -> Error: %s", pmErrStr_r(sts, errmsg, sizeof(errmsg)));
-	fprintf(stderr, " [%s]", pmUnitsStr_r(ounit_arg, strbuf, sizeof(strbuf)));
-	if (ounit != ounit_arg)
-	    fprintf(stderr, " defaults to [%s]", pmUnitsStr_r(ounit, strbuf, sizeof(strbuf)));
+	if (sts == 0)
+	    fprintf(stderr, " -> %s", pmAtomStr_r(oval, type, strbuf, sizeof(strbuf)));
+	else {
+	    char errmsg[PM_MAXERRMSGLEN];
+	    fprintf(stderr, " -> Error: %s", pmErrStr_r(sts, errmsg, sizeof(errmsg)));
+	}
+	fprintf(stderr, " [%s]", pmUnitsStr_r(ounit, strbuf, sizeof(strbuf)));
+	if (count_units(ounit, &special) != ounit)
+	    fprintf(stderr, " defaults to [%s]", pmUnitsStr_r(&special, strbuf, sizeof(strbuf)));
 	fputc('\n', stderr);
     }
     return sts;
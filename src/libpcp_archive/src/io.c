@@ -69,7 +69,7 @@ again:
 	    __pmFseek(f, offset, SEEK_SET);
 	    if (vol != PM_LOG_VOL_META) {
 		if (acp->ac_curvol < lcp->maxvol) {
-		    if (__pmLogChangeVol(acp, acp->ac_curvol+1) == 0) {
+		    if (__pmLogChangeVol(acp, acp->ac_curvol+1) >= 0) {
 			f = acp->ac_mfp;
 			goto again;
 		    }
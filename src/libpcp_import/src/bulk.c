@@ -0,0 +1,273 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+
+/*
+ * Bulk import - pmiPutAtomValues() supplies a whole matrix of binary
+ * values (one row per timestamp, one column per handle), so there is
+ * no name lookup and no string conversion per value.  Building each
+ * __pmResult is pipelined with encoding and writing it to the archive
+ * on a writer thread, through a short bounded queue.
+ */
+
+#include "pmapi.h"
+#include "libpcp.h"
+#include "import.h"
+#include "private.h"
+
+#define QDEPTH	8	/* results in flight between builder and writer */
+
+typedef struct {
+    int		midx;		/* index into metric[] */
+    int		numval;		/* columns (instances) for this metric */
+    int		*col;		/* column in values[] for each instance */
+} pmi_bulkset;
+
+typedef struct {
+    pmi_context		*ctx;
+    int			sts;		/* first error from the writer */
+#ifdef PM_MULTI_THREAD
+    pthread_mutex_t	lock;
+    pthread_cond_t	cond;
+#endif
+    __pmResult		*queue[QDEPTH];
+    int			head;
+    int			count;
+    int			done;		/* no more results will be queued */
+} pmi_writer;
+
+static void
+free_sets(pmi_bulkset *sets, int nset)
+{
+    int		i;
+
+    for (i = 0; i < nset; i++)
+	free(sets[i].col);
+    free(sets);
+}
+
+/*
+ * Group the columns by metric (in order of first appearance) so each
+ * record has one pmValueSet per metric, rejecting any metric-instance
+ * pair that is named more than once.
+ */
+static int
+make_sets(pmi_context *current, int nhandle, const int *handles, pmi_bulkset **setp)
+{
+    pmi_bulkset	*sets;
+    pmi_handle	*hp, *other;
+    int		nset = 0;
+    int		h, i, j;
+
+    if ((sets = (pmi_bulkset *)calloc(nhandle, sizeof(*sets))) == NULL)
+	return -ENOMEM;
+
+    for (h = 0; h < nhandle; h++) {
+	hp = &current->handle[handles[h]-1];
+	for (i = 0; i < nset; i++) {
+	    if (sets[i].midx == hp->midx)
+		break;
+	}
+	if (i == nset) {
+	    sets[i].midx = hp->midx;
+	    sets[i].col = (int *)malloc(nhandle * sizeof(int));
+	    if (sets[i].col == NULL) {
+		free_sets(sets, nset);
+		return -ENOMEM;
+	    }
+	    nset++;
+	}
+	for (j = 0; j < sets[i].numval; j++) {
+	    other = &current->handle[handles[sets[i].col[j]]-1];
+	    if (other->inst == hp->inst) {
+		free_sets(sets, nset);
+		return PMI_ERR_DUPVALUE;
+	    }
+	}
+	sets[i].col[sets[i].numval++] = h;
+    }
+
+    *setp = sets;
+    return nset;
+}
+
+static int
+make_result(pmi_context *current, pmi_bulkset *sets, int nset,
+	const int *handles, int nhandle, const struct timespec *stamp,
+	const pmAtomValue *row, __pmResult **rpp)
+{
+    __pmResult	*rp;
+    pmValueSet	*vsp;
+    pmi_metric	*mp;
+    size_t	need;
+    int		i, j, sts;
+
+    if ((rp = __pmAllocResult(nset)) == NULL)
+	return -ENOMEM;
+    rp->numpmid = 0;
+    rp->timestamp.sec = stamp->tv_sec;
+    rp->timestamp.nsec = stamp->tv_nsec;
+
+    for (i = 0; i < nset; i++) {
+	mp = &current->metric[sets[i].midx];
+	need = sizeof(pmValueSet) + (sets[i].numval-1)*sizeof(pmValue);
+	if ((vsp = (pmValueSet *)malloc(need)) == NULL) {
+	    __pmFreeResult(rp);
+	    return -ENOMEM;
+	}
+	vsp->pmid = mp->pmid;
+	vsp->numval = 0;
+	vsp->valfmt = PM_VAL_INSITU;
+	rp->vset[rp->numpmid++] = vsp;
+	for (j = 0; j < sets[i].numval; j++) {
+	    pmValue	*vp = &vsp->vlist[j];
+
+	    vp->inst = current->handle[handles[sets[i].col[j]]-1].inst;
+	    if ((sts = __pmStuffValue(&row[sets[i].col[j]], vp, mp->desc.type)) < 0) {
+		__pmFreeResult(rp);
+		return sts;
+	    }
+	    vsp->valfmt = sts;
+	    vsp->numval++;
+	}
+    }
+
+    *rpp = rp;
+    return 0;
+}
+
+#ifdef PM_MULTI_THREAD
+static void *
+writer(void *arg)
+{
+    pmi_writer	*wp = (pmi_writer *)arg;
+    __pmResult	*rp;
+    int		sts;
+
+    pthread_mutex_lock(&wp->lock);
+    for (;;) {
+	while (wp->count == 0 && !wp->done)
+	    pthread_cond_wait(&wp->cond, &wp->lock);
+	if (wp->count == 0)
+	    break;
+	rp = wp->queue[wp->head];
+	wp->head = (wp->head + 1) % QDEPTH;
+	wp->count--;
+	pthread_cond_signal(&wp->cond);
+	pthread_mutex_unlock(&wp->lock);
+
+	/* after an error, drain the queue without writing */
+	sts = wp->sts < 0 ? 0 : _pmi_put_result(wp->ctx, rp);
+	__pmFreeResult(rp);
+
+	pthread_mutex_lock(&wp->lock);
+	if (sts < 0 && wp->sts == 0)
+	    wp->sts = sts;
+    }
+    pthread_mutex_unlock(&wp->lock);
+    return NULL;
+}
+
+static int
+enqueue(pmi_writer *wp, __pmResult *rp)
+{
+    int		sts;
+
+    pthread_mutex_lock(&wp->lock);
+    while (wp->count == QDEPTH)
+	pthread_cond_wait(&wp->cond, &wp->lock);
+    wp->queue[(wp->head + wp->count) % QDEPTH] = rp;
+    wp->count++;
+    sts = wp->sts;
+    pthread_cond_signal(&wp->cond);
+    pthread_mutex_unlock(&wp->lock);
+    return sts;
+}
+#endif
+
+/*
+ * Called from pmiPutAtomValues() once the handles and timestamps have
+ * been validated.  Returns the number of records written, else the
+ * first error from building or writing a record.
+ */
+int
+_pmi_put_bulk(pmi_context *current, int nhandle, const int *handles,
+	int nstamp, const struct timespec *stamps, const pmAtomValue *values)
+{
+    pmi_bulkset	*sets;
+    __pmResult	*rp;
+    int		nset;
+    int		s, sts = 0;
+#ifdef PM_MULTI_THREAD
+    pmi_writer	w;
+    pthread_t	tid;
+    int		threaded = 0;
+#endif
+
+    if ((nset = make_sets(current, nhandle, handles, &sets)) < 0)
+	return nset;
+
+#ifdef PM_MULTI_THREAD
+    /*
+     * Only worth a thread when there is more than one record; the
+     * writer is the only one touching the archive until it is joined.
+     */
+    if (nstamp > 1) {
+	memset(&w, 0, sizeof(w));
+	w.ctx = current;
+	pthread_mutex_init(&w.lock, NULL);
+	pthread_cond_init(&w.cond, NULL);
+	if (pthread_create(&tid, NULL, writer, &w) == 0)
+	    threaded = 1;
+	else {
+	    pthread_mutex_destroy(&w.lock);
+	    pthread_cond_destroy(&w.cond);
+	}
+    }
+#endif
+
+    for (s = 0; s < nstamp; s++) {
+	sts = make_result(current, sets, nset, handles, nhandle,
+			&stamps[s], &values[s * nhandle], &rp);
+	if (sts < 0)
+	    break;
+#ifdef PM_MULTI_THREAD
+	if (threaded) {
+	    if ((sts = enqueue(&w, rp)) < 0)
+		break;
+	    continue;
+	}
+#endif
+	sts = _pmi_put_result(current, rp);
+	__pmFreeResult(rp);
+	if (sts < 0)
+	    break;
+    }
+
+#ifdef PM_MULTI_THREAD
+    if (threaded) {
+	pthread_mutex_lock(&w.lock);
+	w.done = 1;
+	pthread_cond_signal(&w.cond);
+	pthread_mutex_unlock(&w.lock);
+	pthread_join(tid, NULL);
+	if (sts >= 0)
+	    sts = w.sts;
+	pthread_mutex_destroy(&w.lock);
+	pthread_cond_destroy(&w.cond);
+    }
+#endif
+
+    free_sets(sets, nset);
+    return sts < 0 ? sts : nstamp;
+}
@@ -1205,6 +1205,35 @@ pmiPutHighResResult(const pmHighResResult *result)
     return current->last_sts = sts;
 }
 
+int
+pmiPutAtomValues(int nhandle, const int *handles, int nstamp,
+		const struct timespec *stamps, const pmAtomValue *values)
+{
+    __pmTimestamp	timestamp;
+    int			h, s, sts;
+
+    if (current == NULL)
+	return PM_ERR_NOCONTEXT;
+    if (nhandle <= 0 || nstamp <= 0)
+	return current->last_sts = PMI_ERR_NODATA;
+    for (h = 0; h < nhandle; h++) {
+	if (handles[h] <= 0 || handles[h] > current->nhandle)
+	    return current->last_sts = PMI_ERR_BADHANDLE;
+    }
+
+    /* timestamps must not go backwards, within the call or across calls */
+    for (s = 0; s < nstamp; s++) {
+	timestamp.sec = stamps[s].tv_sec;
+	timestamp.nsec = stamps[s].tv_nsec;
+	if ((sts = check_timestamp(&timestamp)) < 0)
+	    return current->last_sts = sts;
+	current->last_stamp = timestamp;
+    }
+
+    sts = _pmi_put_bulk(current, nhandle, handles, nstamp, stamps, values);
+    return current->last_sts = sts;
+}
+
 int
 pmiPutMark(void)
 {
@@ -85,6 +85,7 @@ typedef struct {
 
 extern int _pmi_stuff_value(pmi_context *, pmi_handle *, const char *) _PMI_HIDDEN;
 extern int _pmi_put_result(pmi_context *, __pmResult *) _PMI_HIDDEN;
+extern int _pmi_put_bulk(pmi_context *, int, const int *, int, const struct timespec *, const pmAtomValue *) _PMI_HIDDEN;
 extern int _pmi_put_text(pmi_context *) _PMI_HIDDEN;
 extern int _pmi_put_label(pmi_context *) _PMI_HIDDEN;
 extern int _pmi_end(pmi_context *) _PMI_HIDDEN;
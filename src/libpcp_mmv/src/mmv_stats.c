@@ -18,12 +18,16 @@
 #include "pmapi.h"
 #include <ctype.h>
 #include <sys/stat.h>
+#if defined(IS_LINUX)
+#include <sched.h>
+#endif
 #include "mmv_stats.h"
 #include "mmv_dev.h"
 #include "libpcp.h"
 
 struct mmv_registry {
     mmv_indom2_t *	indoms;
+    __uint32_t *	spare;		/* per-indom room for more instances */
     __uint32_t		nindoms;
     mmv_metric2_t *	metrics;
     __uint32_t		nmetrics;
@@ -36,6 +40,7 @@ struct mmv_registry {
     __uint32_t		cluster;
     mmv_stats_flags_t	flags;
     void *		addr;
+    __uint64_t		nextstring;	/* offset of next unused string */
 };
 
 static void
@@ -134,7 +139,7 @@ mmv_init(const char *fname, int version,
 		const mmv_metric_t *st1, int nmetric1,
 		const mmv_indom_t *in1, int nindom1,
 		const mmv_metric2_t *st2, int nmetric2,
-		const mmv_indom2_t *in2, int nindom2,
+		const mmv_indom2_t *in2, int nindom2, const __uint32_t *spare2,
 		const mmv_label_t *lb, int nlabels)
 {
     mmv_disk_instance2_t *inlist2;
@@ -155,14 +160,39 @@ mmv_init(const char *fname, int version,
     __uint64_t values_offset;		/* anchor start of values section */
     __uint64_t strings_offset;		/* anchor start of any/all strings */
     __uint64_t labels_offset;		/* anchor start of any/all labels */
+    __uint64_t stripes_offset;		/* anchor start of per-CPU stripes */
     void *addr;
     size_t size;
     __uint64_t offset;
     int i, j, k, tocidx, stridx;
     int ninstances = 0;
+    int nsparevalues = 0;
+    int nspare = 0;
+    int nstripes = 0;
     int nstrings = 0;
     int nvalues = 0;
 
+    /* per-CPU stripes need the v4 format, not offered for v1 metrics */
+    if ((fl & MMV_FLAG_PERCPU) && nmetric2) {
+	if ((nstripes = sysconf(_SC_NPROCESSORS_CONF)) < 1)
+	    nstripes = 1;
+	version = MMV_VERSION4;
+    } else {
+	fl &= ~MMV_FLAG_PERCPU;
+    }
+
+    /* room for instances added later needs v2 instance names, no stripes */
+    if (spare2 && version != MMV_VERSION1 && !(fl & MMV_FLAG_PERCPU)) {
+	for (i = 0; i < nindom2; i++)
+	    nspare += spare2[i];
+    }
+    if (nspare) {
+	fl |= MMV_FLAG_GROWABLE;
+    } else {
+	fl &= ~MMV_FLAG_GROWABLE;
+	spare2 = NULL;
+    }
+
     for (i = 0; i < nindom1; i++) {
 	ninstances += in1[i].count;
 	if (in1[i].shorttext)
@@ -172,8 +202,12 @@ mmv_init(const char *fname, int version,
     }
     for (i = 0; i < nindom2; i++) {
 	ninstances += in2[i].count;
-	if (version == MMV_VERSION2 || version == MMV_VERSION3)
+	if (version >= MMV_VERSION2)
 	    nstrings += in2[i].count;	/* instance names */
+	if (spare2) {
+	    ninstances += spare2[i];
+	    nstrings += spare2[i];	/* spare instance names */
+	}
 	if (in2[i].shorttext)
 	    nstrings++;
 	if (in2[i].helptext)
@@ -198,7 +232,7 @@ mmv_init(const char *fname, int version,
 	}
     }
     for (i = 0; i < nmetric2; i++) {
-	if (version == MMV_VERSION2 || version == MMV_VERSION3)
+	if (version >= MMV_VERSION2)
 	    nstrings++;		/* metric name */
 	if (st2[i].helptext)
 	    nstrings++;
@@ -210,6 +244,12 @@ mmv_init(const char *fname, int version,
 	    if (st2[i].type == MMV_TYPE_STRING)
 		nstrings += mi2->count;
 	    nvalues += mi2->count;
+	    if (spare2) {
+		k = spare2[mi2 - in2];
+		if (st2[i].type == MMV_TYPE_STRING)
+		    nstrings += k;
+		nsparevalues += k;
+	    }
 	} else {
 	    if (st2[i].type == MMV_TYPE_STRING)
 		nstrings++;
@@ -227,6 +267,8 @@ mmv_init(const char *fname, int version,
     if (nlabels) {
 	size += sizeof(mmv_disk_toc_t) * 1;
     }
+    if (nstripes)
+	size += sizeof(mmv_disk_toc_t) * 1;
     indoms_offset = sizeof(mmv_disk_header_t) + size;
 
     /* Following the indom definitions are the actual instances */
@@ -247,7 +289,8 @@ mmv_init(const char *fname, int version,
 	    if (version == MMV_VERSION1)
 		size += in2[i].count * sizeof(mmv_disk_instance_t);
 	    else
-		size += in2[i].count * sizeof(mmv_disk_instance2_t);
+		size += (in2[i].count + (spare2 ? spare2[i] : 0)) *
+			sizeof(mmv_disk_instance2_t);
     }
     metrics_offset = instances_offset + size;
 
@@ -263,16 +306,21 @@ mmv_init(const char *fname, int version,
     }
     values_offset = metrics_offset + size;
 
-    /* Following the values are the string values and/or help text */
-    size = nvalues * sizeof(mmv_disk_value_t);
+    /* Following the values (and any spare values) are the strings */
+    size = (nvalues + nsparevalues) * sizeof(mmv_disk_value_t);
     strings_offset = values_offset + size;
 
     /* Following the strings are the labels */
     size = nstrings * sizeof(mmv_disk_string_t);
     labels_offset = strings_offset + size;
 
-    /* End of file follows all of the actual strings */
+    /* Following the labels are any cache line aligned per-CPU stripes */
     size = labels_offset + nlabels * sizeof(mmv_disk_label_t);
+    stripes_offset = (size + MMV_STRIPE_ALIGN - 1) & ~(MMV_STRIPE_ALIGN - 1);
+
+    /* End of file follows all of the actual strings and stripes */
+    if (nstripes)
+	size = stripes_offset + nstripes * MMV_STRIPE_STRIDE(nvalues);
 
     if ((addr = mmv_mapping_init(fname, size)) == NULL)
 	return NULL;
@@ -300,6 +348,8 @@ mmv_init(const char *fname, int version,
 	hdr->tocs += 1;
     if (nlabels)
 	hdr->tocs += 1;    
+    if (nstripes)
+	hdr->tocs += 1;
     hdr->flags = fl;
     hdr->cluster = cluster;
     hdr->process = (__int32_t)getpid();
@@ -337,6 +387,12 @@ mmv_init(const char *fname, int version,
 	toc[tocidx].offset = labels_offset;
 	tocidx++;
     }
+    if (nstripes) {
+	toc[tocidx].type = MMV_TOC_STRIPES;
+	toc[tocidx].count = nstripes;
+	toc[tocidx].offset = stripes_offset;
+	tocidx++;
+    }
 
     /* Indom section */
     domlist = (mmv_disk_indom_t *)((char *)addr + indoms_offset);
@@ -391,6 +447,8 @@ mmv_init(const char *fname, int version,
 		inlist2->external = 0;	/* filled in later */
 		inlist2++;
 	    }
+	    if (spare2)
+		inlist2 += spare2[i];	/* room to grow */
 	}
     }
 
@@ -493,7 +551,7 @@ mmv_init(const char *fname, int version,
      * 6 phases: v2 instance names, v2 metric names, all string values,
      *	   any metric help, any indom help, v3 metric labels.
      */
-    if (version == MMV_VERSION2 || version == MMV_VERSION3) {
+    if (version >= MMV_VERSION2) {
 	inlist2 = (mmv_disk_instance2_t *)((char *)addr + instances_offset);
 	for (i = 0; i < nindom2; i++) {
 	    mmv_instances2_t *insts = in2[i].instances;
@@ -506,6 +564,8 @@ mmv_init(const char *fname, int version,
 		slist[stridx].payload[MMV_STRINGMAX-1] = '\0';
 		stridx++;
 	    }
+	    if (spare2)
+		inlist2 += spare2[i];
 	}
 	mlist2 = (mmv_disk_metric2_t *)((char *)addr + metrics_offset);
 	for (i = 0; i < nmetric2; i++) {
@@ -525,7 +585,7 @@ mmv_init(const char *fname, int version,
 	    mmv_disk_metric_t *m1 = (mmv_disk_metric_t *)
 			((char *)(addr + vlist[i].metric));
 	    type = m1->type;
-	} else if (version == MMV_VERSION2 || version == MMV_VERSION3) {
+	} else if (version >= MMV_VERSION2) {
 	    mmv_disk_metric2_t *m2 = (mmv_disk_metric2_t *)
 			((char *)(addr + vlist[i].metric));
 	    type = m2->type;
@@ -688,7 +748,7 @@ mmv_stats_init(const char *fname,
 
     return mmv_init(fname, version, cluster, flags,
 		    st, nmetrics, in, nindoms, 
-		    NULL, 0, NULL, 0, NULL, 0);
+		    NULL, 0, NULL, 0, NULL, NULL, 0);
 }
 
 static int
@@ -772,7 +832,7 @@ mmv_stats2_init(const char *fname,
 	return NULL;
 
     return mmv_init(fname, version, cluster, flags,
-		    NULL, 0, NULL, 0, st, nmetrics, in, nindoms, NULL, 0);
+		    NULL, 0, NULL, 0, st, nmetrics, in, nindoms, NULL, NULL, 0);
 }
 
 mmv_registry_t *
@@ -843,6 +903,7 @@ mmv_stats_add_indom(mmv_registry_t *registry, int serial,
 		    const char *shorthelp, const char *longhelp) 
 {
     mmv_indom2_t * indom;
+    __uint32_t * spare;
     size_t bytes;
 
     if (registry == NULL) {
@@ -850,6 +911,15 @@ mmv_stats_add_indom(mmv_registry_t *registry, int serial,
 	return -1;
     }
 
+    bytes = (registry->nindoms + 1) * sizeof(__uint32_t);
+    spare = (__uint32_t *) realloc(registry->spare, bytes);
+    if (spare == NULL) {
+	setoserror(ENOMEM);
+	return -1;
+    }
+    registry->spare = spare;
+    spare[registry->nindoms] = 0;
+
     bytes = (registry->nindoms + 1) * sizeof(mmv_indom2_t);
     indom = (mmv_indom2_t *) realloc(registry->indoms, bytes);
     if (indom == NULL) {
@@ -909,7 +979,7 @@ mmv_stats_add_instance(mmv_registry_t *registry, int serial,
 	inst_aux[registry->indoms[i].count].external = (char *) instname;
 
 	registry->indoms[i].count++;
-
+	break;
     }
     if (i == registry->nindoms) {
 	/* indom with that serial number was not found */
@@ -921,6 +991,191 @@ mmv_stats_add_instance(mmv_registry_t *registry, int serial,
     return 0;
 }
 
+int
+mmv_stats_reserve_instances(mmv_registry_t *registry, int serial, int count)
+{
+    int i;
+
+    if (registry == NULL) {
+	setoserror(EFAULT);
+	return -1;
+    }
+    /* layout is fixed once started, and stripes cannot grow */
+    if (count < 0 || registry->addr != NULL ||
+	(registry->flags & MMV_FLAG_PERCPU)) {
+	setoserror(EINVAL);
+	return -1;
+    }
+
+    for (i = 0; i < registry->nindoms; i++) {
+	if (registry->indoms[i].serial != serial)
+	    continue;
+	registry->spare[i] = count;
+	return 0;
+    }
+    /* indom with that serial number was not found */
+    setoserror(EINVAL);
+    return -1;
+}
+
+/*
+ * Count the strings reserved for instances appended after start:
+ * one per instance name, plus one per string-valued metric value.
+ */
+static int
+mmv_spare_strings(mmv_registry_t *registry)
+{
+    const mmv_indom2_t *indom;
+    int i, nspare = 0;
+
+    for (i = 0; i < registry->nindoms; i++)
+	nspare += registry->spare[i];
+    if (nspare == 0)
+	return 0;
+
+    for (i = 0; i < registry->nmetrics; i++) {
+	if (registry->metrics[i].type != MMV_TYPE_STRING ||
+	    mmv_singular(registry->metrics[i].indom))
+	    continue;
+	indom = mmv_lookup_indom2(registry->metrics[i].indom,
+				registry->indoms, registry->nindoms);
+	nspare += registry->spare[indom - registry->indoms];
+    }
+    return nspare;
+}
+
+static mmv_disk_toc_t *
+mmv_lookup_toc(void *addr, mmv_toc_type_t type)
+{
+    mmv_disk_header_t *hdr = (mmv_disk_header_t *)addr;
+    mmv_disk_toc_t *toc = (mmv_disk_toc_t *)
+			((char *)addr + sizeof(mmv_disk_header_t));
+    int i;
+
+    for (i = 0; i < hdr->tocs; i++)
+	if (toc[i].type == type)
+	    return &toc[i];
+    return NULL;
+}
+
+/* Spare strings always follow those that were filled in by mmv_init */
+static __uint64_t
+mmv_first_spare_string(mmv_registry_t *registry)
+{
+    mmv_disk_toc_t *toc;
+    int nspare;
+
+    if ((nspare = mmv_spare_strings(registry)) == 0)
+	return 0;
+    if ((toc = mmv_lookup_toc(registry->addr, MMV_TOC_STRINGS)) == NULL)
+	return 0;
+    return toc->offset + (toc->count - nspare) * sizeof(mmv_disk_string_t);
+}
+
+int
+mmv_stats_append_instance(mmv_registry_t *registry, int serial,
+			int instid, const char *instname)
+{
+    mmv_disk_instance2_t *inst;
+    mmv_disk_metric2_t *mlist;
+    mmv_disk_string_t *string;
+    mmv_disk_value_t *vlist;
+    mmv_disk_indom_t *indom;
+    mmv_disk_toc_t *itoc, *mtoc, *vtoc;
+    mmv_instances2_t *insts;
+    __uint64_t ioffset;
+    __uint32_t count;
+    int i, j, nvalues;
+
+    if (registry == NULL) {
+	setoserror(EFAULT);
+	return -1;
+    }
+    if (registry->addr == NULL)	/* not started yet, nothing to grow */
+	return mmv_stats_add_instance(registry, serial, instid, instname);
+
+    if (instname == NULL) {
+	setoserror(EINVAL);
+	return -1;
+    }
+    if (strlen(instname) >= MMV_STRINGMAX) {
+	setoserror(E2BIG);
+	return -1;
+    }
+    for (i = 0; i < registry->nindoms; i++)
+	if (registry->indoms[i].serial == serial)
+	    break;
+    if (i == registry->nindoms) {
+	setoserror(EINVAL);
+	return -1;
+    }
+    if (registry->spare[i] == 0 || registry->nextstring == 0) {
+	setoserror(ENOSPC);
+	return -1;
+    }
+    insts = registry->indoms[i].instances;
+    for (j = 0; j < registry->indoms[i].count; j++) {
+	if (insts[j].internal == instid ||
+	    strcmp(insts[j].external, instname) == 0) {
+	    setoserror(EEXIST);
+	    return -1;
+	}
+    }
+
+    itoc = mmv_lookup_toc(registry->addr, MMV_TOC_INDOMS);
+    mtoc = mmv_lookup_toc(registry->addr, MMV_TOC_METRICS);
+    vtoc = mmv_lookup_toc(registry->addr, MMV_TOC_VALUES);
+    if (itoc == NULL || mtoc == NULL || vtoc == NULL) {
+	setoserror(EINVAL);
+	return -1;
+    }
+    indom = mmv_lookup_disk_indom(serial, (mmv_disk_indom_t *)
+			((char *)registry->addr + itoc->offset), itoc->count);
+    if (indom == NULL) {
+	setoserror(EINVAL);
+	return -1;
+    }
+
+    /* fill in the instance in the slot following the last one */
+    string = (mmv_disk_string_t *)((char *)registry->addr + registry->nextstring);
+    strncpy(string->payload, instname, MMV_STRINGMAX);
+    count = indom->count;
+    ioffset = indom->offset + count * sizeof(mmv_disk_instance2_t);
+    inst = (mmv_disk_instance2_t *)((char *)registry->addr + ioffset);
+    inst->indom = (char *)indom - (char *)registry->addr;
+    inst->padding = 0;
+    inst->internal = instid;
+    inst->external = registry->nextstring;
+    registry->nextstring += sizeof(mmv_disk_string_t);
+
+    /* and one new value for each metric over the indom, after the last */
+    vlist = (mmv_disk_value_t *)((char *)registry->addr + vtoc->offset);
+    mlist = (mmv_disk_metric2_t *)((char *)registry->addr + mtoc->offset);
+    nvalues = vtoc->count;
+    for (j = 0; j < mtoc->count; j++) {
+	if (mlist[j].indom != serial)
+	    continue;
+	memset(&vlist[nvalues], 0, sizeof(mmv_disk_value_t));
+	vlist[nvalues].metric = (char *)&mlist[j] - (char *)registry->addr;
+	vlist[nvalues].instance = ioffset;
+	if (mlist[j].type == MMV_TYPE_STRING) {
+	    vlist[nvalues].extra = registry->nextstring;
+	    registry->nextstring += sizeof(mmv_disk_string_t);
+	}
+	nvalues++;
+    }
+
+    /*
+     * Publish values before the instance - the PMDA reads these counts
+     * in the opposite order, so any instance it sees has its values.
+     */
+    __atomic_store_n(&vtoc->count, nvalues, __ATOMIC_RELEASE);
+    __atomic_store_n(&indom->count, count + 1, __ATOMIC_RELEASE);
+    registry->spare[i]--;
+
+    return mmv_stats_add_instance(registry, serial, instid, instname);
+}
+
 /*
  * Verify the user-supplied label.  Produce a JSONB form label in
  * the provided buffer (out) of length MMV_LABELMAX.
@@ -1200,13 +1455,19 @@ mmv_stats_start(mmv_registry_t *registry)
 
     if (registry->version != MMV_VERSION3)
 	registry->version = version;
+    /* instances appended later have names stored in the strings section */
+    if (mmv_spare_strings(registry) && registry->version == MMV_VERSION1)
+	registry->version = MMV_VERSION2;
 
     registry->addr = mmv_init(registry->file,
 				registry->version, registry->cluster,
 				registry->flags, NULL, 0, NULL, 0, 
 				registry->metrics, registry->nmetrics, 
 				registry->indoms, registry->nindoms,
+				registry->spare,
 				registry->labels, registry->nlabels);
+    if (registry->addr)
+	registry->nextstring = mmv_first_spare_string(registry);
     return registry->addr;
 }
 
@@ -1245,6 +1506,8 @@ mmv_stats_free(mmv_registry_t *registry)
 	    free(registry->indoms[i].instances);
     if (registry->indoms)
 	free(registry->indoms);
+    if (registry->spare)
+	free(registry->spare);
     if (registry->instances)
 	free(registry->instances);
     if (registry->metrics)
@@ -1345,106 +1608,188 @@ mmv_lookup_value_desc(void *addr, const char *metric, const char *inst)
     return NULL;
 }
 
-void
-mmv_inc_value(void *addr, pmAtomValue *av, double inc)
+static mmv_metric_type_t
+mmv_value_type(void *addr, mmv_disk_value_t *v)
 {
-    if (av != NULL && addr != NULL) {
-	mmv_disk_header_t *hdr = (mmv_disk_header_t *)addr;
-	mmv_disk_value_t *v = (mmv_disk_value_t *)av;
-	int type;
+    mmv_disk_header_t *hdr = (mmv_disk_header_t *)addr;
 
-	if (hdr->version == MMV_VERSION1) {
-	    mmv_disk_metric_t *m = (mmv_disk_metric_t *)
+    if (hdr->version == MMV_VERSION1) {
+	mmv_disk_metric_t *m = (mmv_disk_metric_t *)
 					((char *)addr + v->metric);
-	    type = m->type;
-	} else {
-	    mmv_disk_metric2_t *m = (mmv_disk_metric2_t *)
+	return m->type;
+    } else {
+	mmv_disk_metric2_t *m = (mmv_disk_metric2_t *)
 					((char *)addr + v->metric);
-	    type = m->type;
-	}
-	switch (type) {
-	case MMV_TYPE_I32:
-	    v->value.l += (__int32_t)inc;
-	    break;
-	case MMV_TYPE_U32:
-	    v->value.ul += (__uint32_t)inc;
-	    break;
-	case MMV_TYPE_I64:
-	    v->value.ll += (__int64_t)inc;
-	    break;
-	case MMV_TYPE_U64:
-	    v->value.ull += (__uint64_t)inc;
-	    break;
-	case MMV_TYPE_FLOAT:
-	    v->value.f += (float)inc;
-	    break;
-	case MMV_TYPE_DOUBLE:
-	    v->value.d += inc;
-	    break;
-	case MMV_TYPE_ELAPSED:
-	    if (inc < 0)
-		v->extra = (__int64_t)inc;
-	    else {
-		v->value.ll += v->extra + (__int64_t)inc;
-		v->extra = 0;
-	    }
-	    break;
-	default:
-	    break;
-	}
+	return m->type;
+    }
+}
+
+/*
+ * Atomic in-place arithmetic on shared mapping values; concurrent
+ * updaters (threads or processes) never lose an increment.  There's
+ * no native floating point add, so those use a compare-and-swap loop.
+ */
+static void
+mmv_atomic_add(pmAtomValue *av, mmv_metric_type_t type, pmAtomValue *inc)
+{
+    pmAtomValue	old, new;
+
+    switch (type) {
+    case MMV_TYPE_I32:
+	__atomic_fetch_add(&av->l, inc->l, __ATOMIC_RELAXED);
+	break;
+    case MMV_TYPE_U32:
+	__atomic_fetch_add(&av->ul, inc->ul, __ATOMIC_RELAXED);
+	break;
+    case MMV_TYPE_I64:
+	__atomic_fetch_add(&av->ll, inc->ll, __ATOMIC_RELAXED);
+	break;
+    case MMV_TYPE_U64:
+	__atomic_fetch_add(&av->ull, inc->ull, __ATOMIC_RELAXED);
+	break;
+    case MMV_TYPE_FLOAT:
+	old.ul = __atomic_load_n(&av->ul, __ATOMIC_RELAXED);
+	do {
+	    new.f = old.f + inc->f;
+	} while (!__atomic_compare_exchange_n(&av->ul, &old.ul, new.ul,
+			1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+	break;
+    case MMV_TYPE_DOUBLE:
+	old.ull = __atomic_load_n(&av->ull, __ATOMIC_RELAXED);
+	do {
+	    new.d = old.d + inc->d;
+	} while (!__atomic_compare_exchange_n(&av->ull, &old.ull, new.ull,
+			1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+	break;
+    default:
+	break;
     }
 }
 
+static void
+mmv_atomic_set(pmAtomValue *av, mmv_metric_type_t type, pmAtomValue *value)
+{
+    switch (type) {
+    case MMV_TYPE_I32:
+    case MMV_TYPE_U32:
+    case MMV_TYPE_FLOAT:
+	__atomic_store_n(&av->ul, value->ul, __ATOMIC_RELAXED);
+	break;
+    default:
+	__atomic_store_n(&av->ull, value->ull, __ATOMIC_RELAXED);
+	break;
+    }
+}
+
+static void
+mmv_double_atomvalue(mmv_metric_type_t type, double d, pmAtomValue *av)
+{
+    memset(av, 0, sizeof(pmAtomValue));
+    switch (type) {
+    case MMV_TYPE_I32:
+	av->l = (__int32_t)d;
+	break;
+    case MMV_TYPE_U32:
+	av->ul = (__uint32_t)d;
+	break;
+    case MMV_TYPE_I64:
+    case MMV_TYPE_ELAPSED:
+	av->ll = (__int64_t)d;
+	break;
+    case MMV_TYPE_U64:
+	av->ull = (__uint64_t)d;
+	break;
+    case MMV_TYPE_FLOAT:
+	av->f = (float)d;
+	break;
+    case MMV_TYPE_DOUBLE:
+	av->d = d;
+	break;
+    default:
+	break;
+    }
+}
+
+/*
+ * Negative elapsed time increments mark the start of a timed section,
+ * the following positive increment closes it and accumulates the delta.
+ */
+static void
+mmv_elapsed_add(mmv_disk_value_t *v, __int64_t inc)
+{
+    __int64_t	start;
+
+    if (inc < 0)
+	__atomic_store_n(&v->extra, inc, __ATOMIC_RELAXED);
+    else {
+	start = __atomic_exchange_n(&v->extra, 0, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&v->value.ll, start + inc, __ATOMIC_RELAXED);
+    }
+}
+
+static void
+mmv_add_atomvalue(void *addr, mmv_disk_value_t *v, pmAtomValue *inc)
+{
+    mmv_metric_type_t	type = mmv_value_type(addr, v);
+
+    if (type == MMV_TYPE_ELAPSED)
+	mmv_elapsed_add(v, inc->ll);
+    else
+	mmv_atomic_add(&v->value, type, inc);
+}
+
+static pmAtomValue *
+mmv_stripe_value(mmv_value_handle_t *h)
+{
+    unsigned int	cpu = 0;
+#if defined(IS_LINUX)
+    int			sts;
+
+    if ((sts = sched_getcpu()) > 0)
+	cpu = sts % h->nstripes;
+#endif
+    return (pmAtomValue *)(h->stripe + cpu * h->stride);
+}
+
+/*
+ * Any per-CPU stripes are folded into the value on overwrite, so
+ * clear them - concurrent increments may be lost in this case.
+ */
+static void
+mmv_clear_stripes(void *addr, mmv_disk_value_t *v)
+{
+    mmv_value_handle_t	handle;
+    pmAtomValue		zero = {0};
+    int			i;
+
+    if (!(((mmv_disk_header_t *)addr)->flags & MMV_FLAG_PERCPU))
+	return;
+    if (mmv_lookup_value_handle(addr, &v->value, &handle) < 0)
+	return;
+    for (i = 0; handle.stripe && i < handle.nstripes; i++)
+	mmv_atomic_set((pmAtomValue *)(handle.stripe + i * handle.stride),
+			handle.type, &zero);
+}
+
 void
-mmv_inc_atomvalue(void *addr, pmAtomValue *av, pmAtomValue *value)
+mmv_inc_value(void *addr, pmAtomValue *av, double inc)
 {
     if (av != NULL && addr != NULL) {
-	mmv_disk_header_t *hdr = (mmv_disk_header_t *)addr;
 	mmv_disk_value_t *v = (mmv_disk_value_t *)av;
-	int type;
+	pmAtomValue value;
 
-	if (hdr->version == MMV_VERSION1) {
-	    mmv_disk_metric_t *m = (mmv_disk_metric_t *)
-					((char *)addr + v->metric);
-	    type = m->type;
-	} else {
-	    mmv_disk_metric2_t *m = (mmv_disk_metric2_t *)
-					((char *)addr + v->metric);
-	    type = m->type;
-	}
-	switch (type) {
-	case MMV_TYPE_I32:
-	    v->value.l += value->l;
-	    break;
-	case MMV_TYPE_U32:
-	    v->value.ul += value->ul;
-	    break;
-	case MMV_TYPE_I64:
-	    v->value.ll += value->ll;
-	    break;
-	case MMV_TYPE_U64:
-	    v->value.ull += value->ull;
-	    break;
-	case MMV_TYPE_FLOAT:
-	    v->value.f += value->f;
-	    break;
-	case MMV_TYPE_DOUBLE:
-	    v->value.d += value->d;
-	    break;
-	case MMV_TYPE_ELAPSED:
-	    if (value->ll < 0)
-		v->extra = value->ll;
-	    else {
-		v->value.ll += v->extra + value->ll;
-		v->extra = 0;
-	    }
-	    break;
-	default:
-	    break;
-	}
+	mmv_double_atomvalue(mmv_value_type(addr, v), inc, &value);
+	mmv_add_atomvalue(addr, v, &value);
     }
 }
 
+void
+mmv_inc_atomvalue(void *addr, pmAtomValue *av, pmAtomValue *value)
+{
+    if (av != NULL && addr != NULL)
+	mmv_add_atomvalue(addr, (mmv_disk_value_t *)av, value);
+}
+
 void
 mmv_add(void *registry, pmAtomValue *metric, void *value)
 {
@@ -1455,95 +1800,122 @@ void
 mmv_inc(void *addr, pmAtomValue *av)
 {
     if (av != NULL && addr != NULL) {
-	mmv_disk_header_t *hdr = (mmv_disk_header_t *)addr;
 	mmv_disk_value_t *v = (mmv_disk_value_t *)av;
-	int type;
+	mmv_metric_type_t type = mmv_value_type(addr, v);
+	pmAtomValue one;
 
-	if (hdr->version == MMV_VERSION1) {
-	    mmv_disk_metric_t *m = (mmv_disk_metric_t *)
-					((char *)addr + v->metric);
-	    type = m->type;
+	if (type == MMV_TYPE_ELAPSED) {
+	    if (__atomic_load_n(&v->value.ll, __ATOMIC_RELAXED) < 0)
+		__atomic_fetch_add(&v->extra, 1, __ATOMIC_RELAXED);
+	    else
+		mmv_elapsed_add(v, 1);
 	} else {
-	    mmv_disk_metric2_t *m = (mmv_disk_metric2_t *)
-					((char *)addr + v->metric);
-	    type = m->type;
+	    mmv_double_atomvalue(type, 1, &one);
+	    mmv_atomic_add(&v->value, type, &one);
+	}
+    }
+}
+
+int
+mmv_lookup_value_handle(void *addr, pmAtomValue *av, mmv_value_handle_t *h)
+{
+    mmv_disk_header_t *hdr = (mmv_disk_header_t *)addr;
+    mmv_disk_toc_t *toc;
+    mmv_disk_value_t *values = NULL;
+    __uint64_t stripes = 0;
+    int i, nvalues = 0;
+
+    if (addr == NULL || av == NULL || h == NULL)
+	return -EINVAL;
+
+    memset(h, 0, sizeof(*h));
+    h->addr = addr;
+    h->value = av;
+    h->type = mmv_value_type(addr, (mmv_disk_value_t *)av);
+
+    toc = (mmv_disk_toc_t *)((char *)addr + sizeof(mmv_disk_header_t));
+    for (i = 0; i < hdr->tocs; i++) {
+	if (toc[i].type == MMV_TOC_VALUES) {
+	    values = (mmv_disk_value_t *)((char *)addr + toc[i].offset);
+	    nvalues = toc[i].count;
+	} else if (toc[i].type == MMV_TOC_STRIPES) {
+	    stripes = toc[i].offset;
+	    h->nstripes = toc[i].count;
 	}
-	switch (type) {
+    }
+    if (values == NULL)
+	return -EINVAL;
+
+    if (stripes && h->nstripes > 0) {
+	switch (h->type) {
 	case MMV_TYPE_I32:
-	    v->value.l++;
-	    break;
 	case MMV_TYPE_U32:
-	    v->value.ul++;
-	    break;
 	case MMV_TYPE_I64:
-	    v->value.ll++;
-	    break;
 	case MMV_TYPE_U64:
-	    v->value.ull++;
-	    break;
 	case MMV_TYPE_FLOAT:
-	    v->value.f++;
-	    break;
 	case MMV_TYPE_DOUBLE:
-	    v->value.d++;
+	    i = (mmv_disk_value_t *)av - values;
+	    h->stride = MMV_STRIPE_STRIDE(nvalues);
+	    h->stripe = (char *)addr + stripes + i * sizeof(pmAtomValue);
 	    break;
-	case MMV_TYPE_ELAPSED:
-	    if (v->value.ll < 0)
-		v->extra++;
-	    else {
-		v->value.ll += v->extra + 1;
-		v->extra = 0;
-	    }
-	    break;
-	default:
+	default:	/* elapsed time and strings are never striped */
+	    h->nstripes = 0;
 	    break;
 	}
+    } else {
+	h->nstripes = 0;
     }
+    return 0;
+}
+
+void
+mmv_handle_inc_atomvalue(mmv_value_handle_t *h, pmAtomValue *inc)
+{
+    if (h == NULL || h->value == NULL)
+	return;
+    if (h->type == MMV_TYPE_ELAPSED)
+	mmv_elapsed_add((mmv_disk_value_t *)h->value, inc->ll);
+    else if (h->stripe)
+	mmv_atomic_add(mmv_stripe_value(h), h->type, inc);
+    else
+	mmv_atomic_add(h->value, h->type, inc);
+}
+
+void
+mmv_handle_inc_value(mmv_value_handle_t *h, double inc)
+{
+    pmAtomValue value;
+
+    if (h != NULL) {
+	mmv_double_atomvalue(h->type, inc, &value);
+	mmv_handle_inc_atomvalue(h, &value);
+    }
+}
+
+void
+mmv_handle_inc(mmv_value_handle_t *h)
+{
+    if (h != NULL && h->type == MMV_TYPE_ELAPSED)
+	mmv_inc(h->addr, h->value);
+    else
+	mmv_handle_inc_value(h, 1);
 }
 
 void
 mmv_set_value(void *addr, pmAtomValue *av, double val)
 {
     if (av != NULL && addr != NULL) {
-	mmv_disk_header_t *hdr = (mmv_disk_header_t *)addr;
 	mmv_disk_value_t *v = (mmv_disk_value_t *)av;
-	int type;
-
-	if (hdr->version == MMV_VERSION1) {
-	    mmv_disk_metric_t *m = (mmv_disk_metric_t *)
-					((char *)addr + v->metric);
-	    type = m->type;
-	} else {
-	    mmv_disk_metric2_t *m = (mmv_disk_metric2_t *)
-					((char *)addr + v->metric);
-	    type = m->type;
-	}
-	switch (type) {
-	case MMV_TYPE_I32:
-	    v->value.l = (__int32_t)val;
-	    break;
-	case MMV_TYPE_U32:
-	    v->value.ul = (__uint32_t)val;
-	    break;
-	case MMV_TYPE_I64:
-	    v->value.ll = (__int64_t)val;
-	    break;
-	case MMV_TYPE_U64:
-	    v->value.ull = (__uint64_t)val;
-	    break;
-	case MMV_TYPE_FLOAT:
-	    v->value.f = (float)val;
-	    break;
-	case MMV_TYPE_DOUBLE:
-	    v->value.d = val;
-	    break;
-	case MMV_TYPE_ELAPSED:
-	    v->value.ll = (__int64_t)val;
-	    v->extra = 0;
-	    break;
-	default:
-	    break;
-	}
+	mmv_metric_type_t type = mmv_value_type(addr, v);
+	pmAtomValue value;
+
+	if (type == MMV_TYPE_STRING || type == MMV_TYPE_NOSUPPORT)
+	    return;
+	mmv_double_atomvalue(type, val, &value);
+	mmv_clear_stripes(addr, v);
+	mmv_atomic_set(&v->value, type, &value);
+	if (type == MMV_TYPE_ELAPSED)
+	    __atomic_store_n(&v->extra, 0, __ATOMIC_RELAXED);
     }
 }
 
@@ -1551,21 +1923,9 @@ void
 mmv_set_string(void *addr, pmAtomValue *av, const char *string, int size)
 {
     if (av != NULL && addr != NULL && string != NULL) {
-	mmv_disk_header_t *hdr = (mmv_disk_header_t *)addr;
 	mmv_disk_value_t *v = (mmv_disk_value_t *)av;
-	int type;
-
-	if (hdr->version == MMV_VERSION1) {
-	    mmv_disk_metric_t *m = (mmv_disk_metric_t *)
-					((char *)addr + v->metric);
-	    type = m->type;
-	} else {
-	    mmv_disk_metric2_t *m = (mmv_disk_metric2_t *)
-					((char *)addr + v->metric);
-	    type = m->type;
-	}
  
-	if (type == MMV_TYPE_STRING &&
+	if (mmv_value_type(addr, v) == MMV_TYPE_STRING &&
 	    (size >= 0 && size < MMV_STRINGMAX - 1)) {
 	    __uint64_t soffset = v->extra;
 	    mmv_disk_string_t *s;
@@ -1585,25 +1945,17 @@ void
 mmv_set_atomvalue(void *addr, pmAtomValue *av, pmAtomValue *value)
 {
     if (av != NULL && addr != NULL) {
-	mmv_disk_header_t *hdr = (mmv_disk_header_t *)addr;
 	mmv_disk_value_t *v = (mmv_disk_value_t *)av;
-	int type;
+	mmv_metric_type_t type = mmv_value_type(addr, v);
 
-	if (hdr->version == MMV_VERSION1) {
-	    mmv_disk_metric_t *m = (mmv_disk_metric_t *)
-					((char *)addr + v->metric);
-	    type = m->type;
-	} else {
-	    mmv_disk_metric2_t *m = (mmv_disk_metric2_t *)
-					((char *)addr + v->metric);
-	    type = m->type;
+	if (type == MMV_TYPE_STRING) {
+	    mmv_set_string(addr, av, value->cp, strlen(value->cp));
+	    return;
 	}
+	mmv_clear_stripes(addr, v);
 	if (type == MMV_TYPE_ELAPSED)
-	    v->extra = 0;
-	if (type != MMV_TYPE_STRING)
-	    v->value = *value;
-	else
-	    mmv_set_string(addr, av, value->cp, strlen(value->cp));
+	    __atomic_store_n(&v->extra, 0, __ATOMIC_RELAXED);
+	mmv_atomic_set(&v->value, type, value);
     }
 }
 
@@ -25,6 +25,7 @@ PMCD_DATA int	pmcd_seqnum = 1;	/* PMDA start/restart count */
 PMCD_DATA int	pmcd_hi_openfds = -1;   /* Highest open pmcd file descriptor */
 PMCD_DATA int	pmcd_done;		/* flag from pmcd pmda */
 PMCD_DATA int	pmcd_timeout = 5;	/* Timeout for hung agents */
+PMCD_DATA int	pmcd_hedge;		/* Adaptive fetch timeout multiple */
 
 PMCD_DATA int	nAgents;		/* Number of active agents */
 PMCD_DATA AgentInfo *agent;		/* Array of agent info structs */
@@ -49,6 +50,43 @@ pmcd_agent(int domain)
     return NULL;
 }
 
+/*
+ * Return the time (seconds) to wait for a fetch result from an agent.
+ * Once a daemon agent has answered enough fetches for its usual wait
+ * time to be known, this is pmcd_hedge times the upper bound of the
+ * histogram bucket holding its 99th percentile wait, so that one slow
+ * agent does not hold up the values from the others - but never less
+ * than HEDGE_MINIMUM, nor more than pmcd_timeout.
+ */
+#define HEDGE_SAMPLES	32		/* fetches needed before adapting */
+#define HEDGE_MINIMUM	0.01		/* seconds */
+
+double
+pmcd_agent_timeout(AgentInfo *ap)
+{
+    LatencyHist	*hp = &ap->waitTime;
+    __uint64_t	need, seen = 0;
+    double	timeout;
+    int		b;
+
+    if (pmcd_hedge <= 0 || ap->ipcType == AGENT_DSO || hp->count < HEDGE_SAMPLES)
+	return pmcd_timeout;
+
+    need = hp->count - hp->count / 100;
+    for (b = 0; b < PMCD_LAT_BUCKETS - 1; b++)
+	if ((seen += hp->bucket[b]) >= need)
+	    break;
+    if (b == PMCD_LAT_BUCKETS - 1)	/* beyond the last bounded bucket */
+	return pmcd_timeout;
+
+    timeout = (double)(1ULL << b) / 1000000.0 * pmcd_hedge;
+    if (timeout < HEDGE_MINIMUM)
+	timeout = HEDGE_MINIMUM;
+    if (pmcd_timeout > 0 && timeout > pmcd_timeout)
+	timeout = pmcd_timeout;
+    return timeout;
+}
+
 /*
  * File descriptors are used as an internal index with the advent
  * of NSPR in libpcp.  We (may) need to first decode the index to
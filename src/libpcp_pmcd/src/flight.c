@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include <time.h>
+#include "pmcd.h"
+
+/*
+ * PDU flight recorder - unlike the event trace, this is always on and
+ * keeps one fixed-size record for every client request, describing how
+ * long the request waited to be read after pmcd was woken for it, how
+ * long it took to service and which agent took the longest to answer.
+ *
+ * Records are only written from the pmcd main loop and only read from
+ * pmdapmcd (a DSO agent called from that same loop) or when dumping, so
+ * no locking is needed, and the cost per request is two clock reads
+ * and a structure copy.
+ */
+
+static FlightRecord	*flight;
+static __uint64_t	flight_seq;	/* count of requests recorded */
+static struct timeval	flight_ready;	/* when requests became readable */
+static struct timeval	flight_start;	/* when this request was started */
+static int		flight_domain = -1;
+static double		flight_time;	/* time spent in flight_domain */
+
+/*
+ * by default, keep the last 1024 requests -- change by modifying
+ * pmcd.control.flightbufs, with zero turning the recorder off
+ */
+PMCD_DATA int		pmcd_flight_nbufs = 1024;
+
+void
+pmcd_init_flight(int n)
+{
+    if (flight != NULL)
+	free(flight);
+    flight = NULL;
+    pmcd_flight_nbufs = 0;
+    if (n > 0) {
+	if ((flight = (FlightRecord *)calloc(n, sizeof(FlightRecord))) == NULL) {
+	    pmNoMem("pmcd_init_flight", n * sizeof(FlightRecord), PM_RECOV_ERR);
+	    return;
+	}
+	pmcd_flight_nbufs = n;
+    }
+}
+
+/* Note the time at which a set of client requests became ready */
+void
+pmcd_flight_ready(void)
+{
+    pmtimevalNow(&flight_ready);
+}
+
+/* Start timing a client request */
+void
+pmcd_flight_start(void)
+{
+    pmtimevalNow(&flight_start);
+    flight_domain = -1;
+    flight_time = 0;
+}
+
+/*
+ * Note an agent involved in the current request and the time it took
+ * (seconds) - the slowest of these is recorded for the request
+ */
+void
+pmcd_flight_agent(int domain, double elapsed)
+{
+    if (flight_domain == -1 || elapsed > flight_time) {
+	flight_domain = domain;
+	flight_time = elapsed;
+    }
+}
+
+static unsigned int
+flight_usec(struct timeval *end, struct timeval *start)
+{
+    double	usec = pmtimevalSub(end, start) * 1000000.0;
+
+    if (usec <= 0)
+	return 0;
+    if (usec >= (double)UINT_MAX)
+	return UINT_MAX;
+    return (unsigned int)usec;
+}
+
+/* Finish a client request, adding its record to the recorder */
+void
+pmcd_flight_end(unsigned int seq, int type, int size, int status)
+{
+    FlightRecord	*fp;
+    struct timeval	now;
+
+    if (flight == NULL) {
+	if (pmcd_flight_nbufs <= 0)
+	    return;
+	pmcd_init_flight(pmcd_flight_nbufs);	/* first request */
+	if (flight == NULL)
+	    return;
+    }
+
+    pmtimevalNow(&now);
+    fp = &flight[flight_seq % pmcd_flight_nbufs];
+    fp->seq = ++flight_seq;
+    fp->stamp = flight_start;
+    fp->type = type;
+    fp->client = seq;
+    fp->agent = flight_domain;
+    fp->size = size;
+    fp->status = status;
+    fp->queue = flight_usec(&flight_start, &flight_ready);
+    fp->service = flight_usec(&now, &flight_start);
+}
+
+/* Return the record in slot i of the recorder, NULL if unused */
+FlightRecord *
+pmcd_flight_record(int i)
+{
+    if (flight == NULL || i < 0 || i >= pmcd_flight_nbufs)
+	return NULL;
+    if (flight[i].seq == 0)
+	return NULL;
+    return &flight[i];
+}
+
+void
+pmcd_dump_flight(FILE *f)
+{
+    FlightRecord	*fp;
+    __uint64_t		i, first;
+    struct tm		*tmp;
+    time_t		clock;
+    char		strbuf[20];
+
+    fprintf(f, "\n->PMCD flight recorder: ");
+    if (flight == NULL || flight_seq == 0) {
+	fprintf(f, "<empty>\n\n");
+	return;
+    }
+    first = flight_seq > pmcd_flight_nbufs ? flight_seq - pmcd_flight_nbufs : 0;
+    fprintf(f, "requests %llu to %llu\n",
+	    (unsigned long long)first + 1, (unsigned long long)flight_seq);
+    fprintf(f, "->%-8s %-15s %-13s %6s %6s %8s %10s %10s  %s\n",
+	    "seq", "time", "pdu", "client", "agent", "size",
+	    "queue(us)", "svc(us)", "status");
+    for (i = first; i < flight_seq; i++) {
+	fp = &flight[i % pmcd_flight_nbufs];
+	clock = fp->stamp.tv_sec;
+	tmp = localtime(&clock);
+	fprintf(f, "->%-8llu %02d:%02d:%02d.%06d %-13s %6u %6d %8d %10u %10u  %s\n",
+		(unsigned long long)fp->seq,
+		tmp->tm_hour, tmp->tm_min, tmp->tm_sec, (int)fp->stamp.tv_usec,
+		__pmPDUTypeStr_r(fp->type, strbuf, sizeof(strbuf)),
+		fp->client, fp->agent, fp->size, fp->queue, fp->service,
+		fp->status < 0 ? pmErrStr(fp->status) : "ok");
+    }
+    fputc('\n', f);
+}
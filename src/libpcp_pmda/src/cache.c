@@ -26,23 +26,44 @@
  */
 typedef struct entry {
     struct entry	*next;		/* in inst identifier order */
-    struct entry	*h_inst;	/* inst hash chain */
-    struct entry	*h_name;	/* name hash chain */
     int			inst;
     char		*name;
     int			hashlen;	/* smaller of strlen(name) and chars to first space */
+    unsigned int	hashval;	/* hash_str() of first hashlen chars of name */
     int			keylen;		/* > 0 if have key from pmdaCacheStoreKey() */
     void		*key;		/* != NULL if have key from pmdaCacheStoreKey() */
     int			state;
+    int			saved;		/* external file has a record for this entry */
     void		*private;
     time_t		stamp;
 } entry_t;
 
 #define CACHE_VERSION1	1
 #define CACHE_VERSION2	2
-#define CACHE_VERSION	CACHE_VERSION2	/* version of external file format */
+#define CACHE_VERSION3	3
+#define CACHE_VERSION	CACHE_VERSION3	/* latest external file format */
 #define MAX_HASH_TRY	10
 
+/*
+ * Open addressing (linear probing) index over the entries of a cache.
+ * There is no deletion, culled entries stay in the index until
+ * reclaim_cache() rebuilds it.  When an index grows the previous
+ * table is kept intact and drained into the new one a few slots at
+ * a time by later insertions, and lookups consult both tables until
+ * the old one is empty.
+ */
+typedef struct {
+    entry_t		**slot;		/* NULL until first insertion */
+    unsigned int	mask;		/* table size - 1 */
+    unsigned int	used;		/* occupied slots */
+    entry_t		**old;		/* previous table, being drained */
+    unsigned int	oldmask;
+    unsigned int	drain;		/* next slot of old to migrate */
+} index_t;
+
+#define INDEX_MINSIZE	16
+#define INDEX_DRAIN	8	/* old slots migrated per insertion */
+
 /*
  * linked list of cache headers
  */
@@ -51,20 +72,33 @@ typedef struct hdr {
     entry_t		*first;		/* in inst order */
     entry_t		*last;		/* in inst order */
     entry_t		*save;		/* used in cache_walk() */
-    entry_t		**ctl_inst;	/* hash by inst chains */
-    entry_t		**ctl_name;	/* hash by name chains */
+    index_t		ix_inst;	/* index by inst */
+    index_t		ix_name;	/* index by name */
     pmInDom		indom;
-    int			hsize;
-    int			hbits;
     int			nentry;		/* number of entries */
+    int			nlist;		/* entries on the list, including culled */
+    int			nempty;		/* culled entries not yet reclaimed */
+    int			unsorted;	/* entries appended out of inst order */
     int			ins_mode;	/* see insert_cache() */
     int			hstate;		/* dirty/clean/string state */
     int			keyhash_cnt[MAX_HASH_TRY];
     int			maxinst;	/* maximum inst */
+    int			nrecord;	/* records in external file, -1 to rewrite */
+    int			f_ins_mode;	/* ins_mode in external file header */
+    int			f_maxinst;	/* maxinst in external file header */
+    int			f_version;	/* version in external file header */
+    int			ntomb;		/* reclaimed entries with a record in */
+    int			*tomb;		/* the external file, see save_cache() */
 } hdr_t;
 
 #define DEFAULT_MAXINST 0x7fffffff
 
+/*
+ * external file is rewritten (compacted) when it holds more than
+ * twice as many records as there are entries, plus this many
+ */
+#define COMPACT_SLACK	64
+
 /* bitfields for hstate */
 #define DIRTY_INSTANCE	0x1
 #define DIRTY_STAMP	0x2
@@ -95,6 +129,23 @@ hash_str(const signed char *str, int len)
     return hash(str, len, 0);
 }
 
+/*
+ * instance identifiers are often sequential, so mix the bits before
+ * masking with the table size
+ */
+static unsigned int
+hash_inst(int inst)
+{
+    __uint32_t	x = (__uint32_t)inst;
+
+    x ^= x >> 16;
+    x *= 0x85ebca6b;
+    x ^= x >> 13;
+    x *= 0xc2b2ae35;
+    x ^= x >> 16;
+    return x;
+}
+
 static void
 KeyStr(FILE *f, int keylen, const char *key)
 {
@@ -164,14 +215,13 @@ static hdr_t *
 find_cache(pmInDom indom, int *sts)
 {
     hdr_t	*h;
-    int		i;
 
     for (h = base; h != NULL; h = h->next) {
 	if (h->indom == indom)
 	    return h;
     }
 
-    if ((h = (hdr_t *)malloc(sizeof(hdr_t))) == NULL) {
+    if ((h = (hdr_t *)calloc(1, sizeof(hdr_t))) == NULL) {
 	char	strbuf[20];
 	pmNotifyErr(LOG_ERR, 
 	     "find_cache: indom %s: unable to allocate memory for hdr_t",
@@ -181,22 +231,79 @@ find_cache(pmInDom indom, int *sts)
     }
     h->next = base;
     base = h;
-    h->first = NULL;
-    h->last = NULL;
-    h->hsize = 16;
-    h->hbits = 0xf;
-    h->ctl_inst = (entry_t **)calloc(h->hsize, sizeof(entry_t *));
-    h->ctl_name = (entry_t **)calloc(h->hsize, sizeof(entry_t *));
     h->indom = indom;
-    h->nentry = 0;
-    h->ins_mode = 0;
-    h->hstate = 0;
-    for (i = 0; i < MAX_HASH_TRY; i++)
-	h->keyhash_cnt[i] = 0;
     h->maxinst = DEFAULT_MAXINST;
+    h->nrecord = -1;
     return h;
 }
 
+/*
+ * Entries are appended with known inst values (from load_cache() and
+ * pmdaCacheStoreKey()) without searching for their place in the list,
+ * and the list is put back into inst order here, when next needed.
+ * This is a bottom-up merge sort, so stable for culled duplicates.
+ */
+static void
+sort_cache(hdr_t *h)
+{
+    entry_t	*list = h->first;
+    entry_t	*tail = NULL;
+    entry_t	*p;
+    entry_t	*q;
+    entry_t	*e;
+    int		insize = 1;
+    int		nmerges;
+    int		psize;
+    int		qsize;
+    int		i;
+
+    if (h->unsorted == 0 || list == NULL)
+	return;
+
+    for ( ; ; ) {
+	p = list;
+	list = tail = NULL;
+	nmerges = 0;
+	while (p != NULL) {
+	    nmerges++;
+	    q = p;
+	    psize = 0;
+	    for (i = 0; i < insize && q != NULL; i++) {
+		psize++;
+		q = q->next;
+	    }
+	    qsize = insize;
+	    while (psize > 0 || (qsize > 0 && q != NULL)) {
+		if (psize == 0) {
+		    e = q; q = q->next; qsize--;
+		}
+		else if (qsize == 0 || q == NULL) {
+		    e = p; p = p->next; psize--;
+		}
+		else if (p->inst <= q->inst) {
+		    e = p; p = p->next; psize--;
+		}
+		else {
+		    e = q; q = q->next; qsize--;
+		}
+		if (tail == NULL)
+		    list = e;
+		else
+		    tail->next = e;
+		tail = e;
+	    }
+	    p = q;
+	}
+	tail->next = NULL;
+	if (nmerges <= 1)
+	    break;
+	insize <<= 1;
+    }
+    h->first = list;
+    h->last = tail;
+    h->unsorted = 0;
+}
+
 /*
  * Traverse the cache in ascending inst order
  */
@@ -206,6 +313,7 @@ walk_cache(hdr_t *h, int op)
     entry_t	*e;
 
     if (op == PMDA_CACHE_WALK_REWIND) {
+	sort_cache(h);
 	h->save = h->first;
 	return NULL;
     }
@@ -215,33 +323,103 @@ walk_cache(hdr_t *h, int op)
     return e;
 }
 
+static void
+index_place(entry_t **slot, unsigned int mask, entry_t *e, unsigned int hv)
+{
+    unsigned int	i;
+
+    for (i = hv & mask; slot[i] != NULL; i = (i + 1) & mask)
+	;
+    slot[i] = e;
+}
+
+static unsigned int
+index_hash(entry_t *e, int byname)
+{
+    return byname ? e->hashval : hash_inst(e->inst);
+}
+
 /*
- * inst_or_name is 0 for inst hash list, 1 for name hash list
+ * migrate up to n slots from the table being drained
  */
 static void
-dump_hash_list(FILE *fp, hdr_t *h, int inst_or_name, int i)
+index_drain(index_t *ix, int byname, unsigned int n)
 {
     entry_t	*e;
 
-    fprintf(fp, " [%03d]", i);
-    if (inst_or_name == 1) {
-	for (e = h->ctl_name[i]; e != NULL; e = e->h_name) {
-	    fprintf(fp, " -> %d", e->inst);
-	    if (e->state == PMDA_CACHE_EMPTY)
-		fputc('E', fp);
-	    else if (e->state == PMDA_CACHE_INACTIVE)
-		fputc('I', fp);
+    while (ix->old != NULL && n-- > 0) {
+	if ((e = ix->old[ix->drain]) != NULL) {
+	    index_place(ix->slot, ix->mask, e, index_hash(e, byname));
+	    ix->used++;
 	}
-	fputc('\n', fp);
-    }
-    else {
-	for (e = h->ctl_inst[i]; e != NULL; e = e->h_inst) {
-	    fprintf(fp, " -> %d", e->inst);
-	    if (e->state == PMDA_CACHE_EMPTY)
-		fputc('E', fp);
-	    else if (e->state == PMDA_CACHE_INACTIVE)
-		fputc('I', fp);
+	if (ix->drain++ == ix->oldmask) {
+	    free(ix->old);
+	    ix->old = NULL;
 	}
+    }
+}
+
+/*
+ * make room for one more entry, growing the table once it is half full
+ */
+static int
+index_grow(index_t *ix, int byname)
+{
+    entry_t		**slot;
+    unsigned int	size;
+
+    index_drain(ix, byname, INDEX_DRAIN);
+    if (ix->slot != NULL && 2 * (ix->used + 1) <= ix->mask + 1)
+	return 0;
+
+    /* previous resize should be long done by now, but be sure */
+    index_drain(ix, byname, ~0U);
+    size = ix->slot == NULL ? INDEX_MINSIZE : 2 * (ix->mask + 1);
+    if ((slot = (entry_t **)calloc(size, sizeof(entry_t *))) == NULL) {
+	/* soldier on in the current table while there is any room */
+	if (ix->slot != NULL && ix->used + 1 < ix->mask + 1)
+	    return 0;
+	return -oserror();
+    }
+    ix->old = ix->slot;
+    ix->oldmask = ix->mask;
+    ix->drain = 0;
+    ix->slot = slot;
+    ix->mask = size - 1;
+    ix->used = 0;
+    return 0;
+}
+
+static void
+index_add(index_t *ix, entry_t *e, int byname)
+{
+    index_place(ix->slot, ix->mask, e, index_hash(e, byname));
+    ix->used++;
+}
+
+/*
+ * inst_or_name is 0 for inst index, 1 for name index
+ */
+static void
+dump_index(FILE *fp, hdr_t *h, int inst_or_name)
+{
+    index_t		*ix = inst_or_name ? &h->ix_name : &h->ix_inst;
+    entry_t		*e;
+    unsigned int	i;
+
+    if (ix->old != NULL)
+	fprintf(fp, " draining %u slots from %u\n",
+		ix->oldmask + 1 - ix->drain, ix->oldmask + 1);
+    for (i = 0; i <= ix->mask; i++) {
+	if ((e = ix->slot[i]) == NULL)
+	    continue;
+	fprintf(fp, " [%03u] -> %d", i, e->inst);
+	if (e->state == PMDA_CACHE_EMPTY)
+	    fputc('E', fp);
+	else if (e->state == PMDA_CACHE_INACTIVE)
+	    fputc('I', fp);
+	if ((index_hash(e, inst_or_name) & ix->mask) != i)
+	    fprintf(fp, " (home %u)", index_hash(e, inst_or_name) & ix->mask);
 	fputc('\n', fp);
     }
 }
@@ -253,8 +431,10 @@ dump(FILE *fp, hdr_t *h, int do_hash)
     char	strbuf[20];
     int		i;
 
+    sort_cache(h);
     fprintf(fp, "pmdaCacheDump: indom %s: nentry=%d ins_mode=%d hstate=%d hsize=%d\n",
-	pmInDomStr_r(h->indom, strbuf, sizeof(strbuf)), h->nentry, h->ins_mode, h->hstate, h->hsize);
+	pmInDomStr_r(h->indom, strbuf, sizeof(strbuf)), h->nentry, h->ins_mode, h->hstate,
+	h->ix_inst.slot == NULL ? 0 : h->ix_inst.mask + 1);
     for (e = h->first; e != NULL; e = e->next) {
 	if (e->state == PMDA_CACHE_EMPTY) {
 	    fprintf(fp, "(%10d) %8s\n", e->inst, "empty");
@@ -293,51 +473,16 @@ dump(FILE *fp, hdr_t *h, int do_hash)
 	}
     }
 
-    if (h->ctl_inst != NULL) {
+    if (h->ix_inst.slot != NULL) {
 	fprintf(fp, "inst hash\n");
-	for (i = 0; i < h->hsize; i++) {
-	    dump_hash_list(fp, h, 0, i);
-	}
+	dump_index(fp, h, 0);
     }
-    if (h->ctl_name != NULL) {
+    if (h->ix_name.slot != NULL) {
 	fprintf(fp, "name hash\n");
-	for (i = 0; i < h->hsize; i++) {
-	    dump_hash_list(fp, h, 1, i);
-	}
+	dump_index(fp, h, 1);
     }
 }
 
-static entry_t *
-find_name(hdr_t *h, const char *name, int *sts)
-{
-    entry_t	*e;
-    int		hashlen = get_hashlen(h, name);
-
-    *sts = 0;
-    for (e = h->first; e != NULL; e = e->next) {
-	if (e->state != PMDA_CACHE_EMPTY) {
-	    if ((*sts = name_eq(e, name, hashlen)))
-		break;
-	}
-    }
-    return e;
-}
-
-static entry_t *
-find_inst(hdr_t *h, int inst)
-{
-    entry_t	*e;
-
-    if ((e = h->last) != NULL && e->inst < inst)
-	return NULL;
-
-    for (e = h->first; e != NULL; e = e->next) {
-	if (e->inst == inst && e->state != PMDA_CACHE_EMPTY)
-	    break;
-    }
-    return e;
-}
-
 /*
  * supports find by instance identifier (name == NULL) else
  * find by instance name
@@ -345,32 +490,46 @@ find_inst(hdr_t *h, int inst)
 static entry_t *
 find_entry(hdr_t *h, const char *name, int inst, int *sts)
 {
-    entry_t	*e;
+    index_t		*ix;
+    entry_t		**slot;
+    entry_t		*e;
+    unsigned int	mask;
+    unsigned int	hv;
+    unsigned int	i;
+    int			hashlen = 0;
+    int			t;
 
     *sts = 0;
     if (name == NULL) {
-	/*
-	 * search by instance identifier (inst)
-	 */
-	if (h->ctl_inst == NULL)
-	    /* no hash, use linear search */
-	    return find_inst(h, inst);
-	for (e = h->ctl_inst[inst & h->hbits]; e != NULL; e = e->h_inst) {
-	    if (e->inst == inst && e->state != PMDA_CACHE_EMPTY)
-		return e;
-	}
+	ix = &h->ix_inst;
+	hv = hash_inst(inst);
     }
     else {
-	/*
-	 * search by instance name
-	 */
-	int	hashlen = get_hashlen(h, name);
+	ix = &h->ix_name;
+	hashlen = get_hashlen(h, name);
+	hv = hash_str((const signed char *)name, hashlen);
+    }
 
-	if (h->ctl_name == NULL)
-	    /* no hash, use linear search */
-	    return find_name(h, name, sts);
-	for (e = h->ctl_name[hash_str((const signed char *)name, hashlen) & h->hbits]; e != NULL; e = e->h_name) {
-	    if (e->state != PMDA_CACHE_EMPTY) {
+    /* the current table, then any table still being drained */
+    for (t = 0; t < 2; t++) {
+	if (t == 0) {
+	    slot = ix->slot;
+	    mask = ix->mask;
+	}
+	else {
+	    slot = ix->old;
+	    mask = ix->oldmask;
+	}
+	if (slot == NULL)
+	    continue;
+	for (i = hv & mask; (e = slot[i]) != NULL; i = (i + 1) & mask) {
+	    if (e->state == PMDA_CACHE_EMPTY)
+		continue;
+	    if (name == NULL) {
+		if (e->inst == inst)
+		    return e;
+	    }
+	    else if (e->hashval == hv) {
 		if ((*sts = name_eq(e, name, hashlen)))
 		    return e;
 	    }
@@ -381,143 +540,38 @@ find_entry(hdr_t *h, const char *name, int inst, int *sts)
 }
 
 /*
- * optionally resize the hash table first (if resize == 1)
- *
- * then re-order each hash chain so that active entries are
- * before inactive entries, and culled entries dropped
+ * Free the culled entries and rebuild both indexes, sized for the
+ * entries that remain, with active entries placed before inactive
+ * ones so that they are found in fewer probes.
  *
- * applies to _both_ the inst and name hashes
+ * Culled entries that still have a record in the external file are
+ * remembered in tomb[] so save_cache() can append their removal.
  */
 static void
-redo_hash(hdr_t *h, int resize)
+reclaim_cache(hdr_t *h)
 {
-    entry_t	*e;
-    entry_t	*last_e = NULL;
-    entry_t	*t;
-    int		i;
-    entry_t	*last_active;
-    entry_t	*inactive;
-    entry_t	*last_inactive;
-
-    if (resize) {
-	entry_t		**old_inst;
-	entry_t		**old_name;
-	int		oldsize;
-	int		oldi;
-
-	old_inst = h->ctl_inst;
-	old_name = h->ctl_name;
-	oldsize = h->hsize;
-	h->hsize <<= 1;
-	h->ctl_inst = (entry_t **)calloc(h->hsize, sizeof(entry_t *));
-	if (h->ctl_inst == NULL) {
-	    h->ctl_inst = old_inst;
-	    h->hsize = oldsize;
-	    goto reorder;
-	}
-	h->ctl_name = (entry_t **)calloc(h->hsize, sizeof(entry_t *));
-	if (h->ctl_name == NULL) {
-	    free(h->ctl_inst);
-	    h->ctl_inst = old_inst;
-	    h->ctl_name = old_name;
-	    h->hsize = oldsize;
-	    goto reorder;
-	}
-	h->hbits = (h->hbits << 1) | 1;
-	for (oldi = 0; oldi < oldsize; oldi++) {
-	    for (e = old_inst[oldi]; e != NULL; ) {
-		t = e;
-		e = e->h_inst;
-		i = t->inst & h->hbits;
-		t->h_inst = h->ctl_inst[i];
-		h->ctl_inst[i] = t;
-	    }
-	}
-	for (oldi = 0; oldi < oldsize; oldi++) {
-	    for (e = old_name[oldi]; e != NULL; ) {
-		t = e;
-		e = e->h_name;
-		i = hash_str((const signed char *)t->name, t->hashlen) & h->hbits;
-		t->h_name = h->ctl_name[i];
-		h->ctl_name[i] = t;
-	    }
-	}
-	free(old_inst);
-	free(old_name);
-    }
-reorder:
-
-    /*
-     * first the inst hash list, moving active entries before inactive ones,
-     * and unlinking any empty ones
-     */ 
-    for (i = 0; i < h->hsize; i++) {
-	last_active = NULL;
-	inactive = NULL;
-	last_inactive = NULL;
-	e = h->ctl_inst[i];
-	h->ctl_inst[i] = NULL;
-	while (e != NULL) {
-	    t = e;
-	    e = e->h_inst;
-	    t->h_inst = NULL;
-	    if (t->state == PMDA_CACHE_ACTIVE) {
-		if (last_active == NULL)
-		    h->ctl_inst[i] = t;
-		else
-		    last_active->h_inst = t;
-		last_active = t;
-	    }
-	    else if (t->state == PMDA_CACHE_INACTIVE) {
-		if (last_inactive == NULL)
-		    inactive = t;
-		else
-		    last_inactive->h_inst = t;
-		last_inactive = t;
-	    }
-	}
-	if (last_active == NULL)
-	    h->ctl_inst[i] = inactive;
-	else
-	    last_active->h_inst = inactive;
-    }
-
-    /*
-     * and now the name hash list, doing the same thing
-     */
-    for (i = 0; i < h->hsize; i++) {
-	last_active = NULL;
-	inactive = NULL;
-	last_inactive = NULL;
-	e = h->ctl_name[i];
-	h->ctl_name[i] = NULL;
-	while (e != NULL) {
-	    t = e;
-	    e = e->h_name;
-	    t->h_name = NULL;
-	    if (t->state == PMDA_CACHE_ACTIVE) {
-		if (last_active == NULL)
-		    h->ctl_name[i] = t;
-		else
-		    last_active->h_name = t;
-		last_active = t;
-	    }
-	    else if (t->state == PMDA_CACHE_INACTIVE) {
-		if (last_inactive == NULL)
-		    inactive = t;
-		else
-		    last_inactive->h_name = t;
-		last_inactive = t;
-	    }
-	}
-	if (last_active == NULL)
-	    h->ctl_name[i] = inactive;
-	else
-	    last_active->h_name = inactive;
+    entry_t		*e;
+    entry_t		*t;
+    entry_t		*last_e = NULL;
+    entry_t		**inst;
+    entry_t		**name;
+    int			*tomb;
+    unsigned int	size;
+    int			n;
+    int			pass;
+
+    n = h->nlist - h->nempty;
+    for (size = INDEX_MINSIZE; size < 2 * (unsigned int)(n + 1); size <<= 1)
+	;
+    if ((inst = (entry_t **)calloc(size, sizeof(entry_t *))) == NULL)
+	return;
+    if ((name = (entry_t **)calloc(size, sizeof(entry_t *))) == NULL) {
+	free(inst);
+	return;
     }
 
     /*
-     * now walk the instance list, removing any culled entries and
+     * walk the instance list, removing any culled entries and
      * rebuilding the linked list
      */
     e = h->first;
@@ -529,18 +583,52 @@ reorder:
 		h->first = e;
 	    else
 		last_e->next = e;
+	    if (h->save == t)
+		h->save = e;
+	    if (t->saved) {
+		tomb = (int *)realloc(h->tomb, (h->ntomb + 1) * sizeof(int));
+		if (tomb != NULL) {
+		    h->tomb = tomb;
+		    h->tomb[h->ntomb++] = t->inst;
+		}
+		else
+		    h->nrecord = -1;	/* cannot append, rewrite instead */
+	    }
 	    if (t->name)
 		free(t->name);
+	    if (t->key)
+		free(t->key);
 	    free(t);
+	    h->nlist--;
 	}
 	else
 	    last_e = t;
     }
+    h->last = last_e;
+    h->nempty = 0;
+
+    for (pass = PMDA_CACHE_ACTIVE; pass <= PMDA_CACHE_INACTIVE; pass++) {
+	for (e = h->first; e != NULL; e = e->next) {
+	    if (e->state != pass)
+		continue;
+	    index_place(inst, size - 1, e, hash_inst(e->inst));
+	    index_place(name, size - 1, e, e->hashval);
+	}
+    }
 
+    free(h->ix_inst.slot);
+    free(h->ix_inst.old);
+    free(h->ix_name.slot);
+    free(h->ix_name.old);
+    h->ix_inst.slot = inst;
+    h->ix_name.slot = name;
+    h->ix_inst.old = h->ix_name.old = NULL;
+    h->ix_inst.mask = h->ix_name.mask = size - 1;
+    h->ix_inst.used = h->ix_name.used = n;
 }
 
 /*
- * We need to keep the instances in ascending inst order.
+ * Entries are kept in ascending inst order (see sort_cache()).
  * If inst _is_ PM_IN_NULL, then we need to choose a value ...
  * The default mode is appending to use the last value+1 (this is
  * ins_mode == 0).  If we wrap the instance identifier range, or
@@ -558,7 +646,6 @@ insert_cache(hdr_t *h, const char *name, int inst, int *sts)
     entry_t	*e;
     entry_t	*last_e = NULL;
     char	*dup;
-    int		i;
     int		hashlen;
 
     *sts = 0;
@@ -597,9 +684,7 @@ insert_cache(hdr_t *h, const char *name, int inst, int *sts)
 	 * inactive).
 	 * If one matches but the other is different, keep the
 	 * matching entry, but return an error as a warning.
-	 * If both fail to match, we're OK to insert the new entry,
-	 * although we need to run down the list quickly to find the
-	 * correct place to insert the new one.
+	 * If both fail to match, we're OK to insert the new entry.
 	 */
 	e = find_entry(h, NULL, inst, sts);
 	if (e != NULL) {
@@ -624,16 +709,22 @@ insert_cache(hdr_t *h, const char *name, int inst, int *sts)
 	    *sts = PM_ERR_INST;
 	    return e;
 	}
-	/* if this entry is beyond the (sorted) list end, avoid linear scan */
-	if ((e = h->last) == NULL || e->inst > inst)
-	    e = h->first;
-	/* linear search over linked list, starting at either first or last */
-	for (; e != NULL; e = e->next) {
-	    if (e->inst < inst)
-		last_e = e;
-	    else if (e->inst > inst)
-		break;
-	}
+    }
+
+    /*
+     * once culled entries are the majority, reclaim them ... this
+     * also frees up their inst values for PMDA_CACHE_REUSE
+     */
+    if (h->nempty >= INDEX_MINSIZE && 2 * h->nempty > h->nlist)
+	reclaim_cache(h);
+
+    if (index_grow(&h->ix_inst, 0) < 0 || index_grow(&h->ix_name, 1) < 0) {
+	char	strbuf[20];
+	pmNotifyErr(LOG_ERR, 
+	     "insert_cache: indom %s: unable to allocate memory for index",
+	     pmInDomStr_r(h->indom, strbuf, sizeof(strbuf)));
+	*sts = PM_ERR_GENERIC;
+	return NULL;
     }
 
     if ((dup = strdup(name)) == NULL) {
@@ -646,6 +737,7 @@ insert_cache(hdr_t *h, const char *name, int inst, int *sts)
     }
 
     if (inst == PM_IN_NULL) {
+	sort_cache(h);
 	if (h->ins_mode == 0) {
 	    last_e = h->last;
 	    if (last_e == NULL)
@@ -686,6 +778,12 @@ retry:
 	    }
 	}
     }
+    else {
+	/* append, and sort later if this is out of order */
+	last_e = h->last;
+	if (last_e != NULL && last_e->inst > inst)
+	    h->unsorted = 1;
+    }
 
     if ((e = (entry_t *)malloc(sizeof(entry_t))) == NULL) {
 	char	strbuf[20];
@@ -709,39 +807,21 @@ retry:
     }
     e->inst = inst;
     e->name = dup;
-    e->hashlen = get_hashlen(h, dup);
+    e->hashlen = hashlen;
+    e->hashval = hash_str((const signed char *)dup, hashlen);
+    e->keylen = 0;
     e->key = NULL;
     e->state = PMDA_CACHE_INACTIVE;
+    e->saved = 0;
     e->private = NULL;
     e->stamp = 0;
-    if (h->last == NULL || h->last->inst < inst)
+    if (e->next == NULL)
 	h->last = e;
     h->nentry++;
+    h->nlist++;
 
-    /*
-     * try to keep hash table sized so there are on average no
-     * more than 4 entries per hash chain
-     */
-    if (h->hsize > 0 && h->nentry > 4 * h->hsize)
-	redo_hash(h, 1);
-
-    /* link into the inst hash list, if any */
-    if (h->ctl_inst != NULL) {
-	i = inst & h->hbits;
-	e->h_inst = h->ctl_inst[i];
-	h->ctl_inst[i] = e;
-    }
-    else
-	e->h_inst = NULL;
-
-    /* link into the name hash list, if any */
-    if (h->ctl_name != NULL) {
-	i = hash_str((const signed char *)e->name, e->hashlen) & h->hbits;
-	e->h_name = h->ctl_name[i];
-	h->ctl_name[i] = e;
-    }
-    else
-	e->h_name = NULL;
+    index_add(&h->ix_inst, e, 0);
+    index_add(&h->ix_name, e, 1);
 
     return e;
 }
@@ -752,7 +832,9 @@ load_cache(hdr_t *h)
     FILE	*fp;
     entry_t	*e;
     int		cnt;
+    int		nrec;
     int		x;
+    int		version;
     int		inst;
     int		keylen = 0;
     void	*key = NULL;
@@ -760,6 +842,8 @@ load_cache(hdr_t *h)
     char	buf[1024];	/* input line buffer, is this big enough? */
     char	*p;
     int		sts;
+    int		conflict = 0;
+    __pmHashCtl	seen;		/* insts with a record in the file so far */
     int		sep = pmPathSeparator();
     char	strbuf[20];
 
@@ -786,17 +870,17 @@ load_cache(hdr_t *h)
 	return 0;
     }
     /* First grab the file version. */
-    s = sscanf(buf, "%d ", &x);
-    if (s != 1 || x <= 0 || x > CACHE_VERSION) {
+    s = sscanf(buf, "%d ", &version);
+    if (s != 1 || version <= 0 || version > CACHE_VERSION) {
 	pmNotifyErr(LOG_ERR, 
 	     "pmdaCacheOp: %s: illegal cache header record: %s",
 	     filename, buf);
 	fclose(fp);
 	return PM_ERR_GENERIC;
-    }	
+    }
 
     /* Based on the file version, grab the entire line. */
-    switch (x) {
+    switch (version) {
 	case CACHE_VERSION1:
 	    h->maxinst = DEFAULT_MAXINST;
 	    s = sscanf(buf, "%d %d", &x, &h->ins_mode);
@@ -817,7 +901,8 @@ load_cache(hdr_t *h)
 	return PM_ERR_GENERIC;
     }
 
-    for (cnt = 0; ; cnt++) {
+    __pmHashInit(&seen);
+    for (cnt = nrec = 0; ; nrec++) {
 	if (fgets(buf, sizeof(buf), fp) == NULL)
 	    break;
 	if ((p = strchr(buf, '\n')) != NULL)
@@ -826,6 +911,26 @@ load_cache(hdr_t *h)
 	while (*p && isascii((int)*p) && isspace((int)*p))
 	    p++;
 	if (*p == '\0') goto bad;
+	if (*p == '-' && version >= CACHE_VERSION3) {
+	    /* appended by save_cache(), instance has since been culled */
+	    p++;
+	    if (!isascii((int)*p) || !isdigit((int)*p)) goto bad;
+	    inst = 0;
+	    while (*p && isascii((int)*p) && isdigit((int)*p)) {
+		inst = inst*10 + (*p-'0');
+		p++;
+	    }
+	    if (inst < 0 || *p != '\0') goto bad;
+	    e = find_entry(h, NULL, inst, &sts);
+	    if (e != NULL && e->saved) {
+		e->state = PMDA_CACHE_EMPTY;
+		e->saved = 0;
+		h->nempty++;
+	    }
+	    if (__pmHashDel(inst, NULL, &seen))
+		cnt--;
+	    continue;
+	}
 	inst = 0;
 	while (*p && isascii((int)*p) && isdigit((int)*p)) {
 	    inst = inst*10 + (*p-'0');
@@ -860,6 +965,7 @@ load_cache(hdr_t *h)
 		pmNotifyErr(LOG_ERR, 
 		     "load_cache: indom %s: unable to allocate memory for keylen=%d",
 		     pmInDomStr_r(h->indom, strbuf, sizeof(strbuf)), keylen);
+		__pmHashFree(&seen);
 		fclose(fp);
 		return PM_ERR_GENERIC;
 	    }
@@ -883,26 +989,69 @@ bad:
 		 "pmdaCacheOp: %s: illegal record: %s",
 		 filename, buf);
 	    if (key) free(key);
+	    __pmHashFree(&seen);
 	    fclose(fp);
 	    return PM_ERR_GENERIC;
 	}
-	e = insert_cache(h, p, inst, &sts);
-	if (e == NULL) {
-	    if (key) free(key);
-	    fclose(fp);
-	    return sts;
+	if (__pmHashSearch(inst, &seen) != NULL) {
+	    /*
+	     * appended by save_cache() with a new timestamp, replaces
+	     * the earlier record (already checked against the cache)
+	     */
+	    e = find_entry(h, NULL, inst, &sts);
+	    if (e == NULL || name_eq(e, p, get_hashlen(h, p)) != 1) {
+		if (key) free(key);
+		continue;
+	    }
+	}
+	else {
+	    if ((s = __pmHashAdd(inst, NULL, &seen)) < 0) {
+		if (key) free(key);
+		__pmHashFree(&seen);
+		fclose(fp);
+		return s;
+	    }
+	    e = insert_cache(h, p, inst, &sts);
+	    if (e == NULL) {
+		if (key) free(key);
+		__pmHashFree(&seen);
+		fclose(fp);
+		return sts;
+	    }
+	    cnt++;
 	}
 	if (sts != 0) {
 	    pmNotifyErr(LOG_WARNING,
 		"pmdaCacheOp: %s: loading instance %d (\"%s\") ignored, already in cache as %d (\"%s\")",
 		filename, inst, p, e->inst, e->name);
+	    conflict = 1;
 	}
+	if (e->key != NULL && e->key != key)
+	    free(e->key);
 	e->keylen = keylen;
 	e->key = key;
 	e->stamp = x;
+	e->saved = 1;
     }
+    __pmHashFree(&seen);
     fclose(fp);
 
+    /*
+     * the file can be appended to from here on, unless it needs to
+     * be rewritten in a current format or it disagrees with entries
+     * already in the cache
+     */
+    if (version >= CACHE_VERSION2 && !conflict) {
+	h->nrecord = nrec;
+	h->f_ins_mode = h->ins_mode;
+	h->f_maxinst = h->maxinst;
+	h->f_version = version;
+    }
+    else
+	h->nrecord = -1;
+    if (h->nempty > 0)
+	reclaim_cache(h);
+
     if (pmDebugOptions.indom) {
 	fprintf(stderr, "After PMDA_CACHE_LOAD\n");
 	dump(stderr, h, 0);
@@ -911,60 +1060,180 @@ bad:
     return cnt;
 }
 
+/*
+ * Write out the entire cache, compacting the external file.
+ *
+ * There are no removal records in a rewritten file, so it is written
+ * as version 2 and remains readable by older versions of libpcp_pmda;
+ * append_cache() moves the file to version 3 only when it needs to
+ * append a removal record.
+ */
 static int
-save_cache(hdr_t *h, int hstate)
+write_cache(hdr_t *h)
 {
     FILE	*fp;
     entry_t	*e;
     int		cnt;
     time_t	now;
-    int		sep = pmPathSeparator();
-    int		state = h->hstate & ~CACHE_STRINGS;
-    char	strbuf[20];
 
-    if ((state & hstate) == 0) {
-	/* nothing to be done */
-	return 0;
+    if ((fp = fopen(filename, "w")) == NULL)
+	return -oserror();
+    fprintf(fp, "%d %d %d\n", CACHE_VERSION2, h->ins_mode, h->maxinst);
+
+    sort_cache(h);
+    now = time(NULL);
+    cnt = 0;
+    for (e = h->first; e != NULL; e = e->next) {
+	if (e->state == PMDA_CACHE_EMPTY) {
+	    e->saved = 0;
+	    continue;
+	}
+	if (e->stamp == 0)
+	    e->stamp = now;
+	fprintf(fp, "%d %lld", e->inst, (long long)e->stamp);
+	if (e->keylen > 0) {
+	    char	*p = (char *)e->key;
+	    int		i;
+	    fprintf(fp, " [");
+	    for (i = 0; i < e->keylen; i++, p++)
+		fprintf(fp, "%02x", (*p & 0xff));
+	    fputc(']', fp);
+	}
+	fprintf(fp, " %s\n", e->name);
+	e->saved = 1;
+	cnt++;
     }
+    fclose(fp);
 
-    if (vdp == NULL) {
-	if ((vdp = pmGetOptionalConfig("PCP_VAR_DIR")) == NULL)
-	    return PM_ERR_GENERIC;
-	pmsprintf(filename, sizeof(filename),
-		"%s%c" "config" "%c" "pmda", vdp, sep, sep);
-	if (mkdir2(filename, 0755) < 0) {
-	    /* failure here is not fatal ... dir may already exist */
-	    ;
+    h->nrecord = cnt;
+    h->f_ins_mode = h->ins_mode;
+    h->f_maxinst = h->maxinst;
+    h->f_version = CACHE_VERSION2;
+    h->ntomb = 0;
+    return cnt;
+}
+
+/*
+ * Append only the changes since the last save: removal records for
+ * culled entries, then records for new entries and for entries with
+ * a new timestamp (later records replace earlier ones in load_cache())
+ */
+static int
+append_cache(hdr_t *h)
+{
+    FILE	*fp;
+    entry_t	*e;
+    int		cnt;
+    int		i;
+    int		ntomb;
+    time_t	now;
+
+    ntomb = h->ntomb;
+    for (e = h->first; e != NULL && ntomb == 0; e = e->next) {
+	if (e->state == PMDA_CACHE_EMPTY && e->saved)
+	    ntomb++;
+    }
+    if (ntomb > 0 && h->f_version < CACHE_VERSION3) {
+	/*
+	 * removal records need version 3, and the header version is a
+	 * single digit so it can be changed in place
+	 */
+	if ((fp = fopen(filename, "r+")) == NULL)
+	    return -oserror();
+	if (fgetc(fp) != '0' + CACHE_VERSION2 || fseek(fp, 0L, SEEK_SET) < 0 ||
+	    fputc('0' + CACHE_VERSION3, fp) == EOF) {
+	    fclose(fp);
+	    return write_cache(h);
 	}
+	if (fclose(fp) != 0) {
+	    h->nrecord = -1;
+	    return -oserror();
+	}
+	h->f_version = CACHE_VERSION3;
     }
 
-    pmsprintf(filename, sizeof(filename), "%s%cconfig%cpmda%c%s",
-		vdp, sep, sep, sep,
-		pmInDomStr_r(h->indom, strbuf, sizeof(strbuf)));
-    if ((fp = fopen(filename, "w")) == NULL)
+    if ((fp = fopen(filename, "a")) == NULL)
 	return -oserror();
-    fprintf(fp, "%d %d %d\n", CACHE_VERSION, h->ins_mode, h->maxinst);
+
+    for (i = 0; i < h->ntomb; i++) {
+	fprintf(fp, "-%d\n", h->tomb[i]);
+	h->nrecord++;
+    }
+    h->ntomb = 0;
+    for (e = h->first; e != NULL; e = e->next) {
+	if (e->state == PMDA_CACHE_EMPTY && e->saved) {
+	    fprintf(fp, "-%d\n", e->inst);
+	    e->saved = 0;
+	    h->nrecord++;
+	}
+    }
 
     now = time(NULL);
     cnt = 0;
     for (e = h->first; e != NULL; e = e->next) {
 	if (e->state == PMDA_CACHE_EMPTY)
 	    continue;
+	cnt++;
+	if (e->saved && e->stamp != 0)
+	    continue;
 	if (e->stamp == 0)
 	    e->stamp = now;
 	fprintf(fp, "%d %lld", e->inst, (long long)e->stamp);
 	if (e->keylen > 0) {
 	    char	*p = (char *)e->key;
-	    int		i;
 	    fprintf(fp, " [");
 	    for (i = 0; i < e->keylen; i++, p++)
 		fprintf(fp, "%02x", (*p & 0xff));
 	    fputc(']', fp);
 	}
 	fprintf(fp, " %s\n", e->name);
-	cnt++;
+	e->saved = 1;
+	h->nrecord++;
     }
-    fclose(fp);
+    if (fclose(fp) != 0) {
+	/* partial append, start afresh next time */
+	h->nrecord = -1;
+	return -oserror();
+    }
+    return cnt;
+}
+
+static int
+save_cache(hdr_t *h, int hstate)
+{
+    int		cnt;
+    int		sep = pmPathSeparator();
+    int		state = h->hstate & ~CACHE_STRINGS;
+    char	strbuf[20];
+
+    if ((state & hstate) == 0) {
+	/* nothing to be done */
+	return 0;
+    }
+
+    if (vdp == NULL) {
+	if ((vdp = pmGetOptionalConfig("PCP_VAR_DIR")) == NULL)
+	    return PM_ERR_GENERIC;
+	pmsprintf(filename, sizeof(filename),
+		"%s%c" "config" "%c" "pmda", vdp, sep, sep);
+	if (mkdir2(filename, 0755) < 0) {
+	    /* failure here is not fatal ... dir may already exist */
+	    ;
+	}
+    }
+
+    pmsprintf(filename, sizeof(filename), "%s%cconfig%cpmda%c%s",
+		vdp, sep, sep, sep,
+		pmInDomStr_r(h->indom, strbuf, sizeof(strbuf)));
+
+    if (h->nrecord < 0 ||
+	h->f_ins_mode != h->ins_mode || h->f_maxinst != h->maxinst ||
+	h->nrecord > 2 * (h->nlist - h->nempty) + COMPACT_SLACK)
+	cnt = write_cache(h);
+    else
+	cnt = append_cache(h);
+    if (cnt < 0)
+	return cnt;
     h->hstate &= ~(DIRTY_INSTANCE | DIRTY_STAMP);
 
     if (pmDebugOptions.indom) {
@@ -1040,9 +1309,12 @@ store(pmInDom indom, int flags, const char *name, pmInDom inst, int keylen, cons
 
     switch (flags) {
 	case PMDA_CACHE_ADD:
+	    if (e->key != NULL)
+		free(e->key);
 	    e->keylen = keylen;
 	    if (keylen > 0) {
 		if ((e->key = malloc(keylen)) == NULL) {
+		    e->keylen = 0;
 		    char	strbuf[20];
 		    pmNotifyErr(LOG_ERR, 
 			 "store: indom %s: unable to allocate memory for keylen=%d",
@@ -1065,10 +1337,10 @@ store(pmInDom indom, int flags, const char *name, pmInDom inst, int keylen, cons
 
 	case PMDA_CACHE_CULL:
 	    e->state = PMDA_CACHE_EMPTY;
+	    h->nempty++;
 	    /*
-	     * we don't clean anything up, which may be a problem in the
-	     * presence of lots of culling ... see redo_hash() for how
-	     * the culled entries can be reclaimed
+	     * we don't clean anything up here, see insert_cache() and
+	     * reclaim_cache() for how the culled entries are reclaimed
 	     */
 	    h->hstate |= DIRTY_INSTANCE;	/* entry will not be saved */
 	    break;
@@ -1283,6 +1555,7 @@ int pmdaCacheOp(pmInDom indom, int op)
 		    sts++;
 		}
 	    }
+	    h->nempty += sts;
 	    if (sts > 0)
 		h->hstate |= DIRTY_INSTANCE;	/* entries culled */
 	    return sts;
@@ -1311,7 +1584,7 @@ int pmdaCacheOp(pmInDom indom, int op)
 	    return 0;
 
 	case PMDA_CACHE_REORG:
-	    redo_hash(h, 0);
+	    reclaim_cache(h);
 	    return 0;
 
 	case PMDA_CACHE_WALK_REWIND:
@@ -1463,6 +1736,8 @@ int pmdaCachePurgeCallback(pmInDom indom, time_t recent, void (*callback)(void *
 	 * keep these ones
 	 */
 	if (e->stamp != 0 && e->stamp < epoch) {
+	    if (e->state != PMDA_CACHE_EMPTY)
+		h->nempty++;
 	    e->state = PMDA_CACHE_EMPTY;
 	    if (callback && e->private) {
 	    	(*callback)(e->private);
@@ -291,6 +291,56 @@ pmdaProfile(pmProfile *prof, pmdaExt *pmda)
     return 0;
 }
 
+/*
+ * Is an instance selected by the current profile?  Profiles are sorted
+ * by __pmDecodeProfile, so this is a binary search, not a list scan.
+ */
+int
+pmdaInProfile(pmInDom indom, int inst, pmdaExt *pmda)
+{
+    return __pmInProfile(indom, pmda->e_prof, inst);
+}
+
+/*
+ * Expose the (sorted) instance list of the current profile for indom,
+ * so that a PMDA can visit just the instances a client asked for rather
+ * than testing every instance in a large instance domain.  Returns the
+ * length of the list, with *state set to PM_PROFILE_EXCLUDE if it holds
+ * the only instances wanted, or PM_PROFILE_INCLUDE if it holds the only
+ * instances not wanted.
+ */
+int
+pmdaProfileInstances(pmInDom indom, int *state, int **instlist, pmdaExt *pmda)
+{
+    pmProfile		*prof = pmda->e_prof;
+    pmInDomProfile	*p;
+    int			lo, hi, mid;
+
+    *instlist = NULL;
+    if (prof == NULL) {
+	*state = PM_PROFILE_INCLUDE;
+	return 0;
+    }
+    lo = 0;
+    hi = prof->profile_len - 1;
+    while (lo <= hi) {
+	mid = lo + (hi - lo) / 2;
+	p = &prof->profile[mid];
+	if (p->indom == indom) {
+	    *state = p->state;
+	    *instlist = p->instances;
+	    return p->instances_len;
+	}
+	if (p->indom < indom)
+	    lo = mid + 1;
+	else
+	    hi = mid - 1;
+    }
+    /* no profile for this indom => global default, with no exceptions */
+    *state = prof->state;
+    return 0;
+}
+
 /*
  * Return description of an instance or instance domain
  */
@@ -476,22 +526,30 @@ pmdaInstance(pmInDom indom, int inst, char *name, pmInResult **result, pmdaExt *
  * The first byte of the (unused) timestamp field has been
  * co-opted as a flags byte - now indicating state changes
  * that have happened within a PMDA and that need to later
- * be propogated through to any connected clients.
+ * be propogated through to any connected clients.  With a
+ * label change, the second byte indicates the label levels
+ * affected (PMCD_LABEL_LEVELS shifted down by eight bits).
  */
 
 static void
-__pmdaEncodeStatus(pmResult *result, unsigned char byte)
+__pmdaEncodeStatus(pmResult *result, unsigned int status)
 {
     unsigned char	*flags;
 
     memset(&result->timestamp, 0, sizeof(result->timestamp));
-    if (byte) {
+    if (status) {
 	flags = (unsigned char *)&result->timestamp;
-	*flags |= byte;
+	flags[0] |= (status & 0xff);
+	flags[1] |= ((status & PMCD_LABEL_LEVELS) >> 8);
     }
 }
 
-#define PMDA_STATUS_CHANGE (PMDA_EXT_LABEL_CHANGE|PMDA_EXT_NAMES_CHANGE)
+#define PMDA_LABEL_LEVELS_CHANGE \
+	(PMDA_EXT_DOMAIN_LABEL_CHANGE|PMDA_EXT_INDOM_LABEL_CHANGE| \
+	 PMDA_EXT_CLUSTER_LABEL_CHANGE|PMDA_EXT_ITEM_LABEL_CHANGE| \
+	 PMDA_EXT_INSTANCES_LABEL_CHANGE)
+#define PMDA_STATUS_CHANGE \
+	(PMDA_EXT_LABEL_CHANGE|PMDA_EXT_NAMES_CHANGE|PMDA_LABEL_LEVELS_CHANGE)
 
 /*
  * Resize the pmResult and call the e_callback for each metric instance
@@ -508,7 +566,7 @@ pmdaFetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
     int			inst;
     int			numval;
     int			version;
-    unsigned char	flags;
+    unsigned int	flags;
     pmValueSet		*vset;
     pmValueSet		*tmp_vset;
     pmDesc		*dp;
@@ -536,6 +594,9 @@ pmdaFetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
     if (version >= PMDA_INTERFACE_5)
 	__pmdaSetContext(pmda->e_context);
 
+    if (extp->nrefresh > 0)
+	__pmdaRefreshAcquire(pmda);
+
     if (numpmid > extp->maxnpmids) {
 	if (extp->res != NULL)
 	    free(extp->res);
@@ -549,10 +610,24 @@ pmdaFetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
 
     flags = 0;
     if (version >= PMDA_INTERFACE_7 && (pmda->e_flags & PMDA_STATUS_CHANGE)) {
-	if (pmda->e_flags & PMDA_EXT_LABEL_CHANGE)
+	if (pmda->e_flags & (PMDA_EXT_LABEL_CHANGE|PMDA_LABEL_LEVELS_CHANGE))
 	    flags |= PMCD_LABEL_CHANGE;
 	if (pmda->e_flags & PMDA_EXT_NAMES_CHANGE)
 	    flags |= PMCD_NAMES_CHANGE;
+	/* levels are only reported if all changes were qualified */
+	if ((pmda->e_flags & PMDA_LABEL_LEVELS_CHANGE) &&
+	    !(pmda->e_flags & PMDA_EXT_LABEL_CHANGE)) {
+	    if (pmda->e_flags & PMDA_EXT_DOMAIN_LABEL_CHANGE)
+		flags |= PMCD_DOMAIN_LABEL_CHANGE;
+	    if (pmda->e_flags & PMDA_EXT_INDOM_LABEL_CHANGE)
+		flags |= PMCD_INDOM_LABEL_CHANGE;
+	    if (pmda->e_flags & PMDA_EXT_CLUSTER_LABEL_CHANGE)
+		flags |= PMCD_CLUSTER_LABEL_CHANGE;
+	    if (pmda->e_flags & PMDA_EXT_ITEM_LABEL_CHANGE)
+		flags |= PMCD_ITEM_LABEL_CHANGE;
+	    if (pmda->e_flags & PMDA_EXT_INSTANCES_LABEL_CHANGE)
+		flags |= PMCD_INSTANCES_LABEL_CHANGE;
+	}
 	if (pmDebugOptions.libpmda)
 	    fprintf(stderr, "pmdaFetch flags pmda=0x%x to pmcd=0x%x\n",
 			    pmda->e_flags, (int)flags);
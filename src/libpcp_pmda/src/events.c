@@ -78,10 +78,13 @@ event_array(void)
 	    return -oserror();
 	}
 	bufs = tmp_bufs;
+	bufs[i].baddr = NULL;
+	bufs[i].blen = 0;
     }
 
-    bufs[i].bptr = bufs[i].baddr = NULL;
-    bufs[i].blen = 0;
+    /* a released array's buffer (if any) is reused as is */
+    bufs[i].bptr = bufs[i].baddr;
+    bufs[i].berp = bufs[i].baddr;
     bufs[i].bstate = B_INUSE;
     return i;
 }
@@ -152,7 +155,7 @@ pmdaEventReleaseArray(int idx)
     if (idx < 0 || idx >= nbuf || bufs[idx].bstate == B_FREE)
 	return PM_ERR_NOCONTEXT;
 
-    free(bufs[idx].baddr);
+    /* keep the buffer, for the next new array to reuse */
     bufs[idx].bstate = B_FREE;
     return 0;
 }
@@ -23,6 +23,7 @@
 #define HAVE_ANY(interface)	((interface) <= PMDA_INTERFACE_7 && HAVE_V_TWO(interface))
 
 struct dynamic;
+struct refresh;
 
 /*
  * Auxilliary structure used to save data from pmdaDSO or pmdaDaemon and
@@ -37,8 +38,15 @@ typedef struct {
     int			ndynamics;	/* number of dynamics entries, below */
     struct dynamic	*dynamics;	/* dynamic metric manipulation table */
     void		*privdata;	/* private (user) data for this PMDA */
+    int			nrefresh;	/* number of refresh entries, below */
+    struct refresh	**refresh;	/* background refresh per cluster */
 } e_ext_t;
 
+/*
+ * Swap in the latest background refresh snapshots (refresh.c)
+ */
+extern void __pmdaRefreshAcquire(pmdaExt *);
+
 /*
  * Local hash function
  */
@@ -783,17 +783,21 @@ pmdaInit(pmdaInterface *dispatch, pmdaIndom *indoms, int nindoms,
  */
 
 static int
-__pmdaSetupPDU(int infd, int outfd, int flags, const char *agentname)
+__pmdaSetupPDU(int infd, int outfd, int flags, int shmfd, const char *agentname)
 {
     __pmVersionCred	handshake;
+    __pmVersionCred	*vcp;
     __pmCred		*credlist = NULL;
     __pmPDU		*pb;
     int			i, sts, pinpdu, vflag = 0;
     int			version = UNKNOWN_VERSION, credcount = 0, sender = 0;
+    int			ackflags = 0;
 
     handshake.c_type = CVERSION;
     handshake.c_version = PDU_VERSION;
     handshake.c_flags = flags;
+    if (shmfd >= 0)
+	handshake.c_flags |= PDU_FLAG_SHM;
     if ((sts = __pmSendCreds(outfd, (int)getpid(), 1, (__pmCred *)&handshake)) < 0) {
 	pmNotifyErr(LOG_CRIT, "__pmdaSetupPDU: PMDA %s send creds: %s", agentname, pmErrStr(sts));
 	return -1;
@@ -814,7 +818,9 @@ __pmdaSetupPDU(int infd, int outfd, int flags, const char *agentname)
 	for (i = 0; i < credcount; i++) {
 	    switch (credlist[i].c_type) {
 	    case CVERSION:
-		version = credlist[i].c_vala;
+		vcp = (__pmVersionCred *)&credlist[i];
+		version = vcp->c_version;
+		ackflags = vcp->c_flags;
 		vflag = 1;
 		break;
 	    default:
@@ -825,6 +831,15 @@ __pmdaSetupPDU(int infd, int outfd, int flags, const char *agentname)
 	    __pmSetVersionIPC(infd, version);
 	    __pmSetVersionIPC(outfd, version);
 	}
+	/* pmcd has agreed to read large PDUs from the shared memory ring */
+	if (vflag && shmfd >= 0 && (ackflags & PDU_FLAG_SHM)) {
+	    if ((sts = __pmSetShmIPC(outfd, shmfd, PDU_SHM_XMIT)) < 0)
+		pmNotifyErr(LOG_WARNING, "__pmdaSetupPDU: PMDA %s: shared memory ring: %s",
+			agentname, pmErrStr(sts));
+	    else if (pmDebugOptions.libpmda)
+		pmNotifyErr(LOG_DEBUG, "__pmdaSetupPDU: PMDA %s: using shared memory ring",
+			agentname);
+	}
 	if (credlist != NULL)
 	    free(credlist);
     }
@@ -851,6 +866,8 @@ pmdaConnect(pmdaInterface *dispatch)
 {
     pmdaExt	*pmda = NULL;
     int		sts, flags = dispatch->comm.flags;
+    int		shmfd = -1;
+    char	*env;
 
     if (dispatch->version.any.ext == NULL ||
 	(dispatch->version.any.ext->e_flags & PMDA_EXT_SETUPDONE) != PMDA_EXT_SETUPDONE) {
@@ -879,6 +896,12 @@ pmdaConnect(pmdaInterface *dispatch)
 
 	    pmda->e_infd = fileno(stdin);
 	    pmda->e_outfd = fileno(stdout);
+
+	    /* pmcd passes a shared memory ring to PMDAs of type "shm" */
+	    if ((env = getenv("PCP_PMDA_SHMFD")) != NULL) {
+		shmfd = atoi(env);
+		unsetenv("PCP_PMDA_SHMFD");
+	    }
 #ifdef IS_MINGW
 	    /* do not muck with \n in the PDU stream */
 	    _setmode(pmda->e_infd, _O_BINARY);
@@ -930,7 +953,9 @@ pmdaConnect(pmdaInterface *dispatch)
 	    exit(1);
     }
 
-    sts = __pmdaSetupPDU(pmda->e_infd, pmda->e_outfd, flags, pmda->e_name);
+    sts = __pmdaSetupPDU(pmda->e_infd, pmda->e_outfd, flags, shmfd, pmda->e_name);
+    if (shmfd >= 0)
+	close(shmfd);
     if (sts < 0)
 	dispatch->status = sts;
     else {
@@ -1,7 +1,7 @@
 /*
  * Generic event queue support for PMDAs
  *
- * Copyright (c) 2011,2015-2016 Red Hat.
+ * Copyright (c) 2011,2015-2016,2026 Red Hat.
  * Copyright (c) 2011 Nathan Scott.  All rights reserved.
  * 
  * This library is free software; you can redistribute it and/or modify it
@@ -27,8 +27,27 @@ static event_client_t *clients;
 static int numclients;
 static event_client_t *client_lookup(int context);
 
-typedef void (*clientVisitCallBack)(event_clientq_t *, event_queue_t *, void *);
-static void client_iterate(clientVisitCallBack, int, event_queue_t *, void *);
+/* records are padded so the next header is aligned */
+#define REC_ALIGN	sizeof(double)
+#define REC_SIZE(n)	((sizeof(event_hdr_t) + (n) + REC_ALIGN - 1) & ~(REC_ALIGN - 1))
+
+/* is virtual offset a before b? */
+#define BEFORE(a, b)	((ptrdiff_t)((a) - (b)) < 0)
+
+/*
+ * Consumer view of the producer side of a queue, see queue_snapshot()
+ */
+typedef struct {
+    char		*ring;
+    size_t		ringsize;
+    size_t		head;
+    size_t		tail;
+    __uint32_t		headseq;
+    __uint32_t		tailseq;
+    size_t		qsize;
+    __uint32_t		count;
+    __uint64_t		bytes;
+} queue_snap_t;
 
 static event_queue_t *
 queue_lookup(int handle)
@@ -44,50 +63,105 @@ queue_lookup(int handle)
 }
 
 /*
- * Drop an event after it has been queued (i.e. client was too slow)
+ * Copy to or from the ring at a virtual offset, wrapping around the
+ * end of the ring as needed
  */
 static void
-queue_drop(event_clientq_t *clientq, event_queue_t *queue, void *data)
+ring_read(char *ring, size_t ringsize, size_t offset, void *buffer, size_t bytes)
 {
-    event_t *event = (event_t *)data;
-
-    if (clientq->last != NULL && clientq->last == event) {
-	clientq->last = TAILQ_NEXT(event, events);
-	clientq->missed++;
+    size_t	start = offset % ringsize;
+    size_t	part = ringsize - start;
+
+    if (bytes <= part)
+	memcpy(buffer, ring + start, bytes);
+    else {
+	memcpy(buffer, ring + start, part);
+	memcpy((char *)buffer + part, ring, bytes - part);
+    }
+}
 
-	if (pmDebugOptions.libpmda)
-	    pmNotifyErr(LOG_DEBUG, "Client missed queue %s event %p",
-			queue->name, event);
+static void
+ring_write(event_queue_t *queue, size_t offset, const void *buffer, size_t bytes)
+{
+    size_t	start = offset % queue->ringsize;
+    size_t	part = queue->ringsize - start;
+
+    if (bytes <= part)
+	memcpy(queue->ring + start, buffer, bytes);
+    else {
+	memcpy(queue->ring + start, buffer, part);
+	memcpy(queue->ring, (const char *)buffer + part, bytes - part);
     }
 }
 
+/*
+ * Producer side updates are bracketed by these, making the generation
+ * count odd while the update is in progress
+ */
 static void
-queue_drop_bytes(int handle, event_queue_t *queue, size_t bytes)
+queue_update_begin(event_queue_t *queue)
 {
-    event_t *event, *next;
+    __atomic_store_n(&queue->gen, queue->gen + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
 
-    event = TAILQ_FIRST(&queue->tailq);
-    while (event) {
-	if (bytes <= queue->maxmemory - queue->qsize)
+static void
+queue_update_end(event_queue_t *queue)
+{
+    __atomic_store_n(&queue->gen, queue->gen + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Consistent copy of the producer side of a queue, retrying if the
+ * producer is part way through an update
+ */
+static void
+queue_snapshot(event_queue_t *queue, queue_snap_t *snap)
+{
+    unsigned int	gen;
+
+    for (;;) {
+	gen = __atomic_load_n(&queue->gen, __ATOMIC_ACQUIRE);
+	if (gen & 1)
+	    continue;
+	snap->ring = __atomic_load_n(&queue->ring, __ATOMIC_RELAXED);
+	snap->ringsize = __atomic_load_n(&queue->ringsize, __ATOMIC_RELAXED);
+	snap->head = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+	snap->tail = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+	snap->headseq = __atomic_load_n(&queue->headseq, __ATOMIC_RELAXED);
+	snap->tailseq = __atomic_load_n(&queue->tailseq, __ATOMIC_RELAXED);
+	snap->qsize = __atomic_load_n(&queue->qsize, __ATOMIC_RELAXED);
+	snap->count = __atomic_load_n(&queue->count, __ATOMIC_RELAXED);
+	snap->bytes = queue->bytes;	/* may tear, checked below */
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if (__atomic_load_n(&queue->gen, __ATOMIC_RELAXED) == gen)
 	    break;
-	next = TAILQ_NEXT(event, events);
+    }
+}
 
-	if (pmDebugOptions.libpmda)
-	    pmNotifyErr(LOG_DEBUG, "Dropping %s: e=%p sz=%d max=%d qsz=%d",
-				    queue->name, event, (int)event->size,
-				    (int)queue->maxmemory, (int)queue->qsize);
+/*
+ * Drop events from the tail of the queue (oldest first) to make room
+ * for another, of bytes data and need bytes in the ring.  Clients that
+ * had not seen these events find out at their next fetch.
+ */
+static void
+queue_drop_bytes(event_queue_t *queue, size_t bytes, size_t need)
+{
+    event_hdr_t hdr;
 
-	/* Walk clients - if event last seen, drop it and bump missed count */
-	client_iterate(queue_drop, handle, queue, event);
+    while (queue->head != queue->tail &&
+	   (queue->qsize + bytes > queue->maxmemory ||
+	    queue->head - queue->tail + need > queue->ringsize)) {
+	ring_read(queue->ring, queue->ringsize, queue->tail, &hdr, sizeof(hdr));
 
 	if (pmDebugOptions.libpmda)
-	    pmNotifyErr(LOG_DEBUG, "Removing %s event %p (%d bytes)",
-				    queue->name, event, (int)event->size);
+	    pmNotifyErr(LOG_DEBUG, "Dropping %s: seq=%u sz=%d max=%d qsz=%d",
+				    queue->name, queue->tailseq, (int)hdr.size,
+				    (int)queue->maxmemory, (int)queue->qsize);
 
-	TAILQ_REMOVE(&queue->tailq, event, events);
-	queue->qsize -= event->size;
-	free(event);
-	event = next;
+	__atomic_store_n(&queue->tail, queue->tail + REC_SIZE(hdr.size), __ATOMIC_RELAXED);
+	__atomic_store_n(&queue->tailseq, queue->tailseq + 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&queue->qsize, queue->qsize - hdr.size, __ATOMIC_RELAXED);
     }
 }
 
@@ -110,27 +184,20 @@ pmdaEventNewActiveQueue(const char *name, size_t maxmemory, unsigned int nclient
 	    break;
     if (i == numqueues) {
 	/*
-	 * No free slots - extend the available set.
-	  realloc potentially moves "queues" address, fix up 
-	 * must tear down existing queues which may have back
-	 * references and then re-initialise them afterward.
+	 * No free slots - extend the available set.  Nothing points
+	 * into the queues array, so realloc moving it is fine (but
+	 * not while another thread is appending to any queue).
 	 */
-	for (i = 0; i < numqueues; i++)
-	    queue_drop_bytes(i, &queues[i], INT_MAX);
 	size = (numqueues + 1) * sizeof(event_queue_t);
 	queues = realloc(queues, size);
 	if (!queues)
 	    pmNoMem("pmdaEventNewQueue", size, PM_FATAL_ERR);
-	/* realloc moves tailq tqh_last pointer - reset 'em */
-	for (i = 0; i < numqueues; i++)
-	    TAILQ_INIT(&queues[i].tailq);
 	numqueues++;
     }
 
     /* "i" now indexes into a free slot */
     queue = &queues[i];
     memset(queue, 0, sizeof(*queue));
-    TAILQ_INIT(&queue->tailq); 
     queue->eventarray = pmdaEventNewArray();
     queue->numclients = nclients;
     queue->maxmemory = maxmemory;
@@ -160,10 +227,12 @@ int
 pmdaEventQueueCounter(int handle, pmAtomValue *atom)
 {
     event_queue_t *queue = queue_lookup(handle);
+    queue_snap_t snap;
 
     if (!queue)
 	return -EINVAL;
-    atom->ul = queue->count;
+    queue_snapshot(queue, &snap);
+    atom->ul = snap.count;
     return PMDA_FETCH_STATIC;
 }
 
@@ -182,10 +251,12 @@ int
 pmdaEventQueueMemory(int handle, pmAtomValue *atom)
 {
     event_queue_t *queue = queue_lookup(handle);
+    queue_snap_t snap;
 
     if (!queue)
 	return -EINVAL;
-    atom->ull = queue->qsize;
+    queue_snapshot(queue, &snap);
+    atom->ull = snap.qsize;
     return PMDA_FETCH_STATIC;
 }
 
@@ -193,18 +264,37 @@ int
 pmdaEventQueueBytes(int handle, pmAtomValue *atom)
 {
     event_queue_t *queue = queue_lookup(handle);
+    queue_snap_t snap;
 
     if (!queue)
 	return -EINVAL;
-    atom->ull = queue->bytes;
+    queue_snapshot(queue, &snap);
+    atom->ull = snap.bytes;
     return PMDA_FETCH_STATIC;
 }
 
+int
+pmdaEventQueueDropped(int handle, pmAtomValue *atom)
+{
+    event_queue_t *queue = queue_lookup(handle);
+
+    if (!queue)
+	return -EINVAL;
+    atom->ull = queue->dropped;
+    return PMDA_FETCH_STATIC;
+}
+
+/*
+ * Called by the producer (only), which need not be the PMDA main loop
+ * thread - no locks are taken, see queues.h
+ */
 int
 pmdaEventQueueAppend(int handle, void *data, size_t bytes, struct timeval *tv)
 {
     event_queue_t *queue = queue_lookup(handle);
-    event_t *event;
+    event_hdr_t hdr;
+    size_t need = REC_SIZE(bytes);
+    char *ring = NULL;
 
     if (!queue)
 	return -EINVAL;
@@ -214,44 +304,60 @@ pmdaEventQueueAppend(int handle, void *data, size_t bytes, struct timeval *tv)
     if (bytes > queue->maxmemory) {
 	pmNotifyErr(LOG_WARNING, "Event too large for queue %s (%ld > %ld)",
 			queue->name, (long)bytes, (long)queue->maxmemory);
-	goto done;
+	need = 0;
     }
+    else if (__atomic_load_n(&queue->numclients, __ATOMIC_ACQUIRE) == 0)
+	need = 0;
+    else if (queue->ring == NULL) {
+	/*
+	 * First event with clients, allocate the ring - twice maxmemory
+	 * (plus a header), so the record headers do not normally limit
+	 * the data that can be queued.
+	 */
+	size_t ringsize = 2 * REC_SIZE(queue->maxmemory);
 
-    /*
-     * We may need to make room in the event queue.  If so, start at the head
-     * and madly drop events until sufficient space exists or all are freed.
-     * Bump the missed counter for each client who missed an event we had to
-     * throw away.
-     */
-    queue_drop_bytes(handle, queue, bytes);
-    if (queue->numclients == 0)
-	goto done;
-
-    if ((event = malloc(sizeof(event_t) + bytes + 1)) == NULL) {
-	pmNotifyErr(LOG_ERR, "event allocation failure: %ld bytes",
-			(long)(bytes + 1));
-	return -ENOMEM;
+	if ((ring = malloc(ringsize)) == NULL) {
+	    pmNotifyErr(LOG_ERR, "event queue allocation failure: %ld bytes",
+			(long)ringsize);
+	    return -ENOMEM;
+	}
+	queue_update_begin(queue);
+	__atomic_store_n(&queue->ring, ring, __ATOMIC_RELAXED);
+	__atomic_store_n(&queue->ringsize, ringsize, __ATOMIC_RELAXED);
+	queue_update_end(queue);
     }
 
-    /* Track the actual event data */
-    event->count = queue->numclients;
-    memcpy(event->buffer, data, bytes);
-    memcpy(&event->time, tv, sizeof(*tv));
-    event->size = bytes;
-
-    /* Finally, store the event in the queue */
-    TAILQ_INSERT_TAIL(&queue->tailq, event, events);
-    queue->qsize += bytes;
+    queue_update_begin(queue);
+    if (need > 0) {
+	/*
+	 * We may need to make room in the event queue.  If so, start at
+	 * the tail and drop events until sufficient space exists.  The
+	 * new tail is made visible before the space is reused.
+	 */
+	queue_drop_bytes(queue, bytes, need);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	/* Finally, store the event in the queue */
+	hdr.size = bytes;
+	memcpy(&hdr.time, tv, sizeof(hdr.time));
+	ring_write(queue, queue->head, &hdr, sizeof(hdr));
+	if (bytes > 0)
+	    ring_write(queue, queue->head + sizeof(hdr), data, bytes);
+	__atomic_store_n(&queue->head, queue->head + need, __ATOMIC_RELAXED);
+	__atomic_store_n(&queue->headseq, queue->headseq + 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&queue->qsize, queue->qsize + bytes, __ATOMIC_RELAXED);
 
-    if (pmDebugOptions.libpmda)
-	pmNotifyErr(LOG_DEBUG,
-			"Inserted %s event %p (%ld bytes) clients = %d",
-			queue->name, event, (long)event->size, event->count);
+	if (pmDebugOptions.libpmda)
+	    pmNotifyErr(LOG_DEBUG,
+			"Inserted %s event %u (%ld bytes) clients = %d",
+			queue->name, queue->headseq - 1, (long)bytes,
+			queue->numclients);
+    }
 
-done:
     /* Update event queue tracking stats (even for no-clients case) */
     queue->bytes += bytes;
-    queue->count++;
+    __atomic_store_n(&queue->count, queue->count + 1, __ATOMIC_RELAXED);
+    queue_update_end(queue);
     return 0;
 }
 
@@ -273,91 +379,127 @@ queue_filter(event_clientq_t *clientq, void *data, size_t size)
     return 0;
 }
 
+/*
+ * Copy the event at the client cursor out of the ring into the queue
+ * scratch buffer.  Returns zero if the producer dropped the event from
+ * the ring before (or while) it was copied.
+ */
+static int
+queue_copy(event_queue_t *queue, event_clientq_t *clientq,
+		queue_snap_t *snap, event_hdr_t *hdr)
+{
+    size_t	size;
+    char	*scratch;
+
+    ring_read(snap->ring, snap->ringsize, clientq->cursor, hdr, sizeof(*hdr));
+    if (hdr->size <= queue->maxmemory) {
+	if (hdr->size + 1 > queue->scratchsize) {
+	    size = hdr->size + 1;
+	    if ((scratch = realloc(queue->scratch, size)) == NULL)
+		pmNoMem("queue_copy", size, PM_FATAL_ERR);
+	    queue->scratch = scratch;
+	    queue->scratchsize = size;
+	}
+	ring_read(snap->ring, snap->ringsize, clientq->cursor + sizeof(*hdr),
+			queue->scratch, hdr->size);
+	queue->scratch[hdr->size] = '\0';
+    }
+
+    /* only now is it known whether the copy can be trusted */
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    queue_snapshot(queue, snap);
+    if (BEFORE(clientq->cursor, snap->tail))
+	return 0;
+    if (hdr->size > queue->maxmemory) {
+	pmNotifyErr(LOG_ERR, "queue %s corrupt at event %u (%ld bytes)",
+			queue->name, clientq->seq, (long)hdr->size);
+	return 0;
+    }
+    return 1;
+}
+
 static int
 queue_fetch(event_queue_t *queue, event_clientq_t *clientq, pmAtomValue *atom,
 	    pmdaEventDecodeCallBack queue_decoder, void *data)
 {
-    event_t *event, *next;
+    queue_snap_t snap;
+    event_hdr_t hdr;
+    size_t end;
     int records, key, sts;
 
+    queue_snapshot(queue, &snap);
+
     /*
      * Ensure the way we keep track of which clients are interested
-     * in which queues is up to date.
+     * in which queues is up to date.  A new client starts with the
+     * next event appended.
      */
     if (clientq->active == 0) {
 	clientq->active = 1;
-	queue->numclients++;
+	clientq->cursor = snap.head;
+	clientq->seq = snap.headseq;
+	__atomic_store_n(&queue->numclients, queue->numclients + 1,
+			__ATOMIC_RELEASE);
     }
-    if (clientq->last == NULL)
-	clientq->last = TAILQ_FIRST(&queue->tailq);
-    event = clientq->last;
 
     if (pmDebugOptions.libpmda)
-	pmNotifyErr(LOG_DEBUG, "queue_fetch start, last event=%p", event);
+	pmNotifyErr(LOG_DEBUG, "queue_fetch start, seq=%u head=%u",
+			clientq->seq, snap.headseq);
 
     sts = records = 0;
     key = queue->eventarray;
     pmdaEventResetArray(key);
 
-    while (event != NULL) {
+    /* events appended from here on are left for the next fetch */
+    end = snap.head;
+    while (BEFORE(clientq->cursor, end)) {
 	char	message[64];
 
-	if (queue_filter(clientq, event->buffer, event->size)) {
+	/*
+	 * Events this client had not yet seen may have been dropped
+	 * from the tail of the ring, to make room for newer events.
+	 */
+	if (BEFORE(clientq->cursor, snap.tail) ||
+	    !queue_copy(queue, clientq, &snap, &hdr)) {
+	    clientq->missed += snap.tailseq - clientq->seq;
+	    clientq->cursor = snap.tail;
+	    clientq->seq = snap.tailseq;
+	    continue;
+	}
+	clientq->cursor += REC_SIZE(hdr.size);
+	clientq->seq++;
+
+	if (queue_filter(clientq, queue->scratch, hdr.size)) {
 	    if (pmDebugOptions.libpmda)
 		pmNotifyErr(LOG_DEBUG, "Culling event (sz=%ld): \"%s\"", 
-				(long)event->size,
-				__pmdaEventPrint(event->buffer, event->size,
+				(long)hdr.size,
+				__pmdaEventPrint(queue->scratch, hdr.size,
 					message, sizeof(message)));
 	} else {
 	    if (pmDebugOptions.libpmda)
 		pmNotifyErr(LOG_DEBUG, "Adding event (sz=%ld): \"%s\"", 
-				(long)event->size,
-				__pmdaEventPrint(event->buffer, event->size,
+				(long)hdr.size,
+				__pmdaEventPrint(queue->scratch, hdr.size,
 					message, sizeof(message)));
 	    if ((sts = queue_decoder(key,
-			event->buffer, event->size, &event->time, data)) < 0)
+			queue->scratch, hdr.size, &hdr.time, data)) < 0)
 		break;
 	    records += sts;
 	    sts = 0;
 	}
-
-	next = TAILQ_NEXT(event, events);
-
-	/* Remove the current one (if its use count hits zero) */
-	if (--event->count <= 0) {
-	    if (pmDebugOptions.libpmda)
-		pmNotifyErr(LOG_DEBUG, "Removing %s event %p in fetch",
-					queue->name, event);
-	    TAILQ_REMOVE(&queue->tailq, event, events);
-	    queue->qsize -= event->size;
-	    free(event);
-	}
-
-	/* Go on to the next event. */
-	event = next;
     }
 
-    /*
-     * Did this client miss any events?  The "extra" one is the last previously
-     * observed event (pointed at by per-context last pointer) - so, event only
-     * missed once we move past *more* than just that last observed event.
-     */
-    if (sts == 0) {
-	sts = clientq->missed - 1;
+    /* Did this client miss any events? */
+    if (sts == 0 && clientq->missed > 0) {
+	struct timeval timestamp;
+
+	queue->dropped += clientq->missed;
+	gettimeofday(&timestamp, NULL);
+	sts = pmdaEventAddMissedRecord(key, &timestamp, clientq->missed);
 	clientq->missed = 0;
-	if (sts > 0) {
-	    struct timeval timestamp;
-	    gettimeofday(&timestamp, NULL);
-	    sts = pmdaEventAddMissedRecord(key, &timestamp, sts);
-	    records++;
-	} else {
-	    sts = 0;
-	}
+	records++;
     }
 
-    /* Update queue tail pointer for this client. */
-    clientq->last = NULL;
-
     atom->vbp = records ? (pmValueBlock *)pmdaEventGetAddr(key) : NULL;
     return sts;
 }
@@ -417,18 +559,20 @@ queue_release(event_queue_t *queue)
 {
     /* free resources and mark as no longer inuse */
     pmdaEventReleaseArray(queue->eventarray);
+    free(queue->ring);
+    free(queue->scratch);
     memset(queue, 0, sizeof(*queue));
 }
 
 /*
  * We've lost a client (disconnected).
- * Cleanup any filter and any back references across the queues.
+ * Cleanup any filter and the client count for the queue - there are
+ * no references to the events in the ring to drop.
  */
 static void
 queue_cleanup(int handle, event_clientq_t *clientq)
 {
     event_queue_t *queue = queue_lookup(handle);
-    event_t *event, *next;
 
     if (clientq->release)
 	clientq->release(clientq->filter);
@@ -440,23 +584,9 @@ queue_cleanup(int handle, event_clientq_t *clientq)
 	pmNotifyErr(LOG_DEBUG, "queue_cleanup: %s numclients=%d",
 			queue->name, queue->numclients);
 
-    event = clientq->last;
-    while (event) {
-	next = TAILQ_NEXT(event, events);
-
-	/* Remove the current event (if use count hits zero) */
-	if (--event->count <= 0) {
-	    if (pmDebugOptions.libpmda)
-		pmNotifyErr(LOG_DEBUG, "Removing %s event %p",
-				queue->name, event);
-	    TAILQ_REMOVE(&queue->tailq, event, events);
-	    queue->qsize -= event->size;
-	    free(event);
-	}
-	event = next;
-    }
-
-    if (--queue->numclients <= 0) {
+    __atomic_store_n(&queue->numclients, queue->numclients - 1,
+			__ATOMIC_RELEASE);
+    if (queue->numclients <= 0) {
 	if (pmDebugOptions.libpmda)
 	    pmNotifyErr(LOG_DEBUG, "queue_cleanup: %s final shutdown=%d",
 			    queue->name, queue->shutdown);
@@ -551,25 +681,6 @@ client_lookup(int context)
     return NULL;
 }
 
-/*
- * Visit each active context and run a supplied callback routine
- */
-static void
-client_iterate(clientVisitCallBack visit,
-		int handle, event_queue_t *queue, void *data)
-{
-    event_clientq_t *clientq;
-    int i;
-
-    for (i = 0; i < numclients; i++) {
-	if (!clients[i].inuse)
-	    continue;
-	clientq = client_queue_lookup(clients[i].context, handle, 0);
-	if (clientq && clientq->active)
-	    visit(clientq, queue, data);
-    }
-}
-
 int
 pmdaEventEndClient(int context)
 {
@@ -0,0 +1,261 @@
+/*
+ * Background refresh of per-cluster PMDA snapshots.
+ *
+ * Copyright (c) 2019 Red Hat.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+
+#include "pmapi.h"
+#include "libpcp.h"
+#include "pmda.h"
+#include "libdefs.h"
+
+#ifdef PM_MULTI_THREAD
+
+/*
+ * Each registered cluster owns three buffers.  The refresh thread
+ * fills "back", then swaps it with "latest" and raises "fresh".
+ * The fetch side holds "front" and, at the start of each fetch,
+ * swaps it with "latest" if "fresh" is set.  The lock only covers
+ * those index swaps, so a fetch never waits for a refresh to run.
+ */
+typedef struct refresh {
+    int			cluster;
+    struct timeval	interval;
+    pmdaRefreshCallBack	callback;
+    void		*arg;
+    void		*buf[3];
+    int			sts[3];		/* callback status for each buffer */
+    int			front;		/* owned by the fetch side */
+    int			back;		/* owned by the refresh thread */
+    int			latest;		/* most recently completed refresh */
+    int			fresh;		/* latest is newer than front */
+    int			done;		/* refresh thread should exit */
+    pthread_t		thread;
+    pthread_mutex_t	lock;
+    pthread_cond_t	wakeup;
+} refresh_t;
+
+static void *
+refresh_thread(void *arg)
+{
+    refresh_t		*rp = (refresh_t *)arg;
+    struct timeval	now;
+    struct timespec	deadline;
+    int			sts;
+    int			tmp;
+
+    for (;;) {
+	sts = rp->callback(rp->cluster, rp->buf[rp->back], rp->arg);
+
+	pthread_mutex_lock(&rp->lock);
+	rp->sts[rp->back] = sts;
+	tmp = rp->latest;
+	rp->latest = rp->back;
+	rp->back = tmp;
+	rp->fresh = 1;
+
+	pmtimevalNow(&now);
+	pmtimevalInc(&now, &rp->interval);
+	deadline.tv_sec = now.tv_sec;
+	deadline.tv_nsec = now.tv_usec * 1000;
+	while (!rp->done) {
+	    if (pthread_cond_timedwait(&rp->wakeup, &rp->lock, &deadline) != 0)
+		break;
+	}
+	if (rp->done) {
+	    pthread_mutex_unlock(&rp->lock);
+	    break;
+	}
+	pthread_mutex_unlock(&rp->lock);
+    }
+    return NULL;
+}
+
+static refresh_t *
+refresh_lookup(e_ext_t *extp, int cluster)
+{
+    int		i;
+
+    for (i = 0; i < extp->nrefresh; i++) {
+	if (extp->refresh[i]->cluster == cluster)
+	    return extp->refresh[i];
+    }
+    return NULL;
+}
+
+static void
+refresh_free(refresh_t *rp)
+{
+    int		i;
+
+    for (i = 0; i < 3; i++)
+	free(rp->buf[i]);
+    pthread_cond_destroy(&rp->wakeup);
+    pthread_mutex_destroy(&rp->lock);
+    free(rp);
+}
+
+int
+pmdaRefreshRegister(pmdaInterface *dispatch, int cluster,
+		const struct timeval *interval, size_t size,
+		pmdaRefreshCallBack callback, void *arg)
+{
+    e_ext_t		*extp = (e_ext_t *)dispatch->version.any.ext->e_ext;
+    refresh_t		*rp;
+    refresh_t		**tmp;
+    int			i;
+    int			sts;
+
+    if (callback == NULL || size == 0 ||
+	interval == NULL || (interval->tv_sec == 0 && interval->tv_usec == 0))
+	return -EINVAL;
+    if (refresh_lookup(extp, cluster) != NULL)
+	return -EEXIST;
+
+    if ((rp = (refresh_t *)calloc(1, sizeof(*rp))) == NULL)
+	return -oserror();
+    for (i = 0; i < 3; i++) {
+	if ((rp->buf[i] = calloc(1, size)) == NULL) {
+	    sts = -oserror();
+	    while (--i >= 0)
+		free(rp->buf[i]);
+	    free(rp);
+	    return sts;
+	}
+    }
+    rp->cluster = cluster;
+    rp->interval = *interval;
+    rp->callback = callback;
+    rp->arg = arg;
+    rp->front = 0;
+    rp->back = 1;
+    rp->latest = 2;
+    pthread_mutex_init(&rp->lock, NULL);
+    pthread_cond_init(&rp->wakeup, NULL);
+
+    /* first snapshot is built here, so it is ready for the first fetch */
+    rp->sts[rp->front] = callback(cluster, rp->buf[rp->front], arg);
+
+    tmp = (refresh_t **)realloc(extp->refresh,
+				(extp->nrefresh + 1) * sizeof(refresh_t *));
+    if (tmp == NULL) {
+	sts = -oserror();
+	refresh_free(rp);
+	return sts;
+    }
+    extp->refresh = tmp;
+
+    if ((sts = pthread_create(&rp->thread, NULL, refresh_thread, rp)) != 0) {
+	pmNotifyErr(LOG_ERR, "pmdaRefreshRegister: cluster %d thread: %s",
+		    cluster, pmErrStr(-sts));
+	refresh_free(rp);
+	return -sts;
+    }
+    extp->refresh[extp->nrefresh++] = rp;
+
+    if (pmDebugOptions.libpmda)
+	fprintf(stderr, "pmdaRefreshRegister: cluster %d every %.6f sec\n",
+		cluster, pmtimevalToReal(interval));
+    return 0;
+}
+
+int
+pmdaRefreshSnapshot(pmdaInterface *dispatch, int cluster, void **snapshot)
+{
+    e_ext_t		*extp = (e_ext_t *)dispatch->version.any.ext->e_ext;
+    refresh_t		*rp;
+
+    if ((rp = refresh_lookup(extp, cluster)) == NULL)
+	return -ENOENT;
+    *snapshot = rp->buf[rp->front];
+    return rp->sts[rp->front];
+}
+
+/*
+ * Called at the start of each fetch, so that every metric in the
+ * one fetch sees the same snapshot for any given cluster.
+ */
+void
+__pmdaRefreshAcquire(pmdaExt *pmda)
+{
+    e_ext_t		*extp = (e_ext_t *)pmda->e_ext;
+    refresh_t		*rp;
+    int			i;
+    int			tmp;
+
+    for (i = 0; i < extp->nrefresh; i++) {
+	rp = extp->refresh[i];
+	pthread_mutex_lock(&rp->lock);
+	if (rp->fresh) {
+	    tmp = rp->front;
+	    rp->front = rp->latest;
+	    rp->latest = tmp;
+	    rp->fresh = 0;
+	}
+	pthread_mutex_unlock(&rp->lock);
+    }
+}
+
+void
+pmdaRefreshStop(pmdaInterface *dispatch)
+{
+    e_ext_t		*extp = (e_ext_t *)dispatch->version.any.ext->e_ext;
+    refresh_t		*rp;
+    int			i;
+
+    for (i = 0; i < extp->nrefresh; i++) {
+	rp = extp->refresh[i];
+	pthread_mutex_lock(&rp->lock);
+	rp->done = 1;
+	pthread_cond_signal(&rp->wakeup);
+	pthread_mutex_unlock(&rp->lock);
+	pthread_join(rp->thread, NULL);
+	refresh_free(rp);
+    }
+    free(extp->refresh);
+    extp->refresh = NULL;
+    extp->nrefresh = 0;
+}
+
+#else /* !PM_MULTI_THREAD */
+
+int
+pmdaRefreshRegister(pmdaInterface *dispatch, int cluster,
+		const struct timeval *interval, size_t size,
+		pmdaRefreshCallBack callback, void *arg)
+{
+    (void)dispatch; (void)cluster; (void)interval;
+    (void)size; (void)callback; (void)arg;
+    return PM_ERR_NYI;
+}
+
+int
+pmdaRefreshSnapshot(pmdaInterface *dispatch, int cluster, void **snapshot)
+{
+    (void)dispatch; (void)cluster; (void)snapshot;
+    return -ENOENT;
+}
+
+void
+__pmdaRefreshAcquire(pmdaExt *pmda)
+{
+    (void)pmda;
+}
+
+void
+pmdaRefreshStop(pmdaInterface *dispatch)
+{
+    (void)dispatch;
+}
+
+#endif /* PM_MULTI_THREAD */
@@ -0,0 +1,379 @@
+/*
+ * Name mappings shared between PMDAs through a memory-mapped file.
+ *
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+
+#include "pmapi.h"
+#include "libpcp.h"
+#include "pmda.h"
+#include <ctype.h>
+#include <fcntl.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_FCNTL)
+
+/*
+ * The file is a header followed by a fixed number of slots, hashed
+ * by key with linear probing over a short window.  Slots are never
+ * emptied, only reused - a full window evicts its oldest entry - so
+ * a lookup can stop at the first unused slot.  Writers (from any
+ * process) are serialized by a write lock on the file and readers
+ * take a read lock, so a lookup never sees a partial update.
+ */
+#define SHARED_MAGIC	0x50534e4d	/* "PSNM" */
+#define SHARED_VERSION	1
+#define SHARED_SLOTS	4096
+#define SHARED_PROBES	16
+#define SHARED_RESTAMP	60		/* seconds before rewriting a stamp */
+#define SHARED_MAXMAPS	8
+
+typedef struct {
+    __uint32_t		magic;
+    __uint32_t		version;
+    __uint32_t		nslots;
+    __uint32_t		slotsize;
+} shared_hdr_t;
+
+typedef struct {
+    __int64_t		stamp;		/* time of last store, 0 if unused */
+    char		key[PMDA_SHARED_KEYLEN];
+    char		value[PMDA_SHARED_VALUELEN];
+} shared_slot_t;
+
+typedef struct {
+    char		*name;
+    int			flags;
+    int			fd;
+    size_t		length;
+    shared_hdr_t	*hdr;		/* NULL until the file is mapped */
+    shared_slot_t	*slots;
+} shared_t;
+
+static shared_t		maps[SHARED_MAXMAPS];
+
+static unsigned int
+shared_hash(const char *key)
+{
+    const unsigned char	*p;
+    unsigned int	hash = 2166136261U;	/* FNV-1a */
+
+    for (p = (const unsigned char *)key; *p; p++) {
+	hash ^= *p;
+	hash *= 16777619U;
+    }
+    return hash;
+}
+
+static int
+shared_lock(shared_t *sp, int type)
+{
+    struct flock	lock;
+
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = type;
+    lock.l_whence = SEEK_SET;
+    while (fcntl(sp->fd, F_SETLKW, &lock) < 0) {
+	if (oserror() != EINTR)
+	    return -oserror();
+    }
+    return 0;
+}
+
+static void
+shared_unlock(shared_t *sp)
+{
+    shared_lock(sp, F_UNLCK);
+}
+
+static shared_t *
+shared_handle(int handle)
+{
+    if (handle < 0 || handle >= SHARED_MAXMAPS || maps[handle].name == NULL)
+	return NULL;
+    return &maps[handle];
+}
+
+/*
+ * Map the file, creating and initialising it for a writer.  Readers
+ * may open a name before any writer has created its file, so this is
+ * retried on each lookup until it succeeds.
+ */
+static int
+shared_map(shared_t *sp)
+{
+    char		path[MAXPATHLEN];
+    const char		*vdp;
+    struct stat		sbuf;
+    size_t		length;
+    void		*addr;
+    int			sep = pmPathSeparator();
+    int			writer = (sp->flags & PMDA_SHARED_WRITE);
+    int			sts;
+
+    if (sp->hdr != NULL)
+	return 0;
+    if ((vdp = pmGetOptionalConfig("PCP_VAR_DIR")) == NULL)
+	return PM_ERR_GENERIC;
+    pmsprintf(path, sizeof(path), "%s%c" "config" "%c" "pmda" "%c" "shared.%s",
+		vdp, sep, sep, sep, sp->name);
+
+    length = sizeof(shared_hdr_t) + SHARED_SLOTS * sizeof(shared_slot_t);
+    if (writer)
+	sp->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    else
+	sp->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (sp->fd < 0)
+	return -oserror();
+
+    if ((sts = shared_lock(sp, writer ? F_WRLCK : F_RDLCK)) < 0)
+	goto fail;
+    if (fstat(sp->fd, &sbuf) < 0) {
+	sts = -oserror();
+	goto unlock;
+    }
+    if (sbuf.st_size != (off_t)length) {
+	if (!writer) {
+	    sts = -ENOENT;	/* not yet created, or an older layout */
+	    goto unlock;
+	}
+	if (ftruncate(sp->fd, 0) < 0 || ftruncate(sp->fd, length) < 0) {
+	    sts = -oserror();
+	    goto unlock;
+	}
+    }
+    addr = mmap(NULL, length, writer ? PROT_READ | PROT_WRITE : PROT_READ,
+		MAP_SHARED, sp->fd, 0);
+    if (addr == MAP_FAILED) {
+	sts = -oserror();
+	goto unlock;
+    }
+    sp->hdr = (shared_hdr_t *)addr;
+    sp->slots = (shared_slot_t *)(sp->hdr + 1);
+    sp->length = length;
+
+    if (sp->hdr->magic != SHARED_MAGIC ||
+	sp->hdr->version != SHARED_VERSION ||
+	sp->hdr->nslots != SHARED_SLOTS ||
+	sp->hdr->slotsize != sizeof(shared_slot_t)) {
+	if (!writer) {
+	    sts = -ENOENT;
+	    goto unmap;
+	}
+	memset(sp->slots, 0, SHARED_SLOTS * sizeof(shared_slot_t));
+	sp->hdr->nslots = SHARED_SLOTS;
+	sp->hdr->slotsize = sizeof(shared_slot_t);
+	sp->hdr->version = SHARED_VERSION;
+	sp->hdr->magic = SHARED_MAGIC;
+    }
+    shared_unlock(sp);
+
+    if (pmDebugOptions.indom)
+	fprintf(stderr, "pmdaShared: mapped %s for %s\n",
+		path, writer ? "writing" : "reading");
+    return 0;
+
+unmap:
+    munmap(addr, length);
+    sp->hdr = NULL;
+    sp->slots = NULL;
+unlock:
+    shared_unlock(sp);
+fail:
+    close(sp->fd);
+    sp->fd = -1;
+    return sts;
+}
+
+static void
+shared_unmap(shared_t *sp)
+{
+    if (sp->hdr != NULL)
+	munmap((void *)sp->hdr, sp->length);
+    if (sp->fd >= 0)
+	close(sp->fd);
+    sp->hdr = NULL;
+    sp->slots = NULL;
+    sp->fd = -1;
+}
+
+int
+pmdaSharedOpen(const char *name, int flags)
+{
+    shared_t		*sp;
+    const char		*p;
+    int			handle, sts;
+
+    if (name == NULL || *name == '\0')
+	return -EINVAL;
+    for (p = name; *p; p++)
+	if (!isalnum((int)*p) && *p != '-' && *p != '_')
+	    return -EINVAL;
+
+    for (handle = 0; handle < SHARED_MAXMAPS; handle++)
+	if (maps[handle].name == NULL)
+	    break;
+    if (handle == SHARED_MAXMAPS)
+	return -EMFILE;
+    sp = &maps[handle];
+    if ((sp->name = strdup(name)) == NULL)
+	return -ENOMEM;
+    sp->flags = flags;
+    sp->fd = -1;
+
+    if ((sts = shared_map(sp)) < 0 && (flags & PMDA_SHARED_WRITE)) {
+	free(sp->name);
+	memset(sp, 0, sizeof(*sp));
+	return sts;
+    }
+    return handle;
+}
+
+int
+pmdaSharedStore(int handle, const char *key, const char *value)
+{
+    shared_t		*sp;
+    shared_slot_t	*slot, *oldest = NULL;
+    unsigned int	hash, i;
+    time_t		now;
+    int			sts;
+
+    if ((sp = shared_handle(handle)) == NULL)
+	return -EINVAL;
+    if (!(sp->flags & PMDA_SHARED_WRITE))
+	return -EPERM;
+    if (key == NULL || *key == '\0' || value == NULL ||
+	strlen(key) >= PMDA_SHARED_KEYLEN ||
+	strlen(value) >= PMDA_SHARED_VALUELEN)
+	return -E2BIG;
+    if ((sts = shared_map(sp)) < 0)
+	return sts;
+
+    if ((sts = shared_lock(sp, F_WRLCK)) < 0)
+	return sts;
+    now = time(NULL);
+    hash = shared_hash(key);
+    for (i = 0; i < SHARED_PROBES; i++) {
+	slot = &sp->slots[(hash + i) % SHARED_SLOTS];
+	if (slot->stamp == 0 || strcmp(slot->key, key) == 0)
+	    break;
+	if (oldest == NULL || slot->stamp < oldest->stamp)
+	    oldest = slot;
+    }
+    if (i == SHARED_PROBES) {
+	slot = oldest;
+    } else if (slot->stamp != 0 && strcmp(slot->value, value) == 0 &&
+	     now - slot->stamp < SHARED_RESTAMP) {
+	/* unchanged and recently confirmed, leave the page clean */
+	shared_unlock(sp);
+	return 0;
+    }
+    if (strcmp(slot->key, key) != 0) {
+	memset(slot->key, 0, sizeof(slot->key));
+	strcpy(slot->key, key);
+    }
+    memset(slot->value, 0, sizeof(slot->value));
+    strcpy(slot->value, value);
+    slot->stamp = now;
+    shared_unlock(sp);
+    return 1;
+}
+
+int
+pmdaSharedLookup(int handle, const char *key, char *value, size_t length)
+{
+    shared_t		*sp;
+    shared_slot_t	*slot;
+    unsigned int	hash, i;
+    int			sts;
+
+    if ((sp = shared_handle(handle)) == NULL)
+	return -EINVAL;
+    if (key == NULL || value == NULL || length == 0)
+	return -EINVAL;
+    if ((sts = shared_map(sp)) < 0)
+	return sts;
+
+    if ((sts = shared_lock(sp, F_RDLCK)) < 0)
+	return sts;
+    sts = -ENOENT;
+    hash = shared_hash(key);
+    for (i = 0; i < SHARED_PROBES; i++) {
+	slot = &sp->slots[(hash + i) % SHARED_SLOTS];
+	if (slot->stamp == 0)
+	    break;
+	if (strncmp(slot->key, key, PMDA_SHARED_KEYLEN) != 0)
+	    continue;
+	if (strnlen(slot->value, PMDA_SHARED_VALUELEN) >= length)
+	    sts = -E2BIG;
+	else {
+	    strncpy(value, slot->value, length);
+	    value[length-1] = '\0';
+	    sts = 0;
+	}
+	break;
+    }
+    shared_unlock(sp);
+    return sts;
+}
+
+void
+pmdaSharedClose(int handle)
+{
+    shared_t		*sp;
+
+    if ((sp = shared_handle(handle)) == NULL)
+	return;
+    shared_unmap(sp);
+    free(sp->name);
+    memset(sp, 0, sizeof(*sp));
+}
+
+#else	/* no mmap(2) or fcntl(2) locking */
+
+int
+pmdaSharedOpen(const char *name, int flags)
+{
+    (void)name;
+    (void)flags;
+    return PM_ERR_NYI;
+}
+
+int
+pmdaSharedStore(int handle, const char *key, const char *value)
+{
+    (void)handle;
+    (void)key;
+    (void)value;
+    return PM_ERR_NYI;
+}
+
+int
+pmdaSharedLookup(int handle, const char *key, char *value, size_t length)
+{
+    (void)handle;
+    (void)key;
+    (void)value;
+    (void)length;
+    return PM_ERR_NYI;
+}
+
+void
+pmdaSharedClose(int handle)
+{
+    (void)handle;
+}
+
+#endif
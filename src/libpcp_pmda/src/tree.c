@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2014 Red Hat.
+ * Copyright (c) 2014,2026 Red Hat.
  * Copyright (c) 2009-2010 Aconex.  All Rights Reserved.
  * 
  * This library is free software; you can redistribute it and/or modify it
@@ -54,6 +54,7 @@ pmdaTreeRebuildHash(__pmnsTree *tree, int numpmid)
 	if (htabsize % 2 == 0) htabsize++;
 	if (htabsize % 3 == 0) htabsize += 2;
 	if (htabsize % 5 == 0) htabsize += 2;
+	free(tree->htab);
 	tree->htabsize = htabsize;
 	tree->htab = (__pmnsNode **)calloc(htabsize, sizeof(__pmnsNode *));
 	if (tree->htab) {
@@ -112,7 +113,7 @@ pmdaTreePMID(__pmnsTree *pmns, const char *name, pmID *pmid)
     if (pmns && pmns->root) {
 	__pmnsNode *node;
 
-	if ((node = pmdaNodeLookup(pmns->root->first, name)) == NULL)
+	if ((node = __pmFindPMNSNode(pmns, name)) == NULL)
 	    return PM_ERR_NAME;
 	if (NONLEAF(node))
 	    return PM_ERR_NAME;
@@ -302,7 +303,7 @@ pmdaTreeChildren(__pmnsTree *pmns, const char *name, int traverse, char ***offsp
     if (!pmns)
 	return PM_ERR_NAME;
 
-    if ((node = pmdaNodeLookup(pmns->root->first, name)) == NULL)
+    if ((node = __pmFindPMNSNode(pmns, name)) == NULL)
 	return PM_ERR_NAME;
 
     if (traverse == 0)
@@ -322,10 +323,34 @@ pmdaTreeCreate(__pmnsTree **pmns)
     return __pmNewPMNS(pmns);
 }
 
+/*
+ * Once the hash table has been built, new leaf nodes are added to it
+ * here so PMDAs adding names incrementally need not rebuild it.
+ */
 int
 pmdaTreeInsert(__pmnsTree *tree, pmID pmid, const char *name)
 {
-    return __pmAddPMNSNode(tree, pmid, name);
+    __pmnsNode	*node, *np;
+    int		sts, i;
+
+    if ((sts = __pmAddPMNSNode(tree, pmid, name)) < 0 || tree->htabsize == 0)
+	return sts;
+    if ((node = __pmFindPMNSNode(tree, name)) == NULL || NONLEAF(node))
+	return sts;
+    i = pmid % tree->htabsize;
+    for (np = tree->htab[i]; np != NULL; np = np->hash) {
+	if (np == node)
+	    return sts;		/* name was already present */
+    }
+    node->hash = tree->htab[i];
+    tree->htab[i] = node;
+    return sts;
+}
+
+int
+pmdaTreeRemove(__pmnsTree *tree, const char *name)
+{
+    return __pmRemovePMNSNode(tree, name);
 }
 
 void
@@ -17,7 +17,9 @@
  *	   64-bit integer, but no other format conversion
  */
 
+#include <signal.h>
 #include "pmapi.h"
+#include "libpcp.h"
 #include "trace.h"
 #include "trace_dev.h"
 #include <limits.h>
@@ -70,28 +72,16 @@ trace_htonll(char *p)
 #define trace_ntohll(v) trace_htonll(v)
 #endif
 
-int
-__pmtracesenddata(int fd, char *tag, int taglen, int tagtype, double data)
+/*
+ * Build a data PDU for tag in the need bytes at pp, fields in host order
+ */
+static void
+tracedata_encode(tracedata_t *pp, size_t need, char *tag, int taglen,
+		int tagtype, double data)
 {
-    tracedata_t	*pp = NULL;
-    size_t	need = 0;
     char	*cp;
     int		*ip;
 
-    if (taglen <= 0)
-	return PMTRACE_ERR_IPC;
-    else if (__pmstate & PMTRACE_STATE_NOAGENT) {
-	fprintf(stderr, "__pmtracesenddata: sending data (skipped)\n");
-	return 0;
-    }
-
-    /*
-     * pad to the next __pmTracePDU boundary
-     */
-    need = sizeof(tracedata_t) + sizeof(double) + sizeof(__pmTracePDU)*((taglen - 1 + sizeof(__pmTracePDU))/sizeof(__pmTracePDU));
-
-    if ((pp = (tracedata_t *)__pmtracefindPDUbuf((int)need)) == NULL)
-	return -oserror();
     pp->hdr.len = (int)need;
     pp->hdr.type = TRACE_PDU_DATA;
     pp->bits.taglen = taglen;
@@ -118,6 +108,34 @@ __pmtracesenddata(int fd, char *tag, int taglen, int tagtype, double data)
 	for (pad = sizeof(__pmTracePDU) - 1; pad >= (taglen % sizeof(__pmTracePDU)); pad--)
 	    *padp++ = '~';	/* buffer end */
     }
+}
+
+/*
+ * pad to the next __pmTracePDU boundary
+ */
+static size_t
+tracedata_length(int taglen)
+{
+    return sizeof(tracedata_t) + sizeof(double) + sizeof(__pmTracePDU)*((taglen - 1 + sizeof(__pmTracePDU))/sizeof(__pmTracePDU));
+}
+
+int
+__pmtracesenddata(int fd, char *tag, int taglen, int tagtype, double data)
+{
+    tracedata_t	*pp = NULL;
+    size_t	need = 0;
+
+    if (taglen <= 0)
+	return PMTRACE_ERR_IPC;
+    else if (__pmstate & PMTRACE_STATE_NOAGENT) {
+	fprintf(stderr, "__pmtracesenddata: sending data (skipped)\n");
+	return 0;
+    }
+
+    need = tracedata_length(taglen);
+    if ((pp = (tracedata_t *)__pmtracefindPDUbuf((int)need)) == NULL)
+	return -oserror();
+    tracedata_encode(pp, need, tag, taglen, tagtype, data);
 
 #ifdef PMTRACE_DEBUG
     if (__pmstate & PMTRACE_STATE_PDU)
@@ -127,6 +145,126 @@ __pmtracesenddata(int fd, char *tag, int taglen, int tagtype, double data)
     return __pmtracexmitPDU(fd, (__pmTracePDU *)pp);
 }
 
+/*
+ * Batched data PDUs, for the asynchronous protocol only (there is no
+ * ACK to wait for).  Each PDU is encoded straight into the batch in
+ * its final network byte order, and the whole batch goes out in one
+ * write once it reaches batchmax bytes, or when the caller asks for a
+ * flush.  pmdatrace already processes back-to-back PDUs arriving in
+ * a single read, so nothing changes on the wire.
+ *
+ * The caller serializes all access (the TRACE_LOCK in trace.c).
+ */
+static char	*batchbuf;
+static size_t	batchlen;	/* bytes queued */
+static size_t	batchmax;	/* flush once this many bytes are queued */
+static size_t	batchroom;	/* batchmax plus room for one maximal PDU */
+
+static int
+batch_init(void)
+{
+    char	*sptr, *endnum;
+    long	size = TRACE_BATCH_SIZE;
+
+    if ((sptr = getenv(TRACE_ENV_BATCHSIZE)) != NULL) {
+	size = strtol(sptr, &endnum, 0);
+	if (*endnum != '\0' || size <= 0) {
+	    fprintf(stderr, "trace warning: bad PCP_TRACE_BATCHSIZE ignored.");
+	    size = TRACE_BATCH_SIZE;
+	}
+    }
+    batchmax = (size_t)size;
+    batchroom = batchmax + tracedata_length(MAXTAGNAMELEN);
+    if ((batchbuf = (char *)malloc(batchroom)) == NULL) {
+	batchmax = batchroom = 0;
+	return -oserror();
+    }
+    return 0;
+}
+
+int
+__pmtraceflushdata(int fd)
+{
+    ssize_t	n;
+#if defined(HAVE_SIGPIPE)
+    SIG_PF	user_onpipe;
+#endif
+
+    if (batchlen == 0)
+	return 0;
+    if (__pmstate & PMTRACE_STATE_NOAGENT) {
+	fprintf(stderr, "__pmtraceflushdata: sending %d bytes (skipped)\n",
+		(int)batchlen);
+	batchlen = 0;
+	return 0;
+    }
+
+#if defined(HAVE_SIGPIPE)
+    /* as per __pmtracexmitPDU, the write must not raise SIGPIPE */
+    user_onpipe = signal(SIGPIPE, SIG_IGN);
+    if (user_onpipe != SIG_DFL)
+	signal(SIGPIPE, user_onpipe);
+#endif
+
+    n = __pmWrite(fd, batchbuf, batchlen);
+#ifdef PMTRACE_DEBUG
+    if (__pmstate & PMTRACE_STATE_PDU)
+	fprintf(stderr, "__pmtraceflushdata: fd=%d sent %d of %d bytes\n",
+		fd, (int)n, (int)batchlen);
+#endif
+    if (n < 0) {
+	if (oserror() == EAGAIN || oserror() == EWOULDBLOCK || oserror() == EINTR)
+	    return 0;		/* socket is full, try again at the next flush */
+	batchlen = 0;		/* connection is gone, the batch with it */
+	return -oserror();
+    }
+    /* keep any unsent tail, so PDUs are never split on the wire */
+    if ((size_t)n < batchlen)
+	memmove(batchbuf, batchbuf + n, batchlen - n);
+    batchlen -= n;
+    return 0;
+}
+
+int
+__pmtracebatchdata(int fd, char *tag, int taglen, int tagtype, double data)
+{
+    tracedata_t		*pp;
+    __pmTracePDUHdr	*php;
+    size_t		need;
+    int			sts;
+
+    if (taglen <= 0)
+	return PMTRACE_ERR_IPC;
+    if (batchbuf == NULL && (sts = batch_init()) < 0)
+	return sts;
+
+    need = tracedata_length(taglen);
+    if (batchlen + need > batchroom) {
+	if ((sts = __pmtraceflushdata(fd)) < 0)
+	    return sts;
+	if (batchlen + need > batchroom)
+	    return -EAGAIN;	/* PMDA is not keeping up, drop this one */
+    }
+
+    pp = (tracedata_t *)(batchbuf + batchlen);
+    tracedata_encode(pp, need, tag, taglen, tagtype, data);
+    php = &pp->hdr;
+    php->len = htonl(php->len);
+    php->type = htonl(php->type);
+    php->from = htonl((__int32_t)getpid());
+    batchlen += need;
+
+#ifdef PMTRACE_DEBUG
+    if (__pmstate & PMTRACE_STATE_PDU)
+	fprintf(stderr, "__pmtracebatchdata(tag=\"%s\", data=%f) queued=%d\n",
+		tag, data, (int)batchlen);
+#endif
+
+    if (batchlen >= batchmax)
+	return __pmtraceflushdata(fd);
+    return 0;
+}
+
 int
 __pmtracedecodedata(__pmTracePDU *pdubuf, char **tag, int *taglenp,
 				int *tagtype, int *protocol, double *data)
@@ -45,19 +45,25 @@ moreinput(int fd, __pmTracePDU *pdubuf, int len)
     if (__pmstate & PMTRACE_STATE_PDU) {
 	__pmTracePDUHdr	*php = (__pmTracePDUHdr *)pdubuf;
 	__pmTracePDU	*p;
-	int		j, jend;
+	int		j, jend, plen;
 	char		*q;
 
-	jend = (php->len+(int)sizeof(__pmTracePDU)-1)/(int)sizeof(__pmTracePDU);
+	/* header is still in network byte order, and may be partial */
+	plen = len < (int)sizeof(__pmTracePDUHdr) ? len : (int)ntohl(php->len);
+	if (plen > len)
+	    plen = len;
+	jend = (plen+(int)sizeof(__pmTracePDU)-1)/(int)sizeof(__pmTracePDU);
 	fprintf(stderr, "moreinput: fd=%d pdubuf=0x%p len=%d\n",
 		fd, pdubuf, len);
-	fprintf(stderr, "Piggy-back PDU: %s addr=0x%p len=%d from=%d",
-		pdutypestr(php->type), php, php->len, php->from);
+	if (len >= (int)sizeof(__pmTracePDUHdr))
+	    fprintf(stderr, "Piggy-back PDU: %s addr=0x%p len=%d from=%d",
+		pdutypestr((int)ntohl(php->type)), php, (int)ntohl(php->len),
+		(int)ntohl(php->from));
 	fprintf(stderr, "%03d: ", 0);
 	p = (__pmTracePDU *)php;
 
 	/* for Purify ... */
-	q = (char *)p + php->len;
+	q = (char *)p + plen;
 	while (q < (char *)p + jend*sizeof(__pmTracePDU))
 	    *q++ = '~'; /* buffer end */
 
@@ -247,7 +253,7 @@ __pmtracexmitPDU(int fd, __pmTracePDU *pdubuf)
 int
 __pmtracegetPDU(int fd, int timeout, __pmTracePDU **result)
 {
-    int			need, len;
+    int			need, len, status;
     char		*handle;
     static int		maxsize = TRACE_PDU_CHUNK;
     __pmTracePDU	*pdubuf;
@@ -282,6 +288,24 @@ __pmtracegetPDU(int fd, int timeout, __pmTracePDU **result)
 	pdubuf = more[fd].pdubuf;
 	len = more[fd].len;
 	__pmtracenomoreinput(fd);
+	if (len < (int)sizeof(__pmTracePDUHdr)) {
+	    /*
+	     * only part of the next header arrived (common when PDUs
+	     * are batched), so complete it in a buffer of our own
+	     */
+	    __pmtracepinPDUbuf(pdubuf);
+	    pdubuf_prev = pdubuf;
+	    if ((pdubuf = __pmtracefindPDUbuf(maxsize)) == NULL) {
+		__pmtraceunpinPDUbuf(pdubuf_prev);
+		return -oserror();
+	    }
+	    memmove((void *)pdubuf, (void *)pdubuf_prev, len);
+	    __pmtraceunpinPDUbuf(pdubuf_prev);
+	    handle = (char *)pdubuf;
+	    need = (int)sizeof(__pmTracePDUHdr) - len;
+	    status = pduread(fd, &handle[len], need, 0, timeout);
+	    len = (status == need) ? (int)sizeof(__pmTracePDUHdr) : status;
+	}
     }
     else {
 	if ((pdubuf = __pmtracefindPDUbuf(maxsize)) == NULL)
@@ -40,6 +40,7 @@ static int _pmauxtraceconnect(void);
 static void _pmtraceupdatewait(void);
 static int _pmtracegetack(int, int);
 static int _pmtraceremaperr(int);
+static int _pmtracesend(char *, int, int, double);
 static __uint64_t _pmtraceid(void);
 
 int	__pmstate = PMTRACE_STATE_NONE;
@@ -239,9 +240,8 @@ pmtraceend(const char *tag)
 	}
 
 	if (sts >= 0) {
-	    sts = __pmtracesenddata(__pmfd, hptr->tag, hptr->taglength,
+	    sts = _pmtracesend(hptr->tag, hptr->taglength,
 					TRACE_TYPE_TRANSACT, hptr->data);
-	    sts = _pmtraceremaperr(sts);
 	}
 
 	protocol = __pmtraceprotocol(TRACE_PROTOCOL_QUERY);
@@ -345,9 +345,7 @@ _pmtracecommon(const char *label, double value, int type)
     }
 
     if (sts >= 0) {
-	sts = __pmtracesenddata(__pmfd, (char *)label, (int)strlen(label)+1,
-						    type, value);
-	sts = _pmtraceremaperr(sts);
+	sts = _pmtracesend((char *)label, (int)strlen(label)+1, type, value);
     }
 
     protocol = __pmtraceprotocol(TRACE_PROTOCOL_QUERY);
@@ -387,6 +385,139 @@ pmtraceobs(const char *label, double value)
 }
 
 
+/*
+ * With PMTRACE_STATE_BATCH, data PDUs are queued by __pmtracebatchdata
+ * and written out together - when enough bytes are queued, otherwise
+ * by a background thread every PCP_TRACE_BATCHDELAY seconds, and
+ * finally at exit.  All of these run under TRACE_LOCK.
+ */
+static int		_pmbatching;
+static struct timespec	_pmbatchdelay;
+#if !defined(HAVE_PTHREAD_MUTEX_T)
+static struct timeval	_pmbatchflushed;
+#endif
+
+static int
+_pmtraceflush(void)
+{
+    int		sts;
+
+    if (__pmfd < 0 || _pmtimedout)
+	return 0;
+    if ((sts = __pmtraceflushdata(__pmfd)) < 0)
+	sts = _pmtraceremaperr(sts);
+    return sts;
+}
+
+static void
+_pmtraceflushexit(void)
+{
+    struct linger	dolinger = {0, 1};
+
+    TRACE_LOCK;
+    _pmtraceflush();
+    /* before close, unsent data should be flushed (not reset) */
+    if (__pmfd >= 0 && !_pmtimedout && !(__pmstate & PMTRACE_STATE_NOAGENT))
+	__pmSetSockOpt(__pmfd, SOL_SOCKET, SO_LINGER,
+			(char *)&dolinger, (__pmSockLen)sizeof(dolinger));
+    TRACE_UNLOCK;
+}
+
+#if defined(HAVE_PTHREAD_MUTEX_T)
+static void *
+_pmtraceflusher(void *arg)
+{
+    sigset_t	sigs;
+
+    /* leave the application's signals to the application's threads */
+    sigfillset(&sigs);
+    pthread_sigmask(SIG_BLOCK, &sigs, NULL);
+
+    for (;;) {
+	nanosleep(&_pmbatchdelay, NULL);
+	TRACE_LOCK;
+	_pmtraceflush();
+	TRACE_UNLOCK;
+    }
+    return NULL;
+}
+#endif
+
+static void
+_pmtracebatchstart(void)
+{
+    double		delay = TRACE_BATCH_DELAY;
+    char		*sptr, *endptr;
+#if defined(HAVE_PTHREAD_MUTEX_T)
+    pthread_attr_t	attr;
+    pthread_t		flusher;
+    int			sts;
+#endif
+
+    if ((sptr = getenv(TRACE_ENV_BATCHDELAY)) != NULL) {
+	delay = strtod(sptr, &endptr);
+	if (*endptr != '\0' || delay <= 0.0) {
+	    fprintf(stderr, "trace warning: bogus PCP_TRACE_BATCHDELAY.");
+	    delay = TRACE_BATCH_DELAY;
+	}
+    }
+    pmtimespecFromReal(delay, &_pmbatchdelay);
+    atexit(_pmtraceflushexit);
+    _pmbatching = 1;
+
+#if defined(HAVE_PTHREAD_MUTEX_T)
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    sts = pthread_create(&flusher, &attr, _pmtraceflusher, NULL);
+    pthread_attr_destroy(&attr);
+    if (sts != 0)
+	/* fall back to flushing when the batch fills, and at exit */
+	fprintf(stderr, "trace warning: cannot start batch thread: %s\n",
+		strerror(sts));
+#else
+    pmtimevalNow(&_pmbatchflushed);
+#endif
+#ifdef PMTRACE_DEBUG
+    if (__pmstate & PMTRACE_STATE_COMMS)
+	fprintf(stderr, "_pmtracebatchstart: flushing every %.3f seconds\n",
+		delay);
+#endif
+}
+
+/*
+ * Send (or queue) one data PDU - called with TRACE_LOCK held
+ */
+static int
+_pmtracesend(char *tag, int taglen, int type, double data)
+{
+    int		sts;
+
+    if (!(__pmstate & PMTRACE_STATE_BATCH) ||
+	__pmtraceprotocol(TRACE_PROTOCOL_QUERY) != TRACE_PROTOCOL_ASYNC) {
+	sts = __pmtracesenddata(__pmfd, tag, taglen, type, data);
+	return _pmtraceremaperr(sts);
+    }
+
+    if (!_pmbatching)
+	_pmtracebatchstart();
+    if ((sts = __pmtracebatchdata(__pmfd, tag, taglen, type, data)) < 0)
+	return _pmtraceremaperr(sts);
+#if !defined(HAVE_PTHREAD_MUTEX_T)
+    else {
+	/* no flusher thread, so check the batch age on each call */
+	struct timeval	now;
+
+	pmtimevalNow(&now);
+	if (pmtimevalSub(&now, &_pmbatchflushed) >= pmtimespecToReal(&_pmbatchdelay)) {
+	    _pmbatchflushed = now;
+	    sts = _pmtraceflush();
+	}
+    }
+#endif
+    return sts;
+}
+
+
 char *
 pmtraceerrstr(int code)
 {
@@ -932,12 +1063,21 @@ pmtracestate(int code)
 {
     int	old = __pmstate;
 
+    if (code & PMTRACE_STATE_BATCH)
+	code |= PMTRACE_STATE_ASYNC;	/* no per-PDU ACKs in a batch */
     if (code & PMTRACE_STATE_ASYNC) {
 	if (__pmtraceprotocol(TRACE_PROTOCOL_ASYNC) != TRACE_PROTOCOL_ASYNC)
 	    /* only can do this before connection established */
 	    return -EINVAL;
     }
 
+    if (_pmbatching && !(code & PMTRACE_STATE_BATCH)) {
+	/* send anything queued before batching stops */
+	TRACE_LOCK;
+	_pmtraceflush();
+	TRACE_UNLOCK;
+    }
+
     __pmstate = code;
     return old;
 }
@@ -16,6 +16,7 @@
 #include "util.h"
 #include <dirent.h>
 #include <fnmatch.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 
 /* Decode various archive metafile records (desc, indom, labels, helptext) */
@@ -207,7 +208,9 @@ pmDiscoverPurgeDeleted(void)
     	while (p) {
 	    next = p->next;
 
-	    if (!(p->flags & PM_DISCOVER_FLAGS_DELETED)) {
+	    if (!(p->flags & PM_DISCOVER_FLAGS_DELETED) ||
+		(p->flags & PM_DISCOVER_FLAGS_LOGVOL_IN_PROGRESS)) {
+		/* not deleted, or a worker thread is still using it */
 		prev = p;
 	    } else {
 		if (prev)
@@ -401,6 +404,259 @@ check_deleted(pmDiscover *p)
     	p->flags |= PM_DISCOVER_FLAGS_DELETED;
 }
 
+/*
+ * Find a path with a pending change event - the changed callbacks
+ * can add and purge paths, so the search restarts after each one.
+ */
+static pmDiscover *
+pmDiscoverNextChanged(void)
+{
+    pmDiscover		*p;
+    int			i;
+
+    for (i = 0; i < PM_DISCOVER_HASHTAB_SIZE; i++) {
+	for (p = discover_hashtable[i]; p; p = p->next)
+	    if (p->flags & PM_DISCOVER_FLAGS_CHANGED)
+		return p;
+    }
+    return NULL;
+}
+
+static void
+changes_timer_callBack(uv_timer_t *timer)
+{
+    pmDiscover		*p;
+
+    while ((p = pmDiscoverNextChanged()) != NULL) {
+	p->flags &= ~PM_DISCOVER_FLAGS_CHANGED;
+	p->changed(p); /* returns immediately if PM_DISCOVER_FLAGS_DELETED */
+    }
+}
+
+/*
+ * Checkpoint file with the offsets processed for each archive - one line
+ * per archive: metadata file offset, archive label start time and pmlogger
+ * PID, timestamp of the last logvol result processed, and the path.
+ */
+#define CHECKPOINT_FIELDS	5
+#define CHECKPOINT_FORMAT	"%lld %lld.%09d %d %lld.%09d"
+
+void
+pmDiscoverLoadCheckpoint(discoverModuleData *data)
+{
+    char		line[MAXPATHLEN + 128];
+    char		*path;
+    size_t		length;
+    sds			key, value;
+    FILE		*fp;
+    int			i;
+
+    if (data->checkpoint == NULL)
+	return;
+    if ((data->offsets = dictCreate(&sdsOwnDictCallBacks, NULL)) == NULL)
+	return;
+    if ((fp = fopen(data->checkpoint, "r")) == NULL)
+	return;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+	if ((length = strlen(line)) > 0 && line[length-1] == '\n')
+	    line[--length] = '\0';
+	for (i = 0, path = line; i < CHECKPOINT_FIELDS && path; i++)
+	    if ((path = strchr(path, ' ')) != NULL)
+		path++;
+	if (path == NULL || *path == '\0')
+	    continue;
+	key = sdsnew(path);
+	value = sdsnewlen(line, path - line - 1);
+	if (dictAdd(data->offsets, key, value) != DICT_OK) {
+	    sdsfree(key);
+	    sdsfree(value);
+	}
+    }
+    fclose(fp);
+
+    if (pmDebugOptions.discovery)
+	fprintf(stderr, "%s: %lu archive offsets from %s\n",
+		"pmDiscoverLoadCheckpoint",
+		(unsigned long)dictSize(data->offsets), data->checkpoint);
+}
+
+/*
+ * Find the checkpointed offsets for a newly opened archive, and if
+ * its label matches and the offsets are within the current archive,
+ * return the metadata offset and adjust the logvol starting time to
+ * follow the last result processed.  Entries are only used once.
+ */
+static off_t
+pmDiscoverResume(pmDiscover *p, struct timespec *end)
+{
+    discoverModuleData	*data = getDiscoverModuleData(p->module);
+    long long		offset, origin, last;
+    int			onsec, lnsec, pid;
+    struct stat		sbuf;
+    dictEntry		*entry;
+    off_t		result = 0;
+    sds			meta;
+
+    if (data->offsets == NULL ||
+	(entry = dictFind(data->offsets, p->context.name)) == NULL)
+	return 0;
+
+    meta = sdscatfmt(sdsempty(), "%S.meta", p->context.name);
+    if (sscanf((sds)dictGetVal(entry), CHECKPOINT_FORMAT, &offset,
+		&origin, &onsec, &pid, &last, &lnsec) == 6 &&
+	origin == p->origin.sec && onsec == p->origin.nsec &&
+	pid == p->pid && stat(meta, &sbuf) == 0 && offset <= sbuf.st_size &&
+	(last < end->tv_sec || (last == end->tv_sec && lnsec <= end->tv_nsec))) {
+	result = offset;
+	end->tv_sec = last;
+	end->tv_nsec = lnsec + 1;
+	if (end->tv_nsec >= 1000000000) {
+	    end->tv_sec++;
+	    end->tv_nsec -= 1000000000;
+	}
+	if (pmDebugOptions.discovery)
+	    fprintf(stderr, "%s: %s from offset %lld time %lld.%09d\n",
+			"pmDiscoverResume", p->context.name, offset, last, lnsec);
+    } else if (pmDebugOptions.discovery) {
+	fprintf(stderr, "%s: %s checkpoint mismatch, ignored\n",
+			"pmDiscoverResume", p->context.name);
+    }
+    sdsfree(meta);
+
+    dictDelete(data->offsets, p->context.name);
+    return result;
+}
+
+/*
+ * Write the current offsets for all archives to a temporary file,
+ * then rename it over the previous checkpoint.  Archives that have
+ * not been opened since a restart keep their previous offsets.
+ */
+static void
+pmDiscoverSaveCheckpoint(discoverModuleData *data)
+{
+    dictEntry		*entry;
+    pmDiscover		*p;
+    FILE		*fp;
+    long long		offset;
+    sds			tmp;
+    int			i, sts = 0;
+
+    if (data->checkpoint == NULL)
+	return;
+    tmp = sdscatfmt(sdsempty(), "%S.tmp", data->checkpoint);
+    if ((fp = fopen(tmp, "w")) == NULL) {
+	if (pmDebugOptions.discovery)
+	    fprintf(stderr, "%s: cannot create %s: %s\n",
+		    "pmDiscoverSaveCheckpoint", tmp, osstrerror());
+	sdsfree(tmp);
+	return;
+    }
+    for (i = 0; i < PM_DISCOVER_HASHTAB_SIZE; i++) {
+	for (p = discover_hashtable[i]; p; p = p->next) {
+	    if (!(p->flags & PM_DISCOVER_FLAGS_META) ||
+		(p->flags & PM_DISCOVER_FLAGS_DELETED) ||
+		getDiscoverModuleData(p->module) != data)
+		continue;
+	    if (p->ctx < 0 || p->fd < 0) {
+		if (data->offsets &&
+		    (entry = dictFind(data->offsets, p->context.name)) != NULL)
+		    sts |= fprintf(fp, "%s %s\n",
+				(sds)dictGetVal(entry), p->context.name);
+		continue;
+	    }
+	    offset = (long long)lseek(p->fd, 0, SEEK_CUR);
+	    sts |= fprintf(fp, CHECKPOINT_FORMAT " %s\n", offset,
+			(long long)p->origin.sec, p->origin.nsec, (int)p->pid,
+			(long long)p->timestamp.sec, p->timestamp.nsec,
+			p->context.name);
+	}
+    }
+    if (sts < 0 || fflush(fp) != 0 || fsync(fileno(fp)) < 0) {
+	fclose(fp);
+	unlink(tmp);
+    } else if (fclose(fp) != 0 || rename(tmp, data->checkpoint) < 0) {
+	unlink(tmp);
+    }
+    sdsfree(tmp);
+}
+
+static void
+checkpoint_timer_callBack(uv_timer_t *timer)
+{
+    pmDiscoverSaveCheckpoint((discoverModuleData *)timer->data);
+}
+
+void
+pmDiscoverStartCheckpoint(discoverModuleData *data)
+{
+    uint64_t		interval = data->interval * 1000;
+
+    if (data->checkpoint == NULL || interval == 0 || data->events == NULL)
+	return;
+    if ((data->saver = malloc(sizeof(uv_timer_t))) == NULL)
+	return;
+    uv_timer_init(data->events, data->saver);
+    data->saver->data = data;
+    uv_timer_start(data->saver, checkpoint_timer_callBack, interval, interval);
+}
+
+/*
+ * Filesystem events arrive in bursts, several for each record that
+ * pmlogger writes and many more when archives are rotated, so these
+ * are coalesced per path and the changed callback deferred until the
+ * configured window has expired.
+ */
+static void
+pmDiscoverChanged(pmDiscover *p)
+{
+    discoverModuleData	*data = getDiscoverModuleData(p->module);
+
+    if (data->window == 0 || data->events == NULL) {
+	p->changed(p); /* returns immediately if PM_DISCOVER_FLAGS_DELETED */
+	return;
+    }
+    if (p->flags & PM_DISCOVER_FLAGS_CHANGED) {
+	mmv_inc(data->map, data->metrics[DISCOVER_COALESCED_CALLBACKS]);
+	return;
+    }
+    p->flags |= PM_DISCOVER_FLAGS_CHANGED;
+
+    if (data->timer == NULL) {
+	if ((data->timer = malloc(sizeof(uv_timer_t))) == NULL) {
+	    p->flags &= ~PM_DISCOVER_FLAGS_CHANGED;
+	    p->changed(p);
+	    return;
+	}
+	uv_timer_init(data->events, data->timer);
+	data->timer->data = data;
+    }
+    if (!uv_is_active((uv_handle_t *)data->timer))
+	uv_timer_start(data->timer, changes_timer_callBack, data->window, 0);
+}
+
+static void
+discover_timer_close(uv_handle_t *handle)
+{
+    free(handle);
+}
+
+void
+pmDiscoverCloseTimers(discoverModuleData *data)
+{
+    pmDiscoverSaveCheckpoint(data);
+    if (data->saver) {
+	uv_timer_stop(data->saver);
+	uv_close((uv_handle_t *)data->saver, discover_timer_close);
+	data->saver = NULL;
+    }
+    if (data->timer) {
+	uv_timer_stop(data->timer);
+	uv_close((uv_handle_t *)data->timer, discover_timer_close);
+	data->timer = NULL;
+    }
+}
+
 static void
 fs_change_callBack(uv_fs_event_t *handle, const char *filename, int events, int status)
 {
@@ -456,7 +712,7 @@ fs_change_callBack(uv_fs_event_t *handle, const char *filename, int events, int
      * a tracked archive meta data file or logvolume grew
      */
     if (p)
-	p->changed(p); /* returns immediately if PM_DISCOVER_FLAGS_DELETED */
+	pmDiscoverChanged(p);
 
     sdsfree(path);
 }
@@ -483,6 +739,16 @@ pmDiscoverMonitor(sds path, void (*callback)(pmDiscover *))
     /* save the discovery callback to be invoked */
     p->changed = callback;
 
+    /*
+     * Archives are not watched individually - writes to their meta and
+     * log volume files are reported by the watch on their directory,
+     * whose changed callback then processes the archives within it.
+     * This uses one (inotify) watch per directory rather than one per
+     * archive as well.
+     */
+    if (!(p->flags & PM_DISCOVER_FLAGS_DIRECTORY))
+	return 0;
+
     /* filesystem event request buffer */
     if ((p->event_handle = malloc(sizeof(uv_fs_event_t))) != NULL) {
 	/*
@@ -491,21 +757,8 @@ pmDiscoverMonitor(sds path, void (*callback)(pmDiscover *))
 	 */
 	eventfilename = sdsnew(p->context.name);
 	uv_fs_event_init(data->events, p->event_handle);
-
-	if (p->flags & PM_DISCOVER_FLAGS_DIRECTORY) {
-	    uv_fs_event_start(p->event_handle, fs_change_callBack, eventfilename,
-			    UV_FS_EVENT_WATCH_ENTRY);
-	}
-	else {
-	    /*
-	     * Monitor an archive file. This tracks the archive meta file
-	     * but the change callback processes both meta and logvol on
-	     * every callback (meta before logvol).
-	     */
-	    eventfilename = sdscat(eventfilename, ".meta");
-	    uv_fs_event_start(p->event_handle, fs_change_callBack, eventfilename,
+	uv_fs_event_start(p->event_handle, fs_change_callBack, eventfilename,
 			UV_FS_EVENT_WATCH_ENTRY);
-	}
 
 	if (pmDebugOptions.discovery) {
 	    fprintf(stderr, "pmDiscoverMonitor: added event for %s (%s)\n",
@@ -553,6 +806,8 @@ static struct {
     { PM_DISCOVER_FLAGS_MONITORED, "monitored|" },
     { PM_DISCOVER_FLAGS_DATAVOL_READY, "datavol-ready|" },
     { PM_DISCOVER_FLAGS_META_IN_PROGRESS, "metavol-in-progress|" },
+    { PM_DISCOVER_FLAGS_LOGVOL_IN_PROGRESS, "datavol-in-progress|" },
+    { PM_DISCOVER_FLAGS_CHANGED, "changed|" },
     { 0, NULL }
 };
 
@@ -912,6 +1167,7 @@ pmDiscoverInvokeInDomCallBacks(pmDiscover *p, int type, __pmTimestamp *tsp, pmIn
 		     * if this one is a delta indom
 		     */
 		    ldp = idp->next;
+		    __pmLogLoadLazyInDom(ldp);
 		    dupnamelist = (char **)malloc(in->numinst*sizeof(char *));
 		    dupinstlist = (int *)malloc(in->numinst*sizeof(int));
 		    for (j = 0; j < ldp->numinst; j++) {
@@ -1198,27 +1454,137 @@ archive_dir_lock_path(pmDiscover *p)
 }
 
 /*
- * Process metadata records until EOF. That can span multiple
- * callbacks if we get a partial record read.
+ * Decode one metadata record (body and trailer in buf, of len bytes)
+ * and call all registered callbacks.  Metric descriptors and help text
+ * carry no timestamp, so use those given (archive file changed and
+ * modified times).
  */
 static void
-process_metadata(pmDiscover *p)
+process_metarecord(pmDiscover *p, int rtype, uint32_t *buf, int len,
+		__pmTimestamp *changed, __pmTimestamp *modified)
 {
     discoverModuleData	*data = getDiscoverModuleData(p->module);
-    int			partial = 0;
     __pmTimestamp	stamp;
     pmDesc		desc;
-    off_t		off;
     char		*buffer;
-    int			e, nb, len, nsets;
+    int			e, nsets;
     int			type, id; /* pmID or pmInDom */
     int			nnames;
     char		**names;
     pmInResult		inresult;
     pmLabelSet		*labelset = NULL;
     unsigned char	hash[20];
+    sds			source;
+
+    switch (rtype) {
+    case TYPE_DESC:
+	/* decode pmDesc result from PDU buffer */
+	nnames = 0;
+	names = NULL;
+	mmv_inc(data->map, data->metrics[DISCOVER_DECODE_DESC]);
+	if ((e = pmDiscoverDecodeMetaDesc(buf, len, &desc, &nnames, &names)) < 0) {
+	    if (pmDebugOptions.discovery)
+		fprintf(stderr, "%s failed: err=%d %s\n",
+				"pmDiscoverDecodeMetaDesc", e, pmErrStr(e));
+	    break;
+	}
+	pmDiscoverInvokeMetricCallBacks(p, changed, &desc, nnames, names);
+	break;
+
+    case TYPE_INDOM:
+    case TYPE_INDOM_V2:
+    case TYPE_INDOM_DELTA:
+	/* decode indom, indom_v2 or indom_delta result from buffer */
+	mmv_inc(data->map, data->metrics[DISCOVER_DECODE_INDOM]);
+	if ((e = pmDiscoverDecodeMetaInDom((__int32_t *)buf, len, rtype, &stamp, &inresult)) < 0) {
+	    if (pmDebugOptions.discovery)
+		fprintf(stderr, "%s failed: err=%d %s\n",
+				"pmDiscoverDecodeMetaInDom", e, pmErrStr(e));
+	    break;
+	}
+	pmDiscoverInvokeInDomCallBacks(p, rtype, &stamp, &inresult);
+	/* Note:
+	 *   inresult.namelist is always malloc'd in
+	 *   pmDiscoverDecodeMetaInDom(), either indirectly via
+	 *   __pmLogLoadInDom() (for non-32-bit pointer systems) or
+	 *   directly (for 32-bit-pointer systems).
+	 */
+	free(inresult.namelist);
+	break;
+
+    case TYPE_LABEL:
+    case TYPE_LABEL_V2:
+	/* decode labelset from buffer */
+	mmv_inc(data->map, data->metrics[DISCOVER_DECODE_LABEL]);
+	if ((e = pmDiscoverDecodeMetaLabelSet(buf, len, rtype, &stamp, &type, &id, &nsets, &labelset)) < 0) {
+	    if (pmDebugOptions.discovery)
+		fprintf(stderr, "%s failed: err=%d %s\n",
+				"pmDiscoverDecodeMetaLabelSet", e, pmErrStr(e));
+	    break;
+	}
+
+	/*
+	 * If this is a context labelset, we need to store it in 'p' and
+	 * also update the source identifier (pmSID) - effectively making
+	 * a new source.
+	 */
+	if ((type & PM_LABEL_CONTEXT)) {
+	    pmwebapi_source_hash(hash, labelset->json, labelset->jsonlen);
+	    source = pmwebapi_hash_sds(NULL, hash);
+	    if (p->context.source != NULL &&
+		sdscmp(source, p->context.source) == 0) {
+		sdsfree(source);
+	    } else {
+		sdsfree(p->context.source);
+		p->context.source = source;
+		if (p->context.labelset)
+		    pmFreeLabelSets(p->context.labelset, 1);
+		p->context.labelset = __pmDupLabelSets(labelset, 1);
+		pmDiscoverInvokeSourceCallBacks(p, &stamp);
+	    }
+	}
+	pmDiscoverInvokeLabelsCallBacks(p, &stamp, id, type, labelset, nsets);
+	break;
+
+    case TYPE_TEXT:
+	if (pmDebugOptions.discovery)
+	    fprintf(stderr, "TEXT\n");
+	/* decode help text from buffer */
+	buffer = NULL;
+	mmv_inc(data->map, data->metrics[DISCOVER_DECODE_HELPTEXT]);
+	if ((e = pmDiscoverDecodeMetaHelpText(buf, len, &type, &id, &buffer)) < 0) {
+	    if (pmDebugOptions.discovery)
+		fprintf(stderr, "%s failed: err=%d %s\n",
+				"pmDiscoverDecodeMetaHelpText", e, pmErrStr(e));
+	    break;
+	}
+	pmDiscoverInvokeTextCallBacks(p, modified, id, type, buffer);
+	break;
+
+    default:
+	if (pmDebugOptions.discovery)
+	    fprintf(stderr, "%s, len = %d\n",
+		    rtype == (PM_LOG_MAGIC | PM_LOG_VERS02) ? "PM_LOG_MAGICv2"
+		    : (rtype == (PM_LOG_MAGIC | PM_LOG_VERS03) ? "PM_LOG_MAGICv3"
+		    : "UNKNOWN"), len);
+	break;
+    }
+}
+
+/*
+ * Process metadata records until EOF. That can span multiple
+ * callbacks if we get a partial record read.
+ */
+static void
+process_metadata(pmDiscover *p)
+{
+    discoverModuleData	*data = getDiscoverModuleData(p->module);
+    int			partial = 0;
+    __pmTimestamp	changed, modified;
+    off_t		off;
+    int			nb, len;
     __pmLogHdr		hdr;
-    sds			msg, source;
+    sds			msg;
     char		*lock_path;
     int			deleted;
     struct stat		sbuf;
@@ -1236,6 +1602,27 @@ process_metadata(pmDiscover *p)
 		p->context.name, pmDiscoverFlagsStr(p));
     mmv_inc(data->map, data->metrics[DISCOVER_META_CALLBACKS]);
     lock_path = archive_dir_lock_path(p);
+
+    /* use timestamps from last file change and modification */
+#if defined(HAVE_ST_MTIME_WITH_E) && defined(HAVE_STAT_TIME_T)
+    changed.sec = p->statbuf.st_ctime.tv_sec;
+    changed.nsec = p->statbuf.st_ctime.tv_nsec;
+    modified.sec = p->statbuf.st_mtime.tv_sec;
+    modified.nsec = p->statbuf.st_mtime.tv_nsec;
+#elif defined(HAVE_ST_MTIME_WITH_SPEC)
+    changed.sec = p->statbuf.st_ctimespec.tv_sec;
+    changed.nsec = p->statbuf.st_ctimespec.tv_nsec;
+    modified.sec = p->statbuf.st_mtimespec.tv_sec;
+    modified.nsec = p->statbuf.st_mtimespec.tv_nsec;
+#elif defined(HAVE_STAT_TIMESTRUC) || defined(HAVE_STAT_TIMESPEC) || defined(HAVE_STAT_TIMESPEC_T)
+    changed.sec = p->statbuf.st_ctim.tv_sec;
+    changed.nsec = p->statbuf.st_ctim.tv_nsec;
+    modified.sec = p->statbuf.st_mtim.tv_sec;
+    modified.nsec = p->statbuf.st_mtim.tv_nsec;
+#else
+!bozo!
+#endif
+
     for (;;) {
 	if (lock_path && access(lock_path, F_OK) == 0)
 	    break;
@@ -1295,124 +1682,7 @@ process_metadata(pmDiscover *p)
 	if (pmDebugOptions.discovery)
 	    fprintf(stderr, "Log metadata read len %4d type %s: ", len, __pmLogMetaTypeStr(hdr.type));
 
-	switch (hdr.type) {
-	case TYPE_DESC:
-	    /* decode pmDesc result from PDU buffer */
-	    nnames = 0;
-	    names = NULL;
-	    mmv_inc(data->map, data->metrics[DISCOVER_DECODE_DESC]);
-	    if ((e = pmDiscoverDecodeMetaDesc(buf, len, &desc, &nnames, &names)) < 0) {
-		if (pmDebugOptions.discovery)
-		    fprintf(stderr, "%s failed: err=%d %s\n",
-				    "pmDiscoverDecodeMetaDesc", e, pmErrStr(e));
-		break;
-	    }
-	    /* use timestamp from last modification */
-#if defined(HAVE_ST_MTIME_WITH_E) && defined(HAVE_STAT_TIME_T)
-	    stamp.sec = p->statbuf.st_ctime.tv_sec;
-	    stamp.nsec = p->statbuf.st_ctime.tv_nsec;
-#elif defined(HAVE_ST_MTIME_WITH_SPEC)
-	    stamp.sec = p->statbuf.st_ctimespec.tv_sec;
-	    stamp.nsec = p->statbuf.st_ctimespec.tv_nsec;
-#elif defined(HAVE_STAT_TIMESTRUC) || defined(HAVE_STAT_TIMESPEC) || defined(HAVE_STAT_TIMESPEC_T)
-	    stamp.sec = p->statbuf.st_ctim.tv_sec;
-	    stamp.nsec = p->statbuf.st_ctim.tv_nsec;
-#else
-!bozo!
-#endif
-	    pmDiscoverInvokeMetricCallBacks(p, &stamp, &desc, nnames, names);
-	    break;
-
-	case TYPE_INDOM:
-	case TYPE_INDOM_V2:
-	case TYPE_INDOM_DELTA:
-	    /* decode indom, indom_v2 or indom_delta result from buffer */
-	    mmv_inc(data->map, data->metrics[DISCOVER_DECODE_INDOM]);
-	    if ((e = pmDiscoverDecodeMetaInDom((__int32_t *)buf, len, hdr.type, &stamp, &inresult)) < 0) {
-		if (pmDebugOptions.discovery)
-		    fprintf(stderr, "%s failed: err=%d %s\n",
-				    "pmDiscoverDecodeMetaInDom", e, pmErrStr(e));
-		break;
-	    }
-	    pmDiscoverInvokeInDomCallBacks(p, hdr.type, &stamp, &inresult);
-	    /* Note:
-	     *   inresult.namelist is always malloc'd in
-	     *   pmDiscoverDecodeMetaInDom(), either indirectly via
-	     *   __pmLogLoadInDom() (for non-32-bit pointer systems) or
-	     *   directly (for 32-bit-pointer systems).
-	     */
-	    free(inresult.namelist);
-	    break;
-
-	case TYPE_LABEL:
-	case TYPE_LABEL_V2:
-	    /* decode labelset from buffer */
-	    mmv_inc(data->map, data->metrics[DISCOVER_DECODE_LABEL]);
-	    if ((e = pmDiscoverDecodeMetaLabelSet(buf, len, hdr.type, &stamp, &type, &id, &nsets, &labelset)) < 0) {
-		if (pmDebugOptions.discovery)
-		    fprintf(stderr, "%s failed: err=%d %s\n",
-				    "pmDiscoverDecodeMetaLabelSet", e, pmErrStr(e));
-		break;
-	    }
-
-	    /*
-	     * If this is a context labelset, we need to store it in 'p' and
-	     * also update the source identifier (pmSID) - effectively making
-	     * a new source.
-	     */
-	    if ((type & PM_LABEL_CONTEXT)) {
-		pmwebapi_source_hash(hash, labelset->json, labelset->jsonlen);
-		source = pmwebapi_hash_sds(NULL, hash);
-		if (sdscmp(source, p->context.source) == 0) {
-		    sdsfree(source);
-		} else {
-		    sdsfree(p->context.source);
-		    p->context.source = source;
-		    if (p->context.labelset)
-			pmFreeLabelSets(p->context.labelset, 1);
-		    p->context.labelset = __pmDupLabelSets(labelset, 1);
-		    pmDiscoverInvokeSourceCallBacks(p, &stamp);
-		}
-	    }
-	    pmDiscoverInvokeLabelsCallBacks(p, &stamp, id, type, labelset, nsets);
-	    break;
-
-	case TYPE_TEXT:
-	    if (pmDebugOptions.discovery)
-		fprintf(stderr, "TEXT\n");
-	    /* decode help text from buffer */
-	    buffer = NULL;
-	    mmv_inc(data->map, data->metrics[DISCOVER_DECODE_HELPTEXT]);
-	    if ((e = pmDiscoverDecodeMetaHelpText(buf, len, &type, &id, &buffer)) < 0) {
-		if (pmDebugOptions.discovery)
-		    fprintf(stderr, "%s failed: err=%d %s\n",
-				    "pmDiscoverDecodeMetaHelpText", e, pmErrStr(e));
-		break;
-	    }
-	    /* use timestamp from last modification */
-#if defined(HAVE_ST_MTIME_WITH_E) && defined(HAVE_STAT_TIME_T)
-	    stamp.sec = p->statbuf.st_mtime.tv_sec;
-	    stamp.nsec = p->statbuf.st_mtime.tv_nsec;
-#elif defined(HAVE_ST_MTIME_WITH_SPEC)
-	    stamp.sec = p->statbuf.st_mtimespec.tv_sec;
-	    stamp.nsec = p->statbuf.st_mtimespec.tv_nsec;
-#elif defined(HAVE_STAT_TIMESTRUC) || defined(HAVE_STAT_TIMESPEC) || defined(HAVE_STAT_TIMESPEC_T)
-	    stamp.sec = p->statbuf.st_mtim.tv_sec;
-	    stamp.nsec = p->statbuf.st_mtim.tv_nsec;
-#else
-!bozo!
-#endif
-	    pmDiscoverInvokeTextCallBacks(p, &stamp, id, type, buffer);
-	    break;
-
-	default:
-	    if (pmDebugOptions.discovery)
-		fprintf(stderr, "%s, len = %d\n",
-			hdr.type == (PM_LOG_MAGIC | PM_LOG_VERS02) ? "PM_LOG_MAGICv2"
-			: (hdr.type == (PM_LOG_MAGIC | PM_LOG_VERS03) ? "PM_LOG_MAGICv3"
-			: "UNKNOWN"), len);
-	    break;
-	}
+	process_metarecord(p, hdr.type, buf, len, &changed, &modified);
     }
 
     if (partial == 0)
@@ -1441,30 +1711,45 @@ bump_logvol_decode_stats(discoverModuleData *data, pmHighResResult *r)
     }
 }
 
+#define DISCOVER_LOGVOL_BATCH	64	/* results per worker thread batch */
+
+typedef struct discoverLogvol {
+    uv_work_t		req;
+    pmDiscover		*p;
+    int			ctx;		/* PMAPI context of the archive */
+    char		*lock_path;	/* archive directory lock file */
+    int			pending;	/* logvol callback(s) while fetching */
+    int			status;		/* final fetch status of the batch */
+    uint64_t		loops;
+    uint64_t		changevol;
+    unsigned int	count;
+    pmHighResResult	*results[DISCOVER_LOGVOL_BATCH];
+} discoverLogvol;
+
 /*
- * Fetch metric values to EOF and call all registered callbacks.
- * Always process metadata thru to EOF before any logvol data.
+ * Fetch a batch of metric values, up to EOF - this function runs
+ * in a worker thread and must not access the pmDiscover structure.
+ * A zero status indicates the batch filled before reaching EOF.
  */
 static void
-process_logvol(pmDiscover *p)
+logvol_fetch(uv_work_t *req)
 {
-    discoverModuleData	*data = getDiscoverModuleData(p->module);
-    pmHighResResult	*r = NULL;
-    __pmTimestamp	stamp;
+    discoverLogvol	*logvol = (discoverLogvol *)req->data;
+    pmHighResResult	*r;
     __pmContext		*ctxp;
     __pmArchCtl		*acp;
-    char		*lock_path;
     int			oldcurvol;
-    int			sts;
+    int			sts = 0;
 
-    mmv_inc(data->map, data->metrics[DISCOVER_LOGVOL_CALLBACKS]);
-    lock_path = archive_dir_lock_path(p);
-    for (;;) {
-	if (lock_path && access(lock_path, F_OK) == 0)
+    while (logvol->count < DISCOVER_LOGVOL_BATCH) {
+	if (logvol->lock_path && access(logvol->lock_path, F_OK) == 0) {
+	    sts = -EAGAIN;	/* archive directory is locked */
 	    break;
-	mmv_inc(data->map, data->metrics[DISCOVER_LOGVOL_LOOPS]);
-	pmUseContext(p->ctx);
-	ctxp = __pmHandleToPtr(p->ctx);
+	}
+	logvol->loops++;
+	if ((sts = pmUseContext(logvol->ctx)) < 0)
+	    break;
+	ctxp = __pmHandleToPtr(logvol->ctx);
 	acp = ctxp->c_archctl;
 	oldcurvol = acp->ac_curvol;
 	PM_UNLOCK(ctxp->c_lock);
@@ -1472,41 +1757,61 @@ process_logvol(pmDiscover *p)
 	r = NULL; /* so we know if pmFetchArchive() assigned it */
 	if ((sts = pmFetchHighResArchive(&r)) < 0) {
 	    /* err handling to skip to the next vol */
-	    ctxp = __pmHandleToPtr(p->ctx);
+	    ctxp = __pmHandleToPtr(logvol->ctx);
 	    acp = ctxp->c_archctl;
 	    if (oldcurvol < acp->ac_curvol) {
 	    	__pmLogChangeVol(acp, acp->ac_curvol);
 		acp->ac_offset = 0; /* __pmLogFetch will fix it up */
-		mmv_inc(data->map, data->metrics[DISCOVER_LOGVOL_CHANGE_VOL]);
+		logvol->changevol++;
 	    }
 	    PM_UNLOCK(ctxp->c_lock);
+	    break;
+	}
+	logvol->results[logvol->count++] = r;
+	sts = 0;
+    }
+    logvol->status = sts;
+}
 
-	    if (sts == PM_ERR_EOL) {
-		if (pmDebugOptions.discovery)
-		    fprintf(stderr, "%s: %s end of archive reached\n",
-			    "process_logvol", p->context.name);
+static void process_logvol(pmDiscover *);
 
-		/* succesfully processed to current end of log */
-		break;
-	    } else {
-		/* 
-		 * This log vol was probably deleted (likely compressed)
-		 * under our feet. Try and skip to the next volume.
-		 * We hold the context lock during error recovery here.
-		 */
-		if (pmDebugOptions.discovery)
-		    fprintf(stderr, "process_logvol: %s fetch failed:%s\n",
-			p->context.name, pmErrStr(sts));
-	    }
+/*
+ * Call the registered values callbacks for a fetched batch -
+ * this function runs in the main thread.
+ */
+static void
+logvol_fetch_done(uv_work_t *req, int status)
+{
+    discoverLogvol	*logvol = (discoverLogvol *)req->data;
+    pmDiscover		*p = logvol->p;
+    discoverModuleData	*data = getDiscoverModuleData(p->module);
+    pmHighResResult	*r;
+    __pmTimestamp	stamp;
+    unsigned int	i;
+    int			sts = logvol->status;
 
-	    /* we are done - return and wait for another callback */
-	    r = NULL;
-	    break;
-	}
+    p->flags &= ~PM_DISCOVER_FLAGS_LOGVOL_IN_PROGRESS;
+    p->logvol = NULL;
 
-	/*
-	 * Fetch succeeded - call the values callback and continue
+    mmv_add(data->map, data->metrics[DISCOVER_LOGVOL_LOOPS], &logvol->loops);
+    mmv_add(data->map, data->metrics[DISCOVER_LOGVOL_CHANGE_VOL], &logvol->changevol);
+
+    if (sts == PM_ERR_EOL) {
+	if (pmDebugOptions.discovery)
+	    fprintf(stderr, "%s: %s end of archive reached\n",
+		    "process_logvol", p->context.name);
+    } else if (sts < 0 && sts != -EAGAIN) {
+	/* 
+	 * This log vol was probably deleted (likely compressed)
+	 * under our feet. Try and skip to the next volume.
 	 */
+	if (pmDebugOptions.discovery)
+	    fprintf(stderr, "process_logvol: %s fetch failed:%s\n",
+		p->context.name, pmErrStr(sts));
+    }
+
+    for (i = 0; i < logvol->count; i++) {
+	r = logvol->results[i];
 	if (pmDebugOptions.discovery) {
 	    char		tbuf[64], bufs[64];
 
@@ -1524,24 +1829,66 @@ process_logvol(pmDiscover *p)
 	stamp.sec = r->timestamp.tv_sec;
 	stamp.nsec = r->timestamp.tv_nsec;
 	bump_logvol_decode_stats(data, r);
-	pmDiscoverInvokeValuesCallBack(p, &stamp, r);
+	if ((p->flags & PM_DISCOVER_FLAGS_DELETED) == 0)
+	    pmDiscoverInvokeValuesCallBack(p, &stamp, r);
+	p->timestamp = stamp;
 	pmFreeHighResResult(r);
-	r = NULL;
     }
 
-    if (r) {
-	stamp.sec = r->timestamp.tv_sec;
-	stamp.nsec = r->timestamp.tv_nsec;
-	bump_logvol_decode_stats(data, r);
-	pmDiscoverInvokeValuesCallBack(p, &stamp, r);
-	pmFreeHighResResult(r);
+    if (logvol->lock_path)
+	free(logvol->lock_path);
+
+    if (p->flags & PM_DISCOVER_FLAGS_DELETED) {
+	/* purged on the next directory change callback */
+	free(logvol);
+    } else if (sts == 0 || logvol->pending) {
+	/* batch filled before EOF, or more data arrived meanwhile */
+	free(logvol);
+	process_logvol(p);
+    } else {
+	/* datavol is now up-to-date and at EOF */
+	p->flags &= ~PM_DISCOVER_FLAGS_DATAVOL_READY;
+	free(logvol);
     }
+}
 
-    /* datavol is now up-to-date and at EOF */
-    p->flags &= ~PM_DISCOVER_FLAGS_DATAVOL_READY;
+/*
+ * Fetch metric values to EOF and call all registered callbacks.
+ * Always process metadata thru to EOF before any logvol data.
+ * The fetching is done in batches in a worker thread, so that
+ * many archives are decoded in parallel by the libuv thread pool
+ * rather than one at a time on the event loop thread.
+ */
+static void
+process_logvol(pmDiscover *p)
+{
+    discoverModuleData	*data = getDiscoverModuleData(p->module);
+    discoverLogvol	*logvol;
 
-    if (lock_path)
-    	free(lock_path);
+    if (p->flags & PM_DISCOVER_FLAGS_LOGVOL_IN_PROGRESS) {
+	/* a batch is being fetched, try again once it completes */
+	((discoverLogvol *)p->logvol)->pending = 1;
+	return;
+    }
+
+    mmv_inc(data->map, data->metrics[DISCOVER_LOGVOL_CALLBACKS]);
+    if ((logvol = calloc(1, sizeof(discoverLogvol))) == NULL)
+	return;
+    logvol->req.data = logvol;
+    logvol->p = p;
+    logvol->ctx = p->ctx;
+    logvol->lock_path = archive_dir_lock_path(p);
+
+    p->flags |= PM_DISCOVER_FLAGS_LOGVOL_IN_PROGRESS;
+    p->logvol = logvol;
+
+    if (data->events) {
+	uv_queue_work(data->events, &logvol->req,
+			logvol_fetch, logvol_fetch_done);
+    } else {
+	logvol_fetch(&logvol->req);
+	logvol_fetch_done(&logvol->req, 0);
+    }
 }
 
 static void
@@ -1563,6 +1910,8 @@ pmDiscoverInvokeCallBacks(pmDiscover *p)
 	if (p->flags & (PM_DISCOVER_FLAGS_DATAVOL | PM_DISCOVER_FLAGS_META)) {
 	    struct timespec	after = {0, 1};
 	    struct timespec	tp;
+	    pmHighResLogLabel	label;
+	    off_t		offset;
 
 	    /* create the PMAPI context (once off) */
 	    if ((sts = pmNewContext(p->context.type, p->context.name)) < 0) {
@@ -1600,6 +1949,12 @@ pmDiscoverInvokeCallBacks(pmDiscover *p)
 		return;
 	    }
 
+	    if (pmGetHighResArchiveLabel(&label) >= 0) {
+		p->origin.sec = label.start.tv_sec;
+		p->origin.nsec = label.start.tv_nsec;
+		p->pid = label.pid;
+	    }
+
 	    /*
 	     * We have a valid pmapi context. Initialize context state
 	     * and invoke registered source callbacks.
@@ -1608,8 +1963,12 @@ pmDiscoverInvokeCallBacks(pmDiscover *p)
 
 	    /*
 	     * Seek to end of archive for logvol data (see notes in
-	     * process_logvol routine also).
+	     * process_logvol routine also), or to just after the last
+	     * result processed before a restart.
 	     */
+	    offset = pmDiscoverResume(p, &tp);
+	    p->timestamp.sec = tp.tv_sec;
+	    p->timestamp.nsec = tp.tv_nsec;
 	    pmSetModeHighRes(PM_MODE_FORW, &tp, &after);
 
 	    /*
@@ -1629,7 +1988,9 @@ pmDiscoverInvokeCallBacks(pmDiscover *p)
 		sdsfree(metaname);
 		return;
 	    }
-	    /* pre-process all existing metadata */
+	    /* pre-process all existing (or unprocessed) metadata */
+	    if (offset > 0)
+		lseek(p->fd, offset, SEEK_SET);
 	    process_metadata(p);
 	    sdsfree(metaname);
 	}
@@ -1865,6 +2226,318 @@ pmDiscoverUnregister(int handle)
     	discoverCallBackTable[handle] = NULL; /* unregister these callbacks */
 }
 
+/*
+ * Archive records streamed from a remote pmlogger (pmlogger -R) rather
+ * than discovered in the filesystem.  The stream is a sequence of frames,
+ * each a 32-bit volume number and length (network byte order) and then
+ * that many bytes written to the volume - PM_LOG_VOL_META for metadata,
+ * else a data volume.  Records of each volume are reassembled from the
+ * frames and passed to the same callbacks as records read from archive
+ * files, without a PMAPI context, and optionally appended to a copy of
+ * the archive below a given directory.  The metadata volume is resent
+ * from its start (label first) whenever the logger reconnects, so the
+ * copy of it is rewritten from each metadata label.
+ */
+
+#define STREAM_MAXRECORD	(64*1024*1024)	/* sanity limit, any record */
+
+struct pmDiscoverStream {
+    pmDiscover		*p;		/* source, not in the path table */
+    int			version;	/* archive version, from meta label */
+    int			vol;		/* data volume of the data records */
+    __int32_t		frame[2];	/* header of the current frame */
+    size_t		nframe;		/* bytes of frame header so far */
+    size_t		remain;		/* bytes of current frame to come */
+    int			framevol;	/* volume of the current frame */
+    sds			meta;		/* partial metadata record */
+    sds			data;		/* partial data record */
+    sds			base;		/* archive copy base name, or NULL */
+    int			metafd;		/* archive copy metadata */
+    int			datafd;		/* archive copy data volume */
+};
+
+/*
+ * A source identified (for now) by hostname only, as for old archives
+ * without context labels - those that follow make it a new source.
+ */
+static void
+stream_source(pmDiscover *p, __pmTimestamp *tsp)
+{
+    unsigned char	hash[20];
+    pmLabelSet		*labelset = NULL;
+    char		buf[PM_MAXLABELJSONLEN];
+    int			len;
+
+    len = pmsprintf(buf, sizeof(buf), "{\"hostname\":\"%s\"}",
+		    p->context.hostname);
+    __pmAddLabels(&labelset, buf, 0);
+    pmwebapi_source_hash(hash, buf, len);
+    p->context.source = pmwebapi_hash_sds(NULL, hash);
+    p->context.labelset = labelset;
+    pmDiscoverInvokeSourceCallBacks(p, tsp);
+}
+
+static int
+stream_persist(pmDiscoverStream *s, int vol, const char *record, size_t len)
+{
+    char		path[MAXPATHLEN];
+    struct stat		sbuf;
+    int			*fdp = (vol == PM_LOG_VOL_META) ? &s->metafd : &s->datafd;
+    int			label, flags;
+
+    if (s->base == NULL)
+	return 0;
+
+    label = (len >= 2*sizeof(__int32_t) &&
+	     (ntohl(((__int32_t *)record)[1]) & 0xffffff00) == PM_LOG_MAGIC);
+    if (label) {
+	if (*fdp >= 0)
+	    close(*fdp);
+	if (vol == PM_LOG_VOL_META) {
+	    pmsprintf(path, sizeof(path), "%s.meta", s->base);
+	    flags = O_WRONLY | O_CREAT | O_TRUNC;
+	} else {
+	    /* a data volume is continued, after the logger reconnects */
+	    pmsprintf(path, sizeof(path), "%s.%d", s->base, vol);
+	    flags = O_WRONLY | O_CREAT | O_APPEND;
+	    if (stat(path, &sbuf) == 0 && sbuf.st_size > 0)
+		len = 0;	/* label is already there */
+	}
+	if ((*fdp = open(path, flags, 0644)) < 0)
+	    return -oserror();
+    }
+    if (*fdp < 0 || len == 0)
+	return 0;
+    if (write(*fdp, record, len) != (ssize_t)len)
+	return -oserror();
+    return 0;
+}
+
+static int
+stream_result(pmDiscoverStream *s, const char *record, size_t len)
+{
+    pmDiscover		*p = s->p;
+    discoverModuleData	*data;
+    pmHighResResult	*r;
+    __pmResult		*rp;
+    __pmTimestamp	stamp;
+    __pmPDU		*pb;
+    int			rlen = len - 2 * sizeof(__int32_t);
+    int			sts;
+
+    if ((pb = __pmFindPDUBuf(rlen + (int)sizeof(__pmPDUHdr))) == NULL)
+	return -ENOMEM;
+    memcpy(&pb[3], record + sizeof(__int32_t), rlen);
+    ((__pmPDUHdr *)pb)->len = sizeof(__pmPDUHdr) + rlen;
+    ((__pmPDUHdr *)pb)->type = PDU_RESULT;
+    ((__pmPDUHdr *)pb)->from = FROM_ANON;
+    sts = __pmLogDecodeResult(s->version, pb, &rp);
+    __pmUnpinPDUBuf(pb);
+    if (sts < 0)
+	return PM_ERR_LOGREC;
+
+    stamp = rp->timestamp;	/* struct assignment */
+    r = __pmOffsetHighResResult(rp);
+    r->timestamp.tv_sec = stamp.sec;
+    r->timestamp.tv_nsec = stamp.nsec;
+
+    if (p->module != NULL) {
+	if (p->context.source == NULL)
+	    stream_source(p, &stamp);
+	data = getDiscoverModuleData(p->module);
+	bump_logvol_decode_stats(data, r);
+	pmDiscoverInvokeValuesCallBack(p, &stamp, r);
+    }
+    p->timestamp = stamp;
+    pmFreeHighResResult(r);
+    return 0;
+}
+
+static int
+stream_record(pmDiscoverStream *s, int vol, const char *record, size_t len)
+{
+    pmDiscover		*p = s->p;
+    __pmTimestamp	now;
+    __int32_t		word;
+    int			rtype, sts;
+    static uint32_t	*buf;
+    static size_t	buflen;
+
+    if ((sts = stream_persist(s, vol, record, len)) < 0)
+	return sts;
+
+    memcpy(&word, record + sizeof(__int32_t), sizeof(word));
+    rtype = ntohl(word);
+    if ((rtype & 0xffffff00) == PM_LOG_MAGIC) {
+	if (vol == PM_LOG_VOL_META)
+	    s->version = rtype & 0xff;
+	return 0;
+    }
+    if (s->version == 0)	/* records before the metadata label */
+	return PM_ERR_LABEL;
+    if (vol != PM_LOG_VOL_META)
+	return stream_result(s, record, len);
+    if (p->module == NULL)
+	return 0;
+
+    /* metadata body and trailer, 32-bit aligned for the decoders */
+    len -= 2 * sizeof(__int32_t);
+    if (len > buflen) {
+	uint32_t	*tmp;
+
+	if ((tmp = (uint32_t *)realloc(buf, len + 4096)) == NULL)
+	    return -ENOMEM;
+	buf = tmp;
+	buflen = len + 4096;
+    }
+    memcpy(buf, record + 2 * sizeof(__int32_t), len);
+
+    /* descriptors and help text arrive now, as far as we know */
+    __pmGetTimestamp(&now);
+    if (p->context.source == NULL &&
+	rtype != TYPE_LABEL && rtype != TYPE_LABEL_V2)
+	stream_source(p, &now);
+    process_metarecord(p, rtype, buf, len, &now, &now);
+    return 0;
+}
+
+/*
+ * Process each complete record in the reassembly buffer for vol.
+ */
+static int
+stream_records(pmDiscoverStream *s, int vol, sds *bufp)
+{
+    sds			buf = *bufp;
+    size_t		offset = 0, len;
+    __int32_t		head;
+    int			sts = 0;
+
+    while (sdslen(buf) - offset >= sizeof(head)) {
+	memcpy(&head, buf + offset, sizeof(head));
+	len = ntohl(head);
+	if (len < 3 * sizeof(__int32_t) || len > STREAM_MAXRECORD) {
+	    sts = PM_ERR_LOGREC;
+	    break;
+	}
+	if (sdslen(buf) - offset < len)
+	    break;
+	if ((sts = stream_record(s, vol, buf + offset, len)) < 0 &&
+	    sts != PM_ERR_LOGREC)
+	    break;
+	sts = 0;	/* undecodable records are skipped */
+	offset += len;
+    }
+    sdsrange(buf, offset, -1);
+    return sts;
+}
+
+pmDiscoverStream *
+pmDiscoverStreamOpen(pmDiscoverModule *module, const char *hostname,
+		const char *name, const char *dir, void *arg)
+{
+    pmDiscoverStream	*s;
+    pmDiscover		*p;
+    sds			path;
+
+    if (*hostname == '\0' || *hostname == '.' || strchr(hostname, '/') ||
+	*name == '\0' || *name == '.' || strchr(name, '/'))
+	return NULL;
+    if ((s = (pmDiscoverStream *)calloc(1, sizeof(*s))) == NULL)
+	return NULL;
+    if ((p = (pmDiscover *)calloc(1, sizeof(*p))) == NULL) {
+	free(s);
+	return NULL;
+    }
+    p->fd = -1;
+    p->ctx = -1;	/* records are decoded here, not by a PMAPI context */
+    p->context.type = PM_CONTEXT_ARCHIVE;
+    p->context.hostname = sdsnew(hostname);
+    p->module = module;
+    p->data = arg;
+    s->p = p;
+    s->vol = -1;
+    s->metafd = s->datafd = -1;
+    s->meta = sdsempty();
+    s->data = sdsempty();
+
+    if (dir != NULL) {
+	path = sdscatprintf(sdsempty(), "%s%c%s", dir, pmPathSeparator(), hostname);
+	if (mkdir2(path, 0775) < 0 && oserror() != EEXIST) {
+	    sdsfree(path);
+	    pmDiscoverStreamClose(s);
+	    return NULL;
+	}
+	s->base = sdscatprintf(path, "%c%s", pmPathSeparator(), name);
+	p->context.name = sdsdup(s->base);
+    } else {
+	p->context.name = sdscatprintf(sdsempty(), "%s%c%s",
+				hostname, pmPathSeparator(), name);
+    }
+    return s;
+}
+
+int
+pmDiscoverStreamData(pmDiscoverStream *s, const char *buf, size_t len)
+{
+    size_t		bytes;
+    sds			*bufp;
+    int			sts;
+
+    while (len > 0) {
+	if (s->remain == 0) {
+	    /* frame header */
+	    bytes = sizeof(s->frame) - s->nframe;
+	    if (bytes > len)
+		bytes = len;
+	    memcpy((char *)s->frame + s->nframe, buf, bytes);
+	    s->nframe += bytes;
+	    buf += bytes;
+	    len -= bytes;
+	    if (s->nframe < sizeof(s->frame))
+		break;
+	    s->nframe = 0;
+	    s->framevol = ntohl(s->frame[0]);
+	    s->remain = (__uint32_t)ntohl(s->frame[1]);
+	    if (s->framevol < PM_LOG_VOL_META || s->remain > STREAM_MAXRECORD)
+		return -EPROTO;
+	    if (s->framevol >= 0 && s->framevol != s->vol) {
+		/* new data volume, starting with its label */
+		sdsclear(s->data);
+		s->vol = s->framevol;
+	    }
+	    continue;
+	}
+	bytes = (s->remain < len) ? s->remain : len;
+	bufp = (s->framevol == PM_LOG_VOL_META) ? &s->meta : &s->data;
+	if ((*bufp = sdscatlen(*bufp, buf, bytes)) == NULL)
+	    return -ENOMEM;
+	s->remain -= bytes;
+	buf += bytes;
+	len -= bytes;
+	if ((sts = stream_records(s, s->framevol, bufp)) < 0)
+	    return sts;
+    }
+    return 0;
+}
+
+void
+pmDiscoverStreamClose(pmDiscoverStream *s)
+{
+    pmDiscover		*p = s->p;
+
+    if (p->module != NULL && p->context.source != NULL)
+	pmDiscoverInvokeClosedCallBacks(p);
+    if (s->metafd >= 0)
+	close(s->metafd);
+    if (s->datafd >= 0)
+	close(s->datafd);
+    sdsfree(s->meta);
+    sdsfree(s->data);
+    sdsfree(s->base);
+    pmDiscoverFree(p);
+    free(s);
+}
+
 /*
  * Decode a metadata desc record in buf of length len
  * Return 0 on success.
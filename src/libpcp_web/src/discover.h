@@ -18,6 +18,7 @@
 #include "libpcp.h"
 #include "mmv_stats.h"
 #include "slots.h"
+#include "load.h"
 #ifdef HAVE_LIBUV
 #include <uv.h>
 #else
@@ -44,6 +45,22 @@ typedef void uv_loop_t;
  * PM_DISCOVER_FLAGS_META_IN_PROGRESS is set, set PM_DISCOVER_FLAGS_DATAVOL_READY
  * so we know to process the log volume callback once the metadata read has
  * completed.
+ *
+ * Log volume records are fetched in a libuv worker thread, in batches that
+ * are handed back to the event loop for the values callbacks.  While this
+ * is underway PM_DISCOVER_FLAGS_LOGVOL_IN_PROGRESS is set, further logvol
+ * callbacks are deferred until the batch completes, and the path is not
+ * purged until then (even if it has been deleted).
+ *
+ * Only directories are watched - changes to the archive files within are
+ * reported via their directory, which is then rescanned.  Change events
+ * are coalesced: PM_DISCOVER_FLAGS_CHANGED is set on the first event and
+ * the changed callback runs once, when the configured window expires.
+ *
+ * The metadata offset and last logvol timestamp of each archive are saved
+ * periodically to a checkpoint file.  When an archive is first opened after
+ * a restart, processing resumes from these (if the archive label matches)
+ * instead of rereading all metadata and skipping to the end of the logvol.
  */
 
 /*
@@ -62,6 +79,8 @@ typedef enum pmDiscoverFlags {
     PM_DISCOVER_FLAGS_META			= (1 << 7), /* archive metadata */
     PM_DISCOVER_FLAGS_DATAVOL_READY		= (1 << 8), /* flag: datavol data available */
     PM_DISCOVER_FLAGS_META_IN_PROGRESS		= (1 << 9), /* flag: metadata read in progress */
+    PM_DISCOVER_FLAGS_LOGVOL_IN_PROGRESS	= (1 << 10), /* flag: logvol fetch in worker thread */
+    PM_DISCOVER_FLAGS_CHANGED			= (1 << 11), /* flag: change event(s) pending */
 
     PM_DISCOVER_FLAGS_ALL			= ((unsigned int)~PM_DISCOVER_FLAGS_NONE)
 } pmDiscoverFlags;
@@ -78,7 +97,9 @@ typedef struct pmDiscover {
     pmDiscoverContext		context;	/* metadata for metric source */
     pmDiscoverModule		*module;	/* global state from caller */
     pmDiscoverFlags		flags;		/* state for discovery process */
-    __pmTimestamp		timestamp;	
+    __pmTimestamp		timestamp;	/* last logvol result processed */
+    __pmTimestamp		origin;		/* archive label start time */
+    pid_t			pid;		/* archive label pmlogger PID */
     int				ctx;		/* PMAPI context handle */
     int				fd;		/* meta file descriptor */
 #ifdef HAVE_LIBUV
@@ -87,6 +108,7 @@ typedef struct pmDiscover {
     time_t			lastcb;		/* time last callback processed */
     struct stat			statbuf;	/* stat buffer */
     void			*baton;		/* private internal lib data */
+    void			*logvol;	/* logvol batch being fetched */
     void			*data;		/* opaque user data pointer */
 } pmDiscover;
 
@@ -133,6 +155,7 @@ enum {
     DISCOVER_THROTTLE,
     DISCOVER_META_PARTIAL_READS,
     DISCOVER_DECODE_RESULT_ERRORS,
+    DISCOVER_COALESCED_CALLBACKS,
     NUM_DISCOVER_METRIC
 };
 
@@ -149,6 +172,12 @@ typedef struct discoverModuleData {
 
     struct dict			*config;	/* configuration dict */
     uv_loop_t			*events;	/* event library loop */
+    uv_timer_t			*timer;		/* change coalescing timer */
+    unsigned int		window;		/* coalescing window (msec) */
+    sds				checkpoint;	/* archive offsets file path */
+    unsigned int		interval;	/* checkpoint interval (sec) */
+    uv_timer_t			*saver;		/* checkpoint timer */
+    struct dict			*offsets;	/* offsets from last checkpoint */
     redisSlots			*slots;		/* server slots data */
 
     unsigned int		exclude_names;	/* exclude metric names */
@@ -165,5 +194,8 @@ extern discoverModuleData *getDiscoverModuleData(pmDiscoverModule *);
 extern int pmDiscoverRegister(const char *,
 		pmDiscoverModule *, pmDiscoverCallBacks *, void *);
 extern void pmDiscoverUnregister(int);
+extern void pmDiscoverLoadCheckpoint(discoverModuleData *);
+extern void pmDiscoverStartCheckpoint(discoverModuleData *);
+extern void pmDiscoverCloseTimers(discoverModuleData *);
 
 #endif /* SERIES_DISCOVER_H */
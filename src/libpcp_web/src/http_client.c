@@ -22,12 +22,108 @@
 #define DEFAULT_READ_TIMEOUT	1	/* seconds to wait before timing out */
 #define DEFAULT_MAX_REDIRECT	3	/* number of HTTP redirects to follow */
 #define HTTP_PORT		80	/* HTTP server port */
+#define HTTP_POOL_SIZE		32	/* idle connections kept for reuse */
+#define HTTP_POOL_IDLE		30	/* seconds an idle connection is kept */
 
 #define HTTP			"http"
 #define UNIX			"unix"
 #define LOCATION		"location"
 #define CONTENT_TYPE		"content-type"
 
+/*
+ * Idle keep-alive connections, shared by all clients in the process and
+ * keyed by server (host and port, or unix socket path), so a client that
+ * moves between servers - or a new client for the same server - picks up
+ * a connection rather than paying for connection setup again.
+ */
+typedef struct {
+    int			fd;
+    time_t		idle;		/* when the connection was parked */
+    char		key[MAXPATHLEN];
+} http_conn;
+
+static http_conn	pool[HTTP_POOL_SIZE];
+static int		npool;
+#ifdef PM_MULTI_THREAD
+static pthread_mutex_t	pool_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static void
+http_pool_lock(void)
+{
+#ifdef PM_MULTI_THREAD
+    pthread_mutex_lock(&pool_lock);
+#endif
+}
+
+static void
+http_pool_unlock(void)
+{
+#ifdef PM_MULTI_THREAD
+    pthread_mutex_unlock(&pool_lock);
+#endif
+}
+
+/* is an idle connection still usable, i.e. nothing (not even EOF) to read */
+static int
+http_pool_alive(int fd)
+{
+    __pmFdSet		rfds;
+    struct timeval	tv = {0};
+
+    __pmFD_ZERO(&rfds);
+    __pmFD_SET(fd, &rfds);
+    return __pmSelectRead(fd+1, &rfds, &tv) == 0;
+}
+
+static int
+http_pool_take(const char *key)
+{
+    time_t		idle, now = time(NULL);
+    int			i, fd = -1;
+
+    http_pool_lock();
+    for (i = npool - 1; i >= 0; i--) {
+	if (strcmp(pool[i].key, key) != 0)
+	    continue;
+	fd = pool[i].fd;
+	idle = pool[i].idle;
+	pool[i] = pool[--npool];	/* struct copy */
+	if (now - idle <= HTTP_POOL_IDLE && http_pool_alive(fd))
+	    break;
+	__pmCloseSocket(fd);
+	fd = -1;
+    }
+    http_pool_unlock();
+
+    if (pmDebugOptions.http)
+	fprintf(stderr, "http_pool_take %s fd=%d\n", key, fd);
+    return fd;
+}
+
+static void
+http_pool_park(const char *key, int fd)
+{
+    int			i, oldest = 0;
+
+    if (pmDebugOptions.http)
+	fprintf(stderr, "http_pool_park %s fd=%d\n", key, fd);
+
+    http_pool_lock();
+    if (npool == HTTP_POOL_SIZE) {
+	for (i = 1; i < npool; i++)
+	    if (pool[i].idle < pool[oldest].idle)
+		oldest = i;
+	__pmCloseSocket(pool[oldest].fd);
+	pool[oldest] = pool[--npool];	/* struct copy */
+    }
+    pool[npool].fd = fd;
+    pool[npool].idle = time(NULL);
+    pmstrncpy(pool[npool].key, sizeof(pool[npool].key), key);
+    npool++;
+    http_pool_unlock();
+}
+
 static int
 http_client_connectunix(const char *path, struct timeval *timeout)
 {
@@ -219,11 +315,37 @@ http_client_disconnect(http_client *cp)
     cp->fd = -1;
 }
 
+/* done with this server, keep the connection for reuse if we can */
+static void
+http_client_release(http_client *cp)
+{
+    if (cp->fd != -1 && (cp->flags & F_REUSABLE) && cp->source)
+	http_pool_park(cp->source, cp->fd);
+    else if (cp->fd != -1)
+	__pmCloseSocket(cp->fd);
+    cp->fd = -1;
+    cp->flags &= ~F_REUSABLE;
+}
+
+static int
+http_client_pooled(http_client *cp, const char *source)
+{
+    if (cp->source == NULL || strcmp(cp->source, source) != 0) {
+	free(cp->source);
+	if ((cp->source = strdup(source)) == NULL) {
+	    cp->error_code = -ENOMEM;
+	    return -1;
+	}
+    }
+    return cp->fd = http_pool_take(source);
+}
+
 static int
 http_client_connect(http_client *cp)
 {
     http_parser_url	*up = &cp->parser_url;
     const char		*protocol, *url = cp->url;
+    char		source[MAXHOSTNAMELEN+16];
     size_t		length;
 
     if (pmDebugOptions.http)
@@ -254,6 +376,9 @@ http_client_connect(http_client *cp)
 	host[length] = '\0';
 	port = up->port ? up->port : HTTP_PORT;
 
+	pmsprintf(source, sizeof(source), "%s:%d", host, port);
+	if (http_client_pooled(cp, source) >= 0)
+	    return cp->fd;
 	cp->fd = http_client_connectto(host, port, &cp->timeout);
 	return cp->fd;
     }
@@ -275,6 +400,8 @@ http_client_connect(http_client *cp)
 	pmsprintf(path, sizeof(path), "/%.*s/%.*s",
 		up->field_data[UF_HOST].len, url + up->field_data[UF_HOST].off,
 		up->field_data[UF_PATH].len, url + up->field_data[UF_PATH].off);
+	if (http_client_pooled(cp, path) >= 0)
+	    return cp->fd;
 	cp->fd = http_client_connectunix(path, &cp->timeout);
 	return cp->fd;
     }
@@ -346,12 +473,16 @@ http_client_get(http_client *cp)
     /* establish persistent connections (default in HTTP/1.1 onward) */
     if (cp->http_version < PV_HTTP_1_1)
 	len += pmsprintf(bp+len, sizeof(buf)-len, "Connection: keep-alive\r\n");
+    if (cp->headers)
+	len += pmsprintf(bp+len, sizeof(buf)-len, "%s", cp->headers);
     len += pmsprintf(bp+len, sizeof(buf)-len, "\r\n");
     buf[BUFSIZ-1] = '\0';
 
     if (pmDebugOptions.http && pmDebugOptions.desperate)
 	fprintf(stderr, "Sending HTTP request:\n\n%s\n", buf);
 
+    cp->flags &= ~F_REUSABLE;	/* until the response is complete */
+
     if ((sts = __pmSend(cp->fd, buf, len, 0)) < 0) {
 	if (__pmSocketClosed()) {
 	    sts = 1;
@@ -582,6 +713,7 @@ http_client_response(http_client *cp)
 
     http_parser_init(&cp->parser, HTTP_RESPONSE);
     cp->parser.data = (void *)cp;
+    cp->flags &= ~F_MESSAGE_END;
     cp->error_code = 0;
     cp->offset = 0;
 
@@ -617,6 +749,8 @@ http_client_response(http_client *cp)
 
     if (http_should_keep_alive(&cp->parser) == 0)
 	http_client_disconnect(cp);
+    else if ((cp->flags & F_MESSAGE_END) && !cp->error_code)
+	cp->flags |= F_REUSABLE;
 
     if (cp->error_code) {
         if (pmDebugOptions.http)
@@ -649,7 +783,8 @@ pmhttpNewClient(void)
 void
 pmhttpFreeClient(http_client *cp)
 {
-    http_client_disconnect(cp);
+    http_client_release(cp);
+    free(cp->source);
     free(cp->url);
     free(cp);
 }
@@ -678,6 +813,19 @@ pmhttpClientSetUserAgent(http_client *cp, const char *agent, const char *vers)
     return 0;
 }
 
+int
+pmhttpClientSetHeaders(http_client *cp, const char *headers)
+{
+    cp->headers = headers;
+    return 0;
+}
+
+int
+pmhttpClientGetStatus(http_client *cp)
+{
+    return cp->parser.status_code;
+}
+
 static int
 http_compare_source(http_parser_url *a, const char *urla,
                     http_parser_url *b, const char *urlb)
@@ -692,20 +840,27 @@ http_compare_source(http_parser_url *a, const char *urla,
     protocol = urla + a->field_data[UF_SCHEMA].off;
     length = a->field_data[UF_SCHEMA].len;
 
+    if (strncmp(protocol, urlb + b->field_data[UF_SCHEMA].off, length) != 0 ||
+	strncmp(urla + a->field_data[UF_HOST].off,
+		urlb + b->field_data[UF_HOST].off,
+		a->field_data[UF_HOST].len) != 0)
+	return 1;
+
     if (length == sizeof(HTTP)-1 && strncmp(protocol, HTTP, length) == 0) {
 	if (a->port != b->port)
 	    return 1;
-	if (strncmp(urla + a->field_data[UF_SCHEMA].off,
-		    urlb + b->field_data[UF_SCHEMA].off, length) == 0)
-	    return 1;
 	return 0;
     }
     if (length == sizeof(UNIX)-1 && strncmp(protocol, UNIX, length) == 0) {
-	if (a->field_data[UF_PATH].len != b->field_data[UF_PATH].len)
+	/* the socket path is made from the host and path fields */
+	if (a->field_data[UF_PATH].len != b->field_data[UF_PATH].len ||
+	    strncmp(urla + a->field_data[UF_PATH].off,
+		    urlb + b->field_data[UF_PATH].off,
+		    a->field_data[UF_PATH].len) != 0)
 	    return 1;
 	return 0;
     }
-    return 0;
+    return 1;
 }
 
 static int
@@ -729,10 +884,9 @@ http_client_prepare(http_client *cp, const char *url,
 	return -1;
     }
 
-    /* short-circuit if we are making a request from a connected server */
-    if (http_compare_source(&parser_url, url, &cp->parser_url, cp->url) == 0)
-	return 0;
-    http_client_disconnect(cp);
+    /* keep the connection if this request is for the same server */
+    if (http_compare_source(&parser_url, url, &cp->parser_url, cp->url) != 0)
+	http_client_release(cp);
 
     if ((new_url = strdup(url)) == NULL) {
 	cp->error_code = -ENOMEM;
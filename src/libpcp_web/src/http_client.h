@@ -23,6 +23,7 @@ enum {
     F_DISCONNECT	= 1 << 2,
     F_CONTENT_TYPE	= 1 << 3,
     F_MESSAGE_END	= 1 << 4,
+    F_REUSABLE		= 1 << 5,	/* idle, connection may be pooled */
 };
 
 typedef struct http_client {
@@ -31,11 +32,13 @@ typedef struct http_client {
     struct timeval	timeout;
     const char		*user_agent;
     const char		*agent_vers;
+    const char		*headers;	/* extra request header lines */
     unsigned int	flags;
     unsigned int	max_redirect;
     http_protocol	http_version;
     http_parser_url	parser_url;
     char		*url;		/* copy of user URL / redirected */
+    char		*source;	/* server host:port or socket path */
     http_parser		parser;
     char		*body_buffer;	/* user-supplied result buffer */
     size_t		body_length;	/* full length of that buffer */
@@ -28,7 +28,10 @@ void freeSeriesLoadBaton(seriesLoadBaton *);
 void initSeriesGetContext(seriesGetContext *, void *);
 void freeSeriesGetContext(seriesGetContext *, int);
 
+#define DEFAULT_LOAD_WINDOW	32
+
 static void server_cache_window(void *);
+static void server_cache_read(seriesLoadBaton *);
 
 /* cache information about this metric source (host/archive) */
 static void
@@ -45,6 +48,13 @@ server_cache_metric(seriesLoadBaton *baton,
     redis_series_metric(baton->slots, metric, timestamp, meta, data, baton);
 }
 
+/* submit any batched writes for this sample to the cache servers */
+static void
+server_cache_flush(seriesLoadBaton *baton)
+{
+    redisSlotsFlush(baton->slots);
+}
+
 /* cache a mark record (discontinuity) for metrics from this source */
 static void
 server_cache_mark(seriesLoadBaton *baton, sds timestamp, int data)
@@ -121,11 +131,15 @@ get_instance_metadata(seriesLoadBaton *baton, pmInDom indom, int force_refresh)
     indom_t		*ip;
 
     if (indom != PM_INDOM_NULL) {
-	if ((dp = pmwebapi_add_domain(cp, pmInDom_domain(indom))))
+	if ((dp = pmwebapi_add_domain(cp, pmInDom_domain(indom))) &&
+	    cp->context >= 0)
 	    pmwebapi_add_domain_labels(cp, dp);
 	if ((ip = pmwebapi_add_indom(cp, dp, indom)) != NULL) {
 	    if (force_refresh)
 		ip->updated = 1;
+	    /* streamed archives (no context) describe instances themselves */
+	    if (cp->context < 0)
+		return;
 	    if (ip->updated) {
 		pmwebapi_add_indom_instances(cp, ip);
 		pmwebapi_add_instances_labels(cp, ip);
@@ -141,6 +155,10 @@ get_metric_metadata(seriesLoadBaton *baton, metric_t *metric)
 {
     context_t		*context = &baton->pmapi.context;
 
+    /* streamed archives (no context) send labels and help as metadata */
+    if (context->context < 0)
+	return;
+
     if (metric->cluster) {
 	if (metric->cluster->domain)
 	    pmwebapi_add_domain_labels(context, metric->cluster->domain);
@@ -165,7 +183,13 @@ new_metric(seriesLoadBaton *baton, pmValueSet *vsp)
     char		**nameall = NULL;
     int			count = 0, sts, i;
 
-    if ((sts = pmUseContext(context->context)) < 0) {
+    if (context->context < 0) {
+	/* streamed archive, metric descriptor not (yet) seen */
+	if (pmDebugOptions.series)
+	    fprintf(stderr, "%s: no descriptor for PMID %s\n", "new_metric",
+		pmIDStr_r(vsp->pmid, idbuf, sizeof(idbuf)));
+	return NULL;
+    } else if ((sts = pmUseContext(context->context)) < 0) {
 	fprintf(stderr, "%s: failed to use context for PMID %s: %s\n",
 		"new_metric",
 		pmIDStr_r(vsp->pmid, idbuf, sizeof(idbuf)),
@@ -267,29 +291,30 @@ static sds
 pmwebapi_extract_events(pmValueSet *vsp, int inst)
 {
     sds			s;
-    int			record, param, nrecords, flags, sts;
-    pmResult		**results, *result;
+    int			record, param, flags, sts;
+    pmEventIter		iter;
+    pmValueSet		*vset;
+    struct timeval	stamp;
 
-    if ((sts = nrecords = pmUnpackEventRecords(vsp, inst, &results)) < 0) {
+    if ((sts = pmEventIterStart(&iter, vsp, inst)) < 0) {
 	if (pmDebugOptions.series)
-	    fprintf(stderr, "pmUnpackEventRecords: %s\n", pmErrStr(sts));
+	    fprintf(stderr, "pmEventIterStart: %s\n", pmErrStr(sts));
 	return NULL;
     }
-    nrecords = sts;
     pmwebapi_event_flags();
     pmwebapi_event_missed();
     s = sdsnewlen("{", 1);
-    for (record = 0; record < nrecords; record++) {
+    for (record = 0; pmEventIterNext(&iter) > 0; record++) {
 	if (record > 0)
 	    s = sdscatlen(s, ",", 1);
-	result = results[record];
+	stamp.tv_sec = iter.timestamp.tv_sec;
+	stamp.tv_usec = iter.timestamp.tv_nsec / 1000;
 	s = sdscatfmt(s, "\"timestamp\":");
-	s = pmwebapi_usectimestamp(s, &result->timestamp);
-	for (param = flags = 0; param < result->numpmid; param++)
-	    s = pmwebapi_event_parameter(s, result->vset[param], param, &flags);
+	s = pmwebapi_usectimestamp(s, &stamp);
+	for (param = flags = 0; pmEventIterParam(&iter, &vset) > 0; param++)
+	    s = pmwebapi_event_parameter(s, vset, param, &flags);
     }
     s = sdscatlen(s, "}", 1);
-    pmFreeEventResult(results);
     return s;
 }
 
@@ -297,29 +322,30 @@ static sds
 pmwebapi_extract_highres_events(pmValueSet *vsp, int inst)
 {
     sds			s;
-    int			record, param, nrecords, flags, sts;
-    pmHighResResult	**results, *result;
+    int			record, param, flags, sts;
+    pmEventIter		iter;
+    pmValueSet		*vset;
+    struct timespec	stamp;
 
-    if ((sts = pmUnpackHighResEventRecords(vsp, inst, &results)) < 0) {
+    if ((sts = pmEventIterStart(&iter, vsp, inst)) < 0) {
 	if (pmDebugOptions.series)
-	    fprintf(stderr, "pmUnpackHighResEventRecords: %s\n", pmErrStr(sts));
+	    fprintf(stderr, "pmEventIterStart: %s\n", pmErrStr(sts));
 	return NULL;
     }
-    nrecords = sts;
     pmwebapi_event_flags();
     pmwebapi_event_missed();
     s = sdsempty();
-    for (record = 0; record < nrecords; record++) {
+    for (record = 0; pmEventIterNext(&iter) > 0; record++) {
 	if (record > 0)
 	    s = sdscatlen(s, ",", 1);
-	result = results[record];
+	stamp.tv_sec = iter.timestamp.tv_sec;
+	stamp.tv_nsec = iter.timestamp.tv_nsec;
 	s = sdscatfmt(s, "\"timestamp\":");
-	s = pmwebapi_nsectimestamp(s, &result->timestamp);
-	for (param = flags = 0; param < result->numpmid; param++)
-	    s = pmwebapi_event_parameter(s, result->vset[param], param, &flags);
+	s = pmwebapi_nsectimestamp(s, &stamp);
+	for (param = flags = 0; pmEventIterParam(&iter, &vset) > 0; param++)
+	    s = pmwebapi_event_parameter(s, vset, param, &flags);
     }
     s = sdscatlen(s, "}", 1);
-    pmFreeHighResEventResult(results);
     return s;
 }
 
@@ -501,6 +527,7 @@ series_cache_update(seriesLoadBaton *baton, struct dict *exclude)
 	/* initiate writes to backend caching servers (Redis) */
 	server_cache_metric(baton, metric, timestamp, write_meta, write_data);
     }
+    server_cache_flush(baton);
 
 out:
     sdsfree(timestamp);
@@ -508,9 +535,17 @@ out:
     doneSeriesGetContext(context, "series_cache_update");
 }
 
+/*
+ * Archive records are read in batches of up to baton->window records
+ * by a worker thread, into context->ahead.  While the writes for one
+ * batch are outstanding (pipelined to Redis together) the next batch
+ * is already being read, so reading and writing overlap and neither
+ * waits on a round trip per record.
+ */
 static int
 server_cache_series(seriesLoadBaton *baton)
 {
+    seriesGetContext	*context = &baton->pmapi;
     char		pmmsg[PM_MAXERRMSGLEN];
     sds			msg;
     int			sts;
@@ -525,8 +560,18 @@ server_cache_series(seriesLoadBaton *baton)
 	return sts;
     }
 
+    if (baton->window == 0)
+	baton->window = 1;
+    context->ahead = calloc(baton->window, sizeof(pmHighResResult *));
+    context->batch = calloc(baton->window, sizeof(pmHighResResult *));
+    if (context->ahead == NULL || context->batch == NULL)
+	return -ENOMEM;
+
     seriesBatonReference(baton, "server_cache_series");
+    server_cache_read(baton);
+#if !defined(HAVE_LIBUV)
     server_cache_window(baton);
+#endif
     return 0;
 }
 
@@ -535,9 +580,13 @@ server_cache_series_finished(void *arg)
 {
     seriesLoadBaton	*baton = (seriesLoadBaton *)arg;
     seriesGetContext	*context = &baton->pmapi;
+    seriesModuleData	*data = getSeriesModuleData(baton->module);
 
     assert(context->result == NULL);
 
+    if (data && context->error == PM_ERR_EOL)
+	mmv_inc(data->map, data->metrics[SERIES_LOAD_ARCHIVES]);
+
     /* drop load reference taken in server_cache_series */
     doneSeriesLoadBaton(baton, "server_cache_series_finished");
 }
@@ -548,14 +597,13 @@ server_cache_update_done(void *arg)
     seriesLoadBaton	*baton = (seriesLoadBaton *)arg;
     seriesGetContext	*context = &baton->pmapi;
 
-    /* finish book-keeping for the current record */
-    pmFreeHighResResult(context->result);
-    context->result = NULL;
-    context->count++;
+    /* all writes for the current batch have completed */
     context->done = NULL;
+    context->writing = 0;
 
-    /* begin processing of the next record if any */
-    server_cache_window(baton);
+    /* begin processing of the next batch, once it has been read */
+    if (!context->reading)
+	server_cache_window(baton);
 }
 
 #if defined(HAVE_LIBUV)
@@ -566,13 +614,31 @@ fetch_archive(uv_work_t *req)
     seriesLoadBaton	*baton = (seriesLoadBaton *)req->data;
     seriesGetContext	*context = &baton->pmapi;
     context_t		*cp = &context->context;
+    struct timespec	*finish = &baton->timing.end;
     pmHighResResult	*result;
     int			sts;
 
-    assert(context->result == NULL);
-    if ((context->error = sts = pmUseContext(cp->context)) >= 0)
-	if ((context->error = sts = pmFetchHighResArchive(&result)) >= 0)
-	    context->result = result;
+    assert(context->nahead == 0);
+    if ((sts = pmUseContext(cp->context)) < 0) {
+	context->aheaderror = sts;
+	return;
+    }
+    while (context->nahead < baton->window) {
+	if ((sts = pmFetchHighResArchive(&result)) < 0) {
+	    context->aheaderror = sts;
+	    break;
+	}
+	if (finish->tv_sec < result->timestamp.tv_sec ||
+	    (finish->tv_sec == result->timestamp.tv_sec &&
+	     finish->tv_nsec < result->timestamp.tv_nsec)) {
+	    if (pmDebugOptions.series)
+		fprintf(stderr, "%s: time window end\n", "fetch_archive");
+	    pmFreeHighResResult(result);
+	    context->aheaderror = PM_ERR_EOL;
+	    break;
+	}
+	context->ahead[context->nahead++] = result;
+    }
 }
 
 /* this function runs in the main thread */
@@ -581,56 +647,29 @@ fetch_archive_done(uv_work_t *req, int status)
 {
     seriesLoadBaton	*baton = (seriesLoadBaton *)req->data;
     seriesGetContext	*context = &baton->pmapi;
-    struct timespec	*finish = &baton->timing.end;
-    int 		sts = context->error;
 
     free(req);
-    if (context->loaded) {
-	assert(context->result == NULL);
-        doneSeriesGetContext(context, "fetch_archive_done");
-    } else if (sts >= 0) {
-	if (finish->tv_sec > context->result->timestamp.tv_sec ||
-	    (finish->tv_sec == context->result->timestamp.tv_sec &&
-	     finish->tv_nsec >= context->result->timestamp.tv_nsec)) {
-	    context->done = server_cache_update_done;
-	    series_cache_update(baton, baton->exclude_pmids);
-	}
-	else {
-	    if (pmDebugOptions.series)
-		fprintf(stderr, "%s: time window end\n", "fetch_archive_done");
-	    sts = PM_ERR_EOL;
-	    pmFreeHighResResult(context->result);
-	    context->result = NULL;
-	}
-    }
+    context->reading = 0;
 
-    if (sts < 0) {
-	if (sts != PM_ERR_EOL)
-	    baton->error = sts;
-	doneSeriesGetContext(context, "fetch_archive_done");
-    }
+    /* process this batch now, unless writes of the last are outstanding */
+    if (!context->writing)
+	server_cache_window(baton);
 
     doneSeriesLoadBaton(baton, "fetch_archive_done");
 }
 #endif
 
-void
-server_cache_window(void *arg)
+static void
+server_cache_read(seriesLoadBaton *baton)
 {
-    seriesLoadBaton	*baton = (seriesLoadBaton *)arg;
     seriesGetContext	*context = &baton->pmapi;
 
-    seriesBatonCheckMagic(baton, MAGIC_LOAD, "server_cache_window");
-    seriesBatonCheckCount(context, "server_cache_window");
-    assert(context->result == NULL);
-
     if (pmDebugOptions.series)
-	fprintf(stderr, "%s: fetching next result\n", "server_cache_window");
+	fprintf(stderr, "%s: reading next batch\n", "server_cache_read");
 
 #if defined(HAVE_LIBUV)
-    seriesBatonReference(baton, "server_cache_window");
-    seriesBatonReference(context, "server_cache_window");
-    context->done = server_cache_series_finished;
+    seriesBatonReference(baton, "server_cache_read");
+    context->reading = 1;
 
     /*
      * We must perform pmFetchArchive(3) in a worker thread
@@ -640,11 +679,65 @@ server_cache_window(void *arg)
     req->data = baton;
     uv_queue_work(uv_default_loop(), req, fetch_archive, fetch_archive_done);
 #else
-    baton->error = -ENOTSUP;
-    server_cache_series_finished(arg);
+    context->aheaderror = -ENOTSUP;
 #endif
 }
 
+void
+server_cache_window(void *arg)
+{
+    seriesLoadBaton	*baton = (seriesLoadBaton *)arg;
+    seriesGetContext	*context = &baton->pmapi;
+    seriesModuleData	*data = getSeriesModuleData(baton->module);
+    pmHighResResult	**results;
+    unsigned int	i, count;
+
+    seriesBatonCheckMagic(baton, MAGIC_LOAD, "server_cache_window");
+    seriesBatonCheckCount(context, "server_cache_window");
+    assert(context->result == NULL);
+
+    /* take the batch just read, and start reading the next one */
+    results = context->ahead;
+    context->ahead = context->batch;
+    context->batch = results;
+    count = context->nahead;
+    context->nahead = 0;
+    if (context->aheaderror == 0)
+	server_cache_read(baton);
+
+    seriesBatonReference(context, "server_cache_window");
+    if (count == 0) {
+	/* end of archive (or time window), or a fetch failed */
+	if ((context->error = context->aheaderror) != PM_ERR_EOL)
+	    baton->error = context->error;
+	context->done = server_cache_series_finished;
+	/* keep the baton until the final context messages are reported */
+	seriesBatonReference(baton, "server_cache_window");
+	doneSeriesGetContext(context, "server_cache_window");
+	doneSeriesLoadBaton(baton, "server_cache_window");
+	return;
+    }
+
+    if (pmDebugOptions.series)
+	fprintf(stderr, "%s: writing %u results\n", "server_cache_window", count);
+
+    /* writes for all results in this batch are outstanding together */
+    context->writing = 1;
+    context->done = server_cache_update_done;
+    for (i = 0; i < count; i++) {
+	context->result = results[i];
+	results[i] = NULL;
+	seriesBatonReference(context, "server_cache_window");
+	series_cache_update(baton, baton->exclude_pmids);
+	pmFreeHighResResult(context->result);
+	context->result = NULL;
+	context->count++;
+	if (data)
+	    mmv_inc(data->map, data->metrics[SERIES_LOAD_RECORDS]);
+    }
+    doneSeriesGetContext(context, "server_cache_window");
+}
+
 static void
 set_context_source(seriesLoadBaton *baton, const char *source)
 {
@@ -915,9 +1008,14 @@ void
 freeSeriesGetContext(seriesGetContext *baton, int release)
 {
     context_t		*cp = &baton->context;
+    unsigned int	i;
 
     seriesBatonCheckMagic(baton, MAGIC_CONTEXT, "freeSeriesGetContext");
     pmwebapi_release_context(cp);
+    for (i = 0; i < baton->nahead; i++)
+	pmFreeHighResResult(baton->ahead[i]);
+    free(baton->ahead);
+    free(baton->batch);
     if (release) {
 	memset(baton, 0, sizeof(*baton));
 	free(baton);
@@ -1081,6 +1179,9 @@ initSeriesLoadBaton(seriesLoadBaton *baton, void *module, pmSeriesFlags flags,
 	pmLogInfoCallBack info, pmSeriesDoneCallBack done, redisSlots *slots,
 	void *userdata)
 {
+    seriesModuleData	*data = getSeriesModuleData(module);
+    sds			option;
+
     initSeriesBatonMagic(baton, MAGIC_LOAD);
     baton->info = info;
     baton->done = done;
@@ -1092,6 +1193,12 @@ initSeriesLoadBaton(seriesLoadBaton *baton, void *module, pmSeriesFlags flags,
     baton->errors = dictCreate(&intKeyDictCallBacks, baton);
     baton->wanted = dictCreate(&intKeyDictCallBacks, baton);
     baton->exclude_pmids = dictCreate(&intKeyDictCallBacks, baton);
+
+    /* archive records read ahead, and written together, per batch */
+    baton->window = DEFAULT_LOAD_WINDOW;
+    if (data && data->config &&
+	(option = pmIniFileLookup(data->config, "pmseries", "load.window")))
+	baton->window = strtoul(option, NULL, 10);
 }
 
 void
@@ -1289,6 +1396,8 @@ pmSeriesDiscoverLabels(pmDiscoverEvent *event,
     if (baton == NULL || baton->slots == NULL || baton->slots->state != SLOTS_READY)
 	return;
 
+    pmwebapi_labels_changed(cp);
+
     switch (type) {
     case PM_LABEL_CONTEXT:
 	if (pmDebugOptions.discovery)
@@ -16,6 +16,7 @@
 
 #include "pmapi.h"
 #include "pmwebapi.h"
+#include "wheel.h"
 
 #ifdef HAVE_LIBUV
 #include <uv.h>
@@ -46,7 +47,7 @@ typedef struct context {
     unsigned int	padding : 4;	/* zero-filled struct padding */
     unsigned int	refcount : 16;	/* currently-referenced counter */
     unsigned int	timeout;	/* context timeout in milliseconds */
-    uv_timer_t		timer;
+    wheel_timer_t	timer;		/* context timeout, or release */
     int			context;	/* PMAPI context handle */
     int			randomid;	/* random number identifier */
     struct dict		*pmids;		/* metric pmID to metric struct */
@@ -54,8 +55,11 @@ typedef struct context {
     struct dict		*indoms;	/* indom number to indom struct */
     struct dict		*domains;	/* domain number to domain struct */
     struct dict		*clusters;	/* domain+cluster to cluster struct */
+    struct dict		*scrapes;	/* PMNS prefix to scrape plan */
     sds			labels;		/* context labelset as string */
     pmLabelSet		*labelset;	/* labelset at context level */
+    unsigned int	labelgen;	/* advanced on any label change */
+    struct dict		*labelsets;	/* interned merged labelsets */
     void		*privdata;
 } context_t;
 
@@ -82,7 +86,8 @@ typedef struct instance {
     unsigned int	inst;		/* internal instance identifier */
     unsigned int	cached : 1;	/* metadata is already cached */
     unsigned int	updated : 1;	/* instance labels are updated */
-    unsigned int	padding : 30;
+    unsigned int	hashed : 1;	/* name.hash is from name+labels */
+    unsigned int	padding : 29;
     sds			labels;		/* fully merged inst labelset */
     pmLabelSet		*labelset;	/* labels at inst level or NULL */
     labellist_t		*labellist;	/* label name/value mapping set */
@@ -120,6 +125,25 @@ typedef struct valuelist {
     value_t		value[0];
 } valuelist_t;
 
+/*
+ * Previous values of a counter metric, kept in a webgroup context for
+ * fetches that return rates (change per second) in place of values.
+ */
+typedef struct ratevalue {
+    int			inst;		/* internal instance identifier */
+    unsigned int	valid;		/* rate is known for this sample */
+    double		value;		/* most recent sampled value */
+    double		rate;		/* change per second up to value */
+} ratevalue_t;
+
+typedef struct ratehist {
+    struct timespec	stamp;		/* time of the most recent sample */
+    unsigned int	count;		/* instances in values */
+    unsigned int	size;		/* instances allocated (each array) */
+    ratevalue_t		*values;
+    ratevalue_t		*spare;		/* swapped with values each sample */
+} ratehist_t;
+
 typedef struct metric {
     pmDesc		desc;
     cluster_t		*cluster;
@@ -129,9 +153,11 @@ typedef struct metric {
     sds			labels;		/* fully merged metric labelset */
     pmLabelSet		*labelset;	/* metric item labels or NULL */
     labellist_t		*labellist;	/* label name/value mapping set */
+    struct dict		*labelmemo;	/* inst: memoised merged labels */
     seriesname_t	*names;		/* metric names and mappings */
     unsigned int	numnames : 16;	/* count of metric PMNS entries */
-    unsigned int	padding : 14;	/* zero-fill structure padding */
+    unsigned int	padding : 13;	/* zero-fill structure padding */
+    unsigned int	hashed : 1;	/* names[].hash from current labels */
     unsigned int	updated : 1;	/* last sample returned success */
     unsigned int	cached : 1;	/* metadata written into cache */
     int			error;		/* a PMAPI negative error code */
@@ -139,8 +165,21 @@ typedef struct metric {
 	pmAtomValue	atom;		/* singleton value (PM_IN_NULL) */
 	valuelist_t	*vlist;		/* instance values and metadata */
     } u;
+    struct rollup	*rollup;	/* downsampled tier accumulators */
+    ratehist_t		*rates;		/* previous values, for rate fetches */
 } metric_t;
 
+/*
+ * Resolved metrics for scraping one PMNS subtree, built by a single
+ * namespace traversal and reused until the PMNS changes, such that a
+ * scrape is just one fetch and formatting of the values.
+ */
+typedef struct scrapeplan {
+    unsigned int	numpmid;	/* count of metric names in plan */
+    metric_t		**mplist;	/* metrics in traversal order */
+    pmID		*pmidlist;	/* identifiers for pmFetch(3) */
+} scrapeplan_t;
+
 struct seriesGetContext;
 extern void doneSeriesGetContext(struct seriesGetContext *, const char *);
 
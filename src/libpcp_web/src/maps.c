@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2017-2019,2022 Red Hat.
+ * Copyright (c) 2017-2019,2022,2026 Red Hat.
  *
  * This library is free software; you can redistribute it and/or modify it
  * under the terms of the GNU Lesser General Public License as published
@@ -24,6 +24,24 @@ redisMap *namesmap;
 redisMap *labelsmap;
 redisMap *contextmap;
 
+/*
+ * Series (metric, instance) identifiers with metadata already sent to
+ * Redis - as these are SHA1 hashes of the metadata itself, a load from
+ * any further archive or host context producing the same identifiers
+ * need only stream values.  Entries are kept in most recently used
+ * order, in a list threaded through the dictionary values.
+ */
+typedef struct seriesCacheEntry {
+    struct seriesCacheEntry	*prev;
+    struct seriesCacheEntry	*next;
+    sds				key;	/* owned by the dictionary */
+} seriesCacheEntry;
+
+static dict		*seriescache;
+static seriesCacheEntry	*seriesnewest;
+static seriesCacheEntry	*seriesoldest;
+static unsigned int	serieslimit = 1 << 18;
+
 static uint64_t
 intHashCallBack(const void *key)
 {
@@ -161,6 +179,7 @@ redisMapsClose(void)
 	dictRelease(contextmap);
 	contextmap = NULL;
     }
+    redisSeriesCacheReset();
 }
 
 sds
@@ -207,3 +226,115 @@ redisMapRelease(redisMap *map)
     sdsfree(redisMapName(map));
     dictRelease(map);
 }
+
+static void
+series_cache_unlink(seriesCacheEntry *entry)
+{
+    if (entry->prev)
+	entry->prev->next = entry->next;
+    else
+	seriesnewest = entry->next;
+    if (entry->next)
+	entry->next->prev = entry->prev;
+    else
+	seriesoldest = entry->prev;
+    entry->prev = entry->next = NULL;
+}
+
+static void
+series_cache_push(seriesCacheEntry *entry)
+{
+    entry->prev = NULL;
+    entry->next = seriesnewest;
+    if (seriesnewest)
+	seriesnewest->prev = entry;
+    seriesnewest = entry;
+    if (seriesoldest == NULL)
+	seriesoldest = entry;
+}
+
+/* maximum number of identifiers cached, zero disables the cache */
+void
+redisSeriesCacheSetLimit(unsigned int limit)
+{
+    serieslimit = limit;
+    redisSeriesCacheReset();
+}
+
+/* check for (and refresh) a cached identifier, returns 1 if found */
+int
+redisSeriesCacheLookup(const unsigned char *hash, size_t length)
+{
+    seriesCacheEntry	*entry;
+    dictEntry		*dentry;
+    sds			key;
+
+    if (seriescache == NULL)
+	return 0;
+    key = sdsnewlen(hash, length);
+    dentry = dictFind(seriescache, key);
+    sdsfree(key);
+    if (dentry == NULL)
+	return 0;
+    entry = (seriesCacheEntry *)dictGetVal(dentry);
+    if (entry != seriesnewest) {
+	series_cache_unlink(entry);
+	series_cache_push(entry);
+    }
+    return 1;
+}
+
+void
+redisSeriesCacheInsert(const unsigned char *hash, size_t length)
+{
+    seriesCacheEntry	*entry;
+    dictEntry		*dentry;
+    sds			key;
+
+    if (serieslimit == 0)
+	return;
+    if (seriescache == NULL &&
+	(seriescache = dictCreate(&sdsKeyDictCallBacks, NULL)) == NULL)
+	return;
+
+    key = sdsnewlen(hash, length);
+    if (dictFind(seriescache, key) != NULL) {
+	sdsfree(key);
+	return;
+    }
+    if ((entry = calloc(1, sizeof(seriesCacheEntry))) == NULL ||
+	(dentry = dictAddRaw(seriescache, key, NULL)) == NULL) {
+	free(entry);
+	sdsfree(key);
+	return;
+    }
+    sdsfree(key);	/* duplicated by dictAddRaw */
+    dictSetVal(seriescache, dentry, entry);
+    entry->key = dictGetKey(dentry);
+    series_cache_push(entry);
+
+    /* evict the least recently used identifier once beyond the limit */
+    if (dictSize(seriescache) > serieslimit) {
+	entry = seriesoldest;
+	series_cache_unlink(entry);
+	dictDelete(seriescache, entry->key);
+	free(entry);
+    }
+}
+
+/* forget all identifiers, e.g. on (re)connecting to a Redis server */
+void
+redisSeriesCacheReset(void)
+{
+    seriesCacheEntry	*entry, *next;
+
+    for (entry = seriesnewest; entry; entry = next) {
+	next = entry->next;
+	free(entry);
+    }
+    seriesnewest = seriesoldest = NULL;
+    if (seriescache) {
+	dictRelease(seriescache);
+	seriescache = NULL;
+    }
+}
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2017-2018,2022 Red Hat.
+ * Copyright (c) 2017-2018,2022,2026 Red Hat.
  * 
  * This library is free software; you can redistribute it and/or modify it
  * under the terms of the GNU Lesser General Public License as published
@@ -35,6 +35,15 @@ extern redisMapEntry *redisMapLookup(redisMap *, sds);
 extern sds redisMapValue(redisMapEntry *);
 extern void redisMapInsert(redisMap *, sds, sds);
 
+/*
+ * Bounded (least recently used) set of series identifiers for which
+ * metadata has already been written to Redis by this process.
+ */
+extern void redisSeriesCacheSetLimit(unsigned int);
+extern int redisSeriesCacheLookup(const unsigned char *, size_t);
+extern void redisSeriesCacheInsert(const unsigned char *, size_t);
+extern void redisSeriesCacheReset(void);
+
 /*
  * Helper utilities and data structures
  */
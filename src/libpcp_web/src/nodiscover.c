@@ -28,3 +28,42 @@ pmDiscoverUnregister(int handle)
 {
     (void)handle;
 }
+
+void
+pmDiscoverCloseTimers(void *data)
+{
+    (void)data;
+}
+
+void
+pmDiscoverLoadCheckpoint(void *data)
+{
+    (void)data;
+}
+
+void
+pmDiscoverStartCheckpoint(void *data)
+{
+    (void)data;
+}
+
+pmDiscoverStream *
+pmDiscoverStreamOpen(pmDiscoverModule *module, const char *hostname,
+		const char *name, const char *dir, void *arg)
+{
+    (void)module; (void)hostname; (void)name; (void)dir; (void)arg;
+    return NULL;
+}
+
+int
+pmDiscoverStreamData(pmDiscoverStream *stream, const char *buf, size_t len)
+{
+    (void)stream; (void)buf; (void)len;
+    return -EOPNOTSUPP;
+}
+
+void
+pmDiscoverStreamClose(pmDiscoverStream *stream)
+{
+    (void)stream;
+}
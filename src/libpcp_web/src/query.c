@@ -24,6 +24,8 @@
 #include "schema.h"
 #include "slots.h"
 #include "maps.h"
+#include "rollup.h"
+#include "sketch.h"
 #include <math.h>
 #include <fnmatch.h>
 
@@ -52,9 +54,28 @@ typedef struct seriesGetLookup {
 typedef struct seriesGetQuery {
     node_t		*root;
     timing_t		timing;
+    sds			cachekey;	/* canonical expression, if cacheable */
+    unsigned int	cached;		/* root series set from query cache */
 } seriesGetQuery;
 
-typedef struct seriesQueryBaton {
+typedef struct seriesQueryInfo {
+    pmLogLevel		level;
+    sds			message;
+} seriesQueryInfo;
+
+typedef struct seriesQueryBaton seriesQueryBaton;
+typedef void (*seriesCalculateDone)(seriesQueryBaton *, int);
+
+typedef struct seriesGetCalculate {
+    seriesCalculateDone	done;		/* continuation once calculated */
+    pmLogInfoCallBack	info;		/* saved while in a worker thread */
+    void		*userdata;	/* saved while in a worker thread */
+    unsigned int	ninfo;		/* diagnostics deferred until done */
+    seriesQueryInfo	*infos;
+    int			sts;		/* series_calculate result */
+} seriesGetCalculate;
+
+struct seriesQueryBaton {
     seriesBatonMagic	header;		/* MAGIC_QUERY */
     seriesBatonPhase	*current;
     seriesBatonPhase	phases[QUERY_PHASES];
@@ -64,14 +85,17 @@ typedef struct seriesQueryBaton {
     void		*userdata;
     redisSlots          *slots;
     int			error;
+    seriesGetCalculate	calculate;
     seriesGetLookup	lookup;
     seriesGetQuery	query;
-} seriesQueryBaton;
+};
 
 static void series_pattern_match(seriesQueryBaton *, node_t *);
+static int series_compare(const void *, const void *);
 static int series_union(series_set_t *, series_set_t *);
 static int series_intersect(series_set_t *, series_set_t *);
 static int series_calculate(node_t *, int, void *);
+static void series_calculate_async(seriesQueryBaton *, seriesCalculateDone);
 static void series_redis_hash_expression(seriesQueryBaton *, char *, int);
 static void series_node_get_metric_name(seriesQueryBaton *, seriesGetSID *, series_sample_set_t *);
 static void series_node_get_desc(seriesQueryBaton *, sds, series_sample_set_t *);
@@ -80,8 +104,140 @@ static void series_lookup_mapping(void *);
 static void series_lookup_finished(void *);
 static void series_query_mapping(void *arg);
 static void series_instances_reply_callback(redisClusterAsyncContext *, void *, void *);
+static void series_prepare_time_values(seriesQueryBaton *, seriesGetSID *, int);
 
 sds	cursorcount;	/* number of elements in each SCAN call */
+unsigned int	streamrollup;	/* use (and maintain) rollup tier streams */
+unsigned int	querycacheexpire;	/* seconds until cached query sets expire */
+unsigned int	seriesgeneration;	/* incremented as new series are loaded */
+
+/*
+ * Process-wide cache of matching series identifier sets, keyed by the
+ * parsed form of (pure label-matching) query expressions.  Entries
+ * are discarded once new series have been loaded (which may match any
+ * cached expression) or after querycacheexpire seconds, which bounds
+ * staleness from series added by other processes sharing the server.
+ */
+typedef struct seriesQueryCache {
+    series_set_t	set;
+    unsigned int	generation;	/* seriesgeneration when cached */
+    time_t		stamp;		/* time when the set was cached */
+} seriesQueryCache;
+
+#define QUERY_CACHE_MAXSIZE	1024
+
+static dict		*querycache;
+static dictType		queryCacheDictCallBacks;
+
+static void
+series_query_cache_free(void *privdata, void *value)
+{
+    seriesQueryCache	*entry = (seriesQueryCache *)value;
+
+    (void)privdata;
+    if (entry->set.nseries)
+	free(entry->set.series);
+    free(entry);
+}
+
+static int
+series_query_cacheable(node_t *np)
+{
+    if (np == NULL)
+	return 1;
+
+    switch (np->type) {
+    case N_NAME: case N_STRING: case N_INTEGER: case N_DOUBLE:
+    case N_EQ: case N_GLOB: case N_REQ: case N_RNE:
+    case N_AND: case N_OR:
+	break;
+    default:
+	return 0;
+    }
+    return series_query_cacheable(np->left) &&
+	   series_query_cacheable(np->right);
+}
+
+/*
+ * Cache key for an unevaluated expression tree - avoids the canonical
+ * expression form, which requires metric names resolved by evaluation.
+ */
+static sds
+series_query_cache_key(sds key, node_t *np)
+{
+    if (np == NULL)
+	return sdscatlen(key, "-", 1);
+    key = sdscatfmt(key, "(%i:", np->type);
+    if (np->value)
+	key = sdscatrepr(key, np->value, sdslen(np->value));
+    key = series_query_cache_key(key, np->left);
+    key = series_query_cache_key(key, np->right);
+    return sdscatlen(key, ")", 1);
+}
+
+static int
+series_query_cache_lookup(sds key, series_set_t *set)
+{
+    seriesQueryCache	*entry;
+    dictEntry		*hit;
+    size_t		bytes;
+
+    if (querycache == NULL ||
+	(hit = dictFind(querycache, key)) == NULL)
+	return 0;
+    entry = (seriesQueryCache *)dictGetVal(hit);
+    if (entry->generation != seriesgeneration ||
+	time(NULL) - entry->stamp >= querycacheexpire) {
+	dictDelete(querycache, key);
+	return 0;
+    }
+    if ((bytes = entry->set.nseries * SHA1SZ) != 0) {
+	if ((set->series = malloc(bytes)) == NULL)
+	    return 0;
+	memcpy(set->series, entry->set.series, bytes);
+    }
+    set->nseries = entry->set.nseries;
+    return 1;
+}
+
+static void
+series_query_cache_store(sds key, series_set_t *set)
+{
+    seriesQueryCache	*entry;
+    size_t		bytes;
+
+    if (querycache == NULL) {
+	queryCacheDictCallBacks = sdsKeyDictCallBacks;
+	queryCacheDictCallBacks.valDestructor = series_query_cache_free;
+	if ((querycache = dictCreate(&queryCacheDictCallBacks, NULL)) == NULL)
+	    return;
+    } else if (dictSize(querycache) >= QUERY_CACHE_MAXSIZE) {
+	dictEmpty(querycache, NULL);
+    }
+
+    if ((entry = calloc(1, sizeof(seriesQueryCache))) == NULL)
+	return;
+    if ((bytes = set->nseries * SHA1SZ) != 0) {
+	if ((entry->set.series = malloc(bytes)) == NULL) {
+	    free(entry);
+	    return;
+	}
+	memcpy(entry->set.series, set->series, bytes);
+    }
+    entry->set.nseries = set->nseries;
+    entry->generation = seriesgeneration;
+    entry->stamp = time(NULL);
+    dictReplace(querycache, key, entry);
+}
+
+void
+seriesQueryCacheClose(void)
+{
+    if (querycache) {
+	dictRelease(querycache);
+	querycache = NULL;
+    }
+}
 
 static void
 initSeriesGetQuery(seriesQueryBaton *baton, node_t *root, timing_t *timing)
@@ -89,6 +245,8 @@ initSeriesGetQuery(seriesQueryBaton *baton, node_t *root, timing_t *timing)
     seriesBatonCheckMagic(baton, MAGIC_QUERY, "initSeriesGetQuery");
     baton->query.root = root;
     baton->query.timing = *timing;
+    baton->query.cachekey = NULL;
+    baton->query.cached = 0;
 }
 
 static int
@@ -152,6 +310,7 @@ freeSeriesGetQuery(seriesQueryBaton *baton)
     seriesBatonCheckMagic(baton, MAGIC_QUERY, "freeSeriesGetQuery");
     seriesBatonCheckCount(baton, "freeSeriesGetQuery");
     freeSeriesQueryNode(baton->query.root);
+    sdsfree(baton->query.cachekey);
     memset(baton, 0, sizeof(seriesQueryBaton));
     free(baton);
 }
@@ -745,6 +904,8 @@ node_series_reply(seriesQueryBaton *baton, node_t *np, int nelements, redisReply
 	return sts;
     }
 
+    /* sets are kept sorted for merging by series_intersect/series_union */
+    qsort(set.series, set.nseries, SHA1SZ, series_compare);
     return series_union(&np->result, &set);
 }
 
@@ -754,13 +915,44 @@ series_compare(const void *a, const void *b)
     return memcmp(a, b, SHA1SZ);
 }
 
+/*
+ * Find the first identifier not less than 'key' in a sorted set,
+ * starting from index 'low' - exponential (galloping) search for
+ * the bracketing range, then bisection within it.  Used when one
+ * set is much larger than the other, such that a linear merge is
+ * dominated by skipping over the larger set.
+ */
+static int
+series_gallop(unsigned char *set, int low, int count, const unsigned char *key)
+{
+    int		step = 1, high = low, mid;
+
+    while (high < count && memcmp(set + high * SHA1SZ, key, SHA1SZ) < 0) {
+	low = high + 1;
+	high += step;
+	step <<= 1;
+    }
+    if (high > count)
+	high = count;
+    while (low < high) {
+	mid = low + (high - low) / 2;
+	if (memcmp(set + mid * SHA1SZ, key, SHA1SZ) < 0)
+	    low = mid + 1;
+	else
+	    high = mid;
+    }
+    return low;
+}
+
+/* sets differing in size by more than this factor are galloped */
+#define SERIES_GALLOP_RATIO	16
+
 /*
  * Form resulting set via intersection of two child sets.
- * Algorithm:
- * - sort the larger set
- * - for each identifier in the smaller set
- *   o bisect to find match in sorted set
- *   o if matching, add it to the current saved set
+ * Sets are kept in sorted order (see node_series_reply), so this
+ * is a single pass merge over both, or for very differently sized
+ * sets, a galloping search through the larger for each identifier
+ * from the smaller.  Either way the result remains sorted.
  *
  * Memory from the smaller set is re-used to hold the result,
  * its memory is trimmed (via realloc) if the final resulting
@@ -769,8 +961,8 @@ series_compare(const void *a, const void *b)
 static int
 series_intersect(series_set_t *a, series_set_t *b)
 {
-    unsigned char	*small, *large, *saved, *cp;
-    int			nsmall, nlarge, total, i;
+    unsigned char	*small, *large, *saved, *cp, *lp;
+    int			nsmall, nlarge, total, i, j, sts;
 
     if (a->nseries >= b->nseries) {
 	large = a->series;	nlarge = a->nseries;
@@ -783,19 +975,39 @@ series_intersect(series_set_t *a, series_set_t *b)
     if (pmDebugOptions.series)
 	printf("Intersect large(%d) and small(%d) series\n", nlarge, nsmall);
 
-    qsort(large, nlarge, SHA1SZ, series_compare);
-
-    for (i = 0, cp = saved = small; i < nsmall; i++, cp += SHA1SZ) {
-	if (!bsearch(cp, large, nlarge, SHA1SZ, series_compare))
-	    continue;		/* no match, continue advancing cp only */
-	if (saved != cp)
-	    memcpy(saved, cp, SHA1SZ);
-	saved += SHA1SZ;		/* stashed, advance cp & saved pointers */
+    saved = cp = small;
+    if (nlarge > nsmall * SERIES_GALLOP_RATIO) {
+	for (i = j = 0; i < nsmall && j < nlarge; i++, cp += SHA1SZ) {
+	    j = series_gallop(large, j, nlarge, cp);
+	    if (j == nlarge || memcmp(large + j * SHA1SZ, cp, SHA1SZ) != 0)
+		continue;	/* no match, continue advancing cp only */
+	    if (saved != cp)
+		memcpy(saved, cp, SHA1SZ);
+	    saved += SHA1SZ;	/* stashed, advance cp & saved pointers */
+	    j++;
+	}
+    } else {
+	for (i = j = 0, lp = large; i < nsmall && j < nlarge; ) {
+	    if ((sts = memcmp(cp, lp, SHA1SZ)) < 0) {
+		i++;	cp += SHA1SZ;
+	    } else if (sts > 0) {
+		j++;	lp += SHA1SZ;
+	    } else {
+		if (saved != cp)
+		    memcpy(saved, cp, SHA1SZ);
+		saved += SHA1SZ;
+		i++;	cp += SHA1SZ;
+		j++;	lp += SHA1SZ;
+	    }
+	}
     }
 
     if ((total = (saved - small)/SHA1SZ) < nsmall) {
 	/* shrink the smaller set down further */
-	if ((small = realloc(small, total * SHA1SZ)) == NULL)
+	if (total == 0) {
+	    free(small);
+	    small = NULL;
+	} else if ((small = realloc(small, total * SHA1SZ)) == NULL)
 	    return -ENOMEM;
     }
 
@@ -831,72 +1043,80 @@ node_series_intersect(node_t *np, node_t *left, node_t *right)
 }
 
 /*
- * Form the resulting set from union of two child sets.
- * The larger set is realloc-ated to form the result, if we
- * need to (i.e. if there are entries in the smaller set not
- * in the larger).
- *
- * Iterates over the smaller set doing a binary search of
- * each series identifier, and tracks which ones in the small
- * need to be added to the large set.
- * At the end, add more space to the larger set if needed and
- * append to it.  As a courtesy, since all callers need this,
- * we free the smaller set as well.
+ * Form the resulting set from union of two (sorted) child sets.
+ * If the smaller set is empty the larger is used directly, else
+ * a new set is allocated and filled by merging the two, skipping
+ * identifiers present in both, such that the result is sorted.
+ * As a courtesy, since all callers need this, we free the input
+ * sets as well.
  */
 static int
 series_union(series_set_t *a, series_set_t *b)
 {
-    unsigned char	*cp, *saved, *large, *small;
-    int			nlarge, nsmall, total, need, i;
-
-    if (a->nseries >= b->nseries) {
-	large = a->series;	nlarge = a->nseries;
-	small = b->series;	nsmall = b->nseries;
-    } else {
-	small = a->series;	nsmall = a->nseries;
-	large = b->series;	nlarge = b->nseries;
-    }
+    unsigned char	*cp, *ap, *bp, *set;
+    int			total, i, j, sts;
 
     if (pmDebugOptions.series)
-	fprintf(stderr, "Union of large(%d) and small(%d) series\n", nlarge, nsmall);
-
-    qsort(large, nlarge, SHA1SZ, series_compare);
-
-    for (i = 0, cp = saved = small; i < nsmall; i++, cp += SHA1SZ) {
-	if (bsearch(cp, large, nlarge, SHA1SZ, series_compare) != NULL)
-	    continue;		/* already present, no need to save */
-	if (saved != cp)
-	    memcpy(saved, cp, SHA1SZ);
-	saved += SHA1SZ;	/* stashed, advance both cp & saved */
-    }
-
-    if ((need = (saved - small) / SHA1SZ) > 0) {
-	/* grow the larger set to cater for new entries, then add 'em */
-	if ((cp = realloc(large, (nlarge + need) * SHA1SZ)) == NULL)
-	    return -ENOMEM;
-	large = cp;
-	cp += (nlarge * SHA1SZ);
-	memcpy(cp, small, need * SHA1SZ);
-	total = nlarge + need;
+	fprintf(stderr, "Union of large(%d) and small(%d) series\n",
+			a->nseries >= b->nseries ? a->nseries : b->nseries,
+			a->nseries >= b->nseries ? b->nseries : a->nseries);
+
+    if (a->nseries == 0 || b->nseries == 0) {
+	if (a->nseries == 0) {
+	    free(a->series);
+	    a->series = b->series;
+	    a->nseries = b->nseries;
+	} else {
+	    free(b->series);
+	}
+	total = a->nseries;
+	set = a->series;
     } else {
-	total = nlarge;
+	if ((set = malloc((a->nseries + b->nseries) * SHA1SZ)) == NULL)
+	    return -ENOMEM;
+	ap = a->series;
+	bp = b->series;
+	for (i = j = 0, cp = set; i < a->nseries || j < b->nseries; ) {
+	    if (i == a->nseries)
+		sts = 1;
+	    else if (j == b->nseries)
+		sts = -1;
+	    else
+		sts = memcmp(ap, bp, SHA1SZ);
+	    if (sts <= 0) {
+		memcpy(cp, ap, SHA1SZ);
+		if (sts == 0) {		/* present in both, add only once */
+		    j++;	bp += SHA1SZ;
+		}
+		i++;	ap += SHA1SZ;
+	    } else {
+		memcpy(cp, bp, SHA1SZ);
+		j++;	bp += SHA1SZ;
+	    }
+	    cp += SHA1SZ;
+	}
+	total = (cp - set) / SHA1SZ;
+	if (total < a->nseries + b->nseries &&
+	    (cp = realloc(set, total * SHA1SZ)) != NULL)
+	    set = cp;
+	free(a->series);
+	free(b->series);
     }
 
     if (pmDebugOptions.series && pmDebugOptions.desperate) {
 	char		hashbuf[42];
 
 	fprintf(stderr, "Union result set contains %d series:\n", total);
-	for (i = 0, cp = large; i < total; cp += SHA1SZ, i++) {
+	for (i = 0, cp = set; i < total; cp += SHA1SZ, i++) {
 	    pmwebapi_hash_str(cp, hashbuf, sizeof(hashbuf));
 	    fprintf(stderr, "    %s\n", hashbuf);
 	}
     }
 
     a->nseries = total;
-    a->series = large;
+    a->series = set;
     b->series = NULL;
     b->nseries = 0;
-    free(small);
     return 0;
 }
 
@@ -1568,6 +1788,13 @@ series_prepare_time_reply(
 	if (reply->elements > 0) {
 	    /* reply is a normal time series */
 	    series_values_reply(baton, sid->name, reply->elements, reply->element, arg);
+	} else if (sid->rollup) {
+	    /* no rollup tier for this series (yet) - use the raw values */
+	    sid->rollup = 0;
+	    seriesBatonReference(baton, "series_prepare_time_reply");
+	    series_prepare_time_values(baton, sid, -1);
+	    series_query_end_phase(baton);
+	    return;
 	} else {
 	    /* Handle fabricated/expression SID in /series/values :
 	     * - get the expr for sid->name from redis. In the callback for that,
@@ -1604,15 +1831,18 @@ series_value_count_only(timing_t *tp)
     return tp->count;
 }
 
+/*
+ * Query cache for the time series range (groups of instance:value
+ * pairs, with an associated timestamp) of one series, either from
+ * the raw values stream or from a rollup tier (tier >= 0).
+ */
 static void
-series_prepare_time(seriesQueryBaton *baton, series_set_t *result)
+series_prepare_time_values(seriesQueryBaton *baton, seriesGetSID *sid, int tier)
 {
     timing_t		*tp = &baton->query.timing;
-    unsigned char	*series = result->series;
-    seriesGetSID	*sid;
     char		buffer[64], revbuf[64];
     sds			start, end, key, cmd;
-    unsigned int	i, revlen = 0, reverse = 0;
+    unsigned int	revlen = 0, reverse = 0;
 
     /* if only 'count' is requested, work back from most recent value */
     if ((reverse = series_value_count_only(tp)) != 0) {
@@ -1622,9 +1852,6 @@ series_prepare_time(seriesQueryBaton *baton, series_set_t *result)
 	start = sdsnew(timespec_stream_str(&tp->start, buffer, sizeof(buffer)));
     }
 
-    if (pmDebugOptions.series)
-	fprintf(stderr, "START: %s\n", start);
-
     if (reverse)
 	end = sdsnew("-");
     else if (tp->end.tv_sec)
@@ -1632,44 +1859,68 @@ series_prepare_time(seriesQueryBaton *baton, series_set_t *result)
     else
 	end = sdsnew("+");	/* "+" means "no end" - to the most recent */
 
+    if (tier >= 0) {
+	sid->rollup = 1;
+	key = sdscatfmt(sdsempty(), "pcp:rollup:%s:series:%S",
+			rollupTiers[tier].name, sid->name);
+    } else {
+	key = sdscatfmt(sdsempty(), "pcp:values:series:%S", sid->name);
+    }
+
     if (pmDebugOptions.series)
-	fprintf(stderr, "END: %s\n", end);
+	fprintf(stderr, "%s: %s START: %s END: %s\n",
+			"series_prepare_time", key, start, end);
+
+    /* X[REV]RANGE key t1 t2 [count N] */
+    if (reverse) {
+	cmd = redis_command(6);
+	cmd = redis_param_str(cmd, XREVRANGE, XREVRANGE_LEN);
+    } else {
+	cmd = redis_command(4);
+	cmd = redis_param_str(cmd, XRANGE, XRANGE_LEN);
+    }
+    cmd = redis_param_sds(cmd, key);
+    cmd = redis_param_sds(cmd, start);
+    cmd = redis_param_sds(cmd, end);
+    if (reverse) {
+	cmd = redis_param_str(cmd, "COUNT", sizeof("COUNT")-1);
+	cmd = redis_param_str(cmd, revbuf, revlen);
+    }
+    sdsfree(key);
+    sdsfree(start);
+    sdsfree(end);
+    redisSlotsRequest(baton->slots, cmd,
+				series_prepare_time_reply, sid);
+    sdsfree(cmd);
+}
+
+static void
+series_prepare_time(seriesQueryBaton *baton, series_set_t *result)
+{
+    timing_t		*tp = &baton->query.timing;
+    unsigned char	*series = result->series;
+    seriesGetSID	*sid;
+    char		buffer[64];
+    unsigned int	i;
+    int			tier = -1;
 
     /*
-     * Query cache for the time series range (groups of instance:value
-     * pairs, with an associated timestamp).
+     * With a sampling interval at least as wide as a rollup tier, the
+     * coarsest such tier holds all the values to be sampled from, and
+     * far fewer values than the raw stream.  Count-only queries wants
+     * the most recent raw values though.
      */
+    if (streamrollup && !series_value_count_only(tp))
+	tier = rollup_tier(&tp->delta);
+
     for (i = 0; i < result->nseries; i++, series += SHA1SZ) {
 	sid = calloc(1, sizeof(seriesGetSID));
 	pmwebapi_hash_str(series, buffer, sizeof(buffer));
 
 	initSeriesGetSID(sid, buffer, 1, baton);
 	seriesBatonReference(baton, "series_prepare_time");
-
-	key = sdscatfmt(sdsempty(), "pcp:values:series:%S", sid->name);
-
-	/* X[REV]RANGE key t1 t2 [count N] */
-	if (reverse) {
-	    cmd = redis_command(6);
-	    cmd = redis_param_str(cmd, XREVRANGE, XREVRANGE_LEN);
-	} else {
-	    cmd = redis_command(4);
-	    cmd = redis_param_str(cmd, XRANGE, XRANGE_LEN);
-	}
-	cmd = redis_param_sds(cmd, key);
-	cmd = redis_param_sds(cmd, start);
-	cmd = redis_param_sds(cmd, end);
-	if (reverse) {
-	    cmd = redis_param_str(cmd, "COUNT", sizeof("COUNT")-1);
-	    cmd = redis_param_str(cmd, revbuf, revlen);
-	}
-	sdsfree(key);
-	redisSlotsRequest(baton->slots, cmd,
-				series_prepare_time_reply, sid);
-	sdsfree(cmd);
+	series_prepare_time_values(baton, sid, tier);
     }
-    sdsfree(start);
-    sdsfree(end);
 }
 
 static void
@@ -1739,19 +1990,10 @@ series_report_set(seriesQueryBaton *baton, node_t *np)
 }
 
 static void
-series_query_report_matches(void *arg)
+series_query_report_matches_done(seriesQueryBaton *baton, int has_function)
 {
-    seriesQueryBaton	*baton = (seriesQueryBaton *)arg;
-    int			has_function = 0;
     char		hashbuf[42];
 
-    seriesBatonCheckMagic(baton, MAGIC_QUERY, "series_query_report_matches");
-    seriesBatonCheckCount(baton, "series_query_report_matches");
-
-    seriesBatonReference(baton, "series_query_report_matches");
-
-    has_function = series_calculate(baton->query.root, 0, arg);
-
     /*
      * Store the canonical query to Redis if this query statement has
      * function operation.
@@ -1763,6 +2005,18 @@ series_query_report_matches(void *arg)
     series_query_end_phase(baton);
 }
 
+static void
+series_query_report_matches(void *arg)
+{
+    seriesQueryBaton	*baton = (seriesQueryBaton *)arg;
+
+    seriesBatonCheckMagic(baton, MAGIC_QUERY, "series_query_report_matches");
+    seriesBatonCheckCount(baton, "series_query_report_matches");
+
+    seriesBatonReference(baton, "series_query_report_matches");
+    series_calculate_async(baton, series_query_report_matches_done);
+}
+
 static void
 series_query_maps(void *arg)
 {
@@ -1772,7 +2026,8 @@ series_query_maps(void *arg)
     seriesBatonCheckCount(baton, "series_query_maps");
 
     seriesBatonReference(baton, "series_query_maps");
-    series_prepare_maps(baton, baton->query.root, 0);
+    if (!baton->query.cached)
+	series_prepare_maps(baton, baton->query.root, 0);
     series_query_end_phase(baton);
 }
 
@@ -1785,7 +2040,8 @@ series_query_eval(void *arg)
     seriesBatonCheckCount(baton, "series_query_eval");
 
     seriesBatonReference(baton, "series_query_eval");
-    series_prepare_eval(baton, baton->query.root, 0);
+    if (!baton->query.cached)
+	series_prepare_eval(baton, baton->query.root, 0);
     series_query_end_phase(baton);
 }
 
@@ -1798,7 +2054,12 @@ series_query_expr(void *arg)
     seriesBatonCheckCount(baton, "series_query_expr");
 
     seriesBatonReference(baton, "series_query_expr");
-    series_prepare_expr(baton, baton->query.root, 0);
+    if (!baton->query.cached) {
+	series_prepare_expr(baton, baton->query.root, 0);
+	if (baton->query.cachekey && baton->error == 0)
+	    series_query_cache_store(baton->query.cachekey,
+				    &baton->query.root->result);
+    }
     series_query_end_phase(baton);
 }
 
@@ -2384,6 +2645,7 @@ series_expr_canonical(node_t *np, int idx)
     case N_TOPK_SAMPLE:
     case N_NTH_PERCENTILE_INST:
     case N_NTH_PERCENTILE_SAMPLE:
+    case N_QUANTILE_APPROX:
 	left = series_expr_canonical(np->left, idx);
 	right = series_expr_canonical(np->right, idx);
 	break;
@@ -2398,6 +2660,7 @@ series_expr_canonical(node_t *np, int idx)
     case N_FLOOR:
     case N_SQRT:
     case N_ROUND:
+    case N_COUNT_DISTINCT_APPROX:
 	left = series_expr_canonical(np->left, idx);
 	right = NULL;
 	break;
@@ -2484,6 +2747,12 @@ series_expr_canonical(node_t *np, int idx)
     case N_NTH_PERCENTILE_SAMPLE:
 	statement = sdscatfmt(sdsempty(), "nth_percentile_inst(%S, %S)", left, right);
 	break;
+    case N_QUANTILE_APPROX:
+	statement = sdscatfmt(sdsempty(), "quantile_approx(%S, %S)", left, right);
+	break;
+    case N_COUNT_DISTINCT_APPROX:
+	statement = sdscatfmt(sdsempty(), "count_distinct_approx(%S)", left);
+	break;
     case N_ANON:
 	break;
     case N_RATE:
@@ -2610,6 +2879,15 @@ series_node_values_report(seriesQueryBaton *baton, node_t *np)
     }
 }
 
+/* pmUnitsStr_r variant, the calculation functions run in worker threads */
+static sds
+series_units_str(pmUnits *units)
+{
+    char		buffer[64];
+
+    return sdsnew(pmUnitsStr_r(units, buffer, sizeof(buffer)));
+}
+
 static int
 series_rate_check(pmSeriesDesc desc)
 {
@@ -2702,7 +2980,7 @@ series_calculate_rate(node_t *np, void *arg)
 	units.scaleTime = PM_TIME_SEC;
 	np->value_set.series_values[i].series_desc.type = sdsnew("double");
 	np->value_set.series_values[i].series_desc.semantics = sdsnew("instant");
-	np->value_set.series_values[i].series_desc.units = sdsnew(pmUnitsStr(&units));
+	np->value_set.series_values[i].series_desc.units = series_units_str(&units);
     }
 }
 
@@ -3117,7 +3395,7 @@ series_calculate_rescale(node_t *np, void *arg)
 	    }
 	}
 	sdsfree(np->value_set.series_values[i].series_desc.units);
-	np->value_set.series_values[i].series_desc.units = sdsnew(pmUnitsStr(&np->right->meta.units));
+	np->value_set.series_values[i].series_desc.units = series_units_str(&np->right->meta.units);
     }
 }
 
@@ -3366,6 +3644,162 @@ series_calculate_topk(node_t *np, void *arg)
     }
 }
 
+/*
+ * Numeric kernels for the aggregation functions below.  Sample values
+ * are decoded from their string form once, into contiguous arrays of
+ * doubles, and the kernels then operate on those arrays in simple loops
+ * (with no per-value type dispatch) the compiler is able to vectorise.
+ */
+typedef struct series_rank {
+    double		value;
+    unsigned int	index;		/* sample or instance index */
+} series_rank_t;
+
+/*
+ * Decode the values of one instance across all samples (a column) or
+ * of all instances in one sample (a row) into a contiguous array.
+ * Samples with an unexpected number of instances are skipped, and the
+ * number of values decoded is returned.
+ */
+static unsigned int
+series_decode_column(seriesQueryBaton *baton, series_sample_set_t *set,
+		unsigned int n_instances, unsigned int k, series_rank_t *out)
+{
+    unsigned int	j, count = 0;
+    sds			msg;
+
+    for (j = 0; j < set->num_samples; j++) {
+	if (set->series_sample[j].num_instances != n_instances) {
+	    if (pmDebugOptions.query && pmDebugOptions.desperate) {
+		infofmt(msg, "number of instances in each sample are not equal\n");
+		batoninfo(baton, PMLOG_ERROR, msg);
+	    }
+	    continue;
+	}
+	out[count].value = strtod(set->series_sample[j].series_instance[k].data, NULL);
+	out[count].index = j;
+	count++;
+    }
+    return count;
+}
+
+static unsigned int
+series_decode_row(series_instance_set_t *sample, series_rank_t *out)
+{
+    unsigned int	k;
+
+    for (k = 0; k < sample->num_instances; k++) {
+	out[k].value = strtod(sample->series_instance[k].data, NULL);
+	out[k].index = k;
+    }
+    return sample->num_instances;
+}
+
+/*
+ * Population standard deviation, computed in two passes over the array
+ * (for numerical stability) - first the mean, then the squared errors.
+ */
+static double
+series_kernel_stdev(const series_rank_t *values, unsigned int count)
+{
+    double		sum = 0.0, mean, error, sd = 0.0;
+    unsigned int	i;
+
+    if (count == 0)
+	return 0.0;
+    for (i = 0; i < count; i++)
+	sum += values[i].value;
+    mean = sum / count;
+    for (i = 0; i < count; i++) {
+	error = values[i].value - mean;
+	sd += error * error;
+    }
+    return sqrt(sd / count);
+}
+
+/*
+ * Ordering for ranking - by value, with ties ranked by decreasing index
+ * (so in descending order the earlier of equal values comes first).
+ */
+static inline int
+series_rank_less(const series_rank_t *a, const series_rank_t *b)
+{
+    if (a->value != b->value)
+	return a->value < b->value;
+    return a->index > b->index;
+}
+
+static inline void
+series_rank_swap(series_rank_t *a, series_rank_t *b)
+{
+    series_rank_t	t = *a;
+
+    *a = *b;
+    *b = t;
+}
+
+/*
+ * Find the element of the given rank (zero-based, ascending) using an
+ * in-place quickselect partitioning - expected O(n) rather than a sort.
+ */
+static unsigned int
+series_kernel_select(series_rank_t *values, unsigned int count, unsigned int rank)
+{
+    unsigned int	lo = 0, hi = count - 1, mid, i, store;
+
+    while (lo < hi) {
+	/* median-of-three pivot, moved to values[hi] */
+	mid = lo + (hi - lo) / 2;
+	if (series_rank_less(&values[mid], &values[lo]))
+	    series_rank_swap(&values[mid], &values[lo]);
+	if (series_rank_less(&values[hi], &values[lo]))
+	    series_rank_swap(&values[hi], &values[lo]);
+	if (series_rank_less(&values[mid], &values[hi]))
+	    series_rank_swap(&values[mid], &values[hi]);
+
+	for (store = i = lo; i < hi; i++) {
+	    if (series_rank_less(&values[i], &values[hi]))
+		series_rank_swap(&values[i], &values[store++]);
+	}
+	series_rank_swap(&values[store], &values[hi]);
+
+	if (store == rank)
+	    break;
+	if (rank < store)
+	    hi = store - 1;
+	else
+	    lo = store + 1;
+    }
+    return values[rank].index;
+}
+
+/*
+ * Select the nth percentile from count decoded values out of slots
+ * samples (or instances).  Only positive values with an index of at
+ * least first are ranked, in descending order, and the one at position
+ * slots-1-rank is reported, where rank is n percent of slots (rounded
+ * down).  Positions beyond the ranked values report index zero.
+ */
+static unsigned int
+series_kernel_percentile(series_rank_t *values, unsigned int count,
+		unsigned int slots, unsigned int first, int n)
+{
+    unsigned int	ranked = 0, i;
+    int			rank, pos;
+
+    for (i = 0; i < count; i++) {
+	if (values[i].index >= first && values[i].value > 0)
+	    values[ranked++] = values[i];
+    }
+    rank = (int)((double)n / 100 * slots);
+    pos = (rank == (int)slots) ? 0 : (int)slots - 1 - rank;
+    if (pos < 0)
+	pos = 0;
+    if (pos >= (int)ranked)
+	return 0;
+    return series_kernel_select(values, ranked, ranked - 1 - pos);
+}
+
 /*
  * calculate standard deviation series per-instance over time samples
  */
@@ -3373,11 +3807,12 @@ static void
 series_calculate_time_domain_standard_deviation(node_t *np, void *arg)
 {
     seriesQueryBaton	*baton = (seriesQueryBaton *)arg;
-    unsigned int	n_series, n_samples, n_instances, i, j, k;
-    double		sum_data, mean, sd, data;
-    sds			msg;
+    unsigned int	n_series, n_samples, n_instances, count, i, j;
+    series_instance_set_t *sample;
+    series_rank_t	*values = NULL;
     pmSeriesValue	inst;
     char		stdev[64];
+    sds			msg;
 
     n_series = np->left->value_set.num_series;
     np->value_set.num_series = n_series;
@@ -3392,28 +3827,22 @@ series_calculate_time_domain_standard_deviation(node_t *np, void *arg)
 	    for (j = 0; j < n_samples; j++) {
 		np->value_set.series_values[i].series_sample[j].num_instances = 1;
 		np->value_set.series_values[i].series_sample[j].series_instance = (pmSeriesValue *)calloc(1, sizeof(pmSeriesValue));
-		sum_data = 0.0;
-		for (k = 0; k < n_instances; k++) {
-		    if (np->left->value_set.series_values[i].series_sample[j].num_instances != n_instances) {
-			if (pmDebugOptions.query && pmDebugOptions.desperate) {
-			    infofmt(msg, "number of instances in each sample are not equal\n");
-			    batoninfo(baton, PMLOG_ERROR, msg);
-			}
-		    continue;
+		sample = &np->left->value_set.series_values[i].series_sample[j];
+		if (sample->num_instances != n_instances) {
+		    if (pmDebugOptions.query && pmDebugOptions.desperate) {
+			infofmt(msg, "number of instances in each sample are not equal\n");
+			batoninfo(baton, PMLOG_ERROR, msg);
 		    }
-		    data = strtod(np->left->value_set.series_values[i].series_sample[j].series_instance[k].data, NULL);
-		    sum_data += data;
 		}
-
-		mean = sum_data/n_instances;
-		sd = 0.0;
-		for (k = 0; k < n_instances; k++) {
-		    data = strtod(np->left->value_set.series_values[i].series_sample[j].series_instance[k].data, NULL);
-		    sd += pow(data - mean, 2);
+		if (sample->num_instances <= 0) {
+		    np->value_set.series_values[i].series_sample[j].num_instances = 0;
+		    continue;
 		}
+		values = (series_rank_t *)realloc(values, sample->num_instances * sizeof(series_rank_t));
+		count = series_decode_row(sample, values);
 
-		pmsprintf(stdev, sizeof(stdev), "%le", sqrt(sd / n_instances));
-		inst = np->left->value_set.series_values[i].series_sample[j].series_instance[0];
+		pmsprintf(stdev, sizeof(stdev), "%le", series_kernel_stdev(values, count));
+		inst = sample->series_instance[0];
 		np->value_set.series_values[i].series_sample[j].series_instance[0].timestamp = sdsnew(inst.timestamp);
 		np->value_set.series_values[i].series_sample[j].series_instance[0].series = sdsnew(0);
 		np->value_set.series_values[i].series_sample[j].series_instance[0].data = sdsnew(stdev);
@@ -3432,6 +3861,7 @@ series_calculate_time_domain_standard_deviation(node_t *np, void *arg)
 	np->value_set.series_values[i].series_desc.type = sdsnew("double");
 	np->value_set.series_values[i].series_desc.units = sdsnew(np->left->value_set.series_values[i].series_desc.units);
     }
+    free(values);
 }
 
 /*
@@ -3441,49 +3871,35 @@ static void
 series_calculate_standard_deviation(node_t *np, void *arg)
 {
     seriesQueryBaton	*baton = (seriesQueryBaton *)arg;
-    unsigned int	n_series, n_samples, n_instances, i, j, k;
-    double		sum_data, data, sd, mean;
-    char		stdev[64];
-    sds			msg;
+    unsigned int	n_series, n_samples, n_instances, count, i, k;
+    series_sample_set_t	*set;
+    series_rank_t	*values;
     pmSeriesValue       inst;
+    char		stdev[64];
 
     n_series = np->left->value_set.num_series;
     np->value_set.num_series = n_series;
     np->value_set.series_values = (series_sample_set_t *)calloc(n_series, sizeof(series_sample_set_t));
     for (i = 0; i < n_series; i++) {
-	n_samples = np->left->value_set.series_values[i].num_samples;
+	set = &np->left->value_set.series_values[i];
+	n_samples = set->num_samples;
 	if (n_samples > 0) {
 	    np->value_set.series_values[i].num_samples = 1;
 	    np->value_set.series_values[i].series_sample = (series_instance_set_t *)calloc(1, sizeof(series_instance_set_t));
-	    n_instances = np->left->value_set.series_values[i].series_sample[0].num_instances;
+	    n_instances = set->series_sample[0].num_instances;
 	    np->value_set.series_values[i].series_sample[0].num_instances = n_instances;
 	    np->value_set.series_values[i].series_sample[0].series_instance = (pmSeriesValue *)calloc(n_instances, sizeof(pmSeriesValue));
+	    values = (series_rank_t *)calloc(n_samples, sizeof(series_rank_t));
 	    for (k = 0; k < n_instances; k++) {
-		sum_data = 0.0;
-		for (j = 0; j < n_samples; j++) {
-		    if (np->left->value_set.series_values[i].series_sample[j].num_instances != n_instances) {
-			if (pmDebugOptions.query && pmDebugOptions.desperate) {
-			    infofmt(msg, "number of instances in each sample are not equal\n");
-			    batoninfo(baton, PMLOG_ERROR, msg);
-			}
-			continue;
-		    }
-		    data = strtod(np->left->value_set.series_values[i].series_sample[j].series_instance[k].data, NULL);
-		    sum_data += data;
-		}
-		mean = sum_data/n_samples;
-		sd = 0.0;
-		for (j = 0; j < n_samples; j++) {
-		    data = strtod(np->left->value_set.series_values[i].series_sample[j].series_instance[k].data, NULL);
-		    sd += pow(data - mean, 2);
-		}
-		pmsprintf(stdev, sizeof(stdev), "%le", sqrt(sd / n_samples));
-		inst = np->left->value_set.series_values[i].series_sample[0].series_instance[k];
+		count = series_decode_column(baton, set, n_instances, k, values);
+		pmsprintf(stdev, sizeof(stdev), "%le", series_kernel_stdev(values, count));
+		inst = set->series_sample[0].series_instance[k];
 		np->value_set.series_values[i].series_sample[0].series_instance[k].timestamp = sdsnew(inst.timestamp);
 		np->value_set.series_values[i].series_sample[0].series_instance[k].series = sdsnew(inst.series);
 		np->value_set.series_values[i].series_sample[0].series_instance[k].data = sdsnew(stdev);
 		np->value_set.series_values[i].series_sample[0].series_instance[k].ts = inst.ts;
 	    }
+	    free(values);
 	} else {
 	    np->value_set.series_values[i].num_samples = 0;
 	}
@@ -3506,11 +3922,12 @@ static void
 series_calculate_time_domain_nth_percentile(node_t *np, void *arg)
 {
     seriesQueryBaton	*baton = (seriesQueryBaton *)arg;
-    unsigned int	n_series, n_samples, n_instances, i, j, k, l, m;
-    int			n, instance_idx, rank, *n_pointer;
-    double              *n_data, data, rank_d;
-    sds			msg;
+    unsigned int	n_series, n_samples, n_instances, count, i, j;
+    int			n;
+    series_instance_set_t *sample;
+    series_rank_t	*values = NULL;
     pmSeriesValue       inst;
+    sds			msg;
 
     sscanf(np->right->value, "%d", &n);
     n_series = np->left->value_set.num_series;
@@ -3522,48 +3939,30 @@ series_calculate_time_domain_nth_percentile(node_t *np, void *arg)
 	    np->value_set.series_values[i].num_samples = n_samples;
 	    np->value_set.series_values[i].series_sample = (series_instance_set_t *)calloc(n_samples, sizeof(series_instance_set_t));
 	    n_instances = np->left->value_set.series_values[i].series_sample[0].num_instances;
-	    rank_d = ((double)n/100 * n_instances);
-	    rank = (int) rank_d;
 	    for (j = 0; j < n_samples; j++) {
 		np->value_set.series_values[i].series_sample[j].num_instances = 1;
 		np->value_set.series_values[i].series_sample[j].series_instance = (pmSeriesValue *)calloc(1, sizeof(pmSeriesValue));
-		n_data = (double*) calloc(n_instances, sizeof(double));
-		n_pointer = (int*) calloc(n_instances, sizeof(int)); 
-
-		for (k = 0; k < n_instances; k++) {
-		    if (np->left->value_set.series_values[i].series_sample[j].num_instances != n_instances) {
-			if (pmDebugOptions.query && pmDebugOptions.desperate) {
-			    infofmt(msg, "number of instances in each sample are not equal\n");
-			    batoninfo(baton, PMLOG_ERROR, msg);
-			}
-			continue;
-		    }
-		    data = strtod(np->left->value_set.series_values[i].series_sample[j].series_instance[k].data, NULL);
-		    for (l = 0; l < n_instances; ++l){
-			if (data > n_data[l]){
-			    for (m = n_instances - 1; m > l; --m){
-				n_data[m] = n_data[m-1];
-				n_pointer[m] = n_pointer[m-1];
-			    }
-			    n_data[l] = data;
-			    n_pointer[l] = k;
-			    break;
-			}
-		    }
+		sample = &np->left->value_set.series_values[i].series_sample[j];
+		if (sample->num_instances <= 0) {
+		    np->value_set.series_values[i].series_sample[j].num_instances = 0;
+		    continue;
 		}
-
-		if (rank == n_instances) {
-		    instance_idx = n_pointer[0];
-		} else {
-		    instance_idx = n_pointer[n_instances-1-rank];
+		values = (series_rank_t *)realloc(values, sample->num_instances * sizeof(series_rank_t));
+		if (sample->num_instances != n_instances) {
+		    if (pmDebugOptions.query && pmDebugOptions.desperate) {
+			infofmt(msg, "number of instances in each sample are not equal\n");
+			batoninfo(baton, PMLOG_ERROR, msg);
+		    }
+		    count = 0;
 		}
-		inst = np->left->value_set.series_values[i].series_sample[j].series_instance[instance_idx];
+		else
+		    count = series_decode_row(sample, values);
+		inst = sample->series_instance[series_kernel_percentile(values,
+				count, n_instances, 0, n)];
 		np->value_set.series_values[i].series_sample[j].series_instance[0].timestamp = sdsnew(inst.timestamp);
 		np->value_set.series_values[i].series_sample[j].series_instance[0].series = sdsnew(inst.series);
 		np->value_set.series_values[i].series_sample[j].series_instance[0].data = sdsnew(inst.data);
 		np->value_set.series_values[i].series_sample[j].series_instance[0].ts = inst.ts;
-		free(n_data);
-		free(n_pointer);
 	    }
 	} else {
 	    np->value_set.series_values[i].num_samples = 0;
@@ -3578,6 +3977,7 @@ series_calculate_time_domain_nth_percentile(node_t *np, void *arg)
 	np->value_set.series_values[i].series_desc.type = sdsnew(np->left->value_set.series_values[i].series_desc.type);
 	np->value_set.series_values[i].series_desc.units = sdsnew(np->left->value_set.series_values[i].series_desc.units);
     }
+    free(values);
 }
 
 /*
@@ -3587,10 +3987,10 @@ static void
 series_calculate_nth_percentile(node_t *np, void *arg)
 {
     seriesQueryBaton	*baton = (seriesQueryBaton *)arg;
-    unsigned int	n_series, n_samples, n_instances, i, j, k, l, m;
-    int			n, instance_idx, rank, *n_pointer;
-    double              *n_data, data, rank_d;
-    sds			msg;
+    unsigned int	n_series, n_samples, n_instances, count, i, j, k;
+    int			n;
+    series_sample_set_t	*set;
+    series_rank_t	*values;
     pmSeriesValue       inst;
 
     sscanf(np->right->value, "%d", &n);
@@ -3599,53 +3999,26 @@ series_calculate_nth_percentile(node_t *np, void *arg)
     np->value_set.num_series = n_series;
     np->value_set.series_values = (series_sample_set_t *)calloc(n_series, sizeof(series_sample_set_t));
     for (i = 0; i < n_series; i++) {
-	n_samples = np->left->value_set.series_values[i].num_samples;
+	set = &np->left->value_set.series_values[i];
+	n_samples = set->num_samples;
 	if (n_samples > 0) {
 	    np->value_set.series_values[i].num_samples = 1;
 	    np->value_set.series_values[i].series_sample = (series_instance_set_t *)calloc(1, sizeof(series_instance_set_t));
-	    n_instances = np->left->value_set.series_values[i].series_sample[0].num_instances;
+	    n_instances = set->series_sample[0].num_instances;
 	    np->value_set.series_values[i].series_sample[0].num_instances = n_instances;
 	    np->value_set.series_values[i].series_sample[0].series_instance = (pmSeriesValue *)calloc(n_instances, sizeof(pmSeriesValue));
-	    rank_d = ((double)n/100 * n_samples);
-	    rank = (int) rank_d;
+	    values = (series_rank_t *)calloc(n_samples, sizeof(series_rank_t));
 	    for (k = 0; k < n_instances; k++) {
-		n_data = (double*) calloc(n_samples, sizeof(double));
-		n_pointer = (int*) calloc(n_samples, sizeof(int)); 
-
-		for (j = 1; j < n_samples; j++) {
-		    if (np->left->value_set.series_values[i].series_sample[j].num_instances != n_instances) {
-			if (pmDebugOptions.query && pmDebugOptions.desperate) {
-			    infofmt(msg, "number of instances in each sample are not equal\n");
-			    batoninfo(baton, PMLOG_ERROR, msg);
-			}
-			continue;
-		    }
-		    data = atof(np->left->value_set.series_values[i].series_sample[j].series_instance[k].data);
-		    for (l = 0; l < n_samples; ++l){
-			if (data > n_data[l]) {
-			    for (m = n_samples - 1; m > l; --m){
-				n_data[m] = n_data[m-1];
-				n_pointer[m] = n_pointer[m-1];
-			    }
-			    n_data[l] = data;
-			    n_pointer[l] = j;
-			    break;
-			}
-		    }
-		}
-		if (rank == n_samples) {
-		    instance_idx = n_pointer[0];
-		} else {
-		    instance_idx = n_pointer[n_samples-1-rank];
-		}
-		inst = np->left->value_set.series_values[i].series_sample[instance_idx].series_instance[k];
+		count = series_decode_column(baton, set, n_instances, k, values);
+		/* the first sample is not ranked */
+		j = series_kernel_percentile(values, count, n_samples, 1, n);
+		inst = set->series_sample[j].series_instance[k];
 		np->value_set.series_values[i].series_sample[0].series_instance[k].timestamp = sdsnew(inst.timestamp);
 		np->value_set.series_values[i].series_sample[0].series_instance[k].series = sdsnew(inst.series);
 		np->value_set.series_values[i].series_sample[0].series_instance[k].data = sdsnew(inst.data);
 		np->value_set.series_values[i].series_sample[0].series_instance[k].ts = inst.ts;
-		free(n_data);
-		free(n_pointer);
 	    }
+	    free(values);
 	} else {
 	    np->value_set.series_values[i].num_samples = 0;
 	}
@@ -3661,6 +4034,106 @@ series_calculate_nth_percentile(node_t *np, void *arg)
     }
 }
 
+/*
+ * Shared setup for the approximate functions, which reduce all values
+ * of a series (across instances and time) to one value, reported with
+ * the timestamp of the most recent sample.
+ */
+static void
+series_approx_result(node_t *np, int i, sds data, const char *type, const char *units)
+{
+    series_sample_set_t	*set = &np->left->value_set.series_values[i];
+    pmSeriesValue	*inst;
+
+    if (set->num_samples > 0 && set->series_sample[0].num_instances > 0) {
+	inst = &set->series_sample[0].series_instance[0];
+	np->value_set.series_values[i].num_samples = 1;
+	np->value_set.series_values[i].series_sample = (series_instance_set_t *)calloc(1, sizeof(series_instance_set_t));
+	np->value_set.series_values[i].series_sample[0].num_instances = 1;
+	np->value_set.series_values[i].series_sample[0].series_instance = (pmSeriesValue *)calloc(1, sizeof(pmSeriesValue));
+	np->value_set.series_values[i].series_sample[0].series_instance[0].timestamp = sdsnew(inst->timestamp);
+	np->value_set.series_values[i].series_sample[0].series_instance[0].series = sdsnew(0);
+	np->value_set.series_values[i].series_sample[0].series_instance[0].data = data;
+	np->value_set.series_values[i].series_sample[0].series_instance[0].ts = inst->ts;
+    } else {
+	np->value_set.series_values[i].num_samples = 0;
+	sdsfree(data);
+    }
+    np->value_set.series_values[i].sid = (seriesGetSID *)calloc(1, sizeof(seriesGetSID));
+    np->value_set.series_values[i].sid->name = sdsnew(set->sid->name);
+    np->value_set.series_values[i].baton = set->baton;
+    np->value_set.series_values[i].series_desc.indom = sdsnew(set->series_desc.indom);
+    np->value_set.series_values[i].series_desc.pmid = sdsnew(set->series_desc.pmid);
+    np->value_set.series_values[i].series_desc.semantics = sdsnew("instant");
+    np->value_set.series_values[i].series_desc.source = sdsnew(set->series_desc.source);
+    np->value_set.series_values[i].series_desc.type = sdsnew(type);
+    np->value_set.series_values[i].series_desc.units = sdsnew(units ? units : set->series_desc.units);
+}
+
+/*
+ * estimate the nth percentile of all values in each series, using a
+ * quantile sketch of bounded size (relative error SKETCH_ACCURACY)
+ */
+static void
+series_calculate_quantile_approx(node_t *np, void *arg)
+{
+    unsigned int	n_series, i, j, k;
+    series_sample_set_t	*set;
+    quantileSketch	sketch;
+    char		value[64];
+    int			n;
+
+    sscanf(np->right->value, "%d", &n);
+    n_series = np->left->value_set.num_series;
+    np->value_set.num_series = n_series;
+    np->value_set.series_values = (series_sample_set_t *)calloc(n_series, sizeof(series_sample_set_t));
+    for (i = 0; i < n_series; i++) {
+	set = &np->left->value_set.series_values[i];
+	quantileSketchInit(&sketch);
+	for (j = 0; j < set->num_samples; j++)
+	    for (k = 0; k < set->series_sample[j].num_instances; k++)
+		quantileSketchAdd(&sketch, strtod(set->series_sample[j].series_instance[k].data, NULL));
+	pmsprintf(value, sizeof(value), "%le", quantileSketchQuery(&sketch, (double)n / 100));
+	quantileSketchFree(&sketch);
+	series_approx_result(np, i, sdsnew(value), "double", NULL);
+    }
+    (void)arg;
+}
+
+/*
+ * estimate the number of distinct values in each series, using a
+ * fixed size (HyperLogLog) sketch of the hashed value strings
+ */
+static void
+series_calculate_count_distinct_approx(node_t *np, void *arg)
+{
+    unsigned int	n_series, i, j, k;
+    series_sample_set_t	*set;
+    distinctSketch	*sketch;
+    sds			data;
+
+    if ((sketch = calloc(1, sizeof(distinctSketch))) == NULL)
+	return;
+    n_series = np->left->value_set.num_series;
+    np->value_set.num_series = n_series;
+    np->value_set.series_values = (series_sample_set_t *)calloc(n_series, sizeof(series_sample_set_t));
+    for (i = 0; i < n_series; i++) {
+	set = &np->left->value_set.series_values[i];
+	distinctSketchInit(sketch);
+	for (j = 0; j < set->num_samples; j++) {
+	    for (k = 0; k < set->series_sample[j].num_instances; k++) {
+		data = set->series_sample[j].series_instance[k].data;
+		distinctSketchAdd(sketch, data, sdslen(data));
+	    }
+	}
+	data = sdscatfmt(sdsempty(), "%U", (unsigned long long)
+			llround(distinctSketchQuery(sketch)));
+	series_approx_result(np, i, data, "u64", "count");
+    }
+    free(sketch);
+    (void)arg;
+}
+
 /*
  * calculate sum or avg in the time series for each sample across time
  */
@@ -4478,7 +4951,7 @@ series_binary_meta_update(node_t *left, pmUnits *large_units, int *l_sem, int *r
 
     /* Update units */
     sdsfree(left->value_set.series_values[0].series_desc.units);
-    left->value_set.series_values[0].series_desc.units = sdsnew(pmUnitsStr(large_units));
+    left->value_set.series_values[0].series_desc.units = series_units_str(large_units);
 
     /*
      * If the semantics of both operands is not a counter
@@ -4863,6 +5336,12 @@ series_calculate(node_t *np, int level, void *arg)
     case N_NTH_PERCENTILE_SAMPLE:
 	series_calculate_time_domain_nth_percentile(np, arg);
 	break;
+    case N_QUANTILE_APPROX:
+	series_calculate_quantile_approx(np, arg);
+	break;
+    case N_COUNT_DISTINCT_APPROX:
+	series_calculate_count_distinct_approx(np, arg);
+	break;
     default:
 	sts = 0;	/* no function */
 	break;
@@ -4870,6 +5349,98 @@ series_calculate(node_t *np, int level, void *arg)
     return sts;
 }
 
+/*
+ * Diagnostics from the calculation functions are queued while they
+ * run in a worker thread, and passed on from the event loop thread
+ * once the calculation completes.
+ */
+static void
+series_calculate_info(pmLogLevel level, sds message, void *arg)
+{
+    seriesQueryBaton	*baton = (seriesQueryBaton *)arg;
+    seriesGetCalculate	*calculate = &baton->calculate;
+    seriesQueryInfo	*infos;
+    size_t		bytes;
+
+    bytes = (calculate->ninfo + 1) * sizeof(seriesQueryInfo);
+    if ((infos = realloc(calculate->infos, bytes)) == NULL)
+	return;
+    infos[calculate->ninfo].level = level;
+    infos[calculate->ninfo].message = sdsdup(message);
+    calculate->infos = infos;
+    calculate->ninfo++;
+}
+
+static void
+series_calculate_finished(seriesQueryBaton *baton)
+{
+    seriesGetCalculate	*calculate = &baton->calculate;
+    unsigned int	i;
+
+    baton->info = calculate->info;
+    baton->userdata = calculate->userdata;
+    for (i = 0; i < calculate->ninfo; i++)
+	batoninfo(baton, calculate->infos[i].level, calculate->infos[i].message);
+    free(calculate->infos);
+    calculate->infos = NULL;
+    calculate->ninfo = 0;
+
+    calculate->done(baton, calculate->sts);
+}
+
+#if defined(HAVE_LIBUV)
+/* this function runs in a worker thread */
+static void
+series_calculate_work(uv_work_t *req)
+{
+    seriesQueryBaton	*baton = (seriesQueryBaton *)req->data;
+
+    baton->calculate.sts = series_calculate(baton->query.root, 0, baton);
+}
+
+/* this function runs in the main thread */
+static void
+series_calculate_work_done(uv_work_t *req, int status)
+{
+    seriesQueryBaton	*baton = (seriesQueryBaton *)req->data;
+
+    free(req);
+    series_calculate_finished(baton);
+}
+#endif
+
+/*
+ * Evaluate the function nodes of the parse tree, on a worker thread
+ * when an event loop is available so that wide queries do not stall
+ * other clients, then continue with the given completion callback.
+ */
+static void
+series_calculate_async(seriesQueryBaton *baton, seriesCalculateDone done)
+{
+    seriesGetCalculate	*calculate = &baton->calculate;
+#if defined(HAVE_LIBUV)
+    seriesModuleData	*data = getSeriesModuleData(baton->module);
+    uv_work_t		*req;
+#endif
+
+    calculate->done = done;
+    calculate->info = baton->info;
+    calculate->userdata = baton->userdata;
+    baton->info = series_calculate_info;
+    baton->userdata = baton;
+
+#if defined(HAVE_LIBUV)
+    if (data && data->events && (req = malloc(sizeof(uv_work_t))) != NULL) {
+	req->data = baton;
+	uv_queue_work(data->events, req, series_calculate_work,
+			series_calculate_work_done);
+	return;
+    }
+#endif
+    calculate->sts = series_calculate(baton->query.root, 0, baton);
+    series_calculate_finished(baton);
+}
+
 static int
 check_compatibility(pmUnits *units_a, pmUnits *units_b)
 {
@@ -5053,20 +5624,10 @@ series_query_report_values(void *arg)
 }
 
 static void
-series_query_funcs_report_values(void *arg)
+series_query_funcs_report_values_done(seriesQueryBaton *baton, int has_function)
 {
-    seriesQueryBaton	*baton = (seriesQueryBaton *)arg;
-    int			has_function = 0;
     char		hashbuf[42];
 
-    seriesBatonCheckMagic(baton, MAGIC_QUERY, "series_query_funcs_report_values");
-    seriesBatonCheckCount(baton, "series_query_funcs_report_values");
-
-    seriesBatonReference(baton, "series_query_funcs_report_values");
-
-    /* For function-type nodes, calculate actual values */
-    has_function = series_calculate(baton->query.root, 0, baton->userdata);
-
     /*
      * Store the canonical query to Redis if this query statement has
      * function operation.
@@ -5080,6 +5641,20 @@ series_query_funcs_report_values(void *arg)
     series_query_end_phase(baton);
 }
 
+static void
+series_query_funcs_report_values(void *arg)
+{
+    seriesQueryBaton	*baton = (seriesQueryBaton *)arg;
+
+    seriesBatonCheckMagic(baton, MAGIC_QUERY, "series_query_funcs_report_values");
+    seriesBatonCheckCount(baton, "series_query_funcs_report_values");
+
+    seriesBatonReference(baton, "series_query_funcs_report_values");
+
+    /* For function-type nodes, calculate actual values */
+    series_calculate_async(baton, series_query_funcs_report_values_done);
+}
+
 static void
 series_query_funcs(void *arg)
 {
@@ -5166,6 +5741,16 @@ series_solve(pmSeriesSettings *settings,
     initSeriesQueryBaton(baton, settings, arg);
     initSeriesGetQuery(baton, root, timing);
 
+    /* Matching series sets for pure label expressions may be cached */
+    if (querycacheexpire && series_query_cacheable(root)) {
+	baton->query.cachekey = series_query_cache_key(sdsempty(), root);
+	baton->query.cached = series_query_cache_lookup(
+				baton->query.cachekey, &root->result);
+	if (pmDebugOptions.query && baton->query.cached)
+	    fprintf(stderr, "%s: cached %u series for \"%s\"\n", "series_solve",
+			root->result.nseries, baton->query.cachekey);
+    }
+
     baton->current = &baton->phases[0];
     baton->phases[i++].func = series_query_services;
 
@@ -80,6 +80,8 @@ typedef enum nodetype {
     N_LOG,
     N_SQRT,
     N_ROUND,
+    N_QUANTILE_APPROX,
+    N_COUNT_DISTINCT_APPROX,
 
 /* node_t time-related sub-types */
     N_RANGE = 100,
@@ -107,6 +109,7 @@ typedef struct seriesGetSID {
     sds			metric;		/* back-pointer for instance series */
     /* various flags */
     unsigned int	freed : 1;	/* freed individually on completion */
+    unsigned int	rollup : 1;	/* values requested from a rollup tier */
     void		*baton;
 } seriesGetSID;
 
@@ -198,6 +201,7 @@ extern int series_parse(sds, series_t *, char **);
 extern int series_solve(pmSeriesSettings *, node_t *, timing_t *, pmSeriesFlags, void *);
 extern int series_load(pmSeriesSettings *, node_t *, timing_t *, pmSeriesFlags, void *);
 extern void series_stats_inc(pmSeriesSettings *, unsigned int);
+extern void seriesQueryCacheClose(void);
 
 extern const char *series_instance_name(sds);
 extern const char *series_context_name(sds);
@@ -128,6 +128,8 @@ static char *l_type_str(int);
 %token      L_TOPK_SAMPLE
 %token      L_NTH_PERCENTILE_INST
 %token      L_NTH_PERCENTILE_SAMPLE
+%token      L_QUANTILE_APPROX
+%token      L_COUNT_DISTINCT_APPROX
 %token      L_ANON
 %token      L_RATE
 %token      L_INSTANT
@@ -600,6 +602,42 @@ func_sid
 		  lp->yy_np->right = $5;
 		  $$ = lp->yy_series.expr = lp->yy_np;
 		}
+	| L_QUANTILE_APPROX L_LPAREN sid_vec L_COMMA integer L_RPAREN
+		{ char *ptr;
+		  long ret;
+		  ret = strtoul($5->value, &ptr, 10);
+		  if (*ptr != '\0' || ret < 0 || ret > 100){
+			series_error(lp, NULL);
+			return -1;
+		  }
+		  lp->yy_np = newnode(N_QUANTILE_APPROX);
+		  lp->yy_np->left = $3;
+		  lp->yy_np->right = $5;
+		  $$ = lp->yy_series.expr = lp->yy_np;
+		}
+	| L_QUANTILE_APPROX L_LPAREN func_sid L_COMMA integer L_RPAREN
+		{ char *ptr;
+		  long ret;
+		  ret = strtoul($5->value, &ptr, 10);
+		  if (*ptr != '\0' || ret < 0 || ret > 100){
+			series_error(lp, NULL);
+			return -1;
+		  }
+		  lp->yy_np = newnode(N_QUANTILE_APPROX);
+		  lp->yy_np->left = $3;
+		  lp->yy_np->right = $5;
+		  $$ = lp->yy_series.expr = lp->yy_np;
+		}
+	| L_COUNT_DISTINCT_APPROX L_LPAREN sid_vec L_RPAREN
+		{ lp->yy_np = newnode(N_COUNT_DISTINCT_APPROX);
+		  lp->yy_np->left = $3;
+		  $$ = lp->yy_series.expr = lp->yy_np;
+		}
+	| L_COUNT_DISTINCT_APPROX L_LPAREN func_sid L_RPAREN
+		{ lp->yy_np = newnode(N_COUNT_DISTINCT_APPROX);
+		  lp->yy_np->left = $3;
+		  $$ = lp->yy_series.expr = lp->yy_np;
+		}
 	| L_AVG L_LPAREN sid_vec L_RPAREN
 		{ lp->yy_np = newnode(N_AVG);
 		  lp->yy_np->left = $3;
@@ -1115,6 +1153,42 @@ func	: L_RATE L_LPAREN val_vec L_RPAREN
 		  lp->yy_np->right = $5;
 		  $$ = lp->yy_series.expr = lp->yy_np;
 		}
+	| L_QUANTILE_APPROX L_LPAREN val_vec L_COMMA integer L_RPAREN
+		{ char *ptr;
+		  long ret;
+		  ret = strtoul($5->value, &ptr, 10);
+		  if (*ptr != '\0' || ret < 0 || ret > 100){
+			series_error(lp, NULL);
+			return -1;
+		  }
+		  lp->yy_np = newnode(N_QUANTILE_APPROX);
+		  lp->yy_np->left = $3;
+		  lp->yy_np->right = $5;
+		  $$ = lp->yy_series.expr = lp->yy_np;
+		}
+	| L_QUANTILE_APPROX L_LPAREN func L_COMMA integer L_RPAREN
+		{ char *ptr;
+		  long ret;
+		  ret = strtoul($5->value, &ptr, 10);
+		  if (*ptr != '\0' || ret < 0 || ret > 100){
+			series_error(lp, NULL);
+			return -1;
+		  }
+		  lp->yy_np = newnode(N_QUANTILE_APPROX);
+		  lp->yy_np->left = $3;
+		  lp->yy_np->right = $5;
+		  $$ = lp->yy_series.expr = lp->yy_np;
+		}
+	| L_COUNT_DISTINCT_APPROX L_LPAREN val_vec L_RPAREN
+		{ lp->yy_np = newnode(N_COUNT_DISTINCT_APPROX);
+		  lp->yy_np->left = $3;
+		  $$ = lp->yy_series.expr = lp->yy_np;
+		}
+	| L_COUNT_DISTINCT_APPROX L_LPAREN func L_RPAREN
+		{ lp->yy_np = newnode(N_COUNT_DISTINCT_APPROX);
+		  lp->yy_np->left = $3;
+		  $$ = lp->yy_series.expr = lp->yy_np;
+		}
 	| L_AVG L_LPAREN val_vec L_RPAREN
 		{ lp->yy_np = newnode(N_AVG);
 		  lp->yy_np->left = $3;
@@ -1301,6 +1375,8 @@ static const struct {
     { L_TOPK_SAMPLE,	sizeof("topk_sample")-1,	"topk_sample" },
     { L_NTH_PERCENTILE_INST,	sizeof("nth_percentile_inst")-1,	"nth_percentile_inst" },
     { L_NTH_PERCENTILE_SAMPLE,	sizeof("nth_percentile_sample")-1,	"nth_percentile_sample" },
+    { L_QUANTILE_APPROX,	sizeof("quantile_approx")-1,	"quantile_approx" },
+    { L_COUNT_DISTINCT_APPROX,	sizeof("count_distinct_approx")-1,	"count_distinct_approx" },
     { L_RATE,		sizeof("rate")-1,	"rate" },
     { L_ABS,		sizeof("abs")-1,	"abs" },
     { L_FLOOR,		sizeof("floor")-1,	"floor" },
@@ -1364,6 +1440,8 @@ static struct {
     { L_TOPK_SAMPLE,	N_TOPK_SAMPLE,	"TOPK_SAMPLE",	NULL },
     { L_NTH_PERCENTILE_INST,	N_NTH_PERCENTILE_INST,	"NTH_PERCENTILE_INST",	NULL },
     { L_NTH_PERCENTILE_SAMPLE, N_NTH_PERCENTILE_SAMPLE, "NTH_PERCENTILE_SAMPLE", NULL },
+    { L_QUANTILE_APPROX,	N_QUANTILE_APPROX,	"QUANTILE_APPROX",	NULL },
+    { L_COUNT_DISTINCT_APPROX, N_COUNT_DISTINCT_APPROX, "COUNT_DISTINCT_APPROX", NULL },
     { L_ANON,		N_ANON,		"ANON",		NULL },
     { L_RATE,		N_RATE,		"RATE",		NULL },
     { L_INSTANT,	N_INSTANT,	"INSTANT",	NULL },
@@ -2199,6 +2277,7 @@ series_dumpexpr(node_t *np, int level)
     case N_AVG_INST: case N_AVG_SAMPLE: case N_SUM_INST: case N_SUM_SAMPLE:
     case N_STDEV_INST: case N_STDEV_SAMPLE: case N_NTH_PERCENTILE_INST:
     case N_NTH_PERCENTILE_SAMPLE: case N_TOPK_INST: case N_TOPK_SAMPLE: 
+    case N_QUANTILE_APPROX: case N_COUNT_DISTINCT_APPROX:
 	fprintf(stderr, "%*s%s()", level*4, "", n_type_str(np->type));
 	break;
     case N_SCALE: {
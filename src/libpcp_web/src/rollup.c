@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2022 Red Hat.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+#include "rollup.h"
+
+const rollupTier rollupTiers[ROLLUP_TIERS] = {
+    { .name = "1m",	.seconds = 60 },
+    { .name = "10m",	.seconds = 600 },
+    { .name = "1h",	.seconds = 3600 },
+};
+
+int
+rollup_type(int type)
+{
+    switch (type) {
+    case PM_TYPE_32:
+    case PM_TYPE_U32:
+    case PM_TYPE_64:
+    case PM_TYPE_U64:
+    case PM_TYPE_FLOAT:
+    case PM_TYPE_DOUBLE:
+	return 1;
+    default:
+	break;
+    }
+    return 0;
+}
+
+/*
+ * Select the coarsest tier whose interval fits within the requested
+ * sampling interval, or -1 if the raw values are needed.
+ */
+int
+rollup_tier(struct timespec *delta)
+{
+    int			tier;
+
+    for (tier = ROLLUP_TIERS - 1; tier >= 0; tier--)
+	if (delta->tv_sec >= rollupTiers[tier].seconds)
+	    return tier;
+    return -1;
+}
+
+static __uint64_t
+rollup_index(sds stamp, unsigned int tier)
+{
+    /* stream stamps are milliseconds, optionally followed by -fraction */
+    return strtoull(stamp, NULL, 10) / (rollupTiers[tier].seconds * 1000ULL);
+}
+
+/*
+ * Return a bitmap of the tiers with an interval completed by a sample
+ * at the given time - these are to be written before rollup_update.
+ */
+unsigned int
+rollup_closed(metric_t *metric, sds stamp)
+{
+    rollupBucket	*bucket;
+    unsigned int	tier, closed = 0;
+
+    if (metric->rollup == NULL)
+	return 0;
+    for (tier = 0; tier < ROLLUP_TIERS; tier++) {
+	bucket = &metric->rollup->tiers[tier];
+	if (bucket->count && bucket->index != rollup_index(stamp, tier))
+	    closed |= (1 << tier);
+    }
+    return closed;
+}
+
+static double
+rollup_value(int type, pmAtomValue *atom)
+{
+    switch (type) {
+    case PM_TYPE_32:
+	return (double)atom->l;
+    case PM_TYPE_U32:
+	return (double)atom->ul;
+    case PM_TYPE_64:
+	return (double)atom->ll;
+    case PM_TYPE_U64:
+	return (double)atom->ull;
+    case PM_TYPE_FLOAT:
+	return (double)atom->f;
+    case PM_TYPE_DOUBLE:
+	return atom->d;
+    default:
+	break;
+    }
+    return 0.0;
+}
+
+static void
+rollup_sample(rollupBucket *bucket, unsigned int hint,
+		int inst, int type, pmAtomValue *atom)
+{
+    rollupStat		*stat = NULL;
+    unsigned int	i, size;
+    double		value;
+
+    /* instances are usually in the same order from one sample to the next */
+    if (hint < bucket->count && bucket->stats[hint].inst == inst)
+	stat = &bucket->stats[hint];
+    for (i = 0; stat == NULL && i < bucket->count; i++)
+	if (bucket->stats[i].inst == inst)
+	    stat = &bucket->stats[i];
+
+    if (stat == NULL) {
+	if (bucket->count == bucket->size) {
+	    size = bucket->size ? bucket->size * 2 : 1;
+	    if ((stat = realloc(bucket->stats, size * sizeof(rollupStat))) == NULL)
+		return;
+	    bucket->stats = stat;
+	    bucket->size = size;
+	}
+	stat = &bucket->stats[bucket->count++];
+	memset(stat, 0, sizeof(*stat));
+	stat->inst = inst;
+    }
+
+    value = rollup_value(type, atom);
+    if (stat->count == 0 || value < stat->min)
+	stat->min = value;
+    if (stat->count == 0 || value > stat->max)
+	stat->max = value;
+    stat->sum += value;
+    stat->last = *atom;
+    stat->count++;
+}
+
+/*
+ * Accumulate the current values of a metric into each tier, starting
+ * a new interval (discarding completed ones) where necessary.
+ */
+void
+rollup_update(metric_t *metric, sds stamp)
+{
+    rollupBucket	*bucket;
+    valuelist_t		*vlist;
+    unsigned int	tier, i;
+    __uint64_t		index;
+    int			type = metric->desc.type;
+
+    if (metric->rollup == NULL &&
+	(metric->rollup = calloc(1, sizeof(rollup_t))) == NULL)
+	return;
+
+    for (tier = 0; tier < ROLLUP_TIERS; tier++) {
+	bucket = &metric->rollup->tiers[tier];
+	if ((index = rollup_index(stamp, tier)) != bucket->index) {
+	    bucket->index = index;
+	    bucket->count = 0;
+	}
+	bucket->stamp = bucket->stamp ?
+			sdscpylen(bucket->stamp, stamp, sdslen(stamp)) :
+			sdsdup(stamp);
+
+	if (metric->desc.indom == PM_INDOM_NULL) {
+	    rollup_sample(bucket, 0, PM_IN_NULL, type, &metric->u.atom);
+	    continue;
+	}
+	if ((vlist = metric->u.vlist) == NULL)
+	    continue;
+	for (i = 0; i < vlist->listcount; i++)
+	    rollup_sample(bucket, i, vlist->value[i].inst, type,
+			    &vlist->value[i].atom);
+    }
+}
+
+void
+rollup_free(rollup_t *rollup)
+{
+    unsigned int	tier;
+
+    if (rollup == NULL)
+	return;
+    for (tier = 0; tier < ROLLUP_TIERS; tier++) {
+	sdsfree(rollup->tiers[tier].stamp);
+	free(rollup->tiers[tier].stats);
+    }
+    free(rollup);
+}
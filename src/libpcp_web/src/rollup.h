@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2022 Red Hat.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+#ifndef SERIES_ROLLUP_H
+#define SERIES_ROLLUP_H
+
+#include "load.h"
+
+/*
+ * Downsampled (rollup) tiers of time series values, accumulated while
+ * loading and written to pcp:rollup:<tier>:series:<sid> streams as each
+ * tier interval completes.  Entries are stamped with the last sample in
+ * the interval, and carry the same instance:value fields as the values
+ * streams (holding the last value), so they can be read in their place,
+ * plus min:, max:, avg: and count: prefixed fields for each instance.
+ */
+#define ROLLUP_TIERS	3
+
+typedef struct rollupTier {
+    const char		*name;		/* stream key component */
+    unsigned int	seconds;	/* width of each interval */
+} rollupTier;
+
+extern const rollupTier rollupTiers[ROLLUP_TIERS];
+
+typedef struct rollupStat {
+    int			inst;		/* internal instance identifier */
+    unsigned int	count;		/* samples in this interval */
+    double		min;
+    double		max;
+    double		sum;
+    pmAtomValue		last;		/* most recent value (numeric) */
+} rollupStat;
+
+typedef struct rollupBucket {
+    __uint64_t		index;		/* interval number (time / width) */
+    sds			stamp;		/* stream stamp of the last sample */
+    unsigned int	count;		/* instances in use */
+    unsigned int	size;		/* instances allocated */
+    rollupStat		*stats;
+} rollupBucket;
+
+typedef struct rollup {
+    rollupBucket	tiers[ROLLUP_TIERS];
+} rollup_t;
+
+extern int rollup_type(int);
+extern int rollup_tier(struct timespec *);
+extern unsigned int rollup_closed(metric_t *, sds);
+extern void rollup_update(metric_t *, sds);
+extern void rollup_free(rollup_t *);
+
+#endif	/* SERIES_ROLLUP_H */
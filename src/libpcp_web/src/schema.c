@@ -19,13 +19,20 @@
 #include "discover.h"
 #include "util.h"
 #include "sha1.h"
+#include "rollup.h"
 
 #define STRINGIFY(s)	#s
 #define TO_STRING(s)	STRINGIFY(s)
 #define SERIES_VERSION	2
 #define REDIS_VERSION	5
 
+#define DEFAULT_DISCOVER_WINDOW	100	/* msec to coalesce change events */
+#define DEFAULT_DISCOVER_INTERVAL 60	/* sec between offset checkpoints */
+
 extern sds		cursorcount;
+extern unsigned int	streamrollup;
+extern unsigned int	querycacheexpire;
+extern unsigned int	seriesgeneration;
 static sds		maxstreamlen;
 static sds		streamexpire;
 static sds		DEFAULT_CURSORCOUNT;
@@ -803,6 +810,38 @@ redis_series_source_callback(
     doneSeriesLoadBaton(arg, "redis_series_source_callback");
 }
 
+/*
+ * Check whether metadata for all names of a metric (or one of its
+ * instances) has been written before, by any load context, else note
+ * that it is being written now.  The series identifiers are hashes of
+ * that metadata, so known identifiers need no further metadata writes.
+ */
+static int
+redis_series_cached(metric_t *metric, instance_t *instance)
+{
+    unsigned char		key[40];
+    int				i, known = 1;
+
+    if (instance) {
+	memcpy(key, metric->names[0].hash, 20);
+	memcpy(key + 20, instance->name.hash, 20);
+	if (redisSeriesCacheLookup(key, sizeof(key)))
+	    return 1;
+	redisSeriesCacheInsert(key, sizeof(key));
+	seriesgeneration++;	/* invalidates cached query sets */
+	return 0;
+    }
+    for (i = 0; i < metric->numnames; i++) {
+	if (redisSeriesCacheLookup(metric->names[i].hash, 20))
+	    continue;
+	redisSeriesCacheInsert(metric->names[i].hash, 20);
+	known = 0;
+    }
+    if (!known)
+	seriesgeneration++;	/* invalidates cached query sets */
+    return known;
+}
+
 static void
 redis_series_metadata(context_t *context, metric_t *metric, void *arg)
 {
@@ -814,10 +853,12 @@ redis_series_metadata(context_t *context, metric_t *metric, void *arg)
     char			ibuf[32], pbuf[32], sbuf[20], tbuf[20], ubuf[60];
     char			hashbuf[42];
     sds				cmd, key;
-    int				i;
+    int				i, known = 0;
 
     if (metric->cached)
 	goto check_instances;
+    if ((known = redis_series_cached(metric, NULL)) != 0)
+	goto check_instances;
 
     indom = pmwebapi_indom_str(metric, ibuf, sizeof(ibuf));
     pmid = pmwebapi_pmid_str(metric, pbuf, sizeof(pbuf));
@@ -902,7 +943,8 @@ check_instances:
 
     if (metric->desc.indom == PM_INDOM_NULL || metric->u.vlist == NULL) {
 	if (metric->cached == 0) {
-	    redis_series_labelset(slots, metric, NULL, baton);
+	    if (!known)
+		redis_series_labelset(slots, metric, NULL, baton);
 	    metric->cached = 1;
 	}
     } else {
@@ -910,7 +952,8 @@ check_instances:
 	    value = &metric->u.vlist->value[i];
 	    if ((instance = dictFetchValue(metric->indom->insts, &value->inst)) == NULL)
 		continue;
-	    if (instance->cached == 0 || metric->cached == 0) {
+	    if ((instance->cached == 0 || metric->cached == 0) &&
+		redis_series_cached(metric, instance) == 0) {
 		redis_series_instance(slots, metric, instance, baton);
 		redis_series_labelset(slots, metric, instance, baton);
 
@@ -1121,7 +1164,7 @@ redis_series_stream(redisSlots *slots, sds stamp, metric_t *metric,
     cmd = redis_param_raw(cmd, stream);
     sdsfree(key);
     sdsfree(stream);
-    redisSlotsRequest(slots, cmd, redis_series_stream_callback, baton);
+    redisSlotsRequestBatch(slots, cmd, redis_series_stream_callback, baton);
     sdsfree(cmd);
 
     key = sdscatfmt(sdsempty(), "pcp:values:series:%s", hash);
@@ -1130,7 +1173,87 @@ redis_series_stream(redisSlots *slots, sds stamp, metric_t *metric,
     cmd = redis_param_sds(cmd, key);
     cmd = redis_param_sds(cmd, streamexpire);
     sdsfree(key);
-    redisSlotsRequest(slots, cmd, redis_series_timer_callback, load);
+    redisSlotsRequestBatch(slots, cmd, redis_series_timer_callback, load);
+    sdsfree(cmd);
+}
+
+/*
+ * Write one completed rollup tier interval of a series, see rollup.h.
+ */
+static void
+redis_series_rollup(redisSlots *slots, unsigned int tier, metric_t *metric,
+		const char *hash, void *arg)
+{
+    seriesLoadBaton		*load = (seriesLoadBaton *)arg;
+    rollupBucket		*bucket = &metric->rollup->tiers[tier];
+    redisStreamBaton		*baton;
+    rollupStat			*stat;
+    instance_t			*inst;
+    unsigned int		i, count;
+    int				type = metric->desc.type;
+    sds				cmd, key, name, field, stream = sdsempty();
+
+    if ((baton = malloc(sizeof(redisStreamBaton))) == NULL) {
+	stream = sdscatfmt(stream, "OOM creating rollup stream baton");
+	batoninfo(load, PMLOG_ERROR, stream);
+	return;
+    }
+    initRedisStreamBaton(baton, slots, bucket->stamp, hash, load);
+    seriesBatonReferences(load, 2, "redis_series_rollup");
+
+    count = 6;	/* XADD key MAXLEN ~ len stamp */
+    key = sdscatfmt(sdsempty(), "pcp:rollup:%s:series:%s",
+			rollupTiers[tier].name, hash);
+
+    name = sdsempty();
+    field = sdsempty();
+    for (i = 0; i < bucket->count; i++) {
+	stat = &bucket->stats[i];
+	if (stat->inst == PM_IN_NULL) {
+	    sdsclear(name);
+	} else if (metric->indom == NULL ||
+	    (inst = dictFetchValue(metric->indom->insts, &stat->inst)) == NULL) {
+	    continue;
+	} else {
+	    name = sdscpylen(name, (const char *)inst->name.hash,
+				sizeof(inst->name.hash));
+	}
+	stream = series_stream_value(stream, name, type, &stat->last);
+	field = sdscatsds(sdscpylen(field, "min:", 4), name);
+	stream = series_stream_append(stream, field,
+			sdscatprintf(sdsempty(), "%e", stat->min));
+	field = sdscatsds(sdscpylen(field, "max:", 4), name);
+	stream = series_stream_append(stream, field,
+			sdscatprintf(sdsempty(), "%e", stat->max));
+	field = sdscatsds(sdscpylen(field, "avg:", 4), name);
+	stream = series_stream_append(stream, field,
+			sdscatprintf(sdsempty(), "%e", stat->sum / stat->count));
+	field = sdscatsds(sdscpylen(field, "count:", 6), name);
+	stream = series_stream_append(stream, field,
+			sdscatfmt(sdsempty(), "%u", stat->count));
+	count += 10;
+    }
+    sdsfree(field);
+    sdsfree(name);
+
+    cmd = redis_command(count);
+    cmd = redis_param_str(cmd, XADD, XADD_LEN);
+    cmd = redis_param_sds(cmd, key);
+    cmd = redis_param_str(cmd, "MAXLEN", sizeof("MAXLEN")-1);
+    cmd = redis_param_str(cmd, "~", 1);
+    cmd = redis_param_sds(cmd, maxstreamlen);
+    cmd = redis_param_sds(cmd, bucket->stamp);
+    cmd = redis_param_raw(cmd, stream);
+    sdsfree(stream);
+    redisSlotsRequestBatch(slots, cmd, redis_series_stream_callback, baton);
+    sdsfree(cmd);
+
+    cmd = redis_command(3);	/* EXPIRE key timer */
+    cmd = redis_param_str(cmd, EXPIRE, EXPIRE_LEN);
+    cmd = redis_param_sds(cmd, key);
+    cmd = redis_param_sds(cmd, streamexpire);
+    sdsfree(key);
+    redisSlotsRequestBatch(slots, cmd, redis_series_timer_callback, load);
     sdsfree(cmd);
 }
 
@@ -1140,12 +1263,24 @@ redis_series_streamed(sds stamp, metric_t *metric, void *arg)
     seriesLoadBaton		*baton= (seriesLoadBaton *)arg;
     redisSlots			*slots = baton->slots;
     char			hashbuf[42];
-    int				i;
+    unsigned int		closed = 0, tier;
+    int				i, rollup;
+
+    rollup = streamrollup && metric->error == 0 &&
+		rollup_type(metric->desc.type);
+    if (rollup)
+	closed = rollup_closed(metric, stamp);
 
     for (i = 0; i < metric->numnames; i++) {
 	pmwebapi_hash_str(metric->names[i].hash, hashbuf, sizeof(hashbuf));
 	redis_series_stream(slots, stamp, metric, hashbuf, arg);
+	for (tier = 0; closed && tier < ROLLUP_TIERS; tier++)
+	    if (closed & (1 << tier))
+		redis_series_rollup(slots, tier, metric, hashbuf, arg);
     }
+
+    if (rollup)
+	rollup_update(metric, stamp);
 }
 
 void
@@ -1546,11 +1681,23 @@ redisSeriesInit(struct dict *config)
 	else	/* default value: 1 day (without changes) */
 	    streamexpire = DEFAULT_STREAMEXPIRE = sdsnew("86400");
     }
+
+    if ((option = pmIniFileLookup(config, "pmseries", "stream.rollup")))
+	streamrollup = (strcmp(option, "true") == 0);
+
+    if ((option = pmIniFileLookup(config, "pmseries", "query.cache.expire")))
+	querycacheexpire = strtoul(option, NULL, 10);
+    else	/* default value: 1 minute */
+	querycacheexpire = 60;
+
+    if ((option = pmIniFileLookup(config, "pmseries", "cache.series")))
+	redisSeriesCacheSetLimit(strtoul(option, NULL, 10));
 }
 
 static void
 redisSeriesClose(void)
 {
+    seriesQueryCacheClose();
     if (DEFAULT_CURSORCOUNT) {
 	sdsfree(DEFAULT_CURSORCOUNT);
 	DEFAULT_CURSORCOUNT = NULL;
@@ -1640,6 +1787,16 @@ pmSeriesSetupMetrics(pmSeriesModule *module)
 	"calls to /series/load",
 	"total RESTAPI calls to /series/load");
 
+    mmv_stats_add_metric(data->registry, "load.records", 10,
+	MMV_TYPE_U64, MMV_SEM_COUNTER, countunits, MMV_INDOM_NULL,
+	"archive records loaded",
+	"total archive records written to the series store by loads");
+
+    mmv_stats_add_metric(data->registry, "load.archives", 11,
+	MMV_TYPE_U64, MMV_SEM_COUNTER, countunits, MMV_INDOM_NULL,
+	"archives loaded",
+	"total archives (or archive time windows) completely loaded");
+
     data->map = map = mmv_stats_start(data->registry);
     metrics = data->metrics;
 
@@ -1661,6 +1818,10 @@ pmSeriesSetupMetrics(pmSeriesModule *module)
 						"labelvalues.calls", NULL);
     metrics[SERIES_LOAD_CALLS] = mmv_lookup_value_desc(map,
 						"load.calls", NULL);
+    metrics[SERIES_LOAD_RECORDS] = mmv_lookup_value_desc(map,
+						"load.records", NULL);
+    metrics[SERIES_LOAD_ARCHIVES] = mmv_lookup_value_desc(map,
+						"load.archives", NULL);
 }
 
 int
@@ -1892,6 +2053,11 @@ pmDiscoverSetupMetrics(pmDiscoverModule *module)
 	"error result records decoded for monitored archives",
 	"Total errors in result records decoded for monitored archives");
 
+    mmv_stats_add_metric(data->registry, "coalesced_changed_callbacks", 22,
+	MMV_TYPE_U64, MMV_SEM_COUNTER, countunits, MMV_INDOM_NULL,
+	"filesystem changed callbacks coalesced within a window",
+	"Number of filesystem change callbacks merged with a pending change to the same path");
+
     data->map = map = mmv_stats_start(data->registry);
     metrics = data->metrics;
 
@@ -1937,6 +2103,8 @@ pmDiscoverSetupMetrics(pmDiscoverModule *module)
 				    map, "metadata.partial_reads", NULL);
     metrics[DISCOVER_DECODE_RESULT_ERRORS] = mmv_lookup_value_desc(
 				    map, "logvol.decode.result_errors", NULL);
+    metrics[DISCOVER_COALESCED_CALLBACKS] = mmv_lookup_value_desc(
+				    map, "coalesced_changed_callbacks", NULL);
 }
 
 int
@@ -1977,6 +2145,22 @@ pmDiscoverSetup(pmDiscoverModule *module, pmDiscoverCallBacks *cbs, void *arg)
     if ((option = pmIniFileLookup(config, "discover", "path")))
 	logdir = option;
 
+    /* milliseconds over which filesystem change events are coalesced */
+    data->window = DEFAULT_DISCOVER_WINDOW;
+    if ((option = pmIniFileLookup(config, "discover", "events.window")))
+	data->window = strtoul(option, NULL, 0);
+
+    /* archive offsets saved for resuming after a restart */
+    if ((option = pmIniFileLookup(config, "discover", "checkpoint")) == NULL)
+	data->checkpoint = sdscatfmt(sdsempty(), "%s%cpmproxy%cdiscover.offsets",
+		pmGetConfig("PCP_LOG_DIR"), pmPathSeparator(), pmPathSeparator());
+    else if (*option != '\0')
+	data->checkpoint = sdsnew(option);
+    data->interval = DEFAULT_DISCOVER_INTERVAL;
+    if ((option = pmIniFileLookup(config, "discover", "checkpoint.interval")))
+	data->interval = strtoul(option, NULL, 0);
+    pmDiscoverLoadCheckpoint(data);
+
     /* prepare for optional metric and indom exclusion */
     if ((option = pmIniFileLookup(config, "discover", "exclude.metrics"))) {
 	if ((data->pmids = dictCreate(&intKeyDictCallBacks, NULL)) == NULL)
@@ -2018,6 +2202,7 @@ pmDiscoverSetup(pmDiscoverModule *module, pmDiscoverCallBacks *cbs, void *arg)
 	sts = pmDiscoverRegister(logdir, module, cbs, arg);
 	if (sts >= 0) {
 	    data->handle = sts;
+	    pmDiscoverStartCheckpoint(data);
 	    return 0;
 	}
     }
@@ -2032,6 +2217,10 @@ pmDiscoverClose(pmDiscoverModule *module)
 
     if (discover) {
 	pmDiscoverUnregister(discover->handle);
+	pmDiscoverCloseTimers(discover);
+	sdsfree(discover->checkpoint);
+	if (discover->offsets)
+	    dictRelease(discover->offsets);
 	if (discover->slots && !discover->shareslots)
 	    redisSlotsFree(discover->slots);
 	for (i = 0; i < discover->exclude_names; i++)
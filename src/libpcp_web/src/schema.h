@@ -127,6 +127,12 @@ typedef struct seriesGetContext {
     context_t		context;
     unsigned long long	count;		/* number of samples processed */
     pmHighResResult	*result;	/* currently active sample data */
+    pmHighResResult	**ahead;	/* results read ahead by worker */
+    pmHighResResult	**batch;	/* results being written to Redis */
+    unsigned int	nahead;		/* number of results in ahead[] */
+    int			aheaderror;	/* PMAPI error code from read ahead */
+    unsigned int	reading : 1;	/* worker thread filling ahead[] */
+    unsigned int	writing : 1;	/* writes of a batch outstanding */
     int			loaded;		/* end of archive data reached */
     int			error;		/* PMAPI error code from fetch */
 
@@ -149,6 +155,7 @@ typedef struct seriesLoadBaton {
     pmLogInfoCallBack	info;
     void		*userdata;
     timing_t		timing;
+    unsigned int	window;		/* archive records read per batch */
 
     unsigned int	nmetrics;	/* number of metric names passed */
     const char		**metrics;	/* metric specification strings */
@@ -176,6 +183,8 @@ enum {
     SERIES_LABELS_CALLS,
     SERIES_LABELVALUES_CALLS,
     SERIES_LOAD_CALLS,
+    SERIES_LOAD_RECORDS,
+    SERIES_LOAD_ARCHIVES,
     NUM_SERIES_METRIC
 };
 
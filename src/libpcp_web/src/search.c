@@ -18,6 +18,7 @@
 #include "search.h"
 #include "util.h"
 #include "sha1.h"
+#include "textindex.h"
 
 static sds		resultcount_str;
 static sds		DEFAULT_RESULTCOUNT;
@@ -77,7 +78,7 @@ redis_search_docid(const char *key, const char *type, const char *name)
  * This issue isn't fixed in OSS version of RediSearch we are using, 
  * https://github.com/RediSearch/RediSearch/issues/748
  */
-static int
+int
 redis_search_is_stopword(sds s)
 {
     size_t			i;
@@ -201,6 +202,13 @@ redis_search_text_add(redisSlots *slots, pmSearchTextType type,
     if (pmDebugOptions.search)
 	fprintf(stderr, "%s: %s %s\n", "redis_search_text_add", typestr, name);
 
+    if (slots->textindex) {
+	docid = redis_search_docid(FT_TEXT_KEY, typestr, name);
+	textIndexAdd(type, docid, name, indom, oneline, helptext);
+	sdsfree(docid);
+	return;
+    }
+
     seriesBatonReference(context, "redis_search_text_add");
 
     /*
@@ -460,9 +468,16 @@ pmSearchInfo(pmSearchSettings *settings, sds key, void *arg)
 {
     seriesModuleData	*data = getSeriesModuleData(&settings->module);
     redisSearchBaton	*baton;
+    pmSearchMetrics	metrics;
 
     if (data == NULL)
 	return -ENOMEM;
+    if (data->slots && data->slots->textindex) {
+	textIndexMetrics(&metrics);
+	settings->callbacks.on_metrics(&metrics, arg);
+	settings->callbacks.on_done(0, arg);
+	return 0;
+    }
     if ((baton = calloc(1, sizeof(redisSearchBaton))) == NULL)
 	return -ENOMEM;
     initRedisSearchBaton(baton, data->slots, settings, arg);
@@ -531,6 +546,26 @@ extract_search_results(redisSearchBaton *baton,
     }
 }
 
+/*
+ * Answer a query from the embedded text index, synchronously - used
+ * when the RediSearch module is not available in the key server.
+ */
+static int
+text_index_search(pmSearchSettings *settings,
+		pmSearchTextRequest *request, textIndexMode mode, void *arg)
+{
+    struct timespec	started;
+    int			sts;
+
+    pmtimespecNow(&started);
+    if (request->count == 0)
+	request->count = resultcount;
+    sts = textIndexSearch(request, mode, &started,
+			settings->callbacks.on_text_result, arg);
+    settings->callbacks.on_done(sts < 0 ? sts : 0, arg);
+    return 0;
+}
+
 static void
 redis_search_text_query_callback(
 	redisClusterAsyncContext *c, void *r, void *arg)
@@ -738,6 +773,8 @@ pmSearchTextQuery(pmSearchSettings *settings, pmSearchTextRequest *request, void
 
     if (data == NULL)
 	return -ENOMEM;
+    if (data->slots && data->slots->textindex)
+	return text_index_search(settings, request, TEXT_INDEX_QUERY, arg);
     if ((baton = calloc(1, sizeof(redisSearchBaton))) == NULL)
 	return -ENOMEM;
     initRedisSearchBaton(baton, data->slots, settings, arg);
@@ -844,6 +881,8 @@ pmSearchTextSuggest(pmSearchSettings *settings, pmSearchTextRequest *request, vo
 
     if (data == NULL)
 	return -ENOMEM;
+    if (data->slots && data->slots->textindex)
+	return text_index_search(settings, request, TEXT_INDEX_SUGGEST, arg);
     if ((baton = calloc(1, sizeof(redisSearchBaton))) == NULL)
 	return -ENOMEM;
     initRedisSearchBaton(baton, data->slots, settings, arg);
@@ -920,6 +959,8 @@ pmSearchTextInDom(pmSearchSettings *settings, pmSearchTextRequest *request, void
 
     if (data == NULL)
 	return -ENOMEM;
+    if (data->slots && data->slots->textindex)
+	return text_index_search(settings, request, TEXT_INDEX_INDOM, arg);
     if ((baton = calloc(1, sizeof(redisSearchBaton))) == NULL)
 	return -ENOMEM;
     initRedisSearchBaton(baton, data->slots, settings, arg);
@@ -939,14 +980,21 @@ redis_search_schema_callback(
     if (testReplyError(reply, REDIS_EDROPINDEX)) {
 	// index already exists
 	baton->slots->search = 1;
+	baton->slots->textindex = 0;
     }
     else if (reply && reply->type == REDIS_REPLY_STATUS &&
 	(strcmp("OK", reply->str) == 0 || strcmp("QUEUED", reply->str) == 0)) {
 	// index created
 	baton->slots->search = 1;
+	baton->slots->textindex = 0;
+    } else if (textIndexEnabled()) {
+	// probably no RediSearch module installed, use embedded index
+	baton->slots->search = 1;
+	baton->slots->textindex = 1;
     } else {
 	// probably no RediSearch module installed, ignore silently
 	baton->slots->search = 0;
+	baton->slots->textindex = 0;
     }
 
     redis_slots_end_phase(baton);
@@ -1044,6 +1092,7 @@ redisSearchInit(struct dict *config)
 	    resultcount_str = DEFAULT_RESULTCOUNT = sdsnew("10");
 	resultcount = atoi(resultcount_str);
     }
+    textIndexInit(config);
 }
 
 void
@@ -1053,6 +1102,7 @@ redisSearchClose(void)
 	sdsfree(DEFAULT_RESULTCOUNT);
 	DEFAULT_RESULTCOUNT = NULL;
     }
+    textIndexClose();
 }
 
 int
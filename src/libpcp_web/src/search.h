@@ -86,6 +86,7 @@
 extern void redisSearchInit(struct dict *);
 extern void redisSearchClose(void);
 extern void redis_load_search_schema(void *);
+extern int redis_search_is_stopword(sds);
 extern void redis_search_text_add(redisSlots *, pmSearchTextType,
 		const char *, const char *, const char *, const char *, void *);
 
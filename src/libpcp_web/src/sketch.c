@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2022 Red Hat.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sketch.h"
+#include "dict.h"
+
+#define SKETCH_MINVALUE	1.0e-9		/* smallest value given a bucket */
+
+void
+quantileSketchInit(quantileSketch *sketch)
+{
+    memset(sketch, 0, sizeof(*sketch));
+    sketch->gamma = (1.0 + SKETCH_ACCURACY) / (1.0 - SKETCH_ACCURACY);
+    sketch->lngamma = log(sketch->gamma);
+}
+
+void
+quantileSketchFree(quantileSketch *sketch)
+{
+    free(sketch->positive.bins);
+    free(sketch->negative.bins);
+    memset(sketch, 0, sizeof(*sketch));
+}
+
+/*
+ * Resize a store to cover bucket keys low through high (inclusive),
+ * folding the counts of any buckets below low into the lowest bucket.
+ */
+static int
+sketch_store_resize(sketchStore *store, int low, int high)
+{
+    __uint64_t		*bins;
+    unsigned int	i, nbins = high - low + 1;
+    int			key;
+
+    if ((bins = calloc(nbins, sizeof(__uint64_t))) == NULL)
+	return -ENOMEM;
+    for (i = 0; i < store->nbins; i++) {
+	if ((key = store->offset + i) < low)
+	    key = low;
+	bins[key - low] += store->bins[i];
+    }
+    free(store->bins);
+    store->bins = bins;
+    store->nbins = nbins;
+    store->offset = low;
+    return 0;
+}
+
+static void
+sketch_store_add(sketchStore *store, int key)
+{
+    int			low, high;
+
+    if (store->nbins == 0) {
+	low = high = key;
+    } else {
+	low = store->offset;
+	high = store->offset + store->nbins - 1;
+	if (key >= low && key <= high) {
+	    store->bins[key - low]++;
+	    return;
+	}
+	if (key < low)
+	    low = key;
+	else
+	    high = key;
+    }
+    /* bound memory use by collapsing the lowest buckets */
+    if (high - low + 1 > SKETCH_MAXBINS)
+	low = high - SKETCH_MAXBINS + 1;
+    if (key < low)
+	key = low;
+    if (sketch_store_resize(store, low, high) == 0)
+	store->bins[key - low]++;
+}
+
+static int
+sketch_key(quantileSketch *sketch, double value)
+{
+    return (int)ceil(log(value) / sketch->lngamma);
+}
+
+static double
+sketch_value(quantileSketch *sketch, int key)
+{
+    return 2.0 * pow(sketch->gamma, key) / (sketch->gamma + 1.0);
+}
+
+void
+quantileSketchAdd(quantileSketch *sketch, double value)
+{
+    if (isnan(value))
+	return;
+    if (sketch->count == 0 || value < sketch->min)
+	sketch->min = value;
+    if (sketch->count == 0 || value > sketch->max)
+	sketch->max = value;
+    sketch->count++;
+
+    if (value > SKETCH_MINVALUE)
+	sketch_store_add(&sketch->positive, sketch_key(sketch, value));
+    else if (value < -SKETCH_MINVALUE)
+	sketch_store_add(&sketch->negative, sketch_key(sketch, -value));
+    else
+	sketch->zeros++;
+}
+
+/*
+ * Estimate the value at quantile q (0.0 to 1.0) - walk from the most
+ * negative bucket, through zeros, up to the most positive until the
+ * rank of the quantile has been passed.
+ */
+double
+quantileSketchQuery(quantileSketch *sketch, double q)
+{
+    double		rank, value = 0.0;
+    __uint64_t		total = 0;
+    int			i;
+
+    if (sketch->count == 0)
+	return NAN;
+    if (q <= 0.0)
+	return sketch->min;
+    if (q >= 1.0)
+	return sketch->max;
+    rank = q * (sketch->count - 1);
+
+    for (i = (int)sketch->negative.nbins - 1; i >= 0; i--) {
+	if ((total += sketch->negative.bins[i]) > rank) {
+	    value = -sketch_value(sketch, sketch->negative.offset + i);
+	    goto found;
+	}
+    }
+    if ((total += sketch->zeros) > rank)
+	goto found;
+    for (i = 0; i < (int)sketch->positive.nbins; i++) {
+	if ((total += sketch->positive.bins[i]) > rank) {
+	    value = sketch_value(sketch, sketch->positive.offset + i);
+	    goto found;
+	}
+    }
+    value = sketch->max;
+
+found:
+    /* estimates never fall outside the observed range */
+    if (value < sketch->min)
+	value = sketch->min;
+    if (value > sketch->max)
+	value = sketch->max;
+    return value;
+}
+
+void
+distinctSketchInit(distinctSketch *sketch)
+{
+    memset(sketch, 0, sizeof(*sketch));
+}
+
+void
+distinctSketchAdd(distinctSketch *sketch, const char *value, size_t length)
+{
+    __uint64_t		hash = dictGenHashFunction(value, (int)length);
+    unsigned int	index = hash >> (64 - SKETCH_PRECISION);
+    unsigned char	rank = 1;
+
+    /* rank is the position of the first set bit in the remaining bits */
+    hash <<= SKETCH_PRECISION;
+    while (rank <= 64 - SKETCH_PRECISION && (hash & (1ULL << 63)) == 0) {
+	hash <<= 1;
+	rank++;
+    }
+    if (rank > sketch->registers[index])
+	sketch->registers[index] = rank;
+}
+
+/*
+ * Harmonic mean estimate, with linear counting for small cardinalities
+ * (where many registers remain empty).
+ */
+double
+distinctSketchQuery(distinctSketch *sketch)
+{
+    const unsigned int	m = 1 << SKETCH_PRECISION;
+    const double	alpha = 0.7213 / (1.0 + 1.079 / m);
+    unsigned int	i, zeros = 0;
+    double		sum = 0.0, estimate;
+
+    for (i = 0; i < m; i++) {
+	sum += ldexp(1.0, -(int)sketch->registers[i]);
+	if (sketch->registers[i] == 0)
+	    zeros++;
+    }
+    estimate = alpha * m * m / sum;
+    if (estimate <= 2.5 * m && zeros != 0)
+	estimate = m * log((double)m / zeros);
+    return estimate;
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2022 Red Hat.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+#ifndef SERIES_SKETCH_H
+#define SERIES_SKETCH_H
+
+#include "pmapi.h"
+
+/*
+ * Fixed-size summaries of time series values, used by the approximate
+ * query functions.  A quantile sketch (DDSketch) maps each value into
+ * a logarithmically sized bucket bounding the relative error of any
+ * quantile estimate; once too many buckets are in use the lowest are
+ * collapsed together.  A distinct count sketch (HyperLogLog) keeps the
+ * maximum leading zero run of hashed values in a set of registers.
+ */
+#define SKETCH_ACCURACY		0.01	/* relative quantile error bound */
+#define SKETCH_MAXBINS		2048	/* buckets for each sign of value */
+#define SKETCH_PRECISION	12	/* log2 of distinct count registers */
+
+typedef struct sketchStore {
+    int			offset;		/* key of the first bucket */
+    unsigned int	nbins;
+    __uint64_t		*bins;
+} sketchStore;
+
+typedef struct quantileSketch {
+    double		gamma;		/* bucket boundary growth factor */
+    double		lngamma;
+    double		min;
+    double		max;
+    __uint64_t		count;
+    __uint64_t		zeros;		/* values too small for buckets */
+    sketchStore		positive;
+    sketchStore		negative;	/* keyed by absolute value */
+} quantileSketch;
+
+typedef struct distinctSketch {
+    unsigned char	registers[1 << SKETCH_PRECISION];
+} distinctSketch;
+
+extern void quantileSketchInit(quantileSketch *);
+extern void quantileSketchAdd(quantileSketch *, double);
+extern double quantileSketchQuery(quantileSketch *, double);
+extern void quantileSketchFree(quantileSketch *);
+
+extern void distinctSketchInit(distinctSketch *);
+extern void distinctSketchAdd(distinctSketch *, const char *, size_t);
+extern double distinctSketchQuery(distinctSketch *);
+
+#endif	/* SERIES_SKETCH_H */
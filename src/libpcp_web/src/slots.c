@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2017-2021 Red Hat.
+ * Copyright (c) 2017-2021,2026 Red Hat.
  *
  * This library is free software; you can redistribute it and/or modify it
  * under the terms of the GNU Lesser General Public License as published
@@ -28,6 +28,9 @@ static int redisClusterLibuvAttach() { return REDIS_OK; }
 
 static char default_server[] = "localhost:6379";
 
+#define DEFAULT_BATCHSIZE	256	/* stream writes queued per batch */
+#define DEFAULT_BATCHDELAY	10	/* milliseconds before a flush */
+
 static void
 redis_connect_callback(const redisAsyncContext *redis, int status)
 {
@@ -121,6 +124,11 @@ redisSlotsSetupMetrics(redisSlots *slots)
 	"total bytes received in responses",
 	"Cumulative count of bytes received in Redis responses");
 
+    mmv_stats_add_metric(slots->registry, "requests.batches", 10,
+	MMV_TYPE_U64, MMV_SEM_COUNTER, units_count, MMV_INDOM_NULL,
+	"number of request batches",
+	"Total number of batches of queued Redis requests sent");
+
     slots->map = map = mmv_stats_start(slots->registry);
 
     table = slots->metrics;
@@ -142,6 +150,8 @@ redisSlotsSetupMetrics(redisSlots *slots)
 					"requests.total_bytes", NULL);
     table[SLOT_RESPONSES_TOTAL_BYTES] = mmv_lookup_value_desc(map,
 					"responses.total_bytes", NULL);
+    table[SLOT_REQUESTS_BATCHES] = mmv_lookup_value_desc(map,
+					"requests.batches", NULL);
 }
 
 int
@@ -162,6 +172,7 @@ redisSlotsInit(dict *config, void *events)
     sds			def_servers = NULL;
     sds			username = NULL;
     sds			password = NULL;
+    sds			option;
     int			sts = 0;
     struct timeval	connection_timeout = {5, 0}; // 5s
     struct timeval	command_timeout = {60, 0}; // 1m
@@ -195,6 +206,23 @@ redisSlotsInit(dict *config, void *events)
     if (password == NULL)
 	password = pmIniFileLookup(config, "pmseries", "auth.password");
 
+    /* stream writes are batched, bounded in both size and latency */
+    if ((option = pmIniFileLookup(config, "pmseries", "stream.batchsize")))
+	slots->batchsize = strtoul(option, NULL, 10);
+    else
+	slots->batchsize = DEFAULT_BATCHSIZE;
+    if ((option = pmIniFileLookup(config, "pmseries", "stream.batchdelay")))
+	slots->batchdelay = strtoul(option, NULL, 10);
+    else
+	slots->batchdelay = DEFAULT_BATCHDELAY;
+#if defined(HAVE_LIBUV)
+    if (slots->batchsize > 1 && events &&
+	(slots->batchtimer = malloc(sizeof(uv_timer_t))) != NULL) {
+	uv_timer_init((uv_loop_t *)events, slots->batchtimer);
+	((uv_timer_t *)slots->batchtimer)->data = slots;
+    }
+#endif
+
     if ((slots->acc = redisClusterAsyncContextInit()) == NULL) {
 	/* Coverity CID370635 */
 	pmNotifyErr(LOG_ERR, "%s: %s failed\n",
@@ -304,6 +332,9 @@ redisSlotsReconnect(redisSlots *slots, redisSlotsFlags flags,
     slots->state = SLOTS_CONNECTING;
     slots->conn_seq++;
 
+    /* server contents may differ now, so write all metadata afresh */
+    redisSeriesCacheReset();
+
     /* reset Redis context in case of reconnect */
     if (slots->acc->err) {
 	/* reset possible 'Connection refused' error before reconnecting */
@@ -315,6 +346,7 @@ redisSlotsReconnect(redisSlots *slots, redisSlotsFlags flags,
     /* reset redisSlots in case of reconnect */
     slots->cluster = 0;
     slots->search = 0;
+    slots->textindex = 0;
     dictEmpty(slots->keymap, NULL);
 
     sts = redisClusterConnect2(slots->acc->cc);
@@ -388,9 +420,22 @@ redisSlotsConnect(dict *config, redisSlotsFlags flags,
     return slots;
 }
 
+#if defined(HAVE_LIBUV)
+static void
+redisSlotsTimerClose(uv_handle_t *handle)
+{
+    free(handle);
+}
+#endif
+
 void
 redisSlotsFree(redisSlots *slots)
 {
+    redisSlotsFlush(slots);
+#if defined(HAVE_LIBUV)
+    if (slots->batchtimer)
+	uv_close((uv_handle_t *)slots->batchtimer, redisSlotsTimerClose);
+#endif
     redisClusterAsyncDisconnect(slots->acc);
     redisClusterAsyncFree(slots->acc);
     dictRelease(slots->keymap);
@@ -430,7 +475,12 @@ redisSlotsReplyDataAlloc(redisSlots *slots, size_t req_size,
 static inline void
 redisSlotsReplyDataFree(redisSlotsReplyData *srd)
 {
-    free(srd);
+    redisSlotsBatch	*batch = srd->batch;
+
+    if (batch == NULL)
+	free(srd);
+    else if (--batch->pending == 0)
+	free(batch);
 }
 
 uint64_t
@@ -569,12 +619,26 @@ redisSlotsRequest(redisSlots *slots, const sds cmd,
     return REDIS_OK;
 }
 
+static cluster_node *
+redisSlotsFirstNode(redisSlots *slots, const char *caller)
+{
+    dictIterator	*iterator;
+    dictEntry		*entry;
+
+    iterator = dictGetSafeIterator(slots->acc->cc->nodes);
+    entry = dictNext(iterator);
+    dictReleaseIterator(iterator);
+    if (!entry) {
+	pmNotifyErr(LOG_ERR, "%s: No Redis node configured.", caller);
+	return NULL;
+    }
+    return dictGetVal(entry);
+}
+
 int
 redisSlotsRequestFirstNode(redisSlots *slots, const sds cmd,
 		redisClusterCallbackFn *callback, void *arg)
 {
-    dictIterator	*iterator;
-    dictEntry		*entry;
     cluster_node	*node;
     redisSlotsReplyData	*srd;
     uint64_t		size;
@@ -587,16 +651,9 @@ redisSlotsRequestFirstNode(redisSlots *slots, const sds cmd,
     if (UNLIKELY(slots->state != SLOTS_CONNECTED && slots->state != SLOTS_READY))
 	return -ENOTCONN;
 
-    iterator = dictGetSafeIterator(slots->acc->cc->nodes);
-    entry = dictNext(iterator);
-    dictReleaseIterator(iterator);
-    if (!entry) {
-	pmNotifyErr(LOG_ERR, "%s: No Redis node configured.",
-			"redisSlotsRequestFirstNode");
+    if ((node = redisSlotsFirstNode(slots, "redisSlotsRequestFirstNode")) == NULL)
 	return REDIS_ERR;
-    }
 
-    node = dictGetVal(entry);
     if (UNLIKELY(pmDebugOptions.desperate))
 	fprintf(stderr, "%s: sending raw redis command to node %s\n%s",
 			"redisSlotsRequestFirstNode", node->addr, cmd);
@@ -625,6 +682,127 @@ redisSlotsRequestFirstNode(redisSlots *slots, const sds cmd,
     return REDIS_OK;
 }
 
+#if defined(HAVE_LIBUV)
+static void
+redisSlotsBatchTimeout(uv_timer_t *timer)
+{
+    redisSlotsFlush((redisSlots *)timer->data);
+}
+#endif
+
+/*
+ * Queue a request for submission with others in a batch - used for the
+ * high volume stream writes.  The batch is sent once full, or within a
+ * configured delay (or explicitly via redisSlotsFlush), the replies are
+ * delivered to the callback exactly as with redisSlotsRequest.
+ */
+int
+redisSlotsRequestBatch(redisSlots *slots, const sds cmd,
+		redisClusterCallbackFn *callback, void *arg)
+{
+    redisSlotsBatch	*batch;
+    redisSlotsReplyData	*srd;
+    size_t		bytes;
+
+    if (slots->batchtimer == NULL)
+	return redisSlotsRequest(slots, cmd, callback, arg);
+
+    if (UNLIKELY(slots->state != SLOTS_CONNECTED && slots->state != SLOTS_READY))
+	return -ENOTCONN;
+
+    if ((batch = slots->batch) == NULL) {
+	bytes = sizeof(redisSlotsBatch) +
+		slots->batchsize * sizeof(batch->requests[0]);
+	if ((batch = calloc(1, bytes)) == NULL)
+	    return redisSlotsRequest(slots, cmd, callback, arg);
+	slots->batch = batch;
+#if defined(HAVE_LIBUV)
+	uv_timer_start(slots->batchtimer, redisSlotsBatchTimeout,
+			slots->batchdelay, 0);
+#endif
+    }
+
+    srd = &batch->requests[batch->count].data;
+    srd->slots = slots;
+    srd->req_size = sdslen(cmd);
+    srd->callback = callback;
+    srd->arg = arg;
+    srd->batch = batch;
+    batch->requests[batch->count++].cmd = sdsdup(cmd);
+
+    if (batch->count == slots->batchsize)
+	redisSlotsFlush(slots);
+    return REDIS_OK;
+}
+
+/* Submit all queued requests, pipelined to each Redis node */
+void
+redisSlotsFlush(redisSlots *slots)
+{
+    redisSlotsBatch	*batch = slots ? slots->batch : NULL;
+    redisSlotsReplyData	*srd;
+    cluster_node	*node = NULL;
+    unsigned int	i, count, sent = 0;
+    uint64_t		start, size, bytes = 0;
+    int			sts;
+    sds			cmd;
+
+    if (batch == NULL)
+	return;
+    slots->batch = NULL;
+#if defined(HAVE_LIBUV)
+    uv_timer_stop(slots->batchtimer);
+#endif
+
+    start = gettimeusec();
+    count = batch->pending = batch->count;
+    if (!slots->cluster)
+	node = redisSlotsFirstNode(slots, "redisSlotsFlush");
+
+    for (i = 0; i < count; i++) {
+	srd = &batch->requests[i].data;
+	cmd = batch->requests[i].cmd;
+	size = srd->req_size;
+	srd->start = start;
+	srd->conn_seq = slots->conn_seq;
+
+	if (UNLIKELY(pmDebugOptions.desperate))
+	    fprintf(stderr, "%s: sending raw redis command:\n%s",
+			    "redisSlotsFlush", cmd);
+
+	if (UNLIKELY(slots->state != SLOTS_CONNECTED && slots->state != SLOTS_READY))
+	    sts = REDIS_ERR;
+	else if (slots->cluster)
+	    sts = redisClusterAsyncFormattedCommand(slots->acc,
+			    redisSlotsReplyCallback, srd, cmd, size);
+	else if (node)
+	    sts = redisClusterAsyncFormattedCommandToNode(slots->acc, node,
+			    redisSlotsReplyCallback, srd, cmd, size);
+	else
+	    sts = REDIS_ERR;
+	sdsfree(cmd);
+
+	if (sts == REDIS_OK) {
+	    bytes += size;
+	    sent++;
+	} else {
+	    /* no reply will arrive, complete the request here instead */
+	    mmv_inc(slots->map, slots->metrics[SLOT_REQUESTS_ERROR]);
+	    srd->callback(slots->acc, NULL, srd->arg);
+	    redisSlotsReplyDataFree(srd);	/* may release the batch */
+	}
+    }
+
+    if (sent) {
+	size = sent;
+	mmv_add(slots->map, slots->metrics[SLOT_REQUESTS_INFLIGHT_BYTES], &bytes);
+	mmv_add(slots->map, slots->metrics[SLOT_REQUESTS_TOTAL_BYTES], &bytes);
+	mmv_add(slots->map, slots->metrics[SLOT_REQUESTS_INFLIGHT_TOTAL], &size);
+	mmv_add(slots->map, slots->metrics[SLOT_REQUESTS_TOTAL], &size);
+	mmv_inc(slots->map, slots->metrics[SLOT_REQUESTS_BATCHES]);
+    }
+}
+
 int
 redisSlotsProxyConnect(redisSlots *slots, redisInfoCallBack info,
 	redisReader **readerp, const char *buffer, ssize_t nread,
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2017-2020 Red Hat.
+ * Copyright (c) 2017-2020,2026 Red Hat.
  * 
  * This library is free software; you can redistribute it and/or modify it
  * under the terms of the GNU Lesser General Public License as published
@@ -45,6 +45,7 @@ enum {
     SLOT_REQUESTS_INFLIGHT_BYTES,
     SLOT_REQUESTS_TOTAL_BYTES,
     SLOT_RESPONSES_TOTAL_BYTES,
+    SLOT_REQUESTS_BATCHES,
     NUM_SLOT_METRICS
 };
 
@@ -61,13 +62,18 @@ typedef struct redisSlots {
     redisClusterAsyncContext *acc;	/* cluster context */
     redisSlotsState	state;		/* connection state */
     unsigned int	conn_seq;	/* connection sequence (incremented for every connection) */
-    unsigned int	search : 1;	/* RediSearch use enabled */
+    unsigned int	search : 1;	/* text search use enabled */
+    unsigned int	textindex : 1;	/* search via embedded text index */
     unsigned int	cluster : 1;	/* Redis cluster mode enabled */
     redisMap		*keymap;	/* map command names to key position */
     void		*events;	/* libuv event loop */
     mmv_registry_t	*registry;	/* MMV metrics for instrumentation */
     void		*map;		/* MMV mapped metric values handle */
     pmAtomValue		*metrics[NUM_SLOT_METRICS]; /* direct handle lookup */
+    unsigned int	batchsize;	/* maximum requests queued in a batch */
+    unsigned int	batchdelay;	/* maximum batch queueing time (msec) */
+    struct redisSlotsBatch *batch;	/* requests queued for submission */
+    void		*batchtimer;	/* libuv timer bounding batch delay */
 } redisSlots;
 
 /* wraps the actual Redis callback and data */
@@ -79,8 +85,23 @@ typedef struct redisSlotsReplyData {
 
     redisClusterCallbackFn	*callback;	/* actual callback */
     void			*arg;		/* actual callback args */
+    struct redisSlotsBatch	*batch;		/* containing batch, or NULL */
 } redisSlotsReplyData;
 
+/*
+ * Requests queued up for submission to Redis together, in a single
+ * allocation - stream writes from one fetch result are sent as one
+ * pipeline to each Redis node.  Freed when the last reply arrives.
+ */
+typedef struct redisSlotsBatch {
+    unsigned int		count;		/* number of queued requests */
+    unsigned int		pending;	/* requests awaiting a reply */
+    struct {
+	sds			cmd;		/* formatted request */
+	redisSlotsReplyData	data;		/* its reply data */
+    } requests[];
+} redisSlotsBatch;
+
 typedef void (*redisPhase)(redisSlots *, void *);	/* phased operations */
 
 extern void redisSlotsSetupMetrics(redisSlots *);
@@ -94,6 +115,8 @@ extern uint64_t redisSlotsInflightRequests(redisSlots *);
 extern int redisSlotsRequest(redisSlots *, sds, redisClusterCallbackFn *, void *);
 extern int redisSlotsRequestFirstNode(redisSlots *slots, const sds cmd,
 		redisClusterCallbackFn *callback, void *arg);
+extern int redisSlotsRequestBatch(redisSlots *, sds, redisClusterCallbackFn *, void *);
+extern void redisSlotsFlush(redisSlots *);
 extern void redisSlotsFree(redisSlots *);
 
 extern int redisSlotsProxyConnect(redisSlots *,
@@ -0,0 +1,687 @@
+/*
+ * Copyright (c) 2022 Red Hat.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+#include <ctype.h>
+#include "textindex.h"
+#include "search.h"
+#include "util.h"
+
+/* field bits and weights - keep in sync with redis_load_search_schema */
+#define TEXT_FIELD_NAME		(1<<0)
+#define TEXT_FIELD_ONELINE	(1<<1)
+#define TEXT_FIELD_HELPTEXT	(1<<2)
+
+#define TEXT_WEIGHT_NAME	9.0
+#define TEXT_WEIGHT_ONELINE	4.0
+#define TEXT_WEIGHT_HELPTEXT	2.0
+#define TEXT_WEIGHT_PREFIX	1.0
+#define TEXT_WEIGHT_FUZZY	0.25
+
+typedef struct textDocument {
+    sds			docid;
+    sds			name;
+    sds			indom;
+    sds			oneline;
+    sds			helptext;
+    pmSearchTextType	type;
+    unsigned int	ordinal;	/* insertion order, ranking tie-break */
+
+    /* per-query scratch space (queries run on the event loop thread) */
+    unsigned int	epoch;		/* query generation last touched */
+    unsigned int	hits;		/* query terms matched so far */
+    double		weight;		/* weight of the current term match */
+    double		score;		/* accumulated ranking score */
+} textDocument;
+
+typedef struct textPosting {
+    textDocument	*doc;
+    unsigned int	fields;		/* TEXT_FIELD_* bits containing term */
+} textPosting;
+
+typedef struct textPostings {
+    unsigned int	count;
+    unsigned int	size;
+    textPosting		*list;
+} textPostings;
+
+typedef struct textMatch {
+    textDocument	*doc;
+    double		score;
+} textMatch;
+
+static int		enabled = -1;	/* not yet configured */
+static dict		*documents;	/* docid -> textDocument */
+static dict		*terms;		/* term -> textPostings */
+static dict		*indoms;	/* indom -> textPostings */
+static unsigned int	ordinal;	/* documents ever added */
+static unsigned long long records;	/* postings over all terms */
+static unsigned int	epoch;		/* current query generation */
+
+void
+textIndexInit(struct dict *config)
+{
+    sds		option;
+
+    if (enabled >= 0)
+	return;
+    option = pmIniFileLookup(config, "pmsearch", "embedded");
+    enabled = (option && strcmp(option, "false") == 0) ? 0 : 1;
+}
+
+int
+textIndexEnabled(void)
+{
+    return enabled > 0;
+}
+
+static void
+text_postings_free(dict *map)
+{
+    dictIterator	*iterator;
+    dictEntry		*entry;
+    textPostings	*postings;
+
+    iterator = dictGetIterator(map);
+    while ((entry = dictNext(iterator)) != NULL) {
+	postings = (textPostings *)dictGetVal(entry);
+	free(postings->list);
+	free(postings);
+    }
+    dictReleaseIterator(iterator);
+    dictRelease(map);
+}
+
+void
+textIndexClose(void)
+{
+    dictIterator	*iterator;
+    dictEntry		*entry;
+    textDocument	*doc;
+
+    if (terms) {
+	text_postings_free(terms);
+	terms = NULL;
+    }
+    if (indoms) {
+	text_postings_free(indoms);
+	indoms = NULL;
+    }
+    if (documents) {
+	iterator = dictGetIterator(documents);
+	while ((entry = dictNext(iterator)) != NULL) {
+	    doc = (textDocument *)dictGetVal(entry);
+	    sdsfree(doc->docid);
+	    sdsfree(doc->name);
+	    sdsfree(doc->indom);
+	    sdsfree(doc->oneline);
+	    sdsfree(doc->helptext);
+	    free(doc);
+	}
+	dictReleaseIterator(iterator);
+	dictRelease(documents);
+	documents = NULL;
+    }
+    ordinal = epoch = 0;
+    records = 0;
+    enabled = -1;
+}
+
+/*
+ * Split text into lower case terms, at the same delimiters used when
+ * preparing RediSearch queries (see redis_search_text_prep), dropping
+ * empty tokens and stopwords.  Returns the count of (possibly empty)
+ * split tokens for sdsfreesplitres, with unused slots set to NULL.
+ */
+static sds *
+text_index_terms(const char *text, int *count)
+{
+    static const char	*delimiters = ",.<>{}[]\"\':;!@#$%^&*()-+=~/";
+    sds			copy, *tokens;
+    size_t		length;
+    int			i, n;
+
+    *count = 0;
+    if (text == NULL || *text == '\0')
+	return NULL;
+    copy = sdsnew(text);
+    length = sdslen(copy);
+    for (i = 0; i < length; i++) {
+	if (isspace((int)copy[i]) || strchr(delimiters, copy[i]) != NULL)
+	    copy[i] = ' ';
+    }
+    sdstolower(copy);
+    tokens = sdssplitlen(copy, length, " ", 1, &n);
+    sdsfree(copy);
+    if (tokens == NULL)
+	return NULL;
+    for (i = 0; i < n; i++) {
+	if (sdslen(tokens[i]) == 0 || redis_search_is_stopword(tokens[i])) {
+	    sdsfree(tokens[i]);
+	    tokens[i] = NULL;
+	}
+    }
+    *count = n;
+    return tokens;
+}
+
+static void
+text_index_free_terms(sds *tokens, int count)
+{
+    if (tokens)
+	sdsfreesplitres(tokens, count);	/* sdsfree is NULL-safe */
+}
+
+static textPostings *
+text_postings_lookup(dict *map, sds key, int create)
+{
+    textPostings	*postings;
+    dictEntry		*entry;
+
+    if ((entry = dictFind(map, key)) != NULL)
+	return (textPostings *)dictGetVal(entry);
+    if (!create || (postings = calloc(1, sizeof(textPostings))) == NULL)
+	return NULL;
+    dictAdd(map, key, postings);	/* key is duplicated */
+    return postings;
+}
+
+static textPosting *
+text_postings_find(textPostings *postings, textDocument *doc)
+{
+    unsigned int	i;
+
+    /* most recently added documents are at the end, search backward */
+    for (i = postings->count; i > 0; i--)
+	if (postings->list[i-1].doc == doc)
+	    return &postings->list[i-1];
+    return NULL;
+}
+
+static void
+text_postings_insert(dict *map, sds key, textDocument *doc, unsigned int field)
+{
+    textPostings	*postings;
+    textPosting		*posting;
+    unsigned int	size;
+
+    if ((postings = text_postings_lookup(map, key, 1)) == NULL)
+	return;
+    if ((posting = text_postings_find(postings, doc)) != NULL) {
+	posting->fields |= field;
+	return;
+    }
+    if (postings->count == postings->size) {
+	size = postings->size ? postings->size * 2 : 4;
+	if ((posting = realloc(postings->list, size * sizeof(textPosting))) == NULL)
+	    return;
+	postings->list = posting;
+	postings->size = size;
+    }
+    posting = &postings->list[postings->count++];
+    posting->doc = doc;
+    posting->fields = field;
+    records++;
+}
+
+static void
+text_postings_remove(dict *map, sds key, textDocument *doc, unsigned int field)
+{
+    textPostings	*postings;
+    textPosting		*posting;
+    unsigned int	index;
+
+    if ((postings = text_postings_lookup(map, key, 0)) == NULL)
+	return;
+    if ((posting = text_postings_find(postings, doc)) == NULL)
+	return;
+    if ((posting->fields &= ~field) != 0)
+	return;
+    index = posting - postings->list;
+    memmove(posting, posting + 1,
+		(postings->count - index - 1) * sizeof(textPosting));
+    postings->count--;
+    records--;
+    if (postings->count == 0) {
+	free(postings->list);
+	free(postings);
+	dictDelete(map, key);
+    }
+}
+
+static void
+text_index_field(textDocument *doc, const char *text,
+		unsigned int field, int insert)
+{
+    sds			*tokens;
+    int			i, count;
+
+    tokens = text_index_terms(text, &count);
+    for (i = 0; i < count; i++) {
+	if (tokens[i] == NULL)
+	    continue;
+	if (insert)
+	    text_postings_insert(terms, tokens[i], doc, field);
+	else
+	    text_postings_remove(terms, tokens[i], doc, field);
+    }
+    text_index_free_terms(tokens, count);
+}
+
+/* update a document field, re-indexing only if the value changed */
+static void
+text_index_update(textDocument *doc, sds *value,
+		const char *text, unsigned int field)
+{
+    if (text == NULL || *text == '\0')
+	return;
+    if (*value && strcmp(*value, text) == 0)
+	return;
+    if (*value) {
+	text_index_field(doc, *value, field, 0);
+	sdsfree(*value);
+    }
+    *value = sdsnew(text);
+    text_index_field(doc, *value, field, 1);
+}
+
+void
+textIndexAdd(pmSearchTextType type, const char *docid, const char *name,
+		const char *indom, const char *oneline, const char *helptext)
+{
+    textDocument	*doc;
+    dictEntry		*entry;
+    sds			key;
+
+    if (documents == NULL) {
+	documents = dictCreate(&sdsKeyDictCallBacks, NULL);
+	terms = dictCreate(&sdsKeyDictCallBacks, NULL);
+	indoms = dictCreate(&sdsKeyDictCallBacks, NULL);
+    }
+
+    key = sdsnew(docid);
+    if ((entry = dictFind(documents, key)) != NULL) {
+	doc = (textDocument *)dictGetVal(entry);
+	sdsfree(key);
+    } else {
+	if ((doc = calloc(1, sizeof(textDocument))) == NULL) {
+	    sdsfree(key);
+	    return;
+	}
+	doc->docid = key;
+	doc->type = type;
+	doc->ordinal = ordinal++;
+	dictAdd(documents, key, doc);	/* key is duplicated */
+    }
+
+    text_index_update(doc, &doc->name, name, TEXT_FIELD_NAME);
+    text_index_update(doc, &doc->oneline, oneline, TEXT_FIELD_ONELINE);
+    text_index_update(doc, &doc->helptext, helptext, TEXT_FIELD_HELPTEXT);
+
+    /* instance domain is a tag field, matched exactly */
+    if (indom && *indom != '\0' &&
+	(doc->indom == NULL || strcmp(doc->indom, indom) != 0)) {
+	if (doc->indom) {
+	    text_postings_remove(indoms, doc->indom, doc, TEXT_FIELD_NAME);
+	    sdsfree(doc->indom);
+	}
+	doc->indom = sdsnew(indom);
+	text_postings_insert(indoms, doc->indom, doc, TEXT_FIELD_NAME);
+    }
+}
+
+static double
+text_field_weight(unsigned int fields)
+{
+    double		weight = 0.0;
+
+    if (fields & TEXT_FIELD_NAME)
+	weight += TEXT_WEIGHT_NAME;
+    if (fields & TEXT_FIELD_ONELINE)
+	weight += TEXT_WEIGHT_ONELINE;
+    if (fields & TEXT_FIELD_HELPTEXT)
+	weight += TEXT_WEIGHT_HELPTEXT;
+    return weight;
+}
+
+/* is the edit distance between two terms at most one? */
+static int
+text_fuzzy_match(const char *a, size_t alen, const char *b, size_t blen)
+{
+    const char		*swap;
+    size_t		i;
+
+    if (alen > blen) {
+	swap = a; a = b; b = swap;
+	i = alen; alen = blen; blen = i;
+    }
+    if (blen - alen > 1)
+	return 0;
+    for (i = 0; i < alen && a[i] == b[i]; i++)
+	;
+    if (i == alen)
+	return 1;
+    if (alen == blen)	/* substitution */
+	return memcmp(a + i + 1, b + i + 1, alen - i - 1) == 0;
+    return memcmp(a + i, b + i + 1, alen - i) == 0;	/* insertion */
+}
+
+static int
+text_all_digits(sds term)
+{
+    size_t		i;
+
+    for (i = 0; i < sdslen(term); i++)
+	if (!isdigit((int)term[i]))
+	    return 0;
+    return 1;
+}
+
+typedef struct textSearch {
+    pmSearchTextRequest	*request;
+    unsigned int	fields;		/* fields to be searched */
+    unsigned int	types;		/* bitmap of allowed document types */
+    unsigned int	term;		/* index of current query term */
+    unsigned int	nterms;		/* number of query terms */
+    unsigned int	count;
+    unsigned int	size;
+    textMatch		*matches;
+} textSearch;
+
+static void
+text_search_hit(textSearch *search, textDocument *doc, double weight)
+{
+    textMatch		*matches;
+    unsigned int	size;
+
+    if (!(search->types & (1 << doc->type)))
+	return;
+    if (doc->epoch != epoch) {
+	doc->epoch = epoch;
+	doc->hits = 0;
+	doc->score = 0.0;
+    }
+    if (doc->hits == search->term + 1) {
+	/* term already matched (via another index term) - keep the best */
+	if (weight > doc->weight) {
+	    doc->score += weight - doc->weight;
+	    doc->weight = weight;
+	}
+	return;
+    }
+    if (doc->hits != search->term)	/* missed an earlier query term */
+	return;
+    doc->hits++;
+    doc->weight = weight;
+    doc->score += weight;
+
+    if (doc->hits < search->nterms)
+	return;
+    /* matched all query terms - final score is computed when sorting */
+    if (search->count == search->size) {
+	size = search->size ? search->size * 2 : 16;
+	if ((matches = realloc(search->matches, size * sizeof(textMatch))) == NULL)
+	    return;
+	search->matches = matches;
+	search->size = size;
+    }
+    search->matches[search->count++].doc = doc;
+}
+
+static void
+text_search_postings(textSearch *search, textPostings *postings, double scale)
+{
+    textPosting		*posting;
+    unsigned int	i, fields;
+
+    for (i = 0; i < postings->count; i++) {
+	posting = &postings->list[i];
+	if ((fields = posting->fields & search->fields) == 0)
+	    continue;
+	text_search_hit(search, posting->doc, scale * text_field_weight(fields));
+    }
+}
+
+static void
+text_search_query(textSearch *search, sds term)
+{
+    textPostings	*postings;
+
+    if ((postings = text_postings_lookup(terms, term, 0)) == NULL)
+	return;
+    text_search_postings(search, postings, 1.0);
+}
+
+static void
+text_search_suggest(textSearch *search, sds term)
+{
+    dictIterator	*iterator;
+    dictEntry		*entry;
+    size_t		length = sdslen(term), keylen;
+    double		weight;
+    int			fuzzy = !text_all_digits(term);
+    sds			key;
+
+    /* prefix or fuzzy matching requires a scan over the term dictionary */
+    iterator = dictGetIterator(terms);
+    while ((entry = dictNext(iterator)) != NULL) {
+	key = (sds)dictGetKey(entry);
+	keylen = sdslen(key);
+	if (keylen >= length && strncmp(key, term, length) == 0)
+	    weight = TEXT_WEIGHT_PREFIX;
+	else if (fuzzy && text_fuzzy_match(key, keylen, term, length))
+	    weight = TEXT_WEIGHT_FUZZY;
+	else
+	    continue;
+	text_search_postings(search, (textPostings *)dictGetVal(entry),
+				weight / TEXT_WEIGHT_NAME);
+    }
+    dictReleaseIterator(iterator);
+}
+
+static int
+text_match_score_compare(const void *a, const void *b)
+{
+    const textMatch	*ma = (const textMatch *)a;
+    const textMatch	*mb = (const textMatch *)b;
+
+    if (ma->score != mb->score)
+	return ma->score < mb->score ? 1 : -1;
+    return ma->doc->ordinal < mb->doc->ordinal ? -1 : 1;
+}
+
+static int
+text_match_type_compare(const void *a, const void *b)
+{
+    const textMatch	*ma = (const textMatch *)a;
+    const textMatch	*mb = (const textMatch *)b;
+    int			sts;
+
+    if ((sts = strcmp(pmSearchTextTypeStr(ma->doc->type),
+		      pmSearchTextTypeStr(mb->doc->type))) != 0)
+	return sts;
+    return ma->doc->ordinal < mb->doc->ordinal ? -1 : 1;
+}
+
+static void
+text_search_defaults(pmSearchTextRequest *request)
+{
+    if (request->infields_name + request->infields_oneline +
+	request->infields_helptext == 0) {
+	request->infields_name = 1;
+	request->infields_oneline = 1;
+	request->infields_helptext = 1;
+    }
+    if (request->return_name + request->return_indom +
+	request->return_oneline + request->return_helptext +
+	request->return_type == 0) {
+	request->return_name = 1;
+	request->return_indom = 1;
+	request->return_oneline = 1;
+	request->return_helptext = 1;
+	request->return_type = 1;
+    }
+}
+
+/*
+ * Search the index, calling the result callback for each match within
+ * the requested [offset, offset+count) window, in ranked order.  Returns
+ * the total number of matching documents.
+ */
+int
+textIndexSearch(pmSearchTextRequest *request, textIndexMode mode,
+		struct timespec *started, pmSearchTextResultCallBack callback,
+		void *arg)
+{
+    pmSearchTextResult	result;
+    struct timespec	finished;
+    textPostings	*postings;
+    textSearch		search = {0};
+    textDocument	*doc;
+    unsigned int	i, end;
+    double		timer;
+    sds			*tokens, key;
+    int			n, count;
+
+    if (pmDebugOptions.search)
+	fprintf(stderr, "%s: %s\n", "textIndexSearch", request->query);
+
+    if (documents == NULL)
+	return 0;
+
+    search.request = request;
+    epoch++;
+
+    switch (mode) {
+    case TEXT_INDEX_QUERY:
+	text_search_defaults(request);
+	if (request->infields_name)
+	    search.fields |= TEXT_FIELD_NAME;
+	if (request->infields_oneline)
+	    search.fields |= TEXT_FIELD_ONELINE;
+	if (request->infields_helptext)
+	    search.fields |= TEXT_FIELD_HELPTEXT;
+	if (request->type_metric)
+	    search.types |= (1 << PM_SEARCH_TYPE_METRIC);
+	if (request->type_indom)
+	    search.types |= (1 << PM_SEARCH_TYPE_INDOM);
+	if (request->type_inst)
+	    search.types |= (1 << PM_SEARCH_TYPE_INST);
+	if (search.types == 0)
+	    search.types = ~0U;
+	break;
+
+    case TEXT_INDEX_SUGGEST:
+	request->return_name = 1;
+	request->return_indom = request->return_type = 0;
+	request->return_oneline = request->return_helptext = 0;
+	search.fields = TEXT_FIELD_NAME;
+	search.types = (1 << PM_SEARCH_TYPE_METRIC) | (1 << PM_SEARCH_TYPE_INST);
+	break;
+
+    case TEXT_INDEX_INDOM:
+	request->return_name = request->return_indom = 1;
+	request->return_oneline = request->return_helptext = 1;
+	request->return_type = 1;
+	search.fields = TEXT_FIELD_NAME;
+	search.types = ~0U;
+	break;
+    }
+
+    if (mode == TEXT_INDEX_INDOM) {
+	search.nterms = 1;
+	key = sdsnew(request->query);
+	if ((postings = text_postings_lookup(indoms, key, 0)) != NULL)
+	    text_search_postings(&search, postings, 1.0);
+	sdsfree(key);
+    } else {
+	tokens = text_index_terms(request->query, &count);
+	for (n = 0; n < count; n++) {
+	    if (tokens[n] == NULL)
+		continue;
+	    /* by default we cannot use prefix search with short words */
+	    if (mode == TEXT_INDEX_SUGGEST && sdslen(tokens[n]) < 2)
+		continue;
+	    search.nterms++;
+	}
+	for (n = 0; n < count && search.nterms > 0; n++) {
+	    if (tokens[n] == NULL)
+		continue;
+	    if (mode == TEXT_INDEX_SUGGEST) {
+		if (sdslen(tokens[n]) < 2)
+		    continue;
+		text_search_suggest(&search, tokens[n]);
+	    } else {
+		text_search_query(&search, tokens[n]);
+	    }
+	    search.term++;
+	}
+	text_index_free_terms(tokens, count);
+    }
+
+    for (i = 0; i < search.count; i++)
+	search.matches[i].score = search.matches[i].doc->score;
+    qsort(search.matches, search.count, sizeof(textMatch),
+		mode == TEXT_INDEX_INDOM ?
+		text_match_type_compare : text_match_score_compare);
+
+    pmtimespecNow(&finished);
+    timer = pmtimespecSub(&finished, started);
+
+    end = request->offset + request->count;
+    if (end > search.count)
+	end = search.count;
+    for (i = request->offset; i < end; i++) {
+	doc = search.matches[i].doc;
+	memset(&result, 0, sizeof(result));
+	result.total = search.count;
+	result.timer = timer;
+	result.count = i + 1;
+	result.score = search.matches[i].score;
+	result.docid = doc->docid;
+	if (request->return_type)
+	    result.type = doc->type;
+	if (request->return_name)
+	    result.name = doc->name;
+	if (request->return_indom)
+	    result.indom = doc->indom;
+	if (request->return_oneline)
+	    result.oneline = doc->oneline;
+	if (request->return_helptext)
+	    result.helptext = doc->helptext;
+	callback(&result, arg);
+    }
+
+    count = search.count;
+    free(search.matches);
+    return count;
+}
+
+void
+textIndexMetrics(pmSearchMetrics *metrics)
+{
+    unsigned long long	bytes;
+
+    memset(metrics, 0, sizeof(*metrics));
+    if (documents == NULL)
+	return;
+    metrics->docs = dictSize(documents);
+    metrics->terms = dictSize(terms);
+    metrics->records = records;
+
+    bytes = records * sizeof(textPosting);
+    metrics->inverted_sz_mb = (double)bytes / (1024 * 1024);
+    if (metrics->docs)
+	metrics->records_per_doc_avg = (double)records / metrics->docs;
+    if (records)
+	metrics->bytes_per_record_avg = (double)sizeof(textPosting);
+}
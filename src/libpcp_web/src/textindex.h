@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2022 Red Hat.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+#ifndef SEARCH_TEXTINDEX_H
+#define SEARCH_TEXTINDEX_H
+
+#include "pmwebapi.h"
+
+/*
+ * Embedded (in-process) inverted index over metric names, instance
+ * names, instance domains and help text.  Used in place of RediSearch
+ * when that module is not available in the key server.  Documents are
+ * identified by the same docid used for FT.ADD, and fields are updated
+ * in the same PARTIAL fashion - non-empty fields replace old values.
+ */
+typedef enum textIndexMode {
+    TEXT_INDEX_QUERY,		/* all terms, weighted by field */
+    TEXT_INDEX_SUGGEST,		/* name prefix or fuzzy (distance 1) */
+    TEXT_INDEX_INDOM,		/* exact instance domain identifier */
+} textIndexMode;
+
+extern void textIndexInit(struct dict *);
+extern void textIndexClose(void);
+extern int textIndexEnabled(void);
+
+extern void textIndexAdd(pmSearchTextType, const char *, const char *,
+		const char *, const char *, const char *);
+extern int textIndexSearch(pmSearchTextRequest *, textIndexMode,
+		struct timespec *, pmSearchTextResultCallBack, void *);
+extern void textIndexMetrics(pmSearchMetrics *);
+
+#endif	/* SEARCH_TEXTINDEX_H */
@@ -22,6 +22,7 @@
 #include "maps.h"
 #include "util.h"
 #include "sha1.h"
+#include "rollup.h"
 
 const char *SDS_NOINIT = "SDS_NOINIT";	/* back-compat, exported global */
 
@@ -273,6 +274,7 @@ pmwebapi_source_meta(context_t *c, char *buffer, int length)
 	return sts;
     }
     c->host = sdsnew(host);
+    pmwebapi_labels_changed(c);
     sts = pmGetContextLabels(set);
     if (sts == PM_ERR_IPC)
 	c->setup = 0;
@@ -480,8 +482,15 @@ pmwebapi_metric_hash(metric_t *metric)
 	if (len <= 0)
 	    len = pmsprintf(buf, sizeof(buf), "null");
 	metric->labels = sdsnewlen(buf, len);
+	metric->hashed = 0;
     }
 
+    /* names and descriptor are fixed, so only new labels change the hash */
+    metric->cached = 0;
+    if (metric->hashed)
+	return;
+    metric->hashed = 1;
+
     identifier = sdsempty();
     for (i = 0; i < metric->numnames; i++) {
 	identifier = sdscatfmt(identifier,
@@ -498,8 +507,6 @@ pmwebapi_metric_hash(metric_t *metric)
 	sdsclear(identifier);
     }
     sdsfree(identifier);
-
-    metric->cached = 0;
 }
 
 void
@@ -529,8 +536,15 @@ pmwebapi_instance_hash(indom_t *ip, instance_t *instance)
 	if (len <= 0)
 	    len = pmsprintf(buf, sizeof(buf), "null");
 	instance->labels = sdsnewlen(buf, len);
+	instance->hashed = 0;
     }
 
+    /* unchanged name and labels, so unchanged hash */
+    instance->cached = 0;
+    if (instance->hashed)
+	return;
+    instance->hashed = 1;
+
     identifier = sdscatfmt(sdsempty(),
 		"{\"series\":\"instance\",\"name\":\"%S\",\"labels\":%S}",
 		instance->name.sds, instance->labels);
@@ -539,14 +553,11 @@ pmwebapi_instance_hash(indom_t *ip, instance_t *instance)
     SHA1Update(&shactx, (unsigned char *)identifier, sdslen(identifier));
     SHA1Final(instance->name.hash, &shactx);
     sdsfree(identifier);
-
-    instance->cached = 0;
 }
 
 sds
 pmwebapi_new_context(context_t *cp)
 {
-    char		labels[PM_MAXLABELJSONLEN];
     char		pmmsg[PM_MAXERRMSGLEN];
     sds			msg = NULL;
     int			sts;
@@ -562,7 +573,25 @@ pmwebapi_new_context(context_t *cp)
 	else
 	    infofmt(msg, "cannot open archive \"%s\": %s",
 		    cp->name.sds, pmErrStr_r(sts, pmmsg, sizeof(pmmsg)));
-    } else if ((sts = pmwebapi_source_meta(cp, labels, sizeof(labels))) < 0) {
+    } else {
+	msg = pmwebapi_attach_context(cp);
+    }
+    return msg;
+}
+
+/*
+ * Complete setup of a context around an established PMAPI context
+ * handle (cp->context), either newly created or reused.
+ */
+sds
+pmwebapi_attach_context(context_t *cp)
+{
+    char		labels[PM_MAXLABELJSONLEN];
+    char		pmmsg[PM_MAXERRMSGLEN];
+    sds			msg = NULL;
+    int			sts;
+
+    if ((sts = pmwebapi_source_meta(cp, labels, sizeof(labels))) < 0) {
 	infofmt(msg, "failed to get context labels: %s",
 		    pmErrStr_r(sts, pmmsg, sizeof(pmmsg)));
     } else if ((sts = pmwebapi_source_hash(cp->name.hash, labels, sts)) < 0) {
@@ -645,6 +674,27 @@ pmwebapi_free_context(context_t *cp)
     free(cp);
 }
 
+void
+pmwebapi_free_scrapes(context_t *cp)
+{
+    dictIterator	*iterator;
+    dictEntry		*entry;
+    scrapeplan_t	*plan;
+
+    if (cp->scrapes == NULL)
+	return;
+    iterator = dictGetIterator(cp->scrapes);
+    while ((entry = dictNext(iterator)) != NULL) {
+	plan = (scrapeplan_t *)dictGetVal(entry);
+	free(plan->mplist);
+	free(plan->pmidlist);
+	free(plan);
+    }
+    dictReleaseIterator(iterator);
+    dictRelease(cp->scrapes);
+    cp->scrapes = NULL;
+}
+
 void
 pmwebapi_release_context(context_t *cp)
 {
@@ -668,6 +718,8 @@ pmwebapi_release_context(context_t *cp)
     if (cp->labelset)
 	pmFreeLabelSets(cp->labelset, 1);
 
+    pmwebapi_free_scrapes(cp);	/* refers to metrics from cp->pmids */
+
     if (cp->metrics)	/* use the same value pointers as cp->pmids */
 	dictRelease(cp->metrics);	/* but, one entry per name */
 
@@ -699,6 +751,10 @@ pmwebapi_release_context(context_t *cp)
 	dictReleaseIterator(iterator);
 	dictRelease(cp->domains);
     }
+    if (cp->labelsets) {	/* emptied as the metric memos were released */
+	dictRelease(cp->labelsets);
+	cp->labelsets = NULL;
+    }
 }
 
 void
@@ -750,6 +806,8 @@ pmwebapi_add_domain_labels(struct context *context, struct domain *domain)
 			pmErrStr_r(sts, errmsg, sizeof(errmsg)));
 	    domain->labelset = NULL;
 	}
+	if (domain->labelset)
+	    pmwebapi_labels_changed(context);
     }
 }
 
@@ -806,6 +864,8 @@ pmwebapi_add_cluster_labels(struct context *context, struct cluster *cluster)
 			pmErrStr_r(sts, errmsg, sizeof(errmsg)));
 	    cluster->labelset = NULL;
 	}
+	if (cluster->labelset)
+	    pmwebapi_labels_changed(context);
     }
 }
 
@@ -893,6 +953,130 @@ pmwebapi_labelsetdup(pmLabelSet *lp)
     return dup;
 }
 
+/*
+ * Merged labelsets - the context, domain, indom, cluster, item and
+ * instance hierarchy - are memoised per metric and instance, so they
+ * are not merged again for every value of every sample.  The merged
+ * sets are interned by content within the context, such that all of
+ * the instances with identical labels share one immutable pmLabelSet.
+ * Any label change in the context advances its label generation, and
+ * memoised sets from an earlier generation are merged again on use.
+ */
+typedef struct labelintern {
+    unsigned int	refcount;
+    sds			key;		/* JSONB and label flags */
+    pmLabelSet		*labelset;
+} labelintern_t;
+
+typedef struct labelmemo {
+    unsigned int	generation;	/* context labelgen when merged */
+    labelintern_t	*intern;
+} labelmemo_t;
+
+void
+pmwebapi_labels_changed(context_t *cp)
+{
+    cp->labelgen++;
+}
+
+static labelintern_t *
+labelset_intern(context_t *cp, pmLabelSet *set)
+{
+    labelintern_t	*ip;
+    sds			key;
+    char		flags;
+    int			i;
+
+    if (cp->labelsets == NULL &&
+	(cp->labelsets = dictCreate(&sdsKeyDictCallBacks, cp)) == NULL)
+	return NULL;
+
+    key = sdsnewlen(set->json, set->json ? set->jsonlen : 0);
+    for (i = 0; i < set->nlabels; i++) {
+	flags = set->labels[i].flags;
+	key = sdscatlen(key, &flags, 1);
+    }
+
+    if ((ip = (labelintern_t *)dictFetchValue(cp->labelsets, key)) != NULL) {
+	sdsfree(key);
+	pmFreeLabelSets(set, 1);
+	ip->refcount++;
+	return ip;
+    }
+    if ((ip = calloc(1, sizeof(labelintern_t))) == NULL) {
+	sdsfree(key);
+	pmFreeLabelSets(set, 1);
+	return NULL;
+    }
+    ip->refcount = 1;
+    ip->labelset = set;
+    dictAdd(cp->labelsets, key, ip);
+    ip->key = dictGetKey(dictFind(cp->labelsets, key));
+    sdsfree(key);
+    return ip;
+}
+
+static void
+labelset_release(context_t *cp, labelintern_t *ip)
+{
+    if (ip == NULL || --ip->refcount > 0)
+	return;
+    dictDelete(cp->labelsets, ip->key);
+    pmFreeLabelSets(ip->labelset, 1);
+    free(ip);
+}
+
+pmLabelSet *
+pmwebapi_merged_labelset(metric_t *metric, instance_t *instance,
+		pmLabelSet **sets, int nsets)
+{
+    context_t		*cp = metric->cluster->domain->context;
+    labelmemo_t		*mp;
+    pmLabelSet		*merged;
+    unsigned int	inst = instance ? instance->inst : PM_IN_NULL;
+
+    if (metric->labelmemo == NULL &&
+	(metric->labelmemo = dictCreate(&intKeyDictCallBacks, cp)) == NULL)
+	return NULL;
+
+    if ((mp = (labelmemo_t *)dictFetchValue(metric->labelmemo, &inst)) == NULL) {
+	if ((mp = calloc(1, sizeof(labelmemo_t))) == NULL)
+	    return NULL;
+	dictAdd(metric->labelmemo, &inst, mp);
+    } else if (mp->intern && mp->generation == cp->labelgen) {
+	return mp->intern->labelset;
+    }
+
+    labelset_release(cp, mp->intern);
+    mp->intern = NULL;
+    if (__pmMergedLabelSet(sets, nsets, &merged) < 0)
+	return NULL;
+    if ((mp->intern = labelset_intern(cp, merged)) == NULL)
+	return NULL;
+    mp->generation = cp->labelgen;
+    return mp->intern->labelset;
+}
+
+void
+pmwebapi_free_labelmemo(context_t *cp, metric_t *metric)
+{
+    dictIterator	*iterator;
+    dictEntry		*entry;
+    labelmemo_t		*mp;
+
+    if (metric->labelmemo == NULL)
+	return;
+    iterator = dictGetIterator(metric->labelmemo);
+    while ((entry = dictNext(iterator)) != NULL) {
+	mp = (labelmemo_t *)dictGetVal(entry);
+	labelset_release(cp, mp->intern);
+	free(mp);
+    }
+    dictReleaseIterator(iterator);
+    dictRelease(metric->labelmemo);
+    metric->labelmemo = NULL;
+}
+
 void
 pmwebapi_add_instances_labels(struct context *context, struct indom *indom)
 {
@@ -914,6 +1098,8 @@ pmwebapi_add_instances_labels(struct context *context, struct indom *indom)
 	    indom->labelset = NULL;
 	    indom->updated = sts = 0;
 	}
+	if (indom->labelset)
+	    pmwebapi_labels_changed(context);
     }
 
     if (indom->updated == 0) {
@@ -937,6 +1123,7 @@ pmwebapi_add_instances_labels(struct context *context, struct indom *indom)
 	    if (instance->labelset)
 		pmFreeLabelSets(instance->labelset, 1);
 	    instance->labelset = labels;
+	    pmwebapi_labels_changed(context);
 
 	    pmwebapi_instance_hash(indom, instance);
 
@@ -1018,6 +1205,7 @@ pmwebapi_add_instance(struct indom *indom, int inst, char *name)
 	    sdsclear(instance->name.sds);
 	    instance->name.sds = sdscatlen(instance->name.sds, name, length);
 	    pmwebapi_string_hash(instance->name.id, name, length);
+	    instance->hashed = 0;
 	    pmwebapi_instance_hash(indom, instance);
 	}
 	return instance;
@@ -1104,6 +1292,8 @@ pmwebapi_free_metric(metric_t *metric)
 
     if (metric->labelset)
 	pmFreeLabelSets(metric->labelset, 1);
+    if (metric->labelmemo && metric->cluster)
+	pmwebapi_free_labelmemo(metric->cluster->domain->context, metric);
 
     while (list) {
 	sdsfree(list->name);
@@ -1125,6 +1315,12 @@ pmwebapi_free_metric(metric_t *metric)
 	    pmwebapi_release_value(type, &metric->u.vlist->value[i].atom);
 	free(metric->u.vlist);
     }
+    rollup_free(metric->rollup);
+    if (metric->rates) {
+	free(metric->rates->values);
+	free(metric->rates->spare);
+	free(metric->rates);
+    }
 
     memset(metric, 0, sizeof(*metric));
     free(metric);
@@ -1264,6 +1460,8 @@ pmwebapi_add_item_labels(struct context *context, struct metric *metric)
 			pmErrStr_r(sts, errmsg, sizeof(errmsg)));
 	    metric->labelset = NULL;
 	}
+	if (metric->labelset)
+	    pmwebapi_labels_changed(context);
     }
 }
 
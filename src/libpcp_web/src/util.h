@@ -39,6 +39,10 @@ extern int instance_labelsets(struct indom *, struct instance *,
 		void *type);
 
 extern pmLabelSet *pmwebapi_labelsetdup(pmLabelSet *);
+extern pmLabelSet *pmwebapi_merged_labelset(struct metric *, struct instance *,
+		pmLabelSet **, int);
+extern void pmwebapi_labels_changed(struct context *);
+extern void pmwebapi_free_labelmemo(struct context *, struct metric *);
 
 extern const char *pmwebapi_indom_str(struct metric *, char *, int);
 extern const char *pmwebapi_pmid_str(struct metric *, char *, int);
@@ -51,10 +55,12 @@ extern void pmwebapi_metric_hash(struct metric *);
 extern void pmwebapi_instance_hash(struct indom *, struct instance *);
 
 extern sds pmwebapi_new_context(struct context *);
+extern sds pmwebapi_attach_context(struct context *);
 extern void pmwebapi_locate_context(struct context *);
 extern void pmwebapi_setup_context(struct context *);
 extern void pmwebapi_release_context(struct context *);
 extern void pmwebapi_free_context(struct context *);
+extern void pmwebapi_free_scrapes(struct context *);
 extern int pmwebapi_source_meta(struct context *, char *, int);
 extern int pmwebapi_source_hash(unsigned char *, const char *, int);
 extern int pmwebapi_string_hash(unsigned char *, const char *, int);
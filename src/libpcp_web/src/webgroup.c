@@ -13,6 +13,7 @@
  */
 #include <assert.h>
 #include <ctype.h>
+#include <math.h>
 #include "pmapi.h"
 #include "pmda.h"
 #include "schema.h"
@@ -32,13 +33,23 @@ static unsigned int default_timeout;	/* timeout in milliseconds */
 #define DEFAULT_BATCHSIZE 256
 static unsigned int default_batchsize;	/* for groups of metrics */
 
+#define DEFAULT_POOL_SIZE 16
+static unsigned int default_poolsize;	/* idle pmcd connections kept */
+
+#define DEFAULT_POOL_TIMEOUT 30000
+static unsigned int default_pooltime;	/* idle connection timeout, msec */
+
+#define CONTEXT_TIMER_RESOLUTION 100	/* context timeouts wheel, msec */
+
 /* constant string keys (initialized during setup) */
 static sds PARAM_HOSTNAME, PARAM_HOSTSPEC, PARAM_CTXNUM, PARAM_CTXID,
            PARAM_POLLTIME, PARAM_PREFIX, PARAM_MNAME, PARAM_MNAMES,
            PARAM_PMIDS, PARAM_PMID, PARAM_INDOM, PARAM_INSTANCE,
-           PARAM_INAME, PARAM_MVALUE, PARAM_TARGET, PARAM_EXPR, PARAM_MATCH;
+           PARAM_INAME, PARAM_MVALUE, PARAM_TARGET, PARAM_EXPR, PARAM_MATCH,
+           PARAM_RATE;
 static sds AUTH_USERNAME, AUTH_PASSWORD;
 static sds EMPTYSTRING, LOCALHOST, WORK_TIMER, POLL_TIMEOUT, BATCHSIZE;
+static sds POOL_SIZE, POOL_TIMEOUT;
 
 enum matches { MATCH_EXACT, MATCH_GLOB, MATCH_REGEX };
 enum profile { PROFILE_ADD, PROFILE_DEL };
@@ -46,9 +57,23 @@ enum profile { PROFILE_ADD, PROFILE_DEL };
 enum webgroup_metric {
     WEBGROUP_GC_COUNT,
     WEBGROUP_GC_DROPS,
+    WEBGROUP_POOL_REUSE,
+    WEBGROUP_POOL_IDLE,
     NUM_WEBGROUP_METRIC
 };
 
+/*
+ * Idle PMAPI host contexts (pmcd connections) from expired or destroyed
+ * webgroup contexts, kept for reuse by new contexts with an identical
+ * hostspec (including any credentials) - most recently parked first.
+ */
+typedef struct pooled {
+    sds			hostspec;
+    int			context;
+    time_t		idle;		/* time this entry was parked */
+    struct pooled	*next;
+} pooled_t;
+
 typedef struct webgroups {
     struct dict		*contexts;
     struct dict		*config;
@@ -60,6 +85,10 @@ typedef struct webgroups {
     uv_loop_t		*events;
     uv_timer_t		timer;
     uv_mutex_t		mutex;
+    timer_wheel_t	wheel;		/* all context timeouts */
+
+    pooled_t		*pool;
+    unsigned int	npooled;
 
     unsigned int	active;
 } webgroups;
@@ -73,6 +102,7 @@ webgroups_lookup(pmWebGroupModule *module)
 	module->privdata = calloc(1, sizeof(struct webgroups));
 	groups = (struct webgroups *)module->privdata;
 	uv_mutex_init(&groups->mutex);
+	timer_wheel_init(&groups->wheel, CONTEXT_TIMER_RESOLUTION);
     }
     return groups;
 }
@@ -88,9 +118,9 @@ webgroup_deref_context(struct context *cp)
 }
 
 static void
-webgroup_release_context(uv_handle_t *handle)
+webgroup_release_context(wheel_timer_t *timer)
 {
-    struct context	*context = (struct context *)handle->data;
+    struct context	*context = (struct context *)timer->data;
 
     if (pmDebugOptions.http || pmDebugOptions.libweb)
 	fprintf(stderr, "releasing context %p [refcount=%u]\n",
@@ -98,6 +128,129 @@ webgroup_release_context(uv_handle_t *handle)
     pmwebapi_free_context(context);
 }
 
+static void
+webgroup_free_pooled(pooled_t *pp)
+{
+    if (pmDebugOptions.http || pmDebugOptions.libweb)
+	fprintf(stderr, "closing pooled context %d [%s]\n",
+			pp->context, pp->hostspec);
+    pmDestroyContext(pp->context);
+    sdsfree(pp->hostspec);
+    free(pp);
+}
+
+/*
+ * Keep the pmcd connection of a live host context that is going away,
+ * for a later context to the same host; the oldest entry is closed if
+ * the pool is full.
+ */
+static void
+webgroup_park_context(struct context *cp, struct webgroups *groups)
+{
+    pooled_t		*pp, **tail, *oldest = NULL;
+
+    if (default_poolsize == 0 || cp->type != PM_CONTEXT_HOST ||
+	cp->context < 0 || cp->setup == 0)
+	return;
+    if ((pp = (pooled_t *)calloc(1, sizeof(pooled_t))) == NULL)
+	return;
+    if ((pp->hostspec = sdsdup(cp->name.sds)) == NULL) {
+	free(pp);
+	return;
+    }
+    pp->context = cp->context;
+    pp->idle = time(NULL);
+    cp->context = -1;
+
+    if (pmDebugOptions.http || pmDebugOptions.libweb)
+	fprintf(stderr, "pooling context %d [%s]\n", pp->context, pp->hostspec);
+
+    uv_mutex_lock(&groups->mutex);
+    if (groups->npooled >= default_poolsize) {
+	for (tail = &groups->pool; (*tail)->next; tail = &(*tail)->next)
+	    ;
+	oldest = *tail;
+	*tail = NULL;
+	groups->npooled--;
+    }
+    pp->next = groups->pool;
+    groups->pool = pp;
+    groups->npooled++;
+    mmv_set(groups->map, groups->metrics[WEBGROUP_POOL_IDLE], &groups->npooled);
+    uv_mutex_unlock(&groups->mutex);
+
+    if (oldest)
+	webgroup_free_pooled(oldest);
+}
+
+/*
+ * Reuse an idle pmcd connection for a new context, if one to this same
+ * hostspec is pooled.  Returns the PMAPI context, made current, else -1.
+ */
+static int
+webgroup_take_context(sds hostspec, struct webgroups *groups)
+{
+    pooled_t		*pp, **prev;
+    int			context = -1;
+
+    uv_mutex_lock(&groups->mutex);
+    for (prev = &groups->pool; (pp = *prev) != NULL; prev = &pp->next) {
+	if (sdscmp(pp->hostspec, hostspec) == 0) {
+	    *prev = pp->next;
+	    groups->npooled--;
+	    break;
+	}
+    }
+    mmv_set(groups->map, groups->metrics[WEBGROUP_POOL_IDLE], &groups->npooled);
+    uv_mutex_unlock(&groups->mutex);
+
+    if (pp == NULL)
+	return -1;
+    if (pmUseContext(pp->context) < 0) {
+	webgroup_free_pooled(pp);
+	return -1;
+    }
+    if (pmDebugOptions.http || pmDebugOptions.libweb)
+	fprintf(stderr, "reusing pooled context %d [%s]\n",
+			pp->context, pp->hostspec);
+
+    /* previous owner may have restricted the instance profile */
+    pmAddProfile(PM_INDOM_NULL, 0, NULL);
+    context = pp->context;
+    sdsfree(pp->hostspec);
+    free(pp);
+
+    mmv_inc(groups->map, groups->metrics[WEBGROUP_POOL_REUSE]);
+    return context;
+}
+
+/* close pooled connections that have been idle too long (or all) */
+static void
+webgroup_expire_pool(struct webgroups *groups, int all)
+{
+    pooled_t		*pp, **prev, *expired = NULL;
+    time_t		limit = time(NULL) - default_pooltime / 1000;
+
+    uv_mutex_lock(&groups->mutex);
+    for (prev = &groups->pool; (pp = *prev) != NULL; ) {
+	if (all || pp->idle <= limit) {
+	    *prev = pp->next;
+	    pp->next = expired;
+	    expired = pp;
+	    groups->npooled--;
+	} else {
+	    prev = &pp->next;
+	}
+    }
+    mmv_set(groups->map, groups->metrics[WEBGROUP_POOL_IDLE], &groups->npooled);
+    uv_mutex_unlock(&groups->mutex);
+
+    while ((pp = expired) != NULL) {
+	expired = pp->next;
+	webgroup_free_pooled(pp);
+    }
+}
+
 static void
 webgroup_drop_context(struct context *context, struct webgroups *groups)
 {
@@ -106,24 +259,24 @@ webgroup_drop_context(struct context *context, struct webgroups *groups)
 			context, context->refcount);
 
     if (webgroup_deref_context(context) == 0) {
-	if (context->garbage == 0) {
-	    context->garbage = 1;
-	    uv_timer_stop(&context->timer);
-	}
+	context->garbage = 1;
 	if (groups) {
 	    uv_mutex_lock(&groups->mutex);
 	    dictDelete(groups->contexts, &context->randomid);
 	    uv_mutex_unlock(&groups->mutex);
+	    webgroup_park_context(context, groups);
 	}
-	uv_close((uv_handle_t *)&context->timer, webgroup_release_context);
+	/* release from the event loop, replacing any pending timeout */
+	groups = (struct webgroups *)context->privdata;
+	wheel_timer_start(&groups->wheel, &context->timer,
+			webgroup_release_context, 0);
     }
 }
 
 static void
-webgroup_timeout_context(uv_timer_t *arg)
+webgroup_timeout_context(wheel_timer_t *timer)
 {
-    uv_handle_t		*handle = (uv_handle_t *)arg;
-    struct context	*cp = (struct context *)handle->data;
+    struct context	*cp = (struct context *)timer->data;
 
     if (pmDebugOptions.http || pmDebugOptions.libweb)
 	fprintf(stderr, "context %u timed out (%p)\n", cp->randomid, cp);
@@ -134,10 +287,8 @@ webgroup_timeout_context(uv_timer_t *arg)
      * is returned to zero by the caller, or background cleanup
      * finds this context and cleans it.
      */
-    if (cp->refcount == 0 && cp->garbage == 0) {
+    if (cp->refcount == 0 && cp->garbage == 0)
 	cp->garbage = 1;
-	uv_timer_stop(&cp->timer);
-    }
 }
 
 static int
@@ -196,7 +347,6 @@ webgroup_new_context(pmWebGroupSettings *sp, dict *params,
     struct webgroups	*groups = webgroups_lookup(&sp->module);
     struct context	*cp;
     unsigned int	polltime = DEFAULT_POLL_TIMEOUT;
-    uv_handle_t		*handle;
     pmWebAccess		access;
     double		seconds;
     char		*endptr;
@@ -259,7 +409,11 @@ webgroup_new_context(pmWebGroupSettings *sp, dict *params,
   	return NULL;
     }
 
-    if ((*message = pmwebapi_new_context(cp)) != NULL) {
+    if ((cp->context = webgroup_take_context(cp->name.sds, groups)) >= 0)
+	*message = pmwebapi_attach_context(cp);
+    else
+	*message = pmwebapi_new_context(cp);
+    if (*message != NULL) {
 	*status = -ENOTCONN;
 	pmwebapi_free_context(cp);
 	return NULL;
@@ -268,11 +422,7 @@ webgroup_new_context(pmWebGroupSettings *sp, dict *params,
     dictAdd(groups->contexts, &cp->randomid, cp);
     uv_mutex_unlock(&groups->mutex);
 
-    /* leave until the end because uv_timer_init makes this visible in uv_run */
-    handle = (uv_handle_t *)&cp->timer;
-    handle->data = (void *)cp;
-    uv_timer_init(groups->events, &cp->timer);
-
+    wheel_timer_init(&cp->timer, cp);
     cp->privdata = groups;
     cp->setup = 1;
 
@@ -288,6 +438,7 @@ webgroup_timers_stop(struct webgroups *groups)
     if (groups->active) {
 	uv_timer_stop(&groups->timer);
 	uv_close((uv_handle_t *)&groups->timer, NULL);
+	timer_wheel_stop(&groups->wheel);
 	groups->active = 0;
     }
 }
@@ -303,6 +454,8 @@ webgroup_garbage_collect(struct webgroups *groups)
     if (pmDebugOptions.http || pmDebugOptions.libweb)
 	fprintf(stderr, "%s: started\n", "webgroup_garbage_collect");
 
+    webgroup_expire_pool(groups, 0);
+
     /* do context GC if we get the lock (else don't block here) */
     if (uv_mutex_trylock(&groups->mutex) == 0) {
 	iterator = dictGetSafeIterator(groups->contexts);
@@ -321,8 +474,9 @@ webgroup_garbage_collect(struct webgroups *groups)
 	}
 	dictReleaseIterator(iterator);
 
-	/* if dropping the last remaining context, do cleanup */
-	if (groups->active && drops == count) {
+	/* if the last remaining context has been released, do cleanup */
+	if (groups->active && drops == count && groups->npooled == 0 &&
+	    groups->wheel.pending == 0) {
 	    if (pmDebugOptions.http || pmDebugOptions.libweb)
 		fprintf(stderr, "%s: freezing\n", "webgroup_garbage_collect");
 	    webgroup_timers_stop(groups);
@@ -375,11 +529,9 @@ webgroup_use_context(struct context *cp, int *status, sds *message, void *arg)
 	    fprintf(stderr, "context %u timer set (%p) to %u msec\n",
 			cp->randomid, cp, cp->timeout);
 
-	/* refresh current time: https://github.com/libuv/libuv/issues/1068 */
-	uv_update_time(gp->events);
-
-	/* if already started, uv_timer_start updates the existing timer */
-	uv_timer_start(&cp->timer, webgroup_timeout_context, cp->timeout, 0);
+	/* if already started, this updates the existing timer */
+	wheel_timer_start(&gp->wheel, &cp->timer,
+			webgroup_timeout_context, cp->timeout);
     } else {
 	infofmt(*message, "expired context identifier: %u", cp->randomid);
 	*status = -ENOTCONN;
@@ -406,6 +558,8 @@ webgroup_lookup_context(pmWebGroupSettings *sp, sds *id, dict *params,
 	groups->timer.data = (void *)groups;
 	uv_timer_start(&groups->timer, webgroup_worker,
 			default_worker, default_worker);
+	/* and the wheel driving all context timeouts */
+	timer_wheel_start(&groups->wheel, groups->events);
     }
 
     if (*id == NULL) {
@@ -629,6 +783,25 @@ webgroup_fetch_arrays(pmWebGroupSettings *settings, int numnames,
     return 0;
 }
 
+/*
+ * Floating point values are mostly integral (counters converted to
+ * doubles, percentages, etc) and then the %g formats produce the same
+ * digits as integer formatting, without the cost of vsnprintf.  The
+ * limit keeps within the precision where %g would not use exponents.
+ */
+static sds
+webgroup_encode_double(sds value, double d, const char *fmt, double limit)
+{
+    char		buffer[64];
+    int			length;
+
+    if (d > -limit && d < limit && d == (double)(long long)d &&
+	(d != 0.0 || !signbit(d)))
+	return sdscatfmt(value, "%I", (long long)d);
+    length = pmsprintf(buffer, sizeof(buffer), fmt, d);
+    return sdscatlen(value, buffer, length);
+}
+
 static sds
 webgroup_encode_value(sds value, int type, pmAtomValue *atom)
 {
@@ -643,9 +816,9 @@ webgroup_encode_value(sds value, int type, pmAtomValue *atom)
     case PM_TYPE_U64:
 	return sdscatfmt(value, "%U", atom->ull);
     case PM_TYPE_FLOAT:
-	return sdscatprintf(value, "%.8g", (double)atom->f);
+	return webgroup_encode_double(value, (double)atom->f, "%.8g", 1e8);
     case PM_TYPE_DOUBLE:
-	return sdscatprintf(value, "%.16g", atom->d);
+	return webgroup_encode_double(value, atom->d, "%.16g", 1e15);
 
     case PM_TYPE_STRING:
     case PM_TYPE_AGGREGATE:
@@ -661,10 +834,162 @@ webgroup_encode_value(sds value, int type, pmAtomValue *atom)
     return sdscatlen(value, "null", 4);
 }
 
+/*
+ * Rate fetches return the change per second of counter metrics since
+ * the previous rate fetch of the same metric in this context, instead
+ * of their values, so that clients need not keep samples themselves.
+ */
+static int
+webgroup_rate_metric(struct metric *metric)
+{
+    if (metric->desc.sem != PM_SEM_COUNTER)
+	return 0;
+    switch (metric->desc.type) {
+    case PM_TYPE_32:
+    case PM_TYPE_U32:
+    case PM_TYPE_64:
+    case PM_TYPE_U64:
+    case PM_TYPE_FLOAT:
+    case PM_TYPE_DOUBLE:
+	return 1;
+    default:
+	break;
+    }
+    return 0;
+}
+
+static double
+webgroup_rate_double(int type, pmAtomValue *atom)
+{
+    switch (type) {
+    case PM_TYPE_32:
+	return (double)atom->l;
+    case PM_TYPE_U32:
+	return (double)atom->ul;
+    case PM_TYPE_64:
+	return (double)atom->ll;
+    case PM_TYPE_U64:
+	return (double)atom->ull;
+    case PM_TYPE_FLOAT:
+	return (double)atom->f;
+    case PM_TYPE_DOUBLE:
+	return atom->d;
+    default:
+	break;
+    }
+    return 0.0;
+}
+
+/* find an instance in a rate history, usually at the same position */
+static ratevalue_t *
+webgroup_rate_lookup(ratevalue_t *values, unsigned int count,
+		unsigned int hint, int inst)
+{
+    unsigned int	i;
+
+    if (hint < count && values[hint].inst == inst)
+	return &values[hint];
+    for (i = 0; i < count; i++)
+	if (values[i].inst == inst)
+	    return &values[i];
+    return NULL;
+}
+
+static unsigned int
+webgroup_rate_sample(ratehist_t *rates, unsigned int n, int inst,
+		double value, double delta)
+{
+    ratevalue_t		*prev, *next = &rates->spare[n];
+
+    prev = webgroup_rate_lookup(rates->values, rates->count, n, inst);
+    next->inst = inst;
+    next->value = value;
+    /* no rate for new instances, nor counters that went backwards */
+    if ((next->valid = (prev && delta > 0 && value >= prev->value)))
+	next->rate = (value - prev->value) / delta;
+    return n + 1;
+}
+
+/*
+ * Update the rate history of a counter metric from the values just
+ * extracted from a fetch result - instances missing from the result
+ * are dropped from the history, unless the metric has no values at all.
+ */
+static int
+webgroup_rate_update(struct metric *metric, struct timespec *stamp)
+{
+    ratehist_t		*rates = metric->rates;
+    ratevalue_t		*swap;
+    struct value	*value;
+    unsigned int	k, n = 0, size;
+    double		delta;
+    int			type = metric->desc.type;
+
+    if (rates == NULL) {
+	if ((rates = calloc(1, sizeof(ratehist_t))) == NULL)
+	    return -ENOMEM;
+	metric->rates = rates;
+    }
+    if (metric->desc.indom == PM_INDOM_NULL)
+	size = 1;
+    else
+	size = metric->u.vlist ? metric->u.vlist->listcount : 0;
+    if (size > rates->size) {
+	if ((swap = realloc(rates->values, size * sizeof(ratevalue_t))) == NULL)
+	    return -ENOMEM;
+	rates->values = swap;
+	if ((swap = realloc(rates->spare, size * sizeof(ratevalue_t))) == NULL)
+	    return -ENOMEM;
+	rates->spare = swap;
+	rates->size = size;
+    }
+
+    if (metric->updated == 0) {
+	/* keep the previous values for the next successful sample */
+	for (k = 0; k < rates->count; k++)
+	    rates->values[k].valid = 0;
+	return 0;
+    }
+
+    delta = rates->count ? pmtimespecSub(stamp, &rates->stamp) : 0;
+    if (metric->desc.indom == PM_INDOM_NULL)
+	n = webgroup_rate_sample(rates, n, PM_IN_NULL,
+			webgroup_rate_double(type, &metric->u.atom), delta);
+    else for (k = 0; k < size; k++) {
+	value = &metric->u.vlist->value[k];
+	if (value->updated)
+	    n = webgroup_rate_sample(rates, n, value->inst,
+			webgroup_rate_double(type, &value->atom), delta);
+    }
+
+    swap = rates->values;
+    rates->values = rates->spare;
+    rates->spare = swap;
+    rates->count = n;
+    rates->stamp = *stamp;
+    return 0;
+}
+
+/* encode the rate for one instance of a counter, zero if there is none */
+static int
+webgroup_rate_value(sds *value, struct metric *metric, unsigned int hint, int inst)
+{
+    ratevalue_t		*rate;
+
+    if (metric->rates == NULL ||
+	(rate = webgroup_rate_lookup(metric->rates->values,
+				metric->rates->count, hint, inst)) == NULL ||
+	rate->valid == 0)
+	return 0;
+    sdsclear(*value);
+    *value = webgroup_encode_double(*value, rate->rate, "%.16g", 1e15);
+    return 1;
+}
+
 static int
 webgroup_fetch(pmWebGroupSettings *settings, context_t *cp,
 		int numpmid, struct metric **mplist, pmID *pmidlist,
-		sds *message, void *arg)
+		int rates, sds *message, void *arg)
 {
     struct instance	*instance;
     struct metric	*metric;
@@ -677,7 +1002,8 @@ webgroup_fetch(pmWebGroupSettings *settings, context_t *cp,
     char		err[PM_MAXERRMSGLEN];
     sds			v = sdsempty(), series = NULL;
     sds			id = cp->origin;
-    int			i, j, k, sts, inst, type, status = 0;
+    unsigned int	n;
+    int			i, j, k, sts, inst, type, rate, status = 0;
 
     if ((sts = pmFetchHighRes(numpmid, pmidlist, &result)) >= 0) {
 	webresult.seconds = result->timestamp.tv_sec;
@@ -686,15 +1012,21 @@ webgroup_fetch(pmWebGroupSettings *settings, context_t *cp,
 	settings->callbacks.on_fetch(id, &webresult, arg);
 
 	/* extract all values from the result */
-	for (i = 0; i < numpmid; i++)
-	    if ((metric = mplist[i]) != NULL)
-		pmwebapi_add_valueset(mplist[i], result->vset[i]);
+	for (i = 0; i < numpmid; i++) {
+	    if ((metric = mplist[i]) == NULL)
+		continue;
+	    pmwebapi_add_valueset(metric, result->vset[i]);
+	    if (rates && webgroup_rate_metric(metric) &&
+		webgroup_rate_update(metric, &result->timestamp) < 0)
+		mplist[i] = NULL;	/* out-of-memory, skip this metric */
+	}
 
 	/* for each metric, send fresh values */
 	for (i = 0; i < numpmid; i++) {
 	    if ((metric = mplist[i]) == NULL)
 		continue;
 	    type = metric->desc.type;
+	    rate = rates && webgroup_rate_metric(metric);
 
 	    for (j = 0; j < metric->numnames; j++) {
 		series = pmwebapi_hash_sds(series, metric->names[j].hash);
@@ -707,7 +1039,10 @@ webgroup_fetch(pmWebGroupSettings *settings, context_t *cp,
 
 		webvalue.pmid = metric->desc.pmid;
 		if (metric->desc.indom == PM_INDOM_NULL) {
-		    v = webgroup_encode_value(v, type, &metric->u.atom);
+		    if (!rate)
+			v = webgroup_encode_value(v, type, &metric->u.atom);
+		    else if (!webgroup_rate_value(&v, metric, 0, PM_IN_NULL))
+			continue;
 		    webvalue.series = series;
 		    webvalue.inst = PM_IN_NULL;
 		    webvalue.value = v;
@@ -727,7 +1062,7 @@ webgroup_fetch(pmWebGroupSettings *settings, context_t *cp,
 		if (metric->u.vlist == NULL)
 		    continue;
 
-		for (k = 0; k < metric->u.vlist->listcount; k++) {
+		for (n = k = 0; k < metric->u.vlist->listcount; k++) {
 		    value = &metric->u.vlist->value[k];
 		    if (value->updated == 0)
 			continue;
@@ -741,7 +1076,10 @@ webgroup_fetch(pmWebGroupSettings *settings, context_t *cp,
 			else
 			    continue;
 		    }
-		    v = webgroup_encode_value(v, type, &value->atom);
+		    if (!rate)
+			v = webgroup_encode_value(v, type, &value->atom);
+		    else if (!webgroup_rate_value(&v, metric, n++, inst))
+			continue;
 		    series = pmwebapi_hash_sds(series, instance->name.hash);
 		    webvalue.series = series;
 		    webvalue.inst = inst;
@@ -828,7 +1166,7 @@ webgroup_lookup_metric(pmWebGroupSettings *settings, context_t *cp, sds name, vo
 static int
 webgroup_fetch_names(pmWebGroupSettings *settings, context_t *cp, int fail,
 	int numnames, sds *names, struct metric **mplist, pmID *pmidlist,
-	sds *message, void *arg)
+	int rates, sds *message, void *arg)
 {
     struct metric	*metric;
     int			i, sts = 0;
@@ -842,13 +1180,14 @@ webgroup_fetch_names(pmWebGroupSettings *settings, context_t *cp, int fail,
 	    return -EINVAL;
 	pmidlist[i] = metric ? metric->desc.pmid : PM_ID_NULL;
     }
-    return webgroup_fetch(settings, cp, numnames, mplist, pmidlist, message, arg);
+    return webgroup_fetch(settings, cp, numnames, mplist, pmidlist,
+			rates, message, arg);
 }
 
 static int
 webgroup_fetch_pmids(pmWebGroupSettings *settings, context_t *cp, int fail,
 	int numpmids, sds *names, struct metric **mplist, pmID *pmidlist,
-	sds *message, void *arg)
+	int rates, sds *message, void *arg)
 {
     struct metric	*metric;
     int			i, sts = 0;
@@ -863,7 +1202,8 @@ webgroup_fetch_pmids(pmWebGroupSettings *settings, context_t *cp, int fail,
 	pmidlist[i] = metric ? metric->desc.pmid : PM_ID_NULL;
     }
 
-    return webgroup_fetch(settings, cp, numpmids, mplist, pmidlist, message, arg);
+    return webgroup_fetch(settings, cp, numpmids, mplist, pmidlist,
+			rates, message, arg);
 }
 
 void
@@ -873,10 +1213,12 @@ pmWebGroupFetch(pmWebGroupSettings *settings, sds id, dict *params, void *arg)
     struct metric	**mplist = NULL;
     size_t		length;
     pmID		*pmidlist = NULL;
-    sds			msg = NULL, metrics, pmids = NULL, *names = NULL;
-    int			sts = 0, singular = 0, numnames = 0;
+    sds			msg = NULL, metrics, pmids = NULL, *names = NULL, value;
+    int			sts = 0, singular = 0, numnames = 0, rates = 0;
 
     if (params) {
+	if ((value = dictFetchValue(params, PARAM_RATE)) != NULL)
+	    rates = (strcmp(value, "true") == 0);
 	if ((metrics = dictFetchValue(params, PARAM_MNAMES)) == NULL) {
 	    if ((metrics = dictFetchValue(params, PARAM_MNAME)) == NULL) {
 		if ((pmids = dictFetchValue(params, PARAM_PMIDS)) == NULL) {
@@ -907,8 +1249,8 @@ pmWebGroupFetch(pmWebGroupSettings *settings, sds id, dict *params, void *arg)
 	    if (pmDebugOptions.libweb)
 		fprintf(stderr, "%s: fetch %d names (%s,...)\n",
 				"pmWebGroupFetch", numnames, names[0]);
-	    sts = webgroup_fetch_names(settings, cp, singular,
-				numnames, names, mplist, pmidlist, &msg, arg);
+	    sts = webgroup_fetch_names(settings, cp, singular, numnames,
+				names, mplist, pmidlist, rates, &msg, arg);
 	}
     }
     /* handle fetch via numeric/dotted-form PMIDs */
@@ -923,8 +1265,8 @@ pmWebGroupFetch(pmWebGroupSettings *settings, sds id, dict *params, void *arg)
 	    if (pmDebugOptions.libweb)
 		fprintf(stderr, "%s: fetch %d pmids (%s,...)\n",
 				"pmWebGroupFetch", numnames, names[0]);
-	    sts = webgroup_fetch_pmids(settings, cp, singular,
-				numnames, names, mplist, pmidlist, &msg, arg);
+	    sts = webgroup_fetch_pmids(settings, cp, singular, numnames,
+				names, mplist, pmidlist, rates, &msg, arg);
 	}
     }
     else {
@@ -1664,6 +2006,7 @@ scrape_metric_labelsets(metric_t *metric, pmWebLabelSet *labels)
     domain_t	*domain = cluster->domain;
     context_t	*context = domain->context;
     indom_t	*indom = metric->indom;
+    pmLabelSet	*merged;
     int		nsets = 0;
 
     if (context->labelset)
@@ -1676,6 +2019,13 @@ scrape_metric_labelsets(metric_t *metric, pmWebLabelSet *labels)
 	labels->sets[nsets++] = cluster->labelset;
     if (metric->labelset)
 	labels->sets[nsets++] = metric->labelset;
+    /* use the memoised merge of the hierarchy, if possible */
+    if (nsets > 1 &&
+	(merged = pmwebapi_merged_labelset(metric, NULL,
+					labels->sets, nsets)) != NULL) {
+	labels->sets[0] = merged;
+	nsets = 1;
+    }
     labels->nsets = nsets;
     sdsclear(labels->buffer);
     labels->instid = PM_IN_NULL;
@@ -1689,6 +2039,7 @@ scrape_instance_labelsets(metric_t *metric, indom_t *indom, instance_t *inst,
     domain_t	*domain = indom->domain;
     context_t	*context = domain->context;
     cluster_t	*cluster = metric->cluster;
+    pmLabelSet	*merged;
     int		nsets = 0;
 
     if (context->labelset)
@@ -1703,12 +2054,71 @@ scrape_instance_labelsets(metric_t *metric, indom_t *indom, instance_t *inst,
 	labels->sets[nsets++] = metric->labelset;
     if (inst->labelset)
 	labels->sets[nsets++] = inst->labelset;
+    /* use the memoised merge of the hierarchy, if possible */
+    if (nsets > 1 &&
+	(merged = pmwebapi_merged_labelset(metric, inst,
+					labels->sets, nsets)) != NULL) {
+	labels->sets[0] = merged;
+	nsets = 1;
+    }
     labels->nsets = nsets;
     sdsclear(labels->buffer);
     labels->instid = inst->inst;
     labels->instname = inst->name.sds;
 }
 
+/*
+ * PMCD reported a label change, so discard the label metadata cached
+ * for metrics and instance domains - these are then refreshed lazily,
+ * as they were on the first scrape.
+ */
+static void
+webgroup_reset_labels(context_t *cp)
+{
+    dictIterator	*iterator, *instances;
+    dictEntry		*entry, *ientry;
+    instance_t		*instance;
+    metric_t		*metric;
+    indom_t		*indom;
+
+    pmwebapi_labels_changed(cp);	/* memoised merged labels are stale */
+
+    if (cp->pmids) {
+	iterator = dictGetIterator(cp->pmids);
+	while ((entry = dictNext(iterator)) != NULL) {
+	    metric = (metric_t *)dictGetVal(entry);
+	    if (metric->labelset) {
+		pmFreeLabelSets(metric->labelset, 1);
+		metric->labelset = NULL;
+	    }
+	    sdsfree(metric->labels);
+	    metric->labels = NULL;
+	}
+	dictReleaseIterator(iterator);
+    }
+    if (cp->indoms) {
+	iterator = dictGetIterator(cp->indoms);
+	while ((entry = dictNext(iterator)) != NULL) {
+	    indom = (indom_t *)dictGetVal(entry);
+	    if (indom->labelset) {
+		pmFreeLabelSets(indom->labelset, 1);
+		indom->labelset = NULL;
+	    }
+	    sdsfree(indom->labels);
+	    indom->labels = NULL;
+	    indom->updated = 0;
+	    instances = dictGetIterator(indom->insts);
+	    while ((ientry = dictNext(instances)) != NULL) {
+		instance = (instance_t *)dictGetVal(ientry);
+		sdsfree(instance->labels);
+		instance->labels = NULL;
+	    }
+	    dictReleaseIterator(instances);
+	}
+	dictReleaseIterator(iterator);
+    }
+}
+
 static int
 webgroup_scrape(pmWebGroupSettings *settings, context_t *cp,
 		int numpmid, struct metric **mplist, pmID *pmidlist,
@@ -1733,6 +2143,8 @@ webgroup_scrape(pmWebGroupSettings *settings, context_t *cp,
     sdsclear(labels.buffer);
 
     if ((sts = pmFetchHighRes(numpmid, pmidlist, &result)) >= 0) {
+	if (sts & PMCD_LABEL_CHANGE)
+	    webgroup_reset_labels(cp);
 	scrape.seconds = result->timestamp.tv_sec;
 	scrape.nanoseconds = result->timestamp.tv_nsec;
 
@@ -1841,25 +2253,7 @@ webgroup_scrape(pmWebGroupSettings *settings, context_t *cp,
     sdsfree(series);
     sdsfree(labels.buffer);
 
-    return sts < 0 ? sts : 0;
-}
-
-static int
-webgroup_scrape_names(pmWebGroupSettings *settings, context_t *cp,
-	int numnames, sds *names, struct metric **mplist, pmID *pmidlist,
-	sds *msg, void *arg)
-{
-    struct metric	*metric;
-    int			i, sts = 0;
-
-    if (webgroup_use_context(cp, &sts, msg, arg) == NULL)
-	return sts;
-
-    for (i = 0; i < numnames; i++) {
-	metric = mplist[i] = webgroup_lookup_metric(settings, cp, names[i], arg);
-	pmidlist[i] = metric ? metric->desc.pmid : PM_ID_NULL;
-    }
-    return webgroup_scrape(settings, cp, numnames, mplist, pmidlist, msg, arg);
+    return sts;	/* negative error or pmcd state change flags */
 }
 
 typedef struct webscrape {
@@ -1867,71 +2261,136 @@ typedef struct webscrape {
     struct context	*context;
     sds			*msg;
     int			status;
-    unsigned int	numnames;	/* current count of metric names */
-    sds			*names;		/* metric names for batched up scrape */
-    struct metric	**mplist;
-    pmID		*pmidlist;
+    scrapeplan_t	*plan;		/* plan being built by traversal */
+    unsigned int	maxnames;	/* allocated size of plan arrays */
     void		*arg;
 } webscrape_t;
 
-/* Metric namespace traversal callback for use with pmTraversePMNS_r(3) */
+/*
+ * Metric namespace traversal callback for use with pmTraversePMNS_r(3),
+ * resolving each name (metadata is cached in the context) into the plan.
+ */
 static void
 webgroup_scrape_batch(const char *name, void *arg)
 {
     struct webscrape	*scrape = (struct webscrape *)arg;
-    int			i, sts;
+    scrapeplan_t	*plan = scrape->plan;
+    struct metric	*metric, **mplist;
+    pmID		*pmidlist;
+    unsigned int	size;
+    sds			msname;
+
+    msname = sdsnew(name);
+    metric = webgroup_lookup_metric(scrape->settings, scrape->context,
+				    msname, scrape->arg);
+    sdsfree(msname);
+    if (metric == NULL)
+	return;
 
-    if (scrape->names == NULL) {
-	scrape->names = calloc(DEFAULT_BATCHSIZE, sizeof(sds));
-	scrape->mplist = calloc(DEFAULT_BATCHSIZE, sizeof(metric_t *));
-	scrape->pmidlist = calloc(DEFAULT_BATCHSIZE, sizeof(pmID));
-	scrape->numnames = 0;
+    if (plan->numpmid == scrape->maxnames) {
+	size = scrape->maxnames ? scrape->maxnames * 2 : DEFAULT_BATCHSIZE;
+	if ((mplist = realloc(plan->mplist, size * sizeof(metric_t *))) == NULL) {
+	    scrape->status = -ENOMEM;
+	    return;
+	}
+	plan->mplist = mplist;
+	if ((pmidlist = realloc(plan->pmidlist, size * sizeof(pmID))) == NULL) {
+	    scrape->status = -ENOMEM;
+	    return;
+	}
+	plan->pmidlist = pmidlist;
+	scrape->maxnames = size;
     }
+    plan->mplist[plan->numpmid] = metric;
+    plan->pmidlist[plan->numpmid] = metric->desc.pmid;
+    plan->numpmid++;
+}
+
+static void
+webgroup_free_plan(scrapeplan_t *plan)
+{
+    free(plan->mplist);
+    free(plan->pmidlist);
+    free(plan);
+}
+
+/*
+ * Find the scrape plan for a namespace prefix in this context, else
+ * traverse the namespace once to build it.  Plans are dropped when a
+ * fetch reports that the PMNS (or set of PMDAs) in pmcd has changed.
+ */
+static scrapeplan_t *
+webgroup_scrape_plan(const char *prefix, struct webscrape *scrape, int *status)
+{
+    struct context	*cp = scrape->context;
+    scrapeplan_t	*plan;
+    sds			key;
+    int			sts;
 
-    scrape->names[scrape->numnames] = sdsnew(name);
-    scrape->numnames++;
+    key = sdsnew(prefix);
+    if (cp->scrapes && (plan = dictFetchValue(cp->scrapes, key)) != NULL) {
+	sdsfree(key);
+	return plan;
+    }
 
-    if (scrape->numnames == DEFAULT_BATCHSIZE) {
-	sts = webgroup_scrape_names(scrape->settings, scrape->context,
-			scrape->numnames, scrape->names,
-			scrape->mplist, scrape->pmidlist,
-			scrape->msg, scrape->arg);
-	for (i = 0; i < scrape->numnames; i++)
-	    sdsfree(scrape->names[i]);
-	scrape->numnames = 0;
-	if (sts < 0)
-	    scrape->status = sts;
+    if ((plan = calloc(1, sizeof(scrapeplan_t))) == NULL) {
+	sdsfree(key);
+	*status = -ENOMEM;
+	return NULL;
+    }
+    scrape->plan = plan;
+    scrape->maxnames = 0;
+    scrape->status = 0;
+    sts = pmTraversePMNS_r(prefix, webgroup_scrape_batch, scrape);
+    scrape->plan = NULL;
+    if (sts >= 0)
+	sts = scrape->status;
+    if (sts < 0 || plan->numpmid == 0) {
+	webgroup_free_plan(plan);
+	sdsfree(key);
+	*status = (sts < 0) ? sts : PM_ERR_NAME;
+	return NULL;
     }
+
+    if (pmDebugOptions.libweb)
+	fprintf(stderr, "%s: new plan for prefix \"%s\" with %u metrics\n",
+			"webgroup_scrape_plan", prefix, plan->numpmid);
+
+    if (cp->scrapes == NULL)
+	cp->scrapes = dictCreate(&sdsKeyDictCallBacks, NULL);
+    dictAdd(cp->scrapes, key, plan);	/* key is duplicated */
+    sdsfree(key);
+    return plan;
 }
 
 static int
 webgroup_scrape_tree(const char *prefix, struct webscrape *scrape)
 {
-    int			i, sts;
+    struct context	*cp = scrape->context;
+    scrapeplan_t	*plan;
+    int			sts = 0;
     char		err[PM_MAXERRMSGLEN];
 
     if (pmDebugOptions.libweb)
 	fprintf(stderr, "%s: scraping namespace prefix \"%s\"\n",
 			"pmWebGroupScrape", prefix);
 
-    sts = pmTraversePMNS_r(prefix, webgroup_scrape_batch, scrape);
-    if (sts >= 0 && scrape->status >= 0 && scrape->numnames) {
-	/* complete any remaining (sub-batchsize) leftovers */
-	sts = webgroup_scrape_names(scrape->settings, scrape->context,
-				    scrape->numnames, scrape->names,
-				    scrape->mplist, scrape->pmidlist,
-				    scrape->msg, scrape->arg);
-	for (i = 0; i < scrape->numnames; i++)
-	    sdsfree(scrape->names[i]);
-	scrape->numnames = 0;
-    } else {
+    if (webgroup_use_context(cp, &sts, scrape->msg, scrape->arg) == NULL)
+	return sts;
+
+    if ((plan = webgroup_scrape_plan(prefix, scrape, &sts)) == NULL) {
 	infofmt(*scrape->msg, "'%s' - %s", prefix,
 		pmErrStr_r(sts, err, sizeof(err)));
+	return sts;
     }
 
-    if (sts >= 0)
-	sts = (scrape->status < 0) ? scrape->status : 0;
-    return sts;
+    sts = webgroup_scrape(scrape->settings, cp, plan->numpmid,
+			plan->mplist, plan->pmidlist, scrape->msg, scrape->arg);
+
+    /* namespace changes, or failure (possibly lost pmcd), drop every plan */
+    if (sts < 0 || (sts & (PMCD_NAMES_CHANGE | PMCD_AGENT_CHANGE)))
+	pmwebapi_free_scrapes(cp);
+    return sts < 0 ? sts : 0;
 }
 
 void
@@ -1973,12 +2432,6 @@ pmWebGroupScrape(pmWebGroupSettings *settings, sds id, dict *params, void *arg)
 	sts = webgroup_scrape_tree("", &scrape);
     }
 
-    if (scrape.names) {
-	free(scrape.names);
-	free(scrape.mplist);
-	free(scrape.pmidlist);
-    }
-
 done:
     settings->callbacks.on_done(id, sts, msg, arg);
     webgroup_deref_context(cp);
@@ -2257,6 +2710,7 @@ pmWebGroupSetup(pmWebGroupModule *module)
     PARAM_TARGET = sdsnew("target");
     PARAM_EXPR = sdsnew("expr");
     PARAM_MATCH = sdsnew("match");
+    PARAM_RATE = sdsnew("rate");
 
     /* generally needed strings, error messages */
     EMPTYSTRING = sdsnew("");
@@ -2264,6 +2718,8 @@ pmWebGroupSetup(pmWebGroupModule *module)
     WORK_TIMER = sdsnew("pmwebapi.work");
     POLL_TIMEOUT = sdsnew("pmwebapi.timeout");
     BATCHSIZE = sdsnew("pmwebapi.batchsize");
+    POOL_SIZE = sdsnew("pmwebapi.poolsize");
+    POOL_TIMEOUT = sdsnew("pmwebapi.pooltime");
     AUTH_USERNAME = sdsnew("auth.username");
     AUTH_PASSWORD = sdsnew("auth.password");
 
@@ -2321,6 +2777,22 @@ pmWebGroupSetConfiguration(pmWebGroupModule *module, dict *config)
 	    default_batchsize = DEFAULT_BATCHSIZE;
     }
 
+    if ((value = dictFetchValue(config, POOL_SIZE)) == NULL) {
+	default_poolsize = DEFAULT_POOL_SIZE;
+    } else {
+	default_poolsize = strtoul(value, &endnum, 0);
+	if (*endnum != '\0')
+	    default_poolsize = DEFAULT_POOL_SIZE;
+    }
+
+    if ((value = dictFetchValue(config, POOL_TIMEOUT)) == NULL) {
+	default_pooltime = DEFAULT_POOL_TIMEOUT;
+    } else {
+	default_pooltime = strtoul(value, &endnum, 0);
+	if (*endnum != '\0')
+	    default_pooltime = DEFAULT_POOL_TIMEOUT;
+    }
+
     if (groups) {
 	groups->config = config;
 	return 0;
@@ -2334,6 +2806,7 @@ pmWebGroupSetupMetrics(pmWebGroupModule *module)
     struct webgroups	*groups = webgroups_lookup(module);
     pmAtomValue		**ap;
     pmUnits		nounits = MMV_UNITS(0,0,0,0,0,0);
+    pmUnits		countunits = MMV_UNITS(0,0,1,0,0,PM_COUNT_ONE);
     void		*map;
 
     if (groups == NULL || groups->registry == NULL)
@@ -2349,11 +2822,24 @@ pmWebGroupSetupMetrics(pmWebGroupModule *module)
 	"contexts dropped in last garbage collection",
 	"Contexts dropped during most recent webgroup garbage collection");
 
+    mmv_stats_add_metric(groups->registry, "pool.context.reuses", 3,
+	MMV_TYPE_U64, MMV_SEM_COUNTER, countunits, MMV_INDOM_NULL,
+	"new contexts using a pooled pmcd connection",
+	"Count of new webgroup contexts which reused the idle pmcd connection\n"
+	"of an earlier context with the same hostspec, rather than connecting");
+
+    mmv_stats_add_metric(groups->registry, "pool.context.idle", 4,
+	MMV_TYPE_U32, MMV_SEM_INSTANT, nounits, MMV_INDOM_NULL,
+	"idle pmcd connections currently pooled",
+	"Number of pmcd connections kept open for reuse by new contexts");
+
     groups->map = map = mmv_stats_start(groups->registry);
 
     ap = groups->metrics;
     ap[WEBGROUP_GC_DROPS] = mmv_lookup_value_desc(map, "gc.context.scans", NULL);
     ap[WEBGROUP_GC_COUNT] = mmv_lookup_value_desc(map, "gc.context.drops", NULL);
+    ap[WEBGROUP_POOL_REUSE] = mmv_lookup_value_desc(map, "pool.context.reuses", NULL);
+    ap[WEBGROUP_POOL_IDLE] = mmv_lookup_value_desc(map, "pool.context.idle", NULL);
 }
 
 
@@ -2384,7 +2870,9 @@ pmWebGroupClose(pmWebGroupModule *module)
 	    webgroup_drop_context((context_t *)dictGetVal(entry), NULL);
 	dictReleaseIterator(iterator);
 	dictRelease(groups->contexts);
+	webgroup_expire_pool(groups, 1);
 	webgroup_timers_stop(groups);
+	timer_wheel_close(&groups->wheel);	/* releases dropped contexts */
 	memset(groups, 0, sizeof(struct webgroups));
 	free(groups);
 	module->privdata = NULL;
@@ -2407,6 +2895,7 @@ pmWebGroupClose(pmWebGroupModule *module)
     sdsfree(PARAM_TARGET);
     sdsfree(PARAM_EXPR);
     sdsfree(PARAM_MATCH);
+    sdsfree(PARAM_RATE);
 
     /* generally needed strings, error messages */
     sdsfree(EMPTYSTRING);
@@ -2414,6 +2903,8 @@ pmWebGroupClose(pmWebGroupModule *module)
     sdsfree(WORK_TIMER);
     sdsfree(POLL_TIMEOUT);
     sdsfree(BATCHSIZE);
+    sdsfree(POOL_SIZE);
+    sdsfree(POOL_TIMEOUT);
     sdsfree(AUTH_USERNAME);
     sdsfree(AUTH_PASSWORD);
 }
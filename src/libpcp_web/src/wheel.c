@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+#include "pmapi.h"
+#include "libpcp.h"
+#include "wheel.h"
+
+/*
+ * Timers are kept in WHEEL_LEVELS levels of WHEEL_SLOTS slots each.
+ * Level zero has one slot per tick for timers expiring within the
+ * next WHEEL_SLOTS ticks, each slot of level one covers WHEEL_SLOTS
+ * ticks, and so on.  As the wheel turns, the timers in the next slot
+ * of a higher level are cascaded down whenever the lower level wraps,
+ * so that insertion and removal are constant time regardless of the
+ * number of timers, and each tick only visits the timers expiring.
+ *
+ * Timers can be armed and cancelled from any thread, and callbacks
+ * are made from the event loop thread with the wheel locked - they
+ * must not arm or cancel timers themselves.
+ */
+
+static uint64_t
+wheel_clock(timer_wheel_t *wheel)
+{
+    /* uv_hrtime is thread-safe, unlike uv_now on another thread's loop */
+    return uv_hrtime() / 1000000 / wheel->resolution;
+}
+
+static void
+wheel_link(timer_wheel_t *wheel, wheel_timer_t *timer)
+{
+    wheel_timer_t	**slot;
+    uint64_t		delta;
+    int			level;
+
+    if (timer->expiry < wheel->now)
+	timer->expiry = wheel->now;
+    delta = timer->expiry - wheel->now;
+
+    for (level = 0; level < WHEEL_LEVELS - 1; level++)
+	if (delta < (1ULL << (WHEEL_BITS * (level + 1))))
+	    break;
+    if (delta >= (1ULL << (WHEEL_BITS * WHEEL_LEVELS)))	/* clamp */
+	timer->expiry = wheel->now + (1ULL << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+
+    slot = &wheel->slots[level][(timer->expiry >> (WHEEL_BITS * level)) & WHEEL_MASK];
+    if ((timer->next = *slot) != NULL)
+	timer->next->prev = &timer->next;
+    timer->prev = slot;
+    *slot = timer;
+}
+
+static void
+wheel_unlink(wheel_timer_t *timer)
+{
+    if ((*timer->prev = timer->next) != NULL)
+	timer->next->prev = timer->prev;
+    timer->next = NULL;
+    timer->prev = NULL;
+}
+
+/*
+ * Move the timers from the current slot of the given level down to
+ * the lower levels, returns the slot index (zero when this level has
+ * also wrapped, and the next level up must be cascaded as well).
+ */
+static unsigned int
+wheel_cascade(timer_wheel_t *wheel, int level)
+{
+    wheel_timer_t	*timer, *list;
+    unsigned int	index;
+
+    index = (wheel->now >> (WHEEL_BITS * level)) & WHEEL_MASK;
+    list = wheel->slots[level][index];
+    wheel->slots[level][index] = NULL;
+    while ((timer = list) != NULL) {
+	list = timer->next;
+	wheel_link(wheel, timer);
+    }
+    return index;
+}
+
+/*
+ * Expire every timer up to the current tick - with a tick timer that
+ * repeats at the wheel resolution this is normally one slot, but it
+ * catches up should the event loop have been delayed.
+ */
+static void
+wheel_turn(timer_wheel_t *wheel, uint64_t target)
+{
+    wheel_timer_t	*timer, *list;
+    unsigned int	index;
+    int			level;
+
+    while (wheel->pending > 0 && wheel->now <= target) {
+	index = wheel->now & WHEEL_MASK;
+	for (level = 1; index == 0 && level < WHEEL_LEVELS; level++)
+	    index = wheel_cascade(wheel, level);
+	index = wheel->now & WHEEL_MASK;
+
+	/* detach the slot, so expiring timers can be unlinked from it */
+	if ((list = wheel->slots[0][index]) != NULL)
+	    list->prev = &list;
+	wheel->slots[0][index] = NULL;
+	wheel->now++;
+
+	while ((timer = list) != NULL) {
+	    wheel_unlink(timer);
+	    wheel->pending--;
+	    if (timer->callback)
+		timer->callback(timer);
+	}
+    }
+    if (wheel->pending == 0)
+	wheel->now = target + 1;
+}
+
+static void
+wheel_tick(uv_timer_t *arg)
+{
+    uv_handle_t		*handle = (uv_handle_t *)arg;
+    timer_wheel_t	*wheel = (timer_wheel_t *)handle->data;
+
+    uv_mutex_lock(&wheel->mutex);
+    wheel_turn(wheel, wheel_clock(wheel));
+    uv_mutex_unlock(&wheel->mutex);
+}
+
+void
+timer_wheel_init(timer_wheel_t *wheel, unsigned int resolution)
+{
+    memset(wheel, 0, sizeof(*wheel));
+    wheel->resolution = resolution ? resolution : 1;
+    wheel->now = wheel_clock(wheel);
+    uv_mutex_init(&wheel->mutex);
+}
+
+/* Start turning the wheel, on the given event loop. */
+void
+timer_wheel_start(timer_wheel_t *wheel, uv_loop_t *events)
+{
+    if (wheel->active)
+	return;
+    wheel->active = 1;
+    uv_timer_init(events, &wheel->tick);
+    wheel->tick.data = (void *)wheel;
+    uv_timer_start(&wheel->tick, wheel_tick,
+			wheel->resolution, wheel->resolution);
+}
+
+/* Stop turning the wheel, pending timers expire once it is restarted. */
+void
+timer_wheel_stop(timer_wheel_t *wheel)
+{
+    if (wheel->active) {
+	uv_timer_stop(&wheel->tick);
+	uv_close((uv_handle_t *)&wheel->tick, NULL);
+	wheel->active = 0;
+    }
+}
+
+/*
+ * Stop the wheel for good - any timers still pending are expired now,
+ * so that whatever they release is not leaked.
+ */
+void
+timer_wheel_close(timer_wheel_t *wheel)
+{
+    timer_wheel_stop(wheel);
+    uv_mutex_lock(&wheel->mutex);
+    wheel_turn(wheel, UINT64_MAX - 1);
+    uv_mutex_unlock(&wheel->mutex);
+    uv_mutex_destroy(&wheel->mutex);
+}
+
+void
+wheel_timer_init(wheel_timer_t *timer, void *data)
+{
+    memset(timer, 0, sizeof(*timer));
+    timer->data = data;
+}
+
+/*
+ * Arm a one-shot timer to call back after the given number of msec,
+ * or re-arm it if already pending.  Expiry is rounded up to the next
+ * tick, so a timer never expires early but may expire a tick late.
+ */
+void
+wheel_timer_start(timer_wheel_t *wheel, wheel_timer_t *timer,
+		wheel_callback_t callback, uint64_t timeout)
+{
+    uv_mutex_lock(&wheel->mutex);
+    if (timer->prev)
+	wheel_unlink(timer);
+    else
+	wheel->pending++;
+    if (wheel->pending == 1 && wheel->now < wheel_clock(wheel))
+	wheel->now = wheel_clock(wheel);	/* idle wheel catches up */
+    timer->callback = callback;
+    timer->expiry = wheel_clock(wheel) + 1 +
+		(timeout + wheel->resolution - 1) / wheel->resolution;
+    wheel_link(wheel, timer);
+    uv_mutex_unlock(&wheel->mutex);
+}
+
+void
+wheel_timer_stop(timer_wheel_t *wheel, wheel_timer_t *timer)
+{
+    uv_mutex_lock(&wheel->mutex);
+    if (timer->prev) {
+	wheel_unlink(timer);
+	wheel->pending--;
+    }
+    uv_mutex_unlock(&wheel->mutex);
+}
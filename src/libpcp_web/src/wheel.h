@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+#ifndef SERIES_WHEEL_H
+#define SERIES_WHEEL_H
+
+#include <stdint.h>
+#ifdef HAVE_LIBUV
+#include <uv.h>
+#endif
+
+/*
+ * Hierarchical timer wheel - large numbers of one-shot timers driven
+ * by a single libuv timer, with all of the timers expiring within one
+ * tick handled together in a single wakeup.  Timers are embedded in
+ * the structures they time out, so (re)arming and cancelling a timer
+ * never allocates memory.
+ */
+#define WHEEL_BITS	6
+#define WHEEL_SLOTS	(1 << WHEEL_BITS)
+#define WHEEL_MASK	(WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS	4
+
+struct wheel_timer;
+typedef void (*wheel_callback_t)(struct wheel_timer *);
+
+typedef struct wheel_timer {
+    struct wheel_timer	*next;
+    struct wheel_timer	**prev;		/* NULL when timer is not pending */
+    uint64_t		expiry;		/* absolute expiry time, in ticks */
+    wheel_callback_t	callback;
+    void		*data;
+} wheel_timer_t;
+
+#ifdef HAVE_LIBUV
+typedef struct timer_wheel {
+    uv_timer_t		tick;		/* drives every timer on the wheel */
+    uv_mutex_t		mutex;
+    uint64_t		now;		/* next tick to be processed */
+    unsigned int	resolution;	/* tick length, milliseconds */
+    unsigned int	active;		/* tick timer has been started */
+    unsigned int	pending;	/* count of timers currently armed */
+    wheel_timer_t	*slots[WHEEL_LEVELS][WHEEL_SLOTS];
+} timer_wheel_t;
+
+extern void timer_wheel_init(timer_wheel_t *, unsigned int);
+extern void timer_wheel_start(timer_wheel_t *, uv_loop_t *);
+extern void timer_wheel_stop(timer_wheel_t *);
+extern void timer_wheel_close(timer_wheel_t *);
+
+extern void wheel_timer_init(wheel_timer_t *, void *);
+extern void wheel_timer_start(timer_wheel_t *, wheel_timer_t *,
+		wheel_callback_t, uint64_t);
+extern void wheel_timer_stop(timer_wheel_t *, wheel_timer_t *);
+#endif
+
+#endif /* SERIES_WHEEL_H */
@@ -41,7 +41,7 @@ require DynaLoader;
 	PMDA_FETCH_NOVALUES PMDA_FETCH_STATIC PMDA_FETCH_DYNAMIC
 );
 @EXPORT_OK = qw();
-$VERSION = '1.17';
+$VERSION = '1.18';
 
 # metric identification
 sub PM_ID_NULL		{ 0xffffffff; }
@@ -399,6 +399,24 @@ cluster, during the fetch operation.  Only clusters being requested
 during this fetch will be refreshed, allowing selective metric value
 updates within the PMDA.
 
+=item $pmda->set_values(cluster, values)
+
+Replace the value table for all metrics of I<cluster> with I<values>,
+a hash reference keyed by metric item number.  Each entry is either
+the value of a singular metric, or a hash reference of values keyed
+by instance identifier.  Values are then returned for fetches of the
+metrics in this table directly from the table, without calling the
+fetch callback (which remains in use for any metrics not in the table)
+for each metric and instance.  This is usually called from the refresh
+function, once per fetch for each cluster being requested, and is much
+more efficient than the fetch callback for large instance domains.
+Returns the number of values in the table, or a negative error code.
+
+=item $pmda->clear_values(cluster)
+
+Remove the value table for I<cluster>, as set by B<set_values>, so
+that the fetch callback is used for all metrics of that cluster again.
+
 =item $pmda->set_store_callback(cb_function)
 
 Register an store function, used indirectly by B<pmdaInit>(3).
@@ -41,6 +41,19 @@ static SV *instance_func;
 static SV *store_cb_func;
 static SV *fetch_cb_func;
 
+/*
+ * Bulk value tables, one per cluster, replaced from perl (set_values)
+ * typically once per fetch from the cluster refresh method - values
+ * are then served to pmdaFetch from here, without calling back into
+ * perl for every metric and instance.
+ */
+typedef struct {
+    int		type;		/* metric value type */
+    __pmHashCtl	insts;		/* instance -> pmAtomValue */
+} item_values_t;
+
+static __pmHashCtl cluster_values;	/* cluster -> item -> item_values_t */
+
 int
 clustertab_lookup(int cluster)
 {
@@ -315,6 +328,189 @@ input_callback(SV *input_cb_func, int data, char *string)
     LEAVE;
 }
 
+static __pmHashWalkState
+values_free_inst(const __pmHashNode *hp, void *cp)
+{
+    item_values_t	*ip = (item_values_t *)cp;
+    pmAtomValue		*ap = (pmAtomValue *)hp->data;
+
+    if (ip->type == PM_TYPE_STRING)
+	free(ap->cp);
+    free(ap);
+    return PM_HASH_WALK_NEXT;
+}
+
+static __pmHashWalkState
+values_free_item(const __pmHashNode *hp, void *cp)
+{
+    item_values_t	*ip = (item_values_t *)hp->data;
+
+    __pmHashWalkCB(values_free_inst, ip, &ip->insts);
+    __pmHashFree(&ip->insts);
+    free(ip);
+    return PM_HASH_WALK_NEXT;
+}
+
+static void
+values_free(__pmHashCtl *items)
+{
+    __pmHashWalkCB(values_free_item, NULL, items);
+    __pmHashFree(items);
+    free(items);
+}
+
+static int
+values_type(unsigned int cluster, unsigned int item)
+{
+    int		i;
+
+    for (i = 0; i < mtab_size; i++)
+	if (pmID_cluster(metrictab[i].m_desc.pmid) == cluster &&
+	    pmID_item(metrictab[i].m_desc.pmid) == item)
+	    return metrictab[i].m_desc.type;
+    return PM_TYPE_NOSUPPORT;
+}
+
+static int
+values_add(item_values_t *ip, unsigned int inst, SV *value)
+{
+    pmAtomValue	*ap;
+
+    if (!SvOK(value))
+	return 0;	/* undef - no value for this instance */
+    if ((ap = (pmAtomValue *)malloc(sizeof(pmAtomValue))) == NULL)
+	return -ENOMEM;
+    switch (ip->type) {
+	case PM_TYPE_32:	ap->l = SvIV(value); break;
+	case PM_TYPE_U32:	ap->ul = SvUV(value); break;
+	case PM_TYPE_64:	ap->ll = SvIV(value); break;
+	case PM_TYPE_U64:	ap->ull = SvUV(value); break;
+	case PM_TYPE_FLOAT:	ap->f = SvNV(value); break;
+	case PM_TYPE_DOUBLE:	ap->d = SvNV(value); break;
+	case PM_TYPE_STRING:
+	    if ((ap->cp = strdup(SvPV_nolen(value))) == NULL) {
+		free(ap);
+		return -ENOMEM;
+	    }
+	    break;
+    }
+    if (__pmHashAdd(inst, ap, &ip->insts) < 0) {
+	if (ip->type == PM_TYPE_STRING)
+	    free(ap->cp);
+	free(ap);
+	return -ENOMEM;
+    }
+    return 1;
+}
+
+/*
+ * Replace the value table for a cluster from a hash reference keyed
+ * by item number, with either a value (singular metrics) or a hash of
+ * values keyed by instance identifier.  Returns the number of values.
+ */
+static int
+values_update(unsigned int cluster, SV *values)
+{
+    __pmHashCtl		*items;
+    __pmHashNode	*node;
+    item_values_t	*ip;
+    HV			*hv, *ihv;
+    HE			*he, *ihe;
+    SV			*value;
+    char		*key;
+    I32			len;
+    int			type, sts, count = 0;
+
+    if (!SvROK(values) || SvTYPE(SvRV(values)) != SVt_PVHV) {
+	warn("values must be given as a hash reference");
+	return -EINVAL;
+    }
+    if ((items = (__pmHashCtl *)calloc(1, sizeof(__pmHashCtl))) == NULL)
+	return -ENOMEM;
+
+    hv = (HV *)SvRV(values);
+    hv_iterinit(hv);
+    while ((he = hv_iternext(hv)) != NULL) {
+	key = hv_iterkey(he, &len);
+	type = values_type(cluster, strtoul(key, NULL, 10));
+	if (type == PM_TYPE_NOSUPPORT) {
+	    warn("no metric for values of cluster %u item %s", cluster, key);
+	    continue;
+	}
+	if ((ip = (item_values_t *)calloc(1, sizeof(item_values_t))) == NULL ||
+	    __pmHashAdd(strtoul(key, NULL, 10), ip, items) < 0) {
+	    free(ip);
+	    values_free(items);
+	    return -ENOMEM;
+	}
+	ip->type = type;
+
+	value = hv_iterval(hv, he);
+	if (SvROK(value) && SvTYPE(SvRV(value)) == SVt_PVHV) {
+	    ihv = (HV *)SvRV(value);
+	    hv_iterinit(ihv);
+	    while ((ihe = hv_iternext(ihv)) != NULL) {
+		key = hv_iterkey(ihe, &len);
+		sts = values_add(ip, strtoul(key, NULL, 10), hv_iterval(ihv, ihe));
+		if (sts < 0) {
+		    values_free(items);
+		    return sts;
+		}
+		count += sts;
+	    }
+	} else {
+	    if ((sts = values_add(ip, PM_IN_NULL, value)) < 0) {
+		values_free(items);
+		return sts;
+	    }
+	    count += sts;
+	}
+    }
+
+    if ((node = __pmHashSearch(cluster, &cluster_values)) != NULL) {
+	values_free((__pmHashCtl *)node->data);
+	node->data = items;
+    } else if (__pmHashAdd(cluster, items, &cluster_values) < 0) {
+	values_free(items);
+	return -ENOMEM;
+    }
+    return count;
+}
+
+static void
+values_clear(unsigned int cluster)
+{
+    __pmHashNode	*node;
+
+    if ((node = __pmHashSearch(cluster, &cluster_values)) != NULL) {
+	values_free((__pmHashCtl *)node->data);
+	__pmHashDel(cluster, node->data, &cluster_values);
+    }
+}
+
+/*
+ * Returns PM_ERR_PMID if the metric has no value table, else serves
+ * the value for this instance (if any) from it.
+ */
+static int
+values_lookup(pmdaMetric *metric, unsigned int inst, pmAtomValue *atom)
+{
+    __pmHashNode	*node;
+    item_values_t	*ip;
+
+    if (cluster_values.nodes == 0 ||
+	(node = __pmHashSearch(pmID_cluster(metric->m_desc.pmid),
+				&cluster_values)) == NULL ||
+	(node = __pmHashSearch(pmID_item(metric->m_desc.pmid),
+				(__pmHashCtl *)node->data)) == NULL)
+	return PM_ERR_PMID;
+    ip = (item_values_t *)node->data;
+    if ((node = __pmHashSearch(inst, &ip->insts)) == NULL)
+	return PMDA_FETCH_NOVALUES;
+    *atom = *(pmAtomValue *)node->data;
+    return PMDA_FETCH_STATIC;	/* table is only replaced at next refresh */
+}
+
 int
 fetch_callback(pmdaMetric *metric, unsigned int inst, pmAtomValue *atom)
 {
@@ -323,6 +519,12 @@ fetch_callback(pmdaMetric *metric, unsigned int inst, pmAtomValue *atom)
     int		sts;
     STRLEN	n_a;	/* required by older Perl versions, used in POPpx */
 
+    /* values from a bulk value table need no call into perl */
+    if ((sts = values_lookup(metric, inst, atom)) != PM_ERR_PMID)
+	return sts;
+    if (fetch_cb_func == NULL)
+	return PMDA_FETCH_NOVALUES;
+
     ENTER;
     SAVETMPS;	/* allows us to tidy our perl stack changes later */
 
@@ -917,6 +1119,27 @@ set_fetch_callback(self,cb_function)
 	    pmdaSetFetchCallBack(self, fetch_callback);
 	}
 
+int
+set_values(self,cluster,values)
+	pmdaInterface *self
+	unsigned int	cluster
+	SV *	values
+    CODE:
+	RETVAL = values_update(cluster, values);
+	if (RETVAL >= 0)
+	    pmdaSetFetchCallBack(self, fetch_callback);
+    OUTPUT:
+	RETVAL
+
+void
+clear_values(self,cluster)
+	pmdaInterface *self
+	unsigned int	cluster
+    PREINIT:
+	(void)self;
+    CODE:
+	values_clear(cluster);
+
 void
 set_inet_socket(self,port)
 	pmdaInterface *self
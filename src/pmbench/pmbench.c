@@ -0,0 +1,594 @@
+/*
+ * pmbench - load generator and throughput benchmark for pmcd and pmproxy
+ *
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include <ctype.h>
+#include <pthread.h>
+#include "pmapi.h"
+#include "libpcp.h"
+#include "pmhttp.h"
+
+/*
+ * Each client thread has its own PMAPI context (and HTTP client, when
+ * pmproxy requests are in the mix) and issues requests back-to-back,
+ * or paced at a fixed rate, choosing each request at random from the
+ * weighted workload mix.  Latencies are kept per thread and operation
+ * and only merged once all clients have finished, so the measurement
+ * itself adds no contention between the clients.
+ */
+
+enum {
+    OP_FETCH,		/* pmFetch of all metrics */
+    OP_DESC,		/* pmLookupDesc of one metric */
+    OP_INSTANCE,	/* pmGetInDom of one instance domain */
+    OP_LABEL,		/* pmLookupLabels of one metric */
+    OP_WEBFETCH,	/* pmproxy /pmapi/fetch of all metrics */
+    OP_SERIES,		/* pmproxy /series/query */
+    NUM_OPS
+};
+
+static const char *opnames[NUM_OPS] = {
+    "fetch", "desc", "instance", "label", "webfetch", "series",
+};
+
+typedef struct {
+    unsigned int	*usec;		/* latency of each request */
+    unsigned int	count;
+    unsigned int	size;
+    unsigned int	errors;
+    int			error;		/* first error seen */
+} latency_t;
+
+typedef struct {
+    pthread_t		tid;
+    int			id;
+    int			sts;		/* context creation status */
+    unsigned int	seed;
+    latency_t		ops[NUM_OPS];
+} client_t;
+
+static const char	*default_metrics[] = {
+    "sample.load", "sample.colour", "sample.bin", "sample.seconds",
+};
+
+static int		weights[NUM_OPS];
+static int		total_weight;
+static int		nclients = 1;
+static double		rate;		/* requests/sec per client, 0 is flat out */
+static struct timeval	duration = { 10, 0 };
+static struct timeval	finish;
+static char		*source;
+static char		*baseurl = "http://localhost:44322";
+static char		*query;
+
+static int		nmetrics;
+static const char	**metrics;
+static pmID		*pmids;
+static pmInDom		*indoms;
+static int		nindoms;
+static char		*fetchurl;
+static char		*seriesurl;
+
+static pmLongOptions longopts[] = {
+    PMAPI_OPTIONS_HEADER("General options"),
+    PMOPT_DEBUG,
+    PMOPT_HOST,
+    PMOPT_VERSION,
+    PMOPT_HELP,
+    PMAPI_OPTIONS_HEADER("Workload options"),
+    { "clients", 1, 'c', "N", "number of concurrent clients [1]" },
+    { "duration", 1, 'T', "TIME", "run for TIME [10sec]" },
+    { "rate", 1, 'r', "N", "requests per second for each client [unlimited]" },
+    { "mix", 1, 'w', "MIX", "workload mix, op:weight,... [fetch:70,desc:10,instance:10,label:10]" },
+    { "url", 1, 'u', "URL", "pmproxy base URL [http://localhost:44322]" },
+    { "query", 1, 'q', "EXPR", "series query for series requests [first metric]" },
+    PMAPI_OPTIONS_END
+};
+
+static int
+overrides(int opt, pmOptions *opts)
+{
+    if (opt == 'T')
+	return 1;	/* duration, not the end of a time window */
+    return 0;
+}
+
+static pmOptions opts = {
+    .short_options = "c:D:h:q:r:T:u:Vw:?",
+    .long_options = longopts,
+    .short_usage = "[options] [metricname ...]",
+    .override = overrides,
+};
+
+static int
+parse_mix(const char *spec)
+{
+    char	*copy, *item, *save, *weight, *end;
+    int		i, w;
+
+    memset(weights, 0, sizeof(weights));
+    total_weight = 0;
+    if ((copy = strdup(spec)) == NULL)
+	pmNoMem("parse_mix", strlen(spec) + 1, PM_FATAL_ERR);
+    for (item = strtok_r(copy, ",", &save); item;
+	 item = strtok_r(NULL, ",", &save)) {
+	w = 1;
+	if ((weight = strchr(item, ':')) != NULL) {
+	    *weight++ = '\0';
+	    w = (int)strtol(weight, &end, 10);
+	    if (*end != '\0' || w < 0) {
+		pmprintf("%s: bad weight \"%s\" in workload mix\n",
+			pmGetProgname(), weight);
+		goto fail;
+	    }
+	}
+	for (i = 0; i < NUM_OPS; i++)
+	    if (strcmp(item, opnames[i]) == 0)
+		break;
+	if (i == NUM_OPS) {
+	    pmprintf("%s: unknown operation \"%s\" in workload mix\n",
+			pmGetProgname(), item);
+	    goto fail;
+	}
+	weights[i] += w;
+	total_weight += w;
+    }
+    free(copy);
+    if (total_weight == 0) {
+	pmprintf("%s: empty workload mix\n", pmGetProgname());
+	return -1;
+    }
+    return 0;
+
+fail:
+    free(copy);
+    return -1;
+}
+
+/* simple per-client generator, so clients never share random state */
+static int
+choose_op(client_t *cp)
+{
+    unsigned int	r;
+    int			i;
+
+    cp->seed ^= cp->seed << 13;
+    cp->seed ^= cp->seed >> 17;
+    cp->seed ^= cp->seed << 5;
+    r = cp->seed % total_weight;
+    for (i = 0; i < NUM_OPS; i++) {
+	if (r < weights[i])
+	    break;
+	r -= weights[i];
+    }
+    return i;
+}
+
+static void
+record(latency_t *lp, struct timeval *start, int sts)
+{
+    struct timeval	now;
+    double		usec;
+    size_t		size;
+
+    pmtimevalNow(&now);
+    if (sts < 0) {
+	if (lp->errors++ == 0)
+	    lp->error = sts;
+	return;
+    }
+    if (lp->count == lp->size) {
+	lp->size = lp->size ? lp->size * 2 : 1024;
+	size = lp->size * sizeof(unsigned int);
+	if ((lp->usec = (unsigned int *)realloc(lp->usec, size)) == NULL)
+	    pmNoMem("record latency", size, PM_FATAL_ERR);
+    }
+    usec = pmtimevalSub(&now, start) * 1000000.0;
+    lp->usec[lp->count++] = usec < UINT_MAX ? (unsigned int)usec : UINT_MAX;
+}
+
+static int
+pmcd_requests(void)
+{
+    return weights[OP_FETCH] || weights[OP_DESC] ||
+	   weights[OP_INSTANCE] || weights[OP_LABEL];
+}
+
+static int
+http_request(struct http_client *http, const char *url)
+{
+    char	buffer[65536];
+    char	*body = buffer;
+    size_t	length = sizeof(buffer);
+    int		sts;
+
+    if ((sts = pmhttpClientFetch(http, url, body, length, NULL, 0)) < 0)
+	return sts;
+    sts = pmhttpClientGetStatus(http);
+    return (sts >= 200 && sts < 300) ? 0 : PM_ERR_GENERIC;
+}
+
+static int
+do_request(struct http_client *http, int op, int n)
+{
+    pmResult	*result;
+    pmLabelSet	*labels;
+    pmDesc	desc;
+    int		*instlist;
+    char	**namelist;
+    int		sts;
+
+    switch (op) {
+    case OP_FETCH:
+	if ((sts = pmFetch(nmetrics, pmids, &result)) >= 0)
+	    pmFreeResult(result);
+	break;
+    case OP_DESC:
+	sts = pmLookupDesc(pmids[n % nmetrics], &desc);
+	break;
+    case OP_INSTANCE:
+	if ((sts = pmGetInDom(indoms[n % nindoms], &instlist, &namelist)) > 0) {
+	    free(instlist);
+	    free(namelist);
+	}
+	break;
+    case OP_LABEL:
+	if ((sts = pmLookupLabels(pmids[n % nmetrics], &labels)) > 0)
+	    pmFreeLabelSets(labels, sts);
+	break;
+    case OP_WEBFETCH:
+	sts = http_request(http, fetchurl);
+	break;
+    case OP_SERIES:
+	sts = http_request(http, seriesurl);
+	break;
+    default:
+	sts = PM_ERR_GENERIC;
+	break;
+    }
+    return sts;
+}
+
+static void *
+client(void *arg)
+{
+    client_t		*cp = (client_t *)arg;
+    struct http_client	*http = NULL;
+    struct timeval	now, start, next, step;
+    struct timeval	timeout = { 10, 0 };
+    double		delay;
+    int			ctx = -1, op, n = 0;
+
+    if (pmcd_requests() &&
+	(ctx = pmNewContext(PM_CONTEXT_HOST, source)) < 0) {
+	cp->sts = ctx;
+	return NULL;
+    }
+    if (weights[OP_WEBFETCH] || weights[OP_SERIES]) {
+	if ((http = pmhttpNewClient()) == NULL) {
+	    cp->sts = -ENOMEM;
+	    if (ctx >= 0)
+		pmDestroyContext(ctx);
+	    return NULL;
+	}
+	pmhttpClientSetTimeout(http, &timeout);
+	pmhttpClientSetUserAgent(http, pmGetProgname(), PCP_VERSION);
+    }
+
+    if (rate > 0)
+	pmtimevalFromReal(1.0 / rate, &step);
+    pmtimevalNow(&next);
+    for (;;) {
+	pmtimevalNow(&now);
+	if (pmtimevalSub(&now, &finish) >= 0)
+	    break;
+	if (rate > 0) {
+	    if ((delay = pmtimevalSub(&next, &now)) > 0) {
+		struct timespec	ts;
+
+		ts.tv_sec = (time_t)delay;
+		ts.tv_nsec = (long)((delay - ts.tv_sec) * 1000000000.0);
+		nanosleep(&ts, NULL);
+	    }
+	    pmtimevalInc(&next, &step);
+	}
+	op = choose_op(cp);
+	pmtimevalNow(&start);
+	record(&cp->ops[op], &start, do_request(http, op, n++));
+    }
+
+    if (http)
+	pmhttpFreeClient(http);
+    if (ctx >= 0)
+	pmDestroyContext(ctx);
+    return NULL;
+}
+
+static int
+compare(const void *a, const void *b)
+{
+    unsigned int	x = *(const unsigned int *)a;
+    unsigned int	y = *(const unsigned int *)b;
+
+    return x < y ? -1 : (x > y);
+}
+
+static unsigned int
+percentile(unsigned int *usec, unsigned int count, double p)
+{
+    unsigned int	i;
+
+    if (count == 0)
+	return 0;
+    i = (unsigned int)(p / 100.0 * count);
+    return usec[i < count ? i : count - 1];
+}
+
+static void
+report(client_t *clients, double elapsed)
+{
+    latency_t		all;
+    unsigned int	total = 0, errors = 0;
+    int			first[NUM_OPS] = {0};
+    int			i, op;
+
+    printf("%-10s %9s %7s %10s %9s %9s %9s %9s %9s\n",
+	    "operation", "requests", "errors", "req/sec",
+	    "p50(us)", "p90(us)", "p99(us)", "p99.9(us)", "max(us)");
+    for (op = 0; op < NUM_OPS; op++) {
+	if (weights[op] == 0)
+	    continue;
+	memset(&all, 0, sizeof(all));
+	for (i = 0; i < nclients; i++) {
+	    all.count += clients[i].ops[op].count;
+	    all.errors += clients[i].ops[op].errors;
+	    if (first[op] == 0)
+		first[op] = clients[i].ops[op].error;
+	}
+	if (all.count &&
+	    (all.usec = (unsigned int *)malloc(all.count * sizeof(unsigned int))) == NULL)
+	    pmNoMem("report", all.count * sizeof(unsigned int), PM_FATAL_ERR);
+	for (i = 0; i < nclients; i++) {
+	    latency_t	*lp = &clients[i].ops[op];
+
+	    if (lp->count)
+		memcpy(&all.usec[all.size], lp->usec, lp->count * sizeof(unsigned int));
+	    all.size += lp->count;
+	}
+	qsort(all.usec, all.count, sizeof(unsigned int), compare);
+	printf("%-10s %9u %7u %10.1f %9u %9u %9u %9u %9u\n",
+		opnames[op], all.count, all.errors, all.count / elapsed,
+		percentile(all.usec, all.count, 50),
+		percentile(all.usec, all.count, 90),
+		percentile(all.usec, all.count, 99),
+		percentile(all.usec, all.count, 99.9),
+		all.count ? all.usec[all.count - 1] : 0);
+	total += all.count;
+	errors += all.errors;
+	free(all.usec);
+    }
+    printf("%-10s %9u %7u %10.1f\n", "total", total, errors, total / elapsed);
+
+    for (op = 0; op < NUM_OPS; op++)
+	if (first[op] < 0)
+	    printf("%s: first error: %s\n", opnames[op], pmErrStr(first[op]));
+}
+
+static char *
+make_url(const char *path, const char *param, const char *value)
+{
+    size_t	length;
+    char	*url;
+    const char	*p;
+    char	*q;
+
+    /* worst case, every character of value is percent-encoded */
+    length = strlen(baseurl) + strlen(path) + strlen(param) + 3 * strlen(value) + 2;
+    if ((url = (char *)malloc(length)) == NULL)
+	pmNoMem("make_url", length, PM_FATAL_ERR);
+    q = url + pmsprintf(url, length, "%s%s%s=", baseurl, path, param);
+    for (p = value; *p; p++) {
+	if (isalnum((int)*p) || strchr("-_.~,", *p) != NULL)
+	    *q++ = *p;
+	else
+	    q += sprintf(q, "%%%02X", (unsigned char)*p);
+    }
+    *q = '\0';
+    return url;
+}
+
+static int
+setup(void)
+{
+    pmDesc	desc;
+    size_t	length;
+    char	*names;
+    int		i, j, ctx, sts;
+
+    if ((pmids = (pmID *)calloc(nmetrics, sizeof(pmID))) == NULL ||
+	(indoms = (pmInDom *)calloc(nmetrics, sizeof(pmInDom))) == NULL)
+	pmNoMem("setup", nmetrics * sizeof(pmID), PM_FATAL_ERR);
+
+    if (pmcd_requests()) {
+	if ((ctx = pmNewContext(PM_CONTEXT_HOST, source)) < 0) {
+	    fprintf(stderr, "%s: Cannot connect to PMCD on host \"%s\": %s\n",
+		    pmGetProgname(), source, pmErrStr(ctx));
+	    return ctx;
+	}
+	if ((sts = pmLookupName(nmetrics, metrics, pmids)) < 0) {
+	    fprintf(stderr, "%s: pmLookupName: %s\n",
+		    pmGetProgname(), pmErrStr(sts));
+	    return sts;
+	}
+	for (i = 0; i < nmetrics; i++) {
+	    if (pmids[i] == PM_ID_NULL) {
+		fprintf(stderr, "%s: %s: %s\n", pmGetProgname(), metrics[i],
+			pmErrStr(PM_ERR_NAME));
+		return PM_ERR_NAME;
+	    }
+	    if ((sts = pmLookupDesc(pmids[i], &desc)) < 0) {
+		fprintf(stderr, "%s: %s: %s\n", pmGetProgname(), metrics[i],
+			pmErrStr(sts));
+		return sts;
+	    }
+	    if (desc.indom == PM_INDOM_NULL)
+		continue;
+	    for (j = 0; j < nindoms; j++)
+		if (indoms[j] == desc.indom)
+		    break;
+	    if (j == nindoms)
+		indoms[nindoms++] = desc.indom;
+	}
+	pmDestroyContext(ctx);
+	if (weights[OP_INSTANCE] && nindoms == 0) {
+	    fprintf(stderr, "%s: no metric with an instance domain for instance requests\n",
+		    pmGetProgname());
+	    return PM_ERR_INDOM;
+	}
+    }
+
+    if (weights[OP_WEBFETCH]) {
+	for (length = 1, i = 0; i < nmetrics; i++)
+	    length += strlen(metrics[i]) + 1;
+	if ((names = (char *)calloc(1, length)) == NULL)
+	    pmNoMem("setup", length, PM_FATAL_ERR);
+	for (i = 0; i < nmetrics; i++) {
+	    if (i)
+		strcat(names, ",");
+	    strcat(names, metrics[i]);
+	}
+	fetchurl = make_url("/pmapi/fetch", "?names", names);
+	free(names);
+    }
+    if (weights[OP_SERIES])
+	seriesurl = make_url("/series/query", "?expr", query ? query : metrics[0]);
+    return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    client_t		*clients;
+    struct timeval	start, end;
+    char		*endnum, *errmsg;
+    char		*mix = "fetch:70,desc:10,instance:10,label:10";
+    int			c, i, sts, failed = 0;
+
+    while ((c = pmGetOptions(argc, argv, &opts)) != EOF) {
+	switch (c) {
+	case 'c':	/* number of clients */
+	    nclients = (int)strtol(opts.optarg, &endnum, 10);
+	    if (*endnum != '\0' || nclients < 1) {
+		pmprintf("%s: -c requires a positive numeric argument\n",
+			pmGetProgname());
+		opts.errors++;
+	    }
+	    break;
+
+	case 'q':	/* series query */
+	    query = opts.optarg;
+	    break;
+
+	case 'r':	/* request rate per client */
+	    rate = strtod(opts.optarg, &endnum);
+	    if (*endnum != '\0' || rate < 0) {
+		pmprintf("%s: -r requires a non-negative numeric argument\n",
+			pmGetProgname());
+		opts.errors++;
+	    }
+	    break;
+
+	case 'T':	/* duration */
+	    if (pmParseInterval(opts.optarg, &duration, &errmsg) < 0) {
+		pmprintf("%s: -T argument not in pmParseInterval(3) format:\n",
+			pmGetProgname());
+		pmprintf("%s\n", errmsg);
+		free(errmsg);
+		opts.errors++;
+	    }
+	    break;
+
+	case 'u':	/* pmproxy URL */
+	    baseurl = opts.optarg;
+	    break;
+
+	case 'w':	/* workload mix */
+	    mix = opts.optarg;
+	    break;
+
+	default:
+	    opts.errors++;
+	    break;
+	}
+    }
+
+    if (!opts.errors && parse_mix(mix) < 0)
+	opts.errors++;
+
+    if (opts.errors || (opts.flags & PM_OPTFLAG_EXIT)) {
+	sts = !(opts.flags & PM_OPTFLAG_EXIT);
+	pmUsageMessage(&opts);
+	exit(sts);
+    }
+
+    if (opts.nhosts > 1) {
+	fprintf(stderr, "%s: only one host may be specified\n", pmGetProgname());
+	exit(1);
+    }
+    source = opts.nhosts ? opts.hosts[0] : "local:";
+
+    if (opts.optind < argc) {
+	metrics = (const char **)&argv[opts.optind];
+	nmetrics = argc - opts.optind;
+    } else {
+	metrics = default_metrics;
+	nmetrics = sizeof(default_metrics) / sizeof(default_metrics[0]);
+    }
+
+    if (setup() < 0)
+	exit(1);
+
+    if ((clients = (client_t *)calloc(nclients, sizeof(client_t))) == NULL)
+	pmNoMem("clients", nclients * sizeof(client_t), PM_FATAL_ERR);
+
+    pmtimevalNow(&start);
+    finish = start;
+    pmtimevalInc(&finish, &duration);
+    for (i = 0; i < nclients; i++) {
+	clients[i].id = i;
+	clients[i].seed = (unsigned int)(start.tv_usec + 1) * 2654435761U + i + 1;
+	if (clients[i].seed == 0)
+	    clients[i].seed = 1;
+	if ((sts = pthread_create(&clients[i].tid, NULL, client, &clients[i])) != 0) {
+	    fprintf(stderr, "%s: pthread_create: %s\n",
+		    pmGetProgname(), strerror(sts));
+	    exit(1);
+	}
+    }
+    for (i = 0; i < nclients; i++) {
+	pthread_join(clients[i].tid, NULL);
+	if (clients[i].sts < 0) {
+	    fprintf(stderr, "%s: client %d: %s\n",
+		    pmGetProgname(), i, pmErrStr(clients[i].sts));
+	    failed++;
+	}
+    }
+    pmtimevalNow(&end);
+
+    printf("%s: %d client%s, %.2f sec, source %s\n", pmGetProgname(),
+	    nclients, nclients == 1 ? "" : "s", pmtimevalSub(&end, &start), source);
+    report(clients, pmtimevalSub(&end, &start));
+    exit(failed == nclients);
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * CPU and NUMA memory node affinity for pmcd and the agents it starts.
+ *
+ * Lists are in the usual "0-3,8,10-11" form.  Both the CPU affinity
+ * and the memory policy are inherited across fork and exec, so those
+ * for pmcd itself (pmcd -C and -M) also apply to DSO agents, which run
+ * inside pmcd, and to any agent without its own cpus= or mems= in
+ * pmcd.conf.  An agent's own settings are applied in the child process
+ * before the agent is exec'ed, so all of the agent's memory, including
+ * that allocated during its initialisation, follows its memory policy.
+ */
+
+#include "pmapi.h"
+#include "libpcp.h"
+#include "pmcd.h"
+#include <ctype.h>
+#ifdef HAVE_SCHED_H
+#include <sched.h>
+#endif
+#include <sys/syscall.h>
+
+#define AFFINITY_WORDBITS	(8 * sizeof(unsigned long))
+#define AFFINITY_WORDS		(AFFINITY_MAXBITS / AFFINITY_WORDBITS)
+
+#ifndef MPOL_BIND
+#define MPOL_BIND	2	/* from <numaif.h>, not always installed */
+#endif
+
+AffinityInfo	pmcd_affinity;
+
+/*
+ * Parse a CPU or memory node list into mask (if not NULL), returns 0
+ * or -EINVAL for a malformed list, or one with numbers too large.
+ */
+int
+ParseAffinityList(const char *list, unsigned long *mask)
+{
+    const char	*p = list;
+    char	*end;
+    long	lo, hi;
+
+    if (mask != NULL)
+	memset(mask, 0, AFFINITY_WORDS * sizeof(unsigned long));
+    for (;;) {
+	if (!isdigit((int)*p))
+	    return -EINVAL;
+	lo = hi = strtol(p, &end, 10);
+	if (*end == '-') {
+	    p = end + 1;
+	    if (!isdigit((int)*p))
+		return -EINVAL;
+	    hi = strtol(p, &end, 10);
+	}
+	if (lo > hi || hi >= AFFINITY_MAXBITS)
+	    return -EINVAL;
+	for (; mask != NULL && lo <= hi; lo++)
+	    mask[lo / AFFINITY_WORDBITS] |= 1UL << (lo % AFFINITY_WORDBITS);
+	if (*end == '\0')
+	    break;
+	if (*end != ',')
+	    return -EINVAL;
+	p = end + 1;
+    }
+    return 0;
+}
+
+/*
+ * Apply affinity settings to process pid (0 for the calling process).
+ * A memory policy can only be set for the calling process.
+ */
+int
+SetAffinity(const AffinityInfo *ap, pid_t pid)
+{
+    unsigned long	mask[AFFINITY_WORDS];
+    int			sts;
+
+    if (ap->cpus != NULL) {
+#if defined(HAVE_SCHED_H) && defined(CPU_SET)
+	cpu_set_t	set;
+	int		i;
+
+	if ((sts = ParseAffinityList(ap->cpus, mask)) < 0)
+	    return sts;
+	CPU_ZERO(&set);
+	for (i = 0; i < AFFINITY_MAXBITS && i < CPU_SETSIZE; i++) {
+	    if (mask[i / AFFINITY_WORDBITS] & (1UL << (i % AFFINITY_WORDBITS)))
+		CPU_SET(i, &set);
+	}
+	if (sched_setaffinity(pid, sizeof(set), &set) < 0)
+	    return -oserror();
+#else
+	return -EOPNOTSUPP;
+#endif
+    }
+
+    if (ap->mems != NULL) {
+#ifdef SYS_set_mempolicy
+	if (pid != 0)
+	    return -EOPNOTSUPP;
+	if ((sts = ParseAffinityList(ap->mems, mask)) < 0)
+	    return sts;
+	/* maxnode counts one more than the bits in the mask */
+	if (syscall(SYS_set_mempolicy, MPOL_BIND, mask, AFFINITY_MAXBITS + 1) < 0)
+	    return -oserror();
+#else
+	return -EOPNOTSUPP;
+#endif
+    }
+
+    return 0;
+}
+
+/* Return true if two sets of affinity settings are different. */
+int
+AffinityDiffer(const AffinityInfo *a1, const AffinityInfo *a2)
+{
+    if ((a1->cpus == NULL) != (a2->cpus == NULL) ||
+	(a1->cpus != NULL && strcmp(a1->cpus, a2->cpus) != 0))
+	return 1;
+    if ((a1->mems == NULL) != (a2->mems == NULL) ||
+	(a1->mems != NULL && strcmp(a1->mems, a2->mems) != 0))
+	return 1;
+    return 0;
+}
+
+void
+FreeAffinity(AffinityInfo *ap)
+{
+    free(ap->cpus);
+    free(ap->mems);
+    ap->cpus = ap->mems = NULL;
+}
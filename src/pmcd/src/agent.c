@@ -62,6 +62,8 @@ CleanupAgent(AgentInfo* aPtr, int why, int status)
     int		exit_status = status;
     int		reason = 0;
 
+    FetchCacheDrop(aPtr);
+
     if (aPtr->ipcType == AGENT_DSO) {
 	if (aPtr->ipc.dso.dlHandle != NULL) {
 #ifdef HAVE_DLOPEN
@@ -72,6 +74,7 @@ CleanupAgent(AgentInfo* aPtr, int why, int status)
     }
     else {
 	pmcd_trace(TR_DEL_AGENT, aPtr->pmDomainId, aPtr->inFd, aPtr->outFd);
+	IOEventDel(aPtr->outFd);
 	if (aPtr->inFd != -1) {
 	    if (aPtr->ipcType == AGENT_SOCKET)
 	      __pmCloseSocket(aPtr->inFd);
@@ -108,6 +111,8 @@ CleanupAgent(AgentInfo* aPtr, int why, int status)
     else {
 	if (why == AT_CONFIG) {
 	    fprintf(stderr, " unconfigured");
+	} else if (why == AT_HANDOVER) {
+	    fprintf(stderr, " replaced");
 	} else {
 	    reason = REASON_PROTOCOL;
 	    fprintf(stderr, " protocol failure for fd=%d", status);
@@ -119,7 +124,7 @@ CleanupAgent(AgentInfo* aPtr, int why, int status)
 	    int 	wait_status;
 	    int 	slept = 0;
 
-	    if (aPtr->ipcType == AGENT_PIPE)
+	    if (aPtr->ipcType == AGENT_PIPE || aPtr->ipcType == AGENT_SHM)
 		pid = aPtr->ipc.pipe.agentPid;
 	    else if (aPtr->ipcType == AGENT_SOCKET)
 		pid = aPtr->ipc.socket.agentPid;
@@ -166,13 +171,18 @@ CleanupAgent(AgentInfo* aPtr, int why, int status)
     aPtr->status.connected = 0;
     aPtr->status.busy = 0;
     aPtr->status.notReady = 0;
+    aPtr->status.late = 0;
     aPtr->status.fenced = 0;
     aPtr->status.flags = 0;
-    AgentDied = 1;
 
     if (pmcd_trace_mask)
 	pmcd_dump_trace(stderr);
 
+    /* a replaced agent's domain is still served, clients are not told */
+    if (why == AT_HANDOVER)
+	return;
+
+    AgentDied = 1;
     MarkStateChanges(PMCD_DROP_AGENT);
 }
 
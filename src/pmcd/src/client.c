@@ -19,9 +19,6 @@
 
 #define MIN_CLIENTS_ALLOC 8
 
-int		maxClientFd = -1;	/* largest fd for a client */
-__pmFdSet	clientFds;		/* for client select() */
-
 static int	clientSize;
 
 /*
@@ -75,7 +72,7 @@ ClientInfo *
 AcceptNewClient(int reqfd)
 {
     static unsigned int	seq = 0;
-    int			i, fd;
+    int			i, fd, sts;
     __pmSockLen		addrlen;
     struct timeval	now;
 
@@ -103,12 +100,17 @@ AcceptNewClient(int reqfd)
 	DeleteClient(&client[i]);
 	return NULL;	
     }
-    if (fd > maxClientFd)
-	maxClientFd = fd;
+    if ((sts = IOEventAdd(fd, IOEV_CLIENT, i)) < 0) {
+	pmNotifyErr(LOG_ERR, "AcceptNewClient(%d): cannot wait for input on fd %d: %s\n",
+			reqfd, fd, pmErrStr(sts));
+	__pmCloseSocket(fd);
+	client[i].fd = -1;
+	DeleteClient(&client[i]);
+	return NULL;
+    }
 
     pmcd_openfds_sethi(fd);
 
-    __pmFD_SET(fd, &clientFds);
     __pmSetVersionIPC(fd, UNKNOWN_VERSION);	/* before negotiation */
     __pmSetSocketIPC(fd);
 
@@ -117,6 +119,8 @@ AcceptNewClient(int reqfd)
     client[i].status.attributes = 0;
     client[i].status.changes = 0;
     memset(&client[i].attrs, 0, sizeof(__pmHashCtl));
+    memset(&client[i].sentDescs, 0, sizeof(__pmHashCtl));
+    memset(&client[i].sentInDoms, 0, sizeof(__pmHashCtl));
 
     /*
      * Note seq needs to be unique, but we're using a free running counter
@@ -127,6 +131,8 @@ AcceptNewClient(int reqfd)
     client[i].seq = seq++;
     pmtimevalNow(&now);
     client[i].start = now.tv_sec;
+    memset(&client[i].fetchTime, 0, sizeof(client[i].fetchTime));
+    memset(&client[i].xmitTime, 0, sizeof(client[i].xmitTime));
 
     if (pmDebugOptions.appl0)
 	fprintf(stderr, "AcceptNewClient(%d): client[%d] (fd %d)\n", reqfd, i, fd);
@@ -167,6 +173,19 @@ NewClient(void)
     return i;
 }
 
+/*
+ * Forget the metadata sent ahead of fetch results (PDU_FLAG_METADATA),
+ * so it is sent again with the next result that needs it
+ */
+void
+ClearSentMetadata(ClientInfo *cp)
+{
+    __pmHashFree(&cp->sentDescs);
+    cp->sentDescs.nodes = 0;
+    __pmHashFree(&cp->sentInDoms);
+    cp->sentInDoms.nodes = 0;
+}
+
 void
 DeleteClient(ClientInfo *cp)
 {
@@ -188,7 +207,7 @@ DeleteClient(ClientInfo *cp)
 	return;
     }
     if (cp->fd != -1) {
-	__pmFD_CLR(cp->fd, &clientFds);
+	IOEventDel(cp->fd);
 	__pmCloseSocket(cp->fd);
     }
     if (i == nClients-1) {
@@ -197,13 +216,6 @@ DeleteClient(ClientInfo *cp)
 	    i--;
 	nClients = (i >= 0) ? i + 1 : 0;
     }
-    if (cp->fd == maxClientFd) {
-	maxClientFd = -1;
-	for (i = 0; i < nClients; i++) {
-	    if (client[i].fd > maxClientFd)
-		maxClientFd = client[i].fd;
-	}
-    }
     hcp = &cp->profile;
     for (i = 0; i < hcp->hsize; i++) {
 	for (hp = hcp->hash[i]; hp != NULL; hp = hp->next) {
@@ -218,6 +230,7 @@ DeleteClient(ClientInfo *cp)
     __pmHashClear(hcp);
     __pmFreeAttrsSpec(&cp->attrs);
     __pmHashClear(&cp->attrs);
+    ClearSentMetadata(cp);
     __pmSockAddrFree(cp->addr);
     cp->addr = NULL;
     cp->status.connected = 0;
@@ -15,6 +15,18 @@
 #ifndef PMCD_CLIENT_H
 #define PMCD_CLIENT_H
 
+/*
+ * Fetch latency histogram (pmdapmcd) ... bucket 0 counts times below
+ * 1 usec, bucket b counts times in [2^(b-1), 2^b) usec, and the last
+ * bucket counts everything above that
+ */
+#define PMCD_LAT_BUCKETS	24
+typedef struct {
+    __uint64_t		count;		/* number of times recorded */
+    __uint64_t		total;		/* sum of all times, in usec */
+    __uint64_t		bucket[PMCD_LAT_BUCKETS];
+} LatencyHist;
+
 /* The table of clients, used by pmcd */
 typedef struct {
     int			fd;		/* Socket descriptor */
@@ -34,18 +46,21 @@ typedef struct {
     time_t		start;		/* Time client connected (pmdapmcd) */
     __pmSockAddr	*addr;		/* Network address of client */
     __pmHashCtl		attrs;		/* Connection attributes (tuples) */
+    LatencyHist		fetchTime;	/* Whole fetch, request to reply sent */
+    LatencyHist		xmitTime;	/* Sending the reply (pmdapmcd) */
+    __pmHashCtl		sentDescs;	/* PMIDs of descs sent with results */
+    __pmHashCtl		sentInDoms;	/* InDoms sent with results */
 } ClientInfo;
 
 PMCD_DATA extern ClientInfo *client;		/* Array of clients */
 PMCD_DATA extern int	nClients;		/* Number of entries in array */
-extern int		maxClientFd;		/* largest fd for a client */
-extern __pmFdSet	clientFds;		/* for client select() */
 PMCD_DATA extern int	this_client_id;		/* client for current request */
 
 /* prototypes */
 extern ClientInfo *AcceptNewClient(int);
 extern int NewClient(void);
 extern void DeleteClient(ClientInfo *);
+extern void ClearSentMetadata(ClientInfo *);
 PMCD_CALL extern ClientInfo *GetClient(int);
 PMCD_CALL extern int SetClientAttribute(int, int, char *);
 PMCD_CALL extern void ShowClients(FILE *m);
@@ -0,0 +1,337 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * Coalescing of identical fetches from different clients.
+ *
+ * When several clients (pmloggers, pmie, pmproxy) sample the same
+ * metrics at the same moment, each fetch is normally passed on to the
+ * PMDAs.  With a coalescing window set (pmcd -F), the most recent
+ * result from each agent is kept, and a later request for the same
+ * pmIDs with the same instance profile (and, for agents that receive
+ * client credentials or container names, the same client identity)
+ * that arrives within the window is answered from it, without another
+ * round trip to the agent.
+ *
+ * The kept result is a decoded result PDU, so its value sets hold a pin
+ * on the PDU buffer until the result is replaced or dropped.  Results
+ * from DSO agents are in a skeleton owned by the DSO, so these are
+ * copied through a PDU buffer in the same way before being kept.
+ *
+ * Fetches from the pmcd PMDA (which reports on pmcd itself) and results
+ * containing event records (which are consumed per client) are never
+ * shared.
+ */
+
+#include "pmapi.h"
+#include "libpcp.h"
+#include "pmcd.h"
+
+#define PMCD_DOMAIN	2	/* pmcd's own PMDA, see pmns/stdpmid */
+
+struct timeval	pmcd_coalesce;	/* 0 => fetches are never shared */
+
+typedef struct {
+    AgentInfo	*ap;		/* agent the result came from */
+    struct timeval stamp;	/* when the agent was asked */
+    int		npmids;
+    pmID	*pmids;		/* as requested from the agent */
+    int		nprof;
+    int		*prof;		/* flattened instance profile */
+    char	*ident;		/* client identity, NULL if not relevant */
+    pmResult	*result;	/* decoded from a PDU */
+} FetchCache;
+
+static FetchCache	*cache;		/* indexed by agent[] index */
+static int		ncache;
+
+static void
+FreeEntry(FetchCache *cp)
+{
+    if (cp->result != NULL)
+	pmFreeResult(cp->result);
+    if (cp->pmids != NULL)
+	free(cp->pmids);
+    if (cp->prof != NULL)
+	free(cp->prof);
+    if (cp->ident != NULL)
+	free(cp->ident);
+    memset(cp, 0, sizeof(*cp));
+}
+
+/*
+ * Instance profile as a flat array of ints, so that two profiles can
+ * be compared with memcmp() ... __pmDecodeProfile() sorts profiles,
+ * so those that select the same instances in a different order are
+ * recognised as the same.
+ */
+static int *
+ProfileKey(pmProfile *prof, int *nkey)
+{
+    pmInDomProfile	*ip;
+    int			*key;
+    int			need, i, k;
+
+    need = 2;
+    for (i = 0; i < prof->profile_len; i++)
+	need += 3 + prof->profile[i].instances_len;
+    if ((key = (int *)malloc(need * sizeof(int))) == NULL)
+	return NULL;
+    k = 0;
+    key[k++] = prof->state;
+    key[k++] = prof->profile_len;
+    for (i = 0; i < prof->profile_len; i++) {
+	ip = &prof->profile[i];
+	key[k++] = ip->indom;
+	key[k++] = ip->state;
+	key[k++] = ip->instances_len;
+	if (ip->instances_len > 0)
+	    memcpy(&key[k], ip->instances, ip->instances_len * sizeof(int));
+	k += ip->instances_len;
+    }
+    *nkey = need;
+    return key;
+}
+
+static pmProfile *
+ClientProfile(ClientInfo *cip, int ctxnum)
+{
+    static pmProfile	defprofile = {PM_PROFILE_INCLUDE, 0, NULL};
+    __pmHashNode	*hp;
+
+    if ((hp = __pmHashSearch(ctxnum, &cip->profile)) != NULL)
+	return (pmProfile *)hp->data;
+    return &defprofile;
+}
+
+/*
+ * The connection attributes an agent may use to tailor its results for
+ * a client, when the agent has asked for them (see DoAttributes)
+ */
+static char *
+ClientIdentity(AgentInfo *ap, ClientInfo *cip)
+{
+    static const int	attrs[] = {
+	PCP_ATTR_USERID, PCP_ATTR_GROUPID, PCP_ATTR_USERNAME, PCP_ATTR_CONTAINER
+    };
+    __pmHashNode	*node;
+    char		buf[1024];
+    int			i, n = 0;
+
+    if ((ap->status.flags & (PDU_FLAG_AUTH|PDU_FLAG_CONTAINER)) == 0)
+	return NULL;
+    for (i = 0; i < sizeof(attrs) / sizeof(attrs[0]) && n < sizeof(buf); i++) {
+	node = __pmHashSearch(attrs[i], &cip->attrs);
+	n += pmsprintf(&buf[n], sizeof(buf) - n, "%d=%s\n", attrs[i],
+			node && node->data ? (char *)node->data : "");
+    }
+    return strdup(buf);
+}
+
+static int
+SameIdentity(const char *a, const char *b)
+{
+    if (a == NULL || b == NULL)
+	return a == b;
+    return strcmp(a, b) == 0;
+}
+
+/*
+ * Result from an earlier fetch to agent[aindex] that can be used for
+ * this request, else NULL.  The result remains owned by the cache.
+ */
+pmResult *
+FetchCacheLookup(int aindex, int npmids, pmID *pmids, ClientInfo *cip, int ctxnum)
+{
+    FetchCache		*cp;
+    AgentInfo		*ap = &agent[aindex];
+    struct timeval	now;
+    double		age;
+    char		*ident;
+    int			*prof;
+    int			nprof;
+    int			same;
+
+    if (aindex >= ncache)
+	return NULL;
+    cp = &cache[aindex];
+    if (cp->result == NULL)
+	return NULL;
+    if (cp->ap != ap || !ap->status.connected) {
+	FreeEntry(cp);
+	return NULL;
+    }
+    pmtimevalNow(&now);
+    age = pmtimevalSub(&now, &cp->stamp);
+    if (age < 0 || age > pmtimevalToReal(&pmcd_coalesce)) {
+	FreeEntry(cp);
+	return NULL;
+    }
+    if (cp->npmids != npmids || memcmp(cp->pmids, pmids, npmids * sizeof(pmID)) != 0)
+	return NULL;
+
+    if ((prof = ProfileKey(ClientProfile(cip, ctxnum), &nprof)) == NULL)
+	return NULL;
+    same = (nprof == cp->nprof && memcmp(prof, cp->prof, nprof * sizeof(int)) == 0);
+    free(prof);
+    if (!same)
+	return NULL;
+
+    ident = ClientIdentity(ap, cip);
+    same = SameIdentity(ident, cp->ident);
+    if (ident != NULL)
+	free(ident);
+    if (!same)
+	return NULL;
+
+    if (pmDebugOptions.appl0)
+	fprintf(stderr, "FetchCacheLookup: client[%d] shares \"%s\" agent result from %.3fs ago\n",
+		(int)(cip - client), ap->pmDomainLabel, age);
+    return cp->result;
+}
+
+/*
+ * Keep a copy of a successful fetch result from a DSO agent, and
+ * return the copy for use in place of the DSO's own result (whose
+ * values are released here); else return the result unchanged.
+ */
+static pmResult *
+CopyDsoResult(pmResult *result)
+{
+    __pmResult	*tmp;
+    __pmResult	*rp;
+    __pmPDU	*pb;
+    int		sts;
+
+    if ((tmp = __pmAllocResult(result->numpmid)) == NULL)
+	return NULL;
+    tmp->timestamp.sec = result->timestamp.tv_sec;
+    tmp->timestamp.nsec = result->timestamp.tv_usec * 1000;
+    tmp->numpmid = result->numpmid;
+    memcpy(tmp->vset, result->vset, result->numpmid * sizeof(pmValueSet *));
+    sts = __pmEncodeResult(NULL, tmp, &pb);
+    tmp->numpmid = 0;		/* vsets still belong to the DSO */
+    __pmFreeResult(tmp);
+    if (sts < 0)
+	return NULL;
+    sts = __pmDecodeResult(pb, &rp);
+    __pmUnpinPDUBuf(pb);
+    if (sts < 0)
+	return NULL;
+    return __pmOffsetResult(rp);
+}
+
+/*
+ * Offer a fresh result from agent[aindex] to the cache together with
+ * the request it answers.  Returns the result to be used for this
+ * fetch; if that is owned by the cache (FetchCacheHolds() is true) it
+ * must not be freed by the caller.
+ */
+pmResult *
+FetchCacheSave(int aindex, int npmids, pmID *pmids, ClientInfo *cip, int ctxnum,
+		struct timeval *stamp, pmResult *result)
+{
+    FetchCache	*cp;
+    AgentInfo	*ap = &agent[aindex];
+    pmResult	*copy;
+    pmValueSet	*vsp;
+    int		i, j;
+
+    if (ap->pmDomainId == PMCD_DOMAIN || result->numpmid != npmids)
+	return result;
+    /* event records are handed out once per client, so never shared */
+    for (i = 0; i < result->numpmid; i++) {
+	vsp = result->vset[i];
+	if (vsp->numval <= 0 || vsp->valfmt == PM_VAL_INSITU)
+	    continue;
+	for (j = 0; j < vsp->numval; j++) {
+	    if (vsp->vlist[j].value.pval->vtype == PM_TYPE_EVENT ||
+		vsp->vlist[j].value.pval->vtype == PM_TYPE_HIGHRES_EVENT)
+		return result;
+	}
+    }
+
+    if (aindex >= ncache) {
+	FetchCache	*tmp;
+	int		size = nAgents > aindex ? nAgents : aindex + 1;
+
+	if ((tmp = (FetchCache *)realloc(cache, size * sizeof(FetchCache))) == NULL)
+	    return result;
+	memset(&tmp[ncache], 0, (size - ncache) * sizeof(FetchCache));
+	cache = tmp;
+	ncache = size;
+    }
+    cp = &cache[aindex];
+    FreeEntry(cp);
+
+    if (ap->ipcType == AGENT_DSO) {
+	if ((copy = CopyDsoResult(result)) == NULL)
+	    return result;
+    }
+    else
+	copy = result;
+
+    if ((cp->pmids = (pmID *)malloc(npmids * sizeof(pmID))) == NULL ||
+	(cp->prof = ProfileKey(ClientProfile(cip, ctxnum), &cp->nprof)) == NULL) {
+	if (copy != result)
+	    pmFreeResult(copy);
+	FreeEntry(cp);
+	return result;
+    }
+    memcpy(cp->pmids, pmids, npmids * sizeof(pmID));
+    cp->npmids = npmids;
+    cp->ident = ClientIdentity(ap, cip);
+    cp->stamp = *stamp;
+    cp->ap = ap;
+    cp->result = copy;
+
+    if (copy != result)
+	/* DSO manages the pmResult skeleton, but the values need freeing */
+	__pmFreeResultValues(result);
+    return copy;
+}
+
+/*
+ * True if result is the one kept for agent[aindex]
+ */
+int
+FetchCacheHolds(int aindex, pmResult *result)
+{
+    return aindex < ncache && result != NULL && cache[aindex].result == result;
+}
+
+/*
+ * Forget the result kept for an agent, after a store to the agent or
+ * when the agent goes away
+ */
+void
+FetchCacheDrop(AgentInfo *ap)
+{
+    int		i;
+
+    for (i = 0; i < ncache; i++) {
+	if (cache[i].ap == ap)
+	    FreeEntry(&cache[i]);
+    }
+}
+
+/*
+ * Forget all kept results, before the agent table is rebuilt
+ */
+void
+FetchCacheFlush(void)
+{
+    int		i;
+
+    for (i = 0; i < ncache; i++)
+	FreeEntry(&cache[i]);
+}
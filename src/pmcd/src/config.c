@@ -595,6 +595,40 @@ FreeAgent(AgentInfo *ap)
 	    free(argv[i]);
 	free(argv);
     }
+    FreeAffinity(&ap->affinity);
+}
+
+/* Parse a "cpus=list" or "mems=list" keyword for an agent pmcd starts.
+ * Returns 1 if the token is one of these, 0 if not, -1 for errors.
+ */
+static int
+ParseAffinity(const char *source, AffinityInfo *ap)
+{
+    char	**valuep;
+    char	*value;
+
+    if (tokenend - token > 5 && strncmp(token, "cpus=", 5) == 0)
+	valuep = &ap->cpus;
+    else if (tokenend - token > 5 && strncmp(token, "mems=", 5) == 0)
+	valuep = &ap->mems;
+    else
+	return 0;
+
+    if ((value = CopyToken()) == NULL) {
+	pmNoMem("pmcd config: affinity", tokenend - token + 1, PM_FATAL_ERR);
+	/*NOTREACHED*/
+    }
+    if (ParseAffinityList(value + 5, NULL) < 0) {
+	fprintf(stderr,
+		     "%s config[line %d]: Error: bad CPU or memory node list \"%s\"\n",
+		     source, nLines, value);
+	free(value);
+	return -1;
+    }
+    memmove(value, value + 5, strlen(value + 5) + 1);
+    free(*valuep);
+    *valuep = value;
+    return 1;
 }
 
 /* Parse a DSO specification, creating and initialising a new entry in the
@@ -683,8 +717,10 @@ static int
 ParseSocket(const char *source, char *pmDomainLabel, int pmDomainId)
 {
     int		addrDomain, port = -1;
+    int		sts;
     char	*socketName = NULL;
     AgentInfo	*newAgent;
+    AffinityInfo affinity = { NULL, NULL };
 
     FindNextToken(source);
     if (TokenIs("inet"))
@@ -717,6 +753,21 @@ ParseSocket(const char *source, char *pmDomainLabel, int pmDomainId)
 	}
     FindNextToken(source);
 
+    /* Optional affinity for an agent that pmcd creates */
+    while ((sts = ParseAffinity(source, &affinity)) > 0)
+	FindNextToken(source);
+    if (sts == 0 && *token == '\n' && (affinity.cpus || affinity.mems)) {
+	fprintf(stderr,
+		     "%s config[line %d]: Error: cpus= and mems= need a command to create the agent\n",
+		     source, nLines);
+	sts = -1;
+    }
+    if (sts < 0) {
+	FreeAffinity(&affinity);
+	free(socketName);
+	return -1;
+    }
+
     /* If an internet domain port name was specified, find the corresponding
      port number. */
 
@@ -730,6 +781,7 @@ ParseSocket(const char *source, char *pmDomainLabel, int pmDomainId)
 	    fprintf(stderr,
 		"%s config[line %d]: Error: failed to get port number for port name %s\n",
 		source, nLines, socketName);
+	    FreeAffinity(&affinity);
 	    free(socketName);
 	    return -1;
 	}
@@ -747,6 +799,7 @@ ParseSocket(const char *source, char *pmDomainLabel, int pmDomainId)
     newAgent->ipc.socket.addrDomain = addrDomain;
     newAgent->ipc.socket.name = socketName;
     newAgent->ipc.socket.port = port;
+    newAgent->affinity = affinity;
     if (*token != '\n') {
 	newAgent->ipc.socket.argv = BuildArgv(source);
 	if (newAgent->ipc.socket.argv == NULL) {
@@ -763,14 +816,15 @@ ParseSocket(const char *source, char *pmDomainLabel, int pmDomainId)
     return 0;
 }
 
-/* Parse a pipe specification, creating and initialising a new entry in the
- * agent table if the spec has no errors.
+/* Parse a pipe (or shm) specification, creating and initialising a new
+ * entry in the agent table if the spec has no errors.
  */
 static int
-ParsePipe(const char *source, char *pmDomainLabel, int pmDomainId)
+ParsePipe(const char *source, char *pmDomainLabel, int pmDomainId, int ipcType)
 {
     int		i;
     AgentInfo	*newAgent;
+    AffinityInfo affinity = { NULL, NULL };
     int notReady = 0;
 
     FindNextToken(source);
@@ -788,21 +842,26 @@ ParsePipe(const char *source, char *pmDomainLabel, int pmDomainId)
 	    fprintf(stderr,
 		     "%s config[line %d]: Error: command to create pipe agent expected.\n",
 		     source, nLines);
+	    FreeAffinity(&affinity);
 	    return -1;
 	} else if ((i = TokenIs ("notready"))) {
 	    notReady = 1;
+	} else if ((i = ParseAffinity(source, &affinity)) < 0) {
+	    FreeAffinity(&affinity);
+	    return -1;
 	}
     } while (i);
 
     /* Now create and initialise a slot in the agents table for the new agent */
 
     newAgent = GetNewAgent();
-    newAgent->ipcType = AGENT_PIPE;
+    newAgent->ipcType = ipcType;
     newAgent->pmDomainId = pmDomainId;
     newAgent->inFd = -1;
     newAgent->outFd = -1;
     newAgent->pmDomainLabel = strdup(pmDomainLabel);
     newAgent->status.startNotReady = notReady;
+    newAgent->affinity = affinity;
     newAgent->ipc.pipe.argv = BuildArgv(source);
 
     if (newAgent->ipc.pipe.argv == NULL) {
@@ -1335,10 +1394,12 @@ ReadConfigFiles(FILE *configFile, FILE *accessFile)
 	else if (TokenIs("socket"))
 	    sts = ParseSocket(source, pmDomainLabel, pmDomainId);
 	else if (TokenIs("pipe"))
-	    sts = ParsePipe(source, pmDomainLabel, pmDomainId);
+	    sts = ParsePipe(source, pmDomainLabel, pmDomainId, AGENT_PIPE);
+	else if (TokenIs("shm"))
+	    sts = ParsePipe(source, pmDomainLabel, pmDomainId, AGENT_SHM);
 	else {
 	    fprintf(stderr,
-			 "%s config[line %d]: Error: expected `dso', `socket' or `pipe'\n",
+			 "%s config[line %d]: Error: expected `dso', `socket', `pipe' or `shm'\n",
 			 source, nLines);
 	    sts = -1;
 	}
@@ -1516,6 +1577,11 @@ DoAgentCreds(AgentInfo* aPtr, __pmPDU *pb)
 	handshake.c_type = CVERSION;
 	handshake.c_version = PDU_VERSION;
 	handshake.c_flags = (flags & PDU_FLAG_AUTH);
+	/* agree to the shared memory ring if one was set up for this agent */
+	if ((flags & PDU_FLAG_SHM) && __pmShmIPC(aPtr->outFd))
+	    handshake.c_flags |= PDU_FLAG_SHM;
+	else
+	    __pmCloseShmIPC(aPtr->outFd);
 	if ((sts = __pmSendCreds(aPtr->inFd, (int)pmcd_pid, 1, cp)) < 0)
 	    return sts;
 	pmcd_trace(TR_XMIT_PDU, aPtr->inFd, PDU_CREDS, credcount);
@@ -1692,7 +1758,7 @@ CreateRootAgentPOSIX(AgentInfo *aPtr)
 	args = aPtr->ipc.pipe.commandLine;
     else if (aPtr->ipcType == AGENT_SOCKET)
 	args = aPtr->ipc.socket.commandLine;
-    else
+    else	/* DSO, or shm which needs its ring inherited from pmcd */
 	return -EINVAL;
 
     if (pmdarootfd <= 0) {
@@ -1715,13 +1781,16 @@ CreateRootAgentPOSIX(AgentInfo *aPtr)
 static pid_t
 CreateAgentPOSIX(AgentInfo *aPtr)
 {
-    int		i;
+    int		i, sts;
     int		inPipe[2];	/* Pipe for input to child */
     int		outPipe[2];	/* For output to child */
+    int		shmfd = -1;	/* Shared memory ring for output */
+    int		ispipe;
     pid_t	childPid = (pid_t)-1;
     char	**argv = NULL;
 
-    if (aPtr->ipcType == AGENT_PIPE) {
+    ispipe = (aPtr->ipcType == AGENT_PIPE || aPtr->ipcType == AGENT_SHM);
+    if (ispipe) {
 	argv = aPtr->ipc.pipe.argv;
 	if (pipe1(inPipe) < 0) {
 	    fprintf(stderr,
@@ -1739,6 +1808,13 @@ CreateAgentPOSIX(AgentInfo *aPtr)
 	    return (pid_t)-1;
 	}
 	pmcd_openfds_sethi(outPipe[1]);
+
+	if (aPtr->ipcType == AGENT_SHM && (shmfd = __pmShmCreate()) < 0) {
+	    /* not fatal, large PDUs are sent down the pipe instead */
+	    fprintf(stderr,
+		    "pmcd: shared memory create failed for \"%s\" agent: %s\n",
+		    aPtr->pmDomainLabel, pmErrStr(shmfd));
+	}
     }
     else if (aPtr->ipcType == AGENT_SOCKET)
 	argv = aPtr->ipc.socket.argv;
@@ -1748,23 +1824,33 @@ CreateAgentPOSIX(AgentInfo *aPtr)
 	if (childPid == (pid_t)-1) {
 	    fprintf(stderr, "pmcd: creating child for \"%s\" agent: %s\n",
 			 aPtr->pmDomainLabel, osstrerror());
-	    if (aPtr->ipcType == AGENT_PIPE) {
+	    if (ispipe) {
 		close(inPipe[0]);
 		close(inPipe[1]);
 		close(outPipe[0]);
 		close(outPipe[1]);
+		if (shmfd >= 0)
+		    close(shmfd);
 	    }
 	    return (pid_t)-1;
 	}
 
 	if (childPid) {
 	    /* This is the parent (PMCD) */
-	    if (aPtr->ipcType == AGENT_PIPE) {
+	    if (ispipe) {
 		close(inPipe[0]);
 		close(outPipe[1]);
 		aPtr->inFd = inPipe[1];
 		aPtr->outFd = outPipe[0];
 	    }
+	    if (shmfd >= 0) {
+		/* ring is only used if the PMDA asks for it, at negotiation */
+		if ((i = __pmSetShmIPC(aPtr->outFd, shmfd, PDU_SHM_RECV)) < 0)
+		    fprintf(stderr,
+			    "pmcd: shared memory attach failed for \"%s\" agent: %s\n",
+			    aPtr->pmDomainLabel, pmErrStr(i));
+		close(shmfd);
+	    }
 	}
 	else {
 	    /*
@@ -1772,7 +1858,7 @@ CreateAgentPOSIX(AgentInfo *aPtr)
 	     * make sure stderr is fd 2
 	     */
 	    dup2(fileno(stderr), STDERR_FILENO); 
-	    if (aPtr->ipcType == AGENT_PIPE) {
+	    if (ispipe) {
 		/* make pipe stdin for PMDA */
 		dup2(inPipe[0], STDIN_FILENO);
 		/* make pipe stdout for PMDA */
@@ -1787,13 +1873,23 @@ CreateAgentPOSIX(AgentInfo *aPtr)
 	    }
 
 	    for (i = 0; i <= pmcd_hi_openfds; i++) {
-		/* Close all except std{in,out,err} */
+		/* Close all except std{in,out,err} and the ring */
 		if (i == STDIN_FILENO ||
 		    i == STDOUT_FILENO ||
-		    i == STDERR_FILENO)
+		    i == STDERR_FILENO ||
+		    i == shmfd)
 		    continue;
 		close(i);
 	    }
+	    if (shmfd >= 0) {
+		char	shmenv[16];
+
+		pmsprintf(shmenv, sizeof(shmenv), "%d", shmfd);
+		setenv("PCP_PMDA_SHMFD", shmenv, 1);
+	    }
+	    if ((sts = SetAffinity(&aPtr->affinity, 0)) < 0)
+		fprintf(stderr, "pmcd: \"%s\" agent affinity not set: %s\n",
+			     aPtr->pmDomainLabel, pmErrStr(sts));
 
 	    execvp(argv[0], argv);
 	    /* botch if reach here */
@@ -1814,7 +1910,7 @@ CreateAgentWin32(AgentInfo *aPtr)
     pid_t	pid;
     char	*argv[2];
 
-    if (aPtr->ipcType == AGENT_PIPE)
+    if (aPtr->ipcType == AGENT_PIPE || aPtr->ipcType == AGENT_SHM)
 	argv[0] = aPtr->ipc.pipe.commandLine;
     else if (aPtr->ipcType == AGENT_SOCKET)
 	argv[0] = aPtr->ipc.socket.commandLine;
@@ -1858,10 +1954,21 @@ CreateAgent(AgentInfo *aPtr)
 	aPtr->status.isChild = 1;
     } else {
 	aPtr->status.isRootChild = 1;
+	/* started by pmdaroot, only the CPU affinity can be changed */
+	if (aPtr->affinity.cpus) {
+	    AffinityInfo	cpus = { aPtr->affinity.cpus, NULL };
+
+	    if ((sts = SetAffinity(&cpus, childPid)) < 0)
+		fprintf(stderr, "pmcd: \"%s\" agent affinity not set: %s\n",
+			     aPtr->pmDomainLabel, pmErrStr(sts));
+	}
+	if (aPtr->affinity.mems)
+	    fprintf(stderr, "pmcd: \"%s\" agent memory nodes not set: "
+			 "agent started by pmdaroot\n", aPtr->pmDomainLabel);
     }
 #endif
 
-    if (aPtr->ipcType == AGENT_PIPE) {
+    if (aPtr->ipcType == AGENT_PIPE || aPtr->ipcType == AGENT_SHM) {
 	aPtr->ipc.pipe.agentPid = childPid;
 	/* ready for version negotiation */
 	if ((sts = AgentNegotiate(aPtr)) < 0) {
@@ -1938,12 +2045,17 @@ PrintAgentInfo(FILE *stream)
 	    break;
 
 	case AGENT_PIPE:
+	case AGENT_SHM:
 	    version = __pmVersionIPC(aPtr->inFd);
 	    fprintf(stream, " %3d %5" FMT_PID " %3d %3d %3d ",
 		aPtr->pmDomainId, aPtr->ipc.pipe.agentPid, aPtr->inFd, aPtr->outFd, version);
 	    fputs("bin ", stream);
 	    if (aPtr->ipc.pipe.commandLine) {
-		fputs("pipe cmd=", stream);
+		/* shm only once the ring has been negotiated */
+		if (__pmShmIPC(aPtr->outFd))
+		    fputs("shm cmd=", stream);
+		else
+		    fputs("pipe cmd=", stream);
 		fputs(aPtr->ipc.pipe.commandLine, stream);
 		putc('\n', stream);
 	    }
@@ -2106,12 +2218,77 @@ GetAgentDso(AgentInfo *aPtr)
 }
 
 
+/*
+ * Newest modification time of the executables (PMDA binary, script or
+ * interpreter) named by absolute path in an agent's arguments.  Other
+ * files, like a log file the agent writes, are not considered.
+ */
+static time_t
+PipeFileTime(char **argv)
+{
+    struct stat	sbuf;
+    time_t	newest = 0;
+    int		i;
+
+    for (i = 0; argv != NULL && argv[i] != NULL; i++) {
+	if (argv[i][0] != '/' || stat(argv[i], &sbuf) < 0 ||
+	    !S_ISREG(sbuf.st_mode) || !(sbuf.st_mode & S_IXUSR))
+	    continue;
+	if (sbuf.st_mtime > newest)
+	    newest = sbuf.st_mtime;
+    }
+    return newest;
+}
+
+/* Start one agent, *created is set for socket agents pmcd created. */
+static int
+StartAgent(AgentInfo *aPtr, int *created)
+{
+    int		sts = 0;
+
+    switch (aPtr->ipcType) {
+    case AGENT_DSO:
+	sts = GetAgentDso(aPtr);
+	break;
+
+    case AGENT_SOCKET:
+	if (aPtr->ipc.socket.argv) { /* Create agent if required */
+	    sts = CreateAgent(aPtr);
+	    if (sts >= 0 && created != NULL)
+		*created = 1;
+
+	    /* Don't attempt to connect yet, if the agent has just been
+		   created, it will need time to initialise socket. */
+	}
+	else
+	    sts = ConnectSocketAgent(aPtr);
+	break;			/* Connect to existing agent */
+
+    case AGENT_PIPE:
+    case AGENT_SHM:
+	aPtr->ipc.pipe.fileTime = PipeFileTime(aPtr->ipc.pipe.argv);
+	sts = CreateAgent(aPtr);
+	break;
+    }
+    aPtr->status.connected = sts == 0;
+    if (aPtr->status.connected) {
+	if (aPtr->ipcType == AGENT_DSO)
+	    pmcd_trace(TR_ADD_AGENT, aPtr->pmDomainId, -1, -1);
+	else
+	    pmcd_trace(TR_ADD_AGENT, aPtr->pmDomainId, aPtr->inFd, aPtr->outFd);
+	aPtr->status.notReady = aPtr->status.startNotReady;
+    }
+    else
+	aPtr->reason = REASON_NOSTART;
+    return sts;
+}
+
 /* For creating and establishing contact with agents of the PMCD. */
 static void
 ContactAgents(void)
 {
     int		i;
-    int		sts = 0;
+    int		sts;
     int		createdSocketAgents = 0;
     AgentInfo	*aPtr;
 
@@ -2119,40 +2296,10 @@ ContactAgents(void)
 	aPtr = &agent[i];
 	if (aPtr->status.connected)
 	    continue;
-	switch (aPtr->ipcType) {
-	case AGENT_DSO:
-	    sts = GetAgentDso(aPtr);
-	    break;
-
-	case AGENT_SOCKET:
-	    if (aPtr->ipc.socket.argv) { /* Create agent if required */
-		sts = CreateAgent(aPtr);
-		if (sts >= 0)
-		    createdSocketAgents = 1;
-
-		/* Don't attempt to connect yet, if the agent has just been
-		       created, it will need time to initialise socket. */
-	    }
-	    else
-		sts = ConnectSocketAgent(aPtr);
-	    break;			/* Connect to existing agent */
-
-	case AGENT_PIPE:
-	    sts = CreateAgent(aPtr);
-	    break;
-	}
-	aPtr->status.connected = sts == 0;
-	if (aPtr->status.connected) {
-	    if (aPtr->ipcType == AGENT_DSO)
-		pmcd_trace(TR_ADD_AGENT, aPtr->pmDomainId, -1, -1);
-	    else
-		pmcd_trace(TR_ADD_AGENT, aPtr->pmDomainId, aPtr->inFd, aPtr->outFd);
+	if (StartAgent(aPtr, &createdSocketAgents) == 0) {
 	    MarkStateChanges(PMCD_ADD_AGENT);
 	    pmcd_seqnum++;
-	    aPtr->status.notReady = aPtr->status.startNotReady;
 	}
-	else
-	    aPtr->reason = REASON_NOSTART;
     }
 
     /* Allow newly created socket agents time to initialise before attempting
@@ -2314,6 +2461,8 @@ AgentsDiffer(AgentInfo *a1, AgentInfo *a2)
 	return 1;
     if (a1->ipcType != a2->ipcType)
 	return 1;
+    if (AffinityDiffer(&a1->affinity, &a2->affinity))
+	return 1;
     if (a1->ipcType == AGENT_DSO) {
 	DsoInfo	*dso1 = &a1->ipc.dso;
 	DsoInfo	*dso2 = &a2->ipc.dso;
@@ -2371,10 +2520,77 @@ AgentsDiffer(AgentInfo *a1, AgentInfo *a2)
 	else if ((pipe1->argv == NULL && pipe2->argv != NULL) ||
 		 (pipe1->argv != NULL && pipe2->argv == NULL))
 		    return 1;
+	/* a1 is from the new configuration, a2 is running */
+	if (pipe2->fileTime != 0 &&
+	    PipeFileTime(pipe1->argv) != pipe2->fileTime)
+	    return 1;
     }
     return 0;
 }
 
+/*
+ * True if the executables used by any running pipe agent (PMDA binary,
+ * script or interpreter named in its arguments) have been
+ * modified since it was started.
+ */
+static int
+AgentFilesChanged(void)
+{
+    AgentInfo	*ap;
+    int		i;
+
+    for (i = 0; i < nAgents; i++) {
+	ap = &agent[i];
+	if (!ap->status.connected ||
+	    (ap->ipcType != AGENT_PIPE && ap->ipcType != AGENT_SHM))
+	    continue;
+	if (ap->ipc.pipe.fileTime != 0 &&
+	    PipeFileTime(ap->ipc.pipe.argv) != ap->ipc.pipe.fileTime) {
+	    fprintf(stderr, "Files used by \"%s\" agent have changed\n",
+			ap->pmDomainLabel);
+	    return 1;
+	}
+    }
+    return 0;
+}
+
+/*
+ * Start newAgent as the replacement for oldAgent, a running agent for
+ * the same domain whose configuration (or PMDA files) changed, and only
+ * once it is running retire oldAgent.  Requests are processed one at a
+ * time, so none are outstanding with oldAgent at this point, and the
+ * domain is never without an agent.  Clients are not notified with
+ * PMCD_DROP_AGENT and PMCD_ADD_AGENT, so their names, descriptors and
+ * other metadata (and pmlogger archives) carry on as before ... the
+ * replacement is expected to export the same metrics.
+ *
+ * Only daemon agents using pipes are replaced like this.  A socket
+ * agent may need the address the old agent holds, and a DSO agent
+ * cannot be initialised again while the same library is loaded.
+ * Returns 0 on success, else the old agent is to be retired and the
+ * new one started in the usual way.
+ */
+static int
+HandoverAgent(AgentInfo *newAgent, AgentInfo *oldAgent)
+{
+    int		sts;
+
+    if (newAgent->pmDomainId != oldAgent->pmDomainId ||
+	newAgent->ipcType != oldAgent->ipcType ||
+	(newAgent->ipcType != AGENT_PIPE && newAgent->ipcType != AGENT_SHM))
+	return -1;
+
+    fprintf(stderr, "Replacing \"%s\" agent (dom %d)\n",
+		newAgent->pmDomainLabel, newAgent->pmDomainId);
+    if ((sts = StartAgent(newAgent, NULL)) < 0) {
+	fprintf(stderr, "Replacement \"%s\" agent failed to start: %s\n",
+		newAgent->pmDomainLabel, pmErrStr(sts));
+	return sts;
+    }
+    CleanupAgent(oldAgent, AT_HANDOVER, 0);
+    return 0;
+}
+
 /* Make the "dest" agent the equivalent of an existing "src" agent.
  * This assumes that the agents are identical according to AgentsDiffer(), and
  * that they have distinct copies of the fields compared therein.
@@ -2402,8 +2618,10 @@ DupAgent(AgentInfo *dest, AgentInfo *src)
     }
     else if (src->ipcType == AGENT_SOCKET)
 	dest->ipc.socket.agentPid = src->ipc.socket.agentPid;
-    else
+    else {
 	dest->ipc.pipe.agentPid = src->ipc.pipe.agentPid;
+	dest->ipc.pipe.fileTime = src->ipc.pipe.fileTime;
+    }
 }
 
 void
@@ -2418,6 +2636,9 @@ ParseRestartAgents(char *fileName)
     AgentInfo	*ap;
     __pmFdSet	fds;
 
+    /* The agent table is about to be rebuilt */
+    FetchCacheFlush();
+
     /* Clean up any deceased agents.  We haven't seen an agent's death unless
      * a PDU transfer involving the agent has occurred.  This cleans up others
      * as well.
@@ -2427,7 +2648,8 @@ ParseRestartAgents(char *fileName)
     for (i = 0; i < nAgents; i++) {
 	ap = &agent[i];
 	if (ap->status.connected &&
-	    (ap->ipcType == AGENT_SOCKET || ap->ipcType == AGENT_PIPE)) {
+	    (ap->ipcType == AGENT_SOCKET || ap->ipcType == AGENT_PIPE ||
+	     ap->ipcType == AGENT_SHM)) {
 
 	    __pmFD_SET(ap->outFd, &fds);
 	    if (ap->outFd > j)
@@ -2445,7 +2667,8 @@ ParseRestartAgents(char *fileName)
 	    for (i = 0; i < nAgents; i++) {
 		ap = &agent[i];
 		if (ap->status.connected &&
-		    (ap->ipcType == AGENT_SOCKET || ap->ipcType == AGENT_PIPE) &&
+		    (ap->ipcType == AGENT_SOCKET || ap->ipcType == AGENT_PIPE ||
+		     ap->ipcType == AGENT_SHM) &&
 		    __pmFD_ISSET(ap->outFd, &fds)) {
 
 		    /* try to discover more ... */
@@ -2523,6 +2746,8 @@ ParseRestartAgents(char *fileName)
 #else
 !bozo!
 #endif
+    /* ... and the files used by running agents are unchanged too */
+    if (!AgentFilesChanged())
     {
 	fprintf(stderr, "Configuration file '%s' unchanged\n", fileName);
 	fprintf(stderr, "Restarting any deceased agents:\n");
@@ -2606,6 +2831,19 @@ ParseRestartAgents(char *fileName)
 		oldAgent[j].status.restartKeep = 1;
 	    }
 
+    /* Replace running agents whose configuration changed in place */
+    for (i = 0; i < nAgents; i++) {
+	if (agent[i].status.connected)
+	    continue;
+	for (j = 0; j < oldNAgents; j++) {
+	    if (oldAgent[j].status.connected && !oldAgent[j].status.restartKeep &&
+		oldAgent[j].pmDomainId == agent[i].pmDomainId) {
+		HandoverAgent(&agent[i], &oldAgent[j]);
+		break;
+	    }
+	}
+    }
+
     for (j = 0; j < oldNAgents; j++) {
 	if (oldAgent[j].status.connected && !oldAgent[j].status.restartKeep)
 	    CleanupAgent(&oldAgent[j], AT_CONFIG, 0);
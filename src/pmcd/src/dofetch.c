@@ -228,6 +228,10 @@ SendFetch(DomPmidList *dpList, AgentInfo *aPtr, ClientInfo *cPtr, int ctxnum)
 	    fprintf(stderr, "(pipe)\n");
 	    break;
 
+	case AGENT_SHM:
+	    fprintf(stderr, "(shm)\n");
+	    break;
+
 	default:
 	    fprintf(stderr, "(type %d unknown!)\n", aPtr->ipcType);
 	    break;
@@ -351,14 +355,24 @@ SendFetch(DomPmidList *dpList, AgentInfo *aPtr, ClientInfo *cPtr, int ctxnum)
  * overloaded to contain out-of-band information such as state
  * changes that may need to be communicated back to clients.
  * Extract the flags that indicate those state changes here.
+ *
+ * A label change is qualified by the label levels affected in
+ * the second byte - if the PMDA did not say, any level below the
+ * context labels (which only pmcd changes) may have changed.
  */
 static int
 ExtractState(void *timestamp)
 {
-    unsigned char	byte;
-
-    memcpy(&byte, timestamp, sizeof(unsigned char));
-    return (int)byte;
+    unsigned char	bytes[2];
+    int			levels;
+
+    memcpy(bytes, timestamp, sizeof(bytes));
+    if ((bytes[0] & PMCD_LABEL_CHANGE) == 0)
+	return (int)bytes[0];
+    levels = (bytes[1] << 8) & PMCD_LABEL_LEVELS & ~PMCD_CONTEXT_LABEL_CHANGE;
+    if (levels == 0)
+	levels = PMCD_LABEL_LEVELS & ~PMCD_CONTEXT_LABEL_CHANGE;
+    return (int)bytes[0] | levels;
 }
 
 /*
@@ -367,6 +381,93 @@ ExtractState(void *timestamp)
  * is in the output result - new uses pmHighResResult (timespec),
  * original uses pmResult (timeval).
  */
+/*
+ * Add the time from start to end into a latency histogram, see
+ * LatencyHist in client.h for the bucket boundaries
+ */
+static void
+LatencyRecord(LatencyHist *hp, struct timeval *start, struct timeval *end)
+{
+    double	usec = pmtimevalSub(end, start) * 1000000.0;
+    __uint64_t	t = usec > 0 ? (__uint64_t)usec : 0;
+    int		b;
+
+    hp->count++;
+    hp->total += t;
+    for (b = 0; t != 0 && b < PMCD_LAT_BUCKETS - 1; b++)
+	t >>= 1;
+    hp->bucket[b]++;
+}
+
+/*
+ * For clients that asked for PDU_FLAG_METADATA, send the descriptors
+ * of metrics in this result, and the instances of their indoms, that
+ * have not been sent to this client before ... saving the round trips
+ * to look them up once the result arrives.
+ */
+static int
+SendFetchMetadata(ClientInfo *cip, __pmResult *rp)
+{
+    pmInResult	*inresult;
+    pmDesc	*descs;
+    pmID	*pmids;
+    int		i, n, sts;
+
+    if ((pmids = (pmID *)malloc(rp->numpmid * sizeof(pmID))) == NULL)
+	return -oserror();
+    for (i = n = 0; i < rp->numpmid; i++) {
+	if (rp->vset[i]->numval < 0)
+	    continue;
+	if (__pmHashSearch(rp->vset[i]->pmid, &cip->sentDescs) != NULL)
+	    continue;
+	if (__pmHashAdd(rp->vset[i]->pmid, NULL, &cip->sentDescs) < 0)
+	    continue;
+	pmids[n++] = rp->vset[i]->pmid;
+    }
+    if (n == 0) {
+	free(pmids);
+	return 0;
+    }
+    if ((descs = (pmDesc *)calloc(n, sizeof(pmDesc))) == NULL) {
+	sts = -oserror();
+	free(pmids);
+	return sts;
+    }
+    GetDescs(cip, n, pmids, descs);
+    free(pmids);
+
+    /* only the descriptors found, bad ones are left to pmLookupDesc */
+    for (i = sts = 0; i < n; i++) {
+	if (descs[i].pmid != PM_ID_NULL)
+	    descs[sts++] = descs[i];
+    }
+    if ((n = sts) > 0) {
+	pmcd_trace(TR_XMIT_PDU, cip->fd, PDU_DESCS, n);
+	if ((sts = __pmSendDescs(cip->fd, FROM_ANON, n, descs)) < 0) {
+	    pmcd_trace(TR_XMIT_ERR, cip->fd, PDU_DESCS, sts);
+	    free(descs);
+	    return sts;
+	}
+    }
+
+    for (i = sts = 0; i < n && sts >= 0; i++) {
+	if (descs[i].indom == PM_INDOM_NULL)
+	    continue;
+	if (__pmHashSearch(descs[i].indom, &cip->sentInDoms) != NULL)
+	    continue;
+	if (__pmHashAdd(descs[i].indom, NULL, &cip->sentInDoms) < 0)
+	    continue;
+	if (GetInstance(cip, descs[i].indom, PM_IN_NULL, NULL, &inresult) < 0)
+	    continue;
+	pmcd_trace(TR_XMIT_PDU, cip->fd, PDU_INSTANCE, (int)descs[i].indom);
+	if ((sts = __pmSendInstance(cip->fd, FROM_ANON, inresult)) < 0)
+	    pmcd_trace(TR_XMIT_ERR, cip->fd, PDU_INSTANCE, sts);
+	__pmFreeInResult(inresult);
+    }
+    free(descs);
+    return sts < 0 ? sts : 0;
+}
+
 static int
 HandleFetch(ClientInfo *cip, __pmPDU* pb, int pdutype)
 {
@@ -382,24 +483,40 @@ HandleFetch(ClientInfo *cip, __pmPDU* pb, int pdutype)
     static int		nDoms;
     static pmResult	**results;	/* array of replies from PMDAs */
     static int		*resIndex;
+    static int		*dsoList;	/* indices into dList for DSO agents */
+    static struct timeval *sentAt;	/* when each agent was sent its request */
+    int			nDso;
+    int			d;
+    int			coalesce;
+    struct timeval	stamp;		/* when the fetch arrived */
+    struct timeval	before, now;
     __pmFdSet		waitFds;
     __pmFdSet		readyFds;
     int			nWait;
     int			maxFd;
     struct timeval	timeout;
+    double		deadline, wait;
     __pmHashCtl		*hcp;
     __pmHashNode	*hp;
     pmProfile		*profile;
 
+    pmtimevalNow(&stamp);
+
     if (nAgents > nDoms) {
 	if (results != NULL)
 	    free(results);
 	if (resIndex != NULL)
 	    free(resIndex);
+	if (dsoList != NULL)
+	    free(dsoList);
+	if (sentAt != NULL)
+	    free(sentAt);
 	results = (pmResult **)malloc((nAgents + 1) * sizeof (pmResult *));
 	resIndex = (int *)malloc((nAgents + 1) * sizeof(int));
-	if (results == NULL || resIndex == NULL) {
-	    pmNoMem("DoFetch.results", (nAgents + 1) * sizeof (pmResult *) + (nAgents + 1) * sizeof(int), PM_FATAL_ERR);
+	dsoList = (int *)malloc((nAgents + 1) * sizeof(int));
+	sentAt = (struct timeval *)malloc((nAgents + 1) * sizeof(struct timeval));
+	if (results == NULL || resIndex == NULL || dsoList == NULL || sentAt == NULL) {
+	    pmNoMem("DoFetch.results", (nAgents + 1) * (sizeof (pmResult *) + 2 * sizeof(int) + sizeof(struct timeval)), PM_FATAL_ERR);
 	    /* NOTREACHED */
 	}
 	nDoms = nAgents;
@@ -442,18 +559,35 @@ HandleFetch(ClientInfo *cip, __pmPDU* pb, int pdutype)
 
     dList = SplitPmidList(nPmids, pmidList);
 
+    coalesce = pmcd_coalesce.tv_sec != 0 || pmcd_coalesce.tv_usec != 0;
+
     /* For each domain in the split pmidList, dispatch the per-domain subset
-     * of pmIDs to the appropriate agent.  For DSO agents, the pmResult will
-     * come back immediately.  If a request cannot be sent to an agent, a
-     * suitable pmResult (containing metric not available values) will be
-     * returned.
+     * of pmIDs to the appropriate agent.  The requests for daemon agents go
+     * out first, so that they are all working on their fetches while the
+     * DSO agents are called below.  For DSO agents, the pmResult will come
+     * back immediately.  If a request cannot be sent to an agent, a suitable
+     * pmResult (containing metric not available values) will be returned.
+     * When coalescing, a recent result from the agent for the same request
+     * may be used instead.
      */
     __pmFD_ZERO(&waitFds);
     nWait = 0;
     maxFd = -1;
+    nDso = 0;
     for (i = 0; dList[i].domain != -1; i++) {
 	j = mapdom[dList[i].domain];
+	if (coalesce &&
+	    (results[j] = FetchCacheLookup(j, dList[i].listSize, dList[i].list,
+					   cip, ctxnum)) != NULL)
+	    continue;
+	if (agent[j].ipcType == AGENT_DSO) {
+	    dsoList[nDso++] = i;
+	    continue;
+	}
+	pmtimevalNow(&before);
 	results[j] = SendFetch(&dList[i], &agent[j], cip, ctxnum);
+	pmtimevalNow(&sentAt[j]);
+	LatencyRecord(&agent[j].sendTime, &before, &sentAt[j]);
 	if (results[j] == NULL) { /* Wait for agent's response */
 	    int fd = agent[j].outFd;
 	    agent[j].status.busy = 1;
@@ -469,35 +603,103 @@ HandleFetch(ClientInfo *cip, __pmPDU* pb, int pdutype)
     if (dList[i].listSize != 0)
 	results[nAgents] = MakeBadResult(dList[i].listSize, dList[i].list, PM_ERR_NOAGENT);
 
+    /* DSO agents, in domain order as before.  These share libpcp_pmda (and
+     * its caches) within pmcd and are not safe to call concurrently, so
+     * they remain serial here, but now overlapped with the daemon agents.
+     */
+    for (d = 0; d < nDso; d++) {
+	i = dsoList[d];
+	j = mapdom[dList[i].domain];
+	pmtimevalNow(&before);
+	results[j] = SendFetch(&dList[i], &agent[j], cip, ctxnum);
+	pmtimevalNow(&now);
+	LatencyRecord(&agent[j].sendTime, &before, &now);
+	pmcd_flight_agent(agent[j].pmDomainId, pmtimevalSub(&now, &before));
+	changes |= ExtractState(&results[j]->timestamp);
+	if (coalesce && !agent[j].status.madeDsoResult)
+	    results[j] = FetchCacheSave(j, dList[i].listSize, dList[i].list,
+					cip, ctxnum, &stamp, results[j]);
+    }
+
     /* Wait for results to roll in from agents */
     while (nWait > 0) {
         __pmFD_COPY(&readyFds, &waitFds);
-	if (nWait > 1) {
-	    timeout.tv_sec = pmcd_timeout;
-	    timeout.tv_usec = 0;
+
+	/*
+	 * Wait until the first of the busy agents times out - each has
+	 * its own timeout when pmcd_hedge is set, else all share
+	 * pmcd_timeout, and with only one agent to wait for, its result
+	 * is simply read below, subject to pmcd_timeout.
+	 */
+	pmtimevalNow(&now);
+	deadline = -1;
+	for (i = 0; i < nAgents; i++) {
+	    if (!agent[i].status.busy ||
+		(wait = pmcd_agent_timeout(&agent[i])) <= 0)
+		continue;
+	    wait -= pmtimevalSub(&now, &sentAt[i]);
+	    if (wait < 0)
+		wait = 0;
+	    if (deadline < 0 || wait < deadline)
+		deadline = wait;
+	}
+
+	if (nWait > 1 || pmcd_hedge > 0) {
+	    if (deadline >= 0)
+		pmtimevalFromReal(deadline, &timeout);
 
             retry:
 	    setoserror(0);
-	    sts = __pmSelectRead(maxFd+1, &readyFds, &timeout);
+	    sts = __pmSelectRead(maxFd+1, &readyFds,
+				deadline >= 0 ? &timeout : NULL);
 
 	    if (sts == 0) {
-		pmNotifyErr(LOG_INFO, "DoFetch: select timeout");
-
-		/* Timeout, terminate agents with undelivered results */
+		/* Timeout, give up on agents with undelivered results */
+		pmtimevalNow(&now);
 		for (i = 0; i < nAgents; i++) {
-		    if (agent[i].status.busy) {
-			/* Find entry in dList for this agent */
-			for (j = 0; dList[j].domain != -1; j++)
-			    if (dList[j].domain == agent[i].pmDomainId)
-				break;
+		    if (!agent[i].status.busy)
+			continue;
+		    wait = pmcd_agent_timeout(&agent[i]);
+		    if (wait <= 0 || pmtimevalSub(&now, &sentAt[i]) < wait)
+			continue;
+		    agent[i].status.busy = 0;
+		    __pmFD_CLR(agent[i].outFd, &waitFds);
+		    nWait--;
+		    pmcd_flight_agent(agent[i].pmDomainId,
+				      pmtimevalSub(&now, &sentAt[i]));
+		    /* Find entry in dList for this agent */
+		    for (j = 0; dList[j].domain != -1; j++)
+			if (dList[j].domain == agent[i].pmDomainId)
+			    break;
+		    pmcd_trace(TR_RECV_TIMEOUT, agent[i].outFd, PDU_RESULT, 0);
+		    if (wait < pmcd_timeout || pmcd_timeout == 0) {
+			/*
+			 * Slower than usual, answer without this agent and
+			 * leave it running - it is not sent requests again
+			 * until its result arrives, see HandleLateAgent.
+			 */
 			results[i] = MakeBadResult(dList[j].listSize,
 						   dList[j].list,
-						   PM_ERR_NOAGENT);
-			pmcd_trace(TR_RECV_TIMEOUT, agent[i].outFd, PDU_RESULT, 0);
-			CleanupAgent(&agent[i], AT_COMM, agent[i].inFd);
+						   PM_ERR_AGAIN);
+			agent[i].status.late = 1;
+			agent[i].status.notReady = 1;
+			agent[i].lateSince = sentAt[i];
+			agent[i].lateCount++;
+			if (pmDebugOptions.appl0)
+			    pmNotifyErr(LOG_INFO, "DoFetch: \"%s\" agent late, "
+					"gave up after %.3f sec\n",
+					agent[i].pmDomainLabel, wait);
+			continue;
 		    }
+		    /* Timeout, terminate agents with undelivered results */
+		    pmNotifyErr(LOG_INFO, "DoFetch: select timeout");
+		    LatencyRecord(&agent[i].waitTime, &sentAt[i], &now);
+		    results[i] = MakeBadResult(dList[j].listSize,
+					       dList[j].list,
+					       PM_ERR_NOAGENT);
+		    CleanupAgent(&agent[i], AT_COMM, agent[i].inFd);
 		}
-		break;
+		continue;
 	    }
 	    else if (sts < 0) {
 		if (neterror() == EINTR)
@@ -520,6 +722,9 @@ HandleFetch(ClientInfo *cip, __pmPDU* pb, int pdutype)
 	    __pmFD_CLR(ap->outFd, &waitFds);
 	    nWait--;
 	    pinpdu = sts = __pmGetPDU(ap->outFd, ANY_SIZE, pmcd_timeout, &pb);
+	    pmtimevalNow(&now);
+	    LatencyRecord(&ap->waitTime, &sentAt[i], &now);
+	    pmcd_flight_agent(ap->pmDomainId, pmtimevalSub(&now, &sentAt[i]));
 	    if (sts > 0)
 		pmcd_trace(TR_RECV_PDU, ap->outFd, sts, (int)((__psint_t)pb & 0xffffffff));
 	    if (sts == PDU_RESULT) {
@@ -528,6 +733,14 @@ HandleFetch(ClientInfo *cip, __pmPDU* pb, int pdutype)
 		    results[i] = __pmOffsetResult(rp);
 		    if (results[i]->numpmid == aFreq[i]) {
 			changes |= ExtractState(&rp->timestamp);
+			if (coalesce) {
+			    for (j = 0; dList[j].domain != -1; j++)
+				if (dList[j].domain == ap->pmDomainId)
+				    break;
+			    results[i] = FetchCacheSave(i, dList[j].listSize,
+					    dList[j].list, cip, ctxnum,
+					    &stamp, results[i]);
+			}
 		    } else {
 			if (pmDebugOptions.appl0)
 			    pmNotifyErr(LOG_ERR, "DoFetch: \"%s\" agent given %d pmIDs, returned %d\n",
@@ -607,12 +820,25 @@ HandleFetch(ClientInfo *cip, __pmPDU* pb, int pdutype)
 	sts = __pmSendError(cip->fd, FROM_ANON, (int)cip->status.changes);
 	if (sts > 0)
 	    sts = 0;
+	/* names or agents changed, so metadata may have too */
+	if (cip->status.changes & (PMCD_NAMES_CHANGE | PMCD_AGENT_CHANGE))
+	    ClearSentMetadata(cip);
 	cip->status.changes = 0;
     }
-    if (sts == 0)
-	sts = (pdutype == PDU_HIGHRES_FETCH) ?
-		__pmSendHighResResult(cip->fd, FROM_ANON, endResult) :
-		__pmSendResult(cip->fd, FROM_ANON, endResult);
+    if (sts == 0 && (__pmFeaturesIPC(cip->fd) & PDU_FLAG_METADATA))
+	sts = SendFetchMetadata(cip, endResult);
+    if (sts == 0) {
+	pmtimevalNow(&before);
+	if (pdutype != PDU_HIGHRES_FETCH)
+	    sts = __pmSendResult(cip->fd, FROM_ANON, endResult);
+	else if (__pmFeaturesIPC(cip->fd) & PDU_FLAG_COMPACT)
+	    sts = __pmSendCompactResult(cip->fd, FROM_ANON, endResult);
+	else
+	    sts = __pmSendHighResResult(cip->fd, FROM_ANON, endResult);
+	pmtimevalNow(&now);
+	LatencyRecord(&cip->xmitTime, &before, &now);
+	LatencyRecord(&cip->fetchTime, &stamp, &now);
+    }
 
     if (sts < 0) {
 	pmcd_trace(TR_XMIT_ERR, cip->fd, pdutype, sts);
@@ -624,6 +850,9 @@ HandleFetch(ClientInfo *cip, __pmPDU* pb, int pdutype)
      */
     for (i = 0; dList[i].domain != -1; i++) {
 	j = mapdom[dList[i].domain];
+	if (FetchCacheHolds(j, results[j]))
+	    /* kept for sharing with later fetches */
+	    continue;
 	if (agent[j].ipcType == AGENT_DSO && agent[j].status.connected &&
 	    !agent[j].status.madeDsoResult)
 	    /* Living DSO's manage their own pmResult skeleton unless
@@ -643,6 +872,78 @@ HandleFetch(ClientInfo *cip, __pmPDU* pb, int pdutype)
     return 0;
 }
 
+/*
+ * A late agent (see pmcd_hedge) has sent the result of the fetch that
+ * was answered without it.  Discard that result, noting how long it
+ * took, and the agent can be sent requests again (unless it is now
+ * saying it is not ready).
+ */
+void
+HandleLateAgent(AgentInfo *ap)
+{
+    int			fd = ap->outFd;
+    int			s, sts, pinpdu;
+    struct timeval	now;
+    __pmPDU		*pb;
+
+    pinpdu = sts = __pmGetPDU(fd, ANY_SIZE, pmcd_timeout, &pb);
+    pmtimevalNow(&now);
+    if (sts > 0)
+	pmcd_trace(TR_RECV_PDU, fd, sts, (int)((__psint_t)pb & 0xffffffff));
+    if (sts == PDU_ERROR) {
+	if ((s = __pmDecodeError(pb, &sts)) < 0)
+	    sts = s;
+	else if (sts != PM_ERR_PMDANOTREADY)
+	    sts = 0;
+    }
+    else if (sts == PDU_RESULT)
+	sts = 0;
+    else if (sts >= 0) {
+	pmcd_trace(TR_WRONG_PDU, fd, PDU_RESULT, sts);
+	sts = PM_ERR_IPC;
+    }
+    if (pinpdu > 0)
+	__pmUnpinPDUBuf(pb);
+
+    if (sts < 0 && sts != PM_ERR_PMDANOTREADY) {
+	CleanupAgent(ap, AT_COMM, fd);
+	return;
+    }
+    LatencyRecord(&ap->waitTime, &ap->lateSince, &now);
+    ap->status.late = 0;
+    if (sts == 0) {	/* else remains not ready, until it says otherwise */
+	ap->status.notReady = 0;
+	IOEventDel(fd);
+    }
+    if (pmDebugOptions.appl0)
+	pmNotifyErr(LOG_INFO, "\"%s\" agent late result discarded, after %.3f sec\n",
+		    ap->pmDomainLabel, pmtimevalSub(&now, &ap->lateSince));
+}
+
+/*
+ * Agents still late after pmcd_timeout are hung, and cleaned up just
+ * as those that are not given adaptive timeouts would have been.
+ */
+void
+ExpireLateAgents(void)
+{
+    struct timeval	now;
+    int			i;
+
+    if (pmcd_timeout <= 0)
+	return;
+    pmtimevalNow(&now);
+    for (i = 0; i < nAgents; i++) {
+	if (!agent[i].status.late ||
+	    pmtimevalSub(&now, &agent[i].lateSince) < pmcd_timeout)
+	    continue;
+	pmNotifyErr(LOG_INFO, "\"%s\" agent result overdue, %d sec timeout",
+			agent[i].pmDomainLabel, pmcd_timeout);
+	pmcd_trace(TR_RECV_TIMEOUT, agent[i].outFd, PDU_RESULT, 0);
+	CleanupAgent(&agent[i], AT_COMM, agent[i].inFd);
+    }
+}
+
 int
 DoFetch(ClientInfo *cip, __pmPDU *pb)
 {
@@ -67,6 +67,7 @@ DoText(ClientInfo *cp, __pmPDU* pb)
 
     if ((ap = pmcd_agent(((__pmID_int *)&ident)->domain)) == NULL)
 	return PM_ERR_PMID;
+    pmcd_flight_agent(ap->pmDomainId, 0);
     if (!ap->status.connected)
 	return PM_ERR_NOAGENT;
     if (ap->status.fenced)
@@ -167,7 +168,7 @@ DoProfile(ClientInfo *cp, __pmPDU *pb)
     return sts;
 }
 
-static int
+int
 GetDescs(ClientInfo *cp, int numpmid, pmID *pmids, pmDesc *descs)
 {
     AgentInfo	*ap;
@@ -180,6 +181,7 @@ GetDescs(ClientInfo *cp, int numpmid, pmID *pmids, pmDesc *descs)
 	    sts = PM_ERR_PMID;
 	    continue;
 	}
+	pmcd_flight_agent(ap->pmDomainId, 0);
 	if (!ap->status.connected) {
 	    descs[i].pmid = PM_ID_NULL;
 	    sts = PM_ERR_NOAGENT;
@@ -311,24 +313,24 @@ done:
     return sts;
 }
 
+/*
+ * Instance request on behalf of a client, from the PMDA for indom.
+ * Consumes name.  On success *result is to be freed by the caller.
+ */
 int
-DoInstance(ClientInfo *cp, __pmPDU *pb)
+GetInstance(ClientInfo *cp, pmInDom indom, int inst, char *name,
+		pmInResult **result)
 {
     int			sts, s;
-    pmInDom		indom;
-    int			inst;
-    char		*name;
-    pmInResult	*inresult = NULL;
+    pmInResult		*inresult = NULL;
     AgentInfo		*ap;
     int			fdfail = -1;
 
-    sts = __pmDecodeInstanceReq(pb, &indom, &inst, &name);
-    if (sts < 0)
-	return sts;
     if ((ap = pmcd_agent(((__pmInDom_int *)&indom)->domain)) == NULL) {
 	if (name != NULL) free(name);
 	return PM_ERR_INDOM;
     }
+    pmcd_flight_agent(ap->pmDomainId, 0);
     if (!ap->status.connected) {
 	if (name != NULL) free(name);
 	return PM_ERR_NOAGENT;
@@ -353,7 +355,9 @@ DoInstance(ClientInfo *cp, __pmPDU *pb)
 	pmcd_trace(TR_XMIT_PDU, ap->inFd, PDU_INSTANCE_REQ, (int)indom);
 	sts = __pmSendInstanceReq(ap->inFd, cp - client, indom, inst, name);
 	if (sts >= 0) {
+	    __pmPDU	*pb;
 	    int		pinpdu;
+
 	    pinpdu = sts = __pmGetPDU(ap->outFd, ANY_SIZE, pmcd_timeout, &pb);
 	    if (sts > 0)
 		pmcd_trace(TR_RECV_PDU, ap->outFd, sts, (int)((__psint_t)pb & 0xffffffff));
@@ -383,15 +387,8 @@ DoInstance(ClientInfo *cp, __pmPDU *pb)
     }
     if (name != NULL) free(name);
 
-    if (sts >= 0) {
-	pmcd_trace(TR_XMIT_PDU, cp->fd, PDU_INSTANCE, (int)(inresult->indom));
-	sts = __pmSendInstance(cp->fd, FROM_ANON, inresult);
-	if (sts < 0) {
-	    pmcd_trace(TR_XMIT_ERR, cp->fd, PDU_INSTANCE, sts);
-	    CleanupClient(cp, sts);
-	}
-	__pmFreeInResult(inresult);
-    }
+    if (sts >= 0)
+	*result = inresult;
     else
 	if (ap->ipcType != AGENT_DSO &&
 	    (sts == PM_ERR_IPC || sts == PM_ERR_TIMEOUT || sts == -EPIPE) &&
@@ -401,6 +398,31 @@ DoInstance(ClientInfo *cp, __pmPDU *pb)
     return sts;
 }
 
+int
+DoInstance(ClientInfo *cp, __pmPDU *pb)
+{
+    int			sts;
+    pmInDom		indom;
+    int			inst;
+    char		*name;
+    pmInResult		*inresult;
+
+    sts = __pmDecodeInstanceReq(pb, &indom, &inst, &name);
+    if (sts < 0)
+	return sts;
+    if ((sts = GetInstance(cp, indom, inst, name, &inresult)) < 0)
+	return sts;
+
+    pmcd_trace(TR_XMIT_PDU, cp->fd, PDU_INSTANCE, (int)(inresult->indom));
+    sts = __pmSendInstance(cp->fd, FROM_ANON, inresult);
+    if (sts < 0) {
+	pmcd_trace(TR_XMIT_ERR, cp->fd, PDU_INSTANCE, sts);
+	CleanupClient(cp, sts);
+    }
+    __pmFreeInResult(inresult);
+    return sts;
+}
+
 static int
 GetChangedContextLabels(pmLabelSet **sets, int *changed)
 {
@@ -524,6 +546,7 @@ DoLabel(ClientInfo *cp, __pmPDU *pb)
 	default:
 	    return PM_ERR_TYPE;
     }
+    pmcd_flight_agent(ap->pmDomainId, 0);
 
     if (!ap->status.connected)
 	return PM_ERR_NOAGENT;
@@ -668,6 +691,7 @@ DoPMNSIDs(ClientInfo *cp, __pmPDU *pb)
 	    sts = PM_ERR_NOAGENT;
 	    goto fail;
 	}
+	pmcd_flight_agent(ap->pmDomainId, 0);
 	if (!ap->status.connected) {
 	    sts = PM_ERR_NOAGENT;
 	    goto fail;
@@ -743,29 +767,20 @@ fail:
 }
 
 /*
- * This handler is for the remote version of pmLookupName.
+ * Translate names to PMIDs, with the help of the PMDAs for names
+ * below dynamic PMNS roots.  Failed translations are returned as
+ * PM_ID_NULL in idlist[].
  */
-int
-DoPMNSNames(ClientInfo *cp, __pmPDU *pb)
+static int
+LookupNames(ClientInfo *cp, int numids, char **namelist, pmID *idlist)
 {
     int		sts;
-    int		numids = 0;
-    int		numok;
     int		lsts;
     int		domain;
-    pmID	*idlist = NULL;
-    char	**namelist = NULL;
     int		i;
+    __pmPDU	*pb;
     AgentInfo	*ap = NULL;
 
-    if ((sts = __pmDecodeNameList(pb, &numids, &namelist, NULL)) < 0)
-	goto done;
-
-    if ((idlist = (pmID *)calloc(numids, sizeof(int))) == NULL) {
-        sts = -oserror();
-	goto done;
-    }
-
     sts = pmLookupName(numids, (const char **)namelist, idlist);
     /*
      * even if this fails, or looks up fewer than numids, we have to
@@ -861,6 +876,31 @@ DoPMNSNames(ClientInfo *cp, __pmPDU *pb)
 	}
     }
 
+    return sts;
+}
+
+/*
+ * This handler is for the remote version of pmLookupName.
+ */
+int
+DoPMNSNames(ClientInfo *cp, __pmPDU *pb)
+{
+    int		sts;
+    int		numids = 0;
+    int		numok;
+    pmID	*idlist = NULL;
+    char	**namelist = NULL;
+    int		i;
+
+    if ((sts = __pmDecodeNameList(pb, &numids, &namelist, NULL)) < 0)
+	goto done;
+
+    if ((idlist = (pmID *)calloc(numids, sizeof(int))) == NULL) {
+        sts = -oserror();
+	goto done;
+    }
+
+    sts = LookupNames(cp, numids, namelist, idlist);
     if (sts < 0)
 	/* fatal error or explicit error in the numids == 1 case */
 	goto done;
@@ -1247,17 +1287,25 @@ traverse_dynamic(ClientInfo *cp, char *start, int *num_names, char ***names)
  *	This is a bit inefficient but convenient.
  *	It would really be better to build up a PDU buffer
  *	directly and not do the extra copying !
+ *
+ *	If the client asks for descriptors (subtype 1), the names are
+ *	translated and their descriptors fetched in bulk, and the reply
+ *	is a PDU_PMNS_NAMEDESCS instead.
  */
 int
 DoPMNSTraverse(ClientInfo *cp, __pmPDU *pb)
 {
     int		sts = 0;
     char 	*name = NULL;
+    int		subtype = 0;
     int		travNL_need = 0;
+    pmID	*idlist = NULL;
+    pmDesc	*desclist = NULL;
+    int		i;
 
     travNL = NULL;
 
-    if ((sts = __pmDecodeTraversePMNSReq(pb, &name)) < 0)
+    if ((sts = __pmDecodeTraversePMNSReq2(pb, &name, &subtype)) < 0)
 	goto done;
   
     travNL_strlen = 0;
@@ -1291,6 +1339,25 @@ check:
     if (travNL_num < 1)
 	goto done;
 
+    if (subtype == 1 &&
+	(idlist = (pmID *)calloc(travNL_num, sizeof(pmID))) != NULL &&
+	(desclist = (pmDesc *)calloc(travNL_num, sizeof(pmDesc))) != NULL &&
+	LookupNames(cp, travNL_num, travNL, idlist) >= 0) {
+	/* failed lookups are returned with a PM_ID_NULL descriptor */
+	GetDescs(cp, travNL_num, idlist, desclist);
+	for (i = 0; i < travNL_num; i++) {
+	    if (desclist[i].pmid != idlist[i])
+		desclist[i].pmid = PM_ID_NULL;
+	}
+	pmcd_trace(TR_XMIT_PDU, cp->fd, PDU_PMNS_NAMEDESCS, travNL_num);
+	if ((sts = __pmSendNameDescs(cp->fd, FROM_ANON, travNL_num, (const char **)travNL, desclist)) < 0) {
+	    pmcd_trace(TR_XMIT_ERR, cp->fd, PDU_PMNS_NAMEDESCS, sts);
+	    CleanupClient(cp, sts);
+	}
+	goto done;
+    }
+
+    /* names only, or we could not get the descriptors */
     pmcd_trace(TR_XMIT_PDU, cp->fd, PDU_PMNS_NAMES, travNL_num);
     if ((sts = __pmSendNameList(cp->fd, FROM_ANON, travNL_num, (const char **)travNL, NULL)) < 0) {
 	pmcd_trace(TR_XMIT_ERR, cp->fd, PDU_PMNS_NAMES, sts);
@@ -1301,6 +1368,8 @@ check:
 done:
     if (name) free(name);
     if (travNL) free(travNL);
+    if (idlist) free(idlist);
+    if (desclist) free(desclist);
     return sts;
 }
 
@@ -1403,6 +1472,9 @@ DoCreds(ClientInfo *cp, __pmPDU *pb)
 			{ PDU_FLAG_LABELS,	"LABELS" },
 			{ PDU_FLAG_HIGHRES,	"HIGHRES" },
 			{ PDU_FLAG_DESCS,	"DESCS" },
+			{ PDU_FLAG_SHM,		"SHM" },
+			{ PDU_FLAG_COMPACT,	"COMPACT" },
+			{ PDU_FLAG_METADATA,	"METADATA" },
 		    };
 		    int	n;
 		    int	first = 1;
@@ -1433,6 +1505,43 @@ DoCreds(ClientInfo *cp, __pmPDU *pb)
     if (sts >= 0 && version)
 	sts = __pmSetVersionIPC(cp->fd, version);
 
+    /*
+     * Compact result encoding and metadata sent with results are not
+     * connection attributes, remember the client asked for them and
+     * keep them out of the handshake below.
+     */
+    if (sts >= 0 && (flags & (PDU_FLAG_COMPACT | PDU_FLAG_METADATA))) {
+	sts = __pmSetFeaturesIPC(cp->fd, version,
+			flags & (PDU_FLAG_COMPACT | PDU_FLAG_METADATA));
+	flags &= ~(PDU_FLAG_COMPACT | PDU_FLAG_METADATA);
+    }
+
+    /*
+     * A local client offering a shared memory ring sends it next; large
+     * PDUs (results) for the client then go through the ring.  If there
+     * is no ring or it is not usable, PDUs are simply sent inline.
+     */
+    if (sts >= 0 && (flags & PDU_FLAG_SHM)) {
+	struct timeval	wait = { 1, 0 };
+	int		shmfd;
+
+	if ((shmfd = __pmShmRecvFd(cp->fd, &wait)) >= 0) {
+	    if ((sts = __pmSetShmIPC(cp->fd, shmfd, PDU_SHM_XMIT)) < 0) {
+		if (pmDebugOptions.attr)
+		    fprintf(stderr, "DoCreds: client fd=%d shared memory ring: %s\n",
+			    cp->fd, pmErrStr(sts));
+		sts = 0;
+	    }
+	    close(shmfd);
+	}
+	else if (shmfd == PM_ERR_IPC || shmfd == PM_ERR_TIMEOUT)
+	    sts = shmfd;
+	else if (pmDebugOptions.attr)
+	    fprintf(stderr, "DoCreds: client fd=%d no shared memory ring: %s\n",
+		    cp->fd, pmErrStr(shmfd));
+	flags &= ~PDU_FLAG_SHM;
+    }
+
     /*
      * In normal operation, some of this code is redundant. A 
      * remote client should error out during initial handshake
@@ -159,6 +159,9 @@ DoStore(ClientInfo *cp, __pmPDU* pb)
 	ap = pmcd_agent(((__pmID_int *)&dResult[i]->vset[0]->pmid)->domain);
 	/* If it's in a "good" list, pmID has agent that is connected */
 	assert(ap != NULL);
+	pmcd_flight_agent(ap->pmDomainId, 0);
+	/* later fetches must see the effects of the store */
+	FetchCacheDrop(ap);
 
 	if (ap->ipcType == AGENT_DSO) {
 	    if (ap->ipc.dso.dispatch.comm.pmda_interface >= PMDA_INTERFACE_5)
@@ -0,0 +1,299 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * Input readiness for the pmcd main loop.
+ *
+ * The file descriptors pmcd waits on (request ports, clients and
+ * not-ready agents) are registered here with a type and a datum
+ * (address family, client[] or agent[] index), and IOEventWait()
+ * returns just the ones that are ready.  epoll(7) is used on Linux
+ * and kqueue(2) on the BSDs and macOS, so the cost of a wakeup does
+ * not depend on the number of connected clients and there is no
+ * FD_SETSIZE limit on descriptor values.  select(2) remains as the
+ * fallback, and may be forced with PMCD_EVENT_LOOP=select in the
+ * environment.
+ */
+
+#include "pmapi.h"
+#include "libpcp.h"
+#include "pmcd.h"
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+#ifdef HAVE_SYS_EVENT_H
+#include <sys/event.h>
+#endif
+
+#define IOEV_SELECT	0
+#define IOEV_EPOLL	1
+#define IOEV_KQUEUE	2
+
+static int	backend = IOEV_SELECT;
+static int	evfd = -1;		/* epoll or kqueue descriptor */
+
+static IOEvent	*source;		/* registered, indexed by fd */
+static int	nsource;		/* allocated entries in source[] */
+static int	nactive;		/* registered descriptors */
+
+static IOEvent	*ready;			/* returned by IOEventWait() */
+static int	nready;			/* allocated entries in ready[] */
+
+static __pmFdSet selectFds;		/* select backend */
+static int	maxSelectFd = -1;
+
+#if defined(HAVE_SYS_EPOLL_H)
+static struct epoll_event	*evlist;
+#elif defined(HAVE_SYS_EVENT_H)
+static struct kevent		*evlist;
+#endif
+
+static const char *
+backend_name(int which)
+{
+    switch (which) {
+	case IOEV_EPOLL:
+	    return "epoll";
+	case IOEV_KQUEUE:
+	    return "kqueue";
+    }
+    return "select";
+}
+
+const char *
+IOEventBackend(void)
+{
+    return backend_name(backend);
+}
+
+int
+IOEventInit(void)
+{
+    char	*env;
+
+    __pmFD_ZERO(&selectFds);
+    if ((env = getenv("PMCD_EVENT_LOOP")) != NULL &&
+	strcmp(env, "select") == 0)
+	return 0;
+
+#if defined(HAVE_SYS_EPOLL_H)
+#if defined(EPOLL_CLOEXEC)
+    evfd = epoll_create1(EPOLL_CLOEXEC);
+#else
+    if ((evfd = epoll_create(64)) >= 0)
+	fcntl(evfd, F_SETFD, FD_CLOEXEC);
+#endif
+    if (evfd >= 0)
+	backend = IOEV_EPOLL;
+#elif defined(HAVE_SYS_EVENT_H)
+    if ((evfd = kqueue()) >= 0)
+	backend = IOEV_KQUEUE;
+#endif
+    if (backend == IOEV_SELECT && env != NULL && strcmp(env, "select") != 0)
+	pmNotifyErr(LOG_WARNING, "IOEventInit: %s not available (%s), using select\n",
+			env, osstrerror());
+    return 0;
+}
+
+/*
+ * Register fd for input, replacing any previous registration of the
+ * same descriptor
+ */
+int
+IOEventAdd(int fd, int type, int data)
+{
+    IOEvent	*tmp;
+    int		size;
+    int		sts = 0;
+
+    if (fd < 0)
+	return -EBADF;
+    if (backend == IOEV_SELECT && fd >= FD_SETSIZE)
+	return -EMFILE;
+
+    if (fd >= nsource) {
+	size = nsource ? nsource : 64;
+	while (size <= fd)
+	    size *= 2;
+	if ((tmp = (IOEvent *)realloc(source, size * sizeof(IOEvent))) == NULL)
+	    return -oserror();
+	memset(&tmp[nsource], 0, (size - nsource) * sizeof(IOEvent));
+	source = tmp;
+	nsource = size;
+    }
+
+    if (source[fd].type == IOEV_NONE) {
+	switch (backend) {
+#if defined(HAVE_SYS_EPOLL_H)
+	case IOEV_EPOLL: {
+	    struct epoll_event	ev;
+
+	    memset(&ev, 0, sizeof(ev));
+	    ev.events = EPOLLIN;
+	    ev.data.fd = fd;
+	    if (epoll_ctl(evfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		/* stale from a descriptor closed without IOEventDel() */
+		if (oserror() != EEXIST)
+		    sts = -oserror();
+		else if (epoll_ctl(evfd, EPOLL_CTL_MOD, fd, &ev) < 0)
+		    sts = -oserror();
+	    }
+	    break;
+	}
+#elif defined(HAVE_SYS_EVENT_H)
+	case IOEV_KQUEUE: {
+	    struct kevent	ev;
+
+	    EV_SET(&ev, fd, EVFILT_READ, EV_ADD, 0, 0, NULL);
+	    if (kevent(evfd, &ev, 1, NULL, 0, NULL) < 0)
+		sts = -oserror();
+	    break;
+	}
+#endif
+	default:
+	    __pmFD_SET(fd, &selectFds);
+	    if (fd > maxSelectFd)
+		maxSelectFd = fd;
+	    break;
+	}
+	if (sts < 0)
+	    return sts;
+	nactive++;
+    }
+
+    source[fd].fd = fd;
+    source[fd].type = type;
+    source[fd].data = data;
+    return 0;
+}
+
+/*
+ * Stop waiting for input on fd ... must be called before fd is closed
+ */
+void
+IOEventDel(int fd)
+{
+    if (fd < 0 || fd >= nsource || source[fd].type == IOEV_NONE)
+	return;
+
+    switch (backend) {
+#if defined(HAVE_SYS_EPOLL_H)
+    case IOEV_EPOLL: {
+	struct epoll_event	ev;	/* non-NULL for kernels before 2.6.9 */
+
+	memset(&ev, 0, sizeof(ev));
+	epoll_ctl(evfd, EPOLL_CTL_DEL, fd, &ev);
+	break;
+    }
+#elif defined(HAVE_SYS_EVENT_H)
+    case IOEV_KQUEUE: {
+	struct kevent	ev;
+
+	EV_SET(&ev, fd, EVFILT_READ, EV_DELETE, 0, 0, NULL);
+	kevent(evfd, &ev, 1, NULL, 0, NULL);
+	break;
+    }
+#endif
+    default:
+	__pmFD_CLR(fd, &selectFds);
+	if (fd == maxSelectFd) {
+	    while (maxSelectFd >= 0 && !__pmFD_ISSET(maxSelectFd, &selectFds))
+		maxSelectFd--;
+	}
+	break;
+    }
+    memset(&source[fd], 0, sizeof(IOEvent));
+    nactive--;
+}
+
+/*
+ * Registration for fd, or NULL if fd is not registered
+ */
+IOEvent *
+IOEventLookup(int fd)
+{
+    if (fd < 0 || fd >= nsource || source[fd].type == IOEV_NONE)
+	return NULL;
+    return &source[fd];
+}
+
+/*
+ * Block until at least one registered descriptor has input (or a
+ * signal arrives), then return the number of ready descriptors with
+ * their registrations in *readyp.  Returns -1 with oserror() set on
+ * failure, as select(2).
+ */
+int
+IOEventWait(IOEvent **readyp)
+{
+    int		size;
+    int		count = 0;
+    int		fd, i, sts;
+
+    size = nactive > 0 ? nactive : 1;
+    if (size > nready) {
+	IOEvent		*tmp;
+
+	if ((tmp = (IOEvent *)realloc(ready, size * sizeof(IOEvent))) == NULL)
+	    return -1;
+	ready = tmp;
+#if defined(HAVE_SYS_EPOLL_H) || defined(HAVE_SYS_EVENT_H)
+	if (backend != IOEV_SELECT) {
+	    void	*evtmp;
+
+	    if ((evtmp = realloc(evlist, size * sizeof(*evlist))) == NULL)
+		return -1;
+	    evlist = evtmp;
+	}
+#endif
+	nready = size;
+    }
+
+    switch (backend) {
+#if defined(HAVE_SYS_EPOLL_H)
+    case IOEV_EPOLL:
+	if ((sts = epoll_wait(evfd, evlist, size, -1)) < 0)
+	    return -1;
+	for (i = 0; i < sts; i++) {
+	    fd = evlist[i].data.fd;
+	    if (fd < nsource && source[fd].type != IOEV_NONE)
+		ready[count++] = source[fd];
+	}
+	break;
+#elif defined(HAVE_SYS_EVENT_H)
+    case IOEV_KQUEUE:
+	if ((sts = kevent(evfd, NULL, 0, evlist, size, NULL)) < 0)
+	    return -1;
+	for (i = 0; i < sts; i++) {
+	    fd = (int)evlist[i].ident;
+	    if (fd < nsource && source[fd].type != IOEV_NONE)
+		ready[count++] = source[fd];
+	}
+	break;
+#endif
+    default: {
+	__pmFdSet	readableFds;
+
+	readableFds = selectFds;
+	if ((sts = __pmSelectRead(maxSelectFd+1, &readableFds, NULL)) < 0)
+	    return -1;
+	for (fd = 0; fd <= maxSelectFd && count < sts; fd++) {
+	    if (__pmFD_ISSET(fd, &readableFds))
+		ready[count++] = source[fd];
+	}
+	break;
+    }
+    }
+
+    *readyp = ready;
+    return count;
+}
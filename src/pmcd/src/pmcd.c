@@ -37,7 +37,6 @@ int		AgentPendingRestart;	/* for automatic restart */
 int		labelChanged;		/* For SIGHUP labels check */
 static int	timeToDie;		/* For SIGINT handling */
 static int	restart;		/* For SIGHUP restart */
-static int	maxReqPortFd;		/* Largest request port fd */
 static char	configFileName[MAXPATHLEN]; /* path to pmcd.conf */
 static char	*logfile = "pmcd.log";	/* log file name */
 static int	run_daemon = 1;		/* run as a daemon, see -f */
@@ -100,11 +99,15 @@ static pmLongOptions longopts[] = {
     { "foreground", 0, 'f', 0, "run in the foreground" },
     { "hostname", 1, 'H', "HOST", "set the hostname to be used for pmcd.hostname metric" },
     { "username", 1, 'U', "USER", "in daemon mode, run as named user [default pcp]" },
+    { "cpus", 1, 'C', "LIST", "run pmcd and its agents on these CPUs" },
+    { "mems", 1, 'M', "LIST", "allocate pmcd and agent memory from these NUMA nodes" },
     PMAPI_OPTIONS_HEADER("Configuration options"),
     { "config", 1, 'c', "PATH", "path to configuration file" },
+    { "coalesce", 1, 'F', "TIME", "share identical PMDA fetches made within TIME [default 0, never]" },
     { "", 1, 'L', "BYTES", "maximum size for PDUs from clients [default 65536]" },
     { "", 1, 'q', "TIME", "PMDA initial negotiation timeout (seconds) [default 3]" },
     { "", 1, 't', "TIME", "PMDA response timeout (seconds) [default 5]" },
+    { "hedge", 1, 'y', "N", "answer fetches without PMDAs N times slower than usual [default 0, never]" },
     { "verify", 0, 'v', 0, "check validity of pmcd configuration, then exit" },
     PMAPI_OPTIONS_HEADER("Connection options"),
     { "interface", 1, 'i', "ADDR", "accept connections on this IP address" },
@@ -121,7 +124,7 @@ static pmLongOptions longopts[] = {
 
 static pmOptions opts = {
     .flags = PM_OPTFLAG_POSIX,
-    .short_options = "Ac:D:fH:i:l:L:N:n:p:q:Qs:St:T:U:vx:?",
+    .short_options = "Ac:C:D:fF:H:i:l:L:M:N:n:p:q:Qs:St:T:U:vx:y:?",
     .long_options = longopts,
 };
 
@@ -149,6 +152,16 @@ ParseOptions(int argc, char *argv[], int *nports)
 		strncpy(configFileName, opts.optarg, sizeof(configFileName)-1);
 		break;
 
+	    case 'C':	/* CPU affinity */
+		if (ParseAffinityList(opts.optarg, NULL) < 0) {
+		    pmprintf("%s: -C requires a CPU list: %s\n",
+			pmGetProgname(), opts.optarg);
+		    opts.errors++;
+		}
+		else
+		    pmcd_affinity.cpus = opts.optarg;
+		break;
+
 	    case 'D':	/* debug options */
 		sts = pmSetDebug(opts.optarg);
 		if (sts < 0) {
@@ -163,6 +176,16 @@ ParseOptions(int argc, char *argv[], int *nports)
 		run_daemon = 0;
 		break;
 
+	    case 'F':
+		/* coalescing window for fetches from different clients */
+		if (pmParseInterval(opts.optarg, &pmcd_coalesce, &endptr) < 0) {
+		    pmprintf("%s: -F requires a time interval: %s\n",
+			pmGetProgname(), endptr);
+		    free(endptr);
+		    opts.errors++;
+		}
+		break;
+
 	    case 'i':
 		/* one (of possibly several) interfaces for client requests */
 		__pmServerAddInterface(opts.optarg);
@@ -188,6 +211,16 @@ ParseOptions(int argc, char *argv[], int *nports)
 		}
 		break;
 
+	    case 'M':	/* NUMA memory nodes */
+		if (ParseAffinityList(opts.optarg, NULL) < 0) {
+		    pmprintf("%s: -M requires a memory node list: %s\n",
+			pmGetProgname(), opts.optarg);
+		    opts.errors++;
+		}
+		else
+		    pmcd_affinity.mems = opts.optarg;
+		break;
+
 	    case 'N':
 		dupok = 0;
 		/*FALLTHROUGH*/
@@ -263,6 +296,17 @@ ParseOptions(int argc, char *argv[], int *nports)
 		fatalfile = opts.optarg;
 		break;
 
+	    case 'y':
+		val = (int)strtol(opts.optarg, &endptr, 10);
+		if (*endptr != '\0' || val < 0) {
+		    pmprintf("%s: -y requires a positive numeric argument\n",
+			pmGetProgname());
+		    opts.errors++;
+		} else {
+		    pmcd_hedge = val;
+		}
+		break;
+
 	    case '?':
 		usage = 1;
 		break;
@@ -287,146 +331,141 @@ ParseOptions(int argc, char *argv[], int *nports)
 }
 
 /*
- * Determine which clients (if any) have sent data to the server and handle it
- * as required.
+ * Handle the data a client has sent to the server, as required.
  */
-void
-HandleClientInput(__pmFdSet *fdsPtr)
+static void
+HandleClientInput(ClientInfo *cp)
 {
     int		sts;
-    int		i;
+    int		status;
+    int		i = cp - client;
+    int		pinpdu;
     __pmPDU	*pb;
     __pmPDUHdr	*php;
-    ClientInfo	*cp;
-
-    for (i = 0; i < nClients; i++) {
-	int		pinpdu;
-
-	if (!client[i].status.connected || !__pmFD_ISSET(client[i].fd, fdsPtr))
-	    continue;
 
-	cp = &client[i];
-	this_client_id = i;
+    this_client_id = i;
 
-	pinpdu = sts = __pmGetPDU(cp->fd, LIMIT_SIZE, pmcd_timeout, &pb);
-	if (sts > 0) {
-	    pmcd_trace(TR_RECV_PDU, cp->fd, sts, (int)((__psint_t)pb & 0xffffffff));
-	} else {
-	    CleanupClient(cp, sts);
-	    continue;
-	}
+    pmcd_flight_start();
+    pinpdu = sts = __pmGetPDU(cp->fd, LIMIT_SIZE, pmcd_timeout, &pb);
+    if (sts > 0) {
+	pmcd_trace(TR_RECV_PDU, cp->fd, sts, (int)((__psint_t)pb & 0xffffffff));
+    } else {
+	CleanupClient(cp, sts);
+	return;
+    }
 
-	php = (__pmPDUHdr *)pb;
-	if (__pmVersionIPC(cp->fd) == UNKNOWN_VERSION && php->type != PDU_CREDS) {
-	    /* old V1 client protocol, no longer supported */
-	    sts = PM_ERR_IPC;
-	    CleanupClient(cp, sts);
-	    __pmUnpinPDUBuf(pb);
-	    continue;
-	}
+    php = (__pmPDUHdr *)pb;
+    if (__pmVersionIPC(cp->fd) == UNKNOWN_VERSION && php->type != PDU_CREDS) {
+	/* old V1 client protocol, no longer supported */
+	sts = PM_ERR_IPC;
+	CleanupClient(cp, sts);
+	__pmUnpinPDUBuf(pb);
+	return;
+    }
 
-	if (pmDebugOptions.appl0)
-	    ShowClients(stderr);
+    if (pmDebugOptions.appl0)
+	ShowClients(stderr);
 
-	switch (php->type) {
-	    case PDU_PROFILE:
-		sts = (cp->denyOps & PMCD_OP_FETCH) ?
-		      PM_ERR_PERMISSION : DoProfile(cp, pb);
-		break;
+    switch (php->type) {
+	case PDU_PROFILE:
+	    sts = (cp->denyOps & PMCD_OP_FETCH) ?
+		  PM_ERR_PERMISSION : DoProfile(cp, pb);
+	    break;
 
-	    case PDU_FETCH:
-		sts = (cp->denyOps & PMCD_OP_FETCH) ?
-		      PM_ERR_PERMISSION : DoFetch(cp, pb);
-		break;
+	case PDU_FETCH:
+	    sts = (cp->denyOps & PMCD_OP_FETCH) ?
+		  PM_ERR_PERMISSION : DoFetch(cp, pb);
+	    break;
 
-	    case PDU_HIGHRES_FETCH:
-		sts = (cp->denyOps & PMCD_OP_FETCH) ?
-		      PM_ERR_PERMISSION : DoHighResFetch(cp, pb);
-		break;
+	case PDU_HIGHRES_FETCH:
+	    sts = (cp->denyOps & PMCD_OP_FETCH) ?
+		  PM_ERR_PERMISSION : DoHighResFetch(cp, pb);
+	    break;
 
-	    case PDU_INSTANCE_REQ:
-		sts = (cp->denyOps & PMCD_OP_FETCH) ?
-		      PM_ERR_PERMISSION : DoInstance(cp, pb);
-		break;
+	case PDU_INSTANCE_REQ:
+	    sts = (cp->denyOps & PMCD_OP_FETCH) ?
+		  PM_ERR_PERMISSION : DoInstance(cp, pb);
+	    break;
 
-	    case PDU_LABEL_REQ:
-		sts = (cp->denyOps & PMCD_OP_FETCH) ?
-		      PM_ERR_PERMISSION : DoLabel(cp, pb);
-		break;
+	case PDU_LABEL_REQ:
+	    sts = (cp->denyOps & PMCD_OP_FETCH) ?
+		  PM_ERR_PERMISSION : DoLabel(cp, pb);
+	    break;
 
-	    case PDU_DESC_REQ:
-		sts = (cp->denyOps & PMCD_OP_FETCH) ?
-		      PM_ERR_PERMISSION : DoDesc(cp, pb);
-		break;
+	case PDU_DESC_REQ:
+	    sts = (cp->denyOps & PMCD_OP_FETCH) ?
+		  PM_ERR_PERMISSION : DoDesc(cp, pb);
+	    break;
 
-	    case PDU_DESC_IDS:
-		sts = (cp->denyOps & PMCD_OP_FETCH) ?
-		      PM_ERR_PERMISSION : DoDescIDs(cp, pb);
-		break;
+	case PDU_DESC_IDS:
+	    sts = (cp->denyOps & PMCD_OP_FETCH) ?
+		  PM_ERR_PERMISSION : DoDescIDs(cp, pb);
+	    break;
 
-	    case PDU_TEXT_REQ:
-		sts = (cp->denyOps & PMCD_OP_FETCH) ?
-		      PM_ERR_PERMISSION : DoText(cp, pb);
-		break;
+	case PDU_TEXT_REQ:
+	    sts = (cp->denyOps & PMCD_OP_FETCH) ?
+		  PM_ERR_PERMISSION : DoText(cp, pb);
+	    break;
 
-	    case PDU_RESULT:
-		sts = (cp->denyOps & PMCD_OP_STORE) ?
-		      PM_ERR_PERMISSION : DoStore(cp, pb);
-		break;
+	case PDU_RESULT:
+	    sts = (cp->denyOps & PMCD_OP_STORE) ?
+		  PM_ERR_PERMISSION : DoStore(cp, pb);
+	    break;
 
-	    case PDU_PMNS_IDS:
-		sts = (cp->denyOps & PMCD_OP_FETCH) ?
-		      PM_ERR_PERMISSION : DoPMNSIDs(cp, pb);
-		break;
+	case PDU_PMNS_IDS:
+	    sts = (cp->denyOps & PMCD_OP_FETCH) ?
+		  PM_ERR_PERMISSION : DoPMNSIDs(cp, pb);
+	    break;
 
-	    case PDU_PMNS_NAMES:
-		sts = (cp->denyOps & PMCD_OP_FETCH) ?
-		      PM_ERR_PERMISSION : DoPMNSNames(cp, pb);
-		break;
+	case PDU_PMNS_NAMES:
+	    sts = (cp->denyOps & PMCD_OP_FETCH) ?
+		  PM_ERR_PERMISSION : DoPMNSNames(cp, pb);
+	    break;
 
-	    case PDU_PMNS_CHILD:
-		sts = (cp->denyOps & PMCD_OP_FETCH) ?
-		      PM_ERR_PERMISSION : DoPMNSChild(cp, pb);
-		break;
+	case PDU_PMNS_CHILD:
+	    sts = (cp->denyOps & PMCD_OP_FETCH) ?
+		  PM_ERR_PERMISSION : DoPMNSChild(cp, pb);
+	    break;
 
-	    case PDU_PMNS_TRAVERSE:
-		sts = (cp->denyOps & PMCD_OP_FETCH) ?
-		      PM_ERR_PERMISSION : DoPMNSTraverse(cp, pb);
-		break;
+	case PDU_PMNS_TRAVERSE:
+	    sts = (cp->denyOps & PMCD_OP_FETCH) ?
+		  PM_ERR_PERMISSION : DoPMNSTraverse(cp, pb);
+	    break;
 
-	    case PDU_CREDS:
-		sts = DoCreds(cp, pb);
-		break;
+	case PDU_CREDS:
+	    sts = DoCreds(cp, pb);
+	    break;
 
-	    default:
-		sts = PM_ERR_IPC;
-	}
-	if (sts < 0) {
-	    if (pmDebugOptions.appl0)
-		fprintf(stderr, "PDU:  %s client[%d]: %s\n",
-		    __pmPDUTypeStr(php->type), i, pmErrStr(sts));
-	    /* Make sure client still alive before sending. */
-	    if (cp->status.connected) {
-		pmcd_trace(TR_XMIT_PDU, cp->fd, PDU_ERROR, sts);
-		sts = __pmSendError(cp->fd, FROM_ANON, sts);
-		if (sts < 0)
-		    pmNotifyErr(LOG_ERR, "HandleClientInput: "
-			"error sending Error PDU to client[%d] %s\n", i, pmErrStr(sts));
-	    }
+	default:
+	    sts = PM_ERR_IPC;
+    }
+    status = sts < 0 ? sts : 0;
+    if (sts < 0) {
+	if (pmDebugOptions.appl0)
+	    fprintf(stderr, "PDU:  %s client[%d]: %s\n",
+		__pmPDUTypeStr(php->type), i, pmErrStr(sts));
+	/* Make sure client still alive before sending. */
+	if (cp->status.connected) {
+	    pmcd_trace(TR_XMIT_PDU, cp->fd, PDU_ERROR, sts);
+	    sts = __pmSendError(cp->fd, FROM_ANON, sts);
+	    if (sts < 0)
+		pmNotifyErr(LOG_ERR, "HandleClientInput: "
+		    "error sending Error PDU to client[%d] %s\n", i, pmErrStr(sts));
 	}
-	if (pinpdu > 0)
-	    __pmUnpinPDUBuf(pb);
+    }
+    pmcd_flight_end(cp->seq, php->type, php->len, status);
+    if (pinpdu > 0)
+	__pmUnpinPDUBuf(pb);
 
-	/*
-	 * May need to send connection attributes to interested PMDAs, if
-	 * something changed for this client during this PDU exchange.
-	 */
-	if (client[i].status.attributes) {
-	    if (pmDebugOptions.appl1)
-		pmNotifyErr(LOG_INFO, "Client idx=%d,seq=%d attrs reset\n",
-				i, client[i].seq);
-	    AgentsAttributes(i);
-	}
+    /*
+     * May need to send connection attributes to interested PMDAs, if
+     * something changed for this client during this PDU exchange.
+     */
+    if (client[i].status.attributes) {
+	if (pmDebugOptions.appl1)
+	    pmNotifyErr(LOG_INFO, "Client idx=%d,seq=%d attrs reset\n",
+			    i, client[i].seq);
+	AgentsAttributes(i);
     }
 }
 
@@ -573,7 +612,7 @@ static void
 SignalReloadLabels(void)
 {
     /* Inform clients there's been a change in context label state */
-    MarkStateChanges(PMCD_LABEL_CHANGE);
+    MarkStateChanges(PMCD_LABEL_CHANGE | PMCD_CONTEXT_LABEL_CHANGE);
 }
 
 static void
@@ -605,154 +644,192 @@ SignalReloadPMNS(void)
     }
 }
 
-/* Process I/O on file descriptors from agents that were marked as not ready
- * to handle PDUs.
+/* Process I/O on the file descriptor from an agent that was marked as not
+ * ready to handle PDUs.  Returns 1 if the agent is now ready.
  */
 static int
-HandleReadyAgents(__pmFdSet *readyFds)
+HandleReadyAgent(AgentInfo *ap)
 {
-    int		i, s, sts;
-    int		fd;
+    int		s, sts;
+    int		fd = ap->outFd;
     int		reason;
     int		ready = 0;
-    AgentInfo	*ap;
+    int		pinpdu;
     __pmPDU	*pb;
 
-    for (i = 0; i < nAgents; i++) {
-	ap = &agent[i];
-	if (ap->status.notReady) {
-	    fd = ap->outFd;
-	    if (__pmFD_ISSET(fd, readyFds)) {
-		int		pinpdu;
-
-		/* Expect an error PDU containing PM_ERR_PMDAREADY */
-		reason = AT_COMM;	/* most errors are protocol failures */
-		pinpdu = sts = __pmGetPDU(ap->outFd, ANY_SIZE, pmcd_timeout, &pb);
-		if (sts > 0)
-		    pmcd_trace(TR_RECV_PDU, ap->outFd, sts, (int)((__psint_t)pb & 0xffffffff));
-		if (sts == PDU_ERROR) {
-		    s = __pmDecodeError(pb, &sts);
-		    if (s < 0) {
-			sts = s;
-			pmcd_trace(TR_RECV_ERR, ap->outFd, PDU_ERROR, sts);
-		    }
-		    else {
-			/* sts is the status code from the error PDU */
-			if (pmDebugOptions.appl0)
-			    pmNotifyErr(LOG_INFO,
-				 "%s agent (not ready) sent %s status(%d)\n",
-				 ap->pmDomainLabel,
-				 sts == PM_ERR_PMDAREADY ?
-					     "ready" : "unknown", sts);
-			if (sts == PM_ERR_PMDAREADY) {
-			    ap->status.notReady = 0;
-			    sts = 1;
-			    ready++;
-			}
-			else {
-			    pmcd_trace(TR_RECV_ERR, ap->outFd, PDU_ERROR, sts);
-			    sts = PM_ERR_IPC;
-			}
-		    }
-		}
-		else {
-		    if (sts < 0)
-			pmcd_trace(TR_RECV_ERR, ap->outFd, PDU_RESULT, sts);
-		    else
-			pmcd_trace(TR_WRONG_PDU, ap->outFd, PDU_ERROR, sts);
- 		    sts = PM_ERR_IPC; /* Wrong PDU type */
-		}
-		if (pinpdu > 0)
-		    __pmUnpinPDUBuf(pb);
-
-		if (ap->ipcType != AGENT_DSO && sts <= 0)
-		    CleanupAgent(ap, reason, fd);
+    /* Expect an error PDU containing PM_ERR_PMDAREADY */
+    reason = AT_COMM;	/* most errors are protocol failures */
+    pinpdu = sts = __pmGetPDU(ap->outFd, ANY_SIZE, pmcd_timeout, &pb);
+    if (sts > 0)
+	pmcd_trace(TR_RECV_PDU, ap->outFd, sts, (int)((__psint_t)pb & 0xffffffff));
+    if (sts == PDU_ERROR) {
+	s = __pmDecodeError(pb, &sts);
+	if (s < 0) {
+	    sts = s;
+	    pmcd_trace(TR_RECV_ERR, ap->outFd, PDU_ERROR, sts);
+	}
+	else {
+	    /* sts is the status code from the error PDU */
+	    if (pmDebugOptions.appl0)
+		pmNotifyErr(LOG_INFO,
+		     "%s agent (not ready) sent %s status(%d)\n",
+		     ap->pmDomainLabel,
+		     sts == PM_ERR_PMDAREADY ?
+				 "ready" : "unknown", sts);
+	    if (sts == PM_ERR_PMDAREADY) {
+		ap->status.notReady = 0;
+		IOEventDel(fd);
+		sts = 1;
+		ready++;
+	    }
+	    else {
+		pmcd_trace(TR_RECV_ERR, ap->outFd, PDU_ERROR, sts);
+		sts = PM_ERR_IPC;
 	    }
 	}
     }
+    else {
+	if (sts < 0)
+	    pmcd_trace(TR_RECV_ERR, ap->outFd, PDU_RESULT, sts);
+	else
+	    pmcd_trace(TR_WRONG_PDU, ap->outFd, PDU_ERROR, sts);
+	sts = PM_ERR_IPC; /* Wrong PDU type */
+    }
+    if (pinpdu > 0)
+	__pmUnpinPDUBuf(pb);
+
+    if (ap->ipcType != AGENT_DSO && sts <= 0)
+	CleanupAgent(ap, reason, fd);
     return ready;
 }
 
+/*
+ * Agents that were not ready may send an ERROR PDU to indicate they are
+ * now ready, so wait for input from exactly those agents.
+ */
+static void
+WatchNotReadyAgents(void)
+{
+    int		i, fd, sts;
+    IOEvent	*evp;
+
+    for (i = 0; i < nAgents; i++) {
+	AgentInfo	*ap = &agent[i];
+	int		watched;
+
+	if ((fd = ap->outFd) < 0)
+	    continue;
+	evp = IOEventLookup(fd);
+	watched = (evp != NULL && evp->type == IOEV_AGENT && evp->data == i);
+	if (ap->status.notReady && !watched) {
+	    if ((sts = IOEventAdd(fd, IOEV_AGENT, i)) < 0)
+		pmNotifyErr(LOG_ERR, "not ready: cannot check %s agent on fd %d: %s\n",
+				ap->pmDomainLabel, fd, pmErrStr(sts));
+	    else if (pmDebugOptions.appl0)
+		pmNotifyErr(LOG_INFO, "not ready: check %s agent on fd %d\n",
+				ap->pmDomainLabel, fd);
+	}
+	else if (!ap->status.notReady && watched)
+	    IOEventDel(fd);
+    }
+}
+
 static void
-CheckNewClient(__pmFdSet * fdset, int rfd, int family)
+CheckNewClient(int rfd, int family)
 {
     int		s, sts, accepted = 1;
     __uint32_t	challenge;
     ClientInfo	*cp;
 
-    if (__pmFD_ISSET(rfd, fdset)) {
-	if ((cp = AcceptNewClient(rfd)) == NULL) {
-	    if (pmDebugOptions.access) {
-		fprintf(stderr, "CheckNewClient: AcceptNewClient(%d) failed: %s\n",
-		    rfd, pmErrStr(-oserror()));
-	    }
-	    return;	/* Accept failed and no client added */
+    if ((cp = AcceptNewClient(rfd)) == NULL) {
+	if (pmDebugOptions.access) {
+	    fprintf(stderr, "CheckNewClient: AcceptNewClient(%d) failed: %s\n",
+		rfd, pmErrStr(-oserror()));
 	}
+	return;	/* Accept failed and no client added */
+    }
 
-	sts = __pmAccAddClient(cp->addr, &cp->denyOps);
+    sts = __pmAccAddClient(cp->addr, &cp->denyOps);
 #if defined(HAVE_STRUCT_SOCKADDR_UN)
-	if (sts >= 0 && family == AF_UNIX) {
-	    if ((sts = __pmServerSetLocalCreds(cp->fd, &cp->attrs)) < 0) {
-		pmNotifyErr(LOG_ERR,
-			"ClientLoop: error extracting local credentials: %s",
-			pmErrStr(sts));
-	    }
+    if (sts >= 0 && family == AF_UNIX) {
+	if ((sts = __pmServerSetLocalCreds(cp->fd, &cp->attrs)) < 0) {
+	    pmNotifyErr(LOG_ERR,
+		    "ClientLoop: error extracting local credentials: %s",
+		    pmErrStr(sts));
 	}
+    }
 #endif
-	if (sts >= 0) {
-	    memset(&cp->pduInfo, 0, sizeof(cp->pduInfo));
-	    cp->pduInfo.version = PDU_VERSION;
-	    cp->pduInfo.licensed = 1;
-	    cp->pduInfo.features |= PDU_FLAG_DESCS;
-	    cp->pduInfo.features |= PDU_FLAG_LABELS;
-	    cp->pduInfo.features |= PDU_FLAG_HIGHRES;
-	    if (__pmServerHasFeature(PM_SERVER_FEATURE_SECURE))
-		cp->pduInfo.features |= (PDU_FLAG_SECURE | PDU_FLAG_SECURE_ACK);
-	    if (__pmServerHasFeature(PM_SERVER_FEATURE_COMPRESS))
-		cp->pduInfo.features |= PDU_FLAG_COMPRESS;
-	    if (__pmServerHasFeature(PM_SERVER_FEATURE_AUTH))       /*optional*/
-		cp->pduInfo.features |= PDU_FLAG_AUTH;
-            if (__pmServerHasFeature(PM_SERVER_FEATURE_CERT_REQD))  /* Required for remote connections only */
-		cp->pduInfo.features |= PDU_FLAG_CERT_REQD;	    /* Enforced in connect.c:check_feature_flags */
-	    if (__pmServerHasFeature(PM_SERVER_FEATURE_CREDS_REQD)) /*required*/
-		cp->pduInfo.features |= PDU_FLAG_CREDS_REQD;
-	    if (__pmServerHasFeature(PM_SERVER_FEATURE_CONTAINERS))
-		cp->pduInfo.features |= PDU_FLAG_CONTAINER;
-	    challenge = *(__uint32_t *)(&cp->pduInfo);
-	    sts = 0;
-	}
-	else {
-	    challenge = 0;
-	    accepted = 0;
-	}
+    if (sts >= 0) {
+	memset(&cp->pduInfo, 0, sizeof(cp->pduInfo));
+	cp->pduInfo.version = PDU_VERSION;
+	cp->pduInfo.licensed = 1;
+	cp->pduInfo.features |= PDU_FLAG_DESCS;
+	cp->pduInfo.features |= PDU_FLAG_LABELS;
+	cp->pduInfo.features |= PDU_FLAG_HIGHRES;
+	cp->pduInfo.features |= PDU_FLAG_COMPACT;
+	cp->pduInfo.features |= PDU_FLAG_METADATA;
+	if (__pmServerHasFeature(PM_SERVER_FEATURE_SECURE))
+	    cp->pduInfo.features |= (PDU_FLAG_SECURE | PDU_FLAG_SECURE_ACK);
+	if (__pmServerHasFeature(PM_SERVER_FEATURE_COMPRESS))
+	    cp->pduInfo.features |= PDU_FLAG_COMPRESS;
+	if (__pmServerHasFeature(PM_SERVER_FEATURE_AUTH))       /*optional*/
+	    cp->pduInfo.features |= PDU_FLAG_AUTH;
+	if (__pmServerHasFeature(PM_SERVER_FEATURE_CERT_REQD))  /* Required for remote connections only */
+	    cp->pduInfo.features |= PDU_FLAG_CERT_REQD;	    /* Enforced in connect.c:check_feature_flags */
+	if (__pmServerHasFeature(PM_SERVER_FEATURE_CREDS_REQD)) /*required*/
+	    cp->pduInfo.features |= PDU_FLAG_CREDS_REQD;
+	if (__pmServerHasFeature(PM_SERVER_FEATURE_CONTAINERS))
+	    cp->pduInfo.features |= PDU_FLAG_CONTAINER;
+#if defined(HAVE_STRUCT_SOCKADDR_UN)
+	if (family == AF_UNIX)	/* client may pass a shared memory ring */
+	    cp->pduInfo.features |= PDU_FLAG_SHM;
+#endif
+	challenge = *(__uint32_t *)(&cp->pduInfo);
+	sts = 0;
+    }
+    else {
+	challenge = 0;
+	accepted = 0;
+    }
 
-	pmcd_trace(TR_XMIT_PDU, cp->fd, PDU_ERROR, sts);
+    pmcd_trace(TR_XMIT_PDU, cp->fd, PDU_ERROR, sts);
 
-	/* reset (no meaning, use fd table to version) */
-	cp->pduInfo.version = UNKNOWN_VERSION;
+    /* reset (no meaning, use fd table to version) */
+    cp->pduInfo.version = UNKNOWN_VERSION;
 
-	s = __pmSendXtendError(cp->fd, FROM_ANON, sts, htonl(challenge));
-	if (s < 0) {
+    s = __pmSendXtendError(cp->fd, FROM_ANON, sts, htonl(challenge));
+    if (s < 0) {
+	/*
+	 * Port-probe style connections frequently drop just before
+	 * reaching here, as this is the first PDU we send.  Rather
+	 * than being chatty in pmcd.log write this diagnostic only
+	 * under debugging conditions.
+	 */
+	if (pmDebugOptions.appl0)
+	    pmNotifyErr(LOG_INFO, "ClientLoop: "
+		    "error sending Conn ACK PDU to new client %s\n",
+		    pmErrStr(s));
+	if (sts >= 0)
 	    /*
-	     * Port-probe style connections frequently drop just before
-	     * reaching here, as this is the first PDU we send.  Rather
-	     * than being chatty in pmcd.log write this diagnostic only
-	     * under debugging conditions.
+	     * prefer earlier failure status if any, else
+	     * use the one from __pmSendXtendError()
 	     */
-	    if (pmDebugOptions.appl0)
-		pmNotifyErr(LOG_INFO, "ClientLoop: "
-			"error sending Conn ACK PDU to new client %s\n",
-			pmErrStr(s));
-	    if (sts >= 0)
-	        /*
-		 * prefer earlier failure status if any, else
-		 * use the one from __pmSendXtendError()
-		 */
-	        sts = s;
-	    accepted = 0;
-	}
-	if (!accepted)
-	    CleanupClient(cp, sts);
+	    sts = s;
+	accepted = 0;
+    }
+    if (!accepted)
+	CleanupClient(cp, sts);
+}
+
+static void
+WatchRequestPort(__pmFdSet *fdset, int rfd, int family)
+{
+    int		sts;
+
+    if ((sts = IOEventAdd(rfd, IOEV_REQPORT, family)) < 0) {
+	fprintf(stderr, "Error: cannot wait for connections on fd %d: %s\n",
+		rfd, pmErrStr(sts));
+	DontStart();
     }
 }
 
@@ -761,55 +838,63 @@ CheckNewClient(__pmFdSet * fdset, int rfd, int family)
 static void
 ClientLoop(void)
 {
-    int		i, fd, sts;
-    int		maxFd;
-    int		checkAgents;
+    int		i, sts;
     int		reload_namespace = 0;
     int		restartAgents = -1;	/* initial state unknown */
-    __pmFdSet	readableFds;
+    IOEvent	*ready;
 
     for (;;) {
 
-	/* Figure out which file descriptors to wait for input on.  Keep
-	 * track of the highest numbered descriptor for the select call.
-	 */
-	readableFds = clientFds;
-	maxFd = maxClientFd + 1;
+	WatchNotReadyAgents();
 
-	/* If an agent was not ready, it may send an ERROR PDU to indicate it
-	 * is now ready.  Add such agents to the list of file descriptors.
+	/*
+	 * Only the descriptors with input pending are returned, so the
+	 * cost here does not grow with the number of idle clients.
 	 */
-	checkAgents = 0;
-	for (i = 0; i < nAgents; i++) {
-	    AgentInfo	*ap = &agent[i];
-
-	    if (ap->status.notReady) {
-		fd = ap->outFd;
-		__pmFD_SET(fd, &readableFds);
-		if (fd > maxFd)
-		    maxFd = fd + 1;
-		checkAgents = 1;
-		if (pmDebugOptions.appl0)
-		    pmNotifyErr(LOG_INFO,
-				 "not ready: check %s agent on fd %d (max = %d)\n",
-				 ap->pmDomainLabel, fd, maxFd);
-	    }
-	}
-
-	sts = __pmSelectRead(maxFd, &readableFds, NULL);
+	sts = IOEventWait(&ready);
 	if (sts > 0) {
+	    pmcd_flight_ready();
+	    ExpireLateAgents();
 	    if (pmDebugOptions.appl0)
-		for (i = 0; i <= maxClientFd; i++)
-		    if (__pmFD_ISSET(i, &readableFds))
-			fprintf(stderr, "DATA: from %s (fd %d)\n",
-				FdToString(i), i);
-	    __pmServerAddNewClients(&readableFds, CheckNewClient);
-	    if (checkAgents)
-		reload_namespace = HandleReadyAgents(&readableFds);
-	    HandleClientInput(&readableFds);
+		for (i = 0; i < sts; i++)
+		    fprintf(stderr, "DATA: from %s (fd %d)\n",
+			    FdToString(ready[i].fd), ready[i].fd);
+	    /*
+	     * New connections, then agents, then client requests - the
+	     * same order as the select loop always used.  An entry may be
+	     * stale by the time it is reached (client or agent cleaned up
+	     * by an earlier entry), so check it still refers to the same
+	     * descriptor.
+	     */
+	    for (i = 0; i < sts; i++) {
+		if (ready[i].type == IOEV_REQPORT)
+		    CheckNewClient(ready[i].fd, ready[i].data);
+	    }
+	    for (i = 0; i < sts; i++) {
+		AgentInfo	*ap;
+
+		if (ready[i].type != IOEV_AGENT)
+		    continue;
+		ap = &agent[ready[i].data];
+		if (ap->outFd != ready[i].fd)
+		    continue;
+		if (ap->status.late)
+		    HandleLateAgent(ap);
+		else if (ap->status.notReady && HandleReadyAgent(ap))
+		    reload_namespace = 1;
+	    }
+	    for (i = 0; i < sts; i++) {
+		ClientInfo	*cp;
+
+		if (ready[i].type != IOEV_CLIENT)
+		    continue;
+		cp = &client[ready[i].data];
+		if (cp->status.connected && cp->fd == ready[i].fd)
+		    HandleClientInput(cp);
+	    }
 	}
 	else if (sts == -1 && neterror() != EINTR) {
-	    pmNotifyErr(LOG_ERR, "ClientLoop select: %s\n", netstrerror());
+	    pmNotifyErr(LOG_ERR, "ClientLoop %s: %s\n", IOEventBackend(), netstrerror());
 	    break;
 	}
 	if (AgentDied) {
@@ -939,6 +1024,7 @@ main(int argc, char *argv[])
     int		maxpending = MAXPENDING;
     int		env_warn = 0;
     char	*envstr;
+    __pmFdSet	requestFds;
 #ifdef HAVE_SA_SIGINFO
     static struct sigaction act;
 #endif
@@ -1007,9 +1093,8 @@ main(int argc, char *argv[])
     __pmSetSignalHandler(SIGBUS, SigBad);
     __pmSetSignalHandler(SIGSEGV, SigBad);
 
-    if ((sts = __pmServerOpenRequestPorts(&clientFds, maxpending)) < 0)
+    if ((sts = __pmServerOpenRequestPorts(&requestFds, maxpending)) < 0)
 	DontStart();
-    maxReqPortFd = maxClientFd = sts;
 
     /*
      * would prefer open log earlier so any messages up to this point
@@ -1037,6 +1122,14 @@ main(int argc, char *argv[])
 	fprintf(stderr, "%s: maxpending=%d from PMCD_MAXPENDING=%s in environment\n",
 			"Warning", maxpending, getenv("PMCD_MAXPENDING"));
 
+    /* before any agents (DSOs included) start, they inherit these */
+    if ((pmcd_affinity.cpus || pmcd_affinity.mems) &&
+	(sts = SetAffinity(&pmcd_affinity, 0)) < 0) {
+	fprintf(stderr, "Error: cannot set CPU or memory node affinity: %s\n",
+		pmErrStr(sts));
+	DontStart();
+    }
+
     sts = pmLoadASCIINameSpace(pmnsfile, dupok);
     if (sts < 0) {
 	fprintf(stderr, "Error: pmLoadASCIINameSpace(%s, %d): %s\n",
@@ -1096,6 +1189,11 @@ main(int argc, char *argv[])
     __pmServerDumpRequestPorts(stderr);
     fflush(stderr);
 
+    IOEventInit();
+    __pmServerAddNewClients(&requestFds, WatchRequestPort);
+    if (pmDebugOptions.appl0)
+	fprintf(stderr, "ClientLoop: using %s\n", IOEventBackend());
+
     /* all the work is done here */
     ClientLoop();
 
@@ -1199,9 +1297,6 @@ CleanupClient(ClientInfo *cp, int sts)
     pmcd_trace(TR_DEL_CLIENT, cp-client, cp->fd, sts);
     DeleteClient(cp);
 
-    if (maxClientFd < maxReqPortFd)
-	maxClientFd = maxReqPortFd;
-
     for (i = 0; i < nAgents; i++)
 	if (agent[i].profClient == cp)
 	    agent[i].profClient = NULL;
@@ -40,7 +40,7 @@
 
 /*
  * Structures of type-specific info for each kind of domain agent-PMCD 
- * connection (DSO, socket, pipe).
+ * connection (DSO, socket, pipe).  A shm agent uses the pipe info.
  */
 
 typedef void (*DsoInitPtr)(pmdaInterface*);
@@ -69,13 +69,24 @@ typedef struct {
     char* commandLine;			/* Command line to use for child */
     char* *argv;			/* Arg list built from command line */
     pid_t agentPid;			/* Process ID of the agent */
+    time_t fileTime;			/* Newest mtime of executables in argv */
 } PipeInfo;
 
+/*
+ * CPU and NUMA memory node affinity (affinity.c), lists in "0-3,8" form.
+ */
+typedef struct {
+    char	*cpus;			/* CPUs to run on, NULL for any */
+    char	*mems;			/* Memory nodes to allocate from */
+} AffinityInfo;
+
+#define AFFINITY_MAXBITS	1024	/* highest CPU or node number + 1 */
+
 /* The agent table and its size. */
 
 typedef struct {
     int        pmDomainId;		/* PMD identifier */
-    int        ipcType;			/* DSO, socket or pipe */
+    int        ipcType;			/* DSO, socket, pipe or shm */
     int        pduVersion;		/* PDU_VERSION for this agent */
     int        inFd, outFd;		/* For input to/output from agent */
     int	       done;			/* Set when processed for this Fetch */
@@ -93,10 +104,16 @@ typedef struct {
 	    notReady : 1,		/* Agent not ready to process PDUs */
 	    startNotReady : 1,		/* Agent starts in non-ready state */
 	    fenced : 1,			/* Agent fenced; no sampling */
-	    unused : 7,			/* Zero-padded, unused space */
+	    late : 1,			/* Result overdue, see pmcd_hedge */
+	    unused : 6,			/* Zero-padded, unused space */
 	    flags : 16;			/* Agent-supplied connection flags */
     } status;
     int		reason;			/* if ! connected */
+    LatencyHist	sendTime;		/* SendFetch, whole fetch for DSOs */
+    LatencyHist	waitTime;		/* Waiting for a daemon's result */
+    struct timeval lateSince;		/* When the overdue request was sent */
+    __uint64_t	lateCount;		/* Fetches answered without waiting */
+    AffinityInfo affinity;		/* Set for agents pmcd starts */
     union {				/* per-ipcType info */
 	DsoInfo    dso;
 	SocketInfo socket;
@@ -121,6 +138,7 @@ extern int		AgentDied;	/* for updating mapdom[] */
 #define	AGENT_DSO	0
 #define AGENT_SOCKET	1
 #define AGENT_PIPE	2
+#define AGENT_SHM	3		/* pipe, plus shared memory ring */
 
 /* Masks for operations used in access controls for clients. */
 #define PMCD_OP_FETCH	0x1
@@ -133,6 +151,7 @@ extern int		AgentDied;	/* for updating mapdom[] */
 #define AT_CONFIG	1
 #define AT_COMM		2
 #define AT_EXIT		3
+#define AT_HANDOVER	4		/* replaced by a new agent */
 
 /*
  * Agent termination reasons for "reason" in AgentInfo, and pmcd.agent.state
@@ -155,6 +174,13 @@ extern int	pmdarootfd;
 /* timeout to PMDAs (secs) */
 PMCD_DATA extern int	pmcd_timeout;
 
+/*
+ * adaptive fetch timeouts, as a multiple of each daemon agent's usual
+ * wait time (0 => off, always wait for pmcd_timeout)
+ */
+PMCD_DATA extern int	pmcd_hedge;
+PMCD_CALL extern double pmcd_agent_timeout(AgentInfo *);
+
 /* timeout for credentials */
 extern int	_creds_timeout;
 
@@ -200,6 +226,32 @@ PMCD_CALL extern void pmcd_trace(int, int, int, int);
 PMCD_CALL extern void pmcd_dump_trace(FILE *);
 extern int pmcd_load_libpcp_pmda(void);
 
+/*
+ * PDU flight recorder - one record for each client request, kept in a
+ * ring of pmcd_flight_nbufs entries (pmdapmcd, pmcd.flight.*)
+ */
+typedef struct {
+    __uint64_t		seq;		/* request number, from 1 */
+    struct timeval	stamp;		/* when servicing started */
+    int			type;		/* request PDU type */
+    unsigned int	client;		/* client sequence number */
+    int			agent;		/* domain of slowest agent, or -1 */
+    int			size;		/* request PDU length, bytes */
+    int			status;		/* zero, or the error returned */
+    unsigned int	queue;		/* wait after pmcd woke, usec */
+    unsigned int	service;	/* time servicing request, usec */
+} FlightRecord;
+
+PMCD_DATA extern int	pmcd_flight_nbufs;
+
+PMCD_CALL extern void pmcd_init_flight(int);
+extern void pmcd_flight_ready(void);
+extern void pmcd_flight_start(void);
+extern void pmcd_flight_agent(int, double);
+extern void pmcd_flight_end(unsigned int, int, int, int);
+PMCD_CALL extern FlightRecord *pmcd_flight_record(int);
+PMCD_CALL extern void pmcd_dump_flight(FILE *);
+
 /*
  * PDU handling routines
  */
@@ -210,6 +262,8 @@ extern int DoDesc(ClientInfo *, __pmPDU *);
 extern int DoDescIDs(ClientInfo *, __pmPDU *);
 extern int DoLabel(ClientInfo *, __pmPDU *);
 extern int DoInstance(ClientInfo *, __pmPDU *);
+extern int GetDescs(ClientInfo *, int, pmID *, pmDesc *);
+extern int GetInstance(ClientInfo *, pmInDom, int, char *, pmInResult **);
 extern int DoText(ClientInfo *, __pmPDU *);
 extern int DoStore(ClientInfo *, __pmPDU *);
 extern int DoCreds(ClientInfo *, __pmPDU *);
@@ -233,6 +287,50 @@ extern void CleanupClient(ClientInfo *, int);
 extern int ClientsAttributes(AgentInfo *);
 extern int AgentsAttributes(int);
 extern int CheckError(AgentInfo *, int);
+extern void HandleLateAgent(AgentInfo *);
+extern void ExpireLateAgents(void);
+
+/*
+ * Sharing of identical PMDA fetches between clients (coalesce.c)
+ */
+extern struct timeval	pmcd_coalesce;	/* window, 0 => never shared */
+
+extern pmResult *FetchCacheLookup(int, int, pmID *, ClientInfo *, int);
+extern pmResult *FetchCacheSave(int, int, pmID *, ClientInfo *, int, struct timeval *, pmResult *);
+extern int FetchCacheHolds(int, pmResult *);
+extern void FetchCacheDrop(AgentInfo *);
+extern void FetchCacheFlush(void);
+
+/*
+ * CPU and memory node affinity of pmcd and agents (affinity.c)
+ */
+extern AffinityInfo	pmcd_affinity;	/* pmcd -C and -M */
+
+extern int ParseAffinityList(const char *, unsigned long *);
+extern int SetAffinity(const AffinityInfo *, pid_t);
+extern int AffinityDiffer(const AffinityInfo *, const AffinityInfo *);
+extern void FreeAffinity(AffinityInfo *);
+
+/*
+ * Descriptors the main loop waits for input on (ioevent.c)
+ */
+#define IOEV_NONE	0
+#define IOEV_REQPORT	1	/* request port, data is address family */
+#define IOEV_CLIENT	2	/* client connection, data is client[] index */
+#define IOEV_AGENT	3	/* not ready agent, data is agent[] index */
+
+typedef struct {
+    int		fd;
+    int		type;		/* IOEV_* */
+    int		data;
+} IOEvent;
+
+extern int IOEventInit(void);
+extern const char *IOEventBackend(void);
+extern int IOEventAdd(int, int, int);
+extern void IOEventDel(int);
+extern IOEvent *IOEventLookup(int);
+extern int IOEventWait(IOEvent **);
 
 /*
  * Highest known file descriptor used for a Client or an Agent connection.
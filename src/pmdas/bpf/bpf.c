@@ -16,6 +16,7 @@
 
 #include <pcp/pmapi.h>
 #include <pcp/pmda.h>
+#include <pcp/pmwebapi.h>
 #include "domain.h"
 #include "modules/module.h"
 #include <sys/stat.h>
@@ -23,6 +24,7 @@
 #include <bpf/libbpf.h>
 #include <bpf/bpf.h>
 #include <dlfcn.h>
+#include <pthread.h>
 #include "bpf.h"
 
 /* see libpcp.h __pmXx_int */
@@ -65,6 +67,14 @@ static pmdaOptions opts = {
 
 dict *pmda_config;
 
+/*
+ * Optional background refresh of all modules, every refresh_interval msec
+ * from the [pmda] section of bpf.conf (daemon only).  Modules are not
+ * thread-safe, so refresh_lock serialises module refresh and fetch calls.
+ */
+static int refresh_interval;
+static pthread_mutex_t refresh_lock = PTHREAD_MUTEX_INITIALIZER;
+
 /*
  * callback provided to pmdaFetch
  */
@@ -383,8 +393,11 @@ bpf_fetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
 {
     module* target;
     int cache_result;
+    int sts;
 
-    for(int i = 0; i < numpmid; i++) {
+    pthread_mutex_lock(&refresh_lock);
+    // with background refresh, modules are already up to date
+    for(int i = 0; i < numpmid && refresh_interval == 0; i++) {
         unsigned int cluster_id = pmID_cluster(pmidlist[i]);
         unsigned int item = pmID_item(pmidlist[i]);
         cache_result = pmdaCacheLookup(clusters, cluster_id, NULL, (void**)&target);
@@ -393,7 +406,65 @@ bpf_fetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
         }
     }
 
-    return pmdaFetch(numpmid, pmidlist, resp, pmda);
+    sts = pmdaFetch(numpmid, pmidlist, resp, pmda);
+    pthread_mutex_unlock(&refresh_lock);
+    return sts;
+}
+
+/**
+ * Background refresh thread, refreshing every active module in turn
+ */
+static void *
+bpf_refresh_thread(void *arg)
+{
+    struct timespec delay;
+    module* target;
+    int cluster_id;
+
+    (void)arg;
+    delay.tv_sec = refresh_interval / 1000;
+    delay.tv_nsec = (refresh_interval % 1000) * 1000000;
+
+    for (;;) {
+        nanosleep(&delay, NULL);
+
+        pthread_mutex_lock(&refresh_lock);
+        pmdaCacheOp(clusters, PMDA_CACHE_WALK_REWIND);
+        while ((cluster_id = pmdaCacheOp(clusters, PMDA_CACHE_WALK_NEXT)) != -1) {
+            if (pmdaCacheLookup(clusters, cluster_id, NULL, (void**)&target) == PMDA_CACHE_ACTIVE)
+                target->refresh(0);
+        }
+        pthread_mutex_unlock(&refresh_lock);
+    }
+    return NULL;
+}
+
+static void
+bpf_start_refresh(dict *cfg)
+{
+    pthread_t thread;
+    sds value;
+    int sts;
+
+    if (cfg == NULL || (value = pmIniFileLookup(cfg, "pmda", "refresh_interval")) == NULL)
+        return;
+    if ((refresh_interval = atoi(value)) <= 0) {
+        refresh_interval = 0;
+        return;
+    }
+    if (isDSO) {
+        pmNotifyErr(LOG_INFO, "background refresh not supported in DSO mode");
+        refresh_interval = 0;
+        return;
+    }
+
+    if ((sts = pthread_create(&thread, NULL, bpf_refresh_thread, NULL)) != 0) {
+        pmNotifyErr(LOG_ERR, "cannot start refresh thread: %s", pmErrStr(-sts));
+        refresh_interval = 0;
+        return;
+    }
+    pthread_detach(thread);
+    pmNotifyErr(LOG_INFO, "refreshing modules every %d msec", refresh_interval);
 }
 
 void
@@ -572,6 +643,8 @@ bpf_init(pmdaInterface *dp)
     pmNotifyErr(LOG_INFO, "setting up namespace");
     bpf_setup_pmns();
 
+    bpf_start_refresh(pmda_config);
+
     pmNotifyErr(LOG_INFO, "bpf pmda init complete");
 }
 
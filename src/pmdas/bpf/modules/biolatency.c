@@ -1,4 +1,5 @@
 #include "module.h"
+#include "histogram.h"
 #include <bpf/libbpf.h>
 #include <bpf/bpf.h>
 #include <pcp/pmda.h>
@@ -9,6 +10,7 @@ pmdaInstid biolatency_instances[NUM_LATENCY_SLOTS];
 
 struct biolatency_bpf *bpf_obj;
 int biolatency_fd = -1;
+histogram biolatency_hist;
 #define INDOM_COUNT 1
 #define BIOLATENCY_INDOM 0
 unsigned int indom_id_mapping[INDOM_COUNT];
@@ -110,6 +112,12 @@ int biolatency_init(dict *cfg, char *module_name)
         return biolatency_fd;
     }
 
+    ret = histogram_init(&biolatency_hist, biolatency_fd, NUM_LATENCY_SLOTS);
+    if (ret != 0) {
+        pmNotifyErr(LOG_ERR, "histogram setup failed: %s", pmErrStr(ret));
+        return ret;
+    }
+
     fill_instids_log2(NUM_LATENCY_SLOTS, biolatency_instances);
 
     return 0;
@@ -117,6 +125,7 @@ int biolatency_init(dict *cfg, char *module_name)
 
 void biolatency_shutdown()
 {
+    histogram_free(&biolatency_hist);
     if (biolatency_fd != 0) {
         close(biolatency_fd);
         biolatency_fd = -1;
@@ -128,7 +137,8 @@ void biolatency_shutdown()
 
 void biolatency_refresh(unsigned int item)
 {
-    /* do nothing */
+    if (biolatency_fd != -1)
+        histogram_refresh(&biolatency_hist);
 }
 
 int biolatency_fetch_to_atom(unsigned int item, unsigned int inst, pmAtomValue *atom)
@@ -142,15 +152,7 @@ int biolatency_fetch_to_atom(unsigned int item, unsigned int inst, pmAtomValue *
         return PMDA_FETCH_NOVALUES;
     }
 
-    unsigned long key = inst;
-    unsigned long value = 0;
-    int ret = bpf_map_lookup_elem(biolatency_fd, &key, &value);
-    if (ret == -1) {
-        return PMDA_FETCH_NOVALUES;
-    }
-
-    atom->ull = value;
-    return PMDA_FETCH_STATIC;
+    return histogram_fetch(&biolatency_hist, inst, atom);
 }
 
 struct module bpf_module = {
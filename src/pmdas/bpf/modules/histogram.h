@@ -0,0 +1,166 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <errno.h>
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+
+/* entries requested per BPF_MAP_LOOKUP_BATCH call */
+#define HISTOGRAM_BATCH 256
+
+/**
+ * Userspace snapshot of a BPF histogram map.
+ *
+ * A histogram map holds one u64 count per u64 slot key; per-CPU maps hold
+ * a count for each possible CPU, which are summed.  The entire map is read
+ * once per refresh, with BPF_MAP_LOOKUP_BATCH where the kernel supports it
+ * (5.6+) and by key iteration otherwise, so fetching each instance is then
+ * a lookup in the snapshot rather than a bpf(2) system call.
+ */
+typedef struct histogram {
+    int fd;
+    int ncpus;              /* possible CPUs for per-CPU maps, else 1 */
+    int batch;              /* BPF_MAP_LOOKUP_BATCH is usable */
+    unsigned int nslots;
+    __u64 *counts;          /* snapshot, indexed by slot */
+    unsigned char *present; /* slot was found in the map */
+    __u64 *keys;            /* HISTOGRAM_BATCH keys */
+    __u64 *values;          /* HISTOGRAM_BATCH x ncpus values */
+} histogram;
+
+void histogram_free(histogram *hist)
+{
+    free(hist->counts);
+    free(hist->present);
+    free(hist->keys);
+    free(hist->values);
+    memset(hist, 0, sizeof(*hist));
+    hist->fd = -1;
+}
+
+/**
+ * Set up a snapshot of the first nslots slots of the histogram map fd.
+ *
+ * @return 0 on success, or a negative errno.
+ */
+int histogram_init(histogram *hist, int fd, unsigned int nslots)
+{
+    struct bpf_map_info info;
+    __u32 length = sizeof(info);
+    int ncpus = 1;
+
+    memset(hist, 0, sizeof(*hist));
+    hist->fd = -1;
+
+    memset(&info, 0, sizeof(info));
+    if (bpf_obj_get_info_by_fd(fd, &info, &length) != 0)
+        return -errno;
+    if (info.key_size != sizeof(__u64) || info.value_size != sizeof(__u64))
+        return -EINVAL;
+    if (info.type == BPF_MAP_TYPE_PERCPU_HASH ||
+        info.type == BPF_MAP_TYPE_PERCPU_ARRAY) {
+        if ((ncpus = libbpf_num_possible_cpus()) <= 0)
+            return ncpus < 0 ? ncpus : -EINVAL;
+    }
+
+    hist->counts = calloc(nslots, sizeof(__u64));
+    hist->present = calloc(nslots, sizeof(unsigned char));
+    hist->keys = calloc(HISTOGRAM_BATCH, sizeof(__u64));
+    hist->values = calloc(HISTOGRAM_BATCH * ncpus, sizeof(__u64));
+    if (!hist->counts || !hist->present || !hist->keys || !hist->values) {
+        histogram_free(hist);
+        return -ENOMEM;
+    }
+    hist->fd = fd;
+    hist->ncpus = ncpus;
+    hist->nslots = nslots;
+    hist->batch = 1;
+    return 0;
+}
+
+static void histogram_add(histogram *hist, __u64 slot, const __u64 *values)
+{
+    __u64 total = 0;
+    int cpu;
+
+    if (slot >= hist->nslots)
+        return;
+    for (cpu = 0; cpu < hist->ncpus; cpu++)
+        total += values[cpu];
+    hist->counts[slot] = total;
+    hist->present[slot] = 1;
+}
+
+static int histogram_read_batch(histogram *hist)
+{
+    __u64 in = 0, out = 0;
+    __u32 count, i;
+    int sts, first = 1;
+
+    do {
+        count = HISTOGRAM_BATCH;
+        sts = bpf_map_lookup_batch(hist->fd, first ? NULL : &in, &out,
+                                   hist->keys, hist->values, &count, NULL);
+        if (sts != 0 && errno != ENOENT)
+            return -errno;
+        for (i = 0; i < count; i++)
+            histogram_add(hist, hist->keys[i], &hist->values[i * hist->ncpus]);
+        in = out;
+        first = 0;
+    } while (sts == 0);
+
+    return 0;
+}
+
+static int histogram_read_iterate(histogram *hist)
+{
+    __u64 key, next, *prev = NULL;
+
+    while (bpf_map_get_next_key(hist->fd, prev, &next) == 0) {
+        if (bpf_map_lookup_elem(hist->fd, &next, hist->values) == 0)
+            histogram_add(hist, next, hist->values);
+        key = next;
+        prev = &key;
+    }
+    return 0;
+}
+
+/**
+ * Refresh the snapshot from the map.
+ *
+ * @return 0 on success, or a negative errno.
+ */
+int histogram_refresh(histogram *hist)
+{
+    int sts;
+
+    if (hist->fd < 0)
+        return -EBADF;
+
+    memset(hist->present, 0, hist->nslots * sizeof(unsigned char));
+    if (hist->batch) {
+        if ((sts = histogram_read_batch(hist)) == 0)
+            return 0;
+        /* assume batch operations are not supported by this kernel */
+        pmNotifyErr(LOG_INFO, "histogram batch lookup failed (%s), iterating",
+                    pmErrStr(sts));
+        hist->batch = 0;
+        memset(hist->present, 0, hist->nslots * sizeof(unsigned char));
+    }
+    return histogram_read_iterate(hist);
+}
+
+/**
+ * Fetch a slot count from the last refresh.
+ *
+ * @return PMDA_FETCH_STATIC, or PMDA_FETCH_NOVALUES if the slot is not in the map.
+ */
+int histogram_fetch(histogram *hist, unsigned int slot, pmAtomValue *atom)
+{
+    if (slot >= hist->nslots || !hist->present[slot])
+        return PMDA_FETCH_NOVALUES;
+    atom->ull = hist->counts[slot];
+    return PMDA_FETCH_STATIC;
+}
+
+#endif
@@ -1,4 +1,5 @@
 #include "module.h"
+#include "histogram.h"
 #include <bpf/libbpf.h>
 #include <bpf/bpf.h>
 #include <pcp/pmda.h>
@@ -9,6 +10,7 @@ pmdaInstid runqlat_instances[NUM_LATENCY_SLOTS];
 
 struct runqlat_bpf *bpf_obj;
 int runqlat_fd = -1;
+histogram runqlat_hist;
 #define INDOM_COUNT 1
 #define RUNQLAT_INDOM 0
 unsigned int indom_id_mapping[INDOM_COUNT];
@@ -110,6 +112,12 @@ int runqlat_init(dict *cfg, char *module_name)
         return runqlat_fd;
     }
 
+    ret = histogram_init(&runqlat_hist, runqlat_fd, NUM_LATENCY_SLOTS);
+    if (ret != 0) {
+        pmNotifyErr(LOG_ERR, "histogram setup failed: %s", pmErrStr(ret));
+        return ret;
+    }
+
     fill_instids_log2(NUM_LATENCY_SLOTS, runqlat_instances);
 
     return 0;
@@ -117,6 +125,7 @@ int runqlat_init(dict *cfg, char *module_name)
 
 void runqlat_shutdown()
 {
+    histogram_free(&runqlat_hist);
     if (runqlat_fd != 0) {
         close(runqlat_fd);
         runqlat_fd = -1;
@@ -128,7 +137,8 @@ void runqlat_shutdown()
 
 void runqlat_refresh(unsigned int item)
 {
-    /* do nothing */
+    if (runqlat_fd != -1)
+        histogram_refresh(&runqlat_hist);
 }
 
 int runqlat_fetch_to_atom(unsigned int item, unsigned int inst, pmAtomValue *atom)
@@ -142,15 +152,7 @@ int runqlat_fetch_to_atom(unsigned int item, unsigned int inst, pmAtomValue *ato
         return PMDA_FETCH_NOVALUES;
     }
 
-    unsigned long key = inst;
-    unsigned long value = 0;
-    int ret = bpf_map_lookup_elem(runqlat_fd, &key, &value);
-    if (ret == -1) {
-        return PMDA_FETCH_NOVALUES;
-    }
-
-    atom->ull = value;
-    return PMDA_FETCH_STATIC;
+    return histogram_fetch(&runqlat_hist, inst, atom);
 }
 
 struct module bpf_module = {
@@ -60,6 +60,7 @@ class Script:
         self.script_id = 's' + str(uuid.uuid4()).replace('-', '')
         self.username: Optional[str] = None
         self.persistent = False
+        self.autostart = False
         self.created_at = datetime.now()
         self.last_accessed_at = datetime.now()
         self.code = code
@@ -117,6 +118,7 @@ class PMDAConfig:
         self.bpftrace_path = 'bpftrace'
         self.script_expiry_time = 60  # 1 min
         self.max_throughput = 2 * 1024 * 1024  # 2 MB/s
+        self.multiplex_autostart = False
 
 
 class RuntimeInfo:
@@ -1,4 +1,4 @@
-from typing import Dict
+from typing import Dict, List
 import re
 import json
 from cpmapi import PM_SEM_INSTANT, PM_SEM_COUNTER, PM_TYPE_U64, PM_TYPE_STRING
@@ -100,6 +100,76 @@ def table_retain_lines(script: Script):
         script.state.data['@output'] = output[:newlines[0]] + output[start_content_at:]
 
 
+def is_shareable(script: Script) -> bool:
+    """check if a parsed script can share a bpftrace process with other scripts"""
+    if script.metadata.custom_output_block or '@output' in script.variables:
+        return False
+    # scripts which print, exit or have run-once probes must run on their own, and
+    # definitions could clash with the ones of other scripts
+    if re.search(r'\b(printf|time|cat|system|exit)\s*\(', script.code):
+        return False
+    if re.search(r'\b(BEGIN|END)\b|\bstruct\s+\w+\s*\{|\bconfig\s*=|^\s*(fn|macro)\s', script.code,
+                 re.MULTILINE):
+        return False
+    # variable names which are already in the format of shared variables
+    return not any(re.match(r'^@_\d+_', var) for var in script.variables)
+
+
+def prefix_variables(code: str, prefix: str) -> str:
+    """rename all @variables to @<prefix>variables, ignoring strings and comments"""
+    tokens = re.finditer(r'"(?:\\.|[^"\\])*"|//[^\n]*|/\*.*?\*/|@(\w*)', code, re.DOTALL)
+    parts = []
+    pos = 0
+    for token in tokens:
+        if token.group(0).startswith('@'):
+            parts.append(code[pos:token.start()])
+            parts.append(f"@{prefix}{token.group(1)}")
+            pos = token.end()
+    parts.append(code[pos:])
+    return ''.join(parts)
+
+
+def merge_scripts(members: Dict[str, Script]) -> str:
+    """merge scripts into the code of a single bpftrace process, keyed by variable prefix"""
+    preamble: List[str] = []
+    bodies = []
+    print_stmts = []
+    for prefix, script in members.items():
+        body = []
+        for line in script.code.splitlines():
+            if line.startswith('#!'):
+                continue
+            if line.startswith('#'):
+                # preprocessor directives must precede all probes
+                if line not in preamble:
+                    preamble.append(line)
+                continue
+            body.append(line)
+        bodies.append(prefix_variables('\n'.join(body), prefix))
+        print_stmts.extend([f"print(@{prefix}{var_name[1:]});" for var_name in script.variables])
+    return '\n'.join(preamble + bodies) + f"\ninterval:s:1 {{ {' '.join(print_stmts)} }}"
+
+
+def process_shared_output(runtime_info: RuntimeInfo, members: Dict[str, Script], line: str):
+    """process a line of output from a shared bpftrace process, routing data to its scripts"""
+    if runtime_info.bpftrace_version <= (0, 9, 2) and '": }' in line:
+        return
+
+    if not line or line.isspace():
+        return
+
+    obj = json.loads(line)
+    if obj['type'] in [BPFtraceMessageType.Map, BPFtraceMessageType.Hist]:
+        for var_name, value in obj['data'].items():
+            match = re.match(r'^@(_\d+_)(.*)$', var_name)
+            if match and match.group(1) in members:
+                process_bpftrace_output_obj(runtime_info, members[match.group(1)],
+                                            {'type': obj['type'], 'data': {f"@{match.group(2)}": value}})
+    else:
+        for script in members.values():
+            process_bpftrace_output_obj(runtime_info, script, obj)
+
+
 def process_bpftrace_output_obj(runtime_info: RuntimeInfo, script: Script, obj: Dict):
     """process a single JSON object from bpftrace output"""
     if obj['type'] == BPFtraceMessageType.AttachedProbes:
@@ -112,6 +112,8 @@ class BPFtracePMDA(PMDA):
                 config.script_expiry_time = configreader.getint('bpftrace', 'script_expiry_time')
             if 'max_throughput' in configreader['bpftrace']:
                 config.max_throughput = configreader.getint('bpftrace', 'max_throughput')
+            if 'multiplex_autostart' in configreader['bpftrace']:
+                config.multiplex_autostart = configreader.getboolean('bpftrace', 'multiplex_autostart')
 
         if 'dynamic_scripts' in configreader:
             if 'enabled' in configreader['dynamic_scripts']:
@@ -291,6 +293,7 @@ class BPFtracePMDA(PMDA):
             script = Script(code)
             script.username = pwd.getpwuid(os.getuid()).pw_name
             script.metadata.name = Path(script_path).stem
+            script.autostart = True
             self.register_script(script, update_ctx=False)
 
     def register_autostart_scripts(self):
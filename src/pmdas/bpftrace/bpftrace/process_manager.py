@@ -1,6 +1,6 @@
 # pylint doesn't recognize subprocess module of asyncio, see https://github.com/PyCQA/pylint/issues/1469
 # pylint: disable=no-member
-from typing import Optional, Dict
+from typing import Optional, Dict, List, Callable
 import signal
 import multiprocessing
 import asyncio
@@ -8,7 +8,7 @@ import traceback
 import time
 from datetime import datetime, timedelta
 from .models import PMDAConfig, RuntimeInfo, Script, Status, Logger, MetricType, BPFtraceError
-from .parser import parse_code, process_bpftrace_output
+from .parser import parse_code, process_bpftrace_output, is_shareable, merge_scripts, process_shared_output
 from .utils import asyncio_get_all_tasks
 
 
@@ -18,6 +18,22 @@ class ScriptTasks:
         self.process: Optional[asyncio.subprocess.Process] = None
         self.run_bpftrace_task: Optional[asyncio.Task] = None
         self.lock = asyncio.Lock()
+        self.group: Optional[SharedGroup] = None
+
+
+class SharedGroup:
+    """scripts sharing a single bpftrace process, keyed by their variable prefix"""
+
+    def __init__(self, members: Dict[str, Script]):
+        self.members = members
+        self.process: Optional[asyncio.subprocess.Process] = None
+        self.run_bpftrace_task: Optional[asyncio.Task] = None
+        self.error = ''
+        self.stopping = False
+
+    def __str__(self) -> str:
+        return f"shared process (PID={self.process.pid if self.process else -1}, " \
+               f"{len(self.members)} scripts)"
 
 
 class ProcessManager():
@@ -32,70 +48,98 @@ class ProcessManager():
         self.scripts: Dict[str, Script] = {}
         self.script_tasks: Dict[str, ScriptTasks] = {}
         self.running = True
+        # autostart scripts waiting to be launched in a shared process
+        self.shared_pending: List[Script] = []
 
     def handle_exception(self, loop, context):
         self.logger.error(f"exception in event loop: {context}")
 
-    async def read_bpftrace_stdout(self, script: Script, script_tasks: ScriptTasks):
+    async def read_bpftrace_stdout(self, process: asyncio.subprocess.Process, max_throughput: int,
+                                   process_line: Callable[[bytes], None]):
+        data_bytes = 0
         data_bytes_last_value = 0
         data_bytes_time = time.time()
         measure_throughput_every = 5  # seconds
 
         try:
-            async for line in script_tasks.process.stdout:
-                script.state.data_bytes += len(line)
+            async for line in process.stdout:
+                data_bytes += len(line)
                 now = time.time()
                 if now >= data_bytes_time + measure_throughput_every:
-                    throughput = (script.state.data_bytes - data_bytes_last_value) / (now - data_bytes_time)
-                    if throughput > self.config.max_throughput:
+                    throughput = (data_bytes - data_bytes_last_value) / (now - data_bytes_time)
+                    if throughput > max_throughput:
                         raise BPFtraceError(f"BPFtrace output exceeds limit of "
-                                            f"{self.config.max_throughput} bytes per second")
-                    data_bytes_last_value = script.state.data_bytes
+                                            f"{max_throughput} bytes per second")
+                    data_bytes_last_value = data_bytes
                     data_bytes_time = time.time()
 
-                line = line.decode('utf-8')
-                try:
-                    process_bpftrace_output(self.runtime_info, script, line)
-                except Exception:  # pylint: disable=broad-except
-                    self.logger.error(f"Error parsing bpftrace output, please open a bug report:\n"
-                                      f"While reading:\n"
-                                      f"{repr(line)}\n"
-                                      f"the following error occured:\n"
-                                      f"{traceback.format_exc()}")
+                process_line(line)
         except ValueError:
             # thrown if the output exceeds 'limit' (argument passed to create_subprocess_exec)
             raise BPFtraceError(
-                f"BPFtrace output exceeds limit of {self.config.max_throughput}"
+                f"BPFtrace output exceeds limit of {max_throughput}"
                 f" bytes per second") from None
 
-    async def read_bpftrace_stderr(self, script: Script, script_tasks: ScriptTasks):
-        async for line in script_tasks.process.stderr:
+    def process_script_line(self, script: Script, line: bytes):
+        script.state.data_bytes += len(line)
+        line = line.decode('utf-8')
+        try:
+            process_bpftrace_output(self.runtime_info, script, line)
+        except Exception:  # pylint: disable=broad-except
+            self.logger.error(f"Error parsing bpftrace output, please open a bug report:\n"
+                              f"While reading:\n"
+                              f"{repr(line)}\n"
+                              f"the following error occured:\n"
+                              f"{traceback.format_exc()}")
+
+    def process_shared_line(self, group: SharedGroup, line: bytes):
+        # the output is not attributable per script, report bytes of the shared process
+        for script in group.members.values():
+            script.state.data_bytes += len(line)
+        line = line.decode('utf-8')
+        try:
+            process_shared_output(self.runtime_info, group.members, line)
+        except Exception:  # pylint: disable=broad-except
+            self.logger.error(f"Error parsing bpftrace output, please open a bug report:\n"
+                              f"While reading:\n"
+                              f"{repr(line)}\n"
+                              f"the following error occured:\n"
+                              f"{traceback.format_exc()}")
+
+    async def read_bpftrace_stderr(self, process: asyncio.subprocess.Process, scripts: List[Script]):
+        async for line in process.stderr:
             line = line.decode('utf-8')
-            script.state.error += line
+            for script in scripts:
+                script.state.error += line
 
-    async def stop_bpftrace_process(self, script: Script, script_tasks: ScriptTasks):
-        """stops a running bpftrace process. *does not wait for run_bpftrace task to finish*"""
-        self.logger.info(f"script: stopping {script}...")
-        process = script_tasks.process
-        script.state.status = Status.Stopping
+    async def terminate_process(self, process: asyncio.subprocess.Process, name: str):
         process.send_signal(signal.SIGINT)
 
         # wait max. 5s for graceful termination of the bpftrace process
-        _done, pending = await asyncio.wait({process.wait()}, timeout=5)
+        _done, pending = await asyncio.wait({asyncio.ensure_future(process.wait())}, timeout=5)
         if pending:
-            self.logger.info(f"stop: {script} is still running, sending SIGKILL...")
+            self.logger.info(f"stop: {name} is still running, sending SIGKILL...")
             process.kill()
 
             # wait again max. 5s until bpftrace process is terminated
-            _done, pending = await asyncio.wait({process.wait()}, timeout=5)
+            _done, pending = await asyncio.wait({asyncio.ensure_future(process.wait())}, timeout=5)
             if pending:
-                self.logger.info(f"stop: {script} is still running after sending SIGKILL...")
+                self.logger.info(f"stop: {name} is still running after sending SIGKILL...")
+
+    async def stop_bpftrace_process(self, script: Script, script_tasks: ScriptTasks):
+        """stops a running bpftrace process. *does not wait for run_bpftrace task to finish*"""
+        self.logger.info(f"script: stopping {script}...")
+        script.state.status = Status.Stopping
+        await self.terminate_process(script_tasks.process, str(script))
 
         # stopping state change in run_bpftrace task (script can also stop itself, without getting SIGINT)
         # do not await for run_bpftace task here, as run_bpftrace is awaiting for this task in case of an exception
 
     async def stop_bpftrace(self, script: Script, script_tasks: ScriptTasks):
         """stops a running bpftrace *and* waits for run_bpftrace task to finish"""
+        if script_tasks.group:
+            await self.leave_shared_group(script, script_tasks)
+            return
         await self.stop_bpftrace_process(script, script_tasks)
         await script_tasks.run_bpftrace_task
 
@@ -104,8 +148,9 @@ class ProcessManager():
         process = script_tasks.process
         try:
             await asyncio.gather(
-                self.read_bpftrace_stdout(script, script_tasks),
-                self.read_bpftrace_stderr(script, script_tasks)
+                self.read_bpftrace_stdout(process, self.config.max_throughput,
+                                          lambda line: self.process_script_line(script, line)),
+                self.read_bpftrace_stderr(process, [script])
             )
         except BPFtraceError as e:
             await self.stop_bpftrace_process(script, script_tasks)
@@ -121,6 +166,26 @@ class ProcessManager():
         else:
             self.logger.info(f"script: stopped {script}")
 
+    async def spawn_bpftrace(self, code: str, limit: int) -> asyncio.subprocess.Process:
+        # support for reading scripts on stdin arrived in bpftrace v0.11.0
+        if self.runtime_info.bpftrace_version >= (0, 11, 0):
+            # read scripts from stdin to not clobber ps(1) output
+            process = await asyncio.subprocess.create_subprocess_exec(
+                self.config.bpftrace_path, '-f', 'json', '-',
+                limit=limit, stdin=asyncio.subprocess.PIPE,
+                stdout=asyncio.subprocess.PIPE, stderr=asyncio.subprocess.PIPE
+            )
+            process.stdin.write(code.encode('utf-8'))
+            await process.stdin.drain()
+            process.stdin.close()
+        else:
+            process = await asyncio.subprocess.create_subprocess_exec(
+                self.config.bpftrace_path, '-f', 'json', '-e', code,
+                limit=limit, stdout=asyncio.subprocess.PIPE,
+                stderr=asyncio.subprocess.PIPE
+            )
+        return process
+
     async def start_bpftrace(self, script: Script, script_tasks: ScriptTasks):
         """starts a bpftrace process. *does not wait until it is finished*"""
         self.logger.info(f"script: starting {script}...")
@@ -135,26 +200,10 @@ class ProcessManager():
             code = script.code + f"\ninterval:s:1 {{ {print_stmts} }}"
 
         try:
-            # support for reading scripts on stdin arrived in bpftrace v0.11.0
-            if self.runtime_info.bpftrace_version >= (0, 11, 0):
-                # read scripts from stdin to not clobber ps(1) output
-                script_tasks.process = await asyncio.subprocess.create_subprocess_exec(
-                    self.config.bpftrace_path, '-f', 'json', '-',
-                    limit=self.config.max_throughput, stdin=asyncio.subprocess.PIPE,
-                    stdout=asyncio.subprocess.PIPE, stderr=asyncio.subprocess.PIPE
-                )
-                script_tasks.process.stdin.write(code.encode('utf-8'))
-                await script_tasks.process.stdin.drain()
-                script_tasks.process.stdin.close()
-            else:
-                script_tasks.process = await asyncio.subprocess.create_subprocess_exec(
-                    self.config.bpftrace_path, '-f', 'json', '-e', code,
-                    limit=self.config.max_throughput, stdout=asyncio.subprocess.PIPE,
-                    stderr=asyncio.subprocess.PIPE
-                )
+            script_tasks.process = await self.spawn_bpftrace(code, self.config.max_throughput)
         except OSError as e:
             script.state.error = str(e)
-            script.state.exit_code = script_tasks.process.returncode if script_tasks.process else 1
+            script.state.exit_code = 1
             script.state.status = Status.Error
             self.logger.info(f"script: failed to start {script} due to error: {script.state.error.rstrip()}")
         else:
@@ -163,6 +212,111 @@ class ProcessManager():
             script_tasks.run_bpftrace_task = asyncio.ensure_future(self.run_bpftrace(script, script_tasks))
             self.logger.info(f"script: started {script}")
 
+    def queue_shared(self, script: Script):
+        """autostart scripts registered within a second of each other share a process"""
+        self.shared_pending.append(script)
+        if len(self.shared_pending) == 1:
+            self.loop.call_later(1, self.launch_shared_pending)
+
+    def launch_shared_pending(self):
+        # scripts could have been deleted while waiting
+        scripts = [script for script in self.shared_pending if script.script_id in self.scripts]
+        self.shared_pending = []
+        self.launch_shared(scripts)
+
+    def launch_shared(self, scripts: List[Script]):
+        if len(scripts) == 1:
+            asyncio.ensure_future(self.start_bpftrace(scripts[0], self.script_tasks[scripts[0].script_id]))
+        elif scripts:
+            group = SharedGroup({f"_{i}_": script for i, script in enumerate(scripts)})
+            for script in scripts:
+                self.script_tasks[script.script_id].group = group
+            asyncio.ensure_future(self.start_shared_bpftrace(group))
+
+    async def start_shared_bpftrace(self, group: SharedGroup):
+        """starts a shared bpftrace process. *does not wait until it is finished*"""
+        scripts = list(group.members.values())
+        self.logger.info(f"script: starting {', '.join(str(script) for script in scripts)} "
+                         f"in a shared process...")
+        for script in scripts:
+            script.state.reset()
+            script.state.status = Status.Starting
+
+        try:
+            group.process = await self.spawn_bpftrace(merge_scripts(group.members),
+                                                      self.config.max_throughput * len(scripts))
+        except OSError as e:
+            for script in scripts:
+                self.script_tasks[script.script_id].group = None
+                script.state.error = str(e)
+                script.state.exit_code = 1
+                script.state.status = Status.Error
+            self.logger.info(f"script: failed to start {group} due to error: {e}")
+            return
+
+        for script in scripts:
+            self.script_tasks[script.script_id].process = group.process
+            script.state.status = Status.Started
+            script.state.pid = group.process.pid
+        group.run_bpftrace_task = asyncio.ensure_future(self.run_shared_bpftrace(group))
+        self.logger.info(f"script: started {group}")
+
+    async def run_shared_bpftrace(self, group: SharedGroup):
+        """runs a shared bpftrace process until it exits or encounters an error"""
+        process = group.process
+        try:
+            await asyncio.gather(
+                self.read_bpftrace_stdout(process, self.config.max_throughput * len(group.members),
+                                          lambda line: self.process_shared_line(group, line)),
+                self.read_bpftrace_stderr(process, list(group.members.values()))
+            )
+        except BPFtraceError as e:
+            await self.terminate_process(process, str(group))
+            group.error = str(e)
+            exit_code = process.returncode
+        else:
+            exit_code = await process.wait()
+
+        # members which left the group have been removed already
+        scripts = list(group.members.values())
+        attached = any(script.state.probes for script in scripts)
+        for script in scripts:
+            self.script_tasks[script.script_id].group = None
+            script.state.exit_code = exit_code
+            if group.error:
+                script.state.error = group.error
+            script.state.status = Status.Stopped if exit_code == 0 and not group.error else Status.Error
+
+        if scripts and scripts[0].state.status == Status.Error:
+            self.logger.info(f"script: stopped {group} due to error: {scripts[0].state.error.rstrip()}")
+            if not attached and not group.stopping and len(scripts) > 1 and self.running:
+                # the merged script failed, e.g. due to conflicting definitions
+                self.logger.info("script: restarting scripts of the shared process separately")
+                for script in scripts:
+                    asyncio.ensure_future(self.start_bpftrace(script, self.script_tasks[script.script_id]))
+        else:
+            self.logger.info(f"script: stopped {group}")
+
+    async def leave_shared_group(self, script: Script, script_tasks: ScriptTasks):
+        """stops a script in a shared process, and restarts the remaining scripts without it"""
+        group = script_tasks.group
+        self.logger.info(f"script: stopping {script}...")
+        script.state.status = Status.Stopping
+        for prefix, member in list(group.members.items()):
+            if member is script:
+                del group.members[prefix]
+        script_tasks.group = None
+
+        group.stopping = True
+        await self.terminate_process(group.process, str(group))
+        await group.run_bpftrace_task
+        script.state.exit_code = 0
+        script.state.status = Status.Stopped
+        self.logger.info(f"script: stopped {script}")
+
+        if self.running and group.members:
+            self.launch_shared(list(group.members.values()))
+
     def register(self, script: Script):
         try:
             script = parse_code(script)
@@ -185,7 +339,10 @@ class ProcessManager():
         script_tasks = ScriptTasks()
         self.scripts[script.script_id] = script
         self.script_tasks[script.script_id] = script_tasks
-        asyncio.ensure_future(self.start_bpftrace(script, script_tasks))
+        if self.config.multiplex_autostart and script.autostart and is_shareable(script):
+            self.queue_shared(script)
+        else:
+            asyncio.ensure_future(self.start_bpftrace(script, script_tasks))
         self.pipe.send(script)
 
     async def start(self, script_id: str):
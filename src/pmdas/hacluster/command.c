@@ -0,0 +1,255 @@
+/*
+ * HA Cluster command output caching.
+ *
+ * Copyright (c) 2026 Red Hat.
+ * 
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include <pthread.h>
+
+#include "pmapi.h"
+#include "libpcp.h"
+#include "pmda.h"
+
+#include "command.h"
+
+/*
+ * The cluster tools (crm_mon, cibadmin, corosync-quorumtool and so on)
+ * can take seconds to run on a busy cluster, and each one is read by
+ * several refresh routines, once per instance in some cases.  So the
+ * output of each distinct command line is captured once and handed
+ * out from memory to every reader.
+ *
+ * As a DSO, captured output is reused until the next fetch (or
+ * instance) request starts.  As a daemon, the first request for a
+ * command runs it in-line, and from then on a background thread
+ * re-runs every known command each interval seconds, so requests
+ * are answered from the most recent output without waiting on any
+ * of these tools.
+ */
+struct command {
+	char		*command;	/* command line, including redirection */
+	char		*output;	/* captured output, NULL until first run */
+	size_t		length;
+	int		sts;		/* popen failure code, or zero */
+	unsigned int	generation;	/* fetch that captured the output */
+};
+
+static struct command	*commands;
+static int		ncommands;
+static unsigned int	generation;
+static int		interval;	/* seconds, zero if not threaded */
+static pthread_mutex_t	command_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int
+command_run(const char *command, char **output, size_t *length)
+{
+	FILE		*pf;
+	char		*buffer = NULL, *p;
+	size_t		size = 0, bytes = 0, n;
+
+	if ((pf = popen(command, "r")) == NULL)
+		return -oserror();
+	do {
+		if (bytes == size) {
+			size = size ? size * 2 : 8192;
+			if ((p = realloc(buffer, size)) == NULL) {
+				free(buffer);
+				pclose(pf);
+				return -ENOMEM;
+			}
+			buffer = p;
+		}
+		n = fread(buffer + bytes, 1, size - bytes, pf);
+		bytes += n;
+	} while (n > 0);
+	pclose(pf);
+
+	*output = buffer;
+	*length = bytes;
+	return 0;
+}
+
+static void *
+command_thread(void *arg)
+{
+	char		*command, *output, *old;
+	size_t		length;
+	int		i, count, sts;
+
+	(void)arg;
+	for (;;) {
+		sleep(interval);
+
+		pthread_mutex_lock(&command_lock);
+		count = ncommands;
+		pthread_mutex_unlock(&command_lock);
+
+		for (i = 0; i < count; i++) {
+			/* entries are only appended, so this string is stable */
+			pthread_mutex_lock(&command_lock);
+			command = commands[i].command;
+			pthread_mutex_unlock(&command_lock);
+
+			output = NULL;
+			length = 0;
+			sts = command_run(command, &output, &length);
+
+			pthread_mutex_lock(&command_lock);
+			old = commands[i].output;
+			commands[i].output = output;
+			commands[i].length = length;
+			commands[i].sts = sts;
+			pthread_mutex_unlock(&command_lock);
+			free(old);
+		}
+		if (pmDebugOptions.appl0)
+			pmNotifyErr(LOG_DEBUG, "refreshed %d commands", count);
+	}
+	return NULL;
+}
+
+/*
+ * Called once at startup, with a non-zero interval (seconds) when
+ * running as a daemon, which starts the background refresh.
+ */
+void
+hacluster_command_setup(int seconds)
+{
+	pthread_t	thread;
+	int		sts;
+
+	if (seconds <= 0)
+		return;
+	interval = seconds;
+	if ((sts = pthread_create(&thread, NULL, command_thread, NULL)) != 0) {
+		pmNotifyErr(LOG_ERR, "cannot start command refresh thread: %s",
+				pmErrStr(-sts));
+		interval = 0;	/* fall back to running commands per-fetch */
+		return;
+	}
+	pthread_detach(thread);
+}
+
+/*
+ * Start of a new fetch or instance request, any output captured for
+ * an earlier request is stale (unless the refresh thread is active).
+ */
+void
+hacluster_command_refresh(void)
+{
+	generation++;
+}
+
+static struct command *
+command_lookup(const char *command)
+{
+	int		i;
+
+	for (i = 0; i < ncommands; i++) {
+		if (strcmp(commands[i].command, command) == 0)
+			return &commands[i];
+	}
+	return NULL;
+}
+
+static struct command *
+command_add(const char *command)
+{
+	struct command	*cp;
+	char		*name;
+	size_t		size = (ncommands + 1) * sizeof(struct command);
+
+	if ((name = strdup(command)) == NULL)
+		return NULL;
+	if ((cp = realloc(commands, size)) == NULL) {
+		free(name);
+		return NULL;
+	}
+	commands = cp;
+	cp = &commands[ncommands];
+	memset(cp, 0, sizeof(*cp));
+	cp->command = name;
+	ncommands++;
+	return cp;
+}
+
+/*
+ * Replacement for popen(3) returning the (possibly cached) output of
+ * the given command as a memory stream, close with hacluster_pclose().
+ */
+FILE *
+hacluster_popen(const char *command)
+{
+	struct command	*cp;
+	FILE		*fp;
+	char		*output = NULL;
+	size_t		length = 0;
+	int		sts;
+
+	pthread_mutex_lock(&command_lock);
+	if ((cp = command_lookup(command)) != NULL && cp->output != NULL &&
+	    (interval > 0 || cp->generation == generation)) {
+		/* copy, the refresh thread may replace this output */
+		sts = cp->sts;
+		if ((length = cp->length) != 0) {
+			if ((output = malloc(length)) != NULL)
+				memcpy(output, cp->output, length);
+			else
+				sts = -ENOMEM;
+		}
+		pthread_mutex_unlock(&command_lock);
+	} else {
+		/* never run, or stale - run it now, without the lock held */
+		pthread_mutex_unlock(&command_lock);
+		sts = command_run(command, &output, &length);
+
+		pthread_mutex_lock(&command_lock);
+		if (cp == NULL)
+			cp = command_add(command);
+		if (cp != NULL && sts == 0) {
+			free(cp->output);
+			if ((cp->output = malloc(length ? length : 1)) != NULL) {
+				memcpy(cp->output, output, length);
+				cp->length = length;
+			}
+			cp->sts = sts;
+			cp->generation = generation;
+		}
+		pthread_mutex_unlock(&command_lock);
+	}
+	if (sts < 0) {
+		free(output);
+		setoserror(-sts);
+		return NULL;
+	}
+
+	if (length == 0)
+		fp = fopen("/dev/null", "r");
+	else if ((fp = fmemopen(NULL, length + 1, "w+")) != NULL) {
+		/* stream owns its buffer (plus a NUL), released by fclose */
+		if (fwrite(output, 1, length, fp) != length) {
+			fclose(fp);
+			fp = NULL;
+		} else {
+			rewind(fp);
+		}
+	}
+	free(output);
+	return fp;
+}
+
+int
+hacluster_pclose(FILE *fp)
+{
+	return fclose(fp);
+}
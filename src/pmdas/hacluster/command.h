@@ -0,0 +1,27 @@
+/*
+ * HA Cluster command output caching.
+ *
+ * Copyright (c) 2026 Red Hat.
+ * 
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#ifndef COMMAND_H
+#define COMMAND_H
+
+#define COMMAND_INTERVAL	5	/* default background refresh, seconds */
+
+extern void hacluster_command_setup(int);
+extern void hacluster_command_refresh(void);
+extern FILE *hacluster_popen(const char *);
+extern int hacluster_pclose(FILE *);
+
+#endif /* COMMAND_H */
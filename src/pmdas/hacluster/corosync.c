@@ -22,6 +22,7 @@
 #include "pmda.h"
 
 #include "corosync.h"
+#include "command.h"
 
 static char *quorumtool_command;
 static char *cfgtool_command;
@@ -148,7 +149,7 @@ hacluster_refresh_corosync_node(const char *node_name, struct member_votes *node
 
 	pmsprintf(buffer, sizeof(buffer), "%s 2>&1", quorumtool_command);
 
-	if ((pf = popen(buffer, "r")) == NULL)
+	if ((pf = hacluster_popen(buffer)) == NULL)
 		return oserror();
 
 	while(fgets(buffer, sizeof(buffer)-1, pf) != NULL) {
@@ -184,7 +185,7 @@ hacluster_refresh_corosync_node(const char *node_name, struct member_votes *node
 		}
 	}
 
-	pclose(pf);
+	hacluster_pclose(pf);
 	return(0);	
 }
 
@@ -196,7 +197,7 @@ hacluster_refresh_corosync_global()
 
 	pmsprintf(buffer, sizeof(buffer), "%s 2>&1", quorumtool_command);
 
-	if ((pf = popen(buffer, "r")) == NULL)
+	if ((pf = hacluster_popen(buffer)) == NULL)
 		return oserror();
 
 	while(fgets(buffer, sizeof(buffer)-1, pf) != NULL) {
@@ -223,11 +224,11 @@ hacluster_refresh_corosync_global()
 		if (strncmp(buffer, "Quorum:", 7) == 0)
 			sscanf(buffer, "%*s %"SCNu32"", &global_stats.quorum);
 	}
-	pclose(pf);
+	hacluster_pclose(pf);
 
 	pmsprintf(buffer, sizeof(buffer), "%s 2>&1", cfgtool_command);
 
-	if ((pf = popen(buffer, "r")) == NULL)
+	if ((pf = hacluster_popen(buffer)) == NULL)
 		return oserror();
 
 	while(fgets(buffer, sizeof(buffer)-1, pf) != NULL) {
@@ -235,7 +236,7 @@ hacluster_refresh_corosync_global()
 		if (strstr(buffer, "FAULTY"))
 			global_stats.ring_errors = 1;
 	}
-	pclose(pf); 
+	hacluster_pclose(pf); 
 	return 0;
 }
 
@@ -249,7 +250,7 @@ hacluster_refresh_corosync_ring(const char *ring_name, struct rings *rings)
 	
 	pmsprintf(buffer, sizeof(buffer), "%s 2>&1", cfgtool_command);
 
-	if ((pf = popen(buffer, "r")) == NULL)
+	if ((pf = hacluster_popen(buffer)) == NULL)
 		return oserror();
 
 	while(fgets(buffer, sizeof(buffer)-1, pf) != NULL) {
@@ -298,11 +299,11 @@ hacluster_refresh_corosync_ring(const char *ring_name, struct rings *rings)
 			}
 		}
 	}
-	pclose(pf);
+	hacluster_pclose(pf);
 
 	pmsprintf(buffer, sizeof(buffer), "%s 2>&1", quorumtool_command);
 
-	if ((pf = popen(buffer, "r")) == NULL)
+	if ((pf = hacluster_popen(buffer)) == NULL)
 		return oserror();
 	
 	/* 
@@ -316,7 +317,7 @@ hacluster_refresh_corosync_ring(const char *ring_name, struct rings *rings)
 		if (strncmp(buffer, "Ring ID:", 2) == 0) 
 			sscanf(buffer, "%*s %*s %s", rings->ring_id);
 	}
-	pclose(pf);
+	hacluster_pclose(pf);
 	return 0;
 }
 
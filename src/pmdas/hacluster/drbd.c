@@ -22,6 +22,7 @@
 #include "pmda.h"
 
 #include "drbd.h"
+#include "command.h"
 
 static char *drbdsetup_command;
 static char *split_brain_path;
@@ -172,7 +173,7 @@ hacluster_refresh_drbd_resource(const char *resource_name, struct resource *reso
 
 	pmsprintf(buffer, sizeof(buffer), "%s 2>&1", drbdsetup_command);
 
-	if ((pf = popen(buffer, "r")) == NULL)
+	if ((pf = hacluster_popen(buffer)) == NULL)
 		return oserror();
 
 	/* 
@@ -260,7 +261,7 @@ hacluster_refresh_drbd_resource(const char *resource_name, struct resource *reso
 				sscanf(buffer_ptr, "\"lower-pending\": %"SCNu64"", &resource->lower_pending);
 		}	
 	}
-	pclose(pf);
+	hacluster_pclose(pf);
 
 	/* Final Check to see if we have a split-brain detected for our resource-volume 
 	 * hook filename is - drbd-split-brain-detected-NODE-VOLUME in our case.
@@ -290,7 +291,7 @@ hacluster_refresh_drbd_peer_device(const char *peer_name, struct peer_device *pe
 
 	pmsprintf(buffer, sizeof(buffer), "%s 2>&1", drbdsetup_command);
 
-	if ((pf = popen(buffer, "r")) == NULL)
+	if ((pf = hacluster_popen(buffer)) == NULL)
 		return oserror();
 
 	/* 
@@ -367,7 +368,7 @@ hacluster_refresh_drbd_peer_device(const char *peer_name, struct peer_device *pe
 				sscanf(buffer_ptr, "\"percent-in-sync\": %f", &peer_device->connections_sync);
 		}
 	}
-	pclose(pf);
+	hacluster_pclose(pf);
 	free(tofree);
 	return 0;
 }
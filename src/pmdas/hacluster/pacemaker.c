@@ -19,6 +19,7 @@
 #include "pmda.h"
 
 #include "pacemaker.h"
+#include "command.h"
 
 #include <time.h>
 
@@ -383,7 +384,7 @@ hacluster_refresh_pacemaker_global()
 
 	pmsprintf(buffer, sizeof(buffer), "%s 2>&1", cibadmin_command);
 
-	if ((pf = popen(buffer, "r")) == NULL)
+	if ((pf = hacluster_popen(buffer)) == NULL)
 		return -oserror();
 
 	while(fgets(buffer, sizeof(buffer)-1, pf) != NULL) {
@@ -393,11 +394,11 @@ hacluster_refresh_pacemaker_global()
 			global_stats.config_last_change = dateToEpoch(last_written_text);
 		}
 	}
-	pclose(pf);
+	hacluster_pclose(pf);
 
 	pmsprintf(buffer, sizeof(buffer), "%s 2>&1", crm_mon_command);
 
-	if ((pf = popen(buffer, "r")) == NULL)
+	if ((pf = hacluster_popen(buffer)) == NULL)
 		return -oserror();
 
 	while(fgets(buffer, sizeof(buffer)-1, pf) != NULL) {
@@ -411,7 +412,7 @@ hacluster_refresh_pacemaker_global()
 				global_stats.stonith_enabled = 0;
 		}
 	}
-	pclose(pf);
+	hacluster_pclose(pf);
 	return 0;
 }
 
@@ -425,7 +426,7 @@ hacluster_refresh_pacemaker_fail(const char *instance_name, struct fail_count *f
 
 	pmsprintf(buffer, sizeof(buffer), "%s 2>&1", crm_mon_command);
 
-	if ((pf = popen(buffer, "r")) == NULL)
+	if ((pf = hacluster_popen(buffer)) == NULL)
 		return -oserror();
 
 	/* 
@@ -464,7 +465,7 @@ hacluster_refresh_pacemaker_fail(const char *instance_name, struct fail_count *f
 			);
 		}
 	}
-	pclose(pf);
+	hacluster_pclose(pf);
 	free(tofree);
 	return 0;
 }
@@ -478,7 +479,7 @@ hacluster_refresh_pacemaker_constraints(const char *constraints_name, struct loc
 
 	pmsprintf(buffer, sizeof(buffer), "%s 2>&1", cibadmin_command);
 
-	if ((pf = popen(buffer, "r")) == NULL)
+	if ((pf = hacluster_popen(buffer)) == NULL)
 		return -oserror();
 
 	while(fgets(buffer, sizeof(buffer)-1, pf) != NULL) {
@@ -499,7 +500,7 @@ hacluster_refresh_pacemaker_constraints(const char *constraints_name, struct loc
 			); 
 		}	
 	}
-	pclose(pf);
+	hacluster_pclose(pf);
 	return 0;
 }
 
@@ -515,7 +516,7 @@ hacluster_refresh_pacemaker_nodes(const char *node_name, struct nodes *nodes)
 
 	pmsprintf(buffer, sizeof(buffer), "%s 2>&1", crm_mon_command);
 
-	if ((pf = popen(buffer, "r")) == NULL)
+	if ((pf = hacluster_popen(buffer)) == NULL)
 		return -oserror();
 
 	while(fgets(buffer, sizeof(buffer)-1, pf) != NULL) {
@@ -558,7 +559,7 @@ hacluster_refresh_pacemaker_nodes(const char *node_name, struct nodes *nodes)
 			nodes->dc = bool_convert(dc);
 		}
 	}
-	pclose(pf);
+	hacluster_pclose(pf);
 	return 0;
 }
 
@@ -572,7 +573,7 @@ hacluster_refresh_pacemaker_node_attribs(const char *attrib_name, struct attribu
 
 	pmsprintf(buffer, sizeof(buffer), "%s 2>&1", crm_mon_command);
 
-	if ((pf = popen(buffer, "r")) == NULL)
+	if ((pf = hacluster_popen(buffer)) == NULL)
 		return -oserror();
 
 	/* 
@@ -614,7 +615,7 @@ hacluster_refresh_pacemaker_node_attribs(const char *attrib_name, struct attribu
 			sscanf(buffer, "%*s %*s value=\"%[^\"]\"", attributes->value);
 		}
 	}
-	pclose(pf);
+	hacluster_pclose(pf);
 	free(tofree);
 	return 0;
 }
@@ -646,7 +647,7 @@ hacluster_refresh_pacemaker_resources(const char *instance_name, struct resource
 
 	pmsprintf(buffer, sizeof(buffer), "%s 2>&1", crm_mon_command);
 
-	if ((pf = popen(buffer, "r")) == NULL) {
+	if ((pf = hacluster_popen(buffer)) == NULL) {
 		if (!no_node_attachment)
 		    free(tofree);
 		return -oserror();
@@ -742,7 +743,7 @@ hacluster_refresh_pacemaker_resources(const char *instance_name, struct resource
 				break;
 		}
 	}
-	pclose(pf);
+	hacluster_pclose(pf);
 
 	if (!no_node_attachment)
 		free(tofree);
@@ -402,7 +402,7 @@ hacluster_pacemaker_fail_instance_refresh(void)
 
 	pmsprintf(buffer, sizeof(buffer), "%s 2>&1", crm_mon_command);
 
-	if ((pf = popen(buffer, "r")) == NULL)
+	if ((pf = hacluster_popen(buffer)) == NULL)
 		return oserror();
 
 	while(fgets(buffer, sizeof(buffer)-1, pf) != NULL) {
@@ -443,7 +443,7 @@ hacluster_pacemaker_fail_instance_refresh(void)
 				if (sts == PM_ERR_INST || (sts >=0 && fail == NULL)) {
 					fail = calloc(1, sizeof(struct pacemaker_fail));
 					if (fail == NULL) {
-						pclose(pf);
+						hacluster_pclose(pf);
 						return PM_ERR_AGAIN;
 					}
 				}
@@ -454,7 +454,7 @@ hacluster_pacemaker_fail_instance_refresh(void)
 			}
 		}
 	}
-	pclose(pf);	
+	hacluster_pclose(pf);	
 	return 0;
 }
 
@@ -478,7 +478,7 @@ hacluster_pacemaker_constraints_instance_refresh(void)
 	pmsprintf(buffer, sizeof(buffer), "%s 2>&1", cibadmin_command);
 	buffer[sizeof(buffer)-1] = '\0';
 
-	if ((pf = popen(buffer, "r")) == NULL)
+	if ((pf = hacluster_popen(buffer)) == NULL)
 		return oserror();
 
 	while(fgets(buffer, sizeof(buffer)-1, pf) != NULL) {
@@ -498,7 +498,7 @@ hacluster_pacemaker_constraints_instance_refresh(void)
 			if (sts == PM_ERR_INST || (sts >=0 && constraints == NULL)) {
 				constraints = calloc(1, sizeof(struct pacemaker_constraints));
 				if (constraints == NULL) {
-					pclose(pf);
+					hacluster_pclose(pf);
 					return PM_ERR_AGAIN;
 				}
 			}
@@ -509,7 +509,7 @@ hacluster_pacemaker_constraints_instance_refresh(void)
 			pmdaCacheStore(indom_all, PMDA_CACHE_ADD, constraint_name, NULL);
 		}
 	}
-	pclose(pf);
+	hacluster_pclose(pf);
 	return 0;
 }
 
@@ -530,7 +530,7 @@ hacluster_pacemaker_nodes_instance_refresh(void)
 
 	pmsprintf(buffer, sizeof(buffer), "%s 2>&1", crm_mon_command);
 
-	if ((pf = popen(buffer, "r")) == NULL)
+	if ((pf = hacluster_popen(buffer)) == NULL)
 		return oserror();
 
 	while(fgets(buffer, sizeof(buffer)-1, pf) != NULL) {
@@ -557,7 +557,7 @@ hacluster_pacemaker_nodes_instance_refresh(void)
 				if (sts == PM_ERR_INST || (sts >=0 && pace_nodes == NULL)) {
 					pace_nodes = calloc(1, sizeof(struct pacemaker_nodes));
 					if (pace_nodes == NULL) {
-						pclose(pf);
+						hacluster_pclose(pf);
 						return PM_ERR_AGAIN;
 					}
 				}
@@ -568,7 +568,7 @@ hacluster_pacemaker_nodes_instance_refresh(void)
 			}
 		}
 	}
-	pclose(pf);
+	hacluster_pclose(pf);
 	return 0;
 }
 
@@ -591,7 +591,7 @@ hacluster_pacemaker_node_attrib_instance_refresh(void)
 
 	pmsprintf(buffer, sizeof(buffer), "%s 2>&1", crm_mon_command);
 
-	if ((pf = popen(buffer, "r")) == NULL)
+	if ((pf = hacluster_popen(buffer)) == NULL)
 		return oserror();
 
 	while(fgets(buffer, sizeof(buffer)-1, pf) != NULL) {
@@ -638,7 +638,7 @@ hacluster_pacemaker_node_attrib_instance_refresh(void)
 				if (sts == PM_ERR_INST || (sts >=0 && node_attrib == NULL)) {
 					node_attrib = calloc(1, sizeof(struct pacemaker_node_attrib));
 					if (node_attrib == NULL) {
-						pclose(pf);
+						hacluster_pclose(pf);
 						return PM_ERR_AGAIN;
 					}
 				}
@@ -650,7 +650,7 @@ hacluster_pacemaker_node_attrib_instance_refresh(void)
 			}
 		}
 	}
-	pclose(pf);
+	hacluster_pclose(pf);
 	return 0;
 }
 
@@ -673,7 +673,7 @@ hacluster_pacemaker_resources_instance_refresh(void)
 
 	pmsprintf(buffer, sizeof(buffer), "%s 2>&1", crm_mon_command);
 
-	if ((pf = popen(buffer, "r")) == NULL)
+	if ((pf = hacluster_popen(buffer)) == NULL)
 		return oserror();
 
 	while(fgets(buffer, sizeof(buffer)-1, pf) != NULL) {
@@ -717,7 +717,7 @@ hacluster_pacemaker_resources_instance_refresh(void)
 				if (sts == PM_ERR_INST || (sts >=0 && pace_resources == NULL)) {
 					pace_resources = calloc(1, sizeof(struct pacemaker_resources));
 					if (pace_resources == NULL) {
-						pclose(pf);
+						hacluster_pclose(pf);
 						return PM_ERR_AGAIN;
 					}
 				}
@@ -732,7 +732,7 @@ hacluster_pacemaker_resources_instance_refresh(void)
 			}
 		}
 	}
-	pclose(pf);
+	hacluster_pclose(pf);
 	return 0;
 }
 
@@ -753,7 +753,7 @@ hacluster_corosync_node_instance_refresh(void)
 	
 	pmsprintf(buffer, sizeof(buffer), "%s 2>&1", quorumtool_command);
 
-	if ((pf = popen(buffer, "r")) == NULL)
+	if ((pf = hacluster_popen(buffer)) == NULL)
 		return oserror();
 
 	while (fgets(buffer, sizeof(buffer)-1, pf) != NULL) {
@@ -783,7 +783,7 @@ hacluster_corosync_node_instance_refresh(void)
 			if (sts == PM_ERR_INST || (sts >=0 && node == NULL)) {
 				node = calloc(1, sizeof(struct corosync_node));
 				if (node == NULL) {
-					pclose(pf);
+					hacluster_pclose(pf);
 					return PM_ERR_AGAIN;
 				}
 			}
@@ -793,7 +793,7 @@ hacluster_corosync_node_instance_refresh(void)
 			pmdaCacheStore(indom, PMDA_CACHE_ADD, node_name, (void *)node);			
 		}
 	}
-	pclose(pf);
+	hacluster_pclose(pf);
 	return(0);
 }
 
@@ -815,7 +815,7 @@ hacluster_corosync_ring_instance_refresh(void)
 	
 	pmsprintf(buffer, sizeof(buffer), "%s 2>&1", cfgtool_command);
 	
-	if ((pf = popen(buffer, "r")) == NULL)
+	if ((pf = hacluster_popen(buffer)) == NULL)
 		return oserror();
 
 	while(fgets(buffer, sizeof(buffer)-1, pf) != NULL) {
@@ -842,7 +842,7 @@ hacluster_corosync_ring_instance_refresh(void)
 			if (sts == PM_ERR_INST || (sts >=0 && ring == NULL)) {
 				ring = calloc(1, sizeof(struct corosync_ring));
 				if (ring == NULL) {
-					pclose(pf);
+					hacluster_pclose(pf);
 					return PM_ERR_AGAIN;
 				}
 			}
@@ -853,7 +853,7 @@ hacluster_corosync_ring_instance_refresh(void)
 			pmdaCacheStore(indom_all, PMDA_CACHE_ADD, ring_name, NULL);
 		}
 	}
-	pclose(pf);
+	hacluster_pclose(pf);
 	return(0);
 }
 
@@ -953,7 +953,7 @@ hacluster_drbd_resource_instance_refresh(void)
 	
 	pmsprintf(buffer, sizeof(buffer), "%s 2>&1", drbdsetup_command);
 	
-	if ((pf = popen(buffer, "r")) == NULL)
+	if ((pf = hacluster_popen(buffer)) == NULL)
 		return oserror();
 
 	while(fgets(buffer, sizeof(buffer)-1, pf) != NULL) {
@@ -995,7 +995,7 @@ hacluster_drbd_resource_instance_refresh(void)
 			if (sts == PM_ERR_INST || (sts >=0 && resource == NULL)) {
 				resource = calloc(1, sizeof(struct drbd_resource));
 				if (resource == NULL) {
-					pclose(pf);
+					hacluster_pclose(pf);
 					return PM_ERR_AGAIN;
 				}
 			}
@@ -1008,7 +1008,7 @@ hacluster_drbd_resource_instance_refresh(void)
 			found_volume = 0;
 		}
 	}
-	pclose(pf);
+	hacluster_pclose(pf);
 	return 0;
 }
 
@@ -1034,7 +1034,7 @@ hacluster_drbd_peer_device_instance_refresh(void)
 
 	pmsprintf(buffer, sizeof(buffer), "%s 2>&1", drbdsetup_command);
 
-	if ((pf = popen(buffer, "r")) == NULL)
+	if ((pf = hacluster_popen(buffer)) == NULL)
 		return oserror();
 
 	while(fgets(buffer, sizeof(buffer)-1, pf) != NULL) {
@@ -1076,7 +1076,7 @@ hacluster_drbd_peer_device_instance_refresh(void)
 			if (sts == PM_ERR_INST || (sts >=0 && peer_device == NULL)) {
 				peer_device = calloc(1, sizeof(struct drbd_peer_device));
 				if (peer_device == NULL) {
-					pclose(pf);
+					hacluster_pclose(pf);
 					return PM_ERR_AGAIN;
 				}
 			}
@@ -1089,13 +1089,14 @@ hacluster_drbd_peer_device_instance_refresh(void)
 			found_peer_node = 0;
 		}
 	}
-	pclose(pf);
+	hacluster_pclose(pf);
 	return 0;
 }
 
 static int
 hacluster_instance(pmInDom indom, int inst, char *name, pmInResult **result, pmdaExt *pmda)
 {
+	hacluster_command_refresh();
 	hacluster_pacemaker_fail_instance_refresh();
 	hacluster_pacemaker_constraints_instance_refresh();
 	hacluster_pacemaker_nodes_instance_refresh();
@@ -1126,7 +1127,9 @@ hacluster_fetch_refresh(pmdaExt *pmda, int *need_refresh)
 	char							*instance_name, *constraint_name, *pace_node_name, *attrib_name;
 	char							*pace_resource_name;
 	int 							i, sts;
-		
+
+	hacluster_command_refresh();
+
 	if ((sts = hacluster_pacemaker_fail_instance_refresh()) < 0)
 		return sts;
 		
@@ -1740,12 +1743,13 @@ static pmLongOptions longopts[] = {
 	PMOPT_DEBUG,
 	PMDAOPT_DOMAIN,
 	PMDAOPT_LOGFILE,
+	{ "refresh", 1, 't', "SECONDS", "interval between cluster command refreshes" },
 	PMOPT_HELP,
 	PMDA_OPTIONS_END
 };
 
 static pmdaOptions opts = {
-	.short_options = "D:d:l:U:?",
+	.short_options = "D:d:l:t:U:?",
 	.long_options = longopts,
 };
 
@@ -1754,6 +1758,8 @@ main(int argc, char **argv)
 {
 	int sep = pmPathSeparator();
 	char helppath[MAXPATHLEN];
+	char *endnum;
+	int c, refresh = COMMAND_INTERVAL;
 	pmdaInterface dispatch;
 
 	_isDSO = 0;
@@ -1762,7 +1768,18 @@ main(int argc, char **argv)
 		pmGetConfig("PCP_PMDAS_DIR"), sep, sep);
 	pmdaDaemon(&dispatch, PMDA_INTERFACE_7, pmGetProgname(), HACLUSTER, "hacluster.log", helppath);
 
-	pmdaGetOptions(argc, argv, &opts, &dispatch);
+	while ((c = pmdaGetOptions(argc, argv, &opts, &dispatch)) != EOF) {
+		switch (c) {
+		case 't':
+			refresh = (int)strtol(opts.optarg, &endnum, 10);
+			if (*endnum != '\0' || refresh < 0) {
+				pmprintf("%s: -t requires a non-negative number of seconds\n",
+					pmGetProgname());
+				opts.errors++;
+			}
+			break;
+		}
+	}
 	if (opts.errors) {
 		pmdaUsageMessage(&opts);
 		exit(1);
@@ -1771,6 +1788,7 @@ main(int argc, char **argv)
 	pmdaOpenLog(&dispatch);
 
 	hacluster_init(&dispatch);
+	hacluster_command_setup(refresh);
 	pmdaConnect(&dispatch);
 	pmdaMain(&dispatch);
 	exit(0);
@@ -21,6 +21,7 @@
 #include "corosync.h"
 #include "sbd.h"
 #include "drbd.h"
+#include "command.h"
 
 enum {
 	CLUSTER_PACEMAKER_GLOBAL = 0,		/* 0  -- NULL INDOM */
@@ -22,6 +22,7 @@
 #include "pmda.h"
 
 #include "sbd.h"
+#include "command.h"
 
 static char *sbd_command;
 
@@ -83,7 +84,7 @@ hacluster_refresh_sbd_device(const char *sbd_dev, struct sbd *sbd)
 
 	pmsprintf(buffer, sizeof(buffer), "%s -d %s dump 2>&1", sbd_command, sbd_dev);
 
-	if ((pf = popen(buffer, "r")) == NULL)
+	if ((pf = hacluster_popen(buffer)) == NULL)
 		return oserror();
 
 	strncpy(sbd->path, sbd_dev, sizeof(sbd->path));
@@ -108,7 +109,7 @@ hacluster_refresh_sbd_device(const char *sbd_dev, struct sbd *sbd)
 		if (strncmp(buffer, "Timeout (msgwait)", 17) == 0)
 			sscanf(buffer, "%*s %*s %*s %"SCNu32"", &sbd->msgwait);
 	}
-	pclose(pf);
+	hacluster_pclose(pf);
 	return 0;
 }
 
@@ -0,0 +1,634 @@
+/*
+ * High frequency sampling PMDA
+ *
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * A small set of system-wide counters is sampled on a sub-second timer,
+ * independent of pmcd fetch requests.  Each sample is appended to a per
+ * source event queue as a fixed-size binary record, and drained by each
+ * client as an event array - so one fetch (or one pmlogger record) carries
+ * every sample taken since the previous fetch, with its own timestamp.
+ *
+ * Structure based upon the systemd and logger PMDAs.
+ */
+
+#include "pmapi.h"
+#include "libpcp.h"
+#include "pmda.h"
+#include "domain.h"
+#include <ctype.h>
+#include <fcntl.h>
+#include <time.h>
+
+#define DEFAULT_MAXMEM	(2 * 1024 * 1024)	/* 2 megabytes per queue */
+#define DEFAULT_INTERVAL 10			/* milliseconds */
+#define MAX_FIELDS	6			/* counters in one sample */
+
+enum {
+    CLUSTER_CONTROL = 0,
+    CLUSTER_DISK,
+    CLUSTER_NETWORK,
+    CLUSTER_PRESSURE,
+    NUM_SOURCES = CLUSTER_PRESSURE
+};
+
+enum {
+    CONTROL_INTERVAL = 0,
+    CONTROL_NUMCLIENTS,
+    CONTROL_MAXMEM,
+    CONTROL_SAMPLES,
+    CONTROL_OVERRUNS,
+};
+
+/*
+ * Every source has a records event metric as item zero, then one
+ * U64 counter parameter metric per field of its samples.
+ */
+typedef struct source {
+    const char		*name;
+    int			nfields;
+    int			(*sample)(struct source *, __uint64_t *);
+    const char		*paths[3];
+    int			fds[3];
+    int			queue;
+    __uint64_t		samples;
+} source_t;
+
+typedef struct disk {
+    char		name[64];
+    int			whole;
+} disk_t;
+
+static int disk_sample(source_t *, __uint64_t *);
+static int network_sample(source_t *, __uint64_t *);
+static int pressure_sample(source_t *, __uint64_t *);
+
+static source_t sources[NUM_SOURCES] = {
+    { "disk", 4, disk_sample, { "/proc/diskstats" } },
+    { "network", 4, network_sample, { "/proc/net/dev" } },
+    { "pressure", 6, pressure_sample,
+	{ "/proc/pressure/cpu", "/proc/pressure/memory", "/proc/pressure/io" } },
+};
+
+static pmdaMetric metrictab[] = {
+/* control.interval */
+    { NULL,
+      { PMDA_PMID(CLUSTER_CONTROL,CONTROL_INTERVAL), PM_TYPE_U32,
+	PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,1,0,0,PM_TIME_MSEC,0) }, },
+/* control.numclients */
+    { NULL,
+      { PMDA_PMID(CLUSTER_CONTROL,CONTROL_NUMCLIENTS), PM_TYPE_U32,
+	PM_INDOM_NULL, PM_SEM_INSTANT, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) }, },
+/* control.maxmem */
+    { NULL,
+      { PMDA_PMID(CLUSTER_CONTROL,CONTROL_MAXMEM), PM_TYPE_U64,
+	PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(1,0,0,PM_SPACE_BYTE,0,0) }, },
+/* control.samples */
+    { NULL,
+      { PMDA_PMID(CLUSTER_CONTROL,CONTROL_SAMPLES), PM_TYPE_U64,
+	PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) }, },
+/* control.overruns */
+    { NULL,
+      { PMDA_PMID(CLUSTER_CONTROL,CONTROL_OVERRUNS), PM_TYPE_U64,
+	PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) }, },
+
+/* disk.records */
+    { NULL,
+      { PMDA_PMID(CLUSTER_DISK,0), PM_TYPE_EVENT,
+	PM_INDOM_NULL, PM_SEM_INSTANT, PMDA_PMUNITS(0,0,0,0,0,0) }, },
+/* disk.read_bytes */
+    { NULL,
+      { PMDA_PMID(CLUSTER_DISK,1), PM_TYPE_U64,
+	PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(1,0,0,PM_SPACE_BYTE,0,0) }, },
+/* disk.write_bytes */
+    { NULL,
+      { PMDA_PMID(CLUSTER_DISK,2), PM_TYPE_U64,
+	PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(1,0,0,PM_SPACE_BYTE,0,0) }, },
+/* disk.reads */
+    { NULL,
+      { PMDA_PMID(CLUSTER_DISK,3), PM_TYPE_U64,
+	PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) }, },
+/* disk.writes */
+    { NULL,
+      { PMDA_PMID(CLUSTER_DISK,4), PM_TYPE_U64,
+	PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) }, },
+
+/* network.records */
+    { NULL,
+      { PMDA_PMID(CLUSTER_NETWORK,0), PM_TYPE_EVENT,
+	PM_INDOM_NULL, PM_SEM_INSTANT, PMDA_PMUNITS(0,0,0,0,0,0) }, },
+/* network.in_bytes */
+    { NULL,
+      { PMDA_PMID(CLUSTER_NETWORK,1), PM_TYPE_U64,
+	PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(1,0,0,PM_SPACE_BYTE,0,0) }, },
+/* network.out_bytes */
+    { NULL,
+      { PMDA_PMID(CLUSTER_NETWORK,2), PM_TYPE_U64,
+	PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(1,0,0,PM_SPACE_BYTE,0,0) }, },
+/* network.in_packets */
+    { NULL,
+      { PMDA_PMID(CLUSTER_NETWORK,3), PM_TYPE_U64,
+	PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) }, },
+/* network.out_packets */
+    { NULL,
+      { PMDA_PMID(CLUSTER_NETWORK,4), PM_TYPE_U64,
+	PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) }, },
+
+/* pressure.records */
+    { NULL,
+      { PMDA_PMID(CLUSTER_PRESSURE,0), PM_TYPE_EVENT,
+	PM_INDOM_NULL, PM_SEM_INSTANT, PMDA_PMUNITS(0,0,0,0,0,0) }, },
+/* pressure.cpu_some */
+    { NULL,
+      { PMDA_PMID(CLUSTER_PRESSURE,1), PM_TYPE_U64,
+	PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,1,0,0,PM_TIME_USEC,0) }, },
+/* pressure.cpu_full */
+    { NULL,
+      { PMDA_PMID(CLUSTER_PRESSURE,2), PM_TYPE_U64,
+	PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,1,0,0,PM_TIME_USEC,0) }, },
+/* pressure.memory_some */
+    { NULL,
+      { PMDA_PMID(CLUSTER_PRESSURE,3), PM_TYPE_U64,
+	PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,1,0,0,PM_TIME_USEC,0) }, },
+/* pressure.memory_full */
+    { NULL,
+      { PMDA_PMID(CLUSTER_PRESSURE,4), PM_TYPE_U64,
+	PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,1,0,0,PM_TIME_USEC,0) }, },
+/* pressure.io_some */
+    { NULL,
+      { PMDA_PMID(CLUSTER_PRESSURE,5), PM_TYPE_U64,
+	PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,1,0,0,PM_TIME_USEC,0) }, },
+/* pressure.io_full */
+    { NULL,
+      { PMDA_PMID(CLUSTER_PRESSURE,6), PM_TYPE_U64,
+	PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,1,0,0,PM_TIME_USEC,0) }, },
+};
+
+static int		domain;
+static long		maxmem;
+static unsigned int	interval = DEFAULT_INTERVAL;	/* msec */
+static __uint64_t	overruns;
+static char		*username;
+static char		filebuf[65536];
+
+/*
+ * Re-read a /proc file through a descriptor held open across samples,
+ * avoiding the path lookup and allocation of an open(2) at every tick.
+ */
+static char *
+read_file(source_t *sp, int i)
+{
+    ssize_t	bytes;
+
+    if (sp->fds[i] < 0)
+	return NULL;
+    if (lseek(sp->fds[i], 0, SEEK_SET) < 0 ||
+	(bytes = read(sp->fds[i], filebuf, sizeof(filebuf) - 1)) < 0)
+	return NULL;
+    filebuf[bytes] = '\0';
+    return filebuf;
+}
+
+/*
+ * Whole disks have a /sys/block entry, partitions do not - remember the
+ * answer for each device name rather than asking again at every tick.
+ */
+static int
+whole_disk(const char *name)
+{
+    static __pmHashCtl	disks;
+    __pmHashNode	*hp;
+    disk_t		*dp;
+    char		path[MAXPATHLEN];
+    unsigned int	key = 0;
+    const char		*p;
+
+    for (p = name; *p; p++)
+	key = key * 31 + (unsigned char)*p;
+    for (hp = __pmHashSearch(key, &disks); hp; hp = hp->next) {
+	dp = (disk_t *)hp->data;
+	if (hp->key == key && strcmp(dp->name, name) == 0)
+	    return dp->whole;
+    }
+    pmsprintf(path, sizeof(path), "/sys/block/%s", name);
+    if ((dp = malloc(sizeof(disk_t))) == NULL)
+	return 0;
+    pmstrncpy(dp->name, sizeof(dp->name), name);
+    dp->whole = (access(path, F_OK) == 0);
+    if (__pmHashAdd(key, dp, &disks) < 0) {
+	free(dp);
+	return 0;
+    }
+    return dp->whole;
+}
+
+/*
+ * Sum over whole disks, skipping partitions and the virtual devices
+ * layered over disks, to avoid double counting.
+ */
+static int
+disk_sample(source_t *sp, __uint64_t *values)
+{
+    unsigned long long	reads, rsect, writes, wsect;
+    char		name[64];
+    char		*p, *line;
+
+    if ((p = read_file(sp, 0)) == NULL)
+	return -oserror();
+    for (line = strtok(p, "\n"); line; line = strtok(NULL, "\n")) {
+	if (sscanf(line, "%*u %*u %63s %llu %*u %llu %*u %llu %*u %llu",
+			name, &reads, &rsect, &writes, &wsect) != 5)
+	    continue;
+	if (strncmp(name, "dm-", 3) == 0 || strncmp(name, "md", 2) == 0 ||
+	    strncmp(name, "loop", 4) == 0 || strncmp(name, "ram", 3) == 0)
+	    continue;
+	if (!whole_disk(name))
+	    continue;
+	values[0] += rsect * 512;
+	values[1] += wsect * 512;
+	values[2] += reads;
+	values[3] += writes;
+    }
+    return 0;
+}
+
+static int
+network_sample(source_t *sp, __uint64_t *values)
+{
+    unsigned long long	ibytes, ipackets, obytes, opackets;
+    char		*p, *line, *colon;
+
+    if ((p = read_file(sp, 0)) == NULL)
+	return -oserror();
+    for (line = strtok(p, "\n"); line; line = strtok(NULL, "\n")) {
+	if ((colon = strchr(line, ':')) == NULL)
+	    continue;	/* header lines */
+	*colon = '\0';
+	while (isspace((int)*line))
+	    line++;
+	if (strcmp(line, "lo") == 0)
+	    continue;
+	if (sscanf(colon + 1, "%llu %llu %*u %*u %*u %*u %*u %*u %llu %llu",
+			&ibytes, &ipackets, &obytes, &opackets) != 4)
+	    continue;
+	values[0] += ibytes;
+	values[1] += obytes;
+	values[2] += ipackets;
+	values[3] += opackets;
+    }
+    return 0;
+}
+
+static int
+pressure_sample(source_t *sp, __uint64_t *values)
+{
+    unsigned long long	total;
+    char		*p, *q, *line;
+    int			i, found = 0;
+
+    for (i = 0; i < 3; i++) {
+	if ((p = read_file(sp, i)) == NULL)
+	    continue;
+	for (line = strtok(p, "\n"); line; line = strtok(NULL, "\n")) {
+	    if ((q = strstr(line, "total=")) == NULL ||
+		sscanf(q, "total=%llu", &total) != 1)
+		continue;
+	    if (strncmp(line, "some", 4) == 0)
+		values[i * 2] = total;
+	    else if (strncmp(line, "full", 4) == 0)
+		values[i * 2 + 1] = total;
+	}
+	found++;
+    }
+    return found ? 0 : -ENOENT;
+}
+
+/*
+ * Take one sample from each source with an active client - a source
+ * nobody is draining is not read at all.
+ */
+static void
+hifreq_sample(void)
+{
+    __uint64_t		values[MAX_FIELDS];
+    struct timeval	stamp;
+    pmAtomValue		atom;
+    source_t		*sp;
+    int			i;
+
+    for (i = 0; i < NUM_SOURCES; i++) {
+	sp = &sources[i];
+	if (sp->queue < 0 ||
+	    pmdaEventQueueClients(sp->queue, &atom) < 0 || atom.ul == 0)
+	    continue;
+	memset(values, 0, sizeof(values));
+	if (sp->sample(sp, values) < 0)
+	    continue;
+	pmtimevalNow(&stamp);
+	pmdaEventQueueAppend(sp->queue, values,
+			sp->nfields * sizeof(__uint64_t), &stamp);
+	sp->samples++;
+    }
+}
+
+static int
+hifreq_decoder(int eventarray, void *buffer, size_t size,
+		struct timeval *timestamp, void *data)
+{
+    source_t		*sp = (source_t *)data;
+    __uint64_t		*values = (__uint64_t *)buffer;
+    pmAtomValue		atom;
+    int			i, sts;
+
+    if (size != sp->nfields * sizeof(__uint64_t))
+	return 0;
+    if ((sts = pmdaEventAddRecord(eventarray, timestamp, PM_EVENT_FLAG_POINT)) < 0)
+	return sts;
+    for (i = 0; i < sp->nfields; i++) {
+	atom.ull = values[i];
+	if ((sts = pmdaEventAddParam(eventarray,
+			pmID_build(domain, (sp - sources) + 1, i + 1),
+			PM_TYPE_U64, &atom)) < 0)
+	    return sts;
+    }
+    return 1;
+}
+
+static int
+hifreq_fetchCallBack(pmdaMetric *mdesc, unsigned int inst, pmAtomValue *atom)
+{
+    unsigned int	cluster = pmID_cluster(mdesc->m_desc.pmid);
+    unsigned int	item = pmID_item(mdesc->m_desc.pmid);
+    source_t		*sp;
+    int			i, sts;
+
+    if (inst != PM_IN_NULL)
+	return PM_ERR_INST;
+
+    if (cluster == CLUSTER_CONTROL) {
+	switch (item) {
+	case CONTROL_INTERVAL:
+	    atom->ul = interval;
+	    break;
+	case CONTROL_NUMCLIENTS:
+	    return pmdaEventClients(atom);
+	case CONTROL_MAXMEM:
+	    atom->ull = maxmem;
+	    break;
+	case CONTROL_SAMPLES:
+	    atom->ull = 0;
+	    for (i = 0; i < NUM_SOURCES; i++)
+		atom->ull += sources[i].samples;
+	    break;
+	case CONTROL_OVERRUNS:
+	    atom->ull = overruns;
+	    break;
+	default:
+	    return PM_ERR_PMID;
+	}
+	return PMDA_FETCH_STATIC;
+    }
+
+    if (cluster > NUM_SOURCES)
+	return PM_ERR_PMID;
+    sp = &sources[cluster - 1];
+    if (item != 0)
+	return PMDA_FETCH_NOVALUES;	/* event record parameters only */
+    if (sp->queue < 0)
+	return PMDA_FETCH_NOVALUES;
+    if ((sts = pmdaEventSetAccess(pmdaGetContext(), sp->queue, 1)) < 0)
+	return sts;
+    return pmdaEventQueueRecords(sp->queue, atom, pmdaGetContext(),
+				 hifreq_decoder, sp);
+}
+
+static int
+hifreq_fetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
+{
+    pmdaEventNewClient(pmda->e_context);
+    return pmdaFetch(numpmid, pmidlist, resp, pmda);
+}
+
+static int
+hifreq_store(pmResult *result, pmdaExt *pmda)
+{
+    pmValueSet		*vsp;
+    pmAtomValue		av;
+    int			i, sts;
+
+    for (i = 0; i < result->numpmid; i++) {
+	vsp = result->vset[i];
+	if (pmID_cluster(vsp->pmid) != CLUSTER_CONTROL ||
+	    pmID_item(vsp->pmid) != CONTROL_INTERVAL)
+	    return PM_ERR_PERMISSION;
+	if (vsp->numval != 1)
+	    return PM_ERR_BADSTORE;
+	if ((sts = pmExtractValue(vsp->valfmt, &vsp->vlist[0],
+			PM_TYPE_U32, &av, PM_TYPE_U32)) < 0)
+	    return sts;
+	if (av.ul < 1 || av.ul > 1000)
+	    return PM_ERR_BADSTORE;
+	interval = av.ul;
+	pmNotifyErr(LOG_INFO, "sampling interval set to %u msec", interval);
+    }
+    return 0;
+}
+
+static void
+hifreq_end_contextCallBack(int context)
+{
+    pmdaEventEndClient(context);
+}
+
+static void
+hifreq_init(pmdaInterface *dp)
+{
+    source_t		*sp;
+    int			i, j;
+
+    domain = dp->domain;
+    dp->version.four.fetch = hifreq_fetch;
+    dp->version.four.store = hifreq_store;
+    pmdaSetFetchCallBack(dp, hifreq_fetchCallBack);
+    pmdaSetEndContextCallBack(dp, hifreq_end_contextCallBack);
+    pmdaInit(dp, NULL, 0, metrictab, sizeof(metrictab)/sizeof(metrictab[0]));
+
+    for (i = 0; i < NUM_SOURCES; i++) {
+	sp = &sources[i];
+	for (j = 0; j < 3; j++) {
+	    if (sp->paths[j] == NULL)
+		sp->fds[j] = -1;
+	    else if ((sp->fds[j] = open(sp->paths[j], O_RDONLY)) < 0)
+		pmNotifyErr(LOG_INFO, "%s source: cannot open %s: %s",
+				sp->name, sp->paths[j], osstrerror());
+	}
+	if ((sp->queue = pmdaEventNewQueue(sp->name, maxmem)) < 0)
+	    pmNotifyErr(LOG_ERR, "%s source: pmdaEventNewQueue failed: %s",
+				sp->name, pmErrStr(sp->queue));
+    }
+}
+
+static long long
+monotonic_usec(void)
+{
+    struct timespec	now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/*
+ * Main loop - pmcd requests are serviced in between samples, which are
+ * scheduled on a fixed grid so that service time does not accumulate as
+ * drift.  Ticks missed entirely (e.g. behind a slow request) are skipped
+ * and counted, rather than being taken late in a burst.
+ */
+static void
+hifreq_main(pmdaInterface *dispatch)
+{
+    struct timeval	timeout;
+    long long		next, now, step;
+    fd_set		fds, readyfds;
+    int			pmcdfd, nready;
+
+    if ((pmcdfd = __pmdaInFd(dispatch)) < 0)
+	exit(1);
+    FD_ZERO(&fds);
+    FD_SET(pmcdfd, &fds);
+
+    next = monotonic_usec();
+    for (;;) {
+	step = interval * 1000LL;
+	now = monotonic_usec();
+	if (now >= next) {
+	    hifreq_sample();
+	    next += step;
+	    if ((now = monotonic_usec()) >= next) {
+		overruns += (now - next) / step + 1;
+		next += ((now - next) / step + 1) * step;
+	    }
+	}
+	timeout.tv_sec = (next - now) / 1000000;
+	timeout.tv_usec = (next - now) % 1000000;
+
+	memcpy(&readyfds, &fds, sizeof(readyfds));
+	nready = select(pmcdfd+1, &readyfds, NULL, NULL, &timeout);
+	if (nready < 0) {
+	    if (neterror() != EINTR) {
+		pmNotifyErr(LOG_ERR, "select failure: %s", netstrerror());
+		exit(1);
+	    }
+	    continue;
+	}
+	if (nready > 0 && FD_ISSET(pmcdfd, &readyfds)) {
+	    if (__pmdaMainPDU(dispatch) < 0)
+		exit(1);	/* fatal if we lose pmcd */
+	}
+    }
+}
+
+static void
+convertUnits(char **endnum, long *mem)
+{
+    switch ((int) **endnum) {
+	case 'b':
+	case 'B':
+		break;
+	case 'k':
+	case 'K':
+		*mem *= 1024;
+		break;
+	case 'm':
+	case 'M':
+		*mem *= 1024 * 1024;
+		break;
+	case 'g':
+	case 'G':
+		*mem *= 1024 * 1024 * 1024;
+		break;
+    }
+    (*endnum)++;
+}
+
+static pmLongOptions longopts[] = {
+    PMDA_OPTIONS_HEADER("Options"),
+    PMOPT_DEBUG,
+    PMDAOPT_DOMAIN,
+    PMDAOPT_LOGFILE,
+    { "maxmem", 1, 'm', "MEMORY", "maximum memory used per queue (default 2MB)" },
+    { "interval", 1, 's', "MSEC", "sampling interval in milliseconds (default 10)" },
+    PMDAOPT_USERNAME,
+    PMOPT_HELP,
+    PMDA_OPTIONS_END
+};
+
+static pmdaOptions opts = {
+    .short_options = "D:d:l:m:s:U:?",
+    .long_options = longopts,
+};
+
+int
+main(int argc, char **argv)
+{
+    static char		helppath[MAXPATHLEN];
+    pmdaInterface	dispatch;
+    char		*endnum;
+    long		minmem;
+    int			c, sep = pmPathSeparator();
+
+    minmem = getpagesize();
+    maxmem = (minmem > DEFAULT_MAXMEM) ? minmem : DEFAULT_MAXMEM;
+    pmSetProgname(argv[0]);
+    pmGetUsername(&username);
+
+    pmsprintf(helppath, sizeof(helppath), "%s%c" "hifreq" "%c" "help",
+		pmGetConfig("PCP_PMDAS_DIR"), sep, sep);
+    pmdaDaemon(&dispatch, PMDA_INTERFACE_5, pmGetProgname(), HIFREQ,
+		"hifreq.log", helppath);
+
+    while ((c = pmdaGetOptions(argc, argv, &opts, &dispatch)) != EOF) {
+	switch (c) {
+	case 'm':
+	    maxmem = strtol(opts.optarg, &endnum, 10);
+	    if (*endnum != '\0')
+		convertUnits(&endnum, &maxmem);
+	    if (*endnum != '\0' || maxmem < minmem) {
+		pmprintf("%s: invalid max memory '%s' (min=%ld)\n",
+			pmGetProgname(), opts.optarg, minmem);
+		opts.errors++;
+	    }
+	    break;
+	case 's':
+	    interval = (unsigned int)strtoul(opts.optarg, &endnum, 10);
+	    if (*endnum != '\0' || interval < 1 || interval > 1000) {
+		pmprintf("%s: -s requires an interval of 1 to 1000 msec\n",
+			pmGetProgname());
+		opts.errors++;
+	    }
+	    break;
+	}
+    }
+    if (opts.errors) {
+	pmdaUsageMessage(&opts);
+	exit(1);
+    }
+    if (opts.username)
+	username = opts.username;
+
+    pmdaOpenLog(&dispatch);
+    pmSetProcessIdentity(username);
+    pmdaConnect(&dispatch);
+    hifreq_init(&dispatch);
+    hifreq_main(&dispatch);
+    exit(0);
+}
@@ -2,7 +2,7 @@
  * Configurable Kernel Virtual Machine (KVM) PMDA
  *
  * Copyright (c) 2018 Fujitsu.
- * Copyright (c) 2018,2020,2022 Red Hat.
+ * Copyright (c) 2018,2020,2022,2026 Red Hat.
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms of the GNU General Public License as published by the
@@ -20,6 +20,7 @@
 #include "domain.h"
 #include "kvmstat.h"
 #include <dirent.h>
+#include <fcntl.h>
 #include <sys/ioctl.h>
 #ifdef HAVE_LINUX_PERF_EVENT_H
 #include <asm/unistd.h>
@@ -217,44 +218,96 @@ typedef struct kvm_debug {
 } kvm_debug_value_t;
 static kvm_debug_value_t kvmstat;
 
+/*
+ * Each statistic is a file below debugfs/kvm, summed over all VMs (the
+ * per-VM directories alongside it are not used).  The files are located
+ * once and kept open, each refresh rereading them from the start with
+ * pread(2), rather than scanning the directory (which grows with every
+ * VM) and opening each file on every fetch.
+ */
+static int kvm_debug_fd[KVM_DEBUG_COUNT];
+static int kvm_debug_setup;
+
+static void
+kvm_debug_close(void)
+{
+    int			i;
+
+    for (i = 0; i < KVM_DEBUG_COUNT; i++) {
+	if (kvm_debug_setup && kvm_debug_fd[i] >= 0)
+	    close(kvm_debug_fd[i]);
+	kvm_debug_fd[i] = -1;
+    }
+    kvm_debug_setup = 0;
+}
+
 static int
-kvm_debug_refresh(kvm_debug_value_t *kvm)
+kvm_debug_open(void)
 {
     struct dirent	*de;
-    FILE   		*fp;
     DIR			*kvm_dir;
-    char		buffer[256];
     char		path[MAXPATHLEN];
-    int			i, sts = 0;
-
-    if (kernel_lockdown)
-	return PM_ERR_PERMISSION;
+    int			i, found = 0;
 
+    kvm_debug_close();
     pmsprintf(path, sizeof(path), "%s/kvm", debugfs);
     if ((kvm_dir = opendir(path)) == NULL)
 	return -oserror();
+    kvm_debug_setup = 1;
 
-    while ((de = readdir(kvm_dir)) != NULL) {   
-	if (!strncmp(de->d_name, ".", 1))
+    while ((de = readdir(kvm_dir)) != NULL) {
+	/* per-VM directories (pid-fd) never match a metric name */
+	for (i = 0; i < KVM_DEBUG_COUNT; i++) {
+	    if (strcmp(de->d_name, metrictab[i].m_user) == 0)
+		break;
+	}
+	if (i == KVM_DEBUG_COUNT || kvm_debug_fd[i] >= 0)
 	    continue;
-
 	pmsprintf(path, sizeof(path), "%s/kvm/%s", debugfs, de->d_name);
-	path[sizeof(path)-1] = '\0';
-	if ((fp = fopen(path, "r")) == NULL) {
+	if ((kvm_debug_fd[i] = open(path, O_RDONLY)) < 0) {
+	    if (pmDebugOptions.appl0)
+		pmNotifyErr(LOG_DEBUG, "kvm_debug_open: %s: %s",
+			    path, osstrerror());
+	    continue;
+	}
+	found++;
+    }
+    closedir(kvm_dir);
+
+    if (pmDebugOptions.appl0)
+	pmNotifyErr(LOG_DEBUG, "kvm_debug_open: %d of %d statistics in %s/kvm",
+			found, KVM_DEBUG_COUNT, debugfs);
+    return found;
+}
+
+static int
+kvm_debug_refresh(kvm_debug_value_t *kvm)
+{
+    char		buffer[64];
+    ssize_t		bytes;
+    int			i, sts = 0;
+
+    if (kernel_lockdown)
+	return PM_ERR_PERMISSION;
+
+    /* no statistics (KVM not loaded) - look again on the next fetch */
+    if (!kvm_debug_setup && (sts = kvm_debug_open()) <= 0) {
+	kvm_debug_close();
+	return sts;
+    }
+
+    for (i = 0; i < KVM_DEBUG_COUNT; i++) {
+	if (kvm_debug_fd[i] < 0)
+	    continue;
+	if ((bytes = pread(kvm_debug_fd[i], buffer, sizeof(buffer)-1, 0)) < 0) {
+	    /* files removed (kvm module unloaded) - locate them afresh */
 	    sts = -oserror();
+	    kvm_debug_close();
 	    break;
 	}
-
-        if (fgets(buffer, sizeof(buffer), fp) != NULL) {
-	    for (i = 0; i < KVM_DEBUG_COUNT; i++) {
-		if (strcmp(de->d_name, metrictab[i].m_user) != 0)
-		    continue;
-		kvm->value[i] = strtoull(buffer, NULL, 0);
-	    }
-        }
-        fclose(fp);
-    } 
-    closedir(kvm_dir);
+	buffer[bytes] = '\0';
+	kvm->value[i] = strtoull(buffer, NULL, 0);
+    }
     return sts;
 }
 
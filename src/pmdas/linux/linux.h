@@ -114,6 +114,7 @@ enum {
 	CLUSTER_NET_ALL,	/* 90 /proc/net/dev aggregate metrics */
 	CLUSTER_FCHOST,		/* 91 /sys/class/fc_host metrics */
 	CLUSTER_WWID,		/* 92 multipath aggregated stats */
+	CLUSTER_REFRESH,	/* 93 PMDA refresh instrumentation */
 
 	NUM_CLUSTERS		/* one more than highest numbered cluster */
 };
@@ -137,6 +138,8 @@ enum {
 	REFRESH_PROC_DISKSTATS,
 	REFRESH_PROC_PARTITIONS,
 
+	REFRESH_PROC_STAT_PERCPU,
+
 	NUM_REFRESHES		/* one more than highest refresh index */
 };
 
@@ -187,6 +190,7 @@ enum {
 	INTERRUPT_CPU_INDOM,	/* 40 - per-CPU interrupt lines */
 	SOFTIRQ_CPU_INDOM,	/* 41 - per-CPU soft IRQs */
 	WWID_INDOM,		/* 42 - per-WWID multipath device */
+	REFRESH_INDOM,		/* 43 - PMDA refresh clusters */
 
 	NUM_INDOMS		/* one more than highest numbered cluster */
 };
@@ -211,6 +215,29 @@ extern int linux_test_mode;
  */
 extern char *linux_statspath;
 extern FILE *linux_statsfile(const char *, char *, int);
+
+/*
+ * Reusable whole-file buffers for frequently refreshed procfs files.
+ */
+typedef struct linux_statsbuf {
+    const char	*path;		/* e.g. "/proc/meminfo" */
+    int		fd;		/* kept open across refreshes, or -1 */
+    int		line;		/* number of lines returned so far */
+    size_t	size;		/* allocated size of buf */
+    size_t	length;		/* length of file contents in buf */
+    size_t	offset;		/* start of the next line in buf */
+    char	*buf;
+    int		nhints;		/* linux_statsbuf_field lookup hints */
+    int		*hints;
+} linux_statsbuf_t;
+
+#define LINUX_STATSBUF(file)	{ .path = (file), .fd = -1 }
+
+extern int linux_statsbuf_read(linux_statsbuf_t *);
+extern char *linux_statsbuf_line(linux_statsbuf_t *);
+extern char *linux_statsbuf_gets(char *, int, linux_statsbuf_t *);
+extern int linux_statsbuf_field(linux_statsbuf_t *, const char *,
+		const void *, size_t);
 extern char *linux_mdadm;
 
 /*
@@ -0,0 +1,151 @@
+/*
+ * Buffered access to procfs statistics files
+ *
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+#include <fcntl.h>
+#include "linux.h"
+
+/*
+ * Read the entire file into a buffer reused across refreshes.  The file
+ * descriptor is kept open until exit (unless testing) and re-read from
+ * the start with pread(2), which regenerates procfs file contents, so a
+ * refresh costs a few large reads rather than open, stdio and close.
+ */
+int
+linux_statsbuf_read(linux_statsbuf_t *sp)
+{
+    char	path[MAXPATHLEN], *p;
+    size_t	size;
+    ssize_t	n;
+    int		sts;
+
+    /* in test mode we replace procfs files (keeping fd open thwarts that) */
+    if (sp->fd >= 0 && (linux_test_mode & LINUX_TEST_STATSPATH)) {
+	close(sp->fd);
+	sp->fd = -1;
+    }
+    if (sp->fd < 0) {
+	pmsprintf(path, sizeof(path), "%s%s", linux_statspath, sp->path);
+	if ((sp->fd = open(path, O_RDONLY|O_CLOEXEC)) < 0)
+	    return -oserror();
+    }
+
+    sp->length = sp->offset = 0;
+    sp->line = 0;
+    for (;;) {
+	if (sp->length + 1 >= sp->size) {
+	    size = sp->size ? sp->size * 2 : 8192;
+	    if ((p = (char *)realloc(sp->buf, size)) == NULL)
+		return -ENOMEM;
+	    sp->buf = p;
+	    sp->size = size;
+	}
+	n = pread(sp->fd, sp->buf + sp->length,
+		  sp->size - sp->length - 1, sp->length);
+	if (n < 0) {
+	    sts = -oserror();
+	    close(sp->fd);
+	    sp->fd = -1;
+	    return sts;
+	}
+	if (n == 0)
+	    break;
+	sp->length += n;
+    }
+    sp->buf[sp->length] = '\0';
+    return sp->length;
+}
+
+/*
+ * Return the next line of the buffer in place, newline removed.
+ */
+char *
+linux_statsbuf_line(linux_statsbuf_t *sp)
+{
+    char	*start, *end;
+
+    if (sp->offset >= sp->length)
+	return NULL;
+    start = sp->buf + sp->offset;
+    if ((end = memchr(start, '\n', sp->length - sp->offset)) != NULL) {
+	*end = '\0';
+	sp->offset = end - sp->buf + 1;
+    } else {
+	sp->offset = sp->length;
+    }
+    sp->line++;
+    return start;
+}
+
+/*
+ * Copy the next line of the buffer, with fgets(3) semantics.
+ */
+char *
+linux_statsbuf_gets(char *line, int size, linux_statsbuf_t *sp)
+{
+    char	*start, *end;
+    size_t	n;
+
+    if (sp->offset >= sp->length || size <= 1)
+	return NULL;
+    start = sp->buf + sp->offset;
+    n = sp->length - sp->offset;
+    if (n > size - 1)
+	n = size - 1;
+    if ((end = memchr(start, '\n', n)) != NULL)
+	n = end - start + 1;
+    memcpy(line, start, n);
+    line[n] = '\0';
+    sp->offset += n;
+    sp->line++;
+    return line;
+}
+
+/*
+ * Find the index of a field name in a NULL-terminated table of
+ * structures, each starting with a (char *) name pointer.  Procfs
+ * files list fields in the same order from one refresh to the next,
+ * so the index found for each line number is remembered and tried
+ * first next time - usually avoiding a linear search of the table.
+ */
+int
+linux_statsbuf_field(linux_statsbuf_t *sp, const char *name,
+		const void *table, size_t stride)
+{
+    const char	*field;
+    int		i, line = sp->line - 1, *hints;
+
+#define FIELD(i) (*(const char **)((const char *)table + (i) * stride))
+
+    if (line >= 0 && line < sp->nhints && (i = sp->hints[line]) >= 0 &&
+	strcmp(name, FIELD(i)) == 0)
+	return i;	/* fast-path, field found where expected */
+
+    for (i = 0; (field = FIELD(i)) != NULL; i++)
+	if (strcmp(name, field) == 0)
+	    break;
+    if (field == NULL)
+	i = -1;
+
+    if (line >= sp->nhints) {
+	if ((hints = (int *)realloc(sp->hints, (line + 64) * sizeof(int))) == NULL)
+	    return i;
+	while (sp->nhints < line + 64)
+	    hints[sp->nhints++] = -1;
+	sp->hints = hints;
+    }
+    if (line >= 0)
+	sp->hints[line] = i;
+    return i;
+}
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2014-2016 Red Hat.
+ * Copyright (c) 2014-2016,2026 Red Hat.
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms of the GNU General Public License as published by the
@@ -15,6 +15,10 @@
 #include "pmdaroot.h"
 #include "namespaces.h"
 #include <sched.h>
+#if defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#include <signal.h>
+#endif
 
 #if defined(HAVE_SETNS)
 
@@ -197,6 +201,294 @@ container_close(linux_container_t *cp, int openfds)
     return 0;
 }
 
+#if defined(HAVE_PTHREAD_H) && defined(HAVE___THREAD)
+
+/*
+ * Namespace worker threads.  Rather than switching the whole PMDA in
+ * and out of a container namespace with a pair of setns(2) calls on
+ * every refresh, one thread per namespace is started for a container
+ * the first time it is needed.  It joins that namespace once and then
+ * stays there, running refresh jobs on behalf of the main thread for
+ * as long as any client context refers to the container.
+ *
+ * Threads only ever run a job while the main thread waits for it, so
+ * the refresh code sees no more concurrency than it did before.
+ */
+typedef struct container_worker {
+    pthread_t		thread;
+    int			started;
+    int			ready;		/* namespace joined, or failed */
+    int			status;		/* from joining the namespace */
+    int			quit;
+    container_func_t	func;		/* job for this worker, if any */
+    linux_container_t	*cp;
+    void		*arg;
+    struct container_ns	*ns;
+} container_worker_t;
+
+typedef struct container_ns {
+    int			pid;
+    int			refcount;
+    pthread_mutex_t	lock;
+    pthread_cond_t	cond;
+    container_worker_t	workers[LINUX_NAMESPACE_COUNT];
+    struct container_ns	*next;
+} container_ns_t;
+
+static container_ns_t	*container_nslist;
+
+static const char	*namespace_names[LINUX_NAMESPACE_COUNT] = {
+    "ipc", "uts", "net", "mnt", "user"
+};
+
+/* set in the thread that has joined a container network namespace */
+static __thread int	container_netns;
+
+int
+container_thread_netns(void)
+{
+    return container_netns;
+}
+
+static int
+worker_nsenter(container_worker_t *wp, int index)
+{
+    char	process[32];
+    int		fd, sts = 0;
+
+    /* the filesystem context is shared by all threads unless unshared */
+    if (index == LINUX_NAMESPACE_MNT_INDEX && unshare(CLONE_FS) < 0)
+	return -oserror();
+
+    pmsprintf(process, sizeof(process), "%d", wp->ns->pid);
+    if ((fd = namespace_open(process, namespace_names[index])) < 0)
+	return -oserror();
+    if (setns(fd, 0) < 0)
+	sts = -oserror();
+    close(fd);
+
+    if (sts == 0 && index == LINUX_NAMESPACE_NET_INDEX)
+	container_netns = 1;
+    return sts;
+}
+
+static void *
+container_worker(void *arg)
+{
+    container_worker_t	*wp = (container_worker_t *)arg;
+    container_ns_t	*ns = wp->ns;
+    int			sts;
+
+    sts = worker_nsenter(wp, wp - ns->workers);
+
+    pthread_mutex_lock(&ns->lock);
+    wp->status = sts;
+    wp->ready = 1;
+    pthread_cond_broadcast(&ns->cond);
+    while (sts == 0) {
+	while (wp->func == NULL && !wp->quit)
+	    pthread_cond_wait(&ns->cond, &ns->lock);
+	if (wp->quit)
+	    break;
+	pthread_mutex_unlock(&ns->lock);
+	wp->func(wp->cp, wp->arg);
+	pthread_mutex_lock(&ns->lock);
+	wp->func = NULL;
+	pthread_cond_broadcast(&ns->cond);
+    }
+    pthread_mutex_unlock(&ns->lock);
+    return NULL;
+}
+
+static int
+container_worker_start(container_worker_t *wp)
+{
+    container_ns_t	*ns = wp->ns;
+    sigset_t		mask, save;
+    int			sts;
+
+    /* signals are for the main thread, workers inherit a blocked mask */
+    sigfillset(&mask);
+    pthread_sigmask(SIG_SETMASK, &mask, &save);
+    wp->ready = wp->quit = 0;
+    sts = pthread_create(&wp->thread, NULL, container_worker, wp);
+    pthread_sigmask(SIG_SETMASK, &save, NULL);
+    if (sts != 0)
+	return -sts;
+
+    pthread_mutex_lock(&ns->lock);
+    while (!wp->ready)
+	pthread_cond_wait(&ns->cond, &ns->lock);
+    sts = wp->status;
+    pthread_mutex_unlock(&ns->lock);
+
+    if (sts < 0) {
+	/* thread has exited, try again on the next refresh */
+	pthread_join(wp->thread, NULL);
+	if (pmDebugOptions.libpmda)
+	    pmNotifyErr(LOG_DEBUG, "container %d %s namespace: %s\n",
+			ns->pid, namespace_names[wp - ns->workers],
+			pmErrStr(sts));
+	return sts;
+    }
+    wp->started = 1;
+    return 0;
+}
+
+static container_ns_t *
+container_ns_attach(int pid)
+{
+    container_ns_t	*ns;
+    int			i;
+
+    for (ns = container_nslist; ns; ns = ns->next) {
+	if (ns->pid == pid) {
+	    ns->refcount++;
+	    return ns;
+	}
+    }
+    if ((ns = (container_ns_t *)calloc(1, sizeof(*ns))) == NULL)
+	return NULL;
+    ns->pid = pid;
+    ns->refcount = 1;
+    pthread_mutex_init(&ns->lock, NULL);
+    pthread_cond_init(&ns->cond, NULL);
+    for (i = 0; i < LINUX_NAMESPACE_COUNT; i++)
+	ns->workers[i].ns = ns;
+    ns->next = container_nslist;
+    container_nslist = ns;
+    return ns;
+}
+
+static void
+container_ns_detach(container_ns_t *ns)
+{
+    container_ns_t	*np, *prev = NULL;
+    int			i;
+
+    if (--ns->refcount > 0)
+	return;
+
+    for (np = container_nslist; np; prev = np, np = np->next) {
+	if (np != ns)
+	    continue;
+	if (prev)
+	    prev->next = ns->next;
+	else
+	    container_nslist = ns->next;
+	break;
+    }
+
+    pthread_mutex_lock(&ns->lock);
+    for (i = 0; i < LINUX_NAMESPACE_COUNT; i++)
+	ns->workers[i].quit = 1;
+    pthread_cond_broadcast(&ns->cond);
+    pthread_mutex_unlock(&ns->lock);
+    for (i = 0; i < LINUX_NAMESPACE_COUNT; i++) {
+	if (ns->workers[i].started)
+	    pthread_join(ns->workers[i].thread, NULL);
+    }
+    pthread_cond_destroy(&ns->cond);
+    pthread_mutex_destroy(&ns->lock);
+    free(ns);
+}
+
+/*
+ * Run func in the given (single) namespace of a container, using the
+ * worker thread for that namespace.  Returns a negative error code if
+ * the namespace could not be joined, in which case func is not run.
+ * If no worker thread can be created, fall back to the setns(2) round
+ * trip from the calling thread.
+ */
+int
+container_run(linux_container_t *cp, int nsflags, int *openfds,
+		container_func_t func, void *arg)
+{
+    container_worker_t	*wp;
+    container_ns_t	*ns;
+    int			index, sts;
+
+    if (!cp) {
+	func(cp, arg);
+	return 0;
+    }
+
+    index = ffs(nsflags) - 1;
+    if (nsflags != (1 << index) || index == LINUX_NAMESPACE_USER_INDEX)
+	goto fallback;	/* cannot join a user namespace when threaded */
+
+    if (cp->ns && cp->ns->pid != cp->pid)
+	container_release(cp);
+    if (cp->ns == NULL && (cp->ns = container_ns_attach(cp->pid)) == NULL)
+	goto fallback;
+    ns = cp->ns;
+    wp = &ns->workers[index];
+
+    if (!wp->started && (sts = container_worker_start(wp)) < 0) {
+	if (sts == -EAGAIN)
+	    goto fallback;
+	return sts;
+    }
+
+    pthread_mutex_lock(&ns->lock);
+    wp->cp = cp;
+    wp->arg = arg;
+    wp->func = func;
+    pthread_cond_broadcast(&ns->cond);
+    while (wp->func != NULL)
+	pthread_cond_wait(&ns->cond, &ns->lock);
+    pthread_mutex_unlock(&ns->lock);
+    return 0;
+
+fallback:
+    if ((sts = container_nsenter(cp, nsflags, openfds)) < 0)
+	return sts;
+    func(cp, arg);
+    container_nsleave(cp, nsflags);
+    return 0;
+}
+
+/*
+ * Drop a context reference to its container namespace workers,
+ * stopping the threads once no context refers to them any more
+ */
+void
+container_release(linux_container_t *cp)
+{
+    if (cp->ns) {
+	container_ns_detach(cp->ns);
+	cp->ns = NULL;
+    }
+}
+
+#else /* !HAVE_PTHREAD_H || !HAVE___THREAD */
+
+int
+container_run(linux_container_t *cp, int nsflags, int *openfds,
+		container_func_t func, void *arg)
+{
+    int		sts;
+
+    if ((sts = container_nsenter(cp, nsflags, openfds)) < 0)
+	return sts;
+    func(cp, arg);
+    container_nsleave(cp, nsflags);
+    return 0;
+}
+
+void
+container_release(linux_container_t *cp)
+{
+    (void)cp;
+}
+
+int
+container_thread_netns(void)
+{
+    return 0;
+}
+#endif /* HAVE_PTHREAD_H && HAVE___THREAD */
+
 #else /* !HAVE_SETNS */
 
 /*
@@ -235,6 +527,28 @@ container_close(linux_container_t *cp, int openfds)
     (void)cp;
     return 0;
 }
+
+int
+container_run(linux_container_t *cp, int nsflags, int *openfds,
+		container_func_t func, void *arg)
+{
+    (void)openfds;
+    (void)nsflags;
+    func(cp, arg);
+    return 0;
+}
+
+void
+container_release(linux_container_t *cp)
+{
+    (void)cp;
+}
+
+int
+container_thread_netns(void)
+{
+    return 0;
+}
 #endif /* !HAVE_SETNS */
 
 int
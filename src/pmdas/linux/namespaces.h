@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2014-2015 Red Hat.
+ * Copyright (c) 2014-2015,2026 Red Hat.
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms of the GNU General Public License as published by the
@@ -28,13 +28,18 @@ enum {
 #define LINUX_NAMESPACE_MNT      (1<<LINUX_NAMESPACE_MNT_INDEX)
 #define LINUX_NAMESPACE_USER     (1<<LINUX_NAMESPACE_USER_INDEX)
 
+struct container_ns;
+
 typedef struct linux_container {
     int		pid;
     int		netfd;
     int		length;
     char	*name;
+    struct container_ns	*ns;	/* namespace worker threads */
 } linux_container_t;
 
+typedef void (*container_func_t)(linux_container_t *, void *);
+
 extern int container_lookup(int, linux_container_t *);
 extern int container_close(linux_container_t *, int);
 
@@ -44,3 +49,7 @@ extern void container_close_network(linux_container_t *);
 extern int container_nsenter(linux_container_t *, int, int *);
 extern int container_nsleave(linux_container_t *, int);
 
+extern int container_run(linux_container_t *, int, int *, container_func_t, void *);
+extern void container_release(linux_container_t *);
+extern int container_thread_netns(void);
+
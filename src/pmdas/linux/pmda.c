@@ -371,6 +371,7 @@ static pmdaIndom indomtab[] = {
     { INTERRUPT_CPU_INDOM, 0, NULL },
     { SOFTIRQ_CPU_INDOM, 0, NULL },
     { WWID_INDOM, 0, NULL },
+    { REFRESH_INDOM, 0, NULL },
 };
 
 
@@ -2628,6 +2629,16 @@ static pmdaMetric metrictab[] = {
     { PMDA_PMID(CLUSTER_KERNEL_UNAME, 6), PM_TYPE_STRING, PM_INDOM_NULL, PM_SEM_DISCRETE, 
     PMDA_PMUNITS(0,0,0,0,0,0) } },
 
+/* pmda.refresh.count */
+  { NULL,
+    { PMDA_PMID(CLUSTER_REFRESH, 0), PM_TYPE_U64, REFRESH_INDOM, PM_SEM_COUNTER, 
+    PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) } },
+
+/* pmda.refresh.time */
+  { NULL,
+    { PMDA_PMID(CLUSTER_REFRESH, 1), PM_TYPE_U64, REFRESH_INDOM, PM_SEM_COUNTER, 
+    PMDA_PMUNITS(0,1,0,0,PM_TIME_USEC,0) } },
+
 /* kernel.uname.distro */
   { NULL,
     { PMDA_PMID(CLUSTER_KERNEL_UNAME, 7), PM_TYPE_STRING, PM_INDOM_NULL, PM_SEM_DISCRETE, 
@@ -7070,7 +7081,15 @@ char *linux_mdadm = "/sbin/mdadm"; /* program for extracting MD RAID status */
 FILE *
 linux_statsfile(const char *path, char *buffer, int size)
 {
-    pmsprintf(buffer, size, "%s%s", linux_statspath, path);
+    /*
+     * /proc/net follows the network namespace of the thread group
+     * leader, so a container namespace worker thread needs its own.
+     */
+    if (strncmp(path, "/proc/net/", 10) == 0 && container_thread_netns())
+	pmsprintf(buffer, size, "%s/proc/thread-self/net/%s",
+			linux_statspath, path + 10);
+    else
+	pmsprintf(buffer, size, "%s%s", linux_statspath, path);
     return fopen(buffer, "r");
 }
 
@@ -7090,12 +7109,223 @@ linux_ctx_container(int ctx)
     return NULL;
 }
 
+/*
+ * Per-cluster refresh counts and times, exported as pmda.refresh.*
+ */
+typedef struct {
+    __uint64_t		count;
+    __uint64_t		time;		/* microseconds */
+} refresh_stats_t;
+
+static refresh_stats_t refresh_stats[NUM_CLUSTERS];
+
+static const char *refresh_names[NUM_CLUSTERS] = {
+    [CLUSTER_PARTITIONS]	= "partitions",
+    [CLUSTER_STAT]		= "stat",
+    [CLUSTER_CPUINFO]		= "cpuinfo",
+    [CLUSTER_MEMINFO]		= "meminfo",
+    [CLUSTER_NUMA_MEMINFO]	= "numa_meminfo",
+    [CLUSTER_LOADAVG]		= "loadavg",
+    [CLUSTER_NET_NFS]		= "net_rpc",
+    [CLUSTER_NET_DEV]		= "net_dev",
+    [CLUSTER_NET_SOCKSTAT]	= "net_sockstat",
+    [CLUSTER_NET_SOCKSTAT6]	= "net_sockstat6",
+    [CLUSTER_NET_SNMP]		= "net_snmp",
+    [CLUSTER_NET_SNMP6]		= "net_snmp6",
+    [CLUSTER_NET_RAW]		= "net_raw",
+    [CLUSTER_NET_RAW6]		= "net_raw6",
+    [CLUSTER_NET_TCP]		= "net_tcp",
+    [CLUSTER_NET_TCP6]		= "net_tcp6",
+    [CLUSTER_NET_UDP]		= "net_udp",
+    [CLUSTER_NET_UDP6]		= "net_udp6",
+    [CLUSTER_NET_UNIX]		= "net_unix",
+    [CLUSTER_NET_NETSTAT]	= "net_netstat",
+    [CLUSTER_FILESYS]		= "filesys",
+    [CLUSTER_INTERRUPTS]	= "interrupts",
+    [CLUSTER_SOFTIRQS]		= "softirqs",
+    [CLUSTER_SWAPDEV]		= "swaps",
+    [CLUSTER_SCSI]		= "scsi",
+    [CLUSTER_SLAB]		= "slabinfo",
+    [CLUSTER_SEM_LIMITS]	= "sem_limits",
+    [CLUSTER_MSG_LIMITS]	= "msg_limits",
+    [CLUSTER_SHM_INFO]		= "shm_info",
+    [CLUSTER_SEM_INFO]		= "sem_info",
+    [CLUSTER_MSG_INFO]		= "msg_info",
+    [CLUSTER_SHM_LIMITS]	= "shm_limits",
+    [CLUSTER_UPTIME]		= "uptime",
+    [CLUSTER_UTMP]		= "utmp",
+    [CLUSTER_VFS]		= "sys_fs",
+    [CLUSTER_LOCKS]		= "locks",
+    [CLUSTER_SYS_KERNEL]	= "sys_kernel",
+    [CLUSTER_VMSTAT]		= "vmstat",
+    [CLUSTER_SYSFS_KERNEL]	= "sysfs_kernel",
+    [CLUSTER_NET_SOFTNET]	= "net_softnet",
+    [CLUSTER_SHM_STAT]		= "shm_stat",
+    [CLUSTER_MSG_STAT]		= "msg_stat",
+    [CLUSTER_SEM_STAT]		= "sem_stat",
+    [CLUSTER_BUDDYINFO]		= "buddyinfo",
+    [CLUSTER_ZONEINFO]		= "zoneinfo",
+    [CLUSTER_KSM_INFO]		= "ksm",
+    [CLUSTER_TAPEDEV]		= "tapestats",
+    [CLUSTER_TTY]		= "tty",
+    [CLUSTER_PRESSURE_CPU]	= "pressure_cpu",
+    [CLUSTER_PRESSURE_MEM]	= "pressure_memory",
+    [CLUSTER_PRESSURE_IO]	= "pressure_io",
+    [CLUSTER_FCHOST]		= "fc_host",
+};
+
+static void
+refresh_done(int cluster, struct timeval *start)
+{
+    refresh_stats_t	*rp = &refresh_stats[cluster];
+    struct timeval	now;
+
+    pmtimevalNow(&now);
+    rp->time += (__uint64_t)(pmtimevalSub(&now, start) * 1000000);
+    if (rp->count++ == 0)
+	pmdaCacheStore(INDOM(REFRESH_INDOM), PMDA_CACHE_ADD,
+			refresh_names[cluster], (void *)rp);
+}
+
+/*
+ * Refresh routines run inside a container namespace - these are called
+ * from the namespace worker thread, see container_run() for details.
+ */
+typedef struct linux_refresh {
+    int			*need_refresh;
+    pmInDom		netaddr;
+    pmInDom		netdev;
+    int			need_net_ioctl;
+    int			sts;
+} linux_refresh_t;
+
+static void
+refresh_net_namespace(linux_container_t *cp, void *arg)
+{
+    linux_refresh_t	*rp = (linux_refresh_t *)arg;
+    struct timeval	start;
+    int			sts;
+
+    if (rp->need_refresh[CLUSTER_NET_DEV]) {
+	pmtimevalNow(&start);
+	refresh_proc_net_dev(rp->netdev, cp);
+	refresh_proc_net_all(rp->netdev, &proc_net_all);
+	refresh_done(CLUSTER_NET_DEV, &start);
+    }
+
+    if (rp->need_refresh[CLUSTER_NET_SOCKSTAT]) {
+	pmtimevalNow(&start);
+	refresh_proc_net_sockstat(&proc_net_sockstat);
+	refresh_done(CLUSTER_NET_SOCKSTAT, &start);
+    }
+
+    if (rp->need_refresh[CLUSTER_NET_SOCKSTAT6]) {
+	pmtimevalNow(&start);
+	refresh_proc_net_sockstat6(&proc_net_sockstat6);
+	refresh_done(CLUSTER_NET_SOCKSTAT6, &start);
+    }
+
+    if (rp->need_refresh[CLUSTER_NET_SNMP]) {
+	pmtimevalNow(&start);
+	refresh_proc_net_snmp(&_pm_proc_net_snmp);
+	refresh_done(CLUSTER_NET_SNMP, &start);
+    }
+
+    if (rp->need_refresh[CLUSTER_NET_SNMP6]) {
+	pmtimevalNow(&start);
+	refresh_proc_net_snmp6(_pm_proc_net_snmp6);
+	refresh_done(CLUSTER_NET_SNMP6, &start);
+    }
+
+    if (rp->need_refresh[CLUSTER_NET_RAW]) {
+	pmtimevalNow(&start);
+	refresh_proc_net_raw(&proc_net_raw);
+	refresh_done(CLUSTER_NET_RAW, &start);
+    }
+
+    if (rp->need_refresh[CLUSTER_NET_RAW6]) {
+	pmtimevalNow(&start);
+	refresh_proc_net_raw6(&proc_net_raw6);
+	refresh_done(CLUSTER_NET_RAW6, &start);
+    }
+
+    if (rp->need_refresh[CLUSTER_NET_TCP]) {
+	pmtimevalNow(&start);
+	refresh_proc_net_tcp(&proc_net_tcp);
+	refresh_done(CLUSTER_NET_TCP, &start);
+    }
+
+    if (rp->need_refresh[CLUSTER_NET_TCP6]) {
+	pmtimevalNow(&start);
+	refresh_proc_net_tcp6(&proc_net_tcp6);
+	refresh_done(CLUSTER_NET_TCP6, &start);
+    }
+
+    if (rp->need_refresh[CLUSTER_NET_UDP]) {
+	pmtimevalNow(&start);
+	refresh_proc_net_udp(&proc_net_udp);
+	refresh_done(CLUSTER_NET_UDP, &start);
+    }
+
+    if (rp->need_refresh[CLUSTER_NET_UDP6]) {
+	pmtimevalNow(&start);
+	refresh_proc_net_udp6(&proc_net_udp6);
+	refresh_done(CLUSTER_NET_UDP6, &start);
+    }
+
+    if (rp->need_refresh[CLUSTER_NET_UNIX]) {
+	pmtimevalNow(&start);
+	refresh_proc_net_unix(&proc_net_unix);
+	refresh_done(CLUSTER_NET_UNIX, &start);
+    }
+
+    if (rp->need_refresh[CLUSTER_NET_NETSTAT]) {
+	pmtimevalNow(&start);
+	sts = refresh_proc_net_netstat(&_pm_proc_net_netstat);
+	refresh_done(CLUSTER_NET_NETSTAT, &start);
+	if (sts < 0 && rp->sts == 0)
+	    rp->sts = sts;
+    }
+}
+
+static void
+refresh_mnt_namespace(linux_container_t *cp, void *arg)
+{
+    linux_refresh_t	*rp = (linux_refresh_t *)arg;
+    struct timeval	start;
+
+    refresh_net_addr_sysfs(rp->netaddr, rp->need_refresh);
+    rp->need_net_ioctl |= refresh_net_sysfs(rp->netdev, rp->need_refresh);
+    if (rp->need_refresh[CLUSTER_FILESYS] || rp->need_refresh[CLUSTER_TMPFS]) {
+	pmtimevalNow(&start);
+	refresh_filesys(INDOM(FILESYS_INDOM), INDOM(TMPFS_INDOM), cp);
+	refresh_done(CLUSTER_FILESYS, &start);
+    }
+}
+
+static void
+refresh_net_ioctl_namespace(linux_container_t *cp, void *arg)
+{
+    linux_refresh_t	*rp = (linux_refresh_t *)arg;
+
+    refresh_net_addr_ioctl(rp->netaddr, cp, rp->need_refresh);
+    refresh_net_ioctl(rp->netdev, cp, rp->need_refresh);
+}
+
+static void
+refresh_uts_namespace(linux_container_t *cp, void *arg)
+{
+    (void)cp;
+    (void)arg;
+    uname(&kernel_uname);
+}
+
 static int
 linux_refresh(pmdaExt *pmda, int *need_refresh, int context)
 {
     linux_container_t *cp = linux_ctx_container(context);
     linux_access_t *laccess = access_ctx(context);
-    int need_net_ioctl = 0;
+    struct timeval start;
     int ns_fds = 0;
     int sts = 0;
     int	lsts;
@@ -7108,33 +7338,52 @@ linux_refresh(pmdaExt *pmda, int *need_refresh, int context)
 	need_refresh[CLUSTER_ZRAM_DEVICES] ||
 	need_refresh[REFRESH_PROC_DISKSTATS] ||
 	need_refresh[REFRESH_PROC_PARTITIONS]) {
+	pmtimevalNow(&start);
     	lsts = refresh_proc_partitions(INDOM(DISK_INDOM),
 			INDOM(PARTITIONS_INDOM), INDOM(ZRAM_INDOM),
 			INDOM(DM_INDOM), INDOM(MD_INDOM), INDOM(WWID_INDOM),
 			need_refresh[REFRESH_PROC_DISKSTATS],
 			need_refresh[REFRESH_PROC_PARTITIONS]);
+	refresh_done(CLUSTER_PARTITIONS, &start);
 	if (lsts < 0 && sts == 0)
 	    sts = lsts;
     }
 
-    if (need_refresh[CLUSTER_STAT])
-	refresh_proc_stat(&proc_stat);
+    if (need_refresh[CLUSTER_STAT]) {
+	pmtimevalNow(&start);
+	refresh_proc_stat(&proc_stat, need_refresh[REFRESH_PROC_STAT_PERCPU]);
+	refresh_done(CLUSTER_STAT, &start);
+    }
 
-    if (need_refresh[CLUSTER_CPUINFO])
+    if (need_refresh[CLUSTER_CPUINFO]) {
+	pmtimevalNow(&start);
 	refresh_proc_cpuinfo();
+	refresh_done(CLUSTER_CPUINFO, &start);
+    }
 
-    if (need_refresh[CLUSTER_MEMINFO])
+    if (need_refresh[CLUSTER_MEMINFO]) {
+	pmtimevalNow(&start);
 	refresh_proc_meminfo(&proc_meminfo);
+	refresh_done(CLUSTER_MEMINFO, &start);
+    }
 
-    if (need_refresh[CLUSTER_NUMA_MEMINFO])
+    if (need_refresh[CLUSTER_NUMA_MEMINFO]) {
+	pmtimevalNow(&start);
 	refresh_numa_meminfo();
+	refresh_done(CLUSTER_NUMA_MEMINFO, &start);
+    }
 
-    if (need_refresh[CLUSTER_LOADAVG])
+    if (need_refresh[CLUSTER_LOADAVG]) {
+	pmtimevalNow(&start);
 	refresh_proc_loadavg(&proc_loadavg);
+	refresh_done(CLUSTER_LOADAVG, &start);
+    }
 
     if (need_refresh[CLUSTER_NET_NFS]) {
+	pmtimevalNow(&start);
 	refresh_proc_net_rpc(&proc_net_rpc);
 	refresh_proc_fs_nfsd(&proc_fs_nfsd);
+	refresh_done(CLUSTER_NET_NFS, &start);
     }
 
     /*
@@ -7173,14 +7422,14 @@ linux_refresh(pmdaExt *pmda, int *need_refresh, int context)
 	need_refresh[REFRESH_NETADDR_IPV6] ||
 	need_refresh[REFRESH_NETADDR_HW]) {
 	pmInDom netaddr = INDOM(NET_ADDR_INDOM);
-	pmInDom netdev = INDOM(NET_DEV_INDOM);
+	linux_refresh_t refresh = { need_refresh, netaddr, INDOM(NET_DEV_INDOM) };
 
 	if (need_refresh[CLUSTER_NET_ADDR])
 	    clear_net_addr_indom(netaddr);
 	if (need_refresh[REFRESH_NETADDR_INET])
-	    need_net_ioctl = 1;
+	    refresh.need_net_ioctl = 1;
 	if (need_refresh[REFRESH_NETADDR_IPV6])
-	    need_net_ioctl = 1;
+	    refresh.need_net_ioctl = 1;
 
 	if (need_refresh[CLUSTER_NET_DEV] ||
 	    need_refresh[CLUSTER_NET_SOCKSTAT] ||
@@ -7196,58 +7445,14 @@ linux_refresh(pmdaExt *pmda, int *need_refresh, int context)
 	    need_refresh[CLUSTER_NET_UNIX] ||
 	    need_refresh[CLUSTER_NET_NETSTAT]) {
 
-	    if ((lsts = container_nsenter(cp, LINUX_NAMESPACE_NET, &ns_fds)) < 0) {
-		if (lsts < 0 && sts == 0)
+	    if ((lsts = container_run(cp, LINUX_NAMESPACE_NET, &ns_fds,
+				refresh_net_namespace, &refresh)) < 0) {
+		if (sts == 0)
 		    sts = lsts;
 		goto done;
 	    }
-
-	    if (need_refresh[CLUSTER_NET_DEV])
-		refresh_proc_net_dev(netdev, cp);
-
-	    if (need_refresh[CLUSTER_NET_DEV])
-		refresh_proc_net_all(netdev, &proc_net_all);
-
-	    if (need_refresh[CLUSTER_NET_SOCKSTAT])
-		refresh_proc_net_sockstat(&proc_net_sockstat);
-
-	    if (need_refresh[CLUSTER_NET_SOCKSTAT6])
-		refresh_proc_net_sockstat6(&proc_net_sockstat6);
-
-	    if (need_refresh[CLUSTER_NET_SNMP])
-		refresh_proc_net_snmp(&_pm_proc_net_snmp);
-
-	    if (need_refresh[CLUSTER_NET_SNMP6])
-		refresh_proc_net_snmp6(_pm_proc_net_snmp6);
-
-	    if (need_refresh[CLUSTER_NET_RAW])
-		refresh_proc_net_raw(&proc_net_raw);
-
-	    if (need_refresh[CLUSTER_NET_RAW6])
-		refresh_proc_net_raw6(&proc_net_raw6);
-
-	    if (need_refresh[CLUSTER_NET_TCP])
-		refresh_proc_net_tcp(&proc_net_tcp);
-
-	    if (need_refresh[CLUSTER_NET_TCP6])
-		refresh_proc_net_tcp6(&proc_net_tcp6);
-
-	    if (need_refresh[CLUSTER_NET_UDP])
-		refresh_proc_net_udp(&proc_net_udp);
-
-	    if (need_refresh[CLUSTER_NET_UDP6])
-		refresh_proc_net_udp6(&proc_net_udp6);
-
-	    if (need_refresh[CLUSTER_NET_UNIX])
-		refresh_proc_net_unix(&proc_net_unix);
-
-	    if (need_refresh[CLUSTER_NET_NETSTAT]) {
-		lsts = refresh_proc_net_netstat(&_pm_proc_net_netstat);
-		if (lsts < 0 && sts == 0)
-		    sts = lsts;
-	    }
-
-	    container_nsleave(cp, LINUX_NAMESPACE_NET);
+	    if (refresh.sts < 0 && sts == 0)
+		sts = refresh.sts;
 	}
 
 	if (need_refresh[CLUSTER_NET_DEV] ||
@@ -7264,29 +7469,21 @@ linux_refresh(pmdaExt *pmda, int *need_refresh, int context)
 	    need_refresh[REFRESH_NETADDR_IPV6] ||
 	    need_refresh[REFRESH_NETADDR_HW]) {
 
-	    if ((lsts = container_nsenter(cp, LINUX_NAMESPACE_MNT, &ns_fds)) < 0) {
-		if (lsts < 0 && sts == 0)
+	    if ((lsts = container_run(cp, LINUX_NAMESPACE_MNT, &ns_fds,
+				refresh_mnt_namespace, &refresh)) < 0) {
+		if (sts == 0)
 		    sts = lsts;
 		goto done;
 	    }
-
-	    refresh_net_addr_sysfs(netaddr, need_refresh);
-	    need_net_ioctl |= refresh_net_sysfs(netdev, need_refresh);
-	    if (need_refresh[CLUSTER_FILESYS] || need_refresh[CLUSTER_TMPFS])
-		refresh_filesys(INDOM(FILESYS_INDOM), INDOM(TMPFS_INDOM), cp);
-
-	    container_nsleave(cp, LINUX_NAMESPACE_MNT);
 	}
 
-	if (need_net_ioctl) {
-	    if ((lsts = container_nsenter(cp, LINUX_NAMESPACE_NET, &ns_fds)) < 0) {
-		if (lsts < 0 && sts == 0)
+	if (refresh.need_net_ioctl) {
+	    if ((lsts = container_run(cp, LINUX_NAMESPACE_NET, &ns_fds,
+				refresh_net_ioctl_namespace, &refresh)) < 0) {
+		if (sts == 0)
 		    sts = lsts;
 		goto done;
 	    }
-	    refresh_net_addr_ioctl(netaddr, cp, need_refresh);
-	    refresh_net_ioctl(netdev, cp, need_refresh);
-	    container_nsleave(cp, LINUX_NAMESPACE_NET);
 	}
 
 	if (need_refresh[CLUSTER_NET_ADDR])
@@ -7294,122 +7491,212 @@ linux_refresh(pmdaExt *pmda, int *need_refresh, int context)
     }
 
     if (need_refresh[CLUSTER_KERNEL_UNAME]) {
-	if ((lsts = container_nsenter(cp, LINUX_NAMESPACE_UTS, &ns_fds)) < 0) {
-	    if (lsts < 0 && sts == 0)
+	if ((lsts = container_run(cp, LINUX_NAMESPACE_UTS, &ns_fds,
+				refresh_uts_namespace, NULL)) < 0) {
+	    if (sts == 0)
 		sts = lsts;
 	    goto done;
 	}
-	uname(&kernel_uname);
-	container_nsleave(cp, LINUX_NAMESPACE_UTS);
     }
 
-    if (need_refresh[CLUSTER_INTERRUPTS])
+    if (need_refresh[CLUSTER_INTERRUPTS]) {
+	pmtimevalNow(&start);
 	refresh_proc_interrupts();
+	refresh_done(CLUSTER_INTERRUPTS, &start);
+    }
 
     if (need_refresh[CLUSTER_SOFTIRQS] ||
-	need_refresh[CLUSTER_SOFTIRQS_TOTAL])
+	need_refresh[CLUSTER_SOFTIRQS_TOTAL]) {
+	pmtimevalNow(&start);
 	refresh_proc_softirqs();
+	refresh_done(CLUSTER_SOFTIRQS, &start);
+    }
 
-    if (need_refresh[CLUSTER_SWAPDEV])
+    if (need_refresh[CLUSTER_SWAPDEV]) {
+	pmtimevalNow(&start);
 	refresh_swapdev(INDOM(SWAPDEV_INDOM));
+	refresh_done(CLUSTER_SWAPDEV, &start);
+    }
 
-    if (need_refresh[CLUSTER_SCSI])
+    if (need_refresh[CLUSTER_SCSI]) {
+	pmtimevalNow(&start);
 	refresh_proc_scsi(INDOM(SCSI_INDOM));
+	refresh_done(CLUSTER_SCSI, &start);
+    }
 
     if (need_refresh[CLUSTER_SLAB]) {
 	if (all_access ||
 	    (laccess != NULL && laccess->uid == 0 && laccess->uid_flag)) {
 	    proc_slabinfo.permission = 1;
+	    pmtimevalNow(&start);
 	    refresh_proc_slabinfo(INDOM(SLAB_INDOM), &proc_slabinfo);
+	    refresh_done(CLUSTER_SLAB, &start);
 	} else {
 	    proc_slabinfo.permission = 0;
 	}
     }
 
-    if (need_refresh[CLUSTER_SEM_LIMITS])
+    if (need_refresh[CLUSTER_SEM_LIMITS]) {
+	pmtimevalNow(&start);
 	refresh_sem_limits(&sem_limits);
+	refresh_done(CLUSTER_SEM_LIMITS, &start);
+    }
 
-    if (need_refresh[CLUSTER_MSG_LIMITS])
-        refresh_msg_limits(&msg_limits);
+    if (need_refresh[CLUSTER_MSG_LIMITS]) {
+	pmtimevalNow(&start);
+	refresh_msg_limits(&msg_limits);
+	refresh_done(CLUSTER_MSG_LIMITS, &start);
+    }
 
-    if (need_refresh[CLUSTER_SHM_INFO])
-        refresh_shm_info(&shm_info);
+    if (need_refresh[CLUSTER_SHM_INFO]) {
+	pmtimevalNow(&start);
+	refresh_shm_info(&shm_info);
+	refresh_done(CLUSTER_SHM_INFO, &start);
+    }
 
-    if (need_refresh[CLUSTER_SEM_INFO])
-        refresh_sem_info(&sem_info);
+    if (need_refresh[CLUSTER_SEM_INFO]) {
+	pmtimevalNow(&start);
+	refresh_sem_info(&sem_info);
+	refresh_done(CLUSTER_SEM_INFO, &start);
+    }
 
-    if (need_refresh[CLUSTER_MSG_INFO])
-        refresh_msg_info(&msg_info);
+    if (need_refresh[CLUSTER_MSG_INFO]) {
+	pmtimevalNow(&start);
+	refresh_msg_info(&msg_info);
+	refresh_done(CLUSTER_MSG_INFO, &start);
+    }
 
-    if (need_refresh[CLUSTER_SHM_LIMITS])
-        refresh_shm_limits(&shm_limits);
+    if (need_refresh[CLUSTER_SHM_LIMITS]) {
+	pmtimevalNow(&start);
+	refresh_shm_limits(&shm_limits);
+	refresh_done(CLUSTER_SHM_LIMITS, &start);
+    }
 
-    if (need_refresh[CLUSTER_UPTIME])
-        refresh_proc_uptime(&proc_uptime);
+    if (need_refresh[CLUSTER_UPTIME]) {
+	pmtimevalNow(&start);
+	refresh_proc_uptime(&proc_uptime);
+	refresh_done(CLUSTER_UPTIME, &start);
+    }
 
-    if (need_refresh[CLUSTER_UTMP])
-        refresh_login_info(&login_info);
+    if (need_refresh[CLUSTER_UTMP]) {
+	pmtimevalNow(&start);
+	refresh_login_info(&login_info);
+	refresh_done(CLUSTER_UTMP, &start);
+    }
 
-    if (need_refresh[CLUSTER_VFS])
-    	refresh_proc_sys_fs(&proc_sys_fs);
+    if (need_refresh[CLUSTER_VFS]) {
+	pmtimevalNow(&start);
+	refresh_proc_sys_fs(&proc_sys_fs);
+	refresh_done(CLUSTER_VFS, &start);
+    }
 
-    if (need_refresh[CLUSTER_LOCKS])
-    	refresh_proc_locks(&proc_locks);
+    if (need_refresh[CLUSTER_LOCKS]) {
+	pmtimevalNow(&start);
+	refresh_proc_locks(&proc_locks);
+	refresh_done(CLUSTER_LOCKS, &start);
+    }
 
-    if (need_refresh[CLUSTER_SYS_KERNEL])
-    	refresh_proc_sys_kernel(&proc_sys_kernel);
+    if (need_refresh[CLUSTER_SYS_KERNEL]) {
+	pmtimevalNow(&start);
+	refresh_proc_sys_kernel(&proc_sys_kernel);
+	refresh_done(CLUSTER_SYS_KERNEL, &start);
+    }
 
-    if (need_refresh[CLUSTER_VMSTAT])
-    	refresh_proc_vmstat(&_pm_proc_vmstat);
+    if (need_refresh[CLUSTER_VMSTAT]) {
+	pmtimevalNow(&start);
+	refresh_proc_vmstat(&_pm_proc_vmstat);
+	refresh_done(CLUSTER_VMSTAT, &start);
+    }
 
-    if (need_refresh[CLUSTER_SYSFS_KERNEL])
-    	refresh_sysfs_kernel(&sysfs_kernel);
+    if (need_refresh[CLUSTER_SYSFS_KERNEL]) {
+	pmtimevalNow(&start);
+	refresh_sysfs_kernel(&sysfs_kernel);
+	refresh_done(CLUSTER_SYSFS_KERNEL, &start);
+    }
 
-    if (need_refresh[CLUSTER_NET_SOFTNET])
+    if (need_refresh[CLUSTER_NET_SOFTNET]) {
+	pmtimevalNow(&start);
 	refresh_proc_net_softnet(&proc_net_softnet);
+	refresh_done(CLUSTER_NET_SOFTNET, &start);
+    }
 
-    if (need_refresh[CLUSTER_SHM_STAT])
+    if (need_refresh[CLUSTER_SHM_STAT]) {
+	pmtimevalNow(&start);
 	refresh_shm_stat(INDOM(IPC_STAT_INDOM));
+	refresh_done(CLUSTER_SHM_STAT, &start);
+    }
 
-    if (need_refresh[CLUSTER_MSG_STAT])
+    if (need_refresh[CLUSTER_MSG_STAT]) {
+	pmtimevalNow(&start);
 	refresh_msg_queue(INDOM(IPC_MSG_INDOM));
+	refresh_done(CLUSTER_MSG_STAT, &start);
+    }
 
-    if (need_refresh[CLUSTER_SEM_STAT])
+    if (need_refresh[CLUSTER_SEM_STAT]) {
+	pmtimevalNow(&start);
 	refresh_sem_array(INDOM(IPC_SEM_INDOM));
+	refresh_done(CLUSTER_SEM_STAT, &start);
+    }
 
-    if (need_refresh[CLUSTER_BUDDYINFO])
+    if (need_refresh[CLUSTER_BUDDYINFO]) {
+	pmtimevalNow(&start);
 	refresh_proc_buddyinfo(&proc_buddyinfo);
+	refresh_done(CLUSTER_BUDDYINFO, &start);
+    }
 
     if (need_refresh[CLUSTER_ZONEINFO] ||
-        need_refresh[CLUSTER_ZONEINFO_PROTECTION])
+        need_refresh[CLUSTER_ZONEINFO_PROTECTION]) {
+	pmtimevalNow(&start);
 	refresh_proc_zoneinfo(INDOM(ZONEINFO_INDOM),
 			      INDOM(ZONEINFO_PROTECTION_INDOM));
+	refresh_done(CLUSTER_ZONEINFO, &start);
+    }
 
-    if (need_refresh[CLUSTER_KSM_INFO])
+    if (need_refresh[CLUSTER_KSM_INFO]) {
+	pmtimevalNow(&start);
 	refresh_ksm_info(&ksm_info);
+	refresh_done(CLUSTER_KSM_INFO, &start);
+    }
 
-    if (need_refresh[CLUSTER_TAPEDEV])
+    if (need_refresh[CLUSTER_TAPEDEV]) {
+	pmtimevalNow(&start);
 	refresh_sysfs_tapestats(INDOM(TAPEDEV_INDOM));
+	refresh_done(CLUSTER_TAPEDEV, &start);
+    }
 
     if (need_refresh[CLUSTER_TTY]) {
 	if (all_access ||
 	    (laccess != NULL && laccess->uid == 0 && laccess->uid_flag)) {
 	    proc_tty_permission = 1;
+	    pmtimevalNow(&start);
 	    refresh_tty(INDOM(TTY_INDOM));
+	    refresh_done(CLUSTER_TTY, &start);
 	} else {
 	    proc_tty_permission = 0;
 	}
     }
 
-    if (need_refresh[CLUSTER_PRESSURE_CPU])
+    if (need_refresh[CLUSTER_PRESSURE_CPU]) {
+	pmtimevalNow(&start);
 	refresh_proc_pressure_cpu(&proc_pressure);
-    if (need_refresh[CLUSTER_PRESSURE_MEM])
+	refresh_done(CLUSTER_PRESSURE_CPU, &start);
+    }
+    if (need_refresh[CLUSTER_PRESSURE_MEM]) {
+	pmtimevalNow(&start);
 	refresh_proc_pressure_mem(&proc_pressure);
-    if (need_refresh[CLUSTER_PRESSURE_IO])
+	refresh_done(CLUSTER_PRESSURE_MEM, &start);
+    }
+    if (need_refresh[CLUSTER_PRESSURE_IO]) {
+	pmtimevalNow(&start);
 	refresh_proc_pressure_io(&proc_pressure);
+	refresh_done(CLUSTER_PRESSURE_IO, &start);
+    }
 
-    if (need_refresh[CLUSTER_FCHOST])
+    if (need_refresh[CLUSTER_FCHOST]) {
+	pmtimevalNow(&start);
 	refresh_sysfs_fchosts(INDOM(FCHOST_INDOM));
+	refresh_done(CLUSTER_FCHOST, &start);
+    }
 
 done:
     container_close(cp, ns_fds);
@@ -9583,6 +9870,27 @@ linux_fetchCallBack(pmdaMetric *mdesc, unsigned int inst, pmAtomValue *atom)
 	}
 	break;
 
+    case CLUSTER_REFRESH: {
+	refresh_stats_t *rp = NULL;
+
+	sts = pmdaCacheLookup(INDOM(REFRESH_INDOM), inst, NULL, (void **)&rp);
+	if (sts < 0)
+	    return sts;
+	if (sts != PMDA_CACHE_ACTIVE || rp == NULL)
+	    return PM_ERR_INST;
+	switch (item) {
+	case 0: /* pmda.refresh.count */
+	    atom->ull = rp->count;
+	    break;
+	case 1: /* pmda.refresh.time */
+	    atom->ull = rp->time;
+	    break;
+	default:
+	    return PM_ERR_PMID;
+	}
+	break;
+    }
+
     case CLUSTER_FCHOST:
 	if (item == FCHOST_HINV_NFCHOST) {
 	    /* hinv.nfchost */
@@ -9634,8 +9942,12 @@ linux_fetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
 		need_refresh[REFRESH_PROC_DISKSTATS]++;
 		need_refresh[CLUSTER_PARTITIONS]++;
 	    }
-	    else if (!(item == 48 && cluster == CLUSTER_STAT))	/* hz */
+	    else if (!(item == 48 && cluster == CLUSTER_STAT)) { /* hz */
 		need_refresh[cluster]++;
+		/* per-CPU and per-node utilisation need every cpuN line */
+		if (cluster == CLUSTER_STAT && is_percpu_stat_metric(item))
+		    need_refresh[REFRESH_PROC_STAT_PERCPU]++;
+	    }
 	    /* disk.{dev,dm,md,partitions}.capacity is in /proc/partitions */
 	    if (is_capacity_metric(cluster, item))
 		need_refresh[REFRESH_PROC_PARTITIONS]++;
@@ -9730,6 +10042,9 @@ linux_fetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
 	    }
 	    break;
 
+	case CLUSTER_REFRESH:
+	    break;
+
 	default:
 	    need_refresh[cluster]++;
 	    break;
@@ -9793,6 +10108,7 @@ static void
 linux_endContextCallBack(int ctx)
 {
     if (ctx >= 0 && ctx < num_ctx) {
+	container_release(&ctxtab[ctx].container);
 	if (ctxtab[ctx].container.name)
 	    free(ctxtab[ctx].container.name);
 	if (ctxtab[ctx].container.netfd)
@@ -9817,6 +10133,7 @@ linux_attribute(int ctx, int attr, const char *value, int len, pmdaExt *pmda)
     if (attr == PMDA_ATTR_CONTAINER) {
 	char	*name = len > 1 ? strndup(value, len) : 0;
 
+	container_release(&ctxtab[ctx].container);
 	if (ctxtab[ctx].container.name)
 	    free(ctxtab[ctx].container.name);
 	if ((ctxtab[ctx].container.name = name) != NULL)
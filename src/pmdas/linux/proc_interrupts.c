@@ -22,9 +22,23 @@ static char *iobuf;			/* buffer sized based on CPU count */
 static unsigned int iobufsz;
 
 static online_cpu_t *online_cpumap;	/* maps input columns to CPU info */
+static unsigned int *column_cpuids;	/* column_to_cpuid for each column */
 unsigned int irq_err_count;
 unsigned int irq_mis_count;
 
+/*
+ * Shape of /proc/interrupts or /proc/softirqs at the last refresh - while
+ * the CPU columns and rows stay the same, values are stored directly into
+ * the per-CPU instances remembered for each row, and the (ncpus * nrows)
+ * per-CPU instance names need not be formatted and looked up each time.
+ */
+typedef struct {
+    unsigned int	ncolumns;
+    unsigned int	nrows;		/* zero if not yet known */
+    unsigned int	generation;	/* count of full parses */
+    unsigned int	*cpuids;	/* CPU identifier of each column */
+} irq_layout_t;
+
 /*
  * One-shot initialisation for global interrupt-metric-related state
  */
@@ -36,10 +50,14 @@ setup_buffers(void)
     if (!setup) {
 	if ((iobufsz = (_pm_ncpus * 64)) < BUFSIZ)
 	    iobufsz = BUFSIZ;
-	if ((iobuf = malloc(iobufsz)) == NULL)
+	/* zero padding after the last line allows word-sized reads */
+	if ((iobuf = calloc(1, iobufsz + sizeof(__uint64_t))) == NULL)
 	    return;
 	online_cpumap = calloc(_pm_ncpus, sizeof(online_cpu_t));
-	if (!online_cpumap) {
+	column_cpuids = calloc(_pm_ncpus, sizeof(unsigned int));
+	if (!online_cpumap || !column_cpuids) {
+	    free(column_cpuids);
+	    free(online_cpumap);
 	    free(iobuf);
 	    return;
 	}
@@ -84,6 +102,66 @@ column_to_cpuid(int column)
     return 0;
 }
 
+/*
+ * Parse the header line, and check whether the CPU columns are the
+ * same as those seen last time (returning 1 if so)
+ */
+static int
+map_columns(char *buffer, irq_layout_t *layout, unsigned int *ncolumns)
+{
+    unsigned int i, n = map_online_cpus(buffer);
+    int same = (layout->nrows > 0 && layout->ncolumns == n);
+
+    if (layout->cpuids == NULL &&
+	(layout->cpuids = calloc(_pm_ncpus, sizeof(unsigned int))) == NULL)
+	same = 0;
+    for (i = 0; i < n; i++) {
+	column_cpuids[i] = column_to_cpuid(i);
+	if (layout->cpuids == NULL)
+	    continue;
+	if (layout->cpuids[i] != online_cpumap[i].cpuid) {
+	    layout->cpuids[i] = online_cpumap[i].cpuid;
+	    same = 0;
+	}
+    }
+    layout->ncolumns = n;
+    *ncolumns = n;
+    return same;
+}
+
+/*
+ * Skip the blank padding of a fixed-width column a word at a time, then
+ * convert the value - like strtoul(3) the end pointer is the start if no
+ * digits are found.  Reads up to seven bytes past the end of the line,
+ * which setup_buffers() allows for.
+ */
+static inline char *
+scan_value(char *s, unsigned long *value)
+{
+    static const __uint64_t blanks = 0x2020202020202020ULL;
+    unsigned long v = 0;
+    __uint64_t word;
+    char *p = s;
+
+    for (;;) {
+	memcpy(&word, p, sizeof(word));
+	if (word != blanks)
+	    break;
+	p += sizeof(word);
+    }
+    while (*p == ' ' || *p == '\t')
+	p++;
+    if ((unsigned int)(*p - '0') > 9) {
+	*value = 0;
+	return s;
+    }
+    do {
+	v = v * 10 + (*p++ - '0');
+    } while ((unsigned int)(*p - '0') <= 9);
+    *value = v;
+    return p;
+}
+
 /*
  * Create descriptive label value - remove duplicates and end-of-line marker
  */
@@ -138,46 +216,81 @@ extract_interrupt_misses(char *buffer)
     return sscanf(buffer, "MIS: %u", &irq_mis_count) == 1;
 }
 
+/*
+ * Extract the per-CPU values for one row, returning 1 if a new row was
+ * added to the indom.  With fast set, the instances remembered for each
+ * column of the row are updated in place, and -1 is returned if that is
+ * not possible because the shape of the file has changed.
+ */
 static int
-extract_interrupt_values(char *name, char *buffer, pmInDom intr, pmInDom cpuintr, int ncolumns)
+extract_values(char *name, char *buffer, pmInDom indom, pmInDom cpuindom,
+		unsigned int ncolumns, unsigned int generation, int fast,
+		int softirq)
 {
     unsigned long i, cpuid, value;
     char *s = buffer, *end = NULL;
     char cpubuf[64];
-    interrupt_cpu_t *cpuip;
+    interrupt_cpu_t *cpuip, **cpus;
     interrupt_t *ip = NULL;
     int sts, changed = 0;
 
-    sts = pmdaCacheLookupName(intr, name, NULL, (void **)&ip);
+    sts = pmdaCacheLookupName(indom, name, NULL, (void **)&ip);
     if (sts < 0 || ip == NULL) {
+	if (fast)
+	    return -1;
 	if ((ip = calloc(1, sizeof(interrupt_t))) == NULL)
 	    return 0;
 	changed = 1;
     }
+    if (fast && (ip->ncolumns != ncolumns || ip->generation != generation))
+	return -1;
+    ip->generation = generation;
+    if (!fast && ip->ncolumns != ncolumns) {
+	if ((cpus = realloc(ip->cpus, ncolumns * sizeof(*cpus))) == NULL) {
+	    ip->ncolumns = 0;
+	    return changed;
+	}
+	ip->cpus = cpus;
+	ip->ncolumns = ncolumns;
+    }
 
     ip->total = 0;
     for (i = 0; i < ncolumns; i++) {
-	value = strtoul(s, &end, 10);
-	if (!isspace(*end))
+	end = scan_value(s, &value);
+	if (!isspace(*end)) {
+	    if (!fast)
+		ip->cpus[i] = NULL;
 	    continue;
+	}
 	s = end;
-	cpuip = NULL;
-	cpuid = column_to_cpuid(i);
-	online_cpumap[cpuid].intr_count += value;
-	pmsprintf(cpubuf, sizeof cpubuf, "%s::cpu%lu", name, cpuid);
-	sts = pmdaCacheLookupName(cpuintr, cpubuf, NULL, (void **)&cpuip);
-	if (sts < 0 || cpuip == NULL) {
-	    if ((cpuip = calloc(1, sizeof(interrupt_cpu_t))) == NULL)
-	        continue;
-	    cpuip->row = ip;
+	if (fast) {
+	    if ((cpuip = ip->cpus[i]) == NULL)
+		return -1;
+	    cpuid = cpuip->cpuid;
+	} else {
+	    cpuip = NULL;
+	    cpuid = column_cpuids[i];
+	    pmsprintf(cpubuf, sizeof cpubuf, "%s::cpu%lu", name, cpuid);
+	    sts = pmdaCacheLookupName(cpuindom, cpubuf, NULL, (void **)&cpuip);
+	    if (sts < 0 || cpuip == NULL) {
+		if ((cpuip = calloc(1, sizeof(interrupt_cpu_t))) == NULL) {
+		    ip->cpus[i] = NULL;
+		    continue;
+		}
+		cpuip->row = ip;
+	    }
+	    cpuip->cpuid = cpuid;
+	    pmdaCacheStore(cpuindom, PMDA_CACHE_ADD, cpubuf, cpuip);
+	    ip->cpus[i] = cpuip;
 	}
-	cpuip->cpuid = cpuid;
+	if (softirq)
+	    online_cpumap[cpuid].sirq_count += value;
+	else
+	    online_cpumap[cpuid].intr_count += value;
 	cpuip->value = value;
 	ip->total += value;
-
-	pmdaCacheStore(cpuintr, PMDA_CACHE_ADD, cpubuf, cpuip);
     }
-    pmdaCacheStore(intr, PMDA_CACHE_ADD, name, ip);
+    pmdaCacheStore(indom, PMDA_CACHE_ADD, name, ip);
 
     if (ip->label == NULL)
 	ip->label = end ? strdup(label_reformat(end)) : NULL;
@@ -185,112 +298,107 @@ extract_interrupt_values(char *name, char *buffer, pmInDom intr, pmInDom cpuintr
     return changed;
 }
 
-int
-refresh_proc_interrupts(void)
+/*
+ * Refresh one of the interrupt files - a full parse is done when the
+ * shape of the file is new or changed (in which case the per-CPU instance
+ * domain is rebuilt), else just the values are updated.
+ */
+static int
+refresh_irqs(linux_statsbuf_t *sp, irq_layout_t *layout,
+		pmInDom indom, pmInDom cpuindom, int softirq)
 {
-    static int setup;
-    FILE *fp;
-    char *name, *values;
-    int i, save, ncolumns;
-    pmInDom intr_indom = INDOM(INTERRUPT_INDOM);
-    pmInDom cpu_intr_indom = INDOM(INTERRUPT_CPU_INDOM);
+    char *name, *values, *s;
+    unsigned int i, nrows, ncolumns;
+    size_t start;
+    int sts, save, fast;
 
-    if (!setup) {
-	pmdaCacheOp(cpu_intr_indom, PMDA_CACHE_LOAD);
-	pmdaCacheOp(intr_indom, PMDA_CACHE_LOAD);
-	setup = 1;
-    }
-    pmdaCacheOp(cpu_intr_indom, PMDA_CACHE_INACTIVE);
-    pmdaCacheOp(intr_indom, PMDA_CACHE_INACTIVE);
+    pmdaCacheOp(indom, PMDA_CACHE_INACTIVE);
 
     setup_buffers();
-    for (i = 0; i < _pm_ncpus; i++)
-	online_cpumap[i].intr_count = 0;
+    for (i = 0; i < _pm_ncpus; i++) {
+	if (softirq)
+	    online_cpumap[i].sirq_count = 0;
+	else
+	    online_cpumap[i].intr_count = 0;
+    }
 
-    if ((fp = linux_statsfile("/proc/interrupts", iobuf, iobufsz)) == NULL)
-	return -oserror();
+    if ((sts = linux_statsbuf_read(sp)) < 0)
+	return sts;
 
     /* first parse header, which maps online CPU number to column number */
-    if (fgets(iobuf, iobufsz, fp)) {
-	ncolumns = map_online_cpus(iobuf);
-    } else {
-	fclose(fp);
+    if (linux_statsbuf_gets(iobuf, iobufsz, sp))
+	fast = map_columns(iobuf, layout, &ncolumns);
+    else
 	return -EINVAL;		/* unrecognised file format */
-    }
+    start = sp->offset;
 
-    save = 0;
-    while (fgets(iobuf, iobufsz, fp) != NULL) {
+again:
+    if (!fast) {
+	pmdaCacheOp(cpuindom, PMDA_CACHE_INACTIVE);
+	layout->generation++;
+    }
+    save = nrows = 0;
+    while (linux_statsbuf_gets(iobuf, iobufsz, sp) != NULL) {
 	/* extract interrupt line (or other) and values from each row */
-	if (extract_interrupt_errors(iobuf))
-	    continue;
-	if (extract_interrupt_misses(iobuf))
-	    continue;
+	if (!softirq) {
+	    for (s = iobuf; *s == ' '; s++)
+		;
+	    if ((*s == 'E' || *s == 'B') && extract_interrupt_errors(iobuf))
+		continue;
+	    if (*s == 'M' && extract_interrupt_misses(iobuf))
+		continue;
+	}
 	name = extract_interrupt_name(iobuf, &values);
-	save |= extract_interrupt_values(name, values, intr_indom, cpu_intr_indom, ncolumns);
+	if ((sts = extract_values(name, values, indom, cpuindom, ncolumns,
+				layout->generation, fast, softirq)) < 0)
+	    break;
+	save |= sts;
+	nrows++;
+    }
+    if (fast && (sts < 0 || nrows != layout->nrows)) {
+	/* rows have come or gone - start over, rebuilding the indoms */
+	for (i = 0; i < _pm_ncpus; i++) {
+	    if (softirq)
+		online_cpumap[i].sirq_count = 0;
+	    else
+		online_cpumap[i].intr_count = 0;
+	}
+	sp->offset = start;
+	fast = 0;
+	goto again;
     }
-    fclose(fp);
+    layout->nrows = nrows;
 
     if (save) {
-	pmdaCacheOp(cpu_intr_indom, PMDA_CACHE_SAVE);
-	pmdaCacheOp(intr_indom, PMDA_CACHE_SAVE);
+	pmdaCacheOp(cpuindom, PMDA_CACHE_SAVE);
+	pmdaCacheOp(indom, PMDA_CACHE_SAVE);
     }
     return 0;
 }
 
-static int
-extract_softirq_values(char *name, char *buffer, pmInDom sirq, pmInDom cpusirq, int ncolumns)
+int
+refresh_proc_interrupts(void)
 {
-    unsigned long i, cpuid, value;
-    char *s = buffer, *end = NULL;
-    char cpubuf[64];
-    interrupt_cpu_t *cpuip;
-    interrupt_t *ip = NULL;
-    int sts, changed = 0;
-
-    sts = pmdaCacheLookupName(sirq, name, NULL, (void **)&ip);
-    if (sts < 0 || ip == NULL) {
-	if ((ip = calloc(1, sizeof(interrupt_t))) == NULL)
-	    return 0;
-	changed = 1;
-    }
-
-    ip->total = 0;
-    for (i = 0; i < ncolumns; i++) {
-	value = strtoul(s, &end, 10);
-	if (!isspace(*end))
-	    continue;
-	s = end;
-	cpuip = NULL;
-	cpuid = column_to_cpuid(i);
-	online_cpumap[cpuid].sirq_count += value;
-	pmsprintf(cpubuf, sizeof cpubuf, "%s::cpu%lu", name, cpuid);
-	sts = pmdaCacheLookupName(cpusirq, cpubuf, NULL, (void **)&cpuip);
-	if (sts < 0 || cpuip == NULL) {
-	    if ((cpuip = calloc(1, sizeof(interrupt_cpu_t))) == NULL)
-	        continue;
-	    cpuip->row = ip;
-	}
-	cpuip->cpuid = cpuid;
-	cpuip->value = value;
-	ip->total += value;
+    static linux_statsbuf_t interrupts = LINUX_STATSBUF("/proc/interrupts");
+    static irq_layout_t layout;
+    static int setup;
+    pmInDom intr_indom = INDOM(INTERRUPT_INDOM);
+    pmInDom cpu_intr_indom = INDOM(INTERRUPT_CPU_INDOM);
 
-	pmdaCacheStore(cpusirq, PMDA_CACHE_ADD, cpubuf, cpuip);
+    if (!setup) {
+	pmdaCacheOp(cpu_intr_indom, PMDA_CACHE_LOAD);
+	pmdaCacheOp(intr_indom, PMDA_CACHE_LOAD);
+	setup = 1;
     }
-    pmdaCacheStore(sirq, PMDA_CACHE_ADD, name, ip);
-
-    if (ip->label == NULL)
-	ip->label = end ? strdup(label_reformat(end)) : NULL;
-
-    return changed;
+    return refresh_irqs(&interrupts, &layout, intr_indom, cpu_intr_indom, 0);
 }
 
 int
 refresh_proc_softirqs(void)
 {
+    static linux_statsbuf_t softirqs = LINUX_STATSBUF("/proc/softirqs");
+    static irq_layout_t layout;
     static int setup;
-    FILE *fp;
-    char *name, *values;
-    int i = 0, save, ncolumns;
     pmInDom sirq_indom = INDOM(SOFTIRQ_INDOM);
     pmInDom cpu_sirq_indom = INDOM(SOFTIRQ_CPU_INDOM);
 
@@ -299,37 +407,7 @@ refresh_proc_softirqs(void)
 	pmdaCacheOp(sirq_indom, PMDA_CACHE_LOAD);
 	setup = 1;
     }
-    pmdaCacheOp(cpu_sirq_indom, PMDA_CACHE_INACTIVE);
-    pmdaCacheOp(sirq_indom, PMDA_CACHE_INACTIVE);
-
-    setup_buffers();
-    for (i = 0; i < _pm_ncpus; i++)
-	online_cpumap[i].sirq_count = 0;
-
-    if ((fp = linux_statsfile("/proc/softirqs", iobuf, iobufsz)) == NULL)
-	return -oserror();
-
-    /* first parse header, which maps online CPU number to column number */
-    if (fgets(iobuf, iobufsz, fp)) {
-	ncolumns = map_online_cpus(iobuf);
-    } else {
-	fclose(fp);
-	return -EINVAL;		/* unrecognised file format */
-    }
-
-    save = 0;
-    while (fgets(iobuf, iobufsz, fp) != NULL) {
-	/* extract values from all subsequent softirqs file lines */
-	name = extract_interrupt_name(iobuf, &values);
-	save |= extract_softirq_values(name, values, sirq_indom, cpu_sirq_indom, ncolumns);
-    }
-    fclose(fp);
-
-    if (save) {
-	pmdaCacheOp(cpu_sirq_indom, PMDA_CACHE_SAVE);
-	pmdaCacheOp(sirq_indom, PMDA_CACHE_SAVE);
-    }
-    return 0;
+    return refresh_irqs(&softirqs, &layout, sirq_indom, cpu_sirq_indom, 1);
 }
 
 int
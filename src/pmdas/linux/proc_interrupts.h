@@ -13,12 +13,17 @@
  * for more details.
  */
 
+struct interrupt_cpu;
+
 typedef struct {
     char		*label;		/* short interrupt label text */
     unsigned long long	total;		/* aggregation of interrupt counts */
+    unsigned int	ncolumns;	/* number of per-column instances */
+    unsigned int	generation;	/* full parse this row was last in */
+    struct interrupt_cpu **cpus;	/* per-CPU instance for each column */
 } interrupt_t;
 
-typedef struct {
+typedef struct interrupt_cpu {
     unsigned int	cpuid;		/* CPU identifier */
     unsigned int	value;		/* individual CPU interrupt value */
     interrupt_t		*row;		/* row data in /proc/interrupts */
@@ -88,10 +88,11 @@ static struct {
 int
 refresh_proc_meminfo(proc_meminfo_t *proc_meminfo)
 {
+    static linux_statsbuf_t meminfo = LINUX_STATSBUF("/proc/meminfo");
     char	buf[1024];
-    char	*bufp;
+    char	*line, *bufp;
     int64_t	*p;
-    int		i;
+    int		i, sts;
     FILE	*fp;
 
     for (i = 0; meminfo_fields[i].field != NULL; i++) {
@@ -99,28 +100,25 @@ refresh_proc_meminfo(proc_meminfo_t *proc_meminfo)
 	*p = -1; /* marked as "no value available" */
     }
 
-    if ((fp = linux_statsfile("/proc/meminfo", buf, sizeof(buf))) == NULL)
-	return -oserror();
+    if ((sts = linux_statsbuf_read(&meminfo)) < 0)
+	return sts;
 
-    while (fgets(buf, sizeof(buf), fp) != NULL) {
-	if ((bufp = strchr(buf, ':')) == NULL)
+    while ((line = linux_statsbuf_line(&meminfo)) != NULL) {
+	if ((bufp = strchr(line, ':')) == NULL)
 	    continue;
 	*bufp = '\0';
-	for (i=0; meminfo_fields[i].field != NULL; i++) {
-	    if (strcmp(buf, meminfo_fields[i].field) != 0)
-		continue;
-	    p = MOFFSET(i, proc_meminfo);
-	    for (bufp++; *bufp; bufp++) {
-	    	if (isdigit((int)*bufp)) {
-		    sscanf(bufp, "%llu", (unsigned long long *)p);
-		    break;
-		}
+	if ((i = linux_statsbuf_field(&meminfo, line,
+			meminfo_fields, sizeof(meminfo_fields[0]))) < 0)
+	    continue;
+	p = MOFFSET(i, proc_meminfo);
+	for (bufp++; *bufp; bufp++) {
+	    if (isdigit((int)*bufp)) {
+		sscanf(bufp, "%llu", (unsigned long long *)p);
+		break;
 	    }
 	}
     }
 
-    fclose(fp);
-
     /*
      * MemAvailable is only in 3.x or later kernels but we can calculate it
      * using other values, similar to upstream kernel commit 34e431b0ae.
@@ -162,27 +162,43 @@ find_line_format(const char *fmt, int fmtlen, char **bufindex, int nbufindex, in
 
 #define WAITIO_SLOP 100
 
+/*
+ * Metrics needing per-CPU (and per-node) utilisation from /proc/stat.
+ */
+int
+is_percpu_stat_metric(int item)
+{
+    switch (item) {
+    case 0: case 1: case 2: case 3: case 30: case 31:	/* kernel.percpu.cpu */
+    case 56: case 57: case 58: case 61: case 76: case 83: case 84:
+    case 62: case 63: case 64: case 65: case 66: case 67:	/* kernel.pernode.cpu */
+    case 68: case 69: case 70: case 71: case 77: case 85: case 86:
+	return 1;
+    }
+    return 0;
+}
+
 /*
  * We use /proc/stat as a single source of truth regarding online/offline
  * state for CPUs (its per-CPU stats are for online CPUs only).
  * This drives the contents of the CPU indom for all per-CPU metrics, so
  * it is important to ensure this refresh routine is called first before
  * refreshing any other per-CPU metrics (e.g. interrupts, softnet).
+ * Per-CPU and per-node utilisation values are only extracted when one
+ * of those metrics has been requested (percpu is non-zero).
  */
 int
-refresh_proc_stat(proc_stat_t *proc_stat)
+refresh_proc_stat(proc_stat_t *proc_stat, int percpu)
 {
     pernode_t	*np;
     percpu_t	*cp;
     pmInDom	cpus, nodes;
-    char	buf[MAXPATHLEN], *name, *sp, **bp;
+    char	*name, *statbuf, **bp;
     char	cpuname[32];
     int		n = 0, i, size;
     static unsigned long long	prev_wait;
 
-    static int fd = -1; /* kept open until exit(), unless testing */
-    static char *statbuf;
-    static int maxstatbuf;
+    static linux_statsbuf_t statfile = LINUX_STATSBUF("/proc/stat");
     static char **bufindex;
     static int nbufindex;
     static int maxbufindex;
@@ -193,7 +209,7 @@ refresh_proc_stat(proc_stat_t *proc_stat)
     nodes = INDOM(NODE_INDOM);
 
     /* reset per-node aggregate CPU utilisation stats */
-    for (pmdaCacheOp(nodes, PMDA_CACHE_WALK_REWIND);;) {
+    for (pmdaCacheOp(nodes, PMDA_CACHE_WALK_REWIND); percpu;) {
 	if ((i = pmdaCacheOp(nodes, PMDA_CACHE_WALK_NEXT)) < 0)
 	    break;
 	if (!pmdaCacheLookup(nodes, i, NULL, (void **)&np) || !np)
@@ -201,36 +217,9 @@ refresh_proc_stat(proc_stat_t *proc_stat)
 	memset(&np->stat, 0, sizeof(np->stat));
     }
 
-    /* in test mode we replace procfs files (keeping fd open thwarts that) */
-    if (fd >= 0 && (linux_test_mode & LINUX_TEST_STATSPATH)) {
-	close(fd);
-	fd = -1;
-    }
-
-    if (fd >= 0) {
-	if (lseek(fd, 0, SEEK_SET) < 0)
-	    return -oserror();
-    } else {
-	pmsprintf(buf, sizeof(buf), "%s/proc/stat", linux_statspath);
-	if ((fd = open(buf, O_RDONLY)) < 0)
-	    return -oserror();
-    }
-
-    for (;;) {
-	while (n >= maxstatbuf) {
-	    size = maxstatbuf + 512;
-	    if ((sp = (char *)realloc(statbuf, size)) == NULL)
-		return -ENOMEM;
-	    statbuf = sp;
-	    maxstatbuf = size;
-	}
-	size = (statbuf + maxstatbuf) - (statbuf + n);
-	if ((i = read(fd, statbuf + n, size)) > 0)
-	    n += i;
-	else
-	    break;
-    }
-    statbuf[n] = '\0';
+    if ((n = linux_statsbuf_read(&statfile)) < 0)
+	return n;
+    statbuf = statfile.buf;
 
     if (bufindex == NULL) {
 	size = 16 * sizeof(char *);
@@ -308,6 +297,11 @@ refresh_proc_stat(proc_stat_t *proc_stat)
 	    pmsprintf(cpuname, sizeof(cpuname), "cpu%u", i); /* instance name */
 	    if (pmdaCacheLookupName(cpus, cpuname, &i, (void **)&cp) < 0 || !cp)
 		continue;
+	    if (!percpu) {
+		/* online state only, no per-CPU or per-node values needed */
+		pmdaCacheStore(cpus, PMDA_CACHE_ADD, cpuname, (void *)cp);
+		continue;
+	    }
 	    /* need to NOT zero out the prev_wait field, as it is used below */
 	    prev_wait = cp->stat.prev_wait;
 	    memset(&cp->stat, 0, sizeof(cp->stat));
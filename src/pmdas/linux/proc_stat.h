@@ -28,6 +28,7 @@ typedef struct {
     unsigned long	procs_blocked;
 } proc_stat_t;
 
-extern int refresh_proc_stat(proc_stat_t *);
+extern int refresh_proc_stat(proc_stat_t *, int);
+extern int is_percpu_stat_metric(int);
 extern void setup_cpu_info(cpuinfo_t *);
 extern void cpu_node_setup(void);
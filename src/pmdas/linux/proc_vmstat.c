@@ -405,11 +405,10 @@ proc_vmstat_init(void)
 int
 refresh_proc_vmstat(proc_vmstat_t *proc_vmstat)
 {
-    char	buf[1024];
-    char	*bufp;
+    static linux_statsbuf_t vmstat = LINUX_STATSBUF("/proc/vmstat");
+    char	*line, *bufp;
     int64_t	*p;
-    int		i;
-    FILE	*fp;
+    int		i, sts;
 
     for (i = 0; vmstat_fields[i].field != NULL; i++) {
 	p = VMSTAT_OFFSET(i, proc_vmstat);
@@ -420,36 +419,34 @@ refresh_proc_vmstat(proc_vmstat_t *proc_vmstat)
     proc_vmstat->pgscan_kswapd_total = 0;
     proc_vmstat->pgsteal_total = 0;
 
-    if ((fp = linux_statsfile("/proc/vmstat", buf, sizeof(buf))) == NULL)
-    	return -oserror();
+    if ((sts = linux_statsbuf_read(&vmstat)) < 0)
+    	return sts;
 
     _pm_have_proc_vmstat = 1;
 
-    while (fgets(buf, sizeof(buf), fp) != NULL) {
-	if ((bufp = strchr(buf, ' ')) == NULL)
+    while ((line = linux_statsbuf_line(&vmstat)) != NULL) {
+	if ((bufp = strchr(line, ' ')) == NULL)
 	    continue;
 	*bufp = '\0';
-	for (i = 0; vmstat_fields[i].field != NULL; i++) {
-	    if (strcmp(buf, vmstat_fields[i].field) != 0)
-		continue;
-	    p = VMSTAT_OFFSET(i, proc_vmstat);
-	    for (bufp++; *bufp; bufp++) {
-	    	if (isdigit((int)*bufp)) {
-		    sscanf(bufp, "%llu", (unsigned long long *)p);
-		    break;
-		}
+	if ((i = linux_statsbuf_field(&vmstat, line,
+			vmstat_fields, sizeof(vmstat_fields[0]))) < 0)
+	    continue;
+	p = VMSTAT_OFFSET(i, proc_vmstat);
+	for (bufp++; *bufp; bufp++) {
+	    if (isdigit((int)*bufp)) {
+		sscanf(bufp, "%llu", (unsigned long long *)p);
+		break;
 	    }
-	    if (*bufp == '\0')
-		continue;
-	    else if (strncmp(buf, "pgsteal_", 8) == 0)
-		proc_vmstat->pgsteal_total += *p;
-	    else if (strncmp(buf, "pgscan_kswapd", 13) == 0)
-		proc_vmstat->pgscan_kswapd_total += *p;
-	    else if (strncmp(buf, "pgscan_direct", 13) == 0)
-		proc_vmstat->pgscan_direct_total += *p;
 	}
+	if (*bufp == '\0')
+	    continue;
+	else if (strncmp(line, "pgsteal_", 8) == 0)
+	    proc_vmstat->pgsteal_total += *p;
+	else if (strncmp(line, "pgscan_kswapd", 13) == 0)
+	    proc_vmstat->pgscan_kswapd_total += *p;
+	else if (strncmp(line, "pgscan_direct", 13) == 0)
+	    proc_vmstat->pgscan_direct_total += *p;
     }
-    fclose(fp);
 
     if (proc_vmstat->nr_slab == -1)	/* split apart in 2.6.18 */
 	proc_vmstat->nr_slab = proc_vmstat->nr_slab_reclaimable +
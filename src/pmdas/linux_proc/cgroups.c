@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012-2019,2022 Red Hat.
+ * Copyright (c) 2012-2019,2022,2026 Red Hat.
  * Copyright (c) 2010 Aconex.  All Rights Reserved.
  *
  * This program is free software; you can redistribute it and/or modify it
@@ -21,9 +21,19 @@
 #include "clusters.h"
 #include "proc_pid.h"
 #include <sys/stat.h>
+#include <sys/resource.h>
+#include <pthread.h>
+#include <stddef.h>
 #include <ctype.h>
+#include <fcntl.h>
+#include <regex.h>
 
 unsigned int	cgroup_version;
+int		cgroup_threads = 4;	/* cgroup v2 file readers */
+
+static regex_t	cgroup_include;
+static regex_t	cgroup_exclude;
+static int	cgroup_filters;		/* bitmap of the above in use */
 
 /*
  * Parts of the following two functions are based on systemd code, see
@@ -504,6 +514,51 @@ check_refresh(const char *cgroup, const char *container, int container_length)
     return 1;
 }
 
+/*
+ * Optional include and exclude regular expressions, matched against
+ * cgroup names (e.g. /system.slice/pmcd.service) before any of the
+ * files of a cgroup are read.  Subdirectories of an excluded cgroup
+ * are still visited, and are subject to the same filters.
+ */
+int
+cgroup_filter(const char *include, const char *exclude)
+{
+    char	errmsg[256];
+    int		sts;
+
+    if (include) {
+	if ((sts = regcomp(&cgroup_include, include, REG_EXTENDED|REG_NOSUB))) {
+	    regerror(sts, &cgroup_include, errmsg, sizeof(errmsg));
+	    pmNotifyErr(LOG_ERR, "bad cgroup include pattern \"%s\": %s",
+			include, errmsg);
+	    return -EINVAL;
+	}
+	cgroup_filters |= 1;
+    }
+    if (exclude) {
+	if ((sts = regcomp(&cgroup_exclude, exclude, REG_EXTENDED|REG_NOSUB))) {
+	    regerror(sts, &cgroup_exclude, errmsg, sizeof(errmsg));
+	    pmNotifyErr(LOG_ERR, "bad cgroup exclude pattern \"%s\": %s",
+			exclude, errmsg);
+	    return -EINVAL;
+	}
+	cgroup_filters |= 2;
+    }
+    return 0;
+}
+
+static int
+cgroup_filtered(const char *cgroup)
+{
+    if ((cgroup_filters & 1) &&
+	regexec(&cgroup_include, cgroup, 0, NULL, 0) != 0)
+	return 1;
+    if ((cgroup_filters & 2) &&
+	regexec(&cgroup_exclude, cgroup, 0, NULL, 0) == 0)
+	return 1;
+    return 0;
+}
+
 static void
 cgroup_scan(const char *mnt, const char *path, cgroup_refresh_t refresh,
 		const char *container, int container_length, void *arg)
@@ -526,7 +581,8 @@ cgroup_scan(const char *mnt, const char *path, cgroup_refresh_t refresh,
 	return;
 
     cgname = cgroup_name(cgpath, length);
-    if (check_refresh(cgpath + mntlen, container, container_length))
+    if (check_refresh(cgpath + mntlen, container, container_length) &&
+	!cgroup_filtered(cgname))
 	refresh(cgpath, cgname, arg);
 
     /* descend into subdirectories to find all cgroups */
@@ -560,7 +616,8 @@ cgroup_scan(const char *mnt, const char *path, cgroup_refresh_t refresh,
 	    continue;
 
 	cgname = cgroup_name(cgpath, length);
-	if (check_refresh(cgpath + mntlen, container, container_length))
+	if (check_refresh(cgpath + mntlen, container, container_length) &&
+	    !cgroup_filtered(cgname))
 	    refresh(cgpath, cgname, arg);
 	cgroup_scan(mnt, cgname, refresh, container, container_length, arg);
     }
@@ -600,7 +657,7 @@ refresh_cgroups(const char *subsys, const char *container, size_t length,
 static void
 read_pressure(FILE *fp, const char *type, cgroup_pressure_t *pp)
 {
-    static char fmt[] = "TYPE avg10=%f avg60=%f avg300=%f total=%llu\n";
+    char	fmt[] = "TYPE avg10=%f avg60=%f avg300=%f total=%llu\n";
     int		count;
 
 #ifdef __GNUC__
@@ -625,16 +682,14 @@ read_pressure(FILE *fp, const char *type, cgroup_pressure_t *pp)
 }
 
 static int
-read_pressures(const char *file, cgroup_pressures_t *pp, int full)
+read_pressures(FILE *fp, cgroup_pressures_t *pp, int full)
 {
-    FILE	*fp;
-
     memset(&pp->some, 0, sizeof(cgroup_pressure_t));
     if (full)
 	memset(&pp->full, 0, sizeof(cgroup_pressure_t));
 
-    if ((fp = fopen(file, "r")) == NULL)
-	return -oserror();
+    if (fp == NULL)
+	return -ENOENT;
 
     read_pressure(fp, "some", &pp->some);
     if (full)
@@ -852,36 +907,36 @@ setup_cpusched(void *arg)
     pmdaCacheOp(INDOM(CGROUP_CPUSCHED_INDOM), PMDA_CACHE_INACTIVE);
 }
 
+/* cgroup v2 cpu.stat - called from cgroup worker threads */
 static int
-read_cpu_time(const char *file, cgroup_cputime_t *ccp)
+read_cpu_time(FILE *fp, cgroup_cputime_t *ccp)
 {
-    static cgroup_cputime_t cputime;
-    static struct {
+    static const struct {
 	char		*field;
-	__uint64_t	*offset;
+	size_t		offset;
     } cputime_fields[] = {
-	{ "usage_usec",			&cputime.usage },
-	{ "user_usec",			&cputime.user },
-	{ "system_usec",		&cputime.system },
-	{ NULL, NULL }
+	{ "usage_usec",		offsetof(cgroup_cputime_t, usage) },
+	{ "user_usec",		offsetof(cgroup_cputime_t, user) },
+	{ "system_usec",	offsetof(cgroup_cputime_t, system) },
+	{ NULL, 0 }
     };
+    cgroup_cputime_t cputime;
     char buffer[4096], name[64];
     unsigned long long value;
-    FILE *fp;
     int i;
 
     memset(&cputime, -1, sizeof(cputime));
-    if ((fp = fopen(file, "r")) == NULL) {
+    if (fp == NULL) {
 	memcpy(ccp, &cputime, sizeof(cputime));
 	return -ENOENT;
     }
     while (fgets(buffer, sizeof(buffer), fp) != NULL) {
-	if (sscanf(buffer, "%s %llu\n", &name[0], &value) < 2)
+	if (sscanf(buffer, "%63s %llu\n", &name[0], &value) < 2)
 	    continue;
 	for (i = 0; cputime_fields[i].field != NULL; i++) {
 	    if (strcmp(name, cputime_fields[i].field) != 0)
 		continue;
-	    *cputime_fields[i].offset = value;
+	    *(__uint64_t *)((char *)&cputime + cputime_fields[i].offset) = value;
 	    break;
 	}
     }
@@ -971,91 +1026,93 @@ setup_memory(void *arg)
     pmdaCacheOp(INDOM(CGROUP_MEMORY_INDOM), PMDA_CACHE_INACTIVE);
 }
 
+#define MEMSTAT(field)	offsetof(cgroup_memstat_t, field)
+
+/* memory.stat - v1, and v2 from cgroup worker threads */
 static int
-read_memory_stats(const char *file, cgroup_memstat_t *cmp)
+read_memory_stats(FILE *fp, cgroup_memstat_t *cmp)
 {
-    static cgroup_memstat_t memory;
-    static struct {
+    static const struct {
 	char		*field;
-	__uint64_t	*offset;
+	size_t		offset;
     } memory_fields[] = {
-	{ "active_anon",		&memory.active_anon },
-	{ "active_file",		&memory.active_file },
-	{ "anon",			&memory.anon },
-	{ "anon_thp",			&memory.anon_thp },
-	{ "cache",			&memory.cache },
-	{ "file",			&memory.file },
-	{ "file_dirty",			&memory.file_dirty },
-	{ "file_mapped",		&memory.file_mapped },
-	{ "file_writeback",		&memory.file_writeback },
-	{ "inactive_anon",		&memory.inactive_anon },
-	{ "inactive_file",		&memory.inactive_file },
-	{ "kernel_stack",		&memory.kernel_stack },
-	{ "mapped_file",		&memory.mapped_file },
-	{ "pgactivate",			&memory.pgactivate },
-	{ "pgdeactivate",		&memory.pgdeactivate },
-	{ "pgfault",			&memory.pgfault },
-	{ "pglazyfree",			&memory.pglazyfree },
-	{ "pglazyfreed",		&memory.pglazyfreed },
-	{ "pgmajfault",			&memory.pgmajfault },
-	{ "pgpgin",			&memory.pgpgin },
-	{ "pgpgout",			&memory.pgpgout },
-	{ "pgrefill",			&memory.pgrefill },
-	{ "pgscan",			&memory.pgscan },
-	{ "pgsteal",			&memory.pgsteal },
-	{ "recent_rotated_anon",	&memory.recent_rotated_anon },
-	{ "recent_rotated_file",	&memory.recent_rotated_file },
-	{ "recent_scanned_anon",	&memory.recent_scanned_anon },
-	{ "recent_scanned_file",	&memory.recent_scanned_file },
-	{ "rss",			&memory.rss },
-	{ "rss_huge",			&memory.rss_huge },
-	{ "shmem",			&memory.shmem },
-	{ "slab",			&memory.slab },
-	{ "slab_reclaimable",		&memory.slab_reclaimable },
-	{ "slab_unreclaimable",		&memory.slab_unreclaimable },
-	{ "sock",			&memory.sock },
-	{ "swap",			&memory.swap },
-	{ "thp_collapse_alloc",		&memory.thp_collapse_alloc },
-	{ "thp_fault_alloc",		&memory.thp_fault_alloc },
-	{ "total_cache",		&memory.total_cache },
-	{ "total_rss",			&memory.total_rss },
-	{ "total_rss_huge",		&memory.total_rss_huge },
-	{ "total_mapped_file",		&memory.total_mapped_file },
-	{ "total_writeback",		&memory.total_writeback },
-	{ "total_swap",			&memory.total_swap },
-	{ "total_pgpgin",		&memory.total_pgpgin },
-	{ "total_pgpgout",		&memory.total_pgpgout },
-	{ "total_pgfault",		&memory.total_pgfault },
-	{ "total_pgmajfault",		&memory.total_pgmajfault },
-	{ "total_inactive_anon",	&memory.total_inactive_anon },
-	{ "total_active_anon",		&memory.total_active_anon },
-	{ "total_inactive_file",	&memory.total_inactive_file },
-	{ "total_active_file",		&memory.total_active_file },
-	{ "total_unevictable",		&memory.total_unevictable },
-	{ "unevictable",		&memory.unevictable },
-	{ "workingset_activate",	&memory.workingset_activate },
-	{ "workingset_nodereclaim",	&memory.workingset_nodereclaim },
-	{ "workingset_refault",		&memory.workingset_refault },
-	{ "writeback",			&memory.writeback },
-	{ NULL, NULL }
+	{ "active_anon",		MEMSTAT(active_anon) },
+	{ "active_file",		MEMSTAT(active_file) },
+	{ "anon",			MEMSTAT(anon) },
+	{ "anon_thp",			MEMSTAT(anon_thp) },
+	{ "cache",			MEMSTAT(cache) },
+	{ "file",			MEMSTAT(file) },
+	{ "file_dirty",			MEMSTAT(file_dirty) },
+	{ "file_mapped",		MEMSTAT(file_mapped) },
+	{ "file_writeback",		MEMSTAT(file_writeback) },
+	{ "inactive_anon",		MEMSTAT(inactive_anon) },
+	{ "inactive_file",		MEMSTAT(inactive_file) },
+	{ "kernel_stack",		MEMSTAT(kernel_stack) },
+	{ "mapped_file",		MEMSTAT(mapped_file) },
+	{ "pgactivate",			MEMSTAT(pgactivate) },
+	{ "pgdeactivate",		MEMSTAT(pgdeactivate) },
+	{ "pgfault",			MEMSTAT(pgfault) },
+	{ "pglazyfree",			MEMSTAT(pglazyfree) },
+	{ "pglazyfreed",		MEMSTAT(pglazyfreed) },
+	{ "pgmajfault",			MEMSTAT(pgmajfault) },
+	{ "pgpgin",			MEMSTAT(pgpgin) },
+	{ "pgpgout",			MEMSTAT(pgpgout) },
+	{ "pgrefill",			MEMSTAT(pgrefill) },
+	{ "pgscan",			MEMSTAT(pgscan) },
+	{ "pgsteal",			MEMSTAT(pgsteal) },
+	{ "recent_rotated_anon",	MEMSTAT(recent_rotated_anon) },
+	{ "recent_rotated_file",	MEMSTAT(recent_rotated_file) },
+	{ "recent_scanned_anon",	MEMSTAT(recent_scanned_anon) },
+	{ "recent_scanned_file",	MEMSTAT(recent_scanned_file) },
+	{ "rss",			MEMSTAT(rss) },
+	{ "rss_huge",			MEMSTAT(rss_huge) },
+	{ "shmem",			MEMSTAT(shmem) },
+	{ "slab",			MEMSTAT(slab) },
+	{ "slab_reclaimable",		MEMSTAT(slab_reclaimable) },
+	{ "slab_unreclaimable",		MEMSTAT(slab_unreclaimable) },
+	{ "sock",			MEMSTAT(sock) },
+	{ "swap",			MEMSTAT(swap) },
+	{ "thp_collapse_alloc",		MEMSTAT(thp_collapse_alloc) },
+	{ "thp_fault_alloc",		MEMSTAT(thp_fault_alloc) },
+	{ "total_cache",		MEMSTAT(total_cache) },
+	{ "total_rss",			MEMSTAT(total_rss) },
+	{ "total_rss_huge",		MEMSTAT(total_rss_huge) },
+	{ "total_mapped_file",		MEMSTAT(total_mapped_file) },
+	{ "total_writeback",		MEMSTAT(total_writeback) },
+	{ "total_swap",			MEMSTAT(total_swap) },
+	{ "total_pgpgin",		MEMSTAT(total_pgpgin) },
+	{ "total_pgpgout",		MEMSTAT(total_pgpgout) },
+	{ "total_pgfault",		MEMSTAT(total_pgfault) },
+	{ "total_pgmajfault",		MEMSTAT(total_pgmajfault) },
+	{ "total_inactive_anon",	MEMSTAT(total_inactive_anon) },
+	{ "total_active_anon",		MEMSTAT(total_active_anon) },
+	{ "total_inactive_file",	MEMSTAT(total_inactive_file) },
+	{ "total_active_file",		MEMSTAT(total_active_file) },
+	{ "total_unevictable",		MEMSTAT(total_unevictable) },
+	{ "unevictable",		MEMSTAT(unevictable) },
+	{ "workingset_activate",	MEMSTAT(workingset_activate) },
+	{ "workingset_nodereclaim",	MEMSTAT(workingset_nodereclaim) },
+	{ "workingset_refault",		MEMSTAT(workingset_refault) },
+	{ "writeback",			MEMSTAT(writeback) },
+	{ NULL, 0 }
     };
+    cgroup_memstat_t memory;
     char buffer[4096], name[64];
     unsigned long long value;
-    FILE *fp;
     int i;
 
     memset(&memory, -1, sizeof(memory));
-    if ((fp = fopen(file, "r")) == NULL) {
+    if (fp == NULL) {
 	memcpy(cmp, &memory, sizeof(memory));
 	return -ENOENT;
     }
     while (fgets(buffer, sizeof(buffer), fp) != NULL) {
-	if (sscanf(buffer, "%s %llu\n", &name[0], &value) < 2)
+	if (sscanf(buffer, "%63s %llu\n", &name[0], &value) < 2)
 	    continue;
 	for (i = 0; memory_fields[i].field != NULL; i++) {
 	    if (strcmp(name, memory_fields[i].field) != 0)
 		continue;
-	    *memory_fields[i].offset = value;
+	    *(__uint64_t *)((char *)&memory + memory_fields[i].offset) = value;
 	    break;
 	}
     }
@@ -1084,7 +1141,7 @@ refresh_memory(const char *path, const char *name, void *arg)
 	return;
 
     pmsprintf(file, sizeof(file), "%s/%s", path, "memory.stat");
-    read_memory_stats(file, &memory->stat);
+    read_memory_stats(fopen(file, "r"), &memory->stat);
     pmsprintf(file, sizeof(file), "%s/%s", path, "memory.current");
     read_oneline_ull(file, &memory->current);
     pmsprintf(file, sizeof(file), "%s/%s", path, "memory.limit_in_bytes");
@@ -1447,42 +1504,369 @@ get_perdev_iostat(pmInDom indom, const char *name, const char *disk,
     return cdevp;
 }
 
+/* cgroup v2 io.stat - called from cgroup worker threads */
 static int
-read_io_stats(const char *file, const char *name)
+read_io_stats(FILE *fp, cgroup2_t *cgroup)
 {
-    pmInDom indom = INDOM(CGROUP2_PERDEV_INDOM);
-    pmInDom devtindom = INDOM(DEVT_INDOM);
-    cgroup_perdev_iostat_t *iodev;
+    cgroup_devt_iostat_t *devices, *iodev;
     char buffer[4096];
-    FILE *fp;
+    unsigned int size;
+    int i;
 
-    if ((fp = fopen(file, "r")) == NULL)
+    cgroup->ndevices = 0;
+    if (fp == NULL)
 	return -ENOENT;
 
     while (fgets(buffer, sizeof(buffer), fp) != NULL) {
-	unsigned int major, minor;
-	cgroup_iostat_t io;
-	char *devname;
-	int i;
-
+	if (cgroup->ndevices == cgroup->maxdevices) {
+	    size = cgroup->maxdevices ? cgroup->maxdevices * 2 : 4;
+	    devices = realloc(cgroup->devices, size * sizeof(*devices));
+	    if (devices == NULL)
+		break;
+	    cgroup->devices = devices;
+	    cgroup->maxdevices = size;
+	}
+	iodev = &cgroup->devices[cgroup->ndevices];
 	i = sscanf(buffer, "%u:%u rbytes=%llu wbytes=%llu rios=%llu wios=%llu "
-			   "dbytes=%llu dios=%llu\n", &major, &minor,
-		(unsigned long long *)&io.rbytes, (unsigned long long *)&io.wbytes,
-		(unsigned long long *)&io.rios, (unsigned long long *)&io.wios,
-		(unsigned long long *)&io.dbytes, (unsigned long long *)&io.dios);
-	if (i < 8)
-	    continue;
-	if ((devname = get_blkdev(devtindom, major, minor)) == NULL)
-	    continue;
-	/* all device fields are now acquired, update indom and cgroup total */
-	iodev = get_perdev_iostat(indom, name, devname, buffer, sizeof(buffer));
-	iodev->stats = io;	/* struct copy */
-	pmdaCacheStore(indom, PMDA_CACHE_ADD, buffer, iodev);
+			   "dbytes=%llu dios=%llu\n", &iodev->major, &iodev->minor,
+		(unsigned long long *)&iodev->stats.rbytes,
+		(unsigned long long *)&iodev->stats.wbytes,
+		(unsigned long long *)&iodev->stats.rios,
+		(unsigned long long *)&iodev->stats.wios,
+		(unsigned long long *)&iodev->stats.dbytes,
+		(unsigned long long *)&iodev->stats.dios);
+	if (i == 8)
+	    cgroup->ndevices++;
     }
     fclose(fp);
     return 0;
 }
 
+static FILE *
+cgroup2_fopen(cgroup2_t *cgroup, const char *file)
+{
+    FILE *fp;
+    int fd;
+
+    if (cgroup->dirfd < 0)
+	return NULL;
+    if ((fd = openat(cgroup->dirfd, file, O_RDONLY|O_CLOEXEC)) < 0)
+	return NULL;
+    if ((fp = fdopen(fd, "r")) == NULL)
+	close(fd);
+    return fp;
+}
+
+static int
+read_oneline_ull_at(cgroup2_t *cgroup, const char *file, __uint64_t *value)
+{
+    char buffer[64], *endp;
+    FILE *fp;
+    int sts = -ENOENT;
+
+    if ((fp = cgroup2_fopen(cgroup, file)) != NULL) {
+	sts = fgets(buffer, sizeof(buffer), fp) != NULL ? 0 : -ENOMEM;
+	fclose(fp);
+    }
+    *value = sts < 0 ? ULONGLONG_MAX : strtoull(buffer, &endp, 0);
+    return sts;
+}
+
+static void
+cgroup2_opendir(cgroup2_t *cgroup)
+{
+    if (cgroup->dirfd >= 0)
+	close(cgroup->dirfd);
+    cgroup->dirfd = open(cgroup->path, O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+}
+
+/*
+ * Returns the "populated" value from cgroup.events, i.e. whether any
+ * task is in this cgroup or its descendants - or -1 if unavailable,
+ * as for the root cgroup.
+ */
+static int
+cgroup2_populated(cgroup2_t *cgroup)
+{
+    char buffer[64];
+    int populated = -1;
+    FILE *fp;
+
+    if ((fp = cgroup2_fopen(cgroup, "cgroup.events")) == NULL &&
+	cgroup->populated >= 0) {
+	/* cgroup removed (and possibly recreated) since last opened */
+	cgroup2_opendir(cgroup);
+	cgroup->idle = 0;
+	fp = cgroup2_fopen(cgroup, "cgroup.events");
+    }
+    if (fp != NULL) {
+	while (fgets(buffer, sizeof(buffer), fp) != NULL)
+	    if (sscanf(buffer, "populated %d", &populated) == 1)
+		break;
+	fclose(fp);
+    }
+    return cgroup->populated = populated;
+}
+
+/*
+ * Read the cgroup v2 files needed for one cgroup, relative to its open
+ * directory.  Called from cgroup worker threads, so only the cgroup2_t
+ * (and memory buffer) is modified here - indom updates are made later
+ * by cgroup2_merge() in the main thread.
+ *
+ * Counters of a cgroup without any tasks cannot change, so these are
+ * only read once while it remains unpopulated, and then at the usual
+ * rescan interval.  Pressure averages decay and are always read.
+ */
+static void
+cgroup2_read(cgroup2_t *cgroup, time_t now)
+{
+    cgroup_memory_t *memory = cgroup->memory;
+    unsigned int files, skip = 0;
+
+    if (cgroup->dirfd < 0)
+	cgroup2_opendir(cgroup);
+
+    if (cgroup2_populated(cgroup) == 0) {
+	if (cgroup->idle && now >= cgroup->idlestamp + proc_rescan_interval)
+	    cgroup->idle = 0;
+	if (cgroup->idle == 0)
+	    cgroup->idlestamp = now;
+	skip = cgroup->idle;
+	cgroup->idle |= cgroup->wanted & CG2_IDLE_FILES;
+    } else {
+	cgroup->idle = 0;
+    }
+    files = cgroup->wanted & ~skip;
+
+    if (files & CG2_CPU_PRESSURE)
+	read_pressures(cgroup2_fopen(cgroup, "cpu.pressure"),
+			&cgroup->cpu_pressures, 0);
+    if (files & CG2_CPU_STAT)
+	read_cpu_time(cgroup2_fopen(cgroup, "cpu.stat"), &cgroup->cputime);
+    if (files & CG2_IO_PRESSURE)
+	read_pressures(cgroup2_fopen(cgroup, "io.pressure"),
+			&cgroup->io_pressures, 1);
+    if (files & CG2_IO_STAT)
+	read_io_stats(cgroup2_fopen(cgroup, "io.stat"), cgroup);
+    if (files & CG2_MEM_PRESSURE)
+	read_pressures(cgroup2_fopen(cgroup, "memory.pressure"),
+			&cgroup->mem_pressures, 1);
+    if (files & CG2_MEMORY) {
+	cgroup->memory_ok = (read_memory_stats(
+			cgroup2_fopen(cgroup, "memory.stat"), &memory->stat) == 0);
+	if (cgroup->memory_ok) {
+	    read_oneline_ull_at(cgroup, "memory.current", &memory->current);
+	    read_oneline_ull_at(cgroup, "memory.limit_in_bytes", &memory->limit);
+	    read_oneline_ull_at(cgroup, "memory.usage_in_bytes", &memory->usage);
+	    read_oneline_ull_at(cgroup, "memory.failcnt", &memory->failcnt);
+	}
+    }
+}
+
+/*
+ * Pool of threads reading cgroup v2 files, with the main thread
+ * also taking part - each refresh hands out the queued cgroups one
+ * at a time and waits until all have been read.
+ */
+static struct {
+    pthread_mutex_t	lock;
+    pthread_cond_t	ready;		/* cgroups queued for reading */
+    pthread_cond_t	done;		/* all queued cgroups have been read */
+    cgroup2_t		**work;
+    unsigned int	count;
+    unsigned int	next;
+    unsigned int	finished;
+    time_t		now;
+    int			started;	/* number of worker threads */
+} cgpool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .ready = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+};
+
+static void *
+cgroup2_worker(void *arg)
+{
+    cgroup2_t *cgroup;
+    time_t now;
+
+    (void)arg;
+    pthread_mutex_lock(&cgpool.lock);
+    for (;;) {
+	while (cgpool.next >= cgpool.count)
+	    pthread_cond_wait(&cgpool.ready, &cgpool.lock);
+	cgroup = cgpool.work[cgpool.next++];
+	now = cgpool.now;
+	pthread_mutex_unlock(&cgpool.lock);
+	cgroup2_read(cgroup, now);
+	pthread_mutex_lock(&cgpool.lock);
+	if (++cgpool.finished == cgpool.count)
+	    pthread_cond_signal(&cgpool.done);
+    }
+    return NULL;
+}
+
+static void
+cgroup2_start(void)
+{
+    pthread_attr_t attr;
+    pthread_t tid;
+    int i, sts;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    for (i = 1; i < cgroup_threads; i++) {
+	if ((sts = pthread_create(&tid, &attr, cgroup2_worker, NULL)) != 0) {
+	    pmNotifyErr(LOG_WARNING, "cgroup worker thread create failed: %s",
+			    pmErrStr(-sts));
+	    break;
+	}
+	cgpool.started++;
+    }
+    pthread_attr_destroy(&attr);
+    cgroup_threads = cgpool.started + 1;
+}
+
+static void
+cgroup2_collect(cgroup2_t **work, unsigned int count)
+{
+    cgroup2_t *cgroup;
+    time_t now = time(NULL);
+    unsigned int i;
+
+    if (cgroup_threads > 1 && cgpool.started == 0)
+	cgroup2_start();
+
+    if (cgpool.started == 0 || count < 2) {
+	for (i = 0; i < count; i++)
+	    cgroup2_read(work[i], now);
+	return;
+    }
+
+    pthread_mutex_lock(&cgpool.lock);
+    cgpool.work = work;
+    cgpool.count = count;
+    cgpool.next = cgpool.finished = 0;
+    cgpool.now = now;
+    pthread_cond_broadcast(&cgpool.ready);
+    while (cgpool.next < cgpool.count) {
+	cgroup = cgpool.work[cgpool.next++];
+	pthread_mutex_unlock(&cgpool.lock);
+	cgroup2_read(cgroup, now);
+	pthread_mutex_lock(&cgpool.lock);
+	cgpool.finished++;
+    }
+    while (cgpool.finished < cgpool.count)
+	pthread_cond_wait(&cgpool.done, &cgpool.lock);
+    cgpool.count = cgpool.next = 0;
+    pthread_mutex_unlock(&cgpool.lock);
+}
+
+/* cgroups queued by refresh_all(), and those queued in the previous refresh */
+static cgroup2_t	**cg2_work, **cg2_open;
+static unsigned int	cg2_nwork, cg2_maxwork, cg2_nopen, cg2_maxopen;
+static unsigned int	cg2_generation;
+
+static void
+cgroup2_queue(cgroup2_t *cgroup)
+{
+    cgroup2_t **work;
+    unsigned int size;
+
+    if (cg2_nwork == cg2_maxwork) {
+	size = cg2_maxwork ? cg2_maxwork * 2 : 64;
+	if ((work = realloc(cg2_work, size * sizeof(*work))) == NULL)
+	    return;
+	cg2_work = work;
+	cg2_maxwork = size;
+    }
+    cgroup->refreshed = cg2_generation;
+    cg2_work[cg2_nwork++] = cgroup;
+}
+
+/* update the per-device and memory indoms from one cgroups file values */
+static void
+cgroup2_merge(cgroup2_t *cgroup)
+{
+    pmInDom indom = INDOM(CGROUP2_PERDEV_INDOM);
+    pmInDom devtindom = INDOM(DEVT_INDOM);
+    cgroup_perdev_iostat_t *iodev;
+    cgroup_devt_iostat_t *devt;
+    char *devname, *escname, escbuf[MAXPATHLEN];
+    char buffer[MAXPATHLEN+16];
+    unsigned int i;
+
+    if (cgroup->wanted & CG2_IO_STAT) {
+	for (i = 0; i < cgroup->ndevices; i++) {
+	    devt = &cgroup->devices[i];
+	    if ((devname = get_blkdev(devtindom, devt->major, devt->minor)) == NULL)
+		continue;
+	    iodev = get_perdev_iostat(indom, cgroup->name, devname,
+				buffer, sizeof(buffer));
+	    if (iodev == NULL)
+		continue;
+	    iodev->stats = devt->stats;	/* struct copy */
+	    pmdaCacheStore(indom, PMDA_CACHE_ADD, buffer, iodev);
+	}
+    }
+
+    if ((cgroup->wanted & CG2_MEMORY) && cgroup->memory_ok) {
+	indom = INDOM(CGROUP_MEMORY_INDOM);
+	escname = unit_name_unescape(cgroup->name, escbuf);
+	if (pmdaCacheLookupName(indom, escname, NULL, NULL) != PMDA_CACHE_ACTIVE) {
+	    cgroup->memory->container = cgroup->container;
+	    pmdaCacheStore(indom, PMDA_CACHE_ADD, escname, cgroup->memory);
+	}
+    }
+}
+
+/*
+ * Directories of cgroups are kept open between refreshes, up to half
+ * the open files limit - those of cgroups that have gone are closed.
+ */
+static void
+cgroup2_release(void)
+{
+    static unsigned int	maxfds;
+    struct rlimit	limit;
+    cgroup2_t		**open;
+    unsigned int	i, nfds, size;
+
+    if (maxfds == 0) {
+	if (getrlimit(RLIMIT_NOFILE, &limit) < 0 ||
+	    limit.rlim_cur == RLIM_INFINITY)
+	    maxfds = 4096;
+	else
+	    maxfds = limit.rlim_cur / 2;
+    }
+
+    for (i = 0; i < cg2_nopen; i++) {
+	if (cg2_open[i]->refreshed != cg2_generation &&
+	    cg2_open[i]->dirfd >= 0) {
+	    close(cg2_open[i]->dirfd);
+	    cg2_open[i]->dirfd = -1;
+	}
+    }
+
+    /* this refresh work becomes the open list, reusing the old array */
+    open = cg2_open;
+    size = cg2_maxopen;
+    cg2_open = cg2_work;
+    cg2_nopen = cg2_nwork;
+    cg2_maxopen = cg2_maxwork;
+    cg2_work = open;
+    cg2_maxwork = size;
+    cg2_nwork = 0;
+
+    for (i = nfds = 0; i < cg2_nopen; i++) {
+	if (cg2_open[i]->dirfd < 0 || ++nfds <= maxfds)
+	    continue;
+	close(cg2_open[i]->dirfd);
+	cg2_open[i]->dirfd = -1;
+    }
+}
+
 void
 setup_all(void *arg)
 {
@@ -1529,44 +1913,47 @@ refresh_all(const char *path, const char *name, void *arg)
 
     escname = unit_name_unescape(name, escbuf);
     sts = pmdaCacheLookupName(indom, escname, NULL, (void **)&cgroup);
-    if (sts == PMDA_CACHE_ACTIVE)
-	goto v1;
-    if (sts != PMDA_CACHE_INACTIVE &&
-	(cgroup = (cgroup2_t *)calloc(1, sizeof(cgroup2_t))) == NULL)
-	goto v1;
-
-    if (need_refresh[CLUSTER_CGROUP2_CPU_PRESSURE]) {
-	pmsprintf(file, sizeof(file), "%s/%s", path, "cpu.pressure");
-	read_pressures(file, &cgroup->cpu_pressures, 0);
-    }
-
-    if (need_refresh[CLUSTER_CGROUP2_CPU_STAT]) {
-	pmsprintf(file, sizeof(file), "%s/%s", path, "cpu.stat");
-	read_cpu_time(file, &cgroup->cputime);
-    }
-
-    if (need_refresh[CLUSTER_CGROUP2_IO_PRESSURE]) {
-	pmsprintf(file, sizeof(file), "%s/%s", path, "io.pressure");
-	read_pressures(file, &cgroup->io_pressures, 1);
-    }
-
-    if (need_refresh[CLUSTER_CGROUP2_IO_STAT]) {
-	pmsprintf(file, sizeof(file), "%s/%s", path, "io.stat");
-	read_io_stats(file, name);
+    if (sts == PMDA_CACHE_ACTIVE && cgroup->refreshed == cg2_generation)
+	goto v1;	/* already queued during this refresh */
+    if (sts < 0) {
+	if ((cgroup = (cgroup2_t *)calloc(1, sizeof(cgroup2_t))) == NULL)
+	    goto v1;
+	if ((cgroup->path = strdup(path)) == NULL ||
+	    (cgroup->name = strdup(name)) == NULL) {
+	    free(cgroup->path);
+	    free(cgroup);
+	    goto v1;
+	}
+	cgroup->dirfd = -1;
+	cgroup->populated = -1;
     }
 
-    if (need_refresh[CLUSTER_CGROUP2_MEM_PRESSURE]) {
-	pmsprintf(file, sizeof(file), "%s/%s", path, "memory.pressure");
-	read_pressures(file, &cgroup->mem_pressures, 1);
+    /* the files are read later, by cgroup2_collect() */
+    cgroup->wanted = 0;
+    if (need_refresh[CLUSTER_CGROUP2_CPU_PRESSURE])
+	cgroup->wanted |= CG2_CPU_PRESSURE;
+    if (need_refresh[CLUSTER_CGROUP2_CPU_STAT])
+	cgroup->wanted |= CG2_CPU_STAT;
+    if (need_refresh[CLUSTER_CGROUP2_IO_PRESSURE])
+	cgroup->wanted |= CG2_IO_PRESSURE;
+    if (need_refresh[CLUSTER_CGROUP2_IO_STAT])
+	cgroup->wanted |= CG2_IO_STAT;
+    if (need_refresh[CLUSTER_CGROUP2_MEM_PRESSURE])
+	cgroup->wanted |= CG2_MEM_PRESSURE;
+    if (need_refresh[CLUSTER_MEMORY_GROUPS]) {
+	if (cgroup->memory == NULL)
+	    cgroup->memory = (cgroup_memory_t *)calloc(1, sizeof(cgroup_memory_t));
+	if (cgroup->memory != NULL)
+	    cgroup->wanted |= CG2_MEMORY;
     }
 
     cgroup_container(name, id, sizeof(id), &cgroup->container);
     pmdaCacheStore(indom, PMDA_CACHE_ADD, escname, cgroup);
+    cgroup2_queue(cgroup);
 
 v1:
     /*
-     * Deprecated v1 cgroup subsystems follow, some rarely used now
-     * (memory stats, however, are still always handled this way).
+     * Deprecated v1 cgroup subsystems follow, some rarely used now.
      */
 
     if (need_refresh[CLUSTER_CPUSET_GROUPS]) {
@@ -1587,12 +1974,6 @@ v1:
 	    refresh_cpusched(path, name, NULL);
     }
 
-    if (need_refresh[CLUSTER_MEMORY_GROUPS]) {
-	pmsprintf(file, sizeof(file), "%s/%s", path, "memory.stat");
-	if (access(file, R_OK) == 0)
-	    refresh_memory(path, name, NULL);
-    }
-
     if (need_refresh[CLUSTER_NETCLS_GROUPS]) {
 	pmsprintf(file, sizeof(file), "%s/%s", path, "net_cls.classid");
 	if (access(file, R_OK) == 0)
@@ -1609,5 +1990,13 @@ v1:
 void
 refresh_cgroups2(const char *cgroup, size_t cgrouplen, void *arg)
 {
+    unsigned int i;
+
+    cg2_generation++;
     refresh_cgroups(NULL, cgroup, cgrouplen, setup_all, refresh_all, arg);
+
+    cgroup2_collect(cg2_work, cg2_nwork);
+    for (i = 0; i < cg2_nwork; i++)
+	cgroup2_merge(cg2_work[i]);
+    cgroup2_release();
 }
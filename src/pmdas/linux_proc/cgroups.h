@@ -456,6 +456,24 @@ enum {
     CG_IO_STAT_DIOS			= 5,
 };
 
+typedef struct {
+    unsigned int	major;
+    unsigned int	minor;
+    cgroup_iostat_t	stats;
+} cgroup_devt_iostat_t;
+
+/* cgroup v2 files, read concurrently by the cgroup worker threads */
+enum {
+    CG2_CPU_PRESSURE			= (1<<0),
+    CG2_CPU_STAT			= (1<<1),
+    CG2_IO_PRESSURE			= (1<<2),
+    CG2_IO_STAT				= (1<<3),
+    CG2_MEM_PRESSURE			= (1<<4),
+    CG2_MEMORY				= (1<<5),
+};
+/* files whose values cannot change without tasks in the cgroup */
+#define CG2_IDLE_FILES	(CG2_CPU_STAT | CG2_IO_STAT | CG2_MEMORY)
+
 typedef struct {
     cgroup_pressures_t	cpu_pressures;
     cgroup_pressures_t	io_pressures;
@@ -463,6 +481,21 @@ typedef struct {
     cgroup_cputime_t	cputime;
     /* I/O stats are per-cgroup::per-device */
     int			container;
+
+    /* private state for the worker threads and cgroup2_merge() */
+    char		*path;		/* sysfs directory of this cgroup */
+    char		*name;		/* instance name (unescaped) */
+    int			dirfd;		/* open across refreshes, or -1 */
+    int			populated;	/* last cgroup.events value, or -1 */
+    unsigned int	refreshed;	/* generation of last refresh */
+    unsigned int	wanted;		/* CG2_* files needed this refresh */
+    unsigned int	idle;		/* CG2_* files read while unpopulated */
+    time_t		idlestamp;
+    int			memory_ok;
+    cgroup_memory_t	*memory;	/* memory.stat, memory.current */
+    unsigned int	ndevices;
+    unsigned int	maxdevices;
+    cgroup_devt_iostat_t *devices;	/* io.stat lines */
 } cgroup2_t;
 
 enum {
@@ -486,6 +519,9 @@ extern void refresh_cgroups2(const char *, size_t, void *);
 extern char *cgroup_container_path(char *, size_t, const char *);
 extern char *cgroup_container_search(const char *, char *, int);
 
+extern int cgroup_filter(const char *, const char *);
+extern int cgroup_threads;
+
 extern unsigned int cgroup_version;
 
 #endif /* _CGROUP_H */
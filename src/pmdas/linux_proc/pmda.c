@@ -3777,6 +3777,7 @@ proc_init(pmdaInterface *dp)
 	pmsprintf(helppath, sizeof(helppath), "%s%c" "proc" "%c" "help",
 		pmGetConfig("PCP_PMDAS_DIR"), sep, sep);
 	pmdaDSO(dp, PMDA_INTERFACE_7, "proc DSO", helppath);
+	cgroup_threads = 0;	/* no threads inside pmcd */
     }
 
     if (dp->status != 0)
@@ -3834,6 +3835,7 @@ proc_init(pmdaInterface *dp)
     acct_init(&proc_acct);
 
     tty_driver_init();
+    proc_events_init();
 
     rootfd = pmdaRootConnect(NULL);
     pmdaSetFlags(dp, PMDA_EXT_FLAG_HASHED);
@@ -3867,13 +3869,17 @@ pmLongOptions	longopts[] = {
     PMDAOPT_LOGFILE,
     { "with-threads", 0, 'L', 0, "include threads in the all-processes instance domain" },
     { "from-cgroup", 1, 'r', "NAME", "restrict monitoring to processes in the named cgroup" },
+    { "rescan", 1, 'R', "SECS", "interval between full scans of /proc [default 60, 0 to always scan]" },
+    { "cgroup-include", 1, 'g', "REGEX", "only report cgroups with names matching an extended regular expression" },
+    { "cgroup-exclude", 1, 'G', "REGEX", "do not report cgroups with names matching an extended regular expression" },
+    { "cgroup-threads", 1, 't', "N", "threads reading cgroup files [default 4, 1 for none]" },
     PMDAOPT_USERNAME,
     PMOPT_HELP,
     PMDA_OPTIONS_END
 };
 
 pmdaOptions	opts = {
-    .short_options = "AD:d:l:Lr:U:?",
+    .short_options = "AD:d:g:G:l:Lr:R:t:U:?",
     .long_options = longopts,
 };
 
@@ -3884,6 +3890,8 @@ main(int argc, char **argv)
     pmdaInterface	dispatch;
     char		helppath[MAXPATHLEN];
     char		*username = "root";
+    char		*include = NULL, *exclude = NULL;
+    char		*endnum;
 
     _isDSO = 0;
     pmSetProgname(argv[0]);
@@ -3902,8 +3910,27 @@ main(int argc, char **argv)
 	case 'r':
 	    cgroups = opts.optarg;
 	    break;
+	case 'R':
+	    proc_rescan_interval = atoi(opts.optarg);
+	    break;
+	case 'g':
+	    include = opts.optarg;
+	    break;
+	case 'G':
+	    exclude = opts.optarg;
+	    break;
+	case 't':
+	    cgroup_threads = (int)strtol(opts.optarg, &endnum, 10);
+	    if (*endnum != '\0' || cgroup_threads < 1) {
+		pmprintf("%s: -t requires a positive number of threads\n",
+			pmGetProgname());
+		opts.errors++;
+	    }
+	    break;
 	}
     }
+    if (cgroup_filter(include, exclude) < 0)
+	opts.errors++;
 
     if (opts.errors) {
 	pmdaUsageMessage(&opts);
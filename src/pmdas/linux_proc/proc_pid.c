@@ -23,6 +23,11 @@
 #include <dirent.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
 #include <pwd.h>
 #include <grp.h>
 #include "proc_pid.h"
@@ -34,11 +39,18 @@ static size_t	procbuflen;
 static char	*procbuf;
 
 static proc_pid_list_t procpids; /* previous pids list that the proc pmda uses */
+
+int		proc_rescan_interval = 60; /* full /proc scans, seconds */
+static int	events_fd = -1;	/* proc connector socket, or -1 */
+
+static int	dirfd_count;	/* number of cached /proc/<pid> directories */
+static int	dirfd_limit = -1; /* upper bound on dirfd_count */
 static void refresh_proc_pidlist(proc_pid_t *, proc_pid_list_t *, proc_runq_t *);
 static int refresh_proc_pid_stat(proc_pid_entry_t *);
 static int refresh_proc_pid_status(proc_pid_entry_t *);
 static int refresh_proc_pid_io(proc_pid_entry_t *);
 static int refresh_proc_pid_schedstat(proc_pid_entry_t *);
+static void proc_closedir_fd(proc_pid_entry_t *);
 
 /* Hotproc variables */
 
@@ -46,6 +58,10 @@ static int refresh_proc_pid_schedstat(proc_pid_entry_t *);
  * need a seperate list since it is generated by the timer update.
 */
 static proc_pid_list_t hotpids;
+static proc_pid_list_t hotevalpids; /* all processes, for hotproc evaluation */
+
+/* pid lists that may be maintained from process events */
+static proc_pid_list_t *eventpids[] = { &procpids, &hotevalpids };
 /* Hold a pointer to this since we need it for the timer */
 static proc_pid_t *hotproc_poss_pid;
 
@@ -156,6 +172,200 @@ tasklist_append(const char *pid, proc_pid_list_t *pids)
     }
 }
 
+/*
+ * Insert or remove one pid in a sorted list, e.g. from process events
+ */
+static int
+pidlist_search(int pid, proc_pid_list_t *pids)
+{
+    int			lo = 0, hi = pids->count, mid;
+
+    while (lo < hi) {
+	mid = (lo + hi) / 2;
+	if (pids->pids[mid] < pid)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    return lo;
+}
+
+static void
+pidlist_insert_pid(int pid, proc_pid_list_t *pids)
+{
+    int			i = pidlist_search(pid, pids);
+
+    if (i < pids->count && pids->pids[i] == pid)
+	return;
+    pidlist_append_pid(pid, pids);
+    if (i >= pids->count - 1)
+	return;
+    memmove(&pids->pids[i+1], &pids->pids[i], (pids->count-1-i) * sizeof(int));
+    pids->pids[i] = pid;
+}
+
+static void
+pidlist_remove_pid(int pid, proc_pid_list_t *pids)
+{
+    int			i = pidlist_search(pid, pids);
+
+    if (i >= pids->count || pids->pids[i] != pid)
+	return;
+    pids->count--;
+    memmove(&pids->pids[i], &pids->pids[i+1], (pids->count-i) * sizeof(int));
+}
+
+/*
+ * Subscribe to fork and exit notifications from the kernel proc
+ * connector (CN_PROC).  These incrementally maintain the global pid
+ * lists (for the proc indom and for hotproc evaluation) between full
+ * /proc scans, which are then only needed every
+ * proc_rescan_interval seconds as a consistency check, or whenever
+ * events may have been lost.  Requires CAP_NET_ADMIN, and is never
+ * used with an alternate PROC_STATSPATH (QA).
+ */
+void
+proc_events_init(void)
+{
+    struct sockaddr_nl	addr;
+    struct nlmsghdr	*nlh;
+    struct cn_msg	*cn;
+    enum proc_cn_mcast_op op = PROC_CN_MCAST_LISTEN;
+    char		buf[NLMSG_SPACE(sizeof(struct cn_msg) + sizeof(op))];
+    int			fd, size = 4 * 1024 * 1024;
+
+    if (proc_rescan_interval <= 0 || proc_statspath[0] != '\0')
+	return;
+
+    if ((fd = socket(PF_NETLINK, SOCK_DGRAM|SOCK_CLOEXEC, NETLINK_CONNECTOR)) < 0)
+	goto fail;
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = CN_IDX_PROC;
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+	goto fail;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+    memset(buf, 0, sizeof(buf));
+    nlh = (struct nlmsghdr *)buf;
+    nlh->nlmsg_len = NLMSG_LENGTH(sizeof(struct cn_msg) + sizeof(op));
+    nlh->nlmsg_type = NLMSG_DONE;
+    nlh->nlmsg_pid = getpid();
+    cn = (struct cn_msg *)NLMSG_DATA(nlh);
+    cn->id.idx = CN_IDX_PROC;
+    cn->id.val = CN_VAL_PROC;
+    cn->len = sizeof(op);
+    memcpy(cn->data, &op, sizeof(op));
+    if (send(fd, buf, nlh->nlmsg_len, 0) < 0)
+	goto fail;
+
+    if (pmDebugOptions.appl1)
+	fprintf(stderr, "%s: tracking process events, rescan every %ds\n",
+			"proc_events_init", proc_rescan_interval);
+    events_fd = fd;
+    return;
+
+fail:
+    if (pmDebugOptions.appl1)
+	fprintf(stderr, "%s: proc connector unavailable: %s\n",
+			"proc_events_init", pmErrStr(-oserror()));
+    if (fd >= 0)
+	close(fd);
+}
+
+static void
+proc_events_apply(int pid, int tgid, int fork)
+{
+    proc_pid_list_t	*pids;
+    int			i;
+
+    for (i = 0; i < sizeof(eventpids) / sizeof(eventpids[0]); i++) {
+	pids = eventpids[i];
+	if (!pids->tracked || (pid != tgid && !pids->threads))
+	    continue;
+	if (fork)
+	    pidlist_insert_pid(pid, pids);
+	else
+	    pidlist_remove_pid(pid, pids);
+    }
+}
+
+static void
+proc_events_untrack(void)
+{
+    int			i;
+
+    for (i = 0; i < sizeof(eventpids) / sizeof(eventpids[0]); i++)
+	eventpids[i]->tracked = 0;
+}
+
+/*
+ * Read all pending process events, applying them to each of the pid
+ * lists currently being tracked.  If events could have been lost all
+ * lists revert to untracked (needing a full scan) and -1 is returned.
+ */
+static int
+proc_events_drain(void)
+{
+    struct sockaddr_nl	addr;
+    struct nlmsghdr	*nlh;
+    struct cn_msg	*cn;
+    struct proc_event	*ev;
+    socklen_t		addrlen;
+    ssize_t		n;
+    int			sts = 0;
+    char		buf[16384] __attribute__((aligned(NLMSG_ALIGNTO)));
+
+    for (;;) {
+	addrlen = sizeof(addr);
+	n = recvfrom(events_fd, buf, sizeof(buf), MSG_DONTWAIT,
+			(struct sockaddr *)&addr, &addrlen);
+	if (n < 0) {
+	    if (oserror() == EAGAIN || oserror() == EWOULDBLOCK)
+		break;
+	    if (oserror() == EINTR)
+		continue;
+	    if (oserror() == ENOBUFS) {	/* overrun, events dropped */
+		sts = -1;
+		continue;
+	    }
+	    if (pmDebugOptions.appl1)
+		fprintf(stderr, "%s: recv failed: %s\n",
+			"proc_events_drain", pmErrStr(-oserror()));
+	    close(events_fd);
+	    events_fd = -1;
+	    proc_events_untrack();
+	    return -1;
+	}
+	if (addr.nl_pid != 0)	/* not from the kernel */
+	    continue;
+	for (nlh = (struct nlmsghdr *)buf; NLMSG_OK(nlh, n);
+	     nlh = NLMSG_NEXT(nlh, n)) {
+	    if (nlh->nlmsg_type == NLMSG_ERROR || nlh->nlmsg_type == NLMSG_NOOP)
+		continue;
+	    cn = (struct cn_msg *)NLMSG_DATA(nlh);
+	    if (cn->id.idx != CN_IDX_PROC || cn->id.val != CN_VAL_PROC)
+		continue;
+	    ev = (struct proc_event *)cn->data;
+	    switch (ev->what) {
+	    case PROC_EVENT_FORK:
+		proc_events_apply(ev->event_data.fork.child_pid,
+				  ev->event_data.fork.child_tgid, 1);
+		break;
+	    case PROC_EVENT_EXIT:
+		proc_events_apply(ev->event_data.exit.process_pid,
+				  ev->event_data.exit.process_tgid, 0);
+		break;
+	    default:
+		break;
+	    }
+	}
+    }
+    if (sts < 0)
+	proc_events_untrack();
+    return sts;
+}
+
 static int
 refresh_cgroup_pidlist(int want_threads, proc_pid_list_t *pids, const char *cgroup)
 {
@@ -165,6 +375,7 @@ refresh_cgroup_pidlist(int want_threads, proc_pid_list_t *pids, const char *cgro
 
     pids->count = 0;
     pids->threads = want_threads;
+    pids->tracked = 0;
 
     /*
      * We're running in cgroups mode where a subset of the processes is
@@ -202,6 +413,18 @@ refresh_global_pidlist(int want_threads, proc_pid_list_t *pids)
     DIR			*dirp;
     struct dirent	*dp;
     char		path[MAXPATHLEN];
+    time_t		now = time(NULL);
+    int			tracking = (events_fd >= 0 &&
+				   (pids == &procpids || pids == &hotevalpids));
+
+    if (tracking) {
+	if (pids->tracked && pids->threads == want_threads &&
+	    now < pids->rescan && proc_events_drain() == 0)
+	    return 0;
+	/* bring other lists up to date, dropping events before this scan */
+	pids->tracked = 0;
+	proc_events_drain();
+    }
 
     pids->count = 0;
     pids->threads = want_threads;
@@ -225,6 +448,11 @@ refresh_global_pidlist(int want_threads, proc_pid_list_t *pids)
     closedir(dirp);
 
     qsort(pids->pids, pids->count, sizeof(int), compare_pid);
+
+    if (tracking && events_fd >= 0) {
+	pids->tracked = 1;
+	pids->rescan = now + proc_rescan_interval;
+    }
     return 0;
 }
 
@@ -448,18 +676,15 @@ hotproc_eval_procs(void)
 
     memset(&vars, 0, sizeof(config_vars));
 
-    hotpids.count = 0;
-    hotpids.threads = 0;
-
     /* Whats running right now */
-    refresh_global_pidlist(0, &hotpids);
-    refresh_proc_pidlist(hotproc_poss_pid, &hotpids, NULL);
+    refresh_global_pidlist(0, &hotevalpids);
+    refresh_proc_pidlist(hotproc_poss_pid, &hotevalpids, NULL);
 
     pmtimevalNow(&timestamp);
 
-    for (i=0; i < hotpids.count; i++) {
+    for (i=0; i < hotevalpids.count; i++) {
 
-	pid = hotpids.pids[i];
+	pid = hotevalpids.pids[i];
 
 	entry = proc_pid_entry_lookup(pid, hotproc_poss_pid);
 	if (entry == NULL) {
@@ -796,6 +1021,7 @@ refresh_proc_pidlist(proc_pid_t *proc_pid, proc_pid_list_t *pids, proc_runq_t *r
 	    memset(ep, 0, sizeof(proc_pid_entry_t));
 
 	    ep->id = pids->pids[i];
+	    ep->dirfd = -1;
 
 	    pmsprintf(buf, sizeof(buf), "%s/proc/%d/cmdline", proc_statspath, pids->pids[i]);
 	    if ((fd = open(buf, O_RDONLY)) >= 0) {
@@ -932,6 +1158,7 @@ refresh_proc_pidlist(proc_pid_t *proc_pid, proc_pid_list_t *pids, proc_runq_t *r
 		    free(ep->wchan_buf);
 		if (ep->environ_buf != NULL)
 		    free(ep->environ_buf);
+		proc_closedir_fd(ep);
 	    	if (prev == NULL)
 		    proc_pid->pidhash.hash[i] = node->next;
 		else
@@ -1021,6 +1248,77 @@ refresh_hotproc_pid(proc_pid_t *proc_pid, int threads, const char *cgroups)
 }
 
 
+/*
+ * Each pid keeps its /proc/<pid> (or /proc/<pid>/task/<pid>) directory
+ * open across fetches, so that subsequent opens of the individual files
+ * are relative lookups via openat(2) rather than full /proc path walks.
+ * This is bounded by half of the open file descriptor limit - beyond
+ * that we simply open files by path name, as before.
+ */
+static int
+proc_dirfd_limit(void)
+{
+    struct rlimit	rlim;
+
+    if (dirfd_limit < 0) {
+	if (getrlimit(RLIMIT_NOFILE, &rlim) < 0)
+	    dirfd_limit = 0;
+	else if (rlim.rlim_cur == RLIM_INFINITY || rlim.rlim_cur / 2 > INT_MAX)
+	    dirfd_limit = INT_MAX;
+	else
+	    dirfd_limit = rlim.rlim_cur / 2;
+	if (pmDebugOptions.appl1)
+	    fprintf(stderr, "%s: caching up to %d pid directories\n",
+			    "proc_dirfd_limit", dirfd_limit);
+    }
+    return dirfd_limit;
+}
+
+static void
+proc_closedir_fd(proc_pid_entry_t *ep)
+{
+    if (ep->dirfd >= 0) {
+	close(ep->dirfd);
+	ep->dirfd = -1;
+	dirfd_count--;
+    }
+}
+
+static int
+proc_dirfd(proc_pid_entry_t *ep)
+{
+    int			fd = -1;
+    char		buf[128];
+
+    if (ep->dirfd >= 0) {
+	if (ep->dirtask == procpids.threads)
+	    return ep->dirfd;
+	proc_closedir_fd(ep);	/* threads setting has changed */
+    }
+    if (dirfd_count >= proc_dirfd_limit())
+	return -1;
+
+    if (procpids.threads) {
+	pmsprintf(buf, sizeof(buf), "%s/proc/%d/task/%d",
+			proc_statspath, ep->id, ep->id);
+	fd = open(buf, O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+    }
+    if (fd < 0) {
+	pmsprintf(buf, sizeof(buf), "%s/proc/%d", proc_statspath, ep->id);
+	fd = open(buf, O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+    }
+    if (fd < 0) {
+	if (pmDebugOptions.appl1 && pmDebugOptions.desperate)
+	    fprintf(stderr, "%s: open(\"%s\", O_DIRECTORY) failed: %s\n",
+			    "proc_dirfd", buf, pmErrStr(-oserror()));
+	return -1;
+    }
+    ep->dirfd = fd;
+    ep->dirtask = procpids.threads;
+    dirfd_count++;
+    return fd;
+}
+
 /*
  * Open a proc file, taking into account that we may want thread info
  * rather than process information.
@@ -1033,9 +1331,22 @@ refresh_hotproc_pid(proc_pid_t *proc_pid, int threads, const char *cgroups)
 static int
 proc_open(const char *base, proc_pid_entry_t *ep)
 {
-    int			fd;
+    int			fd, dirfd;
     char		buf[128];
 
+    if ((dirfd = proc_dirfd(ep)) >= 0) {
+	if ((fd = openat(dirfd, base, O_RDONLY)) >= 0) {
+	    if (pmDebugOptions.appl1 && pmDebugOptions.desperate)
+		fprintf(stderr, "%s: openat(%d, \"%s\") -> fd=%d\n",
+				"proc_open", dirfd, base, fd);
+	    return fd;
+	}
+	if (pmDebugOptions.appl1 && pmDebugOptions.desperate)
+	    fprintf(stderr, "%s: openat(%d, \"%s\", O_RDONLY) failed: %s\n",
+			    "proc_open", dirfd, base, pmErrStr(-oserror()));
+	/* fallback to path lookups below */
+    }
+
     if (procpids.threads) {
 	pmsprintf(buf, sizeof(buf), "%s/proc/%d/task/%d/%s",
 			proc_statspath, ep->id, ep->id, base);
@@ -1049,6 +1360,8 @@ proc_open(const char *base, proc_pid_entry_t *ep)
 	    if (pmDebugOptions.appl1 && pmDebugOptions.desperate)
 		fprintf(stderr, "%s: thread: %s -> fd=%d\n",
 				"proc_open", buf, fd);
+	    if (dirfd >= 0)	/* stale directory, e.g. pid reused */
+		proc_closedir_fd(ep);
 	    return fd;
 	}
     }
@@ -1058,6 +1371,8 @@ proc_open(const char *base, proc_pid_entry_t *ep)
 	if (pmDebugOptions.appl1 && pmDebugOptions.desperate)
 	    fprintf(stderr, "%s: open(\"%s\", O_RDONLY) failed: %s\n",
 			    "proc_open", buf, pmErrStr(-oserror()));
+    } else if (dirfd >= 0) {	/* stale directory, e.g. pid reused */
+	proc_closedir_fd(ep);
     }
     if (pmDebugOptions.appl1 && pmDebugOptions.desperate)
 	fprintf(stderr, "%s: %s -> fd=%d\n", "proc_open", buf, fd);
@@ -1069,6 +1384,16 @@ proc_opendir(const char *base, proc_pid_entry_t *ep)
 {
     DIR			*dir;
     char		buf[128];
+    int			fd, dirfd;
+
+    if ((dirfd = proc_dirfd(ep)) >= 0) {
+	if ((fd = openat(dirfd, base, O_RDONLY|O_DIRECTORY)) >= 0) {
+	    if ((dir = fdopendir(fd)) != NULL)
+		return dir;
+	    close(fd);
+	}
+	/* fallback to path lookups below */
+    }
 
     if (procpids.threads) {
 	pmsprintf(buf, sizeof(buf), "%s/proc/%d/task/%d/%s", proc_statspath, ep->id, ep->id, base);
@@ -1137,7 +1462,7 @@ static int
 read_proc_entry(int fd, size_t *lenp, char **bufp)
 {
     size_t		len = 0;
-    char		*p = *bufp, buf[1024];
+    char		*p = *bufp, buf[4096];
     int			n, sts = 0;
 
     for (len=0;;) {
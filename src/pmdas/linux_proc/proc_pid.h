@@ -224,6 +224,8 @@ enum {
 
 typedef struct {
     int			id;	/* pid, hash key and internal instance id */
+    int			dirfd;	/* cached /proc/<pid> directory or -1 */
+    int			dirtask; /* dirfd is /proc/<pid>/task/<pid> */
     int			pad;
     unsigned int	fetched;   /* PROC_PID_FLAG_* values (sample attempt) */
     unsigned int	success;   /* PROC_PID_FLAG_* values (sample success) */
@@ -297,8 +299,16 @@ typedef struct {
     int			size;		/* size of the buffer (pids) allocated */
     int			*pids;		/* array of process identifiers */
     int			threads;	/* /proc/PID/{xxx,task/PID/xxx} flag */
+    int			tracked;	/* maintained from process events */
+    time_t		rescan;		/* time of next full /proc scan */
 } proc_pid_list_t;
 
+/* full /proc scan interval when tracking process events (seconds) */
+extern int proc_rescan_interval;
+
+/* subscribe to process fork and exit events, if possible */
+extern void proc_events_init(void);
+
 /* lookup a proc hash entry */
 extern proc_pid_entry_t *proc_pid_entry_lookup(int, proc_pid_t *);
 
@@ -0,0 +1,637 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/*
+ * Socket statistics direct from the kernel, using the NETLINK_SOCK_DIAG
+ * (INET_DIAG) interface that ss(8) itself is built on.  This avoids a
+ * fork+exec of ss and parsing its text output on every refresh, which
+ * is significant with very large numbers of sockets.
+ *
+ * Only filters made up of ss(8) "state" and "exclude" terms can be
+ * expressed here (as the kernel-side idiag_states mask); any other
+ * expression is left to ss itself, see ss_refresh().
+ *
+ * The ss_stats_t fields are filled in with the values (and for the
+ * string fields, the formats) that "ss -noemitauO" would have reported.
+ */
+
+#include <pcp/pmapi.h>
+#include <pcp/pmda.h>
+#include "libpcp.h"
+#include <fcntl.h>
+#include <ftw.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/sock_diag.h>
+#include <linux/inet_diag.h>
+#include "ss_stats.h"
+
+/*
+ * Socket states, as numbered by the kernel (and ss) ... SS_NEW_SYN_RECV
+ * sockets are reported as SYN-RECV by the kernel.
+ */
+enum {
+    SS_UNKNOWN, SS_ESTABLISHED, SS_SYN_SENT, SS_SYN_RECV,
+    SS_FIN_WAIT1, SS_FIN_WAIT2, SS_TIME_WAIT, SS_CLOSE,
+    SS_CLOSE_WAIT, SS_LAST_ACK, SS_LISTEN, SS_CLOSING,
+    SS_MAX
+};
+#define SS_ALL		((1 << SS_MAX) - 1)
+
+static const char *sstate_name[] = {
+    "UNKNOWN", "ESTAB", "SYN-SENT", "SYN-RECV",
+    "FIN-WAIT-1", "FIN-WAIT-2", "TIME-WAIT", "UNCONN",
+    "CLOSE-WAIT", "LAST-ACK", "LISTEN", "CLOSING",
+};
+
+static const char *tmr_name[] = {
+    "off", "on", "keepalive", "timewait", "persist", "unknown"
+};
+
+/* response attributes newer than some kernel headers we build against */
+#define SS_DIAG_SKV6ONLY	11
+#define SS_DIAG_CGROUP_ID	21
+
+/* struct tcp_info options bits */
+#define SS_TCPI_OPT_TIMESTAMPS	1
+#define SS_TCPI_OPT_SACK	2
+#define SS_TCPI_OPT_WSCALE	4
+
+/*
+ * struct tcp_info from the kernel's <linux/tcp.h> ... a local copy so
+ * the fields from newer kernels are known regardless of the headers
+ * this is built with.  Older kernels send a shorter structure, and the
+ * fields missing from the reply stay zero.
+ */
+typedef struct {
+    __uint8_t	tcpi_state;
+    __uint8_t	tcpi_ca_state;
+    __uint8_t	tcpi_retransmits;
+    __uint8_t	tcpi_probes;
+    __uint8_t	tcpi_backoff;
+    __uint8_t	tcpi_options;
+    __uint8_t	tcpi_snd_wscale : 4, tcpi_rcv_wscale : 4;
+    __uint8_t	tcpi_delivery_rate_app_limited : 1, tcpi_fastopen_client_fail : 2;
+    __uint32_t	tcpi_rto;
+    __uint32_t	tcpi_ato;
+    __uint32_t	tcpi_snd_mss;
+    __uint32_t	tcpi_rcv_mss;
+    __uint32_t	tcpi_unacked;
+    __uint32_t	tcpi_sacked;
+    __uint32_t	tcpi_lost;
+    __uint32_t	tcpi_retrans;
+    __uint32_t	tcpi_fackets;
+    __uint32_t	tcpi_last_data_sent;
+    __uint32_t	tcpi_last_ack_sent;
+    __uint32_t	tcpi_last_data_recv;
+    __uint32_t	tcpi_last_ack_recv;
+    __uint32_t	tcpi_pmtu;
+    __uint32_t	tcpi_rcv_ssthresh;
+    __uint32_t	tcpi_rtt;
+    __uint32_t	tcpi_rttvar;
+    __uint32_t	tcpi_snd_ssthresh;
+    __uint32_t	tcpi_snd_cwnd;
+    __uint32_t	tcpi_advmss;
+    __uint32_t	tcpi_reordering;
+    __uint32_t	tcpi_rcv_rtt;
+    __uint32_t	tcpi_rcv_space;
+    __uint32_t	tcpi_total_retrans;
+    __uint64_t	tcpi_pacing_rate;
+    __uint64_t	tcpi_max_pacing_rate;
+    __uint64_t	tcpi_bytes_acked;
+    __uint64_t	tcpi_bytes_received;
+    __uint32_t	tcpi_segs_out;
+    __uint32_t	tcpi_segs_in;
+    __uint32_t	tcpi_notsent_bytes;
+    __uint32_t	tcpi_min_rtt;
+    __uint32_t	tcpi_data_segs_in;
+    __uint32_t	tcpi_data_segs_out;
+    __uint64_t	tcpi_delivery_rate;
+    __uint64_t	tcpi_busy_time;
+    __uint64_t	tcpi_rwnd_limited;
+    __uint64_t	tcpi_sndbuf_limited;
+    __uint32_t	tcpi_delivered;
+    __uint32_t	tcpi_delivered_ce;
+    __uint64_t	tcpi_bytes_sent;
+    __uint64_t	tcpi_bytes_retrans;
+    __uint32_t	tcpi_dsack_dups;
+    __uint32_t	tcpi_reord_seen;
+    __uint32_t	tcpi_rcv_ooopack;
+    __uint32_t	tcpi_snd_wnd;
+} ss_tcp_info_t;
+
+/*
+ * Translate a filter into an idiag_states mask, using the same state
+ * names and groups as ss(8).  Returns 0 on success, or -1 if the filter
+ * uses anything other than "state" and "exclude" (or "excl") terms.
+ */
+static int
+scan_state(const char *state, unsigned int *mask)
+{
+    static const char *sstate_namel[] = {
+	"UNKNOWN", "established", "syn-sent", "syn-recv",
+	"fin-wait-1", "fin-wait-2", "time-wait", "unconnected",
+	"close-wait", "last-ack", "listening", "closing",
+    };
+    int		i;
+
+    if (strcasecmp(state, "close") == 0 || strcasecmp(state, "closed") == 0)
+	*mask = (1 << SS_CLOSE);
+    else if (strcasecmp(state, "syn-rcv") == 0)
+	*mask = (1 << SS_SYN_RECV);
+    else if (strcasecmp(state, "all") == 0)
+	*mask = SS_ALL;
+    else if (strcasecmp(state, "connected") == 0)
+	*mask = SS_ALL & ~((1 << SS_CLOSE) | (1 << SS_LISTEN));
+    else if (strcasecmp(state, "synchronized") == 0)
+	*mask = SS_ALL & ~((1 << SS_CLOSE) | (1 << SS_LISTEN) | (1 << SS_SYN_SENT));
+    else if (strcasecmp(state, "bucket") == 0)
+	*mask = (1 << SS_SYN_RECV) | (1 << SS_TIME_WAIT);
+    else if (strcasecmp(state, "big") == 0)
+	*mask = SS_ALL & ~((1 << SS_SYN_RECV) | (1 << SS_TIME_WAIT));
+    else if (strcasecmp(state, "listen") == 0)
+	*mask = (1 << SS_LISTEN);
+    else {
+	for (i = 1; i < SS_MAX; i++) {
+	    if (strcasecmp(state, sstate_namel[i]) == 0) {
+		*mask = (1 << i);
+		return 0;
+	    }
+	}
+	return -1;
+    }
+    return 0;
+}
+
+int
+ss_netlink_states(const char *filter, unsigned int *states)
+{
+    char	*copy, *tok, *save = NULL;
+    unsigned int mask, include = 0, exclude = 0;
+    int		sts = 0;
+
+    if ((copy = strdup(filter ? filter : "")) == NULL)
+	return -1;
+    for (tok = strtok_r(copy, " \t\n", &save); tok != NULL;
+	 tok = strtok_r(NULL, " \t\n", &save)) {
+	if (strcmp(tok, "state") == 0) {
+	    if ((tok = strtok_r(NULL, " \t\n", &save)) == NULL ||
+		scan_state(tok, &mask) < 0) {
+		sts = -1;
+		break;
+	    }
+	    include |= mask;
+	}
+	else if (strcmp(tok, "exclude") == 0 || strcmp(tok, "excl") == 0) {
+	    if ((tok = strtok_r(NULL, " \t\n", &save)) == NULL ||
+		scan_state(tok, &mask) < 0) {
+		sts = -1;
+		break;
+	    }
+	    exclude |= mask;
+	}
+	else {
+	    /* an address, port or other expression, leave it to ss */
+	    sts = -1;
+	    break;
+	}
+    }
+    free(copy);
+    if (sts < 0)
+	return sts;
+
+    /* as for ss -a, all states unless some were given */
+    if (include == 0)
+	include = SS_ALL;
+    *states = include & ~exclude;
+    return 0;
+}
+
+/*
+ * cgroup v2 id to path mapping, built by walking the cgroup2 hierarchy
+ * (each cgroup's id is the file handle of its directory) ... rebuilt at
+ * most once per refresh, and only when an unknown id is seen.
+ */
+static __pmHashCtl	cgroup_hash;
+static char		cgroup_root[MAXPATHLEN];
+static size_t		cgroup_rootlen;
+static int		cgroup_scanned;
+
+typedef struct {
+    __uint64_t		id;
+    char		path[1];	/* allocated to the required length */
+} cgroup_entry_t;
+
+static cgroup_entry_t *
+cgroup_lookup(__uint64_t id)
+{
+    __pmHashNode	*hp;
+    cgroup_entry_t	*cp;
+
+    for (hp = __pmHashSearch((unsigned int)id, &cgroup_hash); hp; hp = hp->next) {
+	cp = (cgroup_entry_t *)hp->data;
+	if (hp->key == (unsigned int)id && cp->id == id)
+	    return cp;
+    }
+    return NULL;
+}
+
+static int
+cgroup_visit(const char *path, const struct stat *sbuf, int flag, struct FTW *ftw)
+{
+    struct {
+	struct file_handle	fh;
+	__uint64_t		id;
+    } handle;
+    const char		*p;
+    cgroup_entry_t	*cp;
+    __uint64_t		id;
+    int			mnt;
+
+    (void)sbuf; (void)ftw;
+    if (flag != FTW_D)
+	return 0;
+    handle.fh.handle_bytes = sizeof(handle.id);
+    if (name_to_handle_at(AT_FDCWD, path, &handle.fh, &mnt, 0) < 0 ||
+	handle.fh.handle_bytes != sizeof(id))
+	return 0;
+    memcpy(&id, handle.fh.f_handle, sizeof(id));
+    if (cgroup_lookup(id) != NULL)
+	return 0;
+
+    /* path relative to the cgroup2 mount point, "/" for the root */
+    p = path + cgroup_rootlen;
+    if (*p == '\0')
+	p = "/";
+    if ((cp = malloc(sizeof(*cp) + strlen(p))) == NULL)
+	return 0;
+    cp->id = id;
+    strcpy(cp->path, p);
+    if (__pmHashAdd((unsigned int)id, cp, &cgroup_hash) < 0)
+	free(cp);
+    return 0;
+}
+
+static void
+cgroup_scan(void)
+{
+    FILE	*fp;
+    char	buf[MAXPATHLEN], dir[MAXPATHLEN], type[64];
+
+    if (cgroup_root[0] == '\0') {
+	pmsprintf(cgroup_root, sizeof(cgroup_root), "/sys/fs/cgroup");
+	if ((fp = fopen("/proc/self/mounts", "r")) != NULL) {
+	    while (fgets(buf, sizeof(buf), fp) != NULL) {
+		if (sscanf(buf, "%*s %4095s %63s", dir, type) == 2 &&
+		    strcmp(type, "cgroup2") == 0) {
+		    pmsprintf(cgroup_root, sizeof(cgroup_root), "%s", dir);
+		    break;
+		}
+	    }
+	    fclose(fp);
+	}
+	cgroup_rootlen = strlen(cgroup_root);
+    }
+    nftw(cgroup_root, cgroup_visit, 16, FTW_PHYS | FTW_MOUNT);
+}
+
+static void
+cgroup_path(__uint64_t id, char *buf, size_t buflen)
+{
+    cgroup_entry_t	*cp;
+
+    if ((cp = cgroup_lookup(id)) == NULL && !cgroup_scanned) {
+	cgroup_scanned = 1;
+	cgroup_scan();
+	cp = cgroup_lookup(id);
+    }
+    if (cp != NULL)
+	pmsprintf(buf, buflen, "%s", cp->path);
+    else
+	pmsprintf(buf, buflen, "unreachable:%llx", (unsigned long long)id);
+}
+
+/*
+ * Format an address and port as ss -n does, e.g. 10.0.0.1:22,
+ * [fe80::1]:22, 0.0.0.0:* and *:* and with an optional %interface
+ */
+static void
+ss_addr(char *buf, int buflen, int family, __uint32_t *addr,
+	unsigned short port, unsigned int ifindex, int v6only)
+{
+    char	host[INET6_ADDRSTRLEN + 2];
+    char	text[INET6_ADDRSTRLEN];
+    char	ifname[IF_NAMESIZE + 1];
+    char	portstr[8];
+
+    if (family == AF_INET)
+	inet_ntop(AF_INET, addr, host, sizeof(host));
+    else if (!v6only && addr[0] == 0 && addr[1] == 0 && addr[2] == 0 && addr[3] == 0)
+	pmsprintf(host, sizeof(host), "*");
+    else {
+	inet_ntop(AF_INET6, addr, text, sizeof(text));
+	pmsprintf(host, sizeof(host), "[%s]", text);
+    }
+    ifname[0] = '%';
+    if (ifindex == 0 || if_indextoname(ifindex, &ifname[1]) == NULL)
+	ifname[0] = '\0';
+    if (port)
+	pmsprintf(portstr, sizeof(portstr), "%u", port);
+    else
+	pmsprintf(portstr, sizeof(portstr), "*");
+    pmsprintf(buf, buflen, "%s%s:%s", host, ifname, portstr);
+}
+
+/* timer expiry in the ss(8) format, e.g. 3min57sec or 1.204ms */
+static void
+ss_ms_timer(char *buf, int buflen, unsigned int timeout)
+{
+    int		secs, msecs, minutes, n = 0;
+
+    secs = timeout / 1000;
+    minutes = secs / 60;
+    secs = secs % 60;
+    msecs = timeout % 1000;
+    buf[0] = '\0';
+    if (minutes) {
+	msecs = 0;
+	n += pmsprintf(buf + n, buflen - n, "%dmin", minutes);
+	if (minutes > 9)
+	    secs = 0;
+    }
+    if (secs) {
+	if (secs > 9)
+	    msecs = 0;
+	n += pmsprintf(buf + n, buflen - n, "%d%s", secs, msecs ? "." : "sec");
+    }
+    if (msecs)
+	pmsprintf(buf + n, buflen - n, "%03dms", msecs);
+}
+
+static void
+ss_tcp_info(ss_stats_t *ss, const void *data, size_t len)
+{
+    ss_tcp_info_t	info;
+
+    memset(&info, 0, sizeof(info));
+    memcpy(&info, data, len < sizeof(info) ? len : sizeof(info));
+
+    ss->ts = (info.tcpi_options & SS_TCPI_OPT_TIMESTAMPS) != 0;
+    ss->sack = (info.tcpi_options & SS_TCPI_OPT_SACK) != 0;
+    if (info.tcpi_options & SS_TCPI_OPT_WSCALE) {
+	ss->wscale_snd = info.tcpi_snd_wscale;
+	ss->wscale_rcv = info.tcpi_rcv_wscale;
+	pmsprintf(ss->wscale_str, sizeof(ss->wscale_str), "%d,%d",
+		ss->wscale_snd, ss->wscale_rcv);
+    }
+    if (info.tcpi_rto && info.tcpi_rto != 3000000)
+	ss->rto = (double)info.tcpi_rto / 1000;
+    if (info.tcpi_rtt) {
+	ss->round_trip_rtt = (double)info.tcpi_rtt / 1000;
+	ss->round_trip_rttvar = (double)info.tcpi_rttvar / 1000;
+	pmsprintf(ss->round_trip_str, sizeof(ss->round_trip_str), "%g/%g",
+		ss->round_trip_rtt, ss->round_trip_rttvar);
+    }
+    if (info.tcpi_ato)
+	ss->ato = (double)info.tcpi_ato / 1000;
+    ss->backoff = info.tcpi_backoff;
+    ss->mss = info.tcpi_snd_mss;
+    ss->pmtu = info.tcpi_pmtu;
+    ss->rcvmss = info.tcpi_rcv_mss;
+    ss->advmss = info.tcpi_advmss;
+    ss->cwnd = info.tcpi_snd_cwnd;
+    if (info.tcpi_snd_ssthresh < 0xFFFF)
+	ss->ssthresh = info.tcpi_snd_ssthresh;
+    ss->bytes_sent = info.tcpi_bytes_sent;
+    ss->bytes_retrans = info.tcpi_bytes_retrans;
+    ss->bytes_acked = info.tcpi_bytes_acked;
+    ss->bytes_received = info.tcpi_bytes_received;
+    ss->segs_out = info.tcpi_segs_out;
+    ss->segs_in = info.tcpi_segs_in;
+    ss->data_segs_out = info.tcpi_data_segs_out;
+    ss->data_segs_in = info.tcpi_data_segs_in;
+    if (info.tcpi_rtt && info.tcpi_snd_mss && info.tcpi_snd_cwnd)
+	ss->send = (double)(__uint64_t)((double)info.tcpi_snd_cwnd *
+			info.tcpi_snd_mss * 8000000.0 / info.tcpi_rtt + 0.5);
+    ss->lastsnd = info.tcpi_last_data_sent;
+    ss->lastrcv = info.tcpi_last_data_recv;
+    ss->lastack = info.tcpi_last_ack_recv;
+    if (info.tcpi_pacing_rate != ~0ULL)
+	ss->pacing_rate = (double)info.tcpi_pacing_rate * 8;
+    ss->delivery_rate = (double)info.tcpi_delivery_rate * 8;
+    ss->delivered = info.tcpi_delivered;
+    ss->app_limited = info.tcpi_delivery_rate_app_limited;
+    ss->reord_seen = info.tcpi_reord_seen;
+    ss->busy = info.tcpi_busy_time / 1000;
+    ss->unacked = info.tcpi_unacked;
+    ss->rwnd_limited = info.tcpi_rwnd_limited / 1000;
+    if (info.tcpi_retrans || info.tcpi_total_retrans)
+	pmsprintf(ss->retrans_str, sizeof(ss->retrans_str), "%u/%u",
+		info.tcpi_retrans, info.tcpi_total_retrans);
+    ss->dsack_dups = info.tcpi_dsack_dups;
+    ss->rcv_rtt = (double)info.tcpi_rcv_rtt / 1000;
+    ss->rcv_space = info.tcpi_rcv_space;
+    ss->lost = info.tcpi_lost;
+    ss->rcv_ssthresh = info.tcpi_rcv_ssthresh;
+    ss->minrtt = (double)info.tcpi_min_rtt / 1000;
+    ss->notsent = info.tcpi_notsent_bytes;
+}
+
+static void
+ss_skmem(ss_stats_t *ss, const __uint32_t *skmem, size_t len)
+{
+    int		nvars = len / sizeof(__uint32_t);
+    int		n;
+
+    if (nvars <= SK_MEMINFO_OPTMEM)
+	return;
+    ss->skmem_rmem_alloc = skmem[SK_MEMINFO_RMEM_ALLOC];
+    ss->skmem_rcv_buf = skmem[SK_MEMINFO_RCVBUF];
+    ss->skmem_wmem_alloc = skmem[SK_MEMINFO_WMEM_ALLOC];
+    ss->skmem_snd_buf = skmem[SK_MEMINFO_SNDBUF];
+    ss->skmem_fwd_alloc = skmem[SK_MEMINFO_FWD_ALLOC];
+    ss->skmem_wmem_queued = skmem[SK_MEMINFO_WMEM_QUEUED];
+    ss->skmem_ropt_mem = skmem[SK_MEMINFO_OPTMEM];
+    n = pmsprintf(ss->skmem_str, sizeof(ss->skmem_str),
+		"r%u,rb%u,t%u,tb%u,f%u,w%u,o%u",
+		ss->skmem_rmem_alloc, ss->skmem_rcv_buf,
+		ss->skmem_wmem_alloc, ss->skmem_snd_buf,
+		ss->skmem_fwd_alloc, ss->skmem_wmem_queued,
+		ss->skmem_ropt_mem);
+    if (nvars > SK_MEMINFO_BACKLOG) {
+	ss->skmem_back_log = skmem[SK_MEMINFO_BACKLOG];
+	n += pmsprintf(ss->skmem_str + n, sizeof(ss->skmem_str) - n,
+		",bl%u", ss->skmem_back_log);
+    }
+    if (nvars > SK_MEMINFO_DROPS) {
+	ss->skmem_sock_drop = skmem[SK_MEMINFO_DROPS];
+	pmsprintf(ss->skmem_str + n, sizeof(ss->skmem_str) - n,
+		",d%u", ss->skmem_sock_drop);
+    }
+}
+
+/*
+ * decode one inet_diag_msg into ss
+ */
+static void
+ss_decode(int protocol, struct nlmsghdr *h, ss_stats_t *ss)
+{
+    struct inet_diag_msg *r = NLMSG_DATA(h);
+    struct rtattr	*attr;
+    int			len;
+    char		expires[16];
+
+    memset(ss, 0, sizeof(*ss));
+    strcpy(ss->netid, protocol == IPPROTO_TCP ? "tcp" : "udp");
+    if (r->idiag_state < SS_MAX)
+	strcpy(ss->state, sstate_name[r->idiag_state]);
+    else
+	strcpy(ss->state, sstate_name[SS_UNKNOWN]);
+    ss->recvq = r->idiag_rqueue;
+    ss->sendq = r->idiag_wqueue;
+    ss->inode = r->idiag_inode;
+    ss->uid = r->idiag_uid;
+    ss->sk = ((__uint64_t)r->id.idiag_cookie[1] << 32) | r->id.idiag_cookie[0];
+
+    /* v6only is needed before the addresses are formatted */
+    len = h->nlmsg_len - NLMSG_LENGTH(sizeof(*r));
+    for (attr = (struct rtattr *)(r + 1); RTA_OK(attr, len); attr = RTA_NEXT(attr, len)) {
+	switch (attr->rta_type) {
+	case SS_DIAG_SKV6ONLY:
+	    ss->v6only = *(__uint8_t *)RTA_DATA(attr);
+	    break;
+	case INET_DIAG_SKMEMINFO:
+	    ss_skmem(ss, RTA_DATA(attr), RTA_PAYLOAD(attr));
+	    break;
+	case INET_DIAG_INFO:
+	    if (protocol == IPPROTO_TCP)
+		ss_tcp_info(ss, RTA_DATA(attr), RTA_PAYLOAD(attr));
+	    break;
+	case INET_DIAG_CONG:
+	    ss->cubic = strcmp((char *)RTA_DATA(attr), "cubic") == 0;
+	    break;
+	case SS_DIAG_CGROUP_ID:
+	    if (RTA_PAYLOAD(attr) >= sizeof(__uint64_t)) {
+		__uint64_t	id;
+		memcpy(&id, RTA_DATA(attr), sizeof(id));
+		cgroup_path(id, ss->cgroup, sizeof(ss->cgroup));
+	    }
+	    break;
+	}
+    }
+
+    ss_addr(ss->src, sizeof(ss->src), r->idiag_family, r->id.idiag_src,
+	    ntohs(r->id.idiag_sport), r->id.idiag_if, ss->v6only);
+    ss_addr(ss->dst, sizeof(ss->dst), r->idiag_family, r->id.idiag_dst,
+	    ntohs(r->id.idiag_dport), 0, ss->v6only);
+
+    if (protocol == IPPROTO_TCP && r->idiag_timer) {
+	int	timer = r->idiag_timer > 4 ? 5 : r->idiag_timer;
+
+	ss_ms_timer(expires, sizeof(expires), r->idiag_expires);
+	pmsprintf(ss->timer_name, sizeof(ss->timer_name), "%s", tmr_name[timer]);
+	pmsprintf(ss->timer_expire_str, sizeof(ss->timer_expire_str), "%s", expires);
+	ss->timer_retrans = r->idiag_retrans;
+	pmsprintf(ss->timer_str, sizeof(ss->timer_str), "%s,%s,%d",
+		ss->timer_name, ss->timer_expire_str, ss->timer_retrans);
+    }
+}
+
+/*
+ * Dump all sockets for one family and protocol, storing each one
+ */
+static int
+ss_dump(int fd, int indom, int family, int protocol, unsigned int states)
+{
+    static __uint32_t	seq;
+    struct {
+	struct nlmsghdr		nlh;
+	struct inet_diag_req_v2	r;
+    } req;
+    struct sockaddr_nl	nladdr = { .nl_family = AF_NETLINK };
+    struct nlmsghdr	*h;
+    ss_stats_t		ss;
+    char		buf[32768];
+    ssize_t		n;
+    int			sts;
+
+    memset(&req, 0, sizeof(req));
+    req.nlh.nlmsg_len = sizeof(req);
+    req.nlh.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+    req.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.nlh.nlmsg_seq = ++seq;
+    req.r.sdiag_family = family;
+    req.r.sdiag_protocol = protocol;
+    req.r.idiag_states = states;
+    req.r.idiag_ext = (1 << (INET_DIAG_SKMEMINFO - 1));
+    if (protocol == IPPROTO_TCP)
+	req.r.idiag_ext |= (1 << (INET_DIAG_INFO - 1)) |
+			   (1 << (INET_DIAG_CONG - 1));
+
+    if (sendto(fd, &req, sizeof(req), 0,
+		(struct sockaddr *)&nladdr, sizeof(nladdr)) < 0)
+	return -oserror();
+
+    for (;;) {
+	if ((n = recv(fd, buf, sizeof(buf), 0)) < 0) {
+	    if (oserror() == EINTR)
+		continue;
+	    return -oserror();
+	}
+	if (n == 0)
+	    return 0;
+	for (h = (struct nlmsghdr *)buf; NLMSG_OK(h, n); h = NLMSG_NEXT(h, n)) {
+	    if (h->nlmsg_seq != seq)
+		continue;
+	    if (h->nlmsg_type == NLMSG_DONE)
+		return 0;
+	    if (h->nlmsg_type == NLMSG_ERROR) {
+		struct nlmsgerr *err = NLMSG_DATA(h);
+		/* protocol or family not supported by this kernel */
+		if (err->error == -ENOENT || err->error == -EOPNOTSUPP)
+		    return 0;
+		return err->error ? err->error : PM_ERR_GENERIC;
+	    }
+	    if (h->nlmsg_type != SOCK_DIAG_BY_FAMILY)
+		continue;
+	    ss_decode(protocol, h, &ss);
+	    if ((sts = ss_store(indom, &ss)) < 0)
+		return sts;
+	}
+    }
+}
+
+int
+ss_netlink_refresh(int indom, unsigned int states)
+{
+    static const int	protocols[] = { IPPROTO_UDP, IPPROTO_TCP };
+    static const int	families[] = { AF_INET, AF_INET6 };
+    int			fd, i, j, sts = 0;
+
+    if ((fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_SOCK_DIAG)) < 0)
+	return -oserror();
+    if (pmDebugOptions.appl0)
+	fprintf(stderr, "ss_netlink_refresh: states=0x%x\n", states);
+
+    cgroup_scanned = 0;
+    for (i = 0; sts >= 0 && i < sizeof(protocols)/sizeof(protocols[0]); i++)
+	for (j = 0; sts >= 0 && j < sizeof(families)/sizeof(families[0]); j++)
+	    sts = ss_dump(fd, indom, families[j], protocols[i], states);
+    close(fd);
+    return sts;
+}
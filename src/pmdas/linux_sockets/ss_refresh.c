@@ -32,23 +32,42 @@ ss_free(void *p)
     free(ss);
 }
 
+/*
+ * Add or update the cache entry for one socket
+ */
 int
-ss_refresh(int indom)
+ss_store(int indom, ss_stats_t *parsed_ss)
+{
+    ss_stats_t *ss = NULL;
+    int sts, inst;
+    char instname[128];
+
+    ss_instname(parsed_ss, instname, sizeof(instname));
+    sts = pmdaCacheLookupName(indom, instname, &inst, (void **)&ss);
+    if (sts < 0 || ss == NULL) {
+	/* new entry */
+	if (ss == NULL)
+	    ss = (ss_stats_t *)malloc(sizeof(ss_stats_t));
+	if (ss == NULL)
+	    return -ENOMEM;
+    }
+    *ss = *parsed_ss;
+    ss->instid = pmdaCacheStore(indom, PMDA_CACHE_ADD, instname, (void **)ss);
+    return 0;
+}
+
+static int
+ss_refresh_stream(int indom)
 {
     FILE *fp;
     int sts = 0;
-    ss_stats_t *ss, parsed_ss;
-    int inst;
+    ss_stats_t parsed_ss;
     int has_state_field;
-    char instname[128];
     char line[4096] = {0};
 
     if ((fp = ss_open_stream()) == NULL)
     	return -errno;
 
-    /* invalidate all cache entries */
-    pmdaCacheOp(indom, PMDA_CACHE_INACTIVE);
-    
     has_state_field = 0;
     memset(&parsed_ss, 0, sizeof(parsed_ss));
     while (fgets(line, sizeof(line), fp) != NULL) {
@@ -61,24 +80,45 @@ ss_refresh(int indom)
 	}
 		
 	ss_parse(line, has_state_field, &parsed_ss);
-	ss_instname(&parsed_ss, instname, sizeof(instname));
-	ss = NULL;
-	sts = pmdaCacheLookupName(indom, instname, &inst, (void **)&ss);
-	if (sts < 0 || ss == NULL) {
-	    /* new entry */
-	    if (ss == NULL)
-		ss = (ss_stats_t *)malloc(sizeof(ss_stats_t));
-	    if (ss == NULL) {
-		ss_close_stream(fp);
-	    	return -ENOMEM;
-	    }
-	    sts = 0;
-	}
-	*ss = parsed_ss;
-	ss->instid = pmdaCacheStore(indom, PMDA_CACHE_ADD, instname, (void **)ss);
+	if ((sts = ss_store(indom, &parsed_ss)) < 0)
+	    break;
     }
     ss_close_stream(fp);
 
+    return sts;
+}
+
+int
+ss_refresh(int indom)
+{
+    static int use_netlink = 1;
+    unsigned int states;
+    int sts = -1;
+
+    if (ss_filter == NULL) {
+	/* pmstore to network.persocket.filter frees this if changing */
+	if ((ss_filter = strdup("")) == NULL)
+	    return -ENOMEM;
+    }
+
+    /* invalidate all cache entries */
+    pmdaCacheOp(indom, PMDA_CACHE_INACTIVE);
+
+    /*
+     * Ask the kernel directly (netlink sock_diag) unless the filter
+     * can only be handled by ss(8), or this is QA input from a file.
+     */
+    if (use_netlink && getenv("PCPQA_PMDA_SOCKETS") == NULL &&
+	ss_netlink_states(ss_filter, &states) == 0) {
+	if ((sts = ss_netlink_refresh(indom, states)) < 0) {
+	    pmNotifyErr(LOG_WARNING, "netlink socket diagnostics failed: %s, "
+			"using ss(8) instead", pmErrStr(sts));
+	    use_netlink = 0;
+	}
+    }
+    if (sts < 0 && (sts = ss_refresh_stream(indom)) < 0)
+	return sts;
+
     /* purge inactive/closed sockets after 10min, and free private data */
     pmdaCachePurgeCallback(indom, 600, ss_free);
     pmdaCacheOp(indom, PMDA_CACHE_SYNC); 
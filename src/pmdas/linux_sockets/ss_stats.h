@@ -87,6 +87,9 @@ typedef struct ss_stats {
 } ss_stats_t;
 
 extern int ss_refresh(int);
+extern int ss_store(int, ss_stats_t *);
+extern int ss_netlink_states(const char *, unsigned int *);
+extern int ss_netlink_refresh(int, unsigned int);
 extern int ss_parse(char *, int, ss_stats_t *);
 extern FILE *ss_open_stream(void);
 extern void ss_close_stream(FILE *);
@@ -50,8 +50,6 @@ static zfs_vdev_cachestats_t vdev_cachestats;
 static zfs_vdev_mirrorstats_t vdev_mirrorstats;
 static zfs_zfetchstats_t zfetchstats;
 static zfs_zilstats_t zilstats;
-static zfs_poolstats_t *poolstats;
-static pmdaInstid *pools;
 static pmdaIndom indomtab[] = {
     { ZFS_POOL_INDOM, 0, NULL }
 };
@@ -1175,47 +1173,40 @@ static int
 zfs_fetch(int numpmid, pmID *pmidlist, pmResult **resp, pmdaExt *pmda)
 {
     int i;
+    int need_refresh[ZFS_POOL_CLUST+1] = { 0 };
     __pmID_int *idp;
 
+    /* refresh each cluster once per fetch, however many metrics it has */
     for (i = 0; i < numpmid; i++) {
         idp = (__pmID_int *)&(pmidlist[i]);
-        switch (idp->cluster) {
-        case ZFS_ARC_CLUST:
-            zfs_arcstats_refresh(&arcstats);
-            break;
-        case ZFS_ABD_CLUST:
-            zfs_abdstats_refresh(&abdstats);
-            break;
-        case ZFS_DBUF_CLUST:
-            zfs_dbufstats_refresh(&dbufstats);
-            break;
-        case ZFS_DMUTX_CLUST:
-            zfs_dmu_tx_refresh(&dmu_tx);
-            break;
-        case ZFS_DNODE_CLUST:
-            zfs_dnodestats_refresh(&dnodestats);
-            break;
-        case ZFS_FM_CLUST:
-            zfs_fmstats_refresh(&fmstats);
-            break;
-        case ZFS_VDEV_CLUST:
-            zfs_vdev_cachestats_refresh(&vdev_cachestats);
-            zfs_vdev_mirrorstats_refresh(&vdev_mirrorstats);
-            break;
-        case ZFS_XUIO_CLUST:
-            zfs_xuiostats_refresh(&xuiostats);
-            break;
-        case ZFS_ZFETCH_CLUST:
-            zfs_zfetchstats_refresh(&zfetchstats);
-            break;
-        case ZFS_ZIL_CLUST:
-            zfs_zilstats_refresh(&zilstats);
-            break;
-        case ZFS_POOL_CLUST:
-            zfs_poolstats_refresh(&poolstats, &pools, &indomtab[ZFS_POOL_INDOM]);
-            break;
-        }
+        if (idp->cluster <= ZFS_POOL_CLUST)
+            need_refresh[idp->cluster]++;
+    }
+    if (need_refresh[ZFS_ARC_CLUST])
+        zfs_arcstats_refresh(&arcstats);
+    if (need_refresh[ZFS_ABD_CLUST])
+        zfs_abdstats_refresh(&abdstats);
+    if (need_refresh[ZFS_DBUF_CLUST])
+        zfs_dbufstats_refresh(&dbufstats);
+    if (need_refresh[ZFS_DMUTX_CLUST])
+        zfs_dmu_tx_refresh(&dmu_tx);
+    if (need_refresh[ZFS_DNODE_CLUST])
+        zfs_dnodestats_refresh(&dnodestats);
+    if (need_refresh[ZFS_FM_CLUST])
+        zfs_fmstats_refresh(&fmstats);
+    if (need_refresh[ZFS_VDEV_CLUST]) {
+        zfs_vdev_cachestats_refresh(&vdev_cachestats);
+        zfs_vdev_mirrorstats_refresh(&vdev_mirrorstats);
     }
+    if (need_refresh[ZFS_XUIO_CLUST])
+        zfs_xuiostats_refresh(&xuiostats);
+    if (need_refresh[ZFS_ZFETCH_CLUST])
+        zfs_zfetchstats_refresh(&zfetchstats);
+    if (need_refresh[ZFS_ZIL_CLUST])
+        zfs_zilstats_refresh(&zilstats);
+    /* per-pool kstats are only read as the callback asks for each pool */
+    if (need_refresh[ZFS_POOL_CLUST])
+        zfs_poolstats_refresh(indomtab[ZFS_POOL_INDOM].it_indom);
     return pmdaFetch(numpmid, pmidlist, resp, pmda);
 }
 
@@ -1223,47 +1214,50 @@ static int
 zfs_fetchCallBack(pmdaMetric *mdesc, unsigned int inst, pmAtomValue *atom)
 {
     __pmID_int *idp = (__pmID_int *)&(mdesc->m_desc.pmid);
+    zfs_poolstats_t *ps;
 
-    if (idp->cluster == ZFS_POOL_CLUST) { // && mdesc->m_desc.indom == ZFS_POOL_INDOM) {
+    if (idp->cluster == ZFS_POOL_CLUST) {
+        if ((ps = zfs_poolstats_lookup(mdesc->m_desc.indom, inst)) == NULL)
+            return PM_ERR_INST;
         switch (idp->item) {
         case ZFS_POOL_STATE:
-            atom->l = (__int32_t)poolstats[inst].state;
+            atom->l = (__int32_t)ps->state;
             break;
         case ZFS_POOL_NREAD:
-            atom->ull = (__uint64_t)poolstats[inst].nread;
+            atom->ull = (__uint64_t)ps->nread;
             break;
         case ZFS_POOL_NWRITTEN:
-            atom->ull = (__uint64_t)poolstats[inst].nwritten;
+            atom->ull = (__uint64_t)ps->nwritten;
             break;
         case ZFS_POOL_READS:
-            atom->ull = (__uint64_t)poolstats[inst].reads;
+            atom->ull = (__uint64_t)ps->reads;
             break;
         case ZFS_POOL_WRITES:
-            atom->ull = (__uint64_t)poolstats[inst].writes;
+            atom->ull = (__uint64_t)ps->writes;
             break;
         case ZFS_POOL_WTIME:
-            atom->ull = (__uint64_t)poolstats[inst].wtime;
+            atom->ull = (__uint64_t)ps->wtime;
             break;
         case ZFS_POOL_WLENTIME:
-            atom->ull = (__uint64_t)poolstats[inst].wlentime;
+            atom->ull = (__uint64_t)ps->wlentime;
             break;
         case ZFS_POOL_WUPDATE:
-            atom->ull = (__uint64_t)poolstats[inst].wupdate;
+            atom->ull = (__uint64_t)ps->wupdate;
             break;
         case ZFS_POOL_RTIME:
-            atom->ull = (__uint64_t)poolstats[inst].rtime;
+            atom->ull = (__uint64_t)ps->rtime;
             break;
         case ZFS_POOL_RLENTIME:
-            atom->ull = (__uint64_t)poolstats[inst].rlentime;
+            atom->ull = (__uint64_t)ps->rlentime;
             break;
         case ZFS_POOL_RUPDATE:
-            atom->ull = (__uint64_t)poolstats[inst].rupdate;
+            atom->ull = (__uint64_t)ps->rupdate;
             break;
         case ZFS_POOL_WCNT:
-            atom->ull = (__uint64_t)poolstats[inst].wcnt;
+            atom->ull = (__uint64_t)ps->wcnt;
             break;
         case ZFS_POOL_RCNT:
-            atom->ull = (__uint64_t)poolstats[inst].rcnt;
+            atom->ull = (__uint64_t)ps->rcnt;
             break;
         default:
             return PM_ERR_PMID;
@@ -1290,7 +1284,8 @@ zfs_fetchCallBack(pmdaMetric *mdesc, unsigned int inst, pmAtomValue *atom)
 static int
 zfs_instance(pmInDom indom, int inst, char *name, pmInResult **result, pmdaExt *pmda)
 {
-    //zfs_pools_init(&poolstats, &pools, &indomtab[ZFS_POOL_INDOM]);
+    if (indom == indomtab[ZFS_POOL_INDOM].it_indom)
+        zfs_pools_refresh(indom);
     return pmdaInstance(indom, inst, name, result, pmda);
 }
 
@@ -25,15 +25,11 @@ zfs_abdstats_refresh(zfs_abdstats_t *abdstats)
 {
     char *line = NULL, *mname, *mval;
     char delim[] = " ";
-    char fname[MAXPATHLEN];
     FILE *fp;
     size_t len = 0;
     uint64_t value;
 
-    if (zfs_stats_file_check(fname, sizeof(fname), "abdstats") != 0)
-        return;
-
-    fp = fopen(fname, "r");
+    fp = zfs_stats_file_open("abdstats");
     if (fp != NULL) {
         while (getline(&line, &len, fp) != -1) {
             mname = strtok(line, delim);
@@ -25,15 +25,11 @@ zfs_dbufstats_refresh(zfs_dbufstats_t *dbufstats)
 {
     char *line = NULL, *mname, *mval;
     char delim[] = " ";
-    char fname[MAXPATHLEN];
     FILE *fp;
     size_t len = 0;
     uint64_t value;
 
-    if (zfs_stats_file_check(fname, sizeof(fname), "dbufstats") != 0)
-        return;
-
-    fp = fopen(fname, "r");
+    fp = zfs_stats_file_open("dbufstats");
     if (fp != NULL) {
         while (getline(&line, &len, fp) != -1) {
             mname = strtok(line, delim);
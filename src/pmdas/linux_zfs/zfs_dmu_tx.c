@@ -25,15 +25,11 @@ zfs_dmu_tx_refresh(zfs_dmu_tx_t *dmu_tx)
 {
     char *line = NULL, *mname, *mval;
     char delim[] = " ";
-    char fname[MAXPATHLEN];
     FILE *fp;
     size_t len = 0;
     uint64_t value;
 
-    if (zfs_stats_file_check(fname, sizeof(fname), "dmu_tx") != 0)
-        return;
-
-    fp = fopen(fname, "r");
+    fp = zfs_stats_file_open("dmu_tx");
     if (fp != NULL) {
         while (getline(&line, &len, fp) != -1) {
             mname = strtok(line, delim);
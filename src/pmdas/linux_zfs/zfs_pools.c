@@ -29,57 +29,99 @@
 #include "zfs_utils.h"
 #include "zfs_pools.h"
 
+/*
+ * Every pool ever seen, whether currently present or not - the pool
+ * instance domain is a pmdaCache, which keeps instance identifiers
+ * stable as pools come and go, and holds a pointer to these.
+ */
+static zfs_pool_t *pool_list;
+static unsigned int pool_generation;
+static unsigned int fetch_generation;
+
+static void
+zfs_pool_forget(zfs_pool_t *pool)
+{
+    zfs_kstat_close(&pool->state);
+    zfs_kstat_close(&pool->io);
+    pool->ino = 0;
+}
+
+/*
+ * Discover the pools by looking for directories in /proc/spl/kstat/zfs,
+ * updating the instance domain only for pools that appeared or went.
+ */
 void
-zfs_pools_init(zfs_poolstats_t **poolstats, pmdaInstid **pools, pmdaIndom *poolsindom)
+zfs_pools_refresh(pmInDom indom)
 {
     DIR *zfs_dp;
     struct dirent *ep;
-    int pool_num = 0;
-    size_t size;
-    zfs_poolstats_t *poolstats_tmp;
-    static int seen_err = 0;
     struct stat sstat;
     char statpath[MAXPATHLEN];
+    zfs_pool_t *pool;
+    ino_t ino;
+    int sts, inst, pool_num = 0;
     int sep = pmPathSeparator();
+    static int seen_err = 0;
 
-    // Discover the pools by looking for directories in /proc/spl/kstat/zfs
-    if ((zfs_dp = opendir(zfs_path)) != NULL) {
-        while ((ep = readdir(zfs_dp))) {
-	    /*
-	     * Note: d_type field is not necessarily set for some file
-	     * systems (especially /tmp during PCP QA), so have to make
-	     * sure it is a directory using stat()
-	     */
-	    pmsprintf(statpath, sizeof(statpath), "%s%c%s", zfs_path, sep, ep->d_name);
-	    if (stat(statpath, &sstat) < 0) {
-		/* if stat() fails, warn and ignore it ... */
-		pmNotifyErr(LOG_WARNING, "zfs_pools_init: stat(%s) failed: %s\n", statpath, pmErrStr(-errno));
-		continue;
-	    }
-            if ((sstat.st_mode & S_IFMT) == S_IFDIR) {
-                if (strcmp(ep->d_name, ".") == 0 || strcmp(ep->d_name, "..") == 0) {
-                    continue;
-		}
-                else {
-                    pmdaInstid    *pools_tmp;
-                    size = (pool_num + 1) * sizeof(pmdaInstid);
-                    if ((pools_tmp = (pmdaInstid *)realloc(*pools, size)) == NULL)
-                        pmNoMem("pools", size, PM_FATAL_ERR);
-                    *pools = pools_tmp;
-                    (*pools)[pool_num].i_name = (char *) malloc(strlen(ep->d_name) + 1);
-                    strcpy((*pools)[pool_num].i_name, ep->d_name);
-                    (*pools)[pool_num].i_name[strlen(ep->d_name)] = '\0';
-                    (*pools)[pool_num].i_inst = pool_num;
-                    pool_num++;
-                }
+    if ((zfs_dp = opendir(zfs_path)) == NULL) {
+        if (! seen_err)
+            pmNotifyErr(LOG_WARNING, "zfs_pools_refresh: failed to open ZFS pools dir \"%s\": %s\n", zfs_path, pmErrStr(-errno));
+        seen_err = 1;
+        pmdaCacheOp(indom, PMDA_CACHE_INACTIVE);
+        return;
+    }
+
+    pool_generation++;
+    pmdaCacheOp(indom, PMDA_CACHE_INACTIVE);
+    while ((ep = readdir(zfs_dp))) {
+        if (strcmp(ep->d_name, ".") == 0 || strcmp(ep->d_name, "..") == 0)
+            continue;
+        ino = ep->d_ino;
+        /*
+         * Note: d_type field is not necessarily set for some file
+         * systems (especially /tmp during PCP QA), so have to make
+         * sure it is a directory using stat() in that case
+         */
+        if (ep->d_type == DT_UNKNOWN) {
+            pmsprintf(statpath, sizeof(statpath), "%s%c%s", zfs_path, sep, ep->d_name);
+            if (stat(statpath, &sstat) < 0) {
+                /* if stat() fails, warn and ignore it ... */
+                pmNotifyErr(LOG_WARNING, "zfs_pools_refresh: stat(%s) failed: %s\n", statpath, pmErrStr(-errno));
+                continue;
             }
+            if ((sstat.st_mode & S_IFMT) != S_IFDIR)
+                continue;
+            ino = sstat.st_ino;
         }
-        closedir(zfs_dp);
+        else if (ep->d_type != DT_DIR)
+            continue;
+
+        sts = pmdaCacheLookupName(indom, ep->d_name, &inst, (void **)&pool);
+        if (sts < 0 || pool == NULL) {
+            if ((pool = (zfs_pool_t *)calloc(1, sizeof(zfs_pool_t))) == NULL)
+                pmNoMem("pool", sizeof(zfs_pool_t), PM_FATAL_ERR);
+            pool->state.fd = pool->io.fd = -1;
+            pool->next = pool_list;
+            pool_list = pool;
+        }
+        else if (pool->ino != ino) {
+            /* pool was destroyed and created again, reopen its kstats */
+            zfs_pool_forget(pool);
+        }
+        pool->ino = ino;
+        pool->seen = pool_generation;
+        pmdaCacheStore(indom, PMDA_CACHE_ADD, ep->d_name, (void *)pool);
+        pool_num++;
     }
-    else {
-        pmNotifyErr(LOG_WARNING, "zfs_pools_init: failed to open ZFS pools dir \"%s\": %s\n", zfs_path, pmErrStr(-errno));
+    closedir(zfs_dp);
+
+    /* release the kstat files of pools that have gone away */
+    for (pool = pool_list; pool != NULL; pool = pool->next) {
+        if (pool->seen != pool_generation && pool->ino != 0)
+            zfs_pool_forget(pool);
     }
-    if (*pools == NULL) {
+
+    if (pool_num == 0) {
         if (! seen_err) {
             pmNotifyErr(LOG_WARNING, "no ZFS pools found, instance domain is empty.");
             seen_err = 1;
@@ -89,107 +131,92 @@ zfs_pools_init(zfs_poolstats_t **poolstats, pmdaInstid **pools, pmdaIndom *pools
         pmNotifyErr(LOG_INFO, "%d ZFS pools found.", pool_num);
         seen_err = 0;
     }
-    (*poolsindom).it_set = *pools;
-    (*poolsindom).it_numinst = pool_num;
-    if (pool_num > 0) {
-        if ((poolstats_tmp = (zfs_poolstats_t *)realloc(*poolstats, pool_num * sizeof(zfs_poolstats_t))) == NULL)
-            pmNoMem("poolstats init", pool_num * sizeof(zfs_poolstats_t), PM_FATAL_ERR);
-        *poolstats = poolstats_tmp;
-    }
 }
 
+/*
+ * Start a fetch of the pool metrics - the kstat files of each pool
+ * are only read when values for that pool are first asked for.
+ */
 void
-zfs_pools_clear(zfs_poolstats_t **poolstats, pmdaInstid **pools, pmdaIndom *poolsindom)
+zfs_poolstats_refresh(pmInDom indom)
 {
-    int i;
-
-    for (i = 0; i < (*poolsindom).it_numinst; i++) {
-        free((*pools)[i].i_name);
-        (*pools)[i].i_name = NULL;
-    }
-    if (*pools)
-        free(*pools);
-    if (*poolstats)
-        free(*poolstats);
-    *poolstats = NULL;
-    (*poolsindom).it_set = *pools = NULL;
-    (*poolsindom).it_numinst = 0;
+    fetch_generation++;
+    zfs_pools_refresh(indom);
 }
 
-void
-zfs_poolstats_refresh(zfs_poolstats_t **poolstats, pmdaInstid **pools, pmdaIndom *poolsindom)
+static void
+zfs_pool_read(zfs_pool_t *pool, const char *name)
 {
-    int i, nread_seen;
     char pool_dir[MAXPATHLEN+64], fname[MAXPATHLEN+128];
     char *line = NULL, *token, delim[] = " ";
+    zfs_poolstats_t *stats = &pool->stats;
     FILE *fp;
-    struct stat sstat;
     size_t len = 0;
+    int nread_seen;
 
-    if (poolstats != NULL)
-        zfs_pools_clear(poolstats, pools, poolsindom);
-    zfs_pools_init(poolstats, pools, poolsindom);
-    if (poolsindom->it_numinst == 0) {
-        /* no pools, nothing to do */
-        return;
-    }
+    pmsprintf(pool_dir, sizeof(pool_dir), "%s%c%s", zfs_path, pmPathSeparator(), name);
 
-    if ((*poolstats = realloc(*poolstats, (*poolsindom).it_numinst * sizeof(zfs_poolstats_t))) == NULL)
-        pmNoMem("poolstats refresh", (*poolsindom).it_numinst * sizeof(zfs_poolstats_t), PM_FATAL_ERR);
-    for (i = 0; i < (*poolsindom).it_numinst; i++) {
-        pool_dir[0] = 0;
-        pmsprintf(pool_dir, sizeof(pool_dir), "%s%c%s", zfs_path, pmPathSeparator(), (*poolsindom).it_set[i].i_name);
-        if (stat(pool_dir, &sstat) != 0) {
-            continue;
+    // Read the state if exists
+    stats->state = 13; // UNKNOWN
+    pmsprintf(fname, sizeof(fname), "%s%c%s", pool_dir, pmPathSeparator(), "state");
+    fp = zfs_kstat_open(&pool->state, fname);
+    if (fp != NULL) {
+        while (getline(&line, &len, fp) != -1) {
+            if (strncmp(line, "OFFLINE", 7) == 0) stats->state = 0;
+            else if (strncmp(line, "ONLINE", 6) == 0) stats->state = 1;
+            else if (strncmp(line, "DEGRADED", 8) == 0) stats->state = 2;
+            else if (strncmp(line, "FAULTED", 7) == 0) stats->state = 3;
+            else if (strncmp(line, "REMOVED", 7) == 0) stats->state = 4;
+            else if (strncmp(line, "UNAVAIL", 7) == 0) stats->state = 5;
         }
-        // Read the state if exists
-        (*poolstats)[i].state = 13; // UNKNOWN
-        fname[0] = 0;
-        pmsprintf(fname, sizeof(fname), "%s%c%s", pool_dir, pmPathSeparator(), "state");
-        fp = fopen(fname, "r");
-        if (fp != NULL) {
-            while (getline(&line, &len, fp) != -1) {
-                if (strncmp(line, "OFFLINE", 7) == 0) (*poolstats)[i].state = 0;
-                else if (strncmp(line, "ONLINE", 6) == 0) (*poolstats)[i].state = 1;
-                else if (strncmp(line, "DEGRADED", 8) == 0) (*poolstats)[i].state = 2;
-                else if (strncmp(line, "FAULTED", 7) == 0) (*poolstats)[i].state = 3;
-                else if (strncmp(line, "REMOVED", 7) == 0) (*poolstats)[i].state = 4;
-                else if (strncmp(line, "UNAVAIL", 7) == 0) (*poolstats)[i].state = 5;
+        fclose(fp);
+    }
+    // Read the IO stats
+    pmsprintf(fname, sizeof(fname), "%s%c%s", pool_dir, pmPathSeparator(), "io");
+    fp = zfs_kstat_open(&pool->io, fname);
+    if (fp != NULL) {
+        nread_seen = 0;
+        while (getline(&line, &len, fp) != -1) {
+            if (nread_seen == 1) {
+                // Tokenize the line to extract the metrics
+                stats->nread       = strtoull(strtok(line, delim), NULL, 0);
+                stats->nwritten    = strtoull(strtok(NULL, delim), NULL, 0);
+                stats->reads       = strtoull(strtok(NULL, delim), NULL, 0);
+                stats->writes      = strtoull(strtok(NULL, delim), NULL, 0);
+                stats->wtime       = strtoull(strtok(NULL, delim), NULL, 0);
+                stats->wlentime    = strtoull(strtok(NULL, delim), NULL, 0);
+                stats->wupdate     = strtoull(strtok(NULL, delim), NULL, 0);
+                stats->rtime       = strtoull(strtok(NULL, delim), NULL, 0);
+                stats->rlentime    = strtoull(strtok(NULL, delim), NULL, 0);
+                stats->rupdate     = strtoull(strtok(NULL, delim), NULL, 0);
+                stats->wcnt        = strtoull(strtok(NULL, delim), NULL, 0);
+                stats->rcnt        = strtoull(strtok(NULL, delim), NULL, 0);
             }
-            fclose(fp);
-        }
-        // Read the IO stats
-        fname[0] = 0;
-        pmsprintf(fname, sizeof(fname), "%s%c%s", pool_dir, pmPathSeparator(), "io");
-        fp = fopen(fname, "r");
-        if (fp != NULL) {
-            nread_seen = 0;
-            while (getline(&line, &len, fp) != -1) {
-                if (nread_seen == 1) {
-                    // Tokenize the line to extract the metrics
-                    (*poolstats)[i].nread       = strtoull(strtok(line, delim), NULL, 0);
-                    (*poolstats)[i].nwritten    = strtoull(strtok(NULL, delim), NULL, 0);
-                    (*poolstats)[i].reads       = strtoull(strtok(NULL, delim), NULL, 0);
-                    (*poolstats)[i].writes      = strtoull(strtok(NULL, delim), NULL, 0);
-                    (*poolstats)[i].wtime       = strtoull(strtok(NULL, delim), NULL, 0);
-                    (*poolstats)[i].wlentime    = strtoull(strtok(NULL, delim), NULL, 0);
-                    (*poolstats)[i].wupdate     = strtoull(strtok(NULL, delim), NULL, 0);
-                    (*poolstats)[i].rtime       = strtoull(strtok(NULL, delim), NULL, 0);
-                    (*poolstats)[i].rlentime    = strtoull(strtok(NULL, delim), NULL, 0);
-                    (*poolstats)[i].rupdate     = strtoull(strtok(NULL, delim), NULL, 0);
-                    (*poolstats)[i].wcnt        = strtoull(strtok(NULL, delim), NULL, 0);
-                    (*poolstats)[i].rcnt        = strtoull(strtok(NULL, delim), NULL, 0);
-                }
-                else {
-                    // Search for the header line
-                    token = strtok(line, delim);
-                    if (strcmp(token, "nread"))
-                        nread_seen++;
-                }
+            else {
+                // Search for the header line
+                token = strtok(line, delim);
+                if (strcmp(token, "nread"))
+                    nread_seen++;
             }
-            fclose(fp);
         }
+        fclose(fp);
     }
     if (line != NULL)
         free(line);
 }
+
+zfs_poolstats_t *
+zfs_poolstats_lookup(pmInDom indom, unsigned int inst)
+{
+    zfs_pool_t *pool;
+    char *name;
+
+    if (pmdaCacheLookup(indom, inst, &name, (void **)&pool) != PMDA_CACHE_ACTIVE ||
+        pool == NULL)
+        return NULL;
+    if (pool->fetched != fetch_generation) {
+        zfs_pool_read(pool, name);
+        pool->fetched = fetch_generation;
+    }
+    return &pool->stats;
+}
@@ -16,6 +16,8 @@
 #include "libpcp.h"
 #include "pmda.h"
 
+#include "zfs_utils.h"
+
 enum { ZFS_POOL_INDOM = 0, };
 
 enum { /* metric item identifiers */
@@ -50,6 +52,16 @@ typedef struct zfs_poolstats {
     uint64_t rcnt;
 } zfs_poolstats_t;
 
-void zfs_pools_init(zfs_poolstats_t **, pmdaInstid **, pmdaIndom *);
-void zfs_pools_clear(zfs_poolstats_t **, pmdaInstid **, pmdaIndom *);
-void zfs_poolstats_refresh(zfs_poolstats_t **, pmdaInstid **, pmdaIndom *);
+typedef struct zfs_pool {
+    zfs_poolstats_t stats;
+    ino_t ino;                  /* identifies this instance of the pool */
+    unsigned int seen;          /* enumeration generation last seen in */
+    unsigned int fetched;       /* fetch generation stats last read for */
+    zfs_kstat_t state;
+    zfs_kstat_t io;
+    struct zfs_pool *next;
+} zfs_pool_t;
+
+void zfs_pools_refresh(pmInDom);
+void zfs_poolstats_refresh(pmInDom);
+zfs_poolstats_t *zfs_poolstats_lookup(pmInDom, unsigned int);
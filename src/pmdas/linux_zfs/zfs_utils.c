@@ -12,6 +12,7 @@
  * for more details.
  */
 
+#include <fcntl.h>
 #include <sys/stat.h>
 
 #include "pmapi.h"
@@ -22,14 +23,98 @@
 
 char zfs_path[MAXPATHLEN];
 
-int
-zfs_stats_file_check(char *fname, size_t fnamelen, const char *sname)
+/*
+ * Rather than opening (and stat'ing) each kstat file on every fetch,
+ * keep it open and read the whole file from the start with a single
+ * pread(2) into a buffer that grows to fit.  The caller parses the
+ * buffer through a stdio stream, and a failed read closes the file so
+ * that the next attempt reopens it (e.g. after a pool is re-imported).
+ */
+FILE *
+zfs_kstat_open(zfs_kstat_t *ks, const char *path)
+{
+    ssize_t     bytes;
+    size_t      size;
+    char        *buf;
+
+    if (ks->fd < 0) {
+        if ((ks->fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+            if (!ks->warned) {
+                pmNotifyErr(LOG_WARNING, "File does not exist: %s", path);
+                ks->warned = 1;
+            }
+            return NULL;
+        }
+        ks->warned = 0;
+    }
+    if (ks->buf == NULL) {
+        size = 4096;
+        if ((buf = malloc(size)) == NULL)
+            return NULL;
+        ks->buf = buf;
+        ks->size = size;
+    }
+    /* the whole file in one read, so that the values are consistent */
+    while ((bytes = pread(ks->fd, ks->buf, ks->size, 0)) == (ssize_t)ks->size) {
+        size = ks->size * 2;
+        if ((buf = realloc(ks->buf, size)) == NULL)
+            return NULL;
+        ks->buf = buf;
+        ks->size = size;
+    }
+    if (bytes <= 0) {
+        if (pmDebugOptions.appl0)
+            pmNotifyErr(LOG_DEBUG, "zfs_kstat_open: %s: %s", path,
+                        bytes < 0 ? pmErrStr(-oserror()) : "empty");
+        close(ks->fd);
+        ks->fd = -1;
+        return NULL;
+    }
+    return fmemopen(ks->buf, bytes, "r");
+}
+
+void
+zfs_kstat_close(zfs_kstat_t *ks)
 {
-    struct stat buffer;
-    pmsprintf(fname, fnamelen, "%s%c%s", zfs_path, pmPathSeparator(), sname);
-    if (stat(fname, &buffer) != 0) {
-        pmNotifyErr(LOG_WARNING, "File does not exist: %s", fname);
-        return 1;
+    if (ks->fd >= 0)
+        close(ks->fd);
+    free(ks->buf);
+    ks->fd = -1;
+    ks->warned = 0;
+    ks->size = 0;
+    ks->buf = NULL;
+}
+
+/*
+ * The module-wide kstat files directly below zfs_path
+ */
+typedef struct {
+    const char  *name;
+    zfs_kstat_t kstat;
+} zfs_stats_file_t;
+
+static zfs_stats_file_t stats_files[16];
+static int              num_stats_files;
+
+FILE *
+zfs_stats_file_open(const char *sname)
+{
+    char                fname[MAXPATHLEN];
+    zfs_stats_file_t    *sf;
+    int                 i;
+
+    for (i = 0; i < num_stats_files; i++) {
+        if (strcmp(stats_files[i].name, sname) == 0)
+            break;
+    }
+    if (i == num_stats_files) {
+        if (i == sizeof(stats_files) / sizeof(stats_files[0]))
+            return NULL;
+        sf = &stats_files[num_stats_files++];
+        sf->name = sname;
+        sf->kstat.fd = -1;
     }
-    return 0;
+    sf = &stats_files[i];
+    pmsprintf(fname, sizeof(fname), "%s%c%s", zfs_path, pmPathSeparator(), sname);
+    return zfs_kstat_open(&sf->kstat, fname);
 }
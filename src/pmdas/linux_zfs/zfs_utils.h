@@ -12,10 +12,28 @@
  * for more details.
  */
 
+#ifndef ZFS_UTILS_H
+#define ZFS_UTILS_H
+
 #include "pmapi.h"
 #include "libpcp.h"
 #include "pmda.h"
 
 extern char zfs_path[MAXPATHLEN];
 
-int zfs_stats_file_check(char *fname, size_t fnamelen, const char *sname);
+/* a kstat file held open between fetches, re-read using pread(2) */
+typedef struct zfs_kstat {
+    int         fd;
+    int         warned;
+    size_t      size;
+    char        *buf;
+} zfs_kstat_t;
+
+#define ZFS_KSTAT_INIT  { -1, 0, 0, NULL }
+
+FILE *zfs_kstat_open(zfs_kstat_t *, const char *path);
+void zfs_kstat_close(zfs_kstat_t *);
+
+FILE *zfs_stats_file_open(const char *sname);
+
+#endif /* ZFS_UTILS_H */
@@ -22,9 +22,99 @@
 #ifdef HAVE_REGEX_H
 #include <regex.h>
 #endif
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
 
 static int numlogfiles;
 static event_logfile_t *logfiles;
+static int watchfd = -1;	/* inotify descriptor for log directories */
+
+/*
+ * Where inotify is available the directory holding each log file is
+ * watched, so new lines are read as soon as they are written rather
+ * than on the next interval timer expiry (which remains as fallback).
+ * The directory rather than the file is watched so that rotation,
+ * and a log file that does not exist yet, are both noticed too.
+ */
+static void
+event_watch(event_logfile_t *logfile)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    char	dir[MAXPATHLEN];
+    char	*p;
+
+    logfile->wd = -1;
+    if (watchfd < 0 &&
+	(watchfd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0) {
+	pmNotifyErr(LOG_INFO, "inotify unavailable, using %s only - %s",
+			"interval timer", strerror(errno));
+	return;
+    }
+    pmstrncpy(dir, sizeof(dir), logfile->pathname);
+    if ((p = strrchr(dir, '/')) == NULL)
+	pmstrncpy(dir, sizeof(dir), ".");
+    else if (p == dir)
+	p[1] = '\0';
+    else
+	*p = '\0';
+    logfile->wd = inotify_add_watch(watchfd, dir,
+			IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO |
+			IN_ONLYDIR);
+    if (logfile->wd < 0)
+	pmNotifyErr(LOG_INFO, "inotify: %s - %s", dir, strerror(errno));
+#else
+    logfile->wd = -1;
+#endif
+}
+
+int
+event_watchfd(void)
+{
+    return watchfd;
+}
+
+/*
+ * Drain any inotify events, returning non-zero if one of them was for
+ * a log file we are following (other files share these directories).
+ */
+int
+event_watch_events(void)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    struct inotify_event *event;
+    char	buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    const char	*base;
+    ssize_t	n;
+    char	*p;
+    int		i, changed = 0;
+
+    while ((n = read(watchfd, buf, sizeof(buf))) > 0) {
+	for (p = buf; p < buf + n; p += sizeof(*event) + event->len) {
+	    event = (struct inotify_event *)p;
+	    if (event->mask & IN_Q_OVERFLOW) {
+		changed = 1;
+		continue;
+	    }
+	    if (event->len == 0)
+		continue;
+	    for (i = 0; i < numlogfiles && !changed; i++) {
+		if (logfiles[i].wd != event->wd)
+		    continue;
+		base = strrchr(logfiles[i].pathname, '/');
+		base = base ? base + 1 : logfiles[i].pathname;
+		if (strcmp(base, event->name) == 0)
+		    changed = 1;
+	    }
+	}
+    }
+    if (changed && pmDebugOptions.appl2)
+	pmNotifyErr(LOG_DEBUG, "inotify: log file change");
+    return changed;
+#else
+    return 0;
+#endif
+}
 
 void
 event_init(pmID pmid)
@@ -54,6 +144,7 @@ event_init(pmID pmid)
 				    logfiles[i].pathname, strerror(errno));
 		lseek(fd, 0, SEEK_END);
 	    }
+	    event_watch(&logfiles[i]);
 	}
 	else {
 	    strncpy(cmd, logfiles[i].pathname, sizeof(cmd));
@@ -94,6 +185,10 @@ event_shutdown(void)
 	    logfiles[i].fd = 0;
 	}
     }
+    if (watchfd >= 0) {
+	close(watchfd);
+	watchfd = -1;
+    }
 }
 
 /*
@@ -384,7 +479,9 @@ event_refresh(void)
 				logfile->pathname, strerror(errno));
 		logfile->fd = fd;
 	    } else {
+		/* unchanged, allowing for several writes per mtime tick */
 		if ((S_ISREG(pathstat.st_mode)) &&
+		    logfile->pathstat.st_size == pathstat.st_size &&
 		    (memcmp(&logfile->pathstat.st_mtime, &pathstat.st_mtime,
 			    sizeof(pathstat.st_mtime))) == 0)
 		    continue;
@@ -27,6 +27,7 @@ typedef struct event_logfile {
     pid_t	        pid;
     int			queueid;
     int			noaccess;
+    int			wd;		/* inotify watch on parent directory */
     struct stat		pathstat;
     char		pmnsname[MAXPATHLEN];
     char		pathname[MAXPATHLEN];
@@ -39,6 +40,8 @@ extern long maxmem;
 extern void event_init(pmID pmid);
 extern void event_shutdown(void);
 extern void event_refresh(void);
+extern int event_watchfd(void);
+extern int event_watch_events(void);
 extern int event_config(const char *filename);
 
 extern int event_logcount(void);
@@ -444,7 +444,7 @@ void
 loggerMain(pmdaInterface *dispatch)
 {
     fd_set		readyfds;
-    int			nready, pmcdfd;
+    int			nready, pmcdfd, watchfd;
 
     if ((pmcdfd = __pmdaInFd(dispatch)) < 0) {
 	/* error logged in __pmdaInFd() */
@@ -456,6 +456,13 @@ loggerMain(pmdaInterface *dispatch)
     FD_ZERO(&fds);
     FD_SET(pmcdfd, &fds);
 
+    /* log file changes wake us, where inotify is available */
+    if ((watchfd = event_watchfd()) >= 0) {
+	if (watchfd > maxfd)
+	    maxfd = watchfd;
+	FD_SET(watchfd, &fds);
+    }
+
     /* arm interval timer */
     if (__pmAFregister(&interval, NULL, logger_timer) < 0) {
 	pmNotifyErr(LOG_ERR, "registering event interval handler");
@@ -488,6 +495,9 @@ loggerMain(pmdaInterface *dispatch)
 	    if (pmDebugOptions.appl0)
 		pmNotifyErr(LOG_DEBUG, "completed pmcd PDU [fd=%d]", pmcdfd);
 	}
+	if (nready > 0 && watchfd >= 0 && FD_ISSET(watchfd, &readyfds) &&
+	    event_watch_events() && !interval_expired)
+	    event_refresh();
 	if (interval_expired) {
 	    interval_expired = 0;
 	    event_refresh();
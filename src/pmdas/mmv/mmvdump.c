@@ -116,6 +116,8 @@ dump_insts2(void *addr, size_t size, int idx, long base, __uint64_t offset, __in
 	    printf("\nBad file size: too small for toc[%d] inst[%d]\n", idx, i);
 	    return 1;
 	}
+	if (inst[i].indom == 0)	/* spare slot, for a growable indom */
+	    continue;
 	off = inst[i].indom;
 	indom = (mmv_disk_indom_t *)((char *)addr + off);
 	if (size < off + sizeof(mmv_disk_indom_t)) {
@@ -562,6 +564,34 @@ dump_labels(void *addr, size_t size, int idx, long base, __uint64_t offset, __in
     return 0;
 }
 
+int
+dump_stripes(void *addr, size_t size, int idx, long base, __uint64_t offset, __int32_t count, __int32_t nvalues)
+{
+    int i, j;
+    __uint64_t stride = MMV_STRIPE_STRIDE(nvalues);
+    pmAtomValue *av;
+
+    printf("\nTOC[%d]: offset %ld, stripes offset %"PRIu64" (%d entries)\n",
+		idx, base, offset, count);
+
+    for (i = 0; i < count; i++) {
+	__uint64_t off = offset + i * stride;
+
+	if (size < off + stride) {
+	    printf("Bad file size: too small for toc[%d] stripe[%d]\n", idx, i);
+	    return 1;
+	}
+	av = (pmAtomValue *)((char *)addr + off);
+	for (j = 0; j < nvalues; j++) {
+	    if (av[j].ull == 0)
+		continue;
+	    printf("  [%u/%"PRIu64"] value[%d] = 0x%"PRIx64"\n",
+		    i, off + j * sizeof(pmAtomValue), j, av[j].ull);
+	}
+    }
+    return 0;
+}
+
 static char *
 flagstr(int flags)
 {
@@ -578,8 +608,13 @@ flagstr(int flags)
 	strcat(buf, "process, ");
     if (flags & MMV_FLAG_SENTINEL)
 	strcat(buf, "sentinel, ");
+    if (flags & MMV_FLAG_PERCPU)
+	strcat(buf, "percpu, ");
+    if (flags & MMV_FLAG_GROWABLE)
+	strcat(buf, "growable, ");
 
-    flags &= ~(MMV_FLAG_NOPREFIX | MMV_FLAG_PROCESS | MMV_FLAG_SENTINEL);
+    flags &= ~(MMV_FLAG_NOPREFIX | MMV_FLAG_PROCESS | MMV_FLAG_SENTINEL |
+	       MMV_FLAG_PERCPU | MMV_FLAG_GROWABLE);
 
     /* unrecognised bits */
     if (flags) {
@@ -597,6 +632,7 @@ int
 dump(const char *file, void *addr, size_t size)
 {
     int i, sts, type, version;
+    __int32_t nvalues = 0;
     __uint32_t count;
     __uint64_t offset;
     mmv_disk_toc_t *toc;
@@ -615,7 +651,7 @@ dump(const char *file, void *addr, size_t size)
     }
     version = hdr->version;
     if (version != MMV_VERSION1 && version != MMV_VERSION2 &&
-	version != MMV_VERSION3)
+	version != MMV_VERSION3 && version != MMV_VERSION4)
     {
 	printf("Version %d not supported\n", version);
 	return 1;
@@ -650,6 +686,11 @@ dump(const char *file, void *addr, size_t size)
     }
     toc = (mmv_disk_toc_t *)((char *)addr + sizeof(mmv_disk_header_t));
 
+    /* stripes are laid out in terms of the number of values */
+    for (i = 0; i < hdr->tocs; i++)
+	if (toc[i].type == MMV_TOC_VALUES)
+	    nvalues = toc[i].count;
+
     for (i = sts = 0; i < hdr->tocs; i++) {
 	__uint64_t base = ((char *)&toc[i] - (char *)addr);
 
@@ -687,6 +728,10 @@ dump(const char *file, void *addr, size_t size)
 	    if (dump_labels(addr, size, i, base, offset, count))
 		sts = 1;
 	    break;    
+	case MMV_TOC_STRIPES:
+	    if (dump_stripes(addr, size, i, base, offset, count, nvalues))
+		sts = 1;
+	    break;
 	default:
 	    printf("Unrecognised TOC[%d] type: 0x%x\n", i, type);
 	    sts = 1;
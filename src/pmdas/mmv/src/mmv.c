@@ -33,6 +33,9 @@
 #include <sys/stat.h>
 #include <inttypes.h>
 #include <ctype.h>
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
 
 static int isDSO = 1;
 static char *username;
@@ -60,6 +63,18 @@ static pmdaOptions opts = {
     .long_options = longopts,
 };
 
+/*
+ * Index of the values in one mapped file, sorted by metric item and
+ * instance, so fetch finds each value directly rather than scanning
+ * the metric and value tables.  Singular metrics have inst zero.
+ */
+typedef struct {
+    __uint32_t		item;		/* metric item number */
+    __uint32_t		inst;		/* internal instance identifier */
+    int			metric;		/* index into metrics1 or metrics2 */
+    int			value;		/* index into values */
+} vindex_t;
+
 typedef struct {
     char		*name;		/* strdup client name */
     void		*addr;		/* mmap */
@@ -67,15 +82,22 @@ typedef struct {
     mmv_disk_metric_t	*metrics1;	/* v1 metric descs in mmap */
     mmv_disk_metric2_t	*metrics2;	/* v2 metric descs in mmap */
     mmv_disk_label_t	*labels; 	/* labels desc in mmap */
+    char		*stripes;	/* per-CPU value stripes in mmap */
+    vindex_t		*vindex;	/* values by (item, inst), or NULL */
+    int			vindexcnt;	/* number of vindex entries */
     int			vcnt;		/* number of values */
     int			mcnt1;		/* number of metrics */
     int			mcnt2;		/* number of v2 metrics */
     int			lcnt;		/* number of labels */
+    int			nstripes;	/* number of per-CPU stripes */
+    int			icnt;		/* number of instances (growable) */
     int			version;	/* v1/v2/v3 version number */
     int			cluster;	/* cluster identifier */
     pid_t		pid;		/* process identifier */
     __int64_t		len;		/* mmap region len */
     __uint64_t		gen;		/* generation number on open */
+    dev_t		dev;		/* file identity, for reuse on reload */
+    ino_t		ino;
 } stats_t;
 
 typedef struct {
@@ -90,6 +112,7 @@ typedef struct {
     int			notify;		/* notify pmcd of changes */
     int			statsdir_code;	/* last statsdir stat code */
     struct stat		statsdir_stat;	/* last statsdir stat struct */
+    int			watchfd;	/* inotify descriptor for statsdir */
     const char		*prefix;
     char		*pcptmpdir;		/* probably /var/tmp */
     char		*pcpvardir;		/* probably /var/pcp */
@@ -154,10 +177,11 @@ choose_cluster(agent_t *ap, int requested, const char *path)
 }
 
 static int
-create_client_stat(agent_t *ap, const char *client, const char *path, size_t size)
+create_client_stat(agent_t *ap, const char *client, const char *path, struct stat *sbuf)
 {
     mmv_disk_header_t	header;
     stats_t		*sp;
+    size_t		size = sbuf->st_size;
     size_t		offset;
     void		*m;
     int			cluster;
@@ -183,7 +207,8 @@ create_client_stat(agent_t *ap, const char *client, const char *path, size_t siz
 
 	    if (header.version != MMV_VERSION1 &&
 		header.version != MMV_VERSION2 &&
-		header.version != MMV_VERSION3) {
+		header.version != MMV_VERSION3 &&
+		header.version != MMV_VERSION4) {
 		if (pmDebugOptions.appl0)
 		    pmNotifyErr(LOG_ERR,
 			"%s: %s client version %d unsupported (current is %d)",
@@ -238,6 +263,8 @@ create_client_stat(agent_t *ap, const char *client, const char *path, size_t siz
 		sp[in].cluster = cluster;
 		sp[in].gen = header.g1;
 		sp[in].len = size;
+		sp[in].dev = sbuf->st_dev;
+		sp[in].ino = sbuf->st_ino;
 		ap->slist = sp;
 		ap->scnt++;
 	    } else {
@@ -259,6 +286,51 @@ create_client_stat(agent_t *ap, const char *client, const char *path, size_t siz
     return 0;
 }
 
+/*
+ * Keep the mapping of a file from before this reload if it is still
+ * the same file (same identity and size) and has not been rewritten
+ * since (same generation), saving the open, map and checks of every
+ * file each time any file in the directory comes or goes.
+ */
+static int
+reuse_client_stat(agent_t *ap, stats_t *old, int ocnt, const char *client,
+		struct stat *sbuf)
+{
+    mmv_disk_header_t	*hdr;
+    stats_t		*sp, *op;
+    int			i;
+
+    for (i = 0; i < ocnt; i++) {
+	op = &old[i];
+	if (op->addr == NULL || strcmp(op->name, client) != 0)
+	    continue;
+	hdr = (mmv_disk_header_t *)op->addr;
+	if (op->dev != sbuf->st_dev || op->ino != sbuf->st_ino ||
+	    op->len != sbuf->st_size ||
+	    hdr->g1 != op->gen || hdr->g2 != op->gen)
+	    return 0;
+	if (op->pid && !__pmProcessExists(op->pid))
+	    return 0;
+
+	if ((sp = realloc(ap->slist, sizeof(stats_t) * (ap->scnt + 1))) == NULL)
+	    return 0;
+	if (pmDebugOptions.appl0)
+	    pmNotifyErr(LOG_DEBUG, "MMV: keeping %s client: %d \"%s\"",
+				ap->prefix, op->cluster, client);
+	ap->slist = sp;
+	sp[ap->scnt++] = *op;
+	op->addr = NULL;	/* moved to the new list */
+	return 1;
+    }
+    return 0;
+}
+
+static int
+stats_compare(const void *a, const void *b)
+{
+    return strcmp(((const stats_t *)a)->name, ((const stats_t *)b)->name);
+}
+
 /* check validity of client metric name, return non-zero if bad or duplicate */
 static int
 verify_metric_name(agent_t *ap, const char *name, int pos, stats_t *s)
@@ -443,7 +515,7 @@ update_indom(pmdaExt *pmda, stats_t *s, __uint64_t offset, __uint32_t count,
 	    if (j == ip->it_numinst)
 		newinsts++;
 	}
-    } else if (s->version == MMV_VERSION2 || s->version == MMV_VERSION3) {
+    } else if (s->version >= MMV_VERSION2) {
 	in2 = (mmv_disk_instance2_t *)((char *)s->addr + offset);
 	for (i = 0; i < count; i++) {
 	    for (j = 0; j < ip->it_numinst; j++) {
@@ -485,7 +557,7 @@ update_indom(pmdaExt *pmda, stats_t *s, __uint64_t offset, __uint32_t count,
 		ip->it_numinst++;
 	    }
 	}
-    } else if (s->version == MMV_VERSION2 || s->version == MMV_VERSION3) {
+    } else if (s->version >= MMV_VERSION2) {
 	for (i = 0; i < count; i++) {
 	    for (j = 0; j < ip->it_numinst; j++)
 		if (ip->it_set[j].i_inst == in2[i].internal)
@@ -540,7 +612,7 @@ create_indom(pmdaExt *pmda, stats_t *s, __uint64_t offset, __uint32_t count,
 	    ip->it_set[i].i_inst = in1[i].internal;
 	    ip->it_set[i].i_name = in1[i].external;
 	}
-    } else if (s->version == MMV_VERSION2 || s->version == MMV_VERSION3) {
+    } else if (s->version >= MMV_VERSION2) {
 	in2 = (mmv_disk_instance2_t *)((char *)s->addr + offset);
 	ip->it_numinst = count;
 	for (i = 0; i < count; i++) {
@@ -553,15 +625,106 @@ create_indom(pmdaExt *pmda, stats_t *s, __uint64_t offset, __uint32_t count,
     return 0;
 }
 
+static int
+vindex_compare(const void *a, const void *b)
+{
+    const vindex_t	*va = (const vindex_t *)a;
+    const vindex_t	*vb = (const vindex_t *)b;
+
+    if (va->item != vb->item)
+	return va->item < vb->item ? -1 : 1;
+    if (va->inst != vb->inst)
+	return va->inst < vb->inst ? -1 : 1;
+    return va->value - vb->value;
+}
+
+/*
+ * (Re)build the value index of a mapped file.  Values that cannot be
+ * indexed (bad metric or instance offsets) are left out, and lookups
+ * that miss the index fall back to scanning the tables, so results
+ * are always the same as the scan would give.
+ */
+static void
+build_vindex(stats_t *s)
+{
+    mmv_disk_value_t	*v = s->values;
+    vindex_t		*vx;
+    char		*base;
+    __uint64_t		offset;
+    size_t		msize, isize;
+    __uint32_t		indom;
+    int			mcnt, mi, vi, n;
+
+    free(s->vindex);
+    s->vindex = NULL;
+    s->vindexcnt = 0;
+
+    if (s->version == MMV_VERSION1) {
+	base = (char *)s->metrics1;
+	msize = sizeof(mmv_disk_metric_t);
+	isize = sizeof(mmv_disk_instance_t);
+	mcnt = s->mcnt1;
+    } else {
+	base = (char *)s->metrics2;
+	msize = sizeof(mmv_disk_metric2_t);
+	isize = sizeof(mmv_disk_instance2_t);
+	mcnt = s->mcnt2;
+    }
+    if (base == NULL || v == NULL || s->vcnt <= 0)
+	return;
+    if ((vx = (vindex_t *)malloc(s->vcnt * sizeof(vindex_t))) == NULL)
+	return;
+
+    for (vi = n = 0; vi < s->vcnt; vi++) {
+	offset = (char *)s->addr + v[vi].metric - base;
+	if (((char *)s->addr + v[vi].metric) < base ||
+	    offset % msize != 0 || offset / msize >= mcnt)
+	    continue;
+	mi = offset / msize;
+	if (s->version == MMV_VERSION1) {
+	    vx[n].item = s->metrics1[mi].item;
+	    indom = s->metrics1[mi].indom;
+	} else {
+	    vx[n].item = s->metrics2[mi].item;
+	    indom = s->metrics2[mi].indom;
+	}
+	if (indom == PM_INDOM_NULL || indom == 0)
+	    vx[n].inst = 0;
+	else if (s->len < v[vi].instance + isize)
+	    continue;
+	else if (s->version == MMV_VERSION1)
+	    vx[n].inst = ((mmv_disk_instance_t *)
+			((char *)s->addr + v[vi].instance))->internal;
+	else
+	    vx[n].inst = ((mmv_disk_instance2_t *)
+			((char *)s->addr + v[vi].instance))->internal;
+	vx[n].metric = mi;
+	vx[n].value = vi;
+	n++;
+    }
+    qsort(vx, n, sizeof(vindex_t), vindex_compare);
+
+    /* duplicate items (ignored in the namespace) are left to the scan */
+    for (vi = 1; vi < n; vi++) {
+	if (vx[vi].item == vx[vi-1].item && vx[vi].metric != vx[vi-1].metric) {
+	    free(vx);
+	    return;
+	}
+    }
+    s->vindex = vx;
+    s->vindexcnt = n;
+}
+
 static void
 map_stats(pmdaExt *pmda)
 {
     struct dirent	**files;
     struct stat		statbuf;
     agent_t		*ap = (agent_t *)pmdaExtGetData(pmda);
-    char		path[MAXPATHLEN], name[64], *client;
+    stats_t		*old;
+    char		path[MAXPATHLEN], name[64], *client, *reused = NULL;
     int			need_reload = 0, sep = pmPathSeparator();
-    int			i, j, k, sts, num;
+    int			i, j, k, sts, num, ocnt, vcnt;
 
     if (ap->pmns) {
 	pmdaTreeRelease(ap->pmns);
@@ -592,18 +755,19 @@ map_stats(pmdaExt *pmda)
 	ap->intot = 0;
     }
 
-    if (ap->slist != NULL) {
-	for (i = 0; i < ap->scnt; i++) {
-	    free(ap->slist[i].name);
-	    __pmMemoryUnmap(ap->slist[i].addr, ap->slist[i].len);
-	}
-	free(ap->slist);
-	ap->slist = NULL;
-	ap->scnt = 0;
-    }
+    old = ap->slist;
+    ocnt = ap->scnt;
+    ap->slist = NULL;
+    ap->scnt = 0;
 
+    /*
+     * Unchanged files keep their mapping (and cluster), then new or
+     * changed files are mapped, choosing clusters around those kept.
+     */
     num = scandir(ap->statsdir, &files, NULL, alphasort);
-    for (i = 0; i < num; i++) {
+    if (num > 0 && ocnt > 0)
+	reused = (char *)calloc(num, sizeof(char));
+    for (i = 0; reused && i < num; i++) {
 	if (files[i]->d_name[0] == '.')
 	    continue;
 
@@ -611,14 +775,39 @@ map_stats(pmdaExt *pmda)
 	pmsprintf(path, sizeof(path), "%s%c%s", ap->statsdir, sep, client);
 
 	if (stat(path, &statbuf) >= 0 && S_ISREG(statbuf.st_mode))
-	    if (create_client_stat(ap, client, path, statbuf.st_size) == -EAGAIN)
+	    reused[i] = reuse_client_stat(ap, old, ocnt, client, &statbuf);
+    }
+    for (i = 0; i < num; i++) {
+	if (files[i]->d_name[0] == '.' || (reused && reused[i]))
+	    continue;
+
+	client = files[i]->d_name;
+	pmsprintf(path, sizeof(path), "%s%c%s", ap->statsdir, sep, client);
+
+	if (stat(path, &statbuf) >= 0 && S_ISREG(statbuf.st_mode))
+	    if (create_client_stat(ap, client, path, &statbuf) == -EAGAIN)
 		need_reload = 1;
     }
+    if (ap->scnt > 1)
+	qsort(ap->slist, ap->scnt, sizeof(stats_t), stats_compare);
 
     for (i = 0; i < num; i++)
 	free(files[i]);
     if (num > 0)
 	free(files);
+    free(reused);
+
+    for (i = 0; i < ocnt; i++) {
+	if (old[i].addr == NULL)
+	    continue;	/* kept */
+	if (pmDebugOptions.appl0)
+	    pmNotifyErr(LOG_DEBUG, "MMV: dropping %s client: %d \"%s\"",
+				ap->prefix, old[i].cluster, old[i].name);
+	free(old[i].name);
+	free(old[i].vindex);
+	__pmMemoryUnmap(old[i].addr, old[i].len);
+    }
+    free(old);
 
     for (i = 0; ap->slist && i < ap->scnt; i++) {
 	stats_t	*s = ap->slist + i;
@@ -627,6 +816,8 @@ map_stats(pmdaExt *pmda)
 	mmv_disk_toc_t *toc = (mmv_disk_toc_t *)
 			((char *)s->addr + sizeof(mmv_disk_header_t));
 
+	vcnt = s->vcnt;
+	s->icnt = 0;
 	for (j = 0; j < hdr->tocs; j++) {
 	    __uint64_t offset = toc[j].offset;
 	    __uint32_t count = toc[j].count;
@@ -679,7 +870,7 @@ map_stats(pmdaExt *pmda)
 					mp->type, mp->semantics, mp->dimension);
 		    }
 		}
-		else if (s->version == MMV_VERSION2 || s->version == MMV_VERSION3) {
+		else if (s->version >= MMV_VERSION2) {
 		    mmv_disk_metric2_t *ml = (mmv_disk_metric2_t *)
 					((char *)s->addr + offset);
 
@@ -785,6 +976,7 @@ map_stats(pmdaExt *pmda)
 			}
 		    }
 		    ioffset = id[k].offset;
+		    s->icnt += icount;
 		    sts = verify_indom_serial(pmda, serial, s, &pmindom, &ip);
 		    if (sts == -EINVAL)
 			continue;
@@ -843,6 +1035,12 @@ map_stats(pmdaExt *pmda)
 		s->lcnt = count;
 	    	break;
 
+	    case MMV_TOC_STRIPES:
+		/* bounds verified once the values section is known */
+		s->stripes = (char *)s->addr + offset;
+		s->nstripes = count;
+		break;
+
 	    default:
 		if (pmDebugOptions.appl0) {
 		    pmNotifyErr(LOG_DEBUG, "MMV: %s - bad TOC type (%x)",
@@ -851,6 +1049,24 @@ map_stats(pmdaExt *pmda)
 		break;
 	    }
 	}
+
+	if (s->stripes) {
+	    __uint64_t offset = (s->stripes - (char *)s->addr) +
+			s->nstripes * MMV_STRIPE_STRIDE(s->vcnt);
+
+	    if (s->len < offset) {
+		if (pmDebugOptions.appl0) {
+		    pmNotifyErr(LOG_ERR, "MMV: %s - "
+				"stripes offset: %"PRIu64" < %"PRIu64,
+				s->name, s->len, offset);
+		}
+		s->stripes = NULL;
+		s->nstripes = 0;
+	    }
+	}
+
+	if (s->vindex == NULL || s->vcnt != vcnt)
+	    build_vindex(s);
     }
 
     pmdaTreeRebuildHash(ap->pmns, ap->mtot); /* for reverse (pmid->name) lookups */
@@ -927,6 +1143,69 @@ mmv_lookup_item2(int item, unsigned int inst,
     return sts;
 }
 
+/* first vindex entry at or after (item, inst) */
+static int
+vindex_search(stats_t *s, __uint32_t item, __uint32_t inst)
+{
+    vindex_t		*vx = s->vindex;
+    int			lo = 0, hi = s->vindexcnt, mid;
+
+    while (lo < hi) {
+	mid = (lo + hi) / 2;
+	if (vx[mid].item < item || (vx[mid].item == item && vx[mid].inst < inst))
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    return lo;
+}
+
+/*
+ * Find a value using the index - returns the metric type, else
+ * PM_ERR_INST if the index cannot answer and the tables must be
+ * scanned (instances without values, PM_IN_NULL for a metric with
+ * an indom where the first value in the table is wanted).
+ */
+static int
+mmv_lookup_vindex(int item, unsigned int inst,
+	stats_t *s, mmv_disk_value_t **value,
+	__uint64_t *shorttext, __uint64_t *helptext)
+{
+    vindex_t		*vx;
+    __uint32_t		indom;
+    int			i;
+
+    i = vindex_search(s, item, 0);
+    if (i >= s->vindexcnt || s->vindex[i].item != item)
+	return PM_ERR_INST;
+    vx = &s->vindex[i];
+    indom = (s->version == MMV_VERSION1) ?
+		s->metrics1[vx->metric].indom : s->metrics2[vx->metric].indom;
+    if (indom != PM_INDOM_NULL && indom != 0) {
+	if (inst == PM_IN_NULL)
+	    return PM_ERR_INST;
+	i = vindex_search(s, item, inst);
+	if (i >= s->vindexcnt || s->vindex[i].item != item ||
+	    s->vindex[i].inst != inst)
+	    return PM_ERR_INST;
+	vx = &s->vindex[i];
+    }
+
+    *value = &s->values[vx->value];
+    if (s->version == MMV_VERSION1) {
+	if (shorttext)
+	    *shorttext = s->metrics1[vx->metric].shorttext;
+	if (helptext)
+	    *helptext = s->metrics1[vx->metric].helptext;
+	return s->metrics1[vx->metric].type;
+    }
+    if (shorttext)
+	*shorttext = s->metrics2[vx->metric].shorttext;
+    if (helptext)
+	*helptext = s->metrics2[vx->metric].helptext;
+    return s->metrics2[vx->metric].type;
+}
+
 static int
 mmv_lookup_stat_metric(agent_t *agent, pmID pmid, unsigned int inst,
 	stats_t **stats, mmv_disk_value_t **value,
@@ -940,9 +1219,14 @@ mmv_lookup_stat_metric(agent_t *agent, pmID pmid, unsigned int inst,
 	if (s->cluster != pmID_cluster(pmid))
 	    continue;
 
-	sts = (s->version == MMV_VERSION1) ?
-	    mmv_lookup_item1(pmID_item(pmid), inst, s, value, shorttext, helptext):
-	    mmv_lookup_item2(pmID_item(pmid), inst, s, value, shorttext, helptext);
+	sts = PM_ERR_INST;
+	if (s->vindex != NULL)
+	    sts = mmv_lookup_vindex(pmID_item(pmid), inst, s, value,
+				    shorttext, helptext);
+	if (sts < 0)
+	    sts = (s->version == MMV_VERSION1) ?
+		mmv_lookup_item1(pmID_item(pmid), inst, s, value, shorttext, helptext):
+		mmv_lookup_item2(pmID_item(pmid), inst, s, value, shorttext, helptext);
 	if (sts == MMV_TYPE_NOSUPPORT)
 	    sts = PM_ERR_APPVERSION;
 	if (sts >= 0) {
@@ -960,6 +1244,43 @@ mmv_lookup_stat_metric_value(agent_t *agent, pmID pmid, unsigned int inst,
     return mmv_lookup_stat_metric(agent, pmid, inst, stats, value, NULL, NULL);
 }
 
+/*
+ * Fold any per-CPU stripes of a counter into the fetched value
+ */
+static void
+mmv_stripes_sum(stats_t *s, mmv_disk_value_t *v, int type, pmAtomValue *atom)
+{
+    __uint64_t		stride = MMV_STRIPE_STRIDE(s->vcnt);
+    char		*stripe;
+    pmAtomValue		*av;
+    int			i;
+
+    stripe = s->stripes + (v - s->values) * sizeof(pmAtomValue);
+    for (i = 0; i < s->nstripes; i++, stripe += stride) {
+	av = (pmAtomValue *)stripe;
+	switch (type) {
+	    case MMV_TYPE_I32:
+		atom->l += av->l;
+		break;
+	    case MMV_TYPE_U32:
+		atom->ul += av->ul;
+		break;
+	    case MMV_TYPE_I64:
+		atom->ll += av->ll;
+		break;
+	    case MMV_TYPE_U64:
+		atom->ull += av->ull;
+		break;
+	    case MMV_TYPE_FLOAT:
+		atom->f += av->f;
+		break;
+	    case MMV_TYPE_DOUBLE:
+		atom->d += av->d;
+		break;
+	}
+    }
+}
+
 /*
  * callback provided to pmdaFetch
  */
@@ -1005,16 +1326,22 @@ mmv_fetchCallBack(pmdaMetric *mdesc, unsigned int inst, pmAtomValue *atom)
 		if ((flags & MMV_FLAG_SENTINEL) &&
 		    (memcmp(atom, &aNaN, sizeof(*atom)) == 0))
 		    return PMDA_FETCH_NOVALUES;
+		if (s->stripes)
+		    mmv_stripes_sum(s, v, sts, atom);
 		break;
 	    case MMV_TYPE_FLOAT:
 		memcpy(atom, &v->value, sizeof(pmAtomValue));
 		if ((flags & MMV_FLAG_SENTINEL) && atom->f == fNaN)
 		    return PMDA_FETCH_NOVALUES;
+		if (s->stripes)
+		    mmv_stripes_sum(s, v, sts, atom);
 		break;
 	    case MMV_TYPE_DOUBLE:
 		memcpy(atom, &v->value, sizeof(pmAtomValue));
 		if ((flags & MMV_FLAG_SENTINEL) && atom->d == dNaN)
 		    return PMDA_FETCH_NOVALUES;
+		if (s->stripes)
+		    mmv_stripes_sum(s, v, sts, atom);
 		break;
 	    case MMV_TYPE_ELAPSED: {
 		atom->ll = v->value.ll;
@@ -1053,6 +1380,129 @@ mmv_fetchCallBack(pmdaMetric *mdesc, unsigned int inst, pmAtomValue *atom)
     return PMDA_FETCH_NOVALUES;
 }
 
+/*
+ * Pick up instances appended to a growable file since the last fetch,
+ * without remapping - new instances are published after their values,
+ * so the indom counts are read before the values count.
+ */
+static void
+mmv_grow_stats(pmdaExt *pmda, stats_t *s)
+{
+    mmv_disk_header_t	*hdr = (mmv_disk_header_t *)s->addr;
+    mmv_disk_toc_t	*toc, *itoc = NULL, *vtoc = NULL;
+    mmv_disk_indom_t	*id;
+    pmdaIndom		*ip;
+    pmInDom		pmindom;
+    __uint64_t		offset;
+    __uint32_t		count;
+    int			i, icnt, vcnt;
+
+    toc = (mmv_disk_toc_t *)((char *)s->addr + sizeof(mmv_disk_header_t));
+    for (i = 0; i < hdr->tocs; i++) {
+	if (toc[i].type == MMV_TOC_INDOMS)
+	    itoc = &toc[i];
+	else if (toc[i].type == MMV_TOC_VALUES)
+	    vtoc = &toc[i];
+    }
+    if (itoc == NULL || vtoc == NULL)
+	return;
+    if (s->len < itoc->offset + itoc->count * sizeof(mmv_disk_indom_t))
+	return;
+
+    id = (mmv_disk_indom_t *)((char *)s->addr + itoc->offset);
+    for (i = icnt = 0; i < itoc->count; i++)
+	icnt += __atomic_load_n(&id[i].count, __ATOMIC_ACQUIRE);
+    vcnt = __atomic_load_n(&vtoc->count, __ATOMIC_ACQUIRE);
+    if (icnt == s->icnt && vcnt == s->vcnt)
+	return;
+
+    if (pmDebugOptions.appl0)
+	pmNotifyErr(LOG_DEBUG, "MMV: %s: %d instances and %d values, was %d/%d",
+			s->name, icnt, vcnt, s->icnt, s->vcnt);
+
+    if (s->len >= vtoc->offset + vcnt * sizeof(mmv_disk_value_t) &&
+	s->vcnt != vcnt) {
+	s->vcnt = vcnt;
+	build_vindex(s);
+    }
+    for (i = 0; i < itoc->count; i++) {
+	count = id[i].count;
+	offset = id[i].offset + count * sizeof(mmv_disk_instance2_t);
+	if (s->len < offset)
+	    continue;
+	if (verify_indom_serial(pmda, id[i].serial, s, &pmindom, &ip) == -EEXIST)
+	    update_indom(pmda, s, id[i].offset, count, &id[i], ip);
+    }
+    s->icnt = icnt;
+}
+
+/*
+ * Where inotify is available the stats directory is watched, so the
+ * directory need not be stat'd on every fetch and a reload happens
+ * only after files come, go or are rewritten.  The watch is set up
+ * before the first stat of the directory so no change is missed.
+ * Returns non-zero if the watch is in place.
+ */
+static int
+statsdir_watch(agent_t *ap)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    if (ap->watchfd == -1) {
+	if ((ap->watchfd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0) {
+	    ap->watchfd = -2;	/* unavailable, never try again */
+	    return 0;
+	}
+	if (inotify_add_watch(ap->watchfd, ap->statsdir,
+			IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+			IN_CLOSE_WRITE | IN_ATTRIB |
+			IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR) < 0) {
+	    /* no directory yet perhaps, try again next time */
+	    close(ap->watchfd);
+	    ap->watchfd = -1;
+	}
+	return 0;	/* directory stat'd this time */
+    }
+    return (ap->watchfd >= 0);
+#else
+    return 0;
+#endif
+}
+
+/* drain any inotify events, return non-zero if there were some */
+static int
+statsdir_events(agent_t *ap)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    struct inotify_event *event;
+    char		buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t		n;
+    char		*p;
+    int			changed = 0, lost = 0;
+
+    while ((n = read(ap->watchfd, buf, sizeof(buf))) > 0) {
+	changed = 1;
+	for (p = buf; p < buf + n; p += sizeof(*event) + event->len) {
+	    event = (struct inotify_event *)p;
+	    if (event->mask & IN_IGNORED)
+		lost = 1;	/* directory removed or moved away */
+	}
+    }
+    if (lost) {
+	/* back to stat'ing the directory until it reappears */
+	close(ap->watchfd);
+	ap->watchfd = -1;
+	ap->statsdir_code = 0;
+	memset(&ap->statsdir_stat, 0, sizeof(ap->statsdir_stat));
+    }
+    if (changed && pmDebugOptions.appl0)
+	pmNotifyErr(LOG_DEBUG, "MMV: %s: %s changed", pmGetProgname(),
+			ap->statsdir);
+    return changed;
+#else
+    return 0;
+#endif
+}
+
 static void
 mmv_reload_maybe(pmdaExt *pmda)
 {
@@ -1079,7 +1529,9 @@ mmv_reload_maybe(pmdaExt *pmda)
      * a change in permissions from accessible to not (or vice-
      * versa), and so on.
      */
-    if (stat(ap->statsdir, &s) >= 0) {
+    if (statsdir_watch(ap))
+	need_reload += statsdir_events(ap);
+    else if (stat(ap->statsdir, &s) >= 0) {
 #if defined(HAVE_ST_MTIME_WITH_E)
 	if (s.st_mtime != ap->statsdir_stat.st_mtime)
 #elif defined(HAVE_ST_MTIME_WITH_SPEC)
@@ -1116,6 +1568,13 @@ mmv_reload_maybe(pmdaExt *pmda)
 	    pmNotifyErr(LOG_DEBUG, 
 		      "MMV: %s: %d metrics and %d indoms after reload", 
 		      pmGetProgname(), ap->mtot, ap->intot);
+    } else {
+	for (i = 0; i < ap->scnt; i++) {
+	    mmv_disk_header_t *hdr = (mmv_disk_header_t *)ap->slist[i].addr;
+	    if ((hdr->flags & MMV_FLAG_GROWABLE) &&
+		ap->slist[i].version >= MMV_VERSION2)
+		mmv_grow_stats(pmda, &ap->slist[i]);
+	}
     }
 }
 
@@ -1412,6 +1871,7 @@ init_pmda(pmdaInterface *dp, agent_t *ap)
     ap->pcppmdasdir = pmGetConfig("PCP_PMDAS_DIR");
 
     pmsprintf(ap->statsdir, MAXPATHLEN, "%s%c%s", ap->pcptmpdir, sep, ap->prefix);
+    ap->watchfd = -1;
     pmsprintf(ap->pmnsdir, MAXPATHLEN, "%s%c" "pmns", ap->pcpvardir, sep);
 
     /* Initialize internal dispatch table */
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2014,2019,2021 Red Hat.
+ * Copyright (c) 2014,2019,2021,2026 Red Hat.
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms of the GNU General Public License as published by the
@@ -55,6 +55,7 @@ struct {
     { .symbol = "nvmlDeviceGetAccountingStats" },
     { .symbol = "nvmlDeviceGetTotalEnergyConsumption" },
     { .symbol = "nvmlDeviceGetPowerUsage" },
+    { .symbol = "nvmlDeviceGetSamples" },
 };
 enum {
     NVML_INIT,
@@ -85,6 +86,7 @@ enum {
     NVML_DEVICE_GET_ACCOUNTINGSTATS,
     NVML_DEVICE_GET_TOTALENERGYCONSUMPTION,
     NVML_DEVICE_GET_POWERUSAGE,
+    NVML_DEVICE_GET_SAMPLES,
     NVML_SYMBOL_COUNT
 };
 typedef int (*local_init_t)(void);
@@ -107,6 +109,7 @@ typedef int (*local_dev_get_accountingpids_t)(nvmlDevice_t, unsigned int *, unsi
 typedef int (*local_dev_get_accountingstats_t)(nvmlDevice_t, unsigned int, nvmlAccountingStats_t *);
 typedef int (*local_dev_get_totalenergyconsumption_t)(nvmlDevice_t, unsigned long long *);
 typedef int (*local_dev_get_powerusage_t)(nvmlDevice_t, unsigned int *);
+typedef int (*local_dev_get_samples_t)(nvmlDevice_t, nvmlSamplingType_t, unsigned long long, nvmlValueType_t *, unsigned int *, nvmlSample_t *);
 
 static int
 resolve_symbols(void)
@@ -375,6 +378,20 @@ localNvmlDeviceGetAccountingStats(nvmlDevice_t device, unsigned int pid, nvmlAcc
     return dev_get_accountingstats(device, pid, stats);
 }
 
+int
+localNvmlDeviceGetSamples(nvmlDevice_t device, nvmlSamplingType_t type,
+		unsigned long long lastseen, nvmlValueType_t *valtype,
+		unsigned int *count, nvmlSample_t *samples)
+{
+    local_dev_get_samples_t dev_get_samples;
+    void *func = nvml_symtab[NVML_DEVICE_GET_SAMPLES].handle;
+
+    if (!func)
+	return NVML_ERROR_FUNCTION_NOT_FOUND;
+    dev_get_samples = (local_dev_get_samples_t)func;
+    return dev_get_samples(device, type, lastseen, valtype, count, samples);
+}
+
 const char *
 localNvmlErrStr(nvmlReturn_t sts)
 {
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2014,2019,2021 Red Hat.
+ * Copyright (c) 2014,2019,2021,2026 Red Hat.
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms of the GNU General Public License as published by the
@@ -95,6 +95,39 @@ typedef struct {
     unsigned int	computeInstanceId;
 } nvmlProcessInfo_t;
 
+typedef enum {
+    NVML_TOTAL_POWER_SAMPLES		= 0,
+    NVML_GPU_UTILIZATION_SAMPLES	= 1,
+    NVML_MEMORY_UTILIZATION_SAMPLES	= 2,
+    NVML_ENC_UTILIZATION_SAMPLES	= 3,
+    NVML_DEC_UTILIZATION_SAMPLES	= 4,
+    NVML_PROCESSOR_CLK_SAMPLES		= 5,
+    NVML_MEMORY_CLK_SAMPLES		= 6,
+    NVML_SAMPLINGTYPE_COUNT
+} nvmlSamplingType_t;
+
+typedef enum {
+    NVML_VALUE_TYPE_DOUBLE		= 0,
+    NVML_VALUE_TYPE_UNSIGNED_INT	= 1,
+    NVML_VALUE_TYPE_UNSIGNED_LONG	= 2,
+    NVML_VALUE_TYPE_UNSIGNED_LONG_LONG	= 3,
+    NVML_VALUE_TYPE_SIGNED_LONG_LONG	= 4,
+    NVML_VALUE_TYPE_COUNT
+} nvmlValueType_t;
+
+typedef union {
+    double		dVal;
+    unsigned int	uiVal;
+    unsigned long	ulVal;
+    unsigned long long	ullVal;
+    signed long long	sllVal;
+} nvmlValue_t;
+
+typedef struct {
+    unsigned long long	timeStamp;	/* CPU timestamp, microseconds */
+    nvmlValue_t		sampleValue;
+} nvmlSample_t;
+
 typedef struct {
     unsigned int	gpuUtilization;
     unsigned int	memoryUtilization;
@@ -127,5 +160,6 @@ extern int localNvmlDeviceGetAccountingPids(nvmlDevice_t, unsigned int *, unsign
 extern int localNvmlDeviceGetAccountingStats(nvmlDevice_t, unsigned int, nvmlAccountingStats_t *);
 extern int localNvmlDeviceGetTotalEnergyConsumption(nvmlDevice_t, unsigned long long *);
 extern int localNvmlDeviceGetPowerUsage(nvmlDevice_t, unsigned int *);
+extern int localNvmlDeviceGetSamples(nvmlDevice_t, nvmlSamplingType_t, unsigned long long, nvmlValueType_t *, unsigned int *, nvmlSample_t *);
 
 #endif /* _LOCAL_NVML_H */
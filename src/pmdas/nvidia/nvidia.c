@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2014,2019,2021 Red Hat.
+ * Copyright (c) 2014,2019,2021,2026 Red Hat.
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms of the GNU General Public License as published by the
@@ -16,6 +16,7 @@
 #include "domain.h"
 #include "libpcp.h"
 #include "localnvml.h"
+#include <pthread.h>
 
 /* InDom table (set of graphics cards, set of processes+devices) */
 enum { GCARD_INDOM = 0, GPROC_INDOM, PROC_INDOM };
@@ -209,6 +210,7 @@ enum {
 typedef struct {
     pid_t		pid;
     unsigned int	flags;	/* COMPUTE|GRAPHICS|ACCOUNT */
+    unsigned int	refreshed;	/* refresh generation last seen */
     char		*name;
     struct {
 	unsigned long long	memused;
@@ -240,7 +242,6 @@ typedef struct {
     char		*name;
     char		*uuid;
     char		*busid;
-    unsigned int	flags;
     unsigned int	nprocs;
     unsigned int	temperature;
     unsigned int	fanspeed;
@@ -256,22 +257,61 @@ typedef struct {
     nvmlMemory_t	memory;
 } nvinfo_t;
 
+/*
+ * NVML readings for one card.  These are gathered without holding the
+ * PMDA lock - concurrently for all cards when running as a daemon - and
+ * then merged into the nvinfo_t values that fetch requests are served
+ * from.  Buffers are retained between refreshes.
+ */
+typedef struct {
+    unsigned int	cardid;
+    unsigned int	flags;		/* HASCOMPUTE|HASGRAPHICS|HASACCOUNT */
+    int			need_processes;
+    int			status;		/* device handle lookup */
+    int			failed[NVIDIA_METRIC_COUNT];
+    nvmlDevice_t	device;
+    char		name[NVML_DEVICE_NAME_BUFFER_SIZE];
+    char		uuid[NVML_DEVICE_UUID_BUFFER_SIZE];
+    nvmlPciInfo_t	pci;
+    unsigned int	fanspeed;
+    unsigned int	temperature;
+    unsigned int	power;
+    unsigned long long	energy;
+    nvmlPstates_t	pstate;
+    nvmlUtilization_t	utilization;
+    nvmlMemory_t	memory;
+    int			nosamples;	/* nvmlDeviceGetSamples unavailable */
+    unsigned long long	lastseen[2];	/* newest gpu, memory sample time */
+    unsigned int	nsamples;
+    nvmlSample_t	*samples;
+    struct {
+	unsigned int		count;
+	unsigned int		size;	/* local high-water mark */
+	nvmlProcessInfo_t	*infos;
+	nvmlAccountingStats_t	*stats;
+    } procs[PROCESS_MODES];
+} nvcollect_t;
+
 /* overall struct, holds instance values, indom and instance struct arrays */
 typedef struct {
     int			numcards;
     int			maxcards;
     nvinfo_t		*nvinfo;
+    nvcollect_t		*collect;
+    pthread_t		*threads;
     pmdaIndom		*nvindom;
 } pcp_nvinfo_t;
 
 static pcp_nvinfo_t	pcp_nvinfo;
 static __pmHashCtl	processes;
+static unsigned int	refreshes;
 static char		mypath[MAXPATHLEN];
 static int		isDSO = 1;
 static int		nvmlDSO_loaded;
 static int		nvmlDSO_status;
-static int		autorefresh = -1;
+static int		autorefresh;
 static struct timeval	interval;
+static pthread_mutex_t	nvidia_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 static int
 setup_gcard_indom(void)
@@ -279,6 +319,7 @@ setup_gcard_indom(void)
     nvmlDevice_t	device;
     unsigned int	device_count = 0, count;
     pmdaIndom		*idp = &indomtab[GCARD_INDOM];
+    nvcollect_t		*collect;
     char		gpuname[32], *name;
     int			i, sts;
 
@@ -302,6 +343,14 @@ setup_gcard_indom(void)
 	free(pcp_nvinfo.nvindom->it_set);
 	return -ENOMEM;
     }
+    if ((pcp_nvinfo.collect = (nvcollect_t *)calloc(device_count, sizeof(nvcollect_t))) == NULL ||
+	(pcp_nvinfo.threads = (pthread_t *)calloc(device_count, sizeof(pthread_t))) == NULL) {
+	pmNoMem("gcard buffers", device_count * sizeof(nvcollect_t), PM_RECOV_ERR);
+	free(pcp_nvinfo.collect);
+	free(pcp_nvinfo.nvinfo);
+	free(pcp_nvinfo.nvindom->it_set);
+	return -ENOMEM;
+    }
 
     for (i = 0; i < device_count; i++) {
 	pcp_nvinfo.nvindom->it_set[i].i_inst = i;
@@ -312,11 +361,15 @@ setup_gcard_indom(void)
 		free(pcp_nvinfo.nvindom->it_set[i].i_name);
 	    free(pcp_nvinfo.nvindom->it_set);
 	    free(pcp_nvinfo.nvinfo);
+	    free(pcp_nvinfo.collect);
+	    free(pcp_nvinfo.threads);
 	    return -ENOMEM;
 	}
 	pcp_nvinfo.nvindom->it_set[i].i_name = name;
     }
     for (i = 0; i < device_count; i++) {
+	collect = &pcp_nvinfo.collect[i];
+	collect->cardid = i;
 	if ((sts = localNvmlDeviceGetHandleByIndex(i, &device))) {
 	    pmNotifyErr(LOG_ERR, "nvmlDeviceGetHandleByIndex: %s",
 			localNvmlErrStr(sts));
@@ -325,14 +378,14 @@ setup_gcard_indom(void)
 	count = 0;
 	sts = localNvmlDeviceGetComputeRunningProcesses(device, &count, NULL);
 	if (sts == NVML_SUCCESS || sts == NVML_ERROR_INSUFFICIENT_SIZE)
-	    pcp_nvinfo.nvinfo[i].flags |= HASCOMPUTE;
+	    collect->flags |= HASCOMPUTE;
 	count = 0;
 	sts = localNvmlDeviceGetGraphicsRunningProcesses(device, &count, NULL);
 	if (sts == NVML_SUCCESS || sts == NVML_ERROR_INSUFFICIENT_SIZE)
-	    pcp_nvinfo.nvinfo[i].flags |= HASGRAPHICS;
+	    collect->flags |= HASGRAPHICS;
 	sts = localNvmlDeviceSetAccountingMode(device, NVML_FEATURE_ENABLED);
 	if (sts == NVML_SUCCESS)
-	    pcp_nvinfo.nvinfo[i].flags |= HASACCOUNT;
+	    collect->flags |= HASACCOUNT;
 	localNvmlDeviceSetPersistenceMode(device, NVML_FEATURE_ENABLED);
     }
 
@@ -342,24 +395,255 @@ setup_gcard_indom(void)
     return 0;
 }
 
+/*
+ * Average the utilization samples buffered by the driver since the
+ * previous refresh, so that short bursts of activity between refreshes
+ * are observed rather than only the most recent sample period.
+ */
+static int
+collect_samples(nvcollect_t *c, nvmlSamplingType_t type, int which,
+		unsigned int *value)
+{
+    nvmlValueType_t	valtype;
+    nvmlSample_t	*sample, *tmp;
+    unsigned long long	total = 0, lastseen = c->lastseen[which];
+    unsigned int	i, n = 0, count = 0;
+    int			sts;
+
+    sts = localNvmlDeviceGetSamples(c->device, type, lastseen,
+				    &valtype, &count, NULL);
+    if (sts != NVML_SUCCESS)
+	return sts;
+    if (count > c->nsamples) {
+	if ((tmp = realloc(c->samples, count * sizeof(*tmp))) == NULL)
+	    return NVML_ERROR_MEMORY;
+	c->samples = tmp;
+	c->nsamples = count;
+    }
+    count = c->nsamples;
+    sts = localNvmlDeviceGetSamples(c->device, type, lastseen,
+				    &valtype, &count, c->samples);
+    if (sts != NVML_SUCCESS)
+	return sts;
+
+    for (i = 0; i < count && i < c->nsamples; i++) {
+	sample = &c->samples[i];
+	if (sample->timeStamp <= lastseen)
+	    continue;
+	switch (valtype) {
+	case NVML_VALUE_TYPE_DOUBLE:
+	    total += (unsigned long long)(sample->sampleValue.dVal + 0.5);
+	    break;
+	case NVML_VALUE_TYPE_UNSIGNED_INT:
+	    total += sample->sampleValue.uiVal;
+	    break;
+	case NVML_VALUE_TYPE_UNSIGNED_LONG:
+	    total += sample->sampleValue.ulVal;
+	    break;
+	case NVML_VALUE_TYPE_UNSIGNED_LONG_LONG:
+	    total += sample->sampleValue.ullVal;
+	    break;
+	case NVML_VALUE_TYPE_SIGNED_LONG_LONG:
+	    total += sample->sampleValue.sllVal;
+	    break;
+	default:
+	    continue;
+	}
+	if (sample->timeStamp > c->lastseen[which])
+	    c->lastseen[which] = sample->timeStamp;
+	n++;
+    }
+    if (n == 0)
+	return NVML_ERROR_NOT_FOUND;
+    *value = total / n;
+    return NVML_SUCCESS;
+}
+
+static int
+collect_utilization(nvcollect_t *c)
+{
+    nvmlUtilization_t	utilization;
+    int			sts;
+
+    if (!c->nosamples) {
+	if ((sts = collect_samples(c, NVML_GPU_UTILIZATION_SAMPLES, 0,
+				&utilization.gpu)) == NVML_SUCCESS &&
+	    (sts = collect_samples(c, NVML_MEMORY_UTILIZATION_SAMPLES, 1,
+				&utilization.memory)) == NVML_SUCCESS) {
+	    c->utilization = utilization;	/* struct copy */
+	    return NVML_SUCCESS;
+	}
+	if (sts == NVML_ERROR_NOT_SUPPORTED ||
+	    sts == NVML_ERROR_FUNCTION_NOT_FOUND)
+	    c->nosamples = 1;
+    }
+    /* no new samples buffered, or no sample buffer support at all */
+    return localNvmlDeviceGetUtilizationRates(c->device, &c->utilization);
+}
+
+typedef int (*running_processes_t)(nvmlDevice_t, unsigned int *, nvmlProcessInfo_t *);
+
+static void
+collect_processes(nvcollect_t *c, int mode)
+{
+    running_processes_t	running;
+    nvmlProcessInfo_t	*infos;
+    nvmlAccountingStats_t *stats;
+    unsigned int	i, count = 0;
+
+    c->procs[mode].count = 0;
+    if (mode == PROCESS_COMPUTE)
+	running = localNvmlDeviceGetComputeRunningProcesses;
+    else
+	running = localNvmlDeviceGetGraphicsRunningProcesses;
+
+    /* extract size of the process list for this device */
+    running(c->device, &count, NULL);
+    if (count == 0)
+	return;
+    if (count > c->procs[mode].size) {
+	if ((infos = realloc(c->procs[mode].infos, count * sizeof(*infos))) == NULL)
+	    return;	/* out-of-memory */
+	c->procs[mode].infos = infos;
+	if ((stats = realloc(c->procs[mode].stats, count * sizeof(*stats))) == NULL)
+	    return;	/* out-of-memory */
+	c->procs[mode].stats = stats;
+	c->procs[mode].size = count;
+    }
+
+    /* extract actual list of processes on this device now */
+    count = c->procs[mode].size;
+    running(c->device, &count, c->procs[mode].infos);
+    if (count > c->procs[mode].size)	/* list grew in the meantime */
+	count = c->procs[mode].size;
+
+    /* extract the per-process stats now if available */
+    for (i = 0; i < count; i++) {
+	stats = &c->procs[mode].stats[i];
+	memset(stats, 0, sizeof(*stats));
+	if ((c->flags & HASACCOUNT))
+	    localNvmlDeviceGetAccountingStats(c->device,
+			    c->procs[mode].infos[i].pid, stats);
+    }
+    c->procs[mode].count = count;
+}
+
+/*
+ * Query NVML for all values from one card - this is where the time is
+ * spent, so these run in parallel and touch only the nvcollect_t.
+ */
+static void
+collect_card(nvcollect_t *c)
+{
+    int			j;
+
+    for (j = 0; j < NVIDIA_METRIC_COUNT; j++)
+	c->failed[j] = 0;
+    if ((c->status = localNvmlDeviceGetHandleByIndex(c->cardid, &c->device)))
+	return;
+
+    /* names and identifiers are constant, so only requested until known */
+    if (c->name[0] == '\0' &&
+	localNvmlDeviceGetName(c->device, c->name, sizeof(c->name)))
+	c->failed[NVIDIA_CARDNAME] = 1;
+    if (c->uuid[0] == '\0' &&
+	localNvmlDeviceGetUUID(c->device, c->uuid, sizeof(c->uuid)))
+	c->failed[NVIDIA_CARDUUID] = 1;
+    if (c->pci.busId[0] == '\0' &&
+	localNvmlDeviceGetPciInfo(c->device, &c->pci))
+	c->failed[NVIDIA_BUSID] = 1;
+    if (localNvmlDeviceGetFanSpeed(c->device, &c->fanspeed))
+	c->failed[NVIDIA_FANSPEED] = 1;
+    if (localNvmlDeviceGetTemperature(c->device, NVML_TEMPERATURE_GPU, &c->temperature))
+	c->failed[NVIDIA_TEMPERATURE] = 1;
+    if (collect_utilization(c)) {
+	c->failed[NVIDIA_GPUACTIVE] = 1;
+	c->failed[NVIDIA_MEMACTIVE] = 1;
+    }
+    if (localNvmlDeviceGetMemoryInfo(c->device, &c->memory)) {
+	c->failed[NVIDIA_MEMUSED] = 1;
+	c->failed[NVIDIA_MEMTOTAL] = 1;
+	c->failed[NVIDIA_MEMFREE] = 1;
+    }
+    if (localNvmlDeviceGetPerformanceState(c->device, &c->pstate))
+	c->failed[NVIDIA_PERFSTATE] = 1;
+    if (localNvmlDeviceGetTotalEnergyConsumption(c->device, &c->energy))
+	c->failed[NVIDIA_ENERGY] = 1;
+    if (localNvmlDeviceGetPowerUsage(c->device, &c->power))
+	c->failed[NVIDIA_POWER] = 1;
+
+    if (c->need_processes) {
+	if ((c->flags & HASCOMPUTE))
+	    collect_processes(c, PROCESS_COMPUTE);
+	if ((c->flags & HASGRAPHICS))
+	    collect_processes(c, PROCESS_GRAPHICS);
+    }
+}
+
+static void *
+collect_worker(void *arg)
+{
+    collect_card((nvcollect_t *)arg);
+    return NULL;
+}
+
 static void
+collect_cards(pcp_nvinfo_t *nvinfo, unsigned int count, int need_processes)
+{
+    unsigned int	i, nthreads = 0;
+
+    for (i = 0; i < count; i++)
+	nvinfo->collect[i].need_processes = need_processes;
+
+    /* no helper threads within pmcd, query cards in turn there */
+    if (isDSO || count < 2) {
+	for (i = 0; i < count; i++)
+	    collect_card(&nvinfo->collect[i]);
+	return;
+    }
+
+    for (i = 0; i < count; i++, nthreads++) {
+	if (pthread_create(&nvinfo->threads[i], NULL,
+			   collect_worker, &nvinfo->collect[i]) != 0)
+	    break;
+    }
+    for (; i < count; i++)	/* thread creation failed, finish inline */
+	collect_card(&nvinfo->collect[i]);
+    for (i = 0; i < nthreads; i++)
+	pthread_join(nvinfo->threads[i], NULL);
+}
+
+static int
 update_process(pid_t pid, int mode, unsigned int cardid,
 		nvmlProcessInfo_t *info, nvmlAccountingStats_t *stats)
 {
     __pmHashNode	*node;
     process_t		*process;
     char		name[32];
+    int			added = 0;
 
     if ((node = __pmHashSearch(pid, &processes)) == NULL) {
 	if ((process = (process_t *)calloc(1, sizeof(process_t))) == NULL)
-	    return;
+	    return 0;
 	process->pid = pid;
 	pmsprintf(name, sizeof(name), "%06d", pid);
 	process->name = strdup(name);
 	__pmHashAdd(pid, process, &processes);
+	added = 1;
     } else {
 	process = (process_t *)node->data;
     }
+    if (process->refreshed != refreshes) {
+	/* first sighting in this refresh, reset per-refresh state */
+	process->refreshed = refreshes;
+	process->acct[PROCESS_COMPUTE].ngpus = 0;
+	process->acct[PROCESS_GRAPHICS].ngpus = 0;
+	process->acct[PROCESS_COMPUTE].running = 0;
+	process->acct[PROCESS_GRAPHICS].running = 0;
+	process->acct[PROCESS_COMPUTE].gpulist = 0;
+	process->acct[PROCESS_GRAPHICS].gpulist = 0;
+	process->flags &= ~(COMPUTE|GRAPHICS|ACCOUNT);
+    }
     if ((mode == PROCESS_COMPUTE))
 	process->flags |= COMPUTE;
     if ((mode == PROCESS_GRAPHICS))
@@ -374,103 +658,67 @@ update_process(pid_t pid, int mode, unsigned int cardid,
 	process->acct[mode].gpulist |= (1 << cardid);
     process->acct[mode].samples++;
     process->acct[mode].ngpus++;
+    return added;
 }
 
-static void
-update_processes(nvmlDevice_t device, pmInDom gpuproc_indom,
-		const char *name, unsigned int cardid,
-		unsigned int count, nvmlProcessInfo_t *infos,
-		nvinfo_t *nvinfo, int mode)
+static int
+update_processes(pmInDom gpuproc_indom, nvcollect_t *c, int mode)
 {
     char		pname[NVML_DEVICE_NAME_BUFFER_SIZE+64];	/* + for pid::cardid:: */
-    int			i, inst;
-
-    for (i = 0; i < count; i++) {
-	nvmlAccountingStats_t	stats = {0};
-	nvproc_t		*nvproc;
-
-	/* extract the per-process stats now if available */
-	if ((nvinfo->flags & HASACCOUNT))
-	    localNvmlDeviceGetAccountingStats(device, infos[i].pid, &stats);
+    nvmlProcessInfo_t	*infos = c->procs[mode].infos;
+    nvmlAccountingStats_t *stats = c->procs[mode].stats;
+    nvproc_t		*nvproc;
+    int			i, inst, added = 0;
 
+    for (i = 0; i < c->procs[mode].count; i++) {
 	/* handle the per-process instance domain first */
-	update_process(infos[i].pid, mode, cardid, &infos[i], &stats);
-
-	if (name == NULL)
-	    continue;
+	added |= update_process(infos[i].pid, mode, c->cardid, &infos[i], &stats[i]);
 
 	/* build instance name (device + PID) */
-	pmsprintf(pname, sizeof(pname), "gpu%u::%u", cardid, infos[i].pid);
+	pmsprintf(pname, sizeof(pname), "gpu%u::%u", c->cardid, infos[i].pid);
 
 	/* lookup struct for this instance, create new one if none */
 	if (pmdaCacheLookupName(gpuproc_indom, pname, &inst, (void **)&nvproc) < 0) {
 	    if ((nvproc = (nvproc_t *)calloc(1, sizeof(*nvproc))) == NULL)
 		continue;	/* out-of-memory */
 	    nvproc->pid = infos[i].pid;
-	    nvproc->cardid = cardid;
+	    nvproc->cardid = c->cardid;
 	}
 	nvproc->memused = infos[i].usedGpuMemory;
 	nvproc->memaccum += infos[i].usedGpuMemory;
-	memcpy(&nvproc->acct, &stats, sizeof(stats));
+	memcpy(&nvproc->acct, &stats[i], sizeof(stats[i]));
 	nvproc->samples++;
 
 	pmdaCacheStore(gpuproc_indom, PMDA_CACHE_ADD, pname, nvproc);
     }
+    return added;
 }
 
+/*
+ * Drop processes no longer using any card, returning the number culled.
+ * Processes are otherwise updated in place, so the instance domain only
+ * needs rebuilding when a process has come or gone.
+ */
 static int
-refresh_proc(nvmlDevice_t device, pmInDom gpuproc_indom,
-		const char *name, unsigned int cardid, nvinfo_t *nvinfo)
+cull_processes(void)
 {
-    static nvmlProcessInfo_t *infos, *tmp;
-    static int		ninfos;		/* local high-water mark */
-    unsigned int	count, total = 0;
-
-    if ((nvinfo->flags & HASCOMPUTE)) {
-	/* extract size of compute process list for this device */
-	count = 0;
-	localNvmlDeviceGetComputeRunningProcesses(device, &count, NULL);
-	if (count > ninfos) {
-	    if ((tmp = realloc(infos, count * sizeof(*infos))) == NULL)
-		return total;	/* out-of-memory */
-	    infos = tmp;
-	    ninfos = count;
-	}
-	/* extract actual list of processes using compute on this device now */
-	if (count > 0) {
-	    count = ninfos;
-	    localNvmlDeviceGetComputeRunningProcesses(device, &count, infos);
-	    if (count > 0) {
-		update_processes(device, gpuproc_indom, name, cardid,
-				 count, infos, nvinfo, PROCESS_COMPUTE);
-		total += count;
-	    }
-	}
-    }
+    __pmHashNode	*node, *next;
+    process_t		*proc;
+    int			i, culled = 0;
 
-    if ((nvinfo->flags & HASGRAPHICS)) {
-	/* extract size of graphics process list for this device */
-	count = 0;
-	localNvmlDeviceGetGraphicsRunningProcesses(device, &count, NULL);
-	if (count > ninfos) {
-	    if ((tmp = realloc(infos, count * sizeof(*infos))) == NULL)
-		return total;	/* out-of-memory */
-	    infos = tmp;
-	    ninfos = count;
-	}
-	/* extract actual list of processes using graphics on this device now */
-	if (count > 0) {
-	    count = ninfos;
-	    localNvmlDeviceGetGraphicsRunningProcesses(device, &count, infos);
-	    if (count > 0) {
-		update_processes(device, gpuproc_indom, name, cardid,
-				 count, infos, nvinfo, PROCESS_GRAPHICS);
-		total += count;
-	    }
+    for (i = 0; i < processes.hsize; i++) {
+	for (node = processes.hash[i]; node != NULL; node = next) {
+	    next = node->next;
+	    proc = (process_t *)node->data;
+	    if (proc->refreshed == refreshes)
+		continue;
+	    __pmHashDel(node->key, proc, &processes);
+	    free(proc->name);
+	    free(proc);
+	    culled++;
 	}
     }
-
-    return total;
+    return culled;
 }
 
 static int
@@ -486,27 +734,98 @@ pid_compare(const void *a, const void *b)
     return 0;
 }
 
+static void
+update_proc_indom(void)
+{
+    pmdaIndom		*proc_indomp = &indomtab[PROC_INDOM];
+    pmdaInstid		*it_set = NULL;
+    __pmHashNode	*node;
+    process_t		*proc;
+    size_t		bytes = processes.nodes * sizeof(pmdaInstid);
+    int			i, j;
+
+    if (bytes > 0) {
+	it_set = (pmdaInstid *)realloc(proc_indomp->it_set, bytes);
+	if (it_set == NULL)
+	    free(proc_indomp->it_set);
+    } else if (proc_indomp->it_set != NULL) {
+	free(proc_indomp->it_set);
+    }
+
+    if ((proc_indomp->it_set = it_set) != NULL) {
+	for (i = j = 0; i < processes.hsize && j < processes.nodes; i++) {
+	    for (node = processes.hash[i]; node; node = node->next) {
+		proc = (process_t *)node->data;
+		proc_indomp->it_set[j].i_inst = node->key;
+		proc_indomp->it_set[j].i_name = proc->name;
+		if (++j >= processes.nodes)
+		    break;
+	    }
+	}
+	qsort(proc_indomp->it_set, j, sizeof(pmdaInstid), pid_compare);
+	proc_indomp->it_numinst = j;
+    } else {
+	proc_indomp->it_numinst = 0;
+    }
+}
+
+/*
+ * Merge the latest readings from one card into the values exported
+ * to clients - called with the PMDA lock held.
+ */
+static int
+update_card(nvinfo_t *info, nvcollect_t *c, pmInDom gpuproc_indom)
+{
+    int			j, changed = 0;
+
+    info->cardid = c->cardid;
+    if (c->status) {
+	pmNotifyErr(LOG_ERR, "nvmlDeviceGetHandleByIndex: %s",
+			localNvmlErrStr(c->status));
+	for (j = 0; j < NVIDIA_METRIC_COUNT; j++)
+	    info->failed[j] = 1;
+	return 0;
+    }
+    for (j = 0; j < NVIDIA_METRIC_COUNT; j++)
+	info->failed[j] = c->failed[j];
+
+    if (info->name == NULL &&
+	info->failed[NVIDIA_CARDNAME] == 0)
+	info->name = strdup(c->name);
+    if (info->uuid == NULL &&
+	info->failed[NVIDIA_CARDUUID] == 0)
+	info->uuid = strdup(c->uuid);
+    if (info->busid == NULL &&
+	info->failed[NVIDIA_BUSID] == 0)
+	info->busid = strdup(c->pci.busId);
+    info->temperature = c->temperature;
+    info->fanspeed = c->fanspeed;
+    info->perfstate = c->pstate;
+    info->active = c->utilization;	/* struct copy */
+    info->memutilaccum += c->utilization.memory;
+    info->gpuutilaccum += c->utilization.gpu;
+    info->memory = c->memory; 		/* struct copy */
+    info->memaccum += c->memory.used;
+    info->energy = c->energy;
+    info->power = c->power;
+    info->nprocs = 0;
+    info->samples++;
+
+    if (c->need_processes) {
+	changed |= update_processes(gpuproc_indom, c, PROCESS_COMPUTE);
+	changed |= update_processes(gpuproc_indom, c, PROCESS_GRAPHICS);
+	info->nprocs = c->procs[PROCESS_COMPUTE].count +
+			c->procs[PROCESS_GRAPHICS].count;
+    }
+    return changed;
+}
+
 static int
 refresh(pcp_nvinfo_t *nvinfo, int need_processes)
 {
     unsigned int	device_count;
-    nvmlDevice_t	device;
-    process_t		*proc;
-    __pmHashNode	*node;
     pmInDom		gpuproc_indom = indomtab[GPROC_INDOM].it_indom;
-    char		name[NVML_DEVICE_NAME_BUFFER_SIZE];
-    char		uuid[NVML_DEVICE_UUID_BUFFER_SIZE];
-    nvmlPciInfo_t	pci;
-    unsigned int	nproc = 0;
-    unsigned int	power = 0;
-    unsigned long long	energy = 0;
-    unsigned int	fanspeed = 0;
-    unsigned int	temperature = 0;
-    nvmlUtilization_t	utilization;
-    nvmlMemory_t	memory = {0};
-    nvmlPstates_t	pstate = 0;
-    nvinfo_t		*info;
-    int			i, j, sts;
+    int			i, sts, changed = 0;
 
     if (!nvmlDSO_loaded) {
 	sts = nvmlDSO_status;
@@ -518,133 +837,43 @@ refresh(pcp_nvinfo_t *nvinfo, int need_processes)
 		pmNotifyErr(LOG_ERR, "nvmlInit: %s", localNvmlErrStr(sts));
 	    return 0;
 	}
+	pthread_mutex_lock(&nvidia_mutex);
 	setup_gcard_indom();
+	pthread_mutex_unlock(&nvidia_mutex);
 	nvmlDSO_loaded = 1;
     }
 
-    /* mark caches inactive, later iterate over active processes */
-    if (need_processes) {
-	/* gpu+proc indom */
-	pmdaCacheOp(gpuproc_indom, PMDA_CACHE_INACTIVE);
-	/* proc indom */
-	for (i = 0; i < processes.hsize; i++) {
-	    for (node = processes.hash[i]; node != NULL; node = node->next) {
-		proc = (process_t *)node->data;
-		proc->acct[PROCESS_COMPUTE].ngpus = 0;
-		proc->acct[PROCESS_GRAPHICS].ngpus = 0;
-		proc->acct[PROCESS_COMPUTE].running = 0;
-		proc->acct[PROCESS_GRAPHICS].running = 0;
-		proc->acct[PROCESS_COMPUTE].gpulist = 0;
-		proc->acct[PROCESS_GRAPHICS].gpulist = 0;
-		proc->flags &= ~(COMPUTE|GRAPHICS|ACCOUNT);
-	    }
-	}
-    }
-
     if ((sts = localNvmlDeviceGetCount(&device_count)) != 0) {
 	pmNotifyErr(LOG_ERR, "nvmlDeviceGetCount: %s",
 			localNvmlErrStr(sts));
 	return sts;
     }
-    nvinfo->numcards = device_count;
+    if (device_count > nvinfo->maxcards)
+	device_count = nvinfo->maxcards;
 
-    for (i = 0; i < device_count && i < nvinfo->maxcards; i++) {
-	info = &nvinfo->nvinfo[i];
-	info->cardid = i;
-	if ((sts = localNvmlDeviceGetHandleByIndex(i, &device))) {
-	    pmNotifyErr(LOG_ERR, "nvmlDeviceGetHandleByIndex: %s",
-			localNvmlErrStr(sts));
-	    for (j = 0; j < NVIDIA_METRIC_COUNT; j++)
-		info->failed[j] = 1;
-	    continue;
-	}
-	for (j = 0; j < NVIDIA_METRIC_COUNT; j++)
-	    info->failed[j] = 0;
-	if ((sts = localNvmlDeviceGetName(device, name, sizeof(name))))
-	    info->failed[NVIDIA_CARDNAME] = 1;
-	if ((sts = localNvmlDeviceGetUUID(device, uuid, sizeof(uuid))))
-	    info->failed[NVIDIA_CARDUUID] = 1;
-	if ((sts = localNvmlDeviceGetPciInfo(device, &pci)))
-	    info->failed[NVIDIA_BUSID] = 1;
-	if ((sts = localNvmlDeviceGetFanSpeed(device, &fanspeed)))
-	    info->failed[NVIDIA_FANSPEED] = 1;
-	if ((sts = localNvmlDeviceGetTemperature(device, NVML_TEMPERATURE_GPU, &temperature)))
-	    info->failed[NVIDIA_TEMPERATURE] = 1;
-	if ((sts = localNvmlDeviceGetUtilizationRates(device, &utilization))) {
-	    info->failed[NVIDIA_GPUACTIVE] = 1;
-	    info->failed[NVIDIA_MEMACTIVE] = 1;
-	}
-	if ((sts = localNvmlDeviceGetMemoryInfo(device, &memory))) {
-	    info->failed[NVIDIA_MEMUSED] = 1;
-	    info->failed[NVIDIA_MEMTOTAL] = 1;
-	    info->failed[NVIDIA_MEMFREE] = 1;
-	}
-	if ((sts = localNvmlDeviceGetPerformanceState(device, &pstate)))
-	    info->failed[NVIDIA_PERFSTATE] = 1;
-	if ((sts = localNvmlDeviceGetTotalEnergyConsumption(device, &energy)))
-	    info->failed[NVIDIA_ENERGY] = 1;
-	if ((sts = localNvmlDeviceGetPowerUsage(device, &power)))
-	    info->failed[NVIDIA_POWER] = 1;
-
-	if (info->name == NULL &&
-	    info->failed[NVIDIA_CARDNAME] == 0)
-	    info->name = strdup(name);
-	if (info->uuid == NULL &&
-	    info->failed[NVIDIA_CARDUUID] == 0)
-	    info->uuid = strdup(uuid);
-	if (info->busid == NULL &&
-	    info->failed[NVIDIA_BUSID] == 0)
-	    info->busid = strdup(pci.busId);
-	info->temperature = temperature;
-	info->fanspeed = fanspeed;
-	info->perfstate = pstate;
-	info->active = utilization;	/* struct copy */
-	info->memutilaccum += utilization.memory;
-	info->gpuutilaccum += utilization.gpu;
-	info->memory = memory; 		/* struct copy */
-	info->memaccum += memory.used;
-	info->energy = energy;
-	info->power = power;
-	info->nprocs = 0;
-	info->samples++;
-
-	if (need_processes) {
-	    info->nprocs = refresh_proc(device, gpuproc_indom, name, i, info);
-	    nproc += info->nprocs;
-	}
+    /* query all cards, without blocking fetch requests meanwhile */
+    collect_cards(nvinfo, device_count, need_processes);
+
+    pthread_mutex_lock(&nvidia_mutex);
+    nvinfo->numcards = device_count;
+    if (need_processes) {
+	/* mark caches inactive, later iterate over active processes */
+	pmdaCacheOp(gpuproc_indom, PMDA_CACHE_INACTIVE);
+	refreshes++;
     }
+    for (i = 0; i < device_count; i++)
+	changed |= update_card(&nvinfo->nvinfo[i], &nvinfo->collect[i],
+				gpuproc_indom);
 
     /* update indoms, cull old entries that remain inactive */
     if (need_processes) {
-	pmdaIndom	*proc_indomp = &indomtab[PROC_INDOM];
-	pmdaInstid	*it_set = NULL;
-	size_t		bytes = nproc * sizeof(pmdaInstid);
-
-	if (bytes > 0) {
-	    it_set = (pmdaInstid *)realloc(proc_indomp->it_set, bytes);
-	    if (it_set == NULL)
-		free(proc_indomp->it_set);
-	} else if (proc_indomp->it_set != NULL) {
-	    free(proc_indomp->it_set);
-	}
-
-	if ((proc_indomp->it_set = it_set) != NULL) {
-	    for (i = j = 0; i < processes.hsize && j < nproc; i++) {
-		for (node = processes.hash[i]; node; node = node->next) {
-		    proc = (process_t *)node->data;
-		    proc_indomp->it_set[j].i_inst = node->key;
-		    proc_indomp->it_set[j].i_name = proc->name;
-		    if (++j >= nproc)
-			break;
-		}
-	    }
-	    qsort(proc_indomp->it_set, j, sizeof(pmdaInstid), pid_compare);
-	    proc_indomp->it_numinst = j;
-	} else {
-	    proc_indomp->it_numinst = 0;
-	}
+	if (cull_processes() > 0)
+	    changed = 1;
+	if (changed)
+	    update_proc_indom();
     }
     pmdaCachePurge(gpuproc_indom, 120);
+    pthread_mutex_unlock(&nvidia_mutex);
 
     return 0;
 }
@@ -653,31 +882,41 @@ static int
 nvidia_instance(pmInDom indom, int inst, char *name, pmInResult **result, pmdaExt *pmda)
 {
     unsigned int	serial = pmInDom_serial(indom);
+    int			sts;
 
-    if (serial == GPROC_INDOM || serial == PROC_INDOM)
+    if (!autorefresh && (serial == GPROC_INDOM || serial == PROC_INDOM))
 	refresh(&pcp_nvinfo, 1);
-    return pmdaInstance(indom, inst, name, result, pmda);
+    pthread_mutex_lock(&nvidia_mutex);
+    sts = pmdaInstance(indom, inst, name, result, pmda);
+    pthread_mutex_unlock(&nvidia_mutex);
+    return sts;
 }
 
 /*
  * Wrapper for pmdaFetch which refresh the set of values once per fetch
- * PDU.  The fetchCallback is then called once per-metric/instance pair
- * to perform the actual filling of the pmResult (via each pmAtomValue).
+ * PDU (unless a background thread is refreshing values already).  The
+ * fetchCallback is then called once per-metric/instance pair to perform
+ * the actual filling of the pmResult (via each pmAtomValue).
  */
 static int
 nvidia_fetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
 {
-    int		i, item, cluster, need_processes = 0;
-
-    for (i = 0; i < numpmid; i++) {
-	item = pmID_item(pmidlist[i]);
-	cluster = pmID_cluster(pmidlist[i]);
-	if ((cluster == 0 && item == NVIDIA_NPROCS) ||
-	    (cluster == 1 || cluster == 2 || cluster == 3 || cluster == 4))
-	    need_processes = 1;
+    int		i, sts, item, cluster, need_processes = 0;
+
+    if (!autorefresh) {
+	for (i = 0; i < numpmid; i++) {
+	    item = pmID_item(pmidlist[i]);
+	    cluster = pmID_cluster(pmidlist[i]);
+	    if ((cluster == 0 && item == NVIDIA_NPROCS) ||
+		(cluster == 1 || cluster == 2 || cluster == 3 || cluster == 4))
+		need_processes = 1;
+	}
+	refresh(&pcp_nvinfo, need_processes);
     }
-    refresh(&pcp_nvinfo, need_processes);
-    return pmdaFetch(numpmid, pmidlist, resp, pmda);
+    pthread_mutex_lock(&nvidia_mutex);
+    sts = pmdaFetch(numpmid, pmidlist, resp, pmda);
+    pthread_mutex_unlock(&nvidia_mutex);
+    return sts;
 }
 
 static int
@@ -999,7 +1238,10 @@ nvidia_label(int ident, int type, pmLabelSet **lpp, pmdaExt *pmda)
     default:
 	break;
     }
-    return pmdaLabel(ident, type, lpp, pmda);
+    pthread_mutex_lock(&nvidia_mutex);
+    sts = pmdaLabel(ident, type, lpp, pmda);
+    pthread_mutex_unlock(&nvidia_mutex);
+    return sts;
 }
 
 /**
@@ -1049,66 +1291,49 @@ nvidia_init(pmdaInterface *dp)
 	     metrictab, sizeof(metrictab)/sizeof(metrictab[0]));
 }
 
-static void
-nvidia_timer(int sig, void *ptr)
+/*
+ * Background refresh of all values on a fixed interval, so that fetch
+ * requests are answered from the most recent values without waiting on
+ * NVML, and accumulating metrics observe changes between client samples.
+ */
+static void *
+nvidia_refresh_thread(void *arg)
 {
-    (void)sig; (void)ptr;
-    autorefresh = 1;
+    struct timespec	next, now;
+    long long		step, nsec;
+
+    (void)arg;
+    step = (long long)interval.tv_sec * 1000000000LL + interval.tv_usec * 1000LL;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (;;) {
+	refresh(&pcp_nvinfo, 1);
+
+	nsec = next.tv_nsec + step;
+	next.tv_sec += nsec / 1000000000LL;
+	next.tv_nsec = nsec % 1000000000LL;
+	/* refresh overran the interval, start again from now */
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (now.tv_sec > next.tv_sec ||
+	    (now.tv_sec == next.tv_sec && now.tv_nsec > next.tv_nsec))
+	    next = now;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR)
+	    ;
+    }
+    return NULL;
 }
 
 static void
 nvidia_main(pmdaInterface *dispatch)
 {
-    fd_set		readyfds, fds;
-    int			nready, pmcdfd, maxfd = 0;
-
-    if ((pmcdfd = __pmdaInFd(dispatch)) < 0)
-	exit(1);
-    if (pmcdfd > maxfd)
-	maxfd = pmcdfd;
-
-    FD_ZERO(&fds);
-    FD_SET(pmcdfd, &fds);
+    pthread_t		thread;
+    int			sts;
 
-    /* arm interval timer */
-    if (autorefresh == 1 &&
-	__pmAFregister(&interval, NULL, nvidia_timer) < 0) {
-	pmNotifyErr(LOG_ERR, "registering event interval handler");
+    if (autorefresh &&
+	(sts = pthread_create(&thread, NULL, nvidia_refresh_thread, NULL)) != 0) {
+	pmNotifyErr(LOG_ERR, "creating refresh thread: %s", strerror(sts));
 	exit(1);
     }
-
-    for (;;) {
-	memcpy(&readyfds, &fds, sizeof(readyfds));
-	nready = select(maxfd+1, &readyfds, NULL, NULL, NULL);
-	if (pmDebugOptions.appl2)
-	    pmNotifyErr(LOG_DEBUG, "select: nready=%d autorefresh=%d",
-			nready, autorefresh);
-	if (nready < 0) {
-	    if (neterror() != EINTR) {
-		pmNotifyErr(LOG_ERR, "select failure: %s", netstrerror());
-		exit(1);
-	    } else if (autorefresh == 0) {
-		continue;
-	    }
-	}
-
-	__pmAFblock();
-	if (nready > 0 && FD_ISSET(pmcdfd, &readyfds)) {
-	    if (pmDebugOptions.appl0)
-		pmNotifyErr(LOG_DEBUG, "processing pmcd PDU [fd=%d]", pmcdfd);
-	    if (__pmdaMainPDU(dispatch) < 0) {
-		__pmAFunblock();
-		exit(1);        /* fatal if we lose pmcd */
-	    }
-	    if (pmDebugOptions.appl0)
-		pmNotifyErr(LOG_DEBUG, "completed pmcd PDU [fd=%d]", pmcdfd);
-	}
-	if (autorefresh > 0) {
-	    autorefresh = 0;
-	    refresh(&pcp_nvinfo, 1);
-	}
-        __pmAFunblock();
-    }
+    pmdaMain(dispatch);
 }
 
 static pmLongOptions longopts[] = {
@@ -1148,8 +1373,12 @@ main(int argc, char **argv)
 			    pmGetProgname(), endnum);
 		    free(endnum);
 		    opts.errors++;
+		} else if (interval.tv_sec == 0 && interval.tv_usec == 0) {
+		    fprintf(stderr, "%s: -t requires a non-zero interval\n",
+			    pmGetProgname());
+		    opts.errors++;
 		}
-		autorefresh = 1;	/* enable timers, non-default */
+		autorefresh = 1;	/* enable refresh thread, non-default */
 		break;
 	    default:
 		opts.errors++;
@@ -0,0 +1,197 @@
+/*
+ * Persistent name tables for the OpenMetrics PMDA
+ *
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include "pmapi.h"
+#include "libpcp.h"
+#include "pmda.h"
+#include "openmetrics.h"
+
+/* 32-bit FNV-1a */
+unsigned int
+om_hash(const char *name)
+{
+    unsigned int	h = 2166136261U;
+
+    while (*name) {
+	h ^= (unsigned char)*name++;
+	h *= 16777619U;
+    }
+    return h;
+}
+
+void
+om_names_init(om_names *np, unsigned int serial)
+{
+    memset(np, 0, sizeof(*np));
+    np->serial = serial;
+    __pmHashInit(&np->hash);
+}
+
+void
+om_names_free(om_names *np)
+{
+    int		i;
+
+    for (i = 0; i < np->count; i++)
+	free(np->names[i]);
+    free(np->names);
+    __pmHashFree(&np->hash);
+    np->names = NULL;
+    np->count = np->size = 0;
+}
+
+int
+om_names_lookup(om_names *np, const char *name)
+{
+    __pmHashNode	*hp;
+    unsigned int	key = om_hash(name);
+
+    for (hp = __pmHashSearch(key, &np->hash); hp; hp = hp->next) {
+	if (hp->key == key && strcmp(np->names[(long)hp->data], name) == 0)
+	    return (int)(long)hp->data;
+    }
+    return -1;
+}
+
+/*
+ * Append a new name, returning its number, or -E2BIG once the table
+ * has reached its limit (the caller checks the name is not present).
+ */
+int
+om_names_add(om_names *np, const char *name, int limit)
+{
+    char	**names;
+    char	*copy;
+    int		num = np->count;
+
+    if (num > limit)
+	return -E2BIG;
+    if (num == np->size) {
+	np->size = np->size ? np->size * 2 : 16;
+	if ((names = realloc(np->names, np->size * sizeof(char *))) == NULL)
+	    return -ENOMEM;
+	np->names = names;
+    }
+    if ((copy = strdup(name)) == NULL)
+	return -ENOMEM;
+    if (__pmHashAdd(om_hash(name), (void *)(long)num, &np->hash) < 0) {
+	free(copy);
+	return -ENOMEM;
+    }
+    np->names[num] = copy;
+    np->count++;
+    np->dirty = 1;
+    return num;
+}
+
+/* instance name as presented to PMAPI clients */
+int
+om_names_external(om_names *np, int num, char *buf, size_t buflen)
+{
+    if (num < 0 || num >= np->count)
+	return PM_ERR_INST;
+    if (np->prefix)
+	pmsprintf(buf, buflen, "%d %s", num, np->names[num]);
+    else
+	pmsprintf(buf, buflen, "%s", np->names[num]);
+    return 0;
+}
+
+static void
+names_path(om_names *np, char *path, size_t pathlen)
+{
+    int		sep = pmPathSeparator();
+
+    pmsprintf(path, pathlen, "%s%c" "config" "%c" "pmda" "%c" "%d.%u.om",
+		pmGetConfig("PCP_VAR_DIR"), sep, sep, sep, om_domain, np->serial);
+}
+
+/*
+ * On-disk format is a "prefix N" header line, followed by one name per
+ * line in number order, with backslash and newline characters escaped.
+ */
+void
+om_names_load(om_names *np)
+{
+    FILE	*fp;
+    char	path[MAXPATHLEN];
+    char	line[BUFSIZ];
+    char	*p, *q;
+    int		prefix;
+
+    names_path(np, path, sizeof(path));
+    if ((fp = fopen(path, "r")) == NULL)
+	return;
+    if (fgets(line, sizeof(line), fp) == NULL ||
+	sscanf(line, "prefix %d", &prefix) != 1) {
+	pmNotifyErr(LOG_WARNING, "%s: bad header, ignored", path);
+	fclose(fp);
+	return;
+    }
+    np->prefix = prefix;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+	for (p = q = line; *p && *p != '\n'; p++) {
+	    if (*p == '\\' && p[1] == 'n') {
+		*q++ = '\n';
+		p++;
+	    } else if (*p == '\\' && p[1] == '\\') {
+		*q++ = '\\';
+		p++;
+	    } else {
+		*q++ = *p;
+	    }
+	}
+	*q = '\0';
+	if (om_names_add(np, line, INT_MAX-1) < 0)
+	    break;
+    }
+    fclose(fp);
+    np->dirty = 0;
+    if (om_verbose)
+	pmNotifyErr(LOG_DEBUG, "loaded %s%s, %d names",
+			path, np->prefix ? " (pfx)" : "", np->count);
+}
+
+void
+om_names_save(om_names *np)
+{
+    FILE	*fp;
+    char	path[MAXPATHLEN];
+    char	*p;
+    int		i;
+
+    if (!np->dirty)
+	return;
+    names_path(np, path, sizeof(path));
+    if ((fp = fopen(path, "w")) == NULL) {
+	pmNotifyErr(LOG_ERR, "cannot save %s: %s", path, osstrerror());
+	return;
+    }
+    fprintf(fp, "prefix %d\n", np->prefix);
+    for (i = 0; i < np->count; i++) {
+	for (p = np->names[i]; *p; p++) {
+	    if (*p == '\n')
+		fputs("\\n", fp);
+	    else if (*p == '\\')
+		fputs("\\\\", fp);
+	    else
+		fputc(*p, fp);
+	}
+	fputc('\n', fp);
+    }
+    if (fclose(fp) == 0)
+	np->dirty = 0;	/* reset only on success */
+}
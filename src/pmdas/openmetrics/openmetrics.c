@@ -0,0 +1,727 @@
+/*
+ * OpenMetrics PMDA
+ *
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/*
+ * Each .url file or executable script below the config directory is a
+ * source, and becomes a PMNS subtree and PMID cluster of its own.  The
+ * sources are scraped in the background every interval by a pool of
+ * worker threads (scrape.c), so that requests from pmcd are answered
+ * from the most recently completed scrape without waiting for the
+ * end-points.  All callbacks below run with om_lock held.
+ */
+
+#include <ftw.h>
+#include <sys/stat.h>
+#include "pmapi.h"
+#include "libpcp.h"
+#include "pmda.h"
+#include "domain.h"
+#include "openmetrics.h"
+
+pthread_mutex_t		om_lock;
+om_source		**om_sources;
+om_names		om_clusters;
+pmdaIndom		*om_indomtab;
+int			om_nindoms;
+char			*om_root = "openmetrics";
+int			om_domain = OPENMETRICS;
+int			om_verbose;
+int			om_timeout = 2;
+int			om_notify;
+
+static char		*config_dir;
+static int		nosort;
+static int		interval = 10;
+static int		nworkers = 16;
+static int		pmns_stale = 1;
+static pmdaNameSpace	*pmns;
+
+static struct {
+    const char		*name;
+    pmDesc		desc;
+    const char		*oneline;
+} controls[NUM_CONTROLS] = {
+    [CONTROL_CALLS] = { "calls",
+	{ 0, PM_TYPE_U64, 0, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
+	"per-end-point source call counter" },
+    [CONTROL_FETCH_TIME] = { "fetch_time",
+	{ 0, PM_TYPE_U64, 0, PM_SEM_COUNTER, PMDA_PMUNITS(0,1,0,0,PM_TIME_MSEC,0) },
+	"per-end-point source fetch time counter, excluding parse time" },
+    [CONTROL_PARSE_TIME] = { "parse_time",
+	{ 0, PM_TYPE_U64, 0, PM_SEM_COUNTER, PMDA_PMUNITS(0,1,0,0,PM_TIME_MSEC,0) },
+	"per-end-point source parse time counter, excluding fetch time" },
+    [CONTROL_DEBUG] = { "debug",
+	{ 0, PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,0,0,0,0,0) },
+	"debug flag to enable verbose log messages" },
+    [CONTROL_STATUS] = { "status",
+	{ 0, PM_TYPE_STRING, 0, PM_SEM_INSTANT, PMDA_PMUNITS(0,0,0,0,0,0) },
+	"per-end-point source URL response status after the most recent fetch" },
+    [CONTROL_STATUS_CODE] = { "status_code",
+	{ 0, PM_TYPE_32, 0, PM_SEM_DISCRETE, PMDA_PMUNITS(0,0,0,0,0,0) },
+	"per-end-point source URL response status code after the most recent fetch" },
+};
+
+/* new metrics or instances - called with om_lock held */
+void
+om_changed(void)
+{
+    om_notify = 1;
+    pmns_stale = 1;
+}
+
+/* register an instance domain, returning its om_indomtab index */
+int
+om_add_indom(pmInDom indom)
+{
+    pmdaIndom	*indomtab;
+    int		i;
+
+    for (i = 0; i < om_nindoms; i++)
+	if (om_indomtab[i].it_indom == indom)
+	    return i;
+    if ((indomtab = realloc(om_indomtab, (om_nindoms + 1) * sizeof(pmdaIndom))) == NULL)
+	return -ENOMEM;
+    om_indomtab = indomtab;
+    indomtab += om_nindoms;
+    indomtab->it_indom = indom;
+    indomtab->it_numinst = 0;
+    indomtab->it_set = NULL;
+    return om_nindoms++;
+}
+
+static void
+sources_indom(void)
+{
+    pmdaIndom	*idp = &om_indomtab[0];
+    pmdaInstid	*set;
+    int		i, n = 0;
+
+    if ((set = realloc(idp->it_set, om_clusters.count * sizeof(pmdaInstid))) == NULL)
+	return;
+    for (i = 0; i < om_clusters.count; i++) {
+	if (i > 0 && om_sources[i] == NULL)
+	    continue;
+	set[n].i_inst = i;
+	set[n].i_name = om_clusters.names[i];
+	n++;
+    }
+    idp->it_set = set;
+    idp->it_numinst = n;
+}
+
+static void
+openmetrics_prepare(pmdaExt *pmda)
+{
+    pmda->e_indoms = om_indomtab;
+    pmda->e_nindoms = om_nindoms;
+    if (om_notify) {
+	pmdaExtSetFlags(pmda, PMDA_EXT_NAMES_CHANGE);
+	om_notify = 0;
+    }
+}
+
+static om_metric *
+lookup_metric(pmID pmid)
+{
+    om_source	*sp;
+    unsigned int cluster = pmID_cluster(pmid);
+    unsigned int item = pmID_item(pmid);
+
+    if (cluster == 0 || cluster >= om_clusters.count)
+	return NULL;
+    if ((sp = om_sources[cluster]) == NULL || item >= sp->msize)
+	return NULL;
+    return sp->metrics[item];
+}
+
+static void
+rebuild_pmns(void)
+{
+    char	name[BUFSIZ];
+    om_metric	*mp;
+    om_source	*sp;
+    int		c, i, count = 0;
+
+    if (pmns)
+	pmdaTreeRelease(pmns);
+    if ((i = pmdaTreeCreate(&pmns)) < 0) {
+	pmNotifyErr(LOG_ERR, "failed to create new pmns: %s", pmErrStr(i));
+	pmns = NULL;
+	return;
+    }
+    for (i = 1; i < NUM_CONTROLS; i++) {
+	pmsprintf(name, sizeof(name), "%s.control.%s", om_root, controls[i].name);
+	pmdaTreeInsert(pmns, pmID_build(om_domain, 0, i), name);
+	count++;
+    }
+    for (c = 1; c < om_clusters.count; c++) {
+	if ((sp = om_sources[c]) == NULL)
+	    continue;
+	for (i = 0; i < sp->msize; i++) {
+	    if ((mp = sp->metrics[i]) == NULL)
+		continue;
+	    pmdaTreeInsert(pmns, mp->desc.pmid, mp->pmns);
+	    count++;
+	}
+    }
+    pmdaTreeRebuildHash(pmns, count);
+    pmns_stale = 0;
+}
+
+static int
+openmetrics_desc_locked(pmID pmid, pmDesc *desc)
+{
+    om_metric	*mp;
+    unsigned int item = pmID_item(pmid);
+
+    if (pmID_cluster(pmid) == 0) {
+	if (item == 0 || item >= NUM_CONTROLS)
+	    return PM_ERR_PMID;
+	*desc = controls[item].desc;
+	desc->pmid = pmid;
+	if (desc->indom != PM_INDOM_NULL)
+	    desc->indom = om_indomtab[0].it_indom;
+	return 0;
+    }
+    if ((mp = lookup_metric(pmid)) == NULL)
+	return PM_ERR_PMID;
+    *desc = mp->desc;
+    return 0;
+}
+
+static int
+openmetrics_desc(pmID pmid, pmDesc *desc, pmdaExt *pmda)
+{
+    int		sts;
+
+    pthread_mutex_lock(&om_lock);
+    sts = openmetrics_desc_locked(pmid, desc);
+    pthread_mutex_unlock(&om_lock);
+    return sts;
+}
+
+static int
+control_fetch(unsigned int item, unsigned int inst, pmAtomValue *atom)
+{
+    om_source	*sp = NULL;
+
+    if (item == CONTROL_DEBUG) {
+	atom->ul = om_verbose;
+	return PMDA_FETCH_STATIC;
+    }
+    if (inst >= om_clusters.count)
+	return PM_ERR_INST;
+    if (inst > 0 && (sp = om_sources[inst]) == NULL)
+	return PM_ERR_INST;
+
+    switch (item) {
+    case CONTROL_CALLS:
+	atom->ull = sp ? sp->calls : 0;
+	break;
+    case CONTROL_FETCH_TIME:
+	atom->ull = sp ? sp->fetch_time : 0;
+	break;
+    case CONTROL_PARSE_TIME:
+	atom->ull = sp ? sp->parse_time : 0;
+	break;
+    case CONTROL_STATUS:
+	atom->cp = (sp && sp->status) ? sp->status : (sp ? "unknown" : "none");
+	break;
+    case CONTROL_STATUS_CODE:
+	atom->l = sp ? sp->status_code : 0;
+	break;
+    default:
+	return PM_ERR_PMID;
+    }
+    return PMDA_FETCH_STATIC;
+}
+
+static int
+openmetrics_fetchCallBack(pmdaMetric *mdesc, unsigned int inst, pmAtomValue *atom)
+{
+    om_metric	*mp;
+    om_values	*vp;
+    unsigned int idx;
+
+    if (pmID_cluster(mdesc->m_desc.pmid) == 0)
+	return control_fetch(pmID_item(mdesc->m_desc.pmid), inst, atom);
+
+    if ((mp = lookup_metric(mdesc->m_desc.pmid)) == NULL)
+	return PM_ERR_PMID;
+    vp = &mp->values[mp->source->front];
+    if (vp->count == 0)
+	return PM_ERR_AGAIN;
+    idx = (inst == PM_IN_NULL) ? 0 : inst;
+    if (idx >= vp->size || vp->stamp[idx] != vp->generation)
+	return (inst == PM_IN_NULL) ? PM_ERR_AGAIN : PMDA_FETCH_NOVALUES;
+    *atom = vp->atoms[idx];
+    return PMDA_FETCH_STATIC;
+}
+
+static int
+openmetrics_fetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
+{
+    int		sts;
+
+    pthread_mutex_lock(&om_lock);
+    openmetrics_prepare(pmda);
+    sts = pmdaFetch(numpmid, pmidlist, resp, pmda);
+    pthread_mutex_unlock(&om_lock);
+    return sts;
+}
+
+static int
+openmetrics_instance(pmInDom indom, int inst, char *name, pmInResult **result, pmdaExt *pmda)
+{
+    int		sts;
+
+    pthread_mutex_lock(&om_lock);
+    openmetrics_prepare(pmda);
+    sts = pmdaInstance(indom, inst, name, result, pmda);
+    pthread_mutex_unlock(&om_lock);
+    return sts;
+}
+
+static int
+openmetrics_text(int ident, int type, char **buffer, pmdaExt *pmda)
+{
+    om_metric	*mp;
+    static char	*text;
+
+    if ((type & PM_TEXT_PMID) == 0)
+	return PM_ERR_TEXT;
+
+    pthread_mutex_lock(&om_lock);
+    if (text) {
+	free(text);
+	text = NULL;
+    }
+    if (pmID_cluster(ident) == 0) {
+	unsigned int	item = pmID_item(ident);
+
+	if (item > 0 && item < NUM_CONTROLS)
+	    text = strdup(controls[item].oneline);
+    }
+    else if ((mp = lookup_metric(ident)) != NULL) {
+	if ((type & PM_TEXT_HELP) && mp->helptext)
+	    text = strdup(mp->helptext);
+	else if (mp->oneline)
+	    text = strdup(mp->oneline);
+    }
+    pthread_mutex_unlock(&om_lock);
+
+    if ((*buffer = text) == NULL)
+	return PM_ERR_TEXT;
+    return 0;
+}
+
+static int
+openmetrics_label(int ident, int type, pmLabelSet **lpp, pmdaExt *pmda)
+{
+    char	buf[BUFSIZ], json[BUFSIZ];
+    om_source	*sp;
+    unsigned int cluster;
+    int		i, sts;
+
+    pthread_mutex_lock(&om_lock);
+    openmetrics_prepare(pmda);
+    if (type == PM_LABEL_CLUSTER) {
+	cluster = pmID_cluster(ident);
+	if (cluster > 0 && cluster < om_clusters.count &&
+	    (sp = om_sources[cluster]) != NULL) {
+	    if (sp->scripted) {
+		om_json_escape(json, sizeof(json), sp->path);
+		pmsprintf(buf, sizeof(buf), "{\"script\":%s,\"source\":\"%s\"}",
+			    json, sp->name);
+		__pmAddLabels(lpp, buf, 0);
+	    }
+	    else if (sp->url) {
+		om_json_escape(json, sizeof(json), sp->url);
+		pmsprintf(buf, sizeof(buf),
+			    "{\"hostname\":\"%s\",\"source\":\"%s\",\"url\":%s}",
+			    sp->hostname, sp->name, json);
+		__pmAddLabels(lpp, buf, 0);
+	    }
+	}
+    }
+    else if (type == PM_LABEL_INDOM && ident != om_indomtab[0].it_indom) {
+	cluster = (pmInDom_serial(ident) - INDOM_BASE) / (MAX_METRIC+1);
+	for (i = 1; i < om_nindoms; i++) {
+	    if (om_indomtab[i].it_indom != ident)
+		continue;
+	    if (cluster < om_clusters.count && om_sources[cluster]) {
+		pmsprintf(buf, sizeof(buf), "{\"source\":\"%s\"}",
+			    om_sources[cluster]->name);
+		__pmAddLabels(lpp, buf, 0);
+	    }
+	    break;
+	}
+    }
+    sts = pmdaLabel(ident, type, lpp, pmda);
+    pthread_mutex_unlock(&om_lock);
+    return sts;
+}
+
+static int
+openmetrics_labelCallBack(pmInDom indom, unsigned int inst, pmLabelSet **lp)
+{
+    om_metric	*mp;
+    unsigned int serial = pmInDom_serial(indom);
+    unsigned int cluster, item;
+    int		sts, count = 0;
+
+    if (serial < INDOM_BASE)
+	return 0;
+    cluster = (serial - INDOM_BASE) / (MAX_METRIC+1);
+    item = (serial - INDOM_BASE) % (MAX_METRIC+1);
+    if ((mp = lookup_metric(pmID_build(om_domain, cluster, item))) == NULL ||
+	mp->indom < 0 || inst >= mp->insts.count)
+	return 0;
+    /* callback returns the number of labels in the merged set */
+    if (mp->instlabels[inst] && strcmp(mp->instlabels[inst], "{}") != 0 &&
+	(sts = __pmAddLabels(lp, mp->instlabels[inst], 0)) > 0)
+	count = sts;
+    if (mp->instnotes[inst] && strcmp(mp->instnotes[inst], "{}") != 0 &&
+	(sts = __pmAddLabels(lp, mp->instnotes[inst], PM_LABEL_OPTIONAL)) > 0)
+	count = sts;
+    return count;
+}
+
+static int
+openmetrics_store(pmResult *result, pmdaExt *pmda)
+{
+    pmValueSet	*vsp;
+    pmAtomValue	atom;
+    int		i, sts;
+
+    for (i = 0; i < result->numpmid; i++) {
+	vsp = result->vset[i];
+	if (pmID_cluster(vsp->pmid) != 0 ||
+	    pmID_item(vsp->pmid) != CONTROL_DEBUG)
+	    return PM_ERR_PERMISSION;
+	if (vsp->numval != 1)
+	    return PM_ERR_BADSTORE;
+	if ((sts = pmExtractValue(vsp->valfmt, &vsp->vlist[0],
+				PM_TYPE_32, &atom, PM_TYPE_32)) < 0)
+	    return sts;
+	if (atom.l < 0)
+	    return PM_ERR_BADSTORE;
+	om_verbose = (atom.l != 0);
+	pmNotifyErr(LOG_INFO, "%s.control.debug: set to %d", om_root, om_verbose);
+    }
+    return 0;
+}
+
+static int
+openmetrics_pmid(const char *name, pmID *pmid, pmdaExt *pmda)
+{
+    int		sts;
+
+    pthread_mutex_lock(&om_lock);
+    if (pmns_stale)
+	rebuild_pmns();
+    sts = pmdaTreePMID(pmns, name, pmid);
+    pthread_mutex_unlock(&om_lock);
+    return sts;
+}
+
+static int
+openmetrics_name(pmID pmid, char ***nameset, pmdaExt *pmda)
+{
+    int		sts;
+
+    pthread_mutex_lock(&om_lock);
+    if (pmns_stale)
+	rebuild_pmns();
+    sts = pmdaTreeName(pmns, pmid, nameset);
+    pthread_mutex_unlock(&om_lock);
+    return sts;
+}
+
+static int
+openmetrics_children(const char *name, int traverse, char ***kids, int **sts, pmdaExt *pmda)
+{
+    int		count;
+
+    pthread_mutex_lock(&om_lock);
+    if (pmns_stale)
+	rebuild_pmns();
+    count = pmdaTreeChildren(pmns, name, traverse, kids, sts);
+    pthread_mutex_unlock(&om_lock);
+    return count;
+}
+
+/*
+ * Config directory scanning - every .url file or executable script is
+ * a source, named by its path relative to the config directory (with
+ * the suffix removed and '/' mapped to '.').
+ */
+typedef struct {
+    char	*name;
+    char	*path;
+    int		scripted;
+} om_entry;
+
+static om_entry		*entries;
+static int		nentries;
+static regex_t		nickname;
+
+static int
+scan_entry(const char *path, const struct stat *sbuf, int flag, struct FTW *ftw)
+{
+    om_entry	*ep;
+    const char	*base = path + ftw->base;
+    char	*name, *p;
+    int		scripted;
+
+    if (flag != FTW_F || base[0] == '.')
+	return 0;
+    scripted = (sbuf->st_mode & S_IXUSR) != 0;
+    p = strrchr(base, '.');
+    if (!scripted && (p == NULL || strcmp(p, ".url") != 0)) {
+	if (om_verbose)
+	    pmNotifyErr(LOG_DEBUG, "ignored config file '%s', doesn't end in "
+			"'.url' and not executable", path);
+	return 0;
+    }
+    if ((name = strdup(path + strlen(config_dir) + 1)) == NULL)
+	return 0;
+    if ((p = strrchr(name + (base - path) - strlen(config_dir) - 1, '.')) != NULL)
+	*p = '\0';
+    for (p = name; *p; p++)
+	if (*p == '/')
+	    *p = '.';
+    if (strcmp(name, "control") == 0) {
+	pmNotifyErr(LOG_WARNING, "ignored config file '%s', '%s.control' is a "
+		    "reserved PMNS subtree for PMDA statistics", path, om_root);
+	free(name);
+	return 0;
+    }
+    if (regexec(&nickname, name, 0, NULL, 0) != 0) {
+	pmNotifyErr(LOG_WARNING, "ignored config file '%s', unsuitable for "
+		    "PCP namespace", path);
+	free(name);
+	return 0;
+    }
+    if ((ep = realloc(entries, (nentries + 1) * sizeof(om_entry))) == NULL) {
+	free(name);
+	return 0;
+    }
+    entries = ep;
+    ep += nentries++;
+    ep->name = name;
+    ep->path = strdup(path);
+    ep->scripted = scripted;
+    return 0;
+}
+
+static int
+compare_entries(const void *a, const void *b)
+{
+    return strcmp(((const om_entry *)a)->path, ((const om_entry *)b)->path);
+}
+
+static void
+rescan(void)
+{
+    om_source	*sp;
+    int		i, cluster, added = 0;
+
+    nentries = 0;
+    if (nftw(config_dir, scan_entry, 16, FTW_PHYS) < 0 && om_verbose)
+	pmNotifyErr(LOG_DEBUG, "cannot scan %s: %s", config_dir, osstrerror());
+    if (!nosort)	/* sorted for cluster number consistency */
+	qsort(entries, nentries, sizeof(om_entry), compare_entries);
+
+    pthread_mutex_lock(&om_lock);
+    for (i = 0; i < nentries; i++) {
+	if ((cluster = om_names_lookup(&om_clusters, entries[i].name)) > 0 &&
+	    om_sources[cluster] != NULL)
+	    goto next;
+	if (cluster < 0 &&
+	    (cluster = om_names_add(&om_clusters, entries[i].name, MAX_CLUSTER)) < 0) {
+	    pmNotifyErr(LOG_ERR, "too many sources, %s ignored", entries[i].path);
+	    goto next;
+	}
+	if ((sp = calloc(1, sizeof(om_source))) == NULL)
+	    goto next;
+	sp->name = entries[i].name;
+	sp->path = entries[i].path;
+	sp->scripted = entries[i].scripted;
+	sp->cluster = cluster;
+	om_names_init(&sp->items, cluster);
+	om_names_load(&sp->items);
+	om_names_init(&sp->excluded, 0);
+	om_sources[cluster] = sp;
+	pmNotifyErr(LOG_INFO, "Found source %s cluster %d", sp->name, cluster);
+	added++;
+	continue;
+next:
+	free(entries[i].name);
+	free(entries[i].path);
+    }
+    if (added) {
+	om_names_save(&om_clusters);
+	sources_indom();
+	om_changed();
+    }
+    pthread_mutex_unlock(&om_lock);
+}
+
+static void *
+scheduler(void *arg)
+{
+    (void)arg;
+    for (;;) {
+	sleep(interval);
+	rescan();
+	om_refresh(om_timeout);
+    }
+    return NULL;
+}
+
+static void
+openmetrics_init(pmdaInterface *dp)
+{
+    pthread_mutexattr_t	attr;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&om_lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    regcomp(&nickname, "^[A-Za-z][A-Za-z0-9_.]*$", REG_EXTENDED|REG_NOSUB);
+
+    if ((om_sources = calloc(MAX_CLUSTER + 1, sizeof(om_source *))) == NULL) {
+	pmNotifyErr(LOG_ERR, "out of memory");
+	exit(1);
+    }
+    om_names_init(&om_clusters, 0);
+    om_names_load(&om_clusters);
+    if (om_clusters.count == 0)
+	om_names_add(&om_clusters, "control", 0);
+    om_add_indom(pmInDom_build(om_domain, 0));
+    sources_indom();
+
+    dp->version.seven.fetch = openmetrics_fetch;
+    dp->version.seven.desc = openmetrics_desc;
+    dp->version.seven.instance = openmetrics_instance;
+    dp->version.seven.text = openmetrics_text;
+    dp->version.seven.store = openmetrics_store;
+    dp->version.seven.pmid = openmetrics_pmid;
+    dp->version.seven.name = openmetrics_name;
+    dp->version.seven.children = openmetrics_children;
+    dp->version.seven.label = openmetrics_label;
+    pmdaSetFetchCallBack(dp, openmetrics_fetchCallBack);
+    pmdaSetLabelCallBack(dp, openmetrics_labelCallBack);
+    pmdaInit(dp, om_indomtab, om_nindoms, NULL, 0);
+}
+
+pmLongOptions	longopts[] = {
+    PMDA_OPTIONS_HEADER("Options"),
+    { "config", 1, 'c', "DIR", "configuration directory" },
+    PMOPT_DEBUG,
+    PMDAOPT_DOMAIN,
+    { "refresh", 1, 'R', "SECS", "interval between scrapes of all sources [default 10]" },
+    PMDAOPT_LOGFILE,
+    { "nosort", 0, 'n', 0, "do not sort config files when assigning cluster numbers" },
+    { "root", 1, 'r', "NAME", "dynamic PMNS root name [default openmetrics]" },
+    { "timeout", 1, 't', "SECS", "HTTP GET timeout for each end-point URL [default 2]" },
+    PMDAOPT_USERNAME,
+    { "workers", 1, 'w', "N", "number of concurrent scraping threads [default 16]" },
+    PMOPT_HELP,
+    PMDA_OPTIONS_END
+};
+
+pmdaOptions	opts = {
+    .short_options = "c:D:d:l:nr:R:t:U:w:?",
+    .long_options = longopts,
+};
+
+int
+main(int argc, char **argv)
+{
+    int			c, sep = pmPathSeparator();
+    pmdaInterface	dispatch;
+    pthread_t		tid;
+    char		path[MAXPATHLEN];
+
+    pmSetProgname(argv[0]);
+    pmdaDaemon(&dispatch, PMDA_INTERFACE_7, pmGetProgname(), OPENMETRICS,
+		"openmetrics.log", NULL);
+
+    while ((c = pmdaGetOptions(argc, argv, &opts, &dispatch)) != EOF) {
+	switch (c) {
+	case 'c':
+	    config_dir = opts.optarg;
+	    break;
+	case 'R':
+	    interval = atoi(opts.optarg);
+	    if (interval <= 0)
+		opts.errors++;
+	    break;
+	case 'n':
+	    nosort = 1;
+	    break;
+	case 'r':
+	    om_root = opts.optarg;
+	    break;
+	case 't':
+	    om_timeout = atoi(opts.optarg);
+	    if (om_timeout <= 0)
+		opts.errors++;
+	    break;
+	case 'w':
+	    nworkers = atoi(opts.optarg);
+	    if (nworkers <= 0)
+		opts.errors++;
+	    break;
+	}
+    }
+
+    if (opts.errors) {
+	pmdaUsageMessage(&opts);
+	exit(1);
+    }
+    if (config_dir == NULL || config_dir[0] != sep) {
+	pmsprintf(path, sizeof(path), "%s%c" "openmetrics" "%c" "%s",
+		    pmGetConfig("PCP_PMDAS_DIR"), sep, sep,
+		    config_dir ? config_dir : "config.d");
+	config_dir = path;
+    }
+    om_domain = dispatch.domain;
+    om_verbose = pmDebugOptions.appl0;
+
+    pmdaOpenLog(&dispatch);
+    if (opts.username)	/* default is the current user */
+	pmSetProcessIdentity(opts.username);
+
+    openmetrics_init(&dispatch);
+    pmdaConnect(&dispatch);
+
+    /* initial scrape populates the namespace before declaring readiness */
+    om_scraper_start(nworkers);
+    rescan();
+    om_refresh(om_timeout * 10);
+    pmdaSendError(&dispatch, PM_ERR_PMDAREADY);
+
+    if ((c = pthread_create(&tid, NULL, scheduler, NULL)) != 0) {
+	pmNotifyErr(LOG_ERR, "cannot create scheduler thread: %s", strerror(c));
+	exit(1);
+    }
+    pmdaMain(&dispatch);
+    exit(0);
+}
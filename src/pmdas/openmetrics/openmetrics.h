@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+#ifndef OPENMETRICS_H
+#define OPENMETRICS_H
+
+#include <regex.h>
+#include <pthread.h>
+
+#define MAX_CLUSTER	0xfff	/* 12 bit cluster field, 0 is "control" */
+#define MAX_METRIC	0x3ff	/* items per source, also in indom serials */
+#define INDOM_BASE	(MAX_CLUSTER+1)
+
+enum {
+    CONTROL_CALLS = 1,
+    CONTROL_FETCH_TIME,
+    CONTROL_PARSE_TIME,
+    CONTROL_DEBUG,
+    CONTROL_STATUS,
+    CONTROL_STATUS_CODE,
+    NUM_CONTROLS
+};
+
+enum { FILTER_INCLUDE, FILTER_EXCLUDE, FILTER_OPTIONAL };
+enum { FILTER_METRIC, FILTER_LABEL };
+
+/*
+ * Persistent name <-> number mapping, for source clusters, metric items
+ * within a source and instances within a metric.  Numbers are handed out
+ * densely from zero and saved below $PCP_VAR_DIR/config/pmda so they are
+ * stable across PMDA restarts.
+ */
+typedef struct om_names {
+    unsigned int	serial;		/* persistence file suffix */
+    int			prefix;		/* external names are "N name" */
+    int			dirty;		/* new names since the last save */
+    int			count;
+    int			size;
+    char		**names;
+    __pmHashCtl		hash;		/* keyed on om_hash(name) */
+} om_names;
+
+typedef struct om_filter {
+    int			action;		/* FILTER_INCLUDE, etc */
+    int			type;		/* FILTER_METRIC or FILTER_LABEL */
+    regex_t		regex;
+} om_filter;
+
+typedef struct om_meta {
+    regex_t		regex;
+    char		*spec;		/* "type indom semantics units" */
+} om_meta;
+
+/*
+ * Values from one scrape, indexed by instance (0 for singular metrics).
+ * An entry is current when its stamp matches the buffer generation, so
+ * a buffer is emptied by bumping the generation.
+ */
+typedef struct om_values {
+    unsigned int	generation;
+    int			count;		/* current values */
+    int			size;
+    unsigned int	*stamp;
+    pmAtomValue		*atoms;		/* strings are malloc'd */
+} om_values;
+
+struct om_source;
+
+typedef struct om_metric {
+    struct om_source	*source;
+    unsigned int	item;
+    char		*name;		/* name in the exposition */
+    char		*pmns;		/* full PMNS name */
+    pmDesc		desc;
+    char		*oneline;
+    char		*helptext;
+    int			indom;		/* om_indomtab index, or -1 if singular */
+    om_names		insts;		/* instance names, unless singular */
+    char		**instlabels;	/* per-instance labels (JSONB) */
+    char		**instnotes;	/* per-instance optional labels */
+    int			isize;		/* allocated instance table entries */
+    om_values		values[2];	/* front and back buffers */
+} om_metric;
+
+typedef struct om_label {
+    char		*name;
+    char		*value;
+} om_label;
+
+typedef struct om_sample {
+    char		*name;
+    char		*value;
+    char		*pcp;		/* "PCP ..." or "PCP5 ..." block metadata */
+    char		*help;
+    char		*type;
+    int			label;		/* first entry in om_doc.labels */
+    int			nlabels;
+    om_metric		*metric;	/* resolved under the PMDA lock */
+    int			inst;
+} om_sample;
+
+typedef struct om_doc {			/* one tokenized exposition */
+    char		*buffer;
+    size_t		length;
+    size_t		size;
+    om_sample		*samples;
+    int			nsamples;
+    int			ssize;
+    om_label		*labels;
+    int			nlabels;
+    int			lsize;
+    int			errors;		/* unparseable lines */
+} om_doc;
+
+typedef struct om_source {
+    char		*name;
+    unsigned int	cluster;
+    char		*path;		/* .url file or executable script */
+    int			scripted;
+    int			busy;		/* queued for, or being scraped */
+    time_t		config_time;	/* ctime of last parsed .url file */
+    char		*url;
+    char		*hostname;	/* from the URL, for cluster labels */
+    char		*headers;	/* HEADER: lines, CRLF terminated */
+    om_filter		*filters;
+    int			nfilters;
+    om_meta		*metadata;
+    int			nmetadata;
+    om_names		items;		/* metric name -> item */
+    om_names		excluded;	/* metric names rejected by filters */
+    om_metric		**metrics;	/* indexed by item */
+    int			msize;
+    int			front;		/* values[] read by fetch */
+    unsigned int	generation;	/* bumped every scrape */
+    om_doc		doc;		/* scraping worker scratch space */
+    /* statistics, reported via the control cluster */
+    __uint64_t		calls;
+    __uint64_t		fetch_time;	/* msec */
+    __uint64_t		parse_time;	/* msec */
+    char		*status;
+    int			status_code;
+} om_source;
+
+/* openmetrics.c */
+extern pthread_mutex_t	om_lock;
+extern om_source	**om_sources;	/* indexed by cluster */
+extern om_names		om_clusters;
+extern pmdaIndom	*om_indomtab;	/* [0] is the sources indom */
+extern int		om_nindoms;
+extern char		*om_root;
+extern int		om_domain;
+extern int		om_verbose;
+extern int		om_timeout;
+extern int		om_notify;
+extern void om_changed(void);
+extern int om_add_indom(pmInDom);
+
+/* names.c */
+extern unsigned int om_hash(const char *);
+extern void om_names_init(om_names *, unsigned int);
+extern void om_names_free(om_names *);
+extern int om_names_lookup(om_names *, const char *);
+extern int om_names_add(om_names *, const char *, int);
+extern int om_names_external(om_names *, int, char *, size_t);
+extern void om_names_load(om_names *);
+extern void om_names_save(om_names *);
+
+/* parse.c */
+extern int om_tokenize(om_doc *);
+extern void om_doc_free(om_doc *);
+extern int om_json_escape(char *, size_t, const char *);
+
+/* scrape.c */
+extern int om_parse_config(om_source *);
+extern void om_refresh(int);
+extern void om_scraper_start(int);
+
+#endif /* OPENMETRICS_H */
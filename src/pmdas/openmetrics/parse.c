@@ -0,0 +1,303 @@
+/*
+ * OpenMetrics / Prometheus exposition format tokenizer
+ *
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/*
+ * The document is tokenized in place: names, label values and metric
+ * values are terminated within the buffer and referenced by pointer,
+ * so there is no per-sample allocation once the sample and label arrays
+ * have grown to fit a source.  No locks are held while this runs.
+ */
+
+#include <ctype.h>
+#include "pmapi.h"
+#include "libpcp.h"
+#include "pmda.h"
+#include "openmetrics.h"
+
+#define isblank_(c)	((c) == ' ' || (c) == '\t' || (c) == '\r')
+
+static char *
+skip_blanks(char *p, char *end)
+{
+    while (p < end && isblank_(*p))
+	p++;
+    return p;
+}
+
+static om_sample *
+new_sample(om_doc *dp)
+{
+    om_sample	*sp;
+    int		size;
+
+    if (dp->nsamples == dp->ssize) {
+	size = dp->ssize ? dp->ssize * 2 : 256;
+	if ((sp = realloc(dp->samples, size * sizeof(om_sample))) == NULL)
+	    return NULL;
+	dp->samples = sp;
+	dp->ssize = size;
+    }
+    sp = &dp->samples[dp->nsamples];
+    memset(sp, 0, sizeof(*sp));
+    sp->label = dp->nlabels;
+    return sp;
+}
+
+static om_label *
+new_label(om_doc *dp)
+{
+    om_label	*lp;
+    int		size;
+
+    if (dp->nlabels == dp->lsize) {
+	size = dp->lsize ? dp->lsize * 2 : 512;
+	if ((lp = realloc(dp->labels, size * sizeof(om_label))) == NULL)
+	    return NULL;
+	dp->labels = lp;
+	dp->lsize = size;
+    }
+    return &dp->labels[dp->nlabels++];
+}
+
+/*
+ * Label values are unescaped in place: \\, \n and \" are the escapes
+ * defined by the exposition format, anything else is kept verbatim.
+ * Returns a pointer past the closing quote, or NULL.
+ */
+static char *
+label_value(char *p, char *end, char **valuep)
+{
+    char	*q = p;
+
+    *valuep = p;
+    while (p < end && *p != '"') {
+	if (*p == '\\' && p + 1 < end) {
+	    p++;
+	    if (*p == 'n')
+		*q++ = '\n';
+	    else if (*p == '\\' || *p == '"')
+		*q++ = *p;
+	    else {
+		*q++ = '\\';
+		*q++ = *p;
+	    }
+	    p++;
+	}
+	else
+	    *q++ = *p++;
+    }
+    if (p == end)
+	return NULL;
+    *q = '\0';
+    return p + 1;
+}
+
+/*
+ * Parse one "name[{labels}] value [timestamp]" line ending at end.
+ */
+static int
+sample_line(om_doc *dp, char *p, char *end, char *pcp, char *help, char *type)
+{
+    om_sample	*sp;
+    om_label	*lp;
+    char	*name, *value;
+    int		first = dp->nlabels;
+
+    name = p;
+    while (p < end && *p != '{' && !isblank_(*p))
+	p++;
+    if (p == name || p == end)
+	goto fail;
+    if (*p != '{') {
+	*p++ = '\0';
+	p = skip_blanks(p, end);
+    }
+    if (p < end && *p == '{') {
+	*p++ = '\0';
+	for (;;) {
+	    p = skip_blanks(p, end);
+	    if (p == end)
+		goto fail;
+	    if (*p == '}') {
+		p++;
+		break;
+	    }
+	    if ((lp = new_label(dp)) == NULL)
+		goto fail;
+	    lp->name = p;
+	    while (p < end && *p != '=' && !isblank_(*p))
+		p++;
+	    if (p == lp->name)
+		goto fail;
+	    value = p;
+	    p = skip_blanks(p, end);
+	    if (p == end || *p != '=')
+		goto fail;
+	    *value = '\0';
+	    p = skip_blanks(p + 1, end);
+	    if (p == end || *p != '"')
+		goto fail;
+	    if ((p = label_value(p + 1, end, &lp->value)) == NULL)
+		goto fail;
+	    p = skip_blanks(p, end);
+	    if (p < end && *p == ',')
+		p++;
+	    else if (p == end || *p != '}')
+		goto fail;
+	}
+	p = skip_blanks(p, end);
+    }
+    value = p;
+    while (p < end && !isblank_(*p))
+	p++;
+    if (p == value)
+	goto fail;
+    *p = '\0';		/* any timestamp following is ignored */
+
+    if ((sp = new_sample(dp)) == NULL)
+	goto fail;
+    sp->name = name;
+    sp->value = value;
+    sp->pcp = pcp;
+    sp->help = help;
+    sp->type = type;
+    sp->label = first;
+    sp->nlabels = dp->nlabels - first;
+    dp->nsamples++;
+    return 0;
+
+fail:
+    dp->nlabels = first;
+    dp->errors++;
+    return -EINVAL;
+}
+
+/*
+ * Returns a pointer to the text following "keyword name " in a comment
+ * line, or NULL if the comment is not of that form.
+ */
+static char *
+comment_text(char *p, char *end, const char *keyword)
+{
+    size_t	length = strlen(keyword);
+
+    if (end - p <= length || strncmp(p, keyword, length) != 0 ||
+	!isblank_(p[length]))
+	return NULL;
+    p = skip_blanks(p + length, end);
+    while (p < end && !isblank_(*p))
+	p++;
+    if (p < end)
+	*p++ = '\0';
+    return skip_blanks(p, end);
+}
+
+/*
+ * Tokenize dp->buffer (dp->length bytes, NUL terminated by the caller)
+ * into dp->samples, attaching the most recent "# PCP", "# PCP5", "# HELP"
+ * and "# TYPE" metadata of the enclosing block to each sample.  Metadata
+ * is reset by the first comment following a run of samples.
+ */
+int
+om_tokenize(om_doc *dp)
+{
+    char	*p = dp->buffer, *end = dp->buffer + dp->length;
+    char	*eol, *text;
+    char	*pcp = NULL, *help = NULL, *type = NULL;
+    int		in_samples = 0;
+
+    dp->nsamples = dp->nlabels = dp->errors = 0;
+
+    for (; p < end; p = eol + 1) {
+	if ((eol = memchr(p, '\n', end - p)) == NULL)
+	    eol = end;
+	*eol = '\0';
+	p = skip_blanks(p, eol);
+	while (eol > p && isblank_(eol[-1]))
+	    *--eol = '\0';
+	if (p == eol)
+	    continue;
+
+	if (*p != '#') {
+	    in_samples = 1;
+	    sample_line(dp, p, eol, pcp, help, type);
+	    continue;
+	}
+
+	if (in_samples) {
+	    in_samples = 0;
+	    pcp = help = type = NULL;
+	}
+	p = skip_blanks(p + 1, eol);
+	if ((strncmp(p, "PCP5", 4) == 0 && isblank_(p[4])) ||
+	    (strncmp(p, "PCP", 3) == 0 && isblank_(p[3])))
+	    pcp = p;	/* split into fields when a metric is created */
+	else if ((text = comment_text(p, eol, "HELP")) != NULL)
+	    help = text;
+	else if ((text = comment_text(p, eol, "TYPE")) != NULL)
+	    type = text;
+    }
+
+    return dp->nsamples;
+}
+
+void
+om_doc_free(om_doc *dp)
+{
+    free(dp->buffer);
+    free(dp->samples);
+    free(dp->labels);
+    memset(dp, 0, sizeof(*dp));
+}
+
+/* quote a string for use as a JSONB label value */
+int
+om_json_escape(char *buf, size_t buflen, const char *s)
+{
+    size_t	n = 0;
+
+    if (buflen < 3)
+	return -E2BIG;
+    buf[n++] = '"';
+    for (; *s; s++) {
+	if (n + 4 >= buflen)
+	    return -E2BIG;
+	switch (*s) {
+	case '"':
+	case '\\':
+	    buf[n++] = '\\';
+	    buf[n++] = *s;
+	    break;
+	case '\n':
+	    buf[n++] = '\\';
+	    buf[n++] = 'n';
+	    break;
+	case '\t':
+	    buf[n++] = '\\';
+	    buf[n++] = 't';
+	    break;
+	default:
+	    if ((unsigned char)*s < ' ')
+		buf[n++] = ' ';
+	    else
+		buf[n++] = *s;
+	    break;
+	}
+    }
+    buf[n++] = '"';
+    buf[n] = '\0';
+    return n;
+}
@@ -0,0 +1,1154 @@
+/*
+ * Concurrent end-point scraping for the OpenMetrics PMDA
+ *
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/*
+ * A pool of worker threads, each with its own HTTP client (and so its
+ * own persistent connections), takes sources from a queue.  For each
+ * one the worker fetches and tokenizes the document, resolves samples
+ * to metrics and instances, and converts values into that source's back
+ * buffers - all without the PMDA lock, since the worker is the only
+ * writer of a source's tables.  The lock is taken only to publish new
+ * metrics or instances, and to swap the front and back buffers at the
+ * end, so fetch requests from pmcd are never blocked on the network.
+ */
+
+#include <ctype.h>
+#include <stdarg.h>
+#include "pmapi.h"
+#include "libpcp.h"
+#include "pmda.h"
+#include "pmhttp.h"
+#include <sys/stat.h>
+#include "openmetrics.h"
+
+#define DOC_INITIAL	(64 * 1024)
+#define DOC_MAXIMUM	(256 * 1024 * 1024)
+#define MAX_LABELS	128		/* naming labels used per instance */
+#define NAMELEN		8192		/* instance names and label sets */
+
+typedef struct http_client http_client;
+
+static pthread_mutex_t	queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	queue_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t	done_cond = PTHREAD_COND_INITIALIZER;
+static int		*queue;		/* clusters waiting for a worker */
+static int		qhead, qcount, qsize;
+static int		pending;	/* queued plus in progress */
+static int		scrape_timeout;	/* seconds, for the current round */
+
+static void
+free_config(om_source *sp)
+{
+    int		i;
+
+    for (i = 0; i < sp->nfilters; i++)
+	regfree(&sp->filters[i].regex);
+    for (i = 0; i < sp->nmetadata; i++) {
+	regfree(&sp->metadata[i].regex);
+	free(sp->metadata[i].spec);
+    }
+    free(sp->filters);
+    free(sp->metadata);
+    free(sp->url);
+    free(sp->hostname);
+    free(sp->headers);
+    sp->filters = NULL;
+    sp->metadata = NULL;
+    sp->nfilters = sp->nmetadata = 0;
+    sp->url = sp->hostname = sp->headers = NULL;
+}
+
+/* Python-style re.match() semantics: anchored at the start only */
+static int
+compile_regex(regex_t *rp, const char *pattern)
+{
+    char	buf[BUFSIZ];
+
+    pmsprintf(buf, sizeof(buf), "^(%s)", pattern);
+    return regcomp(rp, buf, REG_EXTENDED|REG_NOSUB);
+}
+
+static char *
+url_hostname(const char *url)
+{
+    char	host[MAXHOSTNAMELEN];
+    const char	*p;
+    size_t	length;
+
+    if (strncmp(url, "http://", 7) == 0 || strncmp(url, "https://", 8) == 0) {
+	p = strstr(url, "//") + 2;
+	length = strcspn(p, "/");
+	if (length >= sizeof(host))
+	    length = sizeof(host) - 1;
+	memcpy(host, p, length);
+	host[length] = '\0';
+	if (strcmp(host, "localhost") != 0)
+	    return strdup(host);
+    }
+    gethostname(host, sizeof(host));
+    host[sizeof(host)-1] = '\0';
+    return strdup(host);
+}
+
+static void
+append_header(om_source *sp, char *line)
+{
+    char	*key, *value, *p, *q;
+    size_t	length;
+
+    /* "HEADER: key: value", with white space in the key removed */
+    key = line + sizeof("HEADER:") - 1;
+    if ((value = strchr(key, ':')) == NULL) {
+	pmNotifyErr(LOG_WARNING, "%s: ignored bad HEADER \"%s\"", sp->path, line);
+	return;
+    }
+    *value++ = '\0';
+    for (p = q = key; *p; p++)
+	if (!isspace((unsigned char)*p))
+	    *q++ = *p;
+    *q = '\0';
+    while (isspace((unsigned char)*value))
+	value++;
+
+    length = (sp->headers ? strlen(sp->headers) : 0) + strlen(key) + strlen(value) + 5;
+    if ((p = realloc(sp->headers, length)) == NULL)
+	return;
+    if (sp->headers == NULL)
+	*p = '\0';
+    sp->headers = p;
+    strcat(p, key);
+    strcat(p, ": ");
+    strcat(p, value);
+    strcat(p, "\r\n");
+}
+
+static void
+append_filter(om_source *sp, char *line)
+{
+    om_filter	*fp;
+    char	*action, *type, *regex;
+
+    line += sizeof("FILTER:") - 1;
+    action = strtok(line, " \t");
+    type = strtok(NULL, " \t");
+    regex = strtok(NULL, "");
+    if (action == NULL || type == NULL || regex == NULL)
+	goto bad;
+    while (isspace((unsigned char)*regex))
+	regex++;
+    if ((fp = realloc(sp->filters, (sp->nfilters + 1) * sizeof(*fp))) == NULL)
+	return;
+    sp->filters = fp;
+    fp += sp->nfilters;
+    if (strcmp(action, "INCLUDE") == 0)
+	fp->action = FILTER_INCLUDE;
+    else if (strcmp(action, "EXCLUDE") == 0)
+	fp->action = FILTER_EXCLUDE;
+    else if (strcmp(action, "OPTIONAL") == 0)
+	fp->action = FILTER_OPTIONAL;
+    else
+	goto bad;
+    if (strcmp(type, "METRIC") == 0)
+	fp->type = FILTER_METRIC;
+    else if (strcmp(type, "LABEL") == 0)
+	fp->type = FILTER_LABEL;
+    else
+	goto bad;
+    if (compile_regex(&fp->regex, regex) != 0)
+	goto bad;
+    sp->nfilters++;
+    return;
+
+bad:
+    pmNotifyErr(LOG_WARNING, "%s: ignored bad FILTER entry", sp->path);
+}
+
+static void
+append_metadata(om_source *sp, char *line)
+{
+    om_meta	*mp;
+    char	*regex, *spec;
+
+    line += sizeof("METADATA:") - 1;
+    if ((regex = strtok(line, " \t")) == NULL ||
+	(spec = strtok(NULL, "")) == NULL) {
+	pmNotifyErr(LOG_WARNING, "%s: ignored bad METADATA entry", sp->path);
+	return;
+    }
+    if ((mp = realloc(sp->metadata, (sp->nmetadata + 1) * sizeof(*mp))) == NULL)
+	return;
+    sp->metadata = mp;
+    mp += sp->nmetadata;
+    if (compile_regex(&mp->regex, regex) != 0 || (mp->spec = strdup(spec)) == NULL) {
+	pmNotifyErr(LOG_WARNING, "%s: ignored bad METADATA regex \"%s\"", sp->path, regex);
+	return;
+    }
+    sp->nmetadata++;
+}
+
+/*
+ * (Re)read a .url file if it changed since it was last parsed.  The first
+ * line that is not blank or a comment is the URL, followed by optional
+ * HEADER:, FILTER: and METADATA: entries.  The new configuration is
+ * built aside and swapped in under the PMDA lock, as cluster labels are
+ * read from it by pmcd requests.
+ */
+int
+om_parse_config(om_source *sp)
+{
+    struct stat	sbuf;
+    om_source	conf;
+    FILE	*fp;
+    char	line[BUFSIZ];
+    char	*p;
+    size_t	length;
+
+    if (stat(sp->path, &sbuf) < 0)
+	return -oserror();
+    if (sp->scripted)
+	return (sbuf.st_mode & S_IXUSR) ? 0 : -EACCES;
+    if (sp->url != NULL && sbuf.st_ctime <= sp->config_time)
+	return 0;
+    if ((fp = fopen(sp->path, "r")) == NULL)
+	return -oserror();
+
+    memset(&conf, 0, sizeof(conf));
+    conf.path = sp->path;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+	length = strlen(line);
+	while (length > 0 && isspace((unsigned char)line[length-1]))
+	    line[--length] = '\0';
+	for (p = line; isspace((unsigned char)*p); p++)
+	    ;
+	if (*p == '\0' || *p == '#')
+	    continue;
+	if (conf.url == NULL)
+	    conf.url = strdup(p);
+	else if (strncmp(p, "HEADER:", 7) == 0)
+	    append_header(&conf, p);
+	else if (strncmp(p, "FILTER:", 7) == 0)
+	    append_filter(&conf, p);
+	else if (strncmp(p, "METADATA:", 9) == 0)
+	    append_metadata(&conf, p);
+	else
+	    pmNotifyErr(LOG_WARNING, "%s: ignored unrecognised config entry \"%s\"",
+			sp->path, p);
+    }
+    fclose(fp);
+    if (conf.url == NULL) {
+	free_config(&conf);
+	return -EINVAL;
+    }
+    conf.hostname = url_hostname(conf.url);
+
+    pthread_mutex_lock(&om_lock);
+    free_config(sp);
+    sp->url = conf.url;
+    sp->hostname = conf.hostname;
+    sp->headers = conf.headers;
+    sp->filters = conf.filters;
+    sp->nfilters = conf.nfilters;
+    sp->metadata = conf.metadata;
+    sp->nmetadata = conf.nmetadata;
+    sp->config_time = sbuf.st_ctime;
+    pthread_mutex_unlock(&om_lock);
+
+    if (om_verbose)
+	pmNotifyErr(LOG_DEBUG, "%s: url %s, %d filters, %d metadata",
+			sp->path, sp->url, sp->nfilters, sp->nmetadata);
+    return 0;
+}
+
+static int
+check_filter(om_source *sp, const char *name, int type)
+{
+    int		i;
+
+    for (i = 0; i < sp->nfilters; i++) {
+	if (sp->filters[i].type != type)
+	    continue;
+	if (regexec(&sp->filters[i].regex, name, 0, NULL, 0) == 0)
+	    return sp->filters[i].action;
+    }
+    return FILTER_INCLUDE;
+}
+
+/*
+ * Document retrieval - into sp->doc.buffer, NUL terminated.
+ */
+static int
+grow_buffer(om_doc *dp, size_t size)
+{
+    char	*buffer;
+
+    if (size > DOC_MAXIMUM)
+	return -E2BIG;
+    if ((buffer = realloc(dp->buffer, size)) == NULL)
+	return -ENOMEM;
+    dp->buffer = buffer;
+    dp->size = size;
+    return 0;
+}
+
+static int
+read_stream(om_doc *dp, FILE *fp)
+{
+    size_t	bytes;
+    int		sts;
+
+    dp->length = 0;
+    for (;;) {
+	if (dp->size - dp->length < BUFSIZ &&
+	    (sts = grow_buffer(dp, dp->size ? dp->size * 2 : DOC_INITIAL)) < 0)
+	    return sts;
+	bytes = fread(dp->buffer + dp->length, 1, dp->size - dp->length - 1, fp);
+	if (bytes == 0)
+	    break;
+	dp->length += bytes;
+    }
+    if (ferror(fp))
+	return -EIO;
+    dp->buffer[dp->length] = '\0';
+    return 0;
+}
+
+static int
+fetch_file(om_source *sp, const char *path)
+{
+    FILE	*fp;
+    int		sts;
+
+    if ((fp = fopen(path, "r")) == NULL)
+	return -oserror();
+    sts = read_stream(&sp->doc, fp);
+    fclose(fp);
+    return sts;
+}
+
+static int
+fetch_script(om_source *sp)
+{
+    __pmExecCtl_t	*argp = NULL;
+    FILE		*fp;
+    int			sts;
+
+    if ((sts = __pmProcessAddArg(&argp, sp->path)) < 0)
+	return sts;
+    if ((sts = __pmProcessPipe(&argp, "r", PM_EXEC_TOSS_NONE, &fp)) < 0)
+	return sts;
+    sts = read_stream(&sp->doc, fp);
+    if (__pmProcessPipeClose(fp) != 0 && sts == 0)
+	sts = -ECHILD;
+    return sts;
+}
+
+static http_client *
+new_client(void)
+{
+    http_client		*client;
+    struct timeval	timeout = { scrape_timeout, 0 };
+
+    if ((client = pmhttpNewClient()) != NULL) {
+	pmhttpClientSetTimeout(client, &timeout);
+	pmhttpClientSetUserAgent(client, "pmdaopenmetrics", "1.0");
+    }
+    return client;
+}
+
+/*
+ * The client API takes a fixed size buffer; should the document not
+ * fit, grow the buffer and ask again on a new connection (the failed
+ * response has not been consumed).  Sources keep their buffer between
+ * scrapes, so this settles after the first few.
+ */
+static int
+fetch_url(om_source *sp, http_client **clientp, int *status)
+{
+    om_doc		*dp = &sp->doc;
+    struct timeval	timeout = { scrape_timeout, 0 };
+    int			sts;
+
+    if (dp->size == 0 && (sts = grow_buffer(dp, DOC_INITIAL)) < 0)
+	return sts;
+    for (;;) {
+	if (*clientp == NULL && (*clientp = new_client()) == NULL)
+	    return -ENOMEM;
+	pmhttpClientSetTimeout(*clientp, &timeout);
+	pmhttpClientSetHeaders(*clientp, sp->headers);
+	sts = pmhttpClientFetch(*clientp, sp->url, dp->buffer, dp->size - 1, NULL, 0);
+	*status = pmhttpClientGetStatus(*clientp);
+	if (sts != -E2BIG)
+	    break;
+	pmhttpFreeClient(*clientp);
+	*clientp = NULL;
+	if ((sts = grow_buffer(dp, dp->size * 2)) < 0)
+	    return sts;
+    }
+    if (sts < 0)
+	return sts;
+    dp->length = sts;
+    dp->buffer[sts] = '\0';
+    if (*status >= 300)
+	return -EPROTO;
+    return 0;
+}
+
+/*
+ * Metric metadata, from (in order of preference) a config METADATA: entry,
+ * a "# PCP5" or "# PCP" comment, else heuristics based on the name and
+ * "# TYPE" of the metric, as for the original Python implementation.
+ */
+static int
+metadata_type(const char *type)
+{
+    if (strcmp(type, "double") == 0) return PM_TYPE_DOUBLE;
+    if (strcmp(type, "float") == 0) return PM_TYPE_FLOAT;
+    if (strcmp(type, "u64") == 0) return PM_TYPE_U64;
+    if (strcmp(type, "64") == 0) return PM_TYPE_64;
+    if (strcmp(type, "u32") == 0) return PM_TYPE_U32;
+    if (strcmp(type, "32") == 0) return PM_TYPE_32;
+    if (strcmp(type, "string") == 0) return PM_TYPE_STRING;
+    return PM_TYPE_DOUBLE;
+}
+
+static int
+metadata_sem(const char *sem)
+{
+    if (strcmp(sem, "counter") == 0) return PM_SEM_COUNTER;
+    if (strcmp(sem, "discrete") == 0) return PM_SEM_DISCRETE;
+    return PM_SEM_INSTANT;
+}
+
+static void
+metadata_units(om_source *sp, char **fields, int nfields, pmUnits *units)
+{
+    char	buf[BUFSIZ];
+    char	*errmsg;
+    double	multiplier;
+    int		i;
+
+    memset(units, 0, sizeof(*units));
+    if (nfields == 0 || strcmp(fields[0], "none") == 0)
+	return;
+    buf[0] = '\0';
+    for (i = 0; i < nfields; i++) {
+	if (i)
+	    strncat(buf, " ", sizeof(buf) - strlen(buf) - 1);
+	strncat(buf, fields[i], sizeof(buf) - strlen(buf) - 1);
+    }
+    if (pmParseUnitsStr(buf, units, &multiplier, &errmsg) < 0) {
+	pmNotifyErr(LOG_ERR, "%s: bad units \"%s\": %s", sp->name, buf, errmsg);
+	free(errmsg);
+	memset(units, 0, sizeof(*units));
+    }
+}
+
+static int
+split_fields(char *line, char **fields, int maxfields)
+{
+    int		n = 0;
+    char	*p;
+
+    for (p = strtok(line, " \t"); p && n < maxfields; p = strtok(NULL, " \t"))
+	fields[n++] = p;
+    return n;
+}
+
+static int
+name_has(const char *name, const char *piece)
+{
+    size_t	length = strlen(piece);
+    const char	*p;
+
+    for (p = name; (p = strstr(p, piece)) != NULL; p++) {
+	if ((p == name || p[-1] == '_') && (p[length] == '\0' || p[length] == '_'))
+	    return 1;
+    }
+    return 0;
+}
+
+/*
+ * Fill in desc, pmns name and singular flag; returns 1 for a singular
+ * (PM_INDOM_NULL) metric per the metadata, 0 otherwise.
+ */
+static int
+metric_metadata(om_source *sp, om_metric *mp, om_sample *smp, int *has_pcp)
+{
+    char	line[BUFSIZ];
+    char	name[BUFSIZ];
+    char	*fields[64];
+    char	*pcpname = NULL;
+    int		nfields, i, singular = 0;
+
+    mp->desc.type = PM_TYPE_DOUBLE;
+    mp->desc.sem = PM_SEM_INSTANT;
+    memset(&mp->desc.units, 0, sizeof(pmUnits));
+    *has_pcp = 0;
+
+    for (i = 0; i < sp->nmetadata; i++) {
+	if (regexec(&sp->metadata[i].regex, smp->name, 0, NULL, 0) == 0)
+	    break;
+    }
+    if (i < sp->nmetadata) {
+	/* METADATA: regex type indom semantics units */
+	pmstrncpy(line, sizeof(line), sp->metadata[i].spec);
+	nfields = split_fields(line, fields, 64);
+	if (nfields >= 3) {
+	    mp->desc.type = metadata_type(fields[0]);
+	    singular = (strcmp(fields[1], "PM_INDOM_NULL") == 0);
+	    mp->desc.sem = metadata_sem(fields[2]);
+	    metadata_units(sp, fields + 3, nfields - 3, &mp->desc.units);
+	}
+	*has_pcp = 1;
+    }
+    else if (smp->pcp) {
+	pmstrncpy(line, sizeof(line), smp->pcp);
+	nfields = split_fields(line, fields, 64);
+	if (strcmp(fields[0], "PCP5") == 0 && nfields >= 6) {
+	    /* PCP5 name pmid type indom semantics units */
+	    pcpname = fields[1];
+	    mp->desc.type = metadata_type(fields[3]);
+	    singular = (strcmp(fields[4], "PM_INDOM_NULL") == 0);
+	    mp->desc.sem = metadata_sem(fields[5]);
+	    metadata_units(sp, fields + 6, nfields - 6, &mp->desc.units);
+	}
+	else if (strcmp(fields[0], "PCP") == 0 && nfields >= 2) {
+	    /* PCP name semantics units */
+	    pcpname = fields[1];
+	    if (nfields >= 3)
+		mp->desc.sem = metadata_sem(fields[2]);
+	    metadata_units(sp, fields + 3, nfields > 3 ? nfields - 3 : 0, &mp->desc.units);
+	}
+	*has_pcp = 1;
+    }
+    else {
+	const char	*type = smp->type ? smp->type : "";
+	int		histogram = (strcmp(type, "histogram") == 0);
+
+	if (strcmp(type, "counter") == 0 ||
+	    name_has(smp->name, "total") || name_has(smp->name, "count") ||
+	    name_has(smp->name, "sum") ||
+	    (histogram && name_has(smp->name, "bucket")))
+	    mp->desc.sem = PM_SEM_COUNTER;
+
+	if (((histogram || strcmp(type, "summary") == 0) &&
+	     name_has(smp->name, "count")) ||
+	    (histogram && name_has(smp->name, "bucket"))) {
+	    mp->desc.units.dimCount = 1;
+	}
+	else if (name_has(smp->name, "seconds")) {
+	    mp->desc.units.dimTime = 1;
+	    mp->desc.units.scaleTime = PM_TIME_SEC;
+	}
+	else if (name_has(smp->name, "microseconds")) {
+	    mp->desc.units.dimTime = 1;
+	    mp->desc.units.scaleTime = PM_TIME_USEC;
+	}
+	else if (name_has(smp->name, "bytes")) {
+	    mp->desc.units.dimSpace = 1;
+	}
+    }
+
+    /* PMNS name: PCP metadata may rename, else ':' become '.' */
+    if (pcpname)
+	pmsprintf(name, sizeof(name), "%s.%s.%s", om_root, sp->name, pcpname);
+    else {
+	char	*p;
+
+	pmsprintf(name, sizeof(name), "%s.%s.%s", om_root, sp->name, smp->name);
+	for (p = name; *p; p++)
+	    if (*p == ':')
+		*p = '.';
+    }
+    mp->pmns = strdup(name);
+    return singular;
+}
+
+static void
+metric_help(om_metric *mp, const char *help)
+{
+    char	*text, *p, *q;
+
+    if (help == NULL || (text = strdup(help)) == NULL)
+	return;
+    for (p = q = text; *p; p++) {
+	if (*p == '\\' && p[1] == '\\') {
+	    *q++ = '\\';
+	    p++;
+	} else if (*p == '\\' && p[1] == 'n') {
+	    *q++ = '\n';
+	    p++;
+	} else {
+	    *q++ = *p;
+	}
+    }
+    *q = '\0';
+    if ((p = strchr(text, '\n')) != NULL) {
+	*p++ = '\0';
+	mp->helptext = strdup(p);
+    }
+    mp->oneline = text;
+}
+
+/*
+ * Instance tables - names, labels and the instance domain served to
+ * pmcd - are extended under the PMDA lock.
+ */
+static int
+grow_instances(om_metric *mp)
+{
+    pmdaIndom	*idp = &om_indomtab[mp->indom];
+    pmdaInstid	*set;
+    char	**lp, **np;
+    int		size = mp->insts.size;
+
+    if (size <= mp->isize)
+	return 0;
+    if ((set = realloc(idp->it_set, size * sizeof(pmdaInstid))) == NULL)
+	return -ENOMEM;
+    idp->it_set = set;
+    if ((lp = realloc(mp->instlabels, size * sizeof(char *))) == NULL)
+	return -ENOMEM;
+    mp->instlabels = lp;
+    if ((np = realloc(mp->instnotes, size * sizeof(char *))) == NULL)
+	return -ENOMEM;
+    mp->instnotes = np;
+    memset(lp + mp->isize, 0, (size - mp->isize) * sizeof(char *));
+    memset(np + mp->isize, 0, (size - mp->isize) * sizeof(char *));
+    mp->isize = size;
+    return 0;
+}
+
+/* make instances up to and including inst visible via pmdaInstance */
+static void
+publish_instances(om_metric *mp, int inst)
+{
+    pmdaIndom	*idp = &om_indomtab[mp->indom];
+    char	external[NAMELEN];
+    int		i;
+
+    for (i = idp->it_numinst; i <= inst; i++) {
+	om_names_external(&mp->insts, i, external, sizeof(external));
+	idp->it_set[i].i_inst = i;
+	idp->it_set[i].i_name = strdup(external);
+    }
+    idp->it_numinst = inst + 1;
+}
+
+/*
+ * Create a new metric for this sample (under the PMDA lock), or return
+ * NULL if it is excluded by the filters or a limit is reached.
+ */
+static om_metric *
+new_metric(om_source *sp, om_sample *smp, int included)
+{
+    om_metric	*mp, **metrics;
+    unsigned int serial;
+    int		item, singular, has_pcp, size;
+
+    if ((item = om_names_lookup(&sp->items, smp->name)) < 0) {
+	if ((item = om_names_add(&sp->items, smp->name, MAX_METRIC)) < 0) {
+	    pmNotifyErr(LOG_ERR, "%s: too many metrics, %s dropped",
+			    sp->name, smp->name);
+	    return NULL;
+	}
+	om_names_save(&sp->items);
+    }
+    if (item >= sp->msize) {
+	size = sp->items.size;
+	if ((metrics = realloc(sp->metrics, size * sizeof(om_metric *))) == NULL)
+	    return NULL;
+	memset(metrics + sp->msize, 0, (size - sp->msize) * sizeof(om_metric *));
+	sp->metrics = metrics;
+	sp->msize = size;
+    }
+    if ((mp = calloc(1, sizeof(om_metric))) == NULL)
+	return NULL;
+    mp->source = sp;
+    mp->item = item;
+    mp->name = strdup(smp->name);
+    mp->desc.pmid = pmID_build(om_domain, sp->cluster, item);
+    singular = metric_metadata(sp, mp, smp, &has_pcp);
+    metric_help(mp, smp->help);
+    mp->values[0].generation = mp->values[1].generation = sp->generation;
+    mp->values[0].count = mp->values[1].count = 0;
+
+    if (singular || included == 0) {
+	mp->desc.indom = PM_INDOM_NULL;
+	mp->indom = -1;
+    }
+    else {
+	serial = INDOM_BASE + sp->cluster * (MAX_METRIC+1) + item;
+	mp->desc.indom = pmInDom_build(om_domain, serial);
+	om_names_init(&mp->insts, serial);
+	om_names_load(&mp->insts);
+	if (mp->insts.count == 0)
+	    mp->insts.prefix = !has_pcp;
+	if ((mp->indom = om_add_indom(mp->desc.indom)) < 0 ||
+	    grow_instances(mp) < 0) {
+	    free(mp->name);
+	    free(mp->pmns);
+	    free(mp);
+	    return NULL;
+	}
+	if (mp->insts.count > 0)
+	    publish_instances(mp, mp->insts.count - 1);
+    }
+    sp->metrics[item] = mp;
+    om_changed();
+
+    if (om_verbose)
+	pmNotifyErr(LOG_DEBUG, "new metric %s pmid=%s type=%d sem=%d indom=%s",
+			mp->pmns, pmIDStr(mp->desc.pmid), mp->desc.type,
+			mp->desc.sem, pmInDomStr(mp->desc.indom));
+    return mp;
+}
+
+static int
+compare_labels(const void *a, const void *b)
+{
+    const om_label	*la = *(const om_label **)a;
+    const om_label	*lb = *(const om_label **)b;
+
+    return strcmp(la->name, lb->name);
+}
+
+static void
+append_json(char *buf, size_t buflen, const om_label *lp)
+{
+    char	value[NAMELEN];
+    size_t	length = strlen(buf);
+
+    if (om_json_escape(value, sizeof(value), lp->value) < 0)
+	return;
+    pmsprintf(buf + length, buflen - length, "%s\"%s\":%s",
+		length > 1 ? "," : "", lp->name, value);
+}
+
+static void
+instance_labels(om_metric *mp, int inst, om_label **naming, int nnaming,
+		om_label **optional, int noptional)
+{
+    char	labels[NAMELEN], notes[NAMELEN];
+    int		i;
+
+    pmstrncpy(labels, sizeof(labels), "{");
+    for (i = 0; i < nnaming; i++) {
+	if (strcmp(naming[i]->name, "instname") != 0)
+	    append_json(labels, sizeof(labels), naming[i]);
+    }
+    strncat(labels, "}", sizeof(labels) - strlen(labels) - 1);
+    pmstrncpy(notes, sizeof(notes), "{");
+    for (i = 0; i < noptional; i++)
+	append_json(notes, sizeof(notes), optional[i]);
+    strncat(notes, "}", sizeof(notes) - strlen(notes) - 1);
+    free(mp->instlabels[inst]);
+    free(mp->instnotes[inst]);
+    mp->instlabels[inst] = strdup(labels);
+    mp->instnotes[inst] = strdup(notes);
+}
+
+static int
+new_instance(om_metric *mp, const char *name)
+{
+    int		inst;
+
+    if ((inst = om_names_add(&mp->insts, name, INT_MAX-1)) < 0)
+	return inst;
+    if (grow_instances(mp) < 0)
+	return -ENOMEM;
+    publish_instances(mp, inst);
+    return inst;
+}
+
+/*
+ * Map one sample to its metric and instance.  Existing metrics and
+ * instances are found without the PMDA lock - this worker is the only
+ * writer of the source's name tables - and it is taken only to create.
+ */
+static void
+resolve_sample(om_source *sp, om_sample *smp)
+{
+    om_doc	*dp = &sp->doc;
+    om_label	*naming[MAX_LABELS], *optional[MAX_LABELS], *lp;
+    om_metric	*mp = NULL;
+    char	name[NAMELEN];
+    char	*instname = NULL;
+    size_t	length;
+    int		nnaming = 0, noptional = 0, item, i, action;
+
+    smp->metric = NULL;
+
+    /* trim labels according to the filters */
+    for (i = 0; i < smp->nlabels; i++) {
+	lp = &dp->labels[smp->label + i];
+	action = sp->nfilters ? check_filter(sp, lp->name, FILTER_LABEL) :
+				FILTER_INCLUDE;
+	if (action == FILTER_INCLUDE && nnaming < MAX_LABELS)
+	    naming[nnaming++] = lp;
+	else if (action == FILTER_OPTIONAL && noptional < MAX_LABELS)
+	    optional[noptional++] = lp;
+    }
+
+    if ((item = om_names_lookup(&sp->items, smp->name)) >= 0 && item < sp->msize)
+	mp = sp->metrics[item];
+    if (mp == NULL) {
+	if (sp->nfilters && om_names_lookup(&sp->excluded, smp->name) >= 0)
+	    return;
+	if (check_filter(sp, smp->name, FILTER_METRIC) != FILTER_INCLUDE) {
+	    pmNotifyErr(LOG_INFO, "Metric %s.%s.%s excluded by config filters",
+			    om_root, sp->name, smp->name);
+	    om_names_add(&sp->excluded, smp->name, INT_MAX-1);
+	    return;
+	}
+	pthread_mutex_lock(&om_lock);
+	mp = new_metric(sp, smp, nnaming + noptional);
+	pthread_mutex_unlock(&om_lock);
+	if (mp == NULL)
+	    return;
+    }
+    smp->metric = mp;
+    if (mp->indom < 0) {
+	smp->inst = PM_IN_NULL;
+	return;
+    }
+
+    /* pmproxy-style exporters name their own instances */
+    if (!mp->insts.prefix) {
+	for (i = 0; i < nnaming; i++) {
+	    if (strcmp(naming[i]->name, "instname") == 0) {
+		instname = naming[i]->value;
+		break;
+	    }
+	    if (strcmp(naming[i]->name, "instance") == 0)
+		instname = naming[i]->value;
+	}
+    }
+    if (instname == NULL) {
+	qsort(naming, nnaming, sizeof(om_label *), compare_labels);
+	name[0] = '\0';
+	for (i = length = 0; i < nnaming && length < sizeof(name); i++)
+	    length += pmsprintf(name + length, sizeof(name) - length, "%s%s:%s",
+				i ? " " : "", naming[i]->name, naming[i]->value);
+	instname = name;
+    }
+
+    if ((smp->inst = om_names_lookup(&mp->insts, instname)) < 0) {
+	pthread_mutex_lock(&om_lock);
+	if (instname == name && mp->insts.count == 0)
+	    mp->insts.prefix = 1;	/* no instname, uniquely prefixed */
+	if ((smp->inst = new_instance(mp, instname)) >= 0)
+	    instance_labels(mp, smp->inst, naming, nnaming, optional, noptional);
+	om_changed();
+	pthread_mutex_unlock(&om_lock);
+	if (smp->inst < 0)
+	    smp->metric = NULL;
+    }
+    else if (mp->instlabels[smp->inst] == NULL) {
+	/* first sighting since a restart, name was loaded from disk */
+	pthread_mutex_lock(&om_lock);
+	instance_labels(mp, smp->inst, naming, nnaming, optional, noptional);
+	pthread_mutex_unlock(&om_lock);
+    }
+}
+
+static int
+grow_values(om_values *vp, int size)
+{
+    unsigned int	*stamp;
+    pmAtomValue		*atoms;
+
+    if (size <= vp->size)
+	return 0;
+    if (size < vp->size * 2)
+	size = vp->size * 2;
+    if ((stamp = realloc(vp->stamp, size * sizeof(unsigned int))) == NULL)
+	return -ENOMEM;
+    vp->stamp = stamp;
+    if ((atoms = realloc(vp->atoms, size * sizeof(pmAtomValue))) == NULL)
+	return -ENOMEM;
+    vp->atoms = atoms;
+    memset(stamp + vp->size, 0, (size - vp->size) * sizeof(unsigned int));
+    vp->size = size;
+    return 0;
+}
+
+/* empty a back buffer, releasing any strings from an earlier scrape */
+static void
+clear_values(om_metric *mp, om_values *vp, unsigned int generation)
+{
+    int		i;
+
+    if (mp->desc.type == PM_TYPE_STRING) {
+	for (i = 0; i < vp->size; i++) {
+	    if (vp->stamp[i] == vp->generation)
+		free(vp->atoms[i].cp);
+	}
+    }
+    vp->generation = generation;
+    vp->count = 0;
+}
+
+static int
+convert_value(om_metric *mp, const char *s, pmAtomValue *ap)
+{
+    char	*end;
+    double	d;
+
+    switch (mp->desc.type) {
+    case PM_TYPE_STRING:
+	return (ap->cp = strdup(s)) ? 0 : -ENOMEM;
+    case PM_TYPE_FLOAT:
+    case PM_TYPE_DOUBLE:
+	d = strtod(s, &end);
+	if (*end != '\0')
+	    return PM_ERR_CONV;
+	if (mp->desc.type == PM_TYPE_FLOAT)
+	    ap->f = (float)d;
+	else
+	    ap->d = d;
+	return 0;
+    case PM_TYPE_32:
+	ap->l = (__int32_t)strtol(s, &end, 10);
+	break;
+    case PM_TYPE_U32:
+	ap->ul = (__uint32_t)strtoul(s, &end, 10);
+	break;
+    case PM_TYPE_64:
+	ap->ll = strtoll(s, &end, 10);
+	break;
+    case PM_TYPE_U64:
+	ap->ull = strtoull(s, &end, 10);
+	break;
+    default:
+	return PM_ERR_TYPE;
+    }
+    if (*end == '\0')
+	return 0;
+    /* integer metadata, but exporters often write "1e+06" or "12.0" */
+    d = strtod(s, &end);
+    if (*end != '\0')
+	return PM_ERR_CONV;
+    switch (mp->desc.type) {
+    case PM_TYPE_32: ap->l = (__int32_t)d; break;
+    case PM_TYPE_U32: ap->ul = (__uint32_t)d; break;
+    case PM_TYPE_64: ap->ll = (__int64_t)d; break;
+    default: ap->ull = (__uint64_t)d; break;
+    }
+    return 0;
+}
+
+static void
+store_value(om_source *sp, om_sample *smp, int back)
+{
+    om_metric	*mp = smp->metric;
+    om_values	*vp = &mp->values[back];
+    pmAtomValue	atom;
+    int		i = (smp->inst == PM_IN_NULL) ? 0 : smp->inst;
+
+    if (convert_value(mp, smp->value, &atom) < 0) {
+	if (om_verbose)
+	    pmNotifyErr(LOG_DEBUG, "%s: bad value \"%s\" for %s",
+			    sp->name, smp->value, mp->pmns);
+	return;
+    }
+    if (grow_values(vp, i + 1) < 0) {
+	if (mp->desc.type == PM_TYPE_STRING)
+	    free(atom.cp);
+	return;
+    }
+    if (vp->stamp[i] == vp->generation) {	/* repeated, last one wins */
+	if (mp->desc.type == PM_TYPE_STRING)
+	    free(vp->atoms[i].cp);
+    } else {
+	vp->stamp[i] = vp->generation;
+	vp->count++;
+    }
+    vp->atoms[i] = atom;
+}
+
+static void
+set_status(om_source *sp, const char *fmt, ...)
+{
+    char	buf[BUFSIZ];
+    va_list	arg;
+
+    va_start(arg, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, arg);
+    va_end(arg);
+    free(sp->status);
+    sp->status = strdup(buf);
+}
+
+static void
+scrape(om_source *sp, http_client **clientp)
+{
+    om_doc		*dp = &sp->doc;
+    struct timeval	start, fetched, done;
+    unsigned int	generation;
+    int			back, status = 0;
+    int			i, sts;
+
+    pmtimevalNow(&start);
+    if ((sts = om_parse_config(sp)) < 0) {
+	pthread_mutex_lock(&om_lock);
+	sp->calls++;
+	set_status(sp, "cannot read %s: %s", sp->path, pmErrStr(sts));
+	sp->status_code = 0;
+	pthread_mutex_unlock(&om_lock);
+	return;
+    }
+    if (sp->scripted)
+	sts = fetch_script(sp);
+    else if (strncmp(sp->url, "file://", 7) == 0)
+	sts = fetch_file(sp, sp->url + 7);
+    else
+	sts = fetch_url(sp, clientp, &status);
+    pmtimevalNow(&fetched);
+
+    if (sts < 0) {
+	pthread_mutex_lock(&om_lock);
+	sp->calls++;
+	sp->fetch_time += (__uint64_t)(pmtimevalSub(&fetched, &start) * 1000);
+	set_status(sp, "failed to fetch URL or execute script %s: %s",
+			sp->path, status >= 300 ? "HTTP error" : pmErrStr(sts));
+	sp->status_code = status;
+	pthread_mutex_unlock(&om_lock);
+	if (om_verbose)
+	    pmNotifyErr(LOG_DEBUG, "%s: %s", sp->name, sp->status);
+	return;
+    }
+
+    om_tokenize(dp);
+
+    /* resolve metrics and instances, then fill the back buffers */
+    back = !sp->front;
+    generation = ++sp->generation;
+    for (i = 0; i < sp->items.count; i++) {
+	if (sp->metrics && sp->metrics[i])
+	    clear_values(sp->metrics[i], &sp->metrics[i]->values[back], generation);
+    }
+    for (i = 0; i < dp->nsamples; i++) {
+	resolve_sample(sp, &dp->samples[i]);
+	if (dp->samples[i].metric != NULL)
+	    store_value(sp, &dp->samples[i], back);
+    }
+    pmtimevalNow(&done);
+
+    pthread_mutex_lock(&om_lock);
+    sp->front = back;
+    sp->calls++;
+    sp->fetch_time += (__uint64_t)(pmtimevalSub(&fetched, &start) * 1000);
+    sp->parse_time += (__uint64_t)(pmtimevalSub(&done, &fetched) * 1000);
+    set_status(sp, "success");
+    sp->status_code = status;
+    pthread_mutex_unlock(&om_lock);
+
+    for (i = 0; i < sp->items.count; i++) {
+	if (sp->metrics && sp->metrics[i] && sp->metrics[i]->insts.dirty)
+	    om_names_save(&sp->metrics[i]->insts);
+    }
+    if (om_verbose)
+	pmNotifyErr(LOG_DEBUG, "fetched %zu bytes with %d samples (%d unparsed) from %s",
+			dp->length, dp->nsamples, dp->errors, sp->path);
+}
+
+static void *
+worker(void *arg)
+{
+    http_client	*client = NULL;
+    om_source	*sp;
+    int		cluster;
+
+    (void)arg;
+    for (;;) {
+	pthread_mutex_lock(&queue_lock);
+	while (qcount == 0)
+	    pthread_cond_wait(&queue_cond, &queue_lock);
+	cluster = queue[qhead];
+	qhead = (qhead + 1) % qsize;
+	qcount--;
+	pthread_mutex_unlock(&queue_lock);
+
+	sp = om_sources[cluster];
+	scrape(sp, &client);
+
+	pthread_mutex_lock(&queue_lock);
+	sp->busy = 0;
+	if (--pending == 0)
+	    pthread_cond_broadcast(&done_cond);
+	pthread_mutex_unlock(&queue_lock);
+    }
+    return NULL;
+}
+
+/*
+ * Scrape every source concurrently, waiting for them all to complete
+ * (each is bounded by the timeout).  Sources still busy from an earlier
+ * round are not queued twice.
+ */
+void
+om_refresh(int timeout)
+{
+    int		cluster;
+
+    pthread_mutex_lock(&queue_lock);
+    scrape_timeout = timeout;
+    if (qsize < om_clusters.count) {
+	int	*q = malloc(om_clusters.count * sizeof(int));
+	int	i;
+
+	if (q == NULL) {
+	    pthread_mutex_unlock(&queue_lock);
+	    return;
+	}
+	for (i = 0; i < qcount; i++)
+	    q[i] = queue[(qhead + i) % qsize];
+	free(queue);
+	queue = q;
+	qhead = 0;
+	qsize = om_clusters.count;
+    }
+    for (cluster = 1; cluster < om_clusters.count; cluster++) {
+	if (om_sources[cluster] == NULL || om_sources[cluster]->busy)
+	    continue;
+	om_sources[cluster]->busy = 1;
+	queue[(qhead + qcount) % qsize] = cluster;
+	qcount++;
+	pending++;
+    }
+    pthread_cond_broadcast(&queue_cond);
+    while (pending > 0)
+	pthread_cond_wait(&done_cond, &queue_lock);
+    pthread_mutex_unlock(&queue_lock);
+}
+
+void
+om_scraper_start(int nworkers)
+{
+    pthread_t	tid;
+    int		i, sts;
+
+    for (i = 0; i < nworkers; i++) {
+	if ((sts = pthread_create(&tid, NULL, worker, NULL)) != 0) {
+	    pmNotifyErr(LOG_ERR, "cannot create scrape thread: %s", strerror(sts));
+	    if (i == 0)
+		exit(1);
+	    break;
+	}
+	pthread_detach(tid);
+    }
+}
@@ -35,6 +35,14 @@
 #define TIME_ENABLED 1
 #define TIME_RUNNING 2
 
+/* maximum events per group, negative to size groups to the pmu counters */
+static int group_limit = -1;
+
+void perf_event_group_limit(int limit)
+{
+    group_limit = limit;
+}
+
 const char *perf_strerror(int err)
 {
     const char *ret = "Unknown error";
@@ -90,6 +98,12 @@ static void free_perfdata(perfdata_t *del)
     if(0 == del ) {
         return;
     }
+    for ( i = 0; i < del->ngroups; ++i )
+    {
+        free(del->groups[i].members);
+        free(del->groups[i].buffer);
+    }
+    free(del->groups);
     for ( i = 0; i < del->nevents; ++i )
     {
         free_event(&del->events[i]);
@@ -409,6 +423,131 @@ static int fetch_perf_scale(char *event_name, double *scale)
     return ret;
 }
 
+/*
+ * Maximum number of events in a group for a libpfm event (idx), or a raw
+ * event (negative idx).  All members of a group are scheduled onto the pmu
+ * together, so one generic counter is left spare for the NMI watchdog and
+ * other users, else the group might never be scheduled at all.
+ */
+static int event_group_limit(int idx)
+{
+    pfm_event_info_t einfo;
+    pfm_pmu_info_t pinfo;
+
+    if (group_limit >= 0)
+        return group_limit;
+    if (idx < 0)
+        return 1;
+
+    memset(&einfo, 0, sizeof(einfo));
+    einfo.size = sizeof(einfo);
+    if (pfm_get_event_info(idx, PFM_OS_PERF_EVENT_EXT, &einfo) != PFM_SUCCESS)
+        return 1;
+    memset(&pinfo, 0, sizeof(pinfo));
+    pinfo.size = sizeof(pinfo);
+    if (pfm_get_pmu_info(einfo.pmu, &pinfo) != PFM_SUCCESS)
+        return 1;
+    return pinfo.num_cntrs - 1;
+}
+
+static eventgroup_t *find_group(perfdata_t *inst, eventcpuinfo_t *info)
+{
+    eventgroup_t *group;
+    int i;
+
+    for (i = inst->ngroups - 1; i >= 0; i--) {
+        group = &inst->groups[i];
+        if (group->cpu == info->cpu && group->type == info->hw.type &&
+            group->nmembers < group->limit)
+            return group;
+    }
+    return NULL;
+}
+
+/*
+ * Add an opened event to group, or to a new group led by this event
+ * if group is NULL.
+ */
+static int add_group_member(perfdata_t *inst, eventgroup_t *group,
+                            eventcpuinfo_t *info, int limit)
+{
+    eventgroup_t *groups;
+    eventcpuinfo_t **members;
+    uint64_t *buffer;
+    int ngroups = inst->ngroups;
+
+    if (NULL == group) {
+        groups = realloc(inst->groups, (ngroups + 1) * sizeof(*groups));
+        if (NULL == groups)
+            return -E_PERFEVENT_REALLOC;
+        inst->groups = groups;
+        group = &groups[ngroups++];
+        memset(group, 0, sizeof(*group));
+        group->fd = info->fd;
+        group->cpu = info->cpu;
+        group->type = info->hw.type;
+        group->limit = limit;
+    }
+
+    members = realloc(group->members, (group->nmembers + 1) * sizeof(*members));
+    if (NULL == members)
+        goto fail;
+    group->members = members;
+    buffer = realloc(group->buffer, (3 + 2 * (group->nmembers + 1)) * sizeof(*buffer));
+    if (NULL == buffer)
+        goto fail;
+    group->buffer = buffer;
+
+    members[group->nmembers++] = info;
+    info->group = group - inst->groups;
+    inst->ngroups = ngroups;
+    return 0;
+
+ fail:
+    if (ngroups != inst->ngroups) {
+        free(group->members);
+        free(group->buffer);
+    }
+    return -E_PERFEVENT_REALLOC;
+}
+
+/*
+ * Open a hardware event on info->cpu, joining an existing group for the
+ * same cpu and pmu if one has room, else leading a new group, so that all
+ * counts for the group are later fetched with a single read(2).
+ */
+static int open_grouped_event(perfdata_t *inst, eventcpuinfo_t *info, int limit)
+{
+    eventgroup_t *group = NULL;
+
+    info->group = -1;
+    if (limit < 2) {
+        info->fd = perf_event_open(&info->hw, -1, info->cpu, -1, 0);
+        return info->fd;
+    }
+
+    info->hw.read_format |= PERF_FORMAT_GROUP | PERF_FORMAT_ID;
+    if ((group = find_group(inst, info)) != NULL)
+        info->fd = perf_event_open(&info->hw, -1, info->cpu, group->fd, 0);
+    if (NULL == group || info->fd == -1) {
+        group = NULL;
+        info->fd = perf_event_open(&info->hw, -1, info->cpu, -1, 0);
+    }
+    if (info->fd == -1)
+        return -1;
+
+    /* without an id (pre-3.12 kernels) members are matched by position */
+    if (ioctl(info->fd, PERF_EVENT_IOC_ID, &info->id) == -1)
+        info->id = 0;
+
+    if (add_group_member(inst, group, info, limit) < 0) {
+        close(info->fd);
+        errno = ENOMEM;
+        info->fd = -1;
+    }
+    return info->fd;
+}
+
 /*
  * Setup a derived event
  */
@@ -586,6 +725,7 @@ static int perf_setup_event(perfdata_t *inst, const char *eventname,
     {
         memset(info, 0, sizeof *info);
         info->fd = -1;
+        info->group = -1;
         info->cpu = cpuarr[i];
 
         if( 0 == strncmp(eventname, "RAPL:", 5) ) {
@@ -620,7 +760,7 @@ static int perf_setup_event(perfdata_t *inst, const char *eventname,
             info->hw.exclude_hv = 1;
             info->hw.exclude_guest = 1;
             info->hw.disabled = 1;
-            info->fd = perf_event_open(&info->hw, -1, info->cpu, -1, 0);
+            open_grouped_event(inst, info, event_group_limit(-1));
 
             if (info->fd == -1) {
                 fprintf(stderr, "perf_event_open failed on cpu%d for \"%s\": %s\n",
@@ -653,7 +793,7 @@ static int perf_setup_event(perfdata_t *inst, const char *eventname,
 
             info->hw.disabled = 1;
             info->hw.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
-            info->fd = perf_event_open(&info->hw, -1, info->cpu, -1, 0);
+            open_grouped_event(inst, info, event_group_limit(info->idx));
             if(info->fd == -1)
             {
                 fprintf(stderr, "perf_event_open failed on cpu%d for \"%s\": %s\n", 
@@ -768,6 +908,7 @@ static int perf_setup_dynamic_events(perfdata_t *inst,
             for(i = 0; i < ncpus; ++i) {
                 memset(info, 0, sizeof *info);
                 info->fd = -1;
+                info->group = -1;
                 info->cpu = cpuarr[i];
                 info->type = EVENT_TYPE_PERF;
                 info->hw.size = sizeof(info->hw);
@@ -1121,6 +1262,54 @@ static int perf_derived_get(perf_derived_counter **derived_counters,
     return 0;
 }
 
+/*
+ * Fetch the counts for every group with a single read(2) per group, and
+ * hand them to the member events.  Members of a group that could not be
+ * read are left stale, and reported as unreadable by perf_get().
+ */
+static void perf_read_groups(perfdata_t *pdata)
+{
+    eventgroup_t *group;
+    eventcpuinfo_t *info;
+    uint64_t nr, *entry;
+    ssize_t ret;
+    int i, j, k;
+
+    for (i = 0; i < pdata->ngroups; ++i)
+    {
+        group = &pdata->groups[i];
+        ret = read(group->fd, group->buffer,
+                   (3 + 2 * group->nmembers) * sizeof(uint64_t));
+        nr = group->buffer[0];
+        if (ret < 0 || nr > group->nmembers ||
+            (size_t)ret != (3 + 2 * nr) * sizeof(uint64_t))
+        {
+            fprintf(stderr, "cannot read event group on cpu %d:%zd\n", group->cpu, ret);
+            continue;
+        }
+
+        for (j = 0; j < nr; ++j)
+        {
+            entry = &group->buffer[3 + 2 * j];
+            info = group->members[j];
+            if (info->id && info->id != entry[1])
+            {
+                /* not in creation order, find this id */
+                for (k = 0; k < group->nmembers; ++k)
+                    if (group->members[k]->id == entry[1])
+                        break;
+                if (k == group->nmembers)
+                    continue;
+                info = group->members[k];
+            }
+            info->values[RAW_VALUE] = entry[0];
+            info->values[TIME_ENABLED] = group->buffer[1];
+            info->values[TIME_RUNNING] = group->buffer[2];
+            info->fresh = 1;
+        }
+    }
+}
+
 int perf_get(perfhandle_t *inst, perf_counter **counters, int *size,
              perf_derived_counter **derived_counters, int *derived_size)
 {
@@ -1147,6 +1336,8 @@ int perf_get(perfhandle_t *inst, perf_counter **counters, int *size,
         ncounters = pdata->nevents;
     }
 
+    perf_read_groups(pdata);
+
     events_read = 0;
     for(idx = 0; idx < pdata->nevents; ++idx)
     {
@@ -1171,7 +1362,19 @@ int perf_get(perfhandle_t *inst, perf_counter **counters, int *size,
 
             int ret;
 
-            if( info->type == EVENT_TYPE_PERF ) {
+            if( info->type == EVENT_TYPE_PERF && info->group >= 0 ) {
+                if (!info->fresh) {
+                    fprintf(stderr, "could not read event %s on cpu %d\n", event->name, info->cpu);
+                    continue;
+                }
+                info->fresh = 0;
+                ++events_read;
+
+                pcounter[idx].data[cpuidx].value += scaled_value_delta(info);
+                pcounter[idx].data[cpuidx].time_enabled = info->values[TIME_ENABLED];
+                pcounter[idx].data[cpuidx].time_running = info->values[TIME_RUNNING];
+                pcounter[idx].data[cpuidx].id = info->cpu;
+            } else if( info->type == EVENT_TYPE_PERF ) {
                 ret = read(info->fd, info->values, sizeof(info->values));
                 if (ret != sizeof(info->values)) {
                     if (ret == -1)
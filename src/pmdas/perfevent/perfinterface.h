@@ -67,8 +67,22 @@ typedef struct eventcpuinfo_t_ {
     char *fstr; /* fstr from library, must be freed */
     rapl_data_t rapldata;
     int cpu;
+    int group; /* index into perfdata_t groups, or -1 if read individually */
+    int fresh; /* values filled in by the last group read */
+    uint64_t id; /* kernel event identifier, matches group read entries */
 } eventcpuinfo_t;
 
+/* events on one cpu read together via PERF_FORMAT_GROUP */
+typedef struct eventgroup_t_ {
+    int fd; /* group leader, owned by members[0] */
+    int cpu;
+    uint32_t type; /* perf_event_attr type shared by all members */
+    int limit; /* maximum members, so the group fits the pmu counters */
+    int nmembers;
+    eventcpuinfo_t **members;
+    uint64_t *buffer; /* read_format layout, 3 + 2 * nmembers entries */
+} eventgroup_t;
+
 typedef struct event_t_ {
     char *name;
     int disable_event;
@@ -101,6 +115,9 @@ typedef struct perfdata_t_
     int nderivedevents;
     derived_event_t *derived_events;
 
+    int ngroups;
+    eventgroup_t *groups;
+
     /* information about the architecture (number of cpus, numa nodes etc) */
     archinfo_t *archinfo;
 
@@ -118,6 +135,11 @@ void perf_counter_destroy(perf_counter *data, int size, perf_derived_counter *de
 
 void perf_event_destroy(perfhandle_t *inst);
 
+/* Set the maximum number of events per group, before perf_event_create().
+ * A negative limit (default) sizes groups to the pmu counters, while 0 or 1
+ * disables grouping so each event is read individually. */
+void perf_event_group_limit(int limit);
+
 #define PERF_COUNTER_ENABLE 0
 #define PERF_COUNTER_DISABLE 1
 int perf_counter_enable(perfhandle_t *inst, int enable);
@@ -751,6 +751,7 @@ static void usage(void)
     fputs("Options:\n"
           "  -C           maintain compatibility to (possibly) nonconforming metric names\n"
           "  -d domain    use domain (numeric) for metrics domain of PMDA\n"
+          "  -g limit     maximum events per read group (default: pmu counters - 1)\n"
           "  -l logfile   write log into logfile rather than using default log name\n"
           "  -U username  user account to run under (default \"pcp\")\n"
           "\nExactly one of the following options may appear:\n"
@@ -780,13 +781,16 @@ int main(int argc, char **argv)
     pmdaDaemon(&dispatch, PMDA_INTERFACE_7, pmGetProgname(), PERFEVENT,
                "perfevent.log", mypath);
 
-    while ((c = pmdaGetOpt(argc, argv, "CD:d:i:l:pu:U:6:?", &dispatch, &err)) != EOF)
+    while ((c = pmdaGetOpt(argc, argv, "CD:d:g:i:l:pu:U:6:?", &dispatch, &err)) != EOF)
     {
         switch(c)
         {
         case 'C':
             compat_names = 1;
             break;
+        case 'g':
+            perf_event_group_limit(atoi(optarg));
+            break;
         case 'U':
             username = optarg;
             break;
@@ -89,6 +89,12 @@ static pmDesc	desctab[] = {
     { PMDA_PMID(0,25), PM_TYPE_STRING, PM_INDOM_NULL, PM_SEM_INSTANT, PMDA_PMUNITS(0,0,0,0,0,0) },
 /* zoneinfo -- local timezone tzfile identification  -- for pmlogger timezone */
     { PMDA_PMID(0,26), PM_TYPE_STRING, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,0,0,0,0,0) },
+/* control.flightbufs -- number of flight recorder buffers */
+    { PMDA_PMID(0,27), PM_TYPE_32, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,0,0,0,0,0) },
+/* control.dumpflight -- push-button, pmStore to dump flight recorder */
+    { PMDA_PMID(0,28), PM_TYPE_32, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,0,0,0,0,0) },
+/* control.hedge -- adaptive fetch timeout multiple, 0 for never */
+    { PMDA_PMID(0,29), PM_TYPE_32, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,0,0,0,0,0) },
 
 /* pdu_in.error */
     { PMDA_PMID(1,0), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
@@ -138,6 +144,10 @@ static pmDesc	desctab[] = {
     { PMDA_PMID(1,23), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
 /* pdu_in.descs */
     { PMDA_PMID(1,24), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
+/* pdu_in.compact_result */
+    { PMDA_PMID(1,25), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
+/* pdu_in.namedescs */
+    { PMDA_PMID(1,26), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
 
 /* pdu_out.error */
     { PMDA_PMID(2,0), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
@@ -187,6 +197,10 @@ static pmDesc	desctab[] = {
     { PMDA_PMID(2,23), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
 /* pdu_out.descs */
     { PMDA_PMID(2,24), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
+/* pdu_out.compact_result */
+    { PMDA_PMID(2,25), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
+/* pdu_out.namedescs */
+    { PMDA_PMID(2,26), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
 
 /* pmlogger.port */
     { PMDA_PMID(3,0), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,0,0,0,0,0) },
@@ -205,6 +219,16 @@ static pmDesc	desctab[] = {
     { PMDA_PMID(4,2), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_INSTANT, PMDA_PMUNITS(0,0,0,0,0,0) },
 /* agent.name */
     { PMDA_PMID(4,3), PM_TYPE_STRING, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,0,0,0,0,0) },
+/* agent.fetch.count */
+    { PMDA_PMID(4,4), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
+/* agent.fetch.send.time */
+    { PMDA_PMID(4,5), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,1,0,0,PM_TIME_USEC,0) },
+/* agent.fetch.wait.time */
+    { PMDA_PMID(4,6), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,1,0,0,PM_TIME_USEC,0) },
+/* agent.fetch.wait.late */
+    { PMDA_PMID(4,7), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
+/* agent.fetch.wait.timeout */
+    { PMDA_PMID(4,8), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_INSTANT, PMDA_PMUNITS(0,1,0,0,PM_TIME_USEC,0) },
 
 /* pmie.configfile */
     { PMDA_PMID(5,0), PM_TYPE_STRING, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,0,0,0,0,0) },
@@ -233,6 +257,12 @@ static pmDesc	desctab[] = {
     { PMDA_PMID(6,1), PM_TYPE_STRING, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,0,0,0,0,0) },
 /* client.container */
     { PMDA_PMID(6,2), PM_TYPE_STRING, PM_INDOM_NULL, PM_SEM_INSTANT, PMDA_PMUNITS(0,0,0,0,0,0) },
+/* client.fetch.count */
+    { PMDA_PMID(6,3), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
+/* client.fetch.total.time */
+    { PMDA_PMID(6,4), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,1,0,0,PM_TIME_USEC,0) },
+/* client.fetch.xmit.time */
+    { PMDA_PMID(6,5), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,1,0,0,PM_TIME_USEC,0) },
 
 /* pmcd.cputime.total */
     { PMDA_PMID(7,0), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,1,0,0,PM_TIME_MSEC,0) },
@@ -260,6 +290,34 @@ static pmDesc	desctab[] = {
 /* pmcd.feature.client_cert_required */
     { PMDA_PMID(8,9), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_INSTANT, PMDA_PMUNITS(0,0,0,0,0,0) },
 
+/* agent.fetch.send.histogram */
+    { PMDA_PMID(9,0), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
+/* agent.fetch.wait.histogram */
+    { PMDA_PMID(9,1), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
+/* client.fetch.total.histogram */
+    { PMDA_PMID(9,2), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
+/* client.fetch.xmit.histogram */
+    { PMDA_PMID(9,3), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
+
+/* flight.seq */
+    { PMDA_PMID(10,0), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,0,0,0,0,0) },
+/* flight.time */
+    { PMDA_PMID(10,1), PM_TYPE_DOUBLE, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,1,0,0,PM_TIME_SEC,0) },
+/* flight.pdu */
+    { PMDA_PMID(10,2), PM_TYPE_STRING, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,0,0,0,0,0) },
+/* flight.client */
+    { PMDA_PMID(10,3), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,0,0,0,0,0) },
+/* flight.agent */
+    { PMDA_PMID(10,4), PM_TYPE_32, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,0,0,0,0,0) },
+/* flight.size */
+    { PMDA_PMID(10,5), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(1,0,0,PM_SPACE_BYTE,0,0) },
+/* flight.queue */
+    { PMDA_PMID(10,6), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,1,0,0,PM_TIME_USEC,0) },
+/* flight.service */
+    { PMDA_PMID(10,7), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,1,0,0,PM_TIME_USEC,0) },
+/* flight.status */
+    { PMDA_PMID(10,8), PM_TYPE_32, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,0,0,0,0,0) },
+
 /* End-of-List */
     { PM_ID_NULL, 0, 0, 0, PMDA_PMUNITS(0, 0, 0, 0, 0, 0) }
 };
@@ -267,7 +325,11 @@ static int		ndesc = sizeof(desctab)/sizeof(desctab[0]);
 
 static pmProfile	*_profile;	/* last received profile */
 
-/* there are four instance domains: pmlogger, register, PMDA, and pmie */
+/*
+ * instance domains: pmlogger, register, PMDA, pmie, buffer pool, client,
+ * the fetch latency histograms for PMDAs and clients, and the slots of
+ * the PDU flight recorder
+ */
 #define INDOM_PMLOGGERS	1
 static pmInDom		logindom;
 #define INDOM_REGISTER	2
@@ -280,6 +342,12 @@ static pmInDom		pmieindom;
 static pmInDom		bufindom;
 #define INDOM_CLIENT	6
 static pmInDom		clientindom;
+#define INDOM_PMDALAT	7
+static pmInDom		pmdalatindom;
+#define INDOM_CLIENTLAT	8
+static pmInDom		clientlatindom;
+#define INDOM_FLIGHT	9
+static pmInDom		flightindom;
 
 #define NUMREG 16
 static int		reg[NUMREG];
@@ -409,6 +477,9 @@ init_tables(int dom)
     pmieindom = pmInDom_build(dom, INDOM_PMIES);
     bufindom = pmInDom_build(dom, INDOM_POOL);
     clientindom = pmInDom_build(dom, INDOM_CLIENT);
+    pmdalatindom = pmInDom_build(dom, INDOM_PMDALAT);
+    clientlatindom = pmInDom_build(dom, INDOM_CLIENTLAT);
+    flightindom = pmInDom_build(dom, INDOM_FLIGHT);
 
     /* merge performance domain ID part into PMIDs in pmDesc table */
     for (i = 0; desctab[i].pmid != PM_ID_NULL; i++) {
@@ -428,6 +499,10 @@ init_tables(int dom)
 	    desctab[i].indom = pmieindom;
 	else if (cluster == 6)
 	    desctab[i].indom = clientindom;
+	else if (cluster == 9)
+	    desctab[i].indom = item < 2 ? pmdalatindom : clientlatindom;
+	else if (cluster == 10)
+	    desctab[i].indom = flightindom;
     }
     ndesc--;
 }
@@ -768,6 +843,173 @@ pmcd_instance_pool(int inst, char *name, pmInResult **result)
     return 0;
 }
 
+/*
+ * Instances of the fetch latency histograms are one per bucket (see
+ * LatencyHist) for each PMDA or client, named "owner:bound" where
+ * bound is the upper limit of the bucket, e.g. "sample:1024us"
+ */
+#define CLIENTLAT_OWNER(seq)	((int)((seq) % (INT_MAX / PMCD_LAT_BUCKETS)))
+
+/*
+ * Owner o of histogram instances, returns the owner's instance base
+ * (or -1 if there is no such owner right now) with its name and the
+ * pair of histograms it has
+ */
+static int
+latency_owner(pmInDom indom, int o, char *buf, size_t buflen, LatencyHist **hist)
+{
+    if (indom == pmdalatindom) {
+	if (o >= nAgents)
+	    return -1;
+	pmsprintf(buf, buflen, "%s", agent[o].pmDomainLabel);
+	hist[0] = &agent[o].sendTime;
+	hist[1] = &agent[o].waitTime;
+	return agent[o].pmDomainId * PMCD_LAT_BUCKETS;
+    }
+    if (o >= nClients || !client[o].status.connected)
+	return -1;
+    pmsprintf(buf, buflen, "%u", client[o].seq);
+    hist[0] = &client[o].fetchTime;
+    hist[1] = &client[o].xmitTime;
+    return CLIENTLAT_OWNER(client[o].seq) * PMCD_LAT_BUCKETS;
+}
+
+static void
+latency_name(char *buf, size_t buflen, const char *owner, int bucket)
+{
+    if (bucket == PMCD_LAT_BUCKETS - 1)
+	pmsprintf(buf, buflen, "%s:inf", owner);
+    else
+	pmsprintf(buf, buflen, "%s:%uus", owner, 1U << bucket);
+}
+
+static int
+pmcd_instance_latency(pmInDom indom, int inst, char *name, pmInResult **result)
+{
+    pmInResult	*res;
+    LatencyHist	*hist[2];
+    char	owner[MAXPATHLEN];
+    char	buf[MAXPATHLEN];
+    int		nowner = (indom == pmdalatindom) ? nAgents : nClients;
+    int		base, o, b, n;
+
+    if ((res = (pmInResult *)malloc(sizeof(pmInResult))) == NULL)
+	return -oserror();
+    res->indom = indom;
+    res->instlist = NULL;
+    res->namelist = NULL;
+    n = (name == NULL && inst == PM_IN_NULL) ? nowner * PMCD_LAT_BUCKETS : 1;
+    res->numinst = 0;
+
+    if (inst == PM_IN_NULL &&
+	(res->instlist = (int *)malloc(n * sizeof(int))) == NULL) {
+	__pmFreeInResult(res);
+	return -oserror();
+    }
+    if (name == NULL &&
+	(res->namelist = (char **)calloc(n, sizeof(char *))) == NULL) {
+	__pmFreeInResult(res);
+	return -oserror();
+    }
+
+    for (o = 0; o < nowner; o++) {
+	if ((base = latency_owner(indom, o, owner, sizeof(owner), hist)) < 0)
+	    continue;
+	for (b = 0; b < PMCD_LAT_BUCKETS; b++) {
+	    if (name == NULL && inst != PM_IN_NULL && inst != base + b)
+		continue;
+	    latency_name(buf, sizeof(buf), owner, b);
+	    if (name != NULL && strcmp(name, buf) != 0)
+		continue;
+	    if (res->instlist != NULL)
+		res->instlist[res->numinst] = base + b;
+	    if (res->namelist != NULL &&
+		(res->namelist[res->numinst] = strdup(buf)) == NULL) {
+		__pmFreeInResult(res);
+		return -oserror();
+	    }
+	    res->numinst++;
+	    if (res->numinst == n)
+		goto done;
+	}
+    }
+    if (name != NULL || inst != PM_IN_NULL) {
+	__pmFreeInResult(res);
+	return PM_ERR_INST;
+    }
+
+done:
+    *result = res;
+    return 0;
+}
+
+/*
+ * Instances of the flight recorder metrics are the recorder slots that
+ * hold a request, named by slot number - pmcd.flight.seq orders them
+ */
+static int
+pmcd_instance_flight(int inst, char *name, pmInResult **result)
+{
+    pmInResult	*res;
+    char	buf[16], *end;
+    int		i, n;
+
+    if ((res = (pmInResult *)malloc(sizeof(pmInResult))) == NULL)
+	return -oserror();
+    res->indom = flightindom;
+    res->instlist = NULL;
+    res->namelist = NULL;
+    res->numinst = 0;
+
+    if (name == NULL && inst == PM_IN_NULL) {
+	for (i = n = 0; i < pmcd_flight_nbufs; i++)
+	    if (pmcd_flight_record(i) != NULL)
+		n++;
+	if (n > 0 &&
+	    ((res->instlist = (int *)malloc(n * sizeof(int))) == NULL ||
+	     (res->namelist = (char **)calloc(n, sizeof(char *))) == NULL)) {
+	    __pmFreeInResult(res);
+	    return -oserror();
+	}
+	for (i = 0; i < pmcd_flight_nbufs && res->numinst < n; i++) {
+	    if (pmcd_flight_record(i) == NULL)
+		continue;
+	    pmsprintf(buf, sizeof(buf), "%d", i);
+	    res->instlist[res->numinst] = i;
+	    if ((res->namelist[res->numinst] = strdup(buf)) == NULL) {
+		__pmFreeInResult(res);
+		return -oserror();
+	    }
+	    res->numinst++;
+	}
+    }
+    else if (name == NULL) {
+	/* given an inst, return the name */
+	pmsprintf(buf, sizeof(buf), "%d", inst);
+	if (pmcd_flight_record(inst) == NULL ||
+	    (res->namelist = (char **)malloc(sizeof(char *))) == NULL ||
+	    (res->namelist[0] = strdup(buf)) == NULL) {
+	    __pmFreeInResult(res);
+	    return PM_ERR_INST;
+	}
+	res->numinst = 1;
+    }
+    else {
+	/* given a name, return an inst */
+	i = (int)strtol(name, &end, 10);
+	if (*end != '\0' || pmcd_flight_record(i) == NULL ||
+	    (res->instlist = (int *)malloc(sizeof(int))) == NULL) {
+	    __pmFreeInResult(res);
+	    return PM_ERR_INST;
+	}
+	res->instlist[0] = i;
+	res->numinst = 1;
+    }
+
+    *result = res;
+    return 0;
+}
+
 static int
 pmcd_instance(pmInDom indom, int inst, char *name, pmInResult **result, pmdaExt *pmda)
 {
@@ -784,6 +1026,10 @@ pmcd_instance(pmInDom indom, int inst, char *name, pmInResult **result, pmdaExt
 	return pmcd_instance_reg(inst, name, result);
     else if (indom == bufindom)
 	return pmcd_instance_pool(inst, name, result);
+    else if (indom == pmdalatindom || indom == clientlatindom)
+	return pmcd_instance_latency(indom, inst, name, result);
+    else if (indom == flightindom)
+	return pmcd_instance_flight(inst, name, result);
     else if (indom == logindom || indom == pmdaindom || indom == pmieindom || indom == clientindom) {
 	res = (pmInResult *)malloc(sizeof(pmInResult));
 	if (res == NULL)
@@ -1330,6 +1576,129 @@ fetch_client_metric(int item, ClientInfo *cp)
     return NULL;
 }
 
+/*
+ * Fill res->vset[i] with the buckets of one of the latency histograms
+ * (which = 0 or 1, see latency_owner) for everything in the profile
+ */
+static int
+fetch_latency(pmInDom indom, int which, pmResult *res, int i)
+{
+    pmValueSet		*vset = res->vset[i];
+    pmID		pmid = vset->pmid;
+    pmAtomValue		atom;
+    LatencyHist		*hist[2];
+    char		owner[MAXPATHLEN];
+    int			nowner = (indom == pmdalatindom) ? nAgents : nClients;
+    int			base, o, b, numval;
+    int			sts = 0;
+
+    for (o = numval = 0; o < nowner; o++) {
+	if ((base = latency_owner(indom, o, owner, sizeof(owner), hist)) < 0)
+	    continue;
+	for (b = 0; b < PMCD_LAT_BUCKETS; b++) {
+	    if (__pmInProfile(indom, _profile, base + b))
+		numval++;
+	}
+    }
+    if (numval != 1) {
+	/* need a different vset size */
+	if (vset_resize(res, i, 1, numval) == -1)
+	    return -ENOMEM;
+	vset = res->vset[i];
+	vset->pmid = pmid;
+    }
+    for (o = numval = 0; o < nowner; o++) {
+	if ((base = latency_owner(indom, o, owner, sizeof(owner), hist)) < 0)
+	    continue;
+	for (b = 0; b < PMCD_LAT_BUCKETS; b++) {
+	    if (!__pmInProfile(indom, _profile, base + b))
+		continue;
+	    vset->vlist[numval].inst = base + b;
+	    atom.ull = hist[which]->bucket[b];
+	    if ((sts = __pmStuffValue(&atom, &vset->vlist[numval], PM_TYPE_U64)) < 0)
+		return sts;
+	    numval++;
+	}
+    }
+    if (numval > 0) {
+	pmResult	sortme;
+	sortme.numpmid = 1;
+	sortme.vset[0] = vset;
+	pmSortInstances(&sortme);
+    }
+    return sts;
+}
+
+/*
+ * Fill res->vset[i] with one field of the flight recorder records for
+ * everything in the profile
+ */
+static int
+fetch_flight(unsigned int item, pmDesc *dp, pmResult *res, int i)
+{
+    pmValueSet		*vset = res->vset[i];
+    pmID		pmid = vset->pmid;
+    pmAtomValue		atom;
+    FlightRecord	*fp;
+    char		strbuf[20];
+    int			slot, numval;
+    int			sts = 0;
+
+    if (item > 8)
+	return PM_ERR_PMID;
+    for (slot = numval = 0; slot < pmcd_flight_nbufs; slot++) {
+	if (pmcd_flight_record(slot) != NULL &&
+	    __pmInProfile(flightindom, _profile, slot))
+	    numval++;
+    }
+    if (numval != 1) {
+	/* need a different vset size */
+	if (vset_resize(res, i, 1, numval) == -1)
+	    return -ENOMEM;
+	vset = res->vset[i];
+	vset->pmid = pmid;
+    }
+    for (slot = numval = 0; slot < pmcd_flight_nbufs; slot++) {
+	if ((fp = pmcd_flight_record(slot)) == NULL ||
+	    !__pmInProfile(flightindom, _profile, slot))
+	    continue;
+	switch (item) {
+	    case 0:	/* flight.seq */
+		atom.ull = fp->seq;
+		break;
+	    case 1:	/* flight.time */
+		atom.d = pmtimevalToReal(&fp->stamp);
+		break;
+	    case 2:	/* flight.pdu */
+		atom.cp = __pmPDUTypeStr_r(fp->type, strbuf, sizeof(strbuf));
+		break;
+	    case 3:	/* flight.client */
+		atom.ul = fp->client;
+		break;
+	    case 4:	/* flight.agent */
+		atom.l = fp->agent;
+		break;
+	    case 5:	/* flight.size */
+		atom.ul = fp->size;
+		break;
+	    case 6:	/* flight.queue */
+		atom.ul = fp->queue;
+		break;
+	    case 7:	/* flight.service */
+		atom.ul = fp->service;
+		break;
+	    case 8:	/* flight.status */
+		atom.l = fp->status;
+		break;
+	}
+	vset->vlist[numval].inst = slot;
+	if ((sts = __pmStuffValue(&atom, &vset->vlist[numval], dp->type)) < 0)
+	    return sts;
+	numval++;
+    }
+    return sts;
+}
+
 static int
 pmcd_fetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
 {
@@ -1562,6 +1931,15 @@ pmcd_fetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
 				}
 				atom.cp = zoneinfo;
 				break;
+			case 27:	/* control.flightbufs */
+				atom.l = pmcd_flight_nbufs;
+				break;
+			case 28:	/* control.dumpflight ... always 0 */
+				atom.l = 0;
+				break;
+			case 29:	/* control.hedge */
+				atom.l = pmcd_hedge;
+				break;
 
 			default:
 				sts = atom.l = PM_ERR_PMID;
@@ -1684,6 +2062,24 @@ pmcd_fetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
 			case 3:		/* agent.name */
 			    atom.cp = agent[j].pmDomainLabel;
 			    break;
+			case 4:		/* agent.fetch.count */
+			    atom.ull = agent[j].sendTime.count;
+			    break;
+			case 5:		/* agent.fetch.send.time */
+			    atom.ull = agent[j].sendTime.total;
+			    break;
+			case 6:		/* agent.fetch.wait.time */
+			    atom.ull = agent[j].waitTime.total;
+			    break;
+			case 7:		/* agent.fetch.wait.late */
+			    atom.ull = agent[j].lateCount;
+			    break;
+			case 8:		/* agent.fetch.wait.timeout */
+			    if (agent[j].ipcType == AGENT_DSO)
+				atom.ull = 0;
+			    else
+				atom.ull = (__uint64_t)(pmcd_agent_timeout(&agent[j]) * 1000000);
+			    break;
 			default:
 			    sts = atom.l = PM_ERR_PMID;
 			    break;
@@ -1810,6 +2206,16 @@ pmcd_fetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
 			    k = strlen(atom.cp);
 			    atom.cp[k-1] = '\0';
 			    break;
+
+			case 3:		/* client.fetch.count */
+			    atom.ull = client[j].fetchTime.count;
+			    break;
+			case 4:		/* client.fetch.total.time */
+			    atom.ull = client[j].fetchTime.total;
+			    break;
+			case 5:		/* client.fetch.xmit.time */
+			    atom.ull = client[j].xmitTime.total;
+			    break;
 			default:
 			    sts = atom.l = PM_ERR_PMID;
 			    break;
@@ -1836,6 +2242,32 @@ pmcd_fetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
 	    case 8:	/* feature metrics */
 		sts = fetch_feature(item, &atom);
 		break;
+
+	    case 9:	/* fetch latency histograms */
+		if (item > 3) {
+		    sts = atom.l = PM_ERR_PMID;
+		    break;
+		}
+		sts = fetch_latency(dp->indom, item & 1, res, i);
+		if (sts == -ENOMEM)
+		    return sts;
+		vset = res->vset[i];
+		if (sts < 0)
+		    break;
+		valfmt = sts;
+		sts = 0;
+		break;
+
+	    case 10:	/* PDU flight recorder */
+		sts = fetch_flight(item, dp, res, i);
+		if (sts == -ENOMEM)
+		    return sts;
+		vset = res->vset[i];
+		if (sts < 0)
+		    break;
+		valfmt = sts;
+		sts = 0;
+		break;
 	}
 
 	if (sts == 0 && valfmt == -1 && vset->numval == 1)
@@ -1974,6 +2406,25 @@ pmcd_store(pmResult *result, pmdaExt *pmda)
 		/* bump ... intended for QA */
 		pmcd_seqnum++;
 	    }
+	    else if (item == 27) { /* pmcd.control.flightbufs */
+		val = vsp->vlist[0].value.lval;
+		if (val < 0) {
+		    sts = PM_ERR_SIGN;
+		    break;
+		}
+		pmcd_init_flight(val);
+	    }
+	    else if (item == 28) { /* pmcd.control.dumpflight */
+		pmcd_dump_flight(stderr);
+	    }
+	    else if (item == 29) { /* pmcd.control.hedge */
+		val = vsp->vlist[0].value.lval;
+		if (val < 0) {
+		    sts = PM_ERR_SIGN;
+		    break;
+		}
+		pmcd_hedge = val;
+	    }
 	    else {
 		sts = PM_ERR_PMID;
 		break;
@@ -254,6 +254,19 @@ container_info_end_labels(container_info_parser_t *ip, int bytes)
     ip->field = -1;	/* end labels */
 }
 
+/* container names shared with other PMDAs, see pmdaShared(3) */
+static int shared_ids = -1;	/* container identifier -> name */
+static int shared_names = -1;	/* container name -> identifier */
+
+static void
+container_info_share(const char *id, const char *name)
+{
+    if (id == NULL || name == NULL || *name == '\0')
+	return;
+    pmdaSharedStore(shared_ids, id, name);
+    pmdaSharedStore(shared_names, name, id);
+}
+
 static void
 container_info_update(container_info_parser_t *ip, int level, const char *position)
 {
@@ -274,6 +287,8 @@ container_info_update(container_info_parser_t *ip, int level, const char *positi
 	/* store the completed values into the cached structure */
 	memcpy(&cp->info, &ip->values, sizeof(cp->info));
 	pmdaCacheStore(indom, PMDA_CACHE_ADD, name, (void *)cp);
+	/* and make the name available to other PMDAs, e.g. pmdaroot */
+	container_info_share(name, podman_strings_lookup(cp->info.name));
     }
 }
 
@@ -585,12 +600,16 @@ podman_parse_init(void)
     pod_info_json->action_callback_POP = pod_info_complete;
     jsonsl_enable_all_callbacks(pod_info_json);
 
+    shared_ids = pmdaSharedOpen("containers", PMDA_SHARED_WRITE);
+    shared_names = pmdaSharedOpen("container-names", PMDA_SHARED_WRITE);
     return 0;
 }
 
 void
 podman_parse_end(void)
 {
+    pmdaSharedClose(shared_ids);
+    pmdaSharedClose(shared_names);
     jsonsl_destroy(container_stats_json);
     jsonsl_destroy(container_info_json);
     jsonsl_destroy(pod_info_json);
@@ -97,6 +97,10 @@ static container_engine_t engines[] = {
     { .name = NULL },
 };
 
+/* container names shared with other PMDAs, see pmdaShared(3) */
+static int shared_ids = -1;	/* container identifier -> name */
+static int shared_names = -1;	/* container name -> identifier */
+
 static void
 root_setup_containers(void)
 {
@@ -104,6 +108,23 @@ root_setup_containers(void)
 
     for (dp = &engines[0]; dp->name != NULL; dp++)
 	dp->setup(dp);
+
+    shared_ids = pmdaSharedOpen("containers", PMDA_SHARED_WRITE);
+    shared_names = pmdaSharedOpen("container-names", PMDA_SHARED_WRITE);
+    if (shared_ids < 0 || shared_names < 0)
+	pmNotifyErr(LOG_WARNING, "cannot share container names: %s\n",
+		pmErrStr(shared_ids < 0 ? shared_ids : shared_names));
+}
+
+static void
+root_share_container(const char *container, const char *name)
+{
+    if (*name == '/')	/* docker names */
+	name++;
+    if (*name == '\0')
+	return;
+    pmdaSharedStore(shared_ids, container, name);
+    pmdaSharedStore(shared_names, name, container);
 }
 
 static void
@@ -128,10 +149,15 @@ root_refresh_container_values(char *container, container_t *values)
 {
     container_engine_t *dp;
 
+    int sts;
+
     for (dp = &engines[0]; dp->name != NULL; dp++) {
 	if (values->engine != dp)
 	    continue;
-	return dp->value_refresh(dp, container, values);
+	if ((sts = dp->value_refresh(dp, container, values)) >= 0 &&
+	    values->name != NULL)
+	    root_share_container(container, values->name);
+	return sts;
     }
     return PM_ERR_INST;
 }
@@ -141,6 +167,7 @@ root_container_search(const char *query)
 {
     int inst, fuzzy, best = 0;
     char *name = (char *)query;
+    char cid[PMDA_SHARED_VALUELEN];
     container_t *cp = NULL, *found = NULL;
     container_engine_t *dp;
     pmInDom indom = INDOM(CONTAINERS_INDOM);
@@ -153,6 +180,21 @@ root_container_search(const char *query)
 	goto out;
     }
 
+    /*
+     * next fastest - an exact container name resolved earlier, by us
+     * or another PMDA, confirmed by refreshing just that container
+     */
+    if (query && pmdaSharedLookup(shared_names, query, cid, sizeof(cid)) == 0 &&
+	PMDA_CACHE_ACTIVE ==
+	pmdaCacheLookupName(indom, cid, &inst, (void **)&cp) &&
+	root_refresh_container_values(cid, cp) >= 0 &&
+	(best = cp->engine->name_matching(cp->engine, query, cp->name, cid)) >= 99) {
+	name = cid;
+	found = cp;
+	goto out;
+    }
+    best = 0;
+
     for (pmdaCacheOp(indom, PMDA_CACHE_WALK_REWIND);;) {
 	if ((inst = pmdaCacheOp(indom, PMDA_CACHE_WALK_NEXT)) < 0)
 	    break;
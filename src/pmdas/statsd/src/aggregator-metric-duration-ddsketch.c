@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+#include <math.h>
+#include <stdio.h>
+
+#include "utils.h"
+#include "aggregators.h"
+#include "aggregator-metric-duration.h"
+#include "aggregator-metric-duration-ddsketch.h"
+#include "config-reader.h"
+
+/**
+ * Bucket growth factor, every value in bucket i lies in (gamma^(i-1), gamma^i]
+ */
+static const double ddsketch_gamma =
+    (1.0 + DDSKETCH_RELATIVE_ACCURACY) / (1.0 - DDSKETCH_RELATIVE_ACCURACY);
+
+static int
+ddsketch_index(double value) {
+    return (int)ceil(log(value) / log(ddsketch_gamma));
+}
+
+static double
+ddsketch_value(int index) {
+    return 2.0 * pow(ddsketch_gamma, index) / (ddsketch_gamma + 1.0);
+}
+
+/**
+ * Makes sure bins cover given bucket index, collapsing the lowest buckets
+ * if range would grow over DDSKETCH_MAX_BINS
+ * @arg sketch - Target sketch
+ * @arg index - Bucket index to cover
+ * @return position of index in bins
+ */
+static unsigned int
+ddsketch_reserve(struct ddsketch_duration* sketch, int index) {
+    int low, high;
+    unsigned int i, length;
+    unsigned long long* bins;
+
+    if (sketch->length == 0) {
+        low = high = index;
+    } else {
+        if (index >= sketch->offset &&
+            index < sketch->offset + (int)sketch->length) {
+            return index - sketch->offset;
+        }
+        low = index < sketch->offset ? index : sketch->offset;
+        high = sketch->offset + (int)sketch->length - 1;
+        if (index > high) {
+            high = index;
+        }
+    }
+    if (high - low + 1 > DDSKETCH_MAX_BINS) {
+        low = high - DDSKETCH_MAX_BINS + 1;
+    }
+    length = high - low + 1;
+    bins = (unsigned long long*) calloc(length, sizeof(unsigned long long));
+    ALLOC_CHECK(bins, "Unable to allocate memory for duration sketch buckets.");
+    for (i = 0; i < sketch->length; i++) {
+        int current = sketch->offset + (int)i;
+        bins[(current < low ? low : current) - low] += sketch->bins[i];
+    }
+    free(sketch->bins);
+    sketch->bins = bins;
+    sketch->length = length;
+    sketch->offset = low;
+    return index < low ? 0 : index - low;
+}
+
+/**
+ * Creates DDSketch duration value
+ * @arg value - Initial value
+ * @arg out - Placeholder for created sketch
+ */
+void
+create_ddsketch_duration_value(long long unsigned int value, void** out) {
+    struct ddsketch_duration* sketch = (struct ddsketch_duration*) malloc(sizeof(struct ddsketch_duration));
+    ALLOC_CHECK(sketch, "Unable to allocate memory for duration sketch.");
+    *sketch = (struct ddsketch_duration) { 0 };
+    update_ddsketch_duration_value(value, sketch);
+    *out = sketch;
+}
+
+/**
+ * Records value into DDSketch duration value
+ * @arg value - Value to record
+ * @arg sketch - Sketch to update
+ */
+void
+update_ddsketch_duration_value(long long unsigned int value, struct ddsketch_duration* sketch) {
+    double current = (double)value;
+    unsigned int position;
+
+    if (value == 0) {
+        sketch->zero_count += 1;
+    } else {
+        position = ddsketch_reserve(sketch, ddsketch_index(current));
+        sketch->bins[position] += 1;
+    }
+    if (sketch->count == 0 || current < sketch->min) {
+        sketch->min = current;
+    }
+    if (sketch->count == 0 || current > sketch->max) {
+        sketch->max = current;
+    }
+    sketch->count += 1;
+    sketch->sum += current;
+    sketch->sum_of_squares += current * current;
+}
+
+/**
+ * Estimates value at given percentile, result is within DDSKETCH_RELATIVE_ACCURACY of actual value
+ * @arg sketch - Target sketch
+ * @arg percentile - Percentile to get value at
+ * @return estimated value
+ */
+static double
+ddsketch_value_at_percentile(struct ddsketch_duration* sketch, double percentile) {
+    double rank = percentile / 100.0 * (double)(sketch->count - 1);
+    double result = sketch->max;
+    unsigned long long accumulator = sketch->zero_count;
+    unsigned int i;
+
+    if (accumulator > rank) {
+        return 0;
+    }
+    for (i = 0; i < sketch->length; i++) {
+        accumulator += sketch->bins[i];
+        if (accumulator > rank) {
+            result = ddsketch_value(sketch->offset + (int)i);
+            break;
+        }
+    }
+    if (result < sketch->min) {
+        return sketch->min;
+    }
+    if (result > sketch->max) {
+        return sketch->max;
+    }
+    return result;
+}
+
+/**
+ * Gets duration values meta data from sketch
+ * @arg sketch - Target sketch
+ * @arg instance - What information to extract
+ * @return duration instance value
+ */
+double
+get_ddsketch_duration_instance(struct ddsketch_duration* sketch, enum DURATION_INSTANCE instance) {
+    if (sketch == NULL || sketch->count == 0) {
+        return 0;
+    }
+    switch (instance) {
+        case DURATION_MIN:
+            return sketch->min;
+        case DURATION_MAX:
+            return sketch->max;
+        case DURATION_COUNT:
+            return (double)sketch->count;
+        case DURATION_AVERAGE:
+            return sketch->sum / (double)sketch->count;
+        case DURATION_MEDIAN:
+            return ddsketch_value_at_percentile(sketch, 50);
+        case DURATION_PERCENTILE90:
+            return ddsketch_value_at_percentile(sketch, 90);
+        case DURATION_PERCENTILE95:
+            return ddsketch_value_at_percentile(sketch, 95);
+        case DURATION_PERCENTILE99:
+            return ddsketch_value_at_percentile(sketch, 99);
+        case DURATION_STANDARD_DEVIATION:
+        {
+            double average = sketch->sum / (double)sketch->count;
+            double variance = sketch->sum_of_squares / (double)sketch->count - average * average;
+            return variance > 0 ? sqrt(variance) : 0;
+        }
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Prints duration sketch metadata in human readable way
+ * @arg f - Opened file handle, doesn't close it when finished
+ * @arg sketch - Target sketch
+ */
+void
+print_ddsketch_duration_value(FILE* f, struct ddsketch_duration* sketch) {
+    fprintf(f, "min             = %lf\n", get_ddsketch_duration_instance(sketch, DURATION_MIN));
+    fprintf(f, "max             = %lf\n", get_ddsketch_duration_instance(sketch, DURATION_MAX));
+    fprintf(f, "median          = %lf\n", get_ddsketch_duration_instance(sketch, DURATION_MEDIAN));
+    fprintf(f, "average         = %lf\n", get_ddsketch_duration_instance(sketch, DURATION_AVERAGE));
+    fprintf(f, "percentile90    = %lf\n", get_ddsketch_duration_instance(sketch, DURATION_PERCENTILE90));
+    fprintf(f, "percentile95    = %lf\n", get_ddsketch_duration_instance(sketch, DURATION_PERCENTILE95));
+    fprintf(f, "percentile99    = %lf\n", get_ddsketch_duration_instance(sketch, DURATION_PERCENTILE99));
+    fprintf(f, "count           = %lf\n", get_ddsketch_duration_instance(sketch, DURATION_COUNT));
+    fprintf(f, "std deviation   = %lf\n", get_ddsketch_duration_instance(sketch, DURATION_STANDARD_DEVIATION));
+    fprintf(f, "buckets         = %u\n", sketch->length);
+}
+
+/**
+ * Frees DDSketch duration metric value
+ * @arg config
+ * @arg value - value to be freed
+ */
+void
+free_ddsketch_duration_value(struct agent_config* config, void* value) {
+    (void)config;
+    struct ddsketch_duration* sketch = (struct ddsketch_duration*)value;
+    if (sketch != NULL) {
+        free(sketch->bins);
+        free(sketch);
+    }
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+#ifndef AGGREGATOR_DURATION_DDSKETCH_
+#define AGGREGATOR_DURATION_DDSKETCH_
+
+#include <stdio.h>
+
+#include "aggregator-metric-duration.h"
+#include "config-reader.h"
+
+/**
+ * Relative accuracy guaranteed for quantile estimates
+ */
+#define DDSKETCH_RELATIVE_ACCURACY 0.01
+
+/**
+ * Upper bound for number of buckets per sketch, when value range outgrows
+ * this the lowest buckets are collapsed together
+ */
+#define DDSKETCH_MAX_BINS 2048
+
+/**
+ * Represents DDSketch duration aggregation unit - values are counted in
+ * logarithmically sized buckets, bins[i] counts values that map to
+ * bucket index (offset + i)
+ */
+typedef struct ddsketch_duration {
+    unsigned long long* bins;
+    unsigned int length;
+    int offset;
+    unsigned long long zero_count;
+    unsigned long long count;
+    double min;
+    double max;
+    double sum;
+    double sum_of_squares;
+} ddsketch_duration;
+
+/**
+ * Creates DDSketch duration value
+ * @arg value - Initial value
+ * @arg out - Placeholder for created sketch
+ */
+extern void
+create_ddsketch_duration_value(long long unsigned int value, void** out);
+
+/**
+ * Records value into DDSketch duration value
+ * @arg value - Value to record
+ * @arg sketch - Sketch to update
+ */
+extern void
+update_ddsketch_duration_value(long long unsigned int value, struct ddsketch_duration* sketch);
+
+/**
+ * Gets duration values meta data from sketch
+ * @arg sketch - Target sketch
+ * @arg instance - What information to extract
+ * @return duration instance value
+ */
+extern double
+get_ddsketch_duration_instance(struct ddsketch_duration* sketch, enum DURATION_INSTANCE instance);
+
+/**
+ * Prints duration sketch metadata in human readable way
+ * @arg f - Opened file handle, doesn't close it when finished
+ * @arg sketch - Target sketch
+ */
+extern void
+print_ddsketch_duration_value(FILE* f, struct ddsketch_duration* sketch);
+
+/**
+ * Frees DDSketch duration metric value
+ * @arg config
+ * @arg value - value to be freed
+ */
+extern void
+free_ddsketch_duration_value(struct agent_config* config, void* value);
+
+#endif
@@ -21,6 +21,7 @@
 #include "aggregator-metrics.h"
 #include "aggregator-metric-duration-exact.h"
 #include "aggregator-metric-duration-hdr.h"
+#include "aggregator-metric-duration-ddsketch.h"
 
 /**
  * Creates duration value in given dest
@@ -31,7 +32,7 @@ create_duration_value(struct agent_config* config, struct statsd_datagram* datag
 
 /**
  * Updates duration metric record of value subtype
- * @arg config - Config from which we know what duration type is, either HDR or exact
+ * @arg config - Config from which we know what duration type is, either HDR, DDSketch or exact
  * @arg item - Item to be updated
  * @arg datagram - Data to update the item with
  * @return 1 on success, 0 on fail
@@ -42,7 +43,7 @@ update_duration_value(struct agent_config* config, struct statsd_datagram* datag
 /**
  * Extracts duration metric meta values from duration metric record
  * @arg config - Config which contains info on which duration aggregating type we are using
- * @arg value - Either "struct exact_duration_collection*" or "struct hdr_histogram*", basically value from metric that has type of "duration"
+ * @arg value - Either "struct exact_duration_collection*", "struct hdr_histogram*" or "struct ddsketch_duration*", basically value from metric that has type of "duration"
  * @arg instance - What information to extract
  * @return duration instance value
  */
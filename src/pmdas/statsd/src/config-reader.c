@@ -28,6 +28,7 @@ static void
 set_default_config(struct agent_config* config) {
     config->max_udp_packet_size = 1472;
     config->max_unprocessed_packets = 2048;
+    config->listener_threads = 1;
     config->verbose = 0;
     config->debug_output_filename = (char*) malloc(sizeof(char) * 6);
     ALLOC_CHECK(config->debug_output_filename, "Unable to allocate memory for debug output filename");
@@ -67,6 +68,11 @@ ini_line_handler(void* user, const char* section, const char* name, const char*
         if (param < UINT32_MAX) {
             dest->max_unprocessed_packets = (unsigned int) param;
         }
+    } else if (MATCH("listener_threads")) {
+        long unsigned int param = strtoul(value, NULL, 10);
+        if (param >= 1 && param <= MAX_LISTENER_THREADS) {
+            dest->listener_threads = (unsigned int) param;
+        }
     } else if (MATCH("port")) {
         long unsigned int param = strtoul(value, NULL, 10);
         if (param < UINT32_MAX) {
@@ -140,11 +146,12 @@ read_agent_config_cmd(pmdaInterface* dispatch, struct agent_config* dest, int ar
         { "parser-type", 1, 'r', "PARSER-TYPE", "Parser type to use (ragel = 1, basic = 0)" },
         { "duration-aggregation-type", 1, 'a', "DURATION-AGGREGATION-TYPE", "Aggregation type for duration metric to use (hdr_histogram = 1, basic histogram = 0)" },
         { "max-unprocessed-packets-size:", 1, 'z', "MAX-UNPROCESSED-PACKETS-SIZE", "Maximum count of unprocessed packets." },
+        { "listener-threads", 1, 't', "LISTENER-THREADS", "Number of network listener threads" },
         PMDA_OPTIONS_END
     };
 
     static pmdaOptions opts = {
-        .short_options = "D:d:l:U:v:so:Z:P:r:a:z:?",
+        .short_options = "D:d:l:U:v:so:Z:P:r:a:z:t:?",
         .long_options = longopts,
     };
     while(1) {
@@ -220,6 +227,16 @@ read_agent_config_cmd(pmdaInterface* dispatch, struct agent_config* dest, int ar
                 }
                 break;
             }
+            case 't':
+            {
+                long unsigned int param = strtoul(opts.optarg, NULL, 10);
+                if (param >= 1 && param <= MAX_LISTENER_THREADS) {
+                    dest->listener_threads = (unsigned int) param;
+                } else {
+                    pmNotifyErr(LOG_INFO, "listener_threads option value is out of bounds.");
+                }
+                break;
+            }
         }
     }
     if (opts.errors) {
@@ -246,7 +263,9 @@ print_agent_config(struct agent_config* config) {
     pmNotifyErr(LOG_INFO, "parser_type: %s \n", config->parser_type == PARSER_TYPE_BASIC ? "BASIC" : "RAGEL");
     pmNotifyErr(LOG_INFO, "maximum of unprocessed packets: %d \n", config->max_unprocessed_packets);
     pmNotifyErr(LOG_INFO, "maximum udp packet size: %ld \n", config->max_udp_packet_size);
+    pmNotifyErr(LOG_INFO, "listener threads: %d \n", config->listener_threads);
     pmNotifyErr(LOG_INFO, "duration_aggregation_type: %s\n", 
-        config->duration_aggregation_type == DURATION_AGGREGATION_TYPE_HDR_HISTOGRAM ? "HDR_HISTOGRAM" : "BASIC");
+        config->duration_aggregation_type == DURATION_AGGREGATION_TYPE_HDR_HISTOGRAM ? "HDR_HISTOGRAM" :
+        config->duration_aggregation_type == DURATION_AGGREGATION_TYPE_DDSKETCH ? "DDSKETCH" : "BASIC");
     pmNotifyErr(LOG_INFO, "</settings>\n");
 }
@@ -28,9 +28,15 @@ typedef enum PARSER_TYPE {
 
 typedef enum DURATION_AGGREGATION_TYPE {
     DURATION_AGGREGATION_TYPE_BASIC = 0,
-    DURATION_AGGREGATION_TYPE_HDR_HISTOGRAM = 1
+    DURATION_AGGREGATION_TYPE_HDR_HISTOGRAM = 1,
+    DURATION_AGGREGATION_TYPE_DDSKETCH = 2
 } DURATION_AGGREGATION_TYPE;
 
+/**
+ * Upper bound for number of network listener threads
+ */
+#define MAX_LISTENER_THREADS 64
+
 typedef struct agent_config {
     enum DURATION_AGGREGATION_TYPE duration_aggregation_type;
     enum PARSER_TYPE parser_type;
@@ -38,6 +44,7 @@ typedef struct agent_config {
     unsigned int verbose;
     unsigned int show_version;
     unsigned int max_unprocessed_packets;
+    unsigned int listener_threads;
     unsigned int port;
     char* debug_output_filename;
     char* username;
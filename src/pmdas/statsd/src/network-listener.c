@@ -22,6 +22,8 @@
 #include <chan/chan.h>
 #include <pthread.h>
 #include <sys/types.h>
+#include <sys/socket.h>
+#include <unistd.h>
 #include <signal.h>
 
 #include "network-listener.h"
@@ -30,9 +32,28 @@
 #include "utils.h"
 #include "config-reader.h"
 
+/**
+ * Creates an unprocessed datagram, the payload is stored in the same allocation
+ * @arg value - Payload
+ * @arg length - Payload length
+ * @return unprocessed_statsd_datagram
+ */
+static struct unprocessed_statsd_datagram*
+create_unprocessed_datagram(const char* value, size_t length) {
+    struct unprocessed_statsd_datagram* datagram =
+        (struct unprocessed_statsd_datagram*) malloc(sizeof(struct unprocessed_statsd_datagram) + length + 1);
+    ALLOC_CHECK(datagram, "Unable to assign memory for struct representing unprocessed datagrams.");
+    datagram->value = (char*) (datagram + 1);
+    memcpy(datagram->value, value, length);
+    datagram->value[length] = '\0';
+    return datagram;
+}
+
 /**
  * Thread entrypoint - listens on address and port specified in config 
- * for UDP/TCP containing StatsD payload and then sends it over to parser thread for parsing
+ * for UDP/TCP containing StatsD payload and then sends it over to parser thread for parsing.
+ * When more than one listener thread is configured, each binds its own SO_REUSEPORT socket
+ * and the kernel spreads incoming datagrams between them.
  * @arg args - network_listener_args
  */
 void*
@@ -60,6 +81,12 @@ network_listener_exec(void* args) {
     if (fd == -1) {
         DIE("failed creating socket (err=%s)", strerror(errno));
     }
+    if (config->listener_threads > 1) {
+        int on = 1;
+        if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) == -1) {
+            DIE("failed setting SO_REUSEPORT on socket (err=%s)", strerror(errno));
+        }
+    }
     if (bind(fd, res->ai_addr, res->ai_addrlen) == -1) {
         DIE("failed binding socket (err=%s)", strerror(errno));
     }
@@ -69,54 +96,64 @@ network_listener_exec(void* args) {
     struct timeval tv;
     freeaddrinfo(res);
     int max_udp_packet_size = config->max_udp_packet_size;
-    char *buffer = (char *) malloc(max_udp_packet_size * sizeof(char));
-    struct sockaddr_storage src_addr;
-    socklen_t src_addr_len = sizeof(src_addr);
-    int rv;
-    while(1) {
+    // receive up to LISTENER_BATCH_SIZE datagrams per recvmmsg call
+    char *buffer = (char *) malloc(LISTENER_BATCH_SIZE * max_udp_packet_size * sizeof(char));
+    ALLOC_CHECK(buffer, "Unable to assign memory for datagram buffers.");
+    struct mmsghdr messages[LISTENER_BATCH_SIZE];
+    struct iovec iovecs[LISTENER_BATCH_SIZE];
+    int i, rv, done = 0;
+    memset(messages, 0, sizeof(messages));
+    for (i = 0; i < LISTENER_BATCH_SIZE; i++) {
+        iovecs[i].iov_base = buffer + i * max_udp_packet_size;
+        iovecs[i].iov_len = max_udp_packet_size;
+        messages[i].msg_hdr.msg_iov = &iovecs[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+    while(!done) {
         FD_ZERO(&readfds);
         FD_SET(fd, &readfds);
         tv.tv_sec = 1;
         tv.tv_usec = 0;
         rv = select(fd + 1, &readfds, NULL, NULL, &tv);
-        if (rv == 1) {
-            ssize_t count = recvfrom(fd, buffer, max_udp_packet_size, 0, (struct sockaddr*)&src_addr, &src_addr_len);
-            if (count == -1) {
+        if (rv != 1) {
+            int exit_flag = check_exit_flag();
+            if (exit_flag) {        
+                break;
+            }
+            continue;
+        }
+        // drain the socket before waiting again
+        do {
+            rv = recvmmsg(fd, messages, LISTENER_BATCH_SIZE, MSG_DONTWAIT, NULL);
+            if (rv == -1) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                    break;
+                }
                 DIE("%s", strerror(errno));
-            } 
-            // since we checked for -1
-            else if ((signed int)count == max_udp_packet_size) { 
-                VERBOSE_LOG(2, "Datagram too large for buffer: truncated and skipped");
-            } else {
-                struct unprocessed_statsd_datagram* datagram = (struct unprocessed_statsd_datagram*) malloc(sizeof(struct unprocessed_statsd_datagram));
-                ALLOC_CHECK(datagram, "Unable to assign memory for struct representing unprocessed datagrams.");
-                datagram->value = (char*) malloc(sizeof(char) * (count + 1));
-                ALLOC_CHECK(datagram->value, "Unable to assign memory for datagram value.");
-                memcpy(datagram->value, buffer, count);
-                datagram->value[count] = '\0';
+            }
+            for (i = 0; i < rv; i++) {
+                unsigned int count = messages[i].msg_len;
+                // since we checked for -1
+                if ((signed int)count == max_udp_packet_size) { 
+                    VERBOSE_LOG(2, "Datagram too large for buffer: truncated and skipped");
+                    continue;
+                }
+                struct unprocessed_statsd_datagram* datagram =
+                    create_unprocessed_datagram(iovecs[i].iov_base, count);
                 if (strcmp(end_message, datagram->value) == 0) {
                     free_unprocessed_datagram(datagram);
                     kill(getpid(), SIGINT);
+                    done = 1;
                     break;
                 }
                 chan_send(network_listener_to_parser, datagram);
             }
-            memset(buffer, 0, max_udp_packet_size);
-            rv = 0;
-        } else {
-            int exit_flag = check_exit_flag();
-            if (exit_flag) {        
-                break;
-            }
-        }
+        } while (!done && rv == LISTENER_BATCH_SIZE);
     }
     VERBOSE_LOG(2, "Network listener thread exiting.");
-    struct unprocessed_statsd_datagram* datagram = (struct unprocessed_statsd_datagram*) malloc(sizeof(struct unprocessed_statsd_datagram));
-    ALLOC_CHECK(datagram, "Unable to assign memory for struct representing unprocessed datagrams.");
-    size_t length = strlen(end_message) + 1;
-    datagram->value = (char*) malloc(sizeof(char) * length);
-    memcpy(datagram->value, end_message, length);
-    chan_send(network_listener_to_parser, datagram);
+    close(fd);
+    chan_send(network_listener_to_parser,
+        create_unprocessed_datagram(end_message, strlen(end_message)));
     free(buffer);
     pthread_exit(NULL);
 }
@@ -127,12 +164,7 @@ network_listener_exec(void* args) {
  */
 void
 free_unprocessed_datagram(struct unprocessed_statsd_datagram* datagram) {
-    if (datagram != NULL) {
-        if (datagram->value != NULL) {
-            free(datagram->value);
-        }
-        free(datagram);
-    }
+    free(datagram);
 }
 
 /**
@@ -20,9 +20,14 @@
 
 #include "config-reader.h"
 
+/**
+ * Maximum number of datagrams read by a listener thread per recvmmsg call
+ */
+#define LISTENER_BATCH_SIZE 32
+
 typedef struct unprocessed_statsd_datagram
 {
-    char* value;
+    char* value; // points just past the struct, allocated together
 } unprocessed_statsd_datagram;
 
 typedef struct network_listener_args
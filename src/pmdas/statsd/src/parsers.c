@@ -49,6 +49,7 @@ parser_exec(void* args) {
     char delim[] = "\n";
     struct timespec t0, t1;
     unsigned long time_spent_parsing;
+    unsigned int listeners_running = config->listener_threads;
     int should_exit;
     while(1) {
         should_exit = check_exit_flag();
@@ -60,7 +61,11 @@ parser_exec(void* args) {
         if (strcmp(datagram->value, network_end_message) == 0) {
             VERBOSE_LOG(2, "Got network end message.");
             free_unprocessed_datagram(datagram);
-            break;
+            // wait for every listener thread, so none blocks sending to us
+            if (--listeners_running == 0) {
+                break;
+            }
+            continue;
         }
         if (should_exit) {
             VERBOSE_LOG(2, "Freeing datagrams after exit.");
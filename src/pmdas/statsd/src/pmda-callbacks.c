@@ -359,17 +359,19 @@ map_metric(char* key, struct metric* item, void* pmda) {
     // this prevents creating of metrics/labels that have tags as we don't deal with those yet
     struct pmda_data_extension* data = (struct pmda_data_extension*)pmdaExtGetData((pmdaExt*)pmda);
     // lets check if metric already has pmid assigned, if not create new metric for it (including new pmid)
+    // (metrics mapped on an earlier reload are already in the PMNS)
     if (item->meta->pmid == PM_ID_NULL) {
         create_pcp_metric(key, item, (pmdaExt*)pmda);
+        data->pcp_metric_count += 1;
+        pmdaTreeInsert(data->pcp_pmns, item->meta->pmid, item->meta->pcp_name);
+        data->notify |= PMDA_EXT_NAMES_CHANGE;
+        VERBOSE_LOG(1, "Populated PMNS with %d, %s .", item->meta->pmid, item->meta->pcp_name);
     }
     // pcp_instance_change_requested flag is set, when metric gets new metric_label
     if (item->meta->pcp_instance_change_requested == 1) {
         update_pcp_metric_instance_domain(key, item, (pmdaExt*)pmda);
     }
-    data->pcp_metric_count += 1;
     process_stat(data->config, data->stats_storage, STAT_TRACKED_METRIC, (void*)item->type);
-    VERBOSE_LOG(1, "Populated PMNS with %d, %s .", item->meta->pmid, item->meta->pcp_name);
-    pmdaTreeInsert(data->pcp_pmns, item->meta->pmid, item->meta->pcp_name);
 }
 
 static void
@@ -409,24 +411,25 @@ insert_hardcoded_metrics(pmdaExt* pmda) {
 
 /**
  * Maps all stats (both hardcoded and the ones aggregated from StatsD datagrams) to 
+ * the PMNS. The PMNS is created on the first call only, later calls just insert
+ * names of metrics received since, so the cost of a reload no longer grows with
+ * the number of metrics already known.
  */
 static void
 statsd_map_stats(pmdaExt* pmda) {
     struct pmda_data_extension* data = (struct pmda_data_extension*) pmdaExtGetData(pmda);
     int status = 0;
-    if (data->pcp_pmns) {
-        pmdaTreeRelease(data->pcp_pmns);
-        VERBOSE_LOG(1, "Released PMNS.");
-        data->notify |= PMDA_EXT_NAMES_CHANGE; 
+    if (data->pcp_pmns == NULL) {
+        status = pmdaTreeCreate(&data->pcp_pmns);
+        if (status < 0) {
+            VERBOSE_LOG(1, "%s: failed to create new pmns: %s\n", pmGetProgname(), pmErrStr(status));
+            data->pcp_pmns = NULL;
+            return;
+        }
+        insert_hardcoded_metrics(pmda);
+        data->pcp_pmns_hashed = 0;
     }
-    status = pmdaTreeCreate(&data->pcp_pmns);
-    if (status < 0) {
-        VERBOSE_LOG(1, "%s: failed to create new pmns: %s\n", pmGetProgname(), pmErrStr(status));
-        data->pcp_pmns = NULL;
-        return;
-    } 
     reset_stat(data->config, data->stats_storage, STAT_TRACKED_METRIC);
-    insert_hardcoded_metrics(pmda);
     struct pmda_metrics_container* container = data->metrics_storage;
     pthread_mutex_lock(&container->mutex);
     metrics* m = container->metrics;
@@ -441,7 +444,11 @@ statsd_map_stats(pmdaExt* pmda) {
     data->generation = data->metrics_storage->generation;
     pthread_mutex_unlock(&container->mutex);
 
-    pmdaTreeRebuildHash(data->pcp_pmns, data->pcp_metric_count);
+    // pmdaTreeInsert adds to an existing hash, resize once it has doubled
+    if (data->pcp_metric_count >= 2 * data->pcp_pmns_hashed) {
+        pmdaTreeRebuildHash(data->pcp_pmns, data->pcp_metric_count);
+        data->pcp_pmns_hashed = data->pcp_metric_count;
+    }
 }
 
 /**
@@ -915,10 +922,15 @@ statsd_resolve_static_metric_fetch(pmdaMetric* mdesc, unsigned int instance, pmA
             char* result;
             char* basic = "Basic";
             char* ragel = "HDR histogram";
+            char* ddsketch = "DDSketch";
             if (config->duration_aggregation_type == DURATION_AGGREGATION_TYPE_BASIC) {
                 result = (char*) malloc(sizeof(char) * 6);
                 ALLOC_CHECK(result, "Unable to allocate memory for duration aggregation type value.");
                 memcpy(result, basic, 6);
+            } else if (config->duration_aggregation_type == DURATION_AGGREGATION_TYPE_DDSKETCH) {
+                result = (char*) malloc(sizeof(char) * 9);
+                ALLOC_CHECK(result, "Unable to allocate memory for duration aggregation type value.");
+                memcpy(result, ddsketch, 9);
             } else {
                 result = (char*) malloc(sizeof(char) * 14);
                 ALLOC_CHECK(result, "Unable to allocate memory for duration aggregation type value.");
@@ -254,7 +254,7 @@ main_PDU_loop(pmdaInterface* dispatch) {
 }
 
 static int _isDSO = 1; /* for local contexts */
-static pthread_t network_listener;
+static pthread_t* network_listeners;
 static pthread_t aggregator;
 static pthread_t parser;
 static chan_t* network_listener_to_parser;
@@ -274,6 +274,7 @@ statsd_init(pmdaInterface *dispatch)
     struct pmda_metrics_container* metricsp;
     struct pmda_stats_container* statsp;
     int pthread_errno, sep = pmPathSeparator();
+    unsigned int i;
 
     if (_isDSO) {
         pmsprintf(
@@ -308,8 +309,12 @@ statsd_init(pmdaInterface *dispatch)
     aggregator_thread_args = create_aggregator_args(&config, parser_to_aggregator, metricsp, statsp);
 
     pthread_errno = 0; 
-    pthread_errno = pthread_create(&network_listener, NULL, network_listener_exec, listener_thread_args);
-    PTHREAD_CHECK(pthread_errno);
+    network_listeners = (pthread_t*) malloc(config.listener_threads * sizeof(pthread_t));
+    ALLOC_CHECK(network_listeners, "Unable to assign memory for network listener threads.");
+    for (i = 0; i < config.listener_threads; i++) {
+        pthread_errno = pthread_create(&network_listeners[i], NULL, network_listener_exec, listener_thread_args);
+        PTHREAD_CHECK(pthread_errno);
+    }
     pthread_errno = pthread_create(&parser, NULL, parser_exec, parser_thread_args);
     PTHREAD_CHECK(pthread_errno);
     pthread_errno = pthread_create(&aggregator, NULL, aggregator_exec, aggregator_thread_args);
@@ -343,11 +348,15 @@ statsd_init(pmdaInterface *dispatch)
 
 static void
 statsd_done(void) {    
-    if (pthread_join(network_listener, NULL) != 0) {
-        DIE("Error joining network network listener thread.");
-    } else {
-        VERBOSE_LOG(2, "Network listener thread joined.");
+    unsigned int i;
+    for (i = 0; i < config.listener_threads; i++) {
+        if (pthread_join(network_listeners[i], NULL) != 0) {
+            DIE("Error joining network network listener thread.");
+        } else {
+            VERBOSE_LOG(2, "Network listener thread joined.");
+        }
     }
+    free(network_listeners);
     if (pthread_join(parser, NULL) != 0) {
         DIE("Error joining datagram parser thread.");
     } else {
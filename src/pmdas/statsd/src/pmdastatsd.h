@@ -40,6 +40,7 @@ extern struct pmda_data_extension {
     pmdaMetric* pcp_metrics;
     pmdaIndom* pcp_instance_domains;
     pmdaNameSpace* pcp_pmns;
+    size_t pcp_pmns_hashed; // metric count when PMNS hash was last built
     dict* instance_map;
     size_t pcp_instance_domain_count;
     size_t pcp_metric_count;
@@ -0,0 +1,248 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include <ctype.h>
+#include "pmapi.h"
+#include "libpcp.h"
+#include "pmda.h"
+#include "summary.h"
+
+/*
+ * In-process evaluation of the summary expressions.  Rather than a pmie
+ * child process sending values back over a pipe, each expression is
+ * registered as a derived metric and evaluated against a local context
+ * (DSO PMDAs only - a PMDA cannot fetch from its own pmcd while pmcd is
+ * waiting on it).  Evaluation is lazy, happening only when summary
+ * metrics are fetched and at most once per summary_interval, so rate
+ * conversion is over at least that interval and all the operands of
+ * all the expressions are fetched together.
+ *
+ * An expression with an instance domain is averaged over its instances,
+ * like pmie's avg_inst, so a relational expression (one or zero for each
+ * instance) gives the proportion of instances for which it is true.
+ */
+
+#define DERIVE_PREFIX	"pmdasummary."
+
+struct timeval	summary_interval = { 10, 0 };
+
+static int		ctx = -1;	/* local context, -1 if not in use */
+static int		nexpr;
+static pmID		*dpmids;	/* derived metric for each expression */
+static pmID		*pmids;		/* and the summary metric it exports */
+static int		*dtypes;	/* and the type of the derived metric */
+static struct timeval	last;		/* when last evaluated */
+static int		novalues;	/* some expression had no values */
+
+/* trim leading and trailing white space, in place */
+static char *
+trim(char *p)
+{
+    char	*q;
+
+    while (isspace((int)*p))
+	p++;
+    for (q = p + strlen(p); q > p && isspace((int)q[-1]); q--)
+	;
+    *q = '\0';
+    return p;
+}
+
+/*
+ * Export a derived metric as the summary metric name, which must
+ * already be in the PMNS, with a singular double value
+ */
+static int
+derive_export(const char *name, const char *dname)
+{
+    pmID	pmid;
+    pmID	dpmid;
+    pmDesc	desc;
+    int		sts;
+
+    if ((sts = pmLookupName(1, &name, &pmid)) < 0) {
+	pmNotifyErr(LOG_ERR, "summary: %s: %s\n", name, pmErrStr(sts));
+	return sts;
+    }
+    if ((sts = pmLookupName(1, &dname, &dpmid)) < 0 ||
+	(sts = pmLookupDesc(dpmid, &desc)) < 0) {
+	pmNotifyErr(LOG_ERR, "summary: %s expression: %s\n", name, pmErrStr(sts));
+	return sts;
+    }
+    if ((meta = (meta_t *)realloc(meta, (nmeta+1) * sizeof(meta_t))) == NULL ||
+	(dpmids = (pmID *)realloc(dpmids, (nexpr+1) * sizeof(pmID))) == NULL ||
+	(pmids = (pmID *)realloc(pmids, (nexpr+1) * sizeof(pmID))) == NULL ||
+	(dtypes = (int *)realloc(dtypes, (nexpr+1) * sizeof(int))) == NULL)
+	pmNoMem("summary_derive_init", (nexpr+1) * sizeof(meta_t), PM_FATAL_ERR);
+    meta[nmeta].name = strdup(name);
+    meta[nmeta].desc = desc;		/* struct assignment */
+    meta[nmeta].desc.pmid = pmid;
+    meta[nmeta].desc.indom = PM_INDOM_NULL;
+    meta[nmeta].desc.type = PM_TYPE_DOUBLE;
+    meta[nmeta].desc.sem = PM_SEM_INSTANT;
+    nmeta++;
+    dpmids[nexpr] = dpmid;
+    pmids[nexpr] = pmid;
+    dtypes[nexpr] = desc.type;
+    nexpr++;
+    return 0;
+}
+
+/*
+ * Load the expressions from config, one "name = expression" per line
+ * with # comments, and set up the local context to evaluate them
+ */
+int
+summary_derive_init(const char *config)
+{
+    FILE	*f;
+    char	line[1024];
+    char	dname[MAXPATHLEN];
+    char	*name;
+    char	*expr;
+    char	*errmsg;
+    char	*p;
+    char	**names = NULL;
+    char	**dnames = NULL;
+    int		nnames = 0;
+    int		lineno = 0;
+    int		sts = 0;
+    int		i;
+
+    if ((f = fopen(config, "r")) == NULL) {
+	sts = -oserror();
+	pmNotifyErr(LOG_ERR, "summary: cannot open %s: %s\n", config, pmErrStr(sts));
+	return sts;
+    }
+    while (fgets(line, sizeof(line), f) != NULL) {
+	lineno++;
+	if ((p = strchr(line, '#')) != NULL)
+	    *p = '\0';
+	name = trim(line);
+	if (*name == '\0')
+	    continue;
+	if ((p = strchr(name, '=')) == NULL) {
+	    pmNotifyErr(LOG_ERR, "summary: %s[%d]: missing '='\n", config, lineno);
+	    continue;
+	}
+	*p = '\0';
+	expr = trim(p + 1);
+	name = trim(name);
+	pmsprintf(dname, sizeof(dname), "%s%s", DERIVE_PREFIX, name);
+	if (pmRegisterDerivedMetric(dname, expr, &errmsg) < 0) {
+	    pmNotifyErr(LOG_ERR, "summary: %s[%d]: %s\n", config, lineno, errmsg);
+	    free(errmsg);
+	    continue;
+	}
+	if ((names = (char **)realloc(names, (nnames+1) * sizeof(char *))) == NULL ||
+	    (dnames = (char **)realloc(dnames, (nnames+1) * sizeof(char *))) == NULL)
+	    pmNoMem("summary_derive_init", (nnames+1) * sizeof(char *), PM_FATAL_ERR);
+	names[nnames] = strdup(name);
+	dnames[nnames] = strdup(dname);
+	nnames++;
+    }
+    fclose(f);
+
+    if ((ctx = pmNewContext(PM_CONTEXT_LOCAL, NULL)) < 0) {
+	sts = ctx;
+	pmNotifyErr(LOG_ERR, "summary: cannot create local context: %s\n", pmErrStr(sts));
+    }
+    for (i = 0; i < nnames; i++) {
+	if (ctx >= 0)
+	    derive_export(names[i], dnames[i]);
+	free(names[i]);
+	free(dnames[i]);
+    }
+    free(names);
+    free(dnames);
+    if (sts < 0)
+	return sts;
+    if (nexpr == 0) {
+	pmNotifyErr(LOG_ERR, "summary: no usable expressions in %s\n", config);
+	return PM_ERR_VALUE;
+    }
+
+    /* prime any rate or delta conversions with an initial fetch */
+    summary_derive_fetch();
+    return nexpr;
+}
+
+void
+summary_derive_fetch(void)
+{
+    struct timeval	now;
+    pmResult		*rp;
+    __pmResult		*cp;
+    pmValueSet		*vsp;
+    pmAtomValue		atom;
+    double		sum;
+    int			i;
+    int			j;
+    int			sts;
+
+    if (ctx < 0)
+	return;
+    /*
+     * cached values are used until the interval has passed, unless
+     * there were none (e.g. rates just after the priming fetch)
+     */
+    pmtimevalNow(&now);
+    if (last.tv_sec != 0 && !novalues &&
+	pmtimevalSub(&now, &last) < pmtimevalToReal(&summary_interval))
+	return;
+
+    if ((sts = pmUseContext(ctx)) < 0 ||
+	(sts = pmFetch(nexpr, dpmids, &rp)) < 0) {
+	pmNotifyErr(LOG_ERR, "summary: fetch failed: %s\n", pmErrStr(sts));
+	return;
+    }
+    last = now;
+
+    if ((cp = __pmAllocResult(nexpr)) == NULL) {
+	pmFreeResult(rp);
+	return;
+    }
+    cp->numpmid = nexpr;
+    novalues = 0;
+    for (i = 0; i < nexpr; i++) {
+	if ((vsp = (pmValueSet *)malloc(sizeof(pmValueSet))) == NULL)
+	    pmNoMem("summary_derive_fetch", sizeof(pmValueSet), PM_FATAL_ERR);
+	vsp->pmid = pmids[i];
+	vsp->valfmt = PM_VAL_INSITU;
+	vsp->numval = rp->vset[i]->numval;
+	if (vsp->numval > 0) {
+	    vsp->numval = 1;
+	    vsp->vlist[0].inst = PM_IN_NULL;
+	    for (sum = 0, j = 0; j < rp->vset[i]->numval; j++) {
+		sts = pmExtractValue(rp->vset[i]->valfmt, &rp->vset[i]->vlist[j],
+				     dtypes[i], &atom, PM_TYPE_DOUBLE);
+		if (sts < 0)
+		    break;
+		sum += atom.d;
+	    }
+	    atom.d = sum / rp->vset[i]->numval;
+	    if (sts >= 0)
+		sts = __pmStuffValue(&atom, &vsp->vlist[0], PM_TYPE_DOUBLE);
+	    if (sts < 0)
+		vsp->numval = sts;
+	    else
+		vsp->valfmt = sts;
+	}
+	if (vsp->numval <= 0)
+	    novalues = 1;
+	cp->vset[i] = vsp;
+    }
+    pmFreeResult(rp);
+    summary_cache(cp);
+}
@@ -71,12 +71,13 @@ summaryMainLoop(char *pmdaname, int clientfd, pmdaInterface *dtp)
     for ( ;; ) {
 	FD_ZERO(&readFds);
 	FD_SET(infd, &readFds);
-	FD_SET(clientfd, &readFds);
+	if (clientfd >= 0)
+	    FD_SET(clientfd, &readFds);
 
 	/* select here : block if nothing to do */
 	sts = select(maxfd, &readFds, NULL, NULL, NULL);
 
-	clientReady = FD_ISSET(clientfd, &readFds);
+	clientReady = clientfd >= 0 && FD_ISSET(clientfd, &readFds);
 	pmcdReady = FD_ISSET(infd, &readFds);
 
 	if (sts < 0)
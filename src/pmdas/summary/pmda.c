@@ -38,21 +38,35 @@ main(int argc, char **argv)
     char		helpfile[MAXPATHLEN]; 
     int			cmdpipe;		/* metric source/cmd pipe */
     char		*command = NULL;
+    char		*config = NULL;
+    char		*endnum;
     char		*username;
 
     pmSetProgname(argv[0]);
     pmGetUsername(&username);
-    __pmSetInternalState(PM_STATE_PMCS);  /* we are below the PMAPI */
 
     pmsprintf(helpfile, sizeof(helpfile), "%s%c" "summary" "%c" "help",
 		pmGetConfig("PCP_PMDAS_DIR"), sep, sep);
     pmdaDaemon (&dispatch, PMDA_INTERFACE_2, pmGetProgname(), SYSSUMMARY,
 		"summary.log", helpfile);
 
-    while ((c = pmdaGetOpt(argc, argv, "H:h:D:d:l:U:",
+    while ((c = pmdaGetOpt(argc, argv, "c:H:h:D:d:l:t:U:",
 			   &dispatch, &errflag)) != EOF) {
 	switch (c) {
 
+	    case 'c':		/* evaluate expressions in-process */
+		config = optarg;
+		break;
+
+	    case 't':		/* minimum interval between evaluations */
+		if (pmParseInterval(optarg, &summary_interval, &endnum) < 0) {
+		    fprintf(stderr, "%s: -t argument not in pmParseInterval(3) format:\n%s\n",
+			    pmGetProgname(), endnum);
+		    free(endnum);
+		    errflag++;
+		}
+		break;
+
 	    case 'H':		/* backwards compatibility, synonym for -h */
 		dispatch.version.two.ext->e_helptext = optarg;
 		break;
@@ -70,8 +84,15 @@ main(int argc, char **argv)
     for (len=0, i=optind; i < argc; i++) {
 	len += strlen(argv[i]) + 1;
     }
-    if (len == 0) {
-	fprintf(stderr, "%s: a command must be given after the options\n",
+    if (config != NULL) {
+	if (len != 0) {
+	    fprintf(stderr, "%s: no command is used with -c\n",
+		    pmGetProgname());
+	    errflag++;
+	}
+    }
+    else if (len == 0) {
+	fprintf(stderr, "%s: a command or -c must be given after the options\n",
 		pmGetProgname());
 	errflag++;
     }
@@ -87,12 +108,15 @@ main(int argc, char **argv)
     commandArgv = argv + optind;
 
     if (errflag) {
-	fprintf(stderr, "Usage: %s [options] command [arg ...]\n\n",
-		pmGetProgname());
+	fprintf(stderr, "Usage: %s [options] command [arg ...]\n"
+			"       %s [options] -c config\n\n",
+		pmGetProgname(), pmGetProgname());
 	fputs("Options:\n"
+	      "  -c config      evaluate expressions from config in-process\n"
 	      "  -h helpfile    help text file\n"
 	      "  -d domain      use domain (numeric) for metrics domain of PMDA\n"
 	      "  -l logfile     write log into logfile rather than using default log name\n"
+	      "  -t interval    with -c, minimum interval between evaluations [10 sec]\n"
 	      "  -U username    user account to run under (default \"pcp\")\n",
 	      stderr);		
 	exit(1);
@@ -107,6 +131,25 @@ main(int argc, char **argv)
     /* initialize */
     summary_init(&dispatch);
 
+    if (config != NULL) {
+	/*
+	 * derived metrics are evaluated here, so no command, and
+	 * (unlike a command) we need the PMAPI for that
+	 */
+	if (summary_derive_init(config) < 0)
+	    exit(1);
+	pmdaConnect(&dispatch);
+	if (dispatch.status) {
+	    fprintf(stderr, "Cannot connect to pmcd: %s\n",
+		    pmErrStr(dispatch.status));
+	    exit(1);
+	}
+	summaryMainLoop(pmGetProgname(), -1, &dispatch);
+	summary_done();
+	exit(0);
+    }
+    __pmSetInternalState(PM_STATE_PMCS);  /* we are below the PMAPI */
+
     pmdaConnect(&dispatch);
     if (dispatch.status) {
 	fprintf (stderr, "Cannot connect to pmcd: %s\n",
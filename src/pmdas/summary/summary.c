@@ -52,16 +52,73 @@ found:
     return PM_ERR_PMID;
 }
 
+/*
+ * Merge the values in resp into cachedResult, which takes ownership
+ * of the new value sets, and release the old ones along with resp
+ */
+void
+summary_cache(__pmResult *resp)
+{
+    int		i;
+    int		j;
+    pmValueSet	*vsp;
+
+    if (cachedResult == NULL) {
+	int		need;
+	need = (int)sizeof(pmResult) - (int)sizeof(pmValueSet *);
+	if ((cachedResult = (pmResult *)malloc(need)) == NULL) {
+	    pmNoMem("summary_cache: result malloc", need, PM_FATAL_ERR);
+	}
+	cachedResult->numpmid = 0;
+    }
+
+    /*
+     * swap values from resp with those in cachedResult, expanding
+     * cachedResult if there are metrics we've not seen before
+     */
+    for (i = 0; i < resp->numpmid; i++) {
+	for (j = 0; j < cachedResult->numpmid; j++) {
+	    if (resp->vset[i]->pmid == cachedResult->vset[j]->pmid) {
+		/* found matching PMID, update this value */
+		break;
+	    }
+	}
+
+	if (j == cachedResult->numpmid) {
+	    /* new PMID, expand cachedResult and initialize vset */
+	    int		need;
+	    cachedResult->numpmid++;
+	    need = (int)sizeof(pmResult) +
+		(cachedResult->numpmid-1) * (int)sizeof(pmValueSet *);
+	    if ((cachedResult = (pmResult *)realloc(cachedResult, need)) == NULL) {
+		pmNoMem("summary_cache: result realloc", need, PM_FATAL_ERR);
+	    }
+	    if ((cachedResult->vset[j] = (pmValueSet *)malloc(sizeof(pmValueSet))) == NULL) {
+		pmNoMem("summary_cache: vset[]", sizeof(pmValueSet), PM_FATAL_ERR);
+	    }
+	    cachedResult->vset[j]->pmid = resp->vset[i]->pmid;
+	    cachedResult->vset[j]->numval = 0;
+	}
+
+	/*
+	 * swap vsets
+	 */
+	vsp = cachedResult->vset[j];
+	cachedResult->vset[j] = resp->vset[i];
+	resp->vset[i] = vsp;
+    }
+
+    __pmFreeResult(resp);
+}
+
 void
 service_client(__pmPDU *pb)
 {
     int		n;
     int		i;
-    int		j;
     pmDesc	desc;
     pmDesc	foundDesc;
     __pmResult	*resp;
-    pmValueSet	*vsp;
     __pmPDUHdr   *ph = (__pmPDUHdr *)pb;
 
     switch (ph->type) {
@@ -100,53 +157,7 @@ service_client(__pmPDU *pb)
 	    exit(1);
 	}
 
-	if (cachedResult == NULL) {
-	    int		need;
-	    need = (int)sizeof(pmResult) - (int)sizeof(pmValueSet *);
-	    if ((cachedResult = (pmResult *)malloc(need)) == NULL) {
-		pmNoMem("service_client: result malloc", need, PM_FATAL_ERR);
-	    }
-	    cachedResult->numpmid = 0;
-	}
-
-	/*
-	 * swap values from resp with those in cachedResult, expanding
-	 * cachedResult if there are metrics we've not seen before
-	 */
-	for (i = 0; i < resp->numpmid; i++) {
-	    for (j = 0; j < cachedResult->numpmid; j++) {
-		if (resp->vset[i]->pmid == cachedResult->vset[j]->pmid) {
-		    /* found matching PMID, update this value */
-		    break;
-		}
-	    }
-
-	    if (j == cachedResult->numpmid) {
-		/* new PMID, expand cachedResult and initialize vset */
-		int		need;
-		cachedResult->numpmid++;
-		need = (int)sizeof(pmResult) +
-		    (cachedResult->numpmid-1) * (int)sizeof(pmValueSet *);
-		if ((cachedResult = (pmResult *)realloc(cachedResult, need)) == NULL) {
-		    pmNoMem("service_client: result realloc", need, PM_FATAL_ERR);
-		}
-		if ((cachedResult->vset[j] = (pmValueSet *)malloc(sizeof(pmValueSet))) == NULL) {
-		    pmNoMem("service_client: vset[]", sizeof(pmValueSet), PM_FATAL_ERR);
-		}
-		cachedResult->vset[j]->pmid = resp->vset[i]->pmid;
-		cachedResult->vset[j]->numval = 0;
-	    }
-
-	    /*
-	     * swap vsets
-	     */
-	    vsp = cachedResult->vset[j];
-	    cachedResult->vset[j] = resp->vset[i];
-	    resp->vset[i] = vsp;
-
-	}
-
-	__pmFreeResult(resp);
+	summary_cache(resp);
 	break;
 	    
     case PDU_ERROR:
@@ -229,6 +240,9 @@ summary_fetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt * ex)
     res->timestamp.tv_usec = 0;
     res->numpmid = numpmid;
 
+    /* in-process expressions are evaluated now, if they are due */
+    summary_derive_fetch();
+
     for (i = 0; i < numpmid; i++) {
 	pmid = pmidlist[i];
 
@@ -296,6 +310,8 @@ summary_done(void)
     int st;
 
     fprintf(stderr, "summary agent pid=%" FMT_PID " done\n", (pid_t)getpid());
-    kill(clientPID, SIGINT);
-    waitpid(clientPID, &st, 0);
+    if (clientPID > 0) {
+	kill(clientPID, SIGINT);
+	waitpid(clientPID, &st, 0);
+    }
 }
@@ -27,5 +27,11 @@ extern pid_t	clientPID;
 extern void summaryMainLoop(char *, int, pmdaInterface *);
 extern void mainLoopFreeResultCallback(void (*)(pmResult *));
 extern void service_client(__pmPDU *);
+extern void summary_cache(__pmResult *);
+
+/* in-process evaluation as derived metrics, see -c */
+extern struct timeval	summary_interval;
+extern int summary_derive_init(const char *);
+extern void summary_derive_fetch(void);
 
 
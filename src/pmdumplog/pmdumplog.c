@@ -24,13 +24,14 @@
 #include <errno.h>
 #include "../libpcp/src/internal.h"
 
-static char		timebuf[32];	/* for pmCtime result + .xxx */
 static int		numpmid;
 static pmID		*pmid;
 static pmID		pmid_flags;
 static pmID		pmid_missed;
+static int		Mflag;		/* for -M (report <mark> records) */
 static int		sflag;
 static int		xflag;		/* for -x (long timestamps) */
+static int		nthreads = 1;	/* for --threads */
 static __pmLogLabel	label;
 static int		version;	/* of input archive */
 
@@ -48,6 +49,7 @@ static pmLongOptions longopts[] = {
     { "markrecs", 0, 'M', 0, "report <mark> records" },
     { "metrics", 0, 'm', 0, "dump values of the metrics (default)" },
     PMOPT_NAMESPACE,
+    { "threads", 1, 'P', "N", "dump N archive volumes in parallel" },
     { "reverse", 0, 'r', 0, "process archive in reverse chronological order" },
     PMOPT_START,
     { "sizes", 0, 's', 0, "report size of data records in archive" },
@@ -66,7 +68,7 @@ static int overrides(int, pmOptions *);
 static pmOptions opts = {
     .version = PMAPI_VERSION_3,
     .flags = PM_OPTFLAG_DONE | PM_OPTFLAG_STDOUT_TZ | PM_OPTFLAG_BOUNDARIES,
-    .short_options = "aD:dehIilLmMn:rS:sT:tv:xZ:z?",
+    .short_options = "aD:dehIilLmMn:P:rS:sT:tv:xZ:z?",
     .long_options = longopts,
     .short_usage = "[options] [archive [metricname ...]]",
     .override = overrides,
@@ -74,11 +76,160 @@ static pmOptions opts = {
 
 static __pmContext	*ctxp;
 
+/*
+ * names and descriptor of a metric, looked up once per metric rather
+ * than for every value dumped
+ */
+typedef struct {
+    int		numnames;	/* from pmNameAll() */
+    char	**names;
+    int		sts;		/* from pmLookupDesc() */
+    pmDesc	desc;
+} metric_t;
+
+/*
+ * instance names of an instance domain as of one of its metadata
+ * records, sorted for binary search rather than the linear search
+ * pmNameInDom() uses for every value
+ */
+typedef struct {
+    int		inst;
+    int		index;		/* position in the metadata record */
+    char	*name;
+} instname_t;
+
+typedef struct {
+    __pmTimestamp	stamp;		/* time of the last search */
+    __pmLogInDom	*idp;		/* metadata record found then */
+    int			numinst;
+    instname_t		*list;		/* sorted by inst, then index */
+} indom_t;
+
+/*
+ * state for dumping data records, one per thread with --threads
+ */
+typedef struct {
+    FILE		*f;		/* output stream */
+    __pmContext		*ctxp;		/* archive context to fetch from */
+    __pmResult		*skel;		/* for picking the numpmid metrics */
+    __pmHashCtl		metrics;	/* metric_t by PMID */
+    __pmHashCtl		indoms;		/* indom_t by pmInDom */
+} dump_t;
+
+#ifdef PM_MULTI_THREAD
+static pthread_mutex_t	event_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static metric_t *
+lookup_metric(dump_t *dp, pmID id)
+{
+    __pmHashNode	*hp;
+    metric_t		*mp;
+
+    if ((hp = __pmHashSearch((unsigned int)id, &dp->metrics)) != NULL)
+	return (metric_t *)hp->data;
+
+    if ((mp = (metric_t *)malloc(sizeof(metric_t))) == NULL) {
+	pmNoMem("lookup_metric", sizeof(metric_t), PM_FATAL_ERR);
+	/* NOTREACHED */
+    }
+    mp->names = NULL; /* silence coverity */
+    mp->numnames = pmNameAll(id, &mp->names);
+    mp->sts = pmLookupDesc(id, &mp->desc);
+    if (__pmHashAdd((unsigned int)id, (void *)mp, &dp->metrics) < 0) {
+	pmNoMem("lookup_metric", sizeof(__pmHashNode), PM_FATAL_ERR);
+	/* NOTREACHED */
+    }
+    return mp;
+}
+
+static int
+instname_cmp(const void *a, const void *b)
+{
+    const instname_t	*ap = (const instname_t *)a;
+    const instname_t	*bp = (const instname_t *)b;
+
+    if (ap->inst != bp->inst)
+	return ap->inst < bp->inst ? -1 : 1;
+    return ap->index - bp->index;
+}
+
+/*
+ * name of instance inst at the time of the last record fetched, as
+ * per pmNameInDom() (so the first match in the metadata record wins)
+ * ... returns NULL if unknown
+ */
+static char *
+lookup_inst(dump_t *dp, pmInDom indom, int inst)
+{
+    __pmTimestamp	*tsp = &dp->ctxp->c_origin;
+    __pmLogInDom	*idp;
+    __pmHashNode	*hp;
+    indom_t		*ip;
+    int			lo, hi, mid;
+    int			i;
+
+    if ((hp = __pmHashSearch((unsigned int)indom, &dp->indoms)) != NULL)
+	ip = (indom_t *)hp->data;
+    else {
+	if ((ip = (indom_t *)calloc(1, sizeof(indom_t))) == NULL) {
+	    pmNoMem("lookup_inst", sizeof(indom_t), PM_FATAL_ERR);
+	    /* NOTREACHED */
+	}
+	if (__pmHashAdd((unsigned int)indom, (void *)ip, &dp->indoms) < 0) {
+	    pmNoMem("lookup_inst", sizeof(__pmHashNode), PM_FATAL_ERR);
+	    /* NOTREACHED */
+	}
+    }
+
+    /* search the metadata once per record, not once per value */
+    if (ip->list == NULL || __pmTimestampCmp(&ip->stamp, tsp) != 0) {
+	idp = __pmLogSearchInDom(dp->ctxp->c_archctl->ac_log, indom, tsp);
+	ip->stamp = *tsp;
+	if (idp == NULL || idp->numinst <= 0) {
+	    ip->idp = NULL;
+	    ip->numinst = 0;
+	}
+	else if (idp != ip->idp) {
+	    free(ip->list);
+	    if ((ip->list = (instname_t *)malloc(idp->numinst * sizeof(instname_t))) == NULL) {
+		pmNoMem("lookup_inst", idp->numinst * sizeof(instname_t), PM_FATAL_ERR);
+		/* NOTREACHED */
+	    }
+	    for (i = 0; i < idp->numinst; i++) {
+		ip->list[i].inst = idp->instlist[i];
+		ip->list[i].index = i;
+		ip->list[i].name = idp->namelist[i];
+	    }
+	    qsort(ip->list, idp->numinst, sizeof(instname_t), instname_cmp);
+	    ip->idp = idp;
+	    ip->numinst = idp->numinst;
+	}
+	else
+	    ip->numinst = idp->numinst;
+    }
+
+    /* first entry for inst, if any */
+    lo = 0;
+    hi = ip->numinst;
+    while (lo < hi) {
+	mid = (lo + hi) / 2;
+	if (ip->list[mid].inst < inst)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    if (lo < ip->numinst && ip->list[lo].inst == inst)
+	return ip->list[lo].name;
+    return NULL;
+}
+
 static void
-dump_timeval(struct timeval *stamp)
+dump_timeval(FILE *f, struct timeval *stamp)
 {
     time_t	time = stamp->tv_sec;
     int		usec = (int)stamp->tv_usec;
+    char	timebuf[32];	/* for pmCtime result + .xxx */
     char	*yr = NULL;
     char       	*ddmm;
     struct tm	tm;
@@ -87,17 +238,17 @@ dump_timeval(struct timeval *stamp)
 	ddmm = pmCtime(&time, timebuf);
 	ddmm[10] = '\0';
 	yr = &ddmm[20];
-	printf("%s ", ddmm);
+	fprintf(f, "%s ", ddmm);
     }
     pmLocaltime(&time, &tm);
-    printf("%02d:%02d:%02d.%06d", tm.tm_hour, tm.tm_min, tm.tm_sec, usec);
+    fprintf(f, "%02d:%02d:%02d.%06d", tm.tm_hour, tm.tm_min, tm.tm_sec, usec);
     if (xflag && yr)
-	printf(" %4.4s", yr);
+	fprintf(f, " %4.4s", yr);
     if (xflag >= 2) {
 	struct timeval	start;
 	start.tv_sec = label.start.sec;
 	start.tv_usec = label.start.nsec / 1000;
-	printf(" (%.6f)", pmtimevalSub(stamp, &start));
+	fprintf(f, " (%.6f)", pmtimevalSub(stamp, &start));
     }
 }
 
@@ -125,28 +276,27 @@ myPrintTimestamp(FILE *f, const __pmTimestamp *tsp)
  * ctime + HH:MM:SS.{NSEC|USEC}
  */
 static void
-dump_pmTimestamp(const __pmTimestamp *tsp)
+dump_pmTimestamp(FILE *f, const __pmTimestamp *tsp)
 {
     time_t	time = tsp->sec;
+    char	timebuf[32];	/* for pmCtime result + .xxx */
     char	*yr = NULL;
     char       	*ddmm;
-    struct tm	tm;
 
     if (xflag) {
 	ddmm = pmCtime(&time, timebuf);
 	ddmm[10] = '\0';
 	yr = &ddmm[20];
-	printf("%s ", ddmm);
+	fprintf(f, "%s ", ddmm);
     }
-    pmLocaltime(&time, &tm);
-    myPrintTimestamp(stdout, tsp);
+    myPrintTimestamp(f, tsp);
     if (xflag && yr)
-	printf(" %4.4s", yr);
+	fprintf(f, " %4.4s", yr);
     if (xflag >= 2) {
 	if (version == PM_LOG_VERS03)
-	    printf(" (%.9f)", __pmTimestampSub(tsp, &label.start));
+	    fprintf(f, " (%.9f)", __pmTimestampSub(tsp, &label.start));
 	else
-	    printf(" (%.6f)", __pmTimestampSub(tsp, &label.start));
+	    fprintf(f, " (%.6f)", __pmTimestampSub(tsp, &label.start));
     }
 }
 
@@ -193,8 +343,12 @@ do_size(__pmResult *rp)
 static void
 setup_event_derived_metrics(void)
 {
-    int sts;
+    int		sts;
+    char	errmsg[PM_MAXERRMSGLEN];
 
+#ifdef PM_MULTI_THREAD
+    pthread_mutex_lock(&event_lock);
+#endif
     if (pmid_flags == 0) {
 	/*
 	 * get PMID for event.flags and event.missed
@@ -208,7 +362,7 @@ setup_event_derived_metrics(void)
 	if ((sts = pmLookupName(1, &name_flags, &pmid_flags)) < 0) {
 	    /* should not happen! */
 	    fprintf(stderr, "Warning: cannot get PMID for %s: %s\n",
-		    name_flags, pmErrStr(sts));
+		    name_flags, pmErrStr_r(sts, errmsg, sizeof(errmsg)));
 	    /* avoid subsequent warnings ... */
 	    pmid_flags = pmID_build(pmID_domain(pmid_flags), pmID_cluster(pmid_flags), 1);
 	}
@@ -216,37 +370,40 @@ setup_event_derived_metrics(void)
 	if (sts < 0) {
 	    /* should not happen! */
 	    fprintf(stderr, "Warning: cannot get PMID for %s: %s\n",
-		    name_missed, pmErrStr(sts));
+		    name_missed, pmErrStr_r(sts, errmsg, sizeof(errmsg)));
 	    /* avoid subsequent warnings ... */
 	    pmid_missed = pmID_build(pmID_domain(pmid_missed), pmID_cluster(pmid_missed), 1);
 	}
     }
+#ifdef PM_MULTI_THREAD
+    pthread_mutex_unlock(&event_lock);
+#endif
 }
 
 static int
-dump_nrecords(int nrecords, int nmissed)
+dump_nrecords(FILE *f, int nrecords, int nmissed)
 {
-    printf("%d", nrecords);
+    fprintf(f, "%d", nrecords);
     if (nmissed > 0)
-	printf(" (and %d missed)", nmissed);
+	fprintf(f, " (and %d missed)", nmissed);
     if (nrecords + nmissed == 1)
-	printf(" event record\n");
+	fputs(" event record\n", f);
     else
-	printf(" event records\n");
+	fputs(" event records\n", f);
     return 0;
 }
 
 static int
-dump_nparams(int npmids)
+dump_nparams(FILE *f, int npmids)
 {
     if (npmids == 0) {
-	printf(" ---\n");
-	printf("	          No parameters\n");
+	fputs(" ---\n", f);
+	fputs("	          No parameters\n", f);
 	return -1;
     }
     if (npmids < 0) {
-	printf(" ---\n");
-	printf("	          Error: illegal number of parameters (%d)\n",
+	fputs(" ---\n", f);
+	fprintf(f, "	          Error: illegal number of parameters (%d)\n",
 		npmids);
 	return -1;
     }
@@ -254,49 +411,49 @@ dump_nparams(int npmids)
 }
 
 static void
-dump_parameter(pmValueSet *xvsp, int index, int *flagsp)
+dump_parameter(dump_t *dp, pmValueSet *xvsp, int index, int *flagsp)
 {
-    int		sts, flags = *flagsp;
-    pmDesc	desc;
-    char	**names;
+    FILE	*f = dp->f;
+    int		flags = *flagsp;
+    metric_t	*mp = lookup_metric(dp, xvsp->pmid);
+    char	strbuf[20];
+    char	errmsg[PM_MAXERRMSGLEN];
 
-    if ((sts = pmNameAll(xvsp->pmid, &names)) >= 0) {
+    if (mp->numnames >= 0) {
 	if (index == 0) {
 	    if (xvsp->pmid == pmid_flags) {
 		flags = *flagsp = xvsp->vlist[0].value.lval;
-		printf(" flags 0x%x", flags);
-		printf(" (%s) ---\n", pmEventFlagsStr(flags));
-		free(names);
+		fprintf(f, " flags 0x%x", flags);
+		fprintf(f, " (%s) ---\n", pmEventFlagsStr_r(flags, errmsg, sizeof(errmsg)));
 		return;
 	    }
-	    printf(" ---\n");
+	    fputs(" ---\n", f);
 	}
 	if ((flags & PM_EVENT_FLAG_MISSED) && index == 1 &&
 	    (xvsp->pmid == pmid_missed)) {
-	    printf("        ==> %d missed event records\n",
+	    fprintf(f, "        ==> %d missed event records\n",
 		    xvsp->vlist[0].value.lval);
-	    free(names);
 	    return;
 	}
-	printf("        %s (", pmIDStr(xvsp->pmid));
-	__pmPrintMetricNames(stdout, sts, names, " or ");
-	printf("):");
-	free(names);
+	fprintf(f, "        %s (", pmIDStr_r(xvsp->pmid, strbuf, sizeof(strbuf)));
+	__pmPrintMetricNames(f, mp->numnames, mp->names, " or ");
+	fputs("):", f);
     }
     else
-	printf("        PMID: %s:", pmIDStr(xvsp->pmid));
-    if ((sts = pmLookupDesc(xvsp->pmid, &desc)) < 0) {
-	printf(" pmLookupDesc: %s\n", pmErrStr(sts));
+	fprintf(f, "        PMID: %s:", pmIDStr_r(xvsp->pmid, strbuf, sizeof(strbuf)));
+    if (mp->sts < 0) {
+	fprintf(f, " pmLookupDesc: %s\n", pmErrStr_r(mp->sts, errmsg, sizeof(errmsg)));
 	return;
     }
-    printf(" value ");
-    pmPrintValue(stdout, xvsp->valfmt, desc.type, &xvsp->vlist[0], 1);
-    putchar('\n');
+    fputs(" value ", f);
+    pmPrintValue(f, xvsp->valfmt, mp->desc.type, &xvsp->vlist[0], 1);
+    fputc('\n', f);
 }
 
 static void
-dump_event(int numnames, char **names, pmValueSet *vsp, int index, int indom, int type)
+dump_event(dump_t *dp, metric_t *mp, pmValueSet *vsp, int index, int indom, int type)
 {
+    FILE	*f = dp->f;
     int		r;		/* event records */
     int		p;		/* event parameters */
     int		flags;
@@ -304,23 +461,22 @@ dump_event(int numnames, char **names, pmValueSet *vsp, int index, int indom, in
     int		nmissed = 0;
     int		highres = (type == PM_TYPE_HIGHRES_EVENT);
     char	*iname;
+    char	strbuf[20];
     pmValue	*vp = &vsp->vlist[index];
 
-    printf("    %s (", pmIDStr(vsp->pmid));
-    __pmPrintMetricNames(stdout, numnames, names, " or ");
+    fprintf(f, "    %s (", pmIDStr_r(vsp->pmid, strbuf, sizeof(strbuf)));
+    __pmPrintMetricNames(f, mp->numnames, mp->names, " or ");
     if (indom != PM_INDOM_NULL) {
-	putchar('[');
-	if (pmNameInDom(indom, vp->inst, &iname) < 0)
-	    printf("%d or ???])", vp->inst);
-	else {
-	    printf("%d or \"%s\"])", vp->inst, iname);
-	    free(iname);
-	}
+	fputc('[', f);
+	if ((iname = lookup_inst(dp, indom, vp->inst)) == NULL)
+	    fprintf(f, "%d or ???])", vp->inst);
+	else
+	    fprintf(f, "%d or \"%s\"])", vp->inst, iname);
     }
     else {
-	printf(")");
+	fputc(')', f);
     }
-    printf(": ");
+    fputs(": ", f);
 
     if (highres) {
 	pmHighResResult	**hr;
@@ -328,7 +484,7 @@ dump_event(int numnames, char **names, pmValueSet *vsp, int index, int indom, in
 	if ((nrecords = pmUnpackHighResEventRecords(vsp, index, &hr)) < 0)
 	    return;
 	if (nrecords == 0) {
-	    printf("No event records\n");
+	    fputs("No event records\n", f);
 	    pmFreeHighResEventResult(hr);
 	    return;
 	}
@@ -341,16 +497,16 @@ dump_event(int numnames, char **names, pmValueSet *vsp, int index, int indom, in
 		nmissed += hr[r]->vset[1]->vlist[0].value.lval;
 	    }
 	}
-	dump_nrecords(nrecords, nmissed);
+	dump_nrecords(f, nrecords, nmissed);
 
 	for (r = 0; r < nrecords; r++) {
-	    printf("        --- event record [%d] timestamp ", r);
-	    pmPrintHighResStamp(stdout, &hr[r]->timestamp);
-	    if (dump_nparams(hr[r]->numpmid) < 0)
+	    fprintf(f, "        --- event record [%d] timestamp ", r);
+	    pmPrintHighResStamp(f, &hr[r]->timestamp);
+	    if (dump_nparams(f, hr[r]->numpmid) < 0)
 		continue;
 	    flags = 0;
 	    for (p = 0; p < hr[r]->numpmid; p++)
-		dump_parameter(hr[r]->vset[p], p, &flags);
+		dump_parameter(dp, hr[r]->vset[p], p, &flags);
 	}
 	pmFreeHighResEventResult(hr);
     }
@@ -360,7 +516,7 @@ dump_event(int numnames, char **names, pmValueSet *vsp, int index, int indom, in
 	if ((nrecords = pmUnpackEventRecords(vsp, index, &res)) < 0)
 	    return;
 	if (nrecords == 0) {
-	    printf("No event records\n");
+	    fputs("No event records\n", f);
 	    pmFreeEventResult(res);
 	    return;
 	}
@@ -373,117 +529,214 @@ dump_event(int numnames, char **names, pmValueSet *vsp, int index, int indom, in
 		nmissed += res[r]->vset[1]->vlist[0].value.lval;
 	    }
 	}
-	dump_nrecords(nrecords, nmissed);
+	dump_nrecords(f, nrecords, nmissed);
 
 	for (r = 0; r < nrecords; r++) {
-	    printf("        --- event record [%d] timestamp ", r);
-	    dump_timeval(&res[r]->timestamp);
-	    if (dump_nparams(res[r]->numpmid) < 0)
+	    fprintf(f, "        --- event record [%d] timestamp ", r);
+	    dump_timeval(f, &res[r]->timestamp);
+	    if (dump_nparams(f, res[r]->numpmid) < 0)
 		continue;
 	    flags = 0;
 	    for (p = 0; p < res[r]->numpmid; p++)
-		dump_parameter(res[r]->vset[p], p, &flags);
+		dump_parameter(dp, res[r]->vset[p], p, &flags);
 	}
 	pmFreeEventResult(res);
     }
 }
 
 static void
-dump_metric(int numnames, char **names, pmValueSet *vsp, int index, int indom, int type)
+dump_metric(dump_t *dp, metric_t *mp, pmValueSet *vsp, int index, int indom, int type)
 {
+    FILE	*f = dp->f;
     pmValue	*vp = &vsp->vlist[index];
     char	*iname;
+    char	strbuf[20];
 
     if (index == 0) {
-	printf("    %s (", pmIDStr(vsp->pmid));
-	__pmPrintMetricNames(stdout, numnames, names, " or ");
-	printf("):");
+	fprintf(f, "    %s (", pmIDStr_r(vsp->pmid, strbuf, sizeof(strbuf)));
+	__pmPrintMetricNames(f, mp->numnames, mp->names, " or ");
+	fputs("):", f);
 	if (vsp->numval > 1) {
-	    putchar('\n');
-	    printf("       ");
+	    fputc('\n', f);
+	    fputs("       ", f);
 	}
     }
     else
-	printf("       ");
+	fputs("       ", f);
 
     if (indom != PM_INDOM_NULL) {
-	printf(" inst [");
-	if (pmNameInDom(indom, vp->inst, &iname) < 0)
-	    printf("%d or ???]", vp->inst);
-	else {
-	    printf("%d or \"%s\"]", vp->inst, iname);
-	    free(iname);
-	}
+	fputs(" inst [", f);
+	if ((iname = lookup_inst(dp, indom, vp->inst)) == NULL)
+	    fprintf(f, "%d or ???]", vp->inst);
+	else
+	    fprintf(f, "%d or \"%s\"]", vp->inst, iname);
     }
-    printf(" value ");
-    pmPrintValue(stdout, vsp->valfmt, type, vp, 1);
-    putchar('\n');
+    fputs(" value ", f);
+    pmPrintValue(f, vsp->valfmt, type, vp, 1);
+    fputc('\n', f);
 }
 
 static void
-dump_result(__pmResult *resp)
+dump_result(dump_t *dp, __pmResult *resp)
 {
+    FILE	*f = dp->f;
     int		i;
     int		j;
-    int		n;
-    char	**names;
-    pmDesc	desc;
+    int		indom;
+    int		type;
+    metric_t	*mp;
+    char	strbuf[20];
+    char	errmsg[PM_MAXERRMSGLEN];
 
     if (sflag) {
 	int		nbyte;
 	nbyte = do_size(resp);
-	printf("[%d bytes]\n", nbyte);
+	fprintf(f, "[%d bytes]\n", nbyte);
     }
 
-    dump_pmTimestamp(&resp->timestamp);
+    dump_pmTimestamp(f, &resp->timestamp);
 
     if (resp->numpmid == 0) {
-	printf("  <mark>\n");
+	fputs("  <mark>\n", f);
 	return;
     }
-    printf(" %d metric", resp->numpmid);
+    fprintf(f, " %d metric", resp->numpmid);
     if (resp->numpmid == 0 || resp->numpmid > 1)
-	putchar('s');
-    putchar('\n');
+	fputc('s', f);
+    fputc('\n', f);
 
     for (i = 0; i < resp->numpmid; i++) {
 	pmValueSet	*vsp = resp->vset[i];
 
-	names = NULL; /* silence coverity */
-	n = pmNameAll(vsp->pmid, &names);
+	mp = lookup_metric(dp, vsp->pmid);
 	if (vsp->numval == 0) {
-	    printf("    %s (", pmIDStr(vsp->pmid));
-	    __pmPrintMetricNames(stdout, n, names, " or ");
-	    printf("): No values returned!\n");
-	    goto next;
+	    fprintf(f, "    %s (", pmIDStr_r(vsp->pmid, strbuf, sizeof(strbuf)));
+	    __pmPrintMetricNames(f, mp->numnames, mp->names, " or ");
+	    fputs("): No values returned!\n", f);
+	    continue;
 	}
 	else if (vsp->numval < 0) {
-	    printf("    %s (", pmIDStr(vsp->pmid));
-	    __pmPrintMetricNames(stdout, n, names, " or ");
-	    printf("): %s\n", pmErrStr(vsp->numval));
-	    goto next;
+	    fprintf(f, "    %s (", pmIDStr_r(vsp->pmid, strbuf, sizeof(strbuf)));
+	    __pmPrintMetricNames(f, mp->numnames, mp->names, " or ");
+	    fprintf(f, "): %s\n", pmErrStr_r(vsp->numval, errmsg, sizeof(errmsg)));
+	    continue;
 	}
 
-	if (pmLookupDesc(vsp->pmid, &desc) < 0) {
+	if (mp->sts < 0) {
 	    /* don't know, so punt on the most common cases */
-	    desc.indom = PM_INDOM_NULL;
+	    indom = PM_INDOM_NULL;
 	    if (vsp->valfmt == PM_VAL_INSITU)
-		desc.type = PM_TYPE_32;
+		type = PM_TYPE_32;
 	    else
-		desc.type = PM_TYPE_AGGREGATE;
+		type = PM_TYPE_AGGREGATE;
+	}
+	else {
+	    indom = mp->desc.indom;
+	    type = mp->desc.type;
 	}
 
 	for (j = 0; j < vsp->numval; j++) {
-	    if (desc.type == PM_TYPE_EVENT ||
-		desc.type == PM_TYPE_HIGHRES_EVENT)
-		dump_event(n, names, vsp, j, desc.indom, desc.type);
+	    if (type == PM_TYPE_EVENT || type == PM_TYPE_HIGHRES_EVENT)
+		dump_event(dp, mp, vsp, j, indom, type);
 	    else
-		dump_metric(n, names, vsp, j, desc.indom, desc.type);
+		dump_metric(dp, mp, vsp, j, indom, type);
+	}
+    }
+}
+
+/*
+ * dump the data records from the current position in the archive up
+ * to done, which is inclusive if last (else exclusive) ... returns
+ * PM_ERR_EOL once done is reached, else an error from the fetch
+ */
+static int
+dump_records(dump_t *dp, int mode, const __pmTimestamp *done, int last)
+{
+    FILE		*f = dp->f;
+    int			first = 1;
+    int			cmp;
+    int			sts;
+    int			i;
+    int			j;
+    char		timebuf[32];	/* for pmCtime result + .xxx */
+    __pmResult		*raw_result;
+    __pmResult		*result;
+    __pmResult		*skel_result = dp->skel;
+
+    for ( ; ; ) {
+	/*
+	 * with a list of metrics, only records containing at least one
+	 * of them are returned (with <mark> records), and only their
+	 * pmValueSets are decoded
+	 */
+	if (numpmid > 0)
+	    sts = __pmLogFetchFilter(dp->ctxp, numpmid, pmid, &raw_result);
+	else
+	    sts = __pmLogFetch(dp->ctxp, 0, NULL, &raw_result);
+	if (sts < 0)
+	    break;
+	if (numpmid == 0 || (raw_result->numpmid == 0 && Mflag)) {
+	    /*
+	     * want 'em all or <mark> record ...
+	     */
+	    result = raw_result;
+	}
+	else if (numpmid > 0) {
+	    /*
+	     * cherry pick from raw_result if pmid matches one
+	     * of interest
+	     */
+	    int	picked = 0;
+
+	    skel_result->timestamp = raw_result->timestamp;
+	    for (j = 0; j < numpmid; j++)
+		skel_result->vset[j] = NULL;
+	    for (i = 0; i < raw_result->numpmid; i++) {
+		for (j = 0; j < numpmid; j++) {
+		    if (pmid[j] == raw_result->vset[i]->pmid) {
+			skel_result->vset[j] = raw_result->vset[i];
+			picked++;
+			break;
+		    }
+		}
+	    }
+	    if (picked == 0) {
+		/* no metrics of interest, skip this record */
+		__pmFreeResult(raw_result);
+		continue;
+	    }
+	    skel_result->numpmid = picked;
+	    if (picked != numpmid) {
+		/* did not find 'em all ... shuffle time */
+		for (i = j = 0; j < numpmid; j++) {
+		    if (skel_result->vset[j] != NULL)
+			skel_result->vset[i++] = skel_result->vset[j];
+		}
+	    }
+	    result = skel_result;
+	}
+	else {
+	    /* not interesting */
+	    __pmFreeResult(raw_result);
+	    continue;
+	}
+	if (first && mode == PM_MODE_BACK) {
+	    first = 0;
+	    fprintf(f, "\nLog finished at %24.24s - dump in reverse order\n",
+		    pmCtime((const time_t *)&result->timestamp.sec, timebuf));
+	}
+	cmp = __pmTimestampCmp(&result->timestamp, done);
+	if ((mode == PM_MODE_FORW && (cmp > 0 || (cmp == 0 && !last))) ||
+	    (mode == PM_MODE_BACK && cmp < 0)) {
+	    __pmFreeResult(raw_result);
+	    sts = PM_ERR_EOL;
+	    break;
 	}
-next:
-	if (n > 0)
-	    free(names);
+	fputc('\n', f);
+	dump_result(dp, result);
+	__pmFreeResult(raw_result);
     }
+    return sts;
 }
 
 static void
@@ -558,7 +811,7 @@ dumpDiskInDom(void)
 		fprintf(stderr, "dumpDiskInDom: __pmLogLoadInDom failed: %s\n", pmErrStr(sts));
 		exit(1);
 	    }
-	    dump_pmTimestamp(&lid.stamp);
+	    dump_pmTimestamp(stdout, &lid.stamp);
 	    printf(" InDom: %s", pmInDomStr(lid.indom));
 	    if (hdr.type == TYPE_INDOM_DELTA)
 		printf(" delta");
@@ -626,7 +879,9 @@ dumpInDom(void)
 			;
 		if (idp->isdelta)
 		    __pmLogUndeltaInDom((pmInDom)hp->key, idp);
-		dump_pmTimestamp(&idp->stamp);
+		else
+		    __pmLogLoadLazyInDom(idp);
+		dump_pmTimestamp(stdout, &idp->stamp);
 		printf(" %d instances\n", idp->numinst);
 		for (j = 0; j < idp->numinst; j++) {
 		    printf("   %d or \"%s\"\n",
@@ -801,7 +1056,7 @@ dumpLabelSets(void)
 	 * Now print all the label sets at this time stamp.
 	 * Sort by type and then identifier.
 	 */
-	dump_pmTimestamp(&this_stamp);
+	dump_pmTimestamp(stdout, &this_stamp);
 	putchar('\n');
 	for (lix = 0; lix < sizeof(labelTypes) / sizeof(*labelTypes); ++lix) {
 	    /* Are there labels of this type? */
@@ -891,7 +1146,7 @@ dumpTI(void)
 
     for (i = 0; i < lcp->numti; i++) {
 	tip = &lcp->ti[i];
-	dump_pmTimestamp(&tip->stamp);
+	dump_pmTimestamp(stdout, &tip->stamp);
 	printf("\t  %5d  %11lld  %11lld\n", tip->vol,
 		(long long)tip->off_meta, (long long)tip->off_data);
 	if (i == 0) {
@@ -964,6 +1219,7 @@ dumpLabel(int verbose)
 {
     char		*ddmm;
     char		*yr;
+    char		timebuf[32];	/* for pmCtime result + .xxx */
     __pmTimestamp	end;
     time_t		time;
 
@@ -1082,6 +1338,220 @@ dometric(const char *name)
     }
 }
 
+#ifdef PM_MULTI_THREAD
+/*
+ * with --threads, the data records are split into time ranges at the
+ * start of each archive volume (as recorded in the temporal index) and
+ * the ranges are dumped in parallel, each by a worker thread with its
+ * own archive context into a temporary file ... the main thread copies
+ * the files to stdout in time order as they complete, and the workers
+ * are held to a few ranges ahead of that to bound the space used
+ */
+typedef struct {
+    __pmTimestamp	start;		/* start of range */
+    __pmTimestamp	finish;		/* end of range */
+    int			last;		/* last range, finish is inclusive */
+    FILE		*out;		/* dump of this range */
+    int			sts;		/* PM_ERR_EOL or error */
+    int			done;		/* dump of this range is complete */
+} range_t;
+
+typedef struct {
+    int			ctx;		/* own context for this worker */
+    dump_t		dump;
+    pthread_t		tid;
+} worker_t;
+
+static range_t		*ranges;
+static int		nranges;
+static int		nextrange;	/* next range for a worker to dump */
+static int		ncopied;	/* ranges copied to stdout so far */
+static pthread_mutex_t	range_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	range_cond = PTHREAD_COND_INITIALIZER;
+
+static void *
+dump_worker(void *arg)
+{
+    worker_t		*wp = (worker_t *)arg;
+    range_t		*rp;
+    struct timespec	start;
+    int			sts;
+
+    pmUseContext(wp->ctx);
+    for ( ; ; ) {
+	pthread_mutex_lock(&range_lock);
+	while (nextrange < nranges && nextrange >= ncopied + 2 * nthreads)
+	    pthread_cond_wait(&range_cond, &range_lock);
+	if (nextrange >= nranges) {
+	    pthread_mutex_unlock(&range_lock);
+	    break;
+	}
+	rp = &ranges[nextrange++];
+	pthread_mutex_unlock(&range_lock);
+
+	start.tv_sec = rp->start.sec;
+	start.tv_nsec = rp->start.nsec;
+	wp->dump.f = rp->out;
+	if ((sts = pmSetModeHighRes(PM_MODE_FORW, &start, NULL)) < 0)
+	    rp->sts = sts;
+	else
+	    rp->sts = dump_records(&wp->dump, PM_MODE_FORW, &rp->finish, rp->last);
+
+	pthread_mutex_lock(&range_lock);
+	rp->done = 1;
+	pthread_cond_broadcast(&range_cond);
+	pthread_mutex_unlock(&range_lock);
+    }
+    return NULL;
+}
+
+/*
+ * split the records up to done into ranges at the start of each volume
+ * ... returns the number of ranges, which is 1 if the temporal index is
+ * not in order (positioning by time relies on it)
+ */
+static int
+split_ranges(const __pmTimestamp *done)
+{
+    __pmLogCtl		*lcp = ctxp->c_archctl->ac_log;
+    __pmLogTI		*tip;
+    int			i;
+
+    if ((ranges = (range_t *)calloc(lcp->numti + 1, sizeof(range_t))) == NULL) {
+	pmNoMem("split_ranges", (lcp->numti + 1) * sizeof(range_t), PM_FATAL_ERR);
+	/* NOTREACHED */
+    }
+    ranges[0].start.sec = opts.start.tv_sec;
+    ranges[0].start.nsec = opts.start.tv_nsec;
+    nranges = 1;
+    for (i = 1; i < lcp->numti; i++) {
+	tip = &lcp->ti[i];
+	if (tip->vol < tip[-1].vol || tip->vol > lcp->maxvol ||
+	    __pmTimestampCmp(&tip->stamp, &tip[-1].stamp) < 0 ||
+	    (tip->vol == tip[-1].vol && tip->off_data < tip[-1].off_data)) {
+	    nranges = 1;
+	    break;
+	}
+	if (tip->vol == tip[-1].vol ||
+	    __pmTimestampCmp(&tip->stamp, &ranges[nranges-1].start) <= 0 ||
+	    __pmTimestampCmp(&tip->stamp, done) >= 0)
+	    continue;
+	ranges[nranges-1].finish = tip->stamp;
+	ranges[nranges++].start = tip->stamp;
+    }
+    ranges[nranges-1].finish = *done;
+    ranges[nranges-1].last = 1;
+    return nranges;
+}
+
+/*
+ * dump the data records in the ranges from split_ranges() in parallel
+ * ... returns PM_ERR_EOL, or an error from the first range that had
+ * one (after the output for all of the earlier ranges)
+ */
+static int
+dump_ranges(const char *archive, int ctxflags, int ctx)
+{
+    worker_t		*workers;
+    char		buf[BUFSIZ];
+    size_t		n;
+    int			nworkers;
+    int			i;
+    int			sts;
+
+    for (i = 0; i < nranges; i++) {
+	if ((ranges[i].out = tmpfile()) == NULL) {
+	    fprintf(stderr, "%s: Error: cannot create temporary file: %s\n",
+		    pmGetProgname(), osstrerror());
+	    exit(1);
+	}
+    }
+
+    nworkers = nthreads < nranges ? nthreads : nranges;
+    if ((workers = (worker_t *)calloc(nworkers, sizeof(worker_t))) == NULL) {
+	pmNoMem("dump_ranges", nworkers * sizeof(worker_t), PM_FATAL_ERR);
+	/* NOTREACHED */
+    }
+    for (i = 0; i < nworkers; i++) {
+	if ((workers[i].ctx = pmNewContext(PM_CONTEXT_ARCHIVE | ctxflags, archive)) < 0) {
+	    fprintf(stderr, "%s: Cannot open archive \"%s\": %s\n",
+		    pmGetProgname(), archive, pmErrStr(workers[i].ctx));
+	    exit(1);
+	}
+	if ((workers[i].dump.ctxp = __pmHandleToPtr(workers[i].ctx)) == NULL) {
+	    fprintf(stderr, "%s: botch: __pmHandleToPtr(%d) returns NULL!\n",
+		    pmGetProgname(), workers[i].ctx);
+	    exit(1);
+	}
+	/* as for ctxp in main(), only this worker will use the context */
+	PM_UNLOCK(workers[i].dump.ctxp->c_lock);
+	if (numpmid > 0 &&
+	    (workers[i].dump.skel = __pmAllocResult(numpmid)) == NULL) {
+	    fprintf(stderr, "%s: malloc(skel_result): %s\n", pmGetProgname(), osstrerror());
+	    exit(1);
+	}
+	__pmHashInit(&workers[i].dump.metrics);
+	__pmHashInit(&workers[i].dump.indoms);
+    }
+    pmUseContext(ctx);
+
+    for (i = 0; i < nworkers; i++) {
+	if ((sts = pthread_create(&workers[i].tid, NULL, dump_worker, &workers[i])) != 0) {
+	    fprintf(stderr, "%s: Error: cannot create thread: %s\n",
+		    pmGetProgname(), strerror(sts));
+	    exit(1);
+	}
+    }
+    sts = PM_ERR_EOL;
+    for (i = 0; i < nranges; i++) {
+	pthread_mutex_lock(&range_lock);
+	while (!ranges[i].done)
+	    pthread_cond_wait(&range_cond, &range_lock);
+	pthread_mutex_unlock(&range_lock);
+
+	rewind(ranges[i].out);
+	while ((n = fread(buf, 1, sizeof(buf), ranges[i].out)) > 0)
+	    fwrite(buf, 1, n, stdout);
+	fclose(ranges[i].out);
+
+	pthread_mutex_lock(&range_lock);
+	ncopied++;
+	if (ranges[i].sts != PM_ERR_EOL) {
+	    /* no more ranges for the workers */
+	    sts = ranges[i].sts;
+	    nextrange = nranges;
+	}
+	pthread_cond_broadcast(&range_cond);
+	pthread_mutex_unlock(&range_lock);
+	if (sts != PM_ERR_EOL)
+	    break;
+    }
+    for (i = 0; i < nworkers; i++) {
+	pthread_join(workers[i].tid, NULL);
+	pmDestroyContext(workers[i].ctx);
+    }
+    free(workers);
+
+    return sts;
+}
+#else /* !PM_MULTI_THREAD */
+static int
+split_ranges(const __pmTimestamp *done)
+{
+    (void)done;
+    return 1;
+}
+
+static int
+dump_ranges(const char *archive, int ctxflags, int ctx)
+{
+    (void)archive;
+    (void)ctxflags;
+    (void)ctx;
+    return PM_ERR_THREAD;
+}
+#endif /* PM_MULTI_THREAD */
+
 static int
 overrides(int opt, pmOptions *options)
 {
@@ -1118,7 +1588,7 @@ main(int argc, char *argv[])
     char		*rawfile = NULL;
     int			i;
     int			ctxid;
-    int			first = 1;
+    int			ctxflags = 0;
     int			dflag = 0;
     int			eflag = 0;
     int			hflag = 0;
@@ -1126,14 +1596,12 @@ main(int argc, char *argv[])
     int			iflag = 0;
     int			Lflag = 0;
     int			lflag = 0;
-    int			Mflag = 0;
     int			mflag = 0;
     int			tflag = 0;
     int			vflag = 0;
     int			mode = PM_MODE_FORW;
-    __pmResult		*raw_result;
-    __pmResult		*skel_result = NULL;
-    __pmResult		*result;
+    char		*endnum;
+    dump_t		dump;
     __pmTimestamp	done;
 
     while ((c = pmGetOptions(argc, argv, &opts)) != EOF) {
@@ -1180,6 +1648,15 @@ main(int argc, char *argv[])
 	    Mflag = 1;
 	    break;
 
+	case 'P':	/* number of volumes to dump in parallel */
+	    nthreads = (int)strtol(opts.optarg, &endnum, 10);
+	    if (*endnum != '\0' || nthreads < 1) {
+		pmprintf("%s: -P requires positive numeric argument\n",
+			pmGetProgname());
+		opts.errors++;
+	    }
+	    break;
+
 	case 'r':	/* read log in reverse chornological order */
 	    mode = PM_MODE_BACK;
 	    break;
@@ -1243,7 +1720,8 @@ main(int argc, char *argv[])
     if ((sts = ctxid = pmNewContext(PM_CONTEXT_ARCHIVE, opts.archives[0])) < 0) {
 	if (sts == PM_ERR_FEATURE) {
 	    fprintf(stderr, "%s: Warning: unsupported feature bits, other errors may follow ...\n", pmGetProgname());
-	    sts = ctxid = pmNewContext(PM_CONTEXT_ARCHIVE | PM_CTXFLAG_NO_FEATURE_CHECK, opts.archives[0]);
+	    ctxflags = PM_CTXFLAG_NO_FEATURE_CHECK;
+	    sts = ctxid = pmNewContext(PM_CONTEXT_ARCHIVE | ctxflags, opts.archives[0]);
 	}
 	if (sts < 0) {
 	    fprintf(stderr, "%s: Cannot open archive \"%s\": %s\n",
@@ -1292,11 +1770,11 @@ main(int argc, char *argv[])
 	exit(1);
     }
     /*
-     * Note: This application is single threaded, and once we have ctxp
-     *	     the associated __pmContext will not move and will only be
-     *	     accessed or modified synchronously either here or in libpcp.
-     *	     We unlock the context so that it can be locked as required
-     *	     within libpcp.
+     * Note: Once we have ctxp the associated __pmContext will not move
+     *	     and will only be accessed or modified synchronously either
+     *	     here or in libpcp (worker threads for --threads have their
+     *	     own contexts).  We unlock the context so that it can be
+     *	     locked as required within libpcp.
      */
     PM_UNLOCK(ctxp->c_lock);
 
@@ -1308,12 +1786,17 @@ main(int argc, char *argv[])
     }
     version = label.magic & 0xff;
 
+    memset((void *)&dump, 0, sizeof(dump));
+    dump.f = stdout;
+    dump.ctxp = ctxp;
+    __pmHashInit(&dump.metrics);
+    __pmHashInit(&dump.indoms);
     if (numpmid > 0) {
 	/*
 	 * setup dummy __pmResult
 	 */
-	skel_result = __pmAllocResult(numpmid);
-	if (skel_result == NULL) {
+	dump.skel = __pmAllocResult(numpmid);
+	if (dump.skel == NULL) {
 	    fprintf(stderr, "%s: malloc(skel_result): %s\n", pmGetProgname(), osstrerror());
 	    exit(1);
 	}
@@ -1375,73 +1858,19 @@ main(int argc, char *argv[])
 		done.nsec = 0;
 	    }
 	}
-	sts = 0;
-	for ( ; ; ) {
-	    sts = __pmLogFetch(ctxp, 0, NULL, &raw_result);
-	    if (sts < 0)
-		break;
-	    if (numpmid == 0 || (raw_result->numpmid == 0 && Mflag)) {
-		/*
-		 * want 'em all or <mark> record ...
-		 */
-		result = raw_result;
-	    }
-	    else if (numpmid > 0) {
-		/*
-		 * cherry pick from raw_result if pmid matches one
-		 * of interest
-		 */
-		int	picked = 0;
-		int	j;
-
-		skel_result->timestamp = raw_result->timestamp;
-		for (j = 0; j < numpmid; j++)
-		    skel_result->vset[j] = NULL;
-		for (i = 0; i < raw_result->numpmid; i++) {
-		    for (j = 0; j < numpmid; j++) {
-			if (pmid[j] == raw_result->vset[i]->pmid) {
-			    skel_result->vset[j] = raw_result->vset[i];
-			    picked++;
-			    break;
-			}
-		    }
-		}
-		if (picked == 0) {
-		    /* no metrics of interest, skip this record */
-		    __pmFreeResult(raw_result);
-		    continue;
-		}
-		skel_result->numpmid = picked;
-		if (picked != numpmid) {
-		    /* did not find 'em all ... shuffle time */
-		    for (i = j = 0; j < numpmid; j++) {
-			if (skel_result->vset[j] != NULL)
-			    skel_result->vset[i++] = skel_result->vset[j];
-		    }
-		}
-		result = skel_result;
-	    }
-	    else {
-		/* not interesting */
-		__pmFreeResult(raw_result);
-		continue;
-	    }
-	    if (first && mode == PM_MODE_BACK) {
-		first = 0;
-		printf("\nLog finished at %24.24s - dump in reverse order\n",
-			pmCtime((const time_t *)&result->timestamp.sec, timebuf));
-	    }
-	    if ((mode == PM_MODE_FORW &&
-		 __pmTimestampCmp(&result->timestamp, &done) > 0) ||
-		(mode == PM_MODE_BACK &&
-		 __pmTimestampCmp(&result->timestamp, &done) < 0)) {
-		sts = PM_ERR_EOL;
-		break;
-	    }
-	    putchar('\n');
-	    dump_result(result);
-	    __pmFreeResult(raw_result);
-	}
+	/*
+	 * dump volumes in parallel only going forwards, and not when
+	 * archive diagnostics are being reported
+	 */
+#ifndef PM_MULTI_THREAD
+	nthreads = 1;
+#endif
+	if (pmDebugOptions.log)
+	    nthreads = 1;
+	if (nthreads > 1 && mode == PM_MODE_FORW && split_ranges(&done) > 1)
+	    sts = dump_ranges(opts.archives[0], ctxflags, ctxid);
+	else
+	    sts = dump_records(&dump, mode, &done, 1);
 	if (sts != PM_ERR_EOL) {
 	    fprintf(stderr, "%s: pmFetch: %s\n", pmGetProgname(), pmErrStr(sts));
 	    exit(1);
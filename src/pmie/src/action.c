@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/***********************************************************************
+ * action.c
+ *
+ * Asynchronous action dispatch.  By default a shell action blocks the
+ * evaluator until the command has finished, so that its exit status
+ * can be the value of the action.  With -k, shell actions are instead
+ * started in the background, at most actionjobs of them at a time, and
+ * reaped by sleepTight() - firings beyond that are dropped, not queued,
+ * as the rule will fire again (subject to its holdoff) if the condition
+ * persists.  STOMP messages are queued by stompSend() and written as
+ * batched frames once per evaluation round, see stompFlush().
+ ***********************************************************************/
+
+#include "pmapi.h"
+#include "libpcp.h"
+#if defined(HAVE_SYS_WAIT_H)
+#include <sys/wait.h>
+#endif
+#include "dstruct.h"
+#include "pragmatics.h"
+#include "stomp.h"
+#include "rulestats.h"
+#include "action.h"
+
+int		actionjobs;		/* 0 for synchronous shell actions */
+unsigned long	actiondropped;
+unsigned long	actionfailed;
+
+static pid_t	*jobs;			/* running shell actions */
+static int	njobs;
+
+/*
+ * Return 0 if another shell action may be started now, else -1.
+ * Children that have already finished are reaped first, so a burst of
+ * short commands is not limited to one round of actionjobs.
+ */
+int
+actionSlot(void)
+{
+#ifdef HAVE_WAITPID
+    pid_t	pid;
+    int		i, sts;
+
+    if (jobs == NULL) {
+	jobs = (pid_t *)alloc(actionjobs * sizeof(pid_t));
+	njobs = 0;
+    }
+    for (i = 0; njobs == actionjobs && i < njobs; ) {
+	pid = jobs[i];
+	if (waitpid(pid, &sts, WNOHANG) == pid)
+	    actionDone(pid, sts);	/* jobs[i] replaced */
+	else
+	    i++;
+    }
+#endif
+    return njobs < actionjobs ? 0 : -1;
+}
+
+void
+actionStart(pid_t pid)
+{
+    if (njobs < actionjobs)
+	jobs[njobs++] = pid;
+}
+
+void
+actionDone(pid_t pid, int sts)
+{
+    int		i;
+
+    for (i = 0; i < njobs; i++) {
+	if (jobs[i] != pid)
+	    continue;
+	jobs[i] = jobs[--njobs];
+#ifdef HAVE_WAITPID
+	if (!WIFEXITED(sts) || WEXITSTATUS(sts) != 0) {
+	    actionfailed++;
+	    if (pmDebugOptions.appl2)
+		fprintf(stderr, "actionDone: shell action pid=%" FMT_PID
+			" failed, status=0x%x\n", pid, sts);
+	}
+#endif
+	break;
+    }
+}
+
+int
+actionRunning(void)
+{
+    return njobs;
+}
+
+int
+actionPending(void)
+{
+    return njobs + stompQueued();
+}
+
+/*
+ * Called after each task evaluation - send any STOMP messages queued
+ * by the rules of the task, and update the exported action counters.
+ */
+void
+actionFlush(void)
+{
+    if (stomping)
+	stompFlush();
+    if (njobs > 0)
+	need_wait = 1;
+    rulestatsActions();
+}
@@ -0,0 +1,31 @@
+/***********************************************************************
+ * action.h - asynchronous action dispatch
+ ***********************************************************************
+ *
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+#ifndef ACTION_H
+#define ACTION_H
+
+extern int		actionjobs;	/* concurrent shell actions, -k */
+extern unsigned long	actiondropped;	/* actions dropped, queue full */
+extern unsigned long	actionfailed;	/* async shell actions failed */
+
+int actionSlot(void);			/* free shell job slot? */
+void actionStart(pid_t);		/* note async shell child */
+void actionDone(pid_t, int);		/* reaped child, with status */
+int actionRunning(void);			/* running shell jobs */
+int actionPending(void);		/* shell jobs + queued messages */
+void actionFlush(void);			/* end of evaluation round */
+
+#endif /* ACTION_H */
@@ -28,6 +28,7 @@
 #include "fun.h"
 #include "eval.h"
 #include "show.h"
+#include "action.h"
 
 #if defined(HAVE_VALUES_H)
 #include <values.h>
@@ -61,6 +62,9 @@ RealTime	runTime;			/* run time interval */
 int		hostZone;			/* timezone from host? */
 char		*timeZone;			/* timezone from command line */
 int		quiet;				/* suppress default diagnostics */
+int		fetchthreads = 1;		/* concurrent host fetches, -J */
+int		backtest;			/* archive backtest mode, -B */
+unsigned int	actcount;			/* actions executed, backtest */
 int		verbose;			/* verbosity 0, 1 or 2 */
 int		interactive;			/* interactive mode, -d */
 int		isdaemon;			/* run as a daemon */
@@ -81,6 +85,7 @@ pmiestats_t	instrument;			/* used if no mmap (archive) */
 
 Task		*taskq = NULL;		/* evaluator task queue */
 Expr		*curr;			/* current executing rule expression */
+unsigned int	evalcycle;		/* count of Task evaluations */
 
 SymbolTable	hosts;			/* currently known hosts */
 SymbolTable	metrics;		/* currently known metrics */
@@ -201,9 +206,9 @@ sleepTight(Task *t)
 		    fprintf(stderr, " signal=%d", WTERMSIG(sts));
 		fprintf(stderr, "\n");
 	    }
-	    ;
+	    actionDone(pid, sts);
 	}
-	need_wait = 0;
+	need_wait = actionRunning() > 0;	/* more -k shell actions */
     }
 #endif
 
@@ -320,31 +325,34 @@ sleepTight(Task *t)
  * value
  ***********************************************************************/
 
-void
-newRingBfr(Expr *x)
+/* size of one element in ring buffer of x */
+static size_t
+ringElement(Expr *x)
 {
-    size_t  sz;
-    char    *p;
-    int     i;
-
     switch (x->sem) {
 
     case SEM_BOOLEAN:
     case SEM_CHAR:
-	    sz = sizeof(char);
-	    break;
+	    return sizeof(char);
 
     default:
 	    if (x->metrics != NULL && x->metrics->desc.type == PM_TYPE_STRING)
-		sz = sizeof(char *);
-	    else
-		sz = sizeof(double);
-	    break;
+		return sizeof(char *);
+	    return sizeof(double);
     }
+}
+
+void
+newRingBfr(Expr *x)
+{
+    size_t  sz;
+    char    *p;
+    int     i;
 
-    sz *= x->tspan;
+    sz = ringElement(x) * x->tspan;
     if (x->ring) free(x->ring);
-    x->ring = zalloc(x->nsmpls * sz);
+    x->ringsz = x->nsmpls * sz;
+    x->ring = zalloc(x->ringsz);
     p = (char *)x->ring;
     for (i = 0; i < x->nsmpls; i++) {
 	x->smpls[i].ptr = (void *)p;
@@ -352,6 +360,63 @@ newRingBfr(Expr *x)
     }
 }
 
+/*
+ * Reshape ring buffer of x for a new layout of tspan instances, where
+ * element j of each sample comes from element map[j] of the current
+ * layout, or has no value yet if map[j] < 0.  Unlike newRingBfr(), the
+ * samples (and so history) are kept for the surviving instances, and
+ * the buffer only grows, so an indom that churns from one sample to the
+ * next does not cost an allocation each time.
+ *
+ * Returns 0 if the values of x cannot be remapped (strings), and the
+ * caller must start over with newRingBfr().
+ */
+static int
+remapRingBfr(Expr *x, int tspan, const int *map)
+{
+    static char	*scratch;
+    static size_t	scratchsz;
+    size_t	sz = ringElement(x);
+    size_t	oldsz = x->tspan * sz;
+    size_t	need = x->nsmpls * tspan * sz;
+    char	*p, *q;
+    int		i, j;
+
+    if (x->sem != SEM_BOOLEAN && sz != sizeof(double))
+	return 0;
+
+    /* samples in time order, as they cannot be remapped in place */
+    if (x->nsmpls * oldsz > scratchsz) {
+	scratchsz = x->nsmpls * oldsz * 2;
+	scratch = (char *)ralloc(scratch, scratchsz);
+    }
+    for (i = 0; i < x->nsmpls; i++)
+	memcpy(scratch + i * oldsz, x->smpls[i].ptr, oldsz);
+
+    if (need > x->ringsz) {
+	x->ringsz = need > 2 * x->ringsz ? need : 2 * x->ringsz;
+	free(x->ring);
+	x->ring = alloc(x->ringsz);
+    }
+    p = (char *)x->ring;
+    for (i = 0; i < x->nsmpls; i++) {
+	x->smpls[i].ptr = (void *)p;
+	q = scratch + i * oldsz;
+	if (x->sem == SEM_BOOLEAN) {
+	    for (j = 0; j < tspan; j++)
+		((Boolean *)p)[j] = map[j] < 0 ? B_UNKNOWN : ((Boolean *)q)[map[j]];
+	}
+	else {
+	    for (j = 0; j < tspan; j++)
+		((double *)p)[j] = map[j] < 0 ? mynan : ((double *)q)[map[j]];
+	}
+	p += tspan * sz;
+    }
+    x->tspan = tspan;
+    x->nvals = x->nsmpls * tspan;
+    return 1;
+}
+
 
 void
 newStringBfr(Expr *x, size_t length, char *bfr)
@@ -364,6 +429,7 @@ newStringBfr(Expr *x, size_t length, char *bfr)
     if (x->ring)
 	free(x->ring);
     x->ring = bfr;
+    x->ringsz = length;
     x->smpls[0].ptr = (void *) bfr;
 }
 
@@ -713,6 +779,7 @@ freeExpr(Expr *x)
 	    free(x->metrics);
 	}
 	if (x->ring) free(x->ring);
+	if (x->parents) free(x->parents);
 	free(x);
     }
 }
@@ -801,16 +868,42 @@ changeSmpls(Expr **p, int nsmpls)
 }
 
 
+static void instExpr(Expr *, Expr *, const int *);
+
+/*
+ * propagate changes to every parent of a (possibly shared) Expr,
+ * map (if not NULL) gives the previous position of each instance
+ * of x, after an instance domain change
+ */
+static void
+instParents(Expr *x, int up, const int *map)
+{
+    Expr    *p;
+    int	    i;
+
+    for (i = -1; i < x->nparents; i++) {
+	p = (i < 0) ? x->parent : x->parents[i];
+	if (p == NULL)
+	    continue;
+	if (up || map || (UNITS_UNKNOWN(p->units) && !UNITS_UNKNOWN(x->units)))
+	    instExpr(p, x, map);
+    }
+}
+
 /* propagate instance domain, semantics and units from
    argument expressions to parents */
 static void
-instExpr(Expr *x)
+instExpr(Expr *x, Expr *from, const int *map)
 {
     int	    up = 0;
     Expr    *arg1 = x->arg1;
     Expr    *arg2 = x->arg2;
     Expr    *arg = primary(arg1, arg2);
 
+    /* map only applies if instances of x are those of from */
+    if (from != arg || x->e_idom == -1)
+	map = NULL;
+
     /* semantics ... */
     if (x->sem == SEM_UNKNOWN) {
 	if (arg2 == NULL) {
@@ -867,7 +960,13 @@ instExpr(Expr *x)
     }
 
     /* instance domain */
-    if ((x->e_idom != -1) && (x->e_idom != arg->e_idom)) {
+    if (map && x->nsmpls > 1 && x->e_idom >= 0 && arg->e_idom >= 0 &&
+	remapRingBfr(x, arg->e_idom, map)) {
+	/* keep earlier samples, they are needed by this expression */
+	up = (x->e_idom != arg->e_idom);
+	x->e_idom = arg->e_idom;
+    }
+    else if ((x->e_idom != -1) && (x->e_idom != arg->e_idom)) {
 	up = 1;
 	x->e_idom = arg->e_idom;
 	x->tspan = (x->e_idom >= 0) ? x->e_idom : abs(x->hdom);
@@ -876,15 +975,16 @@ instExpr(Expr *x)
 	newRingBfr(x);
     }
 
-    if (up && x->parent)
-	instExpr(x->parent);
+    if (up || map)
+	instParents(x, up, map);
 }
 
 
 /* propagate instance domain, semantics and units from given
-   fetch expression to its parents */
+   fetch expression to its parents, keeping the samples of any
+   instances that remain if map is not NULL (see remapRingBfr) */
 void
-instFetchExpr(Expr *x)
+remapFetchExpr(Expr *x, const int *map)
 {
     Metric  *m;
     int     ninst;
@@ -931,7 +1031,12 @@ instFetchExpr(Expr *x)
 	}
 	m++;
     }
-    if (x->e_idom != ninst) {
+    if (map && x->e_idom >= 0 && ninst >= 0 && remapRingBfr(x, ninst, map)) {
+	/* instances changed, but samples kept for those remaining */
+	up = (x->e_idom != ninst);
+	x->e_idom = ninst;
+    }
+    else if (x->e_idom != ninst) {
 	/* number of instances is different */
 	x->e_idom = ninst;
 	x->tspan = (x->e_idom >= 0) ? x->e_idom : abs(x->hdom);
@@ -939,14 +1044,16 @@ instFetchExpr(Expr *x)
 	x->valid = 0;
 	newRingBfr(x);
 	up = 1;
+	map = NULL;
     }
-    if (x->parent) {
-	/* do we need to propagate changes? */
-	if (up ||
-	    (UNITS_UNKNOWN(x->parent->units) && !UNITS_UNKNOWN(x->units))) {
-	    instExpr(x->parent);
-	}
-    }
+    /* propagate changes, if needed */
+    instParents(x, up, map);
+}
+
+void
+instFetchExpr(Expr *x)
+{
+    remapFetchExpr(x, NULL);
 }
 
 
@@ -1180,6 +1287,13 @@ __dumpExpr(int level, Expr *x)
     for (i = 0; i < level; i++) fprintf(stderr, ".. ");
     fprintf(stderr, "  op=%d (%s) arg1=" PRINTF_P_PFX "%p arg2=" PRINTF_P_PFX "%p parent=" PRINTF_P_PFX "%p\n",
 	x->op, opStrings(x->op), x->arg1, x->arg2, x->parent);
+    if (x->nparents > 0) {
+	for (i = 0; i < level; i++) fprintf(stderr, ".. ");
+	fprintf(stderr, "  shared, other parents:");
+	for (j = 0; j < x->nparents; j++)
+	    fprintf(stderr, " " PRINTF_P_PFX "%p", x->parents[j]);
+	fputc('\n', stderr);
+    }
     for (i = 0; i < level; i++) fprintf(stderr, ".. ");
     fprintf(stderr, "  eval=");
     for (j = 0; fn_map[j].addr; j++) {
@@ -107,10 +107,13 @@ typedef struct expr {
     struct expr	    *arg1;	/* NULL || (Expr *) */
     struct expr     *arg2;	/* NULL || (Expr *) */
     struct expr	    *parent;	/* parent of this Expr */
+    struct expr	    **parents;	/* other parents, if Expr is shared */
+    int		    nparents;	/* number of other parents */
 
     /* evaluator */
     Eval	    *eval;	/* evaluator function */
     int		    valid;	/* number of valid samples */
+    unsigned int    cycle;	/* last evaluation, if Expr is shared */
 
     /* description of value matrix */
     int		    hdom;	/* cardinality of host dimension */
@@ -127,6 +130,7 @@ typedef struct expr {
 
     /* value buffer */
     void    	    *ring;	/* base address of value ring buffer */
+    size_t	    ringsz;	/* bytes allocated for ring buffer */
     Sample	    smpls[1];	/* array dynamically allocated */
 } Expr;
 
@@ -200,6 +204,7 @@ typedef struct host {
     int	    	    down;	/* host is not delivering metrics */
     Metric	    *waits;	/* wait list of Metrics */
     Metric          *duds;	/* bad Metrics discovered during evaluation */
+    struct hoststats *stats;	/* fetch instrumentation, may be NULL */
 } Host;
 
 /* element of evaluator task queue */
@@ -216,8 +221,24 @@ typedef struct task {
     Symbol	  *rules;	/* array of rules to be evaluated */
     Host          *hosts;	/* fetches to be executed and waiting */
     __pmResult	  *rslt;	/* for secret agent mode */
+    __pmHashCtl	  shares;	/* common subexpressions of rules */
+    struct trigger *trigs;	/* backtest outcomes, one per rule */
+    struct rulestats *stats;	/* rule instrumentation, may be NULL */
 } Task;
 
+/*
+ * Outcomes of a rule over a backtest run
+ */
+typedef struct trigger {
+    unsigned int  evals;	/* evaluations */
+    unsigned int  ntrue;	/* ... of which were true */
+    unsigned int  nfalse;	/* ... false */
+    unsigned int  nunknown;	/* ... unknown */
+    unsigned int  actions;	/* actions executed */
+    RealTime	  first;	/* first true evaluation */
+    RealTime	  last;		/* last true evaluation */
+} Trigger;
+
 /* value semantics - as in pmDesc plus following */
 #define SEM_UNKNOWN	0	/* semantics not yet available */
 #define SEM_NUMVAR	10	/* numeric variable value */
@@ -357,6 +378,7 @@ void rotate(Expr *);
 Expr *primary(Expr *, Expr *);
 void changeSmpls(Expr **, int);
 void instFetchExpr(Expr *);
+void remapFetchExpr(Expr *, const int *);
 char *getStringValue(Expr *, int);
 
 /***********************************************************************
@@ -405,6 +427,9 @@ extern RealTime    runTime;	/* run time interval */
 extern int	   hostZone;	/* timezone from host? */
 extern char	   *timeZone;	/* timezone from command line */
 extern int	   quiet;	/* suppress default diagnostics */
+extern int	   fetchthreads; /* concurrent host fetches, -J */
+extern int	   backtest;	/* archive backtest mode, -B */
+extern unsigned int actcount;	/* actions executed in backtest mode */
 extern int	   verbose;	/* verbosity 0, 1 or 2 */
 extern int	   interactive;	/* interactive mode, -d */
 extern int	   isdaemon;	/* run as a daemon */
@@ -426,6 +451,7 @@ extern SymbolTable metrics;	/* currently known metrics */
 
 extern Task	   *taskq;	/* evaluator task queue */
 extern Expr	   *curr;	/* current executing rule expression */
+extern unsigned int evalcycle;	/* count of Task evaluations */
 
 extern RealTime	   now;		/* current time */
 extern RealTime    start;	/* start evaluation */
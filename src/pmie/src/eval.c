@@ -26,6 +26,8 @@
 #include "fun.h"
 #include "pragmatics.h"
 #include "show.h"
+#include "rulestats.h"
+#include "action.h"
 
 /***********************************************************************
  * scheduling
@@ -198,12 +200,44 @@ enable(Task *t)
 
 int	showTimeFlag = 0;	/* set when -e used on the command line */
 
+/* accumulate backtest outcome of a Boolean rule */
+static void
+trigger(Trigger *tp, Expr *x, unsigned int actions)
+{
+    Boolean	*bp = (Boolean *)x->ring;
+    int		seen = 0;
+    int		i;
+
+    tp->actions += actions;
+    if (x->sem != SEM_BOOLEAN)
+	return;
+    /* a set of truth values is true if any one of them is true */
+    if (x->valid > 0) {
+	for (i = 0; i < x->tspan; i++)
+	    seen |= 1 << bp[i];
+    }
+    else
+	seen = 1 << B_UNKNOWN;
+    tp->evals++;
+    if (seen & (1 << B_TRUE)) {
+	if (tp->ntrue++ == 0)
+	    tp->first = now;
+	tp->last = now;
+    }
+    else if (seen & (1 << B_UNKNOWN))
+	tp->nunknown++;
+    else
+	tp->nfalse++;
+}
+
 /* evaluate Task */
 static void
 eval(Task *task)
 {
     Symbol	*s;
     pmValueSet  *vset;
+    unsigned int actions;
+    RealTime	begin = 0, end;
     int		i;
 
     if (pmDebugOptions.appl2) {
@@ -215,12 +249,24 @@ eval(Task *task)
     taskFetch(task);
 
     /* evaluate rule expressions */
+    evalcycle++;
+    if (backtest && task->trigs == NULL)
+	task->trigs = (Trigger *)zalloc(task->nrules * sizeof(Trigger));
     s = task->rules;
     for (i = 0; i < task->nrules; i++) {
 	curr = symValue(*s);
 	if (curr->op < NOP) {
+	    actions = actcount;
+	    if (task->stats)
+		begin = getReal();
 	    (curr->eval)(curr);
 	    perf->eval_actual++;
+	    if (task->stats) {
+		end = getReal();
+		rulestatsEval(task, i, end - begin, begin - task->eval);
+	    }
+	    if (backtest)
+		trigger(&task->trigs[i], curr, actcount - actions);
 	}
 	s++;
     }
@@ -859,6 +905,7 @@ run(void)
 	    enable(t);
 	reflectTime(t->delta);
 	eval(t);
+	actionFlush();
 	if (waiting(t) && t->retry == 0) {
 	    /* just failed host or metric availability */
 	    t->retry = t->delta > RETRY ? RETRY : t->delta;
@@ -909,6 +956,72 @@ run(void)
 }
 
 
+static void
+reportTime(const char *label, RealTime t)
+{
+    time_t	clock = (time_t)t;
+    char	bfr[26];
+
+    pmCtime(&clock, bfr);
+    bfr[24] = '\0';
+    printf("%s %s", label, bfr);
+}
+
+static int
+compnth(const void *a, const void *b)
+{
+    return (*(Task **)a)->nth - (*(Task **)b)->nth;
+}
+
+/*
+ * Backtest report - the outcome of each rule over the whole run,
+ * in the order the rules were given.
+ */
+void
+backtestReport(void)
+{
+    Task	*t, **tasks;
+    Trigger	*tp;
+    Symbol	*s;
+    int		ntasks = 0;
+    int		i, j;
+
+    for (t = taskq; t; t = t->next)
+	ntasks++;
+    tasks = (Task **)alloc((ntasks + 1) * sizeof(Task *));
+    for (i = 0, t = taskq; t; t = t->next)
+	tasks[i++] = t;
+    qsort(tasks, ntasks, sizeof(Task *), compnth);
+
+    printf("Backtest of archive %s (host %s)\n",
+	    archives->fname, archives->hname);
+    reportTime("  from", start);
+    reportTime(" to", stop < last ? stop : last);
+    printf("\n\n");
+
+    for (i = 0; i < ntasks; i++) {
+	t = tasks[i];
+	s = t->rules;
+	for (j = 0; j < t->nrules; j++, s++) {
+	    if (((Expr *)symValue(*s))->sem != SEM_BOOLEAN)
+		continue;
+	    tp = t->trigs ? &t->trigs[j] : NULL;
+	    printf("%s: %u evaluations, %u true, %u false, %u unknown, "
+		    "%u actions\n", symName(*s),
+		    tp ? tp->evals : 0, tp ? tp->ntrue : 0,
+		    tp ? tp->nfalse : 0, tp ? tp->nunknown : 0,
+		    tp ? tp->actions : 0);
+	    if (tp && tp->ntrue) {
+		reportTime("    first true", tp->first);
+		reportTime(", last true", tp->last);
+		putchar('\n');
+	    }
+	}
+    }
+    free(tasks);
+}
+
+
 /* invalidate all expressions being evaluated
    i.e. mark values as unknown */
 void
@@ -33,6 +33,9 @@ void findEval(Expr *);
 /* run evaluator until specified time reached */
 void run(void);
 
+/* report rule outcomes at the end of a backtest run */
+void backtestReport(void);
+
 /* invalidate one expression (and descendents) */
 void clobber(Expr *);
 
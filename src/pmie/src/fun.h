@@ -25,7 +25,18 @@
 #include "andor.h"
 
 #define ROTATE(x)  if ((x)->nsmpls > 1) rotate(x);
-#define EVALARG(x) if ((x)->op < NOP) ((x)->eval)(x);
+/* shared Expr (see pragmatics.c) is evaluated once per Task evaluation */
+#define EVALARG(x) \
+    if ((x)->op < NOP && ((x)->nparents == 0 || (x)->cycle != evalcycle)) { \
+	(x)->cycle = evalcycle; \
+	((x)->eval)(x); \
+    }
+
+/*
+ * swap B_TRUE and B_UNKNOWN, mapping truth values to their rank in
+ * Kleene logic (false < unknown < true) and ranks back to values
+ */
+#define KLEENE(v) ((((v) & 1) << 1) | (((v) >> 1) & 1))
 
 /* expression evaluator function prototypes */
 void rule(Expr *);
@@ -28,11 +28,16 @@
 #include <sys/stat.h>
 #include "pmapi.h"
 #include "libpcp.h"
+#if defined(HAVE_SYS_WAIT_H)
+#include <sys/wait.h>
+#endif
 
 #include "dstruct.h"
 #include "stomp.h"
 #include "syntax.h"
 #include "pragmatics.h"
+#include "rulestats.h"
+#include "action.h"
 #include "eval.h"
 #include "show.h"
 
@@ -92,6 +97,7 @@ static pmLongOptions longopts[] = {
     PMOPT_HOSTZONE,
     PMOPT_HELP,
     PMAPI_OPTIONS_HEADER("Runtime options"),
+    { "backtest", 0, 'B', 0, "report rule outcomes over archives, instead of actions" },
     { "check", 0, 'C', 0, "parse configuration and exit" },
     { "config", 1, 'c', "FILE", "configuration file" },
     { "interact", 0, 'd', 0, "interactive debugging mode" },
@@ -100,6 +106,8 @@ static pmLongOptions longopts[] = {
     { "systemd", 0, 'F', 0, "systemd mode - notify service manager (if any) when started and ready" },
     { "", 0, 'H', NULL }, /* was: no DNS lookup on the default hostname */
     { "", 1, 'j', "FILE", "stomp protocol (JMS) file" },
+    { "fetch-threads", 1, 'J', "N", "fetch from up to N hosts concurrently [default 1]" },
+    { "action-jobs", 1, 'k', "N", "run up to N shell actions in the background" },
     { "logfile", 1, 'l', "FILE", "send status and error messages to FILE" },
     { "username", 1, 'U', "USER", "run as named USER in daemon mode [default pcp]" },
     PMAPI_OPTIONS_HEADER("Reporting options"),
@@ -116,7 +124,7 @@ static pmLongOptions longopts[] = {
 
 static pmOptions opts = {
     .flags = PM_OPTFLAG_STDOUT_TZ,
-    .short_options = "a:A:bc:CdD:efFHh:j:l:n:O:PqS:t:T:U:vVWXxzZ:?",
+    .short_options = "a:A:bBc:CdD:efFHh:j:J:k:l:n:O:PqS:t:T:U:vVWXxzZ:?",
     .long_options = longopts,
     .short_usage = "[options] [filename ...]",
     .override = override,
@@ -461,6 +469,111 @@ sigbadproc(int sig)
 }
 
 
+/***********************************************************************
+ * backtest mode - each archive is evaluated on its own, by a child
+ * process (up to -J of them at a time), and the reports are then
+ * written out in command line order
+ ***********************************************************************/
+
+static void
+backtestArchives(void)
+{
+    Archive		*a;
+    Archive		**list;
+    FILE		**out;
+    pid_t		*pids;
+    pid_t		pid;
+    char		bfr[BUFSIZ];
+    size_t		bytes;
+    int			narchives = 0;
+    int			running = 0;
+    int			failed = 0;
+    int			next;
+    int			sts;
+    int			i;
+
+    for (a = archives; a; a = a->next)
+	narchives++;
+    if (narchives == 1)
+	return;		/* evaluated directly by this process */
+
+#ifdef IS_MINGW
+    fprintf(stderr, "%s: -B with more than one archive is not supported\n",
+	    pmGetProgname());
+    exit(1);
+#else
+    list = (Archive **)alloc(narchives * sizeof(Archive *));
+    out = (FILE **)alloc(narchives * sizeof(FILE *));
+    pids = (pid_t *)alloc(narchives * sizeof(pid_t));
+
+    /* archives list is in reverse command line order */
+    for (i = narchives - 1, a = archives; a; a = a->next)
+	list[i--] = a;
+    for (i = 0; i < narchives; i++) {
+	if ((out[i] = tmpfile()) == NULL) {
+	    fprintf(stderr, "%s: cannot create backtest report file: %s\n",
+		    pmGetProgname(), osstrerror());
+	    exit(1);
+	}
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    for (next = 0; next < narchives || running > 0; ) {
+	while (next < narchives && running < fetchthreads) {
+	    if ((pid = fork()) == 0) {
+		/* child, carry on with just this one archive */
+		a = list[next];
+		a->next = NULL;
+		archives = a;
+		first = a->first;
+		last = a->last;
+		dup2(fileno(out[next]), STDOUT_FILENO);
+		dup2(fileno(out[next]), STDERR_FILENO);
+		free(list);
+		free(out);
+		free(pids);
+		return;
+	    }
+	    if (pid < 0) {
+		fprintf(stderr, "%s: backtest fork failed: %s\n",
+			pmGetProgname(), osstrerror());
+		exit(1);
+	    }
+	    pids[next++] = pid;
+	    running++;
+	}
+	if ((pid = wait(&sts)) < 0) {
+	    if (errno == EINTR)
+		continue;
+	    break;
+	}
+	for (i = 0; i < next; i++) {
+	    if (pids[i] == pid) {
+		running--;
+		if (!WIFEXITED(sts) || WEXITSTATUS(sts) != 0) {
+		    fprintf(stderr, "%s: backtest of archive %s failed\n",
+			    pmGetProgname(), list[i]->fname);
+		    failed++;
+		}
+		break;
+	    }
+	}
+    }
+
+    for (i = 0; i < narchives; i++) {
+	if (i > 0)
+	    putchar('\n');
+	rewind(out[i]);
+	while ((bytes = fread(bfr, 1, sizeof(bfr), out[i])) > 0)
+	    fwrite(bfr, 1, bytes, stdout);
+	fclose(out[i]);
+    }
+    exit(failed ? 1 : 0);
+#endif
+}
+
+
 /***********************************************************************
  * command line processing - extract command line arguments & initialize
  ***********************************************************************/
@@ -473,6 +586,7 @@ getargs(int argc, char *argv[])
     char		*subopts;
     char		*subopt;
     char		*msg = NULL;
+    char		*endnum;
     int			checkFlag = 0;
     int			foreground = 0;
     int			primary = 0;
@@ -523,6 +637,10 @@ getargs(int argc, char *argv[])
 	    bflag++;
 	    break;
 
+	case 'B':			/* archive backtest mode */
+	    backtest = 1;
+	    break;
+
 	case 'c': 			/* configuration file */
 	    if (interactive) {
 		pmprintf("%s: at most one of -c and -d allowed\n", pmGetProgname());
@@ -580,6 +698,24 @@ getargs(int argc, char *argv[])
 	    stompfile = opts.optarg;
 	    break;
 
+	case 'J':			/* concurrent host fetches */
+	    fetchthreads = (int)strtol(opts.optarg, &endnum, 10);
+	    if (*endnum != '\0' || fetchthreads < 1) {
+		pmprintf("%s: -J requires a positive numeric argument\n",
+			pmGetProgname());
+		opts.errors++;
+	    }
+	    break;
+
+	case 'k':			/* asynchronous shell actions */
+	    actionjobs = (int)strtol(opts.optarg, &endnum, 10);
+	    if (*endnum != '\0' || actionjobs < 0) {
+		pmprintf("%s: -k requires a non-negative numeric argument\n",
+			pmGetProgname());
+		opts.errors++;
+	    }
+	    break;
+
 	case 'l':			/* alternate log file */
 	    if (commandlog != NULL) {
 		pmprintf("%s: at most one -l option is allowed\n", pmGetProgname());
@@ -640,6 +776,17 @@ getargs(int argc, char *argv[])
 		pmGetProgname());
 	opts.errors++;
     }
+    if (!opts.errors && backtest &&
+	dfltConn != PM_CONTEXT_ARCHIVE && opts.narchives == 0) {
+	pmprintf("%s: the -B option requires archives (-a)\n",
+		pmGetProgname());
+	opts.errors++;
+    }
+    if (!opts.errors && backtest && (interactive || agent || applet)) {
+	pmprintf("%s: the -B option is incompatible with -d, -x and -X\n",
+		pmGetProgname());
+	opts.errors++;
+    }
     if (opts.errors) {
     	pmUsageMessage(&opts);
 	exit(1);
@@ -655,6 +802,12 @@ getargs(int argc, char *argv[])
 	}
 	foreground = 1;
     }
+    if (archives) {
+	if (backtest)
+	    backtestArchives();
+	else if (!checkArchives())
+	    exit(1);
+    }
     if (!dfltConn && opts.nhosts) {
 	dfltConn = opts.context = PM_CONTEXT_HOST;
 	dfltHostConn = opts.hosts[c];
@@ -811,6 +964,9 @@ getargs(int argc, char *argv[])
     if (agent)
 	agentInit();			/* initialize secret agent stuff */
 
+    if (!archives && !interactive)
+	rulestatsInit(primary);		/* per-rule and per-host MMV stats */
+
     pmtimevalFromReal(now, &tv1);
     if (archives) {
 	pmtimevalFromReal(last, &tv2);
@@ -983,6 +1139,8 @@ main(int argc, char **argv)
 	interact();
     else {
 	run();
+	if (backtest)
+	    backtestReport();
 	if (systemd)
 	    __pmServerNotifyServiceManagerStopping(getpid());
     }
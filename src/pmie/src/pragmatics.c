@@ -25,11 +25,13 @@
 
 #include <math.h>
 #include <ctype.h>
+#include <pthread.h>
 #include "pmapi.h"
 #include "libpcp.h"
 #include "dstruct.h"
 #include "eval.h"
 #include "pragmatics.h"
+#include "rulestats.h"
 #if defined(HAVE_IEEEFP_H)
 #include <ieeefp.h>
 #endif
@@ -429,6 +431,8 @@ bundle(Task *t, Expr *x)
 
     if (x->op == CND_FETCH) {
 	m = x->metrics;
+	if (m->host)		/* shared, bundled by an earlier rule */
+	    return;
 	for (i = 0; i < x->hdom; i++) {
 	    h = findHost(t, m);
 	    m->host = h;
@@ -459,6 +463,250 @@ bundle(Task *t, Expr *x)
 }
 
 
+/***********************************************************************
+ * common subexpressions
+ ***********************************************************************/
+
+/*
+ * Identical subexpressions of the rules in a Task (same operators over
+ * the same metrics, hosts, instances and number of samples) are merged
+ * into one Expr, with one ring buffer, that is evaluated only once each
+ * time the Task is evaluated.  Merging is bottom-up, so the operands of
+ * two identical nodes are already the same Expr (or equal constants)
+ * and only the nodes themselves need to be compared.
+ */
+
+typedef struct {
+    Metric	*from;		/* metrics of merged duplicate */
+    Metric	*to;		/* metrics of surviving Expr */
+} Remap;
+
+static Remap	*remap;		/* Metric remapping for current rule */
+static int	nremap;
+static int	szremap;
+
+/* may this Expr be shared by several parents? */
+static int
+shareable(Expr *x)
+{
+    Metric	*m;
+    int		i;
+
+    if (x->op == RULE || x->op == CND_RULESET || x->op == CND_OTHER ||
+	x->op >= ACT_SEQ)
+	return 0;
+    if (x->op == CND_FETCH) {
+	/* uninitialized Metrics may later reshape their parents */
+	for (m = x->metrics, i = 0; i < x->hdom; m++, i++) {
+	    if (m->conv == 0)
+		return 0;
+	}
+    }
+    return 1;
+}
+
+/* is Expr below a CND_INSTANT node (no rate conversion for counters)? */
+static int
+instant(Expr *x)
+{
+    for (x = x->parent; x != NULL; x = x->parent) {
+	if (x->op == CND_INSTANT)
+	    return 1;
+    }
+    return 0;
+}
+
+static unsigned int
+hashArg(Expr *x)
+{
+    unsigned int	h = 0;
+    char		*p;
+
+    if (x == NULL)
+	return 0;
+    if (x->op == NOP && x->sem == SEM_NUMCONST && x->tspan == 1) {
+	unsigned int	bits[sizeof(double) / sizeof(unsigned int)];
+	unsigned int	i;
+
+	memcpy(bits, x->smpls[0].ptr, sizeof(double));
+	for (i = 0; i < sizeof(bits) / sizeof(bits[0]); i++)
+	    h = h * 31 + bits[i];
+	return h;
+    }
+    if (x->op == NOP && x->sem == SEM_CHAR) {
+	for (p = (char *)x->smpls[0].ptr; *p; p++)
+	    h = h * 31 + *p;
+	return h;
+    }
+    return (unsigned int)((__psint_t)x >> 4);
+}
+
+static unsigned int
+hashExpr(Expr *x)
+{
+    unsigned int	h;
+    Metric		*m;
+    int			i;
+
+    h = x->op;
+    h = h * 31 + x->nsmpls;
+    h = h * 31 + hashArg(x->arg1);
+    h = h * 31 + hashArg(x->arg2);
+    if (x->op == CND_FETCH) {
+	for (m = x->metrics, i = 0; i < x->hdom; m++, i++) {
+	    h = h * 31 + (unsigned int)((__psint_t)m->mname >> 4);
+	    h = h * 31 + (unsigned int)((__psint_t)m->hconn >> 4);
+	}
+    }
+    return h;
+}
+
+/* same operand, or constants with the same value */
+static int
+sameArg(Expr *x, Expr *y)
+{
+    if (x == y)
+	return 1;
+    if (x == NULL || y == NULL || x->op != NOP || y->op != NOP ||
+	x->sem != y->sem || x->tspan != y->tspan ||
+	memcmp(&x->units, &y->units, sizeof(pmUnits)) != 0)
+	return 0;
+    if (x->sem == SEM_NUMCONST && x->tspan == 1)
+	return *(double *)x->smpls[0].ptr == *(double *)y->smpls[0].ptr;
+    if (x->sem == SEM_CHAR)
+	return strcmp((char *)x->smpls[0].ptr, (char *)y->smpls[0].ptr) == 0;
+    return 0;
+}
+
+static int
+sameMetrics(Expr *x, Expr *y)
+{
+    Metric	*m = x->metrics;
+    Metric	*n = y->metrics;
+    int		i, j;
+
+    for (i = 0; i < x->hdom; i++, m++, n++) {
+	if (m->mname != n->mname || m->hconn != n->hconn ||
+	    m->specinst != n->specinst)
+	    return 0;
+	for (j = 0; j < m->specinst; j++) {
+	    if (strcmp(m->inames[j], n->inames[j]) != 0)
+		return 0;
+	}
+    }
+    return instant(x) == instant(y);
+}
+
+static int
+sameExpr(Expr *x, Expr *y)
+{
+    if (x->op != y->op || x->eval != y->eval || x->sem != y->sem ||
+	x->hdom != y->hdom || x->e_idom != y->e_idom ||
+	x->tdom != y->tdom || x->tspan != y->tspan ||
+	x->nsmpls != y->nsmpls ||
+	memcmp(&x->units, &y->units, sizeof(pmUnits)) != 0)
+	return 0;
+    if (!sameArg(x->arg1, y->arg1) || !sameArg(x->arg2, y->arg2))
+	return 0;
+    if (x->op == CND_FETCH)
+	return sameMetrics(x, y);
+    return 1;
+}
+
+/* record an additional parent of a shared Expr */
+static void
+addParent(Expr *x, Expr *parent)
+{
+    x->nparents++;
+    x->parents = (Expr **)ralloc(x->parents, x->nparents * sizeof(Expr *));
+    x->parents[x->nparents-1] = parent;
+}
+
+/* discard duplicate Expr x, which is being replaced by y */
+static void
+dropExpr(Expr *x, Expr *y)
+{
+    if (x->metrics != y->metrics) {
+	if (nremap == szremap) {
+	    szremap = szremap ? 2 * szremap : 8;
+	    remap = (Remap *)ralloc(remap, szremap * sizeof(Remap));
+	}
+	remap[nremap].from = x->metrics;
+	remap[nremap].to = y->metrics;
+	nremap++;
+    }
+
+    /* operands are either y's or equal constants owned by x */
+    if (x->arg1 == y->arg1) {
+	if (x->arg1 && x->arg1->parent == x)
+	    x->arg1->parent = y;
+	x->arg1 = NULL;
+    }
+    if (x->arg2 == y->arg2) {
+	if (x->arg2 && x->arg2->parent == x)
+	    x->arg2->parent = y;
+	x->arg2 = NULL;
+    }
+    freeExpr(x);
+}
+
+/*
+ * merge operands of given expression into the common subexpressions,
+ * and then the Expr itself unless it is the root of a rule
+ */
+static Expr *
+shareExpr(Task *t, Expr *x, int root)
+{
+    __pmHashNode	*hp;
+    unsigned int	key;
+    Expr		*arg;
+    Expr		*y;
+    int			new1 = 0;
+    int			new2 = 0;
+    int			i;
+
+    if (x->op >= NOP)
+	return x;
+
+    if (x->arg1 && (arg = shareExpr(t, x->arg1, 0)) != x->arg1) {
+	x->arg1 = arg;
+	new1 = 1;
+    }
+    if (x->arg2 && (arg = shareExpr(t, x->arg2, 0)) != x->arg2) {
+	x->arg2 = arg;
+	new2 = 1;
+    }
+    for (i = 0; i < nremap; i++) {
+	if (x->metrics == remap[i].from) {
+	    x->metrics = remap[i].to;
+	    break;
+	}
+    }
+
+    if (!root && shareable(x)) {
+	key = hashExpr(x);
+	for (hp = __pmHashSearch(key, &t->shares); hp; hp = hp->next) {
+	    y = (Expr *)hp->data;
+	    if (hp->key != key || y == x || !sameExpr(x, y))
+		continue;
+	    if (pmDebugOptions.appl1) {
+		fprintf(stderr, "shareExpr: " PRINTF_P_PFX "%p replaced by ", x);
+		__dumpExpr(1, y);
+	    }
+	    dropExpr(x, y);
+	    return y;
+	}
+	__pmHashAdd(key, x, &t->shares);
+    }
+
+    if (new1)
+	addParent(x->arg1, x);
+    if (new2)
+	addParent(x->arg2, x);
+    return x;
+}
+
+
 /***********************************************************************
  * secret agent mode support
  ***********************************************************************/
@@ -518,7 +766,6 @@ initArchive(Archive *a)
     struct timeval  tv;
     int		    sts;
     int		    handle;
-    Archive	    *b;
     const char	    *tmp;
 
     /* setup temorary context for the archive */
@@ -557,19 +804,7 @@ initArchive(Archive *a)
     }
     a->last = pmtimevalToReal(&tv);
 
-    /* check for duplicate host */
-    b = archives;
-    while (b) {
-	if (strcmp(a->hname, b->hname) == 0) {
-	    fprintf(stderr, "%s: Error: archive %s not legal - archive %s is already open "
-		    "for host %s\n", pmGetProgname(), a->fname, b->fname, b->hname);
-	    pmDestroyContext(handle);
-	    return 0;
-	}
-	b = b->next;
-    }
-
-    /* put archive record on the archives list */
+    /* put archive record on the archives list (see checkArchives) */
     a->next = archives;
     archives = a;
 
@@ -583,6 +818,27 @@ initArchive(Archive *a)
     return 1;
 }
 
+/*
+ * check that no two archives are for the same host, except when
+ * backtesting, where each archive is evaluated on its own
+ */
+int
+checkArchives(void)
+{
+    Archive	*a, *b;
+
+    for (a = archives; a; a = a->next) {
+	for (b = a->next; b; b = b->next) {
+	    if (strcmp(a->hname, b->hname) == 0) {
+		fprintf(stderr, "%s: Error: archive %s not legal - archive %s is already open "
+			"for host %s\n", pmGetProgname(), a->fname, b->fname, b->hname);
+		return 0;
+	    }
+	}
+    }
+    return 1;
+}
+
 
 /* initialize timezone */
 void
@@ -979,6 +1235,8 @@ pragmatics(Symbol rule, RealTime delta)
 
     if (x->op != NOP) {
 	t = findTask(delta);
+	nremap = 0;
+	shareExpr(t, x, 1);
 	bundle(t, x);
 	t->nrules++;
 	t->rules = (Symbol *) ralloc(t->rules, t->nrules * sizeof(Symbol));
@@ -1012,6 +1270,160 @@ mark_all(Host *hdown)
     }
 }
 
+/* report a failed fetch, marking live host as down */
+static void
+fetchFailed(Host *h, int sts)
+{
+    if (archives) {
+	if (sts == PM_ERR_LOGREC) {
+	    fprintf(stderr, "%s: pmFetch failed: %s\n", pmGetProgname(),
+		    pmErrStr(sts));
+	    exit(1);
+	}
+    }
+    else {
+	pmNotifyErr(LOG_ERR, "pmFetch from %s failed: %s\n",
+		symName(h->name), pmErrStr(sts));
+	host_state_changed(symName(h->conn), STATE_LOSTCONN);
+	h->down = 1;
+	mark_all(h);
+    }
+}
+
+/*
+ * Concurrent fetching (-J) - the Fetches of a Task each use their own
+ * context, so they can be issued from a pool of worker threads and one
+ * slow or unresponsive pmcd does not hold up all of the other hosts.
+ * Only pmFetch runs in the workers; results are then checked by the
+ * main thread in the usual host order, and rule evaluation (and so
+ * action execution) remains sequential.
+ */
+typedef struct {
+    pthread_mutex_t	lock;
+    pthread_cond_t	work;		/* fetches have been queued */
+    pthread_cond_t	done;		/* all queued fetches completed */
+    Fetch		**fetches;	/* fetches queued for current Task */
+    int			*status;	/* pmFetch result for each fetch */
+    RealTime		*elapsed;	/* pmFetch time for each fetch */
+    int			size;		/* allocated length of above */
+    int			nfetches;	/* number of queued fetches */
+    int			next;		/* next queued fetch to be started */
+    int			active;		/* queued fetches not yet completed */
+    int			nworkers;	/* number of worker threads */
+} FetchPool;
+
+static FetchPool	pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .work = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+};
+
+static void *
+fetchWorker(void *arg)
+{
+    Fetch	*f;
+    RealTime	begin;
+    int		i;
+    int		sts;
+
+    (void)arg;
+    pthread_mutex_lock(&pool.lock);
+    for (;;) {
+	while (pool.next >= pool.nfetches)
+	    pthread_cond_wait(&pool.work, &pool.lock);
+	i = pool.next++;
+	f = pool.fetches[i];
+	pthread_mutex_unlock(&pool.lock);
+
+	begin = getReal();
+	if ((sts = pmUseContext(f->handle)) >= 0)
+	    sts = pmFetch(f->npmids, f->pmids, &f->result);
+
+	pthread_mutex_lock(&pool.lock);
+	pool.status[i] = sts;
+	pool.elapsed[i] = getReal() - begin;
+	if (--pool.active == 0)
+	    pthread_cond_signal(&pool.done);
+    }
+    return NULL;
+}
+
+/* start worker threads on first use, returns number available */
+static int
+fetchWorkers(void)
+{
+    pthread_t	tid;
+    int		sts;
+
+    while (pool.nworkers < fetchthreads) {
+	if ((sts = pthread_create(&tid, NULL, fetchWorker, NULL)) != 0) {
+	    pmNotifyErr(LOG_WARNING, "cannot create fetch thread: %s\n",
+			strerror(sts));
+	    fetchthreads = pool.nworkers > 1 ? pool.nworkers : 1;
+	    break;
+	}
+	pthread_detach(tid);
+	pool.nworkers++;
+    }
+    return pool.nworkers;
+}
+
+/* execute all fetches for given Task using the worker threads */
+static void
+poolFetch(Task *t)
+{
+    Host	*h;
+    Fetch	*f;
+    int		i;
+    int		n = 0;
+
+    for (h = t->hosts; h; h = h->next) {
+	for (f = h->fetches; f; f = f->next) {
+	    if (f->result) pmFreeResult(f->result);
+	    f->result = NULL;
+	    if (! h->down) {
+		if (n == pool.size) {
+		    pool.size = pool.size ? pool.size * 2 : 16;
+		    pool.fetches = (Fetch **)ralloc(pool.fetches,
+					pool.size * sizeof(Fetch *));
+		    pool.status = (int *)ralloc(pool.status,
+					pool.size * sizeof(int));
+		    pool.elapsed = (RealTime *)ralloc(pool.elapsed,
+					pool.size * sizeof(RealTime));
+		}
+		pool.fetches[n++] = f;
+	    }
+	}
+    }
+    if (n == 0)
+	return;
+
+    pthread_mutex_lock(&pool.lock);
+    pool.next = 0;
+    pool.active = n;
+    pool.nfetches = n;
+    pthread_cond_broadcast(&pool.work);
+    while (pool.active > 0)
+	pthread_cond_wait(&pool.done, &pool.lock);
+    pool.nfetches = 0;
+    pthread_mutex_unlock(&pool.lock);
+
+    /* leave the same current context as sequential fetching would */
+    pmUseContext(pool.fetches[n-1]->handle);
+
+    for (i = 0; i < n; i++) {
+	f = pool.fetches[i];
+	h = f->host;
+	rulestatsFetch(h, pool.elapsed[i], pool.status[i]);
+	if (pool.status[i] >= 0 && ! h->down)
+	    continue;
+	if (f->result) pmFreeResult(f->result);
+	f->result = NULL;
+	if (! h->down)
+	    fetchFailed(h, pool.status[i]);
+    }
+}
+
 /* execute fetches for given Task */
 void
 taskFetch(Task *t)
@@ -1022,40 +1434,38 @@ taskFetch(Task *t)
     Metric	*m;
     pmResult	*r;
     pmValueSet	**v;
+    RealTime	begin;
     int		i;
     int		sts;
 
-    /* do all fetches, quick as you can */
-    h = t->hosts;
-    while (h) {
-	f = h->fetches;
-	while (f) {
-	    if (f->result) pmFreeResult(f->result);
-	    if (! h->down) {
-		pmUseContext(f->handle);
-		if ((sts = pmFetch(f->npmids, f->pmids, &f->result)) < 0) {
-		    if (archives) {
-			if (sts == PM_ERR_LOGREC) {
-			    fprintf(stderr, "%s: pmFetch failed: %s\n", pmGetProgname(),
-				    pmErrStr(sts));
-			    exit(1);
-			}
-		    }
-		    else {
-			pmNotifyErr(LOG_ERR, "pmFetch from %s failed: %s\n",
-				symName(f->host->name), pmErrStr(sts));
-			host_state_changed(symName(f->host->conn), STATE_LOSTCONN);
-			h->down = 1;
-			mark_all(h);
+    if (fetchthreads > 1 && ! archives && fetchWorkers() > 1) {
+	/* fetch from all hosts concurrently */
+	poolFetch(t);
+    }
+    else {
+	/* do all fetches, quick as you can */
+	h = t->hosts;
+	while (h) {
+	    f = h->fetches;
+	    while (f) {
+		if (f->result) pmFreeResult(f->result);
+		if (! h->down) {
+		    pmUseContext(f->handle);
+		    begin = h->stats ? getReal() : 0;
+		    sts = pmFetch(f->npmids, f->pmids, &f->result);
+		    if (h->stats)
+			rulestatsFetch(h, getReal() - begin, sts);
+		    if (sts < 0) {
+			fetchFailed(h, sts);
+			f->result = NULL;
 		    }
-		    f->result = NULL;
 		}
+		else
+		    f->result = NULL;
+		f = f->next;
 	    }
-	    else
-		f->result = NULL;
-	    f = f->next;
+	    h = h->next;
 	}
-	h = h->next;
     }
 
     /* sort and distribute pmValueSets to requesting Metrics */
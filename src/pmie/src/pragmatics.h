@@ -39,6 +39,7 @@ int newContext(Symbol *, const char *, int);
 
 /* initialize access to archive */
 int initArchive(Archive *);
+int checkArchives(void);
 
 /* initialize timezone */
 void zoneInit(void);
@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/***********************************************************************
+ * rulestats.c
+ *
+ * Per-rule and per-host cost instrumentation.  The pmiestats_t file
+ * (see stats.h) has a fixed layout with process-wide totals only, so
+ * values with one instance per rule or per host are exported through
+ * an MMV file instead, for pmdammv (and so pmlogger) to pick up.
+ ***********************************************************************/
+
+#include "pmapi.h"
+#include "libpcp.h"
+#include "rulestats.h"
+#include "action.h"
+
+#define RULE_INDOM	1
+#define HOST_INDOM	2
+
+static mmv_registry_t	*registry;
+static void		*actionmap;	/* for the process-wide values */
+static pmAtomValue	*pending, *dropped, *failed;
+
+static pmUnits usec = MMV_UNITS(0,1,0,0,PM_TIME_USEC,0);
+static pmUnits count = MMV_UNITS(0,0,1,0,0,PM_COUNT_ONE);
+
+static void
+rulestatsStop(void)
+{
+    /* the file is removed too, as registry has MMV_FLAG_PROCESS */
+    if (registry) {
+	mmv_stats_free(registry);
+	registry = NULL;
+    }
+}
+
+/* number of values held in the ring buffers of an expression tree */
+static int
+ringValues(Expr *x)
+{
+    int		n = 0;
+
+    while (x) {
+	n += x->nvals;
+	if (x->arg2)
+	    n += ringValues(x->arg2);
+	x = x->arg1;
+    }
+    return n;
+}
+
+/* earlier Host in taskq with the same connection as h, if any */
+static Host *
+sameHost(Host *h)
+{
+    Task	*t;
+    Host	*p;
+
+    for (t = taskq; t; t = t->next) {
+	for (p = t->hosts; p; p = p->next) {
+	    if (p == h)
+		return NULL;
+	    if (p->conn == h->conn)
+		return p;
+	}
+    }
+    return NULL;
+}
+
+static void
+lookupHandle(void *map, const char *metric, const char *inst,
+		mmv_value_handle_t *hp)
+{
+    pmAtomValue	*value;
+
+    if ((value = mmv_lookup_value_desc(map, metric, inst)) == NULL ||
+	mmv_lookup_value_handle(map, value, hp) < 0)
+	memset(hp, 0, sizeof(*hp));
+}
+
+void
+rulestatsInit(int isprimary)
+{
+    Task	*t;
+    Host	*h, *p;
+    Expr	*x;
+    void	*map;
+    char	*file, name[MAXPATHLEN];
+    int		i, nrules = 0, nhosts = 0;
+
+    if (taskq == NULL)
+	return;
+
+    /* the primary pmie has well-known metric names, others are by PID */
+    if (isprimary)
+	pmsprintf(name, sizeof(name), "pmie");
+    else
+	pmsprintf(name, sizeof(name), "pmie.%" FMT_PID, (pid_t)getpid());
+    if ((file = strdup(name)) == NULL ||
+	(registry = mmv_stats_registry(file, 0, MMV_FLAG_PROCESS)) == NULL) {
+	fprintf(stderr, "%s: warning cannot create rule stats: %s\n",
+		pmGetProgname(), osstrerror());
+	if (file)
+	    free(file);
+	return;
+    }
+
+    mmv_stats_add_indom(registry, RULE_INDOM, "pmie rules",
+	"Instance domain of rules loaded by this pmie, by rule name");
+    mmv_stats_add_indom(registry, HOST_INDOM, "pmie hosts",
+	"Instance domain of hosts (or archives) being fetched from,\n"
+	"identified by host specification as given in the rules");
+    for (t = taskq; t; t = t->next) {
+	for (i = 0; i < t->nrules; i++) {
+	    x = symValue(t->rules[i]);
+	    if (x->op < NOP)
+		mmv_stats_add_instance(registry, RULE_INDOM, nrules++,
+				symName(t->rules[i]));
+	}
+	for (h = t->hosts; h; h = h->next) {
+	    if (sameHost(h) == NULL)
+		mmv_stats_add_instance(registry, HOST_INDOM, nhosts++,
+				symName(h->conn));
+	}
+    }
+
+    mmv_stats_add_metric(registry, "rule.evaluations", 1, MMV_TYPE_U64,
+	MMV_SEM_COUNTER, count, RULE_INDOM,
+	"Number of times each rule has been evaluated", NULL);
+    mmv_stats_add_metric(registry, "rule.eval_time", 2, MMV_TYPE_U64,
+	MMV_SEM_COUNTER, usec, RULE_INDOM,
+	"Cumulative time spent evaluating each rule",
+	"Time spent in the evaluator for the rule expression, including\n"
+	"any actions it executed, but excluding the metric fetches.");
+    mmv_stats_add_metric(registry, "rule.lateness", 3, MMV_TYPE_U64,
+	MMV_SEM_COUNTER, usec, RULE_INDOM,
+	"Cumulative lateness of each rule evaluation",
+	"Sum over all evaluations of the time between the scheduled\n"
+	"evaluation time of the rule and the start of its evaluation.\n"
+	"This includes metric fetches for the rule and evaluation of\n"
+	"the rules preceding it in the same sample interval.");
+    mmv_stats_add_metric(registry, "rule.last_lateness", 4, MMV_TYPE_U64,
+	MMV_SEM_INSTANT, usec, RULE_INDOM,
+	"Lateness of the most recent evaluation of each rule", NULL);
+    mmv_stats_add_metric(registry, "rule.ring_size", 5, MMV_TYPE_U32,
+	MMV_SEM_INSTANT, count, RULE_INDOM,
+	"Values held in the sample ring buffers for each rule",
+	"Number of values held by all the nodes of the expression of\n"
+	"the rule, which grows with the number of hosts, instances and\n"
+	"samples the rule covers.");
+    mmv_stats_add_metric(registry, "host.fetches", 6, MMV_TYPE_U64,
+	MMV_SEM_COUNTER, count, HOST_INDOM,
+	"Number of pmFetch calls to each host", NULL);
+    mmv_stats_add_metric(registry, "host.fetch_time", 7, MMV_TYPE_U64,
+	MMV_SEM_COUNTER, usec, HOST_INDOM,
+	"Cumulative time spent in pmFetch for each host", NULL);
+    mmv_stats_add_metric(registry, "host.fetch_errors", 8, MMV_TYPE_U64,
+	MMV_SEM_COUNTER, count, HOST_INDOM,
+	"Number of failed pmFetch calls to each host", NULL);
+    mmv_stats_add_metric(registry, "action.pending", 9, MMV_TYPE_U32,
+	MMV_SEM_INSTANT, count, MMV_INDOM_NULL,
+	"Actions started or queued but not yet completed",
+	"Number of asynchronous shell actions still running (see -k) plus\n"
+	"the number of messages queued for the STOMP server.");
+    mmv_stats_add_metric(registry, "action.dropped", 10, MMV_TYPE_U64,
+	MMV_SEM_COUNTER, count, MMV_INDOM_NULL,
+	"Action firings dropped because the action queue was full",
+	"Shell actions dropped because -k shell actions were already\n"
+	"running, and STOMP messages dropped because the message queue\n"
+	"was full.");
+    mmv_stats_add_metric(registry, "action.failed", 11, MMV_TYPE_U64,
+	MMV_SEM_COUNTER, count, MMV_INDOM_NULL,
+	"Asynchronous shell actions that exited with non-zero status", NULL);
+
+    if ((map = mmv_stats_start(registry)) == NULL) {
+	fprintf(stderr, "%s: warning cannot create rule stats file %s: %s\n",
+		pmGetProgname(), file, osstrerror());
+	mmv_stats_free(registry);
+	registry = NULL;
+	return;
+    }
+    atexit(rulestatsStop);
+
+    actionmap = map;
+    pending = mmv_lookup_value_desc(map, "action.pending", NULL);
+    dropped = mmv_lookup_value_desc(map, "action.dropped", NULL);
+    failed = mmv_lookup_value_desc(map, "action.failed", NULL);
+
+    /* resolve all the values once, so updates are direct */
+    for (t = taskq; t; t = t->next) {
+	t->stats = (RuleStats *)zalloc(t->nrules * sizeof(RuleStats));
+	for (i = 0; i < t->nrules; i++) {
+	    RuleStats	*rp = &t->stats[i];
+	    const char	*inst = symName(t->rules[i]);
+
+	    x = symValue(t->rules[i]);
+	    if (x->op >= NOP)
+		continue;
+	    lookupHandle(map, "rule.evaluations", inst, &rp->evals);
+	    lookupHandle(map, "rule.eval_time", inst, &rp->evaltime);
+	    lookupHandle(map, "rule.lateness", inst, &rp->lateness);
+	    rp->late = mmv_lookup_value_desc(map, "rule.last_lateness", inst);
+	    rp->ringsize = mmv_lookup_value_desc(map, "rule.ring_size", inst);
+	}
+	for (h = t->hosts; h; h = h->next) {
+	    if ((p = sameHost(h)) != NULL) {
+		h->stats = p->stats;
+		continue;
+	    }
+	    h->stats = (HostStats *)zalloc(sizeof(HostStats));
+	    lookupHandle(map, "host.fetches", symName(h->conn), &h->stats->fetches);
+	    lookupHandle(map, "host.fetch_time", symName(h->conn), &h->stats->fetchtime);
+	    lookupHandle(map, "host.fetch_errors", symName(h->conn), &h->stats->errors);
+	}
+    }
+}
+
+/* account for evaluation of i-th rule of Task */
+void
+rulestatsEval(Task *t, int i, RealTime elapsed, RealTime late)
+{
+    RuleStats	*rp;
+
+    if (t->stats == NULL)
+	return;
+    rp = &t->stats[i];
+    if (late < 0)
+	late = 0;
+    mmv_handle_inc(&rp->evals);
+    mmv_handle_inc_value(&rp->evaltime, elapsed * 1000000);
+    mmv_handle_inc_value(&rp->lateness, late * 1000000);
+    mmv_set_value(rp->evals.addr, rp->late, late * 1000000);
+    mmv_set_value(rp->evals.addr, rp->ringsize,
+		ringValues(symValue(t->rules[i])));
+}
+
+/* account for one pmFetch from Host */
+void
+rulestatsFetch(Host *h, RealTime elapsed, int sts)
+{
+    HostStats	*hp = h->stats;
+
+    if (hp == NULL)
+	return;
+    mmv_handle_inc(&hp->fetches);
+    mmv_handle_inc_value(&hp->fetchtime, elapsed * 1000000);
+    if (sts < 0)
+	mmv_handle_inc(&hp->errors);
+}
+
+/* export the action dispatch counters, once per evaluation round */
+void
+rulestatsActions(void)
+{
+    if (registry == NULL)
+	return;
+    mmv_set_value(actionmap, pending, actionPending());
+    mmv_set_value(actionmap, dropped, actiondropped);
+    mmv_set_value(actionmap, failed, actionfailed);
+}
@@ -0,0 +1,44 @@
+/***********************************************************************
+ * rulestats.h - per-rule and per-host instrumentation via MMV
+ ***********************************************************************
+ *
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+#ifndef RULESTATS_H
+#define RULESTATS_H
+
+#include "mmv_stats.h"
+#include "dstruct.h"
+
+/* MMV values for one rule, indexed like Task rules */
+typedef struct rulestats {
+    mmv_value_handle_t	evals;		/* evaluations */
+    mmv_value_handle_t	evaltime;	/* cumulative evaluation time */
+    mmv_value_handle_t	lateness;	/* cumulative lateness */
+    pmAtomValue		*late;		/* lateness of last evaluation */
+    pmAtomValue		*ringsize;	/* values held by expression tree */
+} RuleStats;
+
+/* MMV values for one host, shared by all Tasks fetching from it */
+typedef struct hoststats {
+    mmv_value_handle_t	fetches;	/* pmFetch calls */
+    mmv_value_handle_t	fetchtime;	/* cumulative pmFetch time */
+    mmv_value_handle_t	errors;		/* failed pmFetch calls */
+} HostStats;
+
+void rulestatsInit(int);		/* create MMV file for taskq */
+void rulestatsEval(Task *, int, RealTime, RealTime);
+void rulestatsFetch(Host *, RealTime, int);
+void rulestatsActions(void);
+
+#endif /* RULESTATS_H */
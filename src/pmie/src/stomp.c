@@ -31,6 +31,11 @@ static char *username = NULL;
 static char *passcode = NULL;
 static char *topic = NULL;		/* JMS "topic" for pmie messages */
 static char pmietopic[] = "PMIE";	/* default JMS "topic" for pmie */
+static int batch = 1;			/* messages per SEND frame */
+static int queuemax = 1000;		/* messages held between rounds */
+
+static char **queue;			/* messages waiting for stompFlush */
+static int nqueue;
 
 static char buffer[4096];
 
@@ -246,6 +251,8 @@ static char *isspace_terminate(char *string)
  *	passcode=<password> | password=<password>
  *	timeout=<seconds>	# optional
  *	topic=<JMStopic>	# optional
+ *	batch=<count>		# optional, messages per frame
+ *	queue=<count>		# optional, messages held for sending
  */
 static void stomp_parse(void)
 {
@@ -305,6 +312,16 @@ static void stomp_parse(void)
 		free(topic);
 	    topic = strdup(isspace_terminate(&buffer[6]));
 	}
+	else if (strncmp(buffer, "batch=", 6) == 0) {	/* optional */
+	    batch = atoi(isspace_terminate(&buffer[6]));
+	    if (batch < 1)
+		batch = 1;
+	}
+	else if (strncmp(buffer, "queue=", 6) == 0) {	/* optional */
+	    queuemax = atoi(isspace_terminate(&buffer[6]));
+	    if (queuemax < 1)
+		queuemax = 1;
+	}
     }
     fclose(f);
 
@@ -400,22 +417,70 @@ finished:
 }
 
 /*
- * Send a message to the stomp server.
+ * Queue a message for the stomp server, it is sent by the next call to
+ * stompFlush() at the end of the current evaluation round.  Returns -1
+ * if the queue is full (e.g. the server has been unreachable for some
+ * time), in which case the message is dropped.
  */
 int stompSend(const char *msg)
 {
-    int len;
+    char *m;
 
-    if (fd < 0) stompInit();	/* reconnect */
-    if (fd < -1) return -1;
-
-    len = pmsprintf(buffer, sizeof(buffer),
-		   "SEND\ndestination:/topic/%s\n\n", topic);
-    if (stomp_write(buffer, len) < 0)
+    if (queue == NULL &&
+	(queue = (char **)malloc(queuemax * sizeof(char *))) == NULL) {
+	pmNoMem("stompSend", queuemax * sizeof(char *), PM_RECOV_ERR);
 	return -1;
-    if (stomp_write(msg, strlen(msg)) < 0)
+    }
+    if (nqueue >= queuemax)
 	return -1;
-    if (stomp_write("\0\n", 2) < 0)
+    if ((m = strdup(msg)) == NULL) {
+	pmNoMem("stompSend", strlen(msg) + 1, PM_RECOV_ERR);
 	return -1;
+    }
+    queue[nqueue++] = m;
     return 0;
 }
+
+int stompQueued(void)
+{
+    return nqueue;
+}
+
+/*
+ * Send queued messages to the stomp server, up to batch messages (one
+ * per line) in each SEND frame.  Messages that could not be sent stay
+ * queued for the next round, after a reconnect attempt.
+ */
+void stompFlush(void)
+{
+    int i, n, len, sent = 0;
+
+    if (nqueue == 0)
+	return;
+    if (fd < 0) stompInit();	/* reconnect */
+
+    while (fd >= 0 && sent < nqueue) {
+	n = nqueue - sent;
+	if (n > batch)
+	    n = batch;
+	len = pmsprintf(buffer, sizeof(buffer),
+		       "SEND\ndestination:/topic/%s\n\n", topic);
+	if (stomp_write(buffer, len) < 0)
+	    break;
+	for (i = sent; i < sent + n; i++) {
+	    if (i > sent && stomp_write("\n", 1) < 0)
+		break;
+	    if (stomp_write(queue[i], strlen(queue[i])) < 0)
+		break;
+	}
+	if (i < sent + n || stomp_write("\0\n", 2) < 0)
+	    break;
+	sent += n;
+    }
+
+    for (i = 0; i < sent; i++)
+	free(queue[i]);
+    nqueue -= sent;
+    if (nqueue > 0 && sent > 0)
+	memmove(queue, &queue[sent], nqueue * sizeof(char *));
+}
@@ -23,4 +23,6 @@
 extern int stomping;			/* true if stomp actions present */
 extern char *stompfile;			/* stomp config file */
 extern int stompInit(void);		/* connect to stomp server */
-extern int stompSend(const char *);	/* send to JMS server, via stomp */
+extern int stompSend(const char *);	/* queue for JMS server, via stomp */
+extern int stompQueued(void);		/* count of queued messages */
+extern void stompFlush(void);		/* send queued messages */
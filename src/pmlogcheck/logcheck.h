@@ -6,9 +6,33 @@
 #define STATE_MISSING	2
 #define STATE_BAD	3
 
+#define IS_UNKNOWN	0
+#define IS_INDEX	1
+#define IS_META		2
+#define IS_LOG		3
+
+#define CKSUM_NONE	0	/* not checked against a checksum file */
+#define CKSUM_OK	1	/* whole volume matches its checksums */
+#define CKSUM_BAD	2	/* checksum mismatch or truncated volume */
+
+/*
+ * pass0 state and results for one file of the archive
+ */
+typedef struct {
+    char		*fname;
+    FILE		*out;		/* diagnostics, stderr or a buffer */
+    int			is;		/* IS_INDEX, IS_META or IS_LOG */
+    int			sts;		/* STS_* for the file's records */
+    int			label_sts;	/* STS_* for the file's label */
+    int			magic;		/* from a good label, else 0 */
+    __pmTimestamp	start;		/* from a good label */
+    int			cksum;		/* CKSUM_* for data volumes */
+} pass0_t;
+
 extern char		sep;
 extern int		vflag;
 extern int		nowrap;
+extern int		kflag;
 extern int		index_state;
 extern int		meta_state;
 extern int		log_state;
@@ -19,7 +43,7 @@ extern char *		goldenfname;
 extern int		goldenmagic;
 extern __pmTimestamp	goldenstart;
 
-extern int pass0(char *);
+extern void pass0(pass0_t *);
 extern int pass1(__pmContext *, char *);
 extern int pass2(__pmContext *, char *);
 extern int pass3(__pmContext *, char *, pmOptions *);
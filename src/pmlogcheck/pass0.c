@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2017,2021 Red Hat.
+ * Copyright (c) 2017,2021,2026 Red Hat.
  * Copyright (c) 2013 Ken McDonell, Inc.  All Rights Reserved.
  * 
  * This program is free software; you can redistribute it and/or modify it
@@ -23,10 +23,6 @@ int		goldenmagic;
 char * 		goldenfname;
 __pmTimestamp	goldenstart;
 
-#define IS_UNKNOWN	0
-#define IS_INDEX	1
-#define IS_META		2
-#define IS_LOG		3
 /*
  * Pass 0 for all files
  * - should only come here if fname exists
@@ -43,6 +39,13 @@ __pmTimestamp	goldenstart;
  * - for index files, following the label record there should be
  *   a number of complete records, each of which is a __pmLogTI
  *   record, with the fields converted network byte order
+ * - for data volumes with a checksum file (see pmlogger -k), and
+ *   if asked to (-k), verify the checksums instead
+ *
+ * Files may be checked concurrently (-j), so nothing here touches
+ * the global state ... the results are left in the pass0_t and
+ * merged by the caller, in file order, and all diagnostics go to
+ * p->out.
  *
  * TODO - repair
  * - truncate metadata and data files ... unconditional or interactive confirm?
@@ -53,35 +56,36 @@ __pmTimestamp	goldenstart;
 /*
  * Already checked len in header and trailer, so just read label
  * directly.
- * If not first file, check label consistency.
- * Checks here mimic those in __pmLogChkLabel().
+ * Checks here mimic those in __pmLogChkLabel(), the consistency of
+ * labels across files is checked later, when results are merged.
  */
 static int
-checklabel(__pmFILE *f, char *fname, int len)
+checklabel(pass0_t *p, __pmFILE *f)
 {
     __pmLogLabel	label;
     size_t		bytes;
     long		offset = __pmFtell(f);
     __int32_t		magic;
     int			sts = STS_OK;
+    char		errmsg[PM_MAXERRMSGLEN];
 
     /* first read the magic number for sanity and version checking */
     __pmFseek(f, sizeof(__int32_t), SEEK_SET);
     if ((bytes = __pmFread(&magic, 1, sizeof(magic), f)) != sizeof(magic)) {
-	fprintf(stderr, "checklabel(...,%s): botch: magic read returns %zu not %zu as expected\n", fname, bytes, sizeof(magic));
+	fprintf(p->out, "checklabel(...,%s): botch: magic read returns %zu not %zu as expected\n", p->fname, bytes, sizeof(magic));
 	sts = STS_FATAL;
     }
 
     magic = ntohl(magic);
     if ((magic & 0xffffff00) != PM_LOG_MAGIC) {
-	fprintf(stderr, "%s: bad label magic number: 0x%x not 0x%x as expected\n",
-	    fname, magic & 0xffffff00, PM_LOG_MAGIC);
+	fprintf(p->out, "%s: bad label magic number: 0x%x not 0x%x as expected\n",
+	    p->fname, magic & 0xffffff00, PM_LOG_MAGIC);
 	sts = STS_FATAL;
     }
     if ((magic & 0xff) != PM_LOG_VERS02 &&
         (magic & 0xff) != PM_LOG_VERS03) {
-	fprintf(stderr, "%s: bad label version: %d not %d or %d as expected\n",
-	    fname, magic & 0xff, PM_LOG_VERS02, PM_LOG_VERS03);
+	fprintf(p->out, "%s: bad label version: %d not %d or %d as expected\n",
+	    p->fname, magic & 0xff, PM_LOG_VERS02, PM_LOG_VERS03);
 	sts = STS_FATAL;
     }
 
@@ -90,21 +94,13 @@ checklabel(__pmFILE *f, char *fname, int len)
     if ((sts = __pmLogLoadLabel(f, &label)) < 0) {
 	/* don't report again if error already reported above */
 	if (sts != STS_FATAL)
-	    fprintf(stderr, "%s: cannot load label record: %s\n", fname, pmErrStr(sts));
+	    fprintf(p->out, "%s: cannot load label record: %s\n", p->fname, pmErrStr_r(sts, errmsg, sizeof(errmsg)));
 	sts = STS_FATAL;
     }
     else {
-	if (goldenmagic == 0) {
-	    if (sts == STS_OK) {
-		/* first good label */
-		goldenfname = strdup(fname);
-		goldenmagic = magic;
-		goldenstart = label.start;
-	    }
-	} else if ((magic & 0xff) != (goldenmagic & 0xff)) {
-	    fprintf(stderr, "%s: mismatched label version: %d not %d as expected from %s\n",
-				fname, magic & 0xff, magic & 0xff, goldenfname);
-	    sts = STS_FATAL;
+	if (sts == STS_OK) {
+	    p->magic = magic;
+	    p->start = label.start;
 	}
 	__pmLogFreeLabel(&label);
     }
@@ -112,68 +108,196 @@ checklabel(__pmFILE *f, char *fname, int len)
     return sts; 
 }
 
-int
-pass0(char *fname)
+/*
+ * Verify a data volume against its checksum file, block by block.
+ * Returns CKSUM_OK if every byte of the volume is covered and matches,
+ * CKSUM_BAD for a mismatch or a truncated volume, else CKSUM_NONE (no
+ * checksum file, or one that does not cover the whole volume) and the
+ * volume is left for the usual record by record checks.
+ */
+static int
+checksums(pass0_t *p, __pmFILE *f, const char *sumname)
+{
+    __pmFILE	*sf;
+    char	*sbuf = NULL;
+    char	*buf = NULL;
+    char	*line, *next;
+    size_t	slen = 0, salloc = 0;
+    size_t	bytes;
+    size_t	blocksize;
+    long long	offset, len, covered = 0;
+    unsigned int crc;
+    int		nblock = 0, nbad = 0;
+    int		c;
+    int		sts = CKSUM_NONE;
+
+    if ((sf = __pmFopen(sumname, "r")) == NULL) {
+	if (vflag > 1)
+	    fprintf(p->out, "%s: no checksum file\n", p->fname);
+	return CKSUM_NONE;
+    }
+    /*
+     * small, one line per block, so read it all ... a byte at a time
+     * because short reads at EOF are not reported by all handlers
+     */
+    while ((c = __pmFgetc(sf)) != EOF) {
+	if (slen + 1 >= salloc) {
+	    salloc = salloc ? 2 * salloc : BUFSIZ;
+	    if ((sbuf = (char *)realloc(sbuf, salloc)) == NULL) {
+		pmNoMem("pass0: checksum file", salloc, PM_FATAL_ERR);
+		/* NOTREACHED */
+	    }
+	}
+	sbuf[slen++] = c;
+    }
+    if (sbuf == NULL) {
+	fprintf(p->out, "%s: empty checksum file, ignored\n", sumname);
+	__pmFclose(sf);
+	return CKSUM_NONE;
+    }
+    __pmFclose(sf);
+    sbuf[slen] = '\0';
+
+    line = strtok_r(sbuf, "\n", &next);
+    if (line == NULL ||
+	sscanf(line, "PCP checksum crc32 %zu", &blocksize) != 1 ||
+	blocksize == 0) {
+	fprintf(p->out, "%s: bad checksum file header, ignored\n", sumname);
+	goto done;
+    }
+    if ((buf = (char *)malloc(blocksize)) == NULL) {
+	pmNoMem("pass0: checksum block", blocksize, PM_FATAL_ERR);
+	/* NOTREACHED */
+    }
+
+    while ((line = strtok_r(NULL, "\n", &next)) != NULL) {
+	if (line[0] == '#')
+	    /* checksums end here, e.g. the volume was rewritten */
+	    break;
+	if (sscanf(line, "%lld %lld %x", &offset, &len, &crc) != 3 ||
+	    offset != covered || len <= 0 || len > (long long)blocksize) {
+	    fprintf(p->out, "%s: bad checksum record \"%s\", ignored\n", sumname, line);
+	    goto done;
+	}
+	if ((bytes = __pmFread(buf, 1, len, f)) != (size_t)len) {
+	    fprintf(p->out, "%s: unexpected EOF in checksum block at offset %lld, wanted %lld, got %zu bytes\n", p->fname, offset, len, bytes);
+	    sts = CKSUM_BAD;
+	    goto done;
+	}
+	if (__pmCRC32(0, buf, len) != crc) {
+	    fprintf(p->out, "%s: checksum mismatch in block at offset %lld, length %lld\n", p->fname, offset, len);
+	    nbad++;
+	}
+	covered += len;
+	nblock++;
+    }
+    if (nbad > 0) {
+	sts = CKSUM_BAD;
+	goto done;
+    }
+    if (covered == 0 || __pmFread(buf, 1, 1, f) != 0) {
+	if (vflag)
+	    fprintf(p->out, "%s: checksums cover only %lld bytes, checking records\n", p->fname, covered);
+	goto done;
+    }
+    if (vflag)
+	fprintf(p->out, "%s: verified %d checksum blocks, %lld bytes\n", p->fname, nblock, covered);
+    sts = CKSUM_OK;
+
+done:
+    free(buf);
+    free(sbuf);
+    return sts;
+}
+
+void
+pass0(pass0_t *p)
 {
     int		len;
     int		check;
     int		type;
-    int		i;
     int		sts;
     int		nrec = 0;
-    int		is = IS_UNKNOWN;
     int		eol;
-    char	*p;
+    char	*q = NULL;
+    char	*body = NULL;
+    size_t	bodylen = 0;
+    size_t	bytes;
     __pmFILE	*f = NULL;
     int		label_ok = STS_OK;
     char	logBase[MAXPATHLEN];
+    char	errmsg[PM_MAXERRMSGLEN];
     long	offset = 0;
 
-    if ((f = __pmFopen(fname, "r")) == NULL) {
-	fprintf(stderr, "%s: cannot open file: %s\n", fname, osstrerror());
+    if ((f = __pmFopen(p->fname, "r")) == NULL) {
+	fprintf(p->out, "%s: cannot open file: %s\n", p->fname, osstrerror_r(errmsg, sizeof(errmsg)));
 	sts = STS_FATAL;
 	goto done;
     }
     
-    strncpy(logBase, fname, sizeof(logBase));
+    strncpy(logBase, p->fname, sizeof(logBase));
     logBase[sizeof(logBase)-1] = '\0';
     if (__pmLogBaseName(logBase) != NULL) {
 	/* A valid archive suffix was found */
-	p = logBase + strlen(logBase) + 1;
-	if (strcmp(p, "index") == 0)
-	    is = IS_INDEX;
-	else if (strcmp(p, "meta") == 0)
-	    is = IS_META;
-	else if (isdigit((int)(*p))) {
-	    is = IS_LOG;
+	q = logBase + strlen(logBase) + 1;
+	if (strcmp(q, "index") == 0)
+	    p->is = IS_INDEX;
+	else if (strcmp(q, "meta") == 0)
+	    p->is = IS_META;
+	else if (isdigit((int)(*q))) {
+	    p->is = IS_LOG;
 	}
     }
-    if (is == IS_UNKNOWN) {
+    if (p->is == IS_UNKNOWN) {
 	/*
 	 * should never get here because filter() is supposed to
 	 * only include PCP archive file names from scandir()
 	 */
-	fprintf(stderr, "%s: pass0 botch: bad file name?\n", fname);
+	fprintf(stderr, "%s: pass0 botch: bad file name?\n", p->fname);
 	exit(1);
     }
 
     if (vflag) {
-	fprintf(stderr, "%s: start pass0 ... ", fname);
+	fprintf(p->out, "%s: start pass0 ... ", p->fname);
 	eol = 0;
     }
 
+    if (p->is == IS_LOG && kflag) {
+	char	sumname[MAXPATHLEN];
+
+	/* logBase is now <base>\0<vol>, so put back the '.' */
+	q[-1] = '.';
+	pmsprintf(sumname, sizeof(sumname), "%s%s", logBase, PM_LOG_CKSUM_SUFFIX);
+	if (vflag) {
+	    fputc('\n', p->out);
+	    eol = 1;
+	}
+	p->cksum = checksums(p, f, sumname);
+	if (p->cksum == CKSUM_BAD) {
+	    sts = STS_FATAL;
+	    goto done;
+	}
+	__pmRewind(f);
+	if (p->cksum == CKSUM_OK) {
+	    /* bytes are as written, but still need label details */
+	    label_ok = checklabel(p, f);
+	    sts = STS_OK;
+	    goto done;
+	}
+    }
+
     type = 0;
     while ((sts = __pmFread(&len, 1, sizeof(len), f)) == sizeof(len)) {
 	len = ntohl(len);
 	if (len < 2 * sizeof(len)) {
 	    if (vflag && !eol) {
-		fputc('\n', stderr);
+		fputc('\n', p->out);
 		eol = 1;
 	    }
 	    if (nrec == 0)
-		fprintf(stderr, "%s: illegal header record length (%d) in label record\n", fname, len);
+		fprintf(p->out, "%s: illegal header record length (%d) in label record\n", p->fname, len);
 	    else
-		fprintf(stderr, "%s[record %d]: illegal header record length (%d)\n", fname, nrec, len);
+		fprintf(p->out, "%s[record %d]: illegal header record length (%d)\n", p->fname, nrec, len);
 	    sts = STS_FATAL;
 	    goto done;
 	}
@@ -182,80 +306,85 @@ pass0(char *fname)
 	 * gobble stuff between header and trailer without looking at it
 	 * ... except for the record type in the case of metadata records
 	 */
-	for (i = 0; i < len; i++) {
-	    check = __pmFgetc(f);
-	    if (check == EOF) {
-		if (vflag && !eol) {
-		    fputc('\n', stderr);
-		    eol = 1;
-		}
-		if (nrec == 0)
-		    fprintf(stderr, "%s: unexpected EOF in label record body, wanted %d, got %d bytes\n", fname, len, i);
-		else
-		    fprintf(stderr, "%s[record %d]: unexpected EOF in record body, wanted %d, got %d bytes\n", fname, nrec, len, i);
-		sts = STS_FATAL;
-		goto done;
+	if (len > bodylen) {
+	    bodylen = len;
+	    if ((body = (char *)realloc(body, bodylen)) == NULL) {
+		pmNoMem("pass0: record buffer", bodylen, PM_FATAL_ERR);
+		/* NOTREACHED */
 	    }
-	    if (is == IS_META && i <= 3 && nrec > 0) {
-		/*
-		 * first word (after len) for metadata record, save type
-		 */
-		type = (type << 8) | check;
+	}
+	if ((bytes = __pmFread(body, 1, len, f)) != len) {
+	    if (vflag && !eol) {
+		fputc('\n', p->out);
+		eol = 1;
 	    }
+	    if (nrec == 0)
+		fprintf(p->out, "%s: unexpected EOF in label record body, wanted %d, got %d bytes\n", p->fname, len, (int)bytes);
+	    else
+		fprintf(p->out, "%s[record %d]: unexpected EOF in record body, wanted %d, got %d bytes\n", p->fname, nrec, len, (int)bytes);
+	    sts = STS_FATAL;
+	    goto done;
+	}
+	if (p->is == IS_META && nrec > 0 && len >= sizeof(type)) {
+	    /*
+	     * first word (after len) for metadata record, save type
+	     */
+	    memcpy(&type, body, sizeof(type));
+	    type = ntohl(type);
 	}
 	if ((sts = __pmFread(&check, 1, sizeof(check), f)) != sizeof(check)) {
 	    if (vflag && !eol) {
-		fputc('\n', stderr);
+		fputc('\n', p->out);
 		eol = 1;
 	    }
 	    if (nrec == 0)
-		fprintf(stderr, "%s: unexpected EOF in label record trailer, wanted %d, got %d bytes\n", fname, (int)sizeof(check), sts);
+		fprintf(p->out, "%s: unexpected EOF in label record trailer, wanted %d, got %d bytes\n", p->fname, (int)sizeof(check), sts);
 	    else
-		fprintf(stderr, "%s[record %d]: unexpected EOF in record trailer, wanted %d, got %d bytes\n", fname, nrec, (int)sizeof(check), sts);
+		fprintf(p->out, "%s[record %d]: unexpected EOF in record trailer, wanted %d, got %d bytes\n", p->fname, nrec, (int)sizeof(check), sts);
 	    sts = STS_FATAL;
 	    goto done;
 	}
 	check = ntohl(check);
 	if (check < 2 * sizeof(len)) {
 	    if (vflag && !eol) {
-		fputc('\n', stderr);
+		fputc('\n', p->out);
 		eol = 1;
 	    }
 	    if (nrec == 0)
-		fprintf(stderr, "%s: illegal trailer record length (%d) in label record\n", fname, check);
+		fprintf(p->out, "%s: illegal trailer record length (%d) in label record\n", p->fname, check);
 	    else
-		fprintf(stderr, "%s[record %d]: illegal trailer record length (%d)\n", fname, nrec, check);
+		fprintf(p->out, "%s[record %d]: illegal trailer record length (%d)\n", p->fname, nrec, check);
 	    sts = STS_FATAL;
 	    goto done;
 	}
 	len += 2 * sizeof(len);
 	if (check != len) {
 	    if (vflag && !eol) {
-		fputc('\n', stderr);
+		fputc('\n', p->out);
 		eol = 1;
 	    }
 	    if (nrec == 0)
-		fprintf(stderr, "%s: label record length mismatch: header %d != trailer %d\n", fname, len, check);
+		fprintf(p->out, "%s: label record length mismatch: header %d != trailer %d\n", p->fname, len, check);
 	    else
-		fprintf(stderr, "%s[record %d]: length mismatch: header %d != trailer %d\n", fname, nrec, len, check);
+		fprintf(p->out, "%s[record %d]: length mismatch: header %d != trailer %d\n", p->fname, nrec, len, check);
 	    sts = STS_FATAL;
 	    goto done;
 	}
 
 	if (nrec == 0) {
 	    int		xsts;
-	    xsts = checklabel(f, fname, len - 2 * sizeof(len));
+	    xsts = checklabel(p, f);
 	    if (label_ok == STS_OK)
 		/* just remember first not OK status */
 		label_ok = xsts;
 	}
 
-	if (is == IS_INDEX) {
+	if (p->is == IS_INDEX) {
 	    /* for index files, done label record, now eat index records */
 	    size_t	record_size;
 	    void	*buffer;
 
-	    if ((goldenmagic & 0xff) >= PM_LOG_VERS03)
+	    if ((p->magic & 0xff) >= PM_LOG_VERS03)
 		record_size = 8*sizeof(__pmPDU);
 	    else
 		record_size = 5*sizeof(__pmPDU);
@@ -271,17 +400,16 @@ pass0(char *fname)
 	    free(buffer);
 	    if (sts != 0) {
 		if (vflag && !eol) {
-		    fputc('\n', stderr);
+		    fputc('\n', p->out);
 		    eol = 1;
 		}
-		fprintf(stderr, "%s[record %d]: unexpected EOF in index entry, wanted %zd, got %d bytes\n", fname, nrec, record_size, sts);
-		index_state = STATE_BAD;
+		fprintf(p->out, "%s[record %d]: unexpected EOF in index entry, wanted %zd, got %d bytes\n", p->fname, nrec, record_size, sts);
 		sts = STS_FATAL;
 		goto done;
 	    }
 	    goto empty_check;
 	}
-	else if (is == IS_META && nrec > 0) {
+	else if (p->is == IS_META && nrec > 0) {
 	    switch (type) {
 		case TYPE_DESC:
 		case TYPE_TEXT:
@@ -292,12 +420,12 @@ pass0(char *fname)
 		case TYPE_INDOM_DELTA:
 		case TYPE_LABEL:
 		    /* not good for V2 */
-		    if ((goldenmagic & 0xff) == PM_LOG_VERS02) {
+		    if ((p->magic & 0xff) == PM_LOG_VERS02) {
 			if (vflag && !eol) {
-			    fputc('\n', stderr);
+			    fputc('\n', p->out);
 			    eol = 1;
 			}
-			fprintf(stderr, "%s[record %d]: unexpected record type %s (%d) for V2 archive\n", fname, nrec, __pmLogMetaTypeStr(type), type);
+			fprintf(p->out, "%s[record %d]: unexpected record type %s (%d) for V2 archive\n", p->fname, nrec, __pmLogMetaTypeStr(type), type);
 			sts = STS_FATAL;
 		    }
 		    break;
@@ -305,12 +433,12 @@ pass0(char *fname)
 		case TYPE_INDOM_V2:
 		case TYPE_LABEL_V2:
 		    /* not good for V3 */
-		    if ((goldenmagic & 0xff) == PM_LOG_VERS03) {
+		    if ((p->magic & 0xff) == PM_LOG_VERS03) {
 			if (vflag && !eol) {
-			    fputc('\n', stderr);
+			    fputc('\n', p->out);
 			    eol = 1;
 			}
-			fprintf(stderr, "%s[record %d]: unexpected record type %s (%d) for V3 archive\n", fname, nrec, __pmLogMetaTypeStr(type), type);
+			fprintf(p->out, "%s[record %d]: unexpected record type %s (%d) for V3 archive\n", p->fname, nrec, __pmLogMetaTypeStr(type), type);
 			sts = STS_FATAL;
 		    }
 		    break;
@@ -321,19 +449,19 @@ pass0(char *fname)
     }
     if (sts != 0) {
 	if (vflag && !eol) {
-	    fputc('\n', stderr);
+	    fputc('\n', p->out);
 	    eol = 1;
 	}
-	fprintf(stderr, "%s[record %d]: unexpected EOF in record header, wanted %d, got %d bytes\n", fname, nrec, (int)sizeof(len), sts);
+	fprintf(p->out, "%s[record %d]: unexpected EOF in record header, wanted %d, got %d bytes\n", p->fname, nrec, (int)sizeof(len), sts);
 	sts = STS_FATAL;
     }
 empty_check:
     if (sts != STS_FATAL && nrec < 2) {
 	if (vflag && !eol) {
-	    fputc('\n', stderr);
+	    fputc('\n', p->out);
 	    eol = 1;
 	}
-	fprintf(stderr, "%s: contains no PCP data\n", fname);
+	fprintf(p->out, "%s: contains no PCP data\n", p->fname);
 	sts = STS_WARNING;
     }
     /*
@@ -341,40 +469,15 @@ empty_check:
      */
 done:
     if (sts == STS_FATAL && offset > 0) {
-	fprintf(stderr, "%s: last valid record ends at offset %ld\n", fname, offset);
-    }
-    if (is == IS_INDEX) {
-	if (sts == STS_OK)
-	    index_state = STATE_OK;
-	else
-	    index_state = STATE_BAD;
-    }
-    else if (is == IS_META) {
-	if (sts == STS_OK)
-	    meta_state = STATE_OK;
-	else
-	    meta_state = STATE_BAD;
-    }
-    else {
-	if (log_state == STATE_OK && sts != STS_OK)
-	    log_state = STATE_BAD;
-	else if (log_state == STATE_MISSING) {
-	    if (sts == STS_OK)
-		log_state = STATE_OK;
-	    else
-		log_state = STATE_BAD;
-	}
+	fprintf(p->out, "%s: last valid record ends at offset %ld\n", p->fname, offset);
     }
-
-    if (sts == STS_OK)
-	sts = label_ok;
+    p->sts = sts;
+    p->label_sts = label_ok;
 
     if (f != NULL)
 	__pmFclose(f);
+    free(body);
 
-    if (vflag && nrec > 0 && sts != STS_FATAL)
-	fprintf(stderr, "found %d records\n", nrec);
-
-    return sts;
+    if (vflag && nrec > 0 && sts != STS_FATAL && label_ok != STS_FATAL)
+	fprintf(p->out, "found %d records\n", nrec);
 }
-
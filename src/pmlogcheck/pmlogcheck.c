@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2014,2022 Red Hat.
+ * Copyright (c) 2014,2022,2026 Red Hat.
  * Copyright (c) 1995-2003 Silicon Graphics, Inc.  All Rights Reserved.
  * Copyright (c) 2017 Ken McDonell.  All Rights Reserved.
  * 
@@ -17,6 +17,7 @@
 #include <limits.h>
 #include <ctype.h>
 #include <unistd.h>
+#include <pthread.h>
 #include "pmapi.h"
 #include "libpcp.h"
 #include "logcheck.h"
@@ -25,6 +26,8 @@ char		sep;
 int		vflag;		/* verbose off by default */
 int		nowrap;		/* suppress wrap check */
 int		mflag;		/* check metadata only, suppress pass3 */
+int		kflag;		/* verify data volumes with checksum files */
+static int	jobs = 1;	/* files checked concurrently in pass0 */
 int		index_state = STATE_MISSING;
 int		meta_state = STATE_MISSING;
 int		log_state = STATE_MISSING;
@@ -33,9 +36,16 @@ int		result_count;
 
 static char	*archbasename;	/* after basename() */
 
+static pass0_t	*files;		/* pass0 state, one per archive file */
+static int	nfiles;
+static int	nextfile;	/* next file for a pass0 worker */
+static pthread_mutex_t	nextfile_lock = PTHREAD_MUTEX_INITIALIZER;
+
 static pmLongOptions longopts[] = {
     PMAPI_OPTIONS_HEADER("Options"),
     PMOPT_DEBUG,
+    { "jobs", 1, 'j', "N", "check up to N archive files concurrently" },
+    { "checksum", 0, 'k', 0, "verify data volumes using their checksum files" },
     { "label", 0, 'l', 0, "print the archive label" },
     { "metadataonly", 0, 'm', 0, "skip checking log data volumes" },
     PMOPT_NAMESPACE,
@@ -51,7 +61,7 @@ static pmLongOptions longopts[] = {
 
 static pmOptions opts = {
     .flags = PM_OPTFLAG_DONE | PM_OPTFLAG_BOUNDARIES | PM_OPTFLAG_STDOUT_TZ,
-    .short_options = "D:lmn:S:T:zvwZ:?",
+    .short_options = "D:j:klmn:S:T:zvwZ:?",
     .long_options = longopts,
     .short_usage = "[options] archive",
 };
@@ -154,6 +164,85 @@ filter(const_dirent *dp)
     return 1;
 }
 
+static void *
+pass0_worker(void *arg)
+{
+    int		i;
+
+    for ( ; ; ) {
+	pthread_mutex_lock(&nextfile_lock);
+	i = nextfile++;
+	pthread_mutex_unlock(&nextfile_lock);
+	if (i >= nfiles)
+	    break;
+	pass0(&files[i]);
+    }
+    return NULL;
+}
+
+/*
+ * Report the pass0 diagnostics for one file and fold its results into
+ * the archive state.  This is done in file order, whether or not the
+ * files were checked concurrently, so the first good label found sets
+ * the label version expected of all the other files.
+ */
+static int
+pass0_merge(pass0_t *p)
+{
+    char	buf[BUFSIZ];
+    size_t	bytes;
+    int		sts = p->sts;
+
+    if (p->out != stderr) {
+	rewind(p->out);
+	while ((bytes = fread(buf, 1, sizeof(buf), p->out)) > 0)
+	    fwrite(buf, 1, bytes, stderr);
+	fclose(p->out);
+	p->out = stderr;
+    }
+
+    if (p->magic != 0) {
+	if (goldenmagic == 0) {
+	    /* first good label */
+	    goldenfname = strdup(p->fname);
+	    goldenmagic = p->magic;
+	    goldenstart = p->start;
+	}
+	else if ((p->magic & 0xff) != (goldenmagic & 0xff)) {
+	    fprintf(stderr, "%s: mismatched label version: %d not %d as expected from %s\n",
+		    p->fname, p->magic & 0xff, goldenmagic & 0xff, goldenfname);
+	    p->label_sts = STS_FATAL;
+	}
+    }
+
+    if (p->is == IS_INDEX) {
+	if (sts == STS_OK)
+	    index_state = STATE_OK;
+	else
+	    index_state = STATE_BAD;
+    }
+    else if (p->is == IS_META) {
+	if (sts == STS_OK)
+	    meta_state = STATE_OK;
+	else
+	    meta_state = STATE_BAD;
+    }
+    else {
+	if (log_state == STATE_OK && sts != STS_OK)
+	    log_state = STATE_BAD;
+	else if (log_state == STATE_MISSING) {
+	    if (sts == STS_OK)
+		log_state = STATE_OK;
+	    else
+		log_state = STATE_BAD;
+	}
+    }
+
+    if (sts == STS_OK)
+	sts = p->label_sts;
+    return sts;
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -171,9 +260,23 @@ main(int argc, char *argv[])
     char		*archdirname;	/* after dirname() */
     char		archname[MAXPATHLEN];	/* full pathname to base of archive name */
     char		*tmp;
+    char		*endnum;
+    pthread_t		*tids;
+    int			nverified;
 
     while ((c = pmGetOptions(argc, argv, &opts)) != EOF) {
 	switch (c) {
+	case 'j':	/* concurrent pass0 checks */
+	    jobs = (int)strtol(opts.optarg, &endnum, 10);
+	    if (*endnum != '\0' || jobs < 1) {
+		pmprintf("%s: -j requires a positive number of jobs, not \"%s\"\n",
+			pmGetProgname(), opts.optarg);
+		opts.errors++;
+	    }
+	    break;
+	case 'k':	/* verify checksums */
+	    kflag = 1;
+	    break;
 	case 'l':	/* display the archive label */
 	    lflag = 1;
 	    break;
@@ -244,7 +347,11 @@ main(int argc, char *argv[])
      * Pass 0 for data, metadata and index files ... check physical
      * archive record structure, then label record
      */
-    sts = STS_OK;
+    if ((files = (pass0_t *)calloc(nfile, sizeof(pass0_t))) == NULL) {
+	pmNoMem("pass0 files", nfile * sizeof(pass0_t), PM_FATAL_ERR);
+	/* NOTREACHED */
+    }
+    nfiles = nfile;
     for (i = 0; i < nfile; i++) {
 	char	path[MAXPATHLEN];
 	if (strcmp(archdirname, ".") == 0) {
@@ -254,10 +361,45 @@ main(int argc, char *argv[])
 	else {
 	    pmsprintf(path, sizeof(path), "%s%c%s", archdirname, sep, namelist[i]->d_name);
 	}
-	if (pass0(path) == STS_FATAL)
+	files[i].fname = strdup(path);
+	files[i].out = stderr;
+	free(namelist[i]);
+    }
+    sts = STS_OK;
+    if (jobs > 1 && nfile > 1) {
+	/*
+	 * check files concurrently, each with its diagnostics buffered
+	 * so that they can be reported in file order
+	 */
+	if (jobs > nfile)
+	    jobs = nfile;
+	if ((tids = (pthread_t *)malloc(jobs * sizeof(pthread_t))) == NULL) {
+	    pmNoMem("pass0 jobs", jobs * sizeof(pthread_t), PM_FATAL_ERR);
+	    /* NOTREACHED */
+	}
+	for (i = 0; i < nfile; i++) {
+	    if ((files[i].out = tmpfile()) == NULL)
+		files[i].out = stderr;
+	}
+	for (i = 0; i < jobs; i++) {
+	    if ((c = pthread_create(&tids[i], NULL, pass0_worker, NULL)) != 0) {
+		fprintf(stderr, "%s: pthread_create: %s\n", pmGetProgname(), strerror(c));
+		exit(EXIT_FAILURE);
+	    }
+	}
+	for (i = 0; i < jobs; i++)
+	    pthread_join(tids[i], NULL);
+	free(tids);
+    }
+    else
+	pass0_worker(NULL);
+    nverified = 0;
+    for (i = 0; i < nfile; i++) {
+	if (pass0_merge(&files[i]) == STS_FATAL)
 	    /* unrepairable or unrepaired error */
 	    sts = STS_FATAL;
-	free(namelist[i]);
+	if (files[i].cksum == CKSUM_OK)
+	    nverified++;
     }
     free(namelist);
     if (meta_state == STATE_MISSING) {
@@ -299,7 +441,7 @@ main(int argc, char *argv[])
 	exit(EXIT_FAILURE);
     }
     /*
-     * Note: This application is single threaded, and once we have ctxp
+     * Note: This application is single threaded (beyond pass0), and once we have ctxp
      *	     the associated __pmContext will not move and will only be
      *	     accessed or modified synchronously either here or in libpcp.
      *	     We unlock the context so that it can be locked as required
@@ -322,6 +464,19 @@ main(int argc, char *argv[])
 
     sts = pass2(ctxp, archname);
 
+    if (!mflag && kflag && nverified > 0) {
+	/* pass3 is not needed if checksums cover all the data volumes */
+	for (i = 0; i < nfile; i++) {
+	    if (files[i].is == IS_LOG && files[i].cksum != CKSUM_OK)
+		break;
+	}
+	if (i == nfile) {
+	    if (vflag)
+		fprintf(stderr, "%s: data volumes verified by checksum, skipping pass3\n", archname);
+	    mflag = 1;
+	}
+    }
+
     if (!mflag)
 	sts = pass3(ctxp, archname, &opts);
 
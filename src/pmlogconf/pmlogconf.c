@@ -17,6 +17,7 @@ static pmLongOptions longopts[] = {
     PMOPT_DEBUG,
     PMOPT_HOST,
     { "", 0, 'c', NULL, "add message and timestamp (not for interactive use)" },
+    { "cache", 1, 'C', "FILE", "reuse probe results saved in FILE while pmcd is unchanged" },
     { "group", 1, 'g', "TAG", "report the logging state for a specific metrics group" },
     { "groups", 1, 'd', "DIR", "specify path to the pmlogconf groups directory" },
     { "quiet", 0, 'q', NULL, "quiet, suppress logging interval dialog" },
@@ -35,7 +36,7 @@ override(int opt, pmOptions *opts)
 }
 
 static pmOptions opts = {
-    .short_options = "D:h:cd:g:qrs:vV?",
+    .short_options = "D:h:cC:d:g:qrs:vV?",
     .long_options = longopts,
     .short_usage = "[options] configfile",
     .override = override,
@@ -57,6 +58,7 @@ char	*config;		/* pmlogger configuration file */
 char	*host;			/* pmcd host specification */
 char	*setupfile;
 char	*finaltag;
+char	*cachefile;		/* per-host cache of probe results */
 
 unsigned	ngroups;
 group_t	*groups;
@@ -536,6 +538,162 @@ fetch_groups(void)
     return sts;
 }
 
+/*
+ * Probe results can be cached per host (-C) so that the periodic
+ * reconfiguration done by pmlogger_check need not lookup, describe
+ * and fetch every probed metric again.  The cache is used while pmcd
+ * is the same process with the same number of PMDAs, the probe of
+ * every group is unchanged, and the results are not too old.
+ */
+#define CACHE_MAXAGE	(6*60*60)	/* seconds before probing again */
+
+static int	cache_valid;		/* probe results came from the cache */
+static char	cache_token[256];	/* pmcd identity when cache written */
+
+static int
+cache_identity(char *buffer, size_t length)
+{
+    static const char	*names[] = { "pmcd.pid", "pmcd.numagents" };
+    pmID		pmids[2];
+    pmResult		*result;
+    pmAtomValue		pid, agents;
+    char		hostname[MAXHOSTNAMELEN];
+    int			sts;
+
+    if ((sts = pmLookupName(2, names, pmids)) < 0)
+	return sts;
+    if (sts != 2)
+	return PM_ERR_NAME;
+    if ((sts = pmFetch(2, pmids, &result)) < 0)
+	return sts;
+    if (result->vset[0]->numval != 1 || result->vset[1]->numval != 1)
+	sts = PM_ERR_VALUE;
+    else if ((sts = pmExtractValue(result->vset[0]->valfmt,
+			&result->vset[0]->vlist[0], PM_TYPE_U32,
+			&pid, PM_TYPE_U32)) >= 0)
+	sts = pmExtractValue(result->vset[1]->valfmt,
+			&result->vset[1]->vlist[0], PM_TYPE_U32,
+			&agents, PM_TYPE_U32);
+    pmFreeResult(result);
+    if (sts < 0)
+	return sts;
+    pmsprintf(buffer, length, "%s %u %u",
+		pmGetContextHostName_r(pmWhichContext(), hostname, sizeof(hostname)),
+		pid.ul, agents.ul);
+    return 0;
+}
+
+static int
+cache_load(void)
+{
+    FILE		*file;
+    group_t		*group;
+    unsigned int	i, hint = 0;
+    long		when;
+    char		*p, *probe, bytes[1024], tag[MAXPATHLEN];
+    int			probed, count = 0;
+
+    if ((file = fopen(cachefile, "r")) == NULL)
+	return -oserror();
+    if (fgets(bytes, sizeof(bytes), file) == NULL ||
+	strcmp(bytes, "#pmlogconf-cache 1\n") != 0 ||
+	fgets(bytes, sizeof(bytes), file) == NULL ||
+	strcmp(chop(bytes), cache_token) != 0 ||
+	fscanf(file, "%ld\n", &when) != 1 ||
+	when > time(NULL) || time(NULL) - when >= CACHE_MAXAGE) {
+	fclose(file);
+	return -ESTALE;
+    }
+    while ((p = fgets(bytes, sizeof(bytes), file)) != NULL) {
+	if (sscanf(p, "%d %s", &probed, tag) != 2 ||
+	    (probe = strchr(strchr(p, ' ') + 1, ' ')) == NULL)
+	    continue;
+	probe = chop(probe + 1);
+	if ((group = group_search(tag, &hint)) == NULL ||
+	    group->probe == NULL || strcmp(group->probe, probe) != 0)
+	    continue;
+	group->pmid = PM_ID_NULL;	/* not looked up */
+	group->probed = probed;
+	group->cached = 1;
+	count++;
+    }
+    fclose(file);
+
+    /* every probed group must have a result, else probe them all */
+    for (i = 0; i < ngroups; i++) {
+	if (!groups[i].valid || groups[i].metric == NULL)
+	    continue;
+	if (!groups[i].cached)
+	    break;
+    }
+    if (i < ngroups) {
+	for (i = 0; i < ngroups; i++)
+	    groups[i].cached = 0;
+	return -ESTALE;
+    }
+    return count;
+}
+
+/*
+ * Find probe results for all groups - from the cache if possible,
+ * else with a single batch of metric lookups and fetch.
+ */
+int
+probe_groups(void)
+{
+    int			sts;
+
+    if (cachefile) {
+	if (cache_identity(cache_token, sizeof(cache_token)) < 0)
+	    cache_token[0] = '\0';
+	else if ((sts = cache_load()) >= 0) {
+	    if (pmDebugOptions.appl0)
+		fprintf(stderr, "Using %d cached probe results from %s\n",
+				sts, cachefile);
+	    cache_valid = 1;
+	    return 0;
+	}
+    }
+    return fetch_groups();
+}
+
+/*
+ * Save the probe result of every group for next time, see -C.
+ * Called once all groups have been parsed (setup_groups).
+ */
+void
+cache_groups(void)
+{
+    FILE		*file;
+    group_t		*group;
+    unsigned int	i;
+    char		tmpfile[MAXPATHLEN];
+
+    if (cachefile == NULL || cache_valid || cache_token[0] == '\0')
+	return;
+
+    pmsprintf(tmpfile, sizeof(tmpfile), "%s.tmp", cachefile);
+    if ((file = fopen(tmpfile, "w")) == NULL) {
+	if (verbose)
+	    fprintf(stderr, "%s: cannot create probe cache \"%s\": %s\n",
+			pmGetProgname(), tmpfile, osstrerror());
+	return;
+    }
+    fprintf(file, "#pmlogconf-cache 1\n%s\n%ld\n", cache_token, (long)time(NULL));
+    for (i = 0; i < ngroups; i++) {
+	group = &groups[i];
+	if (!group->valid || group->metric == NULL || group->probe == NULL)
+	    continue;
+	fprintf(file, "%d %s %s\n", evaluate_group(group), group->tag, group->probe);
+    }
+    if (fclose(file) != 0 || rename(tmpfile, cachefile) < 0) {
+	if (verbose)
+	    fprintf(stderr, "%s: cannot save probe cache \"%s\": %s\n",
+			pmGetProgname(), cachefile, osstrerror());
+	unlink(tmpfile);
+    }
+}
+
 static inline char *
 pmlogger_group_delta(group_t *group)
 {
@@ -882,6 +1040,9 @@ evaluate_group(group_t *group)
 {
     pmValueSet		*vp;
 
+    if (group->cached)
+	return group->probed;
+
     switch (group->probe_style) {
     case PROBE_VALUES:
 	if ((vp = metric_values(group->pmid)) == NULL)
@@ -1221,8 +1382,9 @@ pmlogger_create(FILE *file)
 
     printf("Creating config file \"%s\" using default settings ...\n", config);
     parse_groups(groupdir, NULL);
-    fetch_groups();
+    probe_groups();
     setup_groups();
+    cache_groups();
 
     if (finaltag) {
 	for (i = 0; i < ngroups; i++)
@@ -1600,8 +1762,9 @@ pmlogger_update(FILE *file, struct stat *stat)
 		pmGetProgname(), host);
 
     parse_groups(groupdir, NULL);
-    fetch_groups();
+    probe_groups();
     setup_groups();
+    cache_groups();
 
     create_tempfile(file, &tempfile, stat);
     copy_and_parse_tempfile(file, tempfile);
@@ -1683,6 +1846,10 @@ pmlogconf(int argc, char **argv)
 	    prompt = 0;
 	    break;
 
+	case 'C':	/* per-host probe results cache */
+	    cachefile = opts.optarg;
+	    break;
+
 	case 'd':
 	    pmsprintf(groupdir, MAXPATHLEN, "%s", opts.optarg);
 	    break;
@@ -27,6 +27,7 @@ typedef struct group {
     unsigned int	pmlogger: 1;	/* was group in pmlogger config? */
     unsigned int	pmlogconf: 1;	/* was group in pmlogconf configs? */
     unsigned int	pmrep: 1;	/* was group in pmrep config? */
+    unsigned int	cached: 1;	/* probe result from the cache? */
     pmID		pmid;		/* identifier for probed metric */
     char		*force;		/* force expression, if forcing */
     char		*probe;		/* probe expression, if probing */
@@ -39,6 +40,7 @@ typedef struct group {
     char		*saved_delta;	/* previously configured log interval */
     unsigned int	saved_state;	/* previously configured enable state */
     unsigned int	probe_state;	/* result of evaluating probe */
+    int			probed;		/* cached result of evaluate_group */
 } group_t;
 
 extern unsigned	ngroups;
@@ -60,6 +62,7 @@ extern char	*config;
 extern char	*host;
 extern char	*setupfile;
 extern char	*finaltag;
+extern char	*cachefile;
 
 extern int pmlogconf(int argc, char **argv);
 extern int pmrepconf(int argc, char **argv);
@@ -73,6 +76,8 @@ extern int evaluate_group(group_t *group);
 extern void group_setup(void);
 extern void setup_groups(void);
 extern int fetch_groups(void);
+extern int probe_groups(void);
+extern void cache_groups(void);
 extern char *update_groups(FILE *tempfile, const char *pattern);
 extern unsigned int evaluate_state(group_t *group);
 extern group_t *group_free(group_t *group);
@@ -26,6 +26,7 @@
  */
 typedef struct reclist {
     __int32_t		*pdu;		/* PDU ptr */
+    off_t		spill;		/* -M, 1 + PDU offset in spill file */
     __pmTimestamp	stamp;		/* for indom and label records */
     pmDesc		desc;
     unsigned int	written : 16;	/* written PDU status */
@@ -46,11 +47,13 @@ typedef struct {
     __pmResult		*_result;
     __pmResult		*_Nresult;
     __pmTimestamp	laststamp;
+    __pmTimestamp	end;		/* end of archive, as at startup */
     int			eof[2];
     int			mark;		/* need EOL marker */
     int			recnum;
     int64_t		pmcd_pid;	/* from prologue/epilogue records */
     int32_t		pmcd_seqnum;	/* from prologue/epilogue records */
+    void		*prefetch;	/* read-ahead queue, see prefetch.c */
 } inarch_t;
 #define LOG			0	/* pb[] & eof[] index for data volume */
 #define META			1	/* pb[] & eof[] index for metadata */
@@ -125,6 +128,13 @@ extern void insertresult(rlist_t **, __pmResult *);
 extern __pmResult *searchmlist(__pmResult *);
 extern void abandon_extract(void);
 
+/*
+ * prefetch.c - read-ahead of data records from the input archives
+ */
+extern int prefetch_start(int);
+extern int prefetch_next(inarch_t *, __pmResult **);
+extern void prefetch_stop(void);
+
 /* command line args needed across source files */
 extern int	xarg;
 
@@ -20,6 +20,7 @@
  * appl2	time window and EOF tests
  * appl3	in/out version decisions
  * appl4	indom juggling
+ * appl5	-C concatenation decisions
  */
 
 #include <math.h>
@@ -40,10 +41,13 @@ pmID pmid_seqnum;
 
 static pmLongOptions longopts[] = {
     PMAPI_OPTIONS_HEADER("Options"),
+    { "concat", 0, 'C', 0, "copy records without re-encoding if the archives simply concatenate" },
     { "config", 1, 'c', "FILE", "file to load configuration from" },
     { "desperate", 0, 'd', 0, "desperate, save output after fatal error" },
     { "first", 0, 'f', 0, "use timezone from first archive [default is last]" },
     { "mark", 0, 'm', 0, "ignore prologue/epilogue records and <mark> between archives" },
+    { "spill", 0, 'M', 0, "hold instance domain and label set records in a temporary file" },
+    { "threads", 1, 'P', "N", "use N threads to read ahead the input archives" },
     PMOPT_START,
     { "samples", 1, 's', "NUM", "terminate after NUM log records have been written" },
     PMOPT_FINISH,
@@ -58,7 +62,7 @@ static pmLongOptions longopts[] = {
 };
 
 static pmOptions opts = {
-    .short_options = "c:D:dfmS:s:T:V:v:wxZ:z?",
+    .short_options = "Cc:D:dfMmP:S:s:T:V:v:wxZ:z?",
     .long_options = longopts,
     .short_usage = "[options] input-archive output-archive",
 };
@@ -121,6 +125,9 @@ static __pmHashCtl	rpmidoneline;	/* pmid oneline records to be written */
 static __pmHashCtl	rpmidtext;	/* pmid text records to be written */
 static __pmHashCtl	rlabelset;	/* label sets to be written */
 
+static FILE		*spillf;	/* -M, indom and label set PDUs */
+static off_t		spillend;	/* -M, bytes in spillf */
+
 static __pmTimestamp	curlog;		/* most recent timestamp in log */
 static __pmTimestamp	current;	/* most recent timestamp overall */
 
@@ -137,9 +144,13 @@ static __pmTimestamp	winend = {-1,0};	/* window end time */
 static __pmTimestamp	logend = {-1,0};	/* log end time */
 
 /* command line args */
+int	Carg;				/* -C arg - concatenate if possible */
 char	*configfile;			/* -c arg - name of config file */
+int	Darg;				/* -D arg - debugging */
 int	farg;				/* -f arg - use first timezone */
+int	Marg;				/* -M arg - spill indoms and labels to disk */
 int	old_mark_logic;			/* -m arg - <mark> b/n archives */
+int	Parg = -1;			/* -P arg - read-ahead threads */
 int	sarg = -1;			/* -s arg - finish after X samples */
 char	*Sarg;				/* -S arg - window start */
 char	*Targ;				/* -T arg - window end */
@@ -710,6 +721,70 @@ add_reclist_t(reclist_t *rec)
     return rp;
 }
 
+/*
+ * -M, move the PDU buffer for an indom or label set record out to the
+ * (unlinked) spill file, keeping only its offset in the reclist_t.
+ * The file lives beside the output archive, rather than in $TMPDIR,
+ * as it grows with the metadata being merged.
+ */
+static void
+spill_rec(reclist_t *rec)
+{
+    char	path[MAXPATHLEN];
+    size_t	len;
+    int		fd;
+
+    if (spillf == NULL) {
+	pmsprintf(path, sizeof(path), "%s.spillXXXXXX", outarchname);
+	if ((fd = mkstemp(path)) < 0 || (spillf = fdopen(fd, "w+")) == NULL) {
+	    fprintf(stderr, "%s: Error: cannot create spill file \"%s\": %s\n",
+		    pmGetProgname(), path, osstrerror());
+	    abandon_extract();
+	    /*NOTREACHED*/
+	}
+	unlink(path);
+    }
+
+    len = ntohl(rec->pdu[0]);
+    if (fseeko(spillf, spillend, SEEK_SET) < 0 ||
+	fwrite(rec->pdu, 1, len, spillf) != len) {
+	fprintf(stderr, "%s: Error: spill file write: %s\n",
+		pmGetProgname(), osstrerror());
+	abandon_extract();
+	/*NOTREACHED*/
+    }
+    rec->spill = spillend + 1;
+    spillend += len;
+    free(rec->pdu);
+    rec->pdu = NULL;
+}
+
+/*
+ * return the PDU buffer for a record, reloading it from the spill
+ * file if need be, else NULL if the record has no PDU
+ */
+static __int32_t *
+rec_pdu(reclist_t *rec)
+{
+    __int32_t	len;
+
+    if (rec->pdu != NULL || rec->spill == 0)
+	return rec->pdu;
+
+    if (fseeko(spillf, rec->spill - 1, SEEK_SET) < 0 ||
+	fread(&len, 1, sizeof(len), spillf) != sizeof(len) ||
+	(rec->pdu = (__int32_t *)malloc(ntohl(len))) == NULL ||
+	fseeko(spillf, rec->spill - 1, SEEK_SET) < 0 ||
+	fread(rec->pdu, 1, ntohl(len), spillf) != ntohl(len)) {
+	fprintf(stderr, "%s: Error: spill file read: %s\n",
+		pmGetProgname(), osstrerror());
+	abandon_extract();
+	/*NOTREACHED*/
+    }
+    rec->spill = 0;
+    return rec->pdu;
+}
+
 /*
  * find indom in indomreclist - if it isn't in the list then add it in
  * with no pdu buffer
@@ -957,6 +1032,7 @@ append_indomreclist(int indx)
 	curr->pdu = pdu;
 	curr->stamp = stamp;		/* struct assignment */
 	curr->desc.indom = indom;
+	rec = curr;
 
 	if (__pmHashAdd(indom, (void *)curr, &rindom) < 0) {
 	    fprintf(stderr, "%s: Error: cannot add to indom hash table.\n",
@@ -967,10 +1043,11 @@ append_indomreclist(int indx)
     } else {
 	curr = (reclist_t *)hp->data;
 
-	if (curr->pdu == NULL) {
+	if (curr->pdu == NULL && curr->spill == 0) {
 	    /* insert new record */
 	    curr->pdu = iap->pb[META];
 	    curr->stamp = stamp;		/* struct assignment */
+	    rec = curr;
 	}
 	else {
 	    /* do NOT discard old record; append new record */
@@ -982,6 +1059,8 @@ append_indomreclist(int indx)
 	    curr->nrecs++;
 	}
     }
+    if (Marg)
+	spill_rec(rec);
 
     iap->pb[META] = NULL;
 }
@@ -1058,6 +1137,8 @@ append_labelsetreclist(int i, int type)
 	abandon_extract();
 	/*NOTREACHED*/
     }
+    if (Marg)
+	spill_rec(rec);
 
     iap->pb[META] = NULL;
 }
@@ -1470,8 +1551,8 @@ write_priorlabelset(int type, int ident, const __pmTimestamp *now)
     }
 
     /* Write the chosen record, if it has not already been written. */
-    if (other_labelset != NULL && other_labelset->pdu != NULL &&
-	other_labelset->written != WRITTEN) {
+    if (other_labelset != NULL && other_labelset->written != WRITTEN &&
+	rec_pdu(other_labelset) != NULL) {
 	other_labelset->written = MARK_FOR_WRITE;
 	if (outarchvers == PM_LOG_VERS03)
 	    __pmPutTimestamp(now, &other_labelset->pdu[2]);
@@ -1657,7 +1738,7 @@ write_metareclist(__pmResult *result, int *needti)
 		 * record does not exist. There's no record to write, but we
 		 * still need to output the associated labels and help text.
 		 */
-		if (other_indom->pdu != NULL) { 
+		if (rec_pdu(other_indom) != NULL) {
 		    other_indom->written = MARK_FOR_WRITE;
 		    if (outarchvers == PM_LOG_VERS03)
 			__pmPutTimestamp(&stamp, &other_indom->pdu[2]);
@@ -2060,6 +2141,54 @@ againmeta:
 }
 
 
+/*
+ * pmcd.pid and pmcd.seqnum from pmlogger's prologue/epilogue records
+ *
+ * Warning: If pmlogger changes the contents of the prologue
+ *          and/or epilogue records, then the 5 below will need
+ *          to be adjusted.
+ *          If the type of pmcd.pid changes from U64 or the type
+ *          of pmcd.seqnum changes from U32, the extraction will
+ *          have to change as well.
+ */
+static void
+pmcd_ids(inarch_t *iap, __pmResult *rp)
+{
+    int		i;
+    pmAtomValue	av;
+    int		lsts;
+
+    if (rp->numpmid != 5)
+	return;
+
+    for (i=0; i<rp->numpmid; i++) {
+	if (rp->vset[i]->pmid == pmid_pid) {
+	    lsts = pmExtractValue(rp->vset[i]->valfmt, &rp->vset[i]->vlist[0], PM_TYPE_U64, &av, PM_TYPE_64);
+	    if (lsts != 0) {
+		fprintf(stderr,
+		    "%s: Warning: failed to get pmcd.pid from %s at record %d: %s\n",
+			pmGetProgname(), iap->name, iap->recnum, pmErrStr(lsts));
+		if (pmDebugOptions.desperate)
+		    __pmPrintResult(stderr, rp);
+	    }
+	    else
+		iap->pmcd_pid = av.ll;
+	}
+	else if (rp->vset[i]->pmid == pmid_seqnum) {
+	    lsts = pmExtractValue(rp->vset[i]->valfmt, &rp->vset[i]->vlist[0], PM_TYPE_U32, &av, PM_TYPE_32);
+	    if (lsts != 0) {
+		fprintf(stderr,
+		    "%s: Warning: failed to get pmcd.seqnum from %s at record %d: %s\n",
+			pmGetProgname(), iap->name, iap->recnum, pmErrStr(lsts));
+		if (pmDebugOptions.desperate)
+		    __pmPrintResult(stderr, rp);
+	    }
+	    else
+		iap->pmcd_seqnum = av.l;
+	}
+    }
+}
+
 /*
  * read in next log record for every archive
  */
@@ -2070,7 +2199,6 @@ nextlog(void)
     int			eoflog = 0;	/* number of log files at eof */
     int			sts;
     __pmTimestamp	curtime;
-    __pmArchCtl		*acp;
     __pmContext		*ctxp;
     inarch_t		*iap;
 
@@ -2094,20 +2222,15 @@ nextlog(void)
 	}
 
 
-	if ((ctxp = __pmHandleToPtr(iap->ctx)) == NULL) {
-	    fprintf(stderr, "%s: botch: __pmHandleToPtr(%d) returns NULL!\n", pmGetProgname(), iap->ctx);
-	    abandon_extract();
-	    /*NOTREACHED*/
-	}
-	/* Need to hold c_lock for __pmLogRead_ctx() */
-	acp = ctxp->c_archctl;
-
 againlog:
-	if ((sts =__pmLogRead_ctx(ctxp, PM_MODE_FORW, NULL, &iap->_result, PMLOGREAD_NEXT)) < 0) {
+	if ((sts = prefetch_next(iap, &iap->_result)) < 0) {
 	    if (sts != PM_ERR_EOL) {
 		fprintf(stderr, "%s: Error: __pmLogRead[log %s]: %s\n",
 			pmGetProgname(), iap->name, pmErrStr(sts));
-		_report(acp->ac_mfp);
+		if ((ctxp = __pmHandleToPtr(iap->ctx)) != NULL) {
+		    _report(ctxp->c_archctl->ac_mfp);
+		    PM_UNLOCK(ctxp->c_lock);
+		}
 		if (sts != PM_ERR_LOGREC)
 		    abandon_extract();
 		    /*NOTREACHED*/
@@ -2125,7 +2248,6 @@ againlog:
 		iap->mark = 1;
 		iap->pb[LOG] = NULL;
 	    }
-	    PM_UNLOCK(ctxp->c_lock);
 	    continue;
 	}
 	else
@@ -2139,53 +2261,8 @@ againlog:
 	 */
 	curtime = iap->_result->timestamp;
 
-	/*
-	 * check for prologue/epilogue records ... 
-	 *
-	 * Warning: If pmlogger changes the contents of the prologue
-	 *          and/or epilogue records, then the 5 below will need
-	 *          to be adjusted.
-	 *          If the type of pmcd.pid changes from U64 or the type
-	 *          of pmcd.seqnum changes from U32, the extraction will
-	 *          have to change as well.
-	 */
-	if (iap->_result->numpmid == 5) {
-	    int		i;
-	    pmAtomValue	av;
-	    int		lsts;
-	    for (i=0; i<iap->_result->numpmid; i++) {
-		if (iap->_result->vset[i]->pmid == pmid_pid) {
-		    lsts = pmExtractValue(iap->_result->vset[i]->valfmt, &iap->_result->vset[i]->vlist[0], PM_TYPE_U64, &av, PM_TYPE_64);
-		    if (lsts != 0) {
-			fprintf(stderr,
-			    "%s: Warning: failed to get pmcd.pid from %s at record %d: %s\n",
-				pmGetProgname(), iap->name, iap->recnum, pmErrStr(lsts));
-			if (pmDebugOptions.desperate) {
-			    PM_UNLOCK(ctxp->c_lock);
-			    __pmPrintResult(stderr, iap->_result);
-			    PM_LOCK(ctxp->c_lock);
-			}
-		    }
-		    else
-			iap->pmcd_pid = av.ll;
-		}
-		else if (iap->_result->vset[i]->pmid == pmid_seqnum) {
-		    lsts = pmExtractValue(iap->_result->vset[i]->valfmt, &iap->_result->vset[i]->vlist[0], PM_TYPE_U32, &av, PM_TYPE_32);
-		    if (lsts != 0) {
-			fprintf(stderr,
-			    "%s: Warning: failed to get pmcd.seqnum from %s at record %d: %s\n",
-				pmGetProgname(), iap->name, iap->recnum, pmErrStr(lsts));
-			if (pmDebugOptions.desperate) {
-			    PM_UNLOCK(ctxp->c_lock);
-			    __pmPrintResult(stderr, iap->_result);
-			    PM_LOCK(ctxp->c_lock);
-			}
-		    }
-		    else
-			iap->pmcd_seqnum = av.l;
-		}
-	    }
-	}
+	/* check for prologue/epilogue records ... */
+	pmcd_ids(iap, iap->_result);
 
 	/*
 	 * if log time is greater than (or equal to) the current window
@@ -2231,7 +2308,6 @@ againlog:
                 goto againlog;
             }
 	}
-	PM_UNLOCK(ctxp->c_lock);
 
     } /*for(indx)*/
 
@@ -2259,6 +2335,10 @@ parseargs(int argc, char *argv[])
     while ((c = pmgetopt_r(argc, argv, &opts)) != EOF) {
 	switch (c) {
 
+	case 'C':	/* copy records if the archives simply concatenate */
+	    Carg = 1;
+	    break;
+
 	case 'c':	/* config file */
 	    configfile = opts.optarg;
 	    if (stat(configfile, &sbuf) < 0) {
@@ -2274,6 +2354,7 @@ parseargs(int argc, char *argv[])
 			pmGetProgname(), opts.optarg);
 		opts.errors++;
 	    }
+	    Darg = 1;
 	    break;
 
 	case 'd':	/* desperate to save output archive, even after error */
@@ -2284,10 +2365,22 @@ parseargs(int argc, char *argv[])
 	    farg = 1;
 	    break;
 
+	case 'M':	/* hold indom and label set records on disk */
+	    Marg = 1;
+	    break;
+
 	case 'm':	/* always add <mark> between archives */
 	    old_mark_logic = 1;
 	    break;
 
+	case 'P':	/* number of read-ahead threads */
+	    Parg = (int)strtol(opts.optarg, &endnum, 10);
+	    if (*endnum != '\0' || Parg < 0) {
+		pmprintf("%s: -P requires numeric argument\n", pmGetProgname());
+		opts.errors++;
+	    }
+	    break;
+
 	case 's':	/* number of samples to write out */
 	    sarg = (int)strtol(opts.optarg, &endnum, 10);
 	    if (*endnum != '\0' || sarg < 0) {
@@ -2723,6 +2816,571 @@ do_not_need_mark(inarch_t *iap)
     return 0;
 }
 
+/*
+ * -C support ... when the input archives come from one pmlogger after
+ * another (the pmlogger_daily case) they simply concatenate: each one
+ * ends before the next one starts, and any metadata they share is the
+ * same.  Then the data records can be copied as they are, without being
+ * decoded and encoded again, and the metadata copied without the
+ * duplicates.
+ */
+static __pmHashCtl	cdesc;		/* metric descriptors, by pmid */
+static __pmHashCtl	ctext;		/* help text, by ident */
+static __pmHashCtl	cindom;		/* last indom written, by indom */
+static __pmHashCtl	clabel;		/* last label set written, by ident */
+static off_t		*cmeta_in;	/* input metadata record offsets ... */
+static off_t		*cmeta_out;	/* ... and where they were written */
+static int		cmeta_num;
+static int		cmeta_max;
+static __pmTimestamp	ctitime;	/* time of last temporal index write */
+static int		clast_vol;	/* volume of last record copied ... */
+static off_t		clast_off;	/* ... and its offset */
+
+/* words in the timestamp of a metadata record */
+static int
+concat_stampwords(int type)
+{
+    if (type == TYPE_INDOM_V2 || type == TYPE_LABEL_V2)
+	return 2;
+    if (type == TYPE_INDOM || type == TYPE_INDOM_DELTA || type == TYPE_LABEL)
+	return 3;
+    return 0;
+}
+
+static __pmHashCtl *
+concat_hash(int type)
+{
+    switch (type) {
+	case TYPE_DESC:
+	    return &cdesc;
+	case TYPE_TEXT:
+	    return &ctext;
+	case TYPE_INDOM_V2:
+	case TYPE_INDOM:
+	case TYPE_INDOM_DELTA:
+	    return &cindom;
+	case TYPE_LABEL_V2:
+	case TYPE_LABEL:
+	    return &clabel;
+    }
+    return NULL;
+}
+
+/*
+ * the identifier of the metadata object in a record, and the text or
+ * label type (if any, else -1) that goes with it
+ */
+static int
+concat_key(__int32_t *rec, unsigned int *key)
+{
+    int		type = ntohl(rec[1]);
+    int		k = 2 + concat_stampwords(type);
+
+    switch (type) {
+	case TYPE_DESC:
+	    *key = ntohl(rec[2]);
+	    return -1;
+	case TYPE_TEXT:
+	    *key = ntohl(rec[3]);
+	    return ntohl(rec[2]);
+	case TYPE_LABEL_V2:
+	case TYPE_LABEL:
+	    *key = ntohl(rec[k+1]);
+	    return ntohl(rec[k]);
+    }
+    *key = ntohl(rec[k]);
+    return -1;
+}
+
+static __pmHashNode *
+concat_lookup(__pmHashCtl *hcp, unsigned int key, int subtype)
+{
+    __pmHashNode	*hp;
+    unsigned int	okey;
+
+    for (hp = __pmHashSearch(key, hcp); hp != NULL; hp = hp->next) {
+	if (hp->key == key &&
+	    concat_key((__int32_t *)hp->data, &okey) == subtype)
+	    break;
+    }
+    return hp;
+}
+
+/* same metadata, ignoring the timestamp (if any) */
+static int
+concat_same(__int32_t *a, __int32_t *b)
+{
+    int		k = 2 + concat_stampwords(ntohl(a[1]));
+
+    if (a[0] != b[0] || a[1] != b[1])
+	return 0;
+    return memcmp(&a[k], &b[k], ntohl(a[0]) - k * sizeof(__int32_t)) == 0;
+}
+
+static void
+concat_clear(__pmHashCtl *hcp)
+{
+    __pmHashNode	*hp;
+
+    for (hp = __pmHashWalk(hcp, PM_HASH_WALK_START);
+	 hp != NULL;
+	 hp = __pmHashWalk(hcp, PM_HASH_WALK_NEXT))
+	free(hp->data);
+    __pmHashClear(hcp);
+}
+
+static int
+concat_compare(const void *a, const void *b)
+{
+    return __pmTimestampCmp(&inarch[*(int *)a].label.start,
+			    &inarch[*(int *)b].label.start);
+}
+
+/*
+ * can the input archives simply be concatenated?  If so return the
+ * indices of the non-empty ones in time order (and their number via
+ * np), else NULL
+ */
+static int *
+concat_check(int *np)
+{
+    int			*order;
+    int			n = 0;
+    int			indx;
+    int			sts;
+    int			type;
+    int			subtype;
+    unsigned int	key;
+    off_t		here;
+    char		*reason = NULL;
+    __int32_t		*rec;
+    __pmHashCtl		*hcp;
+    __pmHashNode	*hp;
+    __pmContext		*ctxp;
+    __pmArchCtl		*acp;
+    __pmLogCtl		*lcp;
+
+    if (configfile != NULL || Sarg != NULL || Targ != NULL ||
+	sarg != -1 || varg != -1 || xarg) {
+	if (pmDebugOptions.appl5)
+	    fprintf(stderr, "concat: not with -c, -S, -T, -s, -v or -x\n");
+	return NULL;
+    }
+
+    if ((order = (int *)malloc(inarchnum * sizeof(int))) == NULL) {
+	fprintf(stderr, "%s: Error: malloc order: %s\n",
+		pmGetProgname(), osstrerror());
+	exit(1);
+    }
+    for (indx=0; indx<inarchnum; indx++) {
+	if (inarch[indx].ctx == PM_ERR_NODATA)
+	    continue;
+	if ((ctxp = __pmHandleToPtr(inarch[indx].ctx)) == NULL) {
+	    fprintf(stderr, "%s: botch: __pmHandleToPtr(%d) returns NULL!\n", pmGetProgname(), inarch[indx].ctx);
+	    abandon_extract();
+	    /*NOTREACHED*/
+	}
+	acp = ctxp->c_archctl;
+	PM_UNLOCK(ctxp->c_lock);
+	if (acp->ac_num_logs != 1) {
+	    reason = "multi-archive input";
+	    goto fail;
+	}
+	if (__pmLogVersion(acp->ac_log) != outarchvers) {
+	    reason = "input and output versions differ";
+	    goto fail;
+	}
+	order[n++] = indx;
+    }
+
+    qsort(order, n, sizeof(order[0]), concat_compare);
+    for (indx=1; indx<n; indx++) {
+	if (__pmTimestampCmp(&inarch[order[indx-1]].end,
+			     &inarch[order[indx]].label.start) >= 0) {
+	    reason = "archives overlap";
+	    goto fail;
+	}
+    }
+
+    /*
+     * metric descriptors and help text have no timestamp, so they must
+     * be the same in every archive
+     */
+    for (indx=0; indx<n && reason == NULL; indx++) {
+	ctxp = __pmHandleToPtr(inarch[order[indx]].ctx);
+	acp = ctxp->c_archctl;
+	lcp = acp->ac_log;
+	PM_UNLOCK(ctxp->c_lock);
+
+	here = __pmFtell(lcp->mdfp);
+	__pmFseek(lcp->mdfp, __pmLogLabelSize(lcp), SEEK_SET);
+	while ((sts = pmaGetLog(acp, PM_LOG_VOL_META, &rec)) == 0) {
+	    type = ntohl(rec[1]);
+	    if (type == TYPE_DESC || type == TYPE_TEXT) {
+		hcp = concat_hash(type);
+		subtype = concat_key(rec, &key);
+		if ((hp = concat_lookup(hcp, key, subtype)) == NULL) {
+		    if (__pmHashAdd(key, rec, hcp) < 0) {
+			fprintf(stderr, "%s: Error: __pmHashAdd: %s\n",
+				pmGetProgname(), osstrerror());
+			exit(1);
+		    }
+		    continue;
+		}
+		if (!concat_same((__int32_t *)hp->data, rec)) {
+		    reason = "metadata differs";
+		    free(rec);
+		    break;
+		}
+	    }
+	    free(rec);
+	}
+	if (sts < 0 && sts != PM_ERR_EOL)
+	    reason = "cannot read metadata";
+	__pmFseek(lcp->mdfp, here, SEEK_SET);
+    }
+    concat_clear(&cdesc);
+    concat_clear(&ctext);
+    if (reason != NULL)
+	goto fail;
+
+    *np = n;
+    return order;
+
+fail:
+    if (pmDebugOptions.appl5)
+	fprintf(stderr, "concat: %s\n", reason);
+    free(order);
+    return NULL;
+}
+
+/*
+ * output metadata offset for an input metadata offset, i.e. after
+ * all the metadata that came before it in the input archive
+ */
+static off_t
+concat_metaoff(off_t off)
+{
+    int		lo = 0;
+    int		hi = cmeta_num - 1;
+    int		mid;
+
+    while (lo < hi) {
+	mid = (lo + hi + 1) / 2;
+	if (cmeta_in[mid] <= off)
+	    lo = mid;
+	else
+	    hi = mid - 1;
+    }
+    return cmeta_out[lo];
+}
+
+static void
+concat_metarec(off_t in, off_t out)
+{
+    if (cmeta_num == cmeta_max) {
+	cmeta_max = cmeta_max ? 2 * cmeta_max : 1024;
+	if ((cmeta_in = (off_t *)realloc(cmeta_in, cmeta_max * sizeof(off_t))) == NULL ||
+	    (cmeta_out = (off_t *)realloc(cmeta_out, cmeta_max * sizeof(off_t))) == NULL) {
+	    fprintf(stderr, "%s: Error: realloc metadata offsets: %s\n",
+		    pmGetProgname(), osstrerror());
+	    abandon_extract();
+	    /*NOTREACHED*/
+	}
+    }
+    cmeta_in[cmeta_num] = in;
+    cmeta_out[cmeta_num] = out;
+    cmeta_num++;
+}
+
+/*
+ * copy the metadata of one input archive, less anything already
+ * written ... indoms and label sets are only dropped if they are
+ * unchanged from the last ones written
+ */
+static void
+concat_meta(inarch_t *iap, __pmArchCtl *acp)
+{
+    __pmLogCtl		*lcp = acp->ac_log;
+    __int32_t		*rec;
+    __pmHashCtl		*hcp;
+    __pmHashNode	*hp;
+    unsigned int	key;
+    int			subtype;
+    int			type;
+    int			skip;
+    int			sts;
+
+    cmeta_num = 0;
+    __pmFseek(lcp->mdfp, __pmLogLabelSize(lcp), SEEK_SET);
+    for ( ; ; ) {
+	concat_metarec(__pmFtell(lcp->mdfp), __pmFtell(logctl.mdfp));
+	if ((sts = pmaGetLog(acp, PM_LOG_VOL_META, &rec)) < 0)
+	    break;
+	type = ntohl(rec[1]);
+	if ((hcp = concat_hash(type)) == NULL) {
+	    /* unknown, copy it anyway */
+	    skip = 0;
+	    hp = NULL;
+	}
+	else {
+	    subtype = concat_key(rec, &key);
+	    hp = concat_lookup(hcp, key, subtype);
+	    if (hp == NULL)
+		skip = 0;
+	    else if (type == TYPE_DESC || type == TYPE_TEXT)
+		skip = 1;
+	    else if (type == TYPE_INDOM_DELTA)
+		skip = 0;
+	    else
+		skip = concat_same((__int32_t *)hp->data, rec);
+	}
+	if (!skip && (sts = pmaPutLog(logctl.mdfp, rec)) < 0) {
+	    fprintf(stderr, "%s: Error: pmaPutLog: meta data: %s\n",
+		    pmGetProgname(), pmErrStr(sts));
+	    abandon_extract();
+	    /*NOTREACHED*/
+	}
+	if (skip || hcp == NULL)
+	    free(rec);
+	else if (hp == NULL) {
+	    if (__pmHashAdd(key, rec, hcp) < 0) {
+		fprintf(stderr, "%s: Error: __pmHashAdd: %s\n",
+			pmGetProgname(), osstrerror());
+		abandon_extract();
+		/*NOTREACHED*/
+	    }
+	}
+	else {
+	    /* remember the latest indom or label set */
+	    free(hp->data);
+	    hp->data = rec;
+	}
+    }
+    if (sts != PM_ERR_EOL) {
+	fprintf(stderr, "%s: Error: pmaGetLog[meta %s]: %s\n",
+		pmGetProgname(), iap->name, pmErrStr(sts));
+	_report(lcp->mdfp);
+	abandon_extract();
+	/*NOTREACHED*/
+    }
+}
+
+/*
+ * temporal index entry for the current output data offset, and the
+ * given metadata offset (or the current one if meta is negative)
+ */
+static void
+concat_index(const __pmTimestamp *tsp, off_t meta)
+{
+    off_t	here;
+
+    __pmFflush(logctl.mdfp);
+    here = __pmFtell(logctl.mdfp);
+    if (meta >= 0)
+	__pmFseek(logctl.mdfp, meta, SEEK_SET);
+    __pmLogPutIndex(&archctl, tsp);
+    __pmFseek(logctl.mdfp, here, SEEK_SET);
+    ctitime = *tsp;
+}
+
+/*
+ * copy the data records of one input archive ... the input temporal
+ * index entries move with the records they point to
+ */
+static void
+concat_data(inarch_t *iap, __pmArchCtl *acp)
+{
+    __pmLogCtl		*lcp = acp->ac_log;
+    __pmLogTI		*tip;
+    __int32_t		*rec;
+    __pmTimestamp	stamp;
+    __uint64_t		max_offset;
+    off_t		here;
+    off_t		off;
+    int			vol;
+    int			t = 0;		/* next input temporal index entry */
+    int			sts;
+
+    max_offset = (outarchvers == PM_LOG_VERS02) ? 0x7fffffff : LONGLONG_MAX;
+
+    if ((sts = __pmLogChangeVol(acp, lcp->minvol)) < 0) {
+	fprintf(stderr, "%s: Error: cannot open volume %d of archive \"%s\": %s\n",
+		pmGetProgname(), lcp->minvol, iap->name, pmErrStr(sts));
+	abandon_extract();
+	/*NOTREACHED*/
+    }
+    __pmFseek(acp->ac_mfp, __pmLogLabelSize(lcp), SEEK_SET);
+
+    for ( ; ; ) {
+	vol = acp->ac_curvol;
+	off = __pmFtell(acp->ac_mfp);
+	if ((sts = pmaGetLog(acp, vol, &rec)) < 0) {
+	    if (sts != PM_ERR_EOL) {
+		fprintf(stderr, "%s: Error: pmaGetLog[log %s]: %s\n",
+			pmGetProgname(), iap->name, pmErrStr(sts));
+		_report(acp->ac_mfp);
+		if (sts != PM_ERR_LOGREC)
+		    abandon_extract();
+		    /*NOTREACHED*/
+	    }
+	    break;
+	}
+	if (acp->ac_curvol != vol) {
+	    /* record is the first in the next volume */
+	    vol = acp->ac_curvol;
+	    off = __pmLogLabelSize(lcp);
+	}
+	if (outarchvers == PM_LOG_VERS03)
+	    __pmLoadTimestamp(&rec[1], &stamp);
+	else
+	    __pmLoadTimeval(&rec[1], &stamp);
+
+	if (first_datarec) {
+	    first_datarec = 0;
+	    logctl.label.start = stamp;
+	    logctl.state = PM_LOG_STATE_INIT;
+	    writelabel_data();
+	}
+
+	/* switch volumes if required, as in writerlist() */
+	here = __pmFtell(archctl.ac_mfp);
+	if (here + ntohl(rec[0]) > max_offset) {
+	    newvolume(outarchname, &stamp);
+	    here = __pmFtell(archctl.ac_mfp);
+	}
+
+	for ( ; t < lcp->numti; t++) {
+	    tip = &lcp->ti[t];
+	    if (tip->vol > vol || (tip->vol == vol && tip->off_data > off))
+		break;
+	    if (__pmTimestampCmp(&tip->stamp, &ctitime) > 0)
+		concat_index(&tip->stamp, concat_metaoff(tip->off_meta));
+	}
+	/*
+	 * each output volume starts with an index entry, and without
+	 * an input temporal index add them as writerlist() would
+	 */
+	if ((here == __pmLogLabelSize(&logctl) ||
+	     (lcp->numti == 0 && here > flushsize)) &&
+	    __pmTimestampCmp(&stamp, &ctitime) > 0) {
+	    concat_index(&stamp, -1);
+	    flushsize = here + 100000;
+	}
+
+	old_log_offset = here;
+	if ((sts = pmaPutLog(archctl.ac_mfp, rec)) < 0) {
+	    fprintf(stderr, "%s: Error: pmaPutLog: log data: %s\n",
+		    pmGetProgname(), pmErrStr(sts));
+	    abandon_extract();
+	    /*NOTREACHED*/
+	}
+	free(rec);
+	written++;
+	current = iap->laststamp = stamp;
+	iap->recnum++;
+	clast_vol = vol;
+	clast_off = off;
+    }
+}
+
+/*
+ * pmcd.pid and pmcd.seqnum from the record at vol/off, if it is a
+ * prologue or epilogue record
+ */
+static void
+concat_pmcd(inarch_t *iap, int vol, off_t off)
+{
+    __pmContext	*ctxp;
+    __pmArchCtl	*acp;
+    __pmResult	*rp;
+
+    iap->pmcd_pid = -1;
+    iap->pmcd_seqnum = -1;
+    if (pmUseContext(iap->ctx) < 0 ||
+	(ctxp = __pmHandleToPtr(iap->ctx)) == NULL)
+	return;
+    acp = ctxp->c_archctl;
+    PM_UNLOCK(ctxp->c_lock);
+    if (__pmLogChangeVol(acp, vol) < 0)
+	return;
+    __pmFseek(acp->ac_mfp, off, SEEK_SET);
+    if (__pmLogRead(acp, PM_MODE_FORW, NULL, &rp, PMLOGREAD_NEXT) < 0)
+	return;
+    pmcd_ids(iap, rp);
+    __pmFreeResult(rp);
+}
+
+/*
+ * as for do_not_need_mark(), no <mark> is needed if one archive ends
+ * with an epilogue and the next starts with a prologue from the same
+ * pmcd
+ */
+static int
+concat_need_mark(inarch_t *iap, inarch_t *next)
+{
+    __pmContext	*ctxp;
+    __pmLogCtl	*lcp;
+
+    if (old_mark_logic)
+	return 1;
+    concat_pmcd(iap, clast_vol, clast_off);
+    if (iap->pmcd_pid == -1 || iap->pmcd_seqnum == -1)
+	return 1;
+    if ((ctxp = __pmHandleToPtr(next->ctx)) == NULL)
+	return 1;
+    lcp = ctxp->c_archctl->ac_log;
+    PM_UNLOCK(ctxp->c_lock);
+    concat_pmcd(next, lcp->minvol, __pmLogLabelSize(lcp));
+    return iap->pmcd_pid != next->pmcd_pid ||
+	   iap->pmcd_seqnum != next->pmcd_seqnum;
+}
+
+static void
+concat_archives(int *order, int n)
+{
+    int			indx;
+    int			sts;
+    inarch_t		*iap;
+    __pmContext		*ctxp;
+    __pmTimestamp	msec = { 0, 1000000 };		/* 1msec */
+
+    for (indx=0; indx<n; indx++) {
+	iap = &inarch[order[indx]];
+	if ((ctxp = __pmHandleToPtr(iap->ctx)) == NULL) {
+	    fprintf(stderr, "%s: botch: __pmHandleToPtr(%d) returns NULL!\n", pmGetProgname(), iap->ctx);
+	    abandon_extract();
+	    /*NOTREACHED*/
+	}
+	PM_UNLOCK(ctxp->c_lock);
+	if (pmDebugOptions.appl5)
+	    fprintf(stderr, "concat: copy %s\n", iap->name);
+
+	concat_meta(iap, ctxp->c_archctl);
+	concat_data(iap, ctxp->c_archctl);
+
+	if (indx < n-1 && !first_datarec &&
+	    concat_need_mark(iap, &inarch[order[indx+1]])) {
+	    __pmTimestampInc(&iap->laststamp, &msec);
+	    old_log_offset = __pmFtell(archctl.ac_mfp);
+	    if ((sts = __pmLogWriteMark(&archctl, &iap->laststamp, NULL)) < 0) {
+		fprintf(stderr, "%s: __pmLogWriteMark failed: %s\n",
+			pmGetProgname(), pmErrStr(sts));
+		abandon_extract();
+		/*NOTREACHED*/
+	    }
+	    current = iap->laststamp;
+	    written++;
+	}
+    }
+    concat_clear(&cdesc);
+    concat_clear(&ctext);
+    concat_clear(&cindom);
+    concat_clear(&clabel);
+    free(cmeta_in);
+    free(cmeta_out);
+}
+
 /*--- END FUNCTIONS ---------------------------------------------------------*/
 
 int
@@ -2734,6 +3392,8 @@ main(int argc, char **argv)
     int			stslog;		/* sts from nextlog() */
     int			stsmeta;	/* sts from nextmeta() */
     int			nempty = 0;	/* number of empty input archives */
+    int			*order;		/* input archives for -C */
+    int			norder;
 
     char	*msg;
 
@@ -2807,6 +3467,7 @@ main(int argc, char **argv)
 	iap->recnum = 0;
 	iap->_result = NULL;
 	iap->_Nresult = NULL;
+	iap->prefetch = NULL;
 
 	if ((iap->ctx = pmNewContext(PM_CONTEXT_ARCHIVE, iap->name)) < 0) {
 	    if (iap->ctx == PM_ERR_NODATA) {
@@ -2842,9 +3503,11 @@ main(int argc, char **argv)
 	}
 
 	/*
-	 * Note: This application is single threaded, and once we have ctxp
-	 *       the associated __pmContext will not move and will only be
-	 *       accessed or modified synchronously either here or in libpcp.
+	 * Note: Once we have ctxp the associated __pmContext will not move.
+	 *       Until the read-ahead threads are started (see prefetch.c)
+	 *       it will only be accessed or modified synchronously either
+	 *       here or in libpcp, and after that all access is with the
+	 *       context locked.
 	 *       We unlock the context so that it can be locked as required
 	 *       within libpcp.
 	 */
@@ -2860,6 +3523,7 @@ main(int argc, char **argv)
 	    else
 		exit(1);
 	}
+	iap->end = end;			/* struct assignment */
 
 	if (indx == 0) {
 	    /* start time */
@@ -3038,6 +3702,16 @@ main(int argc, char **argv)
     first_datarec = 1;
     pre_startwin = 1;
 
+    /*
+     * with -C, if the input archives simply concatenate then copy them
+     * one after the other, rather than merging them record by record
+     */
+    if (Carg && (order = concat_check(&norder)) != NULL) {
+	concat_archives(order, norder);
+	free(order);
+	goto done;
+    }
+
     /*
      * get all meta data first
      * nextmeta() should return 0 (will return -1 when all meta is eof)
@@ -3046,6 +3720,20 @@ main(int argc, char **argv)
 	stsmeta = nextmeta();
     } while (stsmeta >= 0);
 
+    /*
+     * now start reading ahead the data records ... not before this,
+     * because for an input that is a multi-archive context reading
+     * past the end of one archive switches the context (and the
+     * metadata file) to the next archive
+     *
+     * by default one thread per input archive up to the number of
+     * CPUs, but none when debugging so the diagnostics from libpcp
+     * are not interleaved
+     */
+    if (Parg < 0)
+	Parg = Darg ? 0 : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    prefetch_start(Parg);
+
     if (skip_ml_numpmid > 0) {
 	fprintf(stderr, "Warning: the metrics below will be missing from the output archive\n");
 	for (j=0; j<skip_ml_numpmid; j++) {
@@ -3272,6 +3960,9 @@ main(int argc, char **argv)
 	}
     } /*while()*/
 
+    prefetch_stop();
+
+done:
     if (first_datarec) {
         fprintf(stderr, "%s: Warning: no qualifying records found.\n",
                 pmGetProgname());
@@ -3298,7 +3989,8 @@ cleanup:
 	}
 
 	__pmFseek(archctl.ac_mfp, old_log_offset, SEEK_SET);
-	__pmLogPutIndex(&archctl, &current);
+	if (__pmTimestampCmp(&current, &ctitime) > 0)
+	    __pmLogPutIndex(&archctl, &current);
 
 	/* need to fix up label with new start-time */
 	writelabel_metati(1);
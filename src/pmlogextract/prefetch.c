@@ -0,0 +1,267 @@
+/*
+ * prefetch.c
+ *
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * Read-ahead of the data records from the input archives.
+ *
+ * Reading and decoding a data record (and decompressing the data
+ * volume) is where most of the time goes when many input archives are
+ * merged, and each input archive has its own context, so these can
+ * proceed in parallel.  A small pool of reader threads fills a bounded
+ * queue of decoded results for each input archive, and nextlog() takes
+ * the results from the head of the queue, in the same order as the
+ * records would have been read directly.  All the merging (choosing
+ * the earliest result, time window and metric selection, metadata and
+ * output) is unchanged and remains in the main thread.
+ */
+
+#include "pmapi.h"
+#include "libpcp.h"
+#include "logger.h"
+
+#define PREFETCH_DEPTH	16	/* decoded results queued per input archive */
+
+typedef struct {
+    int		sts;		/* from __pmLogRead_ctx() */
+    __pmResult	*result;
+} slot_t;
+
+typedef struct {
+    int		ctx;
+    int		head;		/* next slot to be taken */
+    int		count;		/* number of queued slots */
+    int		done;		/* reader has seen end of log or error */
+    int		last_sts;	/* ... and this is the final sts */
+    slot_t	slot[PREFETCH_DEPTH];
+} queue_t;
+
+/*
+ * read the next data record for context ctx, as done by nextlog()
+ * before there was any read-ahead
+ */
+static int
+readlog(int ctx, __pmResult **result)
+{
+    __pmContext	*ctxp;
+    int		sts;
+
+    if ((ctxp = __pmHandleToPtr(ctx)) == NULL) {
+	fprintf(stderr, "%s: botch: __pmHandleToPtr(%d) returns NULL!\n", pmGetProgname(), ctx);
+	abandon_extract();
+	/*NOTREACHED*/
+    }
+    /* Need to hold c_lock for __pmLogRead_ctx() */
+    sts = __pmLogRead_ctx(ctxp, PM_MODE_FORW, NULL, result, PMLOGREAD_NEXT);
+    PM_UNLOCK(ctxp->c_lock);
+    return sts;
+}
+
+#ifdef PM_MULTI_THREAD
+static pthread_mutex_t	prefetch_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	prefetch_more = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t	prefetch_space = PTHREAD_COND_INITIALIZER;
+static pthread_t	*readers;
+static int		nreaders;
+static int		stopping;
+
+/*
+ * reader thread number n services every nreaders'th input archive,
+ * starting with inarch[n], and always reads ahead for the input
+ * archive with the shortest queue
+ */
+static void *
+reader(void *arg)
+{
+    int		n = (int)(long)arg;
+    int		indx;
+    int		sts;
+    int		tail;
+    queue_t	*qp;
+    queue_t	*pick;
+    __pmResult	*result;
+
+    pthread_mutex_lock(&prefetch_lock);
+    for ( ; ; ) {
+	pick = NULL;
+	for (indx = n; indx < inarchnum; indx += nreaders) {
+	    qp = (queue_t *)inarch[indx].prefetch;
+	    if (qp == NULL || qp->done || qp->count == PREFETCH_DEPTH)
+		continue;
+	    if (pick == NULL || qp->count < pick->count)
+		pick = qp;
+	}
+	if (stopping)
+	    break;
+	if (pick == NULL) {
+	    for (indx = n; indx < inarchnum; indx += nreaders) {
+		qp = (queue_t *)inarch[indx].prefetch;
+		if (qp != NULL && !qp->done)
+		    break;
+	    }
+	    if (indx >= inarchnum)
+		break;		/* all done */
+	    pthread_cond_wait(&prefetch_space, &prefetch_lock);
+	    continue;
+	}
+	pthread_mutex_unlock(&prefetch_lock);
+
+	result = NULL;
+	sts = readlog(pick->ctx, &result);
+
+	pthread_mutex_lock(&prefetch_lock);
+	tail = (pick->head + pick->count) % PREFETCH_DEPTH;
+	pick->slot[tail].sts = sts;
+	pick->slot[tail].result = result;
+	pick->count++;
+	if (sts < 0) {
+	    pick->done = 1;
+	    pick->last_sts = sts;
+	}
+	pthread_cond_broadcast(&prefetch_more);
+    }
+    pthread_mutex_unlock(&prefetch_lock);
+    return NULL;
+}
+
+/*
+ * start up to nthreads reader threads ... returns the number of reader
+ * threads started, 0 means no read-ahead and nextlog() reads directly
+ */
+int
+prefetch_start(int nthreads)
+{
+    int		indx;
+    int		sts;
+    queue_t	*qp;
+
+    if (nthreads > inarchnum)
+	nthreads = inarchnum;
+    if (nthreads <= 0)
+	return 0;
+
+    if ((readers = (pthread_t *)malloc(nthreads * sizeof(pthread_t))) == NULL) {
+	fprintf(stderr, "%s: Warning: cannot malloc space for %d reader threads, no read-ahead\n",
+		pmGetProgname(), nthreads);
+	return 0;
+    }
+    for (indx = 0; indx < inarchnum; indx++) {
+	if (inarch[indx].eof[LOG])
+	    continue;		/* empty archive, never read */
+	if ((qp = (queue_t *)calloc(1, sizeof(queue_t))) == NULL) {
+	    fprintf(stderr, "%s: Error: cannot malloc space in \"prefetch_start\"\n",
+		    pmGetProgname());
+	    exit(1);
+	}
+	qp->ctx = inarch[indx].ctx;
+	inarch[indx].prefetch = (void *)qp;
+    }
+
+    nreaders = nthreads;
+    for (indx = 0; indx < nthreads; indx++) {
+	if ((sts = pthread_create(&readers[indx], NULL, reader, (void *)(long)indx)) != 0) {
+	    fprintf(stderr, "%s: Error: cannot create reader thread: %s\n",
+		    pmGetProgname(), strerror(sts));
+	    exit(1);
+	}
+    }
+    if (pmDebugOptions.appl0)
+	fprintf(stderr, "prefetch_start: %d reader threads for %d input archives\n",
+		nthreads, inarchnum);
+    return nthreads;
+}
+
+/*
+ * stop the reader threads and discard any results not yet taken
+ */
+void
+prefetch_stop(void)
+{
+    int		indx;
+    queue_t	*qp;
+
+    if (readers == NULL)
+	return;
+
+    pthread_mutex_lock(&prefetch_lock);
+    stopping = 1;
+    pthread_cond_broadcast(&prefetch_space);
+    pthread_mutex_unlock(&prefetch_lock);
+    for (indx = 0; indx < nreaders; indx++)
+	pthread_join(readers[indx], NULL);
+    free(readers);
+    readers = NULL;
+
+    for (indx = 0; indx < inarchnum; indx++) {
+	if ((qp = (queue_t *)inarch[indx].prefetch) == NULL)
+	    continue;
+	while (qp->count > 0) {
+	    if (qp->slot[qp->head].result != NULL)
+		__pmFreeResult(qp->slot[qp->head].result);
+	    qp->head = (qp->head + 1) % PREFETCH_DEPTH;
+	    qp->count--;
+	}
+	free(qp);
+	inarch[indx].prefetch = NULL;
+    }
+}
+
+#else /* !PM_MULTI_THREAD */
+
+int
+prefetch_start(int nthreads)
+{
+    (void)nthreads;
+    return 0;
+}
+
+void
+prefetch_stop(void)
+{
+}
+#endif /* PM_MULTI_THREAD */
+
+/*
+ * next data record for an input archive, from the read-ahead queue if
+ * there is one, else read directly ... same return value and result as
+ * __pmLogRead_ctx()
+ */
+int
+prefetch_next(inarch_t *iap, __pmResult **result)
+{
+#ifdef PM_MULTI_THREAD
+    queue_t	*qp = (queue_t *)iap->prefetch;
+    int		sts;
+
+    if (qp != NULL) {
+	pthread_mutex_lock(&prefetch_lock);
+	while (qp->count == 0 && !qp->done)
+	    pthread_cond_wait(&prefetch_more, &prefetch_lock);
+	if (qp->count == 0) {
+	    /* already returned the end of log or error */
+	    sts = qp->last_sts;
+	    *result = NULL;
+	}
+	else {
+	    sts = qp->slot[qp->head].sts;
+	    *result = qp->slot[qp->head].result;
+	    qp->head = (qp->head + 1) % PREFETCH_DEPTH;
+	    qp->count--;
+	    pthread_cond_broadcast(&prefetch_space);
+	}
+	pthread_mutex_unlock(&prefetch_lock);
+	return sts;
+    }
+#endif
+    return readlog(iap->ctx, result);
+}
@@ -414,11 +414,15 @@ _configure_pmlogger()
 	then
 	    # pmlogconf file that we own, see if re-generation is needed
 	    eval $CP "$configfile" "$tmpconfig"
+	    # probe results are cached per host between our runs
+	    cachedir="$PCP_TMP_DIR/pmlogconf"
+	    [ -d "$cachedir" ] || mkdir_and_chown "$cachedir" 755 $PCP_USER:$PCP_GROUP >/dev/null 2>&1
+	    cachefile="$cachedir/`echo "$hostname" | sed -e 's;[/:];_;g'`"
 	    if $SHOWME
 	    then
-		echo + $PMLOGCONF -r -c -q -h $hostname "$tmpconfig"
+		echo + $PMLOGCONF -r -c -q -C "$cachefile" -h $hostname "$tmpconfig"
 	    else
-		if $PMLOGCONF -r -c -q -h $hostname "$tmpconfig" </dev/null >$tmp/diag 2>&1
+		if $PMLOGCONF -r -c -q -C "$cachefile" -h $hostname "$tmpconfig" </dev/null >$tmp/diag 2>&1
 		then
 		    if grep 'No changes' $tmp/diag >/dev/null 2>&1
 		    then
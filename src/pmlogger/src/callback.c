@@ -39,6 +39,8 @@ typedef struct _lastfetch {
     struct _lastfetch	*lf_next;
     fetchctl_t		*lf_fp;
     __pmResult		*lf_resp;
+    char		*lf_logged;	/* log on change: lf_resp value sets logged */
+    __pmTimestamp	lf_full;	/* log on change: last time all logged */
 } lastfetch_t;
 
 typedef struct _AFctl {
@@ -49,6 +51,118 @@ typedef struct _AFctl {
 
 static AFctl_t		*achead = (AFctl_t *)0;
 
+/*
+ * Archive write policy ... data volume bytes between temporal index
+ * entries (and frames for compressed volumes), and seconds between
+ * forced writes to stable storage of the data volume, metadata and
+ * temporal index (0 to leave this to the kernel, the default).
+ * Overridden from PMLOGGER_FLUSHSIZE and PMLOGGER_SYNC_INTERVAL.
+ *
+ * Optionally, a temporal index entry is also written after every
+ * indexrecs results and/or when indexdelta seconds of archive time
+ * have passed since the last one (0 for neither, the default), from
+ * PMLOGGER_INDEX_RECORDS and PMLOGGER_INDEX_INTERVAL.
+ *
+ * For tasks logged on change, every value set is logged at least once
+ * every heartbeat seconds (0 for only the first result in each volume),
+ * from PMLOGGER_HEARTBEAT.
+ */
+static off_t		flushdelta = -1;
+static int		syncdelta;
+static time_t		last_sync;
+static int		indexrecs;
+static int		indexdelta;
+static int		heartbeat = 3600;
+static int		last_ti_recs;
+static __pmTimestamp	last_ti_stamp;
+
+static void
+init_write_policy(void)
+{
+    char	*env_str;
+    char	*endp;
+    long	val;
+
+    flushdelta = 100000;
+    if ((env_str = getenv("PMLOGGER_FLUSHSIZE")) != NULL) {
+	val = strtol(env_str, &endp, 10);
+	if (*endp != '\0' || val <= 0)
+	    pmNotifyErr(LOG_WARNING, "ignored bad PMLOGGER_FLUSHSIZE = '%s'", env_str);
+	else
+	    flushdelta = val;
+    }
+    if ((env_str = getenv("PMLOGGER_SYNC_INTERVAL")) != NULL) {
+	val = strtol(env_str, &endp, 10);
+	if (*endp != '\0' || val < 0)
+	    pmNotifyErr(LOG_WARNING, "ignored bad PMLOGGER_SYNC_INTERVAL = '%s'", env_str);
+	else
+	    syncdelta = val;
+    }
+    if ((env_str = getenv("PMLOGGER_INDEX_RECORDS")) != NULL) {
+	val = strtol(env_str, &endp, 10);
+	if (*endp != '\0' || val < 0 || val > INT_MAX)
+	    pmNotifyErr(LOG_WARNING, "ignored bad PMLOGGER_INDEX_RECORDS = '%s'", env_str);
+	else
+	    indexrecs = val;
+    }
+    if ((env_str = getenv("PMLOGGER_INDEX_INTERVAL")) != NULL) {
+	val = strtol(env_str, &endp, 10);
+	if (*endp != '\0' || val < 0 || val > INT_MAX)
+	    pmNotifyErr(LOG_WARNING, "ignored bad PMLOGGER_INDEX_INTERVAL = '%s'", env_str);
+	else
+	    indexdelta = val;
+    }
+    if ((env_str = getenv("PMLOGGER_HEARTBEAT")) != NULL) {
+	val = strtol(env_str, &endp, 10);
+	if (*endp != '\0' || val < 0 || val > INT_MAX)
+	    pmNotifyErr(LOG_WARNING, "ignored bad PMLOGGER_HEARTBEAT = '%s'", env_str);
+	else
+	    heartbeat = val;
+    }
+    last_sync = time(NULL);
+}
+
+static int
+sync_due(void)
+{
+    return syncdelta > 0 && time(NULL) - last_sync >= syncdelta;
+}
+
+/*
+ * Is a temporal index entry due for the result with this timestamp,
+ * based on a count of results or an archive time interval?
+ */
+static int
+index_due(__pmTimestamp *stamp)
+{
+    if (indexrecs > 0 && last_ti_recs >= indexrecs)
+	return 1;
+    if (indexdelta > 0 &&
+	__pmTimestampSub(stamp, &last_ti_stamp) >= indexdelta)
+	return 1;
+    return 0;
+}
+
+/*
+ * Push everything written so far to stable storage.  A compressed
+ * data volume has already been flushed at the start of the frame
+ * holding the latest result (see do_work), so it is not flushed
+ * again here.
+ */
+static void
+sync_archive(void)
+{
+    if (compress_method == NULL)
+	__pmFflush(archctl.ac_mfp);
+    __pmFflush(logctl.mdfp);
+    __pmFflush(logctl.tifp);
+    if (__pmFsync(archctl.ac_mfp) < 0 ||
+	__pmFsync(logctl.mdfp) < 0 ||
+	__pmFsync(logctl.tifp) < 0)
+	pmNotifyErr(LOG_WARNING, "archive sync failed: %s", osstrerror());
+    last_sync = time(NULL);
+}
+
 /* clear the "metric/instance was available at last fetch" flag for each metric
  * and instance in the specified fetchgroup.
  */
@@ -266,6 +380,73 @@ done:
 }
 
 
+/*
+ * Instance domains refetched from pmcd and found to be unchanged,
+ * keyed by indom with the timestamp of the result that prompted the
+ * refetch.  Other metrics in the same result with the same indom now
+ * reuse that answer rather than calling pmGetInDom again.
+ */
+static __pmHashCtl	indom_checked;
+
+static int
+indom_checked_at(pmInDom indom, const __pmTimestamp *stamp)
+{
+    __pmHashNode	*hp;
+
+    for (hp = __pmHashSearch((unsigned int)indom, &indom_checked); hp != NULL; hp = hp->next) {
+	if (hp->key == (unsigned int)indom)
+	    return __pmTimestampSub(stamp, (__pmTimestamp *)hp->data) <= 0;
+    }
+    return 0;
+}
+
+static void
+set_indom_checked(pmInDom indom, const __pmTimestamp *stamp)
+{
+    __pmHashNode	*hp;
+    __pmTimestamp	*tsp;
+    int			sts;
+
+    for (hp = __pmHashSearch((unsigned int)indom, &indom_checked); hp != NULL; hp = hp->next) {
+	if (hp->key == (unsigned int)indom) {
+	    *(__pmTimestamp *)hp->data = *stamp;	/* struct assignment */
+	    return;
+	}
+    }
+    if ((tsp = (__pmTimestamp *)malloc(sizeof(*tsp))) == NULL) {
+	pmNoMem("set_indom_checked", sizeof(*tsp), PM_RECOV_ERR);
+	return;
+    }
+    *tsp = *stamp;	/* struct assignment */
+    if ((sts = __pmHashAdd((unsigned int)indom, (void *)tsp, &indom_checked)) < 0) {
+	fprintf(stderr, "set_indom_checked: __pmHashAdd: %s\n", pmErrStr(sts));
+	free(tsp);
+    }
+}
+
+/*
+ * Is inst in the cached indom?  Instance lists of indoms logged by
+ * pmlogger are sorted (pmaSortInDom), so this is a binary search.
+ */
+static int
+inst_in_indom(int inst, const __pmLogInDom *lidp)
+{
+    int		lo = 0;
+    int		hi = lidp->numinst - 1;
+    int		mid;
+
+    while (lo <= hi) {
+	mid = lo + (hi - lo) / 2;
+	if (lidp->instlist[mid] == inst)
+	    return 1;
+	if (lidp->instlist[mid] < inst)
+	    lo = mid + 1;
+	else
+	    hi = mid - 1;
+    }
+    return 0;
+}
+
 /*
  * compare __pmResults for a particular metric, and return 1 if
  * the set of instances has changed.
@@ -315,11 +496,37 @@ check_inst(pmValueSet *vsp, int hint, __pmResult *lrp)
     return 0;
 }
 
+/*
+ * Return true if the labelsets are identical (same instances, labels
+ * and order) - both are as returned by pmGet*Labels for one ident.
+ */
 static int
-putlabels(unsigned int type, unsigned int ident, const __pmTimestamp *tsp)
+samelabels(pmLabelSet *a, int na, pmLabelSet *b, int nb)
 {
-    int		len;
-    pmLabelSet	*label;
+    int		i;
+
+    if (na != nb)
+	return 0;
+    for (i = 0; i < na; i++) {
+	if (a[i].inst != b[i].inst || a[i].jsonlen != b[i].jsonlen)
+	    return 0;
+	if (a[i].jsonlen && memcmp(a[i].json, b[i].json, a[i].jsonlen) != 0)
+	    return 0;
+    }
+    return 1;
+}
+
+/*
+ * Fetch the labels of the given type and ident, and write them to
+ * the archive - if only_changed is set, only when they differ from
+ * those most recently logged.
+ */
+static int
+putlabels(unsigned int type, unsigned int ident, const __pmTimestamp *tsp,
+	int only_changed)
+{
+    int		len, oldlen;
+    pmLabelSet	*label, *oldlabel;
 
     if (type == PM_LABEL_CONTEXT)
 	len = pmGetContextLabels(&label);
@@ -338,6 +545,13 @@ putlabels(unsigned int type, unsigned int ident, const __pmTimestamp *tsp)
 
     if (len > 0) {
 	int	sts;
+
+	if (only_changed &&
+	    (oldlen = __pmLogLookupLabel(&archctl, type, ident, &oldlabel, tsp)) > 0 &&
+	    samelabels(label, len, oldlabel, oldlen)) {
+	    pmFreeLabelSets(label, len);
+	    return 0;
+	}
 	sts = __pmLogPutLabels(&archctl, type, ident, len, label, tsp);
 	if (sts < 0)
 	    /*
@@ -351,6 +565,32 @@ putlabels(unsigned int type, unsigned int ident, const __pmTimestamp *tsp)
     return 0;
 }
 
+/*
+ * Identifier for the labels of the given type for a metric, returns
+ * PM_IN_NULL for indom and instance labels of singular metrics.
+ */
+static unsigned int
+labelident(unsigned int type, pmDesc *desc)
+{
+    unsigned int	ident;
+
+    if (type == PM_LABEL_INDOM || type == PM_LABEL_INSTANCES)
+	ident = desc->indom;
+    else if (type == PM_LABEL_DOMAIN)
+	ident = pmID_domain(desc->pmid);
+    else if (type == PM_LABEL_CLUSTER)
+	ident = pmID_build(pmID_domain(desc->pmid), pmID_cluster(desc->pmid), 0);
+    else if (type == PM_LABEL_ITEM) {
+	ident = desc->pmid;
+	if (IS_DERIVED(ident))
+	    /* derived metric, rewrite cluster field ... */
+	    ident = SET_DERIVED_LOGGED(ident);
+    }
+    else
+	ident = PM_IN_NULL;
+    return ident;
+}
+
 static int
 manageLabels(pmDesc *desc, const __pmTimestamp *tsp, int only_instances)
 {
@@ -358,7 +598,7 @@ manageLabels(pmDesc *desc, const __pmTimestamp *tsp, int only_instances)
     int		sts = 0;
     pmLabelSet	*label;
     unsigned int type;
-    unsigned int ident = PM_IN_NULL;
+    unsigned int ident;
     unsigned int label_types[] = {
 	PM_LABEL_CONTEXT, PM_LABEL_DOMAIN, PM_LABEL_INDOM,
 	PM_LABEL_CLUSTER, PM_LABEL_ITEM, PM_LABEL_INSTANCES
@@ -371,34 +611,74 @@ manageLabels(pmDesc *desc, const __pmTimestamp *tsp, int only_instances)
     for (; i < ntypes; i++) {
 	type = label_types[i];
 
-	if (type == PM_LABEL_INDOM || type == PM_LABEL_INSTANCES) {
-	    if (desc->indom == PM_INDOM_NULL)
-		continue;
-	    ident = desc->indom;
-	}
-	else if (type == PM_LABEL_DOMAIN)
-	    ident = pmID_domain(desc->pmid);
-	else if (type == PM_LABEL_CLUSTER)
-	    ident = pmID_build(pmID_domain(desc->pmid), pmID_cluster(desc->pmid), 0);
-	else if (type == PM_LABEL_ITEM) {
-	    ident = desc->pmid;
-	    if (IS_DERIVED(ident))
-		/* derived metric, rewrite cluster field ... */
-		ident = SET_DERIVED_LOGGED(ident);
-	}
-	else
-	    ident = PM_IN_NULL;
+	if ((type == PM_LABEL_INDOM || type == PM_LABEL_INSTANCES) &&
+	    desc->indom == PM_INDOM_NULL)
+	    continue;
+	ident = labelident(type, desc);
 
 	/* Lookup returns >= 0 when the key exists */
 	if (__pmLogLookupLabel(&archctl, type, ident, &label, tsp) >= 0)
 	    continue;
 
-	if ((sts = putlabels(type, ident, tsp)) < 0)
+	if ((sts = putlabels(type, ident, tsp, 0)) < 0)
 	    break;
     }
     return sts;
 }
 
+/*
+ * PMCD has flagged a label change - refetch labels at only the levels
+ * it reported as changed (context labels alone, if the PMCD is too old
+ * to say), for the metrics in this result that are already described
+ * in the archive, and log those that differ from the archive's copy.
+ * Metrics seen for the first time are handled by manageLabels().
+ */
+static void
+changedLabels(__pmResult *resp, int changed, const __pmTimestamp *tsp)
+{
+    static const struct {
+	unsigned int	type;
+	int		flag;
+    } levels[] = {
+	{ PM_LABEL_DOMAIN,	PMCD_DOMAIN_LABEL_CHANGE },
+	{ PM_LABEL_INDOM,	PMCD_INDOM_LABEL_CHANGE },
+	{ PM_LABEL_CLUSTER,	PMCD_CLUSTER_LABEL_CHANGE },
+	{ PM_LABEL_ITEM,	PMCD_ITEM_LABEL_CHANGE },
+	{ PM_LABEL_INSTANCES,	PMCD_INSTANCES_LABEL_CHANGE },
+    };
+    const unsigned int	nlevels = sizeof(levels) / sizeof(levels[0]);
+    __pmHashCtl		done[sizeof(levels) / sizeof(levels[0])];
+    pmDesc		desc;
+    unsigned int	ident;
+    int			i, l;
+
+    if ((changed & PMCD_LABEL_LEVELS) == 0)
+	changed |= PMCD_CONTEXT_LABEL_CHANGE;
+    if (changed & PMCD_CONTEXT_LABEL_CHANGE)
+	putlabels(PM_LABEL_CONTEXT, PM_IN_NULL, tsp, 1);
+    if ((changed & PMCD_LABEL_LEVELS & ~PMCD_CONTEXT_LABEL_CHANGE) == 0)
+	return;
+
+    for (l = 0; l < nlevels; l++)
+	__pmHashInit(&done[l]);
+    for (i = 0; i < resp->numpmid; i++) {
+	if (__pmLogLookupDesc(&archctl, resp->vset[i]->pmid, &desc) < 0)
+	    continue;
+	for (l = 0; l < nlevels; l++) {
+	    if ((changed & levels[l].flag) == 0)
+		continue;
+	    if ((ident = labelident(levels[l].type, &desc)) == PM_IN_NULL)
+		continue;
+	    if (__pmHashSearch(ident, &done[l]) != NULL)
+		continue;
+	    __pmHashAdd(ident, NULL, &done[l]);
+	    putlabels(levels[l].type, ident, tsp, 1);
+	}
+    }
+    for (l = 0; l < nlevels; l++)
+	__pmHashFree(&done[l]);
+}
+
 static int
 manageText(pmDesc *desc)
 {
@@ -584,6 +864,161 @@ log_callback(int afid, void *data)
     }
 }
 
+/*
+ * Log on change ... is this value set the same as the one from the
+ * previous fetch?  Instances are expected in the same order, as they
+ * are for repeated fetches of an unchanged instance domain.
+ */
+static int
+same_valueset(pmValueSet *vsp, pmValueSet *lvsp)
+{
+    pmValue	*vp, *lvp;
+    int		j;
+
+    if (vsp->numval != lvsp->numval)
+	return 0;
+    if (vsp->numval <= 0)
+	return 1;	/* no values, or the same error */
+    if (vsp->valfmt != lvsp->valfmt)
+	return 0;
+    for (j = 0; j < vsp->numval; j++) {
+	vp = &vsp->vlist[j];
+	lvp = &lvsp->vlist[j];
+	if (vp->inst != lvp->inst)
+	    return 0;
+	if (vsp->valfmt == PM_VAL_INSITU) {
+	    if (vp->value.lval != lvp->value.lval)
+		return 0;
+	}
+	else if (vp->value.pval->vlen != lvp->value.pval->vlen ||
+		 memcmp(vp->value.pval, lvp->value.pval, vp->value.pval->vlen) != 0)
+	    return 0;
+    }
+    return 1;
+}
+
+static void
+put_result(__pmResult *resp)
+{
+    __pmPDU	*pb;
+    int		sts;
+
+    if ((sts = __pmEncodeResult(&logctl, resp, &pb)) < 0) {
+	fprintf(stderr, "__pmEncodeResult: %s\n", pmErrStr(sts));
+	exit(1);
+    }
+    if (archive_version >= PM_LOG_VERS03) {
+	if ((sts = __pmLogPutResult3(&archctl, pb)) < 0) {
+	    fprintf(stderr, "__pmLogPutResult3: (encode) %s\n", pmErrStr(sts));
+	    exit(1);
+	}
+    } else {
+	if ((sts = __pmLogPutResult2(&archctl, pb)) < 0) {
+	    fprintf(stderr, "__pmLogPutResult2: (encode) %s\n", pmErrStr(sts));
+	    exit(1);
+	}
+    }
+    __pmUnpinPDUBuf(pb);
+}
+
+/*
+ * Log on change ... write only those value sets of resp flagged in
+ * logged, optionally with a different timestamp.  The result is put
+ * back the way it was afterwards.
+ */
+static void
+put_some_result(__pmResult *resp, const char *logged, const __pmTimestamp *stamp)
+{
+    pmValueSet		**save;
+    __pmTimestamp	savestamp = resp->timestamp;
+    int			numpmid = resp->numpmid;
+    int			i, n;
+
+    if ((save = (pmValueSet **)malloc(numpmid * sizeof(save[0]))) == NULL) {
+	pmNoMem("put_some_result", numpmid * sizeof(save[0]), PM_FATAL_ERR);
+	/*NOTREACHED*/
+    }
+    memcpy(save, resp->vset, numpmid * sizeof(save[0]));
+    for (i = n = 0; i < numpmid; i++) {
+	if (logged[i])
+	    resp->vset[n++] = save[i];
+    }
+    resp->numpmid = n;
+    if (stamp != NULL)
+	resp->timestamp = *stamp;	/* struct assignment */
+    put_result(resp);
+    memcpy(resp->vset, save, numpmid * sizeof(save[0]));
+    resp->numpmid = numpmid;
+    resp->timestamp = savestamp;	/* struct assignment */
+    free(save);
+}
+
+/*
+ * Log on change ... flag the value sets of resp that need to be logged,
+ * being those that differ from the previous fetch, or all of them when
+ * full is set or there is no usable previous fetch.
+ *
+ * Where a value set changed but was not logged with the previous fetch,
+ * the previous values are logged first, stamped with the time of the
+ * previous fetch (or the last record written, if later).  So the value
+ * is seen to hold steady up to the change, and interpolation over the
+ * archive returns the same values (and counter rates) as it would had
+ * every value been logged.
+ *
+ * Returns the number of value sets flagged for logging.
+ */
+static int
+log_changes(lastfetch_t *lfp, __pmResult *resp, int full, char **loggedp)
+{
+    __pmResult		*lrp = lfp->lf_resp;
+    __pmTimestamp	stamp;
+    char		*logged;
+    char		*before = NULL;
+    int			i, n, nbefore = 0;
+
+    if ((logged = (char *)malloc(resp->numpmid > 0 ? resp->numpmid : 1)) == NULL) {
+	pmNoMem("log_changes", resp->numpmid, PM_FATAL_ERR);
+	/*NOTREACHED*/
+    }
+    if (lrp == NULL || lfp->lf_logged == NULL || lrp->numpmid != resp->numpmid)
+	full = 1;
+    else if (heartbeat > 0 &&
+	     __pmTimestampSub(&resp->timestamp, &lfp->lf_full) >= heartbeat)
+	full = 1;
+
+    for (i = n = 0; i < resp->numpmid; i++) {
+	if (full || !same_valueset(resp->vset[i], lrp->vset[i])) {
+	    logged[i] = 1;
+	    n++;
+	    if (!full && !lfp->lf_logged[i]) {
+		/* changed since the last time logged, log the old value too */
+		lfp->lf_logged[i] = 2;
+		nbefore++;
+	    }
+	}
+	else
+	    logged[i] = 0;
+    }
+
+    if (nbefore > 0) {
+	before = lfp->lf_logged;
+	for (i = 0; i < resp->numpmid; i++)
+	    before[i] = (before[i] == 2);
+	stamp = lrp->timestamp;		/* struct assignment */
+	if (__pmTimestampSub(&last_stamp, &stamp) > 0)
+	    stamp = last_stamp;		/* struct assignment */
+	if (pmDebugOptions.appl2)
+	    pmNotifyErr(LOG_INFO, "callback: log on change: %d previous values", nbefore);
+	put_some_result(lrp, before, &stamp);
+	last_stamp = stamp;		/* struct assignment */
+    }
+
+    if (full)
+	lfp->lf_full = resp->timestamp;	/* struct assignment */
+    *loggedp = logged;
+    return n;
+}
+
 /*
  * do real work from callback ...
  */
@@ -592,19 +1027,20 @@ do_work(task_t *tp)
 {
     int			i;
     int			j;
-    int			k;
     int			sts;
     fetchctl_t		*fp;
     indomctl_t		*idp;
     __pmResult		*resp;
-    __pmPDU		*pb;
     AFctl_t		*acp;
     lastfetch_t		*lfp;
     lastfetch_t		*free_lfp;
+    char		*logged = NULL;
+    int			nlogged = 0;
     int			changed;
     int			needindom;
     int			needti;
-    static off_t	flushsize = 100000;
+    int			syncdue;
+    static off_t	flushsize = -1;
     long		old_meta_offset;
     long		label_offset;
     long		new_offset;
@@ -616,6 +1052,10 @@ do_work(task_t *tp)
     __uint64_t		max_offset;
     unsigned long	peek_offset;
 
+    if (flushsize < 0) {
+	init_write_policy();
+	flushsize = flushdelta;
+    }
     label_offset = __pmLogLabelSize(archctl.ac_log);
 
     if ((pmDebugOptions.appl2) && (pmDebugOptions.desperate))
@@ -653,6 +1093,10 @@ do_work(task_t *tp)
 		    __pmFreeResult(lfp->lf_resp);
 		    lfp->lf_resp = NULL;
 		}
+		if (lfp->lf_logged != NULL) {
+		    free(lfp->lf_logged);
+		    lfp->lf_logged = NULL;
+		}
 	    }
 	}
     }
@@ -709,6 +1153,8 @@ do_work(task_t *tp)
 	    continue;
 	}
 	pdu_payload = pduresultbytes(resp);
+	if (alignflag && (tp->t_delta.tv_sec != 0 || tp->t_delta.tv_usec != 0))
+	    align_skew(&tp->t_delta, &resp->timestamp);
 
 	if (pmDebugOptions.appl2)
 	    pmNotifyErr(LOG_INFO, "callback: fetch group %p (%d metrics, 0x%x change)", fp, fp->f_numpmid, changed);
@@ -762,14 +1208,19 @@ do_work(task_t *tp)
 	last_log_offset = __pmFtell(archctl.ac_mfp);
 	assert(last_log_offset >= 0);
 
+	if (tp->t_onchange) {
+	    /* everything is logged in the first result of each volume */
+	    nlogged = log_changes(lfp, resp,
+		    last_log_offset == 0 || last_log_offset == label_offset,
+		    &logged);
+	    if (pmDebugOptions.appl2)
+		pmNotifyErr(LOG_INFO, "callback: log on change: %d of %d value sets", nlogged, resp->numpmid);
+	}
+
 	setavail(resp);
 
-	if (changed & PMCD_LABEL_CHANGE) {
-	    /*
-	     * Change to the context labels associated with logged host
-	     */
-	    putlabels(PM_LABEL_CONTEXT, PM_IN_NULL, &resp->timestamp);
-	}
+	if (changed & PMCD_LABEL_CHANGE)
+	    changedLabels(resp, changed, &resp->timestamp);
 
 	needti = 0;
 	old_meta_offset = __pmFtell(logctl.mdfp);
@@ -855,18 +1306,26 @@ do_work(task_t *tp)
 			fprintf(stderr, "numinst=%d => needindom %s\n", old.numinst, pmInDomStr(old.indom));
 		    }
 		}
+		else if (indom_checked_at(old.indom, &resp->timestamp)) {
+		    /*
+		     * Already refetched from pmcd for this pmResult (for
+		     * a previous metric with the same indom) and found to
+		     * be unchanged, for the same reasons as above don't
+		     * ask again.
+		     */
+		    needindom = 0;
+		    if (pmDebugOptions.logmeta && pmDebugOptions.desperate) {
+			fprintf(stderr, "indom %s already checked for this pmResult\n",
+			    pmInDomStr(old.indom));
+		    }
+		}
 		else {
 		    needindom = 0;
 		    /* Need to see if result's insts all exist
 		     * somewhere in the most recent hashed/cached indom.
-		     * Thus a potential numval^2 search.
-                     */
+		     */
 		    for (j = 0; j < vsp->numval; j++) {
-			for (k = 0; k < old.numinst; k++) {
-			    if (vsp->vlist[j].inst == old.instlist[k])
-				break;
-			}
-			if (k == old.numinst) {
+			if (!inst_in_indom(vsp->vlist[j].inst, &old)) {
 			    needindom = 1;
 			    if (pmDebugOptions.logmeta && pmDebugOptions.desperate) {
 				fprintf(stderr, "inst %d in pmResult, not in cached indom => needindom %s\n",
@@ -986,6 +1445,7 @@ do_work(task_t *tp)
 		    else {
 			free(new.instlist);
 			free(new.namelist);
+			set_indom_checked(desc.indom, &resp->timestamp);
 		    }
 		}
 	    }
@@ -1017,25 +1477,46 @@ do_work(task_t *tp)
 	    }
 	}
 
-	if ((sts = __pmEncodeResult(&logctl, resp, &pb)) < 0) {
-	    fprintf(stderr, "__pmEncodeResult: %s\n", pmErrStr(sts));
-	    exit(1);
+	syncdue = sync_due();
+
+	if (tp->t_onchange && nlogged == 0) {
+	    /* nothing has changed, nothing to be written */
+	    if (syncdue)
+		sync_archive();
+	    goto next;
 	}
-	if (archive_version >= PM_LOG_VERS03) {
-	    if ((sts = __pmLogPutResult3(&archctl, pb)) < 0) {
-		fprintf(stderr, "__pmLogPutResult3: (encode) %s\n", pmErrStr(sts));
-		exit(1);
-	    }
-	} else {
-	    if ((sts = __pmLogPutResult2(&archctl, pb)) < 0) {
-		fprintf(stderr, "__pmLogPutResult2: (encode) %s\n", pmErrStr(sts));
-		exit(1);
+
+	if (!needti && index_due(&resp->timestamp)) {
+	    needti = 1;
+	    if (pmDebugOptions.appl2)
+		pmNotifyErr(LOG_INFO, "callback: temporal index entry due after %d results", last_ti_recs);
+	}
+
+	if (compress_method != NULL) {
+	    /*
+	     * Compressed data volume ... the temporal index entry (if
+	     * any) for this result has to mark the start of a new frame,
+	     * so the flushsize check is done before the result is
+	     * written, and flushing ends the current frame.  A pending
+	     * sync also starts a new frame, so the synced data volume
+	     * ends on a frame boundary.
+	     */
+	    if (last_log_offset > flushsize || syncdue) {
+		needti = 1;
+		if (pmDebugOptions.appl2)
+		    pmNotifyErr(LOG_INFO, "callback: file size (%d) reached flushsize (%ld)", (int)last_log_offset, (long)flushsize);
 	    }
+	    if (needti)
+		__pmFflush(archctl.ac_mfp);
 	}
-	__pmUnpinPDUBuf(pb);
+
+	if (tp->t_onchange && nlogged < resp->numpmid)
+	    put_some_result(resp, logged, NULL);
+	else
+	    put_result(resp);
 	__pmOverrideLastFd(__pmFileno(archctl.ac_mfp));
 
-	if (__pmFtell(archctl.ac_mfp) > flushsize) {
+	if (compress_method == NULL && __pmFtell(archctl.ac_mfp) > flushsize) {
 	    needti = 1;
 	    if (pmDebugOptions.appl2)
 		pmNotifyErr(LOG_INFO, "callback: file size (%d) reached flushsize (%ld)", (int)__pmFtell(archctl.ac_mfp), (long)flushsize);
@@ -1059,11 +1540,18 @@ do_work(task_t *tp)
 	     */
 	    __pmFseek(archctl.ac_mfp, new_offset, SEEK_SET);
 	    __pmFseek(logctl.mdfp, new_meta_offset, SEEK_SET);
-	    flushsize = __pmFtell(archctl.ac_mfp) + 100000;
+	    flushsize = __pmFtell(archctl.ac_mfp) + flushdelta;
+	    last_ti_recs = 0;
+	    last_ti_stamp = resp->timestamp;	/* struct assignment */
 	}
+	last_ti_recs++;
+
+	if (syncdue)
+	    sync_archive();
 
 	last_stamp = resp->timestamp;	/* struct assignment */
 
+next:
 	if (lfp->lf_resp != NULL) {
 	    /*
 	     * release memory that is allocated in pmDecodeResult
@@ -1071,6 +1559,10 @@ do_work(task_t *tp)
 	    __pmFreeResult(lfp->lf_resp);
 	}
 	lfp->lf_resp = resp;
+	if (lfp->lf_logged != NULL)
+	    free(lfp->lf_logged);
+	lfp->lf_logged = logged;
+	logged = NULL;
     }
 
     if (rflag && tp->t_size == 0 && pdu_metrics > 0) {
@@ -1148,6 +1640,43 @@ do_work(task_t *tp)
     }
 }
 
+/*
+ * Log on change ... before a <mark> record or the end of the archive,
+ * log the most recently fetched values of value sets that were not
+ * logged at the time, so replay sees them hold steady up to that point,
+ * and arrange for every value to be logged with the next fetch.
+ */
+void
+putpending(void)
+{
+    AFctl_t		*acp;
+    lastfetch_t		*lfp;
+    __pmTimestamp	stamp;
+    int			i, n;
+
+    for (acp = achead; acp != (AFctl_t *)0; acp = acp->ac_next) {
+	for (lfp = acp->ac_fetch; lfp != (lastfetch_t *)0; lfp = lfp->lf_next) {
+	    if (lfp->lf_logged == NULL)
+		continue;
+	    if (lfp->lf_resp != NULL) {
+		for (i = n = 0; i < lfp->lf_resp->numpmid; i++) {
+		    lfp->lf_logged[i] = !lfp->lf_logged[i];
+		    n += lfp->lf_logged[i];
+		}
+		if (n > 0) {
+		    stamp = lfp->lf_resp->timestamp;	/* struct assignment */
+		    if (__pmTimestampSub(&last_stamp, &stamp) > 0)
+			stamp = last_stamp;		/* struct assignment */
+		    put_some_result(lfp->lf_resp, lfp->lf_logged, &stamp);
+		    last_stamp = stamp;			/* struct assignment */
+		}
+	    }
+	    free(lfp->lf_logged);
+	    lfp->lf_logged = NULL;
+	}
+    }
+}
+
 int
 putmark(void)
 {
@@ -1157,5 +1686,7 @@ putmark(void)
 	/* no earlier result, no point adding a mark record */
 	return 0;
 
+    putpending();
+
     return __pmLogWriteMark(&archctl, &last_stamp, &msec);
 }
@@ -726,6 +726,7 @@ find_task(int state, struct timeval *arg_delta)
 
     for (tp = tasklist; tp != NULL; tp = tp->t_next) {
 	if (state == (tp->t_state & 0x3) &&  /* MAND|ON */
+	    !tp->t_onchange &&
 	    arg_delta->tv_sec == tp->t_delta.tv_sec &&
 	    arg_delta->tv_usec == tp->t_delta.tv_usec)
 	    break;
@@ -1076,8 +1077,15 @@ do_control_req(__pmResult *request, int control, int state, int arg_delta, int s
 		/* use only the MAND/ADV and ON/OFF bits of reqstate */
 		newtp->t_state = PMLC_GET_STATE(reqstate);
 		if (PMLC_GET_ON(reqstate)) {
+		    struct timeval	start;
+
 		    newtp->t_delta = tdelta;
-		    newtp->t_afid = __pmAFsetup(NULL, &tdelta, (void *)newtp, log_callback);
+		    if (alignflag) {
+			align_start(&tdelta, &start);
+			newtp->t_afid = __pmAFsetup(&start, &tdelta, (void *)newtp, log_callback);
+		    }
+		    else
+			newtp->t_afid = __pmAFsetup(NULL, &tdelta, (void *)newtp, log_callback);
 		}
 		else
 		    newtp->t_delta.tv_sec = newtp->t_delta.tv_usec = 0;
@@ -0,0 +1,522 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/*
+ * Farm mode (-F) ... one pmlogger process is started for a farm file
+ * listing many hosts, one line of pmlogger arguments per host.  This
+ * process reads and expands (pmcpp) each distinct configuration file
+ * once, optionally loads the -n namespace once, and then forks one
+ * logger per line that continues on through main() with the line's
+ * arguments.  Members share everything set up before the fork with
+ * the farm process copy-on-write, and avoid a fork-and-exec of pmcpp
+ * each.  The farm process then supervises its members: restarting
+ * any that exit, and forwarding SIGHUP (volume switch) and SIGUSR2
+ * (archive switch) to all of them.
+ */
+
+#include "logger.h"
+#include <sys/stat.h>
+#ifndef IS_MINGW
+#include <sys/wait.h>
+#endif
+
+#define FARM_RESTART	60	/* minimum seconds between member starts */
+
+typedef struct {
+    char	*path;		/* configuration file, as resolved */
+    char	*expanded;	/* temporary file holding pmcpp output */
+} shared_t;
+
+typedef struct {
+    int		line;		/* in the farm file, for diagnostics */
+    int		argc;		/* arguments for this member */
+    char	**argv;
+    char	*logfile;	/* default -l, if the line has none */
+    int		config;		/* index of expanded configuration */
+    pid_t	pid;		/* running member, else zero */
+    time_t	start;		/* time of the latest (re)start */
+} member_t;
+
+int		farm_member;		/* set in processes started by a farm */
+char		*farm_config;		/* pmcpp output for this member */
+char		*farm_pmnsfile;		/* namespace loaded before the fork */
+
+static shared_t	*shared;
+static int	nshared;
+static char	pidpath[MAXPATHLEN];
+static member_t	*members;
+static int	nmembers;
+
+static volatile sig_atomic_t	farm_quit;
+static volatile sig_atomic_t	farm_hup;
+static volatile sig_atomic_t	farm_usr2;
+
+/* is argv[i] the -F option, and if so how many arguments does it use */
+static int
+farm_option(char **argv, int i)
+{
+    if (strcmp(argv[i], "-F") == 0 || strcmp(argv[i], "--farm") == 0)
+	return argv[i+1] ? 2 : 1;
+    if (strncmp(argv[i], "-F", 2) == 0 || strncmp(argv[i], "--farm=", 7) == 0)
+	return 1;
+    return 0;
+}
+
+#ifndef IS_MINGW
+static void
+farm_signal(int sig)
+{
+    if (sig == SIGHUP)
+	farm_hup = 1;
+    else if (sig == SIGUSR2)
+	farm_usr2 = 1;
+    else
+	farm_quit = sig;
+}
+
+static void
+farm_kill(int sig)
+{
+    int		i;
+
+    for (i = 0; i < nmembers; i++)
+	if (members[i].pid > 0)
+	    kill(members[i].pid, sig);
+}
+
+/* atexit handler, inherited by members where it must do nothing */
+static void
+farm_cleanup(void)
+{
+    int		i;
+
+    if (farm_member)
+	return;
+    for (i = 0; i < nshared; i++)
+	unlink(shared[i].expanded);
+    if (pidpath[0] != '\0')
+	unlink(pidpath);
+}
+
+/*
+ * Run the configuration through pmcpp once, for all members using it.
+ */
+static int
+farm_expand(char *path)
+{
+    shared_t	*sp;
+    FILE	*pipef, *fp;
+    char	tmp[MAXPATHLEN];
+    char	buf[BUFSIZ];
+    size_t	bytes;
+    int		i, fd, sts;
+
+    for (i = 0; i < nshared; i++)
+	if (strcmp(shared[i].path, path) == 0)
+	    return i;
+
+    if ((sp = realloc(shared, (nshared+1) * sizeof(shared_t))) == NULL) {
+	pmNoMem("farm_expand", (nshared+1) * sizeof(shared_t), PM_FATAL_ERR);
+	/* NOTREACHED */
+    }
+    shared = sp;
+    sp = &shared[nshared];
+
+    pmsprintf(tmp, sizeof(tmp), "%s%cpmlogger_farmXXXXXX",
+		pmGetConfig("PCP_TMPFILE_DIR"), pmPathSeparator());
+    if ((fd = mkstemp(tmp)) < 0 || (fp = fdopen(fd, "w")) == NULL) {
+	fprintf(stderr, "%s: cannot create temporary file \"%s\": %s\n",
+		pmGetProgname(), tmp, osstrerror());
+	exit(1);
+    }
+    pipef = do_pmcpp(path);
+    while ((bytes = fread(buf, 1, sizeof(buf), pipef)) > 0)
+	fwrite(buf, 1, bytes, fp);
+    if ((sts = __pmProcessPipeClose(pipef)) != 0 || fclose(fp) != 0) {
+	fprintf(stderr, "%s: preprocessing \"%s\" failed\n",
+		pmGetProgname(), path);
+	unlink(tmp);
+	exit(1);
+    }
+    sp->path = path;
+    if ((sp->expanded = strdup(tmp)) == NULL) {
+	pmNoMem("farm_expand", strlen(tmp)+1, PM_FATAL_ERR);
+	/* NOTREACHED */
+    }
+    return nshared++;
+}
+
+/*
+ * Split one farm file line into arguments for a member, check them,
+ * and note the configuration file it uses.
+ */
+static void
+farm_member_args(pmOptions *opts, int line, char *buf, char *argv0,
+		int common_argc, char **common_argv, char *common_config)
+{
+    pmOptions	scan;
+    member_t	*mp;
+    char	**argv, *p, *config = common_config;
+    char	*archive, *dir, *last = NULL;
+    int		argc, c, i, logged = 0, errors = 0;
+    size_t	size;
+
+    /* room for argv0 and every whitespace separated word of the line */
+    size = (strlen(buf) / 2 + 2) * sizeof(char *);
+    if ((argv = (char **)calloc(1, size)) == NULL) {
+	pmNoMem("farm_member_args", size, PM_FATAL_ERR);
+	/* NOTREACHED */
+    }
+    argv[0] = argv0;
+    for (argc = 1, p = strtok_r(buf, " \t\n", &last); p != NULL;
+	 p = strtok_r(NULL, " \t\n", &last)) {
+	if ((argv[argc++] = strdup(p)) == NULL) {
+	    pmNoMem("farm_member_args", strlen(p)+1, PM_FATAL_ERR);
+	    /* NOTREACHED */
+	}
+    }
+    if (argc == 1 || argv[1][0] == '#') {
+	for (i = 1; i < argc; i++)
+	    free(argv[i]);
+	free(argv);
+	return;		/* blank or comment line */
+    }
+
+    memset(&scan, 0, sizeof(scan));
+    scan.short_options = opts->short_options;
+    scan.long_options = opts->long_options;
+    scan.flags = PM_OPTFLAG_QUIET;
+    while ((c = pmgetopt_r(argc, argv, &scan)) != EOF) {
+	switch (c) {
+	case 'c':
+	    config = scan.optarg;
+	    break;
+	case 'l':
+	    logged = 1;
+	    break;
+	case 'C':
+	case 'F':
+	case 'P':
+	case 'x':
+	    fprintf(stderr, "%s: line %d: -%c cannot be used for a farm member\n",
+			pmGetProgname(), line, c);
+	    errors++;
+	    break;
+	case '?':
+	    fprintf(stderr, "%s: line %d: unrecognised option\n",
+			pmGetProgname(), line);
+	    errors++;
+	    break;
+	}
+    }
+    if (scan.optind != argc - 1) {
+	fprintf(stderr, "%s: line %d: expecting options then one archive name\n",
+		pmGetProgname(), line);
+	errors++;
+    }
+    if (config == NULL) {
+	fprintf(stderr, "%s: line %d: no configuration file, use -c\n",
+		pmGetProgname(), line);
+	errors++;
+    }
+    if (errors)
+	exit(1);
+
+    if ((mp = realloc(members, (nmembers+1) * sizeof(member_t))) == NULL) {
+	pmNoMem("farm_member_args", (nmembers+1) * sizeof(member_t), PM_FATAL_ERR);
+	/* NOTREACHED */
+    }
+    members = mp;
+    mp = &members[nmembers++];
+    memset(mp, 0, sizeof(*mp));
+    mp->line = line;
+    mp->config = farm_expand(findconfig(config));
+
+    /* default member log is pmlogger.log in the archive directory */
+    archive = argv[argc-1];
+    if (!logged) {
+	size = strlen(archive) + strlen("pmlogger.log") + 2;
+	if ((dir = strdup(archive)) == NULL ||
+	    (mp->logfile = malloc(size)) == NULL) {
+	    pmNoMem("farm_member_args", size, PM_FATAL_ERR);
+	    /* NOTREACHED */
+	}
+	pmsprintf(mp->logfile, size, "%s%cpmlogger.log",
+		dirname(dir), pmPathSeparator());
+	free(dir);
+    }
+
+    /* common arguments first, so the line can override them */
+    size = (common_argc + argc + 3) * sizeof(char *);
+    if ((mp->argv = (char **)calloc(1, size)) == NULL) {
+	pmNoMem("farm_member_args", size, PM_FATAL_ERR);
+	/* NOTREACHED */
+    }
+    mp->argv[mp->argc++] = argv0;
+    for (i = 1; i < common_argc; i++)
+	mp->argv[mp->argc++] = common_argv[i];
+    if (mp->logfile) {
+	mp->argv[mp->argc++] = "-l";
+	mp->argv[mp->argc++] = mp->logfile;
+    }
+    for (i = 1; i < argc; i++)
+	mp->argv[mp->argc++] = argv[i];
+    free(argv);
+}
+
+/*
+ * Start (or restart) a member.  Returns zero in the new member
+ * process, else one in the farm process.
+ */
+static int
+farm_fork(member_t *mp)
+{
+    pid_t	pid;
+
+    time(&mp->start);
+    fflush(NULL);
+    if ((pid = fork()) < 0) {
+	pmNotifyErr(LOG_ERR, "farm: fork for line %d failed: %s",
+			mp->line, osstrerror());
+	return 1;
+    }
+    if (pid == 0)
+	return 0;
+    mp->pid = pid;
+    pmNotifyErr(LOG_INFO, "farm: started pmlogger PID %" FMT_PID " for line %d (%s)",
+			pid, mp->line, mp->argv[mp->argc-1]);
+    return 1;
+}
+
+static void
+farm_reaped(pid_t pid, int status)
+{
+    char	buf[64];
+    int		i;
+
+    for (i = 0; i < nmembers; i++) {
+	if (members[i].pid != pid)
+	    continue;
+	members[i].pid = 0;
+	if (WIFEXITED(status))
+	    pmsprintf(buf, sizeof(buf), "exit status %d", WEXITSTATUS(status));
+	else if (WIFSIGNALED(status))
+	    pmsprintf(buf, sizeof(buf), "signal %d", WTERMSIG(status));
+	else
+	    pmsprintf(buf, sizeof(buf), "status 0x%x", status);
+	if (!farm_quit)
+	    pmNotifyErr(LOG_WARNING, "farm: pmlogger PID %" FMT_PID
+			" for line %d ended with %s, restart in %d seconds",
+			pid, members[i].line, buf,
+			(int)(members[i].start + FARM_RESTART - time(NULL)));
+	break;
+    }
+}
+#endif
+
+/*
+ * Called early in main(), before any other argument processing.
+ * Returns immediately when -F is not used, never returns in the farm
+ * process, and returns in each member with the member's arguments.
+ */
+void
+farm_start(int *argcp, char ***argvp, pmOptions *opts)
+{
+    pmOptions	scan;
+    FILE	*fp;
+    char	**argv = *argvp, **common;
+    char	*farmfile = NULL, *config = NULL, *logfile = "pmlogger.log";
+    char	*pmnsfile = NULL, *username = NULL;
+    char	buf[4*MAXPATHLEN];
+    int		argc = *argcp, c, i, n, line, sts, isdaemon = 0;
+#ifndef IS_MINGW
+    struct sigaction	sa;
+    pid_t	pid;
+    time_t	now;
+#endif
+
+    for (i = 1; i < argc && strcmp(argv[i], "--") != 0; i++)
+	if (farm_option(argv, i))
+	    break;
+    if (i == argc || strcmp(argv[i], "--") == 0)
+	return;
+
+    memset(&scan, 0, sizeof(scan));
+    scan.short_options = opts->short_options;
+    scan.long_options = opts->long_options;
+    scan.flags = PM_OPTFLAG_QUIET;
+    while ((c = pmgetopt_r(argc, argv, &scan)) != EOF) {
+	switch (c) {
+	case 'F':
+	    farmfile = scan.optarg;
+	    break;
+	case 'c':
+	    config = scan.optarg;
+	    break;
+	case 'l':
+	    logfile = scan.optarg;
+	    break;
+	case 'm':
+	    isdaemon = ((strncmp(scan.optarg, "pmlogger_check", 14) == 0) ||
+			(strncmp(scan.optarg, "pmlogger_daily", 14) == 0));
+	    break;
+	case 'n':
+	    pmnsfile = scan.optarg;
+	    break;
+	case 'U':
+	    username = scan.optarg;
+	    isdaemon = 1;
+	    break;
+	case 'C':
+	case 'P':
+	case 'x':
+	    fprintf(stderr, "%s: -%c and -F are mutually exclusive\n",
+			pmGetProgname(), c);
+	    exit(1);
+	}
+    }
+    if (farmfile == NULL)
+	return;		/* -F was the argument of some other option */
+    if (scan.optind != argc) {
+	fprintf(stderr, "%s: no archive argument with -F, use the farm file\n",
+		pmGetProgname());
+	exit(1);
+    }
+
+#ifdef IS_MINGW
+    fprintf(stderr, "%s: -F is not supported on this platform\n",
+		pmGetProgname());
+    exit(1);
+#else
+    /* common arguments, less -F */
+    if ((common = (char **)calloc(argc + 1, sizeof(char *))) == NULL) {
+	pmNoMem("farm_start", (argc + 1) * sizeof(char *), PM_FATAL_ERR);
+	/* NOTREACHED */
+    }
+    for (i = n = 0; i < argc; i++) {
+	if (i > 0 && (c = farm_option(argv, i)) > 0)
+	    i += c - 1;
+	else
+	    common[n++] = argv[i];
+    }
+
+    if ((fp = fopen(farmfile, "r")) == NULL) {
+	fprintf(stderr, "%s: Cannot open farm file \"%s\": %s\n",
+		pmGetProgname(), farmfile, osstrerror());
+	exit(1);
+    }
+    for (line = 1; fgets(buf, sizeof(buf), fp) != NULL; line++)
+	farm_member_args(opts, line, buf, argv[0], n, common, config);
+    fclose(fp);
+    if (nmembers == 0) {
+	fprintf(stderr, "%s: no hosts in farm file \"%s\"\n",
+		pmGetProgname(), farmfile);
+	exit(1);
+    }
+
+    if (pmnsfile != NULL) {
+	if ((sts = pmLoadASCIINameSpace(pmnsfile, 1)) < 0) {
+	    fprintf(stderr, "%s: Cannot load namespace from \"%s\": %s\n",
+			pmGetProgname(), pmnsfile, pmErrStr(sts));
+	    exit(1);
+	}
+	farm_pmnsfile = pmnsfile;
+    }
+
+    if (username == NULL)
+	pmGetUsername(&username);
+    if (isdaemon)
+	pmSetProcessIdentity(username);
+    pmOpenLog("pmlogger", logfile, stderr, &sts);
+    if (sts != 1)
+	fprintf(stderr, "%s: Warning: log file (%s) creation failed\n",
+		pmGetProgname(), logfile);
+    pmNotifyErr(LOG_INFO, "farm: Start, %d hosts from %s, %d configurations",
+		nmembers, farmfile, nshared);
+    /*
+     * Not __pmServerCreatePIDFile(), as members would inherit its
+     * atexit handler and remove the farm PID file as they exit.
+     */
+    atexit(farm_cleanup);
+    if (isdaemon) {
+	setpgid(getpid(), 0);
+	pmsprintf(pidpath, sizeof(pidpath), "%s%cpmlogger_farm.pid",
+		pmGetConfig("PCP_RUN_DIR"), pmPathSeparator());
+	if ((fp = fopen(pidpath, "w")) != NULL) {
+	    fprintf(fp, "%" FMT_PID, getpid());
+	    fclose(fp);
+	} else {
+	    fprintf(stderr, "%s: Warning: cannot create PID file %s: %s\n",
+			pmGetProgname(), pidpath, osstrerror());
+	    pidpath[0] = '\0';
+	}
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = farm_signal;
+    sigaction(SIGHUP, &sa, NULL);
+    sigaction(SIGUSR2, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    pmsprintf(buf, sizeof(buf), "%" FMT_PID, getpid());
+    for ( ; ; ) {
+	while ((pid = waitpid(-1, &sts, WNOHANG)) > 0)
+	    farm_reaped(pid, sts);
+	if (farm_quit)
+	    break;
+	if (farm_hup) {
+	    farm_hup = 0;
+	    farm_kill(SIGHUP);
+	}
+	if (farm_usr2) {
+	    farm_usr2 = 0;
+	    farm_kill(SIGUSR2);
+	}
+	time(&now);
+	for (i = 0; i < nmembers; i++) {
+	    member_t	*mp = &members[i];
+
+	    if (mp->pid != 0 || (mp->start && now < mp->start + FARM_RESTART))
+		continue;
+	    if (farm_fork(mp) != 0)
+		continue;
+
+	    /* new member process, continue on in main() */
+	    memset(&sa, 0, sizeof(sa));
+	    sa.sa_handler = SIG_DFL;
+	    sigaction(SIGHUP, &sa, NULL);
+	    sigaction(SIGUSR2, &sa, NULL);
+	    sigaction(SIGINT, &sa, NULL);
+	    sigaction(SIGTERM, &sa, NULL);
+	    setenv("PMLOGGER_FARM", buf, 1);
+	    farm_member = 1;
+	    farm_config = shared[mp->config].expanded;
+	    *argcp = mp->argc;
+	    *argvp = mp->argv;
+	    return;
+	}
+	sleep(1);
+    }
+
+    pmNotifyErr(LOG_INFO, "farm: caught signal %d, stopping %d hosts",
+		(int)farm_quit, nmembers);
+    farm_kill(SIGTERM);
+    while ((pid = wait(&sts)) > 0 || (pid < 0 && oserror() == EINTR))
+	if (pid > 0)
+	    farm_reaped(pid, sts);
+    pmNotifyErr(LOG_INFO, "farm: End");
+    exit(0);
+#endif
+}
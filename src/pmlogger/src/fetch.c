@@ -126,8 +126,8 @@ myFetch(int numpmid, pmID pmidlist[], __pmResult **result)
 	    do {
 		n = __pmGetPDU(fd, ANY_SIZE, TIMEOUT_DEFAULT, &pb);
 		/*
-		 * expect PDU_[HIGHRES_]RESULT or
-		 *        PDU_ERROR(changed > 0)+PDU_[HIGHRES_]RESULT or
+		 * expect PDU_[HIGHRES_|COMPACT_]RESULT or
+		 *        PDU_ERROR(changed > 0)+PDU_[HIGHRES_|COMPACT_]RESULT or
 		 *        PDU_ERROR(real error < 0 from PMCD) or
 		 *        0 (end of file)
 		 *        < 0 (local error or IPC problem)
@@ -152,6 +152,12 @@ myFetch(int numpmid, pmID pmidlist[], __pmResult **result)
 			    if (flag++)
 				fprintf(stderr, ", ");
 			    fprintf(stderr, "label change");
+			    if (sts & PMCD_CONTEXT_LABEL_CHANGE) fprintf(stderr, " context");
+			    if (sts & PMCD_DOMAIN_LABEL_CHANGE) fprintf(stderr, " domain");
+			    if (sts & PMCD_INDOM_LABEL_CHANGE) fprintf(stderr, " indom");
+			    if (sts & PMCD_CLUSTER_LABEL_CHANGE) fprintf(stderr, " cluster");
+			    if (sts & PMCD_ITEM_LABEL_CHANGE) fprintf(stderr, " item");
+			    if (sts & PMCD_INSTANCES_LABEL_CHANGE) fprintf(stderr, " instances");
 			}
 			if (sts & PMCD_NAMES_CHANGE) {
 			    if (flag++)
@@ -162,6 +168,8 @@ myFetch(int numpmid, pmID pmidlist[], __pmResult **result)
 		    }
 		    else if (n == PDU_HIGHRES_RESULT && !highres)
 			fprintf(stderr, "__pmGetPDU: bad PDU_HIGHRES_RESULT\n");
+		    else if (n == PDU_COMPACT_RESULT && !highres)
+			fprintf(stderr, "__pmGetPDU: bad PDU_COMPACT_RESULT\n");
 		    else if (n == PDU_RESULT && highres)
 			fprintf(stderr, "__pmGetPDU: bad PDU_RESULT\n");
 		    else
@@ -169,12 +177,16 @@ myFetch(int numpmid, pmID pmidlist[], __pmResult **result)
 		}
 
 		if ((n == PDU_HIGHRES_RESULT && highres) ||
+		    (n == PDU_COMPACT_RESULT && highres) ||
 		    (n == PDU_RESULT && !highres)) {
 		    /* Success with a result in a PDU buffer */
 		    PM_LOCK(ctxp->c_lock);
-		    sts = (n == PDU_RESULT) ?
-			    __pmDecodeResult_ctx(ctxp, pb, result) :
-			    __pmDecodeHighResResult_ctx(ctxp, pb, result);
+		    if (n == PDU_RESULT)
+			sts = __pmDecodeResult_ctx(ctxp, pb, result);
+		    else if (n == PDU_COMPACT_RESULT)
+			sts = __pmDecodeCompactResult_ctx(ctxp, pb, result);
+		    else
+			sts = __pmDecodeHighResResult_ctx(ctxp, pb, result);
 		    __pmUnpinPDUBuf(pb);
 		    if (sts < 0)
 			n = sts;
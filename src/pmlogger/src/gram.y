@@ -44,6 +44,7 @@ static int	numinst;
 static int	*intlist;
 static char	**extlist;
 static int	state;			/* logging state, current block */
+static int	onchange;		/* log on change, current block */
 static char	*metricName;		/* current metric, current block */
 
 typedef struct _hl {
@@ -63,7 +64,7 @@ static int		allow;		/* host allow/disallow state */
 static int lookup_metric_name(const char *);
 static void activate_new_metric(const char *);
 static void activate_cached_metric(const char *, int);
-static task_t *findtask(int, struct timeval *);
+static task_t *findtask(int, int, struct timeval *);
 static void append_dynroot_list(const char *, int, int, struct timeval *);
 
 %}
@@ -85,7 +86,7 @@ static void append_dynroot_list(const char *, int, int, struct timeval *);
 	LOG
 	MANDATORY ADVISORY
 	ON OFF MAYBE
-	EVERY ONCE DEFAULT
+	EVERY ONCE DEFAULT CHANGE
 	MSEC SECOND MINUTE HOUR
 
 	ACCESS ENQUIRE ALLOW DISALLOW ALL EXCEPT
@@ -128,7 +129,7 @@ dowhat		: logopt action
 		     * Search for an existing task for this state/interval;
 		     * only allocate and setup a new task if none exists.
 		     */
-		    if ((tp = findtask(state, &ldelta)) == NULL) {
+		    if ((tp = findtask(state, onchange, &ldelta)) == NULL) {
 			if ((tp = (task_t *)calloc(1, sizeof(task_t))) == NULL) {
 			    char emess[256];
 			    pmsprintf(emess, sizeof(emess), "malloc failed: %s", osstrerror());
@@ -154,9 +155,11 @@ dowhat		: logopt action
 			    tp->t_next = NULL;
 			    tp->t_delta = ldelta;
 			    tp->t_state = state;
+			    tp->t_onchange = onchange;
 			}
 		    }
 		    state = 0;
+		    onchange = 0;
 		}
 		;
 
@@ -164,23 +167,23 @@ logopt		: LOG
 		| /* nothing */
 		;
 
-action		: cntrl ON frequency	
+action		: cntrl ON changeopt frequency	
 		{ 
 		    char emess[256];
-                    if ($3 < 0) {
+                    if ($4 < 0) {
 			pmsprintf(emess, sizeof(emess),
-				"Logging delta (%ld msec) must be positive",$3);
+				"Logging delta (%ld msec) must be positive",$4);
 			yyerror(emess);
 		    }
-		    else if ($3 >  PMLC_MAX_DELTA) {
+		    else if ($4 >  PMLC_MAX_DELTA) {
 			pmsprintf(emess, sizeof(emess),
 				"Logging delta (%ld msec) cannot be bigger "
-				"than %d msec", $3, PMLC_MAX_DELTA);
+				"than %d msec", $4, PMLC_MAX_DELTA);
 			yyerror(emess);
 		    }
 
                     PMLC_SET_ON(state, 1); 
-                    $$ = $3;
+                    $$ = $4;
                 }
 		| cntrl OFF			{ PMLC_SET_ON(state, 0);$$ = 0;}
 		| MANDATORY MAYBE
@@ -210,6 +213,10 @@ everyopt	: EVERY
 		| /* nothing */
 		;
 
+changeopt	: CHANGE			{ onchange = 1; }
+		| /* nothing */			{ onchange = 0; }
+		;
+
 timeunits	: MSEC		{ $$ = 1; }
 		| SECOND	{ $$ = 1000; }
 		| MINUTE	{ $$ = 60000; }
@@ -616,12 +623,13 @@ activate_new_metric(const char *name)
  * or NULL if none exists for that value pair.
  */
 task_t *
-findtask(int arg_state, struct timeval *arg_delta)
+findtask(int arg_state, int arg_onchange, struct timeval *arg_delta)
 {
     task_t	*ltp;
 
     for (ltp = tasklist; ltp != NULL; ltp = ltp->t_next) {
 	if (arg_state == ltp->t_state &&
+	    arg_onchange == ltp->t_onchange &&
 	    arg_delta->tv_sec == ltp->t_delta.tv_sec &&
 	    arg_delta->tv_usec == ltp->t_delta.tv_usec)
 	    break;
@@ -703,7 +711,11 @@ yyend(void)
 	     * log as soon as possible and then every t_delta units of
 	     * time thereafter
 	     */
-	    tp->t_afid = __pmAFsetup(&blink, &tp->t_delta, (void *)tp, log_callback);
+	    struct timeval	start = blink;
+
+	    if (alignflag)
+		align_start(&tp->t_delta, &start);
+	    tp->t_afid = __pmAFsetup(&start, &tp->t_delta, (void *)tp, log_callback);
 	}
     }
 }
@@ -47,6 +47,7 @@ typedef struct task_s {
     int			t_alarm;	/* set when log_callback() called for this task */
     int			t_size;		/* pdu size for -r flag reporting */
     int			t_dm;		/* 1 if derived metrics included */
+    int			t_onchange;	/* 1 to log values only on change */
 } task_t;
 
 extern task_t		*tasklist;	/* main list of tasks */
@@ -154,6 +155,7 @@ extern int reconnect(void);
 extern int do_prologue(void);
 extern int do_epilogue(void);
 extern void run_done(int,char *);
+extern void putpending(void);
 extern int putmark(void);
 extern void dumpit(void);
 
@@ -169,6 +171,7 @@ extern char		*pmcd_host;		/* collecting from PMCD on this host */
 extern char		*pmcd_host_conn;	/* ... and this is how we connected to it */
 extern int		primary;		/* Non-zero for primary logger */
 extern int		rflag;
+extern char		*compress_method;	/* NULL or compression for data volumes */
 extern struct timeval	delta;			/* default logging interval */
 extern int		ctlport;		/* pmlogger control port number */
 extern char		*note;			/* note for port map file */
@@ -209,6 +212,26 @@ extern int do_events(pmValueSet *);
 /* cleanup control fds and sockets etc prior to reexec or exit */
 extern void cleanup(void);
 
+/* configuration file handling, shared with farm mode */
+extern char *findconfig(const char *);
+extern FILE *do_pmcpp(char *);
+
+/* farm mode, see -F */
+extern void farm_start(int *, char ***, pmOptions *);
+extern int	farm_member;
+extern char	*farm_config;
+extern char	*farm_pmnsfile;
+
+/* sample alignment, see -A */
+extern int	alignflag;
+extern void align_start(const struct timeval *, struct timeval *);
+extern void align_skew(const struct timeval *, const __pmTimestamp *);
+extern void align_report(void);
+
+/* push mode, see -R */
+extern int push_setup(const char *);
+extern void push_done(void);
+
 /* QA testing and error injection support ... see do_request() */
 extern int	qa_case;
 #define QA_OFF		100
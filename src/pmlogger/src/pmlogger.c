@@ -64,6 +64,9 @@ int		notify_service_mgr = 0;	/* notify service manager when we're ready (daemon
 int		pmlogger_reexec = 0;	/* set when PMLOGGER_REEXEC is set in the environment */
 int		pmlc_ipc_version = LOG_PDU_VERSION;
 int		rflag;			/* report sizes */
+int		alignflag;		/* align fetches across hosts, see -A */
+char		*compress_method;	/* compression for data volumes, see -X */
+static int	meta_index;		/* write metadata index at the end, see -M */
 int		Cflag;			/* parse config and exit */
 __pmTimestamp	epoch;
 struct timeval	delta = { 60, 0 };	/* default logging interval */
@@ -99,6 +102,9 @@ run_done(int sts, char *msg)
 	fputc('\n', stderr);
     }
 
+    putpending();
+    align_report();
+
     if ((lsts = do_epilogue()) < 0)
 	fprintf(stderr, "Warning: problem writing archive epilogue: %s\n",
 	    pmErrStr(lsts));
@@ -127,6 +133,12 @@ run_done(int sts, char *msg)
     __pmFclose(archctl.ac_log->tifp);
     __pmFclose(archctl.ac_log->mdfp);
 
+    if (meta_index && (lsts = __pmLogWriteMetaIndex(archName)) < 0)
+	fprintf(stderr, "Warning: problem writing metadata index: %s\n",
+	    pmErrStr(lsts));
+
+    push_done();
+
     if (log_switch_flag) {
     	/*
 	 * re-exec using saved args, see save_args().
@@ -561,15 +573,19 @@ failed:
 
 static pmLongOptions longopts[] = {
     PMAPI_OPTIONS_HEADER("Options"),
+    { "align", 0, 'A', 0, "align fetches to whole multiples of the interval" },
     { "config", 1, 'c', "FILE", "file to load configuration from" },
     { "check", 0, 'C', 0, "parse configuration and exit" },
     PMOPT_DEBUG,
+    { "farm", 1, 'F', "FILE", "log many hosts, one line of arguments each in FILE" },
     PMOPT_HOST,
     { "labelhost", 1, 'H', "LABELHOST", "override the hostname written into the label" },
     { "pmlc-ipc-version", 1, 'I', "VERSION", "set IPC version for pmlc port [defaily LOG_PDU_VERSION]" },
+    { "checksum", 0, 'k', 0, "write block checksums for the data volumes" },
     { "log", 1, 'l', "FILE", "redirect diagnostics and trace output" },
     { "linger", 0, 'L', 0, "run even if not primary logger instance and nothing to log" },
     { "note", 1, 'm', "MSG", "descriptive note to be added to the port map file" },
+    { "meta-index", 0, 'M', 0, "write a metadata index when the archive is closed" },
     PMOPT_SPECLOCAL,
     { "local-PMDA", 0, 'o', 0, "metrics sourced without connecting to pmcd" },
     PMOPT_NAMESPACE,
@@ -577,7 +593,9 @@ static pmLongOptions longopts[] = {
     { "PID", 1, 'p', "PID", "Log specified metric for the lifetime of the pid" },
     { "primary", 0, 'P', 0, "execute as primary logger instance" },
     { "report", 0, 'r', 0, "report record sizes and archive growth rate" },
+    { "push", 1, 'R', "HOST", "stream archive records to pmproxy on HOST[:PORT]" },
     { "size", 1, 's', "SIZE", "terminate after endsize has been accumulated" },
+    { "space", 0, 'S', 0, "write per-metric space accounting for the data volumes" },
     { "interval", 1, 't', "DELTA", "default logging interval [default 60.0 seconds]" },
     PMOPT_FINISH,
     { "", 0, 'u', 0, "output is unbuffered [default now, so -u is a no-op]" },
@@ -585,18 +603,51 @@ static pmLongOptions longopts[] = {
     { "volsize", 1, 'v', "SIZE", "switch log volumes after size has been accumulated" },
     { "version", 1, 'V', "NUM", "version for archive (default and only version is 2)" },
     { "", 1, 'x', "FD", "control file descriptor for running from pmRecordControl(3)" },
+    { "compress", 1, 'X', "METHOD", "write compressed data volumes [default none]" },
     { "", 0, 'y', 0, "set timezone for times to local time rather than from PMCD host" },
     PMOPT_HELP,
     PMAPI_OPTIONS_END
 };
 
 static pmOptions opts = {
-    .short_options = "c:CD:fh:H:I:l:K:Lm:Nn:op:Prs:T:t:uU:v:V:x:y?",
+    .short_options = "Ac:CD:fF:h:H:I:kl:K:Lm:MNn:op:PrR:s:ST:t:uU:v:V:x:X:y?",
     .long_options = longopts,
     .short_usage = "[options] archive",
 };
 
-static FILE *
+/*
+ * Config file name, as given or else in the standard place
+ */
+char *
+findconfig(const char *name)
+{
+    char	*config;
+    char	*sysconf;
+    int		sz;
+
+    if (access(name, F_OK) == 0)
+	config = strdup(name);
+    else {
+	/* does not exist as given, try the standard place */
+	sysconf = pmGetConfig("PCP_VAR_DIR");
+	sz = strlen(sysconf)+strlen("/config/pmlogger/")+strlen(name)+1;
+	if ((config = (char *)malloc(sz)) == NULL)
+	    pmNoMem("config file name", sz, PM_FATAL_ERR);
+	pmsprintf(config, sz,
+		"%s%c" "config%c" "pmlogger%c" "%s",
+		sysconf, sep, sep, sep, name);
+	if (access(config, F_OK) != 0) {
+	    /* still no good, error handling happens below */
+	    free(config);
+	    config = strdup(name);
+	}
+    }
+    if (config == NULL)
+	pmNoMem("config file name", strlen(name)+1, PM_FATAL_ERR);
+    return config;
+}
+
+FILE *
 do_pmcpp(char *config)
 {
     FILE	*f;
@@ -949,9 +1000,14 @@ main(int argc, char **argv)
     __pmDumpStackInit((void *)&__executable_start);
 #endif
 
+    sep = pmPathSeparator();
+    /* no return for the farm process with -F, members continue here */
+    farm_start(&argc, &argv, &opts);
+    if (getenv("PMLOGGER_FARM") != NULL)
+	farm_member = 1;	/* including after re-exec */
+
     save_args(argc, argv);
     pmGetUsername(&username);
-    sep = pmPathSeparator();
     if ((endnum = getenv("PMLOGGER_INTERVAL")) != NULL)
 	delta.tv_sec = atoi(endnum);
     if ((endnum = pmGetOptionalConfig("PCP_ARCHIVE_VERSION")) != NULL)
@@ -962,30 +1018,21 @@ main(int argc, char **argv)
     while ((c = pmgetopt_r(argc, argv, &opts)) != EOF) {
 	switch (c) {
 
+	case 'A':		/* aligned sampling */
+	    alignflag = 1;
+	    break;
+
 	case 'c':		/* config file */
-	    if (access(opts.optarg, F_OK) == 0)
-		configfile = strdup(opts.optarg);
-	    else {
-		/* does not exist as given, try the standard place */
-		char *sysconf = pmGetConfig("PCP_VAR_DIR");
-		int sz = strlen(sysconf)+strlen("/config/pmlogger/")+strlen(opts.optarg)+1;
-		if ((configfile = (char *)malloc(sz)) == NULL)
-		    pmNoMem("config file name", sz, PM_FATAL_ERR);
-		pmsprintf(configfile, sz,
-			"%s%c" "config%c" "pmlogger%c" "%s",
-			sysconf, sep, sep, sep, opts.optarg);
-		if (access(configfile, F_OK) != 0) {
-		    /* still no good, error handling happens below */
-		    free(configfile);
-		    configfile = strdup(opts.optarg);
-		}
-	    }
+	    configfile = findconfig(opts.optarg);
 	    break;
 
 	case 'C':		/* parse config and exit */
 	    Cflag = 1;
 	    break;
 
+	case 'F':		/* farm file, see farm_start() */
+	    break;
+
 	case 'D':	/* debug flag */
 	    sts = pmSetDebug(opts.optarg);
 	    if (sts < 0) {
@@ -1016,6 +1063,10 @@ main(int argc, char **argv)
 	    }
 	    break;
 
+	case 'k':		/* checksums for data volumes */
+	    __pmLogSetChecksum(PM_LOG_CKSUM_BLOCKSIZE);
+	    break;
+
 	case 'l':		/* log file name */
 	    logfile = opts.optarg;
 	    break;
@@ -1039,6 +1090,10 @@ main(int argc, char **argv)
 			(strncmp(note, "reexec", 6) == 0));
 	    break;
 
+	case 'M':		/* metadata index when the archive is closed */
+	    meta_index = 1;
+	    break;
+
 	case 'N':		/* notify service manager (even if not primary) */
 	    notify_service_mgr = 1;
 	    break;
@@ -1080,6 +1135,14 @@ main(int argc, char **argv)
 	    rflag = 1;
 	    break;
 
+	case 'R':		/* push records to pmproxy, see push.c */
+	    if ((sts = push_setup(opts.optarg)) < 0) {
+		pmprintf("%s: -R requires a HOST or HOST:PORT argument: %s\n",
+			pmGetProgname(), pmErrStr(sts));
+		opts.errors++;
+	    }
+	    break;
+
 	case 's':		/* exit size */
 	    sts = ParseSize(opts.optarg, &exit_samples, &exit_bytes, &exit_time);
 	    if (sts < 0) {
@@ -1092,6 +1155,10 @@ main(int argc, char **argv)
 	    }
 	    break;
 
+	case 'S':		/* space accounting for data volumes */
+	    __pmLogSetSizes(1);
+	    break;
+
 	case 'T':		/* end time */
 	    runtime = opts.optarg;
             break;
@@ -1152,6 +1219,16 @@ main(int argc, char **argv)
 	    }
 	    break;
 
+	case 'X':		/* compression for data volumes */
+	    if ((sts = __pmLogSetCompress(opts.optarg)) < 0) {
+		pmprintf("%s: -X compression method \"%s\" not supported\n",
+			 pmGetProgname(), opts.optarg);
+		opts.errors++;
+	    }
+	    else if (strcmp(opts.optarg, "none") != 0)
+		compress_method = opts.optarg;
+	    break;
+
 	case 'y':
 	    use_localtime = 1;
 	    break;
@@ -1283,7 +1360,8 @@ main(int argc, char **argv)
 	exit(1);
     }
 
-    if (pmnsfile != PM_NS_DEFAULT) {
+    if (pmnsfile != PM_NS_DEFAULT &&
+	(farm_pmnsfile == NULL || strcmp(pmnsfile, farm_pmnsfile) != 0)) {
 	if ((sts = pmLoadASCIINameSpace(pmnsfile, 1)) < 0) {
 	    fprintf(stderr, "%s: Cannot load namespace from \"%s\": %s\n", pmGetProgname(), pmnsfile, pmErrStr(sts));
 	    exit(1);
@@ -1326,7 +1404,16 @@ main(int argc, char **argv)
     if (pmDebugOptions.appl4)
 	pmNotifyErr(LOG_INFO, "Start pmcpp and parse");
 
-    fp = do_pmcpp(configfile);
+    if (farm_config != NULL) {
+	/* farm member, configuration preprocessed once for all */
+	if ((fp = fopen(farm_config, "r")) == NULL) {
+	    fprintf(stderr, "%s: Cannot open farm config file \"%s\": %s\n",
+		pmGetProgname(), farm_config, osstrerror());
+	    exit(1);
+	}
+    }
+    else
+	fp = do_pmcpp(configfile);
     /* do not return unless yyin is valid */
     if (configfile == NULL)
 	configfile = strdup("<stdin>");
@@ -1336,7 +1423,10 @@ main(int argc, char **argv)
      * no return if anything fatal happens
      */
     yyin = pass0(fp);
-    __pmProcessPipeClose(fp);
+    if (farm_config != NULL)
+	fclose(fp);
+    else
+	__pmProcessPipeClose(fp);
 
     /*
      * set up signal handlers ... can't do it earlier because on some
@@ -1529,7 +1619,7 @@ main(int argc, char **argv)
 
     fprintf(stderr, "Archive basename: %s\n", archName);
 
-    if (notify_service_mgr && !pmlogger_reexec) {
+    if (notify_service_mgr && !pmlogger_reexec && !farm_member) {
 	/*
 	 * If we haven't been reexec'd, notify service manager (if any),
 	 * that we are ready.
@@ -1542,7 +1632,8 @@ main(int argc, char **argv)
 	/* detach yourself from the launching process */
         setpgid(getpid(), 0);
 #endif
-	__pmServerCreatePIDFile(pmGetProgname(), 0);
+	if (!farm_member)
+	    __pmServerCreatePIDFile(pmGetProgname(), 0);
     }
 
     /* set up control port socket and external map files */
@@ -1599,19 +1690,29 @@ main(int argc, char **argv)
 	    }
 	    /*
 	     * Scan the task list looking for ones with t_alarm
-	     * set, and link these together (add to end of chain
-	     * to preserved order the same as taslist->t_next)
-	     * ... do all this with async callbacks blocked
+	     * set, and link these together in order of increasing
+	     * logging interval (tasks with equal intervals stay in
+	     * the same order as tasklist->t_next), so that when many
+	     * tasks are due together the high frequency ones are not
+	     * delayed behind the fetch and write of (possibly large)
+	     * infrequent ones ... do all this with async callbacks
+	     * blocked
 	     */
 	    __pmAFblock();
 	    for (tp = tasklist; tp != NULL; tp = tp->t_next) {
 		if (tp->t_alarm) {
-		    if (alarmed == NULL)
+		    task_t	*prev = NULL;
+
+		    for (last = alarmed; last != NULL; last = last->t_alarmed) {
+			if (pmtimevalSub(&tp->t_delta, &last->t_delta) < 0)
+			    break;
+			prev = last;
+		    }
+		    tp->t_alarmed = last;
+		    if (prev == NULL)
 			alarmed = tp;
-		    if (last != NULL)
-			last->t_alarmed = tp;
-		    tp->t_alarmed = NULL;
-		    last = tp;
+		    else
+			prev->t_alarmed = tp;
 		}
 	    }
 	    __pmAFunblock();
@@ -0,0 +1,325 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/*
+ * Push mode (-R) ... as well as being written to the local archive,
+ * each record written to the metadata and data volumes is streamed to
+ * pmproxy over one long-lived HTTP/1.1 request,
+ *
+ *	POST /logger/push?hostname=<host>&name=<archive> HTTP/1.1
+ *	Transfer-Encoding: chunked
+ *
+ * with one chunk per record (or part of the metadata file, see below)
+ * holding a frame header of the volume number and length (32-bit, in
+ * network byte order) and then the bytes as written to that volume.
+ * pmproxy reassembles the records of each volume from its frames.
+ *
+ * Sending never blocks logging.  Frames the socket will not take yet
+ * are held back, up to PUSH_MAXPENDING bytes, beyond which the
+ * connection is dropped.  Reconnection is attempted (at most every
+ * PUSH_RETRY seconds) when the next record is written, and starts by
+ * sending the metadata file as written so far, and the label of the
+ * current data volume, so pmproxy has all the metadata needed for
+ * the data records that follow.  Data records written while there is
+ * no connection are not sent ... the local archive remains the
+ * complete record.
+ */
+
+#include "logger.h"
+#include <fcntl.h>
+
+#define PUSH_PORT	44322		/* pmproxy default port */
+#define PUSH_RETRY	10		/* minimum seconds between connects */
+#define PUSH_TIMEOUT	5		/* seconds to wait for connection */
+#define PUSH_MAXPENDING	(4*1024*1024)	/* bytes held back before dropping */
+
+static char	*push_host;
+static int	push_port = PUSH_PORT;
+static int	push_fd = -1;
+static time_t	push_last;		/* time of the last connect attempt */
+static char	*pending;		/* bytes not yet taken by the socket */
+static size_t	npending;
+static size_t	maxpending;
+static char	*label;			/* label record of current data volume */
+static size_t	labellen;
+static int	labelvol = -1;
+
+static void
+push_disconnect(const char *reason)
+{
+    if (push_fd < 0)
+	return;
+    pmNotifyErr(LOG_WARNING, "pmlogger: push to %s:%d %s, disconnected\n",
+		push_host, push_port, reason);
+    __pmCloseSocket(push_fd);
+    push_fd = -1;
+    npending = 0;
+}
+
+/*
+ * Send as much as the socket will take of the pending bytes.
+ */
+static void
+push_flush(void)
+{
+    ssize_t	n;
+    int		flags = 0;
+
+#ifdef MSG_NOSIGNAL
+    flags |= MSG_NOSIGNAL;
+#endif
+    while (push_fd >= 0 && npending > 0) {
+	if ((n = send(push_fd, pending, npending, flags)) < 0) {
+	    if (neterror() == EINTR)
+		continue;
+	    if (neterror() == EAGAIN || neterror() == EWOULDBLOCK)
+		return;
+	    push_disconnect(netstrerror());
+	    return;
+	}
+	npending -= n;
+	memmove(pending, pending + n, npending);
+    }
+}
+
+static int
+push_append(const void *buf, size_t len)
+{
+    size_t	need = npending + len;
+    char	*p;
+
+    if (need > PUSH_MAXPENDING) {
+	push_disconnect("not keeping up");
+	return -ENOBUFS;
+    }
+    if (need > maxpending) {
+	if (maxpending == 0)
+	    maxpending = 65536;
+	while (maxpending < need)
+	    maxpending *= 2;
+	if ((p = realloc(pending, maxpending)) == NULL) {
+	    maxpending = npending;
+	    push_disconnect("out of memory");
+	    return -ENOMEM;
+	}
+	pending = p;
+    }
+    memcpy(pending + npending, buf, len);
+    npending += len;
+    return 0;
+}
+
+/*
+ * One chunk of the request body, holding one frame.
+ */
+static void
+push_frame(int vol, const void *buf, size_t len)
+{
+    char	size[32];
+    __int32_t	hdr[2];
+
+    if (push_fd < 0)
+	return;
+    pmsprintf(size, sizeof(size), "%zx\r\n", len + sizeof(hdr));
+    hdr[0] = htonl(vol);
+    hdr[1] = htonl((__int32_t)len);
+    if (push_append(size, strlen(size)) < 0 ||
+	push_append(hdr, sizeof(hdr)) < 0 ||
+	push_append(buf, len) < 0 ||
+	push_append("\r\n", 2) < 0)
+	return;
+    push_flush();
+}
+
+static int
+push_connect(void)
+{
+    __pmHostEnt		*servInfo;
+    __pmSockAddr	*myAddr;
+    __pmFdSet		wfds;
+    struct timeval	timeout = { PUSH_TIMEOUT, 0 };
+    void		*enumIx = NULL;
+    int			fd = -ECONNREFUSED, fdFlags, sts;
+
+    if ((servInfo = __pmGetAddrInfo(push_host)) == NULL)
+	return -EHOSTUNREACH;
+    while ((myAddr = __pmHostEntGetSockAddr(servInfo, &enumIx)) != NULL) {
+	if (__pmSockAddrIsInet(myAddr))
+	    fd = __pmCreateSocket();
+	else if (__pmSockAddrIsIPv6(myAddr))
+	    fd = __pmCreateIPv6Socket();
+	else
+	    fd = -EINVAL;
+	if (fd < 0) {
+	    __pmSockAddrFree(myAddr);
+	    continue;
+	}
+	fdFlags = __pmConnectTo(fd, myAddr, push_port);
+	__pmSockAddrFree(myAddr);
+	if (fdFlags < 0) {
+	    __pmCloseSocket(fd);
+	    fd = fdFlags;
+	    continue;
+	}
+	__pmFD_ZERO(&wfds);
+	__pmFD_SET(fd, &wfds);
+	if ((sts = __pmSelectWrite(fd+1, &wfds, &timeout)) == 1 &&
+	    (sts = __pmConnectCheckError(fd)) == 0 &&
+	    (fd = __pmConnectRestoreFlags(fd, fdFlags)) >= 0)
+	    break;
+	__pmCloseSocket(fd);
+	fd = (sts == 0) ? -ETIMEDOUT : (sts < 0 ? sts : -sts);
+    }
+    __pmHostEntFree(servInfo);
+
+    /* writes from here on never block the logger */
+    if (fd >= 0 && fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0) {
+	sts = -oserror();
+	__pmCloseSocket(fd);
+	fd = sts;
+    }
+    return fd;
+}
+
+/*
+ * (Re)connect, send the request header and then the metadata written
+ * so far and the current data volume label.
+ */
+static void
+push_start(void)
+{
+    char	path[MAXPATHLEN];
+    char	buf[65536];
+    char	*name;
+    ssize_t	n;
+    int		fd;
+
+    push_last = time(NULL);
+    if ((fd = push_connect()) < 0) {
+	pmNotifyErr(LOG_WARNING, "pmlogger: push to %s:%d failed: %s\n",
+		    push_host, push_port, pmErrStr(fd));
+	return;
+    }
+    push_fd = fd;
+    npending = 0;
+
+    name = strrchr(archName, '/');
+    name = (name == NULL) ? archName : name + 1;
+    pmsprintf(buf, sizeof(buf),
+		"POST /logger/push?hostname=%s&name=%s HTTP/1.1\r\n"
+		"Host: %s:%d\r\n"
+		"User-Agent: pmlogger\r\n"
+		"Content-Type: application/octet-stream\r\n"
+		"Transfer-Encoding: chunked\r\n\r\n",
+		pmcd_host, name, push_host, push_port);
+    push_append(buf, strlen(buf));
+
+    pmsprintf(path, sizeof(path), "%s.meta", archName);
+    if ((fd = open(path, O_RDONLY)) >= 0) {
+	while (push_fd >= 0 && (n = read(fd, buf, sizeof(buf))) > 0)
+	    push_frame(PM_LOG_VOL_META, buf, n);
+	close(fd);
+    }
+    if (labelvol >= 0)
+	push_frame(labelvol, label, labellen);
+    if (push_fd >= 0)
+	pmNotifyErr(LOG_INFO, "pmlogger: pushing to %s:%d\n",
+		    push_host, push_port);
+}
+
+/*
+ * Tee callback, see __pmLogSetTee(), for every record written.
+ */
+static void
+push_record(void *arg, int vol, const void *buf, size_t len)
+{
+    int		replayed = 0;
+    char	*p;
+
+    if (vol >= 0 && vol != labelvol) {
+	/* first write to a new data volume is its label */
+	if ((p = realloc(label, len)) != NULL) {
+	    memcpy(p, buf, len);
+	    label = p;
+	    labellen = len;
+	    labelvol = vol;
+	}
+	replayed = (labelvol == vol);
+    }
+    else if (vol == PM_LOG_VOL_META)
+	replayed = 1;	/* already written to the metadata file */
+
+    if (push_fd < 0) {
+	if (time(NULL) - push_last < PUSH_RETRY)
+	    return;
+	push_start();
+	if (replayed)
+	    return;
+    }
+    push_frame(vol, buf, len);
+}
+
+/*
+ * Parse -R host[:port] and start copying records as they are written.
+ */
+int
+push_setup(const char *spec)
+{
+    char	*p, *end;
+    long	port;
+
+    if ((push_host = strdup(spec)) == NULL)
+	return -ENOMEM;
+    /* host:port, but not an IPv6 address without a port */
+    if ((p = strchr(push_host, ':')) != NULL && strchr(p + 1, ':') == NULL) {
+	port = strtol(p + 1, &end, 10);
+	if (*end != '\0' || port <= 0 || port > 65535)
+	    return -EINVAL;
+	push_port = (int)port;
+	*p = '\0';
+    }
+    if (*push_host == '\0')
+	return -EINVAL;
+    __pmLogSetTee(push_record, NULL);
+    return 0;
+}
+
+/*
+ * End of the archive, send whatever is held back (waiting briefly
+ * for the socket) and the end of the request body.
+ */
+void
+push_done(void)
+{
+    struct timeval	timeout = { PUSH_TIMEOUT, 0 };
+    __pmFdSet		wfds;
+
+    __pmLogSetTee(NULL, NULL);
+    if (push_fd < 0)
+	return;
+    push_append("0\r\n\r\n", 5);
+    while (push_fd >= 0 && npending > 0) {
+	__pmFD_ZERO(&wfds);
+	__pmFD_SET(push_fd, &wfds);
+	if (__pmSelectWrite(push_fd+1, &wfds, &timeout) <= 0) {
+	    push_disconnect("timed out");
+	    break;
+	}
+	push_flush();
+    }
+    if (push_fd >= 0) {
+	__pmCloseSocket(push_fd);
+	push_fd = -1;
+    }
+}
@@ -91,3 +91,83 @@ linkback(task_t *tp)
     for (fcp = tp->t_fetch; fcp != NULL; fcp = fcp->f_next)
 	fcp->f_aux = (void *)tp;
 }
+
+/*
+ * Sample alignment, see -A ... repeating tasks are started at the
+ * next whole multiple of their interval since the epoch, so every
+ * pmlogger with a disciplined clock (NTP, PTP) fetches at the same
+ * instants as its peers, and the AF queue preserves that phase from
+ * then on.
+ */
+static unsigned long	skew_count;
+static double		skew_sum;	/* signed, for the mean */
+static double		skew_max;	/* largest absolute skew */
+
+static __int64_t
+align_usec(const struct timeval *tv)
+{
+    return (__int64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+}
+
+/*
+ * Return the delay until the next aligned instant for this interval,
+ * at least one blink away so the timer is not already due
+ */
+void
+align_start(const struct timeval *interval, struct timeval *start)
+{
+    struct timeval	now;
+    __int64_t		usec_interval = align_usec(interval);
+    __int64_t		usec, wait;
+
+    if (usec_interval <= 0) {
+	start->tv_sec = start->tv_usec = 0;
+	return;
+    }
+    pmtimevalNow(&now);
+    usec = align_usec(&now);
+    wait = usec_interval - (usec % usec_interval);
+    if (wait < 20000)
+	wait += usec_interval;
+    start->tv_sec = wait / 1000000;
+    start->tv_usec = wait % 1000000;
+}
+
+/*
+ * Account for the skew between the pmcd timestamp of a result and the
+ * aligned instant nearest to it - this covers both scheduling latency
+ * here and any clock offset between this host and the pmcd host
+ */
+void
+align_skew(const struct timeval *interval, const __pmTimestamp *stamp)
+{
+    __int64_t	usec_interval = align_usec(interval);
+    __int64_t	usec, off;
+    double	skew;
+
+    if (usec_interval <= 0)
+	return;
+    usec = (__int64_t)stamp->sec * 1000000 + stamp->nsec / 1000;
+    off = usec % usec_interval;
+    if (off > usec_interval / 2)
+	off -= usec_interval;
+    skew = (double)off / 1000.0;	/* msec */
+    skew_count++;
+    skew_sum += skew;
+    if (skew > skew_max)
+	skew_max = skew;
+    else if (-skew > skew_max)
+	skew_max = -skew;
+    if (pmDebugOptions.appl2)
+	pmNotifyErr(LOG_INFO, "align: fetch skew %.3f msec", skew);
+}
+
+/* Report the skew achieved so far, if any aligned fetches were done */
+void
+align_report(void)
+{
+    if (skew_count == 0)
+	return;
+    pmNotifyErr(LOG_INFO, "pmlogger: aligned fetches %lu, skew mean %.3f msec, max %.3f msec",
+		skew_count, skew_sum / skew_count, skew_max);
+}
@@ -61,6 +61,7 @@ int		sarg = -1;		/* -s arg - finish after X samples */
 char		*Sarg;			/* -S arg - window start */
 char		*Targ;			/* -T arg - window end */
 char		*Aarg;			/* -A arg - output time alignment */
+char		*rarg;			/* -r arg - resume after this archive */
 int		varg = -1;		/* -v arg - switch log vol every X */
 int		zarg;			/* -z arg - use archive timezone */
 char		*tz;			/* -Z arg - use timezone from user */
@@ -73,6 +74,7 @@ int		ictx_a;
 char		*oname;			/* name of output archive */
 pmLogLabel	olabel;			/* output archive label */
 struct timeval	winstart_tval;		/* window start tval*/
+struct timeval	resume_tval;		/* last sample from -r archive */
 
 /* time window stuff */
 static struct timeval logstart_tval;	/* reduced log start */
@@ -89,6 +91,7 @@ static pmLongOptions longopts[] = {
     PMOPT_START,
     PMOPT_SAMPLES,
     PMOPT_FINISH,
+    { "resume", 1, 'r', "ARCHIVE", "resume after the last sample in ARCHIVE" },
     { "interval", 1, 't', "DELTA", "sample output interval [default 10min]" },
     { "", 1, 'v', "NUM", "switch log volumes after this many samples" },
     PMOPT_TIMEZONE,
@@ -98,7 +101,7 @@ static pmLongOptions longopts[] = {
 };
 
 static pmOptions opts = {
-    .short_options = "A:D:S:s:T:t:v:Z:z?",
+    .short_options = "A:D:r:S:s:T:t:v:Z:z?",
     .long_options = longopts,
     .short_usage = "[options] input-archive output-archive",
 };
@@ -128,6 +131,10 @@ parseargs(int argc, char *argv[])
 	    }
 	    break;
 
+	case 'r':	/* resume after previously reduced archive */
+	    rarg = opts.optarg;
+	    break;
+
 	case 's':	/* number of samples to write out */
 	    sarg = (int)strtol(opts.optarg, &endnum, 10);
 	    if (*endnum != '\0' || sarg < 0) {
@@ -192,6 +199,12 @@ parseargs(int argc, char *argv[])
 	}
     }
 
+    if (rarg != NULL && Sarg != NULL) {
+	pmprintf("%s: at most one of -r and/or -S allowed\n",
+		pmGetProgname());
+	opts.errors++;
+    }
+
     if (opts.errors == 0 && opts.optind > argc-2) {
 	pmprintf("%s: Error: insufficient arguments\n", pmGetProgname());
 	opts.errors++;
@@ -200,6 +213,46 @@ parseargs(int argc, char *argv[])
     return -opts.errors;
 }
 
+/*
+ * Get the time of the last sample in the -r archive, which must be
+ * from the same host as the input archive ... reduction resumes one
+ * interval after this.
+ */
+static void
+getresume(void)
+{
+    int			ctx;
+    int			sts;
+    pmLogLabel		rlabel;
+
+    if ((ctx = pmNewContext(PM_CONTEXT_ARCHIVE, rarg)) < 0) {
+	fprintf(stderr, "%s: Error: cannot open archive \"%s\": %s\n",
+		pmGetProgname(), rarg, pmErrStr(ctx));
+	exit(1);
+    }
+    if ((sts = pmGetArchiveLabel(&rlabel)) < 0) {
+	fprintf(stderr, "%s: Error: cannot get archive label record (%s): %s\n", pmGetProgname(), rarg, pmErrStr(sts));
+	exit(1);
+    }
+    if (strcmp(rlabel.ll_hostname, ilabel.ll_hostname) != 0) {
+	fprintf(stderr, "%s: Error: host \"%s\" for archive (%s) does not match host \"%s\" for archive (%s)\n",
+		pmGetProgname(), rlabel.ll_hostname, rarg, ilabel.ll_hostname, iname);
+	exit(1);
+    }
+    if ((sts = pmGetArchiveEnd(&resume_tval)) < 0) {
+	fprintf(stderr, "%s: Error: cannot get end of archive (%s): %s\n",
+		pmGetProgname(), rarg, pmErrStr(sts));
+	exit(1);
+    }
+    pmDestroyContext(ctx);
+
+    if ((sts = pmUseContext(ictx_a)) < 0) {
+	fprintf(stderr, "%s: Error: cannot use context (%s): %s\n",
+		pmGetProgname(), iname, pmErrStr(sts));
+	exit(1);
+    }
+}
+
 int
 main(int argc, char **argv)
 {
@@ -262,6 +315,9 @@ main(int argc, char **argv)
 	exit(1);
     }
 
+    if (rarg != NULL)
+	getresume();
+
     if (zarg) {
 	/* use TZ from metrics source (input-archive) */
 	if ((sts = pmNewZone(ilabel.ll_tz)) < 0) {
@@ -298,6 +354,25 @@ main(int argc, char **argv)
 		pmGetProgname(), msg);
 	exit(1);
     }
+    if (rarg != NULL) {
+	/*
+	 * Keep to the same sample times as the -r archive, so the two
+	 * archives together look like the output of a single run.  If
+	 * there is a gap before the input starts, skip whole intervals.
+	 */
+	double	delta = pmtimespecToReal(&targ);
+	double	next = pmtimevalToReal(&resume_tval) + delta;
+	double	first = pmtimevalToReal(&logstart_tval);
+
+	while (next < first)
+	    next += delta;
+	pmtimevalFromReal(next, &winstart_tval);
+	if (pmtimevalSub(&winend_tval, &winstart_tval) < 0) {
+	    fprintf(stderr, "%s: No input data after the end of archive (%s), nothing to do\n",
+		    pmGetProgname(), rarg);
+	    exit(0);
+	}
+    }
     if (pmDebugOptions.appl0) {
 	char	buf[26];
 	time_t	time;
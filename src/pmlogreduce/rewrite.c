@@ -71,13 +71,11 @@ rewrite(__pmResult *rp)
 		    if (vp->inst == vsp->vlist[j].inst)
 			break;
 		}
-		if (vp == NULL) {
-		    fprintf(stderr,
-			"%s: rewrite: Arrgh: cannot find inst %d in value_t list for %s (%s)\n",
-			    pmGetProgname(), vsp->vlist[j].inst, namelist[i], pmIDStr(vsp->pmid));
-		    exit(1);
-		}
-		if ((vp->control & (V_SEEN|V_INIT)) == 0)
+		/*
+		 * no value_t means this metric-instance pair was not seen
+		 * in the last interval, see doscan()
+		 */
+		if (vp == NULL || (vp->control & (V_SEEN|V_INIT)) == 0)
 		    continue;
 		/*
 		 * we've seen this metric-instance pair in the last
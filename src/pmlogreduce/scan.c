@@ -4,6 +4,8 @@ static __pmTimestamp	last_stamp = { 0, 0 };
 static int		ictx_b = -1;
 
 extern struct timeval	winstart_tval;
+extern struct timeval	resume_tval;
+extern char		*rarg;
 
 /*
  * This is the heart of the data reduction algorithm.  The term
@@ -26,6 +28,13 @@ extern struct timeval	winstart_tval;
  *
  * 5. all of the above has to be done in a way that makes sense in the
  *    presence of mark records
+ *
+ * Only one forward pass is made over the input archive, and the state
+ * kept is bounded by the metric-instances seen in the current interval
+ * ... value_t entries that were not seen in the last interval will not
+ * be output for that interval (see rewrite()), so they are discarded
+ * here and recreated if the metric-instance reappears later on, e.g.
+ * for dynamic instance domains with short-lived instances.
  */
 
 void
@@ -50,7 +59,11 @@ doscan(__pmTimestamp *end)
 	    exit(1);
 	}
 
-	if ((sts = pmSetMode(PM_MODE_FORW, NULL, 0)) < 0) {
+	/*
+	 * when resuming (-r) start scanning at the last sample of the
+	 * earlier reduced archive, not the start of the input archive
+	 */
+	if ((sts = pmSetMode(PM_MODE_FORW, rarg != NULL ? &resume_tval : NULL, 0)) < 0) {
 	    fprintf(stderr,
 		"%s: Error: pmSetMode (ictx_b) failed: %s\n", pmGetProgname(), pmErrStr(sts));
 	    exit(1);
@@ -64,9 +77,27 @@ doscan(__pmTimestamp *end)
     }
 
     for (i = 0; i < numpmid; i++) {
-	for (vp = metriclist[i].first; vp != NULL; vp = vp->next) {
+	value_t		*lvp = NULL;
+	value_t		*nvp;
+
+	for (vp = metriclist[i].first; vp != NULL; vp = nvp) {
+	    nvp = vp->next;
+	    if ((vp->control & (V_SEEN|V_INIT)) == 0) {
+		if (pmDebugOptions.appl1) {
+		    fprintf(stderr,
+			"drop value_t for %s (%s) inst %d\n",
+			namelist[i], pmIDStr(pmidlist[i]), vp->inst);
+		}
+		if (lvp == NULL)
+		    metriclist[i].first = nvp;
+		else
+		    lvp->next = nvp;
+		free(vp);
+		continue;
+	    }
 	    vp->nobs = vp->nwrap = 0;
 	    vp->control &= ~V_SEEN;
+	    lvp = vp;
 	}
     }
 
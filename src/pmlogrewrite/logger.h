@@ -217,6 +217,7 @@ extern int	yyparse(void);
 
 extern int	_pmLogRename(const char *, const char *);
 extern int	_pmLogRemove(const char *, int);
+extern int	_pmLogLink(const char *, const char *);
 #define ntoh_pmInDom(indom) ntohl(indom)
 #define ntoh_pmID(pmid)     ntohl(pmid)
 
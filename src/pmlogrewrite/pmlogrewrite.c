@@ -48,6 +48,7 @@ static pmLongOptions longopts[] = {
     { "check", 0, 'C', 0, "parse config file(s) and quit (verbose warnings also)" },
     { "desperate", 0, 'd', 0, "desperate, save output archive even after error" },
     { "", 0, 'i', 0, "rewrite in place, input-archive will be over-written" },
+    { "meta-index", 0, 'M', 0, "also write a metadata index for the output archive" },
     { "quick", 0, 'q', 0, "quick mode, no output if no change" },
     { "scale", 0, 's', 0, "do scale conversion" },
     { "verbose", 0, 'v', 0, "increased diagnostic verbosity" },
@@ -60,7 +61,7 @@ static pmLongOptions longopts[] = {
 };
 
 static pmOptions opts = {
-    .short_options = "c:CdD:iqsvV:w?",
+    .short_options = "c:CdD:iMqsvV:w?",
     .long_options = longopts,
     .short_usage = "[options] input-archive [output-archive]",
 };
@@ -87,6 +88,7 @@ char	*configfile;			/* current config file */
 int	Cflag;				/* -C parse config and quit */
 int	dflag;				/* -d desperate */
 int	iflag;				/* -i in-place */
+int	Mflag;				/* -M metadata index */
 int	qflag;				/* -q quick or quiet */
 int	sflag;				/* -s scale values */
 int	vflag;				/* -v verbosity */
@@ -371,6 +373,10 @@ parseargs(int argc, char *argv[])
 	    iflag = 1;
 	    break;
 
+	case 'M':	/* metadata index */
+	    Mflag = 1;
+	    break;
+
 	case 'q':	/* quick or quiet */
 	    qflag = 1;
 	    break;
@@ -1500,221 +1506,220 @@ do_newlabelsets(void)
     }
 }
 
-int
-main(int argc, char **argv)
+/*
+ * Return 1 if the rewriting rules change the data volumes, 0 if only
+ * the metadata is changed.  Changes to names, semantics, units without
+ * rescaling, instance names, help text and labels are all metadata only.
+ */
+static int
+datachange(void)
 {
-    int		sts;
-    int		stslog;			/* sts from nextlog() */
-    int		stsmeta = 0;		/* sts from nextmeta() */
-    int		i;
-    int		ti_idx;			/* next slot for input temporal index */
-    int		dir_fd = -1;		/* poinless initialization to humour gcc */
-    int		doneti = 0;
-    __pmTimestamp	tstamp = { 0, 0 };	/* for last log record */
-    off_t	old_log_offset = 0;	/* log offset before last log record */
-    off_t	old_meta_offset;
-    int		seen_event = 0;
+    const metricspec_t	*mp;
+    int			k;
 
-    /* process cmd line args */
-    if (parseargs(argc, argv) < 0) {
-	pmUsageMessage(&opts);
-	exit(1);
+    if (global.flags != 0)
+	/* label records at the start of each data volume */
+	return 1;
+    if (outarch.version != inarch.version)
+	return 1;
+    for (mp = metric_root; mp != NULL; mp = mp->m_next) {
+	if (mp->flags & (METRIC_CHANGE_PMID | METRIC_CHANGE_TYPE |
+			 METRIC_DELETE | METRIC_RESCALE))
+	    return 1;
+	if ((mp->flags & METRIC_CHANGE_INDOM) && mp->output != OUTPUT_ALL)
+	    return 1;
+	if (mp->ip != NULL) {
+	    for (k = 0; k < mp->ip->numinst; k++) {
+		if (mp->ip->inst_flags[k] & (INST_CHANGE_INST | INST_DELETE))
+		    return 1;
+	    }
+	}
     }
+    return 0;
+}
 
-    /* input archive */
-    if (iflag == 0)
-	inarch.name = argv[argc-2];
-    else
-	inarch.name = argv[argc-1];
-    inarch.logrec = inarch.metarec = NULL;
-    inarch.mark = 0;
-    inarch.rp = NULL;
+/*
+ * Return 1 if the input temporal index can be reused for a metadata
+ * only rewrite, i.e. there is one and the entries are in order.
+ */
+static int
+goodindex(void)
+{
+    const __pmLogCtl	*lcp = inarch.ctxp->c_archctl->ac_log;
+    const __pmLogTI	*tip;
+    off_t		off_meta = 0;
+    int			k;
+
+    if (lcp->numti == 0)
+	return 0;
+    for (k = 0; k < lcp->numti; k++) {
+	tip = &lcp->ti[k];
+	if (tip->vol < lcp->minvol || tip->vol > lcp->maxvol)
+	    return 0;
+	if (tip->off_meta < off_meta || tip->off_data <= 0)
+	    return 0;
+	off_meta = tip->off_meta;
+    }
+    return 1;
+}
 
-    if ((inarch.ctx = pmNewContext(PM_CONTEXT_ARCHIVE, inarch.name)) < 0) {
-	if (inarch.ctx == PM_ERR_NODATA) {
-	    fprintf(stderr, "%s: Warning: empty archive \"%s\" will be skipped\n",
-		    pmGetProgname(), inarch.name);
-	    exit(0);
-	}
-	if (inarch.ctx == PM_ERR_FEATURE) {
-	    fprintf(stderr, "%s: Warning: archive \"%s\": unsupported feature bits, other errors may follow ...\n",
-		    pmGetProgname(), inarch.name);
-	    inarch.ctx = pmNewContext(PM_CONTEXT_ARCHIVE | PM_CTXFLAG_NO_FEATURE_CHECK, inarch.name);
-	}
-	if (inarch.ctx < 0) {
-	    fprintf(stderr, "%s: Error: cannot open archive \"%s\": %s\n",
-		    pmGetProgname(), inarch.name, pmErrStr(inarch.ctx));
-	    exit(1);
+/*
+ * Write a temporal index entry for the output archive, copying the
+ * data volume position from the input entry tip and using the current
+ * position in the output metadata file.
+ */
+static void
+putindex(const __pmLogTI *tip)
+{
+    __int32_t		buf[8];
+    size_t		bytes;
+    __uint64_t		off_meta;
+    __uint64_t		off_data;
+
+    off_meta = (__uint64_t)__pmFtell(outarch.logctl.mdfp);
+    off_data = (__uint64_t)tip->off_data;
+    if (outarch.version == PM_LOG_VERS02) {
+	if (off_meta > 0x7fffffff) {
+	    fprintf(stderr, "%s: Error: output metadata file too big for v2 temporal index\n", pmGetProgname());
+	    abandon();
+	    /*NOTREACHED*/
 	}
+	__pmPutTimeval(&tip->stamp, &buf[0]);
+	buf[2] = htonl(tip->vol);
+	buf[3] = htonl((__int32_t)off_meta);
+	buf[4] = htonl((__int32_t)off_data);
+	bytes = 5 * sizeof(__int32_t);
     }
-    inarch.ctxp = __pmHandleToPtr(inarch.ctx);
-    assert(inarch.ctxp != NULL);
-    /*
-     * Note: This application is single threaded, and once we have ctxp
-     *	     the associated __pmContext will not move and will only be
-     *	     accessed or modified synchronously either here or in libpcp.
-     *	     We unlock the context so that it can be locked as required
-     *	     within libpcp.
-     */
-    PM_UNLOCK(inarch.ctxp->c_lock);
-
-    if ((sts = __pmLogLoadLabel(inarch.ctxp->c_archctl->ac_log->mdfp, &inarch.label)) < 0) {
-	fprintf(stderr, "%s: Error: cannot get archive label record (%s): %s\n",
-		pmGetProgname(), inarch.name, pmErrStr(sts));
-	exit(1);
+    else {
+	__pmPutTimestamp(&tip->stamp, &buf[0]);
+	buf[3] = htonl(tip->vol);
+	buf[4] = htonl((__int32_t)(off_meta >> 32));
+	buf[5] = htonl((__int32_t)(off_meta & 0xffffffff));
+	buf[6] = htonl((__int32_t)(off_data >> 32));
+	buf[7] = htonl((__int32_t)(off_data & 0xffffffff));
+	bytes = 8 * sizeof(__int32_t);
+    }
+    if (pmDebugOptions.appl0) {
+	fprintf(stderr, "Index: write ");
+	__pmPrintTimestamp(stderr, &tip->stamp);
+	fprintf(stderr, " vol=%d meta=%lld log=%lld\n", tip->vol,
+		(long long)off_meta, (long long)off_data);
     }
+    if (__pmFwrite(buf, 1, bytes, outarch.logctl.tifp) != bytes) {
+	fprintf(stderr, "%s: Error: temporal index write failed: %s\n",
+		pmGetProgname(), osstrerror());
+	abandon();
+	/*NOTREACHED*/
+    }
+}
 
-    inarch.version = (inarch.label.magic & 0xff);
-    if (inarch.version != PM_LOG_VERS02 && inarch.version != PM_LOG_VERS03) {
-	fprintf(stderr,"%s: Error: illegal version number %d in archive (%s)\n",
-		pmGetProgname(), inarch.version, inarch.name);
+/*
+ * rewrite the metadata only ... the data volumes of the input archive
+ * are linked (or copied) to the output archive unchanged, and the
+ * input temporal index is reused with offsets into the new metadata
+ */
+static void
+rewrite_meta(void)
+{
+    __pmLogCtl	*lcp = inarch.ctxp->c_archctl->ac_log;
+    int		stsmeta = 0;
+    int		k;
+
+    outarch.archctl.ac_log = &outarch.logctl;
+    outarch.archctl.ac_mfp = NULL;
+    if ((outarch.logctl.tifp = __pmLogNewFile(outarch.name, PM_LOG_VOL_TI)) == NULL) {
+	fprintf(stderr, "%s: Error: __pmLogNewFile(%s,%d): %s\n",
+		pmGetProgname(), outarch.name, PM_LOG_VOL_TI, pmErrStr(-oserror()));
+	/* do not cleanup, as for __pmLogCreate() in rewrite_all() */
 	exit(1);
+	/*NOTREACHED*/
     }
+    if ((outarch.logctl.mdfp = __pmLogNewFile(outarch.name, PM_LOG_VOL_META)) == NULL) {
+	char	path[MAXPATHLEN+1];
 
-    if (outarch.version == 0)
-	outarch.version = inarch.version;
-    if (outarch.version == PM_LOG_VERS02 && inarch.version == PM_LOG_VERS03) {
-	fprintf(stderr,"%s: Error: cannot create a v2 archive from v3 (%s)\n",
-		pmGetProgname(), inarch.name);
+	fprintf(stderr, "%s: Error: __pmLogNewFile(%s,%d): %s\n",
+		pmGetProgname(), outarch.name, PM_LOG_VOL_META, pmErrStr(-oserror()));
+	pmsprintf(path, sizeof(path), "%s.index", outarch.name);
+	unlink(path);
 	exit(1);
+	/*NOTREACHED*/
+    }
+    if (_pmLogLink(inarch.name, outarch.name) < 0) {
+	abandon();
+	/*NOTREACHED*/
     }
 
-    /* output archive */
-    if (iflag && Cflag == 0) {
-	/*
-	 * -i (in place) method outline
-	 *
-	 * + create one temporary base filename in the same directory is
-	 *   the input archive, keep a copy of this name this accessed
-	 *   via outarch.name
-	 * + create a second (and different) temporary base file name
-	 *   in the same directory, keep this name in bak_base[]
-	 * + close the temporary file descriptors and unlink the basename
-	 *   files
-	 * + create the output as per normal in outarch.name
-	 * + fsync() all the output files and the container directory
-	 * + rename the _input_ archive files using the _second_ temporary
-	 *   basename
-	 * + rename the output archive files to the basename of the input
-	 *   archive ... if this step fails for any reason, restore the
-	 *   original input files
-	 * + unlink all the (old) input archive files
-	 */
-	char	path[MAXPATHLEN+1];
-	char	dname[MAXPATHLEN+1];
-	mode_t	cur_umask;
-	int	tmp_f1;			/* fd for first temp basename */
-	int	tmp_f2;			/* fd for second temp basename */
-	int	sep = pmPathSeparator();
-
-#if HAVE_MKSTEMP
-	strncpy(path, argv[argc-1], sizeof(path));
-	path[sizeof(path)-1] = '\0';
-	strncpy(dname, dirname(path), sizeof(dname));
-	dname[sizeof(dname)-1] = '\0';
-	if ((dir_fd = open(dname, O_RDONLY)) < 0) {
-	    fprintf(stderr, "%s: Error: cannot open directory \"%s\" for reading: %s\n", pmGetProgname(), dname, strerror(errno));
-	    abandon();
-	    /*NOTREACHED*/
-	}
-	pmsprintf(path, sizeof(path), "%s%cXXXXXX", dname, sep);
-	cur_umask = umask(S_IXUSR | S_IRWXG | S_IRWXO);
-	tmp_f1 = mkstemp(path);
-	umask(cur_umask);
-	outarch.name = strdup(path);
-	if (outarch.name == NULL) {
-	    fprintf(stderr, "%s: Error: temp file strdup(%s) failed: %s\n", pmGetProgname(), path, strerror(errno));
-	    abandon();
-	    /*NOTREACHED*/
-	}
-	pmsprintf(bak_base, sizeof(bak_base), "%s%cXXXXXX", dname, sep);
-	cur_umask = umask(S_IXUSR | S_IRWXG | S_IRWXO);
-	tmp_f2 = mkstemp(bak_base);
-	umask(cur_umask);
-#else
-	char	fname[MAXPATHLEN+1];
-	char	*s;
+    /* label records match those at the start of the data volumes */
+    newlabel();
+    outarch.logctl.label.start = inarch.label.start;
+    outarch.logctl.state = PM_LOG_STATE_INIT;
+    outarch.logctl.label.vol = PM_LOG_VOL_TI;
+    __pmLogWriteLabel(outarch.logctl.tifp, &outarch.logctl.label);
+    outarch.logctl.label.vol = PM_LOG_VOL_META;
+    __pmLogWriteLabel(outarch.logctl.mdfp, &outarch.logctl.label);
 
-	strncpy(path, argv[argc-1], sizeof(path));
-	path[sizeof(path)-1] = '\0';
-	strncpy(fname, basename(path), sizeof(fname));
-	fname[sizeof(fname)-1] = '\0';
-	strncpy(dname, dirname(path), sizeof(dname));
-	dname[sizeof(dname)-1] = '\0';
+    /* new label sets use the timestamp of the first data record */
+    if (nextlog() < 0) {
+	abandon();
+	/*NOTREACHED*/
+    }
+    first_datarec = 0;
+    do_newlabelsets();
+    __pmFreeResult(inarch.rp);
+    inarch.rp = NULL;
 
-	if ((s = tempnam(dname, fname)) == NULL) {
-	    fprintf(stderr, "%s: Error: first tempnam() failed: %s\n", pmGetProgname(), strerror(errno));
-	    abandon();
-	    /*NOTREACHED*/
-	}
-	else {
-	    outarch.name = strdup(s);
-	    if (outarch.name == NULL) {
-		fprintf(stderr, "%s: Error: temp file strdup(%s) failed: %s\n", pmGetProgname(), s, strerror(errno));
+    /*
+     * for each input temporal index entry, copy metadata up to the
+     * offset in the entry and then write the output entry ... and
+     * finally any metadata after the last entry
+     */
+    for (k = 0; k <= lcp->numti; k++) {
+	while (stsmeta >= 0) {
+	    if (k < lcp->numti &&
+		__pmFtell(lcp->mdfp) >= lcp->ti[k].off_meta)
+		break;
+	    if ((stsmeta = nextmeta()) < 0)
+		break;
+	    if (stsmeta == TYPE_DESC)
+		do_desc();
+	    else if (stsmeta == TYPE_INDOM || stsmeta == TYPE_INDOM_DELTA ||
+		     stsmeta == TYPE_INDOM_V2)
+		do_indom(stsmeta);
+	    else if (stsmeta == TYPE_LABEL || stsmeta == TYPE_LABEL_V2)
+		do_labelset();
+	    else if (stsmeta == TYPE_TEXT)
+		do_text();
+	    else {
+		fprintf(stderr, "%s: Error: unrecognised metadata type: %d\n",
+		    pmGetProgname(), stsmeta);
 		abandon();
 		/*NOTREACHED*/
 	    }
-	    cur_umask = umask(S_IXUSR | S_IRWXG | S_IRWXO);
-	    tmp_f1 = open(outarch.name, O_WRONLY|O_CREAT|O_EXCL, 0600);
-	    umask(cur_umask);
-	}
-	if ((s = tempnam(dname, fname)) == NULL) {
-	    fprintf(stderr, "%s: Error: second tempnam() failed: %s\n", pmGetProgname(), strerror(errno));
-	    abandon();
-	    /*NOTREACHED*/
-	}
-	else {
-	    strcpy(bak_base, s);
-	    cur_umask = umask(S_IXUSR | S_IRWXG | S_IRWXO);
-	    tmp_f2 = open(bak_base, O_WRONLY|O_CREAT|O_EXCL, 0600);
-	    umask(cur_umask);
-	}
-#endif
-	if (tmp_f1 < 0) {
-	    fprintf(stderr, "%s: Error: create first temp (%s) failed: %s\n", pmGetProgname(), outarch.name, strerror(errno));
-	    abandon();
-	    /*NOTREACHED*/
-	}
-	if (tmp_f2 < 0) {
-	    fprintf(stderr, "%s: Error: create second temp (%s) failed: %s\n", pmGetProgname(), bak_base, strerror(errno));
-	    abandon();
-	    /*NOTREACHED*/
+	    free(inarch.metarec);
 	}
-	close(tmp_f1);
-	close(tmp_f2);
-	unlink(outarch.name);
-	unlink(bak_base);
+	if (k < lcp->numti)
+	    putindex(&lcp->ti[k]);
     }
-    else
-	outarch.name = argv[argc-1];
-
-    /*
-     * process config file(s)
-     */
-    for (i = 0; i < nconf; i++) {
-	parseconfig(conf[i]);
-    }
-
-    /*
-     * cross-specification dependencies and semantic checks once all
-     * config files have been processed
-     */
-    link_entries();
-    check_indoms();
-    check_output();
-
-    if (vflag)
-	reportconfig();
-
-    if (Cflag)
-	exit(0);
+    __pmFflush(outarch.logctl.mdfp);
+    __pmFflush(outarch.logctl.tifp);
+}
 
-    if (qflag && anychange() == 0) {
-	if (pmDebugOptions.appl3) {
-	    fprintf(stderr, "Done, no rewriting required\n");
-	}
-	exit(0);
-    }
+/*
+ * rewrite the metadata and all of the data volumes
+ */
+static void
+rewrite_all(void)
+{
+    int		sts;
+    int		stslog;			/* sts from nextlog() */
+    int		stsmeta = 0;		/* sts from nextmeta() */
+    int		i;
+    int		ti_idx;			/* next slot for input temporal index */
+    int		doneti = 0;
+    __pmTimestamp	tstamp = { 0, 0 };	/* for last log record */
+    off_t	old_log_offset = 0;	/* log offset before last log record */
+    off_t	old_meta_offset;
+    int		seen_event = 0;
 
     /* create output log - must be done before writing label */
     outarch.archctl.ac_log = &outarch.logctl;
@@ -2005,6 +2010,224 @@ main(int argc, char **argv)
 	__pmFseek(outarch.archctl.ac_mfp, (long)old_log_offset, SEEK_SET);
 	__pmLogPutIndex(&outarch.archctl, &tstamp);
     }
+}
+
+int
+main(int argc, char **argv)
+{
+    int		sts;
+    int		i;
+    int		dir_fd = -1;		/* poinless initialization to humour gcc */
+
+    /* process cmd line args */
+    if (parseargs(argc, argv) < 0) {
+	pmUsageMessage(&opts);
+	exit(1);
+    }
+
+    /* input archive */
+    if (iflag == 0)
+	inarch.name = argv[argc-2];
+    else
+	inarch.name = argv[argc-1];
+    inarch.logrec = inarch.metarec = NULL;
+    inarch.mark = 0;
+    inarch.rp = NULL;
+
+    if ((inarch.ctx = pmNewContext(PM_CONTEXT_ARCHIVE, inarch.name)) < 0) {
+	if (inarch.ctx == PM_ERR_NODATA) {
+	    fprintf(stderr, "%s: Warning: empty archive \"%s\" will be skipped\n",
+		    pmGetProgname(), inarch.name);
+	    exit(0);
+	}
+	if (inarch.ctx == PM_ERR_FEATURE) {
+	    fprintf(stderr, "%s: Warning: archive \"%s\": unsupported feature bits, other errors may follow ...\n",
+		    pmGetProgname(), inarch.name);
+	    inarch.ctx = pmNewContext(PM_CONTEXT_ARCHIVE | PM_CTXFLAG_NO_FEATURE_CHECK, inarch.name);
+	}
+	if (inarch.ctx < 0) {
+	    fprintf(stderr, "%s: Error: cannot open archive \"%s\": %s\n",
+		    pmGetProgname(), inarch.name, pmErrStr(inarch.ctx));
+	    exit(1);
+	}
+    }
+    inarch.ctxp = __pmHandleToPtr(inarch.ctx);
+    assert(inarch.ctxp != NULL);
+    /*
+     * Note: This application is single threaded, and once we have ctxp
+     *	     the associated __pmContext will not move and will only be
+     *	     accessed or modified synchronously either here or in libpcp.
+     *	     We unlock the context so that it can be locked as required
+     *	     within libpcp.
+     */
+    PM_UNLOCK(inarch.ctxp->c_lock);
+
+    if ((sts = __pmLogLoadLabel(inarch.ctxp->c_archctl->ac_log->mdfp, &inarch.label)) < 0) {
+	fprintf(stderr, "%s: Error: cannot get archive label record (%s): %s\n",
+		pmGetProgname(), inarch.name, pmErrStr(sts));
+	exit(1);
+    }
+
+    inarch.version = (inarch.label.magic & 0xff);
+    if (inarch.version != PM_LOG_VERS02 && inarch.version != PM_LOG_VERS03) {
+	fprintf(stderr,"%s: Error: illegal version number %d in archive (%s)\n",
+		pmGetProgname(), inarch.version, inarch.name);
+	exit(1);
+    }
+
+    if (outarch.version == 0)
+	outarch.version = inarch.version;
+    if (outarch.version == PM_LOG_VERS02 && inarch.version == PM_LOG_VERS03) {
+	fprintf(stderr,"%s: Error: cannot create a v2 archive from v3 (%s)\n",
+		pmGetProgname(), inarch.name);
+	exit(1);
+    }
+
+    /* output archive */
+    if (iflag && Cflag == 0) {
+	/*
+	 * -i (in place) method outline
+	 *
+	 * + create one temporary base filename in the same directory is
+	 *   the input archive, keep a copy of this name this accessed
+	 *   via outarch.name
+	 * + create a second (and different) temporary base file name
+	 *   in the same directory, keep this name in bak_base[]
+	 * + close the temporary file descriptors and unlink the basename
+	 *   files
+	 * + create the output as per normal in outarch.name
+	 * + fsync() all the output files and the container directory
+	 * + rename the _input_ archive files using the _second_ temporary
+	 *   basename
+	 * + rename the output archive files to the basename of the input
+	 *   archive ... if this step fails for any reason, restore the
+	 *   original input files
+	 * + unlink all the (old) input archive files
+	 */
+	char	path[MAXPATHLEN+1];
+	char	dname[MAXPATHLEN+1];
+	mode_t	cur_umask;
+	int	tmp_f1;			/* fd for first temp basename */
+	int	tmp_f2;			/* fd for second temp basename */
+	int	sep = pmPathSeparator();
+
+#if HAVE_MKSTEMP
+	strncpy(path, argv[argc-1], sizeof(path));
+	path[sizeof(path)-1] = '\0';
+	strncpy(dname, dirname(path), sizeof(dname));
+	dname[sizeof(dname)-1] = '\0';
+	if ((dir_fd = open(dname, O_RDONLY)) < 0) {
+	    fprintf(stderr, "%s: Error: cannot open directory \"%s\" for reading: %s\n", pmGetProgname(), dname, strerror(errno));
+	    abandon();
+	    /*NOTREACHED*/
+	}
+	pmsprintf(path, sizeof(path), "%s%cXXXXXX", dname, sep);
+	cur_umask = umask(S_IXUSR | S_IRWXG | S_IRWXO);
+	tmp_f1 = mkstemp(path);
+	umask(cur_umask);
+	outarch.name = strdup(path);
+	if (outarch.name == NULL) {
+	    fprintf(stderr, "%s: Error: temp file strdup(%s) failed: %s\n", pmGetProgname(), path, strerror(errno));
+	    abandon();
+	    /*NOTREACHED*/
+	}
+	pmsprintf(bak_base, sizeof(bak_base), "%s%cXXXXXX", dname, sep);
+	cur_umask = umask(S_IXUSR | S_IRWXG | S_IRWXO);
+	tmp_f2 = mkstemp(bak_base);
+	umask(cur_umask);
+#else
+	char	fname[MAXPATHLEN+1];
+	char	*s;
+
+	strncpy(path, argv[argc-1], sizeof(path));
+	path[sizeof(path)-1] = '\0';
+	strncpy(fname, basename(path), sizeof(fname));
+	fname[sizeof(fname)-1] = '\0';
+	strncpy(dname, dirname(path), sizeof(dname));
+	dname[sizeof(dname)-1] = '\0';
+
+	if ((s = tempnam(dname, fname)) == NULL) {
+	    fprintf(stderr, "%s: Error: first tempnam() failed: %s\n", pmGetProgname(), strerror(errno));
+	    abandon();
+	    /*NOTREACHED*/
+	}
+	else {
+	    outarch.name = strdup(s);
+	    if (outarch.name == NULL) {
+		fprintf(stderr, "%s: Error: temp file strdup(%s) failed: %s\n", pmGetProgname(), s, strerror(errno));
+		abandon();
+		/*NOTREACHED*/
+	    }
+	    cur_umask = umask(S_IXUSR | S_IRWXG | S_IRWXO);
+	    tmp_f1 = open(outarch.name, O_WRONLY|O_CREAT|O_EXCL, 0600);
+	    umask(cur_umask);
+	}
+	if ((s = tempnam(dname, fname)) == NULL) {
+	    fprintf(stderr, "%s: Error: second tempnam() failed: %s\n", pmGetProgname(), strerror(errno));
+	    abandon();
+	    /*NOTREACHED*/
+	}
+	else {
+	    strcpy(bak_base, s);
+	    cur_umask = umask(S_IXUSR | S_IRWXG | S_IRWXO);
+	    tmp_f2 = open(bak_base, O_WRONLY|O_CREAT|O_EXCL, 0600);
+	    umask(cur_umask);
+	}
+#endif
+	if (tmp_f1 < 0) {
+	    fprintf(stderr, "%s: Error: create first temp (%s) failed: %s\n", pmGetProgname(), outarch.name, strerror(errno));
+	    abandon();
+	    /*NOTREACHED*/
+	}
+	if (tmp_f2 < 0) {
+	    fprintf(stderr, "%s: Error: create second temp (%s) failed: %s\n", pmGetProgname(), bak_base, strerror(errno));
+	    abandon();
+	    /*NOTREACHED*/
+	}
+	close(tmp_f1);
+	close(tmp_f2);
+	unlink(outarch.name);
+	unlink(bak_base);
+    }
+    else
+	outarch.name = argv[argc-1];
+
+    /*
+     * process config file(s)
+     */
+    for (i = 0; i < nconf; i++) {
+	parseconfig(conf[i]);
+    }
+
+    /*
+     * cross-specification dependencies and semantic checks once all
+     * config files have been processed
+     */
+    link_entries();
+    check_indoms();
+    check_output();
+
+    if (vflag)
+	reportconfig();
+
+    if (Cflag)
+	exit(0);
+
+    if (qflag && anychange() == 0) {
+	if (pmDebugOptions.appl3) {
+	    fprintf(stderr, "Done, no rewriting required\n");
+	}
+	exit(0);
+    }
+
+    if (datachange() == 0 && goodindex()) {
+	/* rules only touch the metadata, data volumes are unchanged */
+	if (pmDebugOptions.appl3)
+	    fprintf(stderr, "Metadata only rewriting\n");
+	rewrite_meta();
+    }
+    else
+	rewrite_all();
 
     if (iflag) {
 	/*
@@ -2017,7 +2240,8 @@ main(int argc, char **argv)
 		abandon();
 		/*NOTREACHED*/
 	}
-	if (__pmFsync(outarch.archctl.ac_mfp) < 0) {
+	if (outarch.archctl.ac_mfp != NULL &&
+	    __pmFsync(outarch.archctl.ac_mfp) < 0) {
 	    fprintf(stderr, "%s: Error: fsync(%d) failed for output data file: %s\n",
 		pmGetProgname(), __pmFileno(outarch.archctl.ac_mfp), strerror(errno));
 		abandon();
@@ -2047,6 +2271,15 @@ main(int argc, char **argv)
 	_pmLogRemove(bak_base, -1);
     }
 
+    if (Mflag) {
+	char	*name = iflag ? inarch.name : outarch.name;
+
+	__pmFflush(outarch.logctl.mdfp);
+	if ((sts = __pmLogWriteMetaIndex(name)) < 0)
+	    fprintf(stderr, "%s: Warning: cannot write metadata index for \"%s\": %s\n",
+		    pmGetProgname(), name, pmErrStr(sts));
+    }
+
     if (pmDebugOptions.pdubuf) {
 	/* dump record buffer state ... looking for mem leaks here */
 	(void)__pmFindPDUBuf(-1);
@@ -22,6 +22,7 @@
 #include <assert.h>
 #include <ctype.h>
 #include <sys/stat.h>
+#include <fcntl.h>
 #include <unistd.h>
 
 void
@@ -303,6 +304,138 @@ smackit:
     return sts;
 }
 
+/*
+ * Copy the file src to dst, when a link is not possible.
+ */
+static int
+copyfile(const char *src, const char *dst)
+{
+    int			in;
+    int			out;
+    int			sts = 0;
+    ssize_t		nread;
+    char		buf[64*1024];
+    struct stat		stbuf;
+
+    if ((in = open(src, O_RDONLY)) < 0)
+	return -oserror();
+    if (fstat(in, &stbuf) < 0 ||
+	(out = open(dst, O_WRONLY|O_CREAT|O_EXCL, stbuf.st_mode & 0777)) < 0) {
+	sts = -oserror();
+	close(in);
+	return sts;
+    }
+    while ((nread = read(in, buf, sizeof(buf))) > 0) {
+	if (write(out, buf, nread) != nread) {
+	    sts = oserror() ? -oserror() : -EIO;
+	    break;
+	}
+    }
+    if (nread < 0)
+	sts = -oserror();
+    if (sts == 0 && fsync(out) < 0)
+	sts = -oserror();
+    close(in);
+    if (close(out) < 0 && sts == 0)
+	sts = -oserror();
+    if (sts < 0)
+	unlink(dst);
+    return sts;
+}
+
+/*
+ * Make the data volumes (but not the .index or .meta files) of the
+ * archive with basename of old also appear with a basename of new,
+ * using a hard link if possible, else a copy.
+ *
+ * Note: also handles compressed versions of files.
+ */
+int
+_pmLogLink(const char *old, const char *new)
+{
+    int			sts;
+    int			nfound = 0;
+    char		*dname;
+    char		*obase;
+    char		*end;
+    char		path[MAXPATHLEN+1];
+    char		opath[MAXPATHLEN+1];
+    char		npath[MAXPATHLEN+1];
+    char		logbase[MAXPATHLEN+1];
+    DIR			*dirp;
+    const char		*p;
+    struct dirent	*dp;
+
+    strncpy(path, old, sizeof(path));
+    path[sizeof(path)-1] = '\0';
+    dname = dirname(path);
+
+    if ((dirp = opendir(dname)) == NULL)
+	return -oserror();
+
+    strncpy(path, old, sizeof(path));
+    path[sizeof(path)-1] = '\0';
+    obase = basename(path);
+
+    for ( ; ; ) {
+	setoserror(0);
+	if ((dp = readdir(dirp)) == NULL)
+	    break;
+
+	/*
+	 * __pmLogBaseName modifies the buffer which is passed to it
+	 * so we need a copy.
+	 */
+	strncpy(logbase, dp->d_name, sizeof(logbase));
+	logbase[sizeof(logbase)-1] = '0';
+	if (__pmLogBaseName(logbase) == NULL)
+	    continue; /* not an archive file */
+
+	if (strcmp(obase, logbase) != 0)
+	    continue; /* Not the same archive */
+
+	/* data volumes are .<n> with an optional compression suffix */
+	p = &dp->d_name[strlen(obase)];
+	if (p[0] != '.' || !isdigit((int)p[1]))
+	    continue;
+	(void)strtol(&p[1], &end, 10);
+	if (*end != '\0' && *end != '.')
+	    continue;
+
+	pmsprintf(opath, sizeof(opath), "%s%s", old, p);
+	pmsprintf(npath, sizeof(npath), "%s%s", new, p);
+	if (link(opath, npath) < 0) {
+	    if (oserror() == EEXIST) {
+		fprintf(stderr, "__pmLogLink: destination file %s already exists\n", npath);
+		sts = PM_ERR_GENERIC;
+		goto cleanup;
+	    }
+	    /* cross-device or no link support, need to copy ... */
+	    if ((sts = copyfile(opath, npath)) < 0) {
+		fprintf(stderr, "__pmLogLink: copy %s -> %s failed: %s\n", opath, npath, pmErrStr(sts));
+		goto cleanup;
+	    }
+	    if (pmDebugOptions.log)
+		fprintf(stderr, "__pmLogLink: copy %s -> %s\n", opath, npath);
+	}
+	else if (pmDebugOptions.log)
+	    fprintf(stderr, "__pmLogLink: link %s -> %s\n", opath, npath);
+	nfound++;
+    }
+
+    if ((sts = oserror()) != 0) {
+	fprintf(stderr, "__pmLogLink: readdir for %s failed: %s\n", dname, pmErrStr(-sts));
+	sts = -sts;
+    }
+    else
+	sts = nfound;
+
+cleanup:
+    closedir(dirp);
+
+    return sts;
+}
+
 char *
 dupcat(const char* s1, const char* s2)
 {
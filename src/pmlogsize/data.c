@@ -114,6 +114,101 @@ cleanup(int all)
 
 }
 
+/*
+ * Load the totals (and for -d, the per-metric counts) for the data
+ * volume fname from the space accounting file written by pmlogger -S
+ * when the volume was closed, adjusted to match the scan in do_data().
+ * Returns 0, or -1 if there is no usable accounting file for the
+ * volume as it is now, in which case the volume must be scanned.
+ */
+static int
+load_sizes(char *fname, int version, long size, long *bytes,
+	long *oheadbytes, int *nrec, int *nmark)
+{
+    __pmFILE	*sf;
+    char	name[MAXPATHLEN];
+    char	sizename[MAXPATHLEN];
+    char	*sbuf = NULL;
+    char	*line, *next;
+    size_t	slen = 0, salloc = 0;
+    long long	volsize, label, vbytes, vohead, mbytes;
+    unsigned int domain, cluster, item;
+    int		vnrec, vnmark, vnmetric;
+    int		mnrec, mnval;
+    int		c, vol, sts = -1;
+    metric_t	*metricp;
+
+    pmstrncpy(name, sizeof(name), fname);
+    __pmLogBaseNameVol(name, &vol);
+    if (vol < 0)
+	return -1;
+    pmsprintf(sizename, sizeof(sizename), "%s.%d%s", name, vol, PM_LOG_SIZE_SUFFIX);
+    if ((sf = __pmFopen(sizename, "r")) == NULL)
+	return -1;
+    /* small, so read it all ... a byte at a time, as for pmlogcheck -k */
+    while ((c = __pmFgetc(sf)) != EOF) {
+	if (slen + 1 >= salloc) {
+	    salloc = salloc ? 2 * salloc : BUFSIZ;
+	    if ((sbuf = (char *)realloc(sbuf, salloc)) == NULL) {
+		fprintf(stderr, "Error: %s realloc(%d) failed\n", sizename, (int)salloc);
+		exit(1);
+	    }
+	}
+	sbuf[slen++] = c;
+    }
+    __pmFclose(sf);
+    if (sbuf == NULL)
+	return -1;
+    sbuf[slen] = '\0';
+
+    if ((line = strtok_r(sbuf, "\n", &next)) == NULL ||
+	strcmp(line, "PCP logsize 1") != 0 ||
+	(line = strtok_r(NULL, "\n", &next)) == NULL ||
+	sscanf(line, "volume %lld %lld %lld %lld %d %d %d", &volsize,
+		&label, &vbytes, &vohead, &vnrec, &vnmark, &vnmetric) != 7 ||
+	volsize != size || vnmetric < 0)
+	goto done;
+
+    if (dflag) {
+	if ((metric_tab = (metric_t *)calloc(vnmetric, sizeof(metric_t))) == NULL && vnmetric > 0) {
+	    fprintf(stderr, "Error: data metric_tab calloc(%d) failed\n", (int)(vnmetric*sizeof(metric_t)));
+	    exit(1);
+	}
+	for (metricp = metric_tab; metricp < &metric_tab[vnmetric]; metricp++) {
+	    if ((line = strtok_r(NULL, "\n", &next)) == NULL ||
+		sscanf(line, "%u.%u.%u %lld %d %d", &domain, &cluster, &item,
+			&mbytes, &mnrec, &mnval) != 6) {
+		nmetric = metricp - metric_tab;
+		cleanup(1);
+		nmetric = 0;
+		metric_tab = NULL;
+		goto done;
+	    }
+	    metricp->pmid = pmID_build(domain, cluster, item);
+	    metricp->bytes = mbytes;
+	    metricp->nrec = mnrec;
+	    metricp->nval = mnval;
+	    metricp->numnames = pmNameAll(metricp->pmid, &metricp->names);
+	}
+	nmetric = vnmetric;
+    }
+
+    /* the scan counts a v3 timestamp as a pmTimespec, not 3 words */
+    if (version >= PM_LOG_VERS03) {
+	vbytes -= (vnrec + vnmark) * (long long)(sizeof(pmTimespec) - 3 * sizeof(__pmPDU));
+	vohead += (vnrec + vnmark) * (long long)(sizeof(pmTimespec) - 3 * sizeof(__pmPDU));
+    }
+    *bytes = vbytes;
+    *oheadbytes = vohead;
+    *nrec = vnrec;
+    *nmark = vnmark;
+    sts = 0;
+
+done:
+    free(sbuf);
+    return sts;
+}
+
 void
 do_data(__pmFILE *f, int version, char *fname)
 {
@@ -152,6 +247,11 @@ do_data(__pmFILE *f, int version, char *fname)
 
     __pmFstat(f, &sbuf);
 
+    if (!rflag && !vflag && ctxp != NULL &&
+	load_sizes(fname, version, sbuf.st_size, &bytes, &oheadbytes,
+		   &nrec, &nmark) == 0)
+	goto report;
+
     while ((sts = __pmFread(&header, 1, sizeof(header), f)) == sizeof(header)) {
 	oheadbytes += sizeof(header);
 	header = ntohl(header);
@@ -363,6 +463,7 @@ do_data(__pmFILE *f, int version, char *fname)
 
     }
 
+report:
     printf("  data: %ld bytes [%.0f%%, %d records",
 	bytes, 100*(float)bytes/sbuf.st_size, nrec);
     if (nmark > 0)
@@ -36,6 +36,7 @@ static pmLongOptions longopts[] = {
     PMOPT_NAMESPACE,
     { "", 0, 'N', 0, "suppress warnings from individual archive fetches (default)" },
     { "precision", 1, 'p', "N", "number of digits to display after the decimal point" },
+    { "threads", 1, 'P', "N", "summarise N time ranges of the archive in parallel" },
     { "sum", 0, 's', 0, "only print the sum of all values of each metric" },
     PMOPT_START,
     PMOPT_FINISH,
@@ -52,7 +53,7 @@ static pmLongOptions longopts[] = {
 static int override(int, pmOptions *);
 static pmOptions opts = {
     .flags = PM_OPTFLAG_DONE | PM_OPTFLAG_BOUNDARIES | PM_OPTFLAG_STDOUT_TZ,
-    .short_options = "abB:D:fFHiIlmMNn:p:rsS:T:vVxyzZ:?",
+    .short_options = "abB:D:fFHiIlmMNn:p:P:rsS:T:vVxyzZ:?",
     .long_options = longopts,
     .short_usage = "[options] archive [metricname ...]",
     .override = override,
@@ -75,6 +76,10 @@ typedef struct {
     int			marked;		/* seen since last "mark" record? */
     unsigned int	bintotal;	/* copy of count for 2nd pass */
     unsigned int	*bin;		/* bins for value distribution */
+    double		firstval;	/* first value in this time range */
+    struct timeval	firststamp;	/* time of first value in this range */
+    int			premarks;	/* range marks seen before firstval */
+    struct timeval	ratestamp;	/* time of first counter rate */
 } instData;
 
 typedef struct {
@@ -85,10 +90,27 @@ typedef struct {
 } aveData;
 
 /*
- * Hash control for statistics & errors related to each metric
+ * Statistics for each metric over the archive, or over one of the
+ * time ranges the archive is split into when summarising in parallel
+ * (see summarise_ranges()) ... for all but the first range, the time
+ * of each mark record is kept for merging
+ */
+typedef struct {
+    __pmHashCtl		hashlist;	/* aveData for each metric */
+    int			partial;	/* not the first time range */
+    int			nmarks;		/* mark records seen */
+    struct timeval	*marks;		/* when, if partial */
+} summary_t;
+
+static summary_t	summary;
+
+/*
+ * Hash control for errors related to each metric
  */
-static __pmHashCtl	hashlist;
 static __pmHashCtl	errlist;
+#ifdef PM_MULTI_THREAD
+static pthread_mutex_t	errlist_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
 
 /* output format flags */
 static unsigned int	stocaveflag;	/* no stochastic counter ave */
@@ -103,6 +125,7 @@ static unsigned int	warnflag;	/* warnings are off by default */
 static unsigned int	delimiter = ' ';/* output field separator */
 static unsigned int	nbins;		/* number of distribution bins */
 static unsigned int	precision = 3;	/* number of digits after "." */
+static int		nthreads = 1;	/* time ranges summarised in parallel */
 
 /* time window stuff */
 static int		dayflag;
@@ -141,7 +164,12 @@ tadd(struct timeval *a, struct timeval *b)
 static void
 pmiderr(pmID pmid, const char *msg, ...)
 {
-    if (warnflag && __pmHashSearch(pmid, &errlist) == NULL) {
+    if (!warnflag)
+	return;
+#ifdef PM_MULTI_THREAD
+    pthread_mutex_lock(&errlist_lock);
+#endif
+    if (__pmHashSearch(pmid, &errlist) == NULL) {
 	va_list	arg;
 	int	numnames;
 	char	**names;
@@ -156,6 +184,9 @@ pmiderr(pmID pmid, const char *msg, ...)
 	__pmHashAdd(pmid, NULL, &errlist);
 	if (numnames > 0) free(names);
     }
+#ifdef PM_MULTI_THREAD
+    pthread_mutex_unlock(&errlist_lock);
+#endif
 }
 
 static void
@@ -270,7 +301,7 @@ printsummary(const char *name)
     }
 
     /* lookup using pmid, print values according to set flags */
-    if ((hptr = __pmHashSearch(pmid, &hashlist)) != NULL) {
+    if ((hptr = __pmHashSearch(pmid, &summary.hashlist)) != NULL) {
 	avedata = (aveData*)hptr->data;
 	for (i = 0; i < avedata->listsize; i++) {
 	    if ((instdata = avedata->instlist[i]) == NULL)
@@ -373,7 +404,7 @@ printsummary(const char *name)
 	    }
 	}
 	if (avedata->instlist) free(avedata->instlist);
-	__pmHashDel(avedata->desc.pmid, (void*)avedata, &hashlist);
+	__pmHashDel(avedata->desc.pmid, (void*)avedata, &summary.hashlist);
 	free(avedata);
     }
 }
@@ -410,7 +441,8 @@ unwrap(double current, double previous, int pmtype)
 }
 
 static void
-newHashInst(pmValue *vp,
+newHashInst(summary_t *sp,
+	pmValue *vp,
 	aveData *avedata,		/* updated by this function */
 	int valfmt,
 	struct timeval *timestamp,	/* timestamp for this sample */
@@ -470,6 +502,9 @@ newHashInst(pmValue *vp,
     instdata->lastval = av.d;
     instdata->firsttime = *timestamp;
     instdata->lasttime = *timestamp;
+    instdata->firstval = av.d;
+    instdata->firststamp = *timestamp;
+    instdata->premarks = sp->nmarks;
     avedata->listsize++;
     if (pmDebugOptions.appl0) {
 	int	numnames;
@@ -483,7 +518,8 @@ newHashInst(pmValue *vp,
 }
 
 static void
-newHashItem(pmValueSet *vsp,
+newHashItem(summary_t *sp,
+	pmValueSet *vsp,
 	pmDesc *desc,
 	aveData *avedata,		/* output from this function */
 	struct timeval *timestamp)	/* timestamp for this sample */
@@ -513,7 +549,7 @@ newHashItem(pmValueSet *vsp,
     avedata->listsize = 0;
     avedata->instlist = NULL;
     for (j = 0; j < vsp->numval; j++)
-	newHashInst(&vsp->vlist[j], avedata, vsp->valfmt, timestamp, j);
+	newHashInst(sp, &vsp->vlist[j], avedata, vsp->valfmt, timestamp, j);
 }
 
 /*
@@ -549,44 +585,60 @@ findbin(pmID pmid, double val, double min, double max)
     return index;
 }
 
+/*
+ * extend discrete metrics to a mark record, and note that one has been
+ * seen since the last fetch for this instance
+ */
+static void
+markinst(aveData *avedata, instData *instdata, struct timeval *stamp)
+{
+    double		val;
+    struct timeval	timediff;
+
+    if (avedata->desc.sem == PM_SEM_DISCRETE) {
+	/* extend discrete metrics to the mark point */
+	timediff = *stamp;
+	tsub(&timediff, &instdata->lasttime);
+	val = instdata->lastval;
+	instdata->stocave += val;
+	instdata->timeave += val*pmtimevalToReal(&timediff);
+	instdata->lasttime = *stamp;
+	instdata->count++;
+    }
+    instdata->marked = 1;
+    instdata->markcount++;
+}
+
 /*
  * must keep a note for every instance of every metric whenever a mark
  * record has been seen between now & the last fetch for that instance
  */
 static void
-markrecord(pmResult *result)
+markrecord(summary_t *sp, pmResult *result)
 {
     int			i, j;
+    size_t		size;
     __pmHashNode	*hptr;
     aveData		*avedata;
-    instData		*instdata;
-    double		val;
-    struct timeval	timediff;
 
     if (pmDebugOptions.appl0) {
 	printstamp(&result->timestamp, '\n');
 	printf(" - mark record\n\n");
     }
-    for (i = 0; i < hashlist.hsize; i++) {
-	for (hptr = hashlist.hash[i]; hptr != NULL; hptr = hptr->next) {
+    for (i = 0; i < sp->hashlist.hsize; i++) {
+	for (hptr = sp->hashlist.hash[i]; hptr != NULL; hptr = hptr->next) {
 	    avedata = (aveData *)hptr->data;
-	    for (j = 0; j < avedata->listsize; j++) {
-		instdata = avedata->instlist[j];
-		if (avedata->desc.sem == PM_SEM_DISCRETE) {
-		    /* extend discrete metrics to the mark point */
-		    timediff = result->timestamp;
-		    tsub(&timediff, &instdata->lasttime);
-		    val = instdata->lastval;
-		    instdata->stocave += val;
-		    instdata->timeave += val*pmtimevalToReal(&timediff);
-		    instdata->lasttime = result->timestamp;
-		    instdata->count++;
-		}
-		instdata->marked = 1;
-		instdata->markcount++;
-	    }
+	    for (j = 0; j < avedata->listsize; j++)
+		markinst(avedata, avedata->instlist[j], &result->timestamp);
 	}
     }
+    if (sp->partial) {
+	size = (sp->nmarks+1) * sizeof(struct timeval);
+	if ((sp->marks = (struct timeval *)realloc(sp->marks, size)) == NULL)
+	    pmNoMem("markrecord.marks", size, PM_FATAL_ERR);
+	sp->marks[sp->nmarks] = result->timestamp;
+    }
+    sp->nmarks++;
 }
 
 static void
@@ -607,7 +659,7 @@ calcbinning(pmResult *result)
     struct timeval	timediff;
 
     if (result->numpmid == 0)	/* mark record */
-	markrecord(result);
+	markrecord(&summary, result);
 
     for (i = 0; i < result->numpmid; i++) {
 	vsp = result->vset[i];
@@ -618,7 +670,7 @@ calcbinning(pmResult *result)
 	    continue;
 	}
 
-	if ((hptr = __pmHashSearch(vsp->pmid, &hashlist)) != NULL) {
+	if ((hptr = __pmHashSearch(vsp->pmid, &summary.hashlist)) != NULL) {
 	    avedata = (aveData *)hptr->data;
 	    for (j = 0; j < vsp->numval; j++) {	/* iterate thro result values */
 		int	fp_bad;
@@ -713,13 +765,191 @@ calcbinning(pmResult *result)
     }
 }
 
+/*
+ * update the statistics for an instance with the next value
+ */
 static void
-calcaverage(pmResult *result)
+updateinst(aveData *avedata, instData *instdata, double value, struct timeval *stamp)
 {
-    int			i, j, k;
-    int			sts;
     int			wrap;
+    int			fp_bad;
     double		val;
+    double		diff;
+    double		rate = 0;
+    struct timeval	timediff;
+
+    fp_bad = 0;
+#ifdef HAVE_FPCLASSIFY
+    fp_bad = fpclassify(value) == FP_NAN;
+#else
+#ifdef HAVE_ISNAN
+    fp_bad = isnan(value);
+#endif
+#endif
+    if (fp_bad)
+	return;
+    timediff = *stamp;
+    tsub(&timediff, &instdata->lasttime);
+    diff = pmtimevalToReal(&timediff);
+    wrap = 0;
+    if (avedata->desc.sem == PM_SEM_COUNTER) {
+	diff *= avedata->scale;
+	if (diff == 0.0) return;
+	if (instdata->marked)
+	    val = value;
+	else
+	    val = unwrap(value, instdata->lastval, avedata->desc.type);
+	if (pmDebugOptions.appl0) {
+	    int	numnames;
+	    char	**names;
+	    numnames = pmNameAll(avedata->desc.pmid, &names);
+	    __pmPrintMetricNames(stderr, numnames, names, " or ");
+	    fprintf(stderr, " base value is %f, count %d\n",
+		    val, instdata->count+1);
+	    if (numnames > 0) free(names);
+	}
+	if (instdata->marked || val < instdata->lastval) {
+	    /* either previous record was a "mark", or this is not */
+	    /* the first one, and counter not monotonic increasing */
+	    if (pmDebugOptions.appl1) {
+		int	numnames;
+		char	**names;
+		numnames = pmNameAll(avedata->desc.pmid, &names);
+		__pmPrintMetricNames(stderr, numnames, names, " or ");
+		fprintf(stderr, " counter wrapped or <mark>\n");
+		if (numnames > 0) free(names);
+	    }
+	    wrap = 1;
+	    instdata->marked = 0;
+	    tadd(&instdata->firsttime, stamp);
+	    tsub(&instdata->firsttime, &instdata->lasttime);
+	}
+	else {
+	    rate = (val - instdata->lastval) / diff;
+	    instdata->stocave += rate;
+	    if (!instdata->marked)
+		instdata->timeave += (val - instdata->lastval);
+	    else {
+		instdata->marked = 0;
+		/* remove the timeslice in question from time-based calc */
+		tadd(&instdata->firsttime, stamp);
+		tsub(&instdata->firsttime, &instdata->lasttime);
+	    }
+	    if (instdata->count == 0) {		/* 1st time */
+		instdata->min = instdata->max = rate;
+		instdata->sum = (val - instdata->lastval);
+		instdata->ratestamp = *stamp;
+	    }
+	    else {
+		if (pmDebugOptions.appl2) {
+		    int	numnames;
+		    char	**names;
+		    char	*istr = NULL;
+
+		    numnames = pmNameAll(avedata->desc.pmid, &names);
+		    if (pmNameInDomArchive(avedata->desc.indom,
+			instdata->inst, &istr) < 0)
+			istr = NULL;
+		    if (rate < instdata->min) {
+			fprintf(stderr, "new min value for ");
+			__pmPrintMetricNames(stderr, numnames, names, " or ");
+			fprintf(stderr, " (inst[%s]: %f) at ",
+			    (istr == NULL ? "":istr), rate);
+			pmPrintStamp(stderr, stamp);
+			fprintf(stderr, "\n");
+		    }
+		    if (rate > instdata->max) {
+			fprintf(stderr, "new max value for ");
+			__pmPrintMetricNames(stderr, numnames, names, " or ");
+			fprintf(stderr, " (inst[%s]: %f) at ",
+			    (istr == NULL ? "":istr), rate);
+			pmPrintStamp(stderr, stamp);
+			fprintf(stderr, "\n");
+		    }
+		    if (numnames > 0) free(names);
+		    if (istr) free(istr);
+		}
+		if (rate < instdata->min) {
+		    instdata->min = rate;
+		    instdata->mintime = *stamp;
+		}
+		if (rate > instdata->max) {
+		    instdata->max = rate;
+		    instdata->maxtime = *stamp;
+		}
+		instdata->sum += (val - instdata->lastval);
+	    }
+	}
+    }
+    else {	/* for the other semantics - discrete & instantaneous */
+	val = value;
+	instdata->sum += val;
+	instdata->stocave += val;
+	if (val < instdata->min) {
+	    instdata->min = val;
+	    instdata->mintime = *stamp;
+	}
+	if (val > instdata->max) {
+	    instdata->max = val;
+	    instdata->maxtime = *stamp;
+	}
+	if (!instdata->marked)
+	    instdata->timeave += instdata->lastval*diff;
+	else {
+	    instdata->marked = 0;
+	    /* remove the timeslice in question from time-based calc */
+	    tadd(&instdata->firsttime, stamp);
+	    tsub(&instdata->firsttime, &instdata->lasttime);
+	}
+    }
+    if (!wrap) {
+	instdata->count++;
+	if (pmDebugOptions.appl1 &&
+	    (avedata->desc.sem != PM_SEM_COUNTER || instdata->count > 0)) {
+	    int	numnames;
+	    char	**names;
+	    double	metricspan = 0.0;
+	    struct timeval	metrictimespan;
+
+	    metrictimespan = *stamp;
+	    tsub(&metrictimespan, &instdata->firsttime);
+	    metricspan = pmtimevalToReal(&metrictimespan);
+	    numnames = pmNameAll(avedata->desc.pmid, &names);
+	    fprintf(stderr, "++ ");
+	    __pmPrintMetricNames(stderr, numnames, names, " or ");
+
+	    if (avedata->desc.sem == PM_SEM_COUNTER) {
+		fprintf(stderr, " timedelta=%f count=%d\n"
+				"sum=%f min=%f max=%f stocsum=%f\n"
+				"rate=%f timesum=%f (+%f) timespan=%f\n",
+			diff, instdata->count, instdata->sum,
+			instdata->min, instdata->max,
+			instdata->stocave, rate, instdata->timeave,
+			diff * (val - instdata->lastval) / 2,
+			metricspan);
+	    }
+	    else {	/* non-counters */
+		fprintf(stderr, " timedelta=%f count=%d\n"
+				"sum=%f min=%f max=%f stocsum=%f\n"
+				"lastval=%f timesum=%f (+%f) timespan=%f\n",
+			diff, instdata->count, instdata->sum,
+			instdata->min, instdata->max,
+			instdata->stocave, instdata->lastval,
+			instdata->timeave, instdata->lastval*diff,
+			metricspan);
+	    }
+	    if (numnames > 0) free(names);
+	}
+    }
+    instdata->lastval = value;
+    instdata->lasttime = *stamp;
+}
+
+static void
+calcaverage(summary_t *sp, pmResult *result)
+{
+    int			i, j, k;
+    int			sts;
     pmDesc		desc;
     pmAtomValue 	av;
     pmValue		*vp;
@@ -727,12 +957,9 @@ calcaverage(pmResult *result)
     __pmHashNode	*hptr = NULL;
     aveData		*avedata = NULL;
     instData		*instdata;
-    double		diff;
-    double		rate = 0;
-    struct timeval	timediff;
 
     if (result->numpmid == 0)	/* mark record */
-	markrecord(result);
+	markrecord(sp, result);
 
     for (i = 0; i < result->numpmid; i++) {
 	vsp = result->vset[i];
@@ -744,7 +971,7 @@ calcaverage(pmResult *result)
 	}
 
 	/* check if pmid already in hash list */
-	if ((hptr = __pmHashSearch(vsp->pmid, &hashlist)) == NULL) {
+	if ((hptr = __pmHashSearch(vsp->pmid, &sp->hashlist)) == NULL) {
 	    if ((sts = pmLookupDesc(vsp->pmid, &desc)) < 0) {
 		pmiderr(vsp->pmid, "cannot find descriptor: %s\n", pmErrStr(sts));
 		continue;
@@ -758,8 +985,8 @@ calcaverage(pmResult *result)
 
 	    /* create a new one & add to list */
 	    avedata = (aveData*) malloc(sizeof(aveData));
-	    newHashItem(vsp, &desc, avedata, &result->timestamp);
-	    if (__pmHashAdd(avedata->desc.pmid, (void*)avedata, &hashlist) < 0) {
+	    newHashItem(sp, vsp, &desc, avedata, &result->timestamp);
+	    if (__pmHashAdd(avedata->desc.pmid, (void*)avedata, &sp->hashlist) < 0) {
 		pmiderr(avedata->desc.pmid, "failed %s hash table insertion\n", pmGetProgname());
 		/* free memory allocated above on insert failure */
 		for (j = 0; j < vsp->numval; j++)
@@ -771,7 +998,6 @@ calcaverage(pmResult *result)
 	else {	/* pmid exists - update statistics */
 	    avedata = (aveData*)hptr->data;
 	    for (j = 0; j < vsp->numval; j++) {	/* iterate thro result values */
-		int	fp_bad;
 		vp = &vsp->vlist[j];
 		k = j;	/* index into stored inst list, result may differ */
 		if ((vsp->numval > 1) || (avedata->desc.indom != PM_INDOM_NULL)) {
@@ -783,13 +1009,13 @@ calcaverage(pmResult *result)
 			    }
 			}
 			if (k == avedata->listsize) {	/* no matching inst was found */
-			    newHashInst(vp, avedata, vsp->valfmt, &result->timestamp, k);
+			    newHashInst(sp, vp, avedata, vsp->valfmt, &result->timestamp, k);
 			    continue;
 			}
 		    }
 		    else if (k >= avedata->listsize) {
 			k = avedata->listsize;
-			newHashInst(vp, avedata, vsp->valfmt, &result->timestamp, k);
+			newHashInst(sp, vp, avedata, vsp->valfmt, &result->timestamp, k);
 			continue;
 		    }
 		}
@@ -799,175 +1025,289 @@ calcaverage(pmResult *result)
 		    pmiderr(avedata->desc.pmid, "failed to extract value: %s\n", pmErrStr(sts));
 		    continue;
 		}
-		fp_bad = 0;
-#ifdef HAVE_FPCLASSIFY
-		fp_bad = fpclassify(av.d) == FP_NAN;
-#else
-#ifdef HAVE_ISNAN
-		fp_bad = isnan(av.d);
-#endif
-#endif
-		if (fp_bad)
+		updateinst(avedata, instdata, av.d, &result->timestamp);
+	    }
+	}
+    }
+}
+
+/*
+ * find the statistics for instance inst of a metric, if any ... as
+ * in calcaverage(), the instance of a singular metric is not checked
+ */
+static instData *
+findinst(aveData *avedata, int inst)
+{
+    int		k;
+
+    if (avedata->desc.indom == PM_INDOM_NULL && avedata->listsize == 1)
+	return avedata->instlist[0];
+    for (k = 0; k < avedata->listsize; k++) {
+	if (avedata->instlist[k]->inst == inst)
+	    return avedata->instlist[k];
+    }
+    return NULL;
+}
+
+/*
+ * merge the statistics b for an instance from one time range into a,
+ * the statistics from all earlier time ranges ... the result is the
+ * same as processing all the values in the one pass
+ */
+static void
+mergeinst(aveData *avedata, instData *a, instData *b, struct timeval *marks)
+{
+    struct timeval	shift;
+    int			first;
+    int			m;
+
+    /* mark records in b's range before b's first value */
+    for (m = 0; m < b->premarks; m++)
+	markinst(avedata, a, &marks[m]);
+
+    /* the step from a's last value to b's first value */
+    updateinst(avedata, a, b->firstval, &b->firststamp);
+
+    /* then everything after b's first value */
+    if (avedata->desc.sem == PM_SEM_COUNTER) {
+	/*
+	 * the first rate of a counter does not move mintime or maxtime,
+	 * but b's first rate is not the first rate overall
+	 */
+	if (b->count > 0) {
+	    first = (pmtimevalSub(&b->mintime, &b->firststamp) == 0);
+	    if (a->count == 0) {
+		a->min = b->min;
+		if (!first)
+		    a->mintime = b->mintime;
+	    }
+	    else if (b->min < a->min) {
+		a->min = b->min;
+		a->mintime = first ? b->ratestamp : b->mintime;
+	    }
+	    first = (pmtimevalSub(&b->maxtime, &b->firststamp) == 0);
+	    if (a->count == 0) {
+		a->max = b->max;
+		if (!first)
+		    a->maxtime = b->maxtime;
+	    }
+	    else if (b->max > a->max) {
+		a->max = b->max;
+		a->maxtime = first ? b->ratestamp : b->maxtime;
+	    }
+	}
+	a->sum += b->sum;
+	a->stocave += b->stocave;
+	a->count += b->count;
+    }
+    else {	/* b's first value is already included in a */
+	if (b->min < a->min) {
+	    a->min = b->min;
+	    a->mintime = b->mintime;
+	}
+	if (b->max > a->max) {
+	    a->max = b->max;
+	    a->maxtime = b->maxtime;
+	}
+	a->sum += b->sum - b->firstval;
+	a->stocave += b->stocave - b->firstval;
+	a->count += b->count - 1;
+    }
+    a->timeave += b->timeave;
+    /* timeslices removed from b's time-based calc */
+    shift = b->firsttime;
+    tsub(&shift, &b->firststamp);
+    tadd(&a->firsttime, &shift);
+    a->lastval = b->lastval;
+    a->lasttime = b->lasttime;
+    a->marked = b->marked;
+    a->markcount += b->markcount;
+}
+
+/*
+ * merge the statistics from a later time range into sp
+ */
+static void
+mergesummary(summary_t *sp, summary_t *later)
+{
+    int			i, j, m;
+    size_t		size;
+    __pmHashNode	*hptr;
+    __pmHashNode	*lhptr;
+    aveData		*avedata;
+    aveData		*lavedata;
+    instData		*instdata;
+    instData		*linstdata;
+
+    /*
+     * instances not seen in the later range only see its mark records
+     */
+    for (i = 0; i < sp->hashlist.hsize; i++) {
+	for (hptr = sp->hashlist.hash[i]; hptr != NULL; hptr = hptr->next) {
+	    avedata = (aveData *)hptr->data;
+	    lhptr = __pmHashSearch(avedata->desc.pmid, &later->hashlist);
+	    lavedata = lhptr ? (aveData *)lhptr->data : NULL;
+	    for (j = 0; j < avedata->listsize; j++) {
+		instdata = avedata->instlist[j];
+		if (lavedata && findinst(lavedata, instdata->inst) != NULL)
 		    continue;
-		timediff = result->timestamp;
-		tsub(&timediff, &instdata->lasttime);
-		diff = pmtimevalToReal(&timediff);
-		wrap = 0;
-		if (avedata->desc.sem == PM_SEM_COUNTER) {
-		    diff *= avedata->scale;
-		    if (diff == 0.0) continue;
-		    if (instdata->marked)
-			val = av.d;
-		    else
-			val = unwrap(av.d, instdata->lastval, avedata->desc.type);
-		    if (pmDebugOptions.appl0) {
-			int	numnames;
-			char	**names;
-			numnames = pmNameAll(avedata->desc.pmid, &names);
-			__pmPrintMetricNames(stderr, numnames, names, " or ");
-			fprintf(stderr, " base value is %f, count %d\n",
-				val, instdata->count+1);
-			if (numnames > 0) free(names);
-		    }
-		    if (instdata->marked || val < instdata->lastval) {
-			/* either previous record was a "mark", or this is not */
-			/* the first one, and counter not monotonic increasing */
-			if (pmDebugOptions.appl1) {
-			    int	numnames;
-			    char	**names;
-			    numnames = pmNameAll(avedata->desc.pmid, &names);
-			    __pmPrintMetricNames(stderr, numnames, names, " or ");
-			    fprintf(stderr, " counter wrapped or <mark>\n");
-			    if (numnames > 0) free(names);
-			}
-			wrap = 1;
-			instdata->marked = 0;
-			tadd(&instdata->firsttime, &result->timestamp);
-			tsub(&instdata->firsttime, &instdata->lasttime);
-		    }
-		    else {
-			rate = (val - instdata->lastval) / diff;
-			instdata->stocave += rate;
-			if (!instdata->marked)
-			    instdata->timeave += (val - instdata->lastval);
-			else {
-			    instdata->marked = 0;
-			    /* remove the timeslice in question from time-based calc */
-			    tadd(&instdata->firsttime, &result->timestamp);
-			    tsub(&instdata->firsttime, &instdata->lasttime);
-			}
-			if (instdata->count == 0) {		/* 1st time */
-			    instdata->min = instdata->max = rate;
-			    instdata->sum = (val - instdata->lastval);
-			}
-			else {
-			    if (pmDebugOptions.appl2) {
-				int	numnames;
-				char	**names;
-				char	*istr = NULL;
-
-				numnames = pmNameAll(avedata->desc.pmid, &names);
-				if (pmNameInDomArchive(avedata->desc.indom,
-				    instdata->inst, &istr) < 0)
-				    istr = NULL;
-				if (rate < instdata->min) {
-				    fprintf(stderr, "new min value for ");
-				    __pmPrintMetricNames(stderr, numnames, names, " or ");
-				    fprintf(stderr, " (inst[%s]: %f) at ",
-					(istr == NULL ? "":istr), rate);
-				    pmPrintStamp(stderr, &result->timestamp);
-				    fprintf(stderr, "\n");
-				}
-				if (rate > instdata->max) {
-				    fprintf(stderr, "new max value for ");
-				    __pmPrintMetricNames(stderr, numnames, names, " or ");
-				    fprintf(stderr, " (inst[%s]: %f) at ",
-					(istr == NULL ? "":istr), rate);
-				    pmPrintStamp(stderr, &result->timestamp);
-				    fprintf(stderr, "\n");
-				}
-				if (numnames > 0) free(names);
-				if (istr) free(istr);
-			    }
-			    if (rate < instdata->min) {
-				instdata->min = rate;
-				instdata->mintime = result->timestamp;
-			    }
-			    if (rate > instdata->max) {
-				instdata->max = rate;
-				instdata->maxtime = result->timestamp;
-			    }
-			    instdata->sum += (val - instdata->lastval);
-			}
-		    }
-		}
-		else {	/* for the other semantics - discrete & instantaneous */
-		    val = av.d;
-		    instdata->sum += val;
-		    instdata->stocave += val;
-		    if (val < instdata->min) {
-			instdata->min = val;
-			instdata->mintime = result->timestamp;
-		    }
-		    if (val > instdata->max) {
-			instdata->max = val;
-			instdata->maxtime = result->timestamp;
-		    }
-		    if (!instdata->marked)
-			instdata->timeave += instdata->lastval*diff;
-		    else {
-			instdata->marked = 0;
-			/* remove the timeslice in question from time-based calc */
-			tadd(&instdata->firsttime, &result->timestamp);
-			tsub(&instdata->firsttime, &instdata->lasttime);
-		    }
-		}
-		if (!wrap) {
-		    instdata->count++;
-		    if (pmDebugOptions.appl1 &&
-			(avedata->desc.sem != PM_SEM_COUNTER || instdata->count > 0)) {
-			int	numnames;
-			char	**names;
-			double	metricspan = 0.0;
-			struct timeval	metrictimespan;
-
-			metrictimespan = result->timestamp;
-			tsub(&metrictimespan, &instdata->firsttime);
-			metricspan = pmtimevalToReal(&metrictimespan);
-			numnames = pmNameAll(avedata->desc.pmid, &names);
-			fprintf(stderr, "++ ");
-			__pmPrintMetricNames(stderr, numnames, names, " or ");
+		for (m = 0; m < later->nmarks; m++)
+		    markinst(avedata, instdata, &later->marks[m]);
+	    }
+	}
+    }
 
-			if (avedata->desc.sem == PM_SEM_COUNTER) {
-			    fprintf(stderr, " timedelta=%f count=%d\n"
-					    "sum=%f min=%f max=%f stocsum=%f\n"
-					    "rate=%f timesum=%f (+%f) timespan=%f\n",
-				    diff, instdata->count, instdata->sum,
-				    instdata->min, instdata->max,
-				    instdata->stocave, rate, instdata->timeave,
-				    diff * (val - instdata->lastval) / 2,
-				    metricspan);
-			}
-			else {	/* non-counters */
-			    fprintf(stderr, " timedelta=%f count=%d\n"
-					    "sum=%f min=%f max=%f stocsum=%f\n"
-					    "lastval=%f timesum=%f (+%f) timespan=%f\n",
-				    diff, instdata->count, instdata->sum,
-				    instdata->min, instdata->max,
-				    instdata->stocave, instdata->lastval,
-				    instdata->timeave, instdata->lastval*diff,
-				    metricspan);
-			}
-			if (numnames > 0) free(names);
-		    }
+    for (i = 0; i < later->hashlist.hsize; i++) {
+	for (lhptr = later->hashlist.hash[i]; lhptr != NULL; lhptr = lhptr->next) {
+	    lavedata = (aveData *)lhptr->data;
+	    if ((hptr = __pmHashSearch(lavedata->desc.pmid, &sp->hashlist)) == NULL) {
+		/* new metric in the later range, take it as is */
+		if (__pmHashAdd(lavedata->desc.pmid, (void *)lavedata, &sp->hashlist) < 0) {
+		    pmiderr(lavedata->desc.pmid, "failed %s hash table insertion\n", pmGetProgname());
+		    continue;
 		}
-		instdata->lastval = av.d;
-		instdata->lasttime = result->timestamp;
+		continue;
+	    }
+	    avedata = (aveData *)hptr->data;
+	    for (j = 0; j < lavedata->listsize; j++) {
+		linstdata = lavedata->instlist[j];
+		if ((instdata = findinst(avedata, linstdata->inst)) == NULL) {
+		    /* new instance in the later range, take it as is */
+		    size = (avedata->listsize+1) * sizeof(instData *);
+		    avedata->instlist = (instData **)realloc(avedata->instlist, size);
+		    if (avedata->instlist == NULL)
+			pmNoMem("mergesummary.instlist", size, PM_FATAL_ERR);
+		    avedata->instlist[avedata->listsize++] = linstdata;
+		    continue;
+		}
+		mergeinst(avedata, instdata, linstdata, later->marks);
+		if (linstdata->bin)
+		    free(linstdata->bin);
+		free(linstdata);
 	    }
+	    if (lavedata->instlist)
+		free(lavedata->instlist);
+	    free(lavedata);
+	}
+    }
+    __pmHashClear(&later->hashlist);
+    sp->nmarks += later->nmarks;
+    if (later->marks)
+	free(later->marks);
+}
+
+#ifdef PM_MULTI_THREAD
+typedef struct {
+    int			ctx;		/* own context for this range */
+    int			last;		/* last range, finish is inclusive */
+    struct timeval	start;		/* start of range */
+    struct timeval	finish;		/* end of range */
+    int			sts;		/* PM_ERR_EOL or error */
+    pthread_t		tid;
+    summary_t		summary;
+} range_t;
+
+static void *
+summarise_range(void *arg)
+{
+    range_t		*rp = (range_t *)arg;
+    pmResult		*result;
+    int			sts;
+
+    if ((sts = pmUseContext(rp->ctx)) < 0 ||
+	(sts = pmSetMode(PM_MODE_FORW, &rp->start, 0)) < 0) {
+	rp->sts = sts;
+	return NULL;
+    }
+    for ( ; ; ) {
+	if ((sts = pmFetchArchive(&result)) < 0)
+	    break;
+	if (pmtimevalSub(&result->timestamp, &rp->finish) < 0 ||
+	    (rp->last && pmtimevalSub(&result->timestamp, &rp->finish) == 0)) {
+	    calcaverage(&rp->summary, result);
+	    pmFreeResult(result);
+	}
+	else {
+	    pmFreeResult(result);
+	    sts = PM_ERR_EOL;
+	    break;
 	}
     }
+    rp->sts = sts;
+    return NULL;
 }
 
+/*
+ * the first pass (averages, minima, maxima, etc) over the archive
+ * split into nthreads time ranges of equal length, each summarised
+ * in its own thread with its own context, then merged in time order
+ * ... returns PM_ERR_EOL, or an error from the first range that had
+ * one
+ */
+static int
+summarise_ranges(const char *archive, int ctx)
+{
+    range_t		*ranges;
+    double		start = pmtimevalToReal(&opts.start);
+    double		step = logspan / nthreads;
+    int			i;
+    int			sts;
+
+    if ((ranges = (range_t *)calloc(nthreads, sizeof(range_t))) == NULL) {
+	pmNoMem("summarise_ranges", nthreads * sizeof(range_t), PM_FATAL_ERR);
+	/* NOTREACHED */
+    }
+    for (i = 0; i < nthreads; i++) {
+	if ((ranges[i].ctx = pmNewContext(PM_CONTEXT_ARCHIVE, archive)) < 0) {
+	    fprintf(stderr, "%s: Cannot open archive \"%s\": %s\n",
+		    pmGetProgname(), archive, pmErrStr(ranges[i].ctx));
+	    exit(1);
+	}
+	if (i == 0)
+	    ranges[i].start = opts.start;
+	else
+	    pmtimevalFromReal(start + i * step, &ranges[i].start);
+	if (i > 0)
+	    ranges[i-1].finish = ranges[i].start;
+	ranges[i].summary.partial = (i > 0);
+    }
+    ranges[nthreads-1].finish = opts.finish;
+    ranges[nthreads-1].last = 1;
+    pmUseContext(ctx);
+
+    for (i = 0; i < nthreads; i++) {
+	if ((sts = pthread_create(&ranges[i].tid, NULL, summarise_range, &ranges[i])) != 0) {
+	    fprintf(stderr, "%s: Error: cannot create thread: %s\n",
+		    pmGetProgname(), strerror(sts));
+	    exit(1);
+	}
+    }
+    sts = PM_ERR_EOL;
+    for (i = 0; i < nthreads; i++) {
+	pthread_join(ranges[i].tid, NULL);
+	if (sts == PM_ERR_EOL)
+	    sts = ranges[i].sts;
+	if (i == 0)
+	    summary = ranges[i].summary;	/* struct assignment */
+	else
+	    mergesummary(&summary, &ranges[i].summary);
+	pmDestroyContext(ranges[i].ctx);
+    }
+    pmUseContext(ctx);
+    free(ranges);
+
+    return sts;
+}
+#else /* !PM_MULTI_THREAD */
+static int
+summarise_ranges(const char *archive, int ctx)
+{
+    (void)archive;
+    (void)ctx;
+    return PM_ERR_THREAD;
+}
+#endif /* PM_MULTI_THREAD */
+
 static int
 override(int opt, pmOptions *optsp)
 {
@@ -1056,6 +1396,15 @@ main(int argc, char *argv[])
 	    }
 	    break;
 
+	case 'P':	/* number of time ranges to summarise in parallel */
+	    nthreads = (int)strtol(opts.optarg, &endnum, 10);
+	    if (*endnum != '\0' || nthreads < 1) {
+		pmprintf("%s: -P requires positive numeric argument\n",
+			pmGetProgname());
+		opts.errors++;
+	    }
+	    break;
+
 	case 's':	/* print sums (and only sums) */
 	    stocaveflag = timeaveflag = lflag = countflag = minflag = maxflag = 0;
 	    sumflag = 1;
@@ -1125,8 +1474,21 @@ main(int argc, char *argv[])
     if (timespan.tv_sec > 86400) /* seconds per day: 60*60*24 */
 	dayflag = 1;
 
+    /*
+     * summarise time ranges in parallel only when the archive end is
+     * known, and not when diagnostics are being reported
+     */
+#ifndef PM_MULTI_THREAD
+    nthreads = 1;
+#endif
+    if (opts.finish.tv_sec == PM_MAX_TIME_T || logspan <= 0 ||
+	pmDebugOptions.appl0 || pmDebugOptions.appl1 || pmDebugOptions.appl2)
+	nthreads = 1;
+
     for (trip = 0; trip < 2; trip++) {	/* two passes if binning */
-	for ( ; ; ) {
+	if (trip == 0 && nthreads > 1)
+	    sts = summarise_ranges(archive, c);
+	else for ( ; ; ) {
 	    if ((sts = pmFetchArchive(&result)) < 0)
 		break;
 
@@ -1134,7 +1496,7 @@ main(int argc, char *argv[])
 		(opts.finish.tv_sec == result->timestamp.tv_sec &&
 		 opts.finish.tv_usec >= result->timestamp.tv_usec)) {
 		if (trip == 0)
-		    calcaverage(result);
+		    calcaverage(&summary, result);
 		else
 		    calcbinning(result);
 		pmFreeResult(result);
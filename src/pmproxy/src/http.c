@@ -17,9 +17,28 @@
 #include "encoding.h"
 #include "dict.h"
 #include "util.h"
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
 
 static int chunked_transfer_size; /* pmproxy.chunksize, pagesize by default */
+static int chunked_transfer_queue; /* pmproxy.chunkqueue, chunks per client */
 static int smallest_buffer_size = 128;
+static int compress_enabled;	/* pmproxy.compression, on by default */
+static int compress_threshold;	/* pmproxy.compressmin, smallest body */
+
+enum http_metric {
+    HTTP_COMPRESS_RESPONSES,
+    HTTP_COMPRESS_BYTES_IN,
+    HTTP_COMPRESS_BYTES_OUT,
+    HTTP_COMPRESS_BYTES_SAVED,
+    NUM_HTTP_METRIC
+};
+
+/* instrumentation is shared by all event loops and worker threads */
+static pmAtomValue	*http_metrics[NUM_HTTP_METRIC];
+static void		*http_map;
+static uv_mutex_t	http_metrics_lock;
 
 /* https://tools.ietf.org/html/rfc7230#section-3.1.1 */
 #define MAX_URL_SIZE	8192
@@ -86,6 +105,86 @@ json_string(const sds original)
     return unicode_encode(original, sdslen(original));
 }
 
+/*
+ * Fast appenders for the per-value parts of large JSON responses,
+ * avoiding format string parsing and intermediate allocations.
+ * json_cat_repr produces exactly the output of sdscatrepr (a quoted
+ * string, with C-style escapes) but copies unescaped runs in one go.
+ */
+sds
+json_cat_repr(sds s, const char *p, size_t length)
+{
+    static const char	hex[] = "0123456789abcdef";
+    const char		*run = p, *end = p + length;
+    char		escape[4];
+    unsigned char	c;
+    size_t		bytes;
+
+    s = sdsMakeRoomFor(s, length + 2);
+    s = sdscatlen(s, "\"", 1);
+    for (; p < end; p++) {
+	c = (unsigned char)*p;
+	if (c >= 0x20 && c < 0x7f && c != '\\' && c != '"')
+	    continue;
+	if (p > run)
+	    s = sdscatlen(s, run, p - run);
+	run = p + 1;
+	escape[0] = '\\';
+	bytes = 2;
+	switch (c) {
+	case '\\':
+	case '"':
+	    escape[1] = c;
+	    break;
+	case '\n':
+	    escape[1] = 'n';
+	    break;
+	case '\r':
+	    escape[1] = 'r';
+	    break;
+	case '\t':
+	    escape[1] = 't';
+	    break;
+	case '\a':
+	    escape[1] = 'a';
+	    break;
+	case '\b':
+	    escape[1] = 'b';
+	    break;
+	default:
+	    escape[1] = 'x';
+	    escape[2] = hex[c >> 4];
+	    escape[3] = hex[c & 0xf];
+	    bytes = 4;
+	    break;
+	}
+	s = sdscatlen(s, escape, bytes);
+    }
+    if (p > run)
+	s = sdscatlen(s, run, p - run);
+    return sdscatlen(s, "\"", 1);
+}
+
+sds
+json_cat_uint(sds s, unsigned long long value)
+{
+    char		buffer[24], *p = buffer + sizeof(buffer);
+
+    do {
+	*--p = '0' + (value % 10);
+    } while ((value /= 10) != 0);
+    return sdscatlen(s, p, buffer + sizeof(buffer) - p);
+}
+
+sds
+json_cat_int(sds s, long long value)
+{
+    if (value >= 0)
+	return json_cat_uint(s, (unsigned long long)value);
+    s = sdscatlen(s, "-", 1);
+    return json_cat_uint(s, -(unsigned long long)value);
+}
+
 const char *
 http_content_type(http_flags_t flags)
 {
@@ -95,6 +194,13 @@ http_content_type(http_flags_t flags)
 	return "text/html";
     if (flags & HTTP_FLAG_TEXT)
 	return "text/plain";
+    if (flags & HTTP_FLAG_PROTOBUF)
+	return "application/vnd.google.protobuf; "
+		"proto=io.prometheus.client.MetricFamily; encoding=delimited";
+    if (flags & HTTP_FLAG_NDJSON)
+	return "application/x-ndjson";
+    if (flags & HTTP_FLAG_EVENTS)
+	return "text/event-stream";
     return "application/octet-stream";
 }
 
@@ -185,6 +291,179 @@ http_set_buffer(struct client *client, sds buffer, http_flags_t flags)
     client->buffer = buffer;
 }
 
+/*
+ * Case-insensitive lookup of a request header value, for servlets
+ * (header names are stored as sent by the client).
+ */
+sds
+http_get_header(struct client *client, const char *name)
+{
+    dictIterator	*iterator;
+    dictEntry		*entry;
+    sds			value = NULL;
+
+    if (client->u.http.headers == NULL)
+	return NULL;
+    iterator = dictGetIterator(client->u.http.headers);
+    while ((entry = dictNext(iterator)) != NULL) {
+	if (strcasecmp((sds)dictGetKey(entry), name) == 0) {
+	    value = (sds)dictGetVal(entry);
+	    break;
+	}
+    }
+    dictReleaseIterator(iterator);
+    return value;
+}
+
+/*
+ * Add a servlet-specific header to the response headers sent for the
+ * current request - must be called before any response is sent.
+ */
+void
+http_add_header(struct client *client, const char *name, sds value)
+{
+    if (client->u.http.response == NULL)
+	client->u.http.response = sdsempty();
+    client->u.http.response = sdscatfmt(client->u.http.response,
+					"%s: %S\r\n", name, value);
+}
+
+#ifdef HAVE_ZLIB
+static void
+http_compress_metrics(size_t insize, size_t outsize, int response)
+{
+    uint64_t		in = insize, out = outsize;
+    uint64_t		saved = (in > out) ? in - out : 0;
+
+    if (http_map == NULL)
+	return;
+    uv_mutex_lock(&http_metrics_lock);
+    if (response)
+	mmv_inc(http_map, http_metrics[HTTP_COMPRESS_RESPONSES]);
+    mmv_add(http_map, http_metrics[HTTP_COMPRESS_BYTES_IN], &in);
+    mmv_add(http_map, http_metrics[HTTP_COMPRESS_BYTES_OUT], &out);
+    mmv_add(http_map, http_metrics[HTTP_COMPRESS_BYTES_SAVED], &saved);
+    uv_mutex_unlock(&http_metrics_lock);
+}
+
+/*
+ * Pass the given input through a gzip deflate stream, returning a new
+ * buffer holding whatever compressed output the stream produced (which
+ * may be empty unless flushing), or NULL on failure.  The input buffer
+ * is always released.
+ */
+static sds
+http_deflate(z_stream *stream, sds input, int flush)
+{
+    size_t		used, room = sdslen(input) / 2 + 64;
+    sds			output = sdsempty();
+    int			sts;
+
+    stream->next_in = (Bytef *)input;
+    stream->avail_in = sdslen(input);
+    do {
+	used = sdslen(output);
+	output = sdsgrowzero(output, used + room);
+	stream->next_out = (Bytef *)output + used;
+	stream->avail_out = room;
+	if ((sts = deflate(stream, flush)) == Z_STREAM_ERROR) {
+	    sdsfree(output);
+	    output = NULL;
+	    break;
+	}
+	sdssetlen(output, used + room - stream->avail_out);
+	output[sdslen(output)] = '\0';
+    } while (stream->avail_out == 0);
+
+    sdsfree(input);
+    return output;
+}
+
+static int
+http_deflate_init(z_stream *stream)
+{
+    memset(stream, 0, sizeof(*stream));
+    /* window bits of 15 + 16 selects gzip (not zlib) header framing */
+    return deflateInit2(stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+			15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK ? 0 : -ENOMEM;
+}
+
+/*
+ * Compress an entire response body in one step, if the client accepts
+ * it and it is large enough to be worth doing; otherwise return NULL.
+ */
+static sds
+http_compress_body(struct client *client, sds body)
+{
+    z_stream		stream;
+    size_t		length = sdslen(body);
+    sds			result;
+
+    if (!compress_enabled || !(client->u.http.flags & HTTP_FLAG_GZIP) ||
+	length < compress_threshold || http_deflate_init(&stream) < 0)
+	return NULL;
+    result = http_deflate(&stream, sdsdup(body), Z_FINISH);
+    deflateEnd(&stream);
+    if (result == NULL || sdslen(result) >= length) {
+	sdsfree(result);	/* not worthwhile, send the original */
+	return NULL;
+    }
+    http_compress_metrics(length, sdslen(result), 1);
+    return result;
+}
+
+/*
+ * Start compressing a chunked response, if the client accepts it -
+ * compression state persists across each chunk of the response.
+ */
+static int
+http_compress_start(struct client *client)
+{
+    z_stream		*stream;
+
+    if (!compress_enabled || !(client->u.http.flags & HTTP_FLAG_GZIP))
+	return 0;
+    if ((stream = malloc(sizeof(z_stream))) == NULL)
+	return 0;
+    if (http_deflate_init(stream) < 0) {
+	free(stream);
+	return 0;
+    }
+    client->u.http.compress = stream;
+    return 1;
+}
+
+static sds
+http_compress_chunk(struct client *client, sds chunk, int finish)
+{
+    z_stream		*stream = (z_stream *)client->u.http.compress;
+    size_t		length = sdslen(chunk);
+    sds			result;
+
+    result = http_deflate(stream, chunk, finish ? Z_FINISH : Z_NO_FLUSH);
+    if (result)
+	http_compress_metrics(length, sdslen(result), finish);
+    return result;
+}
+
+static void
+http_compress_end(struct client *client)
+{
+    z_stream		*stream = (z_stream *)client->u.http.compress;
+
+    if (stream) {
+	deflateEnd(stream);
+	free(stream);
+	client->u.http.compress = NULL;
+    }
+}
+#else
+#define http_compress_body(c,b)		((void)(c), (void)(b), (sds)NULL)
+#define http_compress_start(c)		((void)(c), 0)
+#define http_compress_chunk(c,b,f)	((void)(c), (void)(f), (b))
+#define http_compress_end(c)		do { (void)(c); } while (0)
+#endif
+
 static sds
 http_response_header(struct client *client, unsigned int length, http_code_t sts, http_flags_t flags)
 {
@@ -219,6 +498,13 @@ http_response_header(struct client *client, unsigned int length, http_code_t sts
     else
 	header = sdscatfmt(header, "%S: %u\r\n", HEADER_CONTENT_LENGTH, length);
 
+    if (flags & HTTP_FLAG_COMPRESS)
+	header = sdscatfmt(header, "Content-Encoding: gzip\r\n");
+    if (compress_enabled)
+	header = sdscatfmt(header, "Vary: Accept-Encoding\r\n");
+    if (client->u.http.response)
+	header = sdscatsds(header, client->u.http.response);
+
     header = sdscatfmt(header, "Content-Type: %s%s\r\n",
 		http_content_type(flags), http_content_encoding(flags));
     header = sdscatfmt(header, "Date: %s\r\n\r\n",
@@ -381,26 +667,33 @@ http_reply(struct client *client, sds message,
 {
     enum http_flags	flags = client->u.http.flags;
     char		length[32]; /* hex length */
-    sds			buffer, suffix;
+    sds			buffer, suffix, compressed;
 
     if (flags & HTTP_FLAG_STREAMING) {
-	buffer = sdsempty();
-	if (client->buffer == NULL) {	/* no data currently accumulated */
-	    pmsprintf(length, sizeof(length), "%lX", (unsigned long)sdslen(message));
-	    buffer = sdscatfmt(buffer, "%s\r\n%S\r\n", length, message);
-	} else if (message != NULL) {
-	    pmsprintf(length, sizeof(length), "%lX",
-				(unsigned long)sdslen(client->buffer) + sdslen(message));
-	    buffer = sdscatfmt(buffer, "%s\r\n%S%S\r\n",
-				length, client->buffer, message);
+	if ((suffix = client->buffer) == NULL)	/* no data accumulated */
+	    suffix = message ? message : sdsempty();
+	else if (message != NULL) {
+	    suffix = sdscatsds(suffix, message);
+	    sdsfree(message);
 	}
-
-	sdsfree(message);
-	sdsfree(client->buffer);
 	client->buffer = NULL;
 
+	/* flush any remaining compressed data, with the gzip trailer */
+	if ((flags & HTTP_FLAG_COMPRESS) &&
+	    (suffix = http_compress_chunk(client, suffix, 1)) == NULL)
+	    suffix = sdsempty();
+	http_compress_end(client);
+
+	/* final chunk (if any data remains) and then the chunked suffix */
+	buffer = sdsempty();
+	if (sdslen(suffix) > 0) {
+	    pmsprintf(length, sizeof(length), "%lX", (unsigned long)sdslen(suffix));
+	    buffer = sdscatfmt(buffer, "%s\r\n%S\r\n", length, suffix);
+	}
+	sdsfree(suffix);
+
 	suffix = sdsnewlen("0\r\n\r\n", 5);		/* chunked suffix */
-	client->u.http.flags &= ~HTTP_FLAG_STREAMING;	/* end of stream! */
+	client->u.http.flags &= ~(HTTP_FLAG_STREAMING | HTTP_FLAG_COMPRESS);
 
     } else if (flags & HTTP_FLAG_NO_BODY) {
 	if (client->u.http.parser.method == HTTP_OPTIONS)
@@ -420,6 +713,11 @@ http_reply(struct client *client, sds message,
 	} else {
 	    suffix = sdsempty();
 	}
+	if ((compressed = http_compress_body(client, suffix)) != NULL) {
+	    sdsfree(suffix);
+	    suffix = compressed;
+	    type |= HTTP_FLAG_COMPRESS;
+	}
 	buffer = http_response_header(client, sdslen(suffix), sts, type);
     }
 
@@ -475,26 +773,50 @@ http_transfer(struct client *client)
     /* If the client buffer length is now beyond a set maximum size,
      * send it using chunked transfer encoding.  Once buffer pointer
      * is copied into the uv_buf_t, clear it in the client, and then
-     * return control to caller.
+     * return control to caller - once the number of chunks queued for
+     * writing has dropped below the limit, when called from a thread
+     * other than the event loop.  This bounds the memory used by large
+     * streamed results to a small multiple of the chunk size.
      */
     if (sdslen(client->buffer) >= chunked_transfer_size) {
 	if (parser->http_major == 1 && parser->http_minor > 0) {
 	    if (!(flags & HTTP_FLAG_STREAMING)) {
 		/* send headers (no content length) and initial content */
 		flags |= HTTP_FLAG_STREAMING;
+		if (http_compress_start(client))
+		    flags |= HTTP_FLAG_COMPRESS;
 		buffer = http_response_header(client, 0, HTTP_STATUS_OK, flags);
 		client->u.http.flags = flags;
 	    } else {
 		/* headers already sent, send the next chunk of content */
 		buffer = sdsempty();
 	    }
-	    /* prepend a chunked transfer encoding message length (hex) */
-	    buffer = sdscatprintf(buffer, "%lX\r\n",
-				 (unsigned long)sdslen(client->buffer));
-	    suffix = sdscatfmt(client->buffer, "\r\n");
+	    suffix = client->buffer;
 	    /* reset for next call - original released on I/O completion */
 	    client->buffer = NULL;	/* safe, as now held in 'suffix' */
 
+	    if (flags & HTTP_FLAG_COMPRESS) {
+		if ((suffix = http_compress_chunk(client, suffix, 0)) == NULL) {
+		    sdsfree(buffer);
+		    client_close(client);
+		    return;
+		}
+		if (sdslen(suffix) == 0) {
+		    /* compressor buffered it all, an empty chunk ends the stream */
+		    if (sdslen(buffer) > 0)
+			client_write(client, buffer, NULL);
+		    else
+			sdsfree(buffer);
+		    sdsfree(suffix);
+		    return;
+		}
+	    }
+
+	    /* prepend a chunked transfer encoding message length (hex) */
+	    buffer = sdscatprintf(buffer, "%lX\r\n",
+				 (unsigned long)sdslen(suffix));
+	    suffix = sdscatfmt(suffix, "\r\n");
+
 	    if (pmDebugOptions.http) {
 		method = http_method_str(client->u.http.parser.method);
 		fprintf(stderr, "HTTP %s chunk buffer (client %p, len=%lu)\n%s"
@@ -503,6 +825,8 @@ http_transfer(struct client *client)
 			method, client, (unsigned long)sdslen(suffix), suffix);
 	    }
 	    client_write(client, buffer, suffix);
+	    client_write_wait(client,
+			(size_t)chunked_transfer_queue * chunked_transfer_size);
 
 	} else if (parser->http_major <= 1) {
 	    http_error(client, HTTP_STATUS_PAYLOAD_TOO_LARGE,
@@ -513,6 +837,29 @@ http_transfer(struct client *client)
     }
 }
 
+/*
+ * Send data immediately as the next chunk of an open-ended response,
+ * such as an event stream, with the headers ahead of the first chunk.
+ * Must be called from the event loop thread; data is consumed.
+ */
+void
+http_stream(struct client *client, sds data)
+{
+    enum http_flags	flags = client->u.http.flags;
+    sds			buffer, suffix;
+
+    if (!(flags & HTTP_FLAG_STREAMING)) {
+	flags |= HTTP_FLAG_STREAMING;
+	buffer = http_response_header(client, 0, HTTP_STATUS_OK, flags);
+	client->u.http.flags = flags;
+    } else {
+	buffer = sdsempty();
+    }
+    buffer = sdscatprintf(buffer, "%lX\r\n", (unsigned long)sdslen(data));
+    suffix = sdscatlen(data, "\r\n", 2);
+    client_write(client, buffer, suffix);
+}
+
 static void
 http_client_release(struct client *client)
 {
@@ -523,7 +870,12 @@ http_client_release(struct client *client)
     client->u.http.privdata = NULL;
     client->u.http.servlet = NULL;
     client->u.http.flags = 0;
+    http_compress_end(client);
 
+    if (client->u.http.response) {
+	sdsfree(client->u.http.response);
+	client->u.http.response = NULL;
+    }
     if (client->u.http.headers) {
 	dictRelease(client->u.http.headers);
 	client->u.http.headers = NULL;
@@ -768,6 +1120,43 @@ on_header_field(http_parser *request, const char *offset, size_t length)
     return 0;
 }
 
+/*
+ * Parse an Accept-Encoding header value, looking for gzip (or the "*"
+ * wildcard) with a non-zero quality value, e.g. "deflate, gzip;q=0.8".
+ * https://tools.ietf.org/html/rfc7231#section-5.3.4
+ */
+static int
+http_accept_gzip(const char *value)
+{
+    const char		*p = value, *name, *q;
+    size_t		length;
+
+    while (*p) {
+	while (*p == ' ' || *p == '\t' || *p == ',')
+	    p++;
+	name = p;
+	while (*p && *p != ',' && *p != ';' && *p != ' ' && *p != '\t')
+	    p++;
+	length = p - name;
+	q = NULL;
+	while (*p && *p != ',') {
+	    if (*p == ';') {
+		while (*++p == ' ' || *p == '\t')
+		    ;
+		if ((*p == 'q' || *p == 'Q') && p[1] == '=')
+		    q = p + 2;
+	    } else {
+		p++;
+	    }
+	}
+	if ((length == 4 && strncasecmp(name, "gzip", length) == 0) ||
+	    (length == 6 && strncasecmp(name, "x-gzip", length) == 0) ||
+	    (length == 1 && *name == '*'))
+	    return (q == NULL || strtod(q, NULL) > 0.0);
+    }
+    return 0;
+}
+
 static int
 on_header_value(http_parser *request, const char *offset, size_t length)
 {
@@ -805,6 +1194,11 @@ on_header_value(http_parser *request, const char *offset, size_t length)
 	    client->u.http.parser.status_code = HTTP_STATUS_UNAUTHORIZED;
 	}
     }
+    /* response compression negotiation for all servlets */
+    else if (strcasecmp(field, "Accept-Encoding") == 0 &&
+	http_accept_gzip(value)) {
+	client->u.http.flags |= HTTP_FLAG_GZIP;
+    }
 
     return 0;
 }
@@ -970,12 +1364,67 @@ setup:
     servlet->setup(proxy);
 }
 
+static void
+http_setup_metrics(mmv_registry_t *registry)
+{
+    pmAtomValue		**ap;
+    pmUnits		units_count = MMV_UNITS(0, 0, 1, 0, 0, PM_COUNT_ONE);
+    pmUnits		units_bytes = MMV_UNITS(1, 0, 0, PM_SPACE_BYTE, 0, 0);
+    void		*map;
+
+    mmv_stats_add_metric(registry, "compress.responses", 1,
+	MMV_TYPE_U64, MMV_SEM_COUNTER, units_count, MMV_INDOM_NULL,
+	"number of compressed responses",
+	"Total number of HTTP responses sent with gzip Content-Encoding");
+
+    mmv_stats_add_metric(registry, "compress.bytes.in", 2,
+	MMV_TYPE_U64, MMV_SEM_COUNTER, units_bytes, MMV_INDOM_NULL,
+	"response bytes before compression",
+	"Total size of HTTP response bodies prior to gzip compression");
+
+    mmv_stats_add_metric(registry, "compress.bytes.out", 3,
+	MMV_TYPE_U64, MMV_SEM_COUNTER, units_bytes, MMV_INDOM_NULL,
+	"response bytes after compression",
+	"Total size of HTTP response bodies after gzip compression");
+
+    mmv_stats_add_metric(registry, "compress.bytes.saved", 4,
+	MMV_TYPE_U64, MMV_SEM_COUNTER, units_bytes, MMV_INDOM_NULL,
+	"response bytes saved by compression",
+	"Total reduction in HTTP response body sizes from gzip compression");
+
+    if ((map = mmv_stats_start(registry)) == NULL)
+	return;
+
+    ap = http_metrics;
+    ap[HTTP_COMPRESS_RESPONSES] = mmv_lookup_value_desc(map, "compress.responses", NULL);
+    ap[HTTP_COMPRESS_BYTES_IN] = mmv_lookup_value_desc(map, "compress.bytes.in", NULL);
+    ap[HTTP_COMPRESS_BYTES_OUT] = mmv_lookup_value_desc(map, "compress.bytes.out", NULL);
+    ap[HTTP_COMPRESS_BYTES_SAVED] = mmv_lookup_value_desc(map, "compress.bytes.saved", NULL);
+
+    uv_mutex_init(&http_metrics_lock);
+    http_map = map;
+}
+
 void
 setup_http_module(struct proxy *proxy)
 {
+    mmv_registry_t	*registry;
     sds			option;
 
-    proxymetrics(proxy, METRICS_HTTP);
+    if ((registry = proxymetrics(proxy, METRICS_HTTP)) != NULL)
+	http_setup_metrics(registry);
+
+    if ((option = pmIniFileLookup(config, "pmproxy", "compression")) != NULL)
+	compress_enabled = (strcmp(option, "true") == 0);
+    else
+	compress_enabled = 1;
+#ifndef HAVE_ZLIB
+    compress_enabled = 0;
+#endif
+    if ((option = pmIniFileLookup(config, "pmproxy", "compressmin")) != NULL)
+	compress_threshold = atoi(option);
+    else
+	compress_threshold = 1024;
 
     if ((option = pmIniFileLookup(config, "pmproxy", "chunksize")) != NULL)
 	chunked_transfer_size = atoi(option);
@@ -984,6 +1433,17 @@ setup_http_module(struct proxy *proxy)
     if (chunked_transfer_size < smallest_buffer_size)
 	chunked_transfer_size = smallest_buffer_size;
 
+    if ((option = pmIniFileLookup(config, "pmproxy", "chunkqueue")) != NULL)
+	chunked_transfer_queue = atoi(option);
+    else
+	chunked_transfer_queue = 4;
+    if (chunked_transfer_queue < 1)
+	chunked_transfer_queue = 1;
+
+    /* header names are shared by all event loops */
+    if (proxy->worker != 0)
+	goto servlets;
+
     HEADER_ACCESS_CONTROL_REQUEST_HEADERS = sdsnew("Access-Control-Request-Headers");
     HEADER_ACCESS_CONTROL_REQUEST_METHOD = sdsnew("Access-Control-Request-Method");
     HEADER_ACCESS_CONTROL_ALLOW_METHODS = sdsnew("Access-Control-Allow-Methods");
@@ -996,9 +1456,11 @@ setup_http_module(struct proxy *proxy)
     HEADER_ORIGIN = sdsnew("Origin");
     HEADER_WWW_AUTHENTICATE = sdsnew("WWW-Authenticate");
 
+servlets:
     register_servlet(proxy, &pmsearch_servlet);
     register_servlet(proxy, &pmseries_servlet);
     register_servlet(proxy, &pmwebapi_servlet);
+    register_servlet(proxy, &pmlogger_servlet);
 }
 
 void
@@ -1009,6 +1471,13 @@ close_http_module(struct proxy *proxy)
     for (servlet = proxy->servlets; servlet != NULL; servlet = servlet->next)
 	servlet->close(proxy);
 
+    if (proxy->worker != 0)
+	return;
+
+    if (http_map) {
+	http_map = NULL;
+	uv_mutex_destroy(&http_metrics_lock);
+    }
     proxymetrics_close(proxy, METRICS_HTTP);
 
     sdsfree(HEADER_ACCESS_CONTROL_REQUEST_HEADERS);
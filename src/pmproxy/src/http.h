@@ -29,15 +29,23 @@ typedef enum json_flags {
 extern sds json_push_suffix(sds, json_flags_t);
 extern sds json_pop_suffix(sds);
 extern sds json_string(const sds);
+extern sds json_cat_repr(sds, const char *, size_t);
+extern sds json_cat_uint(sds, unsigned long long);
+extern sds json_cat_int(sds, long long);
+#define json_cat_literal(s, literal) sdscatlen((s), (literal), sizeof(literal)-1)
 
 typedef enum http_flags {
     HTTP_FLAG_JSON	= (1<<0),
     HTTP_FLAG_TEXT	= (1<<1),
     HTTP_FLAG_HTML	= (1<<2),
+    HTTP_FLAG_PROTOBUF	= (1<<3),	/* Prometheus delimited protobuf */
+    HTTP_FLAG_NDJSON	= (1<<4),	/* newline-delimited JSON */
+    HTTP_FLAG_EVENTS	= (1<<5),	/* server-sent event stream */
     HTTP_FLAG_UTF8	= (1<<10),
     HTTP_FLAG_UTF16	= (1<<11),
+    HTTP_FLAG_GZIP	= (1<<12),	/* client accepts gzip encoding */
     HTTP_FLAG_NO_BODY	= (1<<13),
-    HTTP_FLAG_COMPRESS	= (1<<14),
+    HTTP_FLAG_COMPRESS	= (1<<14),	/* response body is gzip encoded */
     HTTP_FLAG_STREAMING	= (1<<15),
     /* maximum 16 for server.h */
 } http_flags_t;
@@ -61,6 +69,7 @@ typedef enum http_options {
 typedef unsigned int http_code_t;
 
 extern void http_transfer(struct client *);
+extern void http_stream(struct client *, sds);
 extern void http_reply(struct client *, sds, http_code_t, http_flags_t, http_options_t);
 extern void http_error(struct client *, http_code_t, const char *);
 
@@ -71,6 +80,8 @@ extern const char *http_content_type(http_flags_t);
 
 extern sds http_get_buffer(struct client *);
 extern void http_set_buffer(struct client *, sds, http_flags_t);
+extern sds http_get_header(struct client *, const char *);
+extern void http_add_header(struct client *, const char *, sds);
 
 typedef void (*httpSetupCallBack)(struct proxy *);
 typedef void (*httpCloseCallBack)(struct proxy *);
@@ -95,5 +106,6 @@ typedef struct servlet {
 extern struct servlet pmsearch_servlet;
 extern struct servlet pmseries_servlet;
 extern struct servlet pmwebapi_servlet;
+extern struct servlet pmlogger_servlet;
 
 #endif /* PMPROXY_HTTP_H */
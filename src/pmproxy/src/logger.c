@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+#include "server.h"
+
+/*
+ * Archive records streamed from pmlogger -R, one long-lived chunked
+ * POST /logger/push request per archive.  The records are passed to
+ * archive discovery (Redis series and search) as they arrive and, if
+ * configured, written to a local copy of the archive too.
+ */
+typedef struct pmLoggerBaton {
+    struct client	*client;
+    pmDiscoverStream	*stream;
+    sds			hostname;
+    sds			name;
+    sds			message;
+    unsigned long long	bytes;
+} pmLoggerBaton;
+
+/* constant string keys (initialized during servlet setup) */
+static sds PARAM_HOSTNAME, PARAM_NAME;
+
+/* local archive copies of pushed records, see [discover] push.directory */
+static sds push_directory;
+
+static void
+pmlogger_data_release(struct client *client)
+{
+    pmLoggerBaton	*baton = (pmLoggerBaton *)client->u.http.data;
+
+    if (pmDebugOptions.http)
+	fprintf(stderr, "%s: %p for client %p\n", "pmlogger_data_release",
+			baton, client);
+
+    if (baton->stream)
+	pmDiscoverStreamClose(baton->stream);
+    sdsfree(baton->hostname);
+    sdsfree(baton->name);
+    sdsfree(baton->message);
+    memset(baton, 0, sizeof(*baton));
+    free(baton);
+}
+
+static void
+pmlogger_error(struct client *client, http_code_t code, const char *message)
+{
+    pmLoggerBaton	*baton = (pmLoggerBaton *)client->u.http.data;
+
+    if (client->u.http.parser.status_code == 0)
+	client->u.http.parser.status_code = code;
+    if (baton->message == NULL)
+	baton->message = sdsnew(message);
+}
+
+static int
+pmlogger_request_url(struct client *client, sds url, dict *parameters)
+{
+    pmLoggerBaton	*baton;
+    dictEntry		*entry;
+
+    if (strcmp(url, "/logger/push") != 0)
+	return 0;
+
+    if ((baton = calloc(1, sizeof(*baton))) == NULL) {
+	client->u.http.parser.status_code = HTTP_STATUS_INTERNAL_SERVER_ERROR;
+	return 1;
+    }
+    client->u.http.data = baton;
+    baton->client = client;
+
+    if (parameters) {
+	if ((entry = dictFind(parameters, PARAM_HOSTNAME)) != NULL)
+	    baton->hostname = sdsdup(dictGetVal(entry));
+	if ((entry = dictFind(parameters, PARAM_NAME)) != NULL)
+	    baton->name = sdsdup(dictGetVal(entry));
+    }
+    if (client->u.http.parser.method != HTTP_POST &&
+	client->u.http.parser.method != HTTP_OPTIONS &&
+	client->u.http.parser.method != HTTP_TRACE)
+	pmlogger_error(client, HTTP_STATUS_METHOD_NOT_ALLOWED,
+			"records must be pushed using POST");
+    else if (client->u.http.parser.method == HTTP_POST &&
+	     (baton->hostname == NULL || baton->name == NULL))
+	pmlogger_error(client, HTTP_STATUS_BAD_REQUEST,
+			"hostname and name parameters are required");
+    return 1;
+}
+
+static int
+pmlogger_request_headers(struct client *client, struct dict *headers)
+{
+    if (pmDebugOptions.http)
+	fprintf(stderr, "logger servlet headers (client=%p)\n", client);
+    return 0;
+}
+
+static int
+pmlogger_request_body(struct client *client, const char *content, size_t length)
+{
+    pmLoggerBaton	*baton = (pmLoggerBaton *)client->u.http.data;
+    pmDiscoverModule	*module;
+    int			sts;
+
+    if (client->u.http.parser.status_code)
+	return 0;	/* discard the remainder, error reported when done */
+
+    if (baton->stream == NULL) {
+	/* discovery runs on the main event loop only */
+	module = redis_discover_module(client->proxy);
+	if (module == NULL && push_directory == NULL) {
+	    pmlogger_error(client, HTTP_STATUS_SERVICE_UNAVAILABLE,
+		client->proxy->worker ?
+			"records can only be pushed to the main event loop" :
+			"archive discovery and push.directory not configured");
+	    return 0;
+	}
+	baton->stream = pmDiscoverStreamOpen(module, baton->hostname,
+				baton->name, push_directory, client->proxy);
+	if (baton->stream == NULL) {
+	    pmlogger_error(client, HTTP_STATUS_BAD_REQUEST,
+			"cannot accept records for this hostname and name");
+	    return 0;
+	}
+	if (pmDebugOptions.http || pmDebugOptions.discovery)
+	    fprintf(stderr, "%s: client %p pushing %s/%s\n",
+			"pmlogger_request_body", client,
+			baton->hostname, baton->name);
+    }
+
+    if ((sts = pmDiscoverStreamData(baton->stream, content, length)) < 0) {
+	pmDiscoverStreamClose(baton->stream);
+	baton->stream = NULL;
+	pmlogger_error(client, HTTP_STATUS_BAD_REQUEST, pmErrStr(sts));
+	return 0;
+    }
+    baton->bytes += length;
+    return 0;
+}
+
+static int
+pmlogger_request_done(struct client *client)
+{
+    pmLoggerBaton	*baton = (pmLoggerBaton *)client->u.http.data;
+    http_flags_t	flags = client->u.http.flags | HTTP_FLAG_JSON;
+    http_code_t		code;
+    sds			quoted, msg;
+
+    if (baton->stream) {
+	pmDiscoverStreamClose(baton->stream);
+	baton->stream = NULL;
+    }
+
+    if (client->u.http.parser.method == HTTP_OPTIONS ||
+	client->u.http.parser.method == HTTP_TRACE ||
+	client->u.http.parser.method == HTTP_HEAD) {
+	http_reply(client, sdsempty(), HTTP_STATUS_OK, flags, HTTP_OPTIONS_POST);
+	return 0;
+    }
+
+    if ((code = client->u.http.parser.status_code) == 0) {
+	code = HTTP_STATUS_OK;
+	msg = sdscatfmt(sdsempty(), "{\"bytes\":%U,\"success\":true}\r\n",
+			baton->bytes);
+    } else {
+	quoted = json_string(baton->message ? baton->message : "(none)");
+	msg = sdscatfmt(sdsempty(), "{\"message\":%S,\"success\":false}\r\n",
+			quoted);
+	sdsfree(quoted);
+    }
+    http_reply(client, msg, code, flags, HTTP_OPTIONS_POST);
+    return 0;
+}
+
+static void
+pmlogger_servlet_setup(struct proxy *proxy)
+{
+    sds			option;
+
+    /* request parameter names are shared by all event loops */
+    if (proxy->worker != 0)
+	return;
+
+    PARAM_HOSTNAME = sdsnew("hostname");
+    PARAM_NAME = sdsnew("name");
+
+    if ((option = pmIniFileLookup(proxy->config, "discover", "push.directory")) &&
+	sdslen(option) > 0)
+	push_directory = sdsdup(option);
+}
+
+static void
+pmlogger_servlet_close(struct proxy *proxy)
+{
+    if (proxy->worker != 0)
+	return;
+
+    sdsfree(PARAM_HOSTNAME);
+    sdsfree(PARAM_NAME);
+    sdsfree(push_directory);
+    push_directory = NULL;
+}
+
+struct servlet pmlogger_servlet = {
+    .name		= "logger",
+    .setup 		= pmlogger_servlet_setup,
+    .close 		= pmlogger_servlet_close,
+    .on_url		= pmlogger_request_url,
+    .on_headers		= pmlogger_request_headers,
+    .on_body		= pmlogger_request_body,
+    .on_done		= pmlogger_request_done,
+    .on_release		= pmlogger_data_release,
+};
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2019,2021 Red Hat.
+ * Copyright (c) 2019,2021,2026 Red Hat.
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms of the GNU Lesser General Public License as published
@@ -56,11 +56,13 @@ labeladd(void *arg, const struct dictEntry *entry)
 	sdscatfmt(labels->buffer, ",%S=%S", entry->key, entry->v.val);
 }
 
-/* convert an array of PCP labelsets into Open Metrics form */
-void
-open_metrics_labels(pmWebLabelSet *labels, struct dict *labeldict)
+/*
+ * Walk labelsets in order adding labels to a temporary dictionary, with
+ * values either quoted (text exposition) or left as-is (protobuf).
+ */
+static void
+labelmerge(pmWebLabelSet *labels, struct dict *labeldict, int quoted)
 {
-    unsigned long	cursor = 0;
     pmLabelSet		*labelset;
     pmLabel		*label;
     dictEntry		*entry;
@@ -74,7 +76,6 @@ open_metrics_labels(pmWebLabelSet *labels, struct dict *labeldict)
     if (instid == NULL)
 	instid = sdsnewlen("instid", 6);
 
-    /* walk labelset in order adding labels to a temporary dictionary */
     for (i = 0; i < labels->nsets; i++) {
 	labelset = labels->sets[i];
 	for (j = 0; j < labelset->nlabels; j++) {
@@ -86,7 +87,8 @@ open_metrics_labels(pmWebLabelSet *labels, struct dict *labeldict)
 
 	    /* extract the label value without any surrounding quotes */
 	    labelvalue(label, labelset->json, &offset, &length);
-	    value = sdscatrepr(sdsempty(), offset, length);
+	    value = quoted ? sdscatrepr(sdsempty(), offset, length) :
+			     sdsnewlen(offset, length);
 
 	    /* overwrite entries from earlier passes: label hierarchy */
 	    if ((entry = dictFind(labeldict, key)) == NULL) {
@@ -103,14 +105,25 @@ open_metrics_labels(pmWebLabelSet *labels, struct dict *labeldict)
     if (labels->instname && dictFind(labeldict, instname) == NULL) {
 	key = sdsdup(instname);
 	value = labels->instname;
-	value = sdscatrepr(sdsempty(), value, sdslen(value));
+	value = quoted ? sdscatrepr(sdsempty(), value, sdslen(value)) :
+			 sdsdup(value);
 	dictAdd(labeldict, key, value);	/* new entry */
     }
     if (labels->instid != PM_IN_NULL && dictFind(labeldict, instid) == NULL) {
 	key = sdsdup(instid);
-	value = sdscatfmt(sdsempty(), "\"%u\"", labels->instid);
+	value = quoted ? sdscatfmt(sdsempty(), "\"%u\"", labels->instid) :
+			 sdscatfmt(sdsempty(), "%u", labels->instid);
 	dictAdd(labeldict, key, value);	/* new entry */
     }
+}
+
+/* convert an array of PCP labelsets into Open Metrics form */
+void
+open_metrics_labels(pmWebLabelSet *labels, struct dict *labeldict)
+{
+    unsigned long	cursor = 0;
+
+    labelmerge(labels, labeldict, 1);
 
     /* finally produce the merged set of labels in the desired format */
     do {
@@ -156,3 +169,132 @@ open_metrics_semantics(sds sem)
 	return sdsnew("gauge");
     return sdsnew("counter");
 }
+
+/*
+ * Prometheus protobuf exposition format - a sequence of varint length
+ * delimited io.prometheus.client.MetricFamily messages, encoded here
+ * directly (only the few message types and fields needed for gauges,
+ * counters and their labels):
+ *
+ * MetricFamily { 1:name string, 2:help string, 3:type enum, 4:metric Metric }
+ * Metric { 1:label LabelPair, 2:gauge Gauge, 3:counter Counter, 6:timestamp_ms int64 }
+ * LabelPair { 1:name string, 2:value string }
+ * Gauge, Counter { 1:value double }
+ */
+#define PROTO_VARINT	0
+#define PROTO_FIXED64	1
+#define PROTO_LENGTH	2
+#define PROTO_TAG(field, wire)	(((field) << 3) | (wire))
+
+#define PROTO_TYPE_COUNTER	0
+#define PROTO_TYPE_GAUGE	1
+
+static sds
+proto_varint(sds s, unsigned long long value)
+{
+    unsigned char	buffer[10];
+    int			length = 0;
+
+    do {
+	buffer[length] = value & 0x7f;
+	if ((value >>= 7) != 0)
+	    buffer[length] |= 0x80;
+	length++;
+    } while (value);
+    return sdscatlen(s, buffer, length);
+}
+
+static sds
+proto_bytes(sds s, unsigned int field, const char *bytes, size_t length)
+{
+    s = proto_varint(s, PROTO_TAG(field, PROTO_LENGTH));
+    s = proto_varint(s, length);
+    return sdscatlen(s, bytes, length);
+}
+
+static sds
+proto_double(sds s, unsigned int field, double value)
+{
+    unsigned char	buffer[8];
+    uint64_t		bits;
+    int			i;
+
+    memcpy(&bits, &value, sizeof(bits));
+    for (i = 0; i < 8; i++)	/* little-endian, regardless of host order */
+	buffer[i] = (bits >> (i * 8)) & 0xff;
+    s = proto_varint(s, PROTO_TAG(field, PROTO_FIXED64));
+    return sdscatlen(s, buffer, sizeof(buffer));
+}
+
+/* check whether an Accept header asks for the Prometheus protobuf format */
+int
+open_metrics_proto_accept(const char *accept)
+{
+    if (accept == NULL)
+	return 0;
+    return strstr(accept, "application/vnd.google.protobuf") != NULL &&
+	   strstr(accept, "io.prometheus.client.MetricFamily") != NULL;
+}
+
+static void
+labelencode(void *arg, const struct dictEntry *entry)
+{
+    pmWebLabelSet	*labels = (pmWebLabelSet *)arg;
+    sds			key = (sds)entry->key, value = (sds)entry->v.val;
+    sds			pair;
+
+    pair = proto_bytes(sdsempty(), 1, key, sdslen(key));
+    pair = proto_bytes(pair, 2, value, sdslen(value));
+    labels->buffer = proto_bytes(labels->buffer, 1, pair, sdslen(pair));
+    sdsfree(pair);
+}
+
+/* convert an array of PCP labelsets into encoded Metric.label fields */
+void
+open_metrics_proto_labels(pmWebLabelSet *labels, struct dict *labeldict)
+{
+    unsigned long	cursor = 0;
+
+    labelmerge(labels, labeldict, 0);
+    do {
+	cursor = dictScan(labeldict, cursor, labelencode, NULL, labels);
+    } while (cursor);
+}
+
+/* append one encoded Metric (labels from above, value, optional time) */
+sds
+open_metrics_proto_metric(sds s, sds labels, int counter,
+		double value, long long milliseconds)
+{
+    sds		metric, v;
+
+    v = proto_double(sdsempty(), 1, value);
+    metric = labels ? sdsdup(labels) : sdsempty();
+    metric = proto_bytes(metric, counter ? 3 : 2, v, sdslen(v));
+    if (milliseconds >= 0) {
+	metric = proto_varint(metric, PROTO_TAG(6, PROTO_VARINT));
+	metric = proto_varint(metric, milliseconds);
+    }
+    s = proto_bytes(s, 4, metric, sdslen(metric));
+    sdsfree(metric);
+    sdsfree(v);
+    return s;
+}
+
+/* append a length-delimited MetricFamily holding the encoded metrics */
+sds
+open_metrics_proto_family(sds s, sds name, sds help, int counter, sds metrics)
+{
+    sds		family;
+
+    family = proto_bytes(sdsempty(), 1, name, sdslen(name));
+    if (help)
+	family = proto_bytes(family, 2, help, sdslen(help));
+    family = proto_varint(family, PROTO_TAG(3, PROTO_VARINT));
+    family = proto_varint(family, counter ? PROTO_TYPE_COUNTER : PROTO_TYPE_GAUGE);
+    family = sdscatsds(family, metrics);	/* already tagged as field 4 */
+    s = proto_varint(s, sdslen(family));
+    s = sdscatsds(s, family);
+    sdsfree(family);
+    return s;
+}
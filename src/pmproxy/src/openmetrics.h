@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2019 Red Hat.
+ * Copyright (c) 2019,2026 Red Hat.
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms of the GNU Lesser General Public License as published
@@ -29,4 +29,10 @@ extern sds open_metrics_semantics(sds);
 /* convert an array of PCP labelsets into Open Metrics form */
 extern void open_metrics_labels(pmWebLabelSet *, dict *);
 
+/* Prometheus protobuf (delimited io.prometheus.client.MetricFamily) form */
+extern int open_metrics_proto_accept(const char *);
+extern void open_metrics_proto_labels(pmWebLabelSet *, dict *);
+extern sds open_metrics_proto_metric(sds, sds, int, double, long long);
+extern sds open_metrics_proto_family(sds, sds, sds, int, sds);
+
 #endif	/* OPEN_METRICS_H */
@@ -79,6 +79,7 @@ static pmLongOptions longopts[] = {
     PMAPI_OPTIONS_HEADER("Configuration options"),
     { "config", 1, 'c', "PATH", "path to configuration file (implies --timeseries)"},
     { "", 0, 'L', 0, "maximum size for PDUs from clients [default 65536]" },
+    { "threads", 1, 'N', "N", "number of event loop threads [default 1]" },
     PMAPI_OPTIONS_HEADER("Connection options"),
     { "interface", 1, 'i', "ADDR", "accept connections on this IP address" },
     { "port", 1, 'p', "PORT", "accept connections on this port" },
@@ -93,7 +94,7 @@ static pmLongOptions longopts[] = {
 };
 
 static pmOptions opts = {
-    .short_options = "Ac:dD:Ffh:i:l:L:p:r:s:tT:U:x:?",
+    .short_options = "Ac:dD:Ffh:i:l:L:N:p:r:s:tT:U:x:?",
     .long_options = longopts,
 };
 
@@ -106,6 +107,7 @@ ParseOptions(int argc, char *argv[], int *nports, int *maxpending)
     int		timeseries = 1;
     int		redis_port = 6379;
     char	*redis_host = NULL;
+    char	*threads = NULL;
     char	*endnum;
     const char	*inifile = NULL;
     sds		option;
@@ -178,6 +180,16 @@ ParseOptions(int argc, char *argv[], int *nports, int *maxpending)
 	    }
 	    break;
 
+	case 'N':	/* number of event loop threads */
+	    sts = (int)strtol(opts.optarg, &endnum, 10);
+	    if (*endnum != '\0' || sts <= 0) {
+		pmprintf("%s: -N requires a positive value\n", pmGetProgname());
+		opts.errors++;
+	    } else {
+		threads = opts.optarg;
+	    }
+	    break;
+
 	case 'p':
 	    if (__pmServerAddPorts(opts.optarg) < 0) {
 		pmprintf("%s: -p requires a positive numeric argument (%s)\n",
@@ -258,6 +270,8 @@ ParseOptions(int argc, char *argv[], int *nports, int *maxpending)
 	/* Extract pmproxy configuration information needed immediately */
 	if ((option = pmIniFileLookup(config, "pmproxy", "maxpending")))
 	    *maxpending = atoi(option);
+	if (threads != NULL)
+	    pmIniFileUpdate(config, "pmproxy", "threads", sdsnew(threads));
 
 	/*
 	 * Push command line options into the configuration, and ensure
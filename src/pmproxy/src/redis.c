@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2018-2021 Red Hat.
+ * Copyright (c) 2018-2021,2026 Red Hat.
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms of the GNU Lesser General Public License as published
@@ -40,61 +40,171 @@ static pmDiscoverCallBacks redis_search = {
 static pmDiscoverSettings redis_discover = {
     .module.on_info	= proxylog,
 };
+static pmDiscoverModule *discover_module;
 
 static void redis_reconnect_worker(void *);
+static void redis_reconnect_timer(uv_timer_t *);
 
-static sds
-redisfmt(redisReply *reply)
+/*
+ * Replies are re-encoded from the parsed form for the client, as the
+ * Redis connections are shared with the series and search modules that
+ * need it.  This is done in two passes, sizing and then filling in one
+ * buffer, so a reply of any size and depth needs a single allocation
+ * and each byte is copied just once.
+ */
+static size_t
+redisnumlen(long long value)
 {
-    sds			c, command = sdsempty();
-    int			i;
+    unsigned long long	v = value < 0 ? -(unsigned long long)value : value;
+    size_t		len = value < 0 ? 2 : 1;
 
-    if (reply == NULL)
-	return command;
+    while (v >= 10) {
+	v /= 10;
+	len++;
+    }
+    return len;
+}
+
+static char *
+redisnumfmt(char *p, char type, long long value)
+{
+    unsigned long long	v = value < 0 ? -(unsigned long long)value : value;
+    char		digits[24];
+    int			n = 0;
+
+    *p++ = type;
+    if (value < 0)
+	*p++ = '-';
+    do {
+	digits[n++] = '0' + (v % 10);
+	v /= 10;
+    } while (v);
+    while (n > 0)
+	*p++ = digits[--n];
+    *p++ = '\r';
+    *p++ = '\n';
+    return p;
+}
+
+/* double replies keep the protocol string, but without setting len */
+static size_t
+redisstrlen(redisReply *reply)
+{
+    if (reply->type == REDIS_REPLY_DOUBLE)
+	return strlen(reply->str);
+    return reply->len;
+}
+
+static char *
+redisstrfmt(char *p, char type, redisReply *reply)
+{
+    size_t		len = redisstrlen(reply);
+
+    *p++ = type;
+    memcpy(p, reply->str, len);
+    p += len;
+    *p++ = '\r';
+    *p++ = '\n';
+    return p;
+}
+
+/* number of entries in an aggregate, maps hold key and value elements */
+static long long
+rediscount(redisReply *reply)
+{
+    if (reply->type == REDIS_REPLY_MAP)
+	return reply->elements / 2;
+    return reply->elements;
+}
+
+static size_t
+redisfmtlen(redisReply *reply)
+{
+    size_t		len, i;
 
     switch (reply->type) {
     case REDIS_REPLY_STRING:
-	command = sdscatfmt(command, "$%U\r\n", (uint64_t)reply->len);
-	command = sdscatlen(command, reply->str, reply->len);
-	return sdscatlen(command, "\r\n", 2);
+	return 1 + redisnumlen(reply->len) + 2 + reply->len + 2;
+    case REDIS_REPLY_ARRAY:
+    case REDIS_REPLY_MAP:
+    case REDIS_REPLY_SET:
+	len = 1 + redisnumlen(rediscount(reply)) + 2;
+	for (i = 0; i < reply->elements; i++)
+	    len += redisfmtlen(reply->element[i]);
+	return len;
+    case REDIS_REPLY_INTEGER:
+	return 1 + redisnumlen(reply->integer) + 2;
+    case REDIS_REPLY_DOUBLE:
+    case REDIS_REPLY_STATUS:
+    case REDIS_REPLY_ERROR:
+	return 1 + redisstrlen(reply) + 2;
+    case REDIS_REPLY_BOOL:
+	return 4;
+    case REDIS_REPLY_NIL:
+	return 5;
+    default:
+	break;
+    }
+    return 0;
+}
+
+static char *
+redisfmtbuf(redisReply *reply, char *p)
+{
+    size_t		i;
+
+    switch (reply->type) {
+    case REDIS_REPLY_STRING:
+	p = redisnumfmt(p, '$', reply->len);
+	memcpy(p, reply->str, reply->len);
+	p += reply->len;
+	*p++ = '\r';
+	*p++ = '\n';
+	return p;
     case REDIS_REPLY_ARRAY:
     case REDIS_REPLY_MAP:
     case REDIS_REPLY_SET:
-	c = sdsempty();
-	for (i = 0; i < reply->elements; i++) {
-	    sds e = redisfmt(reply->element[i]);
-	    c = sdscatsds(c, e);
-	    sdsfree(e);
-	}
 	if (reply->type == REDIS_REPLY_ARRAY)
-	    command = sdscatfmt(command, "*%U\r\n%S", (uint64_t)reply->elements, c);
+	    p = redisnumfmt(p, '*', rediscount(reply));
 	else if (reply->type == REDIS_REPLY_MAP)
-	    command = sdscatfmt(command, "%%%U\r\n%S", (uint64_t)reply->elements, c);
+	    p = redisnumfmt(p, '%', rediscount(reply));
 	else /* (reply->type == REDIS_REPLY_SET) */
-	    command = sdscatfmt(command, "~%U\r\n%S", (uint64_t)reply->elements, c);
-	sdsfree(c);
-	return command;
+	    p = redisnumfmt(p, '~', rediscount(reply));
+	for (i = 0; i < reply->elements; i++)
+	    p = redisfmtbuf(reply->element[i], p);
+	return p;
     case REDIS_REPLY_INTEGER:
-	return sdscatfmt(command, ":%I\r\n", reply->integer);
+	return redisnumfmt(p, ':', reply->integer);
     case REDIS_REPLY_DOUBLE:
-	command = sdscatlen(command, ",", 1);
-	command = sdscatlen(command, reply->str, reply->len);
-	return sdscatlen(command, "\r\n", 2);
+	return redisstrfmt(p, ',', reply);
     case REDIS_REPLY_STATUS:
-	command = sdscatlen(command, "+", 1);
-	command = sdscatlen(command, reply->str, reply->len);
-	return sdscatlen(command, "\r\n", 2);
+	return redisstrfmt(p, '+', reply);
     case REDIS_REPLY_ERROR:
-	command = sdscatlen(command, "-", 1);
-	command = sdscatlen(command, reply->str, reply->len);
-	return sdscatlen(command, "\r\n", 2);
+	return redisstrfmt(p, '-', reply);
     case REDIS_REPLY_BOOL:
-	return sdscatfmt(command, "#%s\r\n", reply->integer ? "t" : "f");
+	memcpy(p, reply->integer ? "#t\r\n" : "#f\r\n", 4);
+	return p + 4;
     case REDIS_REPLY_NIL:
-	return sdscat(command, "$-1\r\n");
+	memcpy(p, "$-1\r\n", 5);
+	return p + 5;
     default:
 	break;
     }
+    return p;
+}
+
+static sds
+redisfmt(redisReply *reply)
+{
+    sds			command = sdsempty();
+    char		*end;
+
+    if (reply == NULL)
+	return command;
+
+    command = sdsMakeRoomFor(command, redisfmtlen(reply));
+    end = redisfmtbuf(reply, command);
+    sdsIncrLen(command, (int)(end - command));
     return command;
 }
 
@@ -165,7 +275,9 @@ on_redis_connected(void *arg)
 	redis_discover.callbacks = redis_search;
     }
 
-    if (archive_discovery && (series_queries || search_queries)) {
+    /* archive discovery is performed by the main event loop only */
+    if (archive_discovery && (series_queries || search_queries) &&
+	proxy->worker == 0) {
 	mmv_registry_t	*registry = proxymetrics(proxy, METRICS_DISCOVER);
 
 	pmDiscoverSetEventLoop(&redis_discover.module, proxy->events);
@@ -173,11 +285,22 @@ on_redis_connected(void *arg)
 	pmDiscoverSetMetricRegistry(&redis_discover.module, registry);
 	pmDiscoverSetup(&redis_discover.module, &redis_discover.callbacks, proxy);
 	pmDiscoverSetSlots(&redis_discover.module, proxy->slots);
+	discover_module = &redis_discover.module;
     }
 
     proxy->redisetup = 1;
 }
 
+/*
+ * Archive discovery module for records streamed by pmlogger -R,
+ * or NULL if discovery is not (yet) setup on the main event loop.
+ */
+pmDiscoverModule *
+redis_discover_module(struct proxy *proxy)
+{
+    return proxy->worker == 0 ? discover_module : NULL;
+}
+
 static redisSlotsFlags
 get_redis_slots_flags()
 {
@@ -225,7 +348,11 @@ setup_redis_module(struct proxy *proxy)
 			proxy, proxy->events, proxy);
 	redisSlotsSetMetricRegistry(proxy->slots, registry);
 	redisSlotsSetupMetrics(proxy->slots);
-	pmWebTimerRegister(redis_reconnect_worker, proxy);
+	proxy->redisreconnect = REDIS_RECONNECT_INTERVAL;
+	if (proxy->worker == 0)
+	    pmWebTimerRegister(redis_reconnect_worker, proxy);
+	else
+	    uv_timer_start(&proxy->timer, redis_reconnect_timer, 1000, 1000);
     }
 }
 
@@ -233,14 +360,13 @@ static void
 redis_reconnect_worker(void *arg)
 {
     struct proxy	*proxy = (struct proxy *)arg;
-    static unsigned int	wait_sec = REDIS_RECONNECT_INTERVAL;
 
     /* wait X seconds, because this timer callback is called every second */
-    if (wait_sec > 1) {
-	wait_sec--;
+    if (proxy->redisreconnect > 1) {
+	proxy->redisreconnect--;
 	return;
     }
-    wait_sec = REDIS_RECONNECT_INTERVAL;
+    proxy->redisreconnect = REDIS_RECONNECT_INTERVAL;
 
     /*
      * skip if Redis is disabled or state is not SLOTS_DISCONNECTED
@@ -256,6 +382,15 @@ redis_reconnect_worker(void *arg)
 			proxy, proxy->events, proxy);
 }
 
+/* worker event loops cannot use the (main loop) pmWebTimer service */
+static void
+redis_reconnect_timer(uv_timer_t *arg)
+{
+    uv_handle_t		*handle = (uv_handle_t *)arg;
+
+    redis_reconnect_worker(handle->data);
+}
+
 void
 close_redis_module(struct proxy *proxy)
 {
@@ -264,8 +399,10 @@ close_redis_module(struct proxy *proxy)
 	proxy->slots = NULL;
     }
 
-    if (archive_discovery)
+    if (archive_discovery && proxy->worker == 0) {
 	pmDiscoverClose(&redis_discover.module);
+	discover_module = NULL;
+    }
 
     proxymetrics_close(proxy, METRICS_REDIS);
     proxymetrics_close(proxy, METRICS_DISCOVER);
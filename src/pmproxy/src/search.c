@@ -501,22 +501,22 @@ pmsearch_request_done(struct client *client)
 
     switch (baton->restkey) {
     case RESTKEY_TEXT:
-	if ((sts = pmSearchTextQuery(&pmsearch_settings, &baton->request, baton)) < 0)
+	if ((sts = pmSearchTextQuery(&client->proxy->search, &baton->request, baton)) < 0)
 	    on_pmsearch_done(sts, baton);
 	break;
 
     case RESTKEY_SUGGEST:
-	if ((sts = pmSearchTextSuggest(&pmsearch_settings, &baton->request, baton)) < 0)
+	if ((sts = pmSearchTextSuggest(&client->proxy->search, &baton->request, baton)) < 0)
 	    on_pmsearch_done(sts, baton);
 	break;
 
     case RESTKEY_INDOM:
-	if ((sts = pmSearchTextInDom(&pmsearch_settings, &baton->request, baton)) < 0)
+	if ((sts = pmSearchTextInDom(&client->proxy->search, &baton->request, baton)) < 0)
 	    on_pmsearch_done(sts, baton);
 	break;
 
     case RESTKEY_INFO:
-	if ((sts = pmSearchInfo(&pmsearch_settings, PARAM_TEXT, baton)) < 0)
+	if ((sts = pmSearchInfo(&client->proxy->search, PARAM_TEXT, baton)) < 0)
 	    on_pmsearch_done(sts, baton);
 	break;
 
@@ -531,6 +531,20 @@ static void
 pmsearch_servlet_setup(struct proxy *proxy)
 {
     mmv_registry_t	*metric_registry = proxymetrics(proxy, METRICS_SEARCH);
+    pmSearchModule	*module = &proxy->search.module;
+
+    proxy->search = pmsearch_settings;	/* struct copy */
+
+    pmSearchSetSlots(module, proxy->slots);
+    pmSearchSetEventLoop(module, proxy->events);
+    pmSearchSetConfiguration(module, proxy->config);
+    pmSearchSetMetricRegistry(module, metric_registry);
+
+    pmSearchSetup(module, proxy);
+
+    /* request parameter names are shared by all event loops */
+    if (proxy->worker != 0)
+	return;
 
     PARAM_CLIENT = sdsnew("clientid");
     PARAM_TEXT = sdsnew("text");
@@ -541,21 +555,17 @@ pmsearch_servlet_setup(struct proxy *proxy)
     PARAM_TYPE = sdsnew("type");
     PARAM_LIMIT = sdsnew("limit");
     PARAM_OFFSET = sdsnew("offset");
-
-    pmSearchSetSlots(&pmsearch_settings.module, proxy->slots);
-    pmSearchSetEventLoop(&pmsearch_settings.module, proxy->events);
-    pmSearchSetConfiguration(&pmsearch_settings.module, proxy->config);
-    pmSearchSetMetricRegistry(&pmsearch_settings.module, metric_registry);
-
-    pmSearchSetup(&pmsearch_settings.module, proxy);
 }
 
 static void
 pmsearch_servlet_close(struct proxy *proxy)
 {
-    pmSearchClose(&pmsearch_settings.module);
+    pmSearchClose(&proxy->search.module);
     proxymetrics_close(proxy, METRICS_SEARCH);
 
+    if (proxy->worker != 0)
+	return;
+
     sdsfree(PARAM_CLIENT);
     sdsfree(PARAM_TEXT);
     sdsfree(PARAM_QUERY);
@@ -174,8 +174,7 @@ on_pmseries_value(pmSID sid, pmSeriesValue *value, void *arg)
 {
     pmSeriesBaton	*baton = (pmSeriesBaton *)arg;
     struct client	*client = baton->client;
-    const char		*prefix;
-    sds			timestamp, series, quoted;
+    sds			timestamp, series;
     sds			result = http_get_buffer(baton->client);
 
     if (pmDebugOptions.query && pmDebugOptions.desperate)
@@ -185,21 +184,24 @@ on_pmseries_value(pmSID sid, pmSeriesValue *value, void *arg)
 
     timestamp = value->timestamp;
     series = value->series;
-    quoted = sdscatrepr(sdsempty(), value->data, sdslen(value->data));
 
     if (baton->series++ == 0) {
 	result = push_client_identifier(baton, result);
 	baton->suffix = json_push_suffix(baton->suffix, JSON_FLAG_ARRAY);
-	prefix = "[";
+	result = json_cat_literal(result, "[{\"series\":\"");
     } else {
-	prefix = ",";
+	result = json_cat_literal(result, ",{\"series\":\"");
     }
-    result = sdscatfmt(result, "%s{\"series\":\"%S\",", prefix, sid);
-    if (sdscmp(sid, series) != 0)	/* an instance of a metric */
-	result = sdscatfmt(result, "\"instance\":\"%S\",", series);
-    result = sdscatfmt(result, "\"timestamp\":%S,", timestamp);
-    result = sdscatfmt(result, "\"value\":%S}", quoted);
-    sdsfree(quoted);
+    result = sdscatsds(result, sid);
+    if (sdscmp(sid, series) != 0) {	/* an instance of a metric */
+	result = json_cat_literal(result, "\",\"instance\":\"");
+	result = sdscatsds(result, series);
+    }
+    result = json_cat_literal(result, "\",\"timestamp\":");
+    result = sdscatsds(result, timestamp);
+    result = json_cat_literal(result, ",\"value\":");
+    result = json_cat_repr(result, value->data, sdslen(value->data));
+    result = sdscatlen(result, "}", 1);
 
     http_set_buffer(client, result, HTTP_FLAG_JSON);
     http_transfer(client);
@@ -248,7 +250,7 @@ on_pmseries_metric(pmSID sid, sds name, void *arg)
     const char		*prefix;
     sds			s, quoted, result = http_get_buffer(client);
 
-    quoted = sdscatrepr(sdsempty(), name, sdslen(name));
+    quoted = json_cat_repr(sdsempty(), name, sdslen(name));
     if (sid == NULL) {	/* request for all metric names globally */
 	if (baton->values == 0) {
 	    result = push_client_identifier(baton, result);
@@ -294,7 +296,7 @@ on_pmseries_context(pmSID sid, sds name, void *arg)
     const char		*prefix;
     sds			s, quoted, result = http_get_buffer(client);
 
-    quoted = sdscatrepr(sdsempty(), name, sdslen(name));
+    quoted = json_cat_repr(sdsempty(), name, sdslen(name));
     if (sid == NULL) {	/* request for all source names */
 	if (baton->values == 0) {
 	    result = push_client_identifier(baton, result);
@@ -459,7 +461,7 @@ on_pmseries_instance(pmSID sid, sds name, void *arg)
     const char		*prefix;
     sds			s, quoted, result = http_get_buffer(client);
 
-    quoted = sdscatrepr(sdsempty(), name, sdslen(name));
+    quoted = json_cat_repr(sdsempty(), name, sdslen(name));
     if (sid == NULL) {	/* all instances globally requested */
 	if (baton->values == 0) {
 	    result = push_client_identifier(baton, result);
@@ -511,7 +513,7 @@ on_pmseries_inst(pmSID sid, pmSeriesInst *inst, void *arg)
     series = inst->series;
     source = inst->source;
     instid = inst->instid;
-    quoted = sdscatrepr(sdsempty(), inst->name, sdslen(inst->name));
+    quoted = json_cat_repr(sdsempty(), inst->name, sdslen(inst->name));
 
     if (baton->values++ == 0) {
 	result = push_client_identifier(baton, result);
@@ -611,7 +613,7 @@ on_pmseries_error(pmLogLevel level, sds message, void *arg)
     if (((status_code = client->u.http.parser.status_code)) == 0)
 	status_code = (level > PMLOG_REQUEST) ?
 		HTTP_STATUS_INTERNAL_SERVER_ERROR : HTTP_STATUS_BAD_REQUEST;
-    quoted = sdscatrepr(sdsempty(), message, sdslen(message));
+    quoted = json_cat_repr(sdsempty(), message, sdslen(message));
     msg = sdsnewlen("{", 1);
     if (baton->clientid)
 	msg = sdscatfmt(msg, "\"client\":%S,", baton->clientid);
@@ -677,7 +679,7 @@ pmseries_setup_request_parameters(struct client *client,
 	/* allow all APIs to pass(-through) a 'client' parameter */
 	if ((entry = dictFind(parameters, PARAM_CLIENT)) != NULL) {
 	    series = dictGetVal(entry);   /* leave sds value, dup'd below */
-	    baton->clientid = sdscatrepr(sdsempty(), series, sdslen(series));
+	    baton->clientid = json_cat_repr(sdsempty(), series, sdslen(series));
 	}
     }
 
@@ -872,7 +874,7 @@ pmseries_load_work(uv_work_t *load)
     pmSeriesBaton	*baton = (pmSeriesBaton *)load->data;
     int			sts;
 
-    if ((sts = pmSeriesLoad(&pmseries_settings,
+    if ((sts = pmSeriesLoad(&baton->client->proxy->series,
 				    baton->query, baton->flags, baton)) < 0)
 	on_pmseries_done(sts, baton);
 }
@@ -939,47 +941,47 @@ pmseries_request_done(struct client *client)
 
     switch (baton->restkey) {
     case RESTKEY_QUERY:
-	if ((sts = pmSeriesQuery(&pmseries_settings,
+	if ((sts = pmSeriesQuery(&baton->client->proxy->series,
 					baton->query, baton->flags, baton)) < 0)
 	    on_pmseries_done(sts, baton);
 	break;
 
     case RESTKEY_DESC:
-	if ((sts = pmSeriesDescs(&pmseries_settings,
+	if ((sts = pmSeriesDescs(&baton->client->proxy->series,
 					baton->nsids, baton->sids, baton)) < 0)
 	    on_pmseries_done(sts, baton);
 	break;
 
     case RESTKEY_INSTS:
-	if ((sts = pmSeriesInstances(&pmseries_settings,
+	if ((sts = pmSeriesInstances(&baton->client->proxy->series,
 					baton->nsids, baton->sids, baton)) < 0)
 	    on_pmseries_done(sts, baton);
 	break;
 
     case RESTKEY_LABELS:
 	sts = (baton->names == NULL) ?
-	    pmSeriesLabels(&pmseries_settings,
+	    pmSeriesLabels(&baton->client->proxy->series,
 					baton->nsids, baton->sids, baton) :
-	    pmSeriesLabelValues(&pmseries_settings,
+	    pmSeriesLabelValues(&baton->client->proxy->series,
 					baton->nnames, baton->names, baton);
 	if (sts < 0)
 	    on_pmseries_done(sts, baton);
 	break;
 
     case RESTKEY_METRIC:
-	if ((sts = pmSeriesMetrics(&pmseries_settings,
+	if ((sts = pmSeriesMetrics(&baton->client->proxy->series,
 					baton->nsids, baton->sids, baton)) < 0)
 	    on_pmseries_done(sts, baton);
 	break;
 
     case RESTKEY_SOURCE:
-	if ((sts = pmSeriesSources(&pmseries_settings,
+	if ((sts = pmSeriesSources(&baton->client->proxy->series,
 					baton->nsids, baton->sids, baton)) < 0)
 	    on_pmseries_done(sts, baton);
 	break;
 
     case RESTKEY_VALUES:
-	if ((sts = pmSeriesValues(&pmseries_settings, &baton->window,
+	if ((sts = pmSeriesValues(&baton->client->proxy->series, &baton->window,
 					baton->nsids, baton->sids, baton)) < 0)
 	    on_pmseries_done(sts, baton);
 	break;
@@ -999,6 +1001,20 @@ static void
 pmseries_servlet_setup(struct proxy *proxy)
 {
     mmv_registry_t	*metric_registry = proxymetrics(proxy, METRICS_SERIES);
+    pmSeriesModule	*module = &proxy->series.module;
+
+    proxy->series = pmseries_settings;	/* struct copy */
+
+    pmSeriesSetSlots(module, proxy->slots);
+    pmSeriesSetEventLoop(module, proxy->events);
+    pmSeriesSetConfiguration(module, proxy->config);
+    pmSeriesSetMetricRegistry(module, metric_registry);
+
+    pmSeriesSetup(module, proxy);
+
+    /* request parameter names are shared by all event loops */
+    if (proxy->worker != 0)
+	return;
 
     PARAM_EXPR = sdsnew("expr");
     PARAM_MATCH = sdsnew("match");
@@ -1020,21 +1036,17 @@ pmseries_servlet_setup(struct proxy *proxy)
     PARAM_START = sdsnew("start");
     PARAM_FINISH = sdsnew("finish");
     PARAM_ZONE = sdsnew("zone");
-
-    pmSeriesSetSlots(&pmseries_settings.module, proxy->slots);
-    pmSeriesSetEventLoop(&pmseries_settings.module, proxy->events);
-    pmSeriesSetConfiguration(&pmseries_settings.module, proxy->config);
-    pmSeriesSetMetricRegistry(&pmseries_settings.module, metric_registry);
-
-    pmSeriesSetup(&pmseries_settings.module, proxy);
 }
 
 static void
 pmseries_servlet_close(struct proxy *proxy)
 {
-    pmSeriesClose(&pmseries_settings.module);
+    pmSeriesClose(&proxy->series.module);
     proxymetrics_close(proxy, METRICS_SERIES);
 
+    if (proxy->worker != 0)
+	return;
+
     sdsfree(PARAM_EXPR);
     sdsfree(PARAM_MATCH);
     sdsfree(PARAM_NAME);
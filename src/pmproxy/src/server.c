@@ -78,6 +78,10 @@ proxymetrics(struct proxy *proxy, enum proxy_registry prid)
     if (prid >= NUM_REGISTRY || prid <= METRICS_NOTUSED)
 	return NULL;
 
+    /* instrumentation is exported by the main event loop only */
+    if (proxy->worker != 0)
+	return NULL;
+
     if (proxy->metrics[prid] != NULL)	/* already setup */
 	return proxy->metrics[prid];
 
@@ -99,7 +103,7 @@ proxymetrics(struct proxy *proxy, enum proxy_registry prid)
 void
 proxymetrics_close(struct proxy *proxy, enum proxy_registry prid)
 {
-    if (prid >= NUM_REGISTRY || prid <= METRICS_NOTUSED)
+    if (prid >= NUM_REGISTRY || prid <= METRICS_NOTUSED || proxy->worker != 0)
 	return;
 
     if (proxy->metrics[prid] != NULL) {
@@ -162,6 +166,40 @@ server_init(int portcount, const char *localpath)
     return proxy;
 }
 
+/*
+ * Each additional event loop has its own proxy structure (and hence
+ * its own module state, Redis connection and REST API context cache),
+ * and shares the TCP request ports of the main loop via SO_REUSEPORT.
+ */
+static int
+worker_init(struct proxy *proxy, struct proxy *worker, unsigned int index,
+		int portcount)
+{
+    int			sts;
+
+    if ((worker->servers = calloc(portcount, sizeof(struct server))) == NULL)
+	return -ENOMEM;
+    if ((worker->events = malloc(sizeof(uv_loop_t))) == NULL) {
+	free(worker->servers);
+	worker->servers = NULL;
+	return -ENOMEM;
+    }
+    if ((sts = uv_loop_init(worker->events)) != 0) {
+	pmNotifyErr(LOG_ERR, "%s: %s - %s failed [%s]: %s\n",
+		    pmGetProgname(), "worker_init", "uv_loop_init",
+		    uv_err_name(sts), uv_strerror(sts));
+	free(worker->events);
+	worker->events = NULL;
+	free(worker->servers);
+	worker->servers = NULL;
+	return sts;
+    }
+    uv_mutex_init(&worker->write_mutex);
+    worker->config = proxy->config;
+    worker->worker = index;
+    return 0;
+}
+
 static void
 signal_handler(uv_signal_t *sighandle, int signum)
 {
@@ -255,6 +293,7 @@ client_put(struct client *client)
 	    on_secure_client_close(client);
 	if (client->buffer)
 	    sdsfree(client->buffer);
+	uv_cond_destroy(&client->drained);
 	memset(client, 0, sizeof(*client));
 	free(client);
     }
@@ -272,6 +311,11 @@ client_close(struct client *client)
     if (client->opened == 1) {
 	client->opened = 0;
 	uv_close((uv_handle_t *)client, on_client_close);
+
+	/* wake any thread waiting in client_write_wait */
+	uv_mutex_lock(&client->mutex);
+	uv_cond_broadcast(&client->drained);
+	uv_mutex_unlock(&client->mutex);
     }
 }
 
@@ -285,6 +329,13 @@ on_client_write(uv_write_t *writer, int status)
 	fprintf(stderr, "%s: completed write [sts=%d] to client %p\n",
 			"on_client_write", status, client);
 
+    if (request->length) {
+	uv_mutex_lock(&client->mutex);
+	client->pending -= request->length;
+	uv_cond_broadcast(&client->drained);
+	uv_mutex_unlock(&client->mutex);
+    }
+
     if (status == 0) {
 	if ((client->protocol & STREAM_SECURE) && client->stream.secure)
 	    on_secure_client_write(client);
@@ -378,6 +429,11 @@ client_write(struct client *client, sds buffer, sds suffix)
 	request->nbuffers = nbuffers;
 	request->writer.data = client;
 	request->callback = on_client_write;
+	request->length = sdslen(buffer) + (suffix ? sdslen(suffix) : 0);
+
+	uv_mutex_lock(&client->mutex);
+	client->pending += request->length;
+	uv_mutex_unlock(&client->mutex);
 
 	/* client must not get freed while waiting for the write callback to fire */
 	client_get(client);
@@ -387,6 +443,32 @@ client_write(struct client *client, sds buffer, sds suffix)
     }
 }
 
+/*
+ * Backpressure for response producers running outside the event loop
+ * thread (e.g. libuv worker threads servicing REST API requests) - wait
+ * until the bytes queued for this client, but not yet written to it,
+ * drop to the given limit.  Write completion in the event loop thread
+ * signals the waiter.  Never blocks the event loop thread itself, as
+ * that is where the queued writes are performed.
+ */
+void
+client_write_wait(struct client *client, size_t limit)
+{
+    uv_thread_t		self = uv_thread_self();
+
+    if (uv_thread_equal(&self, &client->proxy->thread))
+	return;
+
+    uv_mutex_lock(&client->mutex);
+    while (client->pending > limit && client->opened) {
+	if (pmDebugOptions.af)
+	    fprintf(stderr, "%s: client %p waiting on %ld pending bytes\n",
+			"client_write_wait", client, (long)client->pending);
+	uv_cond_wait(&client->drained, &client->mutex);
+    }
+    uv_mutex_unlock(&client->mutex);
+}
+
 static enum stream_protocol
 client_protocol(int key)
 {
@@ -503,8 +585,9 @@ on_client_connection(uv_stream_t *stream, int status)
 	fprintf(stderr, "%s: accept new client %p\n",
 			"on_client_connection", client);
 
-    /* prepare per-client lock for reference counting */
+    /* prepare per-client lock for reference counting and write queueing */
     uv_mutex_init(&client->mutex);
+    uv_cond_init(&client->drained);
     client->refcount = 1;
     client->opened = 1;
 
@@ -539,6 +622,22 @@ on_client_connection(uv_stream_t *stream, int status)
     }
 }
 
+static void
+set_reuse_port(uv_handle_t *handle)
+{
+#ifdef SO_REUSEPORT
+    uv_os_fd_t		uv_fd;
+    int			one = 1;
+
+    if (uv_fileno(handle, &uv_fd) == 0 &&
+	setsockopt((int)uv_fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0)
+	pmNotifyErr(LOG_ERR, "%s: %s - setsockopt(SO_REUSEPORT) failed: %s\n",
+			pmGetProgname(), "set_reuse_port", osstrerror());
+#else
+    (void)handle;
+#endif
+}
+
 static int
 open_request_port(struct proxy *proxy, struct server *server,
 		stream_family_t family, const struct sockaddr *addr,
@@ -557,8 +656,15 @@ open_request_port(struct proxy *proxy, struct server *server,
 	flags = UV_TCP_IPV6ONLY;
     stream->port = port;
 
-    uv_tcp_init(proxy->events, &stream->u.tcp);
     handle = (uv_handle_t *)&stream->u.tcp;
+    if (proxy->worker == 0 && proxy->nworkers == 0) {
+	uv_tcp_init(proxy->events, &stream->u.tcp);
+    } else {
+	/* socket must exist before bind to share the port between loops */
+	uv_tcp_init_ex(proxy->events, &stream->u.tcp,
+			family == STREAM_TCP6 ? AF_INET6 : AF_INET);
+	set_reuse_port(handle);
+    }
     handle->data = (void *)proxy;
 
     uv_tcp_bind(&stream->u.tcp, addr, flags);
@@ -574,7 +680,7 @@ open_request_port(struct proxy *proxy, struct server *server,
 	return -ENOTCONN;
     }
     stream->active = 1;
-    if (__pmServerHasFeature(PM_SERVER_FEATURE_DISCOVERY))
+    if (__pmServerHasFeature(PM_SERVER_FEATURE_DISCOVERY) && proxy->worker == 0)
 	server->presence = __pmServerAdvertisePresence(PM_SERVER_PROXY_SPEC, port);
     return 0;
 }
@@ -635,18 +741,34 @@ typedef struct proxyaddr {
     int			port;
 } proxyaddr;
 
+static int
+open_request_addr(struct proxy *proxy, struct server *server,
+		struct proxyaddr *proxyaddr, int maxpending)
+{
+    const struct sockaddr *sockaddr = (const struct sockaddr *)proxyaddr->addr;
+    enum stream_family	family;
+    int			port;
+
+    family = __pmSockAddrGetFamily(proxyaddr->addr) == AF_INET ?
+					STREAM_TCP4 : STREAM_TCP6;
+    port = __pmSockAddrGetPort(proxyaddr->addr);
+    server->stream.address = proxyaddr->address;
+    return open_request_port(proxy, server, family, sockaddr, port, maxpending);
+}
+
 static void *
 open_request_ports(char *localpath, size_t localpathlen, int maxpending)
 {
     int			inaddr, total, count, port, sts, i, n;
     int			with_ipv6 = strcmp(pmGetAPIConfig("ipv6"), "true") == 0;
+    int			threads = 1;
+    unsigned int	w;
     const char		*address;
     __pmSockAddr	*addr;
     struct proxyaddr	*addrlist;
-    const struct sockaddr *sockaddr;
-    enum stream_family	family;
     struct server	*server;
-    struct proxy	*proxy;
+    struct proxy	*proxy, *worker;
+    sds			option;
 
     if (localpath[0] == '\0')
 	setup_default_local_path(localpath, localpathlen);
@@ -703,6 +825,19 @@ open_request_ports(char *localpath, size_t localpathlen, int maxpending)
 
     signal_init(proxy);
 
+    if ((option = pmIniFileLookup(config, "pmproxy", "threads")) != NULL)
+	threads = atoi(option);
+#ifndef SO_REUSEPORT
+    if (threads > 1) {
+	pmNotifyErr(LOG_WARNING, "%s: no SO_REUSEPORT support, "
+			"using a single event loop thread\n", pmGetProgname());
+	threads = 1;
+    }
+#endif
+    if (threads > 1 &&
+	(proxy->workers = calloc(threads - 1, sizeof(struct proxy))) != NULL)
+	proxy->nworkers = threads - 1;
+
     count = n = 0;
     if (*localpath) {
 	unlink(localpath);
@@ -713,29 +848,39 @@ open_request_ports(char *localpath, size_t localpathlen, int maxpending)
     }
 
     for (i = 0; i < total; i++) {
-	sockaddr = (const struct sockaddr *)addrlist[i].addr;
-	family = __pmSockAddrGetFamily(addrlist[i].addr) == AF_INET ?
-					STREAM_TCP4 : STREAM_TCP6;
-	port = __pmSockAddrGetPort(addrlist[i].addr);
 	server = &proxy->servers[n++];
-	server->stream.address = addrlist[i].address;
-	if (open_request_port(proxy, server, family, sockaddr, port, maxpending) == 0)
+	if (open_request_addr(proxy, server, &addrlist[i], maxpending) == 0)
 	    count++;
-	__pmSockAddrFree(addrlist[i].addr);
     }
-    free(addrlist);
 
     if (count == 0) {
 	pmNotifyErr(LOG_ERR, "%s: can't open any request ports, exiting\n",
 		pmGetProgname());
+	free(proxy->workers);
 	free(proxy);
-	return NULL;
+	goto fail;
     }
     proxy->nservers = n;
+
+    /* additional event loops share the TCP ports, but not the local socket */
+    for (w = 0; w < proxy->nworkers; w++) {
+	worker = &proxy->workers[w];
+	if (worker_init(proxy, worker, w + 1, total) < 0) {
+	    proxy->nworkers = w;
+	    break;
+	}
+	for (i = 0; i < total; i++)
+	    open_request_addr(worker, &worker->servers[i], &addrlist[i], maxpending);
+	worker->nservers = total;
+    }
+
+    for (i = 0; i < total; i++)
+	__pmSockAddrFree(addrlist[i].addr);
+    free(addrlist);
     return proxy;
 
 fail:
-    for (i = 0; i < n; i++)
+    for (i = 0; i < total; i++)
 	__pmSockAddrFree(addrlist[i].addr);
     free(addrlist);
     return NULL;
@@ -767,6 +912,9 @@ dump_request_ports(FILE *output, void *arg)
 		    stream->family == STREAM_TCP4 ? "inet" : "ipv6",
 		    stream->address ? stream->address : "INADDR_ANY");
     }
+    if (proxy->nworkers)
+	fprintf(output, "  TCP ports shared with %u additional event loop thread(s)\n",
+		    proxy->nworkers);
 }
 
 static void
@@ -779,9 +927,8 @@ close_proxy(struct proxy *proxy)
 }
 
 static void
-shutdown_ports(void *arg)
+close_request_ports(struct proxy *proxy)
 {
-    struct proxy	*proxy = (struct proxy *)arg;
     struct server	*server;
     struct stream	*stream;
     unsigned int	i;
@@ -801,7 +948,52 @@ shutdown_ports(void *arg)
 	}
     }
     proxy->nservers = 0;
+}
+
+/*
+ * Worker event loop shutdown, requested from the main thread -
+ * the listening ports are closed so no new clients arrive, and
+ * the loop is stopped; modules are closed once uv_run returns.
+ */
+static void
+on_worker_stop(uv_async_t *arg)
+{
+    uv_handle_t		*handle = (uv_handle_t *)arg;
+    struct proxy	*proxy = (struct proxy *)handle->data;
+
+    close_request_ports(proxy);
+    uv_timer_stop(&proxy->timer);
+    uv_close(handle, NULL);
+    uv_stop(proxy->events);
+}
 
+static void
+stop_workers(struct proxy *proxy)
+{
+    struct proxy	*worker;
+    unsigned int	i;
+
+    for (i = 0; i < proxy->nworkers; i++) {
+	worker = &proxy->workers[i];
+	if (uv_is_active((uv_handle_t *)&worker->stop)) {
+	    uv_async_send(&worker->stop);
+	    uv_thread_join(&worker->thread);
+	}
+	free(worker->servers);
+	worker->servers = NULL;
+    }
+    free(proxy->workers);
+    proxy->workers = NULL;
+    proxy->nworkers = 0;
+}
+
+static void
+shutdown_ports(void *arg)
+{
+    struct proxy	*proxy = (struct proxy *)arg;
+
+    stop_workers(proxy);
+    close_request_ports(proxy);
     close_proxy(proxy);
     if (proxy->config) {
 	pmIniFileFree(proxy->config);
@@ -825,11 +1017,47 @@ shutdown_proxy(uv_timer_t *arg)
     exit(0);
 }
 
+static void
+setup_modules(struct proxy *proxy)
+{
+    setup_secure_module(proxy);
+    setup_redis_module(proxy);
+    setup_http_module(proxy);
+    setup_pcp_module(proxy);
+}
+
+static void worker_loop(void *);
+
+static void
+start_workers(struct proxy *proxy)
+{
+    struct proxy	*worker;
+    uv_handle_t		*handle;
+    unsigned int	i;
+    int			sts;
+
+    for (i = 0; i < proxy->nworkers; i++) {
+	worker = &proxy->workers[i];
+	uv_async_init(worker->events, &worker->stop, on_worker_stop);
+	handle = (uv_handle_t *)&worker->stop;
+	handle->data = (void *)worker;
+	sts = uv_thread_create(&worker->thread, worker_loop, worker);
+	if (sts != 0) {
+	    pmNotifyErr(LOG_ERR, "%s: %s - %s failed [%s]: %s\n",
+			pmGetProgname(), "start_workers", "uv_thread_create",
+			uv_err_name(sts), uv_strerror(sts));
+	    uv_close(handle, NULL);
+	}
+    }
+}
+
 /*
  * Initial setup for each of the major sub-systems modules,
  * which is achieved via a timer that expires immediately.
  * Once any connections are established (async) modules are
  * again informed via their individual setup routines.
+ * Worker event loops start only after this, as they share
+ * some module state setup by the main loop.
  */
 static void
 setup_proxy(uv_timer_t *arg)
@@ -837,10 +1065,8 @@ setup_proxy(uv_timer_t *arg)
     uv_handle_t		*handle = (uv_handle_t *)arg;
     struct proxy	*proxy = (struct proxy *)handle->data;
 
-    setup_secure_module(proxy);
-    setup_redis_module(proxy);
-    setup_http_module(proxy);
-    setup_pcp_module(proxy);
+    setup_modules(proxy);
+    start_workers(proxy);
 }
 
 static void
@@ -871,6 +1097,8 @@ main_loop(void *arg, struct timeval *runtime)
     uv_check_t		after_io;
     uv_handle_t		*handle;
 
+    proxy->thread = uv_thread_self();
+
     if (runtime) {
 	uint64_t millisec = runtime->tv_sec * 1000;
 	millisec += runtime->tv_usec / 1000;
@@ -901,6 +1129,48 @@ main_loop(void *arg, struct timeval *runtime)
     uv_run(proxy->events, UV_RUN_DEFAULT);
 }
 
+/*
+ * Additional event loop thread, accepting clients on the shared
+ * TCP ports and servicing them entirely within this one thread.
+ */
+static void
+worker_loop(void *arg)
+{
+    struct proxy	*proxy = (struct proxy *)arg;
+    uv_prepare_t	before_io;
+    uv_check_t		after_io;
+    uv_handle_t		*handle;
+
+    proxy->thread = uv_thread_self();
+
+    uv_timer_init(proxy->events, &proxy->timer);
+    handle = (uv_handle_t *)&proxy->timer;
+    handle->data = (void *)proxy;
+
+    uv_prepare_init(proxy->events, &before_io);
+    handle = (uv_handle_t *)&before_io;
+    handle->data = (void *)proxy;
+    uv_prepare_start(&before_io, prepare_proxy);
+
+    uv_check_init(proxy->events, &after_io);
+    handle = (uv_handle_t *)&after_io;
+    handle->data = (void *)proxy;
+    uv_check_start(&after_io, check_proxy);
+
+    uv_callback_init(proxy->events, &proxy->write_callbacks,
+		    on_write_callback, UV_DEFAULT);
+
+    setup_modules(proxy);
+
+    uv_run(proxy->events, UV_RUN_DEFAULT);
+
+    close_proxy(proxy);
+    if (uv_loop_close(proxy->events) == 0) {
+	free(proxy->events);
+	proxy->events = NULL;
+    }
+}
+
 struct pmproxy libuv_pmproxy = {
     .openports	= open_request_ports,
     .dumpports	= dump_request_ports,
@@ -47,6 +47,7 @@ typedef struct stream_write_baton {
     uv_write_t		writer;
     uv_buf_t		buffer[2];
     unsigned int	nbuffers;
+    size_t		length;		/* bytes counted in client->pending */
     uv_write_cb		callback;
 } stream_write_baton_t;
 
@@ -91,6 +92,8 @@ typedef struct http_client {
     sds			realm;		/* optional Basic Auth realm */
     void		*privdata;	/* private HTTP parsing state */
     void		*data;		/* opaque servlet information */
+    void		*compress;	/* streaming compression state */
+    sds			response;	/* additional response headers */
     unsigned int	type : 16;	/* HTTP response content type */
     unsigned int	flags : 16;	/* request status flags field */
 } http_client_t;
@@ -137,6 +140,8 @@ typedef struct client {
     } u;
     struct proxy	*proxy;
     sds			buffer;
+    size_t		pending;	/* bytes queued but not yet written */
+    uv_cond_t		drained;	/* signalled on each write completion */
 } client_t;
 
 typedef struct server {
@@ -161,6 +166,16 @@ typedef struct proxy {
     uv_loop_t		*events;	/* global, async event loop */
     uv_callback_t	write_callbacks;
     uv_mutex_t		write_mutex;	/* protects pending writes */
+    pmWebGroupSettings	webgroup;	/* REST API servlet state */
+    pmSeriesSettings	series;		/* time series servlet state */
+    pmSearchSettings	search;		/* search servlet state */
+    unsigned int	redisreconnect; /* seconds until Redis reconnect */
+    unsigned int	worker;		/* event loop thread, zero for main */
+    unsigned int	nworkers;	/* count of additional loop threads */
+    struct proxy	*workers;	/* array of additional loop threads */
+    uv_thread_t		thread;		/* thread running this event loop */
+    uv_async_t		stop;		/* worker loop shutdown request */
+    uv_timer_t		timer;		/* worker loop one second timer */
 } proxy_t;
 
 extern void proxylog(pmLogLevel, sds, void *);
@@ -172,6 +187,7 @@ extern void on_client_write(uv_write_t *, int);
 extern void on_buffer_alloc(uv_handle_t *, size_t, uv_buf_t *);
 
 extern void client_write(struct client *, sds, sds);
+extern void client_write_wait(struct client *, size_t);
 extern int client_is_closed(struct client *);
 extern void client_close(struct client *);
 extern void client_get(struct client *);
@@ -219,6 +235,7 @@ extern void close_secure_module(struct proxy *);
 
 extern void setup_redis_module(struct proxy *);
 extern void close_redis_module(struct proxy *);
+extern pmDiscoverModule *redis_discover_module(struct proxy *);
 
 extern void setup_http_module(struct proxy *);
 extern void close_http_module(struct proxy *);
@@ -226,6 +243,4 @@ extern void close_http_module(struct proxy *);
 extern void setup_pcp_module(struct proxy *);
 extern void close_pcp_module(struct proxy *);
 
-extern void setup_modules(struct proxy *);
-
 #endif	/* PROXY_SERVER_H */
@@ -27,6 +27,7 @@ typedef enum pmWebRestKey {
     RESTKEY_STORE,
     RESTKEY_DERIVE,
     RESTKEY_SCRAPE,
+    RESTKEY_SUBSCRIBE,
 } pmWebRestKey;
 
 typedef struct pmWebRestCommand {
@@ -36,8 +37,13 @@ typedef struct pmWebRestCommand {
     pmWebRestKey	key;
 } pmWebRestCommand;
 
+struct pmWebSubscription;
+
 typedef struct pmWebGroupBaton {
     struct client	*client;
+    struct pmWebGroupBaton *parent;	/* multi-context fetch, if member */
+    struct pmWebSubscription *subscription;	/* subscriber or shared fetch */
+    struct pmWebGroupBaton *next;	/* next subscriber */
     pmWebRestKey	restkey;
     sds			context;
     dict		*labels;
@@ -47,6 +53,8 @@ typedef struct pmWebGroupBaton {
     sds			password;	/* from basic auth header */
     unsigned int	times : 1;
     unsigned int	compat : 1;
+    unsigned int	protobuf : 1;	/* scrape in protobuf format */
+    unsigned int	counter : 1;	/* protobuf family is a counter */
     unsigned int	options : 16;
     unsigned int	numpmids;
     unsigned int	numvsets;
@@ -55,8 +63,66 @@ typedef struct pmWebGroupBaton {
     sds			name;		/* metric currently being processed */
     pmID		pmid;		/* metric currently being processed */
     pmInDom		indom;		/* indom currently being processed */
+    sds			cachekey;	/* scrape cache key for this request */
+    sds			cached;		/* scrape response body for caching */
+    sds			etag;		/* scrape response entity tag */
+    sds			family;		/* protobuf metrics being batched */
+    sds			familyname;	/* protobuf family metric name */
+    sds			familyhelp;	/* protobuf family help text */
+    sds			*members;	/* multi-context fetch contexts or hosts */
+    int			nmembers;
+    unsigned int	byhost : 1;	/* members are hostspecs, not contexts */
+    unsigned int	pending;	/* members yet to complete (parent) */
+    unsigned int	ndone;		/* members already sent (parent) */
+    sds			hostspec;	/* quoted hostspec (member) */
+    sds			buffer;		/* response for this member */
+    dict		*params;	/* request parameters for this member */
+    unsigned int	changed : 1;	/* subscriber wants changed values only */
+    unsigned int	primed : 1;	/* subscriber has had all values once */
 } pmWebGroupBaton;
 
+/*
+ * Streaming subscriptions (/pmapi/subscribe) - clients registering the
+ * same metrics, host or context and interval share a single periodic
+ * fetch, and each result is pushed to all of them as a server-sent
+ * event.  Subscriptions belong to the event loop of their clients.
+ */
+typedef struct pmWebSubscription {
+    sds			key;
+    struct proxy	*proxy;
+    pmWebGroupBaton	*baton;		/* shared fetch state and parameters */
+    pmWebGroupBaton	*subscribers;
+    uv_timer_t		timer;
+    unsigned int	busy : 1;	/* fetch is in progress */
+    unsigned int	closing : 1;	/* no subscribers remain */
+    int			status;		/* result of latest fetch */
+    sds			message;	/* error from latest fetch */
+    sds			stamp;		/* timestamp of latest fetch */
+    sds			vset;		/* values of metric being fetched */
+    sds			all;		/* values of all metrics */
+    sds			changed;	/* values of metrics that changed */
+    dict		*last;		/* metric name: previous values */
+} pmWebSubscription;
+
+/*
+ * Short-lived cache of rendered /metrics responses, so that several
+ * scrapers (e.g. Prometheus replicas) polling at about the same time
+ * are served the same result without repeating the fetches.  Shared
+ * by all event loops; entries for explicitly requested contexts are
+ * specific to the event loop owning the context.
+ */
+typedef struct pmWebScrapeEntry {
+    sds			body;
+    sds			etag;
+    uint64_t		expires;	/* uv_hrtime(3) in nanoseconds */
+    http_flags_t	flags;
+} pmWebScrapeEntry;
+
+static dict		*scrape_cache;
+static uv_mutex_t	scrape_cache_lock;
+static uint64_t		scrape_cache_ttl;	/* nanoseconds, zero disables */
+static unsigned int	scrape_cache_serial;
+
 static pmWebRestCommand commands[] = {
     { .key = RESTKEY_CONTEXT, .options = HTTP_OPTIONS_GET,
 	    .name = "context", .namelen = sizeof("context")-1 },
@@ -76,6 +142,8 @@ static pmWebRestCommand commands[] = {
 	    .name = "store", .namelen = sizeof("store")-1 },
     { .key = RESTKEY_CHILD, .options = HTTP_OPTIONS_GET,
 	    .name = "children", .namelen = sizeof("children")-1 },
+    { .key = RESTKEY_SUBSCRIBE, .options = HTTP_OPTIONS_GET,
+	    .name = "subscribe", .namelen = sizeof("subscribe")-1 },
     { .name = NULL }	/* sentinel */
 };
 
@@ -87,7 +155,12 @@ static pmWebRestCommand openmetrics[] = {
 
 static sds PARAM_NAMES, PARAM_NAME, PARAM_PMIDS, PARAM_PMID,
 	   PARAM_INDOM, PARAM_EXPR, PARAM_VALUE, PARAM_TIMES,
-	   PARAM_CONTEXT, PARAM_CLIENT;
+	   PARAM_CONTEXT, PARAM_CLIENT, PARAM_CONTEXTS, PARAM_HOSTSPECS,
+	   PARAM_HOSTSPEC, PARAM_DELTA, PARAM_CHANGED, PARAM_POLLTIME,
+	   PARAM_RATE;
+
+static dict		*subscriptions;
+static uv_mutex_t	subscriptions_lock;
 
 
 static pmWebRestCommand *
@@ -123,25 +196,78 @@ pmwebapi_lookup_rest_command(sds url, unsigned int *compat, sds *context)
     return NULL;
 }
 
+static void pmwebapi_unsubscribe(pmWebGroupBaton *);
+
 static void
-pmwebapi_data_release(struct client *client)
+pmwebapi_baton_free(pmWebGroupBaton *baton)
 {
-    pmWebGroupBaton	*baton = (pmWebGroupBaton *)client->u.http.data;
-
-    if (pmDebugOptions.http)
-	fprintf(stderr, "%s: baton %p for client %p\n", "pmwebapi_data_release",
-			baton, client);
-
+    if (baton->restkey == RESTKEY_SUBSCRIBE && baton->subscription)
+	pmwebapi_unsubscribe(baton);
     sdsfree(baton->name);
     sdsfree(baton->suffix);
     sdsfree(baton->context);
     sdsfree(baton->clientid);
+    sdsfree(baton->cachekey);
+    sdsfree(baton->cached);
+    sdsfree(baton->etag);
+    sdsfree(baton->family);
+    sdsfree(baton->familyname);
+    sdsfree(baton->familyhelp);
+    sdsfree(baton->username);
+    sdsfree(baton->password);
+    sdsfree(baton->hostspec);
+    sdsfree(baton->buffer);
+    if (baton->members)
+	sdsfreesplitres(baton->members, baton->nmembers);
+    if (baton->params)
+	dictRelease(baton->params);
     if (baton->labels)
 	dictRelease(baton->labels);
     memset(baton, 0, sizeof(*baton));
     free(baton);
 }
 
+static void
+pmwebapi_data_release(struct client *client)
+{
+    pmWebGroupBaton	*baton = (pmWebGroupBaton *)client->u.http.data;
+
+    if (pmDebugOptions.http)
+	fprintf(stderr, "%s: baton %p for client %p\n", "pmwebapi_data_release",
+			baton, client);
+
+    pmwebapi_baton_free(baton);
+}
+
+/*
+ * Fetch results are either sent directly to the client, or for each
+ * member of a multi-context fetch, accumulated separately and then
+ * sent in one piece from the event loop when that member completes.
+ */
+static sds
+pmwebapi_get_buffer(pmWebGroupBaton *baton)
+{
+    sds			buffer;
+
+    if (baton->parent == NULL)
+	return http_get_buffer(baton->client);
+    if ((buffer = baton->buffer) == NULL)
+	buffer = sdsempty();
+    baton->buffer = NULL;
+    return buffer;
+}
+
+static void
+pmwebapi_set_buffer(pmWebGroupBaton *baton, sds buffer)
+{
+    if (baton->parent == NULL) {
+	http_set_buffer(baton->client, buffer, HTTP_FLAG_JSON);
+	http_transfer(baton->client);
+    } else {
+	baton->buffer = buffer;
+    }
+}
+
 static void
 pmwebapi_set_context(pmWebGroupBaton *baton, sds context)
 {
@@ -255,17 +381,113 @@ transfer:
     http_transfer(client);
 }
 
+/*
+ * Subscription fetches render only the values of each metric, kept
+ * separately so that those unchanged since the last fetch can be left
+ * out of the events sent to subscribers asking for changes only.
+ */
+static void
+pmwebapi_subscription_vset(pmWebSubscription *sp, sds name)
+{
+    dictEntry		*entry;
+    sds			vset = sp->vset;
+
+    if (vset == NULL)
+	return;
+    sp->vset = NULL;
+    vset = sdscatlen(vset, "]}", 2);
+
+    if (sdslen(sp->all) > 0)
+	sp->all = sdscatlen(sp->all, ",", 1);
+    sp->all = sdscatsds(sp->all, vset);
+
+    if ((entry = dictFind(sp->last, name)) == NULL) {
+	dictAdd(sp->last, sdsdup(name), vset);
+    } else if (sdscmp((sds)dictGetVal(entry), vset) == 0) {
+	sdsfree(vset);
+	return;
+    } else {
+	sdsfree((sds)dictGetVal(entry));
+	dictSetVal(sp->last, entry, vset);
+    }
+    if (sdslen(sp->changed) > 0)
+	sp->changed = sdscatlen(sp->changed, ",", 1);
+    sp->changed = sdscatsds(sp->changed, vset);
+}
+
+static int
+on_pmwebapi_subscription_fetch(pmWebGroupBaton *baton, pmWebResult *fetch)
+{
+    pmWebSubscription	*sp = baton->subscription;
+
+    sdsfree(sp->vset);
+    sp->vset = NULL;
+    sdsfree(baton->name);
+    baton->name = NULL;
+    sdsclear(sp->all);
+    sdsclear(sp->changed);
+    sdsclear(sp->stamp);
+    sp->stamp = sdscatfmt(sp->stamp, "%I.%I",
+			fetch->seconds, fetch->nanoseconds);
+    baton->numvsets = baton->numinsts = 0;
+    return 0;
+}
+
+static int
+on_pmwebapi_subscription_values(pmWebGroupBaton *baton, pmWebValueSet *valueset)
+{
+    pmWebSubscription	*sp = baton->subscription;
+    char		pmidstr[20];
+
+    if (baton->name)
+	pmwebapi_subscription_vset(sp, baton->name);
+    else
+	baton->name = sdsempty();
+    baton->name = sdscpylen(baton->name, valueset->name, sdslen(valueset->name));
+    baton->pmid = valueset->pmid;
+    baton->numinsts = 0;
+
+    pmIDStr_r(valueset->pmid, pmidstr, sizeof(pmidstr));
+    sp->vset = sdscatfmt(sdsempty(),
+			"{\"pmid\":\"%s\",\"name\":\"%S\",\"instances\":[",
+			pmidstr, valueset->name);
+    return 0;
+}
+
+static int
+on_pmwebapi_subscription_value(pmWebGroupBaton *baton, pmWebValue *value)
+{
+    pmWebSubscription	*sp = baton->subscription;
+    sds			vset = sp->vset;
+
+    if (baton->numinsts++ != 0)
+	vset = sdscatlen(vset, ",", 1);
+    if (value->inst == PM_IN_NULL)
+	vset = sdscatfmt(vset, "{\"instance\":null,\"value\":%s}",
+			sdslen(value->value) ? value->value : "null");
+    else
+	vset = sdscatfmt(vset, "{\"instance\":%u,\"value\":%s}", value->inst,
+			sdslen(value->value) ? value->value : "null");
+    sp->vset = vset;
+    return 0;
+}
+
 static int
 on_pmwebapi_fetch(sds context, pmWebResult *fetch, void *arg)
 {
     pmWebGroupBaton	*baton = (pmWebGroupBaton *)arg;
-    sds			result = http_get_buffer(baton->client);
+    sds			result;
 
     pmwebapi_set_context(baton, context);
+    if (baton->subscription)
+	return on_pmwebapi_subscription_fetch(baton, fetch);
 
+    result = pmwebapi_get_buffer(baton);
     baton->numvsets = baton->numinsts = 0;
     if (baton->compat == 0) {
 	result = sdscatfmt(result, "{\"context\":%S", context);
+	if (baton->hostspec)
+	    result = sdscatfmt(result, ",\"hostspec\":%S", baton->hostspec);
 	if (baton->clientid)
 	    result = sdscatfmt(result, ",\"client\":%S", baton->clientid);
 	result = sdscatfmt(result, ",\"timestamp\":%I.%I,",
@@ -278,8 +500,7 @@ on_pmwebapi_fetch(sds context, pmWebResult *fetch, void *arg)
     result = sdscatfmt(result, "\"values\":[");
     baton->suffix = json_push_suffix(baton->suffix, JSON_FLAG_ARRAY);
 
-    http_set_buffer(baton->client, result, HTTP_FLAG_JSON);
-    http_transfer(baton->client);
+    pmwebapi_set_buffer(baton, result);
     return 0;
 }
 
@@ -287,10 +508,13 @@ static int
 on_pmwebapi_fetch_values(sds context, pmWebValueSet *valueset, void *arg)
 {
     pmWebGroupBaton	*baton = (pmWebGroupBaton *)arg;
-    sds			s, result = http_get_buffer(baton->client);
+    sds			s, result;
     char		pmidstr[20];
 
     pmwebapi_set_context(baton, context);
+    if (baton->subscription)
+	return on_pmwebapi_subscription_values(baton, valueset);
+    result = pmwebapi_get_buffer(baton);
 
     /* pmID insufficient to determine uniqueness, use metric name too */
     if (baton->name == NULL)
@@ -324,8 +548,7 @@ on_pmwebapi_fetch_values(sds context, pmWebValueSet *valueset, void *arg)
 				valueset->name);
     baton->suffix = json_push_suffix(baton->suffix, JSON_FLAG_ARRAY);
 
-    http_set_buffer(baton->client, result, HTTP_FLAG_JSON);
-    http_transfer(baton->client);
+    pmwebapi_set_buffer(baton, result);
     return 0;
 }
 
@@ -333,27 +556,34 @@ static int
 on_pmwebapi_fetch_value(sds context, pmWebValue *value, void *arg)
 {
     pmWebGroupBaton	*baton = (pmWebGroupBaton *)arg;
-    sds			result = http_get_buffer(baton->client);
+    sds			result;
 
     assert(value->pmid == baton->pmid);
     pmwebapi_set_context(baton, context);
+    if (baton->subscription)
+	return on_pmwebapi_subscription_value(baton, value);
+    result = pmwebapi_get_buffer(baton);
 
     if (baton->numinsts != 0)
 	result = sdscatlen(result, ",", 1);
     baton->numinsts++;
 
-    if (value->inst == PM_IN_NULL) {
-	result = sdscatfmt(result, "{\"instance\":%s,\"value\":%s}",
-				baton->compat ? "-1" : "null",
-				sdslen(value->value) ? value->value : "null");
-    } else {
-	result = sdscatfmt(result, "{\"instance\":%u,\"value\":%s}",
-				value->inst,
-				sdslen(value->value) ? value->value : "null");
-    }
+    /* hot path for large instance domains, so avoid format parsing */
+    result = json_cat_literal(result, "{\"instance\":");
+    if (value->inst != PM_IN_NULL)
+	result = json_cat_uint(result, (unsigned int)value->inst);
+    else if (baton->compat)
+	result = json_cat_literal(result, "-1");
+    else
+	result = json_cat_literal(result, "null");
+    result = json_cat_literal(result, ",\"value\":");
+    if (sdslen(value->value))
+	result = sdscatsds(result, value->value);
+    else
+	result = json_cat_literal(result, "null");
+    result = sdscatlen(result, "}", 1);
 
-    http_set_buffer(baton->client, result, HTTP_FLAG_JSON);
-    http_transfer(baton->client);
+    pmwebapi_set_buffer(baton, result);
     return 0;
 }
 
@@ -466,6 +696,77 @@ on_pmwebapi_children(sds context, pmWebChildren *children, void *arg)
     return 0;
 }
 
+/*
+ * Complete the protobuf MetricFamily for the current metric - all of
+ * its instances are sent in one message, so these are batched up and
+ * encoded once the next metric (or the end of the scrape) is reached.
+ */
+static void
+pmwebapi_scrape_flush(pmWebGroupBaton *baton)
+{
+    size_t		length;
+    sds			result;
+
+    if (baton->family == NULL || sdslen(baton->family) == 0)
+	return;
+
+    result = http_get_buffer(baton->client);
+    length = sdslen(result);
+    result = open_metrics_proto_family(result, baton->familyname,
+			baton->familyhelp, baton->counter, baton->family);
+    sdsclear(baton->family);
+
+    /* retain a copy of this latest addition for the scrape cache */
+    if (baton->cached)
+	baton->cached = sdscatlen(baton->cached, result + length,
+				sdslen(result) - length);
+
+    http_set_buffer(baton->client, result, HTTP_FLAG_PROTOBUF);
+    http_transfer(baton->client);
+}
+
+static int
+on_pmwebapi_scrape_proto(pmWebGroupBaton *baton, pmWebScrape *scrape)
+{
+    pmWebInstance	*instance = &scrape->instance;
+    pmWebMetric		*metric = &scrape->metric;
+    long long		milliseconds = -1;
+    sds			s, labels = NULL, semantics;
+
+    if (baton->name == NULL)
+	baton->name = sdsempty();
+
+    s = baton->name;
+    if (metric->pmid != baton->pmid || sdscmp(metric->name, s) != 0) {
+	pmwebapi_scrape_flush(baton);	/* complete the previous metric */
+	sdsclear(s);	/* new metric */
+	baton->name = sdscpylen(s, metric->name, sdslen(metric->name));
+	baton->pmid = metric->pmid;
+
+	sdsfree(baton->familyname);
+	baton->familyname = open_metrics_name(metric->name, baton->compat);
+	sdsfree(baton->familyhelp);
+	baton->familyhelp = metric->oneline ? sdsdup(metric->oneline) : NULL;
+	semantics = open_metrics_semantics(metric->sem);
+	baton->counter = (strcmp(semantics, "counter") == 0);
+	sdsfree(semantics);
+	if (baton->family == NULL)
+	    baton->family = sdsempty();
+    }
+
+    if (metric->indom != PM_INDOM_NULL)
+	labels = instance->labels;
+    if (labels == NULL)
+	labels = metric->labels;
+    if (baton->times)
+	milliseconds = (scrape->seconds * 1000) + (scrape->nanoseconds / 1000000);
+
+    baton->family = open_metrics_proto_metric(baton->family, labels,
+			baton->counter, strtod(scrape->value.value, NULL),
+			milliseconds);
+    return 0;
+}
+
 /*
  * https://openmetrics.io/
  *
@@ -481,6 +782,7 @@ on_pmwebapi_scrape(sds context, pmWebScrape *scrape, void *arg)
     pmWebMetric		*metric = &scrape->metric;
     pmWebValue		*value = &scrape->value;
     long long		milliseconds;
+    size_t		length;
     char		pmidstr[20], indomstr[20];
     sds			name = NULL, semantics = NULL, labels = NULL;
     sds			s, result;
@@ -488,8 +790,11 @@ on_pmwebapi_scrape(sds context, pmWebScrape *scrape, void *arg)
     pmwebapi_set_context(baton, context);
     if (open_metrics_type_check(metric->type) < 0)
 	return 0;
+    if (baton->protobuf)
+	return on_pmwebapi_scrape_proto(baton, scrape);
 
     result = http_get_buffer(baton->client);
+    length = sdslen(result);
     name = open_metrics_name(metric->name, baton->compat);
 
     if (baton->name == NULL)
@@ -544,6 +849,11 @@ value:
     sdsfree(semantics);
     sdsfree(name);
 
+    /* retain a copy of this latest addition for the scrape cache */
+    if (baton->cached)
+	baton->cached = sdscatlen(baton->cached, result + length,
+				sdslen(result) - length);
+
     http_set_buffer(baton->client, result, HTTP_FLAG_TEXT);
     http_transfer(baton->client);
     return 0;
@@ -568,7 +878,10 @@ on_pmwebapi_scrape_labels(sds context, pmWebLabelSet *labelset, void *arg)
     }
     if (baton->labels == NULL)
 	baton->labels = dictCreate(&sdsOwnDictCallBacks, NULL);
-    open_metrics_labels(labelset, baton->labels);
+    if (baton->protobuf)
+	open_metrics_proto_labels(labelset, baton->labels);
+    else
+	open_metrics_labels(labelset, baton->labels);
     dictRelease(baton->labels);	/* reset for next caller */
     baton->labels = NULL;
 }
@@ -579,23 +892,33 @@ on_pmwebapi_check(sds context, pmWebAccess *access,
 {
     pmWebGroupBaton	*baton = (pmWebGroupBaton *)arg;
     struct client	*client = (struct client *)baton->client;
+    sds			username, password;
 
     if (pmDebugOptions.auth || pmDebugOptions.series)
 	fprintf(stderr, "%s: client=%p (ctx=%s) user=%s pass=*** realm=%s\n",
 		"on_pmwebapi_check", client, context,
 		access->username, access->realm);
 
+    /* shared subscription fetches use the credentials of the first client */
+    if (client) {
+	username = client->u.http.username;
+	password = client->u.http.password;
+    } else {
+	username = baton->username;
+	password = baton->password;
+    }
+
     /* Does this context require username/password authentication? */
     if (access->username != NULL ||
 		__pmServerHasFeature(PM_SERVER_FEATURE_CREDS_REQD)) {
 	if (access->username == NULL || access->password == NULL ||
-		client->u.http.username == NULL || client->u.http.password == NULL) {
+		username == NULL || password == NULL) {
 	    *message = sdsnew("authentication required");
 	    *status = -EAGAIN;
 	    return -1;
 	}
-	if (sdscmp(access->username, client->u.http.username) != 0 ||
-		sdscmp(access->password, client->u.http.password) != 0) {
+	if (sdscmp(access->username, username) != 0 ||
+		sdscmp(access->password, password) != 0) {
 	    *message = sdsnew("authentication failed");
 	    *status = -EPERM;
 	    return -1;
@@ -605,13 +928,219 @@ on_pmwebapi_check(sds context, pmWebAccess *access,
     return 0;
 }
 
+static int
+pmwebapi_scrape_compare(const void *a, const void *b)
+{
+    return strcmp(*(const char **)a, *(const char **)b);
+}
+
+/*
+ * Scrape cache key - the request parameters (sorted by name, to be
+ * independent of their order in the URL), any context from the URL
+ * path, compatibility mode and the Accept header.
+ */
+static sds
+pmwebapi_scrape_key(struct client *client, pmWebGroupBaton *baton)
+{
+    dict		*parameters = client->u.http.parameters;
+    dictIterator	*iterator;
+    dictEntry		*entry;
+    sds			key, accept, *names = NULL;
+    unsigned int	i, count = 0;
+
+    key = sdscatfmt(sdsempty(), "compat=%u", baton->compat);
+    if (baton->context)
+	key = sdscatfmt(key, "&loop=%u&path=%S",
+			client->proxy->worker, baton->context);
+    if (parameters && dictSize(parameters) > 0) {
+	if ((names = calloc(dictSize(parameters), sizeof(sds))) == NULL) {
+	    sdsfree(key);
+	    return NULL;
+	}
+	iterator = dictGetIterator(parameters);
+	while ((entry = dictNext(iterator)) != NULL)
+	    names[count++] = (sds)dictGetKey(entry);
+	dictReleaseIterator(iterator);
+	qsort(names, count, sizeof(sds), pmwebapi_scrape_compare);
+	for (i = 0; i < count; i++) {
+	    if (sdscmp(names[i], PARAM_CONTEXT) == 0)
+		key = sdscatfmt(key, "&loop=%u", client->proxy->worker);
+	    key = sdscatfmt(key, "&%S=%S", names[i],
+			(sds)dictFetchValue(parameters, names[i]));
+	}
+	free(names);
+    }
+    if ((accept = http_get_header(client, "Accept")) != NULL)
+	key = sdscatfmt(key, "&accept=%S", accept);
+    return key;
+}
+
+static void
+pmwebapi_scrape_free(pmWebScrapeEntry *entry)
+{
+    sdsfree(entry->body);
+    sdsfree(entry->etag);
+    free(entry);
+}
+
+/* drop expired scrape cache entries - lock must be held by the caller */
+static void
+pmwebapi_scrape_expire(uint64_t now)
+{
+    pmWebScrapeEntry	*value;
+    dictIterator	*iterator;
+    dictEntry		*entry;
+
+    iterator = dictGetSafeIterator(scrape_cache);
+    while ((entry = dictNext(iterator)) != NULL) {
+	value = (pmWebScrapeEntry *)dictGetVal(entry);
+	if (now >= value->expires) {
+	    dictDelete(scrape_cache, dictGetKey(entry));
+	    pmwebapi_scrape_free(value);
+	}
+    }
+    dictReleaseIterator(iterator);
+}
+
+static int
+pmwebapi_etag_match(sds header, sds etag)
+{
+    if (header == NULL)
+	return 0;
+    if (strcmp(header, "*") == 0)
+	return 1;
+    return strstr(header, etag) != NULL;
+}
+
+/*
+ * Serve a /metrics request from the scrape cache, if possible - else
+ * prepare the request for caching of the response once it completes.
+ * Returns non-zero if the request has already been responded to.
+ */
+static int
+pmwebapi_scrape_lookup(struct client *client, pmWebGroupBaton *baton)
+{
+    pmWebScrapeEntry	*value;
+    http_flags_t	flags = client->u.http.flags;
+    uint64_t		now;
+    unsigned int	serial = 0;
+    sds			key, body = NULL, etag = NULL;
+
+    /* never share responses for authenticated requests */
+    if (client->u.http.username != NULL ||
+	__pmServerHasFeature(PM_SERVER_FEATURE_CREDS_REQD))
+	return 0;
+    if ((key = pmwebapi_scrape_key(client, baton)) == NULL)
+	return 0;
+
+    now = uv_hrtime();
+    uv_mutex_lock(&scrape_cache_lock);
+    if ((value = (pmWebScrapeEntry *)dictFetchValue(scrape_cache, key)) != NULL &&
+	now < value->expires) {
+	body = sdsdup(value->body);
+	etag = sdsdup(value->etag);
+	flags |= value->flags;
+    } else {
+	serial = ++scrape_cache_serial;
+    }
+    uv_mutex_unlock(&scrape_cache_lock);
+
+    if (etag == NULL) {
+	/* cache miss - render afresh, with a new entity tag for it */
+	baton->cachekey = key;
+	baton->cached = sdsempty();
+	baton->etag = sdscatprintf(sdsempty(), "\"%x-%llx\"",
+			serial, (unsigned long long)now);
+	http_add_header(client, "ETag", baton->etag);
+	return 0;
+    }
+
+    if (pmDebugOptions.http)
+	fprintf(stderr, "%s: client %p cache hit %s (etag=%s)\n",
+			"pmwebapi_scrape_lookup", client, key, etag);
+    sdsfree(key);
+
+    http_add_header(client, "ETag", etag);
+    if (pmwebapi_etag_match(http_get_header(client, "If-None-Match"), etag)) {
+	sdsfree(body);
+	http_reply(client, sdsempty(), HTTP_STATUS_NOT_MODIFIED,
+			flags, baton->options);
+    } else {
+	http_reply(client, body, HTTP_STATUS_OK, flags, baton->options);
+    }
+    sdsfree(etag);
+    return 1;
+}
+
+/* completed a fresh scrape - add the rendered response to the cache */
+static void
+pmwebapi_scrape_store(pmWebGroupBaton *baton, sds suffix, http_flags_t flags)
+{
+    pmWebScrapeEntry	*value, *previous;
+    uint64_t		now = uv_hrtime();
+
+    if ((value = calloc(1, sizeof(*value))) == NULL)
+	return;
+    value->body = sdscatsds(baton->cached, suffix);
+    value->etag = baton->etag;
+    value->flags = flags & (HTTP_FLAG_JSON | HTTP_FLAG_TEXT | HTTP_FLAG_HTML |
+			    HTTP_FLAG_UTF8 | HTTP_FLAG_UTF16);
+    value->expires = now + scrape_cache_ttl;
+    baton->cached = baton->etag = NULL;
+
+    uv_mutex_lock(&scrape_cache_lock);
+    pmwebapi_scrape_expire(now);
+    if ((previous = (pmWebScrapeEntry *)dictFetchValue(scrape_cache,
+					baton->cachekey)) != NULL) {
+	dictDelete(scrape_cache, baton->cachekey);
+	pmwebapi_scrape_free(previous);
+    }
+    dictAdd(scrape_cache, baton->cachekey, value);
+    uv_mutex_unlock(&scrape_cache_lock);
+}
+
+/*
+ * Complete the response of one member of a multi-context fetch, which
+ * is a fetch result object or, on failure, an error object in its place.
+ */
+static void
+pmwebapi_member_finish(pmWebGroupBaton *member, sds context,
+		int status, sds message)
+{
+    sds			quoted, result = member->buffer;
+
+    member->buffer = NULL;
+    if (status == 0 && member->suffix) {
+	result = sdscatsds(result ? result : sdsempty(), member->suffix);
+    } else {
+	sdsfree(result);
+	result = sdsnewlen("{", 1);
+	if (context)
+	    result = sdscatfmt(result, "\"context\":%S,", context);
+	if (member->hostspec)
+	    result = sdscatfmt(result, "\"hostspec\":%S,", member->hostspec);
+	if (status == 0) {
+	    result = sdscat(result, "\"success\":true}");
+	} else {
+	    quoted = message ? json_string(message) : sdsnew("\"(none)\"");
+	    result = sdscatfmt(result, "\"message\":%S,\"success\":false}",
+			quoted);
+	    sdsfree(quoted);
+	}
+    }
+    sdsfree(member->suffix);
+    member->suffix = NULL;
+    sdstrim(result, "\r\n");
+    member->buffer = result;
+}
+
 static void
 on_pmwebapi_done(sds context, int status, sds message, void *arg)
 {
     pmWebGroupBaton	*baton = (pmWebGroupBaton *)arg;
     struct client	*client = (struct client *)baton->client;
     http_options_t	options = baton->options;
-    http_flags_t	flags = client->u.http.flags;
+    http_flags_t	flags;
     http_code_t		code;
     sds			quoted, msg;
 
@@ -619,6 +1148,23 @@ on_pmwebapi_done(sds context, int status, sds message, void *arg)
 	fprintf(stderr, "%s: client=%p (sts=%d,msg=%s)\n", "on_pmwebapi_done",
 			client, status, message ? message : "");
 
+    if (baton->parent) {
+	pmwebapi_member_finish(baton, context, status, message);
+	return;
+    }
+    if (baton->subscription) {	/* shared fetch, see pmwebapi_tick_done */
+	if (baton->name)
+	    pmwebapi_subscription_vset(baton->subscription, baton->name);
+	baton->subscription->status = status;
+	sdsfree(baton->subscription->message);
+	baton->subscription->message = message ? sdsdup(message) : NULL;
+	return;
+    }
+
+    if (status == 0 && baton->protobuf)
+	pmwebapi_scrape_flush(baton);	/* final protobuf metric family */
+    flags = client->u.http.flags;
+
     if (status == 0) {
 	code = HTTP_STATUS_OK;
 	/* complete current response with JSON suffix if needed */
@@ -635,6 +1181,8 @@ on_pmwebapi_done(sds context, int status, sds message, void *arg)
 	    }
 	}
 	baton->suffix = NULL;
+	if (baton->cachekey)
+	    pmwebapi_scrape_store(baton, msg, flags);
     } else {
 	flags |= HTTP_FLAG_JSON;	/* all errors in JSON */
 	if (((code = client->u.http.parser.status_code)) == 0) {
@@ -666,7 +1214,10 @@ on_pmwebapi_info(pmLogLevel level, sds message, void *arg)
 {
     pmWebGroupBaton	*baton = (pmWebGroupBaton *)arg;
 
-    proxylog(level, message, baton->client->proxy);
+    if (baton->client == NULL)
+	proxylog(level, message, baton->subscription->proxy);
+    else
+	proxylog(level, message, baton->client->proxy);
 }
 
 static pmWebGroupSettings pmwebapi_settings = {
@@ -721,6 +1272,17 @@ pmwebapi_setup_request_parameters(struct client *client,
 	break;
 
     case RESTKEY_FETCH:
+	/* many contexts or hosts at once: contexts=id,... or hostspecs=... */
+	if (parameters &&
+	    ((entry = dictFind(parameters, PARAM_CONTEXTS)) != NULL ||
+	     (entry = dictFind(parameters, PARAM_HOSTSPECS)) != NULL)) {
+	    value = dictGetVal(entry);
+	    baton->byhost = (sdscmp(dictGetKey(entry), PARAM_HOSTSPECS) == 0);
+	    baton->members = sdssplitlen(value, sdslen(value), ",", 1,
+					&baton->nmembers);
+	    if (baton->members == NULL || baton->nmembers == 0)
+		client->u.http.parser.status_code = HTTP_STATUS_BAD_REQUEST;
+	}
 	if (parameters == NULL ||
 	    (dictFind(parameters, PARAM_NAME) == NULL &&
 	     dictFind(parameters, PARAM_NAMES) == NULL &&
@@ -730,6 +1292,22 @@ pmwebapi_setup_request_parameters(struct client *client,
 	client->u.http.flags |= HTTP_FLAG_JSON;
 	break;
 
+    case RESTKEY_SUBSCRIBE:
+	if (parameters == NULL ||
+	    (dictFind(parameters, PARAM_NAME) == NULL &&
+	     dictFind(parameters, PARAM_NAMES) == NULL &&
+	     dictFind(parameters, PARAM_PMID) == NULL &&
+	     dictFind(parameters, PARAM_PMIDS) == NULL))
+	    client->u.http.parser.status_code = HTTP_STATUS_BAD_REQUEST;
+	/* event streams are sent with chunked transfer encoding */
+	if (client->u.http.parser.http_major == 1 &&
+	    client->u.http.parser.http_minor == 0)
+	    client->u.http.parser.status_code = HTTP_STATUS_BAD_REQUEST;
+	if (parameters && (entry = dictFind(parameters, PARAM_CHANGED)))
+	     baton->changed = (strcmp(dictGetVal(entry), "true") == 0);
+	client->u.http.flags |= HTTP_FLAG_EVENTS;
+	break;
+
     case RESTKEY_INDOM:
 	if (parameters == NULL ||
 	    (dictFind(parameters, PARAM_INDOM) == NULL &&
@@ -846,7 +1424,128 @@ pmwebapi_fetch(uv_work_t *work)
     pmWebGroupBaton	*baton = (pmWebGroupBaton *)work->data;
     struct dict		*params = baton->client->u.http.parameters;
 
-    pmWebGroupFetch(&pmwebapi_settings, baton->context, params, baton);
+    if (baton->parent)
+	params = baton->params;
+    pmWebGroupFetch(&baton->client->proxy->webgroup, baton->context, params, baton);
+}
+
+/* private copy of request parameters for a multi-context fetch member */
+static dict *
+pmwebapi_member_params(dict *parameters, sds hostspec)
+{
+    dictIterator	*iterator;
+    dictEntry		*entry;
+    dict		*params;
+    sds			key;
+
+    params = dictCreate(&sdsOwnDictCallBacks, NULL);
+    iterator = dictGetIterator(parameters);
+    while ((entry = dictNext(iterator)) != NULL) {
+	key = (sds)dictGetKey(entry);
+	if (hostspec && sdscmp(key, PARAM_HOSTSPEC) == 0)
+	    continue;
+	dictAdd(params, sdsdup(key), sdsdup((sds)dictGetVal(entry)));
+    }
+    dictReleaseIterator(iterator);
+    if (hostspec)
+	dictAdd(params, sdsdup(PARAM_HOSTSPEC), sdsdup(hostspec));
+    return params;
+}
+
+static void
+pmwebapi_fetch_batch_put(pmWebGroupBaton *baton)
+{
+    if (--baton->pending == 0)
+	on_pmwebapi_done(NULL, 0, NULL, baton);
+}
+
+/* event loop: send the response of one member as soon as it completes */
+static void
+pmwebapi_fetch_member_done(uv_work_t *work, int status)
+{
+    pmWebGroupBaton	*member = (pmWebGroupBaton *)work->data;
+    pmWebGroupBaton	*baton = member->parent;
+    struct client	*client = member->client;
+    sds			result;
+
+    (void)status;
+    free(work);
+
+    if (member->buffer == NULL)	/* not completed, e.g. cancelled */
+	pmwebapi_member_finish(member, member->context, -EINTR, NULL);
+    result = http_get_buffer(client);
+    if (client->u.http.flags & HTTP_FLAG_NDJSON) {
+	result = sdscatsds(result, member->buffer);
+	result = sdscatlen(result, "\n", 1);
+    } else {
+	if (baton->ndone > 0)
+	    result = sdscatlen(result, ",", 1);
+	result = sdscatsds(result, member->buffer);
+    }
+    baton->ndone++;
+    http_set_buffer(client, result, 0);
+    http_transfer(client);
+
+    pmwebapi_baton_free(member);
+    pmwebapi_fetch_batch_put(baton);
+}
+
+/*
+ * Fetch from many contexts or hosts in one request - each is fetched
+ * concurrently in the worker thread pool, and results are sent back,
+ * in order of completion, as one JSON array or as newline-delimited
+ * JSON (with an "Accept: application/x-ndjson" request header).
+ */
+static int
+pmwebapi_fetch_batch(struct client *client, pmWebGroupBaton *baton)
+{
+    pmWebGroupBaton	*member;
+    uv_work_t		*work;
+    sds			accept;
+    int			i;
+
+    accept = http_get_header(client, "Accept");
+    if (accept && strstr(accept, "application/x-ndjson") != NULL) {
+	client->u.http.flags &= ~HTTP_FLAG_JSON;
+	client->u.http.flags |= HTTP_FLAG_NDJSON;
+	baton->suffix = sdsempty();
+    } else {
+	baton->suffix = json_push_suffix(NULL, JSON_FLAG_ARRAY);
+	http_set_buffer(client, sdsnewlen("[", 1), HTTP_FLAG_JSON);
+    }
+
+    baton->pending = 1;	/* held until all members are submitted */
+    for (i = 0; i < baton->nmembers; i++) {
+	if (sdslen(baton->members[i]) == 0)
+	    continue;
+	if ((member = calloc(1, sizeof(*member))) == NULL)
+	    break;
+	if ((work = (uv_work_t *)calloc(1, sizeof(uv_work_t))) == NULL) {
+	    free(member);
+	    break;
+	}
+	member->client = client;
+	member->parent = baton;
+	member->restkey = RESTKEY_FETCH;
+	member->compat = baton->compat;
+	if (baton->clientid)
+	    member->clientid = sdsdup(baton->clientid);
+	if (baton->byhost) {
+	    member->hostspec = json_string(baton->members[i]);
+	    member->params = pmwebapi_member_params(client->u.http.parameters,
+						    baton->members[i]);
+	} else {
+	    member->context = sdsdup(baton->members[i]);
+	    member->params = pmwebapi_member_params(client->u.http.parameters,
+						    NULL);
+	}
+	work->data = member;
+	baton->pending++;
+	uv_queue_work(client->proxy->events, work,
+			pmwebapi_fetch, pmwebapi_fetch_member_done);
+    }
+    pmwebapi_fetch_batch_put(baton);
+    return 0;
 }
 
 static void
@@ -855,7 +1554,7 @@ pmwebapi_indom(uv_work_t *work)
     pmWebGroupBaton	*baton = (pmWebGroupBaton *)work->data;
     struct dict		*params = baton->client->u.http.parameters;
 
-    pmWebGroupInDom(&pmwebapi_settings, baton->context, params, baton);
+    pmWebGroupInDom(&baton->client->proxy->webgroup, baton->context, params, baton);
 }
 
 static void
@@ -864,7 +1563,7 @@ pmwebapi_metric(uv_work_t *work)
     pmWebGroupBaton	*baton = (pmWebGroupBaton *)work->data;
     struct dict		*params = baton->client->u.http.parameters;
 
-    pmWebGroupMetric(&pmwebapi_settings, baton->context, params, baton);
+    pmWebGroupMetric(&baton->client->proxy->webgroup, baton->context, params, baton);
 }
 
 static void
@@ -873,7 +1572,7 @@ pmwebapi_children(uv_work_t *work)
     pmWebGroupBaton	*baton = (pmWebGroupBaton *)work->data;
     struct dict		*params = baton->client->u.http.parameters;
 
-    pmWebGroupChildren(&pmwebapi_settings, baton->context, params, baton);
+    pmWebGroupChildren(&baton->client->proxy->webgroup, baton->context, params, baton);
 }
 
 
@@ -883,7 +1582,7 @@ pmwebapi_store(uv_work_t *work)
     pmWebGroupBaton	*baton = (pmWebGroupBaton *)work->data;
     struct dict		*params = baton->client->u.http.parameters;
 
-    pmWebGroupStore(&pmwebapi_settings, baton->context, params, baton);
+    pmWebGroupStore(&baton->client->proxy->webgroup, baton->context, params, baton);
 }
 
 static void
@@ -892,7 +1591,7 @@ pmwebapi_derive(uv_work_t *work)
     pmWebGroupBaton	*baton = (pmWebGroupBaton *)work->data;
     struct dict		*params = baton->client->u.http.parameters;
 
-    pmWebGroupDerive(&pmwebapi_settings, baton->context, params, baton);
+    pmWebGroupDerive(&baton->client->proxy->webgroup, baton->context, params, baton);
 }
 
 static void
@@ -901,7 +1600,7 @@ pmwebapi_profile(uv_work_t *work)
     pmWebGroupBaton	*baton = (pmWebGroupBaton *)work->data;
     struct dict		*params = baton->client->u.http.parameters;
 
-    pmWebGroupProfile(&pmwebapi_settings, baton->context, params, baton);
+    pmWebGroupProfile(&baton->client->proxy->webgroup, baton->context, params, baton);
 }
 
 static void
@@ -910,7 +1609,7 @@ pmwebapi_scrape(uv_work_t *work)
     pmWebGroupBaton	*baton = (pmWebGroupBaton *)work->data;
     struct dict		*params = baton->client->u.http.parameters;
     
-    pmWebGroupScrape(&pmwebapi_settings, baton->context, params, baton);
+    pmWebGroupScrape(&baton->client->proxy->webgroup, baton->context, params, baton);
 }
 
 static void
@@ -919,7 +1618,7 @@ pmwebapi_context(uv_work_t *work)
     pmWebGroupBaton	*baton = (pmWebGroupBaton *)work->data;
     struct dict		*params = baton->client->u.http.parameters;
 
-    pmWebGroupContext(&pmwebapi_settings, baton->context, params, baton);
+    pmWebGroupContext(&baton->client->proxy->webgroup, baton->context, params, baton);
 }
 
 static void
@@ -929,6 +1628,238 @@ pmwebapi_work_done(uv_work_t *work, int status)
     free(work);
 }
 
+static void
+pmwebapi_subscription_release(uv_handle_t *handle)
+{
+    pmWebSubscription	*sp = (pmWebSubscription *)handle->data;
+
+    pmwebapi_baton_free(sp->baton);
+    sdsfree(sp->key);
+    sdsfree(sp->message);
+    sdsfree(sp->stamp);
+    sdsfree(sp->vset);
+    sdsfree(sp->all);
+    sdsfree(sp->changed);
+    dictRelease(sp->last);
+    memset(sp, 0, sizeof(*sp));
+    free(sp);
+}
+
+static void
+pmwebapi_subscription_send(pmWebSubscription *sp, pmWebGroupBaton *baton)
+{
+    sds			event, quoted, values;
+
+    if (sp->status < 0) {
+	quoted = sp->message ? json_string(sp->message) : sdsnew("\"(none)\"");
+	event = sdscatfmt(sdsempty(),
+			"event: error\ndata: {\"message\":%S,\"success\":false}\n\n",
+			quoted);
+	sdsfree(quoted);
+    } else {
+	if (baton->changed && baton->primed) {
+	    if (sdslen(sp->changed) == 0)
+		return;
+	    values = sp->changed;
+	} else {
+	    values = sp->all;
+	}
+	event = sdscatfmt(sdsempty(),
+			"data: {\"context\":%S,\"timestamp\":%S,\"values\":[%S]}\n\n",
+			sp->baton->context, sp->stamp, values);
+	baton->primed = 1;
+    }
+    http_stream(baton->client, event);
+}
+
+static void
+pmwebapi_tick_fetch(uv_work_t *work)
+{
+    pmWebSubscription	*sp = (pmWebSubscription *)work->data;
+    pmWebGroupBaton	*baton = sp->baton;
+
+    pmWebGroupFetch(&sp->proxy->webgroup, baton->context, baton->params, baton);
+}
+
+static void
+pmwebapi_tick_done(uv_work_t *work, int status)
+{
+    pmWebSubscription	*sp = (pmWebSubscription *)work->data;
+    pmWebGroupBaton	*baton;
+
+    (void)status;
+    free(work);
+    sp->busy = 0;
+
+    if (sp->closing) {
+	uv_close((uv_handle_t *)&sp->timer, pmwebapi_subscription_release);
+	return;
+    }
+    /* a context created for a hostspec may expire, start a new one */
+    if (sp->status < 0 && sp->baton->byhost && sp->baton->context) {
+	sdsfree(sp->baton->context);
+	sp->baton->context = NULL;
+    }
+    for (baton = sp->subscribers; baton; baton = baton->next)
+	pmwebapi_subscription_send(sp, baton);
+}
+
+static void
+pmwebapi_tick(uv_timer_t *timer)
+{
+    pmWebSubscription	*sp = (pmWebSubscription *)timer->data;
+    uv_work_t		*work;
+
+    if (sp->busy)	/* previous fetch is taking longer than interval */
+	return;
+    if ((work = (uv_work_t *)calloc(1, sizeof(uv_work_t))) == NULL)
+	return;
+    sp->busy = 1;
+    work->data = sp;
+    uv_queue_work(sp->proxy->events, work, pmwebapi_tick_fetch, pmwebapi_tick_done);
+}
+
+static void
+pmwebapi_unsubscribe(pmWebGroupBaton *baton)
+{
+    pmWebSubscription	*sp = baton->subscription;
+    pmWebGroupBaton	**prev;
+
+    for (prev = &sp->subscribers; *prev; prev = &(*prev)->next) {
+	if (*prev == baton) {
+	    *prev = baton->next;
+	    break;
+	}
+    }
+    baton->subscription = NULL;
+    baton->next = NULL;
+    if (sp->subscribers)
+	return;
+
+    /* last subscriber has gone, stop fetching */
+    uv_mutex_lock(&subscriptions_lock);
+    dictDelete(subscriptions, sp->key);
+    uv_mutex_unlock(&subscriptions_lock);
+    uv_timer_stop(&sp->timer);
+    sp->closing = 1;
+    if (sp->busy == 0)
+	uv_close((uv_handle_t *)&sp->timer, pmwebapi_subscription_release);
+}
+
+static sds
+pmwebapi_subscription_key(sds key, dict *parameters, sds name)
+{
+    sds			value = parameters ? dictFetchValue(parameters, name) : NULL;
+
+    key = sdscatsds(key, name);
+    key = sdscatlen(key, "=", 1);
+    if (value)
+	key = sdscatsds(key, value);
+    return sdscatlen(key, "\n", 1);
+}
+
+/*
+ * Register a client for the values of a set of metrics at a given
+ * interval, joining an existing subscription for the same metrics,
+ * host or context, credentials and interval if there is one.
+ */
+static int
+pmwebapi_subscribe(struct client *client, pmWebGroupBaton *baton)
+{
+    pmWebSubscription	*sp;
+    pmWebGroupBaton	*shared;
+    struct timeval	delta = { 1, 0 };
+    unsigned int	interval;
+    dict		*params = client->u.http.parameters;
+    char		*errmsg;
+    sds			key, value;
+
+    if ((value = dictFetchValue(params, PARAM_DELTA)) != NULL &&
+	pmParseInterval(value, &delta, &errmsg) < 0) {
+	client->u.http.parser.status_code = HTTP_STATUS_BAD_REQUEST;
+	value = sdsnew(errmsg);
+	free(errmsg);
+	on_pmwebapi_done(NULL, -EINVAL, value, baton);
+	sdsfree(value);
+	return 1;
+    }
+    if ((interval = delta.tv_sec * 1000 + delta.tv_usec / 1000) == 0)
+	interval = 1;
+
+    key = sdscatprintf(sdsempty(), "%p\n%u\n%s\n%s\n", (void *)client->proxy,
+		interval, baton->context ? baton->context : "",
+		client->u.http.username ? client->u.http.username : "");
+    key = pmwebapi_subscription_key(key, params, PARAM_HOSTSPEC);
+    key = pmwebapi_subscription_key(key, params, PARAM_NAMES);
+    key = pmwebapi_subscription_key(key, params, PARAM_NAME);
+    key = pmwebapi_subscription_key(key, params, PARAM_PMIDS);
+    key = pmwebapi_subscription_key(key, params, PARAM_PMID);
+    key = pmwebapi_subscription_key(key, params, PARAM_RATE);
+
+    uv_mutex_lock(&subscriptions_lock);
+    sp = (pmWebSubscription *)dictFetchValue(subscriptions, key);
+    uv_mutex_unlock(&subscriptions_lock);
+
+    if (sp == NULL) {
+	if ((sp = calloc(1, sizeof(*sp))) == NULL ||
+	    (shared = calloc(1, sizeof(*shared))) == NULL) {
+	    free(sp);
+	    sdsfree(key);
+	    client->u.http.parser.status_code = HTTP_STATUS_INTERNAL_SERVER_ERROR;
+	    on_pmwebapi_done(NULL, -ENOMEM, NULL, baton);
+	    return 1;
+	}
+	shared->restkey = RESTKEY_FETCH;
+	shared->subscription = sp;
+	shared->byhost = (baton->context == NULL);
+	if (baton->context)
+	    shared->context = sdsdup(baton->context);
+	if (client->u.http.username)
+	    shared->username = sdsdup(client->u.http.username);
+	if (client->u.http.password)
+	    shared->password = sdsdup(client->u.http.password);
+	shared->params = pmwebapi_member_params(params, NULL);
+	/* keep a context created here alive between fetches */
+	if (dictFind(shared->params, PARAM_POLLTIME) == NULL)
+	    dictAdd(shared->params, sdsdup(PARAM_POLLTIME),
+		    sdscatfmt(sdsempty(), "%u", interval / 1000 * 2 + 5));
+
+	sp->key = key;
+	sp->proxy = client->proxy;
+	sp->baton = shared;
+	sp->stamp = sdsempty();
+	sp->all = sdsempty();
+	sp->changed = sdsempty();
+	sp->last = dictCreate(&sdsOwnDictCallBacks, NULL);
+	uv_timer_init(client->proxy->events, &sp->timer);
+	sp->timer.data = (void *)sp;
+	uv_timer_start(&sp->timer, pmwebapi_tick, 0, interval);
+
+	uv_mutex_lock(&subscriptions_lock);
+	dictAdd(subscriptions, sp->key, sp);
+	uv_mutex_unlock(&subscriptions_lock);
+    } else {
+	sdsfree(key);
+    }
+
+    baton->subscription = sp;
+    baton->next = sp->subscribers;
+    sp->subscribers = baton;
+
+    /* open the event stream now, then send the latest values if any */
+    http_stream(client, sdsnew(": subscribed\n\n"));
+    if (sp->busy == 0 && sdslen(sp->stamp) > 0)
+	pmwebapi_subscription_send(sp, baton);
+
+    /*
+     * Drop the reference taken for this request - the subscription
+     * lasts until the client goes away, when pmwebapi_data_release
+     * ends it, so it must not keep the client alive itself.
+     */
+    client_put(client);
+    return 0;
+}
+
 static int
 pmwebapi_request_done(struct client *client)
 {
@@ -951,6 +1882,21 @@ pmwebapi_request_done(struct client *client)
 	return 0;
     }
 
+    if (baton->restkey == RESTKEY_SCRAPE &&
+	open_metrics_proto_accept(http_get_header(client, "Accept")))
+	baton->protobuf = 1;
+
+    if (baton->restkey == RESTKEY_SCRAPE && scrape_cache_ttl &&
+	pmwebapi_scrape_lookup(client, baton)) {
+	client_put(client);
+	return 0;
+    }
+
+    if (baton->restkey == RESTKEY_FETCH && baton->members)
+	return pmwebapi_fetch_batch(client, baton);
+    if (baton->restkey == RESTKEY_SUBSCRIBE)
+	return pmwebapi_subscribe(client, baton);
+
     if ((work = (uv_work_t *)calloc(1, sizeof(uv_work_t))) == NULL) {
 	client_put(client);
 	return 1;
@@ -999,6 +1945,20 @@ static void
 pmwebapi_servlet_setup(struct proxy *proxy)
 {
     mmv_registry_t	*metric_registry = proxymetrics(proxy, METRICS_WEBGROUP);
+    pmWebGroupModule	*module = &proxy->webgroup.module;
+    sds			option;
+
+    /* each event loop has its own context cache */
+    proxy->webgroup = pmwebapi_settings;	/* struct copy */
+
+    pmWebGroupSetup(module);
+    pmWebGroupSetEventLoop(module, proxy->events);
+    pmWebGroupSetConfiguration(module, proxy->config);
+    pmWebGroupSetMetricRegistry(module, metric_registry);
+
+    /* request parameter names are shared by all event loops */
+    if (proxy->worker != 0)
+	return;
 
     PARAM_NAMES = sdsnew("names");
     PARAM_NAME = sdsnew("name");
@@ -1010,19 +1970,31 @@ pmwebapi_servlet_setup(struct proxy *proxy)
     PARAM_TIMES = sdsnew("times");
     PARAM_CLIENT = sdsnew("client");
     PARAM_CONTEXT = sdsnew("context");
-
-    pmWebGroupSetup(&pmwebapi_settings.module);
-    pmWebGroupSetEventLoop(&pmwebapi_settings.module, proxy->events);
-    pmWebGroupSetConfiguration(&pmwebapi_settings.module, proxy->config);
-    pmWebGroupSetMetricRegistry(&pmwebapi_settings.module, metric_registry);
+    PARAM_CONTEXTS = sdsnew("contexts");
+    PARAM_HOSTSPECS = sdsnew("hostspecs");
+    PARAM_HOSTSPEC = sdsnew("hostspec");
+    PARAM_DELTA = sdsnew("delta");
+    PARAM_CHANGED = sdsnew("changed");
+    PARAM_RATE = sdsnew("rate");
+    PARAM_POLLTIME = sdsnew("polltimeout");
+
+    if ((option = pmIniFileLookup(proxy->config, "pmproxy", "scrapecache")))
+	scrape_cache_ttl = strtoull(option, NULL, 10) * 1000000000ULL;
+    uv_mutex_init(&scrape_cache_lock);
+    scrape_cache = dictCreate(&sdsKeyDictCallBacks, NULL);
+    uv_mutex_init(&subscriptions_lock);
+    subscriptions = dictCreate(&sdsKeyDictCallBacks, NULL);
 }
 
 static void
 pmwebapi_servlet_close(struct proxy *proxy)
 {
-    pmWebGroupClose(&pmwebapi_settings.module);
+    pmWebGroupClose(&proxy->webgroup.module);
     proxymetrics_close(proxy, METRICS_WEBGROUP);
 
+    if (proxy->worker != 0)
+	return;
+
     sdsfree(PARAM_NAMES);
     sdsfree(PARAM_NAME);
     sdsfree(PARAM_PMIDS);
@@ -1033,6 +2005,21 @@ pmwebapi_servlet_close(struct proxy *proxy)
     sdsfree(PARAM_TIMES);
     sdsfree(PARAM_CLIENT);
     sdsfree(PARAM_CONTEXT);
+    sdsfree(PARAM_CONTEXTS);
+    sdsfree(PARAM_HOSTSPECS);
+    sdsfree(PARAM_HOSTSPEC);
+    sdsfree(PARAM_DELTA);
+    sdsfree(PARAM_CHANGED);
+    sdsfree(PARAM_RATE);
+    sdsfree(PARAM_POLLTIME);
+
+    pmwebapi_scrape_expire(UINT64_MAX);
+    dictRelease(scrape_cache);
+    scrape_cache = NULL;
+    uv_mutex_destroy(&scrape_cache_lock);
+    dictRelease(subscriptions);
+    subscriptions = NULL;
+    uv_mutex_destroy(&subscriptions_lock);
 }
 
 struct servlet pmwebapi_servlet = {
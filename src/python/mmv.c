@@ -89,6 +89,8 @@ MOD_INIT(cmmv)
     dict_add(dict, "MMV_FLAG_NOPREFIX", MMV_FLAG_NOPREFIX);
     dict_add(dict, "MMV_FLAG_PROCESS", MMV_FLAG_PROCESS);
     dict_add(dict, "MMV_FLAG_SENTINEL", MMV_FLAG_SENTINEL);
+    dict_add(dict, "MMV_FLAG_PERCPU", MMV_FLAG_PERCPU);
+    dict_add(dict, "MMV_FLAG_GROWABLE", MMV_FLAG_GROWABLE);
 
     dict_add(dict, "MMV_STRING_TYPE", MMV_STRING_TYPE);
     dict_add(dict, "MMV_NUMBER_TYPE", MMV_NUMBER_TYPE);
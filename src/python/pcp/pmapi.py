@@ -86,6 +86,17 @@
         print("load average %s: %f" % (iname, value()))
     for ts, line in vvv():
         print("%s : %s" % (ts, line()))
+
+
+    # ... or, with numpy installed, whole value sets or archive time
+    # ranges as arrays, converted in C rather than value-by-value:
+
+    insts, loads = vv.arrays()[:2]
+    insts, values = context.pmExtractValueArrays(results, 1,
+                                                 descs[1].contents.type)
+    archive = pmapi.pmContext(c_api.PM_CONTEXT_ARCHIVE, "/path/to/archive")
+    pmid = archive.pmLookupName("kernel.all.load")[0]
+    stamps, insts, values = archive.pmFetchArchiveArrays(pmid)
 """
 # pylint: disable=missing-docstring,line-too-long,broad-except,no-member
 # pylint: disable=too-many-lines,too-many-arguments,too-many-nested-blocks
@@ -388,6 +399,25 @@ class pmAtomValue(Union):
                 value = str(value)
         return value
 
+_numpyTypeD = {c_api.PM_TYPE_32 : '=i4',
+               c_api.PM_TYPE_U32 : '=u4',
+               c_api.PM_TYPE_64 : '=i8',
+               c_api.PM_TYPE_U64 : '=u8',
+               c_api.PM_TYPE_FLOAT : '=f4',
+               c_api.PM_TYPE_DOUBLE : '=f8'}
+
+def numpy_dtype(typed):
+    """Return the numpy module and the dtype for a numeric metric type
+
+    numpy is an optional dependency, so it is only imported on first use
+    of the array interfaces (pmExtractValueArrays, pmFetchArchiveArrays,
+    pmFetchArchiveColumns and fetchgroup indom arrays).
+    """
+    import numpy # pylint: disable=import-outside-toplevel
+    if typed not in _numpyTypeD:
+        raise pmErr(c_api.PM_ERR_TYPE)
+    return numpy, numpy.dtype(_numpyTypeD[typed])
+
 class pmUnits(Structure):
     """
     Compiler-specific bitfields specifying scale and dimension of metric values
@@ -2361,6 +2391,52 @@ class pmContext(object):
             raise pmErr(status)
         return result_p
 
+    def pmFetchArchiveArrays(self, pmid, start=None, finish=None,
+                             outtype=c_api.PM_TYPE_DOUBLE):
+        """PMAPI - Fetch every value of one metric between two times in
+        an archive, as numpy arrays of timestamps (seconds since the epoch),
+        instance identifiers and values, one entry per value
+
+        The archive is read and values converted to outtype (any numeric
+        type) in C; start and finish default to the ends of the archive,
+        and may be floats, timespecs or timevals.  The context is left
+        positioned after the last record read.  Requires numpy.
+
+        (stamps, insts, values) = pmFetchArchiveArrays(pmid)
+        """
+        numpy, dtype = numpy_dtype(outtype)
+        start = 0.0 if start is None else float(start)
+        finish = 0.0 if finish is None else float(finish)
+        status, stamps, insts, values = c_api.pmFetchArchiveValues(self.ctx,
+                                                                   pmid, start,
+                                                                   finish,
+                                                                   outtype)
+        if status < 0:
+            raise pmErr(status)
+        return (numpy.frombuffer(stamps, dtype=numpy.float64),
+                numpy.frombuffer(insts, dtype=numpy.int32),
+                numpy.frombuffer(values, dtype=dtype))
+
+    def pmFetchArchiveColumns(self, pmids, start=None, finish=None,
+                              outtype=c_api.PM_TYPE_DOUBLE):
+        """PMAPI - As for pmFetchArchiveArrays, for several metrics read
+        in a single pass through the archive, returning a list with a
+        (stamps, insts, values) tuple of numpy arrays for each pmid
+
+        [(stamps, insts, values), ...] = pmFetchArchiveColumns(pmids)
+        """
+        numpy, dtype = numpy_dtype(outtype)
+        start = 0.0 if start is None else float(start)
+        finish = 0.0 if finish is None else float(finish)
+        status, columns = c_api.pmFetchArchiveColumns(self.ctx, list(pmids),
+                                                      start, finish, outtype)
+        if status < 0:
+            raise pmErr(status)
+        return [(numpy.frombuffer(stamps, dtype=numpy.float64),
+                 numpy.frombuffer(insts, dtype=numpy.int32),
+                 numpy.frombuffer(values, dtype=dtype))
+                for (stamps, insts, values) in columns]
+
     def pmlabelset_to_dict(self, lset, flags=0xff):
         """ return a dict of a pmLabelSet, i.e. {name: value, ...}
             flags arg is currently ignored
@@ -2615,6 +2691,28 @@ class pmContext(object):
             raise pmErr(status)
         return outAtom
 
+    @staticmethod
+    def pmExtractValueArrays(result_p, vset_idx, intype,
+                             outtype=c_api.PM_TYPE_DOUBLE):
+        """PMAPI - Extract all values of one metric from a pmResult (or
+        pmHighResResult) as numpy arrays of instance identifiers and values
+
+        The conversion to outtype (any numeric type) is done in C, without
+        creating python objects for each value.  Requires numpy.
+
+        (insts, values) = pmExtractValueArrays(result_p, i,
+                                               descs[i].contents.type)
+        """
+        numpy, dtype = numpy_dtype(outtype)
+        highres = isinstance(result_p.contents, pmHighResResult)
+        status, insts, values = c_api.pmExtractValues(addressof(result_p.contents),
+                                                      vset_idx, intype,
+                                                      outtype, highres)
+        if status < 0:
+            raise pmErr(status)
+        return (numpy.frombuffer(insts, dtype=numpy.int32),
+                numpy.frombuffer(values, dtype=dtype))
+
     @staticmethod
     def pmConvScale(inType, inAtom, desc, metric_idx, outUnits):
         """PMAPI - Convert a value to a different scale
@@ -2961,6 +3059,8 @@ LIBPCP.pmExtendFetchGroup_timespec.restype = c_int
 LIBPCP.pmExtendFetchGroup_timespec.argtypes = [c_void_p, POINTER(timespec)]
 LIBPCP.pmFetchGroup.restype = c_int
 LIBPCP.pmFetchGroup.argtypes = [c_void_p]
+LIBPCP.pmFormatFetchGroup.restype = c_int
+LIBPCP.pmFormatFetchGroup.argtypes = [c_void_p, c_int, POINTER(c_char_p)]
 
 
 class fetchgroup(object):
@@ -3089,6 +3189,24 @@ class fetchgroup(object):
                            (lambda i: (lambda: decode_one(self, i)))(i)))
             return vv
 
+        def arrays(self):
+            """
+            Return numpy arrays of the instance codes, values and
+            per-instance status from the most recent fetch() - views
+            of this item's buffers (not copies), so their contents
+            change with each fetch().  Requires numpy.
+            """
+            if self.sts.value < 0:
+                raise pmErr(self.sts.value)
+            numpy, dtype = numpy_dtype(self.pmtype)
+            num = self.num.value
+            insts = numpy.frombuffer(self.icodes, dtype=numpy.int32, count=num)
+            stss = numpy.frombuffer(self.stss, dtype=numpy.int32, count=num)
+            # each value is at the start of an 8-byte pmAtomValue
+            values = numpy.ndarray((num,), dtype=dtype, buffer=self.values,
+                                   strides=(sizeof(pmAtomValue),))
+            return (insts, values, stss)
+
 
     class fetchgroup_event(object):
         """
@@ -3296,6 +3414,19 @@ class fetchgroup(object):
             raise pmErr(sts)
         return sts  # propogate any pmFetch(3) state flags to caller
 
+    def format(self, fmt=c_api.PM_FG_FORMAT_JSON):
+        """Render the values from the last fetch() as one string, of
+        JSON (PM_FG_FORMAT_JSON), CSV rows (PM_FG_FORMAT_CSV) or InfluxDB
+        line protocol (PM_FG_FORMAT_LINE) - see pmFormatFetchGroup(3).
+        Values are formatted in bulk within libpcp, for exporters which
+        would otherwise decode and format each value in python.
+        """
+        text = c_char_p()
+        sts = LIBPCP.pmFormatFetchGroup(self.pmfg, fmt, byref(text))
+        if sts < 0:
+            raise pmErr(sts)
+        return text.value.decode('utf-8', 'replace') if sts else ""
+
     def clear(self):
         """Clear all the metrics in this fetchgroup ready to start again."""
         sts = LIBPCP.pmClearFetchGroup(self.pmfg)
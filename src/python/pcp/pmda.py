@@ -562,6 +562,20 @@ class PMDA(MetricDispatch):
     def set_refresh_metrics(refresh_metrics):
         return cpmda.set_refresh_metrics(refresh_metrics)
 
+    @staticmethod
+    def set_values(cluster, values):
+        """
+        Set the values of all metrics in a cluster from a dictionary
+        mapping item numbers to values, or for metrics with an instance
+        domain to a dictionary (or list) of values indexed by instance.
+        Fetched values are then taken directly from this table, without
+        the fetch callback being called for each metric and instance.
+        Metrics with no item in the table still use the fetch callback.
+        The table is not copied, so is usually set in the refresh
+        callback; a table of None removes the cluster table.
+        """
+        return cpmda.set_values(cluster, values)
+
     @staticmethod
     def set_notify_change():
         cpmda.set_notify_change()
@@ -0,0 +1,160 @@
+""" Bulk loading of archives into numpy columns or pandas DataFrames
+
+Each archive is read in one pass by pmFetchArchiveColumns, which decodes
+and converts values in C and returns numpy arrays, rather than looping
+over pmFetch results in python.  The GIL is released while archive
+records are read, so several archives may be loaded in parallel threads,
+each with its own context.
+
+    from pcp import pmframe
+
+    metrics = ["kernel.all.load", "mem.util.free"]
+    columns, names = pmframe.read_columns(archives, metrics, threads=4)
+    stamps, insts, values = columns["kernel.all.load"]
+
+    frame = pmframe.read_dataframe(archives, metrics, threads=4)
+
+The DataFrame is in "long" form, one row per value, with timestamp,
+metric, instance (name) and value columns; pyarrow.Table.from_pandas()
+converts it into Arrow record batches.  Both numpy and (for DataFrames)
+pandas are imported only when needed.
+"""
+#
+# Copyright (C) 2026 Red Hat.
+#
+# This file is part of the "pcp" module, the python interfaces for the
+# Performance Co-Pilot toolkit.
+#
+# This program is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License as published by the
+# Free Software Foundation; either version 2 of the License, or (at your
+# option) any later version.
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+# or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+# for more details.
+#
+# pylint: disable=too-many-arguments,too-many-locals
+#
+
+import threading
+from pcp import pmapi
+import cpmapi as c_api
+
+
+def read_archive(archive, metrics, start=None, finish=None,
+                 outtype=c_api.PM_TYPE_DOUBLE):
+    """Read metrics from one archive over the [start, finish] window,
+    as dicts of {metric: (stamps, insts, values)} numpy arrays and of
+    {metric: {inst: name}} for the metrics with instance domains.
+    Metrics absent from the archive are absent from both dicts.
+    """
+    ctx = pmapi.pmContext(c_api.PM_CONTEXT_ARCHIVE, archive)
+    try:
+        pmids = ctx.pmLookupName(metrics, relaxed=1)
+    except pmapi.pmErr:
+        return {}, {}
+    found = [(metric, pmid) for (metric, pmid) in zip(metrics, pmids)
+             if pmid != c_api.PM_ID_NULL]
+    if not found:
+        return {}, {}
+
+    names = {}
+    descs = ctx.pmLookupDescs([pmid for (_, pmid) in found])
+    for (metric, _), desc in zip(found, descs):
+        if desc.contents.indom != c_api.PM_INDOM_NULL:
+            instL, nameL = ctx.pmGetInDomArchive(desc)
+            names[metric] = dict(zip(instL or [], nameL or []))
+
+    columns = ctx.pmFetchArchiveColumns([pmid for (_, pmid) in found],
+                                        start, finish, outtype)
+    return dict(zip([metric for (metric, _) in found], columns)), names
+
+
+def read_columns(archives, metrics, start=None, finish=None, threads=1,
+                 outtype=c_api.PM_TYPE_DOUBLE):
+    """Read metrics from one or more archives (in the order given, which
+    should be time order) into {metric: (stamps, insts, values)} numpy
+    arrays, with a {metric: {inst: name}} dict of instance names.  With
+    threads greater than one, archives are read concurrently.
+    """
+    if isinstance(archives, str):
+        archives = [archives]
+    if isinstance(metrics, str):
+        metrics = [metrics]
+    numpy = pmapi.numpy_dtype(outtype)[0]
+    results = [None] * len(archives)
+    errors = []
+    lock = threading.Lock()
+    pending = list(range(len(archives)))
+
+    def worker():
+        while True:
+            with lock:
+                if not pending or errors:
+                    return
+                i = pending.pop(0)
+            try:
+                results[i] = read_archive(archives[i], metrics,
+                                          start, finish, outtype)
+            except Exception as error: # pylint: disable=broad-except
+                with lock:
+                    errors.append(error)
+
+    if threads <= 1 or len(archives) <= 1:
+        worker()
+    else:
+        workers = [threading.Thread(target=worker)
+                   for _ in range(min(threads, len(archives)))]
+        for thread in workers:
+            thread.start()
+        for thread in workers:
+            thread.join()
+    if errors:
+        raise errors[0]
+
+    columns, names = {}, {}
+    for metric in metrics:
+        parts = [result[0][metric] for result in results
+                 if metric in result[0]]
+        if not parts:
+            continue
+        if len(parts) == 1:
+            columns[metric] = parts[0]
+        else:
+            columns[metric] = tuple(numpy.concatenate([part[i] for part in parts])
+                                    for i in range(3))
+        for result in results:
+            if metric in result[1]:
+                names.setdefault(metric, {}).update(result[1][metric])
+    return columns, names
+
+
+def read_dataframe(archives, metrics, start=None, finish=None, threads=1,
+                   outtype=c_api.PM_TYPE_DOUBLE):
+    """Read metrics as for read_columns, into a pandas DataFrame with
+    one row per value and timestamp (UTC), metric, instance and value
+    columns.  Instance is the instance name, or None for metrics with
+    no instance domain.
+    """
+    import pandas # pylint: disable=import-outside-toplevel
+    columns, names = read_columns(archives, metrics, start, finish,
+                                  threads, outtype)
+    frames = []
+    for metric in columns:
+        stamps, insts, values = columns[metric]
+        if metric in names:
+            instance = pandas.Series(insts).map(names[metric])
+        else:
+            instance = pandas.Series([None] * len(insts), dtype=object)
+        frames.append(pandas.DataFrame({
+            'timestamp': pandas.to_datetime(stamps, unit='s', utc=True),
+            'metric': pandas.Categorical([metric] * len(stamps),
+                                         categories=list(columns)),
+            'instance': instance,
+            'value': values}))
+    if not frames:
+        return pandas.DataFrame(columns=['timestamp', 'metric',
+                                         'instance', 'value'])
+    return pandas.concat(frames, ignore_index=True)
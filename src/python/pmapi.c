@@ -1297,6 +1297,330 @@ getOptionLocalPMDA(PyObject *self, PyObject *args)
     return Py_BuildValue("i", options.Lflag);
 }
 
+/*
+ * Bulk value extraction for numpy.frombuffer() - all values of one
+ * metric are converted here into contiguous bytearrays of instance
+ * identifiers and values (and timestamps, for an archive time range)
+ * so that python tools need not create objects for every value.
+ */
+typedef struct {
+    PyObject	*array;		/* bytearray, possibly over-allocated */
+    Py_ssize_t	count;		/* number of items in use */
+    Py_ssize_t	size;		/* bytes per item */
+} valueArray;
+
+static int
+valueSize(int type)
+{
+    switch (type) {
+    case PM_TYPE_32:
+    case PM_TYPE_U32:
+    case PM_TYPE_FLOAT:
+	return 4;
+    case PM_TYPE_64:
+    case PM_TYPE_U64:
+    case PM_TYPE_DOUBLE:
+	return 8;
+    }
+    return 0;
+}
+
+static int
+valueArrayInit(valueArray *ap, Py_ssize_t size, Py_ssize_t count)
+{
+    ap->count = 0;
+    ap->size = size;
+    ap->array = PyByteArray_FromStringAndSize(NULL, size * count);
+    return ap->array ? 0 : -1;
+}
+
+static int
+valueArrayReserve(valueArray *ap, Py_ssize_t more)
+{
+    Py_ssize_t	need = (ap->count + more) * ap->size;
+    Py_ssize_t	have = PyByteArray_GET_SIZE(ap->array);
+
+    if (need <= have)
+	return 0;
+    if (need < 2 * have)
+	need = 2 * have;
+    return PyByteArray_Resize(ap->array, need);
+}
+
+static int
+valueArrayFinish(valueArray *ap)
+{
+    return PyByteArray_Resize(ap->array, ap->count * ap->size);
+}
+
+/*
+ * Append every value in a value set, with its instance and (optionally)
+ * the timestamp; space must already be reserved in each array.  Only
+ * pmExtractValue runs per value, so the caller may drop the GIL.
+ */
+static int
+valueArrayAppend(pmValueSet *vsp, int type, int outtype, double stamp,
+		valueArray *times, valueArray *insts, valueArray *values)
+{
+    pmAtomValue	atom;
+    char	*vp = PyByteArray_AS_STRING(values->array);
+    int		*ip = (int *)PyByteArray_AS_STRING(insts->array);
+    double	*tp = times ? (double *)PyByteArray_AS_STRING(times->array) : NULL;
+    int		i, sts;
+
+    for (i = 0; i < vsp->numval; i++) {
+	if ((sts = pmExtractValue(vsp->valfmt, &vsp->vlist[i],
+				type, &atom, outtype)) < 0)
+	    return sts;
+	/* every pmAtomValue member starts at offset zero */
+	memcpy(vp + values->count * values->size, &atom, values->size);
+	values->count++;
+	ip[insts->count++] = vsp->vlist[i].inst;
+	if (tp)
+	    tp[times->count++] = stamp;
+    }
+    return 0;
+}
+
+static PyObject *
+extractValues(PyObject *self, PyObject *args, PyObject *keywords)
+{
+    unsigned long long address;
+    pmValueSet *vsp;
+    valueArray insts, values;
+    int index, type, outtype = PM_TYPE_DOUBLE, highres = 0;
+    int numpmid, size, sts;
+    char *keyword_list[] = {"result", "index", "type", "outtype", "highres", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywords,
+			"Kii|ii:pmExtractValues", keyword_list,
+			&address, &index, &type, &outtype, &highres))
+	return NULL;
+    if (address == 0) {
+	PyErr_SetString(PyExc_ValueError, "pmExtractValues needs a result");
+	return NULL;
+    }
+    if (highres) {
+	pmHighResResult *rp = (pmHighResResult *)(uintptr_t)address;
+	numpmid = rp->numpmid;
+	vsp = (index >= 0 && index < numpmid) ? rp->vset[index] : NULL;
+    } else {
+	pmResult *rp = (pmResult *)(uintptr_t)address;
+	numpmid = rp->numpmid;
+	vsp = (index >= 0 && index < numpmid) ? rp->vset[index] : NULL;
+    }
+    if (vsp == NULL)
+	return Py_BuildValue("(iOO)", -EINVAL, Py_None, Py_None);
+    if ((size = valueSize(outtype)) == 0)
+	return Py_BuildValue("(iOO)", PM_ERR_TYPE, Py_None, Py_None);
+    if (vsp->numval < 0)
+	return Py_BuildValue("(iOO)", vsp->numval, Py_None, Py_None);
+
+    if (valueArrayInit(&insts, sizeof(int), vsp->numval) < 0)
+	return NULL;
+    if (valueArrayInit(&values, size, vsp->numval) < 0) {
+	Py_DECREF(insts.array);
+	return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    sts = valueArrayAppend(vsp, type, outtype, 0.0, NULL, &insts, &values);
+    Py_END_ALLOW_THREADS
+    if (sts < 0) {
+	Py_DECREF(insts.array);
+	Py_DECREF(values.array);
+	return Py_BuildValue("(iOO)", sts, Py_None, Py_None);
+    }
+    return Py_BuildValue("(iNN)", 0, insts.array, values.array);
+}
+
+/*
+ * Every value of some metrics between two times in an archive context,
+ * as three columns (timestamps, instances, values) per metric, reading
+ * only those records that contain at least one of the metrics.  The
+ * context is left positioned after the last record read.  On failure
+ * from python allocation, an exception is set and -ENOMEM returned.
+ */
+static int
+archiveColumns(int context, pmID *pmids, int numpmid,
+		double start, double finish, int outtype, valueArray *columns)
+{
+    pmHighResResult *rp;
+    struct timespec origin;
+    valueArray *cp;
+    pmDesc desc;
+    double stamp;
+    int *types, i, size, numval, sts;
+
+    if ((size = valueSize(outtype)) == 0)
+	return PM_ERR_TYPE;
+    if ((sts = pmUseContext(context)) < 0)
+	return sts;
+    if ((types = malloc(numpmid * sizeof(int))) == NULL) {
+	PyErr_NoMemory();
+	return -ENOMEM;
+    }
+    for (i = 0; i < numpmid; i++) {
+	if ((sts = pmLookupDesc(pmids[i], &desc)) < 0)
+	    goto done;
+	types[i] = desc.type;
+    }
+    origin.tv_sec = (time_t)start;
+    origin.tv_nsec = (long)((start - (double)origin.tv_sec) * 1000000000.0);
+    if ((sts = pmSetModeHighRes(PM_MODE_FORW, &origin, NULL)) < 0)
+	goto done;
+
+    for (i = 0, cp = columns; i < numpmid; i++, cp += 3) {
+	if (valueArrayInit(&cp[0], sizeof(double), 256) < 0 ||
+	    valueArrayInit(&cp[1], sizeof(int), 256) < 0 ||
+	    valueArrayInit(&cp[2], size, 256) < 0) {
+	    sts = -ENOMEM;
+	    goto done;
+	}
+    }
+
+    for (;;) {
+	Py_BEGIN_ALLOW_THREADS
+	sts = pmFetchHighRes(numpmid, pmids, &rp);
+	Py_END_ALLOW_THREADS
+	if (sts < 0) {
+	    if (sts == PM_ERR_EOL)
+		sts = 0;
+	    break;
+	}
+	sts = 0;
+	stamp = pmtimespecToReal(&rp->timestamp);
+	if (finish > 0.0 && stamp > finish) {
+	    pmFreeHighResResult(rp);
+	    break;
+	}
+	/* <mark> records have no value sets, skip any errors too */
+	for (i = 0, cp = columns; i < rp->numpmid && i < numpmid; i++, cp += 3) {
+	    if ((numval = rp->vset[i]->numval) <= 0)
+		continue;
+	    if (valueArrayReserve(&cp[0], numval) < 0 ||
+		valueArrayReserve(&cp[1], numval) < 0 ||
+		valueArrayReserve(&cp[2], numval) < 0) {
+		sts = -ENOMEM;
+		break;
+	    }
+	    if ((sts = valueArrayAppend(rp->vset[i], types[i], outtype, stamp,
+					&cp[0], &cp[1], &cp[2])) < 0)
+		break;
+	}
+	pmFreeHighResResult(rp);
+	if (sts < 0)
+	    break;
+    }
+    for (i = 0; sts == 0 && i < 3 * numpmid; i++) {
+	if (valueArrayFinish(&columns[i]) < 0)
+	    sts = -ENOMEM;
+    }
+
+done:
+    free(types);
+    return sts;
+}
+
+static void
+archiveColumnsFree(valueArray *columns, int numpmid)
+{
+    int i;
+
+    for (i = 0; i < 3 * numpmid; i++)
+	Py_CLEAR(columns[i].array);
+}
+
+static PyObject *
+fetchArchiveValues(PyObject *self, PyObject *args, PyObject *keywords)
+{
+    valueArray columns[3];
+    pmID pmid;
+    double start = 0.0, finish = 0.0;
+    int context, outtype = PM_TYPE_DOUBLE, sts;
+    char *keyword_list[] = {"context", "pmid", "start", "finish", "outtype", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywords,
+			"iI|ddi:pmFetchArchiveValues", keyword_list,
+			&context, &pmid, &start, &finish, &outtype))
+	return NULL;
+    memset(columns, 0, sizeof(columns));
+    sts = archiveColumns(context, &pmid, 1, start, finish, outtype, columns);
+    if (sts < 0) {
+	archiveColumnsFree(columns, 1);
+	if (PyErr_Occurred())
+	    return NULL;
+	return Py_BuildValue("(iOOO)", sts, Py_None, Py_None, Py_None);
+    }
+    return Py_BuildValue("(iNNN)", 0, columns[0].array,
+			 columns[1].array, columns[2].array);
+}
+
+/*
+ * As for pmFetchArchiveValues, but for a list of metrics read together
+ * in a single pass through the archive, returning a list of columns.
+ */
+static PyObject *
+fetchArchiveColumns(PyObject *self, PyObject *args, PyObject *keywords)
+{
+    PyObject *list, *seq, *cols, *result = NULL, *item;
+    valueArray *columns = NULL;
+    pmID *pmids = NULL;
+    double start = 0.0, finish = 0.0;
+    Py_ssize_t i, numpmid;
+    int context, outtype = PM_TYPE_DOUBLE, sts;
+    char *keyword_list[] = {"context", "pmids", "start", "finish", "outtype", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywords,
+			"iO|ddi:pmFetchArchiveColumns", keyword_list,
+			&context, &list, &start, &finish, &outtype))
+	return NULL;
+    if ((seq = PySequence_Fast(list, "pmFetchArchiveColumns needs a pmid sequence")) == NULL)
+	return NULL;
+    if ((numpmid = PySequence_Fast_GET_SIZE(seq)) == 0) {
+	PyErr_SetString(PyExc_ValueError, "pmFetchArchiveColumns needs a pmid");
+	goto out;
+    }
+    if ((pmids = malloc(numpmid * sizeof(pmID))) == NULL ||
+	(columns = calloc(3 * numpmid, sizeof(valueArray))) == NULL) {
+	PyErr_NoMemory();
+	goto out;
+    }
+    for (i = 0; i < numpmid; i++) {
+	pmids[i] = (pmID)PyLong_AsUnsignedLongMask(PySequence_Fast_GET_ITEM(seq, i));
+	if (PyErr_Occurred())
+	    goto out;
+    }
+
+    sts = archiveColumns(context, pmids, (int)numpmid, start, finish, outtype, columns);
+    if (sts < 0) {
+	if (!PyErr_Occurred())
+	    result = Py_BuildValue("(iO)", sts, Py_None);
+	goto out;
+    }
+    if ((cols = PyList_New(numpmid)) == NULL)
+	goto out;
+    for (i = 0; i < numpmid; i++) {
+	/* the list takes over the column references */
+	item = Py_BuildValue("(NNN)", columns[3*i].array,
+			     columns[3*i+1].array, columns[3*i+2].array);
+	columns[3*i].array = columns[3*i+1].array = columns[3*i+2].array = NULL;
+	if (item == NULL) {
+	    Py_DECREF(cols);
+	    goto out;
+	}
+	PyList_SET_ITEM(cols, i, item);
+    }
+    result = Py_BuildValue("(iN)", 0, cols);
+
+out:
+    if (columns)
+	archiveColumnsFree(columns, (int)numpmid);
+    free(columns);
+    free(pmids);
+    Py_DECREF(seq);
+    return result;
+}
+
 static PyMethodDef methods[] = {
     { .ml_name = "PM_XTB_SET",
 	.ml_meth = (PyCFunction) setExtendedTimeBase,
@@ -1427,6 +1751,15 @@ static PyMethodDef methods[] = {
     { .ml_name = "pmSetContextOptions",
 	.ml_meth = (PyCFunction) setContextOptions,
         .ml_flags = METH_VARARGS | METH_KEYWORDS},
+    { .ml_name = "pmExtractValues",
+	.ml_meth = (PyCFunction) extractValues,
+        .ml_flags = METH_VARARGS | METH_KEYWORDS },
+    { .ml_name = "pmFetchArchiveValues",
+	.ml_meth = (PyCFunction) fetchArchiveValues,
+        .ml_flags = METH_VARARGS | METH_KEYWORDS },
+    { .ml_name = "pmFetchArchiveColumns",
+	.ml_meth = (PyCFunction) fetchArchiveColumns,
+        .ml_flags = METH_VARARGS | METH_KEYWORDS },
     { .ml_name = "pmUsageMessage",
 	.ml_meth = (PyCFunction) usageMessage,
         .ml_flags = METH_NOARGS },
@@ -1642,6 +1975,12 @@ MOD_INIT(cpmapi)
     dict_add(dict, "PMCD_AGENT_CHANGE", PMCD_AGENT_CHANGE);
     dict_add(dict, "PMCD_LABEL_CHANGE", PMCD_LABEL_CHANGE);
     dict_add(dict, "PMCD_NAMES_CHANGE", PMCD_NAMES_CHANGE);
+    dict_add(dict, "PMCD_CONTEXT_LABEL_CHANGE", PMCD_CONTEXT_LABEL_CHANGE);
+    dict_add(dict, "PMCD_DOMAIN_LABEL_CHANGE", PMCD_DOMAIN_LABEL_CHANGE);
+    dict_add(dict, "PMCD_INDOM_LABEL_CHANGE", PMCD_INDOM_LABEL_CHANGE);
+    dict_add(dict, "PMCD_CLUSTER_LABEL_CHANGE", PMCD_CLUSTER_LABEL_CHANGE);
+    dict_add(dict, "PMCD_ITEM_LABEL_CHANGE", PMCD_ITEM_LABEL_CHANGE);
+    dict_add(dict, "PMCD_INSTANCES_LABEL_CHANGE", PMCD_INSTANCES_LABEL_CHANGE);
 
     dict_add(dict, "PM_MAXLABELS", PM_MAXLABELS);
     dict_add(dict, "PM_MAXLABELJSONLEN", PM_MAXLABELJSONLEN);
@@ -1674,6 +2013,10 @@ MOD_INIT(cpmapi)
     dict_add(dict, "PM_MODE_FORW",   PM_MODE_FORW);
     dict_add(dict, "PM_MODE_BACK",   PM_MODE_BACK);
 
+    dict_add(dict, "PM_FG_FORMAT_JSON", PM_FG_FORMAT_JSON);
+    dict_add(dict, "PM_FG_FORMAT_CSV",  PM_FG_FORMAT_CSV);
+    dict_add(dict, "PM_FG_FORMAT_LINE", PM_FG_FORMAT_LINE);
+
     dict_add(dict, "PM_TEXT_PMID",    PM_TEXT_PMID);
     dict_add(dict, "PM_TEXT_INDOM",   PM_TEXT_INDOM);
     dict_add(dict, "PM_TEXT_DIRECT",  PM_TEXT_DIRECT);
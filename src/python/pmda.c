@@ -69,6 +69,7 @@ static PyObject *attribute_cb_func;
 static PyObject *endcontext_cb_func;
 static PyObject *refresh_all_func;
 static PyObject *refresh_metrics_func;
+static PyObject *cluster_values;	/* cluster:{item:value(s)} dictionary */
 
 static PyThreadState *thread_state;
 
@@ -591,6 +592,92 @@ instance(pmInDom indom, int a, char *b, pmInResult **rp, pmdaExt *pmda)
     return pmdaInstance(indom, a, b, rp, pmda);
 }
 
+/*
+ * Lookup a value in the table set for this metric's cluster (if any)
+ * via set_values(), where each item maps to a single value for metrics
+ * without an instance domain, or to a dictionary or list of values
+ * indexed by instance for the others.  These are plain dictionary and
+ * sequence lookups that never call back into the interpreter.
+ * Returns PM_ERR_PMID when the fetch callback should be used instead.
+ */
+static int
+values_lookup(pmdaMetric *metric, unsigned int inst, pmAtomValue *atom)
+{
+    PyObject *key, *items, *values, *value;
+    unsigned int item = pmID_item(metric->m_desc.pmid);
+    unsigned int cluster = pmID_cluster(metric->m_desc.pmid);
+    char *s;
+    int rc;
+
+    if (cluster_values == NULL)
+	return PM_ERR_PMID;
+    if ((key = PyLong_FromUnsignedLong(cluster)) == NULL)
+	return -ENOMEM;
+    items = PyDict_GetItem(cluster_values, key);	/* borrowed */
+    Py_DECREF(key);
+    if (items == NULL)
+	return PM_ERR_PMID;
+    if ((key = PyLong_FromUnsignedLong(item)) == NULL)
+	return -ENOMEM;
+    value = values = PyDict_GetItem(items, key);	/* borrowed */
+    Py_DECREF(key);
+    if (values == NULL)
+	return PM_ERR_PMID;
+
+    if (metric->m_desc.indom != PM_INDOM_NULL) {
+	if (PyDict_Check(values)) {
+	    if ((key = PyLong_FromUnsignedLong(inst)) == NULL)
+		return -ENOMEM;
+	    value = PyDict_GetItem(values, key);
+	    Py_DECREF(key);
+	} else if (PyList_Check(values)) {
+	    value = ((Py_ssize_t)inst < PyList_GET_SIZE(values)) ?
+		    PyList_GET_ITEM(values, inst) : NULL;
+	} else if (PyTuple_Check(values)) {
+	    value = ((Py_ssize_t)inst < PyTuple_GET_SIZE(values)) ?
+		    PyTuple_GET_ITEM(values, inst) : NULL;
+	} else {
+	    value = NULL;
+	}
+    }
+    if (value == NULL || value == Py_None)
+	return PMDA_FETCH_NOVALUES;
+
+    switch (metric->m_desc.type) {
+	case PM_TYPE_32:
+	    rc = PyArg_Parse(value, "i:fetch_values_s32", &atom->l);
+	    break;
+	case PM_TYPE_U32:
+	    rc = PyArg_Parse(value, "I:fetch_values_u32", &atom->ul);
+	    break;
+	case PM_TYPE_64:
+	    rc = PyArg_Parse(value, "L:fetch_values_s64", &atom->ll);
+	    break;
+	case PM_TYPE_U64:
+	    rc = PyArg_Parse(value, "K:fetch_values_u64", &atom->ull);
+	    break;
+	case PM_TYPE_FLOAT:
+	    rc = PyArg_Parse(value, "f:fetch_values_float", &atom->f);
+	    break;
+	case PM_TYPE_DOUBLE:
+	    rc = PyArg_Parse(value, "d:fetch_values_double", &atom->d);
+	    break;
+	case PM_TYPE_STRING:
+	    /* table holds a reference, value is copied out by pmdaFetch */
+	    if ((rc = PyArg_Parse(value, "s:fetch_values_string", &s)) != 0)
+		atom->cp = s;
+	    break;
+	default:
+	    pmNotifyErr(LOG_ERR, "unsupported metric type in fetch values");
+	    return -ENOTSUP;
+    }
+    if (!rc) {
+	PyErr_Clear();
+	return PM_ERR_TYPE;
+    }
+    return PMDA_FETCH_STATIC;
+}
+
 static int
 fetch_callback(pmdaMetric *metric, unsigned int inst, pmAtomValue *atom)
 {
@@ -600,6 +687,8 @@ fetch_callback(pmdaMetric *metric, unsigned int inst, pmAtomValue *atom)
     unsigned int item = pmID_item(metric->m_desc.pmid);
     unsigned int cluster = pmID_cluster(metric->m_desc.pmid);
 
+    if ((sts = values_lookup(metric, inst, atom)) != PM_ERR_PMID)
+	return sts;
     if (fetch_cb_func == NULL)
 	return PM_ERR_VALUE;
 
@@ -1602,6 +1691,43 @@ set_refresh_metrics(PyObject *self, PyObject *args)
 			&refresh_metrics_func);
 }
 
+/*
+ * Set (or with None, clear) the table of values for one cluster, as
+ * a dictionary mapping item numbers to values - see values_lookup().
+ * The table is referenced rather than copied, so it is normally set
+ * from the refresh callback each time the cluster values are sampled.
+ */
+static PyObject *
+set_values(PyObject *self, PyObject *args)
+{
+    PyObject *key, *values;
+    unsigned int cluster;
+    int sts;
+
+    if (!PyArg_ParseTuple(args, "IO:set_values", &cluster, &values))
+	return NULL;
+    if (values != Py_None && !PyDict_Check(values)) {
+	PyErr_SetString(PyExc_TypeError, "values must be a dictionary or None");
+	return NULL;
+    }
+    if (cluster_values == NULL && (cluster_values = PyDict_New()) == NULL)
+	return NULL;
+    if ((key = PyLong_FromUnsignedLong(cluster)) == NULL)
+	return NULL;
+    if (values != Py_None)
+	sts = PyDict_SetItem(cluster_values, key, values);
+    else if ((sts = PyDict_DelItem(cluster_values, key)) < 0 &&
+	     PyErr_ExceptionMatches(PyExc_KeyError)) {
+	PyErr_Clear();
+	sts = 0;
+    }
+    Py_DECREF(key);
+    if (sts < 0)
+	return NULL;
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
 static PyMethodDef methods[] = {
     { .ml_name = "pmda_pmid", .ml_meth = (PyCFunction)pmda_pmid,
 	.ml_flags = METH_VARARGS|METH_KEYWORDS },
@@ -1674,6 +1800,8 @@ static PyMethodDef methods[] = {
       .ml_flags = METH_VARARGS|METH_KEYWORDS },
     { .ml_name = "set_refresh_all", .ml_meth = (PyCFunction)set_refresh_all,
 	.ml_flags = METH_VARARGS | METH_KEYWORDS },
+    { .ml_name = "set_values", .ml_meth = (PyCFunction)set_values,
+	.ml_flags = METH_VARARGS },
     { .ml_name = "pmda_log", .ml_meth = (PyCFunction)pmda_log,
 	.ml_flags = METH_VARARGS|METH_KEYWORDS },
     { .ml_name = "pmda_dbg", .ml_meth = (PyCFunction)pmda_dbg,